@@ -778,6 +778,7 @@ interface_reset(struct interface *ifp)
     free(babel_ifp->sendbuf);
     babel_ifp->num_buffered_updates = 0;
     babel_ifp->update_bufsize = 0;
+    babel_ifp->full_update = 0;
     if(babel_ifp->buffered_updates)
         free(babel_ifp->buffered_updates);
     babel_ifp->buffered_updates = NULL;
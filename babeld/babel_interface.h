@@ -57,6 +57,8 @@ struct babel_interface {
     struct buffered_update *buffered_updates;
     int num_buffered_updates;
     int update_bufsize;
+    /* A full dump is to be sent with the buffered updates. */
+    char full_update;
     time_t bucket_time;
     unsigned int bucket;
     time_t last_update_time;
@@ -108,6 +110,9 @@ struct buffered_update {
     unsigned char prefix[16];
     unsigned char plen;
     unsigned char pad[3];
+    /* Looked up when the update is flushed. */
+    struct babel_route *route;
+    struct xroute *xroute;
 };
 
 /* init function */
@@ -1143,15 +1143,188 @@ compare_buffered_updates(const void *av, const void *bv)
     return memcmp(a->prefix, b->prefix, 16);
 }
 
+static int
+compare_buffered_prefixes(const void *av, const void *bv)
+{
+    const struct buffered_update *a = av, *b = bv;
+
+    if(a->plen != b->plen)
+        return a->plen < b->plen ? -1 : 1;
+    return memcmp(a->prefix, b->prefix, 16);
+}
+
+/* A full dump is the same on every interface: it is collected, resolved
+   and sorted once, and shared by all the interfaces that have one
+   pending.  It is rebuilt after the set of installed routes or of
+   xroutes has changed, which also keeps the route and xroute pointers
+   it holds valid. */
+static struct buffered_update *full_updates = NULL;
+static int num_full_updates = 0;
+static int full_updates_valid = 0;
+
+void
+invalidate_full_updates(void)
+{
+    full_updates_valid = 0;
+}
+
+static int
+build_full_updates(void)
+{
+    struct route_stream *routes;
+    struct xroute_stream *xroutes;
+    struct babel_route *route;
+    struct xroute *xroute;
+    struct buffered_update *b;
+    int n, i, j;
+
+    if(full_updates_valid)
+        return 1;
+
+    free(full_updates);
+    full_updates = NULL;
+    num_full_updates = 0;
+
+    n = installed_routes_estimate() + xroutes_estimate();
+    if(n == 0) {
+        full_updates_valid = 1;
+        return 1;
+    }
+
+    full_updates = malloc(n * sizeof(struct buffered_update));
+    if(full_updates == NULL) {
+        zlog_err("malloc(full_updates): %s", safe_strerror(errno));
+        return -1;
+    }
+
+    i = 0;
+    xroutes = xroute_stream();
+    if(xroutes == NULL) {
+        zlog_err("Couldn't allocate xroute stream.");
+        return -1;
+    }
+    while(i < n && (xroute = xroute_stream_next(xroutes)) != NULL) {
+        b = &full_updates[i++];
+        memcpy(b->prefix, xroute->prefix, 16);
+        b->plen = xroute->plen;
+        b->route = NULL;
+        b->xroute = xroute;
+    }
+    xroute_stream_done(xroutes);
+
+    routes = route_stream(1);
+    if(routes == NULL) {
+        zlog_err("Couldn't allocate route stream.");
+        return -1;
+    }
+    while(i < n && (route = route_stream_next(routes)) != NULL) {
+        b = &full_updates[i++];
+        memcpy(b->prefix, route->src->prefix, 16);
+        b->plen = route->src->plen;
+        b->route = route;
+        b->xroute = NULL;
+    }
+    route_stream_done(routes);
+
+    /* A prefix may have both an xroute and an installed route, merge
+       them as find_xroute and find_installed_route would. */
+    qsort(full_updates, i, sizeof(struct buffered_update),
+          compare_buffered_prefixes);
+    for(n = 0, j = 0; j < i; j++) {
+        if(n > 0 &&
+           compare_buffered_prefixes(&full_updates[n - 1],
+                                     &full_updates[j]) == 0) {
+            if(full_updates[j].route)
+                full_updates[n - 1].route = full_updates[j].route;
+            if(full_updates[j].xroute)
+                full_updates[n - 1].xroute = full_updates[j].xroute;
+            continue;
+        }
+        full_updates[n++] = full_updates[j];
+    }
+
+    for(j = 0; j < n; j++) {
+        b = &full_updates[j];
+        memcpy(b->id, b->route ? b->route->src->id : myid, 8);
+    }
+
+    qsort(full_updates, n, sizeof(struct buffered_update),
+          compare_buffered_updates);
+    num_full_updates = n;
+    full_updates_valid = 1;
+    return 1;
+}
+
+static void
+really_send_buffered_update(struct interface *ifp, struct buffered_update *b)
+{
+    babel_interface_nfo *babel_ifp = babel_get_if_nfo(ifp);
+    struct xroute *xroute = b->xroute;
+    struct babel_route *route = b->route;
+
+    if(xroute && (!route || xroute->metric <= kernel_metric)) {
+        really_send_update(ifp, myid,
+                           xroute->prefix, xroute->plen,
+                           myseqno, xroute->metric,
+                           NULL, 0);
+    } else if(route) {
+        unsigned char channels[DIVERSITY_HOPS];
+        int chlen;
+        struct interface *route_ifp = route->neigh->ifp;
+        struct babel_interface *babel_route_ifp = NULL;
+        unsigned short metric;
+        unsigned short seqno;
+
+        seqno = route->seqno;
+        metric =
+            route_interferes(route, ifp) ?
+            route_metric(route) :
+            route_metric_noninterfering(route);
+
+        if(metric < INFINITY)
+            satisfy_request(route->src->prefix, route->src->plen,
+                            seqno, route->src->id, ifp);
+        if((babel_ifp->flags & BABEL_IF_SPLIT_HORIZON) &&
+           route->neigh->ifp == ifp)
+            return;
+
+        babel_route_ifp = babel_get_if_nfo(route_ifp);
+        if(babel_route_ifp->channel ==BABEL_IF_CHANNEL_NONINTERFERING) {
+            memcpy(channels, route->channels, DIVERSITY_HOPS);
+        } else {
+            if(babel_route_ifp->channel == BABEL_IF_CHANNEL_UNKNOWN)
+                channels[0] = BABEL_IF_CHANNEL_INTERFERING;
+            else {
+                assert(babel_route_ifp->channel > 0 &&
+                       babel_route_ifp->channel <= 255);
+                channels[0] = babel_route_ifp->channel;
+            }
+            memcpy(channels + 1, route->channels, DIVERSITY_HOPS - 1);
+        }
+
+        chlen = channels_len(channels);
+        really_send_update(ifp, route->src->id,
+                           route->src->prefix,
+                           route->src->plen,
+                           seqno, metric,
+                           channels, chlen);
+        update_source(route->src, seqno, metric);
+    } else {
+    /* There's no route for this prefix.  This can happen shortly
+       after an xroute has been retracted, so send a retraction. */
+        really_send_update(ifp, myid, b->prefix, b->plen,
+                           myseqno, INFINITY, NULL, -1);
+    }
+}
+
 void
 flushupdates(struct interface *ifp)
 {
     babel_interface_nfo *babel_ifp = NULL;
-    struct xroute *xroute;
-    struct babel_route *route;
-    const unsigned char *last_prefix = NULL;
+    struct buffered_update *b, *f = NULL;
+    unsigned char last_prefix[16];
     unsigned char last_plen = 0xFF;
-    int i;
+    int i, j, n, nf = 0, full;
 
     if(ifp == NULL) {
 	struct vrf *vrf = vrf_lookup_by_id(VRF_DEFAULT);
@@ -1162,104 +1335,64 @@ flushupdates(struct interface *ifp)
     }
 
     babel_ifp = babel_get_if_nfo(ifp);
-    if(babel_ifp->num_buffered_updates > 0) {
-        struct buffered_update *b = babel_ifp->buffered_updates;
-        int n = babel_ifp->num_buffered_updates;
+    if(babel_ifp->num_buffered_updates > 0 || babel_ifp->full_update) {
+        b = babel_ifp->buffered_updates;
+        n = babel_ifp->num_buffered_updates;
+        full = babel_ifp->full_update;
 
         babel_ifp->buffered_updates = NULL;
         babel_ifp->update_bufsize = 0;
         babel_ifp->num_buffered_updates = 0;
+        babel_ifp->full_update = 0;
 
         if(!if_up(ifp))
             goto done;
 
+        if(full && build_full_updates() > 0) {
+            f = full_updates;
+            nf = num_full_updates;
+        }
+
         debugf(BABEL_DEBUG_COMMON,"  (flushing %d buffered updates on %s (%d))",
-               n, ifp->name, ifp->ifindex);
+               n + nf, ifp->name, ifp->ifindex);
 
         /* In order to send fewer update messages, we want to send updates
-           with the same router-id together, with IPv6 going out before IPv4. */
+           with the same router-id together, with IPv6 going out before IPv4.
+           The updates buffered on this interface are sorted and merged
+           with the pending full dump, which is already sorted. */
 
         for(i = 0; i < n; i++) {
-            route = find_installed_route(b[i].prefix, b[i].plen);
-            if(route)
-                memcpy(b[i].id, route->src->id, 8);
+            b[i].xroute = find_xroute(b[i].prefix, b[i].plen);
+            b[i].route = find_installed_route(b[i].prefix, b[i].plen);
+            if(b[i].route)
+                memcpy(b[i].id, b[i].route->src->id, 8);
             else
                 memcpy(b[i].id, myid, 8);
         }
 
-        qsort(b, n, sizeof(struct buffered_update), compare_buffered_updates);
+        if(n > 1)
+            qsort(b, n, sizeof(struct buffered_update),
+                  compare_buffered_updates);
 
-        for(i = 0; i < n; i++) {
-            /* The same update may be scheduled multiple times before it is
-               sent out.  Since our buffer is now sorted, it is enough to
-               compare with the previous update. */
+        i = j = 0;
+        while(i < n || j < nf) {
+            struct buffered_update *u;
 
-            if(last_prefix) {
-                if(b[i].plen == last_plen &&
-                   memcmp(b[i].prefix, last_prefix, 16) == 0)
-                    continue;
-            }
+            if(j >= nf ||
+               (i < n && compare_buffered_updates(&b[i], &f[j]) <= 0))
+                u = &b[i++];
+            else
+                u = &f[j++];
 
-            xroute = find_xroute(b[i].prefix, b[i].plen);
-            route = find_installed_route(b[i].prefix, b[i].plen);
-
-            if(xroute && (!route || xroute->metric <= kernel_metric)) {
-                really_send_update(ifp, myid,
-                                   xroute->prefix, xroute->plen,
-                                   myseqno, xroute->metric,
-                                   NULL, 0);
-                last_prefix = xroute->prefix;
-                last_plen = xroute->plen;
-            } else if(route) {
-                unsigned char channels[DIVERSITY_HOPS];
-                int chlen;
-                struct interface *route_ifp = route->neigh->ifp;
-                struct babel_interface *babel_route_ifp = NULL;
-                unsigned short metric;
-                unsigned short seqno;
-
-                seqno = route->seqno;
-                metric =
-                    route_interferes(route, ifp) ?
-                    route_metric(route) :
-                    route_metric_noninterfering(route);
-
-                if(metric < INFINITY)
-                    satisfy_request(route->src->prefix, route->src->plen,
-                                    seqno, route->src->id, ifp);
-                if((babel_ifp->flags & BABEL_IF_SPLIT_HORIZON) &&
-                   route->neigh->ifp == ifp)
-                    continue;
-
-                babel_route_ifp = babel_get_if_nfo(route_ifp);
-                if(babel_route_ifp->channel ==BABEL_IF_CHANNEL_NONINTERFERING) {
-                    memcpy(channels, route->channels, DIVERSITY_HOPS);
-                } else {
-                    if(babel_route_ifp->channel == BABEL_IF_CHANNEL_UNKNOWN)
-                        channels[0] = BABEL_IF_CHANNEL_INTERFERING;
-                    else {
-                        assert(babel_route_ifp->channel > 0 &&
-                               babel_route_ifp->channel <= 255);
-                        channels[0] = babel_route_ifp->channel;
-                    }
-                    memcpy(channels + 1, route->channels, DIVERSITY_HOPS - 1);
-                }
+            /* The same update may be scheduled multiple times before it is
+               sent out.  Since our buffers are sorted, it is enough to
+               compare with the previous update. */
+            if(u->plen == last_plen && memcmp(u->prefix, last_prefix, 16) == 0)
+                continue;
 
-                chlen = channels_len(channels);
-                really_send_update(ifp, route->src->id,
-                                   route->src->prefix,
-                                   route->src->plen,
-                                   seqno, metric,
-                                   channels, chlen);
-                update_source(route->src, seqno, metric);
-                last_prefix = route->src->prefix;
-                last_plen = route->src->plen;
-            } else {
-            /* There's no route for this prefix.  This can happen shortly
-               after an xroute has been retracted, so send a retraction. */
-                really_send_update(ifp, myid, b[i].prefix, b[i].plen,
-                                   myseqno, INFINITY, NULL, -1);
-            }
+            really_send_buffered_update(ifp, u);
+            memcpy(last_prefix, u->prefix, 16);
+            last_plen = u->plen;
         }
         schedule_flush_now(ifp);
     done:
@@ -1351,21 +1484,9 @@ send_update(struct interface *ifp, int urgent,
                ifp->name, format_prefix(prefix, plen));
         buffer_update(ifp, prefix, plen);
     } else {
-        struct route_stream *routes = NULL;
-        send_self_update(ifp);
+        /* Our xroutes and all the installed routes, see flushupdates. */
         debugf(BABEL_DEBUG_COMMON,"Sending update to %s for any.", ifp->name);
-        routes = route_stream(1);
-        if(routes) {
-            while(1) {
-                struct babel_route *route = route_stream_next(routes);
-                if(route == NULL)
-                    break;
-                buffer_update(ifp, route->src->prefix, route->src->plen);
-            }
-            route_stream_done(routes);
-        } else {
-            zlog_err("Couldn't allocate route stream.");
-        }
+        babel_ifp->full_update = 1;
         set_timeout(&babel_ifp->update_timeout, babel_ifp->update_interval);
         babel_ifp->last_update_time = babel_now.tv_sec;
     }
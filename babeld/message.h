@@ -64,6 +64,7 @@ void parse_packet(const unsigned char *from, struct interface *ifp,
                   const unsigned char *packet, int packetlen);
 void flushbuf(struct interface *ifp);
 void flushupdates(struct interface *ifp);
+void invalidate_full_updates(void);
 void send_ack(struct neighbour *neigh, unsigned short nonce,
               unsigned short interval);
 void send_hello_noupdate(struct interface *ifp, unsigned interval);
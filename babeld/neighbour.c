@@ -106,6 +106,7 @@ find_neighbour(const unsigned char *address, struct interface *ifp)
     neigh->rtt = 0;
     neigh->rtt_time = zero;
     neigh->ifp = ifp;
+    neigh->routes = NULL;
     neigh->next = neighs;
     neighs = neigh;
     send_hello(ifp);
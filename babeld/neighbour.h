@@ -42,6 +42,8 @@ struct neighbour {
     unsigned int rtt;
     struct timeval rtt_time;
     struct interface *ifp;
+    /* The routes through this neighbour, linked by neigh_next. */
+    struct babel_route *routes;
 };
 
 extern struct neighbour *neighs;
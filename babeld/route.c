@@ -23,6 +23,8 @@ THE SOFTWARE.
 
 #include <zebra.h>
 #include "if.h"
+#include "prefix.h"
+#include "table.h"
 
 #include "babeld.h"
 #include "util.h"
@@ -37,8 +39,8 @@ THE SOFTWARE.
 
 static void consider_route(struct babel_route *route);
 
-struct babel_route **routes = NULL;
-static int route_slots = 0, max_route_slots = 0;
+static struct route_table *routes = NULL;
+static int route_slots = 0;
 int kernel_metric = 0;
 int diversity_kind = DIVERSITY_NONE;
 int diversity_factor = BABEL_DEFAULT_DIVERSITY_FACTOR;
@@ -47,58 +49,43 @@ int keep_unfeasible = 0;
 int smoothing_half_life = 0;
 static int two_to_the_one_over_hl = 0; /* 2^(1/hl) * 0x10000 */
 
-/* We maintain a list of "slots", ordered by prefix.  Every slot
+/* We maintain a table of "slots", indexed by prefix.  Every slot
    contains a linked list of the routes to this prefix, with the
-   installed route, if any, at the head of the list. */
+   installed route, if any, at the head of the list.  A slot holds a
+   lock on its node, which is released when the slot becomes empty.
+   Every route is also linked on the list of routes through its
+   neighbour, so that dealing with a neighbour only touches its own
+   routes. */
 
-static int
-route_compare(const unsigned char *prefix, unsigned char plen,
-               struct babel_route *route)
+static void
+route_slot_prefix(struct prefix *p, const unsigned char *prefix,
+                  unsigned char plen)
 {
-    int i = memcmp(prefix, route->src->prefix, 16);
-    if(i != 0)
-        return i;
-
-    if(plen < route->src->plen)
-        return -1;
-    else if(plen > route->src->plen)
-        return 1;
-    else
-        return 0;
+    memset(p, 0, sizeof(*p));
+    p->family = AF_INET6;
+    p->prefixlen = plen;
+    memcpy(&p->u.prefix6, prefix, 16);
 }
 
-/* Performs binary search, returns -1 in case of failure.  In the latter
-   case, new_return is the place where to insert the new element. */
+/* Returns NULL if there are no routes to this prefix. */
 
-static int
-find_route_slot(const unsigned char *prefix, unsigned char plen,
-                int *new_return)
+static struct route_node *
+find_route_slot(const unsigned char *prefix, unsigned char plen)
 {
-    int p, m, g, c;
-
-    if(route_slots < 1) {
-        if(new_return)
-            *new_return = 0;
-        return -1;
-    }
+    struct prefix p;
+    struct route_node *rn;
 
-    p = 0; g = route_slots - 1;
-
-    do {
-        m = (p + g) / 2;
-        c = route_compare(prefix, plen, routes[m]);
-        if(c == 0)
-            return m;
-        else if(c < 0)
-            g = m - 1;
-        else
-            p = m + 1;
-    } while(p <= g);
+    if(routes == NULL)
+        return NULL;
 
-    if(new_return)
-        *new_return = p;
+    route_slot_prefix(&p, prefix, plen);
+    rn = route_node_lookup(routes, &p);
+    if(rn == NULL)
+        return NULL;
 
-    return -1;
+    /* The slot's own lock keeps the node. */
+    route_unlock_node(rn);
+    return rn;
 }
 
 struct babel_route *
@@ -106,12 +93,12 @@ find_route(const unsigned char *prefix, unsigned char plen,
            struct neighbour *neigh, const unsigned char *nexthop)
 {
     struct babel_route *route;
-    int i = find_route_slot(prefix, plen, NULL);
+    struct route_node *rn = find_route_slot(prefix, plen);
 
-    if(i < 0)
+    if(rn == NULL)
         return NULL;
 
-    route = routes[i];
+    route = rn->info;
 
     while(route) {
         if(route->neigh == neigh && memcmp(route->nexthop, nexthop, 16) == 0)
@@ -125,10 +112,15 @@ find_route(const unsigned char *prefix, unsigned char plen,
 struct babel_route *
 find_installed_route(const unsigned char *prefix, unsigned char plen)
 {
-    int i = find_route_slot(prefix, plen, NULL);
+    struct route_node *rn = find_route_slot(prefix, plen);
+    struct babel_route *route;
+
+    if(rn == NULL)
+        return NULL;
 
-    if(i >= 0 && routes[i]->installed)
-        return routes[i];
+    route = rn->info;
+    if(route->installed)
+        return route;
 
     return NULL;
 }
@@ -140,64 +132,53 @@ installed_routes_estimate(void)
     return route_slots;
 }
 
-static int
-resize_route_table(int new_slots)
-{
-    struct babel_route **new_routes;
-    assert(new_slots >= route_slots);
-
-    if(new_slots == 0) {
-        new_routes = NULL;
-        free(routes);
-    } else {
-        new_routes = realloc(routes, new_slots * sizeof(struct babel_route*));
-        if(new_routes == NULL)
-            return -1;
-    }
-
-    max_route_slots = new_slots;
-    routes = new_routes;
-    return 1;
-}
-
 /* Insert a route into the table.  If successful, retains the route.
    On failure, caller must free the route. */
 static struct babel_route *
 insert_route(struct babel_route *route)
 {
-    int i, n;
+    struct prefix p;
+    struct route_node *rn;
+    struct neighbour *neigh = route->neigh;
 
     assert(!route->installed);
 
-    i = find_route_slot(route->src->prefix, route->src->plen, &n);
-
-    if(i < 0) {
-        if(route_slots >= max_route_slots)
-            resize_route_table(max_route_slots < 1 ? 8 : 2 * max_route_slots);
-        if(route_slots >= max_route_slots)
+    if(routes == NULL) {
+        routes = route_table_init();
+        if(routes == NULL)
             return NULL;
-        route->next = NULL;
-        if(n < route_slots)
-            memmove(routes + n + 1, routes + n,
-                    (route_slots - n) * sizeof(struct babel_route*));
+    }
+
+    route_slot_prefix(&p, route->src->prefix, route->src->plen);
+    rn = route_node_get(routes, &p);
+
+    route->next = NULL;
+    if(rn->info == NULL) {
+        /* A new slot, which keeps the lock route_node_get took. */
+        rn->info = route;
         route_slots++;
-        routes[n] = route;
     } else {
-        struct babel_route *r;
-        r = routes[i];
+        struct babel_route *r = rn->info;
+        route_unlock_node(rn);
         while(r->next)
             r = r->next;
         r->next = route;
-        route->next = NULL;
     }
 
+    route->neigh_prev = NULL;
+    route->neigh_next = neigh->routes;
+    if(neigh->routes)
+        neigh->routes->neigh_prev = route;
+    neigh->routes = route;
+
     return route;
 }
 
 void
 flush_route(struct babel_route *route)
 {
-    int i;
+    struct route_node *rn;
+    struct neighbour *neigh = route->neigh;
     struct source *src;
     unsigned oldmetric;
     int lost = 0;
@@ -210,34 +191,30 @@ flush_route(struct babel_route *route)
         lost = 1;
     }
 
-    i = find_route_slot(route->src->prefix, route->src->plen, NULL);
-    assert(i >= 0 && i < route_slots);
+    rn = find_route_slot(route->src->prefix, route->src->plen);
+    assert(rn != NULL);
 
-    if(route == routes[i]) {
-        routes[i] = route->next;
-        route->next = NULL;
-        free(route);
-
-        if(routes[i] == NULL) {
-            if(i < route_slots - 1)
-                memmove(routes + i, routes + i + 1,
-                        (route_slots - i - 1) * sizeof(struct babel_route*));
-            routes[route_slots - 1] = NULL;
+    if(route == rn->info) {
+        rn->info = route->next;
+        if(rn->info == NULL) {
             route_slots--;
+            route_unlock_node(rn);
         }
-
-        if(route_slots == 0)
-            resize_route_table(0);
-        else if(max_route_slots > 8 && route_slots < max_route_slots / 4)
-            resize_route_table(max_route_slots / 2);
     } else {
-        struct babel_route *r = routes[i];
+        struct babel_route *r = rn->info;
         while(r->next != route)
             r = r->next;
         r->next = route->next;
-        route->next = NULL;
-        free(route);
     }
+    route->next = NULL;
+
+    if(route->neigh_prev)
+        route->neigh_prev->neigh_next = route->neigh_next;
+    else
+        neigh->routes = route->neigh_next;
+    if(route->neigh_next)
+        route->neigh_next->neigh_prev = route->neigh_prev;
+    free(route);
 
     if(lost)
         route_lost(src, oldmetric);
@@ -248,71 +225,56 @@ flush_route(struct babel_route *route)
 void
 flush_all_routes()
 {
-    int i;
-
-    /* Start from the end, to avoid shifting the table. */
-    i = route_slots - 1;
-    while(i >= 0) {
-        while(i < route_slots) {
-        /* Uninstall first, to avoid calling route_lost. */
-            if(routes[i]->installed)
-                uninstall_route(routes[i]);
-            flush_route(routes[i]);
+    struct route_node *rn;
+
+    if(routes == NULL)
+        return;
+
+    for(rn = route_top(routes); rn; rn = route_next(rn)) {
+        while(rn->info) {
+            struct babel_route *r = rn->info;
+            /* Uninstall first, to avoid calling route_lost. */
+            if(r->installed)
+                uninstall_route(r);
+            flush_route(r);
         }
-        i--;
     }
 
+    route_table_finish(routes);
+    routes = NULL;
+
     check_sources_released();
 }
 
 void
 flush_neighbour_routes(struct neighbour *neigh)
 {
-    int i;
-
-    i = 0;
-    while(i < route_slots) {
-        struct babel_route *r;
-        r = routes[i];
-        while(r) {
-            if(r->neigh == neigh) {
-                flush_route(r);
-                goto again;
-            }
-            r = r->next;
-        }
-        i++;
-    again:
-        ;
-    }
+    while(neigh->routes)
+        flush_route(neigh->routes);
 }
 
 void
 flush_interface_routes(struct interface *ifp, int v4only)
 {
-    int i;
+    struct neighbour *neigh;
 
-    i = 0;
-    while(i < route_slots) {
-        struct babel_route *r;
-        r = routes[i];
-        while(r) {
-            if(r->neigh->ifp == ifp &&
-               (!v4only || v4mapped(r->nexthop))) {
+    FOR_ALL_NEIGHBOURS(neigh) {
+        struct babel_route *r, *next;
+
+        if(neigh->ifp != ifp)
+            continue;
+
+        for(r = neigh->routes; r; r = next) {
+            next = r->neigh_next;
+            if(!v4only || v4mapped(r->nexthop))
                 flush_route(r);
-                goto again;
-            }
-            r = r->next;
         }
-        i++;
-    again:
-        ;
     }
 }
 
 struct route_stream {
     int installed;
-    int index;
+    struct route_node *rn;
     struct babel_route *next;
 };
 
@@ -327,7 +289,8 @@ route_stream(int installed)
        return NULL;
 
     stream->installed = installed;
-    stream->index = installed ? 0 : -1;
+    /* The stream holds a lock on the next node to visit. */
+    stream->rn = routes ? route_top(routes) : NULL;
     stream->next = NULL;
 
     return stream;
@@ -337,20 +300,20 @@ struct babel_route *
 route_stream_next(struct route_stream *stream)
 {
     if(stream->installed) {
-        while(stream->index < route_slots && !routes[stream->index]->installed)
-            stream->index++;
-
-        if(stream->index < route_slots)
-            return routes[stream->index++];
-        else
-            return NULL;
+        while(stream->rn) {
+            struct babel_route *route = stream->rn->info;
+            stream->rn = route_next(stream->rn);
+            if(route && route->installed)
+                return route;
+        }
+        return NULL;
     } else {
         struct babel_route *next;
-        if(!stream->next) {
-            stream->index++;
-            if(stream->index >= route_slots)
+        while(!stream->next) {
+            if(stream->rn == NULL)
                 return NULL;
-            stream->next = routes[stream->index];
+            stream->next = stream->rn->info;
+            stream->rn = route_next(stream->rn);
         }
         next = stream->next;
         stream->next = next->next;
@@ -361,6 +324,8 @@ route_stream_next(struct route_stream *stream)
 void
 route_stream_done(struct route_stream *stream)
 {
+    if(stream->rn)
+        route_unlock_node(stream->rn);
     free(stream);
 }
 
@@ -373,25 +338,27 @@ metric_to_kernel(int metric)
 /* This is used to maintain the invariant that the installed route is at
    the head of the list. */
 static void
-move_installed_route(struct babel_route *route, int i)
+move_installed_route(struct babel_route *route, struct route_node *rn)
 {
-    assert(i >= 0 && i < route_slots);
+    assert(rn != NULL);
     assert(route->installed);
 
-    if(route != routes[i]) {
-        struct babel_route *r = routes[i];
+    if(route != rn->info) {
+        struct babel_route *r = rn->info;
         while(r->next != route)
             r = r->next;
         r->next = route->next;
-        route->next = routes[i];
-        routes[i] = route;
+        route->next = rn->info;
+        rn->info = route;
     }
 }
 
 void
 install_route(struct babel_route *route)
 {
-    int i, rc;
+    struct route_node *rn;
+    struct babel_route *head;
+    int rc;
 
     if(route->installed)
         return;
@@ -400,10 +367,11 @@ install_route(struct babel_route *route)
         zlog_err("WARNING: installing unfeasible route "
                  "(this shouldn't happen).");
 
-    i = find_route_slot(route->src->prefix, route->src->plen, NULL);
-    assert(i >= 0 && i < route_slots);
+    rn = find_route_slot(route->src->prefix, route->src->plen);
+    assert(rn != NULL);
 
-    if(routes[i] != route && routes[i]->installed) {
+    head = rn->info;
+    if(head != route && head->installed) {
         zlog_err("WARNING: attempting to install duplicate route "
                  "(this shouldn't happen).");
         return;
@@ -420,7 +388,8 @@ install_route(struct babel_route *route)
             return;
     }
     route->installed = 1;
-    move_installed_route(route, i);
+    move_installed_route(route, rn);
+    invalidate_full_updates();
 
 }
 
@@ -440,6 +409,7 @@ uninstall_route(struct babel_route *route)
         zlog_err("kernel_route(FLUSH): %s", safe_strerror(errno));
 
     route->installed = 0;
+    invalidate_full_updates();
 }
 
 /* This is equivalent to uninstall_route followed with install_route,
@@ -475,8 +445,8 @@ switch_routes(struct babel_route *old, struct babel_route *new)
 
     old->installed = 0;
     new->installed = 1;
-    move_installed_route(new, find_route_slot(new->src->prefix, new->src->plen,
-                                              NULL));
+    move_installed_route(new, find_route_slot(new->src->prefix, new->src->plen));
+    invalidate_full_updates();
 }
 
 static void
@@ -688,12 +658,12 @@ find_best_route(const unsigned char *prefix, unsigned char plen, int feasible,
                 struct neighbour *exclude)
 {
     struct babel_route *route = NULL, *r = NULL;
-    int i = find_route_slot(prefix, plen, NULL);
+    struct route_node *rn = find_route_slot(prefix, plen);
 
-    if(i < 0)
+    if(rn == NULL)
         return NULL;
 
-    route = routes[i];
+    route = rn->info;
     while(route && !route_acceptable(route, feasible, exclude))
         route = route->next;
 
@@ -745,31 +715,26 @@ update_neighbour_metric(struct neighbour *neigh, int changed)
 {
 
     if(changed) {
-        int i;
-
-        for(i = 0; i < route_slots; i++) {
-            struct babel_route *r = routes[i];
-            while(r) {
-                if(r->neigh == neigh)
-                    update_route_metric(r);
-                r = r->next;
-            }
-        }
+        struct babel_route *r;
+
+        for(r = neigh->routes; r; r = r->neigh_next)
+            update_route_metric(r);
     }
 }
 
 void
 update_interface_metric(struct interface *ifp)
 {
-    int i;
+    struct neighbour *neigh;
 
-    for(i = 0; i < route_slots; i++) {
-        struct babel_route *r = routes[i];
-        while(r) {
-            if(r->neigh->ifp == ifp)
-                update_route_metric(r);
-            r = r->next;
-        }
+    FOR_ALL_NEIGHBOURS(neigh) {
+        struct babel_route *r;
+
+        if(neigh->ifp != ifp)
+            continue;
+
+        for(r = neigh->routes; r; r = r->neigh_next)
+            update_route_metric(r);
     }
 }
 
@@ -982,20 +947,14 @@ consider_route(struct babel_route *route)
 void
 retract_neighbour_routes(struct neighbour *neigh)
 {
-    int i;
+    struct babel_route *r;
 
-    for(i = 0; i < route_slots; i++) {
-        struct babel_route *r = routes[i];
-        while(r) {
-            if(r->neigh == neigh) {
-                if(r->refmetric != INFINITY) {
-                    unsigned short oldmetric = route_metric(r);
-                    retract_route(r);
-                    if(oldmetric != INFINITY)
-                        route_changed(r, r->src, oldmetric);
-                }
-            }
-            r = r->next;
+    for(r = neigh->routes; r; r = r->neigh_next) {
+        if(r->refmetric != INFINITY) {
+            unsigned short oldmetric = route_metric(r);
+            retract_route(r);
+            if(oldmetric != INFINITY)
+                route_changed(r, r->src, oldmetric);
         }
     }
 }
@@ -1109,14 +1068,17 @@ route_lost(struct source *src, unsigned oldmetric)
 void
 expire_routes(void)
 {
+    struct route_node *rn;
     struct babel_route *r;
-    int i;
 
     debugf(BABEL_DEBUG_COMMON,"Expiring old routes.");
 
-    i = 0;
-    while(i < route_slots) {
-        r = routes[i];
+    if(routes == NULL)
+        return;
+
+    for(rn = route_top(routes); rn; rn = route_next(rn)) {
+    again:
+        r = rn->info;
         while(r) {
             /* Protect against clock being stepped. */
             if(r->time > babel_now.tv_sec || route_old(r)) {
@@ -1134,8 +1096,5 @@ expire_routes(void)
             }
             r = r->next;
         }
-        i++;
-    again:
-        ;
     }
 }
@@ -49,11 +49,12 @@ struct babel_route {
     short installed;
     unsigned char channels[DIVERSITY_HOPS];
     struct babel_route *next;
+    /* The routes through the same neighbour. */
+    struct babel_route *neigh_next, *neigh_prev;
 };
 
 struct route_stream;
 
-extern struct babel_route **routes;
 extern int kernel_metric;
 extern int diversity_kind, diversity_factor;
 extern int keep_unfeasible;
@@ -117,6 +117,7 @@ flush_xroute(struct xroute *xroute)
     if(i != numxroutes - 1)
         memcpy(xroutes + i, xroutes + numxroutes - 1, sizeof(struct xroute));
     numxroutes--;
+    invalidate_full_updates();
     VALGRIND_MAKE_MEM_UNDEFINED(xroutes + numxroutes, sizeof(struct xroute));
 
     if(numxroutes == 0) {
@@ -164,6 +165,7 @@ add_xroute(unsigned char prefix[16], unsigned char plen,
     xroutes[numxroutes].ifindex = ifindex;
     xroutes[numxroutes].proto = proto;
     numxroutes++;
+    invalidate_full_updates();
     return 1;
 }
 
@@ -27,6 +27,8 @@
 #include "thread.h"
 #include "queue.h"
 #include "filter.h"
+#include "slab.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -145,43 +147,118 @@ void bgp_advertise_unintern(struct hash *hash, struct bgp_advertise_attr *baa)
 	}
 }
 
+/*
+ * A subgroup's adj_out are hashed by node, and by addpath id if the
+ * subgroup uses addpath; otherwise there is one per node at most.
+ */
+static int bgp_adj_out_addpath(const struct bgp_adj_out *adj)
+{
+	struct update_subgroup *subgrp = adj->subgroup;
+
+	return bgp_addpath_encode_tx(SUBGRP_PEER(subgrp), SUBGRP_AFI(subgrp),
+				     SUBGRP_SAFI(subgrp));
+}
+
+unsigned int bgp_adj_out_hash_key(void *p)
+{
+	struct bgp_adj_out *adj = p;
+
+	return jhash_2words((uint32_t)(uintptr_t)adj->rn,
+			    bgp_adj_out_addpath(adj) ? adj->addpath_tx_id : 0,
+			    0);
+}
+
+int bgp_adj_out_hash_cmp(const void *p1, const void *p2)
+{
+	const struct bgp_adj_out *adj1 = p1;
+	const struct bgp_adj_out *adj2 = p2;
+
+	if (adj1->rn != adj2->rn)
+		return 0;
+
+	return !bgp_adj_out_addpath(adj1)
+	       || adj1->addpath_tx_id == adj2->addpath_tx_id;
+}
+
+static struct bgp_adj_out *bgp_adj_out_find(struct peer *peer,
+					    struct bgp_node *rn, safi_t safi,
+					    uint32_t addpath_tx_id)
+{
+	struct update_subgroup *subgrp;
+	struct bgp_adj_out *adj, ref;
+	struct peer_af *paf;
+	afi_t afi = bgp_node_table(rn)->afi;
+
+	paf = peer_af_find(peer, afi, safi);
+	if (!paf || !(subgrp = PAF_SUBGRP(paf)))
+		return NULL;
+
+	/* Match on a specific addpath_tx_id if we are using addpath for this
+	 * peer and if an addpath_tx_id was specified */
+	if (bgp_addpath_encode_tx(peer, afi, safi) && !addpath_tx_id) {
+		for (adj = rn->adj_out; adj; adj = adj->next)
+			if (adj->subgroup == subgrp)
+				return adj;
+		return NULL;
+	}
+
+	ref.rn = rn;
+	ref.subgroup = subgrp;
+	ref.addpath_tx_id = addpath_tx_id;
+	return hash_lookup(subgrp->adj_hash, &ref);
+}
+
 int bgp_adj_out_lookup(struct peer *peer, struct bgp_node *rn,
 		       uint32_t addpath_tx_id)
 {
 	struct bgp_adj_out *adj;
-	struct peer_af *paf;
-	afi_t afi;
-	safi_t safi;
-	int addpath_capable;
-
-	for (adj = rn->adj_out; adj; adj = adj->next)
-		SUBGRP_FOREACH_PEER (adj->subgroup, paf)
-			if (paf->peer == peer) {
-				afi = SUBGRP_AFI(adj->subgroup);
-				safi = SUBGRP_SAFI(adj->subgroup);
-				addpath_capable =
-					bgp_addpath_encode_tx(peer, afi, safi);
-
-				/* Match on a specific addpath_tx_id if we are
-				 * using addpath for
-				 * this
-				 * peer and if an addpath_tx_id was specified */
-				if (addpath_capable && addpath_tx_id
-				    && adj->addpath_tx_id != addpath_tx_id)
-					continue;
-
-				return (adj->adv ? (adj->adv->baa ? 1 : 0)
-						 : (adj->attr ? 1 : 0));
-			}
+	safi_t safi = bgp_node_table(rn)->safi;
 
-	return 0;
+	adj = bgp_adj_out_find(peer, rn, safi, addpath_tx_id);
+	/* labeled-unicast is announced from the unicast table */
+	if (!adj && safi == SAFI_UNICAST)
+		adj = bgp_adj_out_find(peer, rn, SAFI_LABELED_UNICAST,
+				       addpath_tx_id);
+	if (!adj)
+		return 0;
+
+	return (adj->adv ? (adj->adv->baa ? 1 : 0) : (adj->attr ? 1 : 0));
 }
 
 
+/*
+ * One per path received, see bgp_info_slab in bgp_route.c.  A path that
+ * inbound policy left unchanged doesn't have one: it is flagged
+ * BGP_INFO_ADJ_IN instead, as its attr is the one received.  That's most of
+ * the paths of a full feed without rewriting policy.
+ */
+static struct slab *bgp_adj_in_slab;
+
+static struct bgp_info *bgp_adj_in_path(struct bgp_node *rn,
+					struct peer *peer, uint32_t addpath_id)
+{
+	struct bgp_info *ri;
+
+	for (ri = rn->info; ri; ri = ri->next)
+		if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+		    && ri->sub_type == BGP_ROUTE_NORMAL
+		    && ri->addpath_rx_id == addpath_id)
+			return ri;
+
+	return NULL;
+}
+
 void bgp_adj_in_set(struct bgp_node *rn, struct peer *peer, struct attr *attr,
 		    uint32_t addpath_id)
 {
-	struct bgp_adj_in *adj;
+	struct bgp_table *table = bgp_node_table(rn);
+	struct bgp_adj_in *adj, **head;
+	struct bgp_info *ri;
+
+	/* the path is about to be replaced, see bgp_adj_in_compact() */
+	ri = bgp_adj_in_path(rn, peer, addpath_id);
+	if (ri)
+		UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
 
 	for (adj = rn->adj_in; adj; adj = adj->next) {
 		if (adj->peer == peer && adj->addpath_rx_id == addpath_id) {
@@ -192,20 +269,123 @@ void bgp_adj_in_set(struct bgp_node *rn, struct peer *peer, struct attr *attr,
 			return;
 		}
 	}
-	adj = XCALLOC(MTYPE_BGP_ADJ_IN, sizeof(struct bgp_adj_in));
+	if (!bgp_adj_in_slab)
+		bgp_adj_in_slab =
+			slab_new(MTYPE_BGP_ADJ_IN, sizeof(struct bgp_adj_in));
+	adj = slab_alloc(bgp_adj_in_slab);
+	adj->rn = rn;
 	adj->peer = peer_lock(peer); /* adj_in peer reference */
 	adj->attr = bgp_attr_intern(attr);
 	adj->addpath_rx_id = addpath_id;
 	BGP_ADJ_IN_ADD(rn, adj);
 	bgp_lock_node(rn);
+
+	head = &peer->adj_in[table->afi][table->safi];
+	adj->peer_prev = NULL;
+	adj->peer_next = *head;
+	if (*head)
+		(*head)->peer_prev = adj;
+	*head = adj;
 }
 
 void bgp_adj_in_remove(struct bgp_node *rn, struct bgp_adj_in *bai)
 {
+	struct bgp_table *table = bgp_node_table(rn);
+
+	if (bai->peer_next)
+		bai->peer_next->peer_prev = bai->peer_prev;
+	if (bai->peer_prev)
+		bai->peer_prev->peer_next = bai->peer_next;
+	else
+		bai->peer->adj_in[table->afi][table->safi] = bai->peer_next;
+
 	bgp_attr_unintern(&bai->attr);
 	BGP_ADJ_IN_DEL(rn, bai);
 	peer_unlock(bai->peer); /* adj_in peer reference */
-	XFREE(MTYPE_BGP_ADJ_IN, bai);
+	slab_free(bgp_adj_in_slab, bai);
+}
+
+/* Drops the bgp_adj_in of a path that came out of inbound policy as it was. */
+void bgp_adj_in_compact(struct bgp_node *rn, struct peer *peer,
+			uint32_t addpath_id)
+{
+	struct bgp_adj_in *adj;
+	struct bgp_info *ri;
+
+	for (adj = rn->adj_in; adj; adj = adj->next)
+		if (adj->peer == peer && adj->addpath_rx_id == addpath_id)
+			break;
+	if (!adj)
+		return;
+
+	ri = bgp_adj_in_path(rn, peer, addpath_id);
+	if (!ri || ri->attr != adj->attr
+	    || CHECK_FLAG(ri->flags, BGP_INFO_REMOVED | BGP_INFO_HISTORY))
+		return;
+
+	SET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+	bgp_adj_in_remove(rn, adj);
+	bgp_unlock_node(rn);
+}
+
+/*
+ * Gives the flagged paths of peer, or of all peers if NULL, their
+ * bgp_adj_in back, for inbound policy to be applied to them again.
+ */
+void bgp_adj_in_expand(struct bgp_node *rn, struct peer *peer)
+{
+	struct bgp_info *ri;
+
+	for (ri = rn->info; ri; ri = ri->next) {
+		if (!CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)
+		    || (peer && ri->peer != peer))
+			continue;
+
+		UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+		bgp_adj_in_set(rn, ri->peer, ri->attr, ri->addpath_rx_id);
+	}
+}
+
+void bgp_adj_in_iter_init(struct bgp_adj_in_iter *iter, struct bgp_node *rn)
+{
+	iter->ain = rn->adj_in;
+	iter->ri = rn->info;
+}
+
+/* Returns the next attr peer sent for the node, NULL at the end. */
+struct attr *bgp_adj_in_next(struct bgp_adj_in_iter *iter,
+			     const struct peer *peer)
+{
+	struct bgp_adj_in *ain;
+	struct bgp_info *ri;
+
+	while ((ain = iter->ain)) {
+		iter->ain = ain->next;
+		if (ain->peer == peer)
+			return ain->attr;
+	}
+
+	while ((ri = iter->ri)) {
+		iter->ri = ri->next;
+		if (ri->peer == peer && CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN))
+			return ri->attr;
+	}
+
+	return NULL;
+}
+
+void bgp_adj_in_reclaim(void)
+{
+	if (bgp_adj_in_slab)
+		slab_reclaim(bgp_adj_in_slab);
+}
+
+void bgp_adj_in_finish(void)
+{
+	if (bgp_adj_in_slab && !slab_count(bgp_adj_in_slab)) {
+		slab_del(bgp_adj_in_slab);
+		bgp_adj_in_slab = NULL;
+	}
 }
 
 int bgp_adj_in_unset(struct bgp_node *rn, struct peer *peer,
@@ -213,6 +393,13 @@ int bgp_adj_in_unset(struct bgp_node *rn, struct peer *peer,
 {
 	struct bgp_adj_in *adj;
 	struct bgp_adj_in *adj_next;
+	struct bgp_info *ri;
+
+	ri = bgp_adj_in_path(rn, peer, addpath_id);
+	if (ri && CHECK_FLAG(ri->flags, BGP_INFO_ADJ_IN)) {
+		UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
+		return 1;
+	}
 
 	adj = rn->adj_in;
 
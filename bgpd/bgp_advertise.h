@@ -82,6 +82,15 @@ struct bgp_adj_out {
 
 	uint32_t addpath_tx_id;
 
+	/* Path flags the announcement was made with, see
+	 * group_announce_route_walkcb() */
+	uint16_t binfo_flags;
+#define BGP_ADJ_OUT_BINFO_FLAGS                                                \
+	(BGP_INFO_DAMPED | BGP_INFO_HISTORY | BGP_INFO_SELECTED                \
+	 | BGP_INFO_VALID | BGP_INFO_DMED_SELECTED | BGP_INFO_STALE            \
+	 | BGP_INFO_REMOVED | BGP_INFO_MULTIPATH | BGP_INFO_ANNC_NH_SELF)
+#define BGP_ADJ_OUT_BINFO_NONE 0xffff
+
 	/* Advertised attribute.  */
 	struct attr *attr;
 
@@ -95,6 +104,13 @@ struct bgp_adj_in {
 	struct bgp_adj_in *next;
 	struct bgp_adj_in *prev;
 
+	/* For the peer's list of adj-ins, see bgp_adj_in_set() */
+	struct bgp_adj_in *peer_next;
+	struct bgp_adj_in *peer_prev;
+
+	/* Node the adj-in hangs off.  */
+	struct bgp_node *rn;
+
 	/* Received peer.  */
 	struct peer *peer;
 
@@ -105,6 +121,12 @@ struct bgp_adj_in {
 	uint32_t addpath_rx_id;
 };
 
+/* See bgp_adj_in_next(). */
+struct bgp_adj_in_iter {
+	struct bgp_adj_in *ain;
+	struct bgp_info *ri;
+};
+
 /* BGP advertisement list.  */
 struct bgp_synchronize {
 	struct bgp_advertise_fifo update;
@@ -173,11 +195,22 @@ extern void bgp_adj_in_set(struct bgp_node *, struct peer *, struct attr *,
 			   uint32_t);
 extern int bgp_adj_in_unset(struct bgp_node *, struct peer *, uint32_t);
 extern void bgp_adj_in_remove(struct bgp_node *, struct bgp_adj_in *);
+extern void bgp_adj_in_compact(struct bgp_node *rn, struct peer *peer,
+			       uint32_t addpath_id);
+extern void bgp_adj_in_expand(struct bgp_node *rn, struct peer *peer);
+extern void bgp_adj_in_iter_init(struct bgp_adj_in_iter *iter,
+				 struct bgp_node *rn);
+extern struct attr *bgp_adj_in_next(struct bgp_adj_in_iter *iter,
+				    const struct peer *peer);
+extern void bgp_adj_in_reclaim(void);
+extern void bgp_adj_in_finish(void);
 
 extern void bgp_sync_init(struct peer *);
 extern void bgp_sync_delete(struct peer *);
 extern unsigned int baa_hash_key(void *p);
 extern int baa_hash_cmp(const void *p1, const void *p2);
+extern unsigned int bgp_adj_out_hash_key(void *p);
+extern int bgp_adj_out_hash_cmp(const void *p1, const void *p2);
 extern void bgp_advertise_add(struct bgp_advertise_attr *baa,
 			      struct bgp_advertise *adv);
 extern struct bgp_advertise *bgp_advertise_new(void);
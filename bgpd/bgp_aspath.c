@@ -27,7 +27,7 @@
 #include "log.h"
 #include "stream.h"
 #include "command.h"
-#include "jhash.h"
+#include "hashfn.h"
 #include "queue.h"
 #include "filter.h"
 
@@ -478,6 +478,23 @@ unsigned int aspath_has_as4(struct aspath *aspath)
 	return 0;
 }
 
+/* Publish a string built for as, unless another pthread beat us to it. */
+static void aspath_str_set(struct aspath *as, char *str_buf, int len)
+{
+	char *expect = NULL;
+
+	do {
+		if (expect) {
+			XFREE(MTYPE_AS_STR, str_buf);
+			return;
+		}
+	} while (!atomic_compare_exchange_weak_explicit(
+		&as->str, &expect, str_buf, memory_order_release,
+		memory_order_acquire));
+
+	as->str_len = len;
+}
+
 /* Convert aspath structure to string expression. */
 static void aspath_make_str_count(struct aspath *as, bool make_json)
 {
@@ -502,9 +519,9 @@ static void aspath_make_str_count(struct aspath *as, bool make_json)
 					       jaspath_segments);
 			json_object_int_add(as->json, "length", 0);
 		}
-		as->str = XMALLOC(MTYPE_AS_STR, 1);
-		as->str[0] = '\0';
-		as->str_len = 0;
+		str_buf = XMALLOC(MTYPE_AS_STR, 1);
+		str_buf[0] = '\0';
+		aspath_str_set(as, str_buf, 0);
 		return;
 	}
 
@@ -540,8 +557,6 @@ static void aspath_make_str_count(struct aspath *as, bool make_json)
 			break;
 		default:
 			XFREE(MTYPE_AS_STR, str_buf);
-			as->str = NULL;
-			as->str_len = 0;
 			json_object_free(as->json);
 			as->json = NULL;
 
@@ -610,11 +625,10 @@ static void aspath_make_str_count(struct aspath *as, bool make_json)
 	assert(len < str_size);
 
 	str_buf[len] = '\0';
-	as->str = str_buf;
-	as->str_len = len;
+	aspath_str_set(as, str_buf, len);
 
 	if (make_json) {
-		json_object_string_add(as->json, "string", str_buf);
+		json_object_string_add(as->json, "string", as->str);
 		json_object_object_add(as->json, "segments", jaspath_segments);
 		json_object_int_add(as->json, "length", aspath_count_hops(as));
 	}
@@ -622,17 +636,26 @@ static void aspath_make_str_count(struct aspath *as, bool make_json)
 	return;
 }
 
-void aspath_str_update(struct aspath *as, bool make_json)
+static void aspath_str_free(struct aspath *as)
 {
 	if (as->str)
 		XFREE(MTYPE_AS_STR, as->str);
+	as->str_len = 0;
 
 	if (as->json) {
 		json_object_free(as->json);
 		as->json = NULL;
 	}
+}
 
-	aspath_make_str_count(as, make_json);
+/* Drop the string and json forms of as after its segments changed.  The
+   string is rebuilt when next needed, the json form right away if asked. */
+void aspath_str_update(struct aspath *as, bool make_json)
+{
+	aspath_str_free(as);
+
+	if (make_json)
+		aspath_make_str_count(as, true);
 }
 
 /* Intern allocated AS path. */
@@ -640,10 +663,8 @@ struct aspath *aspath_intern(struct aspath *aspath)
 {
 	struct aspath *find;
 
-	/* Assert this AS path structure is not interned and has the string
-	   representation built. */
+	/* Assert this AS path structure is not interned. */
 	assert(aspath->refcnt == 0);
-	assert(aspath->str);
 
 	/* Check AS path hash. */
 	find = hash_get(ashash, aspath, hash_alloc_intern);
@@ -659,7 +680,6 @@ struct aspath *aspath_intern(struct aspath *aspath)
    reference count and AS path string is cleared. */
 struct aspath *aspath_dup(struct aspath *aspath)
 {
-	unsigned short buflen = aspath->str_len + 1;
 	struct aspath *new;
 
 	new = XCALLOC(MTYPE_AS_PATH, sizeof(struct aspath));
@@ -668,18 +688,6 @@ struct aspath *aspath_dup(struct aspath *aspath)
 	if (aspath->segments)
 		new->segments = assegment_dup_all(aspath->segments);
 
-	if (!aspath->str)
-		return new;
-
-	new->str = XMALLOC(MTYPE_AS_STR, buflen);
-	new->str_len = aspath->str_len;
-
-	/* copy the string data */
-	if (aspath->str_len > 0)
-		memcpy(new->str, aspath->str, buflen);
-	else
-		new->str[0] = '\0';
-
 	return new;
 }
 
@@ -688,9 +696,6 @@ static void *aspath_hash_alloc(void *arg)
 	const struct aspath *aspath = arg;
 	struct aspath *new;
 
-	/* Malformed AS path value. */
-	assert(aspath->str);
-
 	/* New aspath structure is needed. */
 	new = XMALLOC(MTYPE_AS_PATH, sizeof(struct aspath));
 
@@ -700,6 +705,7 @@ static void *aspath_hash_alloc(void *arg)
 	new->str = aspath->str;
 	new->str_len = aspath->str_len;
 	new->json = aspath->json;
+	memset(new->filter_cache, 0, sizeof(new->filter_cache));
 
 	return new;
 }
@@ -1662,7 +1668,7 @@ struct aspath *aspath_reconcile_as4(struct aspath *aspath,
 	if (BGP_DEBUG(as4, AS4))
 		zlog_debug(
 			"[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now",
-			aspath->str, as4path->str);
+			aspath_print(aspath), aspath_print(as4path));
 
 	while (seg && hops > 0) {
 		switch (seg->type) {
@@ -1721,7 +1727,7 @@ struct aspath *aspath_reconcile_as4(struct aspath *aspath,
 
 	if (BGP_DEBUG(as4, AS4))
 		zlog_debug("[AS4] result of synthesizing is %s",
-			   mergedpath->str);
+			   aspath_print(mergedpath));
 
 	return mergedpath;
 }
@@ -1837,11 +1843,7 @@ struct aspath *aspath_empty(void)
 
 struct aspath *aspath_empty_get(void)
 {
-	struct aspath *aspath;
-
-	aspath = aspath_new();
-	aspath_make_str_count(aspath, false);
-	return aspath;
+	return aspath_new();
 }
 
 unsigned long aspath_count(void)
@@ -1991,8 +1993,6 @@ struct aspath *aspath_str2aspath(const char *str)
 		}
 	}
 
-	aspath_make_str_count(aspath, false);
-
 	return aspath;
 }
 
@@ -2000,14 +2000,16 @@ struct aspath *aspath_str2aspath(const char *str)
 unsigned int aspath_key_make(void *p)
 {
 	struct aspath *aspath = (struct aspath *)p;
-	unsigned int key = 0;
-
-	if (!aspath->str)
-		aspath_str_update(aspath, false);
+	struct assegment *seg;
+	uint64_t h = 2334325;
 
-	key = jhash(aspath->str, aspath->str_len, 2334325);
+	/* Hashed like aspath_cmp() compares, no need for the string */
+	for (seg = aspath->segments; seg; seg = seg->next) {
+		h = hashfn_mix(h, seg->type, seg->length);
+		h = hashfn64(seg->as, seg->length * sizeof(as_t), h);
+	}
 
-	return key;
+	return hashfn_fold(h);
 }
 
 /* If two aspath have same value then return 1 else return 0 */
@@ -2038,6 +2040,7 @@ void aspath_init(void)
 {
 	ashash = hash_create_size(32768, aspath_key_make, aspath_cmp,
 				  "BGP AS Path");
+	ashash->incremental = true;
 }
 
 void aspath_finish(void)
@@ -2053,7 +2056,17 @@ void aspath_finish(void)
 /* return and as path value */
 const char *aspath_print(struct aspath *as)
 {
-	return (as ? as->str : NULL);
+	char *str;
+
+	if (!as)
+		return NULL;
+
+	str = atomic_load_explicit(&as->str, memory_order_acquire);
+	if (!str) {
+		aspath_make_str_count(as, false);
+		str = atomic_load_explicit(&as->str, memory_order_acquire);
+	}
+	return str;
 }
 
 /* Printing functions */
@@ -2064,7 +2077,7 @@ void aspath_print_vty(struct vty *vty, const char *format, struct aspath *as,
 		      const char *suffix)
 {
 	assert(format);
-	vty_out(vty, format, as->str);
+	vty_out(vty, format, aspath_print(as));
 	if (as->str_len && strlen(suffix))
 		vty_out(vty, "%s", suffix);
 }
@@ -2077,7 +2090,30 @@ static void aspath_show_all_iterator(struct hash_backet *backet,
 	as = (struct aspath *)backet->data;
 
 	vty_out(vty, "[%p:%u] (%ld) ", (void *)backet, backet->key, as->refcnt);
-	vty_out(vty, "%s\n", as->str);
+	vty_out(vty, "%s\n", aspath_print(as));
+}
+
+static void aspath_str_flush_iterator(struct hash_backet *backet,
+				      unsigned long *count)
+{
+	struct aspath *as = backet->data;
+
+	if (as->str) {
+		aspath_str_free(as);
+		(*count)++;
+	}
+}
+
+/* Release the strings of all interned paths, they are rebuilt as needed.
+   Used from `clear [ip] bgp paths' to give back memory. */
+unsigned long aspath_str_flush(void)
+{
+	unsigned long count = 0;
+
+	hash_iterate(ashash, (void (*)(struct hash_backet *,
+				       void *))aspath_str_flush_iterator,
+		     &count);
+	return count;
 }
 
 /* Print all aspath and hash information.  This function is used from
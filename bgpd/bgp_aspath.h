@@ -22,6 +22,7 @@
 #define _QUAGGA_BGP_ASPATH_H
 
 #include "lib/json.h"
+#include "lib/frratomic.h"
 
 /* AS path segment type.  */
 #define AS_SET                       1
@@ -55,6 +56,8 @@ struct assegment {
 	uint8_t type;
 };
 
+#define ASPATH_FILTER_CACHE 2
+
 /* AS path may be include some AsSegments.  */
 struct aspath {
 	/* Reference count to this aspath.  */
@@ -63,13 +66,23 @@ struct aspath {
 	/* segment data */
 	struct assegment *segments;
 
-	/* AS path as a json object */
+	/* AS path as a json object, built by aspath_str_update() */
 	json_object *json;
 
 	/* String expression of AS path.  This string is used by vty output
-	   and AS path regular expression match.  */
-	char *str;
+	   and AS path regular expression match.  It is only built when first
+	   asked for through aspath_print(), which pthreads encoding UPDATEs
+	   may do concurrently, hence _Atomic.  */
+	char *_Atomic str;
 	unsigned short str_len;
+
+	/* Most recent as_list_apply() results, most recent first.  Only used
+	   while interned, when the path can't change any more. */
+	struct {
+		const struct as_list *aslist;
+		uint32_t gen;
+		uint8_t type;
+	} filter_cache[ASPATH_FILTER_CACHE];
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -100,6 +113,7 @@ extern const char *aspath_print(struct aspath *);
 extern void aspath_print_vty(struct vty *, const char *, struct aspath *,
 			     const char *);
 extern void aspath_print_all_vty(struct vty *);
+extern unsigned long aspath_str_flush(void);
 extern unsigned int aspath_key_make(void *);
 extern unsigned int aspath_get_first_as(struct aspath *);
 extern unsigned int aspath_get_last_as(struct aspath *);
@@ -27,7 +27,7 @@
 #include "stream.h"
 #include "log.h"
 #include "hash.h"
-#include "jhash.h"
+#include "hashfn.h"
 #include "queue.h"
 #include "table.h"
 #include "filter.h"
@@ -142,7 +142,7 @@ static unsigned int cluster_hash_key_make(void *p)
 {
 	const struct cluster_list *cluster = p;
 
-	return jhash(cluster->list, cluster->length, 0);
+	return hashfn(cluster->list, cluster->length, 0);
 }
 
 static int cluster_hash_cmp(const void *p1, const void *p2)
@@ -351,7 +351,7 @@ static unsigned int encap_hash_key_make(void *p)
 {
 	const struct bgp_attr_encap_subtlv *encap = p;
 
-	return jhash(encap->value, encap->length, 0);
+	return hashfn(encap->value, encap->length, 0);
 }
 
 static int encap_hash_cmp(const void *p1, const void *p2)
@@ -437,7 +437,7 @@ static unsigned int transit_hash_key_make(void *p)
 {
 	const struct transit *transit = p;
 
-	return jhash(transit->val, transit->length, 0);
+	return hashfn(transit->val, transit->length, 0);
 }
 
 static int transit_hash_cmp(const void *p1, const void *p2)
@@ -486,42 +486,44 @@ unsigned long int attr_unknown_count(void)
 
 unsigned int attrhash_key_make(void *p)
 {
-	const struct attr *attr = (struct attr *)p;
-	uint32_t key = 0;
-#define MIX(val)	key = jhash_1word(val, key)
-#define MIX3(a, b, c)	key = jhash_3words((a), (b), (c), key)
-
-	MIX3(attr->origin, attr->nexthop.s_addr, attr->med);
-	MIX3(attr->local_pref, attr->aggregator_as,
-	     attr->aggregator_addr.s_addr);
-	MIX3(attr->weight, attr->mp_nexthop_global_in.s_addr,
-	     attr->originator_id.s_addr);
-	MIX3(attr->tag, attr->label, attr->label_index);
-
-	if (attr->aspath)
-		MIX(aspath_key_make(attr->aspath));
-	if (attr->community)
-		MIX(community_hash_make(attr->community));
-
-	if (attr->lcommunity)
-		MIX(lcommunity_hash_make(attr->lcommunity));
-	if (attr->ecommunity)
-		MIX(ecommunity_hash_make(attr->ecommunity));
-	if (attr->cluster)
-		MIX(cluster_hash_key_make(attr->cluster));
-	if (attr->transit)
-		MIX(transit_hash_key_make(attr->transit));
-	if (attr->encap_subtlvs)
-		MIX(encap_hash_key_make(attr->encap_subtlvs));
+	struct attr *attr = (struct attr *)p;
+	uint64_t h = 0;
+
+	/* interned attributes don't change, nor does their key */
+	if (attr->hash_self == attr)
+		return attr->hash_key;
+
+#define MIX(a, b)	h = hashfn_mix(h, (a), (b))
+#define PAIR(a, b)	(((uint64_t)(a) << 32) | (uint32_t)(b))
+#define KEY(ptr, fn)	((ptr) ? fn(ptr) : 0)
+
+	MIX(PAIR(attr->origin, attr->nexthop.s_addr), attr->med);
+	MIX(PAIR(attr->local_pref, attr->aggregator_as),
+	    attr->aggregator_addr.s_addr);
+	MIX(PAIR(attr->weight, attr->mp_nexthop_global_in.s_addr),
+	    PAIR(attr->originator_id.s_addr, attr->mp_nexthop_len));
+	MIX(PAIR(attr->tag, attr->label), attr->label_index);
+
+	MIX(PAIR(KEY(attr->aspath, aspath_key_make),
+		 KEY(attr->community, community_hash_make)),
+	    PAIR(KEY(attr->lcommunity, lcommunity_hash_make),
+		 KEY(attr->ecommunity, ecommunity_hash_make)));
+	MIX(PAIR(KEY(attr->cluster, cluster_hash_key_make),
+		 KEY(attr->transit, transit_hash_key_make)),
+	    KEY(attr->encap_subtlvs, encap_hash_key_make));
 #if ENABLE_BGP_VNC
-	if (attr->vnc_subtlvs)
-		MIX(encap_hash_key_make(attr->vnc_subtlvs));
+	MIX(KEY(attr->vnc_subtlvs, encap_hash_key_make), 0);
 #endif
-	MIX(attr->mp_nexthop_len);
-	key = jhash(attr->mp_nexthop_global.s6_addr, IPV6_MAX_BYTELEN, key);
-	key = jhash(attr->mp_nexthop_local.s6_addr, IPV6_MAX_BYTELEN, key);
+	h = hashfn64(attr->mp_nexthop_global.s6_addr, IPV6_MAX_BYTELEN, h);
+	h = hashfn64(attr->mp_nexthop_local.s6_addr, IPV6_MAX_BYTELEN, h);
+
+#undef MIX
+#undef PAIR
+#undef KEY
 
-	return key;
+	/* picked up by bgp_attr_hash_alloc() when interning */
+	attr->hash_key = hashfn_fold(h);
+	return attr->hash_key;
 }
 
 int attrhash_cmp(const void *p1, const void *p2)
@@ -570,6 +572,7 @@ static void attrhash_init(void)
 {
 	attrhash =
 		hash_create(attrhash_key_make, attrhash_cmp, "BGP Attributes");
+	attrhash->incremental = true;
 }
 
 /*
@@ -604,11 +607,15 @@ void attr_show_all(struct vty *vty)
 
 static void *bgp_attr_hash_alloc(void *p)
 {
+	static uint64_t serial;
 	struct attr *val = (struct attr *)p;
 	struct attr *attr;
 
 	attr = XMALLOC(MTYPE_ATTR, sizeof(struct attr));
 	*attr = *val;
+	attr->serial = ++serial;
+	/* hash_get() just computed the key of val */
+	attr->hash_self = attr;
 	if (val->encap_subtlvs) {
 		val->encap_subtlvs = NULL;
 	}
@@ -1113,7 +1120,7 @@ static bgp_attr_parse_ret_t bgp_attr_origin(struct bgp_attr_parser_args *args)
 	}
 
 	/* Fetch origin attribute. */
-	attr->origin = stream_getc(BGP_INPUT(peer));
+	attr->origin = stream_getc_unchecked(BGP_INPUT(peer));
 
 	/* If the ORIGIN attribute has an undefined value, then the Error
 	   Subcode is set to Invalid Origin Attribute.  The Data field
@@ -1258,7 +1265,7 @@ static bgp_attr_parse_ret_t bgp_attr_nexthop(struct bgp_attr_parser_args *args)
 	   logged locally (this is implemented somewhere else). The UPDATE
 	   message
 	   gets ignored in any of these cases. */
-	nexthop_n = stream_get_ipv4(peer->curr);
+	nexthop_n = stream_get_ipv4_unchecked(peer->curr);
 	nexthop_h = ntohl(nexthop_n);
 	if ((IPV4_NET0(nexthop_h) || IPV4_NET127(nexthop_h)
 	     || IPV4_CLASS_DE(nexthop_h))
@@ -1294,7 +1301,7 @@ static bgp_attr_parse_ret_t bgp_attr_med(struct bgp_attr_parser_args *args)
 					  args->total);
 	}
 
-	attr->med = stream_getl(peer->curr);
+	attr->med = stream_getl_unchecked(peer->curr);
 
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC);
 
@@ -1324,7 +1331,7 @@ bgp_attr_local_pref(struct bgp_attr_parser_args *args)
 		return BGP_ATTR_PARSE_PROCEED;
 	}
 
-	attr->local_pref = stream_getl(peer->curr);
+	attr->local_pref = stream_getl_unchecked(peer->curr);
 
 	/* Set the local-pref flag. */
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF);
@@ -1373,10 +1380,11 @@ static int bgp_attr_aggregator(struct bgp_attr_parser_args *args)
 	}
 
 	if (CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV))
-		attr->aggregator_as = stream_getl(peer->curr);
+		attr->aggregator_as = stream_getl_unchecked(peer->curr);
 	else
-		attr->aggregator_as = stream_getw(peer->curr);
-	attr->aggregator_addr.s_addr = stream_get_ipv4(peer->curr);
+		attr->aggregator_as = stream_getw_unchecked(peer->curr);
+	attr->aggregator_addr.s_addr =
+		stream_get_ipv4_unchecked(peer->curr);
 
 	/* Set atomic aggregate flag. */
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_AGGREGATOR);
@@ -1400,8 +1408,9 @@ bgp_attr_as4_aggregator(struct bgp_attr_parser_args *args,
 					  0);
 	}
 
-	*as4_aggregator_as = stream_getl(peer->curr);
-	as4_aggregator_addr->s_addr = stream_get_ipv4(peer->curr);
+	*as4_aggregator_as = stream_getl_unchecked(peer->curr);
+	as4_aggregator_addr->s_addr =
+		stream_get_ipv4_unchecked(peer->curr);
 
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_AS4_AGGREGATOR);
 
@@ -1557,7 +1566,8 @@ bgp_attr_originator_id(struct bgp_attr_parser_args *args)
 					  args->total);
 	}
 
-	attr->originator_id.s_addr = stream_get_ipv4(peer->curr);
+	attr->originator_id.s_addr =
+		stream_get_ipv4_unchecked(peer->curr);
 
 	attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID);
 
@@ -2286,6 +2296,19 @@ bgp_attr_parse_ret_t bgp_attr_parse(struct peer *peer, struct attr *attr,
 	/* End pointer of BGP attribute. */
 	endp = BGP_INPUT_PNT(peer) + size;
 
+	/*
+	 * The one bounds check on the stream: everything up to endp is then
+	 * read unchecked, by the attribute parsers too once they checked
+	 * their attribute's length.
+	 */
+	if (!stream_reserve(BGP_INPUT(peer), size)) {
+		zlog_warn("%s: attributes length %u overruns the packet",
+			  peer->host, size);
+		bgp_notify_send(peer, BGP_NOTIFY_UPDATE_ERR,
+				BGP_NOTIFY_UPDATE_ATTR_LENG_ERR);
+		return BGP_ATTR_PARSE_ERROR;
+	}
+
 	/* Get attributes to the end of attribute length. */
 	while (BGP_INPUT_PNT(peer) < endp) {
 		/* Check remaining length check.*/
@@ -2307,8 +2330,8 @@ bgp_attr_parse_ret_t bgp_attr_parse(struct peer *peer, struct attr *attr,
 		/* "The lower-order four bits of the Attribute Flags octet are
 		   unused.  They MUST be zero when sent and MUST be ignored when
 		   received." */
-		flag = 0xF0 & stream_getc(BGP_INPUT(peer));
-		type = stream_getc(BGP_INPUT(peer));
+		flag = 0xF0 & stream_getc_unchecked(BGP_INPUT(peer));
+		type = stream_getc_unchecked(BGP_INPUT(peer));
 
 		/* Check whether Extended-Length applies and is in bounds */
 		if (CHECK_FLAG(flag, BGP_ATTR_FLAG_EXTLEN)
@@ -2326,9 +2349,9 @@ bgp_attr_parse_ret_t bgp_attr_parse(struct peer *peer, struct attr *attr,
 
 		/* Check extended attribue length bit. */
 		if (CHECK_FLAG(flag, BGP_ATTR_FLAG_EXTLEN))
-			length = stream_getw(BGP_INPUT(peer));
+			length = stream_getw_unchecked(BGP_INPUT(peer));
 		else
-			length = stream_getc(BGP_INPUT(peer));
+			length = stream_getc_unchecked(BGP_INPUT(peer));
 
 		/* If any attribute appears more than once in the UPDATE
 		   message, then the Error Subcode is set to Malformed Attribute
@@ -121,6 +121,14 @@ struct attr {
 	/* Reference count of this attribute. */
 	unsigned long refcnt;
 
+	/* Unique among interned attributes, ever; 0 if never interned. */
+	uint64_t serial;
+
+	/* attrhash_key_make() result, kept for the attribute it points back
+	   to once interned; copies of an interned attribute don't match. */
+	const struct attr *hash_self;
+	unsigned int hash_key;
+
 	/* Flag of attribute is set or not. */
 	uint64_t flag;
 
@@ -248,11 +248,12 @@ static int bgp_bfd_dest_replay(int command, struct zclient *client,
 	bfd_client_sendmsg(zclient, ZEBRA_BFD_CLIENT_REGISTER);
 
 	/* Replay the peer, if BFD is enabled in BGP */
-
+	bfd_peer_batch_begin(zclient);
 	for (ALL_LIST_ELEMENTS_RO(bm->bgp, mnode, bgp))
 		for (ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
 			bgp_bfd_update_peer(peer);
 		}
+	bfd_peer_batch_end(zclient);
 
 	return 0;
 }
@@ -0,0 +1,910 @@
+/*
+ * BGP Monitoring Protocol (RFC 7854) exporter.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Monitoring stations are connected to actively.  The main pthread encodes
+ * the messages and queues a copy on every station that is up; each station's
+ * queue is written out by the BMP pthread, so a slow station only ever makes
+ * its own queue grow.  A station that falls too far behind is disconnected
+ * and, like any station that connects, resynchronised when it is back.
+ *
+ * Route Monitoring carries the UPDATEs as received, i.e. the pre-policy
+ * Adj-RIB-In.  Rather than keeping a copy of that, a station that connects
+ * while sessions are up is brought up to date by asking those peers for a
+ * Route Refresh (RFC 7854 section 5).  Only the default instance is
+ * monitored.
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "log.h"
+#include "command.h"
+#include "linklist.h"
+#include "memory.h"
+#include "thread.h"
+#include "stream.h"
+#include "sockunion.h"
+#include "network.h"
+#include "hash.h"
+#include "jhash.h"
+#include "frr_pthread.h"
+#include "hook.h"
+#include "libfrr.h"
+#include "version.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_packet.h"
+
+DEFINE_MTYPE_STATIC(BGPD, BMP_STATION, "BMP station")
+DEFINE_MTYPE_STATIC(BGPD, BMP_OPEN, "BMP peer OPENs")
+
+#define BMP_VERSION_3 3
+
+/* message types */
+#define BMP_TYPE_ROUTE_MONITORING 0
+#define BMP_TYPE_PEER_DOWN        2
+#define BMP_TYPE_PEER_UP          3
+#define BMP_TYPE_INITIATION       4
+
+#define BMP_COMMON_HDR_LEN   6
+#define BMP_PER_PEER_HDR_LEN 42
+
+#define BMP_PEER_TYPE_GLOBAL 0
+
+#define BMP_PEER_FLAG_V (1 << 7)
+#define BMP_PEER_FLAG_A (1 << 5)
+
+#define BMP_INFO_TYPE_SYSDESCR 1
+#define BMP_INFO_TYPE_SYSNAME  2
+
+#define BMP_PEERDOWN_LOCAL_NOTIFY  1
+#define BMP_PEERDOWN_LOCAL_NONE    2
+#define BMP_PEERDOWN_REMOTE_NOTIFY 3
+#define BMP_PEERDOWN_REMOTE_NONE   4
+
+/* a station with this much queued is disconnected */
+#define BMP_QUEUE_MAX (64 * 1024 * 1024)
+/* messages handed to a single writev() */
+#define BMP_WRITE_IOV_MAX 64
+#define BMP_RETRY_TIME 30
+
+enum bmp_station_state {
+	BMP_IDLE,
+	BMP_CONNECTING,
+	BMP_UP,
+};
+
+struct bmp_station {
+	union sockunion su;
+	uint16_t port;
+
+	enum bmp_station_state state;
+	int fd;
+
+	/* main pthread: connect and retry */
+	struct thread *t_connect;
+	/* BMP pthread: writing obuf, watching for the station hanging up */
+	struct thread *t_write;
+	struct thread *t_read;
+	/* scheduled on the main pthread by the BMP pthread on errors */
+	struct thread *t_failed;
+
+	/* messages not written yet; all below under obuf_mtx */
+	pthread_mutex_t obuf_mtx;
+	struct stream_fifo *obuf;
+	size_t queued;
+	uint64_t msgs_sent;
+	uint64_t bytes_sent;
+
+	unsigned int connects;
+	unsigned int overruns;
+};
+
+/* The last OPEN sent and received on a session, for Peer Up messages. */
+struct bmp_open {
+	struct peer *peer;
+	struct stream *sent;
+	struct stream *rcvd;
+};
+
+static struct list *bmp_stations;
+static struct hash *bmp_opens;
+
+static void bmp_station_connect(struct bmp_station *st, long delay);
+static void bmp_station_close(struct bmp_station *st);
+
+static struct frr_pthread *bmp_pthread(void)
+{
+	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_BMP);
+	struct frr_pthread_attr attr = {
+		.id = PTHREAD_BMP,
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
+
+	if (fpt)
+		return fpt;
+
+	/* started on first use, after the daemon has forked off */
+	fpt = frr_pthread_new(&attr, "BGP BMP thread");
+	if (!fpt || frr_pthread_run(fpt, NULL) < 0) {
+		zlog_err("%s: could not start the BMP pthread", __func__);
+		if (fpt)
+			frr_pthread_destroy(fpt);
+		return NULL;
+	}
+	frr_pthread_wait_running(fpt);
+	return fpt;
+}
+
+/* Stored OPENs ----------------------------------------------------------- */
+
+static unsigned int bmp_open_hash_key(void *data)
+{
+	struct bmp_open *bo = data;
+
+	return jhash_1word((uint32_t)(uintptr_t)bo->peer, 0);
+}
+
+static int bmp_open_hash_cmp(const void *a, const void *b)
+{
+	const struct bmp_open *bo1 = a, *bo2 = b;
+
+	return bo1->peer == bo2->peer;
+}
+
+static void *bmp_open_alloc(void *data)
+{
+	struct bmp_open *bo = XCALLOC(MTYPE_BMP_OPEN, sizeof(struct bmp_open));
+
+	bo->peer = ((struct bmp_open *)data)->peer;
+	return bo;
+}
+
+static void bmp_open_free(void *data)
+{
+	struct bmp_open *bo = data;
+
+	if (bo->sent)
+		stream_free(bo->sent);
+	if (bo->rcvd)
+		stream_free(bo->rcvd);
+	XFREE(MTYPE_BMP_OPEN, bo);
+}
+
+/* OPENs on an incoming connection belong to the configured peer. */
+static struct peer *bmp_open_peer(struct peer *peer)
+{
+	if (CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER)
+	    && peer->doppelganger)
+		return peer->doppelganger;
+	return peer;
+}
+
+static struct bmp_open *bmp_open_lookup(struct peer *peer)
+{
+	struct bmp_open ref = {.peer = peer};
+
+	return hash_lookup(bmp_opens, &ref);
+}
+
+static void bmp_open_store(struct peer *peer, struct stream *s, bool sent)
+{
+	struct bmp_open ref = {.peer = bmp_open_peer(peer)};
+	struct bmp_open *bo = hash_get(bmp_opens, &ref, bmp_open_alloc);
+	struct stream **dst = sent ? &bo->sent : &bo->rcvd;
+
+	if (*dst)
+		stream_free(*dst);
+	*dst = stream_dup(s);
+}
+
+/* Station output, BMP pthread -------------------------------------------- */
+
+static int bmp_station_failed(struct thread *t)
+{
+	struct bmp_station *st = THREAD_ARG(t);
+	char buf[SU_ADDRSTRLEN];
+
+	zlog_warn("BMP: station %s port %u went away",
+		  sockunion2str(&st->su, buf, sizeof(buf)), st->port);
+	bmp_station_close(st);
+	bmp_station_connect(st, BMP_RETRY_TIME);
+	return 0;
+}
+
+static int bmp_station_write(struct thread *t)
+{
+	struct bmp_station *st = THREAD_ARG(t);
+	struct iovec iov[BMP_WRITE_IOV_MAX];
+	struct stream *s;
+	ssize_t num;
+	size_t len;
+	int iovcnt = 0;
+	bool more, fatal = false;
+
+	pthread_mutex_lock(&st->obuf_mtx);
+	{
+		for (s = stream_fifo_head(st->obuf);
+		     s && iovcnt < BMP_WRITE_IOV_MAX;
+		     s = stream_fifo_next(st->obuf, s)) {
+			iov[iovcnt].iov_base = stream_pnt(s);
+			iov[iovcnt].iov_len = STREAM_READABLE(s);
+			iovcnt++;
+		}
+
+		num = writev(st->fd, iov, iovcnt);
+		if (num < 0) {
+			num = 0;
+			fatal = !ERRNO_IO_RETRY(errno);
+		}
+
+		st->bytes_sent += num;
+		while (num && (s = stream_fifo_head(st->obuf))) {
+			len = MIN((size_t)num, STREAM_READABLE(s));
+			stream_forward_getp(s, len);
+			num -= len;
+			st->queued -= len;
+			if (STREAM_READABLE(s))
+				break;
+			stream_free(stream_fifo_pop(st->obuf));
+			st->msgs_sent++;
+		}
+
+		more = stream_fifo_head(st->obuf) != NULL;
+	}
+	pthread_mutex_unlock(&st->obuf_mtx);
+
+	if (fatal)
+		thread_add_event(bm->master, bmp_station_failed, st, 0,
+				 &st->t_failed);
+	else if (more)
+		thread_add_write(t->master, bmp_station_write, st, st->fd,
+				 &st->t_write);
+	return 0;
+}
+
+/* Stations have nothing to say; this only notices them hanging up. */
+static int bmp_station_read(struct thread *t)
+{
+	struct bmp_station *st = THREAD_ARG(t);
+	uint8_t buf[1024];
+	ssize_t num;
+
+	num = read(st->fd, buf, sizeof(buf));
+	if (num == 0 || (num < 0 && !ERRNO_IO_RETRY(errno))) {
+		thread_add_event(bm->master, bmp_station_failed, st, 0,
+				 &st->t_failed);
+		return 0;
+	}
+
+	thread_add_read(t->master, bmp_station_read, st, st->fd, &st->t_read);
+	return 0;
+}
+
+/* Messages, main pthread -------------------------------------------------- */
+
+static struct stream *bmp_msg_new(uint8_t type, size_t size)
+{
+	struct stream *s = stream_new(BMP_COMMON_HDR_LEN + size);
+
+	stream_putc(s, BMP_VERSION_3);
+	stream_putl(s, 0); /* length, set by bmp_send() */
+	stream_putc(s, type);
+	return s;
+}
+
+static void bmp_per_peer_hdr(struct stream *s, struct peer *peer)
+{
+	uint8_t flags = 0;
+	struct timeval tv;
+
+	if (sockunion_family(&peer->su) == AF_INET6)
+		flags |= BMP_PEER_FLAG_V;
+	if (!CHECK_FLAG(peer->cap, PEER_CAP_AS4_RCV))
+		flags |= BMP_PEER_FLAG_A;
+
+	gettimeofday(&tv, NULL);
+
+	stream_putc(s, BMP_PEER_TYPE_GLOBAL);
+	stream_putc(s, flags);
+	stream_put(s, NULL, 8); /* peer distinguisher */
+	if (sockunion_family(&peer->su) == AF_INET6)
+		stream_put(s, &peer->su.sin6.sin6_addr, IPV6_MAX_BYTELEN);
+	else {
+		stream_put(s, NULL, 12);
+		stream_put_in_addr(s, &peer->su.sin.sin_addr);
+	}
+	stream_putl(s, peer->as);
+	stream_put_in_addr(s, &peer->remote_id);
+	stream_putl(s, tv.tv_sec);
+	stream_putl(s, tv.tv_usec);
+}
+
+static void bmp_station_queue(struct bmp_station *st, struct stream *s)
+{
+	struct frr_pthread *fpt = bmp_pthread();
+	bool overrun = false;
+
+	pthread_mutex_lock(&st->obuf_mtx);
+	{
+		if (st->queued + stream_get_endp(s) > BMP_QUEUE_MAX)
+			overrun = true;
+		else {
+			st->queued += stream_get_endp(s);
+			stream_fifo_push(st->obuf, s);
+		}
+	}
+	pthread_mutex_unlock(&st->obuf_mtx);
+
+	if (overrun) {
+		char buf[SU_ADDRSTRLEN];
+
+		zlog_warn("BMP: station %s port %u is too slow, resetting",
+			  sockunion2str(&st->su, buf, sizeof(buf)), st->port);
+		stream_free(s);
+		st->overruns++;
+		bmp_station_close(st);
+		bmp_station_connect(st, BMP_RETRY_TIME);
+		return;
+	}
+
+	thread_add_write(fpt->master, bmp_station_write, st, st->fd,
+			 &st->t_write);
+}
+
+/* Sends s to one station, or to all of them that are up if st is NULL. */
+static void bmp_send(struct bmp_station *st, struct stream *s)
+{
+	struct listnode *node, *nnode;
+	struct bmp_station *last = NULL;
+
+	stream_putl_at(s, 1, stream_get_endp(s));
+
+	if (st) {
+		bmp_station_queue(st, s);
+		return;
+	}
+
+	for (ALL_LIST_ELEMENTS(bmp_stations, node, nnode, st)) {
+		if (st->state != BMP_UP)
+			continue;
+		if (last)
+			bmp_station_queue(last, stream_dup(s));
+		last = st;
+	}
+
+	if (last)
+		bmp_station_queue(last, s);
+	else
+		stream_free(s);
+}
+
+static bool bmp_stations_up(void)
+{
+	struct listnode *node;
+	struct bmp_station *st;
+
+	for (ALL_LIST_ELEMENTS_RO(bmp_stations, node, st))
+		if (st->state == BMP_UP)
+			return true;
+	return false;
+}
+
+static bool bmp_monitored(struct peer *peer)
+{
+	return peer->bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT
+	       && !CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER);
+}
+
+static void bmp_info_tlv(struct stream *s, uint16_t type, const char *str)
+{
+	stream_putw(s, type);
+	stream_putw(s, strlen(str));
+	stream_put(s, str, strlen(str));
+}
+
+static void bmp_send_initiation(struct bmp_station *st)
+{
+	const char *name = cmd_hostname_get();
+	struct stream *s;
+
+	s = bmp_msg_new(BMP_TYPE_INITIATION, 512);
+	bmp_info_tlv(s, BMP_INFO_TYPE_SYSDESCR, FRR_FULL_NAME " " FRR_VERSION);
+	bmp_info_tlv(s, BMP_INFO_TYPE_SYSNAME, name ? name : "");
+	bmp_send(st, s);
+}
+
+static void bmp_send_peer_up(struct bmp_station *st, struct peer *peer)
+{
+	struct bmp_open *bo = bmp_open_lookup(peer);
+	struct stream *s;
+
+	if (!bo || !bo->sent || !bo->rcvd || !peer->su_local
+	    || !peer->su_remote)
+		return;
+
+	s = bmp_msg_new(BMP_TYPE_PEER_UP,
+			BMP_PER_PEER_HDR_LEN + 20 + stream_get_endp(bo->sent)
+				+ stream_get_endp(bo->rcvd));
+	bmp_per_peer_hdr(s, peer);
+	if (sockunion_family(peer->su_local) == AF_INET6) {
+		stream_put(s, &peer->su_local->sin6.sin6_addr,
+			   IPV6_MAX_BYTELEN);
+		stream_putw(s, ntohs(peer->su_local->sin6.sin6_port));
+		stream_putw(s, ntohs(peer->su_remote->sin6.sin6_port));
+	} else {
+		stream_put(s, NULL, 12);
+		stream_put_in_addr(s, &peer->su_local->sin.sin_addr);
+		stream_putw(s, ntohs(peer->su_local->sin.sin_port));
+		stream_putw(s, ntohs(peer->su_remote->sin.sin_port));
+	}
+	stream_put(s, STREAM_DATA(bo->sent), stream_get_endp(bo->sent));
+	stream_put(s, STREAM_DATA(bo->rcvd), stream_get_endp(bo->rcvd));
+	bmp_send(st, s);
+}
+
+static void bmp_send_peer_down(struct peer *peer)
+{
+	struct stream *s;
+	uint8_t reason;
+	size_t datalen = 0;
+
+	switch (peer->last_reset) {
+	case PEER_DOWN_NOTIFY_RECEIVED:
+		reason = BMP_PEERDOWN_REMOTE_NOTIFY;
+		datalen = peer->notify.length;
+		break;
+	case PEER_DOWN_NOTIFY_SEND:
+	case PEER_DOWN_USER_RESET:
+	case PEER_DOWN_USER_SHUTDOWN:
+		reason = BMP_PEERDOWN_LOCAL_NOTIFY;
+		break;
+	case PEER_DOWN_CLOSE_SESSION:
+	case PEER_DOWN_NSF_CLOSE_SESSION:
+		reason = BMP_PEERDOWN_REMOTE_NONE;
+		break;
+	default:
+		reason = BMP_PEERDOWN_LOCAL_NONE;
+		break;
+	}
+
+	s = bmp_msg_new(BMP_TYPE_PEER_DOWN,
+			BMP_PER_PEER_HDR_LEN + 1 + BGP_MSG_NOTIFY_MIN_SIZE
+				+ datalen);
+	bmp_per_peer_hdr(s, peer);
+	stream_putc(s, reason);
+
+	switch (reason) {
+	case BMP_PEERDOWN_LOCAL_NOTIFY:
+	case BMP_PEERDOWN_REMOTE_NOTIFY:
+		bgp_packet_set_marker(s, BGP_MSG_NOTIFY);
+		stream_putc(s, peer->notify.code);
+		stream_putc(s, peer->notify.subcode);
+		if (datalen)
+			stream_put(s, peer->notify.data, datalen);
+		/* the NOTIFICATION's length, counted from its marker */
+		stream_putw_at(s, BMP_COMMON_HDR_LEN + BMP_PER_PEER_HDR_LEN + 1
+				       + BGP_MARKER_SIZE,
+			       BGP_MSG_NOTIFY_MIN_SIZE + datalen);
+		break;
+	case BMP_PEERDOWN_LOCAL_NONE:
+		/* no FSM event code to give */
+		stream_putw(s, 0);
+		break;
+	}
+	bmp_send(NULL, s);
+}
+
+/* Asks the peer to send everything again, so stations learn all of it. */
+static void bmp_peer_refresh(struct peer *peer)
+{
+	afi_t afi;
+	safi_t safi;
+
+	if (!CHECK_FLAG(peer->cap, PEER_CAP_REFRESH_OLD_RCV)
+	    && !CHECK_FLAG(peer->cap, PEER_CAP_REFRESH_NEW_RCV))
+		return;
+
+	FOREACH_AFI_SAFI (afi, safi)
+		if (peer->afc_nego[afi][safi])
+			bgp_route_refresh_send(peer, afi, safi, 0, 0, 0);
+}
+
+/* Hooks ------------------------------------------------------------------- */
+
+static int bmp_packet_dump(struct peer *peer, uint8_t type, bgp_size_t size,
+			   struct stream *pkt)
+{
+	struct stream *s;
+
+	if (type == BGP_MSG_OPEN) {
+		bmp_open_store(peer, pkt, false);
+		return 0;
+	}
+
+	if (type != BGP_MSG_UPDATE || !bmp_monitored(peer)
+	    || !bmp_stations_up())
+		return 0;
+
+	s = bmp_msg_new(BMP_TYPE_ROUTE_MONITORING,
+			BMP_PER_PEER_HDR_LEN + stream_get_endp(pkt));
+	bmp_per_peer_hdr(s, peer);
+	stream_put(s, STREAM_DATA(pkt), stream_get_endp(pkt));
+	bmp_send(NULL, s);
+	return 0;
+}
+
+static int bmp_packet_send(struct peer *peer, uint8_t type, bgp_size_t size,
+			   struct stream *pkt)
+{
+	if (type == BGP_MSG_OPEN)
+		bmp_open_store(peer, pkt, true);
+	return 0;
+}
+
+static int bmp_peer_established(struct peer *peer)
+{
+	if (bmp_monitored(peer) && bmp_stations_up())
+		bmp_send_peer_up(NULL, peer);
+	return 0;
+}
+
+static int bmp_peer_backward(struct peer *peer)
+{
+	if (bmp_monitored(peer) && bmp_stations_up())
+		bmp_send_peer_down(peer);
+	return 0;
+}
+
+static int bmp_peer_status_changed(struct peer *peer)
+{
+	struct bmp_open *bo;
+
+	if (peer->status != Deleted
+	    || CHECK_FLAG(peer->sflags, PEER_STATUS_ACCEPT_PEER))
+		return 0;
+
+	bo = bmp_open_lookup(peer);
+	if (bo) {
+		hash_release(bmp_opens, bo);
+		bmp_open_free(bo);
+	}
+	return 0;
+}
+
+/* Stations, main pthread -------------------------------------------------- */
+
+static void bmp_station_up(struct bmp_station *st)
+{
+	struct frr_pthread *fpt = bmp_pthread();
+	struct bgp *bgp = bgp_get_default();
+	struct listnode *node;
+	struct peer *peer;
+
+	if (!fpt) {
+		bmp_station_close(st);
+		return;
+	}
+
+	st->state = BMP_UP;
+	st->connects++;
+
+	bmp_send_initiation(st);
+
+	if (bgp)
+		for (ALL_LIST_ELEMENTS_RO(bgp->peer, node, peer)) {
+			if (peer->status != Established)
+				continue;
+			bmp_send_peer_up(st, peer);
+			bmp_peer_refresh(peer);
+		}
+
+	thread_add_read(fpt->master, bmp_station_read, st, st->fd,
+			&st->t_read);
+}
+
+static int bmp_station_connected(struct thread *t)
+{
+	struct bmp_station *st = THREAD_ARG(t);
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	st->t_connect = NULL;
+
+	if (getsockopt(st->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+		err = errno;
+	if (err) {
+		bmp_station_close(st);
+		bmp_station_connect(st, BMP_RETRY_TIME);
+		return 0;
+	}
+
+	bmp_station_up(st);
+	return 0;
+}
+
+static int bmp_station_retry(struct thread *t)
+{
+	struct bmp_station *st = THREAD_ARG(t);
+	enum connect_result res;
+
+	st->t_connect = NULL;
+
+	st->fd = sockunion_socket(&st->su);
+	if (st->fd < 0) {
+		bmp_station_connect(st, BMP_RETRY_TIME);
+		return 0;
+	}
+	set_nonblocking(st->fd);
+
+	res = sockunion_connect(st->fd, &st->su, htons(st->port), 0);
+	switch (res) {
+	case connect_success:
+		bmp_station_up(st);
+		break;
+	case connect_in_progress:
+		st->state = BMP_CONNECTING;
+		thread_add_write(bm->master, bmp_station_connected, st, st->fd,
+				 &st->t_connect);
+		break;
+	case connect_error:
+		bmp_station_close(st);
+		bmp_station_connect(st, BMP_RETRY_TIME);
+		break;
+	}
+	return 0;
+}
+
+/* Connects to the station, delay seconds from now. */
+static void bmp_station_connect(struct bmp_station *st, long delay)
+{
+	thread_add_timer(bm->master, bmp_station_retry, st, delay,
+			 &st->t_connect);
+}
+
+static void bmp_station_close(struct bmp_station *st)
+{
+	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_BMP);
+
+	if (fpt)
+		thread_cancel_async(fpt->master, &st->t_write, NULL);
+	if (fpt)
+		thread_cancel_async(fpt->master, &st->t_read, NULL);
+	THREAD_OFF(st->t_failed);
+	THREAD_OFF(st->t_connect);
+
+	if (st->fd >= 0)
+		close(st->fd);
+	st->fd = -1;
+	st->state = BMP_IDLE;
+
+	pthread_mutex_lock(&st->obuf_mtx);
+	{
+		stream_fifo_clean(st->obuf);
+		st->queued = 0;
+	}
+	pthread_mutex_unlock(&st->obuf_mtx);
+}
+
+static struct bmp_station *bmp_station_find(union sockunion *su,
+					    uint16_t port)
+{
+	struct listnode *node;
+	struct bmp_station *st;
+
+	for (ALL_LIST_ELEMENTS_RO(bmp_stations, node, st))
+		if (sockunion_same(&st->su, su) && st->port == port)
+			return st;
+	return NULL;
+}
+
+static void bmp_station_free(struct bmp_station *st)
+{
+	bmp_station_close(st);
+	listnode_delete(bmp_stations, st);
+	stream_fifo_free(st->obuf);
+	pthread_mutex_destroy(&st->obuf_mtx);
+	XFREE(MTYPE_BMP_STATION, st);
+}
+
+/* CLI --------------------------------------------------------------------- */
+
+#define BMP_STR "BGP Monitoring Protocol\n"
+
+DEFUN (bmp_connect,
+       bmp_connect_cmd,
+       "bmp connect <A.B.C.D|X:X::X:X> port (1-65535)",
+       BMP_STR
+       "Connect to a monitoring station\n"
+       "Station IPv4 address\n"
+       "Station IPv6 address\n"
+       "TCP port of the station\n"
+       "TCP port number\n")
+{
+	union sockunion su;
+	uint16_t port = strtoul(argv[4]->arg, NULL, 10);
+	struct bmp_station *st;
+
+	if (str2sockunion(argv[2]->arg, &su) < 0) {
+		vty_out(vty, "%% Malformed address\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	if (bmp_station_find(&su, port))
+		return CMD_SUCCESS;
+
+	st = XCALLOC(MTYPE_BMP_STATION, sizeof(struct bmp_station));
+	st->su = su;
+	st->port = port;
+	st->fd = -1;
+	st->obuf = stream_fifo_new();
+	pthread_mutex_init(&st->obuf_mtx, NULL);
+	listnode_add(bmp_stations, st);
+
+	bmp_station_connect(st, 0);
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bmp_connect,
+       no_bmp_connect_cmd,
+       "no bmp connect <A.B.C.D|X:X::X:X> port (1-65535)",
+       NO_STR
+       BMP_STR
+       "Connect to a monitoring station\n"
+       "Station IPv4 address\n"
+       "Station IPv6 address\n"
+       "TCP port of the station\n"
+       "TCP port number\n")
+{
+	union sockunion su;
+	uint16_t port = strtoul(argv[5]->arg, NULL, 10);
+	struct bmp_station *st;
+
+	if (str2sockunion(argv[3]->arg, &su) < 0) {
+		vty_out(vty, "%% Malformed address\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	st = bmp_station_find(&su, port);
+	if (st)
+		bmp_station_free(st);
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_bmp,
+       show_bmp_cmd,
+       "show bmp",
+       SHOW_STR
+       BMP_STR)
+{
+	static const char *const states[] = {
+		[BMP_IDLE] = "Idle",
+		[BMP_CONNECTING] = "Connecting",
+		[BMP_UP] = "Up",
+	};
+	struct listnode *node;
+	struct bmp_station *st;
+	char buf[SU_ADDRSTRLEN];
+	size_t count, queued;
+	uint64_t msgs, bytes;
+
+	for (ALL_LIST_ELEMENTS_RO(bmp_stations, node, st)) {
+		pthread_mutex_lock(&st->obuf_mtx);
+		{
+			count = stream_fifo_count(st->obuf);
+			queued = st->queued;
+			msgs = st->msgs_sent;
+			bytes = st->bytes_sent;
+		}
+		pthread_mutex_unlock(&st->obuf_mtx);
+
+		vty_out(vty, "Station %s port %u: %s\n",
+			sockunion2str(&st->su, buf, sizeof(buf)), st->port,
+			states[st->state]);
+		vty_out(vty, "  %zu messages (%zu bytes) queued\n", count,
+			queued);
+		vty_out(vty, "  %" PRIu64 " messages (%" PRIu64
+			     " bytes) sent\n",
+			msgs, bytes);
+		vty_out(vty, "  %u connects, %u resets for being too slow\n",
+			st->connects, st->overruns);
+	}
+	return CMD_SUCCESS;
+}
+
+static struct cmd_node bmp_node = {BMP_NODE, "", 1};
+
+static int bmp_config_write(struct vty *vty)
+{
+	struct listnode *node;
+	struct bmp_station *st;
+	char buf[SU_ADDRSTRLEN];
+	int write = 0;
+
+	for (ALL_LIST_ELEMENTS_RO(bmp_stations, node, st)) {
+		vty_out(vty, "bmp connect %s port %u\n",
+			sockunion2str(&st->su, buf, sizeof(buf)), st->port);
+		write++;
+	}
+	if (write)
+		vty_out(vty, "!\n");
+	return write;
+}
+
+/* Module ------------------------------------------------------------------ */
+
+static int bgp_bmp_init(struct thread_master *master)
+{
+	bmp_stations = list_new();
+	bmp_opens = hash_create(bmp_open_hash_key, bmp_open_hash_cmp,
+				"BMP peer OPENs");
+
+	install_node(&bmp_node, bmp_config_write);
+	install_element(CONFIG_NODE, &bmp_connect_cmd);
+	install_element(CONFIG_NODE, &no_bmp_connect_cmd);
+	install_element(VIEW_NODE, &show_bmp_cmd);
+	return 0;
+}
+
+static int bgp_bmp_fini(void)
+{
+	struct frr_pthread *fpt;
+
+	/* bgp_exit() still tears peers down after this */
+	hook_unregister(bgp_packet_dump, bmp_packet_dump);
+	hook_unregister(bgp_packet_send, bmp_packet_send);
+	hook_unregister(peer_established, bmp_peer_established);
+	hook_unregister(peer_backward_transition, bmp_peer_backward);
+	hook_unregister(peer_status_changed, bmp_peer_status_changed);
+
+	while (listcount(bmp_stations))
+		bmp_station_free(listgetdata(listhead(bmp_stations)));
+	list_delete_and_null(&bmp_stations);
+
+	hash_clean(bmp_opens, bmp_open_free);
+	hash_free(bmp_opens);
+	bmp_opens = NULL;
+
+	fpt = frr_pthread_get(PTHREAD_BMP);
+	if (fpt) {
+		frr_pthread_stop(fpt, NULL);
+		frr_pthread_destroy(fpt);
+	}
+	return 0;
+}
+
+static int bgp_bmp_module_init(void)
+{
+	hook_register(bgp_packet_dump, bmp_packet_dump);
+	hook_register(bgp_packet_send, bmp_packet_send);
+	hook_register(peer_established, bmp_peer_established);
+	hook_register(peer_backward_transition, bmp_peer_backward);
+	hook_register(peer_status_changed, bmp_peer_status_changed);
+	hook_register(frr_late_init, bgp_bmp_init);
+	hook_register(frr_early_fini, bgp_bmp_fini);
+	return 0;
+}
+
+FRR_MODULE_SETUP(.name = "bgpd_bmp", .version = FRR_VERSION,
+		 .description = "BGP Monitoring Protocol (RFC 7854) exporter",
+		 .init = bgp_bmp_module_init)
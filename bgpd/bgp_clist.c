@@ -52,6 +52,10 @@ community_list_master_lookup(struct community_list_handler *ch, int master)
 	return NULL;
 }
 
+/* Bumped on every change to any community-list, outdating the results
+ * cached on interned communities. */
+static uint32_t community_list_gen = 1;
+
 /* Allocate a new community list entry.  */
 static struct community_entry *community_entry_new(void)
 {
@@ -233,6 +237,8 @@ static void community_list_delete(struct community_list *list)
 	struct community_list_list *clist;
 	struct community_entry *entry, *next;
 
+	community_list_gen++;
+
 	for (entry = list->head; entry; entry = next) {
 		next = entry->next;
 		community_entry_free(entry);
@@ -258,6 +264,53 @@ static int community_list_empty_p(struct community_list *list)
 	return (list->head == NULL && list->tail == NULL) ? 1 : 0;
 }
 
+#define COMMUNITY_SUMMARY_BIT(val) (((val) * 2654435761U) >> 24)
+
+/* Rebuild the summary of the values standard entries of list require. */
+static void community_list_summary_update(struct community_list *list)
+{
+	struct community_entry *entry;
+	uint32_t val, bit;
+	int i;
+
+	list->summary = true;
+	memset(list->summary_bits, 0, sizeof(list->summary_bits));
+
+	for (entry = list->head; entry; entry = entry->next) {
+		if (entry->any || entry->style != COMMUNITY_LIST_STANDARD
+		    || !entry->u.com || !entry->u.com->size
+		    || community_include(entry->u.com, COMMUNITY_INTERNET)) {
+			list->summary = false;
+			return;
+		}
+
+		for (i = 0; i < entry->u.com->size; i++) {
+			val = community_val_get(entry->u.com, i);
+			bit = COMMUNITY_SUMMARY_BIT(val);
+			list->summary_bits[bit / 64] |= 1ULL << (bit % 64);
+		}
+	}
+}
+
+/* Whether com might match an entry of a list with a summary. */
+static bool community_list_summary_check(struct community *com,
+					 struct community_list *list)
+{
+	uint32_t val, bit;
+	int i;
+
+	if (!com)
+		return false;
+
+	for (i = 0; i < com->size; i++) {
+		val = community_val_get(com, i);
+		bit = COMMUNITY_SUMMARY_BIT(val);
+		if (list->summary_bits[bit / 64] & (1ULL << (bit % 64)))
+			return true;
+	}
+	return false;
+}
+
 /* Add community-list entry to the list.  */
 static void community_list_entry_add(struct community_list *list,
 				     struct community_entry *entry)
@@ -270,6 +323,9 @@ static void community_list_entry_add(struct community_list *list,
 	else
 		list->head = entry;
 	list->tail = entry;
+
+	community_list_gen++;
+	community_list_summary_update(list);
 }
 
 /* Delete community-list entry from the list.  */
@@ -288,9 +344,12 @@ static void community_list_entry_delete(struct community_list *list,
 		list->head = entry->next;
 
 	community_entry_free(entry);
+	community_list_gen++;
 
 	if (community_list_empty_p(list))
 		community_list_delete(list);
+	else
+		community_list_summary_update(list);
 }
 
 /* Lookup community-list entry from the list.  */
@@ -592,12 +651,14 @@ community_regexp_delete (struct community *com, regex_t * reg)
 }
 #endif
 
-/* When given community attribute matches to the community-list return
-   1 else return 0.  */
-int community_list_match(struct community *com, struct community_list *list)
+static int community_list_match_entries(struct community *com,
+					struct community_list *list)
 {
 	struct community_entry *entry;
 
+	if (list->summary && !community_list_summary_check(com, list))
+		return 0;
+
 	for (entry = list->head; entry; entry = entry->next) {
 		if (entry->any)
 			return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
@@ -619,6 +680,31 @@ int community_list_match(struct community *com, struct community_list *list)
 	return 0;
 }
 
+/* When given community attribute matches to the community-list return
+   1 else return 0.  */
+int community_list_match(struct community *com, struct community_list *list)
+{
+	int match, i;
+
+	/* Interned communities are shared by many routes, match them once */
+	if (!com || !com->refcnt)
+		return community_list_match_entries(com, list);
+
+	for (i = 0; i < COMMUNITY_LIST_CACHE; i++)
+		if (com->list_cache[i].list == list
+		    && com->list_cache[i].gen == community_list_gen)
+			return com->list_cache[i].match;
+
+	match = community_list_match_entries(com, list);
+
+	memmove(&com->list_cache[1], &com->list_cache[0],
+		sizeof(com->list_cache[0]) * (COMMUNITY_LIST_CACHE - 1));
+	com->list_cache[0].list = list;
+	com->list_cache[0].gen = community_list_gen;
+	com->list_cache[0].match = match;
+	return match;
+}
+
 int lcommunity_list_match(struct lcommunity *lcom, struct community_list *list)
 {
 	struct community_entry *entry;
@@ -668,6 +754,9 @@ int community_list_exact_match(struct community *com,
 {
 	struct community_entry *entry;
 
+	if (list->summary && !community_list_summary_check(com, list))
+		return 0;
+
 	for (entry = list->head; entry; entry = entry->next) {
 		if (entry->any)
 			return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
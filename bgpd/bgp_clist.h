@@ -60,6 +60,12 @@ struct community_list {
 	/* Community-list entry in this community-list.  */
 	struct community_entry *head;
 	struct community_entry *tail;
+
+	/* When all entries are standard community-list ones, a bit is set for
+	   the hash of every value they list.  A community with none of these
+	   bits set can't match any entry.  */
+	bool summary;
+	uint64_t summary_bits[4];
 };
 
 /* Each entry in community-list.  */
@@ -23,7 +23,7 @@
 #include "command.h"
 #include "hash.h"
 #include "memory.h"
-#include "jhash.h"
+#include "hashfn.h"
 
 #include "bgpd/bgp_memory.h"
 #include "bgpd/bgp_community.h"
@@ -161,9 +161,8 @@ uint32_t community_val_get(struct community *com, int i)
 /* Sort and uniq given community. */
 struct community *community_uniq_sort(struct community *com)
 {
-	int i;
+	int i, j;
 	struct community *new;
-	uint32_t val;
 
 	if (!com)
 		return NULL;
@@ -171,14 +170,19 @@ struct community *community_uniq_sort(struct community *com)
 	new = community_new();
 	new->json = NULL;
 
-	for (i = 0; i < com->size; i++) {
-		val = community_val_get(com, i);
+	if (!com->size)
+		return new;
 
-		if (!community_include(new, val))
-			community_add_val(new, val);
-	}
+	/* com->val may point into a packet, hence the copy before sorting.
+	   Sorted, duplicates are adjacent and one pass drops them. */
+	new->val = XMALLOC(MTYPE_COMMUNITY_VAL, com_length(com));
+	memcpy(new->val, com->val, com_length(com));
+	qsort(new->val, com->size, sizeof(uint32_t), community_compare);
 
-	qsort(new->val, new->size, sizeof(uint32_t), community_compare);
+	for (i = j = 1; i < com->size; i++)
+		if (new->val[i] != new->val[j - 1])
+			new->val[j++] = new->val[i];
+	new->size = j;
 
 	return new;
 }
@@ -441,9 +445,7 @@ char *community_str(struct community *com, bool make_json)
    hash package.*/
 unsigned int community_hash_make(struct community *com)
 {
-	uint32_t *pnt = (uint32_t *)com->val;
-
-	return jhash2(pnt, com->size, 0x43ea96c1);
+	return hashfn(com->val, com->size * sizeof(uint32_t), 0x43ea96c1);
 }
 
 int community_match(const struct community *com1, const struct community *com2)
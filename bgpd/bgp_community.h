@@ -23,6 +23,8 @@
 
 #include "lib/json.h"
 
+#define COMMUNITY_LIST_CACHE 2
+
 /* Communities attribute.  */
 struct community {
 	/* Reference count of communities value.  */
@@ -40,6 +42,14 @@ struct community {
 	/* String of community attribute.  This sring is used by vty output
 	   and expanded community-list for regular expression match.  */
 	char *str;
+
+	/* Most recent community_list_match() results, most recent first.
+	   Only used while interned, when the values can't change any more. */
+	struct {
+		const struct community_list *list;
+		uint32_t gen;
+		uint8_t match;
+	} list_cache[COMMUNITY_LIST_CACHE];
 };
 
 /* Well-known communities value.  */
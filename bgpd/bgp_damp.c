@@ -45,6 +45,14 @@ static struct bgp_damp_config *damp = &bgp_damp_cfg;
 #define BGP_DAMP_LIST_ADD(N,A)  BGP_INFO_ADD(N,A,no_reuse_list)
 #define BGP_DAMP_LIST_DEL(N,A)  BGP_INFO_DEL(N,A,no_reuse_list)
 
+/*
+ * After a flap storm a single reuse list can hold a large share of the
+ * table.  When its turn comes it is moved to this extra list, which is then
+ * evaluated REUSE_BATCH routes at a time so that other work gets to run in
+ * between.
+ */
+#define REUSE_PENDING (damp->reuse_list_size)
+
 /* Calculate reuse list index by penalty value.  */
 static int bgp_reuse_index(int penalty)
 {
@@ -103,34 +111,27 @@ int bgp_damp_decay(time_t tdiff, int penalty)
 	return (int)(penalty * damp->decay_array[i]);
 }
 
-/* Handler of reuse timer event.  Each route in the current reuse-list
-   is evaluated.  RFC2439 Section 4.8.7.  */
-static int bgp_reuse_timer(struct thread *t)
+/* Evaluate the routes whose reuse list came up, a batch at a time. */
+static int bgp_reuse_pending(struct thread *t)
 {
 	struct bgp_damp_info *bdi;
-	struct bgp_damp_info *next;
 	time_t t_now, t_diff;
+	unsigned int count = 0;
 
-	damp->t_reuse = NULL;
-	thread_add_timer(bm->master, bgp_reuse_timer, NULL, DELTA_REUSE,
-			 &damp->t_reuse);
+	damp->t_reuse_pending = NULL;
 
 	t_now = bgp_clock();
 
-	/* 1.  save a pointer to the current zeroth queue head and zero the
-	   list head entry.  */
-	bdi = damp->reuse_list[damp->reuse_offset];
-	damp->reuse_list[damp->reuse_offset] = NULL;
-
-	/* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
-	   rotating the circular queue of list-heads.  */
-	damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
-
-	/* 3. if ( the saved list head pointer is non-empty ) */
-	for (; bdi; bdi = next) {
+	while ((bdi = damp->reuse_list[REUSE_PENDING])) {
 		struct bgp *bgp = bdi->binfo->peer->bgp;
 
-		next = bdi->next;
+		if (++count > REUSE_BATCH) {
+			thread_add_event(bm->master, bgp_reuse_pending, NULL,
+					 0, &damp->t_reuse_pending);
+			break;
+		}
+
+		bgp_reuse_list_delete(bdi);
 
 		/* Set t-diff = t-now - t-updated.  */
 		t_diff = t_now - bdi->t_updated;
@@ -158,10 +159,10 @@ static int bgp_reuse_timer(struct thread *t)
 				bgp_process(bgp, bdi->rn, bdi->afi, bdi->safi);
 			}
 
+			/* bgp_damp_info_free() takes it off this list */
+			BGP_DAMP_LIST_ADD(damp, bdi);
 			if (bdi->penalty <= damp->reuse_limit / 2.0)
 				bgp_damp_info_free(bdi, 1);
-			else
-				BGP_DAMP_LIST_ADD(damp, bdi);
 		} else
 			/* Re-insert into another list (See RFC2439 Section
 			 * 4.8.6).  */
@@ -171,6 +172,46 @@ static int bgp_reuse_timer(struct thread *t)
 	return 0;
 }
 
+/* Handler of reuse timer event.  Each route in the current reuse-list
+   is evaluated.  RFC2439 Section 4.8.7.  */
+static int bgp_reuse_timer(struct thread *t)
+{
+	struct bgp_damp_info *bdi;
+	struct bgp_damp_info *tail = NULL;
+
+	damp->t_reuse = NULL;
+	thread_add_timer(bm->master, bgp_reuse_timer, NULL, DELTA_REUSE,
+			 &damp->t_reuse);
+
+	/* 1.  save a pointer to the current zeroth queue head and zero the
+	   list head entry.  */
+	bdi = damp->reuse_list[damp->reuse_offset];
+	damp->reuse_list[damp->reuse_offset] = NULL;
+
+	/* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
+	   rotating the circular queue of list-heads.  */
+	damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+
+	/* 3. if ( the saved list head pointer is non-empty ), put it in
+	   front of what is still pending and get that evaluated.  */
+	if (!bdi)
+		return 0;
+
+	for (tail = bdi; tail->next; tail = tail->next)
+		tail->index = REUSE_PENDING;
+	tail->index = REUSE_PENDING;
+
+	tail->next = damp->reuse_list[REUSE_PENDING];
+	if (tail->next)
+		tail->next->prev = tail;
+	damp->reuse_list[REUSE_PENDING] = bdi;
+
+	thread_add_event(bm->master, bgp_reuse_pending, NULL, 0,
+			 &damp->t_reuse_pending);
+
+	return 0;
+}
+
 /* A route becomes unreachable (RFC2439 Section 4.8.2).  */
 int bgp_damp_withdraw(struct bgp_info *binfo, struct bgp_node *rn, afi_t afi,
 		      safi_t safi, int attr_change)
@@ -388,14 +429,16 @@ static void bgp_damp_parameter_set(int hlife, int reuse, int sup, int maxsup)
 		damp->decay_array[i] =
 			damp->decay_array[i - 1] * damp->decay_array[1];
 
-	/* Reuse-list computations */
+	/* Reuse-list computations.  There is a list for every DELTA_REUSE
+	 * up to max-suppress-time, so that routes need not go around more
+	 * than once before being reused. */
 	i = ceil((double)damp->max_suppress_time / DELTA_REUSE) + 1;
-	if (i > REUSE_LIST_SIZE || i == 0)
+	if (i == 0)
 		i = REUSE_LIST_SIZE;
 	damp->reuse_list_size = i;
 
 	damp->reuse_list = XCALLOC(MTYPE_BGP_DAMP_ARRAY,
-				   damp->reuse_list_size
+				   (damp->reuse_list_size + 1)
 					   * sizeof(struct bgp_reuse_node *));
 
 	/* Reuse-array computations */
@@ -462,7 +505,7 @@ void bgp_damp_info_clean(void)
 
 	damp->reuse_offset = 0;
 
-	for (i = 0; i < damp->reuse_list_size; i++) {
+	for (i = 0; i <= REUSE_PENDING; i++) {
 		if (!damp->reuse_list[i])
 			continue;
 
@@ -490,6 +533,7 @@ int bgp_damp_disable(struct bgp *bgp, afi_t afi, safi_t safi)
 	if (damp->t_reuse)
 		thread_cancel(damp->t_reuse);
 	damp->t_reuse = NULL;
+	THREAD_OFF(damp->t_reuse_pending);
 
 	/* Clean BGP dampening information.  */
 	bgp_damp_info_clean();
@@ -97,7 +97,8 @@ struct bgp_damp_config {
 	/* Reuse index array per-set based. */
 	int *reuse_index;
 
-	/* Reuse list array per-set based. */
+	/* Reuse list array per-set based.  One more list than
+	 * reuse_list_size is allocated, see REUSE_PENDING. */
 	struct bgp_damp_info **reuse_list;
 	int reuse_offset;
 
@@ -106,6 +107,9 @@ struct bgp_damp_config {
 
 	/* Reuse timer thread per-set base. */
 	struct thread *t_reuse;
+
+	/* Works through the REUSE_PENDING list a batch at a time. */
+	struct thread *t_reuse_pending;
 };
 
 #define BGP_DAMP_NONE           0
@@ -127,6 +131,9 @@ struct bgp_damp_config {
 #define REUSE_LIST_SIZE          256
 #define REUSE_ARRAY_SIZE        1024
 
+/* Routes evaluated per event once their reuse list came up */
+#define REUSE_BATCH             1000
+
 extern int bgp_damp_enable(struct bgp *, afi_t, safi_t, time_t, unsigned int,
 			   unsigned int, time_t);
 extern int bgp_damp_disable(struct bgp *, afi_t, safi_t);
@@ -30,13 +30,34 @@
 #include "queue.h"
 #include "memory.h"
 #include "filter.h"
+#include "table.h"
+#include "frr_pthread.h"
+#include "ringbuf.h"
+
+#include <sys/mman.h>
 
 #include "bgpd/bgp_table.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_route.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_lcommunity.h"
 #include "bgpd/bgp_dump.h"
 
+DEFINE_MTYPE_STATIC(BGPD, BGP_DUMP_JOB, "BGP MRT routes dump")
+DEFINE_MTYPE_STATIC(BGPD, BGP_DUMP_CHUNK, "BGP MRT dump chunk")
+DEFINE_MTYPE_STATIC(BGPD, BGP_DUMP_RESTORE, "BGP MRT routes restore")
+
+/* Routes-mrt records are handed to the dump pthread in chunks this big. */
+#define BGP_DUMP_ROUTES_CHUNK (1 << 20)
+
+/* Packets and state changes beyond this much not written yet are dropped. */
+#define BGP_DUMP_RING_SIZE (1 << 22)
+
+/* Routes-mrt records read back into the RIB per event. */
+#define BGP_DUMP_RESTORE_BATCH 1000
+
 enum bgp_dump_type {
 	BGP_DUMP_ALL,
 	BGP_DUMP_ALL_ET,
@@ -83,8 +104,85 @@ struct bgp_dump {
 	char *interval_str;
 
 	struct thread *t_interval;
+
+	/*
+	 * Records on their way to fp, written out by the dump pthread.  The
+	 * main pthread appends to the ring under ring_mtx; fp is written to,
+	 * and replaced, under fp_mtx.
+	 */
+	struct ringbuf *ring;
+	pthread_mutex_t ring_mtx;
+	pthread_mutex_t fp_mtx;
+	_Atomic bool write_posted;
+
+	/* records that found the ring full since the file was opened */
+	unsigned int dropped;
 };
 
+/*
+ * A routes-mrt dump in progress.  The RIB is walked over several events of
+ * the main pthread, which encodes the records into chunks; the chunks are
+ * written out by the dump pthread.  Each prefix is encoded as it is at the
+ * time it is visited, so churn during the walk shows up in the dump as it
+ * would have in a dump taken a bit earlier or later.
+ */
+struct bgp_dump_routes_job {
+	struct bgp *bgp;
+	FILE *fp;
+	afi_t afi;
+	unsigned int seq;
+
+	struct route_table_walk *t_walk;
+
+	/* records not yet handed to the dump pthread */
+	struct stream *chunk;
+};
+
+struct bgp_dump_chunk {
+	FILE *fp;
+	struct stream *s;
+
+	/* the file is closed once this one is written */
+	bool last;
+};
+
+/* chunks handed to the dump pthread and not written out yet */
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned int pending;
+} bgp_dump_writer = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static struct bgp_dump_routes_job *bgp_dump_routes_job;
+
+/*
+ * A routes-mrt dump being read back into the RIB.  The file is mapped, and
+ * parsed a batch of records per event of the main pthread.
+ */
+struct bgp_dump_restore_job {
+	struct bgp *bgp;
+	char *filename;
+
+	uint8_t *map;
+	size_t len;
+	size_t off;
+
+	/* the dump's peer index, NULL for peers not configured (any more) */
+	struct peer **peers;
+	uint16_t npeers;
+
+	/* the record being parsed */
+	struct stream *s;
+
+	struct thread *t_restore;
+	unsigned long restored;
+};
+
+static struct bgp_dump_restore_job *bgp_dump_restore_job;
+
 static int bgp_dump_unset(struct bgp_dump *bgp_dump);
 static int bgp_dump_interval_func(struct thread *);
 
@@ -100,6 +198,152 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
+/* Waits for the dump pthread to write out everything handed to it. */
+static void bgp_dump_writer_wait(void)
+{
+	pthread_mutex_lock(&bgp_dump_writer.mtx);
+	{
+		while (bgp_dump_writer.pending)
+			pthread_cond_wait(&bgp_dump_writer.cond,
+					  &bgp_dump_writer.mtx);
+	}
+	pthread_mutex_unlock(&bgp_dump_writer.mtx);
+}
+
+/* Runs func on the dump pthread; false if that is not running. */
+static bool bgp_dump_writer_post(int (*func)(struct thread *), void *arg)
+{
+	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_DUMP);
+
+	if (!fpt || !atomic_load_explicit(&fpt->running,
+					  memory_order_relaxed))
+		return false;
+
+	pthread_mutex_lock(&bgp_dump_writer.mtx);
+	{
+		bgp_dump_writer.pending++;
+	}
+	pthread_mutex_unlock(&bgp_dump_writer.mtx);
+
+	thread_post_event(fpt->master, func, arg, 0);
+	return true;
+}
+
+/* Called on the dump pthread by each func posted, when it is done. */
+static void bgp_dump_writer_done(void)
+{
+	pthread_mutex_lock(&bgp_dump_writer.mtx);
+	{
+		bgp_dump_writer.pending--;
+		pthread_cond_signal(&bgp_dump_writer.cond);
+	}
+	pthread_mutex_unlock(&bgp_dump_writer.mtx);
+}
+
+/* Writes out what is in the ring.  Requires bgp_dump->fp_mtx. */
+static void bgp_dump_ring_drain(struct bgp_dump *bgp_dump)
+{
+	uint8_t buf[65536];
+	size_t len;
+
+	if (!bgp_dump->ring)
+		return;
+
+	do {
+		pthread_mutex_lock(&bgp_dump->ring_mtx);
+		{
+			len = ringbuf_get(bgp_dump->ring, buf, sizeof(buf));
+		}
+		pthread_mutex_unlock(&bgp_dump->ring_mtx);
+
+		if (len && bgp_dump->fp)
+			fwrite(buf, len, 1, bgp_dump->fp);
+	} while (len);
+
+	if (bgp_dump->fp)
+		fflush(bgp_dump->fp);
+}
+
+/* Runs on the dump pthread. */
+static int bgp_dump_ring_thread(struct thread *t)
+{
+	struct bgp_dump *bgp_dump = THREAD_ARG(t);
+
+	/* records put in from now on come with another event */
+	atomic_store_explicit(&bgp_dump->write_posted, false,
+			      memory_order_seq_cst);
+
+	pthread_mutex_lock(&bgp_dump->fp_mtx);
+	{
+		bgp_dump_ring_drain(bgp_dump);
+	}
+	pthread_mutex_unlock(&bgp_dump->fp_mtx);
+
+	bgp_dump_writer_done();
+	return 0;
+}
+
+/*
+ * Queues the record in obuf for the dump pthread to write out.  If the ring
+ * is full the record is dropped rather than holding up the caller.
+ */
+static void bgp_dump_write(struct bgp_dump *bgp_dump, struct stream *obuf)
+{
+	size_t len = stream_get_endp(obuf);
+	bool put = false;
+
+	pthread_mutex_lock(&bgp_dump->ring_mtx);
+	{
+		if (ringbuf_space(bgp_dump->ring) >= len) {
+			ringbuf_put(bgp_dump->ring, STREAM_DATA(obuf), len);
+			put = true;
+		}
+	}
+	pthread_mutex_unlock(&bgp_dump->ring_mtx);
+
+	if (!put) {
+		bgp_dump->dropped++;
+		return;
+	}
+
+	if (atomic_exchange_explicit(&bgp_dump->write_posted, true,
+				     memory_order_seq_cst))
+		return;
+
+	if (bgp_dump_writer_post(bgp_dump_ring_thread, bgp_dump))
+		return;
+
+	atomic_store_explicit(&bgp_dump->write_posted, false,
+			      memory_order_seq_cst);
+
+	pthread_mutex_lock(&bgp_dump->fp_mtx);
+	{
+		bgp_dump_ring_drain(bgp_dump);
+	}
+	pthread_mutex_unlock(&bgp_dump->fp_mtx);
+}
+
+/* Closes the dump file, once what is queued for it is written out. */
+static void bgp_dump_close(struct bgp_dump *bgp_dump)
+{
+	pthread_mutex_lock(&bgp_dump->fp_mtx);
+	{
+		bgp_dump_ring_drain(bgp_dump);
+
+		if (bgp_dump->fp) {
+			fclose(bgp_dump->fp);
+			bgp_dump->fp = NULL;
+		}
+	}
+	pthread_mutex_unlock(&bgp_dump->fp_mtx);
+
+	if (bgp_dump->dropped) {
+		zlog_warn("bgp_dump: %s: %u records dropped, writing fell behind",
+			  bgp_dump->filename, bgp_dump->dropped);
+		bgp_dump->dropped = 0;
+	}
+}
+
 static FILE *bgp_dump_open_file(struct bgp_dump *bgp_dump)
 {
 	int ret;
@@ -108,6 +352,7 @@ static FILE *bgp_dump_open_file(struct bgp_dump *bgp_dump)
 	char fullpath[MAXPATHLEN];
 	char realpath[MAXPATHLEN];
 	mode_t oldumask;
+	FILE *fp;
 
 	time(&clock);
 	tm = localtime(&clock);
@@ -123,14 +368,12 @@ static FILE *bgp_dump_open_file(struct bgp_dump *bgp_dump)
 		return NULL;
 	}
 
-	if (bgp_dump->fp)
-		fclose(bgp_dump->fp);
-
+	bgp_dump_close(bgp_dump);
 
 	oldumask = umask(0777 & ~LOGFILE_MASK);
-	bgp_dump->fp = fopen(realpath, "w");
+	fp = fopen(realpath, "w");
 
-	if (bgp_dump->fp == NULL) {
+	if (fp == NULL) {
 		zlog_warn("bgp_dump_open_file: %s: %s", realpath,
 			  strerror(errno));
 		umask(oldumask);
@@ -138,7 +381,13 @@ static FILE *bgp_dump_open_file(struct bgp_dump *bgp_dump)
 	}
 	umask(oldumask);
 
-	return bgp_dump->fp;
+	pthread_mutex_lock(&bgp_dump->fp_mtx);
+	{
+		bgp_dump->fp = fp;
+	}
+	pthread_mutex_unlock(&bgp_dump->fp_mtx);
+
+	return fp;
 }
 
 static int bgp_dump_interval_add(struct bgp_dump *bgp_dump, int interval)
@@ -214,8 +463,60 @@ static void bgp_dump_set_size(struct stream *s, int type)
 	stream_putl_at(s, 8, stream_get_endp(s) - BGP_DUMP_HEADER_SIZE);
 }
 
-static void bgp_dump_routes_index_table(struct bgp *bgp)
+static void bgp_dump_chunk_write(struct bgp_dump_chunk *chunk)
 {
+	size_t len = stream_get_endp(chunk->s);
+
+	if (len && fwrite(STREAM_DATA(chunk->s), len, 1, chunk->fp) != 1)
+		zlog_warn("%s: %s", __func__, safe_strerror(errno));
+	if (chunk->last && fclose(chunk->fp))
+		zlog_warn("%s: %s", __func__, safe_strerror(errno));
+
+	stream_free(chunk->s);
+	XFREE(MTYPE_BGP_DUMP_CHUNK, chunk);
+}
+
+/* Runs on the dump pthread. */
+static int bgp_dump_chunk_thread(struct thread *t)
+{
+	bgp_dump_chunk_write(THREAD_ARG(t));
+	bgp_dump_writer_done();
+
+	return 0;
+}
+
+/* Hands the records encoded so far over, to be written in the background. */
+static void bgp_dump_routes_flush(struct bgp_dump_routes_job *job, bool last)
+{
+	struct bgp_dump_chunk *chunk;
+
+	chunk = XCALLOC(MTYPE_BGP_DUMP_CHUNK, sizeof(struct bgp_dump_chunk));
+	chunk->fp = job->fp;
+	chunk->s = job->chunk;
+	chunk->last = last;
+	job->chunk = last ? NULL : stream_new(BGP_DUMP_ROUTES_CHUNK);
+
+	if (bgp_dump_writer_post(bgp_dump_chunk_thread, chunk))
+		return;
+
+	/* without the dump pthread, write in order with what it still has */
+	bgp_dump_writer_wait();
+	bgp_dump_chunk_write(chunk);
+}
+
+/* Moves the record in obuf to the current chunk. */
+static void bgp_dump_routes_put(struct bgp_dump_routes_job *job,
+				struct stream *obuf)
+{
+	if (STREAM_WRITEABLE(job->chunk) < stream_get_endp(obuf))
+		bgp_dump_routes_flush(job, false);
+
+	stream_put(job->chunk, STREAM_DATA(obuf), stream_get_endp(obuf));
+}
+
+static void bgp_dump_routes_index_table(struct bgp_dump_routes_job *job)
+{
+	struct bgp *bgp = job->bgp;
 	struct peer *peer;
 	struct listnode *node;
 	uint16_t peerno = 1;
@@ -293,15 +594,15 @@ static void bgp_dump_routes_index_table(struct bgp *bgp)
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
-	fflush(bgp_dump_routes.fp);
+	bgp_dump_routes_put(job, obuf);
 }
 
 
-static struct bgp_info *bgp_dump_route_node_record(int afi, struct bgp_node *rn,
-						   struct bgp_info *info,
-						   unsigned int seq)
+static struct bgp_info *
+bgp_dump_route_node_record(struct bgp_dump_routes_job *job,
+			   struct bgp_node *rn, struct bgp_info *info)
 {
+	afi_t afi = job->afi;
 	struct stream *obuf;
 	size_t sizep;
 	size_t endp;
@@ -320,7 +621,7 @@ static struct bgp_info *bgp_dump_route_node_record(int afi, struct bgp_node *rn,
 				BGP_DUMP_ROUTES);
 
 	/* Sequence number */
-	stream_putl(obuf, seq);
+	stream_putl(obuf, job->seq);
 
 	/* Prefix length */
 	stream_putc(obuf, rn->p.prefixlen);
@@ -351,6 +652,11 @@ static struct bgp_info *bgp_dump_route_node_record(int afi, struct bgp_node *rn,
 	for (; info; info = info->next) {
 		size_t cur_endp;
 
+		/* Peers configured since the dump started are not indexed */
+		if (!info->peer->table_dump_index
+		    && info->peer != job->bgp->peer_self)
+			continue;
+
 		/* Peer index */
 		stream_putw(obuf, info->peer->table_dump_index);
 
@@ -376,49 +682,89 @@ static struct bgp_info *bgp_dump_route_node_record(int afi, struct bgp_node *rn,
 	stream_putw_at(obuf, sizep, entry_count);
 
 	bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_routes.fp);
+	if (entry_count) {
+		bgp_dump_routes_put(job, obuf);
+		job->seq++;
+	}
 
 	return info;
 }
 
+static int bgp_dump_routes_walk(struct route_node *node, void *arg)
+{
+	struct bgp_dump_routes_job *job = arg;
+	struct bgp_node *rn = bgp_node_from_rnode(node);
+	struct bgp_info *info = rn->info;
+
+	while (info)
+		info = bgp_dump_route_node_record(job, rn, info);
 
-/* Runs under child process. */
-static unsigned int bgp_dump_routes_func(int afi, int first_run,
-					 unsigned int seq)
+	return 0;
+}
+
+static void bgp_dump_routes_stop(void)
 {
-	struct bgp_info *info;
-	struct bgp_node *rn;
+	struct bgp_dump_routes_job *job = bgp_dump_routes_job;
+
+	if (!job)
+		return;
+
+	route_table_walk_cancel(&job->t_walk);
+	bgp_dump_routes_flush(job, true);
+	bgp_unlock(job->bgp);
+	XFREE(MTYPE_BGP_DUMP_JOB, job);
+	bgp_dump_routes_job = NULL;
+}
+
+static void bgp_dump_routes_done(void *arg)
+{
+	struct bgp_dump_routes_job *job = arg;
+
+	if (job->afi == AFI_IP) {
+		job->afi = AFI_IP6;
+		route_table_walk_start(bm->master,
+				       job->bgp->rib[AFI_IP6][SAFI_UNICAST]
+					       ->route_table,
+				       bgp_dump_routes_walk,
+				       bgp_dump_routes_done, job, &job->t_walk);
+		return;
+	}
+
+	bgp_dump_routes_stop();
+}
+
+/*
+ * Takes the freshly opened file over from bgp_dump_routes and starts walking
+ * the RIB; the file is closed when the dump is complete.
+ */
+static void bgp_dump_routes_func(void)
+{
+	struct bgp_dump_routes_job *job;
 	struct bgp *bgp;
-	struct bgp_table *table;
 
 	bgp = bgp_get_default();
-	if (!bgp)
-		return seq;
+	if (!bgp) {
+		fclose(bgp_dump_routes.fp);
+		bgp_dump_routes.fp = NULL;
+		return;
+	}
 
-	if (bgp_dump_routes.fp == NULL)
-		return seq;
+	job = XCALLOC(MTYPE_BGP_DUMP_JOB, sizeof(struct bgp_dump_routes_job));
+	job->bgp = bgp_lock(bgp);
+	job->fp = bgp_dump_routes.fp;
+	bgp_dump_routes.fp = NULL;
+	job->afi = AFI_IP;
+	job->chunk = stream_new(BGP_DUMP_ROUTES_CHUNK);
+	bgp_dump_routes_job = job;
 
 	/* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-	   so this should only be done on the first call to
-	   bgp_dump_routes_func.
-	   ( this function will be called once for ipv4 and once for ipv6 ) */
-	if (first_run)
-		bgp_dump_routes_index_table(bgp);
-
-	/* Walk down each BGP route. */
-	table = bgp->rib[afi][SAFI_UNICAST];
-
-	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		info = rn->info;
-		while (info) {
-			info = bgp_dump_route_node_record(afi, rn, info, seq);
-			seq++;
-		}
-	}
-
-	fflush(bgp_dump_routes.fp);
+	   so it is only needed once, ahead of both walks. */
+	bgp_dump_routes_index_table(job);
 
-	return seq;
+	route_table_walk_start(bm->master,
+			       bgp->rib[AFI_IP][SAFI_UNICAST]->route_table,
+			       bgp_dump_routes_walk, bgp_dump_routes_done, job,
+			       &job->t_walk);
 }
 
 static int bgp_dump_interval_func(struct thread *t)
@@ -427,19 +773,18 @@ static int bgp_dump_interval_func(struct thread *t)
 	bgp_dump = THREAD_ARG(t);
 	bgp_dump->t_interval = NULL;
 
+	/* The previous RIB dump is still being walked, skip this one */
+	if (bgp_dump->type == BGP_DUMP_ROUTES && bgp_dump_routes_job)
+		zlog_warn("%s: previous routes-mrt dump is still running",
+			  __func__);
 	/* Reschedule dump even if file couldn't be opened this time... */
-	if (bgp_dump_open_file(bgp_dump) != NULL) {
+	else if (bgp_dump_open_file(bgp_dump) != NULL) {
 		/* In case of bgp_dump_routes, we need special route dump
-		 * function. */
-		if (bgp_dump->type == BGP_DUMP_ROUTES) {
-			unsigned int seq = bgp_dump_routes_func(AFI_IP, 1, 0);
-			bgp_dump_routes_func(AFI_IP6, 0, seq);
-			/* Close the file now. For a RIB dump there's no point
-			 * in leaving
-			 * it open until the next scheduled dump starts. */
-			fclose(bgp_dump->fp);
-			bgp_dump->fp = NULL;
-		}
+		 * function.  It closes the file when done, for a RIB dump
+		 * there's no point in leaving it open until the next
+		 * scheduled dump starts. */
+		if (bgp_dump->type == BGP_DUMP_ROUTES)
+			bgp_dump_routes_func();
 	}
 
 	/* if interval is set reschedule */
@@ -449,6 +794,410 @@ static int bgp_dump_interval_func(struct thread *t)
 	return 0;
 }
 
+static void bgp_dump_restore_peers_free(struct bgp_dump_restore_job *job)
+{
+	unsigned int i;
+
+	for (i = 0; i < job->npeers; i++)
+		if (job->peers[i])
+			peer_unlock(job->peers[i]);
+
+	if (job->peers)
+		XFREE(MTYPE_BGP_DUMP_RESTORE, job->peers);
+	job->npeers = 0;
+}
+
+static void bgp_dump_restore_stop(void)
+{
+	struct bgp_dump_restore_job *job = bgp_dump_restore_job;
+
+	if (!job)
+		return;
+
+	THREAD_OFF(job->t_restore);
+	munmap(job->map, job->len);
+	bgp_dump_restore_peers_free(job);
+	stream_free(job->s);
+	bgp_unlock(job->bgp);
+	XFREE(MTYPE_BGP_DUMP_RESTORE, job->filename);
+	XFREE(MTYPE_BGP_DUMP_RESTORE, job);
+	bgp_dump_restore_job = NULL;
+}
+
+/* Maps the peers of the dump's index table to the ones configured now. */
+static int bgp_dump_restore_index_table(struct bgp_dump_restore_job *job,
+					struct stream *s)
+{
+	union sockunion su;
+	struct peer *peer;
+	uint16_t namelen;
+	uint16_t count;
+	uint8_t type;
+	unsigned int i;
+
+	bgp_dump_restore_peers_free(job);
+
+	/* Collector BGP ID, View name */
+	if (STREAM_READABLE(s) < 6)
+		return -1;
+	stream_forward_getp(s, 4);
+	namelen = stream_getw(s);
+	if (STREAM_READABLE(s) < namelen)
+		return -1;
+	stream_forward_getp(s, namelen);
+
+	STREAM_GETW(s, count);
+	if (!count)
+		return -1;
+	job->peers = XCALLOC(MTYPE_BGP_DUMP_RESTORE,
+			     count * sizeof(struct peer *));
+	job->npeers = count;
+
+	for (i = 0; i < count; i++) {
+		memset(&su, 0, sizeof(su));
+
+		/* Peer type, Peer BGP ID */
+		STREAM_GETC(s, type);
+		if (STREAM_READABLE(s) < 4)
+			goto stream_failure;
+		stream_forward_getp(s, 4);
+
+		/* Peer IP address */
+		if (type & TABLE_DUMP_V2_PEER_INDEX_TABLE_IP6) {
+			su.sin6.sin6_family = AF_INET6;
+			STREAM_GET(&su.sin6.sin6_addr, s, IPV6_MAX_BYTELEN);
+		} else {
+			su.sin.sin_family = AF_INET;
+			STREAM_GET(&su.sin.sin_addr, s, IPV4_MAX_BYTELEN);
+		}
+
+		/* Peer AS */
+		if (STREAM_READABLE(s) < 4)
+			goto stream_failure;
+		stream_forward_getp(s, type & TABLE_DUMP_V2_PEER_INDEX_TABLE_AS4
+					       ? 4
+					       : 2);
+
+		peer = peer_lookup(job->bgp, &su);
+		if (peer)
+			job->peers[i] = peer_lock(peer);
+	}
+
+	return 0;
+
+stream_failure:
+	return -1;
+}
+
+/*
+ * Decodes the attributes bgp_dump_routes_attr() writes.  Everything attr
+ * refers to is interned, for bgp_attr_unintern_sub() to release.
+ */
+static int bgp_dump_restore_attr(struct stream *s, size_t len,
+				 struct attr *attr)
+{
+	size_t end;
+	size_t start;
+	uint16_t alen;
+	uint8_t flag;
+	uint8_t type;
+	uint8_t nhlen;
+
+	memset(attr, 0, sizeof(*attr));
+	attr->label_index = BGP_INVALID_LABEL_INDEX;
+	attr->label = MPLS_INVALID_LABEL;
+
+	end = stream_get_getp(s) + len;
+	while (stream_get_getp(s) < end) {
+		STREAM_GETC(s, flag);
+		STREAM_GETC(s, type);
+		if (CHECK_FLAG(flag, BGP_ATTR_FLAG_EXTLEN))
+			STREAM_GETW(s, alen);
+		else
+			STREAM_GETC(s, alen);
+
+		start = stream_get_getp(s);
+		if (start + alen > end)
+			goto stream_failure;
+
+		switch (type) {
+		case BGP_ATTR_ORIGIN:
+			STREAM_GETC(s, attr->origin);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_ORIGIN);
+			break;
+		case BGP_ATTR_AS_PATH:
+			if (attr->aspath)
+				goto stream_failure;
+			attr->aspath = aspath_parse(s, alen, 1);
+			if (!attr->aspath)
+				goto stream_failure;
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_AS_PATH);
+			break;
+		case BGP_ATTR_NEXT_HOP:
+			STREAM_GET(&attr->nexthop, s, IPV4_MAX_BYTELEN);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_NEXT_HOP);
+			break;
+		case BGP_ATTR_MULTI_EXIT_DISC:
+			STREAM_GETL(s, attr->med);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_MULTI_EXIT_DISC);
+			break;
+		case BGP_ATTR_LOCAL_PREF:
+			STREAM_GETL(s, attr->local_pref);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_LOCAL_PREF);
+			break;
+		case BGP_ATTR_ATOMIC_AGGREGATE:
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE);
+			break;
+		case BGP_ATTR_AGGREGATOR:
+			STREAM_GETL(s, attr->aggregator_as);
+			STREAM_GET(&attr->aggregator_addr, s, IPV4_MAX_BYTELEN);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_AGGREGATOR);
+			break;
+		case BGP_ATTR_COMMUNITIES:
+			if (attr->community)
+				goto stream_failure;
+			attr->community = community_parse(
+				(uint32_t *)stream_pnt(s), alen);
+			if (!attr->community)
+				goto stream_failure;
+			attr->community = community_intern(attr->community);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_COMMUNITIES);
+			break;
+		case BGP_ATTR_LARGE_COMMUNITIES:
+			if (attr->lcommunity)
+				goto stream_failure;
+			attr->lcommunity = lcommunity_parse(stream_pnt(s), alen);
+			if (!attr->lcommunity)
+				goto stream_failure;
+			attr->lcommunity = lcommunity_intern(attr->lcommunity);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_LARGE_COMMUNITIES);
+			break;
+		case BGP_ATTR_MP_REACH_NLRI:
+			/* AFI, SAFI, then the next hop(s) */
+			if (alen < 4)
+				goto stream_failure;
+			stream_forward_getp(s, 3);
+			STREAM_GETC(s, nhlen);
+			if (nhlen != BGP_ATTR_NHLEN_IPV6_GLOBAL
+			    && nhlen != BGP_ATTR_NHLEN_IPV6_GLOBAL_AND_LL)
+				goto stream_failure;
+			attr->mp_nexthop_len = nhlen;
+			STREAM_GET(&attr->mp_nexthop_global, s,
+				   IPV6_MAX_BYTELEN);
+			if (nhlen == BGP_ATTR_NHLEN_IPV6_GLOBAL_AND_LL)
+				STREAM_GET(&attr->mp_nexthop_local, s,
+					   IPV6_MAX_BYTELEN);
+			attr->flag |= ATTR_FLAG_BIT(BGP_ATTR_MP_REACH_NLRI);
+			break;
+		default:
+			/* not something bgp_dump_routes_attr() writes */
+			break;
+		}
+
+		if (stream_get_getp(s) > start + alen)
+			goto stream_failure;
+		stream_set_getp(s, start + alen);
+	}
+
+	if (!attr->aspath)
+		goto stream_failure;
+
+	return 0;
+
+stream_failure:
+	bgp_attr_unintern_sub(attr);
+	return -1;
+}
+
+static int bgp_dump_restore_rib(struct bgp_dump_restore_job *job,
+				struct stream *s, afi_t afi)
+{
+	struct prefix p;
+	struct attr attr;
+	struct peer *peer;
+	uint32_t originated;
+	uint16_t count;
+	uint16_t index;
+	uint16_t len;
+	time_t now;
+	time_t age;
+	unsigned int i;
+
+	memset(&p, 0, sizeof(p));
+	p.family = afi2family(afi);
+
+	/* Sequence number */
+	if (STREAM_READABLE(s) < 4)
+		return -1;
+	stream_forward_getp(s, 4);
+
+	/* Prefix */
+	STREAM_GETC(s, p.prefixlen);
+	if (p.prefixlen > prefix_blen(&p) * 8)
+		return -1;
+	STREAM_GET(&p.u.prefix, s, PSIZE(p.prefixlen));
+	apply_mask(&p);
+
+	now = time(NULL);
+	STREAM_GETW(s, count);
+	for (i = 0; i < count; i++) {
+		STREAM_GETW(s, index);
+		STREAM_GETL(s, originated);
+		STREAM_GETW(s, len);
+		if (STREAM_READABLE(s) < len)
+			return -1;
+
+		peer = index < job->npeers ? job->peers[index] : NULL;
+		if (!peer || peer->status == Established
+		    || peer->status == Deleted
+		    || !peer->afc[afi][SAFI_UNICAST]) {
+			stream_forward_getp(s, len);
+			continue;
+		}
+
+		if (bgp_dump_restore_attr(s, len, &attr) < 0)
+			return -1;
+
+		age = now > (time_t)originated ? now - originated : 0;
+		bgp_rib_restore(peer, afi, SAFI_UNICAST, &p, &attr,
+				bgp_clock() - age);
+		bgp_attr_unintern_sub(&attr);
+		job->restored++;
+	}
+
+	return 0;
+
+stream_failure:
+	return -1;
+}
+
+static int bgp_dump_restore_func(struct thread *t)
+{
+	struct bgp_dump_restore_job *job = THREAD_ARG(t);
+	struct stream *s = job->s;
+	uint16_t type;
+	uint16_t subtype;
+	uint32_t len;
+	size_t off;
+	int ret;
+	int n;
+
+	job->t_restore = NULL;
+
+	for (n = 0; n < BGP_DUMP_RESTORE_BATCH; n++) {
+		off = job->off;
+		if (job->len - off < BGP_DUMP_HEADER_SIZE)
+			break;
+
+		/* MRT header: timestamp, type, subtype, length */
+		stream_reset(s);
+		stream_put(s, job->map + off, BGP_DUMP_HEADER_SIZE);
+		stream_forward_getp(s, 4);
+		type = stream_getw(s);
+		subtype = stream_getw(s);
+		len = stream_getl(s);
+		if (job->len - off - BGP_DUMP_HEADER_SIZE < len) {
+			zlog_warn("bgp_dump: %s: truncated at offset %zu",
+				  job->filename, off);
+			break;
+		}
+		job->off += BGP_DUMP_HEADER_SIZE + len;
+
+		/* not a record bgp_dump_routes_func() writes */
+		if (type != MSG_TABLE_DUMP_V2 || len > STREAM_SIZE(s))
+			continue;
+
+		stream_reset(s);
+		stream_put(s, job->map + off + BGP_DUMP_HEADER_SIZE, len);
+
+		switch (subtype) {
+		case TABLE_DUMP_V2_PEER_INDEX_TABLE:
+			ret = bgp_dump_restore_index_table(job, s);
+			break;
+		case TABLE_DUMP_V2_RIB_IPV4_UNICAST:
+			ret = bgp_dump_restore_rib(job, s, AFI_IP);
+			break;
+		case TABLE_DUMP_V2_RIB_IPV6_UNICAST:
+			ret = bgp_dump_restore_rib(job, s, AFI_IP6);
+			break;
+		default:
+			ret = 0;
+			break;
+		}
+
+		if (ret < 0) {
+			zlog_warn("bgp_dump: %s: malformed record at offset %zu",
+				  job->filename, off);
+			job->off = job->len;
+			break;
+		}
+	}
+
+	if (n == BGP_DUMP_RESTORE_BATCH) {
+		thread_add_event(bm->master, bgp_dump_restore_func, job, 0,
+				 &job->t_restore);
+		return 0;
+	}
+
+	zlog_info("bgp_dump: restored %lu paths from %s", job->restored,
+		  job->filename);
+	bgp_dump_restore_stop();
+
+	return 0;
+}
+
+/*
+ * Reads the routes-mrt dump configured as the instance's rib-restore file
+ * back into the RIB, so that best paths and forwarding are in place while
+ * the sessions come up again.  Only done while the instance is starting
+ * up, as only then is there nothing in the RIB the dump could be older
+ * than.
+ */
+void bgp_dump_restore(struct bgp *bgp)
+{
+	struct bgp_dump_restore_job *job;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if (!bgp->rib_restore_file || !bgp->t_startup || bgp_dump_restore_job)
+		return;
+
+	fd = open(bgp->rib_restore_file, O_RDONLY);
+	if (fd < 0) {
+		zlog_warn("bgp_dump: %s: %s", bgp->rib_restore_file,
+			  safe_strerror(errno));
+		return;
+	}
+	if (fstat(fd, &st) < 0 || !st.st_size) {
+		close(fd);
+		return;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		zlog_warn("bgp_dump: %s: %s", bgp->rib_restore_file,
+			  safe_strerror(errno));
+		return;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	job = XCALLOC(MTYPE_BGP_DUMP_RESTORE,
+		      sizeof(struct bgp_dump_restore_job));
+	job->bgp = bgp_lock(bgp);
+	job->filename = XSTRDUP(MTYPE_BGP_DUMP_RESTORE, bgp->rib_restore_file);
+	job->map = map;
+	job->len = st.st_size;
+	job->s = stream_new((BGP_MAX_PACKET_SIZE << 1) + BGP_DUMP_MSG_HEADER
+			    + BGP_DUMP_HEADER_SIZE);
+	bgp_dump_restore_job = job;
+
+	/* after the rest of the configuration, peers in particular, is read */
+	thread_add_event(bm->master, bgp_dump_restore_func, job, 0,
+			 &job->t_restore);
+}
+
 /* Dump common information. */
 static void bgp_dump_common(struct stream *obuf, struct peer *peer,
 			    int forceas4)
@@ -514,9 +1263,8 @@ void bgp_dump_state(struct peer *peer, int status_old, int status_new)
 	/* Set length. */
 	bgp_dump_set_size(obuf, MSG_PROTOCOL_BGP4MP);
 
-	/* Write to the stream. */
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump_all.fp);
-	fflush(bgp_dump_all.fp);
+	/* Queue for writing. */
+	bgp_dump_write(&bgp_dump_all, obuf);
 }
 
 static void bgp_dump_packet_func(struct bgp_dump *bgp_dump, struct peer *peer,
@@ -548,9 +1296,8 @@ static void bgp_dump_packet_func(struct bgp_dump *bgp_dump, struct peer *peer,
 	/* Set length. */
 	bgp_dump_set_size(obuf, MSG_PROTOCOL_BGP4MP);
 
-	/* Write to the stream. */
-	fwrite(STREAM_DATA(obuf), stream_get_endp(obuf), 1, bgp_dump->fp);
-	fflush(bgp_dump->fp);
+	/* Queue for writing. */
+	bgp_dump_write(bgp_dump, obuf);
 }
 
 /* Called from bgp_packet.c when BGP packet is received. */
@@ -661,18 +1408,19 @@ static int bgp_dump_set(struct vty *vty, struct bgp_dump *bgp_dump,
 
 static int bgp_dump_unset(struct bgp_dump *bgp_dump)
 {
+	/* Stopping a RIB dump in progress, what was walked is kept. */
+	if (bgp_dump == &bgp_dump_routes)
+		bgp_dump_routes_stop();
+
+	/* Closing file. */
+	bgp_dump_close(bgp_dump);
+
 	/* Removing file name. */
 	if (bgp_dump->filename) {
 		XFREE(MTYPE_BGP_DUMP_STR, bgp_dump->filename);
 		bgp_dump->filename = NULL;
 	}
 
-	/* Closing file. */
-	if (bgp_dump->fp) {
-		fclose(bgp_dump->fp);
-		bgp_dump->fp = NULL;
-	}
-
 	/* Removing interval thread. */
 	if (bgp_dump->t_interval) {
 		thread_cancel(bgp_dump->t_interval);
@@ -853,6 +1601,14 @@ void bgp_dump_init(void)
 	memset(&bgp_dump_updates, 0, sizeof(struct bgp_dump));
 	memset(&bgp_dump_routes, 0, sizeof(struct bgp_dump));
 
+	bgp_dump_all.ring = ringbuf_new(BGP_DUMP_RING_SIZE);
+	bgp_dump_updates.ring = ringbuf_new(BGP_DUMP_RING_SIZE);
+	pthread_mutex_init(&bgp_dump_all.ring_mtx, NULL);
+	pthread_mutex_init(&bgp_dump_updates.ring_mtx, NULL);
+	pthread_mutex_init(&bgp_dump_all.fp_mtx, NULL);
+	pthread_mutex_init(&bgp_dump_updates.fp_mtx, NULL);
+	pthread_mutex_init(&bgp_dump_routes.fp_mtx, NULL);
+
 	bgp_dump_obuf =
 		stream_new((BGP_MAX_PACKET_SIZE << 1) + BGP_DUMP_MSG_HEADER
 			   + BGP_DUMP_HEADER_SIZE);
@@ -868,6 +1624,16 @@ void bgp_dump_finish(void)
 	bgp_dump_unset(&bgp_dump_all);
 	bgp_dump_unset(&bgp_dump_updates);
 	bgp_dump_unset(&bgp_dump_routes);
+	bgp_dump_restore_stop();
+	bgp_dump_writer_wait();
+
+	ringbuf_del(bgp_dump_all.ring);
+	ringbuf_del(bgp_dump_updates.ring);
+	pthread_mutex_destroy(&bgp_dump_all.ring_mtx);
+	pthread_mutex_destroy(&bgp_dump_updates.ring_mtx);
+	pthread_mutex_destroy(&bgp_dump_all.fp_mtx);
+	pthread_mutex_destroy(&bgp_dump_updates.fp_mtx);
+	pthread_mutex_destroy(&bgp_dump_routes.fp_mtx);
 
 	stream_free(bgp_dump_obuf);
 	bgp_dump_obuf = NULL;
@@ -26,7 +26,7 @@
 #include "command.h"
 #include "queue.h"
 #include "filter.h"
-#include "jhash.h"
+#include "hashfn.h"
 #include "stream.h"
 
 #include "bgpd/bgpd.h"
@@ -110,25 +110,42 @@ int ecommunity_add_val(struct ecommunity *ecom, struct ecommunity_val *eval)
 	return 1;
 }
 
+static int ecommunity_compare(const void *a1, const void *a2)
+{
+	return memcmp(a1, a2, ECOMMUNITY_SIZE);
+}
+
 /* This function takes pointer to Extended Communites strucutre then
    create a new Extended Communities structure by uniq and sort each
    Extended Communities value.  */
 struct ecommunity *ecommunity_uniq_sort(struct ecommunity *ecom)
 {
-	int i;
+	int i, j;
 	struct ecommunity *new;
-	struct ecommunity_val *eval;
 
 	if (!ecom)
 		return NULL;
 
 	new = ecommunity_new();
 
-	for (i = 0; i < ecom->size; i++) {
-		eval = (struct ecommunity_val *)(ecom->val
-						 + (i * ECOMMUNITY_SIZE));
-		ecommunity_add_val(new, eval);
-	}
+	if (!ecom->size)
+		return new;
+
+	/* Same order as ecommunity_add_val() builds, in one sort instead of
+	   an insertion per value.  Duplicates end up adjacent. */
+	new->val = XMALLOC(MTYPE_ECOMMUNITY_VAL, ecom_length(ecom));
+	memcpy(new->val, ecom->val, ecom_length(ecom));
+	qsort(new->val, ecom->size, ECOMMUNITY_SIZE, ecommunity_compare);
+
+	for (i = j = 1; i < ecom->size; i++)
+		if (memcmp(new->val + i * ECOMMUNITY_SIZE,
+			   new->val + (j - 1) * ECOMMUNITY_SIZE,
+			   ECOMMUNITY_SIZE))
+			memmove(new->val + j++ * ECOMMUNITY_SIZE,
+				new->val + i * ECOMMUNITY_SIZE,
+				ECOMMUNITY_SIZE);
+	new->size = j;
+
 	return new;
 }
 
@@ -244,7 +261,7 @@ unsigned int ecommunity_hash_make(void *arg)
 	const struct ecommunity *ecom = arg;
 	int size = ecom->size * ECOMMUNITY_SIZE;
 
-	return jhash(ecom->val, size, 0x564321ab);
+	return hashfn(ecom->val, size, 0x564321ab);
 }
 
 /* Compare two Extended Communities Attribute structure.  */
@@ -482,6 +482,48 @@ static void evpn_convert_nexthop_to_ipv6(struct attr *attr)
 	attr->mp_nexthop_len = IPV6_MAX_BYTELEN;
 }
 
+/*
+ * Zebra takes any number of MACIPs in one ZEBRA_REMOTE_MACIP_ADD or _DEL
+ * message, so rather than sending one message per route they are collected
+ * here and sent once the current event is done, the command or instance
+ * changes or the message is full.
+ */
+#define MACIP_ENTRY_MAX (4 + ETH_ALEN + 4 + IPV6_MAX_BYTELEN + 4 + 1)
+
+static struct stream *macip_batch;
+static uint16_t macip_batch_cmd;
+static vrf_id_t macip_batch_vrf;
+static struct thread *t_macip_batch;
+
+static void bgp_zebra_macip_flush(void)
+{
+	struct stream *s;
+
+	THREAD_OFF(t_macip_batch);
+
+	if (!macip_batch || !stream_get_endp(macip_batch))
+		return;
+
+	if (zclient && zclient->sock >= 0) {
+		stream_putw_at(macip_batch, 0, stream_get_endp(macip_batch));
+
+		s = zclient->obuf;
+		stream_reset(s);
+		stream_put(s, STREAM_DATA(macip_batch),
+			   stream_get_endp(macip_batch));
+		zclient_send_message(zclient);
+	}
+
+	stream_reset(macip_batch);
+}
+
+static int bgp_zebra_macip_flush_event(struct thread *thread)
+{
+	t_macip_batch = NULL;
+	bgp_zebra_macip_flush();
+	return 0;
+}
+
 /*
  * Add (update) or delete MACIP from zebra.
  */
@@ -491,6 +533,7 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 				       uint8_t flags)
 {
 	struct stream *s;
+	uint16_t cmd = add ? ZEBRA_REMOTE_MACIP_ADD : ZEBRA_REMOTE_MACIP_DEL;
 	int ipa_len;
 	char buf1[ETHER_ADDR_STRLEN];
 	char buf2[INET6_ADDRSTRLEN];
@@ -504,12 +547,21 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 	if (!IS_BGP_INST_KNOWN_TO_ZEBRA(bgp))
 		return 0;
 
-	s = zclient->obuf;
-	stream_reset(s);
+	if (!macip_batch)
+		macip_batch = stream_new(ZEBRA_MAX_PACKET_SIZ);
+
+	s = macip_batch;
+	if (stream_get_endp(s)
+	    && (macip_batch_cmd != cmd || macip_batch_vrf != bgp->vrf_id
+		|| STREAM_WRITEABLE(s) < MACIP_ENTRY_MAX))
+		bgp_zebra_macip_flush();
+
+	if (!stream_get_endp(s)) {
+		zclient_create_header(s, cmd, bgp->vrf_id);
+		macip_batch_cmd = cmd;
+		macip_batch_vrf = bgp->vrf_id;
+	}
 
-	zclient_create_header(
-		s, add ? ZEBRA_REMOTE_MACIP_ADD : ZEBRA_REMOTE_MACIP_DEL,
-		bgp->vrf_id);
 	stream_putl(s, vpn->vni);
 	stream_put(s, &p->prefix.mac.octet, ETH_ALEN); /* Mac Addr */
 	/* IP address length and IP address, if any. */
@@ -527,8 +579,6 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 	if (add)
 		stream_putc(s, flags);
 
-	stream_putw_at(s, 0, stream_get_endp(s));
-
 	if (bgp_debug_zebra(NULL))
 		zlog_debug(
 			"Tx %s MACIP, VNI %u MAC %s IP %s (flags: 0x%x) remote VTEP %s",
@@ -538,7 +588,9 @@ static int bgp_zebra_send_remote_macip(struct bgp *bgp, struct bgpevpn *vpn,
 			inet_ntop(AF_INET, &remote_vtep_ip, buf2,
 				  sizeof(buf2)));
 
-	return zclient_send_message(zclient);
+	thread_add_event(bm->master, bgp_zebra_macip_flush_event, NULL, 0,
+			 &t_macip_batch);
+	return 0;
 }
 
 /*
@@ -557,6 +609,9 @@ static int bgp_zebra_send_remote_vtep(struct bgp *bgp, struct bgpevpn *vpn,
 	if (!IS_BGP_INST_KNOWN_TO_ZEBRA(bgp))
 		return 0;
 
+	/* zebra must see the MACIPs behind a VTEP in order with it */
+	bgp_zebra_macip_flush();
+
 	s = zclient->obuf;
 	stream_reset(s);
 
@@ -580,7 +635,7 @@ static int bgp_zebra_send_remote_vtep(struct bgp *bgp, struct bgpevpn *vpn,
 			   add ? "ADD" : "DEL", vpn->vni,
 			   inet_ntoa(p->prefix.ip.ipaddr_v4));
 
-	return zclient_send_message(zclient);
+	return zclient_send_message(zclient) < 0 ? -1 : 0;
 }
 
 /*
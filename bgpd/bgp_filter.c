@@ -84,6 +84,10 @@ static struct as_list_master as_list_master = {{NULL, NULL},
 					       NULL,
 					       NULL};
 
+/* Bumped on every change to any AS list, outdating the results cached on
+ * interned AS paths. */
+static uint32_t as_list_gen = 1;
+
 /* Allocate new AS filter. */
 static struct as_filter *as_filter_new(void)
 {
@@ -137,6 +141,7 @@ static void as_list_filter_add(struct as_list *aslist,
 	else
 		aslist->head = asfilter;
 	aslist->tail = asfilter;
+	as_list_gen++;
 
 	/* Run hook function. */
 	if (as_list_master.add_hook)
@@ -304,6 +309,7 @@ static void as_list_delete(struct as_list *aslist)
 		list->head = aslist->next;
 
 	as_list_free(aslist);
+	as_list_gen++;
 }
 
 static int as_list_empty(struct as_list *aslist)
@@ -330,6 +336,7 @@ static void as_list_filter_delete(struct as_list *aslist,
 		aslist->head = asfilter->next;
 
 	as_filter_free(asfilter);
+	as_list_gen++;
 
 	/* If access_list becomes empty delete it from access_master. */
 	if (as_list_empty(aslist))
@@ -354,17 +361,37 @@ enum as_filter_type as_list_apply(struct as_list *aslist, void *object)
 {
 	struct as_filter *asfilter;
 	struct aspath *aspath;
+	enum as_filter_type type = AS_FILTER_DENY;
+	int i;
 
 	aspath = (struct aspath *)object;
 
 	if (aslist == NULL)
 		return AS_FILTER_DENY;
 
+	/* Interned paths are shared by many routes, run the regexes once */
+	if (aspath->refcnt)
+		for (i = 0; i < ASPATH_FILTER_CACHE; i++)
+			if (aspath->filter_cache[i].aslist == aslist
+			    && aspath->filter_cache[i].gen == as_list_gen)
+				return aspath->filter_cache[i].type;
+
 	for (asfilter = aslist->head; asfilter; asfilter = asfilter->next) {
-		if (as_filter_match(asfilter, aspath))
-			return asfilter->type;
+		if (as_filter_match(asfilter, aspath)) {
+			type = asfilter->type;
+			break;
+		}
+	}
+
+	if (aspath->refcnt) {
+		memmove(&aspath->filter_cache[1], &aspath->filter_cache[0],
+			sizeof(aspath->filter_cache[0])
+				* (ASPATH_FILTER_CACHE - 1));
+		aspath->filter_cache[0].aslist = aslist;
+		aspath->filter_cache[0].gen = as_list_gen;
+		aspath->filter_cache[0].type = type;
 	}
-	return AS_FILTER_DENY;
+	return type;
 }
 
 /* Add hook function. */
@@ -21,7 +21,10 @@
 #include "zebra.h"
 
 #include "prefix.h"
+#include "hash.h"
+#include "linklist.h"
 
+#include "bgp_memory.h"
 #include "bgp_table.h"
 #include "bgp_flowspec_util.h"
 #include "bgp_flowspec_private.h"
@@ -355,13 +358,18 @@ int bgp_flowspec_fragment_type_decode(enum bgp_flowspec_util_nlri_t type,
 }
 
 
-static bool bgp_flowspec_contains_prefix(struct prefix *pfs,
-					 struct prefix *input,
-					 int prefix_check)
+/*
+ * Decode the destination and source prefix components of a flowspec NLRI
+ * into prefixes[], which has room for max of them.
+ *
+ * Returns the number of prefixes found.
+ */
+static int bgp_flowspec_prefixes(struct prefix *pfs, struct prefix *prefixes,
+				 int max)
 {
 	uint32_t offset = 0;
 	int type;
-	int ret = 0, error = 0;
+	int ret = 0, error = 0, count = 0;
 	uint8_t *nlri_content = (uint8_t *)pfs->u.prefix_flowspec.ptr;
 	size_t len = pfs->u.prefix_flowspec.prefixlen;
 	struct prefix compare;
@@ -379,21 +387,10 @@ static bool bgp_flowspec_contains_prefix(struct prefix *pfs,
 					nlri_content+offset,
 					len - offset,
 					&compare, &error);
-			if (ret <= 0)
-				break;
-			if (prefix_check &&
-			    compare.prefixlen != input->prefixlen)
+			if (ret <= 0 || error < 0)
 				break;
-			if (compare.family != input->family)
-				break;
-			if ((input->family == AF_INET) &&
-			    IPV4_ADDR_SAME(&input->u.prefix4,
-					   &compare.u.prefix4))
-				return true;
-			if ((input->family == AF_INET6) &&
-			    IPV6_ADDR_SAME(&input->u.prefix6.s6_addr,
-					   &compare.u.prefix6.s6_addr))
-				return true;
+			if (count < max)
+				prefixes[count++] = compare;
 			break;
 		case FLOWSPEC_IP_PROTOCOL:
 		case FLOWSPEC_PORT:
@@ -434,7 +431,147 @@ static bool bgp_flowspec_contains_prefix(struct prefix *pfs,
 		}
 		offset += ret;
 	}
-	return false;
+	return count;
+}
+
+/*
+ * Flowspec tables keep an index of their rules by the addresses of their
+ * destination and source prefix components, so that looking up the rules
+ * for an address does not mean decoding every rule in the table.  Rules are
+ * decoded once, when the first path for them is added to the table.
+ */
+struct bgp_flowspec_index {
+	/* family and address, prefixlen is always the full length */
+	struct prefix p;
+
+	/* struct bgp_flowspec_index_rule, in the order they were added */
+	struct list *rules;
+};
+
+struct bgp_flowspec_index_rule {
+	struct bgp_node *rn;
+
+	/* of the component the rule was indexed by */
+	uint8_t prefixlen;
+};
+
+static unsigned int bgp_flowspec_index_key(void *data)
+{
+	struct bgp_flowspec_index *fsi = data;
+
+	return prefix_hash_key(&fsi->p);
+}
+
+static int bgp_flowspec_index_cmp(const void *d1, const void *d2)
+{
+	const struct bgp_flowspec_index *fsi1 = d1;
+	const struct bgp_flowspec_index *fsi2 = d2;
+
+	return prefix_same(&fsi1->p, &fsi2->p);
+}
+
+static void bgp_flowspec_index_rule_free(void *data)
+{
+	XFREE(MTYPE_BGP_FLOWSPEC_INDEX, data);
+}
+
+static void *bgp_flowspec_index_alloc(void *data)
+{
+	struct bgp_flowspec_index *key = data;
+	struct bgp_flowspec_index *fsi;
+
+	fsi = XCALLOC(MTYPE_BGP_FLOWSPEC_INDEX, sizeof(*fsi));
+	fsi->p = key->p;
+	fsi->rules = list_new();
+	fsi->rules->del = bgp_flowspec_index_rule_free;
+	return fsi;
+}
+
+static void bgp_flowspec_index_free(void *data)
+{
+	struct bgp_flowspec_index *fsi = data;
+
+	list_delete_and_null(&fsi->rules);
+	XFREE(MTYPE_BGP_FLOWSPEC_INDEX, fsi);
+}
+
+/* The index key for the address of a prefix component */
+static void bgp_flowspec_index_prefix(struct prefix *key, struct prefix *p)
+{
+	memset(key, 0, sizeof(*key));
+	key->family = p->family;
+	key->prefixlen = prefix_blen(p) * 8;
+	memcpy(&key->u.prefix, &p->u.prefix, prefix_blen(p));
+}
+
+void bgp_flowspec_index_add(struct bgp_table *table, struct bgp_node *rn)
+{
+	struct prefix prefixes[2];
+	struct bgp_flowspec_index key, *fsi;
+	struct bgp_flowspec_index_rule *rule;
+	int i, count;
+
+	if (rn->p.family != AF_FLOWSPEC)
+		return;
+
+	if (!table->flowspec_index)
+		table->flowspec_index =
+			hash_create(bgp_flowspec_index_key,
+				    bgp_flowspec_index_cmp,
+				    "BGP flowspec rule index");
+
+	count = bgp_flowspec_prefixes(&rn->p, prefixes, array_size(prefixes));
+	for (i = 0; i < count; i++) {
+		bgp_flowspec_index_prefix(&key.p, &prefixes[i]);
+		fsi = hash_get(table->flowspec_index, &key,
+			       bgp_flowspec_index_alloc);
+
+		rule = XCALLOC(MTYPE_BGP_FLOWSPEC_INDEX, sizeof(*rule));
+		rule->rn = rn;
+		rule->prefixlen = prefixes[i].prefixlen;
+		listnode_add(fsi->rules, rule);
+	}
+}
+
+void bgp_flowspec_index_del(struct bgp_table *table, struct bgp_node *rn)
+{
+	struct prefix prefixes[2];
+	struct bgp_flowspec_index key, *fsi;
+	struct bgp_flowspec_index_rule *rule;
+	struct listnode *node, *nnode;
+	int i, count;
+
+	if (rn->p.family != AF_FLOWSPEC || !table->flowspec_index)
+		return;
+
+	count = bgp_flowspec_prefixes(&rn->p, prefixes, array_size(prefixes));
+	for (i = 0; i < count; i++) {
+		bgp_flowspec_index_prefix(&key.p, &prefixes[i]);
+		fsi = hash_lookup(table->flowspec_index, &key);
+		if (!fsi)
+			continue;
+
+		for (ALL_LIST_ELEMENTS(fsi->rules, node, nnode, rule))
+			if (rule->rn == rn) {
+				list_delete_node(fsi->rules, node);
+				bgp_flowspec_index_rule_free(rule);
+			}
+
+		if (!listcount(fsi->rules)) {
+			hash_release(table->flowspec_index, fsi);
+			bgp_flowspec_index_free(fsi);
+		}
+	}
+}
+
+void bgp_flowspec_index_finish(struct bgp_table *table)
+{
+	if (!table->flowspec_index)
+		return;
+
+	hash_clean(table->flowspec_index, bgp_flowspec_index_free);
+	hash_free(table->flowspec_index);
+	table->flowspec_index = NULL;
 }
 
 struct bgp_node *bgp_flowspec_get_match_per_ip(afi_t afi,
@@ -442,17 +579,24 @@ struct bgp_node *bgp_flowspec_get_match_per_ip(afi_t afi,
 					       struct prefix *match,
 					       int prefix_check)
 {
-	struct bgp_node *rn;
-	struct prefix *prefix;
+	struct bgp_flowspec_index key, *fsi;
+	struct bgp_flowspec_index_rule *rule;
+	struct listnode *node;
+
+	if (!rib->flowspec_index)
+		return NULL;
 
-	for (rn = bgp_table_top(rib); rn; rn = bgp_route_next(rn)) {
-		prefix = &rn->p;
+	bgp_flowspec_index_prefix(&key.p, match);
+	fsi = hash_lookup(rib->flowspec_index, &key);
+	if (!fsi)
+		return NULL;
 
-		if (prefix->family != AF_FLOWSPEC)
+	for (ALL_LIST_ELEMENTS_RO(fsi->rules, node, rule)) {
+		if (prefix_check && rule->prefixlen != match->prefixlen)
 			continue;
 
-		if (bgp_flowspec_contains_prefix(prefix, match, prefix_check))
-			return rn;
+		bgp_lock_node(rule->rn);
+		return rule->rn;
 	}
 	return NULL;
 }
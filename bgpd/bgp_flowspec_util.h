@@ -51,6 +51,12 @@ extern int bgp_flowspec_fragment_type_decode(enum bgp_flowspec_util_nlri_t type,
 					     uint32_t max_len,
 					     void *result, int *error);
 
+extern void bgp_flowspec_index_add(struct bgp_table *table,
+				   struct bgp_node *rn);
+extern void bgp_flowspec_index_del(struct bgp_table *table,
+				   struct bgp_node *rn);
+extern void bgp_flowspec_index_finish(struct bgp_table *table);
+
 extern struct bgp_node *bgp_flowspec_get_match_per_ip(afi_t afi,
 						      struct bgp_table *rib,
 						      struct prefix *match,
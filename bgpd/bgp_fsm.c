@@ -55,6 +55,7 @@
 
 DEFINE_HOOK(peer_backward_transition, (struct peer * peer), (peer))
 DEFINE_HOOK(peer_established, (struct peer * peer), (peer))
+DEFINE_HOOK(peer_status_changed, (struct peer * peer), (peer))
 
 /* Definition of display strings corresponding to FSM events. This should be
  * kept consistent with the events defined in bgpd.h
@@ -174,12 +175,12 @@ static struct peer *peer_xfer_conn(struct peer *from_peer)
 		}
 
 		// copy each packet from old peer's output queue to new peer
-		while (from_peer->obuf->head)
+		while (stream_fifo_head(from_peer->obuf))
 			stream_fifo_push(peer->obuf,
 					 stream_fifo_pop(from_peer->obuf));
 
 		// copy each packet from old peer's input queue to new peer
-		while (from_peer->ibuf->head)
+		while (stream_fifo_head(from_peer->ibuf))
 			stream_fifo_push(peer->ibuf,
 					 stream_fifo_pop(from_peer->ibuf));
 
@@ -459,6 +460,16 @@ static int bgp_holdtime_timer(struct thread *thread)
 	return 0;
 }
 
+/* Hold timers, and the input that keeps them from expiring, run ahead of
+ * route processing. */
+void bgp_fsm_init(void)
+{
+	thread_set_func_class(bm->master, bgp_holdtime_timer,
+			      THREAD_CLASS_CRITICAL);
+	thread_set_func_class(bm->master, bgp_process_packet,
+			      THREAD_CLASS_CRITICAL);
+}
+
 int bgp_routeadv_timer(struct thread *thread)
 {
 	struct peer *peer;
@@ -561,6 +572,19 @@ static int bgp_graceful_stale_timer_expire(struct thread *thread)
 	return 0;
 }
 
+/* For paths that are stale before the session ever came up. */
+void bgp_graceful_stale_timer_start(struct peer *peer)
+{
+	if (peer->t_gr_stale)
+		return;
+
+	if (bgp_debug_neighbor_events(peer))
+		zlog_debug("%s graceful restart stalepath timer started for %d sec",
+			   peer->host, peer->bgp->stalepath_time);
+	BGP_TIMER_ON(peer->t_gr_stale, bgp_graceful_stale_timer_expire,
+		     peer->bgp->stalepath_time);
+}
+
 static int bgp_update_delay_applicable(struct bgp *bgp)
 {
 	/* update_delay_over flag should be reset (set to 0) for any new
@@ -589,10 +613,23 @@ int bgp_update_delay_configured(struct bgp *bgp)
 	return 0;
 }
 
+/* Is best-path selection and peer advertisement held by the update-delay?
+   With "update-delay fib-only" only the zebra installs are held. */
+int bgp_update_delay_read_only(struct bgp *bgp)
+{
+	if (bgp_update_delay_active(bgp)
+	    && !bgp_flag_check(bgp, BGP_FLAG_UPDATE_DELAY_FIB_ONLY))
+		return 1;
+
+	return 0;
+}
+
 /* Do the post-processing needed when bgp comes out of the read-only mode
    on ending the update delay. */
 void bgp_update_delay_end(struct bgp *bgp)
 {
+	int read_only = bgp_update_delay_read_only(bgp);
+
 	THREAD_TIMER_OFF(bgp->t_update_delay);
 	THREAD_TIMER_OFF(bgp->t_establish_wait);
 
@@ -627,6 +664,14 @@ void bgp_update_delay_end(struct bgp *bgp)
 	 */
 	bgp_add_eoiu_mark(bgp);
 	bgp->main_zebra_update_hold = 1;
+
+	/* In fib-only mode the best-paths were kept current and peers were
+	   advertised to all along; only zebra was held, since the start of
+	   the delay, and the eoiu mark pushes the final table to it once the
+	   work already queued is done. */
+	if (!read_only)
+		return;
+
 	bgp->main_peers_update_hold = 1;
 
 	/* Resume the queue processing. This should trigger the event that would
@@ -867,8 +912,13 @@ static void bgp_update_delay_begin(struct bgp *bgp)
 	struct listnode *node, *nnode;
 	struct peer *peer;
 
-	/* Stop the processing of queued work. Enqueue shall continue */
-	work_queue_plug(bm->process_main_queue);
+	/* Stop the processing of queued work. Enqueue shall continue. In
+	   fib-only mode keep selecting, but hold the zebra installs until the
+	   delay ends. */
+	if (bgp_flag_check(bgp, BGP_FLAG_UPDATE_DELAY_FIB_ONLY))
+		bgp->main_zebra_update_hold = 1;
+	else
+		work_queue_plug(bm->process_main_queue);
 
 	for (ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer))
 		peer->update_delay_over = 0;
@@ -944,7 +994,7 @@ void bgp_fsm_change_status(struct peer *peer, int status)
 		 * Clearing
 		 * (or Deleted).
 		 */
-		if (!work_queue_is_scheduled(peer->clear_node_queue))
+		if (!bgp_clear_route_pending(peer))
 			BGP_EVENT_ADD(peer, Clearing_Completed);
 	}
 
@@ -976,6 +1026,8 @@ void bgp_fsm_change_status(struct peer *peer, int status)
 		zlog_debug("%s went from %s to %s", peer->host,
 			   lookup_msg(bgp_status_msg, peer->ostatus, NULL),
 			   lookup_msg(bgp_status_msg, peer->status, NULL));
+
+	hook_call(peer_status_changed, peer);
 }
 
 /* Flush the event queue and ensure the peer is shut down */
@@ -1113,6 +1165,8 @@ int bgp_stop(struct peer *peer)
 	}
 	pthread_mutex_unlock(&peer->io_mtx);
 
+	bgp_update_attr_cache_flush(peer);
+
 	/* Close of file descriptor. */
 	if (peer->fd >= 0) {
 		close(peer->fd);
@@ -1633,7 +1687,7 @@ static int bgp_establish(struct peer *peer)
 	 * end
 	 * of read-only mode.
 	 */
-	if (!bgp_update_delay_active(peer->bgp)) {
+	if (!bgp_update_delay_read_only(peer->bgp)) {
 		BGP_TIMER_OFF(peer->t_routeadv);
 		BGP_TIMER_ON(peer->t_routeadv, bgp_routeadv_timer, 0);
 	}
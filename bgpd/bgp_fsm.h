@@ -63,7 +63,9 @@ extern int bgp_event_update(struct peer *, int event);
 extern int bgp_stop(struct peer *peer);
 extern void bgp_timer_set(struct peer *);
 extern int bgp_routeadv_timer(struct thread *);
+extern void bgp_fsm_init(void);
 extern void bgp_fsm_change_status(struct peer *peer, int status);
+extern void bgp_graceful_stale_timer_start(struct peer *peer);
 extern const char *peer_down_str[];
 extern void bgp_update_delay_end(struct bgp *);
 extern void bgp_maxmed_update(struct bgp *);
@@ -89,5 +91,6 @@ extern void bgp_adjust_routeadv(struct peer *);
 #include "hook.h"
 DECLARE_HOOK(peer_backward_transition, (struct peer * peer), (peer))
 DECLARE_HOOK(peer_established, (struct peer * peer), (peer))
+DECLARE_HOOK(peer_status_changed, (struct peer * peer), (peer))
 
 #endif /* _QUAGGA_BGP_FSM_H */
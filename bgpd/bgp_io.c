@@ -28,8 +28,10 @@
 #include "log.h"		// for zlog_debug, safe_strerror, zlog_err
 #include "memory.h"		// for MTYPE_TMP, XCALLOC, XFREE
 #include "network.h"		// for ERRNO_IO_RETRY
+#include "pipeline_stats.h"	// for pipeline_now
 #include "stream.h"		// for stream_get_endp, stream_getw_from, str...
 #include "ringbuf.h"		// for ringbuf_remain, ringbuf_peek, ringbuf_...
+#include "sockopt.h"		// for sockopt_tcp_quickack
 #include "thread.h"		// for THREAD_OFF, THREAD_ARG, thread, thread...
 #include "zassert.h"		// for assert
 
@@ -51,11 +53,116 @@ static bool validate_header(struct peer *);
 #define BGP_IO_TRANS_ERR (1 << 0) // EAGAIN or similar occurred
 #define BGP_IO_FATAL_ERR (1 << 1) // some kind of fatal TCP error
 
+/*
+ * Free list of BGP_MAX_PACKET_SIZE streams used to hand received packets from
+ * the I/O pthread to the main pthread. Filled by bgp_io_pkt_free() once
+ * bgp_process_packet() is done with a packet, drained by bgp_io_pkt_new().
+ */
+#define BGP_IO_PKT_POOL_MAX 1024U
+static struct stream_fifo pkt_pool;
+static pthread_mutex_t pkt_pool_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * I/O pthreads peers are spread over, and how many peers each one serves.
+ * Only touched from the main pthread. The first is PTHREAD_IO, which
+ * bgp_pthreads_run() starts; the others are started on demand once it runs.
+ */
+static struct bgp_io_thread {
+	struct frr_pthread *fpt;
+	unsigned int peers;
+} io_threads[BGP_IO_THREADS_MAX];
+static unsigned int io_threads_started;
+
+/*
+ * Pick the pthread doing a peer's I/O when it is turned on: the one
+ * configured for it or its peer-group if any, else the one with the fewest
+ * peers among the first bm->io_threads. It stays the same until both reads
+ * and writes are off again.
+ */
+static struct frr_pthread *bgp_io_pthread_get(struct peer *peer)
+{
+	unsigned int i, best = 0;
+	unsigned int active = MIN(bm->io_threads, io_threads_started);
+	int cfg = peer->io_thread_cfg;
+
+	if (peer->io_pthread)
+		return peer->io_pthread;
+
+	if (cfg < 0 && peer_group_active(peer))
+		cfg = peer->group->conf->io_thread_cfg;
+
+	if (cfg >= 0 && (unsigned int)cfg < io_threads_started)
+		best = cfg;
+	else
+		for (i = 1; i < active; i++)
+			if (io_threads[i].peers < io_threads[best].peers)
+				best = i;
+
+	io_threads[best].peers++;
+	peer->io_index = best;
+	peer->io_pthread = io_threads[best].fpt;
+	return peer->io_pthread;
+}
+
+static void bgp_io_pthread_put(struct peer *peer)
+{
+	if (!peer->io_pthread
+	    || CHECK_FLAG(peer->thread_flags,
+			  PEER_THREAD_WRITES_ON | PEER_THREAD_READS_ON))
+		return;
+
+	io_threads[peer->io_index].peers--;
+	peer->io_pthread = NULL;
+}
+
+static void bgp_io_threads_adjust(void)
+{
+	struct frr_pthread *fpt;
+	char name[32];
+	unsigned int i;
+
+	for (i = io_threads_started; i < bm->io_threads; i++) {
+		struct frr_pthread_attr attr = {
+			.id = PTHREAD_IO_EXTRA(i),
+			.start = frr_pthread_attr_default.start,
+			.stop = frr_pthread_attr_default.stop,
+		};
+
+		snprintf(name, sizeof(name), "BGP I/O thread %u", i + 1);
+		fpt = frr_pthread_new(&attr, name);
+		if (!fpt || frr_pthread_run(fpt, NULL) < 0) {
+			zlog_err("%s: could not start %s", __func__, name);
+			if (fpt)
+				frr_pthread_destroy(fpt);
+			break;
+		}
+		frr_pthread_wait_running(fpt);
+
+		io_threads[i].fpt = fpt;
+		io_threads_started = i + 1;
+	}
+}
+
 /* Thread external API ----------------------------------------------------- */
 
+void bgp_io_threads_set(unsigned int count)
+{
+	bm->io_threads = count;
+
+	if (io_threads_started)
+		bgp_io_threads_adjust();
+}
+
+void bgp_io_threads_run(void)
+{
+	io_threads[0].fpt = frr_pthread_get(PTHREAD_IO);
+	io_threads_started = 1;
+	bgp_io_threads_adjust();
+}
+
 void bgp_writes_on(struct peer *peer)
 {
-	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_IO);
+	struct frr_pthread *fpt = bgp_io_pthread_get(peer);
 	assert(fpt->running);
 
 	assert(peer->status != Deleted);
@@ -73,18 +180,21 @@ void bgp_writes_on(struct peer *peer)
 
 void bgp_writes_off(struct peer *peer)
 {
-	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_IO);
-	assert(fpt->running);
+	struct frr_pthread *fpt = peer->io_pthread;
 
-	thread_cancel_async(fpt->master, &peer->t_write, NULL);
+	if (fpt) {
+		assert(fpt->running);
+		thread_cancel_async(fpt->master, &peer->t_write, NULL);
+	}
 	THREAD_OFF(peer->t_generate_updgrp_packets);
 
 	UNSET_FLAG(peer->thread_flags, PEER_THREAD_WRITES_ON);
+	bgp_io_pthread_put(peer);
 }
 
 void bgp_reads_on(struct peer *peer)
 {
-	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_IO);
+	struct frr_pthread *fpt = bgp_io_pthread_get(peer);
 	assert(fpt->running);
 
 	assert(peer->status != Deleted);
@@ -104,13 +214,60 @@ void bgp_reads_on(struct peer *peer)
 
 void bgp_reads_off(struct peer *peer)
 {
-	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_IO);
-	assert(fpt->running);
+	struct frr_pthread *fpt = peer->io_pthread;
 
-	thread_cancel_async(fpt->master, &peer->t_read, NULL);
+	if (fpt) {
+		assert(fpt->running);
+		thread_cancel_async(fpt->master, &peer->t_read, NULL);
+	}
 	THREAD_OFF(peer->t_process_packet);
 
 	UNSET_FLAG(peer->thread_flags, PEER_THREAD_READS_ON);
+	bgp_io_pthread_put(peer);
+}
+
+struct stream *bgp_io_pkt_new(void)
+{
+	struct stream *pkt;
+
+	pthread_mutex_lock(&pkt_pool_mtx);
+	{
+		pkt = stream_fifo_pop(&pkt_pool);
+	}
+	pthread_mutex_unlock(&pkt_pool_mtx);
+
+	return pkt ? pkt : stream_new(BGP_MAX_PACKET_SIZE);
+}
+
+void bgp_io_pkt_free(struct stream *pkt)
+{
+	if (STREAM_SIZE(pkt) != BGP_MAX_PACKET_SIZE) {
+		stream_free(pkt);
+		return;
+	}
+
+	stream_reset(pkt);
+
+	pthread_mutex_lock(&pkt_pool_mtx);
+	{
+		if (pkt_pool.count < BGP_IO_PKT_POOL_MAX) {
+			stream_fifo_push(&pkt_pool, pkt);
+			pkt = NULL;
+		}
+	}
+	pthread_mutex_unlock(&pkt_pool_mtx);
+
+	if (pkt)
+		stream_free(pkt);
+}
+
+void bgp_io_pkt_pool_clean(void)
+{
+	pthread_mutex_lock(&pkt_pool_mtx);
+	{
+		stream_fifo_clean(&pkt_pool);
+	}
+	pthread_mutex_unlock(&pkt_pool_mtx);
 }
 
 /* Thread internal functions ----------------------------------------------- */
@@ -120,8 +277,7 @@ void bgp_reads_off(struct peer *peer)
  */
 static int bgp_process_writes(struct thread *thread)
 {
-	static struct peer *peer;
-	peer = THREAD_ARG(thread);
+	struct peer *peer = THREAD_ARG(thread);
 	uint16_t status;
 	bool reschedule;
 	bool fatal = false;
@@ -129,8 +285,6 @@ static int bgp_process_writes(struct thread *thread)
 	if (peer->fd < 0)
 		return -1;
 
-	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_IO);
-
 	pthread_mutex_lock(&peer->io_mtx);
 	{
 		status = bgp_write(peer);
@@ -149,7 +303,7 @@ static int bgp_process_writes(struct thread *thread)
 	}
 
 	if (reschedule) {
-		thread_add_write(fpt->master, bgp_process_writes, peer,
+		thread_add_write(thread->master, bgp_process_writes, peer,
 				 peer->fd, &peer->t_write);
 	} else if (!fatal) {
 		BGP_TIMER_ON(peer->t_generate_updgrp_packets,
@@ -169,7 +323,7 @@ static int bgp_process_writes(struct thread *thread)
 static int bgp_process_reads(struct thread *thread)
 {
 	/* clang-format off */
-	static struct peer *peer;	// peer to read from
+	struct peer *peer;		// peer to read from
 	uint16_t status;		// bgp_read status code
 	bool more = true;		// whether we got more data
 	bool fatal = false;		// whether fatal error occurred
@@ -182,8 +336,6 @@ static int bgp_process_reads(struct thread *thread)
 	if (peer->fd < 0)
 		return -1;
 
-	struct frr_pthread *fpt = frr_pthread_get(PTHREAD_IO);
-
 	pthread_mutex_lock(&peer->io_mtx);
 	{
 		status = bgp_read(peer);
@@ -203,8 +355,6 @@ static int bgp_process_reads(struct thread *thread)
 	}
 
 	while (more) {
-		/* static buffer for transferring packets */
-		static unsigned char pktbuf[BGP_MAX_PACKET_SIZE];
 		/* shorter alias to peer's input buffer */
 		struct ringbuf *ibw = peer->ibuf_work;
 		/* packet size as given by header */
@@ -231,25 +381,32 @@ static int bgp_process_reads(struct thread *thread)
 		assert(pktsize <= BGP_MAX_PACKET_SIZE);
 
 		/*
-		 * If we have that much data, chuck it into its own
+		 * If we have that much data, pull it straight into a pooled
 		 * stream and append to input queue for processing.
 		 */
 		if (ringbuf_remain(ibw) >= pktsize) {
-			struct stream *pkt = stream_new(pktsize);
-			assert(ringbuf_get(ibw, pktbuf, pktsize) == pktsize);
-			stream_put(pkt, pktbuf, pktsize);
+			struct stream *pkt = bgp_io_pkt_new();
+			assert(ringbuf_get(ibw, STREAM_DATA(pkt), pktsize)
+			       == pktsize);
+			stream_set_endp(pkt, pktsize);
 
-			pthread_mutex_lock(&peer->io_mtx);
-			{
-				stream_fifo_push(peer->ibuf, pkt);
-			}
-			pthread_mutex_unlock(&peer->io_mtx);
+			stream_fifo_push(peer->ibuf, pkt);
 
 			added_pkt = true;
 		} else
 			break;
 	}
 
+	/* the oldest packets waiting, for sampled pipeline latency */
+	if (added_pkt && atomic_load_explicit(&bm->pipeline_sample,
+					      memory_order_relaxed)) {
+		int64_t none = 0;
+
+		atomic_compare_exchange_strong_explicit(
+			&peer->ibuf_rx_usec, &none, pipeline_now(),
+			memory_order_relaxed, memory_order_relaxed);
+	}
+
 	assert(ringbuf_space(peer->ibuf_work) >= BGP_MAX_PACKET_SIZE);
 
 	/* handle invalid header */
@@ -257,8 +414,8 @@ static int bgp_process_reads(struct thread *thread)
 		/* wipe buffer just in case someone screwed up */
 		ringbuf_wipe(peer->ibuf_work);
 	} else {
-		thread_add_read(fpt->master, bgp_process_reads, peer, peer->fd,
-				&peer->t_read);
+		thread_add_read(thread->master, bgp_process_reads, peer,
+				peer->fd, &peer->t_read);
 		if (added_pkt)
 			thread_add_timer_msec(bm->master, bgp_process_packet,
 					      peer, 0, &peer->t_process_packet);
@@ -273,8 +430,11 @@ static int bgp_process_reads(struct thread *thread)
  * This function pops packets off of peer->obuf and writes them to peer->fd.
  * The amount of packets written is equal to the minimum of peer->wpkt_quanta
  * and the number of packets on the output buffer, unless an error occurs.
+ * Queued packets are handed to the kernel together with writev(), so that
+ * a burst of small UPDATEs costs one syscall rather than one each; packets
+ * may be stream chains, see bpacket_reformat_for_peer().
  *
- * If write() returns an error, the appropriate FSM event is generated.
+ * If writev() returns an error, the appropriate FSM event is generated.
  *
  * The return value is equal to the number of packets written
  * (which may be zero).
@@ -283,7 +443,10 @@ static uint16_t bgp_write(struct peer *peer)
 {
 	uint8_t type;
 	struct stream *s;
-	int num;
+	struct iovec iov[BGP_WRITE_IOV_MAX];
+	int iovcnt, pktcnt, n;
+	ssize_t num;
+	size_t writenum;
 	int update_last_write = 0;
 	unsigned int count = 0;
 	uint32_t uo = 0;
@@ -292,77 +455,113 @@ static uint16_t bgp_write(struct peer *peer)
 
 	wpkt_quanta_old = atomic_load_explicit(&peer->bgp->wpkt_quanta,
 					       memory_order_relaxed);
+	wpkt_quanta_old = MIN(wpkt_quanta_old, BGP_WRITE_PACKET_MAX);
 
 	while (count < wpkt_quanta_old && (s = stream_fifo_head(peer->obuf))) {
-		int writenum;
+		/*
+		 * Gather what is left of the quanta; nothing may follow a
+		 * NOTIFICATION, the session is over once it is out.
+		 */
+		iovcnt = pktcnt = 0;
 		do {
-			writenum = stream_get_endp(s) - stream_get_getp(s);
-			num = write(peer->fd, STREAM_PNT(s), writenum);
+			n = stream_chain_iov(s, iov + iovcnt,
+					     BGP_WRITE_IOV_MAX - iovcnt);
+			if (!n)
+				break;
+			iovcnt += n;
+			pktcnt++;
+
+			if (stream_getc_from(s, BGP_MARKER_SIZE + 2)
+			    == BGP_MSG_NOTIFY)
+				break;
+		} while (count + pktcnt < wpkt_quanta_old
+			 && (s = stream_fifo_next(peer->obuf, s)));
+		assert(iovcnt);
+
+		num = writev(peer->fd, iov, iovcnt);
+
+		if (num < 0) {
+			if (!ERRNO_IO_RETRY(errno)) {
+				BGP_EVENT_ADD(peer, TCP_fatal_error);
+				SET_FLAG(status, BGP_IO_FATAL_ERR);
+			} else {
+				SET_FLAG(status, BGP_IO_TRANS_ERR);
+			}
 
-			if (num < 0) {
-				if (!ERRNO_IO_RETRY(errno)) {
-					BGP_EVENT_ADD(peer, TCP_fatal_error);
-					SET_FLAG(status, BGP_IO_FATAL_ERR);
-				} else {
-					SET_FLAG(status, BGP_IO_TRANS_ERR);
-				}
+			goto done;
+		}
 
-				goto done;
-			} else if (num != writenum)
-				stream_forward_getp(s, num);
+		atomic_fetch_add_explicit(&peer->write_calls, 1,
+					  memory_order_relaxed);
 
-		} while (num != writenum);
+		/* Retire the packets that went out in full. */
+		while (num > 0) {
+			s = stream_fifo_head(peer->obuf);
+			writenum = stream_chain_readable(s);
 
-		/* Retrieve BGP packet type. */
-		stream_set_getp(s, BGP_MARKER_SIZE + 2);
-		type = stream_getc(s);
+			if ((size_t)num < writenum) {
+				/* the rest goes out with the next writev() */
+				stream_chain_forward_getp(s, num);
+				break;
+			}
+			num -= writenum;
 
-		switch (type) {
-		case BGP_MSG_OPEN:
-			atomic_fetch_add_explicit(&peer->open_out, 1,
+			atomic_fetch_add_explicit(&peer->write_pkts, 1,
 						  memory_order_relaxed);
-			break;
-		case BGP_MSG_UPDATE:
-			atomic_fetch_add_explicit(&peer->update_out, 1,
-						  memory_order_relaxed);
-			uo++;
-			break;
-		case BGP_MSG_NOTIFY:
-			atomic_fetch_add_explicit(&peer->notify_out, 1,
-						  memory_order_relaxed);
-			/* Double start timer. */
-			peer->v_start *= 2;
-
-			/* Overflow check. */
-			if (peer->v_start >= (60 * 2))
-				peer->v_start = (60 * 2);
-
-			/*
-			 * Handle Graceful Restart case where the state changes
-			 * to Connect instead of Idle.
-			 */
-			BGP_EVENT_ADD(peer, BGP_Stop);
-			goto done;
 
-		case BGP_MSG_KEEPALIVE:
-			atomic_fetch_add_explicit(&peer->keepalive_out, 1,
-						  memory_order_relaxed);
-			break;
-		case BGP_MSG_ROUTE_REFRESH_NEW:
-		case BGP_MSG_ROUTE_REFRESH_OLD:
-			atomic_fetch_add_explicit(&peer->refresh_out, 1,
-						  memory_order_relaxed);
-			break;
-		case BGP_MSG_CAPABILITY:
-			atomic_fetch_add_explicit(&peer->dynamic_cap_out, 1,
-						  memory_order_relaxed);
-			break;
-		}
+			/* Retrieve BGP packet type. */
+			stream_set_getp(s, BGP_MARKER_SIZE + 2);
+			type = stream_getc(s);
+
+			switch (type) {
+			case BGP_MSG_OPEN:
+				atomic_fetch_add_explicit(&peer->open_out, 1,
+							  memory_order_relaxed);
+				break;
+			case BGP_MSG_UPDATE:
+				atomic_fetch_add_explicit(&peer->update_out, 1,
+							  memory_order_relaxed);
+				uo++;
+				break;
+			case BGP_MSG_NOTIFY:
+				atomic_fetch_add_explicit(&peer->notify_out, 1,
+							  memory_order_relaxed);
+				/* Double start timer. */
+				peer->v_start *= 2;
+
+				/* Overflow check. */
+				if (peer->v_start >= (60 * 2))
+					peer->v_start = (60 * 2);
+
+				/*
+				 * Handle Graceful Restart case where the state
+				 * changes to Connect instead of Idle.
+				 */
+				BGP_EVENT_ADD(peer, BGP_Stop);
+				goto done;
 
-		count++;
+			case BGP_MSG_KEEPALIVE:
+				atomic_fetch_add_explicit(&peer->keepalive_out,
+							  1,
+							  memory_order_relaxed);
+				break;
+			case BGP_MSG_ROUTE_REFRESH_NEW:
+			case BGP_MSG_ROUTE_REFRESH_OLD:
+				atomic_fetch_add_explicit(&peer->refresh_out, 1,
+							  memory_order_relaxed);
+				break;
+			case BGP_MSG_CAPABILITY:
+				atomic_fetch_add_explicit(
+					&peer->dynamic_cap_out, 1,
+					memory_order_relaxed);
+				break;
+			}
 
-		stream_free(stream_fifo_pop(peer->obuf));
-		update_last_write = 1;
+			count++;
+
+			stream_free(stream_fifo_pop(peer->obuf));
+			update_last_write = 1;
+		}
 	}
 
 done : {
@@ -391,13 +590,13 @@ done : {
  */
 static uint16_t bgp_read(struct peer *peer)
 {
-	size_t readsize; // how many bytes we want to read
-	ssize_t nbytes;  // how many bytes we actually read
+	struct iovec iov[2]; // free space of the input ring
+	ssize_t nbytes;      // how many bytes we actually read
 	uint16_t status = 0;
-	static uint8_t ibw[BGP_MAX_PACKET_SIZE * BGP_READ_PACKET_MAX];
 
-	readsize = MIN(ringbuf_space(peer->ibuf_work), sizeof(ibw));
-	nbytes = read(peer->fd, ibw, readsize);
+	/* read straight into the ring, both spans if it wraps */
+	ringbuf_reserve(peer->ibuf_work, iov);
+	nbytes = readv(peer->fd, iov, iov[1].iov_len ? 2 : 1);
 
 	/* EAGAIN or EWOULDBLOCK; come back later */
 	if (nbytes < 0 && ERRNO_IO_RETRY(errno)) {
@@ -434,8 +633,10 @@ static uint16_t bgp_read(struct peer *peer)
 		BGP_EVENT_ADD(peer, TCP_connection_closed);
 		SET_FLAG(status, BGP_IO_FATAL_ERR);
 	} else {
-		assert(ringbuf_put(peer->ibuf_work, ibw, nbytes)
-		       == (size_t)nbytes);
+		ringbuf_commit(peer->ibuf_work, nbytes);
+		/* quick acks have to be asked for again after each read */
+		if (bgp_flag_check(peer->bgp, BGP_FLAG_TCP_QUICKACK))
+			sockopt_tcp_quickack(peer->fd, 1);
 	}
 
 	return status;
@@ -453,24 +654,31 @@ static bool validate_header(struct peer *peer)
 	uint16_t size;
 	uint8_t type;
 	struct ringbuf *pkt = peer->ibuf_work;
+	const uint8_t *hdr;
 
 	static uint8_t m_correct[BGP_MARKER_SIZE] = {
 		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 		0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
-	uint8_t m_rx[BGP_MARKER_SIZE] = {0x00};
-
-	if (ringbuf_peek(pkt, 0, m_rx, BGP_MARKER_SIZE) != BGP_MARKER_SIZE)
-		return false;
+	uint8_t h_rx[BGP_HEADER_SIZE];
+
+	/* Look at the header in place, unless it wraps around the ring. */
+	hdr = ringbuf_contig(pkt, 0, BGP_HEADER_SIZE);
+	if (!hdr) {
+		if (ringbuf_peek(pkt, 0, h_rx, BGP_HEADER_SIZE)
+		    != BGP_HEADER_SIZE)
+			return false;
+		hdr = h_rx;
+	}
 
-	if (memcmp(m_correct, m_rx, BGP_MARKER_SIZE) != 0) {
+	if (memcmp(m_correct, hdr, BGP_MARKER_SIZE) != 0) {
 		bgp_notify_send(peer, BGP_NOTIFY_HEADER_ERR,
 				BGP_NOTIFY_HEADER_NOT_SYNC);
 		return false;
 	}
 
 	/* Get size and type in network byte order. */
-	ringbuf_peek(pkt, BGP_MARKER_SIZE, &size, sizeof(size));
-	ringbuf_peek(pkt, BGP_MARKER_SIZE + 2, &type, sizeof(type));
+	memcpy(&size, hdr + BGP_MARKER_SIZE, sizeof(size));
+	type = hdr[BGP_MARKER_SIZE + 2];
 
 	size = ntohs(size);
 
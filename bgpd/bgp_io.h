@@ -23,6 +23,8 @@
 #define _FRR_BGP_IO_H
 
 #define BGP_WRITE_PACKET_MAX 10U
+/* packets rewritten for a peer are chains of three segments */
+#define BGP_WRITE_IOV_MAX (BGP_WRITE_PACKET_MAX * 3)
 #define BGP_READ_PACKET_MAX  10U
 
 #include "bgpd/bgpd.h"
@@ -44,6 +46,23 @@ extern void *bgp_io_start(void *arg);
  */
 extern int bgp_io_stop(void **result, struct frr_pthread *fpt);
 
+/**
+ * Sets the number of pthreads doing peer I/O.
+ *
+ * Only the first pthread is started before bgp_io_threads_run(). Peers are
+ * spread over the first count pthreads as their I/O is turned on; lowering
+ * count does not stop pthreads already started, but no further peers are
+ * given to them unless configured so.
+ *
+ * @param count - number of pthreads, 1 to BGP_IO_THREADS_MAX
+ */
+extern void bgp_io_threads_set(unsigned int count);
+
+/**
+ * Starts the I/O pthreads past the first one, once PTHREAD_IO runs.
+ */
+extern void bgp_io_threads_run(void);
+
 /**
  * Turns on packet writing for a peer.
  *
@@ -52,6 +71,9 @@ extern int bgp_io_stop(void **result, struct frr_pthread *fpt);
  *
  * Additionally, it becomes unsafe to perform socket actions on peer->fd.
  *
+ * The peer's I/O pthread is picked when its reads or writes are first
+ * turned on, and kept until both are off.
+ *
  * @param peer - peer to register
  */
 extern void bgp_writes_on(struct peer *peer);
@@ -100,4 +122,32 @@ extern void bgp_reads_on(struct peer *peer);
  */
 extern void bgp_reads_off(struct peer *peer);
 
+/**
+ * Get a stream for a received packet.
+ *
+ * Streams are BGP_MAX_PACKET_SIZE long and come from a pool shared between
+ * the I/O pthread and the main pthread; a new one is allocated only if the
+ * pool is empty. Safe to call from any pthread.
+ *
+ * @return an empty stream
+ */
+extern struct stream *bgp_io_pkt_new(void);
+
+/**
+ * Return a received packet's stream to the pool.
+ *
+ * Streams not obtained from bgp_io_pkt_new(), or returned while the pool is
+ * full, are freed. Safe to call from any pthread.
+ *
+ * @param pkt - stream to release
+ */
+extern void bgp_io_pkt_free(struct stream *pkt);
+
+/**
+ * Free all streams held in the packet pool.
+ *
+ * Called at shutdown once the I/O pthread has stopped.
+ */
+extern void bgp_io_pkt_pool_clean(void);
+
 #endif /* _FRR_BGP_IO_H */
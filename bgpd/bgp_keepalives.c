@@ -29,6 +29,7 @@
 #include "log.h"		// for zlog_debug
 #include "memory.h"		// for MTYPE_TMP, XFREE, XCALLOC, XMALLOC
 #include "monotime.h"		// for monotime, monotime_since
+#include "pqueue.h"		// for pqueue, pqueue_enqueue, pqueue_dequeue
 
 #include "bgpd/bgpd.h"          // for peer, PEER_THREAD_KEEPALIVES_ON, peer...
 #include "bgpd/bgp_debug.h"	// for bgp_debug_neighbor_events
@@ -38,13 +39,17 @@
 
 /*
  * Peer KeepAlive Timer.
- * Associates a peer with the time of its last keepalive.
+ * Associates a peer with the time of its last and next keepalive.
  */
 struct pkat {
 	/* the peer to send keepalives to */
 	struct peer *peer;
 	/* absolute time of last keepalive sent */
 	struct timeval last;
+	/* absolute time the next keepalive is due */
+	struct timeval next;
+	/* position in peerheap, -1 if not queued */
+	int index;
 };
 
 /* List of peers we are sending keepalives for, and associated mutex. */
@@ -52,10 +57,61 @@ static pthread_mutex_t *peerhash_mtx;
 static pthread_cond_t *peerhash_cond;
 static struct hash *peerhash;
 
+/*
+ * The same peers, ordered by when their next keepalive is due, so that a
+ * tick only needs to look at the peers it actually sends a keepalive to.
+ * Protected by peerhash_mtx as well.
+ */
+static struct pqueue *peerheap;
+
+/*
+ * Keepalives due within this tolerance of a tick are sent right away. Doing
+ * this helps alleviate nanosecond sleeps between ticks by grouping together
+ * peers who are due for keepalives at roughly the same time. This tolerance
+ * value is arbitrarily chosen to be 100ms.
+ */
+static const struct timeval tolerance = {0, 100000};
+
+static int pkat_cmp(void *a, void *b)
+{
+	struct pkat *p1 = a;
+	struct pkat *p2 = b;
+
+	if (timercmp(&p1->next, &p2->next, <))
+		return -1;
+	if (timercmp(&p1->next, &p2->next, >))
+		return 1;
+	return 0;
+}
+
+static void pkat_update(void *node, int actual_position)
+{
+	struct pkat *pkat = node;
+
+	pkat->index = actual_position;
+}
+
+/*
+ * Queue the next keepalive for the peer, one keepalive interval after the
+ * last one. As RFC 4271 asks, nothing is sent if the interval is zero.
+ */
+static void pkat_schedule(struct pkat *pkat)
+{
+	struct timeval ka = {0};
+
+	ka.tv_sec = pkat->peer->v_keepalive;
+	if (!ka.tv_sec)
+		return;
+
+	timeradd(&pkat->last, &ka, &pkat->next);
+	pqueue_enqueue(pkat, peerheap);
+}
+
 static struct pkat *pkat_new(struct peer *peer)
 {
 	struct pkat *pkat = XMALLOC(MTYPE_TMP, sizeof(struct pkat));
 	pkat->peer = peer;
+	pkat->index = -1;
 	monotime(&pkat->last);
 	return pkat;
 }
@@ -65,62 +121,77 @@ static void pkat_del(void *pkat)
 	XFREE(MTYPE_TMP, pkat);
 }
 
+/* Record how far off its deadline a keepalive went out. */
+static void pkat_jitter(struct pkat *pkat, struct timeval *now)
+{
+	struct peer *peer = pkat->peer;
+	struct timeval diff;
+	uint32_t jitter, avg;
+
+	if (timercmp(now, &pkat->next, <))
+		timersub(&pkat->next, now, &diff);
+	else
+		timersub(now, &pkat->next, &diff);
+
+	if (diff.tv_sec >= 4000)
+		jitter = UINT32_MAX;
+	else
+		jitter = diff.tv_sec * 1000000 + diff.tv_usec;
+
+	/* moving average over about the last 16 keepalives */
+	avg = atomic_load_explicit(&peer->keepalive_jitter_avg,
+				   memory_order_relaxed);
+	if (!atomic_load_explicit(&peer->keepalive_jitter_cnt,
+				  memory_order_relaxed))
+		avg = jitter;
+	else
+		avg = avg - avg / 16 + jitter / 16;
+
+	atomic_store_explicit(&peer->keepalive_jitter_avg, avg,
+			      memory_order_relaxed);
+	if (jitter > atomic_load_explicit(&peer->keepalive_jitter_max,
+					  memory_order_relaxed))
+		atomic_store_explicit(&peer->keepalive_jitter_max, jitter,
+				      memory_order_relaxed);
+	atomic_fetch_add_explicit(&peer->keepalive_jitter_cnt, 1,
+				  memory_order_relaxed);
+}
 
 /*
- * Callback for hash_iterate. Determines if a peer needs a keepalive and if so,
- * generates and sends it.
+ * Sends keepalives to all peers that are due for one, or will be within the
+ * tolerance, and queues their next one.
  *
- * For any given peer, if the elapsed time since its last keepalive exceeds its
- * configured keepalive timer, a keepalive is sent to the peer and its
- * last-sent time is reset. Additionally, If the elapsed time does not exceed
- * the configured keepalive timer, but the time until the next keepalive is due
- * is within a hardcoded tolerance, a keepalive is sent as if the configured
- * timer was exceeded. Doing this helps alleviate nanosecond sleeps between
- * ticks by grouping together peers who are due for keepalives at roughly the
- * same time. This tolerance value is arbitrarily chosen to be 100ms.
- *
- * In addition, this function calculates the maximum amount of time that the
- * keepalive thread can sleep before another tick needs to take place. This is
- * equivalent to shortest time until a keepalive is due for any one peer.
- *
- * @return maximum time to wait until next update (0 if infinity)
+ * @param next_update set to the time until the next peer is due, or 0 if no
+ *        peer is queued
  */
-static void peer_process(struct hash_backet *hb, void *arg)
+static void peer_process(struct timeval *next_update)
 {
-	struct pkat *pkat = hb->data;
-
-	struct timeval *next_update = arg;
-
-	static struct timeval elapsed;  // elapsed time since keepalive
-	static struct timeval ka = {0}; // peer->v_keepalive as a timeval
-	static struct timeval diff;     // ka - elapsed
+	struct pkat *pkat;
+	struct timeval now;
 
-	static struct timeval tolerance = {0, 100000};
+	monotime(&now);
 
-	/* calculate elapsed time since last keepalive */
-	monotime_since(&pkat->last, &elapsed);
+	while (peerheap->size) {
+		pkat = peerheap->array[0];
 
-	/* calculate difference between elapsed time and configured time */
-	ka.tv_sec = pkat->peer->v_keepalive;
-	timersub(&ka, &elapsed, &diff);
+		timersub(&pkat->next, &now, next_update);
+		if (!timercmp(next_update, &tolerance, <))
+			return;
 
-	int send_keepalive =
-		elapsed.tv_sec >= ka.tv_sec || timercmp(&diff, &tolerance, <);
+		pqueue_dequeue(peerheap);
+		pkat->index = -1;
 
-	if (send_keepalive) {
 		if (bgp_debug_neighbor_events(pkat->peer))
 			zlog_debug("%s [FSM] Timer (keepalive timer expire)",
 				   pkat->peer->host);
 
 		bgp_keepalive_send(pkat->peer);
-		monotime(&pkat->last);
-		memset(&elapsed, 0x00, sizeof(struct timeval));
-		diff = ka;
+		pkat_jitter(pkat, &now);
+		pkat->last = now;
+		pkat_schedule(pkat);
 	}
 
-	/* if calculated next update for this peer < current delay, use it */
-	if (next_update->tv_sec < 0 || timercmp(&diff, next_update, <))
-		*next_update = diff;
+	memset(next_update, 0x00, sizeof(*next_update));
 }
 
 static int peer_hash_cmp(const void *f, const void *s)
@@ -144,7 +215,11 @@ static void bgp_keepalives_finish(void *arg)
 		hash_free(peerhash);
 	}
 
+	if (peerheap)
+		pqueue_delete(peerheap);
+
 	peerhash = NULL;
+	peerheap = NULL;
 
 	pthread_mutex_unlock(peerhash_mtx);
 	pthread_mutex_destroy(peerhash_mtx);
@@ -163,7 +238,6 @@ void *bgp_keepalives_start(void *arg)
 	fpt->master->owner = pthread_self();
 
 	struct timeval currtime = {0, 0};
-	struct timeval aftertime = {0, 0};
 	struct timeval next_update = {0, 0};
 	struct timespec next_update_ts = {0, 0};
 
@@ -182,6 +256,9 @@ void *bgp_keepalives_start(void *arg)
 
 	/* initialize peer hashtable */
 	peerhash = hash_create_size(2048, peer_hash_key, peer_hash_cmp, NULL);
+	peerheap = pqueue_create();
+	peerheap->cmp = pkat_cmp;
+	peerheap->update = pkat_update;
 	pthread_mutex_lock(peerhash_mtx);
 
 	/* register cleanup handler */
@@ -191,24 +268,18 @@ void *bgp_keepalives_start(void *arg)
 	frr_pthread_notify_running(fpt);
 
 	while (atomic_load_explicit(&fpt->running, memory_order_relaxed)) {
-		if (peerhash->count > 0)
+		if (peerheap->size > 0)
 			pthread_cond_timedwait(peerhash_cond, peerhash_mtx,
 					       &next_update_ts);
 		else
-			while (peerhash->count == 0
+			while (peerheap->size == 0
 			       && atomic_load_explicit(&fpt->running,
 						       memory_order_relaxed))
 				pthread_cond_wait(peerhash_cond, peerhash_mtx);
 
 		monotime(&currtime);
 
-		next_update.tv_sec = -1;
-
-		hash_iterate(peerhash, peer_process, &next_update);
-		if (next_update.tv_sec == -1)
-			memset(&next_update, 0x00, sizeof(next_update));
-
-		monotime_since(&currtime, &aftertime);
+		peer_process(&next_update);
 
 		timeradd(&currtime, &next_update, &next_update);
 		TIMEVAL_TO_TIMESPEC(&next_update, &next_update_ts);
@@ -244,6 +315,7 @@ void bgp_keepalives_on(struct peer *peer)
 		if (!hash_lookup(peerhash, &holder)) {
 			struct pkat *pkat = pkat_new(peer);
 			hash_get(peerhash, pkat, hash_alloc_intern);
+			pkat_schedule(pkat);
 			peer_lock(peer);
 		}
 		SET_FLAG(peer->thread_flags, PEER_THREAD_KEEPALIVES_ON);
@@ -273,6 +345,8 @@ void bgp_keepalives_off(struct peer *peer)
 		holder.peer = peer;
 		struct pkat *res = hash_release(peerhash, &holder);
 		if (res) {
+			if (res->index >= 0)
+				pqueue_remove_at(res->index, peerheap);
 			pkat_del(res);
 			peer_unlock(peer);
 		}
@@ -64,8 +64,10 @@ extern void bgp_keepalives_init(void);
 /**
  * Entry function for keepalives pthread.
  *
- * This function loops over an internal list of peers, generating keepalives at
- * regular intervals as determined by each peer's keepalive timer.
+ * This function keeps the registered peers ordered by when their next
+ * keepalive is due and, each time it wakes up, generates keepalives for those
+ * peers that are due, as determined by each peer's keepalive timer. How late
+ * or early each keepalive went out is recorded in peer->keepalive_jitter_*.
  *
  * See bgp_keepalives_on() for additional details.
  *
@@ -41,9 +41,57 @@
 
 extern struct zclient *zclient;
 
-int bgp_parse_fec_update(void)
+/*
+ * FEC (un)registrations are queued here and go to zebra together, as
+ * many to a message as fit, from an event; a change of command sends
+ * the queued ones first so that zebra sees them in order.
+ */
+static struct stream *fec_batch;
+static int fec_batch_command;
+static struct thread *t_fec_batch;
+
+/* flags, family, prefix and label index */
+#define BGP_FEC_ENTRY_MAX (2 + 2 + 1 + IPV6_MAX_BYTELEN + 4)
+
+static void bgp_fec_batch_flush(void)
 {
 	struct stream *s;
+
+	if (!fec_batch || !stream_get_endp(fec_batch))
+		return;
+
+	if (zclient && zclient->sock >= 0) {
+		s = zclient->obuf;
+		stream_reset(s);
+		zclient_create_header(s, fec_batch_command, VRF_DEFAULT);
+		stream_put(s, STREAM_DATA(fec_batch),
+			   stream_get_endp(fec_batch));
+		stream_putw_at(s, 0, stream_get_endp(s));
+		zclient_send_message(zclient);
+	}
+
+	stream_reset(fec_batch);
+}
+
+static int bgp_fec_batch_send(struct thread *thread)
+{
+	t_fec_batch = NULL;
+	bgp_fec_batch_flush();
+	return 0;
+}
+
+void bgp_label_cleanup(void)
+{
+	THREAD_OFF(t_fec_batch);
+	bgp_fec_batch_flush();
+	if (fec_batch)
+		stream_free(fec_batch);
+	fec_batch = NULL;
+}
+
+/* One FEC of an update, zebra may send several in a message. */
+static int bgp_parse_fec_entry(struct stream *s)
+{
 	struct bgp_node *rn;
 	struct bgp *bgp;
 	struct bgp_table *table;
@@ -52,8 +100,6 @@ int bgp_parse_fec_update(void)
 	afi_t afi;
 	safi_t safi;
 
-	s = zclient->ibuf;
-
 	memset(&p, 0, sizeof(struct prefix));
 	p.family = stream_getw(s);
 	p.prefixlen = stream_getc(s);
@@ -93,6 +139,17 @@ int bgp_parse_fec_update(void)
 	return 1;
 }
 
+int bgp_parse_fec_update(void)
+{
+	struct stream *s = zclient->ibuf;
+
+	/* an entry that doesn't apply doesn't stop the others */
+	while (STREAM_READABLE(s))
+		bgp_parse_fec_entry(s);
+
+	return 1;
+}
+
 mpls_label_t bgp_adv_label(struct bgp_node *rn, struct bgp_info *ri,
 			   struct peer *to, afi_t afi, safi_t safi)
 {
@@ -131,11 +188,17 @@ void bgp_reg_dereg_for_label(struct bgp_node *rn, struct bgp_info *ri, int reg)
 	if (!zclient || zclient->sock < 0)
 		return;
 
+	if (!fec_batch)
+		fec_batch = stream_new(ZEBRA_MAX_PACKET_SIZ - ZEBRA_HEADER_SIZE);
+
 	p = &(rn->p);
-	s = zclient->obuf;
-	stream_reset(s);
 	command = (reg) ? ZEBRA_FEC_REGISTER : ZEBRA_FEC_UNREGISTER;
-	zclient_create_header(s, command, VRF_DEFAULT);
+	if (command != fec_batch_command
+	    || STREAM_WRITEABLE(fec_batch) < BGP_FEC_ENTRY_MAX)
+		bgp_fec_batch_flush();
+	fec_batch_command = command;
+
+	s = fec_batch;
 	flags_pos = stream_get_endp(s); /* save position of 'flags' */
 	stream_putw(s, flags);		/* initial flags */
 	stream_putw(s, PREFIX_FAMILY(p));
@@ -152,16 +215,13 @@ void bgp_reg_dereg_for_label(struct bgp_node *rn, struct bgp_info *ri, int reg)
 	} else
 		UNSET_FLAG(rn->flags, BGP_NODE_REGISTERED_FOR_LABEL);
 
-	/* Set length and flags */
-	stream_putw_at(s, 0, stream_get_endp(s));
-
 	/*
 	 * We only need to write new flags if this is a register
 	 */
 	if (reg)
 		stream_putw_at(s, flags_pos, flags);
 
-	zclient_send_message(zclient);
+	thread_add_event(bm->master, bgp_fec_batch_send, NULL, 0, &t_fec_batch);
 }
 
 static int bgp_nlri_get_labels(struct peer *peer, uint8_t *pnt, uint8_t plen,
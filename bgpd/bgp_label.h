@@ -32,6 +32,7 @@ struct peer;
 extern void bgp_reg_dereg_for_label(struct bgp_node *rn, struct bgp_info *ri,
 				    int reg);
 extern int bgp_parse_fec_update(void);
+extern void bgp_label_cleanup(void);
 extern mpls_label_t bgp_adv_label(struct bgp_node *rn, struct bgp_info *ri,
 				  struct peer *to, afi_t afi, safi_t safi);
 
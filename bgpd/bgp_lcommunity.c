@@ -25,7 +25,7 @@
 #include "prefix.h"
 #include "command.h"
 #include "filter.h"
-#include "jhash.h"
+#include "hashfn.h"
 #include "stream.h"
 
 #include "bgpd/bgpd.h"
@@ -101,25 +101,42 @@ static int lcommunity_add_val(struct lcommunity *lcom,
 	return 1;
 }
 
+static int lcommunity_compare(const void *a1, const void *a2)
+{
+	return memcmp(a1, a2, LCOMMUNITY_SIZE);
+}
+
 /* This function takes pointer to Large Communites strucutre then
    create a new Large Communities structure by uniq and sort each
    Large Communities value.  */
 struct lcommunity *lcommunity_uniq_sort(struct lcommunity *lcom)
 {
-	int i;
+	int i, j;
 	struct lcommunity *new;
-	struct lcommunity_val *lval;
 
 	if (!lcom)
 		return NULL;
 
 	new = lcommunity_new();
 
-	for (i = 0; i < lcom->size; i++) {
-		lval = (struct lcommunity_val *)(lcom->val
-						 + (i * LCOMMUNITY_SIZE));
-		lcommunity_add_val(new, lval);
-	}
+	if (!lcom->size)
+		return new;
+
+	/* Same order as lcommunity_add_val() builds, in one sort instead of
+	   an insertion per value.  Duplicates end up adjacent. */
+	new->val = XMALLOC(MTYPE_LCOMMUNITY_VAL, lcom_length(lcom));
+	memcpy(new->val, lcom->val, lcom_length(lcom));
+	qsort(new->val, lcom->size, LCOMMUNITY_SIZE, lcommunity_compare);
+
+	for (i = j = 1; i < lcom->size; i++)
+		if (memcmp(new->val + i * LCOMMUNITY_SIZE,
+			   new->val + (j - 1) * LCOMMUNITY_SIZE,
+			   LCOMMUNITY_SIZE))
+			memmove(new->val + j++ * LCOMMUNITY_SIZE,
+				new->val + i * LCOMMUNITY_SIZE,
+				LCOMMUNITY_SIZE);
+	new->size = j;
+
 	return new;
 }
 
@@ -231,7 +248,7 @@ unsigned int lcommunity_hash_make(void *arg)
 	const struct lcommunity *lcom = arg;
 	int size = lcom_length(lcom);
 
-	return jhash(lcom->val, size, 0xab125423);
+	return hashfn(lcom->val, size, 0xab125423);
 }
 
 /* Compare two Large Communities Attribute structure.  */
@@ -100,6 +100,7 @@ DEFINE_MTYPE(BGPD, BGP_DAMP_INFO, "Dampening info")
 DEFINE_MTYPE(BGPD, BGP_DAMP_ARRAY, "BGP Dampening array")
 DEFINE_MTYPE(BGPD, BGP_REGEXP, "BGP regexp")
 DEFINE_MTYPE(BGPD, BGP_AGGREGATE, "BGP aggregate")
+DEFINE_MTYPE(BGPD, BGP_AGGREGATE_REF, "BGP aggregate component")
 DEFINE_MTYPE(BGPD, BGP_ADDR, "BGP own address")
 DEFINE_MTYPE(BGPD, TIP_ADDR, "BGP own tunnel-ip address")
 
@@ -96,6 +96,7 @@ DECLARE_MTYPE(BGP_DAMP_INFO)
 DECLARE_MTYPE(BGP_DAMP_ARRAY)
 DECLARE_MTYPE(BGP_REGEXP)
 DECLARE_MTYPE(BGP_AGGREGATE)
+DECLARE_MTYPE(BGP_AGGREGATE_REF)
 DECLARE_MTYPE(BGP_ADDR)
 DECLARE_MTYPE(TIP_ADDR)
 
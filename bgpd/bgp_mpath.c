@@ -666,7 +666,7 @@ void bgp_mp_dmed_deselect(struct bgp_info *dmed_best)
  * bestpath info so that a peer update will be generated. The
  * change is detected by generating the current attribute,
  * interning it, and then comparing the interned pointer with the
- * current value. We can skip this generate/compare step if there
+ * current value. We skip this generate/compare step if there
  * is no change in multipath selection and no attribute change in
  * any multipath.
  */
@@ -682,6 +682,7 @@ void bgp_info_mpath_aggregate_update(struct bgp_info *new_best,
 	struct ecommunity *ecomm, *ecommerge;
 	struct lcommunity *lcomm, *lcommerge;
 	struct attr attr = {0};
+	uint8_t as_set;
 
 	if (old_best && (old_best != new_best)
 	    && (old_attr = bgp_info_mpath_attr(old_best))) {
@@ -701,10 +702,27 @@ void bgp_info_mpath_aggregate_update(struct bgp_info *new_best,
 		return;
 	}
 
+	as_set = new_best->peer
+		 && bgp_flag_check(new_best->peer->bgp,
+				   BGP_FLAG_MULTIPATH_RELAX_AS_SET);
+
+	/* Same best path and multipaths with the same attributes as last
+	 * time, so the aggregate is the same as well */
+	if (new_best == old_best && bgp_info_mpath_attr(new_best)
+	    && new_best->mpath->mp_attr_as_set == as_set
+	    && !CHECK_FLAG(new_best->flags, BGP_INFO_MULTIPATH_CHG)
+	    && !CHECK_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED)) {
+		for (mpinfo = bgp_info_mpath_first(new_best); mpinfo;
+		     mpinfo = bgp_info_mpath_next(mpinfo))
+			if (CHECK_FLAG(mpinfo->flags, BGP_INFO_ATTR_CHANGED))
+				break;
+		if (!mpinfo)
+			return;
+	}
+
 	bgp_attr_dup(&attr, new_best->attr);
 
-	if (new_best->peer && bgp_flag_check(new_best->peer->bgp,
-					     BGP_FLAG_MULTIPATH_RELAX_AS_SET)) {
+	if (as_set) {
 
 		/* aggregate attribute from multipath constituents */
 		aspath = aspath_dup(attr.aspath);
@@ -794,4 +812,5 @@ void bgp_info_mpath_aggregate_update(struct bgp_info *new_best,
 		SET_FLAG(new_best->flags, BGP_INFO_ATTR_CHANGED);
 	} else
 		bgp_attr_unintern(&new_attr);
+	new_best->mpath->mp_attr_as_set = as_set;
 }
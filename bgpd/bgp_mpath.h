@@ -40,6 +40,9 @@ struct bgp_info_mpath {
 
 	/* Aggregated attribute for advertising multipath route */
 	struct attr *mp_attr;
+
+	/* Whether mp_attr was built with multipath-relax as-set */
+	uint8_t mp_attr_as_set;
 };
 
 /* Functions to support maximum-paths configuration */
@@ -26,6 +26,8 @@
 #include "memory.h"
 #include "stream.h"
 #include "queue.h"
+#include "hash.h"
+#include "jhash.h"
 #include "filter.h"
 #include "mpls.h"
 #include "json.h"
@@ -331,8 +333,139 @@ static int ecom_intersect(struct ecommunity *e1, struct ecommunity *e2)
 	return 0;
 }
 
+static int ecom_has_val(struct ecommunity *ecom, struct ecommunity_val *val)
+{
+	int i;
+
+	for (i = 0; ecom && i < ecom->size; ++i)
+		if (!memcmp(ecom->val + (i * ECOMMUNITY_SIZE), val->val,
+			    ECOMMUNITY_SIZE))
+			return 1;
+	return 0;
+}
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_VPN_IMPORT_RT, "BGP VPN import route target")
+
 /*
- * returns pointer to new bgp_info upon success
+ * Index from route target to the vrfs importing vpn routes that carry it,
+ * so that leaking a vpn route only visits the vrfs interested in it.  It
+ * follows rtlist[BGP_VPN_POLICY_DIR_FROMVPN] of each instance, whether
+ * import is enabled or not.
+ */
+struct vpn_import_rt {
+	uint8_t val[ECOMMUNITY_SIZE];
+	struct list *vrfs[AFI_MAX];
+};
+
+static struct hash *vpn_import_rt_hash;
+static unsigned int vpn_import_walk;
+
+static unsigned int vpn_import_rt_key(void *arg)
+{
+	struct vpn_import_rt *rt = arg;
+
+	return jhash(rt->val, ECOMMUNITY_SIZE, 0x9b1ac5e3);
+}
+
+static int vpn_import_rt_cmp(const void *a, const void *b)
+{
+	const struct vpn_import_rt *rt1 = a, *rt2 = b;
+
+	return !memcmp(rt1->val, rt2->val, ECOMMUNITY_SIZE);
+}
+
+static void *vpn_import_rt_alloc(void *arg)
+{
+	struct vpn_import_rt *rt;
+
+	rt = XCALLOC(MTYPE_BGP_VPN_IMPORT_RT, sizeof(*rt));
+	memcpy(rt->val, ((struct vpn_import_rt *)arg)->val, ECOMMUNITY_SIZE);
+	return rt;
+}
+
+static void vpn_import_index_add(struct bgp *bgp_vrf, afi_t afi,
+				 struct ecommunity *ecom)
+{
+	struct vpn_import_rt *rt, key;
+	int i;
+
+	for (i = 0; ecom && i < ecom->size; i++) {
+		memcpy(key.val, ecom->val + (i * ECOMMUNITY_SIZE),
+		       ECOMMUNITY_SIZE);
+		rt = hash_get(vpn_import_rt_hash, &key, vpn_import_rt_alloc);
+		if (!rt->vrfs[afi])
+			rt->vrfs[afi] = list_new();
+		if (!listnode_lookup(rt->vrfs[afi], bgp_vrf))
+			listnode_add(rt->vrfs[afi], bgp_vrf);
+	}
+}
+
+static void vpn_import_index_del(struct bgp *bgp_vrf, afi_t afi,
+				 struct ecommunity *ecom)
+{
+	struct vpn_import_rt *rt, key;
+	afi_t a;
+	int i;
+
+	for (i = 0; ecom && i < ecom->size; i++) {
+		memcpy(key.val, ecom->val + (i * ECOMMUNITY_SIZE),
+		       ECOMMUNITY_SIZE);
+		rt = hash_lookup(vpn_import_rt_hash, &key);
+		if (!rt || !rt->vrfs[afi])
+			continue;
+
+		listnode_delete(rt->vrfs[afi], bgp_vrf);
+		if (listcount(rt->vrfs[afi]) == 0)
+			list_delete_and_null(&rt->vrfs[afi]);
+
+		for (a = 0; a < AFI_MAX; a++)
+			if (rt->vrfs[a])
+				break;
+		if (a == AFI_MAX) {
+			hash_release(vpn_import_rt_hash, rt);
+			XFREE(MTYPE_BGP_VPN_IMPORT_RT, rt);
+		}
+	}
+}
+
+/*
+ * Calls func once for each vrf importing vpn routes of afi with any of the
+ * route targets in ecom.
+ */
+static void vpn_import_foreach(struct ecommunity *ecom, afi_t afi,
+			       void (*func)(struct bgp *bgp_vrf, void *arg),
+			       void *arg)
+{
+	struct vpn_import_rt *rt, key;
+	struct listnode *node;
+	struct bgp *bgp_vrf;
+	unsigned int walk;
+	int i;
+
+	if (!ecom)
+		return;
+
+	/* a vrf importing several of the route targets is visited once */
+	walk = ++vpn_import_walk;
+
+	for (i = 0; i < ecom->size; i++) {
+		memcpy(key.val, ecom->val + (i * ECOMMUNITY_SIZE),
+		       ECOMMUNITY_SIZE);
+		rt = hash_lookup(vpn_import_rt_hash, &key);
+		if (!rt || !rt->vrfs[afi])
+			continue;
+
+		for (ALL_LIST_ELEMENTS_RO(rt->vrfs[afi], node, bgp_vrf)) {
+			if (bgp_vrf->vpn_policy[afi].import_walk == walk)
+				continue;
+			bgp_vrf->vpn_policy[afi].import_walk = walk;
+			func(bgp_vrf, arg);
+		}
+	}
+}
+
+/*
+ * returns pointer to new or changed bgp_info upon success
  */
 static struct bgp_info *
 leak_update(
@@ -433,7 +566,7 @@ leak_update(
 			zlog_debug("%s: ->%s: %s Found route, changed attr",
 				   __func__, bgp->name_pretty, buf_prefix);
 
-		return NULL;
+		return bi;
 	}
 
 	new = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_IMPORTED, 0,
@@ -837,6 +970,8 @@ void vpn_leak_from_vrf_withdraw_all(struct bgp *bgp_vpn, /* to */
 					if (debug)
 						zlog_debug("%s: deleting it\n",
 							   __func__);
+					/* withdraw from looped vrfs as well */
+					vpn_leak_to_vrf_withdraw(bgp_vpn, bi);
 					bgp_aggregate_decrement(bgp_vpn, &bn->p,
 								bi, afi, safi);
 					bgp_info_delete(bn, bi);
@@ -1002,38 +1137,82 @@ static void vpn_leak_to_vrf_update_onevrf(struct bgp *bgp_vrf,       /* to */
 		bgp_vpn, &nexthop_orig, nexthop_self_flag, debug);
 }
 
+struct vpn_leak_to_vrf_arg {
+	struct bgp *bgp_vpn;
+	struct bgp_info *info_vpn;
+};
+
+static void vpn_leak_to_vrf_update_importing(struct bgp *bgp_vrf, void *arg)
+{
+	struct vpn_leak_to_vrf_arg *leak = arg;
+
+	if (!leak->info_vpn->extra
+	    || leak->info_vpn->extra->bgp_orig != bgp_vrf) /* no loop */
+		vpn_leak_to_vrf_update_onevrf(bgp_vrf, leak->bgp_vpn,
+					      leak->info_vpn);
+}
+
 void vpn_leak_to_vrf_update(struct bgp *bgp_vpn,       /* from */
 			    struct bgp_info *info_vpn) /* route */
 {
-	struct listnode *mnode, *mnnode;
-	struct bgp *bgp;
+	struct vpn_leak_to_vrf_arg leak = {bgp_vpn, info_vpn};
 
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
 
 	if (debug)
 		zlog_debug("%s: start (info_vpn=%p)", __func__, info_vpn);
 
-	/* Loop over VRFs */
-	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
+	/* Loop over VRFs importing any of the route's RTs */
+	vpn_import_foreach(info_vpn->attr->ecommunity,
+			   family2afi(info_vpn->net->p.family),
+			   vpn_leak_to_vrf_update_importing, &leak);
+}
+
+static void vpn_leak_to_vrf_withdraw_importing(struct bgp *bgp, void *arg)
+{
+	struct vpn_leak_to_vrf_arg *leak = arg;
+	struct bgp_info *info_vpn = leak->info_vpn;
+	struct prefix *p = &info_vpn->net->p;
+	afi_t afi = family2afi(p->family);
+	safi_t safi = SAFI_UNICAST;
+	struct bgp_node *bn;
+	struct bgp_info *bi;
+	const char *debugmsg;
+
+	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
+
+	if (!vpn_leak_from_vpn_active(bgp, afi, &debugmsg)) {
+		if (debug)
+			zlog_debug("%s: skipping: %s", __func__, debugmsg);
+		return;
+	}
+
+	if (debug)
+		zlog_debug("%s: withdrawing from vrf %s", __func__,
+			   bgp->name_pretty);
 
-		if (!info_vpn->extra
-		    || info_vpn->extra->bgp_orig != bgp) { /* no loop */
-			vpn_leak_to_vrf_update_onevrf(bgp, bgp_vpn, info_vpn);
+	bn = bgp_afi_node_get(bgp->rib[afi][safi], afi, safi, p, NULL);
+	for (bi = (bn ? bn->info : NULL); bi; bi = bi->next) {
+		if (bi->extra
+		    && (struct bgp_info *)bi->extra->parent == info_vpn) {
+			break;
 		}
 	}
+
+	if (bi) {
+		if (debug)
+			zlog_debug("%s: deleting bi %p", __func__, bi);
+		bgp_aggregate_decrement(bgp, p, bi, afi, safi);
+		bgp_info_delete(bn, bi);
+		bgp_process(bgp, bn, afi, safi);
+	}
+	bgp_unlock_node(bn);
 }
 
 void vpn_leak_to_vrf_withdraw(struct bgp *bgp_vpn,       /* from */
 			      struct bgp_info *info_vpn) /* route */
 {
-	struct prefix *p;
-	afi_t afi;
-	safi_t safi = SAFI_UNICAST;
-	struct bgp *bgp;
-	struct listnode *mnode, *mnnode;
-	struct bgp_node *bn;
-	struct bgp_info *bi;
-	const char *debugmsg;
+	struct vpn_leak_to_vrf_arg leak = {bgp_vpn, info_vpn};
 	char buf_prefix[PREFIX_STRLEN];
 
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_TO_VRF);
@@ -1063,48 +1242,10 @@ void vpn_leak_to_vrf_withdraw(struct bgp *bgp_vpn,       /* from */
 		return;
 	}
 
-	p = &info_vpn->net->p;
-	afi = family2afi(p->family);
-
-	/* Loop over VRFs */
-	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp)) {
-		if (!vpn_leak_from_vpn_active(bgp, afi, &debugmsg)) {
-			if (debug)
-				zlog_debug("%s: skipping: %s", __func__,
-					   debugmsg);
-			continue;
-		}
-
-		/* Check for intersection of route targets */
-		if (!ecom_intersect(bgp->vpn_policy[afi]
-					    .rtlist[BGP_VPN_POLICY_DIR_FROMVPN],
-				    info_vpn->attr->ecommunity)) {
-
-			continue;
-		}
-
-		if (debug)
-			zlog_debug("%s: withdrawing from vrf %s", __func__,
-				   bgp->name_pretty);
-
-		bn = bgp_afi_node_get(bgp->rib[afi][safi], afi, safi, p, NULL);
-		for (bi = (bn ? bn->info : NULL); bi; bi = bi->next) {
-			if (bi->extra
-			    && (struct bgp_info *)bi->extra->parent
-				       == info_vpn) {
-				break;
-			}
-		}
-
-		if (bi) {
-			if (debug)
-				zlog_debug("%s: deleting bi %p", __func__, bi);
-			bgp_aggregate_decrement(bgp, p, bi, afi, safi);
-			bgp_info_delete(bn, bi);
-			bgp_process(bgp, bn, afi, safi);
-		}
-		bgp_unlock_node(bn);
-	}
+	/* Loop over VRFs importing any of the route's RTs */
+	vpn_import_foreach(info_vpn->attr->ecommunity,
+			   family2afi(info_vpn->net->p.family),
+			   vpn_leak_to_vrf_withdraw_importing, &leak);
 }
 
 void vpn_leak_to_vrf_withdraw_all(struct bgp *bgp_vrf, /* to */
@@ -1137,9 +1278,10 @@ void vpn_leak_to_vrf_withdraw_all(struct bgp *bgp_vrf, /* to */
 	}
 }
 
-void vpn_leak_to_vrf_update_all(struct bgp *bgp_vrf, /* to */
-				struct bgp *bgp_vpn, /* from */
-				afi_t afi)
+/* Leaks the vpn routes carrying any of rts (all if NULL) to a vrf. */
+static void vpn_leak_to_vrf_update_rts(struct bgp *bgp_vrf, /* to */
+				       struct bgp *bgp_vpn, /* from */
+				       afi_t afi, struct ecommunity *rts)
 {
 	struct prefix_rd prd;
 	struct bgp_node *prn;
@@ -1172,6 +1314,9 @@ void vpn_leak_to_vrf_update_all(struct bgp *bgp_vrf, /* to */
 
 				if (bi->extra && bi->extra->bgp_orig == bgp_vrf)
 					continue;
+				if (rts && !ecom_intersect(rts,
+							   bi->attr->ecommunity))
+					continue;
 
 				vpn_leak_to_vrf_update_onevrf(bgp_vrf, bgp_vpn,
 							      bi);
@@ -1180,6 +1325,87 @@ void vpn_leak_to_vrf_update_all(struct bgp *bgp_vrf, /* to */
 	}
 }
 
+void vpn_leak_to_vrf_update_all(struct bgp *bgp_vrf, /* to */
+				struct bgp *bgp_vpn, /* from */
+				afi_t afi)
+{
+	vpn_leak_to_vrf_update_rts(bgp_vrf, bgp_vpn, afi, NULL);
+}
+
+/* Withdraws the routes leaked from vpn the vrf's import RTs don't match. */
+static void vpn_leak_to_vrf_withdraw_unmatched(struct bgp *bgp_vrf, /* to */
+					       struct bgp *bgp_vpn, afi_t afi)
+{
+	struct ecommunity *rtlist =
+		bgp_vrf->vpn_policy[afi].rtlist[BGP_VPN_POLICY_DIR_FROMVPN];
+	struct bgp_node *bn;
+	struct bgp_info *bi, *parent;
+	safi_t safi = SAFI_UNICAST;
+
+	for (bn = bgp_table_top(bgp_vrf->rib[afi][safi]); bn;
+	     bn = bgp_route_next(bn)) {
+
+		for (bi = bn->info; bi; bi = bi->next) {
+			/* bgp_orig is the vrf of origin for routes that went
+			 * through vpn from another vrf, look at the parent */
+			if (bi->sub_type != BGP_ROUTE_IMPORTED || !bi->extra
+			    || !bi->extra->parent)
+				continue;
+
+			parent = bi->extra->parent;
+			if (ecom_intersect(rtlist, parent->attr->ecommunity))
+				continue;
+
+			/* delete route */
+			bgp_aggregate_decrement(bgp_vrf, &bn->p, bi, afi, safi);
+			bgp_info_delete(bn, bi);
+			bgp_process(bgp_vrf, bn, afi, safi);
+		}
+	}
+}
+
+/*
+ * Sets the route targets a vrf imports vpn routes with, taking over ecom
+ * (may be NULL), and withdraws or leaks only the routes this changes the
+ * import of.  With bgp_vpn NULL no routes are touched.
+ */
+void vpn_leak_to_vrf_rt_change(struct bgp *bgp_vpn, struct bgp *bgp_vrf,
+			       afi_t afi, struct ecommunity *ecom)
+{
+	struct ecommunity *old =
+		bgp_vrf->vpn_policy[afi].rtlist[BGP_VPN_POLICY_DIR_FROMVPN];
+	struct ecommunity *added;
+	int was_active = vpn_leak_from_vpn_active(bgp_vrf, afi, NULL);
+	int i;
+
+	vpn_import_index_del(bgp_vrf, afi, old);
+	bgp_vrf->vpn_policy[afi].rtlist[BGP_VPN_POLICY_DIR_FROMVPN] = ecom;
+	vpn_import_index_add(bgp_vrf, afi, ecom);
+
+	if (bgp_vpn && was_active)
+		vpn_leak_to_vrf_withdraw_unmatched(bgp_vrf, bgp_vpn, afi);
+
+	if (bgp_vpn && vpn_leak_from_vpn_active(bgp_vrf, afi, NULL)) {
+		/* routes with the RTs imported before already are */
+		added = ecommunity_new();
+		for (i = 0; i < ecom->size; i++) {
+			struct ecommunity_val *val =
+				(struct ecommunity_val *)(ecom->val
+							  + (i * ECOMMUNITY_SIZE));
+
+			if (!was_active || !ecom_has_val(old, val))
+				ecommunity_add_val(added, val);
+		}
+		if (added->size)
+			vpn_leak_to_vrf_update_rts(bgp_vrf, bgp_vpn, afi,
+						   added);
+		ecommunity_free(&added);
+	}
+
+	if (old)
+		ecommunity_free(&old);
+}
+
 static void vpn_policy_routemap_update(struct bgp *bgp, const char *rmap_name)
 {
 	int debug = BGP_DEBUG(vpn, VPN_LEAK_RMAP_EVENT);
@@ -1833,6 +2059,9 @@ DEFUN (show_ip_bgp_vpn_rd_neighbor_advertised_routes,
 
 void bgp_mplsvpn_init(void)
 {
+	vpn_import_rt_hash = hash_create(vpn_import_rt_key, vpn_import_rt_cmp,
+					 "BGP VPN import route targets");
+
 	install_element(BGP_VPNV4_NODE, &vpnv4_network_cmd);
 	install_element(BGP_VPNV4_NODE, &vpnv4_network_route_map_cmd);
 	install_element(BGP_VPNV4_NODE, &no_vpnv4_network_cmd);
@@ -69,6 +69,10 @@ extern void vpn_leak_to_vrf_withdraw_all(struct bgp *bgp_vrf, afi_t afi);
 extern void vpn_leak_to_vrf_update_all(struct bgp *bgp_vrf, struct bgp *bgp_vpn,
 				       afi_t afi);
 
+extern void vpn_leak_to_vrf_rt_change(struct bgp *bgp_vpn,
+				      struct bgp *bgp_vrf, afi_t afi,
+				      struct ecommunity *ecom);
+
 extern void vpn_leak_to_vrf_update(struct bgp *bgp_vpn,
 				   struct bgp_info *info_vpn);
 
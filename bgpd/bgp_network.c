@@ -149,6 +149,19 @@ int bgp_md5_unset(struct peer *peer)
 	return bgp_md5_set_password(peer, NULL);
 }
 
+/* Apply the "tcp ..." settings of bgp to a peer socket */
+static void bgp_socket_tune(struct bgp *bgp, int sock)
+{
+	setsockopt_so_sendbuf(sock, bgp->tcp_sndbuf ? bgp->tcp_sndbuf
+						    : BGP_SOCKET_SNDBUF_SIZE);
+	if (bgp->tcp_rcvbuf)
+		setsockopt_so_recvbuf(sock, bgp->tcp_rcvbuf);
+	if (bgp->tcp_notsent_lowat)
+		sockopt_tcp_notsent_lowat(sock, bgp->tcp_notsent_lowat);
+	if (bgp_flag_check(bgp, BGP_FLAG_TCP_QUICKACK))
+		sockopt_tcp_quickack(sock, 1);
+}
+
 int bgp_set_socket_ttl(struct peer *peer, int bgp_sock)
 {
 	char buf[INET_ADDRSTRLEN];
@@ -314,8 +327,8 @@ static int bgp_accept(struct thread *thread)
 		return -1;
 	}
 
-	/* Set socket send buffer size */
-	setsockopt_so_sendbuf(bgp_sock, BGP_SOCKET_SNDBUF_SIZE);
+	/* Set socket buffer sizes and other TCP options */
+	bgp_socket_tune(bgp, bgp_sock);
 
 	/* Check remote IP address */
 	peer1 = peer_lookup(bgp, &su);
@@ -555,8 +568,8 @@ int bgp_connect(struct peer *peer)
 
 	set_nonblocking(peer->fd);
 
-	/* Set socket send buffer size */
-	setsockopt_so_sendbuf(peer->fd, BGP_SOCKET_SNDBUF_SIZE);
+	/* Set socket buffer sizes and other TCP options */
+	bgp_socket_tune(peer->bgp, peer->fd);
 
 	if (bgp_set_socket_ttl(peer, peer->fd) < 0)
 		return -1;
@@ -641,8 +641,34 @@ static void unregister_zebra_rnh(struct bgp_nexthop_cache *bnc,
 		sendmsg_zebra_rnh(bnc, ZEBRA_NEXTHOP_UNREGISTER);
 }
 
+/*
+ * Whether path is the only one for its prefix, in which case a change of its
+ * IGP metric alone cannot change the outcome of best path selection.
+ */
+static int path_is_lone(struct bgp_node *rn, struct bgp_info *path)
+{
+	struct bgp_info *ri;
+
+	for (ri = rn->info; ri; ri = ri->next)
+		if (ri != path && !BGP_INFO_HOLDDOWN(ri))
+			return 0;
+
+	return 1;
+}
+
 /**
  * evaluate_paths - Evaluate the paths/nets associated with a nexthop.
+ *
+ * Prefixes are only queued for best path selection if the update can make a
+ * difference for them: the path became valid or invalid, the nexthops it
+ * resolves over changed, or the IGP metric changed and there are other paths
+ * it is compared against.  The queued prefixes are then all handled in the
+ * same run of the route processing work queue.
+ *
+ * When only the nexthops it resolves over changed, zebra has already
+ * resolved the routes using the nexthop again, once per nexthop group they
+ * share; the routes sent again then match what zebra installed.
+ *
  * ARGUMENTS:
  *   struct bgp_nexthop_cache *bnc -- the nexthop structure.
  * RETURNS:
@@ -657,6 +683,8 @@ static void evaluate_paths(struct bgp_nexthop_cache *bnc)
 	struct bgp_table *table;
 	safi_t safi;
 	struct bgp *bgp_path;
+	int valid_changed;
+	unsigned int npaths = 0, nprocessed = 0;
 
 	if (BGP_DEBUG(nht, NHT)) {
 		char buf[PREFIX2STR_BUFFER];
@@ -718,8 +746,9 @@ static void evaluate_paths(struct bgp_nexthop_cache *bnc)
 				(bnc_is_valid_nexthop ? "" : "not "));
 		}
 
-		if ((CHECK_FLAG(path->flags, BGP_INFO_VALID) ? 1 : 0)
-		    != bnc_is_valid_nexthop) {
+		valid_changed = (CHECK_FLAG(path->flags, BGP_INFO_VALID) ? 1 : 0)
+				!= bnc_is_valid_nexthop;
+		if (valid_changed) {
 			if (CHECK_FLAG(path->flags, BGP_INFO_VALID)) {
 				bgp_aggregate_decrement(bgp_path, &rn->p,
 							path, afi, safi);
@@ -738,11 +767,35 @@ static void evaluate_paths(struct bgp_nexthop_cache *bnc)
 		else if (path->extra)
 			path->extra->igpmetric = 0;
 
+		npaths++;
+		if (!valid_changed
+		    && !CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_CHANGED)) {
+			/* Nothing changed at all for this path */
+			if (!CHECK_FLAG(bnc->change_flags,
+					BGP_NEXTHOP_METRIC_CHANGED))
+				continue;
+
+			/* Only the metric did, which doesn't matter if the
+			 * path is not a candidate or has no competition */
+			if (!CHECK_FLAG(path->flags, BGP_INFO_VALID)
+			    || path_is_lone(rn, path))
+				continue;
+		}
+
 		if (CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_METRIC_CHANGED)
 		    || CHECK_FLAG(bnc->change_flags, BGP_NEXTHOP_CHANGED))
 			SET_FLAG(path->flags, BGP_INFO_IGP_CHANGED);
 
 		bgp_process(bgp_path, rn, afi, safi);
+		nprocessed++;
+	}
+
+	if (BGP_DEBUG(nht, NHT)) {
+		char buf[PREFIX2STR_BUFFER];
+
+		zlog_debug("%s: %s - %u of %u paths queued for processing",
+			   __func__, bnc_str(bnc, buf, PREFIX2STR_BUFFER),
+			   nprocessed, npaths);
 	}
 
 	if (peer && !CHECK_FLAG(bnc->flags, BGP_NEXTHOP_PEER_NOTIFIED)) {
@@ -61,6 +61,29 @@
 #include "bgpd/bgp_keepalives.h"
 #include "bgpd/bgp_flowspec.h"
 
+DEFINE_HOOK(bgp_packet_dump,
+	    (struct peer *peer, uint8_t type, bgp_size_t size,
+	     struct stream *s),
+	    (peer, type, size, s))
+DEFINE_HOOK(bgp_packet_send,
+	    (struct peer *peer, uint8_t type, bgp_size_t size,
+	     struct stream *s),
+	    (peer, type, size, s))
+
+DEFINE_MTYPE_STATIC(BGPD, BGP_ATTR_CACHE, "BGP received attribute cache")
+
+/*
+ * Large feeds split prefixes sharing one set of path attributes over many
+ * consecutive UPDATEs. The raw attribute section of the last such UPDATE is
+ * kept along with its parsed attr, which owns the references taken by
+ * bgp_attr_parse(), so that a byte-identical section can skip parsing.
+ */
+struct bgp_attr_cache {
+	struct attr attr;
+	bgp_size_t len;
+	uint8_t raw[];
+};
+
 /**
  * Sets marker and type fields for a BGP message.
  *
@@ -106,14 +129,12 @@ int bgp_packet_set_size(struct stream *s)
 }
 
 /*
- * Push a packet onto the beginning of the peer's output queue.
- * This function acquires the peer's write mutex before proceeding.
+ * Push a packet onto the end of the peer's output queue.
+ * The queue is lock-free, so this does not contend with the I/O thread.
  */
 static void bgp_packet_add(struct peer *peer, struct stream *s)
 {
-	pthread_mutex_lock(&peer->io_mtx);
 	stream_fifo_push(peer->obuf, s);
-	pthread_mutex_unlock(&peer->io_mtx);
 }
 
 static struct stream *bgp_update_packet_eor(struct peer *peer, afi_t afi,
@@ -351,7 +372,8 @@ static void bgp_write_proceed_actions(struct peer *peer)
 
 		/* No packets to send, see if EOR is pending */
 		if (CHECK_FLAG(peer->cap, PEER_CAP_RESTART_RCV)) {
-			if (!subgrp->t_coalesce && peer->afc_nego[afi][safi]
+			if (!subgrp->t_coalesce && !subgrp->t_announce
+			    && peer->afc_nego[afi][safi]
 			    && peer->synctime
 			    && !CHECK_FLAG(peer->af_sflags[afi][safi],
 					   PEER_STATUS_EOR_SEND)
@@ -412,7 +434,8 @@ int bgp_generate_updgrp_packets(struct thread *thread)
 				next_pkt = subgroup_withdraw_packet(
 					PAF_SUBGRP(paf));
 				if (!next_pkt || !next_pkt->buffer)
-					subgroup_update_packet(PAF_SUBGRP(paf));
+					subgroup_update_packets_build(
+						PAF_SUBGRP(paf));
 				next_pkt = paf->next_pkt_to_send;
 			}
 
@@ -421,13 +444,14 @@ int bgp_generate_updgrp_packets(struct thread *thread)
 			 * then try to find out out if we have to send eor or
 			 * if not, skip to the next AFI, SAFI. Don't send the
 			 * EOR prematurely; if the subgroup's coalesce timer is
-			 * running, the adjacency-out structure is not created
-			 * yet.
+			 * running, or its routes are still being announced,
+			 * the adjacency-out structure is not complete yet.
 			 */
 			if (!next_pkt || !next_pkt->buffer) {
 				if (CHECK_FLAG(peer->cap,
 					       PEER_CAP_RESTART_RCV)) {
 					if (!(PAF_SUBGRP(paf))->t_coalesce
+					    && !(PAF_SUBGRP(paf))->t_announce
 					    && peer->afc_nego[afi][safi]
 					    && peer->synctime
 					    && !CHECK_FLAG(
@@ -502,6 +526,7 @@ void bgp_open_send(struct peer *peer)
 	struct stream *s;
 	uint16_t send_holdtime;
 	as_t local_as;
+	bgp_size_t length;
 
 	if (PEER_OR_GROUP_TIMER_SET(peer))
 		send_holdtime = peer->holdtime;
@@ -530,7 +555,9 @@ void bgp_open_send(struct peer *peer)
 	bgp_open_capability(s, peer);
 
 	/* Set BGP packet length. */
-	(void)bgp_packet_set_size(s);
+	length = bgp_packet_set_size(s);
+
+	hook_call(bgp_packet_send, peer, BGP_MSG_OPEN, length, s);
 
 	if (bgp_debug_neighbor_events(peer))
 		zlog_debug(
@@ -551,25 +578,18 @@ void bgp_open_send(struct peer *peer)
  * Writes NOTIFICATION message directly to a peer socket without waiting for
  * the I/O thread.
  *
- * There must be exactly one stream on the peer->obuf FIFO, and the data within
- * this stream must match the format of a BGP NOTIFICATION message.
- * Transmission is best-effort.
+ * The data within the stream must match the format of a BGP NOTIFICATION
+ * message. Transmission is best-effort.
  *
  * @requires peer->io_mtx
  * @param peer
+ * @param s	the NOTIFICATION, consumed
  * @return 0
  */
-static int bgp_write_notify(struct peer *peer)
+static int bgp_write_notify(struct peer *peer, struct stream *s)
 {
 	int ret, val;
 	uint8_t type;
-	struct stream *s;
-
-	/* There should be at least one packet. */
-	s = stream_fifo_pop(peer->obuf);
-
-	if (!s)
-		return 0;
 
 	assert(stream_get_endp(s) >= BGP_HEADER_SIZE);
 
@@ -736,10 +756,11 @@ void bgp_notify_send_with_data(struct peer *peer, uint8_t code,
 	} else
 		peer->last_reset = PEER_DOWN_NOTIFY_SEND;
 
-	/* Add packet to peer's output queue */
-	stream_fifo_push(peer->obuf, s);
-
-	bgp_write_notify(peer);
+	/*
+	 * Write it right away; the output queue may have picked up a
+	 * KEEPALIVE from the keepalives thread since it was wiped.
+	 */
+	bgp_write_notify(peer, s);
 
 	/* ============================================== */
 	pthread_mutex_unlock(&peer->io_mtx);
@@ -1362,6 +1383,71 @@ static int bgp_keepalive_receive(struct peer *peer, bgp_size_t size)
 }
 
 
+/**
+ * Drop the peer's cached received attributes, if any.
+ *
+ * @param peer
+ */
+void bgp_update_attr_cache_flush(struct peer *peer)
+{
+	if (!peer->rcvd_attr_cache)
+		return;
+
+	bgp_attr_unintern_sub(&peer->rcvd_attr_cache->attr);
+	XFREE(MTYPE_BGP_ATTR_CACHE, peer->rcvd_attr_cache);
+}
+
+/**
+ * Look up an UPDATE's raw attribute section in the peer's cache.
+ *
+ * @param peer
+ * @param raw start of the path attributes
+ * @param len total path attribute length
+ * @param attr filled in with the cached attributes on success
+ * @return true if the section matched the cached one byte for byte
+ */
+static bool bgp_update_attr_cache_get(struct peer *peer, const uint8_t *raw,
+				      bgp_size_t len, struct attr *attr)
+{
+	struct bgp_attr_cache *ac = peer->rcvd_attr_cache;
+
+	if (!ac || ac->len != len || memcmp(ac->raw, raw, len))
+		return false;
+
+	*attr = ac->attr;
+	return true;
+}
+
+/**
+ * Hand the references held by a freshly parsed attr over to the cache.
+ *
+ * Attribute sets carrying MP_REACH/MP_UNREACH embed their NLRI and are not
+ * going to repeat, so they are not kept.
+ *
+ * @param peer
+ * @param raw start of the path attributes
+ * @param len total path attribute length
+ * @param attr attributes returned by bgp_attr_parse()
+ * @return true if the cache now owns attr's references
+ */
+static bool bgp_update_attr_cache_set(struct peer *peer, const uint8_t *raw,
+				      bgp_size_t len, struct attr *attr)
+{
+	struct bgp_attr_cache *ac;
+
+	if (attr->flag & (ATTR_FLAG_BIT(BGP_ATTR_MP_REACH_NLRI)
+			  | ATTR_FLAG_BIT(BGP_ATTR_MP_UNREACH_NLRI)))
+		return false;
+
+	ac = XMALLOC(MTYPE_BGP_ATTR_CACHE, sizeof(*ac) + len);
+	ac->attr = *attr;
+	ac->len = len;
+	memcpy(ac->raw, raw, len);
+	peer->rcvd_attr_cache = ac;
+
+	return true;
+}
+
 /**
  * Process BGP UPDATE message for peer.
  *
@@ -1380,6 +1466,7 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 	bgp_size_t attribute_len;
 	bgp_size_t update_len;
 	bgp_size_t withdraw_len;
+	bool attr_cached = false;
 
 	enum NLRI_TYPES {
 		NLRI_UPDATE,
@@ -1486,7 +1573,16 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 #define NLRI_ATTR_ARG (attr_parse_ret != BGP_ATTR_PARSE_WITHDRAW ? &attr : NULL)
 
 	/* Parse attribute when it exists. */
-	if (attribute_len) {
+	if (attribute_len
+	    && bgp_update_attr_cache_get(peer, stream_pnt(s), attribute_len,
+					 &attr)) {
+		attr_cached = true;
+		stream_forward_getp(s, attribute_len);
+	} else if (attribute_len) {
+		uint8_t *raw = stream_pnt(s);
+
+		bgp_update_attr_cache_flush(peer);
+
 		attr_parse_ret = bgp_attr_parse(peer, &attr, attribute_len,
 						&nlris[NLRI_MP_UPDATE],
 						&nlris[NLRI_MP_WITHDRAW]);
@@ -1494,6 +1590,9 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 			bgp_attr_unintern_sub(&attr);
 			return BGP_Stop;
 		}
+		if (attr_parse_ret == BGP_ATTR_PARSE_PROCEED)
+			attr_cached = bgp_update_attr_cache_set(
+				peer, raw, attribute_len, &attr);
 	}
 
 	/* Logging the attribute. */
@@ -1570,7 +1669,10 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 					i <= NLRI_WITHDRAW
 						? BGP_NOTIFY_UPDATE_INVAL_NETWORK
 						: BGP_NOTIFY_UPDATE_OPT_ATTR_ERR);
-			bgp_attr_unintern_sub(&attr);
+			if (attr_cached)
+				bgp_update_attr_cache_flush(peer);
+			else
+				bgp_attr_unintern_sub(&attr);
 			return BGP_Stop;
 		}
 	}
@@ -1623,8 +1725,9 @@ static int bgp_update_receive(struct peer *peer, bgp_size_t size)
 	}
 
 	/* Everything is done.  We unintern temporary structures which
-	   interned in bgp_attr_parse(). */
-	bgp_attr_unintern_sub(&attr);
+	   interned in bgp_attr_parse(), unless the cache now owns them. */
+	if (!attr_cached)
+		bgp_attr_unintern_sub(&attr);
 
 	peer->update_time = bgp_clock();
 
@@ -2182,11 +2285,7 @@ int bgp_process_packet(struct thread *thread)
 		bgp_size_t size;
 		char notify_data_length[2];
 
-		pthread_mutex_lock(&peer->io_mtx);
-		{
-			peer->curr = stream_fifo_pop(peer->ibuf);
-		}
-		pthread_mutex_unlock(&peer->io_mtx);
+		peer->curr = stream_fifo_pop(peer->ibuf);
 
 		if (peer->curr == NULL) // no packets to process, hmm...
 			return 0;
@@ -2201,6 +2300,7 @@ int bgp_process_packet(struct thread *thread)
 
 		/* BGP packet dump function. */
 		bgp_dump_packet(peer, type, peer->curr);
+		hook_call(bgp_packet_dump, peer, type, size, peer->curr);
 
 		/* adjust size to exclude the marker + length + type */
 		size -= BGP_HEADER_SIZE;
@@ -2221,7 +2321,9 @@ int bgp_process_packet(struct thread *thread)
 			atomic_fetch_add_explicit(&peer->update_in, 1,
 						  memory_order_relaxed);
 			peer->readtime = monotime(NULL);
+			bgp_pipeline_rx_usec = bgp_pipeline_rx(peer);
 			mprc = bgp_update_receive(peer, size);
+			bgp_pipeline_rx_usec = 0;
 			if (mprc == BGP_Stop)
 				zlog_err(
 					"%s: BGP UPDATE receipt failed for peer: %s",
@@ -2275,8 +2377,8 @@ int bgp_process_packet(struct thread *thread)
 			assert (!"Message of invalid type received during input processing");
 		}
 
-		/* delete processed packet */
-		stream_free(peer->curr);
+		/* recycle processed packet */
+		bgp_io_pkt_free(peer->curr);
 		peer->curr = NULL;
 		processed++;
 
@@ -2297,15 +2399,10 @@ int bgp_process_packet(struct thread *thread)
 
 	if (fsm_update_result != FSM_PEER_TRANSFERRED
 	    && fsm_update_result != FSM_PEER_STOPPED) {
-		pthread_mutex_lock(&peer->io_mtx);
-		{
-			// more work to do, come back later
-			if (peer->ibuf->count > 0)
-				thread_add_timer_msec(
-					bm->master, bgp_process_packet, peer, 0,
-					&peer->t_process_packet);
-		}
-		pthread_mutex_unlock(&peer->io_mtx);
+		// more work to do, come back later
+		if (stream_fifo_count(peer->ibuf) > 0)
+			thread_add_timer_msec(bm->master, bgp_process_packet,
+					      peer, 0, &peer->t_process_packet);
 	}
 
 	return 0;
@@ -64,4 +64,18 @@ extern int bgp_packet_set_size(struct stream *s);
 extern int bgp_generate_updgrp_packets(struct thread *);
 extern int bgp_process_packet(struct thread *);
 
+extern void bgp_update_attr_cache_flush(struct peer *);
+
+#include "hook.h"
+/* every packet received, before it is processed */
+DECLARE_HOOK(bgp_packet_dump,
+	     (struct peer *peer, uint8_t type, bgp_size_t size,
+	      struct stream *s),
+	     (peer, type, size, s))
+/* packets sent from the main pthread; for now only OPEN */
+DECLARE_HOOK(bgp_packet_send,
+	     (struct peer *peer, uint8_t type, bgp_size_t size,
+	      struct stream *s),
+	     (peer, type, size, s))
+
 #endif /* _QUAGGA_BGP_PACKET_H */
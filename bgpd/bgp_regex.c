@@ -79,7 +79,7 @@ regex_t *bgp_regcomp(const char *regstr)
 
 int bgp_regexec(regex_t *regex, struct aspath *aspath)
 {
-	return regexec(regex, aspath->str, 0, NULL, 0);
+	return regexec(regex, aspath_print(aspath), 0, NULL, 0);
 }
 
 void bgp_regex_free(regex_t *regex)
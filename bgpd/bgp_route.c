@@ -38,6 +38,8 @@
 #include "queue.h"
 #include "memory.h"
 #include "lib/json.h"
+#include "jhash.h"
+#include "slab.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
@@ -75,11 +77,18 @@
 #include "bgpd/bgp_evpn_vty.h"
 #include "bgpd/bgp_flowspec.h"
 #include "bgpd/bgp_flowspec_util.h"
+#include "trace.h"
 
 #ifndef VTYSH_EXTRACT_PL
 #include "bgpd/bgp_route_clippy.c"
 #endif
 
+DEFINE_MTYPE_STATIC(BGPD, BGP_SHOW_PART, "BGP show in progress")
+
+DEFINE_TRACEPOINT(BGP_UPDATE,
+		  "%P from %S, afi %U safi %U addpath %U, result %D")
+DEFINE_TRACEPOINT(BGP_WITHDRAW, "%P from %S, afi %U safi %U addpath %U")
+
 /* Extern from bgp_dump.c */
 extern const char *bgp_origin_str[];
 extern const char *bgp_origin_long_str[];
@@ -159,17 +168,26 @@ struct bgp_node *bgp_afi_node_lookup(struct bgp_table *table, afi_t afi,
 	return rn;
 }
 
+/* Per-path structures are by far the most numerous bgpd allocations, so
+ * they come out of slabs rather than one malloc each. */
+static struct slab *bgp_info_slab;
+static struct slab *bgp_info_extra_slab;
+
 /* Allocate bgp_info_extra */
 static struct bgp_info_extra *bgp_info_extra_new(void)
 {
 	struct bgp_info_extra *new;
-	new = XCALLOC(MTYPE_BGP_ROUTE_EXTRA, sizeof(struct bgp_info_extra));
+
+	if (!bgp_info_extra_slab)
+		bgp_info_extra_slab = slab_new(MTYPE_BGP_ROUTE_EXTRA,
+					       sizeof(struct bgp_info_extra));
+	new = slab_alloc(bgp_info_extra_slab);
 	new->label[0] = MPLS_INVALID_LABEL;
 	new->num_labels = 0;
 	return new;
 }
 
-static void bgp_info_extra_free(struct bgp_info_extra **extra)
+void bgp_info_extra_free(struct bgp_info_extra **extra)
 {
 	if (extra && *extra) {
 		if ((*extra)->damp_info)
@@ -177,7 +195,10 @@ static void bgp_info_extra_free(struct bgp_info_extra **extra)
 
 		(*extra)->damp_info = NULL;
 
-		XFREE(MTYPE_BGP_ROUTE_EXTRA, *extra);
+		if ((*extra)->aggregate_attr)
+			bgp_attr_unintern(&(*extra)->aggregate_attr);
+
+		slab_free(bgp_info_extra_slab, *extra);
 
 		*extra = NULL;
 	}
@@ -196,7 +217,16 @@ struct bgp_info_extra *bgp_info_extra_get(struct bgp_info *ri)
 /* Allocate new bgp info structure. */
 struct bgp_info *bgp_info_new(void)
 {
-	return XCALLOC(MTYPE_BGP_ROUTE, sizeof(struct bgp_info));
+	if (!bgp_info_slab)
+		bgp_info_slab =
+			slab_new(MTYPE_BGP_ROUTE, sizeof(struct bgp_info));
+	return slab_alloc(bgp_info_slab);
+}
+
+/* Release the memory of a bgp_info whose contents were already torn down. */
+void bgp_info_mem_free(struct bgp_info *binfo)
+{
+	slab_free(bgp_info_slab, binfo);
 }
 
 /* Free bgp route information. */
@@ -211,7 +241,7 @@ static void bgp_info_free(struct bgp_info *binfo)
 
 	peer_unlock(binfo->peer); /* bgp_info peer reference */
 
-	XFREE(MTYPE_BGP_ROUTE, binfo);
+	bgp_info_mem_free(binfo);
 }
 
 struct bgp_info *bgp_info_lock(struct bgp_info *binfo)
@@ -245,9 +275,12 @@ struct bgp_info *bgp_info_unlock(struct bgp_info *binfo)
 	return binfo;
 }
 
+/* The paths of a peer are also on a list of the peer, per afi/safi of the
+ * table they are in, for bgp_clear_route(). */
 void bgp_info_add(struct bgp_node *rn, struct bgp_info *ri)
 {
-	struct bgp_info *top;
+	struct bgp_table *table = bgp_node_table(rn);
+	struct bgp_info *top, **head;
 
 	top = rn->info;
 
@@ -255,8 +288,17 @@ void bgp_info_add(struct bgp_node *rn, struct bgp_info *ri)
 	ri->prev = NULL;
 	if (top)
 		top->prev = ri;
+	else if (rn->p.family == AF_FLOWSPEC)
+		bgp_flowspec_index_add(bgp_node_table(rn), rn);
 	rn->info = ri;
 
+	head = &ri->peer->routes[table->afi][table->safi];
+	ri->peer_prev = NULL;
+	ri->peer_next = *head;
+	if (*head)
+		(*head)->peer_prev = ri;
+	*head = ri;
+
 	bgp_info_lock(ri);
 	bgp_lock_node(rn);
 	peer_lock(ri->peer); /* bgp_info peer reference */
@@ -266,6 +308,15 @@ void bgp_info_add(struct bgp_node *rn, struct bgp_info *ri)
    completion callback *only* */
 void bgp_info_reap(struct bgp_node *rn, struct bgp_info *ri)
 {
+	struct bgp_table *table = bgp_node_table(rn);
+
+	if (ri->peer_next)
+		ri->peer_next->peer_prev = ri->peer_prev;
+	if (ri->peer_prev)
+		ri->peer_prev->peer_next = ri->peer_next;
+	else
+		ri->peer->routes[table->afi][table->safi] = ri->peer_next;
+
 	if (ri->next)
 		ri->next->prev = ri->prev;
 	if (ri->prev)
@@ -273,6 +324,9 @@ void bgp_info_reap(struct bgp_node *rn, struct bgp_info *ri)
 	else
 		rn->info = ri->next;
 
+	if (!rn->info && rn->p.family == AF_FLOWSPEC)
+		bgp_flowspec_index_del(bgp_node_table(rn), rn);
+
 	bgp_info_mpath_dequeue(ri);
 	bgp_info_unlock(ri);
 	bgp_unlock_node(rn);
@@ -1124,9 +1178,29 @@ static int bgp_cluster_filter(struct peer *peer, struct attr *attr)
 	return 0;
 }
 
+/* Keeps what the inbound route-map rules cached for a path. */
+static void bgp_info_rmap_extra_set(struct bgp_info *ri,
+				    struct bgp_info_extra *rmap_extra)
+{
+	struct bgp_info_extra *extra;
+
+	if (!ri->extra && !rmap_extra->rpki_state)
+		return;
+
+	extra = bgp_info_extra_get(ri);
+	extra->rpki_state = rmap_extra->rpki_state;
+	extra->rpki_origin_as = rmap_extra->rpki_origin_as;
+}
+
+/*
+ * The route-map rules are evaluated on a stand-in for the path; 'extra' (may
+ * be NULL) is what they see as its bgp_info_extra, so rules can cache state
+ * for the path in there.
+ */
 static int bgp_input_modifier(struct peer *peer, struct prefix *p,
 			      struct attr *attr, afi_t afi, safi_t safi,
-			      const char *rmap_name)
+			      const char *rmap_name,
+			      struct bgp_info_extra *extra)
 {
 	struct bgp_filter *filter;
 	struct bgp_info info;
@@ -1156,8 +1230,10 @@ static int bgp_input_modifier(struct peer *peer, struct prefix *p,
 	/* Route map apply. */
 	if (rmap) {
 		/* Duplicate current value to new strucutre for modification. */
+		memset(&info, 0, sizeof(info));
 		info.peer = peer;
 		info.attr = attr;
+		info.extra = extra;
 
 		SET_FLAG(peer->rmap_type, PEER_RMAP_TYPE_IN);
 
@@ -1209,6 +1285,7 @@ static int bgp_output_modifier(struct peer *peer, struct prefix *p,
 
 	/* Route map apply. */
 	/* Duplicate current value to new strucutre for modification. */
+	memset(&info, 0, sizeof(info));
 	info.peer = peer;
 	info.attr = attr;
 
@@ -1652,6 +1729,7 @@ int subgroup_announce_check(struct bgp_node *rn, struct bgp_info *ri,
 		struct bgp_info_extra dummy_info_extra;
 		struct attr dummy_attr;
 
+		memset(&info, 0, sizeof(info));
 		info.peer = peer;
 		info.attr = attr;
 
@@ -1680,7 +1758,29 @@ int subgroup_announce_check(struct bgp_node *rn, struct bgp_info *ri,
 		if (ri->extra && ri->extra->suppress)
 			ret = route_map_apply(UNSUPPRESS_MAP(filter), p,
 					      RMAP_BGP, &info);
-		else
+		else if (riattr->serial
+			 && !(reflect
+			      && !(riattr->flag
+				   & ATTR_FLAG_BIT(BGP_ATTR_ORIGINATOR_ID)))) {
+			/*
+			 * Which index matches depends on the interned
+			 * attribute and on what was changed in this copy on
+			 * behalf of the source above: the MED and nexthop
+			 * length, through self-origination, reflection and
+			 * route-server transparency.  Reflected routes given
+			 * the source's router-id as originator-id aren't
+			 * cached.
+			 */
+			uint64_t key = (riattr->serial << 3) | (reflect << 2)
+				       | ((from == bgp->peer_self) << 1)
+				       | transparent;
+
+			if (!subgrp->rmap_cache)
+				subgrp->rmap_cache = route_map_cache_new();
+			ret = route_map_apply_cached(subgrp->rmap_cache,
+						     ROUTE_MAP_OUT(filter), p,
+						     RMAP_BGP, &info, key);
+		} else
 			ret = route_map_apply(ROUTE_MAP_OUT(filter), p,
 					      RMAP_BGP, &info);
 
@@ -1786,6 +1886,249 @@ int subgroup_announce_check(struct bgp_node *rn, struct bgp_info *ri,
 	return 1;
 }
 
+/*
+ * Within one process queue item, large feeds hand us thousands of nodes
+ * whose candidate paths share the same attr and peer. bgp_info_cmp() only
+ * looks at those plus a few per-path fields, so its verdicts are kept for
+ * the duration of the item, keyed on everything it depends on.
+ */
+#define BGP_INFO_CMP_CACHE_SIZE 1024
+
+struct bgp_info_cmp_side {
+	struct attr *attr;
+	struct peer *peer;
+	uint32_t igpmetric;
+	uint16_t flags;
+	uint8_t type;
+	uint8_t sub_type;
+	int label;
+};
+
+struct bgp_info_cmp_verdict {
+	unsigned int gen;
+	struct bgp_info_cmp_side new;
+	struct bgp_info_cmp_side exist;
+	int ret;
+	int paths_eq;
+};
+
+static struct {
+	bool active;
+	unsigned int gen;
+	struct bgp *bgp;
+	afi_t afi;
+	safi_t safi;
+	struct bgp_info_cmp_verdict slots[BGP_INFO_CMP_CACHE_SIZE];
+} bgp_info_cmp_cache;
+
+static void bgp_info_cmp_cache_start(void)
+{
+	bgp_info_cmp_cache.active = true;
+	bgp_info_cmp_cache.gen++;
+	bgp_info_cmp_cache.bgp = NULL;
+}
+
+static void bgp_info_cmp_cache_stop(void)
+{
+	bgp_info_cmp_cache.active = false;
+}
+
+static void bgp_info_cmp_side_init(struct bgp_info_cmp_side *side,
+				   struct bgp_info *ri)
+{
+	memset(side, 0, sizeof(*side));
+	side->attr = ri->attr;
+	side->peer = ri->peer;
+	side->flags = ri->flags & (BGP_INFO_SELECTED | BGP_INFO_STALE);
+	side->type = ri->type;
+	side->sub_type = ri->sub_type;
+	if (ri->extra) {
+		side->igpmetric = ri->extra->igpmetric;
+		side->label = bgp_is_valid_label(&ri->extra->label[0]);
+	}
+}
+
+static int bgp_info_cmp_batched(struct bgp *bgp, struct bgp_info *new,
+				struct bgp_info *exist, int *paths_eq,
+				struct bgp_maxpaths_cfg *mpath_cfg, int debug,
+				char *pfx_buf, afi_t afi, safi_t safi)
+{
+	struct bgp_info_cmp_side nside, eside;
+	struct bgp_info_cmp_verdict *v;
+	unsigned int key;
+
+	if (!bgp_info_cmp_cache.active || debug || safi == SAFI_EVPN || !new
+	    || !exist)
+		return bgp_info_cmp(bgp, new, exist, paths_eq, mpath_cfg, debug,
+				    pfx_buf, afi, safi);
+
+	/* verdicts depend on per-instance and per-afi/safi config */
+	if (bgp_info_cmp_cache.bgp != bgp || bgp_info_cmp_cache.afi != afi
+	    || bgp_info_cmp_cache.safi != safi) {
+		bgp_info_cmp_cache.gen++;
+		bgp_info_cmp_cache.bgp = bgp;
+		bgp_info_cmp_cache.afi = afi;
+		bgp_info_cmp_cache.safi = safi;
+	}
+
+	bgp_info_cmp_side_init(&nside, new);
+	bgp_info_cmp_side_init(&eside, exist);
+
+	key = jhash_3words((uintptr_t)nside.attr, (uintptr_t)eside.attr,
+			   (uintptr_t)nside.peer ^ (uintptr_t)eside.peer, 0);
+	v = &bgp_info_cmp_cache.slots[key % BGP_INFO_CMP_CACHE_SIZE];
+
+	if (v->gen == bgp_info_cmp_cache.gen
+	    && !memcmp(&v->new, &nside, sizeof(nside))
+	    && !memcmp(&v->exist, &eside, sizeof(eside))) {
+		*paths_eq = v->paths_eq;
+		return v->ret;
+	}
+
+	v->ret = bgp_info_cmp(bgp, new, exist, &v->paths_eq, mpath_cfg, debug,
+			      pfx_buf, afi, safi);
+	v->gen = bgp_info_cmp_cache.gen;
+	memcpy(&v->new, &nside, sizeof(nside));
+	memcpy(&v->exist, &eside, sizeof(eside));
+	*paths_eq = v->paths_eq;
+
+	return v->ret;
+}
+
+/* A group of deterministic-med, see bgp_dmed_key(), and its best path. */
+struct bgp_dmed_group {
+	uint64_t key;
+	struct bgp_info *best;
+};
+
+#define BGP_DMED_KEY_NEIGHBOR (1ULL << 32)
+#define BGP_DMED_KEY_CONFED   (2ULL << 32)
+#define BGP_DMED_KEY_LOCAL    (3ULL << 32)
+
+/* groups on the stack for up to half as many paths */
+#define BGP_DMED_GROUPS_STACK 64
+
+/*
+ * The group of a path for deterministic-med: the neighbor AS it comes
+ * from, or if it has none its first confederation member AS, as
+ * aspath_cmp_left() and aspath_cmp_left_confed() match them.  Paths of the
+ * own AS make a group of their own; 0 is a path alone.
+ */
+static uint64_t bgp_dmed_key(struct bgp_info *ri)
+{
+	struct aspath *aspath = ri->attr->aspath;
+	struct assegment *seg;
+
+	if (!aspath)
+		return 0;
+	if (!aspath->segments)
+		return BGP_DMED_KEY_LOCAL;
+
+	for (seg = aspath->segments; seg; seg = seg->next)
+		if (seg->type != AS_CONFED_SEQUENCE
+		    && seg->type != AS_CONFED_SET)
+			break;
+	if (seg && seg->type == AS_SEQUENCE)
+		return BGP_DMED_KEY_NEIGHBOR | seg->as[0];
+
+	seg = aspath->segments;
+	if (seg->type == AS_CONFED_SEQUENCE)
+		return BGP_DMED_KEY_CONFED | seg->as[0];
+	return 0;
+}
+
+/* Whether the path takes part in the selection at all. */
+static bool bgp_best_eligible(struct bgp *bgp, struct bgp_info *ri)
+{
+	if (BGP_INFO_HOLDDOWN(ri))
+		return false;
+
+	/* Stale paths of a peer that is not up are used as during a
+	 * graceful restart, see bgp_rib_restore() */
+	if (ri->peer && ri->peer != bgp->peer_self
+	    && !CHECK_FLAG(ri->peer->sflags, PEER_STATUS_NSF_WAIT)
+	    && !CHECK_FLAG(ri->flags, BGP_INFO_STALE)
+	    && ri->peer->status != Established)
+		return false;
+
+	return true;
+}
+
+/*
+ * bgp deterministic-med: flags the best path of each group of paths from
+ * the same AS BGP_INFO_DMED_SELECTED, in one pass over the paths with the
+ * groups hashed on their key.  The paths of a group are compared in list
+ * order, as the best path is picked among the winners afterwards.
+ */
+static void bgp_dmed_select(struct bgp *bgp, struct bgp_node *rn,
+			    struct bgp_maxpaths_cfg *mpath_cfg, int debug,
+			    char *pfx_buf, afi_t afi, safi_t safi)
+{
+	struct bgp_dmed_group stack[BGP_DMED_GROUPS_STACK];
+	struct bgp_dmed_group *groups = stack, *g;
+	struct bgp_info *ri;
+	char path_buf[PATH_ADDPATH_STR_BUFFER];
+	unsigned int n = 0, size, mask, i;
+	int paths_eq;
+	uint64_t key;
+
+	for (ri = rn->info; ri; ri = ri->next) {
+		bgp_info_unset_flag(rn, ri, BGP_INFO_DMED_SELECTED);
+		n++;
+	}
+
+	for (size = BGP_DMED_GROUPS_STACK; size < 2 * n; size *= 2)
+		;
+	if (size > BGP_DMED_GROUPS_STACK)
+		groups = XCALLOC(MTYPE_TMP, size * sizeof(*groups));
+	else
+		memset(stack, 0, sizeof(stack));
+	mask = size - 1;
+
+	for (ri = rn->info; ri; ri = ri->next) {
+		if (!bgp_best_eligible(bgp, ri))
+			continue;
+
+		key = bgp_dmed_key(ri);
+		if (!key) {
+			bgp_info_set_flag(rn, ri, BGP_INFO_DMED_SELECTED);
+			continue;
+		}
+
+		i = jhash_2words(key >> 32, key, 0) & mask;
+		while (groups[i].best && groups[i].key != key)
+			i = (i + 1) & mask;
+		g = &groups[i];
+
+		if (!g->best) {
+			g->key = key;
+			g->best = ri;
+		} else if (bgp_info_cmp_batched(bgp, ri, g->best, &paths_eq,
+						mpath_cfg, debug, pfx_buf, afi,
+						safi))
+			g->best = ri;
+	}
+
+	for (i = 0; i < size; i++) {
+		if (!groups[i].best)
+			continue;
+
+		bgp_info_set_flag(rn, groups[i].best, BGP_INFO_DMED_SELECTED);
+
+		if (debug) {
+			bgp_info_path_with_addpath_rx_str(groups[i].best,
+							  path_buf);
+			zlog_debug("%s: %s is the bestpath from AS %d", pfx_buf,
+				   path_buf,
+				   aspath_get_first_as(
+					   groups[i].best->attr->aspath));
+		}
+	}
+
+	if (groups != stack)
+		XFREE(MTYPE_TMP, groups);
+}
+
 void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn,
 			struct bgp_maxpaths_cfg *mpath_cfg,
 			struct bgp_info_pair *result, afi_t afi, safi_t safi)
@@ -1793,8 +2136,6 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn,
 	struct bgp_info *new_select;
 	struct bgp_info *old_select;
 	struct bgp_info *ri;
-	struct bgp_info *ri1;
-	struct bgp_info *ri2;
 	struct bgp_info *nextri = NULL;
 	int paths_eq, do_mpath, debug;
 	struct list mp_list;
@@ -1811,76 +2152,8 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn,
 		prefix2str(&rn->p, pfx_buf, sizeof(pfx_buf));
 
 	/* bgp deterministic-med */
-	new_select = NULL;
-	if (bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED)) {
-
-		/* Clear BGP_INFO_DMED_SELECTED for all paths */
-		for (ri1 = rn->info; ri1; ri1 = ri1->next)
-			bgp_info_unset_flag(rn, ri1, BGP_INFO_DMED_SELECTED);
-
-		for (ri1 = rn->info; ri1; ri1 = ri1->next) {
-			if (CHECK_FLAG(ri1->flags, BGP_INFO_DMED_CHECK))
-				continue;
-			if (BGP_INFO_HOLDDOWN(ri1))
-				continue;
-			if (ri1->peer && ri1->peer != bgp->peer_self)
-				if (ri1->peer->status != Established)
-					continue;
-
-			new_select = ri1;
-			if (ri1->next) {
-				for (ri2 = ri1->next; ri2; ri2 = ri2->next) {
-					if (CHECK_FLAG(ri2->flags,
-						       BGP_INFO_DMED_CHECK))
-						continue;
-					if (BGP_INFO_HOLDDOWN(ri2))
-						continue;
-					if (ri2->peer
-					    && ri2->peer != bgp->peer_self
-					    && !CHECK_FLAG(
-						       ri2->peer->sflags,
-						       PEER_STATUS_NSF_WAIT))
-						if (ri2->peer->status
-						    != Established)
-							continue;
-
-					if (aspath_cmp_left(ri1->attr->aspath,
-							    ri2->attr->aspath)
-					    || aspath_cmp_left_confed(
-						       ri1->attr->aspath,
-						       ri2->attr->aspath)) {
-						if (bgp_info_cmp(bgp, ri2,
-								 new_select,
-								 &paths_eq,
-								 mpath_cfg,
-								 debug, pfx_buf,
-								 afi, safi)) {
-							bgp_info_unset_flag(
-								rn, new_select,
-								BGP_INFO_DMED_SELECTED);
-							new_select = ri2;
-						}
-
-						bgp_info_set_flag(
-							rn, ri2,
-							BGP_INFO_DMED_CHECK);
-					}
-				}
-			}
-			bgp_info_set_flag(rn, new_select, BGP_INFO_DMED_CHECK);
-			bgp_info_set_flag(rn, new_select,
-					  BGP_INFO_DMED_SELECTED);
-
-			if (debug) {
-				bgp_info_path_with_addpath_rx_str(new_select,
-								  path_buf);
-				zlog_debug("%s: %s is the bestpath from AS %d",
-					   pfx_buf, path_buf,
-					   aspath_get_first_as(
-						   new_select->attr->aspath));
-			}
-		}
-	}
+	if (bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED))
+		bgp_dmed_select(bgp, rn, mpath_cfg, debug, pfx_buf, afi, safi);
 
 	/* Check old selected route and new selected route. */
 	old_select = NULL;
@@ -1905,30 +2178,25 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn,
 			continue;
 		}
 
-		if (ri->peer && ri->peer != bgp->peer_self
-		    && !CHECK_FLAG(ri->peer->sflags, PEER_STATUS_NSF_WAIT))
-			if (ri->peer->status != Established) {
-
-				if (debug)
-					zlog_debug(
-						"%s: ri %p non self peer %s not estab state",
-						__func__, ri, ri->peer->host);
+		if (!bgp_best_eligible(bgp, ri)) {
+			if (debug)
+				zlog_debug(
+					"%s: ri %p non self peer %s not estab state",
+					__func__, ri, ri->peer->host);
 
-				continue;
-			}
+			continue;
+		}
 
 		if (bgp_flag_check(bgp, BGP_FLAG_DETERMINISTIC_MED)
 		    && (!CHECK_FLAG(ri->flags, BGP_INFO_DMED_SELECTED))) {
-			bgp_info_unset_flag(rn, ri, BGP_INFO_DMED_CHECK);
 			if (debug)
 				zlog_debug("%s: ri %p dmed", __func__, ri);
 			continue;
 		}
 
-		bgp_info_unset_flag(rn, ri, BGP_INFO_DMED_CHECK);
-
-		if (bgp_info_cmp(bgp, ri, new_select, &paths_eq, mpath_cfg,
-				 debug, pfx_buf, afi, safi)) {
+		if (bgp_info_cmp_batched(bgp, ri, new_select, &paths_eq,
+					 mpath_cfg, debug, pfx_buf, afi,
+					 safi)) {
 			new_select = ri;
 		}
 	}
@@ -1969,7 +2237,8 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn,
 
 			if (ri->peer && ri->peer != bgp->peer_self
 			    && !CHECK_FLAG(ri->peer->sflags,
-					   PEER_STATUS_NSF_WAIT))
+					   PEER_STATUS_NSF_WAIT)
+			    && !CHECK_FLAG(ri->flags, BGP_INFO_STALE))
 				if (ri->peer->status != Established)
 					continue;
 
@@ -1981,8 +2250,9 @@ void bgp_best_selection(struct bgp *bgp, struct bgp_node *rn,
 				continue;
 			}
 
-			bgp_info_cmp(bgp, ri, new_select, &paths_eq, mpath_cfg,
-				     debug, pfx_buf, afi, safi);
+			bgp_info_cmp_batched(bgp, ri, new_select, &paths_eq,
+					     mpath_cfg, debug, pfx_buf, afi,
+					     safi);
 
 			if (paths_eq) {
 				if (debug)
@@ -2361,6 +2631,90 @@ static void bgp_process_main_one(struct bgp *bgp, struct bgp_node *rn,
 	return;
 }
 
+struct pipeline_stage bgp_pipeline[BGP_PIPELINE_STAGES] = {
+	[BGP_PIPELINE_QUEUE] = {"queue", "UPDATE read, until best path run"},
+	[BGP_PIPELINE_BESTPATH] = {"bestpath", "Best path run, until zapi sent"},
+	[BGP_PIPELINE_TOTAL] = {"total", "UPDATE read, until zapi sent"},
+};
+
+int64_t bgp_pipeline_rx_usec;
+
+/* node whose best path is being run, and when that started, if timed */
+static struct bgp_node *bgp_pipeline_rn;
+static int64_t bgp_pipeline_start_usec;
+
+/*
+ * Reads are only timestamped when no earlier one is waiting, so UPDATEs
+ * take the time of the oldest read not seen yet, or else of the last one
+ * seen.  Packets read later than that look older than they are.
+ */
+int64_t bgp_pipeline_rx(struct peer *peer)
+{
+	int64_t rx;
+
+	if (!atomic_load_explicit(&bm->pipeline_sample, memory_order_relaxed))
+		return 0;
+
+	rx = atomic_exchange_explicit(&peer->ibuf_rx_usec, 0,
+				      memory_order_relaxed);
+	if (rx)
+		peer->rx_usec = rx;
+	return peer->rx_usec;
+}
+
+/* Forgets read times kept while sampling was off */
+void bgp_pipeline_reset(void)
+{
+	struct listnode *node, *pnode;
+	struct bgp *bgp;
+	struct peer *peer;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp))
+		for (ALL_LIST_ELEMENTS_RO(bgp->peer, pnode, peer)) {
+			atomic_store_explicit(&peer->ibuf_rx_usec, 0,
+					      memory_order_relaxed);
+			peer->rx_usec = 0;
+		}
+}
+
+static void bgp_pipeline_sample(struct bgp_node *rn)
+{
+	static uint32_t skipped;
+	uint32_t sample;
+
+	sample = atomic_load_explicit(&bm->pipeline_sample,
+				      memory_order_relaxed);
+	if (!sample || ++skipped < sample)
+		return;
+
+	skipped = 0;
+	rn->pipeline_stamp = (uint32_t)bgp_pipeline_rx_usec | 1;
+}
+
+/* 64 bit time of a stamp, which is less than 71 minutes old */
+static int64_t bgp_pipeline_stamp_usec(uint32_t stamp, int64_t now)
+{
+	return now - (uint32_t)((uint32_t)now - stamp);
+}
+
+int64_t bgp_pipeline_announce(struct bgp_node *rn)
+{
+	int64_t now, rx;
+
+	if (rn != bgp_pipeline_rn || !rn->pipeline_stamp)
+		return 0;
+
+	now = pipeline_now();
+	rx = bgp_pipeline_stamp_usec(rn->pipeline_stamp, now);
+	pipeline_stage_add(&bgp_pipeline[BGP_PIPELINE_BESTPATH],
+			   now - bgp_pipeline_start_usec);
+	pipeline_stage_add(&bgp_pipeline[BGP_PIPELINE_TOTAL], now - rx);
+
+	/* once per run, even if announced to several tables */
+	rn->pipeline_stamp = 0;
+	return rx;
+}
+
 static wq_item_status bgp_process_wq(struct work_queue *wq, void *data)
 {
 	struct bgp_process_queue *pqnode = data;
@@ -2376,18 +2730,35 @@ static wq_item_status bgp_process_wq(struct work_queue *wq, void *data)
 		return WQ_SUCCESS;
 	}
 
+	bgp_info_cmp_cache_start();
+
 	while (!STAILQ_EMPTY(&pqnode->pqueue)) {
 		rn = STAILQ_FIRST(&pqnode->pqueue);
 		STAILQ_REMOVE_HEAD(&pqnode->pqueue, pq);
 		STAILQ_NEXT(rn, pq) = NULL; /* complete unlink */
 		table = bgp_node_table(rn);
+		if (rn->pipeline_stamp) {
+			bgp_pipeline_start_usec = pipeline_now();
+			pipeline_stage_add(
+				&bgp_pipeline[BGP_PIPELINE_QUEUE],
+				bgp_pipeline_start_usec
+					- bgp_pipeline_stamp_usec(
+						  rn->pipeline_stamp,
+						  bgp_pipeline_start_usec));
+			bgp_pipeline_rn = rn;
+		}
 		/* note, new RNs may be added as part of processing */
 		bgp_process_main_one(bgp, rn, table->afi, table->safi);
+		/* not timed further if not announced to zebra */
+		rn->pipeline_stamp = 0;
+		bgp_pipeline_rn = NULL;
 
 		bgp_unlock_node(rn);
 		bgp_table_unlock(table);
 	}
 
+	bgp_info_cmp_cache_stop();
+
 	return WQ_SUCCESS;
 }
 
@@ -2441,6 +2812,10 @@ void bgp_process(struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
 	struct bgp_process_queue *pqnode;
 	int pqnode_reuse = 0;
 
+	/* time a sample of the prefixes UPDATEs bring in */
+	if (bgp_pipeline_rx_usec && !rn->pipeline_stamp)
+		bgp_pipeline_sample(rn);
+
 	/* already scheduled for processing? */
 	if (CHECK_FLAG(rn->flags, BGP_NODE_PROCESS_SCHEDULED))
 		return;
@@ -2670,7 +3045,7 @@ struct bgp_info *info_make(int type, int sub_type, unsigned short instance,
 	struct bgp_info *new;
 
 	/* Make new BGP info. */
-	new = XCALLOC(MTYPE_BGP_ROUTE, sizeof(struct bgp_info));
+	new = bgp_info_new();
 	new->type = type;
 	new->instance = instance;
 	new->sub_type = sub_type;
@@ -2791,11 +3166,12 @@ static int bgp_update_martian_nexthop(struct bgp *bgp, afi_t afi, safi_t safi,
 	return ret;
 }
 
-int bgp_update(struct peer *peer, struct prefix *p, uint32_t addpath_id,
-	       struct attr *attr, afi_t afi, safi_t safi, int type,
-	       int sub_type, struct prefix_rd *prd, mpls_label_t *label,
-	       uint32_t num_labels, int soft_reconfig,
-	       struct bgp_route_evpn *evpn)
+static int bgp_update_main(struct peer *peer, struct prefix *p,
+			   uint32_t addpath_id, struct attr *attr, afi_t afi,
+			   safi_t safi, int type, int sub_type,
+			   struct prefix_rd *prd, mpls_label_t *label,
+			   uint32_t num_labels, int soft_reconfig,
+			   struct bgp_route_evpn *evpn)
 {
 	int ret;
 	int aspath_loop_count = 0;
@@ -2806,6 +3182,7 @@ int bgp_update(struct peer *peer, struct prefix *p, uint32_t addpath_id,
 	struct bgp_info *ri;
 	struct bgp_info *new;
 	struct bgp_info_extra *extra;
+	struct bgp_info_extra rmap_extra;
 	const char *reason;
 	char pfx_buf[BGP_PRD_PATH_STRLEN];
 	int connected = 0;
@@ -2904,12 +3281,20 @@ int bgp_update(struct peer *peer, struct prefix *p, uint32_t addpath_id,
 	 * commands, so we need bgp_attr_flush in the error paths, until we
 	 * intern
 	 * the attr (which takes over the memory references) */
-	if (bgp_input_modifier(peer, p, &new_attr, afi, safi, NULL)
+	memset(&rmap_extra, 0, sizeof(rmap_extra));
+	if (ri && ri->extra) {
+		rmap_extra.rpki_state = ri->extra->rpki_state;
+		rmap_extra.rpki_origin_as = ri->extra->rpki_origin_as;
+	}
+	if (bgp_input_modifier(peer, p, &new_attr, afi, safi, NULL,
+			       &rmap_extra)
 	    == RMAP_DENY) {
 		reason = "route-map;";
 		bgp_attr_flush(&new_attr);
 		goto filtered;
 	}
+	if (ri)
+		bgp_info_rmap_extra_set(ri, &rmap_extra);
 
 	if (peer->sort == BGP_PEER_EBGP) {
 
@@ -3284,6 +3669,7 @@ int bgp_update(struct peer *peer, struct prefix *p, uint32_t addpath_id,
 
 	/* Make new BGP info. */
 	new = info_make(type, sub_type, 0, peer, attr_new, rn);
+	bgp_info_rmap_extra_set(new, &rmap_extra);
 
 	/* Update MPLS label */
 	if (has_valid_label) {
@@ -3448,6 +3834,36 @@ filtered:
 	return 0;
 }
 
+int bgp_update(struct peer *peer, struct prefix *p, uint32_t addpath_id,
+	       struct attr *attr, afi_t afi, safi_t safi, int type,
+	       int sub_type, struct prefix_rd *prd, mpls_label_t *label,
+	       uint32_t num_labels, int soft_reconfig,
+	       struct bgp_route_evpn *evpn)
+{
+	struct bgp_node *rn;
+	int ret;
+
+	ret = bgp_update_main(peer, p, addpath_id, attr, afi, safi, type,
+			      sub_type, prd, label, num_labels, soft_reconfig,
+			      evpn);
+	trace_event(BGP_UPDATE, p, peer->host, afi, safi, addpath_id, ret);
+
+	/* Adj-RIB-In entries the accepted path stands in for */
+	if (ret < 0 || type != ZEBRA_ROUTE_BGP || sub_type != BGP_ROUTE_NORMAL
+	    || (safi != SAFI_UNICAST && safi != SAFI_MULTICAST)
+	    || !CHECK_FLAG(peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
+	    || peer == peer->bgp->peer_self)
+		return ret;
+
+	rn = bgp_afi_node_lookup(peer->bgp->rib[afi][safi], afi, safi, p, prd);
+	if (rn) {
+		bgp_adj_in_compact(rn, peer, addpath_id);
+		bgp_unlock_node(rn);
+	}
+
+	return ret;
+}
+
 int bgp_withdraw(struct peer *peer, struct prefix *p, uint32_t addpath_id,
 		 struct attr *attr, afi_t afi, safi_t safi, int type,
 		 int sub_type, struct prefix_rd *prd, mpls_label_t *label,
@@ -3465,6 +3881,8 @@ int bgp_withdraw(struct peer *peer, struct prefix *p, uint32_t addpath_id,
 	}
 #endif
 
+	trace_event(BGP_WITHDRAW, p, peer->host, afi, safi, addpath_id);
+
 	bgp = peer->bgp;
 
 	/* Lookup node. */
@@ -3636,66 +4054,105 @@ void bgp_announce_route_all(struct peer *peer)
 		bgp_announce_route(peer, afi, safi);
 }
 
-static void bgp_soft_reconfig_table(struct peer *peer, afi_t afi, safi_t safi,
-				    struct bgp_table *table,
-				    struct prefix_rd *prd)
+static int bgp_soft_reconfig_node(struct peer *peer, afi_t afi, safi_t safi,
+				  struct bgp_node *rn, struct prefix_rd *prd)
 {
 	int ret;
-	struct bgp_node *rn;
-	struct bgp_adj_in *ain;
+	struct bgp_adj_in *ain, *next;
 
-	if (!table)
-		table = peer->bgp->rib[afi][safi];
+	bgp_adj_in_expand(rn, peer);
 
-	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn))
-		for (ain = rn->adj_in; ain; ain = ain->next) {
-			if (ain->peer != peer)
-				continue;
+	/* bgp_update() may drop ain again, see bgp_adj_in_compact() */
+	for (ain = rn->adj_in; ain; ain = next) {
+		next = ain->next;
+		if (ain->peer != peer)
+			continue;
 
-			struct bgp_info *ri = rn->info;
-			uint32_t num_labels = 0;
-			mpls_label_t *label_pnt = NULL;
+		struct bgp_info *ri = rn->info;
+		uint32_t num_labels = 0;
+		mpls_label_t *label_pnt = NULL;
 
-			if (ri && ri->extra)
-				num_labels = ri->extra->num_labels;
-			if (num_labels)
-				label_pnt = &ri->extra->label[0];
+		if (ri && ri->extra)
+			num_labels = ri->extra->num_labels;
+		if (num_labels)
+			label_pnt = &ri->extra->label[0];
 
-			ret = bgp_update(peer, &rn->p, ain->addpath_rx_id,
-					 ain->attr, afi, safi, ZEBRA_ROUTE_BGP,
-					 BGP_ROUTE_NORMAL, prd, label_pnt,
-					 num_labels, 1, NULL);
+		ret = bgp_update(peer, &rn->p, ain->addpath_rx_id, ain->attr,
+				 afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+				 prd, label_pnt, num_labels, 1, NULL);
 
-			if (ret < 0) {
-				bgp_unlock_node(rn);
-				return;
-			}
-		}
+		if (ret < 0)
+			return ret;
+	}
+	return 0;
 }
 
-void bgp_soft_reconfig_in(struct peer *peer, afi_t afi, safi_t safi)
+static void bgp_soft_reconfig_table(struct peer *peer, afi_t afi, safi_t safi,
+				    struct bgp_table *table,
+				    struct prefix_rd *prd)
 {
 	struct bgp_node *rn;
-	struct bgp_table *table;
 
+	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn))
+		if (bgp_soft_reconfig_node(peer, afi, safi, rn, prd) < 0) {
+			bgp_unlock_node(rn);
+			return;
+		}
+}
+
+/*
+ * The walk visits the nodes of bgp->rib; in two-level tables every node
+ * holds the table of one route distinguisher, which is done in one go.
+ */
+static int bgp_soft_reconfig_walk(struct route_node *node, void *arg)
+{
+	struct peer *peer = arg;
+	struct bgp_node *rn = bgp_node_from_rnode(node);
+	afi_t afi = bgp_node_table(rn)->afi;
+	safi_t safi = bgp_node_table(rn)->safi;
+	struct prefix_rd prd;
+
+	/* the session went down meanwhile, taking the adj-in with it */
 	if (peer->status != Established)
-		return;
+		return 1;
 
 	if ((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP)
 	    && (safi != SAFI_EVPN))
-		bgp_soft_reconfig_table(peer, afi, safi, NULL, NULL);
-	else
-		for (rn = bgp_table_top(peer->bgp->rib[afi][safi]); rn;
-		     rn = bgp_route_next(rn))
-			if ((table = rn->info) != NULL) {
-				struct prefix_rd prd;
-				prd.family = AF_UNSPEC;
-				prd.prefixlen = 64;
-				memcpy(&prd.val, rn->p.u.val, 8);
-
-				bgp_soft_reconfig_table(peer, afi, safi, table,
-							&prd);
-			}
+		return bgp_soft_reconfig_node(peer, afi, safi, rn, NULL) < 0;
+
+	if (rn->info) {
+		prd.family = AF_UNSPEC;
+		prd.prefixlen = 64;
+		memcpy(&prd.val, rn->p.u.val, 8);
+
+		bgp_soft_reconfig_table(peer, afi, safi, rn->info, &prd);
+	}
+	return 0;
+}
+
+static void bgp_soft_reconfig_done(void *arg)
+{
+	struct peer *peer = arg;
+
+	peer_unlock(peer); /* bgp_soft_reconfig_in */
+}
+
+void bgp_soft_reconfig_in(struct peer *peer, afi_t afi, safi_t safi)
+{
+	struct bgp_table *table = peer->bgp->rib[afi][safi];
+
+	if (peer->status != Established)
+		return;
+
+	/* start over, the policy changed again for the nodes already done */
+	if (peer->t_soft_reconfig[afi][safi])
+		route_table_walk_cancel(&peer->t_soft_reconfig[afi][safi]);
+	else
+		peer_lock(peer); /* bgp_soft_reconfig_done */
+
+	route_table_walk_start(bm->master, table->route_table,
+			       bgp_soft_reconfig_walk, bgp_soft_reconfig_done,
+			       peer, &peer->t_soft_reconfig[afi][safi]);
 }
 
 
@@ -3768,6 +4225,14 @@ static void bgp_clear_node_complete(struct work_queue *wq)
 {
 	struct peer *peer = wq->spec.data;
 
+	/* a whole peer's worth of paths is gone, hand emptied slab chunks
+	 * back */
+	if (bgp_info_slab)
+		slab_reclaim(bgp_info_slab);
+	if (bgp_info_extra_slab)
+		slab_reclaim(bgp_info_extra_slab);
+	bgp_adj_in_reclaim();
+
 	/* Tickle FSM to start moving again */
 	BGP_EVENT_ADD(peer, Clearing_Completed);
 
@@ -3797,100 +4262,103 @@ static void bgp_clear_node_queue_init(struct peer *peer)
 	peer->clear_node_queue->spec.data = peer;
 }
 
-static void bgp_clear_route_table(struct peer *peer, afi_t afi, safi_t safi,
-				  struct bgp_table *table)
+/*
+ * Whether the node is in the RIB of the peer's afi/safi, or one of its RD
+ * tables; those the peer's lists hold besides it, e.g. EVPN VNI tables and
+ * the RIBs of other instances, are not the peer's to clear.
+ */
+static bool bgp_clear_route_owned(struct bgp_table *table,
+				  struct bgp_node *rn)
 {
-	struct bgp_node *rn;
-	int force = bm->process_main_queue ? 0 : 1;
+	if (rn->prn)
+		return bgp_node_table(rn->prn) == table;
+	return bgp_node_table(rn) == table;
+}
 
-	if (!table)
-		table = peer->bgp->rib[afi][safi];
+/*
+ * Queues the node for bgp_clear_route_node(), once for all the paths the
+ * peer has in it, when ri is the first of them.
+ */
+static void bgp_clear_route_queue(struct peer *peer, struct bgp_info *ri)
+{
+	struct bgp_node *rn = ri->net;
+	struct bgp_clear_node_queue *cnq;
+	struct bgp_info *prev;
 
-	/* If still no table => afi/safi isn't configured at all or smth. */
-	if (!table)
-		return;
+	for (prev = rn->info; prev != ri; prev = prev->next)
+		if (prev->peer == peer)
+			return;
 
-	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		struct bgp_info *ri, *next;
-		struct bgp_adj_in *ain;
-		struct bgp_adj_in *ain_next;
-
-		/* XXX:TODO: This is suboptimal, every non-empty route_node is
-		 * queued for every clearing peer, regardless of whether it is
-		 * relevant to the peer at hand.
-		 *
-		 * Overview: There are 3 different indices which need to be
-		 * scrubbed, potentially, when a peer is removed:
-		 *
-		 * 1 peer's routes visible via the RIB (ie accepted routes)
-		 * 2 peer's routes visible by the (optional) peer's adj-in index
-		 * 3 other routes visible by the peer's adj-out index
-		 *
-		 * 3 there is no hurry in scrubbing, once the struct peer is
-		 * removed from bgp->peer, we could just GC such deleted peer's
-		 * adj-outs at our leisure.
-		 *
-		 * 1 and 2 must be 'scrubbed' in some way, at least made
-		 * invisible via RIB index before peer session is allowed to be
-		 * brought back up. So one needs to know when such a 'search' is
-		 * complete.
-		 *
-		 * Ideally:
-		 *
-		 * - there'd be a single global queue or a single RIB walker
-		 * - rather than tracking which route_nodes still need to be
-		 *   examined on a peer basis, we'd track which peers still
-		 *   aren't cleared
-		 *
-		 * Given that our per-peer prefix-counts now should be reliable,
-		 * this may actually be achievable. It doesn't seem to be a huge
-		 * problem at this time,
-		 *
-		 * It is possible that we have multiple paths for a prefix from
-		 * a peer
-		 * if that peer is using AddPath.
-		 */
-		ain = rn->adj_in;
-		while (ain) {
-			ain_next = ain->next;
+	/* the peer is locked while the queue is busy, and
+	 * unlocked in bgp_clear_node_complete */
+	if (!work_queue_is_scheduled(peer->clear_node_queue))
+		peer_lock(peer);
 
-			if (ain->peer == peer) {
-				bgp_adj_in_remove(rn, ain);
-				bgp_unlock_node(rn);
-			}
+	/* both unlocked in bgp_clear_node_queue_del */
+	bgp_table_lock(bgp_node_table(rn));
+	bgp_lock_node(rn);
+	cnq = XCALLOC(MTYPE_BGP_CLEAR_NODE_QUEUE,
+		      sizeof(struct bgp_clear_node_queue));
+	cnq->rn = rn;
+	work_queue_add(peer->clear_node_queue, cnq);
+}
 
-			ain = ain_next;
-		}
+/* Drops the adj-ins of the peer in the table, and unflags its paths. */
+static void bgp_clear_adj_in_table(struct peer *peer, struct bgp_table *table,
+				   afi_t afi, safi_t safi)
+{
+	struct bgp_node *rn;
+	struct bgp_adj_in *ain;
+	struct bgp_adj_in *ain_next;
+	struct bgp_info *ri;
 
-		for (ri = rn->info; ri; ri = next) {
-			next = ri->next;
-			if (ri->peer != peer)
-				continue;
+	for (ain = peer->adj_in[afi][safi]; ain; ain = ain_next) {
+		ain_next = ain->peer_next;
+		rn = ain->rn;
+		if (!bgp_clear_route_owned(table, rn))
+			continue;
 
-			if (force)
-				bgp_info_reap(rn, ri);
-			else {
-				struct bgp_clear_node_queue *cnq;
-
-				/* both unlocked in bgp_clear_node_queue_del */
-				bgp_table_lock(bgp_node_table(rn));
-				bgp_lock_node(rn);
-				cnq = XCALLOC(
-					MTYPE_BGP_CLEAR_NODE_QUEUE,
-					sizeof(struct bgp_clear_node_queue));
-				cnq->rn = rn;
-				work_queue_add(peer->clear_node_queue, cnq);
-				break;
-			}
-		}
+		bgp_adj_in_remove(rn, ain);
+		bgp_unlock_node(rn);
 	}
-	return;
+
+	for (ri = peer->routes[afi][safi]; ri; ri = ri->peer_next)
+		if (bgp_clear_route_owned(table, ri->net))
+			UNSET_FLAG(ri->flags, BGP_INFO_ADJ_IN);
 }
 
+/* Whether routes of the peer are still to be cleared. */
+bool bgp_clear_route_pending(struct peer *peer)
+{
+	return peer->clear_node_queue
+	       && work_queue_is_scheduled(peer->clear_node_queue);
+}
+
+/*
+ * There are 3 different indices which need to be scrubbed, potentially,
+ * when a peer is removed:
+ *
+ * 1 peer's routes visible via the RIB (ie accepted routes)
+ * 2 peer's routes visible by the (optional) peer's adj-in index
+ * 3 other routes visible by the peer's adj-out index
+ *
+ * 3 there is no hurry in scrubbing, once the struct peer is removed from
+ * bgp->peer, we could just GC such deleted peer's adj-outs at our leisure.
+ *
+ * 1 and 2 must be 'scrubbed' in some way, at least made invisible via RIB
+ * index before peer session is allowed to be brought back up.  Both are
+ * found through the lists of the peer, the adj-ins go at once and the
+ * nodes with paths of the peer are queued; it is possible that we have
+ * multiple paths for a prefix from a peer if that peer is using AddPath.
+ */
 void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi)
 {
-	struct bgp_node *rn;
-	struct bgp_table *table;
+	struct bgp_table *table = peer->bgp->rib[afi][safi];
+	struct bgp_info *ri, *next;
+
+	/* If no table => afi/safi isn't configured at all or smth. */
+	if (!table)
+		return;
 
 	if (peer->clear_node_queue == NULL)
 		bgp_clear_node_queue_init(peer);
@@ -3907,25 +4375,19 @@ void bgp_clear_route(struct peer *peer, afi_t afi, safi_t safi)
 	 *    on the process_main queue. Fast-flapping could cause that queue
 	 *    to grow and grow.
 	 */
+	bgp_clear_adj_in_table(peer, table, afi, safi);
 
-	/* lock peer in assumption that clear-node-queue will get nodes; if so,
-	 * the unlock will happen upon work-queue completion; other wise, the
-	 * unlock happens at the end of this function.
-	 */
-	if (!peer->clear_node_queue->thread)
-		peer_lock(peer);
-
-	if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN)
-		bgp_clear_route_table(peer, afi, safi, NULL);
-	else
-		for (rn = bgp_table_top(peer->bgp->rib[afi][safi]); rn;
-		     rn = bgp_route_next(rn))
-			if ((table = rn->info) != NULL)
-				bgp_clear_route_table(peer, afi, safi, table);
+	for (ri = peer->routes[afi][safi]; ri; ri = next) {
+		next = ri->peer_next;
+		if (!bgp_clear_route_owned(table, ri->net))
+			continue;
 
-	/* unlock if no nodes got added to the clear-node-queue. */
-	if (!peer->clear_node_queue->thread)
-		peer_unlock(peer);
+		/* No more events to queue for when shutting down. */
+		if (!bm->process_main_queue)
+			bgp_info_reap(ri->net, ri);
+		else
+			bgp_clear_route_queue(peer, ri);
+	}
 }
 
 void bgp_clear_route_all(struct peer *peer)
@@ -3943,30 +4405,7 @@ void bgp_clear_route_all(struct peer *peer)
 
 void bgp_clear_adj_in(struct peer *peer, afi_t afi, safi_t safi)
 {
-	struct bgp_table *table;
-	struct bgp_node *rn;
-	struct bgp_adj_in *ain;
-	struct bgp_adj_in *ain_next;
-
-	table = peer->bgp->rib[afi][safi];
-
-	/* It is possible that we have multiple paths for a prefix from a peer
-	 * if that peer is using AddPath.
-	 */
-	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		ain = rn->adj_in;
-
-		while (ain) {
-			ain_next = ain->next;
-
-			if (ain->peer == peer) {
-				bgp_adj_in_remove(rn, ain);
-				bgp_unlock_node(rn);
-			}
-
-			ain = ain_next;
-		}
-	}
+	bgp_clear_adj_in_table(peer, peer->bgp->rib[afi][safi], afi, safi);
 }
 
 void bgp_clear_stale_route(struct peer *peer, afi_t afi, safi_t safi)
@@ -4012,6 +4451,62 @@ void bgp_clear_stale_route(struct peer *peer, afi_t afi, safi_t safi)
 	}
 }
 
+/*
+ * Installs a path read back from a RIB snapshot taken before bgpd was
+ * restarted.  The attributes are the ones the path had in the RIB, so
+ * inbound policy has been applied to them already.  The path is stale, and
+ * goes away as on a graceful restart unless the peer advertises it again.
+ */
+void bgp_rib_restore(struct peer *peer, afi_t afi, safi_t safi,
+		     struct prefix *p, struct attr *attr, time_t uptime)
+{
+	struct bgp *bgp = peer->bgp;
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	struct bgp_info *new;
+	int connected;
+
+	rn = bgp_afi_node_get(bgp->rib[afi][safi], afi, safi, p, NULL);
+
+	/* Learned from the peer already, or in the snapshot twice */
+	for (ri = rn->info; ri; ri = ri->next)
+		if (ri->peer == peer && ri->type == ZEBRA_ROUTE_BGP
+		    && ri->sub_type == BGP_ROUTE_NORMAL)
+			break;
+	if (ri) {
+		bgp_unlock_node(rn);
+		return;
+	}
+
+	/* weight is not in the snapshot */
+	if (peer->weight[afi][safi])
+		attr->weight = peer->weight[afi][safi];
+
+	new = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, 0, peer,
+			bgp_attr_intern(attr), rn);
+	new->uptime = uptime;
+
+	if (peer->sort == BGP_PEER_EBGP && peer->ttl == 1
+	    && !CHECK_FLAG(peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)
+	    && !bgp_flag_check(bgp, BGP_FLAG_DISABLE_NH_CONNECTED_CHK))
+		connected = 1;
+	else
+		connected = 0;
+
+	if (bgp_find_or_add_nexthop(bgp, bgp, afi, new, NULL, connected))
+		bgp_info_set_flag(rn, new, BGP_INFO_VALID);
+	bgp_info_set_flag(rn, new, BGP_INFO_STALE);
+
+	bgp_aggregate_increment(bgp, p, new, afi, safi);
+	bgp_info_add(rn, new);
+	bgp_unlock_node(rn);
+
+	peer->nsf[afi][safi] = 1;
+	bgp_graceful_stale_timer_start(peer);
+
+	bgp_process(bgp, rn, afi, safi);
+}
+
 static void bgp_cleanup_table(struct bgp *bgp, struct bgp_table *table,
 			      safi_t safi)
 {
@@ -4309,6 +4804,7 @@ void bgp_static_update(struct bgp *bgp, struct prefix *p,
 	/* Apply route-map. */
 	if (bgp_static->rmap.name) {
 		struct attr attr_tmp = attr;
+		memset(&info, 0, sizeof(info));
 		info.peer = bgp->peer_self;
 		info.attr = &attr_tmp;
 
@@ -4627,6 +5123,7 @@ static void bgp_static_update_safi(struct bgp *bgp, struct prefix *p,
 		struct bgp_info info;
 		int ret;
 
+		memset(&info, 0, sizeof(info));
 		info.peer = bgp->peer_self;
 		info.attr = &attr_tmp;
 
@@ -5369,53 +5866,255 @@ struct bgp_aggregate {
 	/* Route-map for aggregated route. */
 	struct route_map *map;
 
-	/* Suppress-count. */
+	/* Number of contributing routes, and of those by ORIGIN and with
+	 * ATOMIC_AGGREGATE. */
 	unsigned long count;
+	unsigned long incomplete_origin_count;
+	unsigned long egp_origin_count;
+	unsigned long atomic_aggregate_count;
+
+	/* as-set: the AS paths and community values of the contributing
+	 * routes, each with the number of routes having it, and what they
+	 * merge into; see bgp_aggregate_ref_add(). */
+	struct hash *aspath_hash;
+	struct hash *community_hash;
+	struct aspath *aspath;
+	struct community *community;
+	bool community_changed;
 
 	/* SAFI configuration. */
 	safi_t safi;
 };
 
+/* An AS path or community value of an as-set aggregate. */
+struct bgp_aggregate_ref {
+	struct aspath *aspath;
+	uint32_t val;
+	unsigned long count;
+};
+
+static unsigned int bgp_aggregate_aspath_key(void *data)
+{
+	struct bgp_aggregate_ref *ref = data;
+
+	/* AS paths of routes are interned, one pointer each */
+	return jhash_1word((uint32_t)(uintptr_t)ref->aspath, 0);
+}
+
+static int bgp_aggregate_aspath_cmp(const void *a, const void *b)
+{
+	const struct bgp_aggregate_ref *ra = a, *rb = b;
+
+	return ra->aspath == rb->aspath;
+}
+
+static unsigned int bgp_aggregate_community_key(void *data)
+{
+	struct bgp_aggregate_ref *ref = data;
+
+	return jhash_1word(ref->val, 0);
+}
+
+static int bgp_aggregate_community_cmp(const void *a, const void *b)
+{
+	const struct bgp_aggregate_ref *ra = a, *rb = b;
+
+	return ra->val == rb->val;
+}
+
+static void *bgp_aggregate_ref_alloc(void *data)
+{
+	struct bgp_aggregate_ref *ref;
+
+	ref = XCALLOC(MTYPE_BGP_AGGREGATE_REF, sizeof(*ref));
+	*ref = *(struct bgp_aggregate_ref *)data;
+	return ref;
+}
+
+static void bgp_aggregate_ref_free(void *data)
+{
+	XFREE(MTYPE_BGP_AGGREGATE_REF, data);
+}
+
 static struct bgp_aggregate *bgp_aggregate_new(void)
 {
-	return XCALLOC(MTYPE_BGP_AGGREGATE, sizeof(struct bgp_aggregate));
+	struct bgp_aggregate *aggregate;
+
+	aggregate = XCALLOC(MTYPE_BGP_AGGREGATE, sizeof(struct bgp_aggregate));
+	aggregate->aspath_hash =
+		hash_create(bgp_aggregate_aspath_key, bgp_aggregate_aspath_cmp,
+			    "BGP aggregate AS paths");
+	aggregate->community_hash = hash_create(bgp_aggregate_community_key,
+						bgp_aggregate_community_cmp,
+						"BGP aggregate communities");
+	return aggregate;
 }
 
 static void bgp_aggregate_free(struct bgp_aggregate *aggregate)
 {
+	hash_clean(aggregate->aspath_hash, bgp_aggregate_ref_free);
+	hash_free(aggregate->aspath_hash);
+	hash_clean(aggregate->community_hash, bgp_aggregate_ref_free);
+	hash_free(aggregate->community_hash);
+	if (aggregate->aspath)
+		aspath_free(aggregate->aspath);
+	if (aggregate->community)
+		community_free(aggregate->community);
 	XFREE(MTYPE_BGP_AGGREGATE, aggregate);
 }
 
-/* Update an aggregate as routes are added/removed from the BGP table */
-static void bgp_aggregate_route(struct bgp *bgp, struct prefix *p,
-				struct bgp_info *rinew, afi_t afi, safi_t safi,
-				struct bgp_info *del,
-				struct bgp_aggregate *aggregate)
+static void bgp_aggregate_aspath_merge(struct aspath **aspath,
+				       struct aspath *add)
+{
+	struct aspath *asmerge;
+
+	if (*aspath) {
+		asmerge = aspath_aggregate(*aspath, add);
+		aspath_free(*aspath);
+		*aspath = asmerge;
+	} else
+		*aspath = aspath_dup(add);
+}
+
+static void bgp_aggregate_aspath_remerge(struct hash_backet *backet,
+					 void *arg)
+{
+	struct bgp_aggregate_ref *ref = backet->data;
+
+	bgp_aggregate_aspath_merge(arg, ref->aspath);
+}
+
+static void bgp_aggregate_community_collect(struct hash_backet *backet,
+					    void *arg)
+{
+	struct bgp_aggregate_ref *ref = backet->data;
+	struct community *com = arg;
+
+	com->val[com->size++] = htonl(ref->val);
+}
+
+/*
+ * Counts the route with attr in the aggregate.  An AS path only merges into
+ * the as-set when its first route comes; the community is only put
+ * together again, by bgp_aggregate_install(), when a value comes or goes.
+ */
+static void bgp_aggregate_ref_add(struct bgp_aggregate *aggregate,
+				  struct attr *attr)
+{
+	struct bgp_aggregate_ref lookup = {}, *ref;
+	int i;
+
+	aggregate->count++;
+	if (attr->origin == BGP_ORIGIN_INCOMPLETE)
+		aggregate->incomplete_origin_count++;
+	else if (attr->origin == BGP_ORIGIN_EGP)
+		aggregate->egp_origin_count++;
+	if (attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE))
+		aggregate->atomic_aggregate_count++;
+
+	if (!aggregate->as_set)
+		return;
+
+	lookup.aspath = attr->aspath;
+	ref = hash_get(aggregate->aspath_hash, &lookup,
+		       bgp_aggregate_ref_alloc);
+	if (ref->count++ == 0)
+		bgp_aggregate_aspath_merge(&aggregate->aspath, attr->aspath);
+
+	if (!attr->community)
+		return;
+
+	lookup.aspath = NULL;
+	for (i = 0; i < attr->community->size; i++) {
+		lookup.val = community_val_get(attr->community, i);
+		ref = hash_get(aggregate->community_hash, &lookup,
+			       bgp_aggregate_ref_alloc);
+		if (ref->count++ == 0)
+			aggregate->community_changed = true;
+	}
+}
+
+/* Undoes bgp_aggregate_ref_add(); the as-set is merged again from the AS
+ * paths left if one of them goes. */
+static void bgp_aggregate_ref_del(struct bgp_aggregate *aggregate,
+				  struct attr *attr)
+{
+	struct bgp_aggregate_ref lookup = {}, *ref;
+	int i;
+
+	if (!aggregate->count)
+		return;
+
+	aggregate->count--;
+	if (attr->origin == BGP_ORIGIN_INCOMPLETE)
+		aggregate->incomplete_origin_count--;
+	else if (attr->origin == BGP_ORIGIN_EGP)
+		aggregate->egp_origin_count--;
+	if (attr->flag & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE))
+		aggregate->atomic_aggregate_count--;
+
+	if (!aggregate->as_set)
+		return;
+
+	lookup.aspath = attr->aspath;
+	ref = hash_lookup(aggregate->aspath_hash, &lookup);
+	if (ref && --ref->count == 0) {
+		hash_release(aggregate->aspath_hash, ref);
+		bgp_aggregate_ref_free(ref);
+
+		if (aggregate->aspath)
+			aspath_free(aggregate->aspath);
+		aggregate->aspath = NULL;
+		hash_iterate(aggregate->aspath_hash,
+			     bgp_aggregate_aspath_remerge, &aggregate->aspath);
+	}
+
+	if (!attr->community)
+		return;
+
+	lookup.aspath = NULL;
+	for (i = 0; i < attr->community->size; i++) {
+		lookup.val = community_val_get(attr->community, i);
+		ref = hash_lookup(aggregate->community_hash, &lookup);
+		if (ref && --ref->count == 0) {
+			hash_release(aggregate->community_hash, ref);
+			bgp_aggregate_ref_free(ref);
+			aggregate->community_changed = true;
+		}
+	}
+}
+
+/*
+ * Puts the aggregate route in the table as the contributing routes make
+ * it, or withdraws it if there are none.  An unchanged route is left
+ * alone.
+ */
+static void bgp_aggregate_install(struct bgp *bgp, struct prefix *p, afi_t afi,
+				  safi_t safi, struct bgp_aggregate *aggregate)
 {
-	struct bgp_table *table;
-	struct bgp_node *top;
 	struct bgp_node *rn;
-	uint8_t origin;
-	struct aspath *aspath = NULL;
-	struct aspath *asmerge = NULL;
-	struct community *community = NULL;
-	struct community *commerge = NULL;
-#if defined(AGGREGATE_NEXTHOP_CHECK)
-	struct in_addr nexthop;
-	uint32_t med = 0;
-#endif
 	struct bgp_info *ri;
 	struct bgp_info *new;
-	int first = 1;
-	unsigned long match = 0;
-	uint8_t atomic_aggregate = 0;
-
-	/* Record adding route's nexthop and med. */
-	if (rinew) {
-#if defined(AGGREGATE_NEXTHOP_CHECK)
-		nexthop = rinew->attr->nexthop;
-		med = rinew->attr->med;
-#endif
+	struct attr *attr = NULL;
+	struct community tmp;
+	uint8_t origin = BGP_ORIGIN_IGP;
+
+	if (aggregate->community_changed) {
+		if (aggregate->community)
+			community_free(aggregate->community);
+		aggregate->community = NULL;
+
+		if (aggregate->community_hash->count) {
+			tmp.size = 0;
+			tmp.val = XMALLOC(MTYPE_TMP,
+					  aggregate->community_hash->count
+						  * sizeof(uint32_t));
+			hash_iterate(aggregate->community_hash,
+				     bgp_aggregate_community_collect, &tmp);
+			aggregate->community = community_uniq_sort(&tmp);
+			XFREE(MTYPE_TMP, tmp.val);
+		}
+		aggregate->community_changed = false;
 	}
 
 	/* ORIGIN attribute: If at least one route among routes that are
@@ -5426,160 +6125,92 @@ static void bgp_aggregate_route(struct bgp *bgp, struct prefix *p,
 	   route must have the origin attribute with the value EGP. In all
 	   other case the value of the ORIGIN attribute of the aggregated
 	   route is INTERNAL. */
-	origin = BGP_ORIGIN_IGP;
-
-	table = bgp->rib[afi][safi];
-
-	top = bgp_node_get(table, p);
-	for (rn = bgp_node_get(table, p); rn;
-	     rn = bgp_route_next_until(rn, top))
-		if (rn->p.prefixlen > p->prefixlen) {
-			match = 0;
+	if (aggregate->incomplete_origin_count)
+		origin = BGP_ORIGIN_INCOMPLETE;
+	else if (aggregate->egp_origin_count)
+		origin = BGP_ORIGIN_EGP;
+
+	if (aggregate->count)
+		attr = bgp_attr_aggregate_intern(
+			bgp, origin,
+			aggregate->aspath ? aspath_dup(aggregate->aspath)
+					  : NULL,
+			aggregate->community
+				? community_dup(aggregate->community)
+				: NULL,
+			aggregate->as_set,
+			aggregate->atomic_aggregate_count ? 1 : 0);
+
+	rn = bgp_node_get(bgp->rib[afi][safi], p);
 
-			for (ri = rn->info; ri; ri = ri->next) {
-				if (BGP_INFO_HOLDDOWN(ri))
-					continue;
-
-				if (del && ri == del)
-					continue;
+	for (ri = rn->info; ri; ri = ri->next)
+		if (ri->peer == bgp->peer_self && ri->type == ZEBRA_ROUTE_BGP
+		    && ri->sub_type == BGP_ROUTE_AGGREGATE
+		    && !CHECK_FLAG(ri->flags, BGP_INFO_REMOVED))
+			break;
 
-				if (!rinew && first) {
-#if defined(AGGREGATE_NEXTHOP_CHECK)
-					nexthop = ri->attr->nexthop;
-					med = ri->attr->med;
-#endif
-					first = 0;
-				}
+	if (ri && ri->attr == attr) {
+		bgp_attr_unintern(&attr);
+		bgp_unlock_node(rn);
+		return;
+	}
 
-#ifdef AGGREGATE_NEXTHOP_CHECK
-				if (!IPV4_ADDR_SAME(&ri->attr->nexthop,
-						    &nexthop)
-				    || ri->attr->med != med) {
-					if (aspath)
-						aspath_free(aspath);
-					if (community)
-						community_free(community);
-					bgp_unlock_node(rn);
-					bgp_unlock_node(top);
-					return;
-				}
-#endif /* AGGREGATE_NEXTHOP_CHECK */
-
-				if (ri->attr->flag
-				    & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE))
-					atomic_aggregate = 1;
-
-				if (ri->sub_type != BGP_ROUTE_AGGREGATE) {
-					if (aggregate->summary_only) {
-						(bgp_info_extra_get(ri))
-							->suppress++;
-						bgp_info_set_flag(
-							rn, ri,
-							BGP_INFO_ATTR_CHANGED);
-						match++;
-					}
+	/* Withdraw the aggregate route as it was. */
+	if (ri)
+		bgp_info_delete(rn, ri);
 
-					aggregate->count++;
+	if (attr) {
+		new = info_make(ZEBRA_ROUTE_BGP, BGP_ROUTE_AGGREGATE, 0,
+				bgp->peer_self, attr, rn);
+		SET_FLAG(new->flags, BGP_INFO_VALID);
+		bgp_info_add(rn, new);
+	}
 
-					if (origin < ri->attr->origin)
-						origin = ri->attr->origin;
+	if (ri || attr)
+		bgp_process(bgp, rn, afi, safi);
+	bgp_unlock_node(rn);
+}
 
-					if (aggregate->as_set) {
-						if (aspath) {
-							asmerge = aspath_aggregate(
-								aspath,
-								ri->attr->aspath);
-							aspath_free(aspath);
-							aspath = asmerge;
-						} else
-							aspath = aspath_dup(
-								ri->attr->aspath);
-
-						if (ri->attr->community) {
-							if (community) {
-								commerge = community_merge(
-									community,
-									ri->attr->community);
-								community = community_uniq_sort(
-									commerge);
-								community_free(
-									commerge);
-							} else
-								community = community_dup(
-									ri->attr->community);
-						}
-					}
-				}
-			}
-			if (match)
-				bgp_process(bgp, rn, afi, safi);
-		}
-	bgp_unlock_node(top);
+/* Counts the route in, or takes it out of, one aggregate covering it. */
+static void bgp_aggregate_count(struct bgp *bgp, struct bgp_node *arn,
+				struct bgp_info *ri, struct attr *attr,
+				afi_t afi, safi_t safi, bool add)
+{
+	struct bgp_aggregate *aggregate = arn->info;
 
-	if (rinew) {
-		aggregate->count++;
+	if (add) {
+		bgp_aggregate_ref_add(aggregate, attr);
 
+		/* summary-only aggregate route suppress
+		 * aggregated route announcement.  */
 		if (aggregate->summary_only)
-			(bgp_info_extra_get(rinew))->suppress++;
-
-		if (origin < rinew->attr->origin)
-			origin = rinew->attr->origin;
+			(bgp_info_extra_get(ri))->suppress++;
+	} else {
+		bgp_aggregate_ref_del(aggregate, attr);
 
-		if (aggregate->as_set) {
-			if (aspath) {
-				asmerge = aspath_aggregate(aspath,
-							   rinew->attr->aspath);
-				aspath_free(aspath);
-				aspath = asmerge;
-			} else
-				aspath = aspath_dup(rinew->attr->aspath);
-
-			if (rinew->attr->community) {
-				if (community) {
-					commerge = community_merge(
-						community,
-						rinew->attr->community);
-					community =
-						community_uniq_sort(commerge);
-					community_free(commerge);
-				} else
-					community = community_dup(
-						rinew->attr->community);
-			}
+		if (aggregate->summary_only && ri->extra
+		    && ri->extra->suppress > 0 && --ri->extra->suppress == 0
+		    && ri->net) {
+			bgp_info_set_flag(ri->net, ri, BGP_INFO_ATTR_CHANGED);
+			bgp_process(bgp, ri->net, afi, safi);
 		}
 	}
 
-	if (aggregate->count > 0) {
-		rn = bgp_node_get(table, p);
-		new = info_make(
-			ZEBRA_ROUTE_BGP, BGP_ROUTE_AGGREGATE, 0, bgp->peer_self,
-			bgp_attr_aggregate_intern(bgp, origin, aspath,
-						  community, aggregate->as_set,
-						  atomic_aggregate),
-			rn);
-		SET_FLAG(new->flags, BGP_INFO_VALID);
-
-		bgp_info_add(rn, new);
-		bgp_unlock_node(rn);
-		bgp_process(bgp, rn, afi, safi);
-	} else {
-		if (aspath)
-			aspath_free(aspath);
-		if (community)
-			community_free(community);
-	}
+	bgp_aggregate_install(bgp, &arn->p, afi, safi, aggregate);
 }
 
-void bgp_aggregate_delete(struct bgp *, struct prefix *, afi_t, safi_t,
-			  struct bgp_aggregate *);
-
+/*
+ * A route is counted in all the aggregates covering it while its
+ * extra->aggregate_attr holds the attributes it was counted with, so it
+ * is taken out as it came in whatever happened to it meanwhile.
+ */
 void bgp_aggregate_increment(struct bgp *bgp, struct prefix *p,
 			     struct bgp_info *ri, afi_t afi, safi_t safi)
 {
 	struct bgp_node *child;
 	struct bgp_node *rn;
-	struct bgp_aggregate *aggregate;
 	struct bgp_table *table;
+	bool counted = false;
 
 	/* MPLS-VPN aggregation is not yet supported. */
 	if ((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)
@@ -5596,20 +6227,29 @@ void bgp_aggregate_increment(struct bgp *bgp, struct prefix *p,
 	if (p->prefixlen == 0)
 		return;
 
-	if (BGP_INFO_HOLDDOWN(ri))
+	if (BGP_INFO_HOLDDOWN(ri) || ri->sub_type == BGP_ROUTE_AGGREGATE)
 		return;
 
+	if (ri->extra && ri->extra->aggregate_attr) {
+		if (ri->extra->aggregate_attr == ri->attr)
+			return;
+		bgp_aggregate_decrement(bgp, p, ri, afi, safi);
+	}
+
 	child = bgp_node_get(table, p);
 
 	/* Aggregate address configuration check. */
 	for (rn = child; rn; rn = bgp_node_parent_nolock(rn))
-		if ((aggregate = rn->info) != NULL
-		    && rn->p.prefixlen < p->prefixlen) {
-			bgp_aggregate_delete(bgp, &rn->p, afi, safi, aggregate);
-			bgp_aggregate_route(bgp, &rn->p, ri, afi, safi, NULL,
-					    aggregate);
+		if (rn->info && rn->p.prefixlen < p->prefixlen) {
+			bgp_aggregate_count(bgp, rn, ri, ri->attr, afi, safi,
+					    true);
+			counted = true;
 		}
 	bgp_unlock_node(child);
+
+	if (counted)
+		bgp_info_extra_get(ri)->aggregate_attr =
+			bgp_attr_intern(ri->attr);
 }
 
 void bgp_aggregate_decrement(struct bgp *bgp, struct prefix *p,
@@ -5617,35 +6257,27 @@ void bgp_aggregate_decrement(struct bgp *bgp, struct prefix *p,
 {
 	struct bgp_node *child;
 	struct bgp_node *rn;
-	struct bgp_aggregate *aggregate;
 	struct bgp_table *table;
+	struct attr *attr;
 
-	/* MPLS-VPN aggregation is not yet supported. */
-	if ((safi == SAFI_MPLS_VPN) || (safi == SAFI_ENCAP)
-	    || (safi == SAFI_EVPN)
-	    || (safi == SAFI_FLOWSPEC))
+	if (!del->extra || !del->extra->aggregate_attr)
 		return;
 
+	attr = del->extra->aggregate_attr;
 	table = bgp->aggregate[afi][safi];
 
-	/* No aggregates configured. */
-	if (bgp_table_top_nolock(table) == NULL)
-		return;
+	if (bgp_table_top_nolock(table) != NULL) {
+		child = bgp_node_get(table, p);
 
-	if (p->prefixlen == 0)
-		return;
-
-	child = bgp_node_get(table, p);
-
-	/* Aggregate address configuration check. */
-	for (rn = child; rn; rn = bgp_node_parent_nolock(rn))
-		if ((aggregate = rn->info) != NULL
-		    && rn->p.prefixlen < p->prefixlen) {
-			bgp_aggregate_delete(bgp, &rn->p, afi, safi, aggregate);
-			bgp_aggregate_route(bgp, &rn->p, NULL, afi, safi, del,
-					    aggregate);
-		}
-	bgp_unlock_node(child);
+		/* Aggregate address configuration check. */
+		for (rn = child; rn; rn = bgp_node_parent_nolock(rn))
+			if (rn->info && rn->p.prefixlen < p->prefixlen)
+				bgp_aggregate_count(bgp, rn, del, attr, afi,
+						    safi, false);
+		bgp_unlock_node(child);
+	}
+
+	bgp_attr_unintern(&del->extra->aggregate_attr);
 }
 
 /* Called via bgp_aggregate_set when the user configures aggregate-address */
@@ -5655,15 +6287,8 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi,
 	struct bgp_table *table;
 	struct bgp_node *top;
 	struct bgp_node *rn;
-	struct bgp_info *new;
 	struct bgp_info *ri;
 	unsigned long match;
-	uint8_t origin = BGP_ORIGIN_IGP;
-	struct aspath *aspath = NULL;
-	struct aspath *asmerge = NULL;
-	struct community *community = NULL;
-	struct community *commerge = NULL;
-	uint8_t atomic_aggregate = 0;
 
 	table = bgp->rib[afi][safi];
 
@@ -5686,10 +6311,6 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi,
 			if (BGP_INFO_HOLDDOWN(ri))
 				continue;
 
-			if (ri->attr->flag
-			    & ATTR_FLAG_BIT(BGP_ATTR_ATOMIC_AGGREGATE))
-				atomic_aggregate = 1;
-
 			if (ri->sub_type == BGP_ROUTE_AGGREGATE)
 				continue;
 
@@ -5702,43 +6323,13 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi,
 				match++;
 			}
 
-			/* If at least one route among routes that are
-			 * aggregated has ORIGIN with the value INCOMPLETE,
-			 * then the aggregated route MUST have the ORIGIN
-			 * attribute with the value INCOMPLETE.  Otherwise, if
-			 * at least one route among routes that are aggregated
-			 * has ORIGIN with the value EGP, then the aggregated
-			 * route MUST have the ORIGIN attribute with the value
-			 * EGP.
-			 */
-			if (origin < ri->attr->origin)
-				origin = ri->attr->origin;
-
-			/* as-set aggregate route generate origin, as path,
-			 * community aggregation.  */
-			if (aggregate->as_set) {
-				if (aspath) {
-					asmerge = aspath_aggregate(
-						aspath, ri->attr->aspath);
-					aspath_free(aspath);
-					aspath = asmerge;
-				} else
-					aspath = aspath_dup(ri->attr->aspath);
-
-				if (ri->attr->community) {
-					if (community) {
-						commerge = community_merge(
-							community,
-							ri->attr->community);
-						community = community_uniq_sort(
-							commerge);
-						community_free(commerge);
-					} else
-						community = community_dup(
-							ri->attr->community);
-				}
-			}
-			aggregate->count++;
+			/* counted with the attributes of the other
+			 * aggregates it is in, if any */
+			if (!ri->extra || !ri->extra->aggregate_attr)
+				bgp_info_extra_get(ri)->aggregate_attr =
+					bgp_attr_intern(ri->attr);
+			bgp_aggregate_ref_add(aggregate,
+					      ri->extra->aggregate_attr);
 		}
 
 		/* If this node is suppressed, process the change. */
@@ -5748,31 +6339,12 @@ static void bgp_aggregate_add(struct bgp *bgp, struct prefix *p, afi_t afi,
 	bgp_unlock_node(top);
 
 	/* Add aggregate route to BGP table. */
-	if (aggregate->count) {
-		rn = bgp_node_get(table, p);
-		new = info_make(
-			ZEBRA_ROUTE_BGP, BGP_ROUTE_AGGREGATE, 0, bgp->peer_self,
-			bgp_attr_aggregate_intern(bgp, origin, aspath,
-						  community, aggregate->as_set,
-						  atomic_aggregate),
-			rn);
-		SET_FLAG(new->flags, BGP_INFO_VALID);
-
-		bgp_info_add(rn, new);
-		bgp_unlock_node(rn);
-
-		/* Process change. */
-		bgp_process(bgp, rn, afi, safi);
-	} else {
-		if (aspath)
-			aspath_free(aspath);
-		if (community)
-			community_free(community);
-	}
+	bgp_aggregate_install(bgp, p, afi, safi, aggregate);
 }
 
-void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi,
-			  safi_t safi, struct bgp_aggregate *aggregate)
+static void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p,
+				 afi_t afi, safi_t safi,
+				 struct bgp_aggregate *aggregate)
 {
 	struct bgp_table *table;
 	struct bgp_node *top;
@@ -5796,13 +6368,10 @@ void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi,
 		match = 0;
 
 		for (ri = rn->info; ri; ri = ri->next) {
-			if (BGP_INFO_HOLDDOWN(ri))
+			if (!ri->extra || !ri->extra->aggregate_attr)
 				continue;
 
-			if (ri->sub_type == BGP_ROUTE_AGGREGATE)
-				continue;
-
-			if (aggregate->summary_only && ri->extra) {
+			if (aggregate->summary_only && ri->extra->suppress > 0) {
 				ri->extra->suppress--;
 
 				if (ri->extra->suppress == 0) {
@@ -5811,7 +6380,6 @@ void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi,
 					match++;
 				}
 			}
-			aggregate->count--;
 		}
 
 		/* If this node was suppressed, process the change. */
@@ -5820,22 +6388,10 @@ void bgp_aggregate_delete(struct bgp *bgp, struct prefix *p, afi_t afi,
 	}
 	bgp_unlock_node(top);
 
-	/* Delete aggregate route from BGP table. */
-	rn = bgp_node_get(table, p);
-
-	for (ri = rn->info; ri; ri = ri->next)
-		if (ri->peer == bgp->peer_self && ri->type == ZEBRA_ROUTE_BGP
-		    && ri->sub_type == BGP_ROUTE_AGGREGATE)
-			break;
-
-	/* Withdraw static BGP route from routing table. */
-	if (ri) {
-		bgp_info_delete(rn, ri);
-		bgp_process(bgp, rn, afi, safi);
-	}
-
-	/* Unlock bgp_node_lookup. */
-	bgp_unlock_node(rn);
+	/* Delete aggregate route from BGP table, the aggregate is to be
+	 * freed along with what it counted. */
+	aggregate->count = 0;
+	bgp_aggregate_install(bgp, p, afi, safi, aggregate);
 }
 
 /* Aggregate route attribute. */
@@ -6140,6 +6696,7 @@ void bgp_redistribute_add(struct bgp *bgp, struct prefix *p,
 
 		/* Apply route-map. */
 		if (red->rmap.name) {
+			memset(&info, 0, sizeof(info));
 			info.peer = bgp->peer_self;
 			info.attr = &attr_new;
 
@@ -6711,7 +7268,7 @@ void route_vty_out(struct vty *vty, struct prefix *p, struct bgp_info *binfo,
 	if (attr->aspath) {
 		if (json_paths)
 			json_object_string_add(json_path, "aspath",
-					       attr->aspath->str);
+					       aspath_print(attr->aspath));
 		else
 			aspath_print_vty(vty, "%s", attr->aspath, " ");
 	}
@@ -6817,8 +7374,9 @@ void route_vty_out_tmp(struct vty *vty, struct prefix *p, struct attr *attr,
 
 			/* Print aspath */
 			if (attr->aspath)
-				json_object_string_add(json_net, "asPath",
-						       attr->aspath->str);
+				json_object_string_add(
+					json_net, "asPath",
+					aspath_print(attr->aspath));
 
 			/* Print origin */
 			json_object_string_add(json_net, "bgpOriginCode",
@@ -7121,8 +7679,9 @@ static void damp_route_vty_out(struct vty *vty, struct prefix *p,
 		/* Print aspath */
 		if (attr->aspath) {
 			if (use_json)
-				json_object_string_add(json, "asPath",
-						       attr->aspath->str);
+				json_object_string_add(
+					json, "asPath",
+					aspath_print(attr->aspath));
 			else
 				aspath_print_vty(vty, "%s", attr->aspath, " ");
 		}
@@ -7216,8 +7775,9 @@ static void flap_route_vty_out(struct vty *vty, struct prefix *p,
 		/* Print aspath */
 		if (attr->aspath) {
 			if (use_json)
-				json_object_string_add(json, "asPath",
-						       attr->aspath->str);
+				json_object_string_add(
+					json, "asPath",
+					aspath_print(attr->aspath));
 			else
 				aspath_print_vty(vty, "%s", attr->aspath, " ");
 		}
@@ -8129,272 +8689,258 @@ static int bgp_show_community(struct vty *vty, struct bgp *bgp,
 			      safi_t safi);
 
 
-static int bgp_show_table(struct vty *vty, struct bgp *bgp, safi_t safi,
-			  struct bgp_table *table, enum bgp_show_type type,
-			  void *output_arg, uint8_t use_json, char *rd,
-			  int is_last, unsigned long *output_cum,
-			  unsigned long *total_cum,
-			  unsigned long *json_header_depth)
+/*
+ * Output the paths of one node that pass the filter of type, returns how many
+ * there were.  header is cleared once the table header has been printed,
+ * output_count is the number of nodes output from this table so far.
+ */
+static int bgp_show_node(struct vty *vty, struct bgp *bgp, safi_t safi,
+			 struct bgp_table *table, struct bgp_node *rn,
+			 enum bgp_show_type type, void *output_arg,
+			 uint8_t use_json, char *rd, int *header,
+			 unsigned long output_count,
+			 unsigned long *total_count, struct json_stream *js)
 {
 	struct bgp_info *ri;
-	struct bgp_node *rn;
-	int header = 1;
-	int display;
-	unsigned long output_count = 0;
-	unsigned long total_count = 0;
+	int display = 0;
 	struct prefix *p;
 	char buf[BUFSIZ];
 	char buf2[BUFSIZ];
 	json_object *json_paths = NULL;
-	int first = 1;
-
-	if (output_cum && *output_cum != 0)
-		header = 0;
-
-	if (use_json && !*json_header_depth) {
-		vty_out(vty,
-			"{\n \"vrfId\": %d,\n \"vrfName\": \"%s\",\n \"tableVersion\": %" PRId64
-			",\n \"routerId\": \"%s\",\n \"routes\": { ",
-			bgp->vrf_id == VRF_UNKNOWN ? -1 : (int)bgp->vrf_id,
-			bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT ? "Default"
-								    : bgp->name,
-			table->version, inet_ntoa(bgp->router_id));
-		*json_header_depth = 2;
-		if (rd) {
-			vty_out(vty, " \"routeDistinguishers\" : {");
-			++*json_header_depth;
-		}
-		json_paths = json_object_new_object();
-	}
 
-	if (use_json && rd) {
-		vty_out(vty, " \"%s\" : { ", rd);
-	}
+	if (rn->info == NULL)
+		return 0;
 
-	/* Start processing of routes. */
-	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
-		if (rn->info == NULL)
-			continue;
+	if (use_json)
+		json_paths = json_object_new_array();
 
-		display = 0;
-		if (use_json)
-			json_paths = json_object_new_array();
-		else
-			json_paths = NULL;
+	for (ri = rn->info; ri; ri = ri->next) {
+		(*total_count)++;
+		if (type == bgp_show_type_flap_statistics
+		    || type == bgp_show_type_flap_neighbor
+		    || type == bgp_show_type_dampend_paths
+		    || type == bgp_show_type_damp_neighbor) {
+			if (!(ri->extra && ri->extra->damp_info))
+				continue;
+		}
+		if (type == bgp_show_type_regexp) {
+			regex_t *regex = output_arg;
 
-		for (ri = rn->info; ri; ri = ri->next) {
-			total_count++;
-			if (type == bgp_show_type_flap_statistics
-			    || type == bgp_show_type_flap_neighbor
-			    || type == bgp_show_type_dampend_paths
-			    || type == bgp_show_type_damp_neighbor) {
-				if (!(ri->extra && ri->extra->damp_info))
-					continue;
-			}
-			if (type == bgp_show_type_regexp) {
-				regex_t *regex = output_arg;
+			if (bgp_regexec(regex, ri->attr->aspath)
+			    == REG_NOMATCH)
+				continue;
+		}
+		if (type == bgp_show_type_prefix_list) {
+			struct prefix_list *plist = output_arg;
 
-				if (bgp_regexec(regex, ri->attr->aspath)
-				    == REG_NOMATCH)
-					continue;
-			}
-			if (type == bgp_show_type_prefix_list) {
-				struct prefix_list *plist = output_arg;
+			if (prefix_list_apply(plist, &rn->p)
+			    != PREFIX_PERMIT)
+				continue;
+		}
+		if (type == bgp_show_type_filter_list) {
+			struct as_list *as_list = output_arg;
 
-				if (prefix_list_apply(plist, &rn->p)
-				    != PREFIX_PERMIT)
-					continue;
-			}
-			if (type == bgp_show_type_filter_list) {
-				struct as_list *as_list = output_arg;
+			if (as_list_apply(as_list, ri->attr->aspath)
+			    != AS_FILTER_PERMIT)
+				continue;
+		}
+		if (type == bgp_show_type_route_map) {
+			struct route_map *rmap = output_arg;
+			struct bgp_info binfo;
+			struct attr dummy_attr;
+			int ret;
 
-				if (as_list_apply(as_list, ri->attr->aspath)
-				    != AS_FILTER_PERMIT)
-					continue;
-			}
-			if (type == bgp_show_type_route_map) {
-				struct route_map *rmap = output_arg;
-				struct bgp_info binfo;
-				struct attr dummy_attr;
-				int ret;
+			bgp_attr_dup(&dummy_attr, ri->attr);
 
-				bgp_attr_dup(&dummy_attr, ri->attr);
+			memset(&binfo, 0, sizeof(binfo));
+			binfo.peer = ri->peer;
+			binfo.attr = &dummy_attr;
 
-				binfo.peer = ri->peer;
-				binfo.attr = &dummy_attr;
+			ret = route_map_apply(rmap, &rn->p, RMAP_BGP,
+					      &binfo);
+			if (ret == RMAP_DENYMATCH)
+				continue;
+		}
+		if (type == bgp_show_type_neighbor
+		    || type == bgp_show_type_flap_neighbor
+		    || type == bgp_show_type_damp_neighbor) {
+			union sockunion *su = output_arg;
 
-				ret = route_map_apply(rmap, &rn->p, RMAP_BGP,
-						      &binfo);
-				if (ret == RMAP_DENYMATCH)
-					continue;
-			}
-			if (type == bgp_show_type_neighbor
-			    || type == bgp_show_type_flap_neighbor
-			    || type == bgp_show_type_damp_neighbor) {
-				union sockunion *su = output_arg;
-
-				if (ri->peer == NULL
-				    || ri->peer->su_remote == NULL
-				    || !sockunion_same(ri->peer->su_remote, su))
-					continue;
-			}
-			if (type == bgp_show_type_cidr_only) {
-				uint32_t destination;
+			if (ri->peer == NULL
+			    || ri->peer->su_remote == NULL
+			    || !sockunion_same(ri->peer->su_remote, su))
+				continue;
+		}
+		if (type == bgp_show_type_cidr_only) {
+			uint32_t destination;
 
-				destination = ntohl(rn->p.u.prefix4.s_addr);
-				if (IN_CLASSC(destination)
-				    && rn->p.prefixlen == 24)
-					continue;
-				if (IN_CLASSB(destination)
-				    && rn->p.prefixlen == 16)
-					continue;
-				if (IN_CLASSA(destination)
-				    && rn->p.prefixlen == 8)
-					continue;
-			}
-			if (type == bgp_show_type_prefix_longer) {
-				struct prefix *p = output_arg;
+			destination = ntohl(rn->p.u.prefix4.s_addr);
+			if (IN_CLASSC(destination)
+			    && rn->p.prefixlen == 24)
+				continue;
+			if (IN_CLASSB(destination)
+			    && rn->p.prefixlen == 16)
+				continue;
+			if (IN_CLASSA(destination)
+			    && rn->p.prefixlen == 8)
+				continue;
+		}
+		if (type == bgp_show_type_prefix_longer) {
+			struct prefix *p = output_arg;
 
-				if (!prefix_match(p, &rn->p))
-					continue;
-			}
-			if (type == bgp_show_type_community_all) {
-				if (!ri->attr->community)
-					continue;
-			}
-			if (type == bgp_show_type_community) {
-				struct community *com = output_arg;
+			if (!prefix_match(p, &rn->p))
+				continue;
+		}
+		if (type == bgp_show_type_community_all) {
+			if (!ri->attr->community)
+				continue;
+		}
+		if (type == bgp_show_type_community) {
+			struct community *com = output_arg;
 
-				if (!ri->attr->community
-				    || !community_match(ri->attr->community,
-							com))
-					continue;
-			}
-			if (type == bgp_show_type_community_exact) {
-				struct community *com = output_arg;
+			if (!ri->attr->community
+			    || !community_match(ri->attr->community,
+						com))
+				continue;
+		}
+		if (type == bgp_show_type_community_exact) {
+			struct community *com = output_arg;
 
-				if (!ri->attr->community
-				    || !community_cmp(ri->attr->community, com))
-					continue;
-			}
-			if (type == bgp_show_type_community_list) {
-				struct community_list *list = output_arg;
+			if (!ri->attr->community
+			    || !community_cmp(ri->attr->community, com))
+				continue;
+		}
+		if (type == bgp_show_type_community_list) {
+			struct community_list *list = output_arg;
 
-				if (!community_list_match(ri->attr->community,
-							  list))
-					continue;
-			}
-			if (type == bgp_show_type_community_list_exact) {
-				struct community_list *list = output_arg;
+			if (!community_list_match(ri->attr->community,
+						  list))
+				continue;
+		}
+		if (type == bgp_show_type_community_list_exact) {
+			struct community_list *list = output_arg;
 
-				if (!community_list_exact_match(
-					    ri->attr->community, list))
-					continue;
-			}
-			if (type == bgp_show_type_lcommunity) {
-				struct lcommunity *lcom = output_arg;
+			if (!community_list_exact_match(
+				    ri->attr->community, list))
+				continue;
+		}
+		if (type == bgp_show_type_lcommunity) {
+			struct lcommunity *lcom = output_arg;
 
-				if (!ri->attr->lcommunity
-				    || !lcommunity_match(ri->attr->lcommunity,
-							 lcom))
-					continue;
-			}
-			if (type == bgp_show_type_lcommunity_list) {
-				struct community_list *list = output_arg;
+			if (!ri->attr->lcommunity
+			    || !lcommunity_match(ri->attr->lcommunity,
+						 lcom))
+				continue;
+		}
+		if (type == bgp_show_type_lcommunity_list) {
+			struct community_list *list = output_arg;
 
-				if (!lcommunity_list_match(ri->attr->lcommunity,
-							   list))
-					continue;
-			}
-			if (type == bgp_show_type_lcommunity_all) {
-				if (!ri->attr->lcommunity)
-					continue;
-			}
-			if (type == bgp_show_type_dampend_paths
-			    || type == bgp_show_type_damp_neighbor) {
-				if (!CHECK_FLAG(ri->flags, BGP_INFO_DAMPED)
-				    || CHECK_FLAG(ri->flags, BGP_INFO_HISTORY))
-					continue;
-			}
+			if (!lcommunity_list_match(ri->attr->lcommunity,
+						   list))
+				continue;
+		}
+		if (type == bgp_show_type_lcommunity_all) {
+			if (!ri->attr->lcommunity)
+				continue;
+		}
+		if (type == bgp_show_type_dampend_paths
+		    || type == bgp_show_type_damp_neighbor) {
+			if (!CHECK_FLAG(ri->flags, BGP_INFO_DAMPED)
+			    || CHECK_FLAG(ri->flags, BGP_INFO_HISTORY))
+				continue;
+		}
 
-			if (!use_json && header) {
-				vty_out(vty, "BGP table version is %" PRIu64
-					     ", local router ID is %s\n",
-					table->version,
-					inet_ntoa(bgp->router_id));
-				vty_out(vty, BGP_SHOW_SCODE_HEADER);
-				vty_out(vty, BGP_SHOW_OCODE_HEADER);
-				if (type == bgp_show_type_dampend_paths
-				    || type == bgp_show_type_damp_neighbor)
-					vty_out(vty, BGP_SHOW_DAMP_HEADER);
-				else if (type == bgp_show_type_flap_statistics
-					 || type == bgp_show_type_flap_neighbor)
-					vty_out(vty, BGP_SHOW_FLAP_HEADER);
-				else
-					vty_out(vty, BGP_SHOW_HEADER);
-				header = 0;
-			}
-			if (rd != NULL && !display && !output_count) {
-				if (!use_json)
-					vty_out(vty,
-						"Route Distinguisher: %s\n",
-						rd);
-			}
+		if (!use_json && *header) {
+			vty_out(vty, "BGP table version is %" PRIu64
+				     ", local router ID is %s\n",
+				table->version,
+				inet_ntoa(bgp->router_id));
+			vty_out(vty, BGP_SHOW_SCODE_HEADER);
+			vty_out(vty, BGP_SHOW_OCODE_HEADER);
 			if (type == bgp_show_type_dampend_paths
 			    || type == bgp_show_type_damp_neighbor)
-				damp_route_vty_out(vty, &rn->p, ri, display,
-						   safi, use_json, json_paths);
+				vty_out(vty, BGP_SHOW_DAMP_HEADER);
 			else if (type == bgp_show_type_flap_statistics
 				 || type == bgp_show_type_flap_neighbor)
-				flap_route_vty_out(vty, &rn->p, ri, display,
-						   safi, use_json, json_paths);
+				vty_out(vty, BGP_SHOW_FLAP_HEADER);
 			else
-				route_vty_out(vty, &rn->p, ri, display, safi,
-					      json_paths);
-			display++;
+				vty_out(vty, BGP_SHOW_HEADER);
+			*header = 0;
 		}
-
-		if (display) {
-			output_count++;
+		if (rd != NULL && !display && !output_count) {
 			if (!use_json)
-				continue;
+				vty_out(vty,
+					"Route Distinguisher: %s\n",
+					rd);
+		}
+		if (type == bgp_show_type_dampend_paths
+		    || type == bgp_show_type_damp_neighbor)
+			damp_route_vty_out(vty, &rn->p, ri, display,
+					   safi, use_json, json_paths);
+		else if (type == bgp_show_type_flap_statistics
+			 || type == bgp_show_type_flap_neighbor)
+			flap_route_vty_out(vty, &rn->p, ri, display,
+					   safi, use_json, json_paths);
+		else
+			route_vty_out(vty, &rn->p, ri, display, safi,
+				      json_paths);
+		display++;
+	}
 
-			p = &rn->p;
-			sprintf(buf2, "%s/%d",
-				inet_ntop(p->family, &p->u.prefix, buf, BUFSIZ),
-				p->prefixlen);
-			if (first)
-				vty_out(vty, "\"%s\": ", buf2);
-			else
-				vty_out(vty, ",\"%s\": ", buf2);
+	if (!use_json)
+		return display;
 
-			vty_out(vty, "%s",
-				json_object_to_json_string(json_paths));
-			json_object_free(json_paths);
-			json_paths = NULL;
-			first = 0;
-		}
+	if (!display) {
+		json_object_free(json_paths);
+		return 0;
 	}
 
-	if (output_cum) {
-		output_count += *output_cum;
-		*output_cum = output_count;
-	}
-	if (total_cum) {
-		total_count += *total_cum;
-		*total_cum = total_count;
+	p = &rn->p;
+	sprintf(buf2, "%s/%d", inet_ntop(p->family, &p->u.prefix, buf, BUFSIZ),
+		p->prefixlen);
+	json_stream_object(js, buf2, json_paths);
+	return display;
+}
+
+static void bgp_show_table_start(struct bgp *bgp, struct bgp_table *table,
+				 uint8_t use_json, char *rd,
+				 struct json_stream *js)
+{
+	if (!use_json)
+		return;
+
+	if (!js->depth) {
+		json_stream_object_start(js, NULL);
+		json_stream_int(js, "vrfId",
+				bgp->vrf_id == VRF_UNKNOWN ? -1
+							   : (int)bgp->vrf_id);
+		json_stream_string(js, "vrfName",
+				   bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT
+					   ? "Default"
+					   : bgp->name);
+		json_stream_int(js, "tableVersion", table->version);
+		json_stream_string(js, "routerId", inet_ntoa(bgp->router_id));
+		json_stream_object_start(js, "routes");
+		if (rd)
+			json_stream_object_start(js, "routeDistinguishers");
 	}
+
+	if (rd)
+		json_stream_object_start(js, rd);
+}
+
+static void bgp_show_table_end(struct vty *vty, enum bgp_show_type type,
+			       uint8_t use_json, char *rd, int is_last,
+			       unsigned long output_count,
+			       unsigned long total_count,
+			       struct json_stream *js)
+{
 	if (use_json) {
-		if (json_paths)
-			json_object_free(json_paths);
-		if (rd) {
-			vty_out(vty, " }%s ", (is_last ? "" : ","));
-		}
-		if (is_last) {
-			unsigned long i;
-			for (i = 0; i < *json_header_depth; ++i)
-				vty_out(vty, " } ");
-		}
+		if (rd)
+			json_stream_end(js);
+		if (is_last)
+			while (js->depth)
+				json_stream_end(js);
 	} else {
 		if (is_last) {
 			/* No route is displayed */
@@ -8409,10 +8955,115 @@ static int bgp_show_table(struct vty *vty, struct bgp *bgp, safi_t safi,
 					output_count, total_count);
 		}
 	}
+}
+
+static int bgp_show_table(struct vty *vty, struct bgp *bgp, safi_t safi,
+			  struct bgp_table *table, enum bgp_show_type type,
+			  void *output_arg, uint8_t use_json, char *rd,
+			  int is_last, unsigned long *output_cum,
+			  unsigned long *total_cum, struct json_stream *js)
+{
+	struct bgp_node *rn;
+	int header = 1;
+	unsigned long output_count = 0;
+	unsigned long total_count = 0;
+
+	if (output_cum && *output_cum != 0)
+		header = 0;
+
+	bgp_show_table_start(bgp, table, use_json, rd, js);
+
+	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn))
+		if (bgp_show_node(vty, bgp, safi, table, rn, type, output_arg,
+				  use_json, rd, &header, output_count,
+				  &total_count, js))
+			output_count++;
+
+	if (output_cum) {
+		output_count += *output_cum;
+		*output_cum = output_count;
+	}
+	if (total_cum) {
+		total_count += *total_cum;
+		*total_cum = total_count;
+	}
+	bgp_show_table_end(vty, type, use_json, rd, is_last, output_count,
+			   total_count, js);
 
 	return CMD_SUCCESS;
 }
 
+/* How many nodes a deferred "show bgp" looks at in one go */
+#define BGP_SHOW_PART_NODES 512
+
+/* A "show bgp" of a whole table, output a part at a time */
+struct bgp_show_part {
+	struct bgp *bgp;
+	safi_t safi;
+	enum bgp_show_type type;
+	uint8_t use_json;
+	bgp_table_iter_t iter;
+	int header;
+	unsigned long output_count;
+	unsigned long total_count;
+	struct json_stream js;
+};
+
+static bool bgp_show_part_more(struct vty *vty, void *arg)
+{
+	struct bgp_show_part *part = arg;
+	struct bgp_node *rn;
+	int n = 0;
+
+	while ((rn = bgp_table_iter_next(&part->iter))) {
+		if (bgp_show_node(vty, part->bgp, part->safi, part->iter.table,
+				  rn, part->type, NULL, part->use_json, NULL,
+				  &part->header, part->output_count,
+				  &part->total_count, &part->js))
+			part->output_count++;
+
+		if (++n == BGP_SHOW_PART_NODES) {
+			bgp_table_iter_pause(&part->iter);
+			return true;
+		}
+	}
+
+	bgp_show_table_end(vty, part->type, part->use_json, NULL, 1,
+			   part->output_count, part->total_count, &part->js);
+	return false;
+}
+
+static void bgp_show_part_free(void *arg)
+{
+	struct bgp_show_part *part = arg;
+
+	bgp_table_iter_cleanup(&part->iter);
+	bgp_unlock(part->bgp);
+	XFREE(MTYPE_BGP_SHOW_PART, part);
+}
+
+/* bgp_show_table() for a whole table without output_arg, which the vty can
+ * have output while the daemon goes on with other work */
+static int bgp_show_table_defer(struct vty *vty, struct bgp *bgp, safi_t safi,
+				struct bgp_table *table,
+				enum bgp_show_type type, uint8_t use_json)
+{
+	struct bgp_show_part *part;
+
+	part = XCALLOC(MTYPE_BGP_SHOW_PART, sizeof(*part));
+	part->bgp = bgp_lock(bgp);
+	part->safi = safi;
+	part->type = type;
+	part->use_json = use_json;
+	part->header = 1;
+	json_stream_init(&part->js, vty);
+	bgp_table_iter_init(&part->iter, table);
+
+	bgp_show_table_start(bgp, table, use_json, NULL, &part->js);
+	return vty_output_defer(vty, bgp_show_part_more, bgp_show_part_free,
+				part);
+}
+
 int bgp_show_table_rd(struct vty *vty, struct bgp *bgp, safi_t safi,
 		      struct bgp_table *table, struct prefix_rd *prd_match,
 		      enum bgp_show_type type, void *output_arg,
@@ -8421,9 +9072,11 @@ int bgp_show_table_rd(struct vty *vty, struct bgp *bgp, safi_t safi,
 	struct bgp_node *rn, *next;
 	unsigned long output_cum = 0;
 	unsigned long total_cum = 0;
-	unsigned long json_header_depth = 0;
+	struct json_stream js;
 	bool show_msg;
 
+	json_stream_init(&js, vty);
+
 	show_msg = (!use_json && type == bgp_show_type_normal);
 
 	for (rn = bgp_table_top(table); rn; rn = next) {
@@ -8438,12 +9091,14 @@ int bgp_show_table_rd(struct vty *vty, struct bgp *bgp, safi_t safi,
 			prefix_rd2str(&prd, rd, sizeof(rd));
 			bgp_show_table(vty, bgp, safi, rn->info, type,
 				       output_arg, use_json, rd, next == NULL,
-				       &output_cum, &total_cum,
-				       &json_header_depth);
+				       &output_cum, &total_cum, &js);
 			if (next == NULL)
 				show_msg = false;
 		}
 	}
+	/* the last RD may have been skipped */
+	while (js.depth)
+		json_stream_end(&js);
 	if (show_msg) {
 		if (output_cum == 0)
 			vty_out(vty, "No BGP prefixes displayed, %ld exist\n",
@@ -8455,11 +9110,14 @@ int bgp_show_table_rd(struct vty *vty, struct bgp *bgp, safi_t safi,
 	}
 	return CMD_SUCCESS;
 }
-static int bgp_show(struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
-		    enum bgp_show_type type, void *output_arg, uint8_t use_json)
+/* With defer, a whole table is output a part at a time; that must be the
+ * last thing the command outputs. */
+static int bgp_show_instance(struct vty *vty, struct bgp *bgp, afi_t afi,
+			     safi_t safi, enum bgp_show_type type,
+			     void *output_arg, uint8_t use_json, bool defer)
 {
 	struct bgp_table *table;
-	unsigned long json_header_depth = 0;
+	struct json_stream js;
 
 	if (bgp == NULL) {
 		bgp = bgp_get_default();
@@ -8489,8 +9147,20 @@ static int bgp_show(struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
 	else if (safi == SAFI_LABELED_UNICAST)
 		safi = SAFI_UNICAST;
 
+	if (defer && !output_arg)
+		return bgp_show_table_defer(vty, bgp, safi, table, type,
+					    use_json);
+
+	json_stream_init(&js, vty);
 	return bgp_show_table(vty, bgp, safi, table, type, output_arg, use_json,
-			      NULL, 1, NULL, NULL, &json_header_depth);
+			      NULL, 1, NULL, NULL, &js);
+}
+
+static int bgp_show(struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
+		    enum bgp_show_type type, void *output_arg, uint8_t use_json)
+{
+	return bgp_show_instance(vty, bgp, afi, safi, type, output_arg,
+				 use_json, true);
 }
 
 static void bgp_show_all_instances_routes_vty(struct vty *vty, afi_t afi,
@@ -8520,8 +9190,8 @@ static void bgp_show_all_instances_routes_vty(struct vty *vty, afi_t afi,
 					? "Default"
 					: bgp->name);
 		}
-		bgp_show(vty, bgp, afi, safi, bgp_show_type_normal, NULL,
-			 use_json);
+		bgp_show_instance(vty, bgp, afi, safi, bgp_show_type_normal,
+				  NULL, use_json, false);
 	}
 
 	if (use_json)
@@ -9786,12 +10456,12 @@ static int bgp_peer_count_walker(struct thread *t)
 	const struct peer *peer = pc->peer;
 
 	for (rn = bgp_table_top(pc->table); rn; rn = bgp_route_next(rn)) {
-		struct bgp_adj_in *ain;
+		struct bgp_adj_in_iter iter;
 		struct bgp_info *ri;
 
-		for (ain = rn->adj_in; ain; ain = ain->next)
-			if (ain->peer == peer)
-				pc->count[PCOUNT_ADJ_IN]++;
+		bgp_adj_in_iter_init(&iter, rn);
+		while (bgp_adj_in_next(&iter, peer))
+			pc->count[PCOUNT_ADJ_IN]++;
 
 		for (ri = rn->info; ri; ri = ri->next) {
 			char buf[SU_ADDRSTRLEN];
@@ -10062,7 +10732,8 @@ static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi,
 			   uint8_t use_json, json_object *json)
 {
 	struct bgp_table *table;
-	struct bgp_adj_in *ain;
+	struct bgp_adj_in_iter iter;
+	struct attr *ain_attr;
 	struct bgp_adj_out *adj;
 	unsigned long output_count;
 	unsigned long filtered_count;
@@ -10144,9 +10815,8 @@ static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi,
 
 	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn)) {
 		if (in) {
-			for (ain = rn->adj_in; ain; ain = ain->next) {
-				if (ain->peer != peer)
-					continue;
+			bgp_adj_in_iter_init(&iter, rn);
+			while ((ain_attr = bgp_adj_in_next(&iter, peer))) {
 				if (header1) {
 					if (use_json) {
 						json_object_int_add(
@@ -10180,11 +10850,11 @@ static void show_adj_route(struct vty *vty, struct peer *peer, afi_t afi,
 						vty_out(vty, BGP_SHOW_HEADER);
 					header2 = 0;
 				}
-				if (ain->attr) {
-					bgp_attr_dup(&attr, ain->attr);
+				if (ain_attr) {
+					bgp_attr_dup(&attr, ain_attr);
 					if (bgp_input_modifier(peer, &rn->p,
 							       &attr, afi, safi,
-							       rmap_name)
+							       rmap_name, NULL)
 					    != RMAP_DENY) {
 						route_vty_out_tmp(vty, &rn->p,
 								  &attr, safi,
@@ -11548,4 +12218,15 @@ void bgp_route_finish(void)
 		bgp_table_unlock(bgp_distance_table[afi][safi]);
 		bgp_distance_table[afi][safi] = NULL;
 	}
+
+	/* paths still around at this point are reported as leaks */
+	if (bgp_info_slab && !slab_count(bgp_info_slab)) {
+		slab_del(bgp_info_slab);
+		bgp_info_slab = NULL;
+	}
+	if (bgp_info_extra_slab && !slab_count(bgp_info_extra_slab)) {
+		slab_del(bgp_info_extra_slab);
+		bgp_info_extra_slab = NULL;
+	}
+	bgp_adj_in_finish();
 }
@@ -23,6 +23,7 @@
 
 #include "queue.h"
 #include "nexthop.h"
+#include "pipeline_stats.h"
 #include "bgp_table.h"
 
 struct bgp_nexthop_cache;
@@ -76,6 +77,10 @@ struct bgp_info_extra {
 	/* This route is suppressed with aggregation.  */
 	int suppress;
 
+	/* Attributes the route is counted with in the aggregates covering
+	 * it, see bgp_aggregate_increment().  */
+	struct attr *aggregate_attr;
+
 	/* Nexthop reachability check.  */
 	uint32_t igpmetric;
 
@@ -83,6 +88,11 @@ struct bgp_info_extra {
 	mpls_label_t label[BGP_MAX_LABELS];
 	uint32_t num_labels;
 
+	/* RPKI origin validation state cached for the origin AS next to it;
+	 * 0 if not known (see bgp_rpki.c). */
+	uint8_t rpki_state;
+	as_t rpki_origin_as;
+
 #if ENABLE_BGP_VNC
 	union {
 
@@ -146,6 +156,10 @@ struct bgp_info {
 	struct bgp_info *next;
 	struct bgp_info *prev;
 
+	/* For the peer's list of paths, see bgp_info_add() */
+	struct bgp_info *peer_next;
+	struct bgp_info *peer_prev;
+
 	/* For nexthop linked list */
 	LIST_ENTRY(bgp_info) nh_thread;
 
@@ -191,6 +205,7 @@ struct bgp_info {
 #define BGP_INFO_MULTIPATH_CHG  (1 << 12)
 #define BGP_INFO_RIB_ATTR_CHG   (1 << 13)
 #define BGP_INFO_ANNC_NH_SELF   (1 << 14)
+#define BGP_INFO_ADJ_IN         (1 << 15)
 
 	/* BGP route type.  This can be static, RIP, OSPF, BGP etc.  */
 	uint8_t type;
@@ -337,9 +352,13 @@ extern void bgp_announce_route_all(struct peer *);
 extern void bgp_default_originate(struct peer *, afi_t, safi_t, int);
 extern void bgp_soft_reconfig_in(struct peer *, afi_t, safi_t);
 extern void bgp_clear_route(struct peer *, afi_t, safi_t);
+extern bool bgp_clear_route_pending(struct peer *);
 extern void bgp_clear_route_all(struct peer *);
 extern void bgp_clear_adj_in(struct peer *, afi_t, safi_t);
 extern void bgp_clear_stale_route(struct peer *, afi_t, safi_t);
+extern void bgp_rib_restore(struct peer *peer, afi_t afi, safi_t safi,
+			    struct prefix *p, struct attr *attr,
+			    time_t uptime);
 
 extern struct bgp_node *bgp_afi_node_get(struct bgp_table *table, afi_t afi,
 					 safi_t safi, struct prefix *p,
@@ -350,6 +369,7 @@ extern void bgp_info_add(struct bgp_node *rn, struct bgp_info *ri);
 extern void bgp_info_reap(struct bgp_node *rn, struct bgp_info *ri);
 extern void bgp_info_delete(struct bgp_node *rn, struct bgp_info *ri);
 extern struct bgp_info_extra *bgp_info_extra_get(struct bgp_info *);
+extern void bgp_info_extra_free(struct bgp_info_extra **extra);
 extern void bgp_info_set_flag(struct bgp_node *, struct bgp_info *, uint32_t);
 extern void bgp_info_unset_flag(struct bgp_node *, struct bgp_info *, uint32_t);
 extern void bgp_info_path_with_addpath_rx_str(struct bgp_info *ri, char *buf);
@@ -395,6 +415,29 @@ extern int bgp_withdraw(struct peer *, struct prefix *, uint32_t, struct attr *,
 /* for bgp_nexthop and bgp_damp */
 extern void bgp_process(struct bgp *, struct bgp_node *, afi_t, safi_t);
 
+/*
+ * Latency of sampled prefixes from the UPDATE being read to the route
+ * being sent to zebra, which carries on timing it to the kernel.
+ */
+enum bgp_pipeline_stage {
+	BGP_PIPELINE_QUEUE,
+	BGP_PIPELINE_BESTPATH,
+	BGP_PIPELINE_TOTAL,
+	BGP_PIPELINE_STAGES
+};
+extern struct pipeline_stage bgp_pipeline[];
+
+/* read time of the UPDATE being processed, 0 unless timing it */
+extern int64_t bgp_pipeline_rx_usec;
+extern int64_t bgp_pipeline_rx(struct peer *peer);
+extern void bgp_pipeline_reset(void);
+
+/*
+ * For a prefix being announced to zebra, returns when its UPDATE was read
+ * if it is being timed, or 0.
+ */
+extern int64_t bgp_pipeline_announce(struct bgp_node *rn);
+
 /*
  * Add an end-of-initial-update marker to the process queue. This is just a
  * queue element with NULL bgp node.
@@ -448,6 +491,7 @@ extern struct bgp_node *bgp_afi_node_lookup(struct bgp_table *table, afi_t afi,
 					    safi_t safi, struct prefix *p,
 					    struct prefix_rd *prd);
 extern struct bgp_info *bgp_info_new(void);
+extern void bgp_info_mem_free(struct bgp_info *binfo);
 extern void bgp_info_restore(struct bgp_node *, struct bgp_info *);
 
 extern int bgp_info_cmp_compatible(struct bgp *, struct bgp_info *,
@@ -368,7 +368,7 @@ static void route_match_ip_address_free(void *rule)
 /* Route map commands for ip address matching. */
 struct route_map_rule_cmd route_match_ip_address_cmd = {
 	"ip address", route_match_ip_address, route_match_ip_address_compile,
-	route_match_ip_address_free};
+	route_match_ip_address_free, RMAP_CACHE_PREFIX};
 
 /* `match ip next-hop IP_ADDRESS' */
 
@@ -415,7 +415,7 @@ static void route_match_ip_next_hop_free(void *rule)
 /* Route map commands for ip next-hop matching. */
 struct route_map_rule_cmd route_match_ip_next_hop_cmd = {
 	"ip next-hop", route_match_ip_next_hop, route_match_ip_next_hop_compile,
-	route_match_ip_next_hop_free};
+	route_match_ip_next_hop_free, RMAP_CACHE_OBJECT};
 
 /* `match ip route-source ACCESS-LIST' */
 
@@ -503,7 +503,7 @@ static void route_match_ip_address_prefix_list_free(void *rule)
 struct route_map_rule_cmd route_match_ip_address_prefix_list_cmd = {
 	"ip address prefix-list", route_match_ip_address_prefix_list,
 	route_match_ip_address_prefix_list_compile,
-	route_match_ip_address_prefix_list_free};
+	route_match_ip_address_prefix_list_free, RMAP_CACHE_PREFIX};
 
 /* `match ip next-hop prefix-list PREFIX_LIST' */
 
@@ -545,7 +545,7 @@ static void route_match_ip_next_hop_prefix_list_free(void *rule)
 struct route_map_rule_cmd route_match_ip_next_hop_prefix_list_cmd = {
 	"ip next-hop prefix-list", route_match_ip_next_hop_prefix_list,
 	route_match_ip_next_hop_prefix_list_compile,
-	route_match_ip_next_hop_prefix_list_free};
+	route_match_ip_next_hop_prefix_list_free, RMAP_CACHE_OBJECT};
 
 /* `match ip route-source prefix-list PREFIX_LIST' */
 
@@ -844,6 +844,7 @@ static route_map_result_t route_match_metric(void *rule, struct prefix *prefix,
 /* Route map commands for metric matching. */
 struct route_map_rule_cmd route_match_metric_cmd = {
 	"metric", route_match_metric, route_value_compile, route_value_free,
+	RMAP_CACHE_OBJECT,
 };
 
 /* `match as-path ASPATH' */
@@ -888,7 +889,7 @@ static void route_match_aspath_free(void *rule)
 /* Route map commands for aspath matching. */
 struct route_map_rule_cmd route_match_aspath_cmd = {
 	"as-path", route_match_aspath, route_match_aspath_compile,
-	route_match_aspath_free};
+	route_match_aspath_free, RMAP_CACHE_OBJECT};
 
 /* `match community COMMUNIY' */
 struct rmap_community {
@@ -962,7 +963,7 @@ static void route_match_community_free(void *rule)
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_community_cmd = {
 	"community", route_match_community, route_match_community_compile,
-	route_match_community_free};
+	route_match_community_free, RMAP_CACHE_OBJECT};
 
 /* Match function for lcommunity match. */
 static route_map_result_t route_match_lcommunity(void *rule,
@@ -1022,7 +1023,8 @@ static void route_match_lcommunity_free(void *rule)
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_lcommunity_cmd = {
 	"large-community", route_match_lcommunity,
-	route_match_lcommunity_compile, route_match_lcommunity_free};
+	route_match_lcommunity_compile, route_match_lcommunity_free,
+	RMAP_CACHE_OBJECT};
 
 
 /* Match function for extcommunity match. */
@@ -1063,7 +1065,7 @@ static void route_match_ecommunity_free(void *rule)
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_ecommunity_cmd = {
 	"extcommunity", route_match_ecommunity, route_match_ecommunity_compile,
-	route_match_ecommunity_free};
+	route_match_ecommunity_free, RMAP_CACHE_OBJECT};
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
    and `address-family vpnv4'.  */
@@ -1112,7 +1114,7 @@ static void route_match_origin_free(void *rule)
 /* Route map commands for origin matching. */
 struct route_map_rule_cmd route_match_origin_cmd = {
 	"origin", route_match_origin, route_match_origin_compile,
-	route_match_origin_free};
+	route_match_origin_free, RMAP_CACHE_OBJECT};
 
 /* match probability  { */
 
@@ -1239,7 +1241,7 @@ static route_map_result_t route_match_tag(void *rule, struct prefix *prefix,
 /* Route map commands for tag matching. */
 static struct route_map_rule_cmd route_match_tag_cmd = {
 	"tag", route_match_tag, route_map_rule_tag_compile,
-	route_map_rule_tag_free,
+	route_map_rule_tag_free, RMAP_CACHE_OBJECT,
 };
 
 
@@ -2264,7 +2266,8 @@ static void route_match_ipv6_address_free(void *rule)
 /* Route map commands for ip address matching. */
 struct route_map_rule_cmd route_match_ipv6_address_cmd = {
 	"ipv6 address", route_match_ipv6_address,
-	route_match_ipv6_address_compile, route_match_ipv6_address_free};
+	route_match_ipv6_address_compile, route_match_ipv6_address_free,
+	RMAP_CACHE_PREFIX};
 
 /* `match ipv6 next-hop IP_ADDRESS' */
 
@@ -2351,7 +2354,7 @@ static void route_match_ipv6_address_prefix_list_free(void *rule)
 struct route_map_rule_cmd route_match_ipv6_address_prefix_list_cmd = {
 	"ipv6 address prefix-list", route_match_ipv6_address_prefix_list,
 	route_match_ipv6_address_prefix_list_compile,
-	route_match_ipv6_address_prefix_list_free};
+	route_match_ipv6_address_prefix_list_free, RMAP_CACHE_PREFIX};
 
 /* `set ipv6 nexthop global IP_ADDRESS' */
 
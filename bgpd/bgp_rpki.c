@@ -37,6 +37,7 @@
 #include "memory.h"
 #include "thread.h"
 #include "filter.h"
+#include "mpscq.h"
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
 #include "bgp_advertise.h"
@@ -61,6 +62,7 @@
 
 DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_CACHE, "BGP RPKI Cache server")
 DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_CACHE_GROUP, "BGP RPKI Cache server group")
+DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_REVALIDATE, "BGP RPKI revalidation")
 
 #define RPKI_VALID      1
 #define RPKI_NOTFOUND   2
@@ -72,6 +74,11 @@ DEFINE_MTYPE_STATIC(BGPD, BGP_RPKI_CACHE_GROUP, "BGP RPKI Cache server group")
 #define TIMEOUT_DEFAULT 600
 #define INITIAL_SYNCHRONISATION_TIMEOUT_DEFAULT 30
 
+/* ROA changes handled per event on the main pthread */
+#define REVALIDATE_BATCH 1024
+/* validations per second are averaged over this many seconds */
+#define RATE_SECONDS 60
+
 #define RPKI_DEBUG(...)                                                        \
 	if (rpki_debug) {                                                      \
 		zlog_debug("RPKI: " __VA_ARGS__);                              \
@@ -97,6 +104,29 @@ struct rpki_for_each_record_arg {
 	unsigned int *prefix_amount;
 };
 
+/*
+ * A ROA rtrlib added or removed, queued by its pthread for the main pthread
+ * to revalidate the routes covered by the ROA's prefix.
+ */
+struct rpki_revalidate {
+	struct mpscq_item mq;
+	struct prefix prefix;
+};
+
+struct rpki_stats {
+	/* validations done through rtrlib, and per second for the last
+	 * RATE_SECONDS */
+	unsigned long validations;
+	time_t rate_second[RATE_SECONDS];
+	unsigned int rate_count[RATE_SECONDS];
+	/* validations answered from the state cached on the route */
+	unsigned long cache_hits;
+	/* ROA changes reported by rtrlib, counted on its pthread */
+	_Atomic unsigned long roa_changes;
+	/* routes whose cached state was dropped because of those */
+	unsigned long revalidated;
+};
+
 static int start(void);
 static void stop(void);
 static int reset(bool force);
@@ -135,6 +165,15 @@ static unsigned int expire_interval;
 static unsigned int retry_interval;
 static unsigned int timeout;
 static unsigned int initial_synchronisation_timeout;
+static struct mpscq revalidate_queue;
+static _Atomic bool revalidate_posted;
+/*
+ * Whether the first synchronisation after start() completed; until then
+ * rpki_update() does not queue the ROAs, they are covered by revalidating
+ * everything.
+ */
+static _Atomic bool rpki_synced;
+static struct rpki_stats rpki_stats;
 
 static struct cmd_node rpki_node = {RPKI_NODE, "%s(config-rpki)# ", 1};
 static struct route_map_rule_cmd route_match_rpki_cmd = {
@@ -155,8 +194,14 @@ static void free_wrapper(void *ptr)
 	XFREE(MTYPE_BGP_RPKI_CACHE, ptr);
 }
 
-static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
-				struct prefix *prefix);
+static int rpki_validate_info(struct bgp_info *bgp_info,
+			      struct prefix *prefix);
+static void revalidate_all(void);
+static void rpki_update(struct pfx_table *pfx_table,
+			const struct pfx_record record, const bool added);
+static void rpki_status(const struct rtr_mgr_group *group,
+			enum rtr_mgr_status status,
+			const struct rtr_socket *socket, void *data);
 
 static route_map_result_t route_match(void *rule, struct prefix *prefix,
 				      route_map_object_t type, void *object)
@@ -167,10 +212,8 @@ static route_map_result_t route_match(void *rule, struct prefix *prefix,
 	if (type == RMAP_BGP) {
 		bgp_info = object;
 
-		if (rpki_validate_prefix(bgp_info->peer, bgp_info->attr, prefix)
-		    == *rpki_status) {
+		if (rpki_validate_info(bgp_info, prefix) == *rpki_status)
 			return RMAP_MATCH;
-		}
 	}
 	return RMAP_NOMATCH;
 }
@@ -283,6 +326,8 @@ static int bgp_rpki_init(struct thread_master *master)
 	cache_list = list_new();
 	cache_list->del = (void (*)(void *)) & free_cache;
 
+	mpscq_init(&revalidate_queue);
+
 	polling_period = POLLING_PERIOD_DEFAULT;
 	expire_interval = EXPIRE_INTERVAL_DEFAULT;
 	retry_interval = RETRY_INTERVAL_DEFAULT;
@@ -293,11 +338,22 @@ static int bgp_rpki_init(struct thread_master *master)
 	return 0;
 }
 
+/* Drops the ROA changes queued by rpki_update(). */
+static void revalidate_flush(void)
+{
+	struct mpscq_item *mi;
+
+	while ((mi = mpscq_pop(&revalidate_queue)))
+		XFREE(MTYPE_BGP_RPKI_REVALIDATE, mi);
+}
+
 static int bgp_rpki_fini(void)
 {
 	stop();
 	list_delete_and_null(&cache_list);
 
+	revalidate_flush();
+
 	return 0;
 }
 
@@ -326,13 +382,21 @@ static int start(void)
 	struct rtr_mgr_group *groups = get_groups();
 
 	ret = rtr_mgr_init(&rtr_config, groups, groups_len, polling_period,
-			   expire_interval, retry_interval, NULL, NULL, NULL,
-			   NULL);
+			   expire_interval, retry_interval, rpki_update, NULL,
+			   rpki_status, NULL);
 	if (ret == RTR_ERROR) {
 		RPKI_DEBUG("Init rtr_mgr failed.");
 		return ERROR;
 	}
 
+	/*
+	 * The ROAs are fetched anew.  rpki_update() reports each of them, but
+	 * until the first synchronisation completes revalidating the states
+	 * dropped here is enough.
+	 */
+	revalidate_all();
+	atomic_store_explicit(&rpki_synced, false, memory_order_seq_cst);
+
 	RPKI_DEBUG("Starting rtr_mgr.");
 	ret = rtr_mgr_start(rtr_config);
 	if (ret == RTR_ERROR) {
@@ -350,6 +414,9 @@ static int start(void)
 	}
 	if (rtr_mgr_conf_in_sync(rtr_config)) {
 		RPKI_DEBUG("Got synchronisation with at least one RPKI cache!");
+		/* nothing was validated while we waited */
+		atomic_store_explicit(&rpki_synced, true, memory_order_seq_cst);
+		revalidate_flush();
 	} else {
 		RPKI_DEBUG(
 			"Timeout expired! Proceeding without RPKI validation data.");
@@ -415,42 +482,62 @@ static void print_prefix_table(struct vty *vty)
 	vty_out(vty, "Number of IPv6 Prefixes: %u\n", number_of_ipv6_prefixes);
 }
 
-static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
-				struct prefix *prefix)
+/*
+ * Finds the origin AS of a path to validate against, returns false if it
+ * has none (AS_SET at the end of the path).
+ */
+static bool rpki_origin_as(struct peer *peer, struct attr *attr,
+			   as_t *as_number)
 {
 	struct assegment *as_segment;
-	as_t as_number = 0;
-	struct lrtr_ip_addr ip_addr_prefix;
-	enum pfxv_state result;
-	char buf[BUFSIZ];
-	const char *prefix_string;
-
-	if (!is_synchronized())
-		return 0;
 
 	// No aspath means route comes from iBGP
 	if (!attr->aspath || !attr->aspath->segments) {
 		// Set own as number
-		as_number = peer->bgp->as;
+		*as_number = peer->bgp->as;
+		return true;
+	}
+
+	as_segment = attr->aspath->segments;
+	// Find last AsSegment
+	while (as_segment->next)
+		as_segment = as_segment->next;
+
+	if (as_segment->type == AS_SEQUENCE) {
+		// Get rightmost asn
+		*as_number = as_segment->as[as_segment->length - 1];
+	} else if (as_segment->type == AS_CONFED_SEQUENCE
+		   || as_segment->type == AS_CONFED_SET) {
+		// Set own as number
+		*as_number = peer->bgp->as;
 	} else {
-		as_segment = attr->aspath->segments;
-		// Find last AsSegment
-		while (as_segment->next)
-			as_segment = as_segment->next;
-
-		if (as_segment->type == AS_SEQUENCE) {
-			// Get rightmost asn
-			as_number = as_segment->as[as_segment->length - 1];
-		} else if (as_segment->type == AS_CONFED_SEQUENCE
-			   || as_segment->type == AS_CONFED_SET) {
-			// Set own as number
-			as_number = peer->bgp->as;
-		} else {
-			// RFC says: "Take distinguished value NONE as asn"
-			// which means state is unknown
-			return RPKI_NOTFOUND;
-		}
+		// RFC says: "Take distinguished value NONE as asn"
+		// which means state is unknown
+		return false;
+	}
+	return true;
+}
+
+static void rpki_stats_count(void)
+{
+	time_t now = monotime(NULL);
+	unsigned int i = now % RATE_SECONDS;
+
+	if (rpki_stats.rate_second[i] != now) {
+		rpki_stats.rate_second[i] = now;
+		rpki_stats.rate_count[i] = 0;
 	}
+	rpki_stats.rate_count[i]++;
+	rpki_stats.validations++;
+}
+
+/* Asks rtrlib for the state of the prefix originated by as_number. */
+static int rpki_validate_prefix(as_t as_number, struct prefix *prefix)
+{
+	struct lrtr_ip_addr ip_addr_prefix;
+	enum pfxv_state result;
+	char buf[BUFSIZ];
+	const char *prefix_string;
 
 	// Get the prefix in requested format
 	switch (prefix->family) {
@@ -474,6 +561,7 @@ static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
 	// Do the actual validation
 	rtr_mgr_validate(rtr_config, as_number, &ip_addr_prefix,
 			 prefix->prefixlen, &result);
+	rpki_stats_count();
 
 	// Print Debug output
 	prefix_string =
@@ -503,6 +591,236 @@ static int rpki_validate_prefix(struct peer *peer, struct attr *attr,
 	return 0;
 }
 
+/*
+ * The state of a path is kept in its bgp_info_extra, if it has one, until
+ * a ROA covering the prefix changes or the path's origin AS does.
+ */
+static int rpki_validate_info(struct bgp_info *bgp_info,
+			      struct prefix *prefix)
+{
+	struct bgp_info_extra *extra = bgp_info->extra;
+	as_t as_number;
+	int state;
+
+	if (!is_synchronized())
+		return 0;
+
+	if (!rpki_origin_as(bgp_info->peer, bgp_info->attr, &as_number))
+		return RPKI_NOTFOUND;
+
+	if (extra && extra->rpki_state && extra->rpki_origin_as == as_number) {
+		rpki_stats.cache_hits++;
+		return extra->rpki_state;
+	}
+
+	state = rpki_validate_prefix(as_number, prefix);
+	if (extra) {
+		extra->rpki_state = state;
+		extra->rpki_origin_as = as_number;
+	}
+	return state;
+}
+
+/*
+ * Drops the states cached on the paths of a node and runs what we kept of
+ * the announcements (with soft-reconfiguration inbound) through the inbound
+ * policy again, so that "match rpki" sees the new state.
+ */
+static void revalidate_node(struct bgp_node *rn, afi_t afi, safi_t safi)
+{
+	struct bgp_adj_in *ain, *next;
+	struct bgp_info *ri;
+	uint32_t num_labels = 0;
+	mpls_label_t *label_pnt = NULL;
+
+	for (ri = rn->info; ri; ri = ri->next)
+		if (ri->extra && ri->extra->rpki_state) {
+			ri->extra->rpki_state = 0;
+			rpki_stats.revalidated++;
+		}
+
+	ri = rn->info;
+	if (ri && ri->extra)
+		num_labels = ri->extra->num_labels;
+	if (num_labels)
+		label_pnt = &ri->extra->label[0];
+
+	bgp_adj_in_expand(rn, NULL);
+	for (ain = rn->adj_in; ain; ain = next) {
+		next = ain->next;
+		bgp_update(ain->peer, &rn->p, ain->addpath_rx_id, ain->attr,
+			   afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL,
+			   label_pnt, num_labels, 1, NULL);
+	}
+}
+
+static const safi_t revalidate_safis[] = {SAFI_UNICAST, SAFI_MULTICAST,
+					  SAFI_LABELED_UNICAST};
+
+/* Revalidates the routes a ROA for prefix covers, in every instance. */
+static void revalidate_prefix(struct prefix *prefix)
+{
+	afi_t afi = family2afi(prefix->family);
+	struct bgp_table *table;
+	struct bgp_node *top, *rn;
+	struct listnode *node;
+	struct bgp *bgp;
+	unsigned int i;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		for (i = 0; i < array_size(revalidate_safis); i++) {
+			table = bgp->rib[afi][revalidate_safis[i]];
+			if (!table || !bgp_table_count(table))
+				continue;
+
+			top = bgp_node_subtree(table, prefix);
+			if (!top)
+				continue;
+			for (rn = bgp_lock_node(top); rn;
+			     rn = bgp_route_next_until(rn, top))
+				revalidate_node(rn, afi, revalidate_safis[i]);
+			bgp_unlock_node(top);
+		}
+	}
+}
+
+/*
+ * Forgets every cached state, when the ROAs are about to be fetched anew;
+ * routes that had one are revalidated.
+ */
+static void revalidate_all(void)
+{
+	struct bgp_table *table;
+	struct bgp_node *rn;
+	struct bgp_info *ri;
+	struct listnode *node;
+	struct bgp *bgp;
+	unsigned int i;
+	afi_t afi;
+
+	for (ALL_LIST_ELEMENTS_RO(bm->bgp, node, bgp)) {
+		for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
+			for (i = 0; i < array_size(revalidate_safis); i++) {
+				table = bgp->rib[afi][revalidate_safis[i]];
+				if (!table)
+					continue;
+
+				for (rn = bgp_table_top(table); rn;
+				     rn = bgp_route_next(rn)) {
+					for (ri = rn->info; ri; ri = ri->next)
+						if (ri->extra
+						    && ri->extra->rpki_state)
+							break;
+					if (ri)
+						revalidate_node(
+							rn, afi,
+							revalidate_safis[i]);
+				}
+			}
+		}
+	}
+}
+
+/* Runs on the main pthread, for ROA changes queued by rpki_update(). */
+static int revalidate_queued(struct thread *thread)
+{
+	struct rpki_revalidate *rv;
+	unsigned int n;
+
+	/* changes queued from now on come with another event */
+	atomic_store_explicit(&revalidate_posted, false, memory_order_seq_cst);
+
+	/* left from before start(), rpki_synchronised() drops them */
+	if (!atomic_load_explicit(&rpki_synced, memory_order_seq_cst))
+		return 0;
+
+	for (n = 0; n < REVALIDATE_BATCH; n++) {
+		rv = (struct rpki_revalidate *)mpscq_pop(&revalidate_queue);
+		if (!rv)
+			return 0;
+
+		revalidate_prefix(&rv->prefix);
+		XFREE(MTYPE_BGP_RPKI_REVALIDATE, rv);
+	}
+
+	/* give the other tasks a turn before doing the rest */
+	if (!atomic_exchange_explicit(&revalidate_posted, true,
+				      memory_order_seq_cst))
+		thread_add_event(bm->master, revalidate_queued, NULL, 0, NULL);
+	return 0;
+}
+
+/* Called by rtrlib, on its pthread, for each ROA added or removed. */
+static void rpki_update(struct pfx_table *pfx_table,
+			const struct pfx_record record, const bool added)
+{
+	struct rpki_revalidate *rv;
+
+	atomic_fetch_add_explicit(&rpki_stats.roa_changes, 1,
+				  memory_order_relaxed);
+	if (!atomic_load_explicit(&rpki_synced, memory_order_seq_cst))
+		return;
+
+	rv = XCALLOC(MTYPE_BGP_RPKI_REVALIDATE, sizeof(*rv));
+
+	switch (record.prefix.ver) {
+	case LRTR_IPV4:
+		rv->prefix.family = AF_INET;
+		rv->prefix.u.prefix4.s_addr =
+			htonl(record.prefix.u.addr4.addr);
+		break;
+
+#ifdef HAVE_IPV6
+	case LRTR_IPV6:
+		rv->prefix.family = AF_INET6;
+		ipv6_addr_to_network_byte_order(record.prefix.u.addr6.addr,
+						rv->prefix.u.prefix6.s6_addr32);
+		break;
+#endif /* HAVE_IPV6 */
+
+	default:
+		XFREE(MTYPE_BGP_RPKI_REVALIDATE, rv);
+		return;
+	}
+	rv->prefix.prefixlen = record.min_len;
+	apply_mask(&rv->prefix);
+
+	mpscq_push(&revalidate_queue, &rv->mq);
+
+	if (atomic_exchange_explicit(&revalidate_posted, true,
+				     memory_order_seq_cst))
+		return;
+
+	thread_post_event(bm->master, revalidate_queued, NULL, 0);
+}
+
+/*
+ * Runs on the main pthread when a group connected.  If start() gave up
+ * waiting for the first synchronisation, routes were validated against a
+ * partial set of ROAs since.
+ */
+static int rpki_synchronised(struct thread *thread)
+{
+	if (atomic_load_explicit(&rpki_synced, memory_order_seq_cst)
+	    || !is_synchronized())
+		return 0;
+
+	RPKI_DEBUG("Got synchronisation with at least one RPKI cache!");
+	atomic_store_explicit(&rpki_synced, true, memory_order_seq_cst);
+	revalidate_flush();
+	revalidate_all();
+	return 0;
+}
+
+/* Called by rtrlib, on its pthread, when a group's state changes. */
+static void rpki_status(const struct rtr_mgr_group *group,
+			enum rtr_mgr_status status,
+			const struct rtr_socket *socket, void *data)
+{
+	if (status == RTR_MGR_ESTABLISHED)
+		thread_post_event(bm->master, rpki_synchronised, NULL, 0);
+}
+
 static int add_cache(struct cache *cache)
 {
 	uint8_t preference = cache->preference;
@@ -997,6 +1315,42 @@ DEFUN (show_rpki_cache_connection,
 	return CMD_SUCCESS;
 }
 
+DEFUN (show_rpki_statistics,
+       show_rpki_statistics_cmd,
+       "show rpki statistics",
+       SHOW_STR
+       RPKI_OUTPUT_STRING
+       "Show prefix validation statistics\n")
+{
+	time_t now = monotime(NULL);
+	unsigned long minute = 0;
+	unsigned int last = 0;
+	unsigned int i;
+
+	/* the current second is still being counted */
+	for (i = 0; i < RATE_SECONDS; i++) {
+		if (rpki_stats.rate_second[i] == now - 1)
+			last = rpki_stats.rate_count[i];
+		if (rpki_stats.rate_second[i] < now
+		    && rpki_stats.rate_second[i] >= now - RATE_SECONDS)
+			minute += rpki_stats.rate_count[i];
+	}
+
+	vty_out(vty, "Validations: %lu\n", rpki_stats.validations);
+	vty_out(vty,
+		"Validations per second: %u (average over %d seconds: %lu)\n",
+		last, RATE_SECONDS, minute / RATE_SECONDS);
+	vty_out(vty, "Cached states used: %lu\n", rpki_stats.cache_hits);
+	vty_out(vty, "ROA changes: %lu\n",
+		atomic_load_explicit(&rpki_stats.roa_changes,
+				     memory_order_relaxed));
+	vty_out(vty, "ROA changes pending: %zu\n",
+		mpscq_count(&revalidate_queue));
+	vty_out(vty, "Routes revalidated: %lu\n", rpki_stats.revalidated);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN_NOSH (rpki_exit,
 	    rpki_exit_cmd,
 	    "exit",
@@ -1176,6 +1530,7 @@ static void install_cli_commands(void)
 	install_element(ENABLE_NODE, &show_rpki_prefix_table_cmd);
 	install_element(ENABLE_NODE, &show_rpki_cache_connection_cmd);
 	install_element(ENABLE_NODE, &show_rpki_cache_server_cmd);
+	install_element(ENABLE_NODE, &show_rpki_statistics_cmd);
 
 	/* Install debug commands */
 	install_element(CONFIG_NODE, &debug_rpki_cmd);
@@ -29,6 +29,7 @@
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_table.h"
+#include "bgpd/bgp_flowspec_util.h"
 
 void bgp_table_lock(struct bgp_table *rt)
 {
@@ -44,6 +45,7 @@ void bgp_table_unlock(struct bgp_table *rt)
 		return;
 	}
 
+	bgp_flowspec_index_finish(rt);
 	route_table_finish(rt->route_table);
 	rt->route_table = NULL;
 
@@ -37,6 +37,9 @@ struct bgp_table {
 
 	struct route_table *route_table;
 	uint64_t version;
+
+	/* flowspec tables only, see bgp_flowspec_index_add() */
+	struct hash *flowspec_index;
 };
 
 struct bgp_node {
@@ -66,6 +69,9 @@ struct bgp_node {
 #define BGP_NODE_USER_CLEAR             (1 << 1)
 #define BGP_NODE_LABEL_CHANGED          (1 << 2)
 #define BGP_NODE_REGISTERED_FOR_LABEL   (1 << 3)
+
+	/* low 32 bits of when the UPDATE was read, if timed; never 0 then */
+	uint32_t pipeline_stamp;
 };
 
 /*
@@ -193,6 +199,17 @@ bgp_node_lookup(const struct bgp_table *const table, struct prefix *p)
 	return bgp_node_from_rnode(route_node_lookup(table->route_table, p));
 }
 
+/*
+ * bgp_node_subtree
+ *
+ * Gets the top of the nodes within p, without adding one for p.
+ */
+static inline struct bgp_node *
+bgp_node_subtree(const struct bgp_table *const table, struct prefix *p)
+{
+	return bgp_node_from_rnode(route_node_subtree(table->route_table, p));
+}
+
 /*
  * bgp_lock_node
  */
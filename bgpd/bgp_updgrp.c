@@ -87,6 +87,10 @@ static void sync_init(struct update_subgroup *subgrp)
 	BGP_ADV_FIFO_INIT(&subgrp->sync->withdraw_low);
 	subgrp->hash =
 		hash_create(baa_hash_key, baa_hash_cmp, "BGP SubGroup Hash");
+	subgrp->adj_hash = hash_create(bgp_adj_out_hash_key,
+				       bgp_adj_out_hash_cmp,
+				       "BGP SubGroup Adj-Out Hash");
+	subgrp->adj_hash->incremental = true;
 
 	/* We use a larger buffer for subgrp->work in the event that:
 	 * - We RX a BGP_UPDATE where the attributes alone are just
@@ -115,6 +119,9 @@ static void sync_delete(struct update_subgroup *subgrp)
 	if (subgrp->hash)
 		hash_free(subgrp->hash);
 	subgrp->hash = NULL;
+	if (subgrp->adj_hash)
+		hash_free(subgrp->adj_hash);
+	subgrp->adj_hash = NULL;
 	if (subgrp->work)
 		stream_free(subgrp->work);
 	subgrp->work = NULL;
@@ -625,6 +632,16 @@ static int update_group_show_walkcb(struct update_group *updgrp, void *arg)
 		vty_out(vty, "    Packet queue high watermark: %d\n",
 			bpacket_queue_hwm_length(SUBGRP_PKTQ(subgrp)));
 		vty_out(vty, "    Adj-out list count: %u\n", subgrp->adj_count);
+		if (subgrp->rmap_cache) {
+			uint64_t hits, misses;
+
+			route_map_cache_stats(subgrp->rmap_cache, &hits,
+					      &misses);
+			vty_out(vty,
+				"    Route map cache hits: %" PRIu64
+				", misses: %" PRIu64 "\n",
+				hits, misses);
+		}
 		vty_out(vty, "    Advertise list: %s\n",
 			advertise_list_is_empty(subgrp) ? "empty"
 							: "not empty");
@@ -775,7 +792,7 @@ update_subgroup_create(struct update_group *updgrp)
 
 	subgrp = XCALLOC(MTYPE_BGP_UPD_SUBGRP, sizeof(struct update_subgroup));
 	update_subgroup_checkin(subgrp, updgrp);
-	subgrp->v_coalesce = (UPDGRP_INST(updgrp))->coalesce_time;
+	subgrp->v_coalesce = update_group_coalesce_time(UPDGRP_INST(updgrp));
 	sync_init(subgrp);
 	bpacket_queue_init(SUBGRP_PKTQ(subgrp));
 	bpacket_queue_add(SUBGRP_PKTQ(subgrp), NULL, NULL);
@@ -805,12 +822,15 @@ static void update_subgroup_delete(struct update_subgroup *subgrp)
 	if (subgrp->t_coalesce)
 		THREAD_TIMER_OFF(subgrp->t_coalesce);
 
+	route_table_walk_cancel(&subgrp->t_announce);
+
 	bpacket_queue_cleanup(SUBGRP_PKTQ(subgrp));
 	subgroup_clear_table(subgrp);
 
 	if (subgrp->t_coalesce)
 		THREAD_TIMER_OFF(subgrp->t_coalesce);
 	sync_delete(subgrp);
+	route_map_cache_free(subgrp->rmap_cache);
 
 	if (BGP_DEBUG(update_groups, UPDATE_GROUPS))
 		zlog_debug("delete subgroup u%" PRIu64 ":s%" PRIu64,
@@ -1005,6 +1025,12 @@ static int update_subgroup_ready_for_merge(struct update_subgroup *subgrp)
 	if (update_subgroup_needs_refresh(subgrp))
 		return 0;
 
+	/*
+	 * Nor while the adj_out is still being filled in.
+	 */
+	if (subgrp->t_announce)
+		return 0;
+
 	return 1;
 }
 
@@ -1180,6 +1206,7 @@ static void update_subgroup_copy_adj_out(struct update_subgroup *source,
 			bgp_adj_out_alloc(dest, aout->rn, aout->addpath_tx_id);
 		aout_copy->attr =
 			aout->attr ? bgp_attr_intern(aout->attr) : NULL;
+		aout_copy->binfo_flags = aout->binfo_flags;
 	}
 }
 
@@ -1599,6 +1626,17 @@ void update_group_show_stats(struct bgp *bgp, struct vty *vty)
 		bgp->update_group_stats.peer_refreshes_combined);
 	vty_out(vty, "Merge checks triggered: %u\n",
 		bgp->update_group_stats.merge_checks_triggered);
+	vty_out(vty, "Coalesce time: %ums (%s)\n", bgp->coalesce_time,
+		bgp->adaptive_coalesce
+			? "adaptive"
+			: (bgp->heuristic_coalesce ? "heuristic" : "configured"));
+	vty_out(vty, "Prefix arrival rate: %u/s\n",
+		bgp->coalesce_load.rate);
+	vty_out(vty, "UPDATE fill ratio: %u%%\n", bgp->coalesce_load.fill);
+	vty_out(vty, "Coalesce times lengthened: %u\n",
+		bgp->update_group_stats.coalesce_lengthened);
+	vty_out(vty, "Coalesce times shortened: %u\n",
+		bgp->update_group_stats.coalesce_shortened);
 }
 
 /*
@@ -1779,6 +1817,60 @@ int update_group_refresh_default_originate_route_map(struct thread *thread)
 	return (0);
 }
 
+/*
+ * subgroup_announce_join
+ *
+ * Moves the peers of a subgroup that has not announced anything yet into
+ * another subgroup of the update group whose table announce is under way,
+ * rather than walking the table once more for them.  What they missed is
+ * announced again once the walk gets to the end, see
+ * subgroup_announce_catch_up().  Returns 1 if the peers moved, and the
+ * subgroup is gone.
+ */
+int subgroup_announce_join(struct update_subgroup *subgrp)
+{
+	struct update_subgroup *target;
+	struct peer_af *paf;
+	int count;
+
+	if (subgrp->version || subgrp->t_announce
+	    || (subgrp->adj_hash && subgrp->adj_hash->count)
+	    || update_subgroup_needs_refresh(subgrp))
+		return 0;
+
+	UPDGRP_FOREACH_SUBGRP (subgrp->update_group, target) {
+		if (target == subgrp || !target->t_announce
+		    || update_subgroup_needs_refresh(target)
+		    || CHECK_FLAG(target->sflags,
+				  SUBGRP_STATUS_DEFAULT_ORIGINATE))
+			continue;
+		break;
+	}
+	if (!target)
+		return 0;
+
+	if (bgp_debug_update(NULL, NULL, subgrp->update_group, 0))
+		zlog_debug("u%" PRIu64 ":s%" PRIu64
+			   " joining the announce of u%" PRIu64 ":s%" PRIu64,
+			   subgrp->update_group->id, subgrp->id,
+			   target->update_group->id, target->id);
+
+	if (CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_KICK))
+		SET_FLAG(target->sflags, SUBGRP_STATUS_ANNOUNCE_KICK);
+
+	count = subgrp->peer_count;
+	while ((paf = LIST_FIRST(&subgrp->peers))) {
+		bgp_stop_announce_route_timer(paf);
+		update_subgroup_remove_peer_internal(subgrp, paf);
+		update_subgroup_add_peer(target, paf, 0);
+	}
+	update_subgroup_check_delete(subgrp);
+
+	subgroup_announce_catch_up(target);
+	SUBGRP_INCR_STAT_BY(target, peer_refreshes_combined, count);
+	return 1;
+}
+
 /*
  * peer_af_announce_route
  *
@@ -1800,6 +1892,11 @@ void peer_af_announce_route(struct peer_af *paf, int combine)
 	subgrp = paf->subgroup;
 	all_pending = 0;
 
+	/* A peer that got nothing yet may ride along on a table announce
+	 * already under way. */
+	if (subgrp->peer_count == 1 && subgroup_announce_join(subgrp))
+		return;
+
 	if (combine) {
 		/*
 		 * If there are other peers in the old subgroup that also need
@@ -51,6 +51,22 @@
 #define BGP_MAX_SUBGROUP_COALESCE_TIME 10000
 #define BGP_PEER_ADJUST_SUBGROUP_COALESCE_TIME 50
 
+/*
+ * With "coalesce-time adaptive", the time computed above is further scaled
+ * by the recent load of the instance when a subgroup is created:
+ *
+ * - while prefixes arrive at BGP_COALESCE_RATE_HIGH per second or more, the
+ *   table is still converging and announcing it early would only lead to
+ *   more UPDATEs later, so the time is doubled; it is quadrupled if UPDATEs
+ *   were also built less than BGP_COALESCE_FILL_LOW percent full.
+ * - at BGP_COALESCE_RATE_LOW per second or less, there is little to wait
+ *   for and the time is quartered, down to BGP_MIN_SUBGROUP_COALESCE_TIME.
+ */
+#define BGP_COALESCE_RATE_HIGH 1000
+#define BGP_COALESCE_RATE_LOW 10
+#define BGP_COALESCE_FILL_LOW 50
+#define BGP_MIN_SUBGROUP_COALESCE_TIME 100
+
 #define PEER_UPDGRP_FLAGS                                                      \
 	(PEER_FLAG_LOCAL_AS_NO_PREPEND | PEER_FLAG_LOCAL_AS_REPLACE_AS)
 
@@ -213,11 +229,24 @@ struct update_subgroup {
 	/* announcement attribute hash */
 	struct hash *hash;
 
+	/* adj_out of the subgroup, by node and addpath id */
+	struct hash *adj_hash;
+
+	/* outbound route-map results, allocated on first use */
+	struct route_map_cache *rmap_cache;
+
 	struct thread *t_coalesce;
 	uint32_t v_coalesce;
 
 	struct thread *t_merge_check;
 
+	/* pending walk of subgroup_announce_route(), the node it got to, and
+	 * the one to stop at once started over for peers that joined it
+	 * under way; see subgroup_announce_join() */
+	struct route_table_walk *t_announce;
+	struct prefix announce_pos;
+	struct prefix announce_stop;
+
 	/* table version that the subgroup has caught up to. */
 	uint64_t version;
 
@@ -264,6 +293,13 @@ struct update_subgroup {
 #define SUBGRP_FLAG_NEEDS_REFRESH         (1 << 0)
 
 #define SUBGRP_STATUS_DEFAULT_ORIGINATE   (1 << 0)
+/* Send the routes out without MRAI once announced, see
+ * subgroup_coalesce_timer(). */
+#define SUBGRP_STATUS_ANNOUNCE_KICK       (1 << 1)
+/* State of the announce walk, see subgroup_announce_catch_up(). */
+#define SUBGRP_STATUS_ANNOUNCE_POS        (1 << 2)
+#define SUBGRP_STATUS_ANNOUNCE_CATCHUP    (1 << 3)
+#define SUBGRP_STATUS_ANNOUNCE_WRAPPED    (1 << 4)
 
 /*
  * Add the given value to the specified counter on a subgroup and its
@@ -412,6 +448,10 @@ unsigned int bpacket_queue_virtual_length(struct peer_af *paf);
 extern void bpacket_queue_show_vty(struct bpacket_queue *q, struct vty *vty);
 int subgroup_packets_to_build(struct update_subgroup *subgrp);
 extern struct bpacket *subgroup_update_packet(struct update_subgroup *s);
+extern void subgroup_update_packets_build(struct update_subgroup *subgrp);
+extern int update_group_workers_set(unsigned int count, const char *cpus);
+extern void update_group_workers_run(void);
+extern void update_group_workers_finish(void);
 extern struct bpacket *subgroup_withdraw_packet(struct update_subgroup *s);
 extern struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 						struct peer_af *paf);
@@ -437,7 +477,11 @@ extern void update_group_show_packet_queue(struct bgp *bgp, afi_t afi,
 					   safi_t safi, struct vty *vty,
 					   uint64_t id);
 extern void subgroup_announce_route(struct update_subgroup *subgrp);
+extern void subgroup_announce_catch_up(struct update_subgroup *subgrp);
+extern int subgroup_announce_join(struct update_subgroup *subgrp);
 extern void subgroup_announce_all(struct update_subgroup *subgrp);
+extern void update_group_coalesce_note_packet(struct bgp *bgp, size_t len);
+extern uint32_t update_group_coalesce_time(struct bgp *bgp);
 
 extern void subgroup_default_originate(struct update_subgroup *subgrp,
 				       int withdraw);
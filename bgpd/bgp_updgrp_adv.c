@@ -59,44 +59,52 @@ static inline struct bgp_adj_out *adj_lookup(struct bgp_node *rn,
 					     struct update_subgroup *subgrp,
 					     uint32_t addpath_tx_id)
 {
-	struct bgp_adj_out *adj;
-	struct peer *peer;
-	afi_t afi;
-	safi_t safi;
-	int addpath_capable;
+	struct bgp_adj_out ref;
 
 	if (!rn || !subgrp)
 		return NULL;
 
-	peer = SUBGRP_PEER(subgrp);
-	afi = SUBGRP_AFI(subgrp);
-	safi = SUBGRP_SAFI(subgrp);
-	addpath_capable = bgp_addpath_encode_tx(peer, afi, safi);
-
 	/* update-groups that do not support addpath will pass 0 for
-	 * addpath_tx_id so do not both matching against it */
-	for (adj = rn->adj_out; adj; adj = adj->next) {
-		if (adj->subgroup == subgrp) {
-			if (addpath_capable) {
-				if (adj->addpath_tx_id == addpath_tx_id) {
-					break;
-				}
-			} else {
-				break;
-			}
-		}
-	}
-
-	return adj;
+	 * addpath_tx_id so do not both matching against it, see
+	 * bgp_adj_out_hash_cmp() */
+	ref.rn = rn;
+	ref.subgroup = subgrp;
+	ref.addpath_tx_id = addpath_tx_id;
+	return hash_lookup(subgrp->adj_hash, &ref);
 }
 
 static void adj_free(struct bgp_adj_out *adj)
 {
+	if (adj->rn)
+		hash_release(adj->subgroup->adj_hash, adj);
 	TAILQ_REMOVE(&(adj->subgroup->adjq), adj, subgrp_adj_train);
 	SUBGRP_DECR_STAT(adj->subgroup, adj_count);
 	XFREE(MTYPE_BGP_ADJ_OUT, adj);
 }
 
+/*
+ * With addpath every path of a node is offered to each subgroup whenever
+ * the node is processed, while usually just one of them changed.  Apart
+ * from the subgroup's config, whose changes re-announce the whole table,
+ * subgroup_announce_check() only looks at the path's attr and flags and
+ * the node's label: a path announced with the flags it still has and
+ * whose attr didn't change since needn't be checked again.
+ */
+static int adj_out_changed(struct bgp_node *rn, struct update_subgroup *subgrp,
+			   struct bgp_info *ri)
+{
+	struct bgp_adj_out *adj;
+
+	if (CHECK_FLAG(rn->flags, BGP_NODE_LABEL_CHANGED)
+	    || CHECK_FLAG(ri->flags,
+			  BGP_INFO_ATTR_CHANGED | BGP_INFO_IGP_CHANGED))
+		return 1;
+
+	adj = adj_lookup(rn, subgrp, ri->addpath_tx_id);
+	return !adj
+	       || adj->binfo_flags != (ri->flags & BGP_ADJ_OUT_BINFO_FLAGS);
+}
+
 static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 {
 	struct updwalk_context *ctx = arg;
@@ -162,6 +170,10 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 					if (ri == ctx->ri)
 						continue;
 
+					if (!adj_out_changed(ctx->rn, subgrp,
+							     ri))
+						continue;
+
 					subgroup_process_announce_selected(
 						subgrp, ri, ctx->rn,
 						ri->addpath_tx_id);
@@ -187,17 +199,11 @@ static int group_announce_route_walkcb(struct update_group *updgrp, void *arg)
 					/* Find the addpath_tx_id of the path we
 					 * had advertised and
 					 * send a withdraw */
-					for (adj = ctx->rn->adj_out; adj;
-					     adj = adj_next) {
-						adj_next = adj->next;
-
-						if (adj->subgroup == subgrp) {
-							subgroup_process_announce_selected(
-								subgrp, NULL,
-								ctx->rn,
-								adj->addpath_tx_id);
-						}
-					}
+					adj = adj_lookup(ctx->rn, subgrp, 0);
+					if (adj)
+						subgroup_process_announce_selected(
+							subgrp, NULL, ctx->rn,
+							adj->addpath_tx_id);
 				}
 			}
 		}
@@ -291,6 +297,27 @@ static void updgrp_show_adj(struct bgp *bgp, afi_t afi, safi_t safi,
 	update_group_af_walk(bgp, afi, safi, updgrp_show_adj_walkcb, &ctx);
 }
 
+/*
+ * subgroup_announce_kick
+ *
+ * Sends the routes announced upon coalesce timer expiry right away.
+ */
+static void subgroup_announce_kick(struct update_subgroup *subgrp)
+{
+	struct peer_af *paf;
+	struct peer *peer;
+
+	UNSET_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_KICK);
+	if (bgp_update_delay_read_only(SUBGRP_INST(subgrp)))
+		return;
+
+	SUBGRP_FOREACH_PEER (subgrp, paf) {
+		peer = PAF_PEER(paf);
+		BGP_TIMER_OFF(peer->t_routeadv);
+		BGP_TIMER_ON(peer->t_routeadv, bgp_routeadv_timer, 0);
+	}
+}
+
 static int subgroup_coalesce_timer(struct thread *thread)
 {
 	struct update_subgroup *subgrp;
@@ -302,8 +329,6 @@ static int subgroup_coalesce_timer(struct thread *thread)
 			   (SUBGRP_UPDGRP(subgrp))->id, subgrp->id);
 	subgrp->t_coalesce = NULL;
 	subgrp->v_coalesce = 0;
-	subgroup_announce_route(subgrp);
-
 
 	/* While the announce_route() may kick off the route advertisement timer
 	 * for
@@ -312,17 +337,17 @@ static int subgroup_coalesce_timer(struct thread *thread)
 	 * faster (i.e., without enforcing MRAI). Also, if there were no routes
 	 * to
 	 * announce, this is the method currently employed to trigger the EOR.
+	 * That has to wait for the walk announcing the routes to end.
 	 */
-	if (!bgp_update_delay_active(SUBGRP_INST(subgrp))) {
-		struct peer_af *paf;
-		struct peer *peer;
+	SET_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_KICK);
 
-		SUBGRP_FOREACH_PEER (subgrp, paf) {
-			peer = PAF_PEER(paf);
-			BGP_TIMER_OFF(peer->t_routeadv);
-			BGP_TIMER_ON(peer->t_routeadv, bgp_routeadv_timer, 0);
-		}
-	}
+	/* the peers may ride along on a table announce already under way */
+	if (subgroup_announce_join(subgrp))
+		return 0;
+
+	subgroup_announce_route(subgrp);
+	if (!subgrp->t_announce)
+		subgroup_announce_kick(subgrp);
 
 	return 0;
 }
@@ -376,13 +401,15 @@ struct bgp_adj_out *bgp_adj_out_alloc(struct update_subgroup *subgrp,
 
 	adj = XCALLOC(MTYPE_BGP_ADJ_OUT, sizeof(struct bgp_adj_out));
 	adj->subgroup = subgrp;
+	adj->addpath_tx_id = addpath_tx_id;
+	adj->binfo_flags = BGP_ADJ_OUT_BINFO_NONE;
 	if (rn) {
 		BGP_ADJ_OUT_ADD(rn, adj);
 		bgp_lock_node(rn);
 		adj->rn = rn;
+		hash_get(subgrp->adj_hash, adj, hash_alloc_intern);
 	}
 
-	adj->addpath_tx_id = addpath_tx_id;
 	TAILQ_INSERT_TAIL(&(subgrp->adjq), adj, subgrp_adj_train);
 	SUBGRP_INCR_STAT(subgrp, adj_count);
 	return adj;
@@ -454,6 +481,7 @@ void bgp_adj_out_set_subgroup(struct bgp_node *rn,
 	adv->rn = rn;
 	assert(adv->binfo == NULL);
 	adv->binfo = bgp_info_lock(binfo); /* bgp_info adj_out reference */
+	adj->binfo_flags = binfo->flags & BGP_ADJ_OUT_BINFO_FLAGS;
 
 	if (attr)
 		adv->baa = bgp_advertise_intern(subgrp->hash, attr);
@@ -502,6 +530,8 @@ void bgp_adj_out_unset_subgroup(struct bgp_node *rn,
 		if (adj->adv)
 			bgp_advertise_clean_subgroup(subgrp, adj);
 
+		adj->binfo_flags = BGP_ADJ_OUT_BINFO_NONE;
+
 		if (adj->attr && withdraw) {
 			/* We need advertisement structure.  */
 			adj->adv = bgp_advertise_new();
@@ -562,12 +592,11 @@ void subgroup_clear_table(struct update_subgroup *subgrp)
 }
 
 /*
- * subgroup_announce_table
+ * subgroup_announce_node
  */
-void subgroup_announce_table(struct update_subgroup *subgrp,
-			     struct bgp_table *table)
+static void subgroup_announce_node(struct update_subgroup *subgrp,
+				   struct bgp_node *rn)
 {
-	struct bgp_node *rn;
 	struct bgp_info *ri;
 	struct attr attr;
 	struct peer *peer;
@@ -583,29 +612,31 @@ void subgroup_announce_table(struct update_subgroup *subgrp,
 	if (safi == SAFI_LABELED_UNICAST)
 		safi = SAFI_UNICAST;
 
-	if (!table)
-		table = peer->bgp->rib[afi][safi];
+	for (ri = rn->info; ri; ri = ri->next)
+
+		if (CHECK_FLAG(ri->flags, BGP_INFO_SELECTED)
+		    || (addpath_capable
+			&& bgp_addpath_tx_path(peer, afi, safi, ri))) {
+			if (subgroup_announce_check(rn, ri, subgrp, &rn->p,
+						    &attr))
+				bgp_adj_out_set_subgroup(rn, subgrp, &attr,
+							 ri);
+			else
+				bgp_adj_out_unset_subgroup(rn, subgrp, 1,
+							   ri->addpath_tx_id);
+		}
+}
 
-	if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN
-	    && CHECK_FLAG(peer->af_flags[afi][safi],
-			  PEER_FLAG_DEFAULT_ORIGINATE))
-		subgroup_default_originate(subgrp, 0);
+/*
+ * subgroup_announce_table
+ */
+void subgroup_announce_table(struct update_subgroup *subgrp,
+			     struct bgp_table *table)
+{
+	struct bgp_node *rn;
 
 	for (rn = bgp_table_top(table); rn; rn = bgp_route_next(rn))
-		for (ri = rn->info; ri; ri = ri->next)
-
-			if (CHECK_FLAG(ri->flags, BGP_INFO_SELECTED)
-			    || (addpath_capable
-				&& bgp_addpath_tx_path(peer, afi, safi, ri))) {
-				if (subgroup_announce_check(rn, ri, subgrp,
-							    &rn->p, &attr))
-					bgp_adj_out_set_subgroup(rn, subgrp,
-								 &attr, ri);
-				else
-					bgp_adj_out_unset_subgroup(
-						rn, subgrp, 1,
-						ri->addpath_tx_id);
-			}
+		subgroup_announce_node(subgrp, rn);
 
 	/*
 	 * We walked through the whole table -- make sure our version number
@@ -616,6 +647,93 @@ void subgroup_announce_table(struct update_subgroup *subgrp,
 	 * now been deleted.
 	 */
 	subgrp->version = max(subgrp->version, table->version);
+}
+
+static struct bgp_table *subgroup_announce_rib(struct update_subgroup *subgrp)
+{
+	safi_t safi = SUBGRP_SAFI(subgrp);
+
+	if (safi == SAFI_LABELED_UNICAST)
+		safi = SAFI_UNICAST;
+	return SUBGRP_INST(subgrp)->rib[SUBGRP_AFI(subgrp)][safi];
+}
+
+/*
+ * subgroup_announce_walk
+ *
+ * Announces one node of the subgroup's RIB, or in two-level tables the
+ * whole table of one route distinguisher.  Once started over, the walk
+ * ends at the node it had got to when the last peer joined.
+ */
+static int subgroup_announce_walk(struct route_node *node, void *arg)
+{
+	struct update_subgroup *subgrp = arg;
+	struct bgp_node *rn = bgp_node_from_rnode(node);
+	safi_t safi = SUBGRP_SAFI(subgrp);
+
+	if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN)
+		subgroup_announce_node(subgrp, rn);
+	else if (rn->info)
+		subgroup_announce_table(subgrp, rn->info);
+
+	prefix_copy(&subgrp->announce_pos, &rn->p);
+	SET_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_POS);
+
+	return CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_WRAPPED)
+	       && prefix_same(&rn->p, &subgrp->announce_stop);
+}
+
+static void subgroup_announce_done(void *arg);
+
+static void subgroup_announce_start(struct update_subgroup *subgrp)
+{
+	route_table_walk_start(bm->master,
+			       subgroup_announce_rib(subgrp)->route_table,
+			       subgroup_announce_walk, subgroup_announce_done,
+			       subgrp, &subgrp->t_announce);
+}
+
+/*
+ * subgroup_announce_catch_up
+ *
+ * Peers that joined the subgroup while its table was being announced
+ * missed what was announced before.  The walk goes on to the end of the
+ * table, then starts over to where it was when the last of them joined.
+ */
+void subgroup_announce_catch_up(struct update_subgroup *subgrp)
+{
+	if (!subgrp->t_announce
+	    || !CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_POS))
+		return;
+
+	prefix_copy(&subgrp->announce_stop, &subgrp->announce_pos);
+	SET_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_CATCHUP);
+	UNSET_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_WRAPPED);
+}
+
+static void subgroup_announce_done(void *arg)
+{
+	struct update_subgroup *subgrp = arg;
+	struct bgp_table *table = subgroup_announce_rib(subgrp);
+
+	if (CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_CATCHUP)
+	    && !CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_WRAPPED)) {
+		SET_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_WRAPPED);
+		subgroup_announce_start(subgrp);
+		return;
+	}
+	UNSET_FLAG(subgrp->sflags,
+		   SUBGRP_STATUS_ANNOUNCE_POS | SUBGRP_STATUS_ANNOUNCE_CATCHUP
+			   | SUBGRP_STATUS_ANNOUNCE_WRAPPED);
+
+	/* see subgroup_announce_table() */
+	subgrp->version = max(subgrp->version, table->version);
+
+	if (CHECK_FLAG(subgrp->sflags, SUBGRP_STATUS_ANNOUNCE_KICK))
+		subgroup_announce_kick(subgrp);
+	else
+		/* an EOR may have waited for us */
+		subgroup_trigger_write(subgrp);
 
 	/*
 	 * Start a task to merge the subgroup if necessary.
@@ -630,9 +748,10 @@ void subgroup_announce_table(struct update_subgroup *subgrp,
  */
 void subgroup_announce_route(struct update_subgroup *subgrp)
 {
-	struct bgp_node *rn;
-	struct bgp_table *table;
 	struct peer *onlypeer;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
 
 	if (update_subgroup_needs_refresh(subgrp)) {
 		update_subgroup_set_needs_refresh(subgrp, 0);
@@ -648,15 +767,26 @@ void subgroup_announce_route(struct update_subgroup *subgrp)
 				   PEER_STATUS_ORF_WAIT_REFRESH))
 		return;
 
-	if (SUBGRP_SAFI(subgrp) != SAFI_MPLS_VPN
-	    && SUBGRP_SAFI(subgrp) != SAFI_ENCAP
-	    && SUBGRP_SAFI(subgrp) != SAFI_EVPN)
-		subgroup_announce_table(subgrp, NULL);
-	else
-		for (rn = bgp_table_top(update_subgroup_rib(subgrp)); rn;
-		     rn = bgp_route_next(rn))
-			if ((table = (rn->info)) != NULL)
-				subgroup_announce_table(subgrp, table);
+	peer = SUBGRP_PEER(subgrp);
+	afi = SUBGRP_AFI(subgrp);
+	safi = SUBGRP_SAFI(subgrp);
+	if (safi == SAFI_LABELED_UNICAST)
+		safi = SAFI_UNICAST;
+
+	if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN
+	    && CHECK_FLAG(peer->af_flags[afi][safi],
+			  PEER_FLAG_DEFAULT_ORIGINATE))
+		subgroup_default_originate(subgrp, 0);
+
+	/*
+	 * Big tables are announced over several events. Start over if
+	 * already under way, policy may have changed for the nodes done.
+	 */
+	route_table_walk_cancel(&subgrp->t_announce);
+	UNSET_FLAG(subgrp->sflags,
+		   SUBGRP_STATUS_ANNOUNCE_POS | SUBGRP_STATUS_ANNOUNCE_CATCHUP
+			   | SUBGRP_STATUS_ANNOUNCE_WRAPPED);
+	subgroup_announce_start(subgrp);
 }
 
 void subgroup_default_originate(struct update_subgroup *subgrp, int withdraw)
@@ -717,6 +847,7 @@ void subgroup_default_originate(struct update_subgroup *subgrp, int withdraw)
 				/* Provide dummy so the route-map can't modify
 				 * the attributes */
 				bgp_attr_dup(&dummy_attr, ri->attr);
+				memset(&info, 0, sizeof(info));
 				info.peer = ri->peer;
 				info.attr = &dummy_attr;
 
@@ -813,6 +944,69 @@ void subgroup_announce_all(struct update_subgroup *subgrp)
 	}
 }
 
+/*
+ * Fold the prefixes announced since the start of the current sample into the
+ * smoothed arrival rate, once at least a second has passed.
+ */
+static void update_group_coalesce_sample(struct bgp *bgp)
+{
+	time_t now = bgp_clock();
+	time_t elapsed = now - bgp->coalesce_load.start;
+
+	if (!bgp->coalesce_load.start) {
+		bgp->coalesce_load.start = now;
+		return;
+	}
+	if (elapsed <= 0)
+		return;
+
+	bgp->coalesce_load.rate =
+		(bgp->coalesce_load.rate + bgp->coalesce_load.prefixes / elapsed)
+		/ 2;
+	bgp->coalesce_load.prefixes = 0;
+	bgp->coalesce_load.start = now;
+}
+
+/*
+ * Account for an UPDATE built for a subgroup.
+ */
+void update_group_coalesce_note_packet(struct bgp *bgp, size_t len)
+{
+	uint32_t fill = len * 100 / BGP_MAX_PACKET_SIZE;
+
+	bgp->coalesce_load.fill = (bgp->coalesce_load.fill * 7 + fill) / 8;
+}
+
+/*
+ * Coalesce time for a new subgroup, see bgp_updgrp.h.
+ */
+uint32_t update_group_coalesce_time(struct bgp *bgp)
+{
+	uint64_t ct = bgp->coalesce_time;
+
+	if (!bgp->adaptive_coalesce)
+		return bgp->coalesce_time;
+
+	update_group_coalesce_sample(bgp);
+
+	if (bgp->coalesce_load.rate >= BGP_COALESCE_RATE_HIGH) {
+		if (bgp->coalesce_load.fill < BGP_COALESCE_FILL_LOW)
+			ct *= 4;
+		else
+			ct *= 2;
+		if (ct > BGP_MAX_SUBGROUP_COALESCE_TIME)
+			ct = BGP_MAX_SUBGROUP_COALESCE_TIME;
+		bgp->update_group_stats.coalesce_lengthened++;
+	} else if (bgp->coalesce_load.rate <= BGP_COALESCE_RATE_LOW) {
+		ct /= 4;
+		if (ct < BGP_MIN_SUBGROUP_COALESCE_TIME)
+			ct = BGP_MIN_SUBGROUP_COALESCE_TIME;
+		bgp->update_group_stats.coalesce_shortened++;
+	}
+
+	return ct;
+}
+
 /*
  * Go through all update subgroups and set up the adv queue for the
  * input route.
@@ -821,6 +1015,10 @@ void group_announce_route(struct bgp *bgp, afi_t afi, safi_t safi,
 			  struct bgp_node *rn, struct bgp_info *ri)
 {
 	struct updwalk_context ctx;
+
+	update_group_coalesce_sample(bgp);
+	bgp->coalesce_load.prefixes++;
+
 	ctx.ri = ri;
 	ctx.rn = rn;
 	update_group_af_walk(bgp, afi, safi, group_announce_route_walkcb, &ctx);
@@ -43,6 +43,7 @@
 #include "hash.h"
 #include "queue.h"
 #include "mpls.h"
+#include "taskpool.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_debug.h"
@@ -56,6 +57,8 @@
 #include "bgpd/bgp_mplsvpn.h"
 #include "bgpd/bgp_label.h"
 
+DEFINE_MTYPE_STATIC(BGPD, BGP_UPDGRP_BUILD, "BGP update-group UPDATE builds")
+
 /********************
  * PRIVATE FUNCTIONS
  ********************/
@@ -382,6 +385,15 @@ void bpacket_queue_show_vty(struct bpacket_queue *q, struct vty *vty)
 	return;
 }
 
+/*
+ * Most peers of a subgroup get the packet as encoded, so it is only copied
+ * once something actually needs to be rewritten for the peer.
+ */
+static struct stream *bpacket_unshare(struct bpacket *pkt, struct stream *s)
+{
+	return (s == pkt->buffer) ? stream_dup(s) : s;
+}
+
 struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 					 struct peer_af *paf)
 {
@@ -391,7 +403,7 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 	char buf[BUFSIZ];
 	char buf2[BUFSIZ];
 
-	s = stream_dup(pkt->buffer);
+	s = pkt->buffer;
 	peer = PAF_PEER(paf);
 
 	vec = &pkt->arr.entries[BGP_ATTR_VEC_NH];
@@ -429,7 +441,6 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				zlog_warn(
 					"%s: %s: invalid MP nexthop length (AFI IP): %u",
 					__func__, peer->host, nhlen);
-				stream_free(s);
 				return NULL;
 			}
 
@@ -481,8 +492,14 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				nh_modified = 1;
 			}
 
-			if (nh_modified) /* allow for VPN RD */
-				stream_put_in_addr_at(s, offset_nh, mod_v4nh);
+			/*
+			 * Only the nexthop differs, so the peer gets the
+			 * packet's bytes on either side of its own nexthop
+			 * rather than a copy; offset_nh allows for VPN RD.
+			 */
+			if (nh_modified)
+				s = stream_patch(s, offset_nh, mod_v4nh,
+						 IPV4_MAX_BYTELEN);
 
 			if (bgp_debug_update(peer, NULL, NULL, 0))
 				zlog_debug("u%" PRIu64 ":s%" PRIu64
@@ -535,7 +552,6 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				zlog_warn(
 					"%s: %s: invalid MP nexthop length (AFI IP6): %u",
 					__func__, peer->host, nhlen);
-				stream_free(s);
 				return NULL;
 			}
 
@@ -576,6 +592,8 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				}
 			}
 
+			if (gnh_modified || lnh_modified)
+				s = bpacket_unshare(pkt, s);
 			if (gnh_modified)
 				stream_put_in6_addr_at(s, offset_nhglobal,
 						       mod_v6nhg);
@@ -620,9 +638,11 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 				nh_modified = 1;
 			}
 
-			if (nh_modified)
+			if (nh_modified) {
+				s = bpacket_unshare(pkt, s);
 				stream_put_in_addr_at(s, vec->offset + 1,
 						      mod_v4nh);
+			}
 
 			if (bgp_debug_update(peer, NULL, NULL, 0))
 				zlog_debug("u%" PRIu64 ":s%" PRIu64
@@ -633,6 +653,9 @@ struct stream *bpacket_reformat_for_peer(struct bpacket *pkt,
 		}
 	}
 
+	if (s == pkt->buffer)
+		s = stream_share(s);
+
 	return s;
 }
 
@@ -673,11 +696,46 @@ int subgroup_packets_to_build(struct update_subgroup *subgrp)
 	return 0;
 }
 
-/* Make BGP update packet.  */
-struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
-{
+/*
+ * An UPDATE encoded for a subgroup, along with the advertisements it carries.
+ *
+ * Encoding only reads state shared between subgroups, so that UPDATEs for
+ * different subgroups can be encoded concurrently; the advertisements are
+ * consumed and the packet queued afterwards by subgroup_update_commit().
+ */
+struct bpacket_build {
+	struct update_subgroup *subgrp;
+
+	struct stream *packet;
 	struct bpacket_attr_vec_arr vecarr;
-	struct bpacket *pkt;
+
+	/* first advertisement encoded, and how many were */
+	struct bgp_advertise *adv;
+	unsigned int num_adv;
+
+	/* the attributes didn't fit, advertisements must be dropped */
+	bool attr_too_long;
+};
+
+/*
+ * Returns the advertisement bgp_advertise_clean_subgroup() returns once adv
+ * has been cleaned, without cleaning anything: the ones sharing the first
+ * advertisement's attributes, most recent first.
+ */
+static struct bgp_advertise *subgroup_update_next(struct bgp_advertise *first,
+						  struct bgp_advertise *adv)
+{
+	adv = (adv == first) ? adv->baa->adv : adv->next;
+	if (adv == first)
+		adv = adv->next;
+
+	return adv;
+}
+
+static void subgroup_update_encode(struct bpacket_build *build)
+{
+	struct update_subgroup *subgrp = build->subgrp;
+	struct bpacket_attr_vec_arr *vecarr = &build->vecarr;
 	struct peer *peer;
 	struct stream *s;
 	struct stream *snlri;
@@ -704,12 +762,6 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 	mpls_label_t label = MPLS_INVALID_LABEL, *label_pnt = NULL;
 	uint32_t num_labels = 0;
 
-	if (!subgrp)
-		return NULL;
-
-	if (bpacket_queue_is_full(SUBGRP_INST(subgrp), SUBGRP_PKTQ(subgrp)))
-		return NULL;
-
 	peer = SUBGRP_PEER(subgrp);
 	afi = SUBGRP_AFI(subgrp);
 	safi = SUBGRP_SAFI(subgrp);
@@ -718,12 +770,12 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 	snlri = subgrp->scratch;
 	stream_reset(snlri);
 
-	bpacket_attr_vec_arr_reset(&vecarr);
+	bpacket_attr_vec_arr_reset(vecarr);
 
 	addpath_encode = bgp_addpath_encode_tx(peer, afi, safi);
 	addpath_overhead = addpath_encode ? BGP_ADDPATH_ID_LEN : 0;
 
-	adv = BGP_ADV_FIFO_HEAD(&subgrp->sync->update);
+	adv = build->adv = BGP_ADV_FIFO_HEAD(&subgrp->sync->update);
 	while (adv) {
 		assert(adv->rn);
 		rn = adv->rn;
@@ -773,7 +825,7 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 			/* 5: Encode all the attributes, except MP_REACH_NLRI
 			 * attr. */
 			total_attr_len = bgp_packet_attribute(
-				NULL, peer, s, adv->baa->attr, &vecarr, NULL,
+				NULL, peer, s, adv->baa->attr, vecarr, NULL,
 				afi, safi, from, NULL, NULL, 0, 0, 0);
 
 			space_remaining =
@@ -792,11 +844,8 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 					" attributes too long, cannot send UPDATE",
 					subgrp->update_group->id, subgrp->id);
 
-				/* Flush the FIFO update queue */
-				while (adv)
-					adv = bgp_advertise_clean_subgroup(
-						subgrp, adj);
-				return NULL;
+				build->attr_too_long = true;
+				return;
 			}
 
 			if (BGP_DEBUG(update, UPDATE_OUT)
@@ -829,7 +878,7 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 
 			if (stream_empty(snlri))
 				mpattrlen_pos = bgp_packet_mpattr_start(
-					snlri, peer, afi, safi, &vecarr,
+					snlri, peer, afi, safi, vecarr,
 					adv->baa->attr);
 
 			bgp_packet_mpattr_prefix(snlri, afi, safi, &rn->p, prd,
@@ -873,15 +922,8 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 				   pfx_buf);
 		}
 
-		/* Synchnorize attribute.  */
-		if (adj->attr)
-			bgp_attr_unintern(&adj->attr);
-		else
-			subgrp->scount++;
-
-		adj->attr = bgp_attr_intern(adv->baa->attr);
-
-		adv = bgp_advertise_clean_subgroup(subgrp, adj);
+		build->num_adv++;
+		adv = subgroup_update_next(build->adv, adv);
 	}
 
 	if (!stream_empty(s)) {
@@ -895,7 +937,7 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 
 		if (!stream_empty(snlri)) {
 			packet = stream_dupcat(s, snlri, mpattr_pos);
-			bpacket_attr_vec_arr_update(&vecarr, mpattr_pos);
+			bpacket_attr_vec_arr_update(vecarr, mpattr_pos);
 		} else
 			packet = stream_dup(s);
 		bgp_packet_set_size(packet);
@@ -906,12 +948,248 @@ struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
 				   (stream_get_endp(packet)
 				    - stream_get_getp(packet)),
 				   num_pfx);
-		pkt = bpacket_queue_add(SUBGRP_PKTQ(subgrp), packet, &vecarr);
+		build->packet = packet;
 		stream_reset(s);
 		stream_reset(snlri);
-		return pkt;
 	}
-	return NULL;
+}
+
+static struct bpacket *subgroup_update_commit(struct bpacket_build *build)
+{
+	struct update_subgroup *subgrp = build->subgrp;
+	struct bgp_advertise *adv = build->adv;
+	struct bgp_adj_out *adj;
+	unsigned int i;
+
+	if (build->attr_too_long) {
+		/* Flush the FIFO update queue */
+		while (adv)
+			adv = bgp_advertise_clean_subgroup(subgrp, adv->adj);
+		return NULL;
+	}
+
+	for (i = 0; i < build->num_adv; i++) {
+		adj = adv->adj;
+
+		/* Synchnorize attribute.  */
+		if (adj->attr)
+			bgp_attr_unintern(&adj->attr);
+		else
+			subgrp->scount++;
+
+		adj->attr = bgp_attr_intern(adv->baa->attr);
+
+		adv = bgp_advertise_clean_subgroup(subgrp, adj);
+	}
+
+	if (!build->packet)
+		return NULL;
+
+	update_group_coalesce_note_packet(SUBGRP_INST(subgrp),
+					  stream_get_endp(build->packet));
+	return bpacket_queue_add(SUBGRP_PKTQ(subgrp), build->packet,
+				 &build->vecarr);
+}
+
+/* Make BGP update packet.  */
+struct bpacket *subgroup_update_packet(struct update_subgroup *subgrp)
+{
+	struct bpacket_build build = {.subgrp = subgrp};
+
+	if (!subgrp)
+		return NULL;
+
+	if (bpacket_queue_is_full(SUBGRP_INST(subgrp), SUBGRP_PKTQ(subgrp)))
+		return NULL;
+
+	subgroup_update_encode(&build);
+	return subgroup_update_commit(&build);
+}
+
+/*
+ * Pool of pthreads encoding UPDATEs, see subgroup_update_packets_build().
+ */
+static struct {
+	struct taskpool *pool;
+	bool running;
+
+	/* reused between batches, only touched by the main pthread */
+	struct bpacket_build *builds;
+	unsigned int builds_size;
+} updgrp_workers;
+
+struct bpacket_build_batch {
+	struct update_subgroup *subgrp;
+	unsigned int count;
+};
+
+static void update_group_worker_build(void *arg)
+{
+	subgroup_update_encode(arg);
+}
+
+/*
+ * Whether a peer of the subgroup is going to build an UPDATE for it next.
+ */
+static bool subgroup_update_wanted(struct update_subgroup *subgrp)
+{
+	struct peer_af *paf;
+
+	if (BGP_ADV_FIFO_HEAD(&subgrp->sync->withdraw)
+	    || !BGP_ADV_FIFO_HEAD(&subgrp->sync->update))
+		return false;
+
+	if (bpacket_queue_is_full(SUBGRP_INST(subgrp), SUBGRP_PKTQ(subgrp)))
+		return false;
+
+	SUBGRP_FOREACH_PEER (subgrp, paf) {
+		if (paf->peer->t_generate_updgrp_packets
+		    && (!paf->next_pkt_to_send
+			|| !paf->next_pkt_to_send->buffer))
+			return true;
+	}
+
+	return false;
+}
+
+static void bpacket_build_batch_add(struct bpacket_build_batch *batch,
+				    struct update_subgroup *subgrp)
+{
+	if (batch->count == updgrp_workers.builds_size) {
+		updgrp_workers.builds_size =
+			MAX(2 * updgrp_workers.builds_size, 64U);
+		updgrp_workers.builds = XREALLOC(
+			MTYPE_BGP_UPDGRP_BUILD, updgrp_workers.builds,
+			updgrp_workers.builds_size
+				* sizeof(struct bpacket_build));
+	}
+
+	memset(&updgrp_workers.builds[batch->count], 0,
+	       sizeof(struct bpacket_build));
+	updgrp_workers.builds[batch->count++].subgrp = subgrp;
+}
+
+static int update_group_build_walkcb(struct update_group *updgrp, void *arg)
+{
+	struct bpacket_build_batch *batch = arg;
+	struct update_subgroup *subgrp;
+
+	UPDGRP_FOREACH_SUBGRP (updgrp, subgrp) {
+		if (subgrp != batch->subgrp && subgroup_update_wanted(subgrp))
+			bpacket_build_batch_add(batch, subgrp);
+	}
+
+	return UPDWALK_CONTINUE;
+}
+
+/*
+ * Builds the next UPDATE for the subgroup.
+ *
+ * With worker pthreads configured, this also builds one for every other
+ * subgroup of the address family that a peer is about to build one for,
+ * encoding them concurrently on a task pool, with the main pthread helping.
+ * Consuming the advertisements and queueing the packets is done afterwards,
+ * in order, on the main pthread.
+ */
+void subgroup_update_packets_build(struct update_subgroup *subgrp)
+{
+	struct bpacket_build_batch batch = {.subgrp = subgrp};
+	struct taskgroup group;
+	unsigned int i;
+
+	if (!subgrp || !updgrp_workers.pool
+	    || bpacket_queue_is_full(SUBGRP_INST(subgrp),
+				     SUBGRP_PKTQ(subgrp))) {
+		subgroup_update_packet(subgrp);
+		return;
+	}
+
+	bpacket_build_batch_add(&batch, subgrp);
+	update_group_af_walk(SUBGRP_INST(subgrp), SUBGRP_AFI(subgrp),
+			     SUBGRP_SAFI(subgrp), update_group_build_walkcb,
+			     &batch);
+
+	if (batch.count == 1) {
+		subgroup_update_packet(subgrp);
+		return;
+	}
+
+	taskgroup_init(&group, updgrp_workers.pool);
+	for (i = 0; i < batch.count; i++)
+		taskgroup_add(&group, update_group_worker_build,
+			      &updgrp_workers.builds[i]);
+	taskgroup_wait(&group);
+	taskgroup_fini(&group);
+
+	for (i = 0; i < batch.count; i++)
+		subgroup_update_commit(&updgrp_workers.builds[i]);
+}
+
+static void update_group_workers_adjust(unsigned int count)
+{
+	if (updgrp_workers.pool
+	    && taskpool_workers(updgrp_workers.pool) != count) {
+		taskpool_del(updgrp_workers.pool);
+		updgrp_workers.pool = NULL;
+	}
+
+	if (!count || updgrp_workers.pool)
+		return;
+
+	updgrp_workers.pool = taskpool_new("BGP update-group worker", count);
+	if (!updgrp_workers.pool) {
+		zlog_err("%s: could not start update-group workers", __func__);
+		return;
+	}
+	if (bm->updgrp_cpus
+	    && taskpool_set_affinity(updgrp_workers.pool, bm->updgrp_cpus) < 0)
+		zlog_err("%s: could not pin update-group workers to CPUs %s",
+			 __func__, bm->updgrp_cpus);
+}
+
+/*
+ * Sets the number of worker pthreads encoding UPDATEs, and the CPUs they are
+ * pinned to, NULL for any.  They are only started by
+ * update_group_workers_run(), as they would not survive daemonizing after
+ * the configuration has been read.
+ */
+int update_group_workers_set(unsigned int count, const char *cpus)
+{
+	bm->updgrp_workers = count;
+
+	if (bm->updgrp_cpus)
+		XFREE(MTYPE_TMP, bm->updgrp_cpus);
+	if (cpus)
+		bm->updgrp_cpus = XSTRDUP(MTYPE_TMP, cpus);
+
+	if (!updgrp_workers.running)
+		return 0;
+
+	if (updgrp_workers.pool
+	    && taskpool_workers(updgrp_workers.pool) == count)
+		return taskpool_set_affinity(updgrp_workers.pool, cpus);
+
+	update_group_workers_adjust(count);
+	return 0;
+}
+
+void update_group_workers_run(void)
+{
+	updgrp_workers.running = true;
+	update_group_workers_adjust(bm->updgrp_workers);
+}
+
+void update_group_workers_finish(void)
+{
+	update_group_workers_adjust(0);
+	updgrp_workers.running = false;
+
+	if (bm->updgrp_cpus)
+		XFREE(MTYPE_TMP, bm->updgrp_cpus);
+
+	if (updgrp_workers.builds)
+		XFREE(MTYPE_BGP_UPDGRP_BUILD, updgrp_workers.builds);
+	updgrp_workers.builds_size = 0;
 }
 
 /* Make BGP withdraw packet.  */
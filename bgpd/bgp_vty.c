@@ -31,9 +31,11 @@
 #include "log.h"
 #include "memory.h"
 #include "memory_vty.h"
+#include "workqueue.h"
 #include "hash.h"
 #include "queue.h"
 #include "filter.h"
+#include "sockopt.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_advertise.h"
@@ -59,6 +61,7 @@
 #include "bgpd/bgp_bfd.h"
 #include "bgpd/bgp_io.h"
 #include "bgpd/bgp_evpn.h"
+#include "bgpd/bgp_dump.h"
 
 static struct peer_group *listen_range_exists(struct bgp *bgp,
 					      struct prefix *range, int exact);
@@ -1316,6 +1319,8 @@ void bgp_config_write_update_delay(struct vty *vty, struct bgp *bgp)
 			vty_out(vty, " %d", bgp->v_establish_wait);
 		vty_out(vty, "\n");
 	}
+	if (bgp_flag_check(bgp, BGP_FLAG_UPDATE_DELAY_FIB_ONLY))
+		vty_out(vty, " update-delay fib-only\n");
 }
 
 
@@ -1355,6 +1360,28 @@ DEFUN (no_bgp_update_delay,
 	return bgp_update_delay_deconfig_vty(vty);
 }
 
+DEFUN (bgp_update_delay_fib_only,
+       bgp_update_delay_fib_only_cmd,
+       "[no] update-delay fib-only",
+       NO_STR
+       "Force initial delay for best-path and updates\n"
+       "Only delay installing routes to zebra, run best-path and updates\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	if (bgp_update_delay_active(bgp)) {
+		vty_out(vty, "%%Failed: update-delay is in progress\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	if (strmatch(argv[0]->text, "no"))
+		bgp_flag_unset(bgp, BGP_FLAG_UPDATE_DELAY_FIB_ONLY);
+	else
+		bgp_flag_set(bgp, BGP_FLAG_UPDATE_DELAY_FIB_ONLY);
+
+	return CMD_SUCCESS;
+}
+
 
 static int bgp_wpkt_quanta_config_vty(struct vty *vty, const char *num,
 				      char set)
@@ -1449,9 +1476,104 @@ DEFUN (no_bgp_rpkt_quanta,
 	return bgp_rpkt_quanta_config_vty(vty, argv[idx_number]->arg, 0);
 }
 
+void bgp_config_write_tcp(struct vty *vty, struct bgp *bgp)
+{
+	if (bgp->tcp_sndbuf)
+		vty_out(vty, " tcp send-buffer %u\n", bgp->tcp_sndbuf);
+	if (bgp->tcp_rcvbuf)
+		vty_out(vty, " tcp receive-buffer %u\n", bgp->tcp_rcvbuf);
+	if (bgp->tcp_notsent_lowat)
+		vty_out(vty, " tcp notsent-lowat %u\n",
+			bgp->tcp_notsent_lowat);
+	if (bgp_flag_check(bgp, BGP_FLAG_TCP_QUICKACK))
+		vty_out(vty, " tcp quickack\n");
+}
+
+/* TCP tuning, applies to the sessions set up afterwards */
+DEFUN (bgp_tcp_buffer,
+       bgp_tcp_buffer_cmd,
+       "tcp <send-buffer|receive-buffer> (4096-67108864)",
+       "BGP TCP session tuning\n"
+       "Socket send buffer size\n"
+       "Socket receive buffer size\n"
+       "Size in bytes\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+	uint32_t size = strtoul(argv[2]->arg, NULL, 10);
+
+	if (strmatch(argv[1]->text, "send-buffer"))
+		bgp->tcp_sndbuf = size;
+	else
+		bgp->tcp_rcvbuf = size;
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_tcp_buffer,
+       no_bgp_tcp_buffer_cmd,
+       "no tcp <send-buffer|receive-buffer> [(4096-67108864)]",
+       NO_STR
+       "BGP TCP session tuning\n"
+       "Socket send buffer size\n"
+       "Socket receive buffer size\n"
+       "Size in bytes\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	if (strmatch(argv[2]->text, "send-buffer"))
+		bgp->tcp_sndbuf = 0;
+	else
+		bgp->tcp_rcvbuf = 0;
+	return CMD_SUCCESS;
+}
+
+DEFUN (bgp_tcp_notsent_lowat,
+       bgp_tcp_notsent_lowat_cmd,
+       "tcp notsent-lowat (1024-16777216)",
+       "BGP TCP session tuning\n"
+       "Limit the unsent data queued in the kernel, keep the rest in bgpd\n"
+       "Size in bytes\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	bgp->tcp_notsent_lowat = strtoul(argv[2]->arg, NULL, 10);
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_tcp_notsent_lowat,
+       no_bgp_tcp_notsent_lowat_cmd,
+       "no tcp notsent-lowat [(1024-16777216)]",
+       NO_STR
+       "BGP TCP session tuning\n"
+       "Limit the unsent data queued in the kernel, keep the rest in bgpd\n"
+       "Size in bytes\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	bgp->tcp_notsent_lowat = 0;
+	return CMD_SUCCESS;
+}
+
+DEFUN (bgp_tcp_quickack,
+       bgp_tcp_quickack_cmd,
+       "[no] tcp quickack",
+       NO_STR
+       "BGP TCP session tuning\n"
+       "Acknowledge received data right away\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	if (strmatch(argv[0]->text, "no"))
+		bgp_flag_unset(bgp, BGP_FLAG_TCP_QUICKACK);
+	else
+		bgp_flag_set(bgp, BGP_FLAG_TCP_QUICKACK);
+	return CMD_SUCCESS;
+}
+
 void bgp_config_write_coalesce_time(struct vty *vty, struct bgp *bgp)
 {
-	if (!bgp->heuristic_coalesce)
+	if (bgp->adaptive_coalesce)
+		vty_out(vty, " coalesce-time adaptive\n");
+	else if (!bgp->heuristic_coalesce)
 		vty_out(vty, " coalesce-time %u\n", bgp->coalesce_time);
 }
 
@@ -1467,6 +1589,7 @@ DEFUN (bgp_coalesce_time,
 	int idx = 0;
 	argv_find(argv, argc, "(0-4294967295)", &idx);
 	bgp->heuristic_coalesce = false;
+	bgp->adaptive_coalesce = false;
 	bgp->coalesce_time = strtoul(argv[idx]->arg, NULL, 10);
 	return CMD_SUCCESS;
 }
@@ -1481,10 +1604,40 @@ DEFUN (no_bgp_coalesce_time,
 	VTY_DECLVAR_CONTEXT(bgp, bgp);
 
 	bgp->heuristic_coalesce = true;
+	bgp->adaptive_coalesce = false;
 	bgp->coalesce_time = BGP_DEFAULT_SUBGROUP_COALESCE_TIME;
 	return CMD_SUCCESS;
 }
 
+DEFUN (bgp_coalesce_time_adaptive,
+       bgp_coalesce_time_adaptive_cmd,
+       "coalesce-time adaptive",
+       "Subgroup coalesce timer\n"
+       "Adjust the coalesce timer to the observed load\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	if (!bgp->heuristic_coalesce) {
+		bgp->heuristic_coalesce = true;
+		bgp->coalesce_time = BGP_DEFAULT_SUBGROUP_COALESCE_TIME;
+	}
+	bgp->adaptive_coalesce = true;
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_coalesce_time_adaptive,
+       no_bgp_coalesce_time_adaptive_cmd,
+       "no coalesce-time adaptive",
+       NO_STR
+       "Subgroup coalesce timer\n"
+       "Adjust the coalesce timer to the observed load\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	bgp->adaptive_coalesce = false;
+	return CMD_SUCCESS;
+}
+
 /* Maximum-paths configuration */
 DEFUN (bgp_maxpaths,
        bgp_maxpaths_cmd,
@@ -1873,6 +2026,47 @@ DEFUN (no_bgp_graceful_restart_preserve_fw,
 	return CMD_SUCCESS;
 }
 
+DEFUN (bgp_graceful_restart_rib_restore,
+       bgp_graceful_restart_rib_restore_cmd,
+       "bgp graceful-restart rib-restore PATH",
+       "BGP specific commands\n"
+       "Graceful restart capability parameters\n"
+       "Read the RIB back from a routes-mrt dump when starting up\n"
+       "Dump filename\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+	int idx_path = 3;
+
+	if (bgp->inst_type != BGP_INSTANCE_TYPE_DEFAULT) {
+		vty_out(vty,
+			"%% Only the default instance's RIB is dumped\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	if (bgp->rib_restore_file)
+		XFREE(MTYPE_BGP, bgp->rib_restore_file);
+	bgp->rib_restore_file = XSTRDUP(MTYPE_BGP, argv[idx_path]->arg);
+
+	bgp_dump_restore(bgp);
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_graceful_restart_rib_restore,
+       no_bgp_graceful_restart_rib_restore_cmd,
+       "no bgp graceful-restart rib-restore [PATH]",
+       NO_STR
+       "BGP specific commands\n"
+       "Graceful restart capability parameters\n"
+       "Read the RIB back from a routes-mrt dump when starting up\n"
+       "Dump filename\n")
+{
+	VTY_DECLVAR_CONTEXT(bgp, bgp);
+
+	if (bgp->rib_restore_file)
+		XFREE(MTYPE_BGP, bgp->rib_restore_file);
+	return CMD_SUCCESS;
+}
+
 static void bgp_redistribute_redo(struct bgp *bgp)
 {
 	afi_t afi;
@@ -5159,6 +5353,162 @@ DEFUN (no_bgp_set_route_map_delay_timer,
 	return CMD_SUCCESS;
 }
 
+DEFUN (bgp_work_queue_max_stall,
+       bgp_work_queue_max_stall_cmd,
+       "bgp work-queue max-stall (1-1000)",
+       BGP_STR
+       "Route processing work queue\n"
+       "Tune batching to keep each run of the queue short\n"
+       "Longest run in milliseconds\n")
+{
+	int idx_number = 3;
+
+	bm->process_main_queue->spec.max_stall =
+		strtoul(argv[idx_number]->arg, NULL, 10) * 1000UL;
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_work_queue_max_stall,
+       no_bgp_work_queue_max_stall_cmd,
+       "no bgp work-queue max-stall [(1-1000)]",
+       NO_STR
+       BGP_STR
+       "Route processing work queue\n"
+       "Tune batching to keep each run of the queue short\n"
+       "Longest run in milliseconds\n")
+{
+	bm->process_main_queue->spec.max_stall = 0;
+	return CMD_SUCCESS;
+}
+
+DEFUN (bgp_update_group_workers,
+       bgp_update_group_workers_cmd,
+       "bgp update-group workers (1-8) [cpus WORD]",
+       BGP_STR
+       "Update-group settings\n"
+       "Pthreads encoding UPDATEs for different update-groups concurrently\n"
+       "Number of pthreads\n"
+       "Pin the pthreads to CPUs, round-robin\n"
+       "List of CPUs, e.g. 0-3,8\n")
+{
+	int idx_number = 3;
+	int idx_cpus = 5;
+
+	if (update_group_workers_set(strtoul(argv[idx_number]->arg, NULL, 10),
+				     argc > idx_cpus ? argv[idx_cpus]->arg
+						     : NULL)
+	    < 0) {
+		vty_out(vty, "%% Could not pin update-group workers to CPUs\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (bgp_io_threads,
+       bgp_io_threads_cmd,
+       "bgp io-threads (1-64)",
+       BGP_STR
+       "Pthreads reading from and writing to peers\n"
+       "Number of pthreads\n")
+{
+	int idx_number = 2;
+
+	bgp_io_threads_set(strtoul(argv[idx_number]->arg, NULL, 10));
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_io_threads,
+       no_bgp_io_threads_cmd,
+       "no bgp io-threads [(1-64)]",
+       NO_STR
+       BGP_STR
+       "Pthreads reading from and writing to peers\n"
+       "Number of pthreads\n")
+{
+	bgp_io_threads_set(BGP_IO_THREADS_DEFAULT);
+	return CMD_SUCCESS;
+}
+
+DEFUN (bgp_pipeline_latency_sample,
+       bgp_pipeline_latency_sample_cmd,
+       "bgp pipeline-latency sample (1-1000000)",
+       BGP_STR
+       "Latency of sampled prefixes from UPDATE to kernel\n"
+       "Time one in a number of prefixes received\n"
+       "Number of prefixes\n")
+{
+	int idx_number = 3;
+
+	if (!atomic_load_explicit(&bm->pipeline_sample, memory_order_relaxed))
+		bgp_pipeline_reset();
+	atomic_store_explicit(&bm->pipeline_sample,
+			      strtoul(argv[idx_number]->arg, NULL, 10),
+			      memory_order_relaxed);
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_pipeline_latency_sample,
+       no_bgp_pipeline_latency_sample_cmd,
+       "no bgp pipeline-latency sample [(1-1000000)]",
+       NO_STR
+       BGP_STR
+       "Latency of sampled prefixes from UPDATE to kernel\n"
+       "Time one in a number of prefixes received\n"
+       "Number of prefixes\n")
+{
+	atomic_store_explicit(&bm->pipeline_sample, 0, memory_order_relaxed);
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_bgp_pipeline_latency,
+       show_bgp_pipeline_latency_cmd,
+       "show bgp pipeline-latency [json]",
+       SHOW_STR
+       BGP_STR
+       "Latency of sampled prefixes from UPDATE to zebra, by stage\n"
+       JSON_STR)
+{
+	json_object *json = NULL;
+
+	if (use_json(argc, argv))
+		json = json_object_new_object();
+
+	pipeline_stages_show(vty, bgp_pipeline, BGP_PIPELINE_STAGES, json);
+
+	if (json) {
+		vty_out(vty, "%s\n", json_object_to_json_string_ext(
+					     json, JSON_C_TO_STRING_PRETTY));
+		json_object_free(json);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (clear_bgp_pipeline_latency,
+       clear_bgp_pipeline_latency_cmd,
+       "clear bgp pipeline-latency",
+       CLEAR_STR
+       BGP_STR
+       "Latency of sampled prefixes from UPDATE to zebra, by stage\n")
+{
+	pipeline_stages_clear(bgp_pipeline, BGP_PIPELINE_STAGES);
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_update_group_workers,
+       no_bgp_update_group_workers_cmd,
+       "no bgp update-group workers [(1-8) [cpus WORD]]",
+       NO_STR
+       BGP_STR
+       "Update-group settings\n"
+       "Pthreads encoding UPDATEs for different update-groups concurrently\n"
+       "Number of pthreads\n"
+       "Pin the pthreads to CPUs, round-robin\n"
+       "List of CPUs, e.g. 0-3,8\n")
+{
+	update_group_workers_set(0, NULL);
+	return CMD_SUCCESS;
+}
+
 
 /* neighbor interface */
 static int peer_interface_vty(struct vty *vty, const char *ip_str,
@@ -6036,6 +6386,46 @@ DEFUN (no_neighbor_ttl_security,
 	return bgp_vty_return(vty, peer_ttl_security_hops_unset(peer));
 }
 
+DEFUN (neighbor_io_thread,
+       neighbor_io_thread_cmd,
+       "neighbor <A.B.C.D|X:X::X:X|WORD> io-thread (1-64)",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Pthread doing the I/O for the peer, from the next session on\n"
+       "Number of the pthread, see bgp io-threads\n")
+{
+	int idx_peer = 1;
+	int idx_number = 3;
+	struct peer *peer;
+
+	peer = peer_and_group_lookup_vty(vty, argv[idx_peer]->arg);
+	if (!peer)
+		return CMD_WARNING_CONFIG_FAILED;
+
+	peer->io_thread_cfg = strtoul(argv[idx_number]->arg, NULL, 10) - 1;
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_neighbor_io_thread,
+       no_neighbor_io_thread_cmd,
+       "no neighbor <A.B.C.D|X:X::X:X|WORD> io-thread [(1-64)]",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Pthread doing the I/O for the peer, from the next session on\n"
+       "Number of the pthread, see bgp io-threads\n")
+{
+	int idx_peer = 2;
+	struct peer *peer;
+
+	peer = peer_and_group_lookup_vty(vty, argv[idx_peer]->arg);
+	if (!peer)
+		return CMD_WARNING_CONFIG_FAILED;
+
+	peer->io_thread_cfg = -1;
+	return CMD_SUCCESS;
+}
+
 DEFUN (neighbor_addpath_tx_all_paths,
        neighbor_addpath_tx_all_paths_cmd,
        "neighbor <A.B.C.D|X:X::X:X|WORD> addpath-tx-all-paths",
@@ -6430,6 +6820,13 @@ DEFPY (af_rt_vpn_imexport,
 			if (!dodir[dir])
 				continue;
 
+			if (dir == BGP_VPN_POLICY_DIR_FROMVPN) {
+				vpn_leak_to_vrf_rt_change(
+					bgp_get_default(), bgp, afi,
+					yes ? ecommunity_dup(ecom) : NULL);
+				continue;
+			}
+
 			vpn_leak_prechange(dir, afi, bgp_get_default(), bgp);
 
 			if (yes) {
@@ -7481,6 +7878,13 @@ static int bgp_show_summary(struct vty *vty, struct bgp *bgp, int afi, int safi,
 							"updateDelayEstablishWait",
 							bgp->v_establish_wait);
 
+					if (bgp_flag_check(
+						    bgp,
+						    BGP_FLAG_UPDATE_DELAY_FIB_ONLY))
+						json_object_boolean_true_add(
+							json,
+							"updateDelayFibOnly");
+
 					if (bgp_update_delay_active(bgp)) {
 						json_object_string_add(
 							json,
@@ -7518,6 +7922,11 @@ static int bgp_show_summary(struct vty *vty, struct bgp *bgp, int afi, int safi,
 						vty_out(vty,
 							"                   Establish wait: %d seconds\n",
 							bgp->v_establish_wait);
+					if (bgp_flag_check(
+						    bgp,
+						    BGP_FLAG_UPDATE_DELAY_FIB_ONLY))
+						vty_out(vty,
+							"  Delaying zebra updates only\n");
 
 					if (bgp_update_delay_active(bgp)) {
 						vty_out(vty,
@@ -7662,7 +8071,7 @@ static int bgp_show_summary(struct vty *vty, struct bgp *bgp, int afi, int safi,
 			json_object_int_add(json_peer, "tableVersion",
 					    peer->version[afi][safi]);
 			json_object_int_add(json_peer, "outq",
-					    peer->obuf->count);
+					    stream_fifo_count(peer->obuf));
 			json_object_int_add(json_peer, "inq", 0);
 			peer_uptime(peer->uptime, timebuf, BGP_UPTIME_LEN,
 				    use_json, json_peer);
@@ -7716,7 +8125,7 @@ static int bgp_show_summary(struct vty *vty, struct bgp *bgp, int afi, int safi,
 			vty_out(vty, "4 %10u %7u %7u %8" PRIu64 " %4d %4zd %8s",
 				peer->as, PEER_TOTAL_RX(peer),
 				PEER_TOTAL_TX(peer), peer->version[afi][safi],
-				0, peer->obuf->count,
+				0, stream_fifo_count(peer->obuf),
 				peer_uptime(peer->uptime, timebuf,
 					    BGP_UPTIME_LEN, 0, NULL));
 
@@ -8675,6 +9084,7 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 	uint8_t *msg;
 	json_object *json_neigh = NULL;
 	time_t epoch_tbuf;
+	struct sockopt_tcp_stats tcp_stats;
 
 	bgp = p->bgp;
 
@@ -9917,7 +10327,7 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 		/* Packet counts. */
 		json_object_int_add(json_stat, "depthInq", 0);
 		json_object_int_add(json_stat, "depthOutq",
-				    (unsigned long)p->obuf->count);
+				    (unsigned long)stream_fifo_count(p->obuf));
 		json_object_int_add(json_stat, "opensSent",
 				    atomic_load_explicit(&p->open_out,
 							 memory_order_relaxed));
@@ -9956,13 +10366,30 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 							 memory_order_relaxed));
 		json_object_int_add(json_stat, "totalSent", PEER_TOTAL_TX(p));
 		json_object_int_add(json_stat, "totalRecv", PEER_TOTAL_RX(p));
+		json_object_int_add(json_stat, "writeCalls",
+				    atomic_load_explicit(&p->write_calls,
+							 memory_order_relaxed));
+		json_object_int_add(json_stat, "writePackets",
+				    atomic_load_explicit(&p->write_pkts,
+							 memory_order_relaxed));
+		json_object_int_add(
+			json_stat, "keepaliveJitterAvgUsecs",
+			atomic_load_explicit(&p->keepalive_jitter_avg,
+					     memory_order_relaxed));
+		json_object_int_add(
+			json_stat, "keepaliveJitterMaxUsecs",
+			atomic_load_explicit(&p->keepalive_jitter_max,
+					     memory_order_relaxed));
 		json_object_object_add(json_neigh, "messageStats", json_stat);
 	} else {
+		uint32_t write_calls, write_pkts;
+		uint32_t jitter_cnt;
+
 		/* Packet counts. */
 		vty_out(vty, "  Message statistics:\n");
 		vty_out(vty, "    Inq depth is 0\n");
 		vty_out(vty, "    Outq depth is %lu\n",
-			(unsigned long)p->obuf->count);
+			(unsigned long)stream_fifo_count(p->obuf));
 		vty_out(vty, "                         Sent       Rcvd\n");
 		vty_out(vty, "    Opens:         %10d %10d\n",
 			atomic_load_explicit(&p->open_out,
@@ -9996,6 +10423,24 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 					     memory_order_relaxed));
 		vty_out(vty, "    Total:         %10d %10d\n", PEER_TOTAL_TX(p),
 			PEER_TOTAL_RX(p));
+
+		write_calls = atomic_load_explicit(&p->write_calls,
+						   memory_order_relaxed);
+		write_pkts = atomic_load_explicit(&p->write_pkts,
+						  memory_order_relaxed);
+		vty_out(vty, "    Packets per write: %.2f (%u in %u writes)\n",
+			write_calls ? (double)write_pkts / write_calls : 0.0,
+			write_pkts, write_calls);
+
+		jitter_cnt = atomic_load_explicit(&p->keepalive_jitter_cnt,
+						  memory_order_relaxed);
+		if (jitter_cnt)
+			vty_out(vty,
+				"    Keepalive jitter: %u usecs average, %u usecs max\n",
+				atomic_load_explicit(&p->keepalive_jitter_avg,
+						     memory_order_relaxed),
+				atomic_load_explicit(&p->keepalive_jitter_max,
+						     memory_order_relaxed));
 	}
 
 	if (use_json) {
@@ -10323,6 +10768,17 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 		if (p->status == Established && p->rtt)
 			json_object_int_add(json_neigh, "estimatedRttInMsecs",
 					    p->rtt);
+		if (p->status == Established && p->fd >= 0
+		    && sockopt_tcp_stats(p->fd, &tcp_stats) == 0) {
+			json_object_int_add(json_neigh, "tcpRttInMsecs",
+					    tcp_stats.rtt);
+			json_object_int_add(json_neigh, "tcpRttVarInMsecs",
+					    tcp_stats.rttvar);
+			json_object_int_add(json_neigh, "tcpCongestionWindow",
+					    tcp_stats.cwnd);
+			json_object_int_add(json_neigh, "tcpUnackedSegments",
+					    tcp_stats.unacked);
+		}
 		if (p->t_start)
 			json_object_int_add(
 				json_neigh, "nextStartTimerDueInMsecs",
@@ -10354,12 +10810,21 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 		else
 			json_object_string_add(json_neigh, "writeThread",
 					       "off");
+		if (p->io_pthread)
+			json_object_int_add(json_neigh, "ioThread",
+					    p->io_index + 1);
 	} else {
 		vty_out(vty, "BGP Connect Retry Timer in Seconds: %d\n",
 			p->v_connect);
 		if (p->status == Established && p->rtt)
 			vty_out(vty, "Estimated round trip time: %d ms\n",
 				p->rtt);
+		if (p->status == Established && p->fd >= 0
+		    && sockopt_tcp_stats(p->fd, &tcp_stats) == 0)
+			vty_out(vty,
+				"TCP: rtt %u ms, rttvar %u ms, cwnd %u segments, %u segments unacked\n",
+				tcp_stats.rtt, tcp_stats.rttvar,
+				tcp_stats.cwnd, tcp_stats.unacked);
 		if (p->t_start)
 			vty_out(vty, "Next start timer due in %ld seconds\n",
 				thread_timer_remain_second(p->t_start));
@@ -10374,11 +10839,14 @@ static void bgp_show_peer(struct vty *vty, struct peer *p, uint8_t use_json,
 		if (p->password)
 			vty_out(vty, "Peer Authentication Enabled\n");
 
-		vty_out(vty, "Read thread: %s  Write thread: %s\n",
+		vty_out(vty, "Read thread: %s  Write thread: %s",
 			p->t_read ? "on" : "off",
 			CHECK_FLAG(p->thread_flags, PEER_THREAD_WRITES_ON)
 				? "on"
 				: "off");
+		if (p->io_pthread)
+			vty_out(vty, "  I/O thread: %u", p->io_index + 1);
+		vty_out(vty, "\n");
 	}
 
 	if (p->notify.code == BGP_NOTIFY_OPEN_ERR
@@ -10637,6 +11105,18 @@ DEFUN (show_ip_bgp_paths,
 	return CMD_SUCCESS;
 }
 
+DEFUN (clear_ip_bgp_paths,
+       clear_ip_bgp_paths_cmd,
+       "clear [ip] bgp paths",
+       CLEAR_STR
+       IP_STR
+       BGP_STR
+       "Release the cached text form of AS paths\n")
+{
+	vty_out(vty, "Released %lu AS path strings\n", aspath_str_flush());
+	return CMD_SUCCESS;
+}
+
 #include "hash.h"
 
 static void community_show_all_iterator(struct hash_backet *backet,
@@ -11920,6 +12400,22 @@ void bgp_vty_init(void)
 	install_element(CONFIG_NODE, &bgp_set_route_map_delay_timer_cmd);
 	install_element(CONFIG_NODE, &no_bgp_set_route_map_delay_timer_cmd);
 
+	/* "bgp work-queue max-stall" commands. */
+	install_element(CONFIG_NODE, &bgp_work_queue_max_stall_cmd);
+	install_element(CONFIG_NODE, &no_bgp_work_queue_max_stall_cmd);
+
+	/* "bgp update-group workers" commands. */
+	install_element(CONFIG_NODE, &bgp_update_group_workers_cmd);
+	install_element(CONFIG_NODE, &no_bgp_update_group_workers_cmd);
+
+	/* "bgp io-threads" commands. */
+	install_element(CONFIG_NODE, &bgp_io_threads_cmd);
+	install_element(CONFIG_NODE, &no_bgp_io_threads_cmd);
+	install_element(CONFIG_NODE, &bgp_pipeline_latency_sample_cmd);
+	install_element(CONFIG_NODE, &no_bgp_pipeline_latency_sample_cmd);
+	install_element(VIEW_NODE, &show_bgp_pipeline_latency_cmd);
+	install_element(ENABLE_NODE, &clear_bgp_pipeline_latency_cmd);
+
 	/* Dummy commands (Currently not supported) */
 	install_element(BGP_NODE, &no_synchronization_cmd);
 	install_element(BGP_NODE, &no_auto_summary_cmd);
@@ -11961,14 +12457,22 @@ void bgp_vty_init(void)
 	install_element(BGP_NODE, &bgp_update_delay_cmd);
 	install_element(BGP_NODE, &no_bgp_update_delay_cmd);
 	install_element(BGP_NODE, &bgp_update_delay_establish_wait_cmd);
+	install_element(BGP_NODE, &bgp_update_delay_fib_only_cmd);
 
 	install_element(BGP_NODE, &bgp_wpkt_quanta_cmd);
 	install_element(BGP_NODE, &no_bgp_wpkt_quanta_cmd);
 	install_element(BGP_NODE, &bgp_rpkt_quanta_cmd);
 	install_element(BGP_NODE, &no_bgp_rpkt_quanta_cmd);
 
+	install_element(BGP_NODE, &bgp_tcp_buffer_cmd);
+	install_element(BGP_NODE, &no_bgp_tcp_buffer_cmd);
+	install_element(BGP_NODE, &bgp_tcp_notsent_lowat_cmd);
+	install_element(BGP_NODE, &no_bgp_tcp_notsent_lowat_cmd);
+	install_element(BGP_NODE, &bgp_tcp_quickack_cmd);
 	install_element(BGP_NODE, &bgp_coalesce_time_cmd);
 	install_element(BGP_NODE, &no_bgp_coalesce_time_cmd);
+	install_element(BGP_NODE, &bgp_coalesce_time_adaptive_cmd);
+	install_element(BGP_NODE, &no_bgp_coalesce_time_adaptive_cmd);
 
 	/* "maximum-paths" commands. */
 	install_element(BGP_NODE, &bgp_maxpaths_hidden_cmd);
@@ -12024,6 +12528,8 @@ void bgp_vty_init(void)
 
 	install_element(BGP_NODE, &bgp_graceful_restart_preserve_fw_cmd);
 	install_element(BGP_NODE, &no_bgp_graceful_restart_preserve_fw_cmd);
+	install_element(BGP_NODE, &bgp_graceful_restart_rib_restore_cmd);
+	install_element(BGP_NODE, &no_bgp_graceful_restart_rib_restore_cmd);
 
 	/* "bgp graceful-shutdown" commands */
 	install_element(BGP_NODE, &bgp_graceful_shutdown_cmd);
@@ -12966,6 +13472,7 @@ void bgp_vty_init(void)
 
 	/* "show [ip] bgp paths" commands. */
 	install_element(VIEW_NODE, &show_ip_bgp_paths_cmd);
+	install_element(ENABLE_NODE, &clear_ip_bgp_paths_cmd);
 
 	/* "show [ip] bgp community" commands. */
 	install_element(VIEW_NODE, &show_ip_bgp_community_info_cmd);
@@ -13022,6 +13529,10 @@ void bgp_vty_init(void)
 	install_element(BGP_NODE, &neighbor_ttl_security_cmd);
 	install_element(BGP_NODE, &no_neighbor_ttl_security_cmd);
 
+	/* "neighbor io-thread" commands. */
+	install_element(BGP_NODE, &neighbor_io_thread_cmd);
+	install_element(BGP_NODE, &no_neighbor_io_thread_cmd);
+
 	/* "show [ip] bgp memory" commands. */
 	install_element(VIEW_NODE, &show_bgp_memory_cmd);
 
@@ -1340,6 +1340,14 @@ void bgp_zebra_announce(struct bgp_node *rn, struct prefix *p,
 			__func__, buf_prefix,
 			(recursion_flag ? "" : "NOT "));
 	}
+	/* zebra times sampled routes on to the kernel */
+	if (valid_nh_count)
+		api.rx_usec = bgp_pipeline_announce(rn);
+	if (api.rx_usec) {
+		SET_FLAG(api.flags, ZEBRA_FLAG_TIMESTAMPS);
+		api.tx_usec = pipeline_now();
+	}
+
 	zclient_route_send(valid_nh_count ? ZEBRA_ROUTE_ADD
 					  : ZEBRA_ROUTE_DELETE,
 			   zclient, &api);
@@ -1368,6 +1376,7 @@ void bgp_zebra_announce_table(struct bgp *bgp, afi_t afi, safi_t safi)
 
 			    (ri->type == ZEBRA_ROUTE_BGP
 			     && (ri->sub_type == BGP_ROUTE_NORMAL
+				 || ri->sub_type == BGP_ROUTE_AGGREGATE
 				 || ri->sub_type == BGP_ROUTE_IMPORTED)))
 
 				bgp_zebra_announce(rn, &rn->p, ri, bgp, afi,
@@ -2082,6 +2091,7 @@ void bgp_zebra_destroy(void)
 {
 	if (zclient == NULL)
 		return;
+	bgp_label_cleanup();
 	zclient_stop(zclient);
 	zclient_free(zclient);
 	zclient = NULL;
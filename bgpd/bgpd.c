@@ -1159,6 +1159,7 @@ struct peer *peer_new(struct bgp *bgp)
 	peer->bgp = bgp_lock(bgp);
 	peer = peer_lock(peer); /* initial reference */
 	peer->password = NULL;
+	peer->io_thread_cfg = -1;
 
 	/* Set default flags.  */
 	FOREACH_AFI_SAFI (afi, safi) {
@@ -1175,8 +1176,8 @@ struct peer *peer_new(struct bgp *bgp)
 	SET_FLAG(peer->sflags, PEER_STATUS_CAPABILITY_OPEN);
 
 	/* Create buffers.  */
-	peer->ibuf = stream_fifo_new();
-	peer->obuf = stream_fifo_new();
+	peer->ibuf = stream_fifo_new_mpsc();
+	peer->obuf = stream_fifo_new_mpsc();
 	pthread_mutex_init(&peer->io_mtx, NULL);
 
 	/* We use a larger buffer for peer->obuf_work in the event that:
@@ -3310,6 +3311,9 @@ int bgp_delete(struct bgp *bgp)
 				.import_redirect_rtlist);
 		bgp->vpn_policy[afi].import_redirect_rtlist = NULL;
 	}
+	for (afi = 0; afi < AFI_MAX; ++afi)
+		vpn_leak_to_vrf_rt_change(NULL, bgp, afi, NULL);
+
 	/* Remove visibility via the master list - there may however still be
 	 * routes to be processed still referencing the struct bgp.
 	 */
@@ -3382,6 +3386,8 @@ void bgp_free(struct bgp *bgp)
 		XFREE(MTYPE_BGP, bgp->name);
 	if (bgp->name_pretty)
 		XFREE(MTYPE_BGP, bgp->name_pretty);
+	if (bgp->rib_restore_file)
+		XFREE(MTYPE_BGP, bgp->rib_restore_file);
 
 	XFREE(MTYPE_BGP, bgp);
 }
@@ -5529,8 +5535,57 @@ int peer_prefix_list_unset(struct peer *peer, afi_t afi, safi_t safi,
 	return 0;
 }
 
-/* Update prefix-list list. */
-static void peer_prefix_list_update(struct prefix_list *plist)
+static int peer_prefix_list_update_timer(struct thread *thread)
+{
+	struct listnode *mnode, *mnnode;
+	struct listnode *node, *nnode;
+	struct bgp *bgp;
+	struct peer *peer;
+	afi_t afi;
+	safi_t safi;
+
+	bm->t_plist_update = NULL;
+
+	for (ALL_LIST_ELEMENTS(bm->bgp, mnode, mnnode, bgp))
+		for (ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer))
+			FOREACH_AFI_SAFI (afi, safi) {
+				if (!CHECK_FLAG(peer->af_sflags[afi][safi],
+						PEER_STATUS_PLIST_IN_UPDATE))
+					continue;
+
+				UNSET_FLAG(peer->af_sflags[afi][safi],
+					   PEER_STATUS_PLIST_IN_UPDATE);
+				if (bgp_debug_update(peer, NULL, NULL, 1))
+					zlog_debug(
+						"Processing prefix-list update on peer %s (inbound)",
+						peer->host);
+				peer_on_policy_change(peer, afi, safi, 0);
+			}
+
+	return 0;
+}
+
+/*
+ * Peers whose inbound prefix-list changed re-evaluate their routes once the
+ * changes have settled, so that editing or reloading a list entry by entry
+ * does not rerun the policy for every entry.
+ */
+static void peer_prefix_list_mark_update(struct peer *peer, afi_t afi,
+					 safi_t safi)
+{
+	if (!bm->rmap_update_timer || peer->status != Established)
+		return;
+
+	SET_FLAG(peer->af_sflags[afi][safi], PEER_STATUS_PLIST_IN_UPDATE);
+	if (!bm->t_plist_update)
+		thread_add_timer(bm->master, peer_prefix_list_update_timer,
+				 NULL, bm->rmap_update_timer,
+				 &bm->t_plist_update);
+}
+
+/* Update prefix-list list, after prefix-list name of afi pafi changed, or
+ * any afi for AFI_MAX, or all of them for a NULL name. */
+static void peer_prefix_list_refresh(const char *name, afi_t pafi)
 {
 	struct listnode *mnode, *mnnode;
 	struct listnode *node, *nnode;
@@ -5547,9 +5602,8 @@ static void peer_prefix_list_update(struct prefix_list *plist)
 		/*
 		 * Update the prefix-list on update groups.
 		 */
-		update_group_policy_update(
-			bgp, BGP_POLICY_PREFIX_LIST,
-			plist ? prefix_list_name(plist) : NULL, 0, 0);
+		update_group_policy_update(bgp, BGP_POLICY_PREFIX_LIST, name,
+					   0, 0);
 
 		for (ALL_LIST_ELEMENTS(bgp->peer, node, nnode, peer)) {
 			FOREACH_AFI_SAFI (afi, safi) {
@@ -5567,6 +5621,13 @@ static void peer_prefix_list_update(struct prefix_list *plist)
 						filter->plist[direct].plist =
 							NULL;
 				}
+
+				if (name && (pafi == AFI_MAX || pafi == afi)
+				    && filter->plist[FILTER_IN].name
+				    && strcmp(filter->plist[FILTER_IN].name, name)
+					       == 0)
+					peer_prefix_list_mark_update(peer, afi,
+								     safi);
 			}
 		}
 		for (ALL_LIST_ELEMENTS(bgp->group, node, nnode, group)) {
@@ -5590,6 +5651,24 @@ static void peer_prefix_list_update(struct prefix_list *plist)
 	}
 }
 
+static void peer_prefix_list_deferred(const char *name)
+{
+	peer_prefix_list_refresh(name, AFI_MAX);
+}
+
+/* Prefix-list hook; while a config is read in, a list with many entries
+ * is refreshed once rather than for each. */
+static void peer_prefix_list_update(struct prefix_list *plist)
+{
+	if (plist
+	    && cmd_config_defer(peer_prefix_list_deferred,
+				prefix_list_name(plist)))
+		return;
+
+	peer_prefix_list_refresh(plist ? prefix_list_name(plist) : NULL,
+				 plist ? prefix_list_afi(plist) : AFI_MAX);
+}
+
 int peer_aslist_set(struct peer *peer, afi_t afi, safi_t safi, int direct,
 		    const char *name)
 {
@@ -6653,6 +6732,15 @@ static void bgp_config_write_peer_global(struct vty *vty, struct bgp *bgp,
 		}
 	}
 
+	/* io-thread */
+	if (peer->io_thread_cfg >= 0) {
+		if (!peer_group_active(peer)
+		    || g_peer->io_thread_cfg != peer->io_thread_cfg) {
+			vty_out(vty, " neighbor %s io-thread %d\n", addr,
+				peer->io_thread_cfg + 1);
+		}
+	}
+
 	/* disable-connected-check */
 	if (CHECK_FLAG(peer->flags, PEER_FLAG_DISABLE_CONNECTED_CHECK)) {
 		if (!peer_group_active(peer)
@@ -7222,6 +7310,24 @@ int bgp_config_write(struct vty *vty)
 		vty_out(vty, "bgp route-map delay-timer %u\n",
 			bm->rmap_update_timer);
 
+	if (bm->process_main_queue->spec.max_stall)
+		vty_out(vty, "bgp work-queue max-stall %lu\n",
+			bm->process_main_queue->spec.max_stall / 1000);
+
+	if (bm->updgrp_workers) {
+		vty_out(vty, "bgp update-group workers %u", bm->updgrp_workers);
+		if (bm->updgrp_cpus)
+			vty_out(vty, " cpus %s", bm->updgrp_cpus);
+		vty_out(vty, "\n");
+	}
+
+	if (bm->io_threads != BGP_IO_THREADS_DEFAULT)
+		vty_out(vty, "bgp io-threads %u\n", bm->io_threads);
+
+	if (bm->pipeline_sample)
+		vty_out(vty, "bgp pipeline-latency sample %u\n",
+			bm->pipeline_sample);
+
 	if (write)
 		vty_out(vty, "!\n");
 
@@ -7370,6 +7476,9 @@ int bgp_config_write(struct vty *vty)
 		/* coalesce time */
 		bgp_config_write_coalesce_time(vty, bgp);
 
+		/* TCP tuning */
+		bgp_config_write_tcp(vty, bgp);
+
 		/* BGP graceful-restart. */
 		if (bgp->stalepath_time != BGP_DEFAULT_STALEPATH_TIME)
 			vty_out(vty,
@@ -7380,6 +7489,9 @@ int bgp_config_write(struct vty *vty)
 				bgp->restart_time);
 		if (bgp_flag_check(bgp, BGP_FLAG_GRACEFUL_RESTART))
 			vty_out(vty, " bgp graceful-restart\n");
+		if (bgp->rib_restore_file)
+			vty_out(vty, " bgp graceful-restart rib-restore %s\n",
+				bgp->rib_restore_file);
 
 		/* BGP graceful-shutdown */
 		if (bgp_flag_check(bgp, BGP_FLAG_GRACEFUL_SHUTDOWN))
@@ -7520,9 +7632,13 @@ void bgp_master_init(struct thread_master *master)
 	bm->listen_sockets = list_new();
 	bm->port = BGP_PORT_DEFAULT;
 	bm->master = master;
+	/* per-peer hold, keepalive and connect-retry timers are second-scale
+	 * and re-armed constantly; keep them off the timer heap */
+	thread_master_set_timer_wheel(master, true);
 	bm->start_time = bgp_clock();
 	bm->t_rmap_update = NULL;
 	bm->rmap_update_timer = RMAP_DEFAULT_UPDATE_TIMER;
+	bm->io_threads = BGP_IO_THREADS_DEFAULT;
 
 	bgp_process_queue_init();
 
@@ -7590,6 +7706,10 @@ static void bgp_pthreads_init()
 {
 	frr_pthread_init();
 
+	/* packets are read on the I/O pthread and freed on the main one,
+	 * and the other way around for updates sent */
+	stream_cache_enable();
+
 	struct frr_pthread_attr io = {
 		.id = PTHREAD_IO,
 		.start = frr_pthread_attr_default.start,
@@ -7600,27 +7720,41 @@ static void bgp_pthreads_init()
 		.start = bgp_keepalives_start,
 		.stop = bgp_keepalives_stop,
 	};
+	struct frr_pthread_attr dump = {
+		.id = PTHREAD_DUMP,
+		.start = frr_pthread_attr_default.start,
+		.stop = frr_pthread_attr_default.stop,
+	};
 	frr_pthread_new(&io, "BGP I/O thread");
 	frr_pthread_new(&ka, "BGP Keepalives thread");
+	frr_pthread_new(&dump, "BGP MRT dump thread");
 }
 
 void bgp_pthreads_run()
 {
 	struct frr_pthread *io = frr_pthread_get(PTHREAD_IO);
 	struct frr_pthread *ka = frr_pthread_get(PTHREAD_KEEPALIVES);
+	struct frr_pthread *dump = frr_pthread_get(PTHREAD_DUMP);
 
 	frr_pthread_run(io, NULL);
 	frr_pthread_run(ka, NULL);
+	frr_pthread_run(dump, NULL);
 
 	/* Wait until threads are ready. */
 	frr_pthread_wait_running(io);
 	frr_pthread_wait_running(ka);
+	frr_pthread_wait_running(dump);
+
+	bgp_io_threads_run();
+	update_group_workers_run();
 }
 
 void bgp_pthreads_finish()
 {
+	update_group_workers_finish();
 	frr_pthread_stop_all();
 	frr_pthread_finish();
+	bgp_io_pkt_pool_clean();
 }
 
 void bgp_init(void)
@@ -7631,6 +7765,7 @@ void bgp_init(void)
 
 	/* pre-init pthreads */
 	bgp_pthreads_init();
+	bgp_fsm_init();
 
 	/* Init zebra. */
 	bgp_zebra_init(bm->master);
@@ -7714,4 +7849,6 @@ void bgp_terminate(void)
 
 	if (bm->t_rmap_update)
 		BGP_TIMER_OFF(bm->t_rmap_update);
+	if (bm->t_plist_update)
+		BGP_TIMER_OFF(bm->t_plist_update);
 }
@@ -106,6 +106,12 @@ struct bgp_master {
 /* BGP pthreads. */
 #define PTHREAD_IO              (1 << 1)
 #define PTHREAD_KEEPALIVES      (1 << 2)
+#define BGP_UPDGRP_WORKERS_MAX  8
+#define PTHREAD_DUMP            (1 << 4)
+#define PTHREAD_BMP             (1 << 5)
+/* I/O pthreads past the first, see bgp_io_threads_set() */
+#define PTHREAD_IO_EXTRA(i)     ((1 << 8) + (i))
+#define BGP_IO_THREADS_MAX      64
 
 	/* work queues */
 	struct work_queue *process_main_queue;
@@ -137,6 +143,20 @@ struct bgp_master {
 	uint32_t rmap_update_timer;   /* Route map update timer */
 #define RMAP_DEFAULT_UPDATE_TIMER 5 /* disabled by default */
 
+	/* same for inbound prefix-lists, dampened by rmap_update_timer */
+	struct thread *t_plist_update;
+
+	/* pthreads encoding UPDATEs for update-groups, and their CPUs */
+	unsigned int updgrp_workers;
+	char *updgrp_cpus;
+
+	/* pthreads doing peer I/O */
+	unsigned int io_threads;
+#define BGP_IO_THREADS_DEFAULT 1
+
+	/* one in how many prefixes received get timed to zebra, 0 for none */
+	_Atomic uint32_t pipeline_sample;
+
 	/* Id space for automatic RD derivation for an EVI/VRF */
 	bitfield_t rd_idspace;
 
@@ -232,6 +252,9 @@ struct bgp {
 		uint32_t updgrps_deleted;
 		uint32_t subgrps_created;
 		uint32_t subgrps_deleted;
+
+		uint32_t coalesce_lengthened;
+		uint32_t coalesce_shortened;
 	} update_group_stats;
 
 	/* BGP configuration.  */
@@ -316,6 +339,8 @@ struct bgp {
 #define BGP_FLAG_SHOW_HOSTNAME            (1 << 19)
 #define BGP_FLAG_GR_PRESERVE_FWD          (1 << 20)
 #define BGP_FLAG_GRACEFUL_SHUTDOWN        (1 << 21)
+#define BGP_FLAG_UPDATE_DELAY_FIB_ONLY    (1 << 22)
+#define BGP_FLAG_TCP_QUICKACK             (1 << 23)
 
 	/* BGP Per AF flags */
 	uint16_t af_flags[AFI_MAX][SAFI_MAX];
@@ -385,6 +410,9 @@ struct bgp {
 	uint32_t restart_time;
 	uint32_t stalepath_time;
 
+	/* routes-mrt dump read back at startup, see bgp_dump_restore() */
+	char *rib_restore_file;
+
 	/* Maximum-paths configuration */
 	struct bgp_maxpaths_cfg {
 		uint16_t maxpaths_ebgp;
@@ -396,10 +424,25 @@ struct bgp {
 	_Atomic uint32_t wpkt_quanta; // max # packets to write per i/o cycle
 	_Atomic uint32_t rpkt_quanta; // max # packets to read per i/o cycle
 
+	/* TCP tuning of the peer sockets, 0 for the defaults */
+	uint32_t tcp_sndbuf;
+	uint32_t tcp_rcvbuf;
+	uint32_t tcp_notsent_lowat;
+
 	/* Automatic coalesce adjust on/off */
 	bool heuristic_coalesce;
 	/* Actual coalesce time */
 	uint32_t coalesce_time;
+	/* Scale coalesce time by load, see bgp_updgrp.h */
+	bool adaptive_coalesce;
+
+	/* Load observed by update groups, for adaptive coalescing */
+	struct {
+		time_t start;	  /* start of the current sample */
+		uint32_t prefixes; /* prefixes announced in the sample */
+		uint32_t rate;	 /* smoothed prefixes per second */
+		uint32_t fill;	 /* smoothed UPDATE fill, in percent */
+	} coalesce_load;
 
 	/* Auto-shutdown new peers */
 	bool autoshutdown;
@@ -469,6 +512,8 @@ struct bgp {
 	struct {
 		struct ecommunity *rtlist[BGP_VPN_POLICY_DIR_MAX];
 		struct ecommunity *import_redirect_rtlist;
+		/* last vpn route leak walk that visited this vrf */
+		unsigned int import_walk;
 		char *rmap_name[BGP_VPN_POLICY_DIR_MAX];
 		struct route_map *rmap[BGP_VPN_POLICY_DIR_MAX];
 
@@ -664,8 +709,11 @@ struct peer {
 	/* Local router ID. */
 	struct in_addr local_id;
 
-	/* Packet receive and send buffer. */
-	pthread_mutex_t io_mtx;   // guards ibuf, obuf
+	/* Packet receive and send buffer. Both are lock-free fifos with a
+	 * single consumer at a time: the main thread for ibuf, and whoever
+	 * holds io_mtx for obuf. Pushing needs no lock.
+	 */
+	pthread_mutex_t io_mtx;   // guards obuf consumers, buffer wipes
 	struct stream_fifo *ibuf; // packets waiting to be processed
 	struct stream_fifo *obuf; // packets waiting to be written
 
@@ -674,6 +722,13 @@ struct peer {
 
 	struct stream *curr; // the current packet being parsed
 
+	/* Pipeline latency sampling, see bgp_pipeline_rx(): when bgp_read()
+	 * queued the oldest packets not yet seen by bgp_process_packet(), and
+	 * when the packets being processed were read.
+	 */
+	_Atomic int64_t ibuf_rx_usec;
+	int64_t rx_usec;
+
 	/* We use a separate stream to encode MP_REACH_NLRI for efficient
 	 * NLRI packing. peer->obuf_work stores all the other attributes. The
 	 * actual packet is then constructed by concatenating the two.
@@ -848,6 +903,7 @@ struct peer {
 #define PEER_STATUS_PREFIX_LIMIT      (1 << 3) /* exceed prefix-limit */
 #define PEER_STATUS_EOR_SEND          (1 << 4) /* end-of-rib send to peer */
 #define PEER_STATUS_EOR_RECEIVED      (1 << 5) /* end-of-rib received from peer */
+#define PEER_STATUS_PLIST_IN_UPDATE   (1 << 6) /* inbound prefix-list changed */
 
 	/* Default attribute value for the peer. */
 	uint32_t config;
@@ -894,9 +950,23 @@ struct peer {
 #define PEER_THREAD_WRITES_ON         (1 << 0)
 #define PEER_THREAD_READS_ON          (1 << 1)
 #define PEER_THREAD_KEEPALIVES_ON     (1 << 2)
+
+	/* I/O pthread serving the peer while its reads or writes are on, and
+	 * the one configured for it, -1 for any; see bgp_io.c */
+	struct frr_pthread *io_pthread;
+	unsigned int io_index;
+	int io_thread_cfg;
 	/* workqueues */
 	struct work_queue *clear_node_queue;
 
+	/* pending walks of bgp_soft_reconfig_in() */
+	struct route_table_walk *t_soft_reconfig[AFI_MAX][SAFI_MAX];
+
+	/* every path and adj-in of the peer in a table of the afi/safi, so
+	 * bgp_clear_route() need not walk the tables */
+	struct bgp_info *routes[AFI_MAX][SAFI_MAX];
+	struct bgp_adj_in *adj_in[AFI_MAX][SAFI_MAX];
+
 #define PEER_TOTAL_RX(peer)                                                    \
 	atomic_load_explicit(&peer->open_in, memory_order_relaxed)             \
 		+ atomic_load_explicit(&peer->update_in, memory_order_relaxed) \
@@ -935,6 +1005,13 @@ struct peer {
 	_Atomic uint32_t refresh_out;     /* Route Refresh output count */
 	_Atomic uint32_t dynamic_cap_in;  /* Dynamic Capability input count.  */
 	_Atomic uint32_t dynamic_cap_out; /* Dynamic Capability output count. */
+	_Atomic uint32_t write_calls;     /* writev() calls of the I/O thread */
+	_Atomic uint32_t write_pkts;      /* packets these wrote */
+
+	/* How far off their deadline keepalives went out, in microseconds */
+	_Atomic uint32_t keepalive_jitter_cnt; /* keepalives measured */
+	_Atomic uint32_t keepalive_jitter_avg; /* moving average */
+	_Atomic uint32_t keepalive_jitter_max; /* worst seen */
 
 	/* BGP state count */
 	uint32_t established; /* Established */
@@ -970,6 +1047,9 @@ struct peer {
 	/* Track if we printed the attribute in debugs */
 	int rcvd_attr_printed;
 
+	/* Parsed form of the last cacheable path attributes received */
+	struct bgp_attr_cache *rcvd_attr_cache;
+
 	/* Prefix count. */
 	unsigned long pcount[AFI_MAX][SAFI_MAX];
 
@@ -1412,6 +1492,7 @@ extern int bgp_listen_limit_unset(struct bgp *);
 
 extern int bgp_update_delay_active(struct bgp *);
 extern int bgp_update_delay_configured(struct bgp *);
+extern int bgp_update_delay_read_only(struct bgp *);
 extern int bgp_afi_safi_peer_exists(struct bgp *bgp, afi_t afi, safi_t safi);
 extern void peer_as_change(struct peer *, as_t, int);
 extern int peer_remote_as(struct bgp *, union sockunion *, const char *, as_t *,
@@ -32,6 +32,7 @@
 #include "lib/memory.h"
 #include "lib/log.h"
 #include "lib/skiplist.h"
+#include "lib/linklist.h"
 #include "lib/thread.h"
 #include "lib/stream.h"
 
@@ -551,10 +552,9 @@ static void rfapiBgpInfoFree(struct bgp_info *goner)
 	}
 	if (goner->extra) {
 		assert(!goner->extra->damp_info); /* Not used in import tbls */
-		XFREE(MTYPE_BGP_ROUTE_EXTRA, goner->extra);
-		goner->extra = NULL;
+		bgp_info_extra_free(&goner->extra);
 	}
-	XFREE(MTYPE_BGP_ROUTE, goner);
+	bgp_info_mem_free(goner);
 }
 
 struct rfapi_import_table *rfapiMacImportTableGetNoAlloc(struct bgp *bgp,
@@ -906,6 +906,82 @@ static void rfapiBgpInfoChainFree(struct bgp_info *bi)
 	}
 }
 
+/*
+ * An entry of the RT index of import tables: the IP import tables that
+ * import a given RT.
+ */
+struct rfapi_import_rt {
+	uint8_t rt[ECOMMUNITY_SIZE];
+	struct list *tables;
+};
+
+static int rfapiImportRtCmp(void *k1, void *k2)
+{
+	return memcmp(((struct rfapi_import_rt *)k1)->rt,
+		      ((struct rfapi_import_rt *)k2)->rt, ECOMMUNITY_SIZE);
+}
+
+static void rfapiImportRtFree(void *val)
+{
+	struct rfapi_import_rt *irt = val;
+
+	list_delete_and_null(&irt->tables);
+	XFREE(MTYPE_RFAPI_IMPORT_RT, irt);
+}
+
+static struct skiplist *rfapiImportRtIndexNew(void)
+{
+	return skiplist_new(0, rfapiImportRtCmp, rfapiImportRtFree);
+}
+
+/*
+ * Add an import table to the RT index under each of its RTs
+ */
+static void rfapiImportRtIndexAdd(struct rfapi *h,
+				  struct rfapi_import_table *it)
+{
+	struct rfapi_import_rt key;
+	struct rfapi_import_rt *irt;
+	int i;
+
+	for (i = 0; i < it->rt_import_list->size; ++i) {
+		memcpy(key.rt, it->rt_import_list->val + (i * ECOMMUNITY_SIZE),
+		       ECOMMUNITY_SIZE);
+
+		if (skiplist_search(h->import_rt, &key, (void **)&irt)) {
+			irt = XCALLOC(MTYPE_RFAPI_IMPORT_RT,
+				      sizeof(struct rfapi_import_rt));
+			memcpy(irt->rt, key.rt, ECOMMUNITY_SIZE);
+			irt->tables = list_new();
+			skiplist_insert(h->import_rt, irt, irt);
+		}
+
+		/* the RT list may name the same RT twice */
+		if (!listnode_lookup(irt->tables, it))
+			listnode_add(irt->tables, it);
+	}
+}
+
+static void rfapiImportRtIndexDel(struct rfapi *h,
+				  struct rfapi_import_table *it)
+{
+	struct rfapi_import_rt key;
+	struct rfapi_import_rt *irt;
+	int i;
+
+	for (i = 0; i < it->rt_import_list->size; ++i) {
+		memcpy(key.rt, it->rt_import_list->val + (i * ECOMMUNITY_SIZE),
+		       ECOMMUNITY_SIZE);
+
+		if (skiplist_search(h->import_rt, &key, (void **)&irt))
+			continue;
+
+		listnode_delete(irt->tables, it);
+		if (!listcount(irt->tables))
+			skiplist_delete(h->import_rt, irt, irt);
+	}
+}
+
 static void rfapiImportTableFlush(struct rfapi_import_table *it)
 {
 	afi_t afi;
@@ -980,6 +1056,7 @@ void rfapiImportTableRefDelByIt(struct bgp *bgp,
 		} else {
 			h->imports = it->next;
 		}
+		rfapiImportRtIndexDel(h, it);
 		rfapiImportTableFlush(it);
 		XFREE(MTYPE_RFAPI_IMPORTTABLE, it);
 	}
@@ -1023,7 +1100,7 @@ int rfapiEcommunitiesIntersect(struct ecommunity *e1, struct ecommunity *e2)
 	if (!e1 || !e2)
 		return 0;
 
-	{
+	if (VNC_DEBUG(VERBOSE)) {
 		char *s1, *s2;
 		s1 = ecommunity_ecom2str(e1, ECOMMUNITY_FORMAT_DISPLAY, 0);
 		s2 = ecommunity_ecom2str(e2, ECOMMUNITY_FORMAT_DISPLAY, 0);
@@ -3960,13 +4037,37 @@ void rfapiProcessUpdate(struct peer *peer,
 		return;
 
 	/*
-	 * Iterate over all import tables; do a filtered import
-	 * for the afi/safi combination
+	 * Do a filtered import for the afi/safi combination into the
+	 * import tables that import any of the route's RTs. The others
+	 * would not take it, so they are not visited.
 	 */
-	for (it = h->imports; it; it = it->next) {
-		(*rfapiBgpInfoFilteredImportFunction(safi))(
-			it, FIF_ACTION_UPDATE, peer, rfd, p, /* prefix */
-			NULL, afi, prd, attr, type, sub_type, label);
+	if (attr && attr->ecommunity) {
+		struct rfapi_import_rt key;
+		struct rfapi_import_rt *irt;
+		struct listnode *node;
+		uint32_t gen = ++h->import_gen;
+		int i;
+
+		for (i = 0; i < attr->ecommunity->size; ++i) {
+			memcpy(key.rt,
+			       attr->ecommunity->val + (i * ECOMMUNITY_SIZE),
+			       ECOMMUNITY_SIZE);
+
+			if (skiplist_search(h->import_rt, &key, (void **)&irt))
+				continue;
+
+			for (ALL_LIST_ELEMENTS_RO(irt->tables, node, it)) {
+				if (it->import_gen == gen)
+					continue;
+				it->import_gen = gen;
+
+				(*rfapiBgpInfoFilteredImportFunction(safi))(
+					it, FIF_ACTION_UPDATE, peer, rfd,
+					p, /* prefix */
+					NULL, afi, prd, attr, type, sub_type,
+					label);
+			}
+		}
 	}
 
 	if (safi == SAFI_MPLS_VPN) {
@@ -4276,6 +4377,8 @@ struct rfapi *bgp_rfapi_new(struct bgp *bgp)
 	/*
 	 * initialize the ce import table
 	 */
+	h->import_rt = rfapiImportRtIndexNew();
+
 	h->it_ce = XCALLOC(MTYPE_RFAPI_IMPORTTABLE,
 			   sizeof(struct rfapi_import_table));
 	h->it_ce->imported_vpn[AFI_IP] = route_table_init();
@@ -4345,6 +4448,11 @@ void bgp_rfapi_destroy(struct bgp *bgp, struct rfapi *h)
 		route_table_finish(h->un[afi]);
 	}
 
+	if (h->import_rt) {
+		skiplist_free(h->import_rt);
+		h->import_rt = NULL;
+	}
+
 	XFREE(MTYPE_RFAPI_IMPORTTABLE, h->it_ce);
 	XFREE(MTYPE_RFAPI, h);
 }
@@ -4376,6 +4484,7 @@ rfapiImportTableRefAdd(struct bgp *bgp, struct ecommunity *rt_import_list,
 
 		it->rt_import_list = ecommunity_dup(rt_import_list);
 		it->rfg = rfg;
+		rfapiImportRtIndexAdd(h, it);
 		it->monitor_exterior_orphans =
 			skiplist_new(0, NULL, (void (*)(void *))prefix_free);
 
@@ -49,6 +49,9 @@ struct rfapi_import_table {
 	int remote_count[AFI_MAX];
 	int holddown_count[AFI_MAX];
 	int imported_count[AFI_MAX];
+
+	/* Marks the table as visited by the update being imported. */
+	uint32_t import_gen;
 };
 
 #define RFAPI_LOCAL_BI(bi)                                                     \
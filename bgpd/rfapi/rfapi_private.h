@@ -173,6 +173,13 @@ struct rfapi_global_stats {
 struct rfapi {
 	struct route_table *un[AFI_MAX];
 	struct rfapi_import_table *imports; /* IPv4, IPv6 */
+
+	/*
+	 * The import tables above, indexed by each RT they import. Keys
+	 * and values are struct rfapi_import_rt.
+	 */
+	struct skiplist *import_rt;
+	uint32_t import_gen; /* see rfapi_import_table.import_gen */
 	struct list descriptors;	    /* debug & resolve-nve imports */
 
 	struct rfapi_global_stats stat;
@@ -402,6 +409,7 @@ DECLARE_MTYPE(RFAPI_RECENT_DELETE)
 DECLARE_MTYPE(RFAPI_L2ADDR_OPT)
 DECLARE_MTYPE(RFAPI_AP)
 DECLARE_MTYPE(RFAPI_MONITOR_ETH)
+DECLARE_MTYPE(RFAPI_IMPORT_RT)
 
 
 /*
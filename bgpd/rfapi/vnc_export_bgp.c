@@ -1021,6 +1021,7 @@ void vnc_direct_bgp_add_nve(struct bgp *bgp, struct rfapi_descriptor *rfd)
 
 					if (rfgn->rfg->routemap_export_bgp) {
 						route_map_result_t ret;
+						memset(&info, 0, sizeof(info));
 						info.peer = irfd->peer;
 						info.attr = &hattr;
 						ret = route_map_apply(
@@ -1230,6 +1231,7 @@ static void vnc_direct_add_rn_group_rd(struct bgp *bgp,
 	if (rfg->routemap_export_bgp) {
 		route_map_result_t ret;
 
+		memset(&info, 0, sizeof(info));
 		info.peer = irfd->peer;
 		info.attr = &hattr;
 		ret = route_map_apply(rfg->routemap_export_bgp, &rn->p,
@@ -63,6 +63,7 @@ struct eigrp_neighbor *eigrp_nbr_new(struct eigrp_interface *ei)
 
 	/* Relate neighbor to the interface. */
 	nbr->ei = ei;
+	nbr->nexthops = list_new();
 
 	/* Set default values. */
 	eigrp_nbr_state_set(nbr, EIGRP_NEIGHBOR_DOWN);
@@ -176,10 +177,18 @@ struct eigrp_neighbor *eigrp_nbr_lookup_by_addr_process(struct eigrp *eigrp,
 /* Delete specified EIGRP neighbor from interface. */
 void eigrp_nbr_delete(struct eigrp_neighbor *nbr)
 {
+	struct eigrp_nexthop_entry *ne;
+	struct listnode *node;
+
 	eigrp_nbr_state_set(nbr, EIGRP_NEIGHBOR_DOWN);
 	if (nbr->ei)
 		eigrp_topology_neighbor_down(nbr->ei->eigrp, nbr);
 
+	/* Whatever the FSM left in the topology is no longer indexed */
+	for (ALL_LIST_ELEMENTS_RO(nbr->nexthops, node, ne))
+		ne->nbr_node = NULL;
+	list_delete_and_null(&nbr->nexthops);
+
 	/* Cancel all events. */ /* Thread lookup cost would be negligible. */
 	thread_cancel_event(master, nbr);
 	eigrp_fifo_free(nbr->multicast_queue);
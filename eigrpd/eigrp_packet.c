@@ -832,6 +832,17 @@ struct eigrp_packet *eigrp_packet_new(size_t size, struct eigrp_neighbor *nbr)
 	return new;
 }
 
+static void eigrp_packet_write_on(struct eigrp_interface *ei)
+{
+	/* Hook thread to write packet. */
+	if (ei->on_write_q == 0) {
+		listnode_add(ei->eigrp->oi_write_q, ei);
+		ei->on_write_q = 1;
+	}
+	thread_add_write(master, eigrp_write, ei->eigrp, ei->eigrp->fd,
+			 &ei->eigrp->t_write);
+}
+
 void eigrp_send_packet_reliably(struct eigrp_neighbor *nbr)
 {
 	struct eigrp_packet *ep;
@@ -839,10 +850,12 @@ void eigrp_send_packet_reliably(struct eigrp_neighbor *nbr)
 	ep = eigrp_fifo_next(nbr->retrans_queue);
 
 	if (ep) {
-		struct eigrp_packet *duplicate;
-		duplicate = eigrp_packet_duplicate(ep, nbr);
-		/* Add packet to the top of the interface output queue*/
-		eigrp_fifo_push(nbr->ei->obuf, duplicate);
+		if (!ep->multicast_sent) {
+			struct eigrp_packet *duplicate;
+			duplicate = eigrp_packet_duplicate(ep, nbr);
+			/* Add packet to the top of the interface output queue*/
+			eigrp_fifo_push(nbr->ei->obuf, duplicate);
+		}
 
 		/*Start retransmission timer*/
 		thread_add_timer(master, eigrp_unack_packet_retrans, nbr,
@@ -852,14 +865,57 @@ void eigrp_send_packet_reliably(struct eigrp_neighbor *nbr)
 		/*Increment sequence number counter*/
 		nbr->ei->eigrp->sequence_number++;
 
-		/* Hook thread to write packet. */
-		if (nbr->ei->on_write_q == 0) {
-			listnode_add(nbr->ei->eigrp->oi_write_q, nbr->ei);
-			nbr->ei->on_write_q = 1;
+		if (!ep->multicast_sent)
+			eigrp_packet_write_on(nbr->ei);
+	}
+}
+
+/*
+ * Send a packet built for all the neighbors on the interface.
+ *
+ * Every neighbor up gets its own copy on its retransmission queue, addressed
+ * to it, so acks are tracked per neighbor and retransmissions are unicast.
+ * The neighbors which had nothing outstanding would all send it right away:
+ * it goes out once, multicast, for all of them.  The others get it unicast
+ * when it reaches the head of their queue.
+ *
+ * Consumes ep.
+ */
+void eigrp_send_packet_multicast(struct eigrp_interface *ei,
+				 struct eigrp_packet *ep)
+{
+	struct listnode *node, *nnode;
+	struct eigrp_neighbor *nbr;
+	bool multicast = false;
+
+	for (ALL_LIST_ELEMENTS(ei->nbrs, node, nnode, nbr)) {
+		struct eigrp_packet *dup;
+
+		if (nbr->state != EIGRP_NEIGHBOR_UP)
+			continue;
+
+		dup = eigrp_packet_duplicate(ep, nbr);
+		dup->dst = nbr->src;
+
+		/*Put packet to retransmission queue*/
+		eigrp_fifo_push(nbr->retrans_queue, dup);
+
+		if (nbr->retrans_queue->count == 1) {
+			dup->multicast_sent = true;
+			eigrp_send_packet_reliably(nbr);
+			multicast = true;
 		}
-		thread_add_write(master, eigrp_write, nbr->ei->eigrp,
-				 nbr->ei->eigrp->fd, &nbr->ei->eigrp->t_write);
 	}
+
+	if (!multicast) {
+		eigrp_packet_free(ep);
+		return;
+	}
+
+	ep->nbr = NULL;
+	ep->dst.s_addr = htonl(EIGRP_MULTICAST_ADDRESS);
+	eigrp_fifo_push(ei->obuf, ep);
+	eigrp_packet_write_on(ei);
 }
 
 /* Calculate EIGRP checksum */
@@ -1014,13 +1070,7 @@ int eigrp_unack_packet_retrans(struct thread *thread)
 				 EIGRP_PACKET_RETRANS_TIME,
 				 &ep->t_retrans_timer);
 
-		/* Hook thread to write packet. */
-		if (nbr->ei->on_write_q == 0) {
-			listnode_add(nbr->ei->eigrp->oi_write_q, nbr->ei);
-			nbr->ei->on_write_q = 1;
-		}
-		thread_add_write(master, eigrp_write, nbr->ei->eigrp,
-				 nbr->ei->eigrp->fd, &nbr->ei->eigrp->t_write);
+		eigrp_packet_write_on(nbr->ei);
 	}
 
 	return 0;
@@ -54,6 +54,8 @@ extern void eigrp_fifo_free(struct eigrp_fifo *);
 extern void eigrp_fifo_reset(struct eigrp_fifo *);
 
 extern void eigrp_send_packet_reliably(struct eigrp_neighbor *);
+extern void eigrp_send_packet_multicast(struct eigrp_interface *,
+					struct eigrp_packet *);
 
 extern struct TLV_IPv4_Internal_type *eigrp_read_ipv4_tlv(struct stream *);
 extern uint16_t eigrp_add_internalTLV_to_stream(struct stream *,
@@ -212,23 +212,10 @@ void eigrp_send_query(struct eigrp_interface *ei)
 			ep->sequence_number = ei->eigrp->sequence_number;
 			ei->eigrp->sequence_number++;
 
-			for (ALL_LIST_ELEMENTS(ei->nbrs, node2, nnode2, nbr)) {
-				struct eigrp_packet *dup;
-
-				if (nbr->state != EIGRP_NEIGHBOR_UP)
-					continue;
-
-				dup = eigrp_packet_duplicate(ep, nbr);
-				/*Put packet to retransmission queue*/
-				eigrp_fifo_push(nbr->retrans_queue, dup);
-
-				if (nbr->retrans_queue->count == 1)
-					eigrp_send_packet_reliably(nbr);
-			}
+			eigrp_send_packet_multicast(ei, ep);
 
 			has_tlv = false;
-			length = 0;
-			eigrp_packet_free(ep);
+			length = EIGRP_HEADER_LEN;
 			ep = NULL;
 			new_packet = true;
 		}
@@ -255,19 +242,5 @@ void eigrp_send_query(struct eigrp_interface *ei)
 	ep->sequence_number = ei->eigrp->sequence_number;
 	ei->eigrp->sequence_number++;
 
-	for (ALL_LIST_ELEMENTS(ei->nbrs, node2, nnode2, nbr)) {
-		struct eigrp_packet *dup;
-
-		if (nbr->state != EIGRP_NEIGHBOR_UP)
-			continue;
-
-		dup = eigrp_packet_duplicate(ep, nbr);
-		/*Put packet to retransmission queue*/
-		eigrp_fifo_push(nbr->retrans_queue, dup);
-
-		if (nbr->retrans_queue->count == 1)
-			eigrp_send_packet_reliably(nbr);
-	}
-
-	eigrp_packet_free(ep);
+	eigrp_send_packet_multicast(ei, ep);
 }
@@ -108,6 +108,8 @@ struct eigrp {
 				       by last update*/
 	struct list *topology_changes_internalIPV4;
 	struct list *topology_changes_externalIPV4;
+	/* Prefixes whose nexthop flags need to be recomputed */
+	struct list *topology_flags_dirty;
 
 	/*Neighbor self*/
 	struct eigrp_neighbor *neighbor_self;
@@ -274,6 +276,9 @@ struct eigrp_neighbor {
 	struct list *nbr_gr_prefixes_send;
 	/* if packet is first or last during Graceful restart */
 	enum Packet_part_type nbr_gr_packet_type;
+
+	/* topology entries advertised by this neighbor */
+	struct list *nexthops;
 };
 
 //---------------------------------------------------------------------------------------------------------------------------------------------
@@ -301,6 +306,9 @@ struct eigrp_packet {
 	uint16_t length;
 
 	struct eigrp_neighbor *nbr;
+
+	/* First transmission went out in a multicast, only await the ack */
+	bool multicast_sent;
 };
 
 struct eigrp_fifo {
@@ -465,6 +473,8 @@ struct eigrp_prefix_entry {
 
 	uint64_t serno; /*Serial number for this entry. Increased with each
 			   change of entry*/
+
+	bool flags_dirty; /* on eigrp->topology_flags_dirty */
 };
 
 /* EIGRP Topology table record structure */
@@ -481,6 +491,8 @@ struct eigrp_nexthop_entry {
 	uint8_t flags;			   // used for marking successor and FS
 
 	struct eigrp_interface *ei; // pointer for case of connected entry
+
+	struct listnode *nbr_node; // in adv_router->nexthops
 };
 
 //---------------------------------------------------------------------------------------------------------------------------------------------
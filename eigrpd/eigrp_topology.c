@@ -153,6 +153,45 @@ void eigrp_prefix_entry_add(struct route_table *topology,
 	route_lock_node(rn);
 }
 
+/*
+ * Index the entry on the neighbor which advertised it, so that
+ * neighbor events only visit that neighbor's entries.
+ */
+static void eigrp_nexthop_entry_index(struct eigrp_nexthop_entry *entry)
+{
+	struct list *nexthops;
+
+	if (entry->nbr_node || !entry->adv_router)
+		return;
+
+	nexthops = entry->adv_router->nexthops;
+	entry->nbr_node =
+		listnode_add_after(nexthops, listtail(nexthops), entry);
+}
+
+static void eigrp_nexthop_entry_unindex(struct eigrp_nexthop_entry *entry)
+{
+	if (!entry->nbr_node)
+		return;
+
+	list_delete_node(entry->adv_router->nexthops, entry->nbr_node);
+	entry->nbr_node = NULL;
+}
+
+/*
+ * Queue the prefix for eigrp_topology_update_all_node_flags()
+ */
+void eigrp_topology_mark_dirty(struct eigrp_prefix_entry *pe)
+{
+	struct eigrp *eigrp = eigrp_lookup();
+
+	if (pe->flags_dirty || !eigrp)
+		return;
+
+	pe->flags_dirty = true;
+	listnode_add(eigrp->topology_flags_dirty, pe);
+}
+
 /*
  * Adding topology entry to topology node
  */
@@ -166,6 +205,8 @@ void eigrp_nexthop_entry_add(struct eigrp_prefix_entry *node,
 	if (listnode_lookup(node->entries, entry) == NULL) {
 		listnode_add_sort(node->entries, entry);
 		entry->prefix = node;
+		eigrp_nexthop_entry_index(entry);
+		eigrp_topology_mark_dirty(node);
 
 		eigrp_zebra_route_add(node->destination, l);
 	}
@@ -180,6 +221,8 @@ void eigrp_prefix_entry_delete(struct route_table *table,
 			       struct eigrp_prefix_entry *pe)
 {
 	struct eigrp *eigrp = eigrp_lookup();
+	struct eigrp_nexthop_entry *ne;
+	struct listnode *node;
 	struct route_node *rn;
 
 	rn = route_node_lookup(table, pe->destination);
@@ -191,6 +234,11 @@ void eigrp_prefix_entry_delete(struct route_table *table,
 	 * Whatever it is.
 	 */
 	listnode_delete(eigrp->topology_changes_internalIPV4, pe);
+	if (pe->flags_dirty)
+		listnode_delete(eigrp->topology_flags_dirty, pe);
+
+	for (ALL_LIST_ELEMENTS_RO(pe->entries, node, ne))
+		eigrp_nexthop_entry_unindex(ne);
 
 	list_delete_and_null(&pe->entries);
 	list_delete_and_null(&pe->rij);
@@ -210,6 +258,8 @@ void eigrp_nexthop_entry_delete(struct eigrp_prefix_entry *node,
 {
 	if (listnode_lookup(node->entries, entry) != NULL) {
 		listnode_delete(node->entries, entry);
+		eigrp_nexthop_entry_unindex(entry);
+		eigrp_topology_mark_dirty(node);
 		eigrp_zebra_route_delete(node->destination);
 		XFREE(MTYPE_EIGRP_NEXTHOP_ENTRY, entry);
 	}
@@ -329,27 +379,15 @@ eigrp_prefix_entry_lookup(struct list *entries, struct eigrp_neighbor *nbr)
 struct list *eigrp_neighbor_prefixes_lookup(struct eigrp *eigrp,
 					    struct eigrp_neighbor *nbr)
 {
-	struct listnode *node2, *node22;
+	struct listnode *node;
 	struct eigrp_nexthop_entry *entry;
-	struct eigrp_prefix_entry *pe;
-	struct route_node *rn;
 
 	/* create new empty list for prefixes storage */
 	struct list *prefixes = list_new();
 
-	/* iterate over all prefixes in topology table */
-	for (rn = route_top(eigrp->topology_table); rn; rn = route_next(rn)) {
-		if (!rn->info)
-			continue;
-		pe = rn->info;
-		/* iterate over all neighbor entry in prefix */
-		for (ALL_LIST_ELEMENTS(pe->entries, node2, node22, entry)) {
-			/* if entry is from specified neighbor, add to list */
-			if (entry->adv_router == nbr) {
-				listnode_add(prefixes, pe);
-			}
-		}
-	}
+	/* the neighbor's own entries, one per prefix it advertised */
+	for (ALL_LIST_ELEMENTS_RO(nbr->nexthops, node, entry))
+		listnode_add(prefixes, entry->prefix);
 
 	/* return list of prefixes from specified neighbor */
 	return prefixes;
@@ -417,21 +455,23 @@ distance_done:
 	 */
 	listnode_delete(prefix->entries, entry);
 	listnode_add_sort(prefix->entries, entry);
+	/* A new entry from the FSM is first added here */
+	eigrp_nexthop_entry_index(entry);
+	eigrp_topology_mark_dirty(prefix);
 
 	return change;
 }
 
+/*
+ * Recompute the flags of the prefixes whose entries changed since
+ * their flags were last computed.
+ */
 void eigrp_topology_update_all_node_flags(struct eigrp *eigrp)
 {
 	struct eigrp_prefix_entry *pe;
-	struct route_node *rn;
-
-	for (rn = route_top(eigrp->topology_table); rn; rn = route_next(rn)) {
-		pe = rn->info;
-
-		if (!pe)
-			continue;
 
+	while (listcount(eigrp->topology_flags_dirty)) {
+		pe = listnode_head(eigrp->topology_flags_dirty);
 		eigrp_topology_update_node_flags(pe);
 	}
 }
@@ -442,6 +482,11 @@ void eigrp_topology_update_node_flags(struct eigrp_prefix_entry *dest)
 	struct eigrp_nexthop_entry *entry;
 	struct eigrp *eigrp = eigrp_lookup();
 
+	if (dest->flags_dirty) {
+		listnode_delete(eigrp->topology_flags_dirty, dest);
+		dest->flags_dirty = false;
+	}
+
 	for (ALL_LIST_ELEMENTS_RO(dest->entries, node, entry)) {
 		if (((uint64_t)entry->distance
 		     <= (uint64_t)dest->distance * (uint64_t)eigrp->variance)
@@ -485,33 +530,34 @@ void eigrp_update_routing_table(struct eigrp_prefix_entry *prefix)
 void eigrp_topology_neighbor_down(struct eigrp *eigrp,
 				  struct eigrp_neighbor *nbr)
 {
-	struct listnode *node2, *node22;
+	struct listnode *node, *nnode;
 	struct eigrp_prefix_entry *pe;
 	struct eigrp_nexthop_entry *entry;
-	struct route_node *rn;
+	struct list *prefixes;
 
-	for (rn = route_top(eigrp->topology_table); rn; rn = route_next(rn)) {
-		pe = rn->info;
+	/*
+	 * The FSM may remove the prefix it runs on, together with its
+	 * entries, so walk a copy of the neighbor's prefixes and look the
+	 * entry up again on each.
+	 */
+	prefixes = eigrp_neighbor_prefixes_lookup(eigrp, nbr);
+	for (ALL_LIST_ELEMENTS(prefixes, node, nnode, pe)) {
+		struct eigrp_fsm_action_message msg;
 
-		if (!pe)
+		entry = eigrp_prefix_entry_lookup(pe->entries, nbr);
+		if (!entry)
 			continue;
 
-		for (ALL_LIST_ELEMENTS(pe->entries, node2, node22, entry)) {
-			struct eigrp_fsm_action_message msg;
-
-			if (entry->adv_router != nbr)
-				continue;
-
-			msg.metrics.delay = EIGRP_MAX_METRIC;
-			msg.packet_type = EIGRP_OPC_UPDATE;
-			msg.eigrp = eigrp;
-			msg.data_type = EIGRP_INT;
-			msg.adv_router = nbr;
-			msg.entry = entry;
-			msg.prefix = pe;
-			eigrp_fsm_event(&msg);
-		}
+		msg.metrics.delay = EIGRP_MAX_METRIC;
+		msg.packet_type = EIGRP_OPC_UPDATE;
+		msg.eigrp = eigrp;
+		msg.data_type = EIGRP_INT;
+		msg.adv_router = nbr;
+		msg.entry = entry;
+		msg.prefix = pe;
+		eigrp_fsm_event(&msg);
 	}
+	list_delete_and_null(&prefixes);
 
 	eigrp_query_send_all(eigrp);
 	eigrp_update_send_all(eigrp, nbr->ei);
@@ -60,6 +60,7 @@ eigrp_prefix_entry_lookup(struct list *, struct eigrp_neighbor *);
 extern struct list *eigrp_neighbor_prefixes_lookup(struct eigrp *,
 						   struct eigrp_neighbor *);
 extern void eigrp_topology_update_all_node_flags(struct eigrp *);
+extern void eigrp_topology_mark_dirty(struct eigrp_prefix_entry *);
 extern void eigrp_topology_update_node_flags(struct eigrp_prefix_entry *);
 extern enum metric_change
 eigrp_topology_update_distance(struct eigrp_fsm_action_message *);
@@ -490,38 +490,6 @@ static void eigrp_update_place_on_nbr_queue(struct eigrp_neighbor *nbr,
 		eigrp_send_packet_reliably(nbr);
 }
 
-static void eigrp_update_send_to_all_nbrs(struct eigrp_interface *ei,
-					  struct eigrp_packet *ep)
-{
-	struct listnode *node, *nnode;
-	struct eigrp_neighbor *nbr;
-	bool packet_sent = false;
-
-	for (ALL_LIST_ELEMENTS(ei->nbrs, node, nnode, nbr)) {
-		struct eigrp_packet *ep_dup;
-
-		if (nbr->state != EIGRP_NEIGHBOR_UP)
-			continue;
-
-		if (packet_sent)
-			ep_dup = eigrp_packet_duplicate(ep, NULL);
-		else
-			ep_dup = ep;
-
-		ep_dup->nbr = nbr;
-		packet_sent = true;
-		/*Put packet to retransmission queue*/
-		eigrp_fifo_push(nbr->retrans_queue, ep_dup);
-
-		if (nbr->retrans_queue->count == 1) {
-			eigrp_send_packet_reliably(nbr);
-		}
-	}
-
-	if (!packet_sent)
-		eigrp_packet_free(ep);
-}
-
 void eigrp_update_send_EOT(struct eigrp_neighbor *nbr)
 {
 	struct eigrp_packet *ep;
@@ -648,7 +616,7 @@ void eigrp_update_send(struct eigrp_interface *ei)
 
 			ep->sequence_number = seq_no;
 			seq_no++;
-			eigrp_update_send_to_all_nbrs(ei, ep);
+			eigrp_send_packet_multicast(ei, ep);
 
 			length = EIGRP_HEADER_LEN;
 			ep = eigrp_packet_new(ei->ifp->mtu, NULL);
@@ -697,7 +665,7 @@ void eigrp_update_send(struct eigrp_interface *ei)
 		zlog_debug("Enqueuing Update length[%u] Seq [%u]", length,
 			   ep->sequence_number);
 
-	eigrp_update_send_to_all_nbrs(ei, ep);
+	eigrp_send_packet_multicast(ei, ep);
 	ei->eigrp->sequence_number = seq_no++;
 }
 
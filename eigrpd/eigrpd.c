@@ -193,6 +193,7 @@ static struct eigrp *eigrp_new(const char *AS)
 	eigrp->serno_last_update = 0;
 	eigrp->topology_changes_externalIPV4 = list_new();
 	eigrp->topology_changes_internalIPV4 = list_new();
+	eigrp->topology_flags_dirty = list_new();
 
 	eigrp->list[EIGRP_FILTER_IN] = NULL;
 	eigrp->list[EIGRP_FILTER_OUT] = NULL;
@@ -292,6 +293,7 @@ void eigrp_finish_final(struct eigrp *eigrp)
 
 	list_delete_and_null(&eigrp->topology_changes_externalIPV4);
 	list_delete_and_null(&eigrp->topology_changes_internalIPV4);
+	list_delete_and_null(&eigrp->topology_flags_dirty);
 
 	eigrp_delete(eigrp);
 
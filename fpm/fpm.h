@@ -77,6 +77,11 @@
  * complete copy of the forwarding table(s) to the FPM, including
  * routes that it may have picked up from the kernel.
  *
+ * An FPM that can take several route updates in one message announces
+ * so by sending zebra a protobuf CAPABILITIES message, regardless of
+ * the format used for routes. zebra then packs a number of netlink
+ * messages, or a protobuf ROUTES message, into each FPM message.
+ *
  * The FPM interface uses replace semantics. That is, if a 'route add'
  * message for a prefix is followed by another 'route add' message, the
  * information in the second message is complete by itself, and replaces
@@ -102,6 +107,14 @@
  */
 #define FPM_MAX_MSG_LEN 4096
 
+/*
+ * Largest message that can be sent to an FPM that has announced the
+ * 'route_batch' capability (see fpm.proto). Such a message packs a
+ * number of route updates, each of which would fit in FPM_MAX_MSG_LEN
+ * by itself.
+ */
+#define FPM_MAX_BATCH_MSG_LEN 65532
+
 #ifdef __SUNPRO_C
 #pragma pack(1)
 #endif
@@ -92,6 +92,8 @@ struct isis_circuit *isis_circuit_new()
 		circuit->priority[i] = DEFAULT_PRIORITY;
 		circuit->metric[i] = DEFAULT_CIRCUIT_METRIC;
 		circuit->te_metric[i] = DEFAULT_CIRCUIT_METRIC;
+		circuit->srm_lsps[i] = isis_lsp_hash_new();
+		circuit->ssn_lsps[i] = isis_lsp_hash_new();
 	}
 
 	circuit->mtc = mpls_te_circuit_new();
@@ -105,6 +107,8 @@ struct isis_circuit *isis_circuit_new()
 
 void isis_circuit_del(struct isis_circuit *circuit)
 {
+	int i;
+
 	if (!circuit)
 		return;
 
@@ -114,6 +118,11 @@ void isis_circuit_del(struct isis_circuit *circuit)
 
 	circuit_mt_finish(circuit);
 
+	for (i = 0; i < 2; i++) {
+		isis_lsp_hash_free(circuit->srm_lsps[i]);
+		isis_lsp_hash_free(circuit->ssn_lsps[i]);
+	}
+
 	/* and lastly the circuit itself */
 	XFREE(MTYPE_ISIS_CIRCUIT, circuit);
 
@@ -146,9 +155,50 @@ void isis_circuit_configure(struct isis_circuit *circuit,
 	return;
 }
 
+static int circuit_srm_clear(struct isis_lsp *lsp, void *arg)
+{
+	struct isis_circuit *circuit = arg;
+
+	ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+	return HASHWALK_CONTINUE;
+}
+
+static int circuit_ssn_clear(struct isis_lsp *lsp, void *arg)
+{
+	struct isis_circuit *circuit = arg;
+
+	ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
+	return HASHWALK_CONTINUE;
+}
+
+/* Clear the circuit's SRM flags, only looking at the LSPs which have it */
+static void isis_circuit_clear_srmflags(struct isis_circuit *circuit,
+					int level)
+{
+	isis_lsp_hash_walk(circuit->srm_lsps[level - 1], circuit_srm_clear,
+			   circuit);
+	isis_lsp_hash_clean(circuit->srm_lsps[level - 1]);
+}
+
+static void isis_circuit_clear_ssnflags(struct isis_circuit *circuit,
+					int level)
+{
+	isis_lsp_hash_walk(circuit->ssn_lsps[level - 1], circuit_ssn_clear,
+			   circuit);
+	isis_lsp_hash_clean(circuit->ssn_lsps[level - 1]);
+}
+
 void isis_circuit_deconfigure(struct isis_circuit *circuit,
 			      struct isis_area *area)
 {
+	int level;
+
+	/* The index is up for reuse, leave no flags behind on it */
+	for (level = ISIS_LEVEL1; level <= ISIS_LEVEL2; level++) {
+		isis_circuit_clear_srmflags(circuit, level);
+		isis_circuit_clear_ssnflags(circuit, level);
+	}
+
 	/* Free the index of SRM and SSN flags */
 	flags_free_index(&area->flags, circuit->idx);
 	circuit->idx = 0;
@@ -506,6 +556,10 @@ static void isis_circuit_update_all_srmflags(struct isis_circuit *circuit,
 	assert(area);
 	for (level = ISIS_LEVEL1; level <= ISIS_LEVEL2; level++) {
 		if (level & circuit->is_type) {
+			if (!is_set) {
+				isis_circuit_clear_srmflags(circuit, level);
+				continue;
+			}
 			if (area->lspdb[level - 1]
 			    && dict_count(area->lspdb[level - 1]) > 0) {
 				for (dnode = dict_first(area->lspdb[level - 1]);
@@ -513,13 +567,7 @@ static void isis_circuit_update_all_srmflags(struct isis_circuit *circuit,
 					dnode_next = dict_next(
 						area->lspdb[level - 1], dnode);
 					lsp = dnode_get(dnode);
-					if (is_set) {
-						ISIS_SET_FLAG(lsp->SRMflags,
-							      circuit);
-					} else {
-						ISIS_CLEAR_FLAG(lsp->SRMflags,
-								circuit);
-					}
+					lsp_set_srm(lsp, circuit);
 				}
 			}
 		}
@@ -82,6 +82,9 @@ struct isis_circuit {
 	struct thread *t_send_lsp;
 	struct list *lsp_queue;	/* LSPs to be txed (both levels) */
 	struct isis_lsp_hash *lsp_hash; /* Hashtable synchronized with lsp_queue */
+	/* LSPs with this circuit's SRM and SSN flags set, per level */
+	struct isis_lsp_hash *srm_lsps[2];
+	struct isis_lsp_hash *ssn_lsps[2];
 	time_t lsp_queue_last_push[2]; /* timestamp used to enforce transmit
 					* interval;
 					* for scalability, use one timestamp per
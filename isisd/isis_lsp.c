@@ -36,6 +36,7 @@
 #include "if.h"
 #include "checksum.h"
 #include "md5.h"
+#include "pqueue.h"
 #include "table.h"
 
 #include "isisd/dict.h"
@@ -45,6 +46,7 @@
 #include "isisd/isis_circuit.h"
 #include "isisd/isisd.h"
 #include "isisd/isis_lsp.h"
+#include "isisd/isis_lsp_hash.h"
 #include "isisd/isis_pdu.h"
 #include "isisd/isis_dynhn.h"
 #include "isisd/isis_misc.h"
@@ -77,6 +79,88 @@ dict_t *lsp_db_init(void)
 	return dict;
 }
 
+/*
+ * The LSPs of a level are also queued by expiry time, so that lsp_tick()
+ * only looks at the ones whose remaining lifetime or ZeroAgeLifetime ran
+ * out rather than counting down every LSP of the database every second.
+ */
+static int lsp_expiry_cmp(void *a, void *b)
+{
+	struct isis_lsp *la = a, *lb = b;
+
+	if (la->expires < lb->expires)
+		return -1;
+	if (la->expires > lb->expires)
+		return 1;
+	return 0;
+}
+
+static void lsp_expiry_update(void *node, int actual_position)
+{
+	struct isis_lsp *lsp = node;
+
+	lsp->expiry_index = actual_position;
+}
+
+struct pqueue *lsp_expiry_init(void)
+{
+	struct pqueue *queue;
+
+	queue = pqueue_create();
+	queue->cmp = lsp_expiry_cmp;
+	queue->update = lsp_expiry_update;
+
+	return queue;
+}
+
+static void lsp_expiry_dequeue(struct isis_lsp *lsp)
+{
+	if (!lsp->expiry_queue)
+		return;
+
+	pqueue_remove_at(lsp->expiry_index, lsp->expiry_queue);
+	lsp->expiry_queue = NULL;
+}
+
+static void lsp_expiry_enqueue(struct isis_lsp *lsp)
+{
+	lsp_expiry_dequeue(lsp);
+	lsp->expiry_queue = lsp->area->lsp_expiry[lsp->level - 1];
+	pqueue_enqueue(lsp, lsp->expiry_queue);
+}
+
+/* To be called whenever rem_lifetime or age_out was set */
+static void lsp_schedule_expiry(struct isis_lsp *lsp)
+{
+	bool queued = lsp->expiry_queue != NULL;
+
+	lsp_expiry_dequeue(lsp);
+	lsp->expires = monotime(NULL)
+		       + (lsp->hdr.rem_lifetime ? lsp->hdr.rem_lifetime
+						: lsp->age_out);
+	if (queued)
+		lsp_expiry_enqueue(lsp);
+}
+
+/*
+ * Brings rem_lifetime, in the header as well as in the PDU, and age_out
+ * up to date for sending or showing the LSP.  Whether rem_lifetime is zero
+ * is always current, lsp_tick() takes care of it.
+ */
+void lsp_sync_lifetime(struct isis_lsp *lsp)
+{
+	time_t left = lsp->expires - monotime(NULL);
+
+	if (lsp->hdr.rem_lifetime == 0) {
+		lsp->age_out = MAX(left, 0);
+		return;
+	}
+
+	lsp->hdr.rem_lifetime = MIN(MAX(left, 1), UINT16_MAX);
+	if (lsp->pdu && stream_get_endp(lsp->pdu) >= 12)
+		stream_putw_at(lsp->pdu, 10, lsp->hdr.rem_lifetime);
+}
+
 struct isis_lsp *lsp_search(uint8_t *id, dict_t *lspdb)
 {
 	dnode_t *node;
@@ -120,14 +204,24 @@ static void lsp_destroy(struct isis_lsp *lsp)
 	for (ALL_LIST_ELEMENTS_RO(lsp->area->circuit_list, cnode, circuit))
 		isis_circuit_cancel_queued_lsp(circuit, lsp);
 
-	ISIS_FLAGS_CLEAR_ALL(lsp->SSNflags);
-	ISIS_FLAGS_CLEAR_ALL(lsp->SRMflags);
+	lsp_clear_all_ssnflags(lsp);
+	lsp_clear_all_srmflags(lsp);
+	lsp_expiry_dequeue(lsp);
+	isis_csnp_cache_flush(lsp->area, lsp->level);
 
 	lsp_clear_data(lsp);
 
+	/* Fragments and their zero LSP can go in either order */
 	if (LSP_FRAGMENT(lsp->hdr.lsp_id) == 0 && lsp->lspu.frags) {
+		struct listnode *node;
+		struct isis_lsp *frag;
+
+		for (ALL_LIST_ELEMENTS_RO(lsp->lspu.frags, node, frag))
+			frag->lspu.zero_lsp = NULL;
 		list_delete_and_null(&lsp->lspu.frags);
 		lsp->lspu.frags = NULL;
+	} else if (LSP_FRAGMENT(lsp->hdr.lsp_id) && lsp->lspu.zero_lsp) {
+		listnode_delete(lsp->lspu.zero_lsp->lspu.frags, lsp);
 	}
 
 	isis_spf_schedule(lsp->area, lsp->level);
@@ -364,6 +458,7 @@ static void lsp_purge(struct isis_lsp *lsp, int level)
 	lsp->hdr.rem_lifetime = 0;
 	lsp->level = level;
 	lsp->age_out = lsp->area->max_lsp_lifetime[level - 1];
+	lsp_schedule_expiry(lsp);
 
 	lsp_pack_pdu(lsp);
 	lsp_set_all_srmflags(lsp);
@@ -422,6 +517,7 @@ static void lsp_update_data(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr,
 	lsp->area = area;
 	lsp->level = level;
 	lsp->age_out = ZERO_AGE_LIFETIME;
+	lsp_schedule_expiry(lsp);
 	lsp->installed = time(NULL);
 
 	lsp->tlvs = tlvs;
@@ -450,10 +546,39 @@ static void lsp_link_fragment(struct isis_lsp *lsp, struct isis_lsp *lsp0)
 	}
 }
 
+/*
+ * Whether a received LSP changes no more than the prefixes the previous
+ * instance reached, which a PRC takes care of without a full SPF.
+ */
+static bool lsp_prefixes_changed_only(struct isis_lsp *lsp,
+				      struct isis_lsp_hdr *hdr,
+				      struct isis_tlvs *tlvs, bool confusion)
+{
+	if (confusion || !lsp->tlvs || !tlvs)
+		return false;
+
+	/* Appearing or going away */
+	if (!lsp->hdr.seqno || !hdr->seqno || !lsp->hdr.rem_lifetime
+	    || !hdr->rem_lifetime)
+		return false;
+
+	/* Overload and level */
+	if (lsp->hdr.lsp_bits != hdr->lsp_bits)
+		return false;
+
+	/* A fragment about to be linked to its zero LSP */
+	if (LSP_FRAGMENT(lsp->hdr.lsp_id) && !lsp->lspu.zero_lsp)
+		return false;
+
+	return isis_tlvs_same_topology(lsp->tlvs, tlvs);
+}
+
 void lsp_update(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr,
 		struct isis_tlvs *tlvs, struct stream *stream,
 		struct isis_area *area, int level, bool confusion)
 {
+	bool prc;
+
 	if (lsp->own_lsp) {
 		zlog_err(
 			"ISIS-Upd (%s): BUG updating LSP %s still marked as own LSP",
@@ -462,9 +587,14 @@ void lsp_update(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr,
 		lsp->own_lsp = 0;
 	}
 
+	prc = lsp_prefixes_changed_only(lsp, hdr, tlvs, confusion);
+	if (prc)
+		isis_spf_schedule_prc(area, level, lsp->tlvs, tlvs);
+
 	lsp_update_data(lsp, hdr, tlvs, stream, area, level);
 	if (confusion) {
 		lsp->hdr.rem_lifetime = hdr->rem_lifetime = 0;
+		lsp_schedule_expiry(lsp);
 		put_lsp_hdr(lsp, NULL, true);
 	}
 
@@ -479,10 +609,23 @@ void lsp_update(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr,
 			lsp_link_fragment(lsp, lsp0);
 	}
 
-	if (lsp->hdr.seqno)
+	if (lsp->hdr.seqno && !prc)
 		isis_spf_schedule(lsp->area, lsp->level);
 }
 
+/*
+ * The LSP received is the one we have, as its sequence number and checksum
+ * say: only the remaining lifetime needs taking over, its TLVs need not
+ * even be unpacked.
+ */
+void lsp_update_lifetime(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr)
+{
+	lsp->hdr.rem_lifetime = hdr->rem_lifetime;
+	lsp->age_out = ZERO_AGE_LIFETIME;
+	lsp_schedule_expiry(lsp);
+	lsp->installed = time(NULL);
+}
+
 /* creation of LSP directly from what we received */
 struct isis_lsp *lsp_new_from_recv(struct isis_lsp_hdr *hdr,
 				   struct isis_tlvs *tlvs,
@@ -519,6 +662,7 @@ struct isis_lsp *lsp_new(struct isis_area *area, uint8_t *lsp_id,
 	lsp->hdr.lsp_bits = lsp_bits;
 	lsp->level = level;
 	lsp->age_out = ZERO_AGE_LIFETIME;
+	lsp_schedule_expiry(lsp);
 	lsp_link_fragment(lsp, lsp0);
 	put_lsp_hdr(lsp, NULL, false);
 
@@ -534,6 +678,8 @@ struct isis_lsp *lsp_new(struct isis_area *area, uint8_t *lsp_id,
 void lsp_insert(struct isis_lsp *lsp, dict_t *lspdb)
 {
 	dict_alloc_insert(lspdb, lsp->hdr.lsp_id, lsp);
+	lsp_expiry_enqueue(lsp);
+	isis_csnp_cache_flush(lsp->area, lsp->level);
 	if (lsp->hdr.seqno)
 		isis_spf_schedule(lsp->area, lsp->level);
 }
@@ -569,21 +715,6 @@ void lsp_build_list_nonzero_ht(uint8_t *start_id, uint8_t *stop_id,
 	return;
 }
 
-static void lsp_set_time(struct isis_lsp *lsp)
-{
-	assert(lsp);
-
-	if (lsp->hdr.rem_lifetime == 0) {
-		if (lsp->age_out > 0)
-			lsp->age_out--;
-		return;
-	}
-
-	lsp->hdr.rem_lifetime--;
-	if (lsp->pdu && stream_get_endp(lsp->pdu) >= 12)
-		stream_putw_at(lsp->pdu, 10, lsp->hdr.rem_lifetime);
-}
-
 static void lspid_print(uint8_t *lsp_id, uint8_t *trg, char dynhost, char frag)
 {
 	struct isis_dynhn *dyn = NULL;
@@ -635,6 +766,7 @@ void lsp_print(struct isis_lsp *lsp, struct vty *vty, char dynhost)
 	uint8_t LSPid[255];
 	char age_out[8];
 
+	lsp_sync_lifetime(lsp);
 	lspid_print(lsp->hdr.lsp_id, LSPid, dynhost, 1);
 	vty_out(vty, "%-21s%c  ", LSPid, lsp->own_lsp ? '*' : ' ');
 	vty_out(vty, "%5" PRIu16 "   ", lsp->hdr.pdu_len);
@@ -727,64 +859,238 @@ static uint16_t lsp_refresh_time(struct isis_lsp *lsp, uint16_t rem_lifetime)
 	return refresh_time;
 }
 
-static void lsp_build_ext_reach_ipv4(struct isis_lsp *lsp,
-				     struct isis_area *area)
+static void lsp_add_ext_reach(struct isis_tlvs *tlvs, struct isis_area *area,
+			      struct route_node *rn)
 {
-	struct route_table *er_table = get_ext_reach(area, AF_INET, lsp->level);
-	if (!er_table)
+	struct isis_ext_info *info = rn->info;
+	uint32_t metric = info->metric;
+
+	if (metric > MAX_WIDE_PATH_METRIC)
+		metric = MAX_WIDE_PATH_METRIC;
+
+	if (rn->p.family == AF_INET6) {
+		isis_tlvs_add_ipv6_reach(tlvs, isis_area_ipv6_topology(area),
+					 (struct prefix_ipv6 *)&rn->p, metric);
 		return;
+	}
 
-	for (struct route_node *rn = route_top(er_table); rn;
-	     rn = route_next(rn)) {
-		if (!rn->info)
-			continue;
+	struct prefix_ipv4 *ipv4 = (struct prefix_ipv4 *)&rn->p;
 
-		struct prefix_ipv4 *ipv4 = (struct prefix_ipv4 *)&rn->p;
-		struct isis_ext_info *info = rn->info;
+	if (area->oldmetric && metric > 0x3f)
+		metric = 0x3f;
 
-		uint32_t metric = info->metric;
-		if (metric > MAX_WIDE_PATH_METRIC)
-			metric = MAX_WIDE_PATH_METRIC;
-		if (area->oldmetric && metric > 0x3f)
-			metric = 0x3f;
+	if (area->oldmetric)
+		isis_tlvs_add_oldstyle_ip_reach(tlvs, ipv4, metric);
+	if (area->newmetric)
+		isis_tlvs_add_extended_ip_reach(tlvs, ipv4, metric);
+}
 
-		if (area->oldmetric)
-			isis_tlvs_add_oldstyle_ip_reach(lsp->tlvs, ipv4,
-							metric);
-		if (area->newmetric)
-			isis_tlvs_add_extended_ip_reach(lsp->tlvs, ipv4,
-							metric);
+/* What lsp_add_ext_reach() adds takes packed, but for the TLV headers */
+static size_t lsp_ext_reach_size(struct isis_area *area, struct route_node *rn)
+{
+	size_t size = 0;
+
+	if (rn->p.family == AF_INET6)
+		return 6 + PSIZE(rn->p.prefixlen);
+
+	if (area->oldmetric)
+		size += 12;
+	if (area->newmetric)
+		size += 5 + PSIZE(rn->p.prefixlen);
+	return size;
+}
+
+/*
+ * Gives the fragment the new prefixes there is room left for in it, going
+ * by the size of the fragment packed, if it is not beyond
+ * lsp_frag_threshold already: new prefixes then do not trickle into every
+ * fragment.  Keeping 8 bytes and 4% of the room back covers the TLV headers
+ * and the ends of TLVs no prefix fits in; what still does not fit moves on
+ * to the next fragment.
+ */
+static void lsp_ext_reach_fill(struct isis_tlvs *tlvs, struct isis_area *area,
+			       struct list *pending, uint8_t frag_num,
+			       struct stream *s)
+{
+	struct listnode *node, *nnode;
+	struct route_node *rn;
+	size_t room, size;
+
+	stream_reset(s);
+	if (isis_pack_tlvs(tlvs, s, (size_t)-1, false, true))
+		return;
+	room = STREAM_WRITEABLE(s);
+	if (room < 8
+	    || room * 100 < STREAM_SIZE(s) * (100 - area->lsp_frag_threshold))
+		return;
+	room -= 8 + room / 25;
+
+	for (ALL_LIST_ELEMENTS(pending, node, nnode, rn)) {
+		size = lsp_ext_reach_size(area, rn);
+		if (size > room)
+			break;
+		room -= size;
+
+		lsp_add_ext_reach(tlvs, area, rn);
+		((struct isis_ext_info *)rn->info)->lsp_frag = frag_num + 1;
+		list_delete_node(pending, node);
 	}
 }
 
-static void lsp_build_ext_reach_ipv6(struct isis_lsp *lsp,
-				     struct isis_area *area)
+static void lsp_ext_reach_place(struct isis_area *area, int level,
+				struct prefix *p, uint8_t frag_num)
 {
-	struct route_table *er_table =
-		get_ext_reach(area, AF_INET6, lsp->level);
+	struct route_table *er_table = get_ext_reach(area, p->family, level);
+	struct route_node *rn;
+
 	if (!er_table)
 		return;
 
-	for (struct route_node *rn = route_top(er_table); rn;
-	     rn = route_next(rn)) {
-		if (!rn->info)
+	rn = route_node_lookup(er_table, p);
+	if (!rn)
+		return;
+	if (rn->info)
+		((struct isis_ext_info *)rn->info)->lsp_frag = frag_num + 1;
+	route_unlock_node(rn);
+}
+
+/* Records that the prefixes a fragment was handed on to are in it now */
+static void lsp_ext_reach_settle(struct isis_tlvs *tlvs, struct isis_area *area,
+				 int level, uint8_t frag_num)
+{
+	uint16_t mtid = isis_area_ipv6_topology(area);
+	struct isis_item_list *l;
+	struct isis_item *i;
+
+	for (i = tlvs->oldstyle_ip_reach.head; i; i = i->next)
+		lsp_ext_reach_place(
+			area, level,
+			(struct prefix *)&((struct isis_oldstyle_ip_reach *)i)
+				->prefix,
+			frag_num);
+	for (i = tlvs->extended_ip_reach.head; i; i = i->next)
+		lsp_ext_reach_place(
+			area, level,
+			(struct prefix *)&((struct isis_extended_ip_reach *)i)
+				->prefix,
+			frag_num);
+
+	l = (mtid == ISIS_MT_IPV4_UNICAST)
+		    ? &tlvs->ipv6_reach
+		    : isis_lookup_mt_items(&tlvs->mt_ipv6_reach, mtid);
+	for (i = l ? l->head : NULL; i; i = i->next)
+		lsp_ext_reach_place(
+			area, level,
+			(struct prefix *)&((struct isis_ipv6_reach *)i)->prefix,
+			frag_num);
+}
+
+/*
+ * Adds the redistributed prefixes to the fragments built so far, each to
+ * the fragment it went into before.  A prefix coming, going or changing
+ * its metric so only changes that one fragment rather than shifting the
+ * ones after it.  New prefixes fill the room left in the fragments in
+ * order, and what a fragment no longer has room for moves on to the next.
+ */
+static void lsp_build_ext_reach(struct isis_area *area, int level,
+				struct isis_tlvs **frags, size_t tlv_space)
+{
+	int families[] = {AF_INET, AF_INET6};
+	struct list *pending = list_new();
+	struct stream *s = stream_new(tlv_space);
+	struct isis_tlvs *carry = NULL, *tlvs;
+	struct route_table *er_table;
+	struct route_node *rn;
+	struct isis_ext_info *info;
+	struct listnode *node;
+	struct list *pieces;
+	unsigned int n, last = 0;
+	bool handed_on;
+
+	for (n = 0; n < 256; n++)
+		if (frags[n])
+			last = n + 1;
+
+	for (size_t f = 0; f < array_size(families); f++) {
+		er_table = get_ext_reach(area, families[f], level);
+		if (!er_table)
 			continue;
 
-		struct prefix_ipv6 *ipv6 = (struct prefix_ipv6 *)&rn->p;
-		struct isis_ext_info *info = rn->info;
+		for (rn = route_top(er_table); rn; rn = route_next(rn)) {
+			info = rn->info;
+			if (!info)
+				continue;
 
-		uint32_t metric = info->metric;
-		if (info->metric > MAX_WIDE_PATH_METRIC)
-			metric = MAX_WIDE_PATH_METRIC;
-		isis_tlvs_add_ipv6_reach(
-			lsp->tlvs, isis_area_ipv6_topology(area), ipv6, metric);
+			if (!info->lsp_frag) {
+				listnode_add(pending, rn);
+				continue;
+			}
+
+			n = info->lsp_frag - 1;
+			if (!frags[n])
+				frags[n] = isis_alloc_tlvs();
+			lsp_add_ext_reach(frags[n], area, rn);
+			if (n >= last)
+				last = n + 1;
+		}
 	}
-}
 
-static void lsp_build_ext_reach(struct isis_lsp *lsp, struct isis_area *area)
-{
-	lsp_build_ext_reach_ipv4(lsp, area);
-	lsp_build_ext_reach_ipv6(lsp, area);
+	for (n = 0; n < 256 && (n < last || carry || listcount(pending));
+	     n++) {
+		handed_on = !!carry;
+		if (carry) {
+			if (frags[n]) {
+				isis_tlvs_move_items(frags[n], carry);
+				isis_free_tlvs(carry);
+			} else {
+				frags[n] = carry;
+			}
+			carry = NULL;
+		}
+
+		if (listcount(pending)) {
+			if (!frags[n])
+				frags[n] = isis_alloc_tlvs();
+			lsp_ext_reach_fill(frags[n], area, pending, n, s);
+		}
+
+		if (!frags[n])
+			continue;
+
+		pieces = isis_fragment_tlvs(frags[n], tlv_space);
+		if (!pieces) {
+			zlog_warn("BUG: could not fragment own LSP:");
+			log_multiline(LOG_WARNING, "    ", "%s",
+				      isis_format_tlvs(frags[n]));
+			isis_free_tlvs(frags[n]);
+			frags[n] = NULL;
+			continue;
+		}
+		isis_free_tlvs(frags[n]);
+
+		/* What no longer fits is handed on to the next fragment */
+		for (ALL_LIST_ELEMENTS_RO(pieces, node, tlvs)) {
+			if (node == listhead(pieces)) {
+				frags[n] = tlvs;
+			} else if (!carry) {
+				carry = tlvs;
+			} else {
+				isis_tlvs_move_items(carry, tlvs);
+				isis_free_tlvs(tlvs);
+			}
+		}
+		list_delete_and_null(&pieces);
+
+		if (handed_on)
+			lsp_ext_reach_settle(frags[n], area, level, n);
+	}
+
+	if (carry || listcount(pending))
+		zlog_warn("ISIS (%s): Too much information for 256 fragments",
+			  area->area_tag);
+	isis_free_tlvs(carry);
+	list_delete_and_null(&pending);
+	stream_free(s);
 }
 
 static struct isis_lsp *lsp_next_frag(uint8_t frag_num, struct isis_lsp *lsp0,
@@ -804,6 +1110,7 @@ static struct isis_lsp *lsp_next_frag(uint8_t frag_num, struct isis_lsp *lsp0,
 		return lsp;
 	}
 
+	lsp_sync_lifetime(lsp0);
 	lsp = lsp_new(area, frag_id, lsp0->hdr.rem_lifetime, 0,
 		      lsp_bits_generate(level, area->overload_bit,
 					area->attached_bit),
@@ -815,7 +1122,8 @@ static struct isis_lsp *lsp_next_frag(uint8_t frag_num, struct isis_lsp *lsp0,
 
 /*
  * Builds the LSP data part. This func creates a new frag whenever
- * area->lsp_frag_threshold is exceeded.
+ * area->lsp_frag_threshold is exceeded, the redistributed prefixes
+ * staying in the fragments they were in.
  */
 static void lsp_build(struct isis_lsp *lsp, struct isis_area *area)
 {
@@ -1095,8 +1403,6 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area)
 		}
 	}
 
-	lsp_build_ext_reach(lsp, area);
-
 	struct isis_tlvs *tlvs = lsp->tlvs;
 	lsp->tlvs = NULL;
 
@@ -1114,28 +1420,35 @@ static void lsp_build(struct isis_lsp *lsp, struct isis_area *area)
 	}
 	isis_free_tlvs(tlvs);
 
+	struct isis_tlvs *frags[256] = {};
+	unsigned int frag_num = 0;
 	bool fragment_overflow = false;
-	frag = lsp;
 	for (ALL_LIST_ELEMENTS_RO(fragments, node, tlvs)) {
-		if (node != listhead(fragments)) {
-			if (LSP_FRAGMENT(frag->hdr.lsp_id) == 255) {
-				if (!fragment_overflow) {
-					fragment_overflow = true;
-					zlog_warn(
-						"ISIS (%s): Too much information for 256 fragments",
-						area->area_tag);
-				}
-				isis_free_tlvs(tlvs);
-				continue;
+		if (frag_num == 256) {
+			if (!fragment_overflow) {
+				fragment_overflow = true;
+				zlog_warn(
+					"ISIS (%s): Too much information for 256 fragments",
+					area->area_tag);
 			}
-
-			frag = lsp_next_frag(LSP_FRAGMENT(frag->hdr.lsp_id) + 1,
-					     lsp, area, level);
+			isis_free_tlvs(tlvs);
+			continue;
 		}
-		frag->tlvs = tlvs;
+		frags[frag_num++] = tlvs;
 	}
-
 	list_delete_and_null(&fragments);
+
+	lsp_build_ext_reach(area, level, frags, tlv_space);
+
+	for (frag_num = 0; frag_num < 256; frag_num++) {
+		if (!frags[frag_num])
+			continue;
+
+		frag = frag_num ? lsp_next_frag(frag_num, lsp, area, level)
+				: lsp;
+		frag->tlvs = frags[frag_num];
+	}
+
 	lsp_debug("ISIS (%s): LSP construction is complete. Serializing...",
 		  area->area_tag);
 	return;
@@ -1210,7 +1523,57 @@ int lsp_generate(struct isis_area *area, int level)
 }
 
 /*
- * Search own LSPs, update holding time and set SRM
+ * Reissues one of our LSPs just rebuilt if what it says changed or it is
+ * due for a refresh, otherwise leaves it as it was flooded: it is due once
+ * it has aged by the refresh time, or would be within a generation
+ * interval.  old_pdu is what it was flooded as when already taken off it.
+ * Returns in how many seconds it will be due.
+ */
+static uint16_t lsp_reissue(struct isis_lsp *lsp, struct stream *old_pdu,
+			    uint16_t rem_lifetime, uint16_t refresh_time)
+{
+	struct isis_area *area = lsp->area;
+	int refresh_at = rem_lifetime - refresh_time;
+	bool changed;
+
+	lsp_sync_lifetime(lsp);
+
+	/* Purged once nothing is left for it */
+	if (!lsp->tlvs) {
+		if (lsp->hdr.rem_lifetime)
+			lsp_purge(lsp, lsp->level);
+		return refresh_time;
+	}
+
+	/* Packed as it is, it only differs from before in what it says */
+	if (!old_pdu) {
+		old_pdu = lsp->pdu;
+		lsp->pdu = stream_new(LLC_LEN + area->lsp_mtu);
+	}
+	lsp_pack_pdu(lsp);
+	changed = !lsp->hdr.rem_lifetime
+		  || stream_get_endp(old_pdu) != stream_get_endp(lsp->pdu)
+		  || memcmp(STREAM_DATA(old_pdu) + 12,
+			    STREAM_DATA(lsp->pdu) + 12,
+			    stream_get_endp(lsp->pdu) - 12);
+	stream_free(old_pdu);
+
+	if (!changed
+	    && lsp->hdr.rem_lifetime
+		       > refresh_at + area->lsp_gen_interval[lsp->level - 1])
+		return lsp->hdr.rem_lifetime - refresh_at;
+
+	lsp->hdr.rem_lifetime = rem_lifetime;
+	lsp->age_out = ZERO_AGE_LIFETIME;
+	lsp_schedule_expiry(lsp);
+	lsp_inc_seqno(lsp, 0);
+	lsp_set_all_srmflags(lsp);
+	return refresh_time;
+}
+
+/*
+ * Search own LSPs, rebuild them and reissue those that changed or are due
+ * for a refresh
  */
 static int lsp_regenerate(struct isis_area *area, int level)
 {
@@ -1218,7 +1581,8 @@ static int lsp_regenerate(struct isis_area *area, int level)
 	struct isis_lsp *lsp, *frag;
 	struct listnode *node;
 	uint8_t lspid[ISIS_SYS_ID_LEN + 2];
-	uint16_t rem_lifetime, refresh_time;
+	uint16_t rem_lifetime, refresh_time, due, next;
+	struct stream *old_pdu;
 
 	if ((area == NULL) || (area->is_type & level) != level)
 		return ISIS_ERROR;
@@ -1236,31 +1600,32 @@ static int lsp_regenerate(struct isis_area *area, int level)
 		return ISIS_ERROR;
 	}
 
+	/* lsp_build() packs fragment 0 to size the others */
+	old_pdu = lsp->pdu;
+	lsp->pdu = stream_new(LLC_LEN + area->lsp_mtu);
+
 	lsp_clear_data(lsp);
 	lsp_build(lsp, area);
 	rem_lifetime = lsp_rem_lifetime(area, level);
-	lsp->hdr.rem_lifetime = rem_lifetime;
 	lsp->last_generated = time(NULL);
-	lsp_set_all_srmflags(lsp);
+
+	refresh_time = lsp_refresh_time(lsp, rem_lifetime);
+
+	/* The next refresh is when the first fragment is due */
+	next = lsp_reissue(lsp, old_pdu, rem_lifetime, refresh_time);
 	for (ALL_LIST_ELEMENTS_RO(lsp->lspu.frags, node, frag)) {
 		frag->hdr.lsp_bits = lsp_bits_generate(
 			level, area->overload_bit, area->attached_bit);
-		/* Set the lifetime values of all the fragments to the same
-		 * value,
-		 * so that no fragment expires before the lsp is refreshed.
-		 */
-		frag->hdr.rem_lifetime = rem_lifetime;
-		frag->age_out = ZERO_AGE_LIFETIME;
-		lsp_set_all_srmflags(frag);
+		due = lsp_reissue(frag, NULL, rem_lifetime, refresh_time);
+		if (due < next)
+			next = due;
 	}
-	lsp_seqno_update(lsp);
 
-	refresh_time = lsp_refresh_time(lsp, rem_lifetime);
 	if (level == IS_LEVEL_1)
-		thread_add_timer(master, lsp_l1_refresh, area, refresh_time,
+		thread_add_timer(master, lsp_l1_refresh, area, next,
 				 &area->t_lsp_refresh[level - 1]);
 	else if (level == IS_LEVEL_2)
-		thread_add_timer(master, lsp_l2_refresh, area, refresh_time,
+		thread_add_timer(master, lsp_l2_refresh, area, next,
 				 &area->t_lsp_refresh[level - 1]);
 	area->lsp_regenerate_pending[level - 1] = 0;
 
@@ -1271,7 +1636,7 @@ static int lsp_regenerate(struct isis_area *area, int level)
 			", lifetime %" PRIu16 "s refresh %" PRIu16 "s",
 			area->area_tag, level, rawlspid_print(lsp->hdr.lsp_id),
 			lsp->hdr.pdu_len, lsp->hdr.seqno, lsp->hdr.checksum,
-			lsp->hdr.rem_lifetime, refresh_time);
+			lsp->hdr.rem_lifetime, next);
 	}
 	sched_debug(
 		"ISIS (%s): Rebuilt L%d LSP. Set triggered regenerate to non-pending.",
@@ -1606,6 +1971,7 @@ static int lsp_regenerate_pseudo(struct isis_circuit *circuit, int level)
 
 	rem_lifetime = lsp_rem_lifetime(circuit->area, level);
 	lsp->hdr.rem_lifetime = rem_lifetime;
+	lsp_schedule_expiry(lsp);
 	lsp_build_pseudo(lsp, circuit, level);
 	lsp_inc_seqno(lsp, 0);
 	lsp->last_generated = time(NULL);
@@ -1782,9 +2148,65 @@ int lsp_regenerate_schedule_pseudo(struct isis_circuit *circuit, int level)
 	return ISIS_OK;
 }
 
+/* Queues the LSPs with the circuit's SRM flag set for sending */
+static int lsp_tick_queue(struct isis_lsp *lsp, void *arg)
+{
+	struct isis_circuit *circuit = arg;
+
+	isis_circuit_queue_lsp(circuit, lsp);
+	return HASHWALK_CONTINUE;
+}
+
+/*
+ * The remaining lifetime, or the ZeroAgeLifetime after it, of an LSP ran
+ * out.
+ */
+static void lsp_expire(struct isis_lsp *lsp, dict_t *lspdb)
+{
+	dnode_t *dnode;
+
+	/*
+	 * The lsp rem_lifetime is kept at 0 for MaxAge or ZeroAgeLifetime
+	 * depending on explicit purge or natural age out. So schedule spf
+	 * only once when the first time rem_lifetime becomes 0.
+	 */
+	if (lsp->hdr.rem_lifetime) {
+		lsp->hdr.rem_lifetime = 0;
+		if (lsp->pdu && stream_get_endp(lsp->pdu) >= 12)
+			stream_putw_at(lsp->pdu, 10, 0);
+
+		/*
+		 * Schedule may run spf which should be done only after the
+		 * lsp rem_lifetime becomes 0 for the first time.
+		 * ISO 10589 - 7.3.16.4 first paragraph.
+		 */
+		if (lsp->hdr.seqno != 0) {
+			/* 7.3.16.4 a) set SRM flags on all */
+			lsp_set_all_srmflags(lsp);
+			/* 7.3.16.4 b) retain only the header FIXME */
+			/* 7.3.16.4 c) record the time to purge FIXME */
+			/* run/schedule spf */
+			/* isis_spf_schedule is called inside lsp_destroy()
+			 * below; so it is not needed here. */
+			/* isis_spf_schedule (lsp->area, lsp->level); */
+		}
+
+		/* Now counting down the ZeroAgeLifetime */
+		lsp_schedule_expiry(lsp);
+		return;
+	}
+
+	zlog_debug("ISIS-Upd (%s): L%u LSP %s seq 0x%08" PRIx32 " aged out",
+		   lsp->area->area_tag, lsp->level,
+		   rawlspid_print(lsp->hdr.lsp_id), lsp->hdr.seqno);
+	dnode = dict_lookup(lspdb, lsp->hdr.lsp_id);
+	lsp_destroy(lsp);
+	dict_delete_free(lspdb, dnode);
+}
+
 /*
- * Walk through LSPs for an area
- *  - set remaining lifetime
+ * Every second, for an area:
+ *  - age out the LSPs whose lifetime ran out
  *  - set LSPs with SRMflag set for sending
  */
 int lsp_tick(struct thread *thread)
@@ -1792,116 +2214,51 @@ int lsp_tick(struct thread *thread)
 	struct isis_area *area;
 	struct isis_circuit *circuit;
 	struct isis_lsp *lsp;
-	struct list *lsp_list;
-	struct listnode *lspnode, *cnode;
-	dnode_t *dnode, *dnode_next;
+	struct pqueue *queue;
+	struct listnode *cnode;
 	int level;
-	uint16_t rem_lifetime;
 	time_t now = monotime(NULL);
 
-	lsp_list = list_new();
-
 	area = THREAD_ARG(thread);
 	assert(area);
 	area->t_tick = NULL;
 	thread_add_timer(master, lsp_tick, area, 1, &area->t_tick);
 
-	/*
-	 * Build a list of LSPs with (any) SRMflag set
-	 * and removed the ones that have aged out
-	 */
 	for (level = 0; level < ISIS_LEVELS; level++) {
-		if (area->lspdb[level] && dict_count(area->lspdb[level]) > 0) {
-			for (dnode = dict_first(area->lspdb[level]);
-			     dnode != NULL; dnode = dnode_next) {
-				dnode_next =
-					dict_next(area->lspdb[level], dnode);
-				lsp = dnode_get(dnode);
-
-				/*
-				 * The lsp rem_lifetime is kept at 0 for MaxAge
-				 * or
-				 * ZeroAgeLifetime depending on explicit purge
-				 * or
-				 * natural age out. So schedule spf only once
-				 * when
-				 * the first time rem_lifetime becomes 0.
-				 */
-				rem_lifetime = lsp->hdr.rem_lifetime;
-				lsp_set_time(lsp);
-
-				/*
-				 * Schedule may run spf which should be done
-				 * only after
-				 * the lsp rem_lifetime becomes 0 for the first
-				 * time.
-				 * ISO 10589 - 7.3.16.4 first paragraph.
-				 */
-				if (rem_lifetime == 1 && lsp->hdr.seqno != 0) {
-					/* 7.3.16.4 a) set SRM flags on all */
-					lsp_set_all_srmflags(lsp);
-					/* 7.3.16.4 b) retain only the header
-					 * FIXME  */
-					/* 7.3.16.4 c) record the time to purge
-					 * FIXME */
-					/* run/schedule spf */
-					/* isis_spf_schedule is called inside
-					 * lsp_destroy() below;
-					 * so it is not needed here. */
-					/* isis_spf_schedule (lsp->area,
-					 * lsp->level); */
-				}
+		/* Only the LSPs at the head of the expiry queue are due */
+		queue = area->lsp_expiry[level];
+		while (area->lspdb[level] && queue->size > 0) {
+			lsp = queue->array[0];
+			if (lsp->expires > now)
+				break;
+			lsp_expire(lsp, area->lspdb[level]);
+		}
 
-				if (lsp->age_out == 0) {
-					zlog_debug(
-						"ISIS-Upd (%s): L%u LSP %s seq "
-						"0x%08" PRIx32 " aged out",
-						area->area_tag, lsp->level,
-						rawlspid_print(lsp->hdr.lsp_id),
-						lsp->hdr.seqno);
-					lsp_destroy(lsp);
-					lsp = NULL;
-					dict_delete_free(area->lspdb[level],
-							 dnode);
-				} else if (flags_any_set(lsp->SRMflags))
-					listnode_add(lsp_list, lsp);
-			}
+		/*
+		 * Send LSPs on circuits indicated by the SRMflags
+		 */
+		for (ALL_LIST_ELEMENTS_RO(area->circuit_list, cnode, circuit)) {
+			if (!circuit->lsp_queue)
+				continue;
 
-			/*
-			 * Send LSPs on circuits indicated by the SRMflags
-			 */
-			if (listcount(lsp_list) > 0) {
-				for (ALL_LIST_ELEMENTS_RO(area->circuit_list,
-							  cnode, circuit)) {
-					if (!circuit->lsp_queue)
-						continue;
-
-					if (now - circuit->lsp_queue_last_push[level]
-					    < MIN_LSP_RETRANS_INTERVAL) {
-						continue;
-					}
+			if (!isis_lsp_hash_count(circuit->srm_lsps[level]))
+				continue;
 
-					circuit->lsp_queue_last_push[level] = now;
-
-					for (ALL_LIST_ELEMENTS_RO(
-						     lsp_list, lspnode, lsp)) {
-						if (circuit->upadjcount
-							    [lsp->level - 1]
-						    && ISIS_CHECK_FLAG(
-							       lsp->SRMflags,
-							       circuit)) {
-							isis_circuit_queue_lsp(
-								circuit, lsp);
-						}
-					}
-				}
-				list_delete_all_node(lsp_list);
+			if (now - circuit->lsp_queue_last_push[level]
+			    < MIN_LSP_RETRANS_INTERVAL) {
+				continue;
 			}
+
+			circuit->lsp_queue_last_push[level] = now;
+
+			if (!circuit->upadjcount[level])
+				continue;
+
+			isis_lsp_hash_walk(circuit->srm_lsps[level],
+					   lsp_tick_queue, circuit);
 		}
 	}
 
-	list_delete_and_null(&lsp_list);
-
 	return ISIS_OK;
 }
 
@@ -1936,6 +2293,7 @@ void lsp_purge_non_exist(int level, struct isis_lsp_hdr *hdr,
 
 	memcpy(&lsp->hdr, hdr, sizeof(lsp->hdr));
 	lsp->hdr.rem_lifetime = 0;
+	lsp_schedule_expiry(lsp);
 
 	lsp_pack_pdu(lsp);
 
@@ -1952,12 +2310,89 @@ void lsp_set_all_srmflags(struct isis_lsp *lsp)
 
 	assert(lsp);
 
+	if (lsp->area) {
+		struct list *circuit_list = lsp->area->circuit_list;
+		for (ALL_LIST_ELEMENTS_RO(circuit_list, node, circuit)) {
+			lsp_set_srm(lsp, circuit);
+		}
+	}
+}
+
+void lsp_clear_all_srmflags(struct isis_lsp *lsp)
+{
+	struct listnode *node;
+	struct isis_circuit *circuit;
+
+	assert(lsp);
+
+	if (lsp->area) {
+		struct list *circuit_list = lsp->area->circuit_list;
+		for (ALL_LIST_ELEMENTS_RO(circuit_list, node, circuit)) {
+			lsp_clear_srm(lsp, circuit);
+		}
+	}
+
 	ISIS_FLAGS_CLEAR_ALL(lsp->SRMflags);
+}
+
+void lsp_clear_all_ssnflags(struct isis_lsp *lsp)
+{
+	struct listnode *node;
+	struct isis_circuit *circuit;
+
+	assert(lsp);
 
 	if (lsp->area) {
 		struct list *circuit_list = lsp->area->circuit_list;
 		for (ALL_LIST_ELEMENTS_RO(circuit_list, node, circuit)) {
-			ISIS_SET_FLAG(lsp->SRMflags, circuit);
+			lsp_clear_ssn(lsp, circuit);
 		}
 	}
+
+	ISIS_FLAGS_CLEAR_ALL(lsp->SSNflags);
+}
+
+/*
+ * The circuit's sets of LSPs with its SRM or SSN flag set mean lsp_tick()
+ * and build_psnp() need not scan the whole database for the flags.
+ */
+static void lsp_flag_set_add(struct isis_lsp_hash *set, struct isis_lsp *lsp)
+{
+	struct isis_lsp *found = isis_lsp_hash_lookup(set, lsp);
+
+	if (found == lsp)
+		return;
+	if (found)
+		isis_lsp_hash_release(set, found);
+	isis_lsp_hash_add(set, lsp);
+}
+
+static void lsp_flag_set_del(struct isis_lsp_hash *set, struct isis_lsp *lsp)
+{
+	if (isis_lsp_hash_lookup(set, lsp) == lsp)
+		isis_lsp_hash_release(set, lsp);
+}
+
+void lsp_set_srm(struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+	ISIS_SET_FLAG(lsp->SRMflags, circuit);
+	lsp_flag_set_add(circuit->srm_lsps[lsp->level - 1], lsp);
+}
+
+void lsp_clear_srm(struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+	ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+	lsp_flag_set_del(circuit->srm_lsps[lsp->level - 1], lsp);
+}
+
+void lsp_set_ssn(struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+	ISIS_SET_FLAG(lsp->SSNflags, circuit);
+	lsp_flag_set_add(circuit->ssn_lsps[lsp->level - 1], lsp);
+}
+
+void lsp_clear_ssn(struct isis_lsp *lsp, struct isis_circuit *circuit)
+{
+	ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
+	lsp_flag_set_del(circuit->ssn_lsps[lsp->level - 1], lsp);
 }
@@ -46,12 +46,19 @@ struct isis_lsp {
 	int own_lsp;
 	/* used for 60 second counting when rem_lifetime is zero */
 	int age_out;
+	/* When rem_lifetime, or age_out if it is zero, runs out; both are
+	 * only brought up to date by lsp_sync_lifetime() */
+	time_t expires;
+	struct pqueue *expiry_queue; /* the area's lsp_expiry, once inserted */
+	int expiry_index;
 	struct isis_area *area;
 	struct isis_tlvs *tlvs;
 };
 
 dict_t *lsp_db_init(void);
 void lsp_db_destroy(dict_t *lspdb);
+struct pqueue *lsp_expiry_init(void);
+void lsp_sync_lifetime(struct isis_lsp *lsp);
 int lsp_tick(struct thread *thread);
 
 int lsp_generate(struct isis_area *area, int level);
@@ -95,11 +102,19 @@ int lsp_compare(char *areatag, struct isis_lsp *lsp, uint32_t seqno,
 void lsp_update(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr,
 		struct isis_tlvs *tlvs, struct stream *stream,
 		struct isis_area *area, int level, bool confusion);
+void lsp_update_lifetime(struct isis_lsp *lsp, struct isis_lsp_hdr *hdr);
 void lsp_inc_seqno(struct isis_lsp *lsp, uint32_t seqno);
 void lsp_print(struct isis_lsp *lsp, struct vty *vty, char dynhost);
 void lsp_print_detail(struct isis_lsp *lsp, struct vty *vty, char dynhost);
 int lsp_print_all(struct vty *vty, dict_t *lspdb, char detail, char dynhost);
 /* sets SRMflags for all active circuits of an lsp */
 void lsp_set_all_srmflags(struct isis_lsp *lsp);
+void lsp_clear_all_srmflags(struct isis_lsp *lsp);
+void lsp_clear_all_ssnflags(struct isis_lsp *lsp);
+/* SRM and SSN flags, kept in sync with the circuit's sets of LSPs */
+void lsp_set_srm(struct isis_lsp *lsp, struct isis_circuit *circuit);
+void lsp_clear_srm(struct isis_lsp *lsp, struct isis_circuit *circuit);
+void lsp_set_ssn(struct isis_lsp *lsp, struct isis_circuit *circuit);
+void lsp_clear_ssn(struct isis_lsp *lsp, struct isis_circuit *circuit);
 
 #endif /* ISIS_LSP */
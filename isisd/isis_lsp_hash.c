@@ -87,3 +87,29 @@ void isis_lsp_hash_release(struct isis_lsp_hash *ih, struct isis_lsp *lsp)
 {
 	hash_release(ih->h, lsp);
 }
+
+unsigned long isis_lsp_hash_count(struct isis_lsp_hash *ih)
+{
+	return hashcount(ih->h);
+}
+
+struct lsp_hash_walk_arg {
+	int (*func)(struct isis_lsp *lsp, void *arg);
+	void *arg;
+};
+
+static int lsp_hash_walk_cb(struct hash_backet *backet, void *arg)
+{
+	struct lsp_hash_walk_arg *walk = arg;
+
+	return walk->func(backet->data, walk->arg);
+}
+
+void isis_lsp_hash_walk(struct isis_lsp_hash *ih,
+			int (*func)(struct isis_lsp *lsp, void *arg),
+			void *arg)
+{
+	struct lsp_hash_walk_arg walk = {.func = func, .arg = arg};
+
+	hash_walk(ih->h, lsp_hash_walk_cb, &walk);
+}
@@ -31,4 +31,9 @@ struct isis_lsp *isis_lsp_hash_lookup(struct isis_lsp_hash *ih,
 				      struct isis_lsp *lsp);
 void isis_lsp_hash_add(struct isis_lsp_hash *ih, struct isis_lsp *lsp);
 void isis_lsp_hash_release(struct isis_lsp_hash *ih, struct isis_lsp *lsp);
+unsigned long isis_lsp_hash_count(struct isis_lsp_hash *ih);
+/* func returns HASHWALK_CONTINUE or HASHWALK_ABORT, and must not change ih */
+void isis_lsp_hash_walk(struct isis_lsp_hash *ih,
+			int (*func)(struct isis_lsp *lsp, void *arg),
+			void *arg);
 #endif
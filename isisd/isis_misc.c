@@ -29,6 +29,7 @@
 #include "if.h"
 #include "command.h"
 #include "log_int.h"
+#include "frratomic.h"
 
 #include "isisd/dict.h"
 #include "isisd/isis_constants.h"
@@ -322,17 +323,16 @@ const char *rawlspid_print(const uint8_t *from)
 #define FORMAT_ID_SIZE sizeof("0000.0000.0000.00-00")
 const char *isis_format_id(const uint8_t *id, size_t len)
 {
-#define FORMAT_BUF_COUNT 4
+#define FORMAT_BUF_COUNT 8
 	static char buf_ring[FORMAT_BUF_COUNT][FORMAT_ID_SIZE];
-	static size_t cur_buf = 0;
+	/* SPF worker pthreads log IDs too */
+	static _Atomic unsigned int cur_buf;
 
 	char *rv;
 
-	cur_buf++;
-	if (cur_buf >= FORMAT_BUF_COUNT)
-		cur_buf = 0;
-
-	rv = buf_ring[cur_buf];
+	rv = buf_ring[atomic_fetch_add_explicit(&cur_buf, 1,
+						memory_order_relaxed)
+		      % FORMAT_BUF_COUNT];
 
 	if (!id) {
 		snprintf(rv, FORMAT_ID_SIZE, "unknown");
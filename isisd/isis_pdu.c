@@ -47,6 +47,7 @@
 #include "isisd/isisd.h"
 #include "isisd/isis_dynhn.h"
 #include "isisd/isis_lsp.h"
+#include "isisd/isis_lsp_hash.h"
 #include "isisd/isis_pdu.h"
 #include "isisd/iso_checksum.h"
 #include "isisd/isis_csm.h"
@@ -55,6 +56,8 @@
 #include "isisd/isis_mt.h"
 #include "isisd/isis_tlvs.h"
 
+DEFINE_MTYPE_STATIC(ISISD, ISIS_CSNP_CACHE, "ISIS CSNP cache")
+
 static int ack_lsp(struct isis_lsp_hdr *hdr, struct isis_circuit *circuit,
 		   int level)
 {
@@ -683,6 +686,21 @@ out:
 	return retval;
 }
 
+static int process_lsp_unpack(struct isis_circuit *circuit,
+			      struct isis_tlvs **tlvs)
+{
+	const char *error_log;
+
+	if (isis_unpack_tlvs(STREAM_READABLE(circuit->rcv_stream),
+			     circuit->rcv_stream, tlvs, &error_log)) {
+		zlog_warn("Something went wrong unpacking the LSP: %s",
+			  error_log);
+		return ISIS_WARNING;
+	}
+
+	return ISIS_OK;
+}
+
 /*
  * Process Level 1/2 Link State
  * ISO - 10589
@@ -772,14 +790,15 @@ static int process_lsp(uint8_t pdu_type, struct isis_circuit *circuit,
 		return ISIS_WARNING;
 	}
 
+	/* The TLVs are only unpacked once the LSP is going to be stored, an
+	 * LSP which is no newer than ours is dealt with from the header. */
 	struct isis_tlvs *tlvs = NULL;
 	int retval = ISIS_WARNING;
-	const char *error_log;
 
-	if (isis_unpack_tlvs(STREAM_READABLE(circuit->rcv_stream),
-			     circuit->rcv_stream, &tlvs, &error_log)) {
+	if (!isis_tlv_view_wellformed(circuit->rcv_stream,
+				      STREAM_READABLE(circuit->rcv_stream))) {
 		zlog_warn("Something went wrong unpacking the LSP: %s",
-			  error_log);
+			  "TLVs overrun the PDU");
 		goto out;
 	}
 
@@ -792,7 +811,9 @@ static int process_lsp(uint8_t pdu_type, struct isis_circuit *circuit,
 	struct isis_passwd *passwd = (level == ISIS_LEVEL1)
 					     ? &circuit->area->area_passwd
 					     : &circuit->area->domain_passwd;
-	if (!isis_tlvs_auth_is_valid(tlvs, passwd, circuit->rcv_stream, true)) {
+	if (!isis_tlv_view_auth_is_valid(circuit->rcv_stream,
+					 STREAM_READABLE(circuit->rcv_stream),
+					 passwd, true)) {
 		isis_event_auth_failure(circuit->area->area_tag,
 					"LSP authentication failure",
 					hdr.lsp_id);
@@ -882,6 +903,8 @@ dontcheckadj:
 				/* LSP by some other system -> do 7.3.16.4 b) */
 				/* 7.3.16.4 b) 1)  */
 				if (comp == LSP_NEWER) {
+					if (process_lsp_unpack(circuit, &tlvs))
+						goto out;
 					lsp_update(lsp, &hdr, tlvs,
 						   circuit->rcv_stream,
 						   circuit->area, level,
@@ -890,11 +913,11 @@ dontcheckadj:
 					/* ii */
 					lsp_set_all_srmflags(lsp);
 					/* v */
-					ISIS_FLAGS_CLEAR_ALL(
-						lsp->SSNflags); /* FIXME:
-								   OTHER
-								   than c
-								   */
+					lsp_clear_all_ssnflags(
+						lsp); /* FIXME:
+							 OTHER
+							 than c
+							 */
 
 					/* For the case of lsp confusion, flood
 					 * the purge back to its
@@ -903,28 +926,24 @@ dontcheckadj:
 					 * through incoming circuit as usual */
 					if (!lsp_confusion) {
 						/* iii */
-						ISIS_CLEAR_FLAG(lsp->SRMflags,
-								circuit);
+						lsp_clear_srm(lsp, circuit);
 						/* iv */
 						if (circuit->circ_type
 						    != CIRCUIT_T_BROADCAST)
-							ISIS_SET_FLAG(
-								lsp->SSNflags,
-								circuit);
+							lsp_set_ssn(lsp, circuit);
 					}
 				} /* 7.3.16.4 b) 2) */
 				else if (comp == LSP_EQUAL) {
 					/* i */
-					ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+					lsp_clear_srm(lsp, circuit);
 					/* ii */
 					if (circuit->circ_type
 					    != CIRCUIT_T_BROADCAST)
-						ISIS_SET_FLAG(lsp->SSNflags,
-							      circuit);
+						lsp_set_ssn(lsp, circuit);
 				} /* 7.3.16.4 b) 3) */
 				else {
-					ISIS_SET_FLAG(lsp->SRMflags, circuit);
-					ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
+					lsp_set_srm(lsp, circuit);
+					lsp_clear_ssn(lsp, circuit);
 				}
 			} else if (lsp->hdr.rem_lifetime != 0) {
 				/* our own LSP -> 7.3.16.4 c) */
@@ -932,8 +951,8 @@ dontcheckadj:
 					lsp_inc_seqno(lsp, hdr.seqno);
 					lsp_set_all_srmflags(lsp);
 				} else {
-					ISIS_SET_FLAG(lsp->SRMflags, circuit);
-					ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
+					lsp_set_srm(lsp, circuit);
+					lsp_clear_ssn(lsp, circuit);
 				}
 				if (isis->debugs & DEBUG_UPDATE_PACKETS)
 					zlog_debug(
@@ -998,6 +1017,8 @@ dontcheckadj:
 					return ISIS_OK;
 				}
 			}
+			if (process_lsp_unpack(circuit, &tlvs))
+				goto out;
 			/* i */
 			if (!lsp) {
 				lsp = lsp_new_from_recv(
@@ -1015,26 +1036,24 @@ dontcheckadj:
 			/* ii */
 			lsp_set_all_srmflags(lsp);
 			/* iii */
-			ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+			lsp_clear_srm(lsp, circuit);
 
 			/* iv */
 			if (circuit->circ_type != CIRCUIT_T_BROADCAST)
-				ISIS_SET_FLAG(lsp->SSNflags, circuit);
+				lsp_set_ssn(lsp, circuit);
 			/* FIXME: v) */
 		}
 		/* 7.3.15.1 e) 2) LSP equal to the one in db */
 		else if (comp == LSP_EQUAL) {
-			ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
-			lsp_update(lsp, &hdr, tlvs, circuit->rcv_stream,
-				   circuit->area, level, false);
-			tlvs = NULL;
+			lsp_clear_srm(lsp, circuit);
+			lsp_update_lifetime(lsp, &hdr);
 			if (circuit->circ_type != CIRCUIT_T_BROADCAST)
-				ISIS_SET_FLAG(lsp->SSNflags, circuit);
+				lsp_set_ssn(lsp, circuit);
 		}
 		/* 7.3.15.1 e) 3) LSP older than the one in db */
 		else {
-			ISIS_SET_FLAG(lsp->SRMflags, circuit);
-			ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
+			lsp_set_srm(lsp, circuit);
+			lsp_clear_ssn(lsp, circuit);
 		}
 	}
 
@@ -1210,25 +1229,25 @@ static int process_snp(uint8_t pdu_type, struct isis_circuit *circuit,
 			if (cmp == LSP_EQUAL) {
 				/* if (circuit->circ_type !=
 				 * CIRCUIT_T_BROADCAST) */
-				ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+				lsp_clear_srm(lsp, circuit);
 			}
 			/* 7.3.15.2 b) 3) if it is older, clear SSN and set SRM
 			   */
 			else if (cmp == LSP_OLDER) {
-				ISIS_CLEAR_FLAG(lsp->SSNflags, circuit);
-				ISIS_SET_FLAG(lsp->SRMflags, circuit);
+				lsp_clear_ssn(lsp, circuit);
+				lsp_set_srm(lsp, circuit);
 			}
 			/* 7.3.15.2 b) 4) if it is newer, set SSN and clear SRM
 			   on p2p */
 			else {
 				if (own_lsp) {
 					lsp_inc_seqno(lsp, entry->seqno);
-					ISIS_SET_FLAG(lsp->SRMflags, circuit);
+					lsp_set_srm(lsp, circuit);
 				} else {
-					ISIS_SET_FLAG(lsp->SSNflags, circuit);
+					lsp_set_ssn(lsp, circuit);
 					/* if (circuit->circ_type !=
 					 * CIRCUIT_T_BROADCAST) */
-					ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+					lsp_clear_srm(lsp, circuit);
 				}
 			}
 		} else {
@@ -1260,8 +1279,8 @@ static int process_snp(uint8_t pdu_type, struct isis_circuit *circuit,
 						entry->checksum, lsp0, level);
 				lsp_insert(lsp,
 					   circuit->area->lspdb[level - 1]);
-				ISIS_FLAGS_CLEAR_ALL(lsp->SRMflags);
-				ISIS_SET_FLAG(lsp->SSNflags, circuit);
+				lsp_clear_all_srmflags(lsp);
+				lsp_set_ssn(lsp, circuit);
 			}
 		}
 	}
@@ -1293,7 +1312,7 @@ static int process_snp(uint8_t pdu_type, struct isis_circuit *circuit,
 
 		/* on remaining LSPs we set SRM (neighbor knew not of) */
 		for (ALL_LIST_ELEMENTS_RO(lsp_list, node, lsp))
-			ISIS_SET_FLAG(lsp->SRMflags, circuit);
+			lsp_set_srm(lsp, circuit);
 		/* lets free it */
 		list_delete_and_null(&lsp_list);
 	}
@@ -1740,8 +1759,179 @@ static uint16_t get_max_lsp_count(uint16_t size)
 	return lsp_count;
 }
 
+/*
+ * The LSP entries of a level's CSNPs, packed once and then shared by all
+ * the circuits of the level until an LSP comes or goes.  Only the entries'
+ * lifetime, sequence number and checksum change meanwhile, and they are
+ * rewritten from the LSPs on sending.
+ */
+struct isis_csnp_fragment {
+	uint8_t start[ISIS_SYS_ID_LEN + 2];
+	uint8_t stop[ISIS_SYS_ID_LEN + 2];
+	struct stream *entries; /* the packed LSP Entries TLVs */
+	struct isis_lsp **lsps; /* of the entries, in order */
+};
+
+struct isis_csnp_cache {
+	uint16_t num_lsps; /* per fragment, what depends on the circuit */
+	struct list *fragments;
+};
+
+static void csnp_fragment_free(void *arg)
+{
+	struct isis_csnp_fragment *frag = arg;
+
+	stream_free(frag->entries);
+	XFREE(MTYPE_ISIS_CSNP_CACHE, frag->lsps);
+	XFREE(MTYPE_ISIS_CSNP_CACHE, frag);
+}
+
+void isis_csnp_cache_flush(struct isis_area *area, int level)
+{
+	struct isis_csnp_cache *cache = area->csnp_cache[level - 1];
+
+	if (!cache)
+		return;
+
+	list_delete_and_null(&cache->fragments);
+	XFREE(MTYPE_ISIS_CSNP_CACHE, cache);
+	area->csnp_cache[level - 1] = NULL;
+}
+
+static struct isis_csnp_fragment *csnp_fragment_new(struct isis_tlvs *tlvs,
+						    uint8_t *start,
+						    uint8_t *stop)
+{
+	struct isis_csnp_fragment *frag;
+	struct isis_lsp_entry *entry;
+	unsigned int i = 0;
+
+	frag = XCALLOC(MTYPE_ISIS_CSNP_CACHE, sizeof(*frag));
+	memcpy(frag->start, start, sizeof(frag->start));
+	memcpy(frag->stop, stop, sizeof(frag->stop));
+
+	frag->lsps = XCALLOC(MTYPE_ISIS_CSNP_CACHE,
+			     (tlvs->lsp_entries.count + 1) * sizeof(*frag->lsps));
+	for (entry = (struct isis_lsp_entry *)tlvs->lsp_entries.head; entry;
+	     entry = entry->next)
+		frag->lsps[i++] = entry->lsp;
+
+	/* Every TLV has at least one entry */
+	frag->entries = stream_new(tlvs->lsp_entries.count
+					   * (LSP_ENTRIES_LEN + 2)
+				   + 2);
+	if (isis_pack_tlvs(tlvs, frag->entries, (size_t)-1, false, false)) {
+		csnp_fragment_free(frag);
+		return NULL;
+	}
+
+	return frag;
+}
+
+/* Splits the level's LSPDB into the ranges and entries of the CSNPs */
+static struct isis_csnp_cache *csnp_cache_build(struct isis_area *area,
+						int level, uint16_t num_lsps)
+{
+	struct isis_csnp_cache *cache;
+	struct isis_csnp_fragment *frag;
+	struct isis_tlvs *tlvs;
+	bool loop = true;
+
+	cache = XCALLOC(MTYPE_ISIS_CSNP_CACHE, sizeof(*cache));
+	cache->num_lsps = num_lsps;
+	cache->fragments = list_new();
+	cache->fragments->del = csnp_fragment_free;
+
+	uint8_t start[ISIS_SYS_ID_LEN + 2];
+	memset(start, 0x00, ISIS_SYS_ID_LEN + 2);
+	uint8_t stop[ISIS_SYS_ID_LEN + 2];
+	memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
+
+	while (loop) {
+		tlvs = isis_alloc_tlvs();
+
+		struct isis_lsp *last_lsp;
+		isis_tlvs_add_csnp_entries(tlvs, start, stop, num_lsps,
+					   area->lspdb[level - 1], &last_lsp);
+		/*
+		 * Update the stop lsp_id before encoding this CSNP.
+		 */
+		if (tlvs->lsp_entries.count < num_lsps) {
+			memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
+		} else {
+			memcpy(stop, last_lsp->hdr.lsp_id, sizeof(stop));
+		}
+
+		frag = csnp_fragment_new(tlvs, start, stop);
+		isis_free_tlvs(tlvs);
+		if (!frag) {
+			list_delete_and_null(&cache->fragments);
+			XFREE(MTYPE_ISIS_CSNP_CACHE, cache);
+			return NULL;
+		}
+		listnode_add(cache->fragments, frag);
+
+		/*
+		 * Start lsp_id of the next CSNP should be one plus the
+		 * stop lsp_id in this current CSNP.
+		 */
+		memcpy(start, stop, ISIS_SYS_ID_LEN + 2);
+		loop = 0;
+		for (int i = ISIS_SYS_ID_LEN + 1; i >= 0; --i) {
+			if (start[i] < (uint8_t)0xff) {
+				start[i] += 1;
+				loop = 1;
+				break;
+			}
+		}
+		memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
+	}
+
+	return cache;
+}
+
+/* Brings the entries up to date with their LSPs and appends them */
+static void csnp_fragment_put(struct isis_csnp_fragment *frag,
+			      struct stream *stream)
+{
+	struct isis_tlv_iter iter;
+	struct isis_lsp *lsp;
+	unsigned int i = 0;
+	size_t off, pos;
+
+	isis_tlv_iter_init(&iter, frag->entries,
+			   stream_get_endp(frag->entries));
+	while (isis_tlv_iter_next(&iter)) {
+		if (iter.type != ISIS_TLV_LSP_ENTRY)
+			continue;
+
+		for (off = 0; off + LSP_ENTRIES_LEN <= iter.len;
+		     off += LSP_ENTRIES_LEN) {
+			pos = iter.value + off - STREAM_DATA(frag->entries);
+			lsp = frag->lsps[i++];
+			lsp_sync_lifetime(lsp);
+
+			/* Remaining lifetime, LSP ID, sequence number and
+			 * checksum */
+			stream_putw_at(frag->entries, pos,
+				       lsp->hdr.rem_lifetime);
+			pos += 2 + ISIS_SYS_ID_LEN + 2;
+			stream_putl_at(frag->entries, pos, lsp->hdr.seqno);
+			stream_putw_at(frag->entries, pos + 4,
+				       lsp->hdr.checksum);
+		}
+	}
+
+	stream_put(stream, STREAM_DATA(frag->entries),
+		   stream_get_endp(frag->entries));
+}
+
 int send_csnp(struct isis_circuit *circuit, int level)
 {
+	struct isis_csnp_cache *cache;
+	struct isis_csnp_fragment *frag;
+	struct listnode *node;
+
 	if (circuit->area->lspdb[level - 1] == NULL
 	    || dict_count(circuit->area->lspdb[level - 1]) == 0)
 		return ISIS_OK;
@@ -1771,60 +1961,59 @@ int send_csnp(struct isis_circuit *circuit, int level)
 	if (CHECK_FLAG(passwd->snp_auth, SNP_AUTH_SEND))
 		isis_tlvs_add_auth(tlvs, passwd);
 
-	size_t tlv_start = stream_get_endp(circuit->snd_stream);
+	/* The auth TLV stays in place for all the CSNPs */
+	size_t auth_start = stream_get_endp(circuit->snd_stream);
 	if (isis_pack_tlvs(tlvs, circuit->snd_stream, len_pointer, false,
 			   false)) {
 		isis_free_tlvs(tlvs);
 		return ISIS_WARNING;
 	}
-	isis_free_tlvs(tlvs);
+	size_t tlv_start = stream_get_endp(circuit->snd_stream);
 
 	uint16_t num_lsps =
 		get_max_lsp_count(STREAM_WRITEABLE(circuit->snd_stream));
 
-	uint8_t start[ISIS_SYS_ID_LEN + 2];
-	memset(start, 0x00, ISIS_SYS_ID_LEN + 2);
-	uint8_t stop[ISIS_SYS_ID_LEN + 2];
-	memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
-
-	bool loop = true;
-	while (loop) {
-		tlvs = isis_alloc_tlvs();
-		if (CHECK_FLAG(passwd->snp_auth, SNP_AUTH_SEND))
-			isis_tlvs_add_auth(tlvs, passwd);
-
-		struct isis_lsp *last_lsp;
-		isis_tlvs_add_csnp_entries(tlvs, start, stop, num_lsps,
-					   circuit->area->lspdb[level - 1],
-					   &last_lsp);
-		/*
-		 * Update the stop lsp_id before encoding this CSNP.
-		 */
-		if (tlvs->lsp_entries.count < num_lsps) {
-			memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
-		} else {
-			memcpy(stop, last_lsp->hdr.lsp_id, sizeof(stop));
-		}
-
-		memcpy(STREAM_DATA(circuit->snd_stream) + start_pointer, start,
-		       ISIS_SYS_ID_LEN + 2);
-		memcpy(STREAM_DATA(circuit->snd_stream) + end_pointer, stop,
-		       ISIS_SYS_ID_LEN + 2);
-		stream_set_endp(circuit->snd_stream, tlv_start);
-		if (isis_pack_tlvs(tlvs, circuit->snd_stream, len_pointer,
-				   false, false)) {
+	cache = circuit->area->csnp_cache[level - 1];
+	if (cache && cache->num_lsps != num_lsps) {
+		isis_csnp_cache_flush(circuit->area, level);
+		cache = NULL;
+	}
+	if (!cache) {
+		cache = csnp_cache_build(circuit->area, level, num_lsps);
+		if (!cache) {
 			isis_free_tlvs(tlvs);
 			return ISIS_WARNING;
 		}
+		circuit->area->csnp_cache[level - 1] = cache;
+	}
+
+	for (ALL_LIST_ELEMENTS_RO(cache->fragments, node, frag)) {
+		memcpy(STREAM_DATA(circuit->snd_stream) + start_pointer,
+		       frag->start, ISIS_SYS_ID_LEN + 2);
+		memcpy(STREAM_DATA(circuit->snd_stream) + end_pointer,
+		       frag->stop, ISIS_SYS_ID_LEN + 2);
+		stream_set_endp(circuit->snd_stream, tlv_start);
+		csnp_fragment_put(frag, circuit->snd_stream);
+		stream_putw_at(circuit->snd_stream, len_pointer,
+			       stream_get_endp(circuit->snd_stream));
+		isis_tlvs_update_auth(tlvs, circuit->snd_stream, false);
 
 		if (isis->debugs & DEBUG_SNP_PACKETS) {
+			struct isis_tlvs *sent;
+			const char *error_log;
+
 			zlog_debug(
 				"ISIS-Snp (%s): Sending L%d CSNP on %s, length %zd",
 				circuit->area->area_tag, level,
 				circuit->interface->name,
 				stream_get_endp(circuit->snd_stream));
+			stream_set_getp(circuit->snd_stream, auth_start);
+			isis_unpack_tlvs(STREAM_READABLE(circuit->snd_stream),
+					 circuit->snd_stream, &sent,
+					 &error_log);
 			log_multiline(LOG_DEBUG, "              ", "%s",
-				      isis_format_tlvs(tlvs));
+				      isis_format_tlvs(sent));
+			isis_free_tlvs(sent);
 			if (isis->debugs & DEBUG_PACKET_DUMP)
 				zlog_dump_data(
 					STREAM_DATA(circuit->snd_stream),
@@ -1839,24 +2028,9 @@ int send_csnp(struct isis_circuit *circuit, int level)
 			isis_free_tlvs(tlvs);
 			return retval;
 		}
-
-		/*
-		 * Start lsp_id of the next CSNP should be one plus the
-		 * stop lsp_id in this current CSNP.
-		 */
-		memcpy(start, stop, ISIS_SYS_ID_LEN + 2);
-		loop = 0;
-		for (int i = ISIS_SYS_ID_LEN + 1; i >= 0; --i) {
-			if (start[i] < (uint8_t)0xff) {
-				start[i] += 1;
-				loop = 1;
-				break;
-			}
-		}
-		memset(stop, 0xff, ISIS_SYS_ID_LEN + 2);
-		isis_free_tlvs(tlvs);
 	}
 
+	isis_free_tlvs(tlvs);
 	return ISIS_OK;
 }
 
@@ -1904,6 +2078,22 @@ int send_l2_csnp(struct thread *thread)
 	return retval;
 }
 
+struct send_psnp_arg {
+	struct isis_tlvs *tlvs;
+	uint16_t num_lsps;
+};
+
+/* Only the LSPs with the circuit's SSN flag set need looking at */
+static int send_psnp_entry(struct isis_lsp *lsp, void *arg)
+{
+	struct send_psnp_arg *psnp = arg;
+
+	isis_tlvs_add_lsp_entry(psnp->tlvs, lsp);
+	if (psnp->tlvs->lsp_entries.count == psnp->num_lsps)
+		return HASHWALK_ABORT;
+	return HASHWALK_CONTINUE;
+}
+
 /*
  *  7.3.15.4 action on expiration of partial SNP interval
  *  level 1
@@ -1956,18 +2146,10 @@ static int send_psnp(int level, struct isis_circuit *circuit)
 		if (CHECK_FLAG(passwd->snp_auth, SNP_AUTH_SEND))
 			isis_tlvs_add_auth(tlvs, passwd);
 
-		for (dnode_t *dnode =
-			     dict_first(circuit->area->lspdb[level - 1]);
-		     dnode; dnode = dict_next(circuit->area->lspdb[level - 1],
-					      dnode)) {
-			struct isis_lsp *lsp = dnode_get(dnode);
-
-			if (ISIS_CHECK_FLAG(lsp->SSNflags, circuit))
-				isis_tlvs_add_lsp_entry(tlvs, lsp);
+		struct send_psnp_arg arg = {.tlvs = tlvs, .num_lsps = num_lsps};
 
-			if (tlvs->lsp_entries.count == num_lsps)
-				break;
-		}
+		isis_lsp_hash_walk(circuit->ssn_lsps[level - 1],
+				   send_psnp_entry, &arg);
 
 		if (!tlvs->lsp_entries.count) {
 			isis_free_tlvs(tlvs);
@@ -2012,7 +2194,7 @@ static int send_psnp(int level, struct isis_circuit *circuit)
 		entry_head = (struct isis_lsp_entry *)tlvs->lsp_entries.head;
 		for (struct isis_lsp_entry *entry = entry_head; entry;
 		     entry = entry->next)
-			ISIS_CLEAR_FLAG(entry->lsp->SSNflags, circuit);
+			lsp_clear_ssn(entry->lsp, circuit);
 		isis_free_tlvs(tlvs);
 	}
 
@@ -2121,6 +2303,7 @@ int send_lsp(struct thread *thread)
 	}
 
 	/* copy our lsp to the send buffer */
+	lsp_sync_lifetime(lsp);
 	stream_copy(circuit->snd_stream, lsp->pdu);
 
 	if (isis->debugs & DEBUG_UPDATE_PACKETS) {
@@ -2159,7 +2342,7 @@ out:
 		 * to clear
 		 * the fag.
 		 */
-		ISIS_CLEAR_FLAG(lsp->SRMflags, circuit);
+		lsp_clear_srm(lsp, circuit);
 	}
 
 	return retval;
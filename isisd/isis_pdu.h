@@ -208,6 +208,8 @@ int send_lan_l1_hello(struct thread *thread);
 int send_lan_l2_hello(struct thread *thread);
 int send_p2p_hello(struct thread *thread);
 int send_csnp(struct isis_circuit *circuit, int level);
+struct isis_area;
+void isis_csnp_cache_flush(struct isis_area *area, int level);
 int send_l1_csnp(struct thread *thread);
 int send_l2_csnp(struct thread *thread);
 int send_l1_psnp(struct thread *thread);
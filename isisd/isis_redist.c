@@ -117,6 +117,7 @@ static void isis_redist_install(struct isis_area *area, int level,
 	int family = p->family;
 	struct route_table *er_table = get_ext_reach(area, family, level);
 	struct route_node *er_node;
+	struct isis_ext_info *er_info;
 
 	if (!er_table) {
 		zlog_warn(
@@ -129,15 +130,22 @@ static void isis_redist_install(struct isis_area *area, int level,
 	er_node = route_node_get(er_table, p);
 	if (er_node->info) {
 		route_unlock_node(er_node);
+		er_info = er_node->info;
 
 		/* Don't update/reschedule lsp generation if nothing changed. */
-		if (!memcmp(er_node->info, info, sizeof(*info)))
+		if (er_info->origin == info->origin
+		    && er_info->metric == info->metric
+		    && er_info->distance == info->distance)
 			return;
 	} else {
-		er_node->info = XMALLOC(MTYPE_ISIS_EXT_INFO, sizeof(*info));
+		er_node->info = XCALLOC(MTYPE_ISIS_EXT_INFO, sizeof(*info));
+		er_info = er_node->info;
 	}
 
-	memcpy(er_node->info, info, sizeof(*info));
+	/* Stays in its LSP fragment */
+	er_info->origin = info->origin;
+	er_info->metric = info->metric;
+	er_info->distance = info->distance;
 	lsp_regenerate_schedule(area, level, 0);
 }
 
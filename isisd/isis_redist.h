@@ -31,6 +31,9 @@ struct isis_ext_info {
 	int origin;
 	uint32_t metric;
 	uint8_t distance;
+	/* In an area's ext_reach, 1 + the own LSP fragment the prefix went
+	 * into, 0 until it is given one */
+	uint16_t lsp_frag;
 };
 
 struct isis_redist {
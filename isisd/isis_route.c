@@ -378,112 +378,121 @@ struct isis_route_info *isis_route_create(struct prefix *prefix, uint32_t cost,
 	return route_info;
 }
 
+/* Withdraws the route from zebra if it was installed and frees it. */
+static void isis_route_remove(struct prefix *prefix,
+			      struct isis_route_info *rinfo)
+{
+	char buff[PREFIX2STR_BUFFER];
+
+	if (CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED)) {
+		UNSET_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE);
+		if (isis->debugs & DEBUG_RTE_EVENTS) {
+			prefix2str(prefix, buff, sizeof(buff));
+			zlog_debug("ISIS-Rte: route delete  %s", buff);
+		}
+		isis_zebra_route_update(prefix, rinfo);
+	}
+	isis_route_info_delete(rinfo);
+}
+
 static void isis_route_delete(struct prefix *prefix, struct route_table *table)
 {
 	struct route_node *rode;
 	struct isis_route_info *rinfo;
 	char buff[PREFIX2STR_BUFFER];
 
-	/* for log */
-	prefix2str(prefix, buff, sizeof(buff));
-
-
 	rode = route_node_get(table, prefix);
 	rinfo = rode->info;
 
 	if (rinfo == NULL) {
-		if (isis->debugs & DEBUG_RTE_EVENTS)
+		if (isis->debugs & DEBUG_RTE_EVENTS) {
+			prefix2str(prefix, buff, sizeof(buff));
 			zlog_debug(
 				"ISIS-Rte: tried to delete non-existant route %s",
 				buff);
+		}
 		return;
 	}
 
-	if (CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED)) {
-		UNSET_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE);
-		if (isis->debugs & DEBUG_RTE_EVENTS)
-			zlog_debug("ISIS-Rte: route delete  %s", buff);
-		isis_zebra_route_update(prefix, rinfo);
-	}
-	isis_route_info_delete(rinfo);
+	isis_route_remove(prefix, rinfo);
 	rode->info = NULL;
 
 	return;
 }
 
+/*
+ * Syncs a route with zebra.  Returns true when the route is no longer
+ * active, for the caller to delete it.
+ */
+static bool isis_route_validate_info(struct isis_area *area,
+				     struct prefix *prefix,
+				     struct isis_route_info *rinfo)
+{
+	struct route_node *drnode;
+	char buff[PREFIX2STR_BUFFER];
+
+	if (isis->debugs & DEBUG_RTE_EVENTS) {
+		prefix2str(prefix, buff, sizeof(buff));
+		zlog_debug("ISIS-Rte (%s): route validate: %s %s %s %s",
+			   area->area_tag,
+			   (CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ZEBRA_SYNCED)
+				    ? "synced"
+				    : "not-synced"),
+			   (CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ZEBRA_RESYNC)
+				    ? "resync"
+				    : "not-resync"),
+			   (CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE)
+				    ? "active"
+				    : "inactive"),
+			   buff);
+	}
+
+	isis_zebra_route_update(prefix, rinfo);
+	if (CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE))
+		return false;
+
+	/* Area is either L1 or L2 => we use level route tables directly for
+	 * validating => no problems with deleting routes. */
+	if (area->is_type != IS_LEVEL_1_AND_2)
+		return true;
+
+	/* If area is L1L2, we work with merge table and therefore must
+	 * delete node from level tables as well before deleting route info.
+	 * FIXME: Is it performance problem? There has to be the better way.
+	 * Like not to deal with it here at all (see the next comment)? */
+	if (prefix->family == AF_INET) {
+		drnode = route_node_get(area->route_table[0], prefix);
+		if (drnode->info == rinfo)
+			drnode->info = NULL;
+		drnode = route_node_get(area->route_table[1], prefix);
+		if (drnode->info == rinfo)
+			drnode->info = NULL;
+	}
+
+	if (prefix->family == AF_INET6) {
+		drnode = route_node_get(area->route_table6[0], prefix);
+		if (drnode->info == rinfo)
+			drnode->info = NULL;
+		drnode = route_node_get(area->route_table6[1], prefix);
+		if (drnode->info == rinfo)
+			drnode->info = NULL;
+	}
+
+	return true;
+}
+
 /* Validating routes in particular table. */
 static void isis_route_validate_table(struct isis_area *area,
 				      struct route_table *table)
 {
-	struct route_node *rnode, *drnode;
-	struct isis_route_info *rinfo;
-	char buff[PREFIX2STR_BUFFER];
+	struct route_node *rnode;
 
 	for (rnode = route_top(table); rnode; rnode = route_next(rnode)) {
 		if (rnode->info == NULL)
 			continue;
-		rinfo = rnode->info;
-
-		if (isis->debugs & DEBUG_RTE_EVENTS) {
-			prefix2str(&rnode->p, buff, sizeof(buff));
-			zlog_debug(
-				"ISIS-Rte (%s): route validate: %s %s %s %s",
-				area->area_tag,
-				(CHECK_FLAG(rinfo->flag,
-					    ISIS_ROUTE_FLAG_ZEBRA_SYNCED)
-					 ? "synced"
-					 : "not-synced"),
-				(CHECK_FLAG(rinfo->flag,
-					    ISIS_ROUTE_FLAG_ZEBRA_RESYNC)
-					 ? "resync"
-					 : "not-resync"),
-				(CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE)
-					 ? "active"
-					 : "inactive"),
-				buff);
-		}
-
-		isis_zebra_route_update(&rnode->p, rinfo);
-		if (!CHECK_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE)) {
-			/* Area is either L1 or L2 => we use level route tables
-			 * directly for
-			 * validating => no problems with deleting routes. */
-			if (area->is_type != IS_LEVEL_1_AND_2) {
-				isis_route_delete(&rnode->p, table);
-				continue;
-			}
-			/* If area is L1L2, we work with merge table and
-			 * therefore must
-			 * delete node from level tables as well before deleting
-			 * route info.
-			 * FIXME: Is it performance problem? There has to be the
-			 * better way.
-			 * Like not to deal with it here at all (see the next
-			 * comment)? */
-			if (rnode->p.family == AF_INET) {
-				drnode = route_node_get(area->route_table[0],
-							&rnode->p);
-				if (drnode->info == rnode->info)
-					drnode->info = NULL;
-				drnode = route_node_get(area->route_table[1],
-							&rnode->p);
-				if (drnode->info == rnode->info)
-					drnode->info = NULL;
-			}
-
-			if (rnode->p.family == AF_INET6) {
-				drnode = route_node_get(area->route_table6[0],
-							&rnode->p);
-				if (drnode->info == rnode->info)
-					drnode->info = NULL;
-				drnode = route_node_get(area->route_table6[1],
-							&rnode->p);
-				if (drnode->info == rnode->info)
-					drnode->info = NULL;
-			}
 
+		if (isis_route_validate_info(area, &rnode->p, rnode->info))
 			isis_route_delete(&rnode->p, table);
-		}
 	}
 }
 
@@ -593,3 +602,56 @@ void isis_route_invalidate(struct isis_area *area)
 	if (area->is_type & IS_LEVEL_2)
 		isis_route_invalidate_table(area, area->route_table[1]);
 }
+
+/* Marks the route to a single prefix inactive, as a partial route
+ * calculation is about to recreate it. */
+void isis_route_invalidate_prefix(struct isis_area *area,
+				  struct route_table *table,
+				  struct prefix *prefix)
+{
+	struct route_node *rode;
+	struct isis_route_info *rinfo;
+
+	rode = route_node_lookup(table, prefix);
+	if (!rode)
+		return;
+
+	rinfo = rode->info;
+	UNSET_FLAG(rinfo->flag, ISIS_ROUTE_FLAG_ACTIVE);
+	route_unlock_node(rode);
+}
+
+/* isis_route_validate() restricted to a single prefix, L1 routes are still
+ * preferred over the L2 ones. */
+void isis_route_validate_prefix(struct isis_area *area, struct prefix *prefix)
+{
+	struct route_table **tables;
+	struct route_node *rode;
+	struct isis_route_info *rinfo;
+
+	if (prefix->family == AF_INET)
+		tables = area->route_table;
+	else if (prefix->family == AF_INET6)
+		tables = area->route_table6;
+	else
+		return;
+
+	for (int level = ISIS_LEVEL1; level <= ISIS_LEVELS; level++) {
+		if (!(area->is_type & level))
+			continue;
+
+		rode = route_node_lookup(tables[level - 1], prefix);
+		if (!rode)
+			continue;
+
+		rinfo = rode->info;
+		route_unlock_node(rode);
+		if (!isis_route_validate_info(area, prefix, rinfo))
+			return;
+
+		/* Gone, the other level may have a route to install */
+		if (rode->info == rinfo)
+			rode->info = NULL;
+		isis_route_remove(prefix, rinfo);
+	}
+}
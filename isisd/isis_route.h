@@ -59,5 +59,9 @@ void isis_route_validate(struct isis_area *area);
 void isis_route_invalidate_table(struct isis_area *area,
 				 struct route_table *table);
 void isis_route_invalidate(struct isis_area *area);
+void isis_route_invalidate_prefix(struct isis_area *area,
+				  struct route_table *table,
+				  struct prefix *prefix);
+void isis_route_validate_prefix(struct isis_area *area, struct prefix *prefix);
 
 #endif /* _ZEBRA_ISIS_ROUTE_H */
@@ -23,6 +23,7 @@
  */
 
 #include <zebra.h>
+#include <pthread.h>
 
 #include "thread.h"
 #include "linklist.h"
@@ -36,7 +37,7 @@
 #include "table.h"
 #include "spf_backoff.h"
 #include "jhash.h"
-#include "skiplist.h"
+#include "pqueue.h"
 
 #include "isis_constants.h"
 #include "isis_common.h"
@@ -56,6 +57,7 @@
 #include "isis_tlvs.h"
 
 DEFINE_MTYPE_STATIC(ISISD, ISIS_SPF_RUN, "ISIS SPF Run Info");
+DEFINE_MTYPE_STATIC(ISISD, ISIS_SPF_PRC, "ISIS SPF PRC Info");
 
 enum vertextype {
 	VTYPE_PSEUDO_IS = 1,
@@ -90,16 +92,28 @@ struct isis_vertex {
 	struct list *Adj_N;    /* {Adj(N)} next hop or neighbor list */
 	struct list *parents;  /* list of parents for ECMP */
 	uint64_t insert_counter;
+
+	struct isis_vertex_queue *queue; /* the one it is on, if any */
+	int heap_index;			 /* its place on an ordered one */
+	struct isis_vertex *next_spare;
 };
 
 /* Vertex Queue and associated functions */
 
+/*
+ * TENT is a binary heap, the SPT a list.  A tree's two queues share one
+ * index of their vertices, so a single lookup tells whether and where a
+ * vertex is queued, and the vertices a tree is done with are kept, lists
+ * and all, for its next run.
+ */
 struct isis_vertex_queue {
 	union {
-		struct skiplist *slist;
+		struct pqueue *heap;
 		struct list *list;
 	} l;
 	struct hash *hash;
+	bool own_hash;
+	struct isis_vertex **spare; /* where to keep vertices deleted */
 	uint64_t insert_counter;
 };
 
@@ -126,6 +140,12 @@ static int isis_vertex_queue_hash_cmp(const void *a, const void *b)
 	return memcmp(va->N.id, vb->N.id, ISIS_SYS_ID_LEN + 1) == 0;
 }
 
+static struct hash *isis_vertex_queue_hash(const char *name)
+{
+	return hash_create(isis_vertex_queue_hash_key,
+			   isis_vertex_queue_hash_cmp, name);
+}
+
 /*
  * Compares vertizes for sorting in the TENT list. Returns true
  * if candidate should be considered before current, false otherwise.
@@ -156,43 +176,58 @@ static int isis_vertex_queue_tent_cmp(void *a, void *b)
 	return 0;
 }
 
-static struct skiplist *isis_vertex_queue_skiplist(void)
+static void isis_vertex_queue_heap_update(void *node, int actual_position)
 {
-	return skiplist_new(0, isis_vertex_queue_tent_cmp, NULL);
+	struct isis_vertex *vertex = node;
+
+	vertex->heap_index = actual_position;
 }
 
+/*
+ * Without a hash, the queue has its own; without spare, deleted vertices
+ * are freed.
+ */
 static void isis_vertex_queue_init(struct isis_vertex_queue *queue,
-				   const char *name, bool ordered)
+				   struct hash *hash,
+				   struct isis_vertex **spare, bool ordered)
 {
 	if (ordered) {
 		queue->insert_counter = 1;
-		queue->l.slist = isis_vertex_queue_skiplist();
+		queue->l.heap = pqueue_create();
+		queue->l.heap->cmp = isis_vertex_queue_tent_cmp;
+		queue->l.heap->update = isis_vertex_queue_heap_update;
 	} else {
 		queue->insert_counter = 0;
 		queue->l.list = list_new();
 	}
-	queue->hash = hash_create(isis_vertex_queue_hash_key,
-				  isis_vertex_queue_hash_cmp, name);
+	queue->own_hash = !hash;
+	queue->hash = hash ? hash : isis_vertex_queue_hash("IS-IS vertices");
+	queue->spare = spare;
 }
 
-static void isis_vertex_del(struct isis_vertex *vertex);
+static void isis_vertex_del(struct isis_vertex **spare,
+			    struct isis_vertex *vertex);
 
 static void isis_vertex_queue_clear(struct isis_vertex_queue *queue)
 {
-	hash_clean(queue->hash, NULL);
+	struct isis_vertex *vertex;
 
 	if (queue->insert_counter) {
-		struct isis_vertex *vertex;
-		while (0 == skiplist_first(queue->l.slist, NULL,
-					   (void **)&vertex)) {
-			isis_vertex_del(vertex);
-			skiplist_delete_first(queue->l.slist);
+		for (int i = 0; i < queue->l.heap->size; i++) {
+			vertex = queue->l.heap->array[i];
+			hash_release(queue->hash, vertex);
+			isis_vertex_del(queue->spare, vertex);
 		}
+		queue->l.heap->size = 0;
 		queue->insert_counter = 1;
 	} else {
-		queue->l.list->del = (void (*)(void *))isis_vertex_del;
-		list_delete_all_node(queue->l.list);
-		queue->l.list->del = NULL;
+		while (listcount(queue->l.list)) {
+			vertex = listgetdata(listhead(queue->l.list));
+			list_delete_node(queue->l.list,
+					 listhead(queue->l.list));
+			hash_release(queue->hash, vertex);
+			isis_vertex_del(queue->spare, vertex);
+		}
 	}
 }
 
@@ -200,19 +235,23 @@ static void isis_vertex_queue_free(struct isis_vertex_queue *queue)
 {
 	isis_vertex_queue_clear(queue);
 
-	hash_free(queue->hash);
+	if (queue->own_hash)
+		hash_free(queue->hash);
 	queue->hash = NULL;
 
 	if (queue->insert_counter) {
-		skiplist_free(queue->l.slist);
-		queue->l.slist = NULL;
+		pqueue_delete(queue->l.heap);
+		queue->l.heap = NULL;
 	} else
 		list_delete_and_null(&queue->l.list);
 }
 
 static unsigned int isis_vertex_queue_count(struct isis_vertex_queue *queue)
 {
-	return hashcount(queue->hash);
+	if (queue->insert_counter)
+		return queue->l.heap->size;
+
+	return listcount(queue->l.list);
 }
 
 static void isis_vertex_queue_append(struct isis_vertex_queue *queue,
@@ -221,6 +260,7 @@ static void isis_vertex_queue_append(struct isis_vertex_queue *queue,
 	assert(!queue->insert_counter);
 
 	listnode_add(queue->l.list, vertex);
+	vertex->queue = queue;
 
 	struct isis_vertex *inserted;
 
@@ -235,7 +275,8 @@ static void isis_vertex_queue_insert(struct isis_vertex_queue *queue,
 	vertex->insert_counter = queue->insert_counter++;
 	assert(queue->insert_counter != (uint64_t)-1);
 
-	skiplist_insert(queue->l.slist, vertex, vertex);
+	pqueue_enqueue(vertex, queue->l.heap);
+	vertex->queue = queue;
 
 	struct isis_vertex *inserted;
 	inserted = hash_get(queue->hash, vertex, hash_alloc_intern);
@@ -249,11 +290,12 @@ isis_vertex_queue_pop(struct isis_vertex_queue *queue)
 
 	struct isis_vertex *rv;
 
-	if (skiplist_first(queue->l.slist, NULL, (void **)&rv))
+	if (!queue->l.heap->size)
 		return NULL;
 
-	skiplist_delete_first(queue->l.slist);
+	rv = pqueue_dequeue(queue->l.heap);
 	hash_release(queue->hash, rv);
+	rv->queue = NULL;
 
 	return rv;
 }
@@ -262,9 +304,24 @@ static void isis_vertex_queue_delete(struct isis_vertex_queue *queue,
 				     struct isis_vertex *vertex)
 {
 	assert(queue->insert_counter);
+	assert(vertex->queue == queue);
 
-	skiplist_delete(queue->l.slist, vertex, vertex);
+	pqueue_remove_at(vertex->heap_index, queue->l.heap);
 	hash_release(queue->hash, vertex);
+	vertex->queue = NULL;
+}
+
+/* Deletes a vertex of an unordered queue, by its node */
+static void isis_vertex_queue_delete_node(struct isis_vertex_queue *queue,
+					  struct listnode *node)
+{
+	struct isis_vertex *vertex = listgetdata(node);
+
+	assert(!queue->insert_counter);
+
+	list_delete_node(queue->l.list, node);
+	hash_release(queue->hash, vertex);
+	vertex->queue = NULL;
 }
 
 #define ALL_QUEUE_ELEMENTS_RO(queue, node, data)                               \
@@ -276,6 +333,8 @@ static void isis_vertex_queue_delete(struct isis_vertex_queue *queue,
 struct isis_spftree {
 	struct isis_vertex_queue paths; /* the SPT */
 	struct isis_vertex_queue tents; /* TENT */
+	struct hash *vertices;		 /* both of their vertices */
+	struct isis_vertex *spare_vertices; /* for the next run */
 	struct isis_area *area;    /* back pointer to area */
 	unsigned int runcount;     /* number of runs since uptime */
 	time_t last_run_timestamp; /* last run timestamp as wall time for display */
@@ -285,8 +344,51 @@ struct isis_spftree {
 	uint16_t mtid;
 	int family;
 	int level;
+
+	/* Partial route calculation */
+	bool full_pending;	   /* a full run is needed, not a PRC */
+	struct hash *prc_prefixes; /* prefixes whose reachability changed */
+	unsigned int prc_runcount; /* number of PRCs since uptime */
 };
 
+static int isis_spf_prc_prefix_cmp(const void *a, const void *b)
+{
+	return prefix_same(a, b);
+}
+
+static void isis_spf_prc_free(void *arg)
+{
+	XFREE(MTYPE_ISIS_SPF_PRC, arg);
+}
+
+/* Adds a prefix, masked, to those the next PRC recalculates. */
+static void isis_spf_prc_add(struct isis_spftree *spftree,
+			     struct prefix *prefix)
+{
+	struct prefix *p;
+
+	if (hash_lookup(spftree->prc_prefixes, prefix))
+		return;
+
+	p = XMALLOC(MTYPE_ISIS_SPF_PRC, sizeof(*p));
+	prefix_copy(p, prefix);
+	hash_get(spftree->prc_prefixes, p, hash_alloc_intern);
+}
+
+static bool isis_spf_prc_has(struct hash *prefixes, struct prefix *prefix)
+{
+	struct prefix p;
+
+	prefix_copy(&p, prefix);
+	apply_mask(&p);
+	return hash_lookup(prefixes, &p) != NULL;
+}
+
+static void isis_spf_prc_clear(struct isis_spftree *spftree)
+{
+	hash_clean(spftree->prc_prefixes, isis_spf_prc_free);
+}
+
 
 /*
  *  supports the given af ?
@@ -422,22 +524,44 @@ static void isis_vertex_id_init(struct isis_vertex *vertex, void *id,
 	}
 }
 
-static struct isis_vertex *isis_vertex_new(void *id, enum vertextype vtype)
+static struct isis_vertex *isis_vertex_new(struct isis_vertex **spare,
+					   void *id, enum vertextype vtype)
 {
 	struct isis_vertex *vertex;
+	struct list *Adj_N, *parents;
 
-	vertex = XCALLOC(MTYPE_ISIS_VERTEX, sizeof(struct isis_vertex));
+	if (spare && *spare) {
+		vertex = *spare;
+		*spare = vertex->next_spare;
 
-	isis_vertex_id_init(vertex, id, vtype);
+		Adj_N = vertex->Adj_N;
+		parents = vertex->parents;
+		memset(vertex, 0, sizeof(struct isis_vertex));
+		vertex->Adj_N = Adj_N;
+		vertex->parents = parents;
+	} else {
+		vertex = XCALLOC(MTYPE_ISIS_VERTEX,
+				 sizeof(struct isis_vertex));
+		vertex->Adj_N = list_new();
+		vertex->parents = list_new();
+	}
 
-	vertex->Adj_N = list_new();
-	vertex->parents = list_new();
+	isis_vertex_id_init(vertex, id, vtype);
 
 	return vertex;
 }
 
-static void isis_vertex_del(struct isis_vertex *vertex)
+static void isis_vertex_del(struct isis_vertex **spare,
+			    struct isis_vertex *vertex)
 {
+	if (spare) {
+		list_delete_all_node(vertex->Adj_N);
+		list_delete_all_node(vertex->parents);
+		vertex->next_spare = *spare;
+		*spare = vertex;
+		return;
+	}
+
 	list_delete_and_null(&vertex->Adj_N);
 	list_delete_and_null(&vertex->parents);
 
@@ -471,20 +595,36 @@ struct isis_spftree *isis_spftree_new(struct isis_area *area)
 		return NULL;
 	}
 
-	isis_vertex_queue_init(&tree->tents, "IS-IS SPF tents", true);
-	isis_vertex_queue_init(&tree->paths, "IS-IS SPF paths", false);
+	tree->vertices = isis_vertex_queue_hash("IS-IS SPF vertices");
+	isis_vertex_queue_init(&tree->tents, tree->vertices,
+			       &tree->spare_vertices, true);
+	isis_vertex_queue_init(&tree->paths, tree->vertices,
+			       &tree->spare_vertices, false);
 	tree->area = area;
 	tree->last_run_timestamp = 0;
 	tree->last_run_monotime = 0;
 	tree->last_run_duration = 0;
 	tree->runcount = 0;
+	tree->full_pending = true;
+	tree->prc_prefixes = hash_create(prefix_hash_key,
+					 isis_spf_prc_prefix_cmp,
+					 "IS-IS PRC prefixes");
 	return tree;
 }
 
 void isis_spftree_del(struct isis_spftree *spftree)
 {
+	struct isis_vertex *vertex;
+
 	isis_vertex_queue_free(&spftree->tents);
 	isis_vertex_queue_free(&spftree->paths);
+	hash_free(spftree->vertices);
+	while ((vertex = spftree->spare_vertices)) {
+		spftree->spare_vertices = vertex->next_spare;
+		isis_vertex_del(NULL, vertex);
+	}
+	isis_spf_prc_clear(spftree);
+	hash_free(spftree->prc_prefixes);
 	XFREE(MTYPE_ISIS_SPFTREE, spftree);
 
 	return;
@@ -608,7 +748,7 @@ static struct isis_vertex *isis_spf_add_root(struct isis_spftree *spftree,
 		zlog_warn("ISIS-Spf: could not find own l%d LSP!",
 			  spftree->level);
 
-	vertex = isis_vertex_new(id,
+	vertex = isis_vertex_new(&spftree->spare_vertices, id,
 				 spftree->area->oldmetric
 					 ? VTYPE_NONPSEUDO_IS
 					 : VTYPE_NONPSEUDO_TE_IS);
@@ -624,13 +764,23 @@ static struct isis_vertex *isis_spf_add_root(struct isis_spftree *spftree,
 	return vertex;
 }
 
-static struct isis_vertex *isis_find_vertex(struct isis_vertex_queue *queue,
-					    void *id, enum vertextype vtype)
+/* Finds a vertex on whichever of the queues sharing the hash it is on */
+static struct isis_vertex *isis_lookup_vertex(struct hash *hash, void *id,
+					      enum vertextype vtype)
 {
 	struct isis_vertex querier;
 
 	isis_vertex_id_init(&querier, id, vtype);
-	return hash_lookup(queue->hash, &querier);
+	return hash_lookup(hash, &querier);
+}
+
+static struct isis_vertex *isis_find_vertex(struct isis_vertex_queue *queue,
+					    void *id, enum vertextype vtype)
+{
+	struct isis_vertex *vertex;
+
+	vertex = isis_lookup_vertex(queue->hash, id, vtype);
+	return (vertex && vertex->queue == queue) ? vertex : NULL;
 }
 
 /*
@@ -649,9 +799,8 @@ static struct isis_vertex *isis_spf_add2tent(struct isis_spftree *spftree,
 	char buff[PREFIX2STR_BUFFER];
 #endif
 
-	assert(isis_find_vertex(&spftree->paths, id, vtype) == NULL);
-	assert(isis_find_vertex(&spftree->tents, id, vtype) == NULL);
-	vertex = isis_vertex_new(id, vtype);
+	assert(isis_lookup_vertex(spftree->vertices, id, vtype) == NULL);
+	vertex = isis_vertex_new(&spftree->spare_vertices, id, vtype);
 	vertex->d_N = cost;
 	vertex->depth = depth;
 
@@ -705,7 +854,7 @@ static void isis_spf_add_local(struct isis_spftree *spftree,
 		} else { /* vertex->d_N > cost */
 			/*         f) */
 			isis_vertex_queue_delete(&spftree->tents, vertex);
-			isis_vertex_del(vertex);
+			isis_vertex_del(&spftree->spare_vertices, vertex);
 		}
 	}
 
@@ -743,8 +892,8 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype,
 	}
 
 	/*       c)    */
-	vertex = isis_find_vertex(&spftree->paths, id, vtype);
-	if (vertex) {
+	vertex = isis_lookup_vertex(spftree->vertices, id, vtype);
+	if (vertex && vertex->queue == &spftree->paths) {
 #ifdef EXTREME_DEBUG
 		zlog_debug(
 			"ISIS-Spf: process_N %s %s %s dist %d already found from PATH",
@@ -755,7 +904,6 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype,
 		return;
 	}
 
-	vertex = isis_find_vertex(&spftree->tents, id, vtype);
 	/*       d)    */
 	if (vertex) {
 /*        1) */
@@ -786,7 +934,7 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype,
 			/*      4) */
 		} else {
 			isis_vertex_queue_delete(&spftree->tents, vertex);
-			isis_vertex_del(vertex);
+			isis_vertex_del(&spftree->spare_vertices, vertex);
 		}
 	}
 
@@ -800,20 +948,126 @@ static void process_N(struct isis_spftree *spftree, enum vertextype vtype,
 	return;
 }
 
+typedef void (*isis_spf_reach_func)(struct isis_spftree *spftree,
+				    enum vertextype vtype,
+				    struct prefix *prefix, uint32_t metric,
+				    void *arg);
+
+/*
+ * Calls func on each IP reachability of a non-pseudonode LSP fragment that
+ * the tree takes into account.
+ */
+static void isis_spf_walk_reachs(struct isis_spftree *spftree,
+				 struct isis_tlvs *tlvs,
+				 isis_spf_reach_func func, void *arg)
+{
+	enum vertextype vtype;
+
+	if (spftree->family == AF_INET
+	    && spftree->mtid == ISIS_MT_IPV4_UNICAST) {
+		struct isis_item_list *reachs[] = {
+			&tlvs->oldstyle_ip_reach,
+			&tlvs->oldstyle_ip_reach_ext};
+
+		for (unsigned int i = 0; i < array_size(reachs); i++) {
+			vtype = i ? VTYPE_IPREACH_EXTERNAL
+				  : VTYPE_IPREACH_INTERNAL;
+
+			struct isis_oldstyle_ip_reach *r;
+			for (r = (struct isis_oldstyle_ip_reach *)reachs[i]
+					 ->head;
+			     r; r = r->next)
+				func(spftree, vtype, (struct prefix *)&r->prefix,
+				     r->metric, arg);
+		}
+	}
+
+	if (spftree->family == AF_INET) {
+		struct isis_item_list *ipv4_reachs;
+		if (spftree->mtid == ISIS_MT_IPV4_UNICAST)
+			ipv4_reachs = &tlvs->extended_ip_reach;
+		else
+			ipv4_reachs = isis_lookup_mt_items(&tlvs->mt_ip_reach,
+							   spftree->mtid);
+
+		struct isis_extended_ip_reach *r;
+		for (r = ipv4_reachs
+				 ? (struct isis_extended_ip_reach *)
+					   ipv4_reachs->head
+				 : NULL;
+		     r; r = r->next)
+			func(spftree, VTYPE_IPREACH_TE,
+			     (struct prefix *)&r->prefix, r->metric, arg);
+	}
+
+	if (spftree->family == AF_INET6) {
+		struct isis_item_list *ipv6_reachs;
+		if (spftree->mtid == ISIS_MT_IPV4_UNICAST)
+			ipv6_reachs = &tlvs->ipv6_reach;
+		else
+			ipv6_reachs = isis_lookup_mt_items(
+				&tlvs->mt_ipv6_reach, spftree->mtid);
+
+		struct isis_ipv6_reach *r;
+		for (r = ipv6_reachs
+				 ? (struct isis_ipv6_reach *)ipv6_reachs->head
+				 : NULL;
+		     r; r = r->next) {
+			vtype = r->external ? VTYPE_IP6REACH_EXTERNAL
+					    : VTYPE_IP6REACH_INTERNAL;
+			func(spftree, vtype, (struct prefix *)&r->prefix,
+			     r->metric, arg);
+		}
+	}
+}
+
+/* The vertex an LSP's reachabilities are found from */
+struct isis_spf_reach_from {
+	uint32_t cost;
+	uint16_t depth;
+	struct isis_vertex *parent;
+
+	/* Set for a PRC, the only prefixes looked at */
+	struct hash *prefixes;
+};
+
+static void isis_spf_process_reach(struct isis_spftree *spftree,
+				   enum vertextype vtype,
+				   struct prefix *prefix, uint32_t metric,
+				   void *arg)
+{
+	struct isis_spf_reach_from *from = arg;
+
+	if (from->prefixes && !isis_spf_prc_has(from->prefixes, prefix))
+		return;
+
+	process_N(spftree, vtype, prefix, from->cost + metric,
+		  from->depth + 1, from->parent);
+}
+
 /*
  * C.2.6 Step 1
+ *
+ * With prefixes set, for a PRC, only the reachabilities to those are
+ * processed.
  */
 static int isis_spf_process_lsp(struct isis_spftree *spftree,
 				struct isis_lsp *lsp, uint32_t cost,
 				uint16_t depth, uint8_t *root_sysid,
-				struct isis_vertex *parent)
+				struct isis_vertex *parent,
+				struct hash *prefixes)
 {
 	bool pseudo_lsp = LSP_PSEUDO_ID(lsp->hdr.lsp_id);
 	struct listnode *fragnode = NULL;
 	uint32_t dist;
-	enum vertextype vtype;
 	static const uint8_t null_sysid[ISIS_SYS_ID_LEN];
 	struct isis_mt_router_info *mt_router_info = NULL;
+	struct isis_spf_reach_from from = {
+		.cost = cost,
+		.depth = depth,
+		.parent = parent,
+		.prefixes = prefixes,
+	};
 
 	if (!lsp->tlvs)
 		return ISIS_OK;
@@ -847,7 +1101,7 @@ lspfragloop:
 		   print_sys_hostname(lsp->hdr.lsp_id));
 #endif /* EXTREME_DEBUG */
 
-	if (no_overload) {
+	if (no_overload && !prefixes) {
 		if (pseudo_lsp || spftree->mtid == ISIS_MT_IPV4_UNICAST) {
 			struct isis_oldstyle_reach *r;
 			for (r = (struct isis_oldstyle_reach *)
@@ -897,67 +1151,9 @@ lspfragloop:
 		}
 	}
 
-	if (!pseudo_lsp && spftree->family == AF_INET
-	    && spftree->mtid == ISIS_MT_IPV4_UNICAST) {
-		struct isis_item_list *reachs[] = {
-			&lsp->tlvs->oldstyle_ip_reach,
-			&lsp->tlvs->oldstyle_ip_reach_ext};
-
-		for (unsigned int i = 0; i < array_size(reachs); i++) {
-			vtype = i ? VTYPE_IPREACH_EXTERNAL
-				  : VTYPE_IPREACH_INTERNAL;
-
-			struct isis_oldstyle_ip_reach *r;
-			for (r = (struct isis_oldstyle_ip_reach *)reachs[i]
-					 ->head;
-			     r; r = r->next) {
-				dist = cost + r->metric;
-				process_N(spftree, vtype, (void *)&r->prefix,
-					  dist, depth + 1, parent);
-			}
-		}
-	}
-
-	if (!pseudo_lsp && spftree->family == AF_INET) {
-		struct isis_item_list *ipv4_reachs;
-		if (spftree->mtid == ISIS_MT_IPV4_UNICAST)
-			ipv4_reachs = &lsp->tlvs->extended_ip_reach;
-		else
-			ipv4_reachs = isis_lookup_mt_items(
-				&lsp->tlvs->mt_ip_reach, spftree->mtid);
-
-		struct isis_extended_ip_reach *r;
-		for (r = ipv4_reachs
-				 ? (struct isis_extended_ip_reach *)
-					   ipv4_reachs->head
-				 : NULL;
-		     r; r = r->next) {
-			dist = cost + r->metric;
-			process_N(spftree, VTYPE_IPREACH_TE, (void *)&r->prefix,
-				  dist, depth + 1, parent);
-		}
-	}
-
-	if (!pseudo_lsp && spftree->family == AF_INET6) {
-		struct isis_item_list *ipv6_reachs;
-		if (spftree->mtid == ISIS_MT_IPV4_UNICAST)
-			ipv6_reachs = &lsp->tlvs->ipv6_reach;
-		else
-			ipv6_reachs = isis_lookup_mt_items(
-				&lsp->tlvs->mt_ipv6_reach, spftree->mtid);
-
-		struct isis_ipv6_reach *r;
-		for (r = ipv6_reachs
-				 ? (struct isis_ipv6_reach *)ipv6_reachs->head
-				 : NULL;
-		     r; r = r->next) {
-			dist = cost + r->metric;
-			vtype = r->external ? VTYPE_IP6REACH_EXTERNAL
-					    : VTYPE_IP6REACH_INTERNAL;
-			process_N(spftree, vtype, (void *)&r->prefix, dist,
-				  depth + 1, parent);
-		}
-	}
+	if (!pseudo_lsp)
+		isis_spf_walk_reachs(spftree, lsp->tlvs, isis_spf_process_reach,
+				     &from);
 
 	if (fragnode == NULL)
 		fragnode = listhead(lsp->lspu.frags);
@@ -1150,7 +1346,7 @@ static int isis_spf_preload_tent(struct isis_spftree *spftree,
 			isis_spf_process_lsp(
 				spftree, lsp,
 				circuit->te_metric[spftree->level - 1], 0,
-				root_sysid, parent);
+				root_sysid, parent, NULL);
 		} else if (circuit->circ_type == CIRCUIT_T_P2P) {
 			adj = circuit->u.p2p.neighbor;
 			if (!adj || adj->adj_state != ISIS_ADJ_UP)
@@ -1210,7 +1406,9 @@ static int isis_spf_preload_tent(struct isis_spftree *spftree,
 static void add_to_paths(struct isis_spftree *spftree,
 			 struct isis_vertex *vertex)
 {
+#ifdef EXTREME_DEBUG
 	char buff[PREFIX2STR_BUFFER];
+#endif /* EXTREME_DEBUG */
 
 	if (isis_find_vertex(&spftree->paths, vertex->N.id, vertex->type))
 		return;
@@ -1223,23 +1421,30 @@ static void add_to_paths(struct isis_spftree *spftree,
 		   vertex->d_N);
 #endif /* EXTREME_DEBUG */
 
-	if (VTYPE_IP(vertex->type)) {
-		if (listcount(vertex->Adj_N) > 0)
-			isis_route_create((struct prefix *)&vertex->N.prefix,
-					  vertex->d_N, vertex->depth,
-					  vertex->Adj_N, spftree->area,
-					  spftree->level);
-		else if (isis->debugs & DEBUG_SPF_EVENTS)
-			zlog_debug(
-				"ISIS-Spf: no adjacencies do not install route for "
-				"%s depth %d dist %d",
-				vid2string(vertex, buff, sizeof(buff)),
-				vertex->depth, vertex->d_N);
-	}
-
 	return;
 }
 
+/* Creates the route to a prefix on the SPT, on the main thread */
+static void isis_spf_route_create(struct isis_spftree *spftree,
+				  struct isis_vertex *vertex)
+{
+	char buff[PREFIX2STR_BUFFER];
+
+	if (!VTYPE_IP(vertex->type))
+		return;
+
+	if (listcount(vertex->Adj_N) > 0)
+		isis_route_create((struct prefix *)&vertex->N.prefix,
+				  vertex->d_N, vertex->depth, vertex->Adj_N,
+				  spftree->area, spftree->level);
+	else if (isis->debugs & DEBUG_SPF_EVENTS)
+		zlog_debug(
+			"ISIS-Spf: no adjacencies do not install route for "
+			"%s depth %d dist %d",
+			vid2string(vertex, buff, sizeof(buff)), vertex->depth,
+			vertex->d_N);
+}
+
 static void init_spt(struct isis_spftree *spftree, int mtid, int level,
 		     int family)
 {
@@ -1252,38 +1457,18 @@ static void init_spt(struct isis_spftree *spftree, int mtid, int level,
 	return;
 }
 
-static int isis_run_spf(struct isis_area *area, int level, int family,
-			uint8_t *sysid, struct timeval *nowtv)
+/* Readies a tree for a full run, on the main thread */
+static struct isis_spftree *isis_spf_prepare(struct isis_area *area,
+					     int level, int family)
 {
-	int retval = ISIS_OK;
-	struct isis_vertex *vertex;
-	struct isis_vertex *root_vertex;
 	struct isis_spftree *spftree = NULL;
-	uint8_t lsp_id[ISIS_SYS_ID_LEN + 2];
-	struct isis_lsp *lsp;
-	struct route_table *table = NULL;
-	struct timeval time_now;
-	unsigned long long start_time, end_time;
 	uint16_t mtid;
 
-	/* Get time that can't roll backwards. */
-	start_time = nowtv->tv_sec;
-	start_time = (start_time * 1000000) + nowtv->tv_usec;
-
 	if (family == AF_INET)
 		spftree = area->spftree[level - 1];
 	else if (family == AF_INET6)
 		spftree = area->spftree6[level - 1];
 	assert(spftree);
-	assert(sysid);
-
-	/* Make all routes in current route table inactive. */
-	if (family == AF_INET)
-		table = area->route_table[level - 1];
-	else if (family == AF_INET6)
-		table = area->route_table6[level - 1];
-
-	isis_route_invalidate_table(area, table);
 
 	/* We only support ipv4-unicast and ipv6-unicast as topologies for now
 	 */
@@ -1292,10 +1477,35 @@ static int isis_run_spf(struct isis_area *area, int level, int family,
 	else
 		mtid = ISIS_MT_IPV4_UNICAST;
 
+	/* Everything is recalculated, PRCs pending included */
+	spftree->full_pending = false;
+	isis_spf_prc_clear(spftree);
+
+	init_spt(spftree, mtid, level, family);
+
+	return spftree;
+}
+
+/*
+ * Computes the SPT.  This only reads the area's LSPs, circuits and
+ * adjacencies and writes to the tree, so it may run off the main thread
+ * as long as the main thread waits for it.
+ */
+static int isis_spf_compute(struct isis_spftree *spftree, uint8_t *sysid)
+{
+	struct isis_area *area = spftree->area;
+	int level = spftree->level;
+	int retval = ISIS_OK;
+	struct isis_vertex *vertex;
+	struct isis_vertex *root_vertex;
+	uint8_t lsp_id[ISIS_SYS_ID_LEN + 2];
+	struct isis_lsp *lsp;
+
+	assert(sysid);
+
 	/*
 	 * C.2.5 Step 0
 	 */
-	init_spt(spftree, mtid, level, family);
 	/*              a) */
 	root_vertex = isis_spf_add_root(spftree, sysid);
 	/*              b) */
@@ -1303,7 +1513,7 @@ static int isis_run_spf(struct isis_area *area, int level, int family,
 	if (retval != ISIS_OK) {
 		zlog_warn("ISIS-Spf: failed to load TENT SPF-root:%s",
 			  print_sys_hostname(sysid));
-		goto out;
+		return retval;
 	}
 
 	/*
@@ -1333,7 +1543,7 @@ static int isis_run_spf(struct isis_area *area, int level, int family,
 			if (lsp && lsp->hdr.rem_lifetime != 0) {
 				isis_spf_process_lsp(spftree, lsp, vertex->d_N,
 						     vertex->depth, sysid,
-						     vertex);
+						     vertex, NULL);
 			} else {
 				zlog_warn("ISIS-Spf: No LSP found for %s",
 					  rawlspid_print(lsp_id));
@@ -1341,7 +1551,35 @@ static int isis_run_spf(struct isis_area *area, int level, int family,
 		}
 	}
 
-out:
+	return retval;
+}
+
+/* Installs the routes a full run found, on the main thread */
+static void isis_spf_finish(struct isis_spftree *spftree,
+			    struct timeval *nowtv)
+{
+	struct isis_area *area = spftree->area;
+	struct route_table *table = NULL;
+	struct isis_vertex *vertex;
+	struct listnode *node;
+	struct timeval time_now;
+	unsigned long long start_time, end_time;
+
+	/* Get time that can't roll backwards. */
+	start_time = nowtv->tv_sec;
+	start_time = (start_time * 1000000) + nowtv->tv_usec;
+
+	/* Make all routes in current route table inactive. */
+	if (spftree->family == AF_INET)
+		table = area->route_table[spftree->level - 1];
+	else if (spftree->family == AF_INET6)
+		table = area->route_table6[spftree->level - 1];
+
+	isis_route_invalidate_table(area, table);
+
+	for (ALL_QUEUE_ELEMENTS_RO(&spftree->paths, node, vertex))
+		isis_spf_route_create(spftree, vertex);
+
 	isis_route_validate(area);
 	spftree->runcount++;
 	spftree->last_run_timestamp = time(NULL);
@@ -1349,16 +1587,270 @@ out:
 	end_time = time_now.tv_sec;
 	end_time = (end_time * 1000000) + time_now.tv_usec;
 	spftree->last_run_duration = end_time - start_time;
+}
+
+/* A tree computed on a worker pthread */
+struct isis_spf_job {
+	struct isis_spftree *spftree;
+	uint8_t *sysid;
+	int retval;
+
+	pthread_t thread;
+	bool started;
+};
+
+static void *isis_spf_job_run(void *arg)
+{
+	struct isis_spf_job *job = arg;
+
+	job->retval = isis_spf_compute(job->spftree, job->sysid);
+	return NULL;
+}
+
+/*
+ * Full runs of the level's IPv4 and IPv6 trees.  These are independent,
+ * so all but the last are computed on worker pthreads while the main
+ * thread computes that one.  The main thread then waits for the workers,
+ * so nothing changes the LSPDB under them, and installs the routes of
+ * each tree in turn.
+ */
+static int isis_run_spf(struct isis_area *area, int level, int *families,
+			int count, uint8_t *sysid, struct timeval *nowtv)
+{
+	struct isis_spf_job jobs[2];
+	int retval = ISIS_OK;
+	int i;
+
+	assert(count > 0 && count <= (int)array_size(jobs));
+
+	for (i = 0; i < count; i++) {
+		jobs[i].spftree = isis_spf_prepare(area, level, families[i]);
+		jobs[i].sysid = sysid;
+		jobs[i].retval = ISIS_OK;
+		jobs[i].started = false;
+	}
+
+	for (i = 0; i < count - 1; i++)
+		jobs[i].started = !pthread_create(&jobs[i].thread, NULL,
+						  isis_spf_job_run, &jobs[i]);
+
+	/* Without a worker for it, a tree is computed here */
+	for (i = 0; i < count; i++)
+		if (!jobs[i].started)
+			isis_spf_job_run(&jobs[i]);
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+
+		isis_spf_finish(jobs[i].spftree, nowtv);
+		if (jobs[i].retval != ISIS_OK)
+			retval = jobs[i].retval;
+	}
 
 	return retval;
 }
 
+/* An IP reachability, as two instances of an LSP are compared on */
+struct isis_spf_reach {
+	enum vertextype vtype;
+	uint32_t metric;
+	struct prefix prefix;
+};
+
+static unsigned int isis_spf_reach_hash_key(void *arg)
+{
+	struct isis_spf_reach *reach = arg;
+
+	return jhash_2words(prefix_hash_key(&reach->prefix), reach->vtype,
+			    reach->metric);
+}
+
+static int isis_spf_reach_hash_cmp(const void *a, const void *b)
+{
+	const struct isis_spf_reach *ra = a, *rb = b;
+
+	return ra->vtype == rb->vtype && ra->metric == rb->metric
+	       && prefix_same(&ra->prefix, &rb->prefix);
+}
+
+static void isis_spf_reach_init(struct isis_spf_reach *reach,
+				enum vertextype vtype, struct prefix *prefix,
+				uint32_t metric)
+{
+	memset(reach, 0, sizeof(*reach));
+	reach->vtype = vtype;
+	reach->metric = metric;
+	prefix_copy(&reach->prefix, prefix);
+	apply_mask(&reach->prefix);
+}
+
+static void isis_spf_reach_old(struct isis_spftree *spftree,
+			       enum vertextype vtype, struct prefix *prefix,
+			       uint32_t metric, void *arg)
+{
+	struct hash *reachs = arg;
+	struct isis_spf_reach key, *reach;
+
+	isis_spf_reach_init(&key, vtype, prefix, metric);
+	if (hash_lookup(reachs, &key))
+		return;
+
+	reach = XMALLOC(MTYPE_ISIS_SPF_PRC, sizeof(*reach));
+	*reach = key;
+	hash_get(reachs, reach, hash_alloc_intern);
+}
+
+static void isis_spf_reach_new(struct isis_spftree *spftree,
+			       enum vertextype vtype, struct prefix *prefix,
+			       uint32_t metric, void *arg)
+{
+	struct hash *reachs = arg;
+	struct isis_spf_reach key, *reach;
+
+	isis_spf_reach_init(&key, vtype, prefix, metric);
+	reach = hash_release(reachs, &key);
+	if (reach)
+		XFREE(MTYPE_ISIS_SPF_PRC, reach);
+	else
+		isis_spf_prc_add(spftree, &key.prefix);
+}
+
+static void isis_spf_reach_gone(struct hash_backet *backet, void *arg)
+{
+	struct isis_spf_reach *reach = backet->data;
+
+	isis_spf_prc_add(arg, &reach->prefix);
+}
+
+/*
+ * Records for the next PRC the prefixes an LSP reaches in one of its
+ * instances, but not with the same metric in the other.
+ */
+static void isis_spf_prc_add_changes(struct isis_spftree *spftree,
+				     struct isis_tlvs *old_tlvs,
+				     struct isis_tlvs *new_tlvs)
+{
+	struct hash *reachs;
+
+	if (spftree->full_pending)
+		return;
+
+	reachs = hash_create(isis_spf_reach_hash_key, isis_spf_reach_hash_cmp,
+			     "IS-IS PRC reachabilities");
+
+	isis_spf_walk_reachs(spftree, old_tlvs, isis_spf_reach_old, reachs);
+	isis_spf_walk_reachs(spftree, new_tlvs, isis_spf_reach_new, reachs);
+	hash_iterate(reachs, isis_spf_reach_gone, spftree);
+
+	hash_clean(reachs, isis_spf_prc_free);
+	hash_free(reachs);
+}
+
+static struct route_table *isis_spf_route_table(struct isis_spftree *spftree)
+{
+	if (spftree->family == AF_INET6)
+		return spftree->area->route_table6[spftree->level - 1];
+
+	return spftree->area->route_table[spftree->level - 1];
+}
+
+static void isis_spf_prc_invalidate(struct hash_backet *backet, void *arg)
+{
+	struct isis_spftree *spftree = arg;
+
+	isis_route_invalidate_prefix(spftree->area,
+				     isis_spf_route_table(spftree),
+				     backet->data);
+}
+
+static void isis_spf_prc_validate(struct hash_backet *backet, void *arg)
+{
+	struct isis_spftree *spftree = arg;
+
+	isis_route_validate_prefix(spftree->area, backet->data);
+}
+
+/*
+ * Partial route calculation.  The topology is the one the last full run
+ * found, so the vertices of the prefixes whose reachability changed are
+ * taken off the tree and found again from the LSPs of the systems on it,
+ * which are processed in the order the full run popped them.  Only the
+ * routes to those prefixes are recreated.
+ */
+static int isis_run_prc(struct isis_area *area, int level, int family,
+			uint8_t *sysid)
+{
+	struct isis_spftree *spftree;
+	struct isis_vertex *vertex, *root;
+	struct listnode *node, *nnode;
+	uint8_t lsp_id[ISIS_SYS_ID_LEN + 2];
+	struct isis_lsp *lsp;
+
+	if (family == AF_INET)
+		spftree = area->spftree[level - 1];
+	else
+		spftree = area->spftree6[level - 1];
+	assert(spftree);
+
+	/* Refreshed LSPs, nothing changed */
+	if (!hashcount(spftree->prc_prefixes))
+		return ISIS_OK;
+
+	if (isis->debugs & DEBUG_SPF_EVENTS)
+		zlog_debug("ISIS-Spf (%s) L%d PRC for %lu %s prefixes",
+			   area->area_tag, level,
+			   hashcount(spftree->prc_prefixes),
+			   family == AF_INET ? "IPv4" : "IPv6");
+
+	root = listnode_head(spftree->paths.l.list);
+	for (ALL_LIST_ELEMENTS(spftree->paths.l.list, node, nnode, vertex)) {
+		if (!VTYPE_IP(vertex->type)
+		    || !hash_lookup(spftree->prc_prefixes, &vertex->N.prefix))
+			continue;
+		/* Our own, no LSP can do better */
+		if (listnode_lookup(vertex->parents, root))
+			continue;
+
+		isis_vertex_queue_delete_node(&spftree->paths, node);
+		isis_vertex_del(&spftree->spare_vertices, vertex);
+	}
+
+	hash_iterate(spftree->prc_prefixes, isis_spf_prc_invalidate, spftree);
+
+	for (ALL_QUEUE_ELEMENTS_RO(&spftree->paths, node, vertex)) {
+		if (!VTYPE_IS(vertex->type) || vertex == root)
+			continue;
+
+		memcpy(lsp_id, vertex->N.id, ISIS_SYS_ID_LEN + 1);
+		LSP_FRAGMENT(lsp_id) = 0;
+		lsp = lsp_search(lsp_id, area->lspdb[level - 1]);
+		if (lsp && lsp->hdr.rem_lifetime != 0)
+			isis_spf_process_lsp(spftree, lsp, vertex->d_N,
+					     vertex->depth, sysid, vertex,
+					     spftree->prc_prefixes);
+	}
+
+	while ((vertex = isis_vertex_queue_pop(&spftree->tents))) {
+		add_to_paths(spftree, vertex);
+		if (vertex->queue == &spftree->paths)
+			isis_spf_route_create(spftree, vertex);
+	}
+
+	hash_iterate(spftree->prc_prefixes, isis_spf_prc_validate, spftree);
+	isis_spf_prc_clear(spftree);
+	spftree->prc_runcount++;
+
+	return ISIS_OK;
+}
+
 static int isis_run_spf_cb(struct thread *thread)
 {
 	struct isis_spf_run *run = THREAD_ARG(thread);
 	struct isis_area *area = run->area;
 	int level = run->level;
 	int retval = ISIS_OK;
+	int families[2], count = 0;
 
 	XFREE(MTYPE_ISIS_SPF_RUN, run);
 	area->spf_timer[level - 1] = NULL;
@@ -1374,12 +1866,23 @@ static int isis_run_spf_cb(struct thread *thread)
 		zlog_debug("ISIS-Spf (%s) L%d SPF needed, periodic SPF",
 			   area->area_tag, level);
 
-	if (area->ip_circuits)
-		retval = isis_run_spf(area, level, AF_INET, isis->sysid,
-				      &thread->real);
-	if (area->ipv6_circuits)
-		retval = isis_run_spf(area, level, AF_INET6, isis->sysid,
-				      &thread->real);
+	if (area->ip_circuits) {
+		if (area->spftree[level - 1]->full_pending)
+			families[count++] = AF_INET;
+		else
+			retval = isis_run_prc(area, level, AF_INET,
+					      isis->sysid);
+	}
+	if (area->ipv6_circuits) {
+		if (area->spftree6[level - 1]->full_pending)
+			families[count++] = AF_INET6;
+		else
+			retval = isis_run_prc(area, level, AF_INET6,
+					      isis->sysid);
+	}
+	if (count)
+		retval = isis_run_spf(area, level, families, count,
+				      isis->sysid, &thread->real);
 
 	return retval;
 }
@@ -1394,7 +1897,7 @@ static struct isis_spf_run *isis_run_spf_arg(struct isis_area *area, int level)
 	return run;
 }
 
-int isis_spf_schedule(struct isis_area *area, int level)
+static int isis_spf_schedule_run(struct isis_area *area, int level)
 {
 	struct isis_spftree *spftree = area->spftree[level - 1];
 	time_t now = monotime(NULL);
@@ -1446,6 +1949,30 @@ int isis_spf_schedule(struct isis_area *area, int level)
 	return ISIS_OK;
 }
 
+int isis_spf_schedule(struct isis_area *area, int level)
+{
+	area->spftree[level - 1]->full_pending = true;
+	area->spftree6[level - 1]->full_pending = true;
+
+	return isis_spf_schedule_run(area, level);
+}
+
+/*
+ * An LSP changed in the prefixes it reaches only, a PRC updates the
+ * routes to those unless a full run is due anyway.
+ */
+int isis_spf_schedule_prc(struct isis_area *area, int level,
+			  struct isis_tlvs *old_tlvs,
+			  struct isis_tlvs *new_tlvs)
+{
+	isis_spf_prc_add_changes(area->spftree[level - 1], old_tlvs,
+				 new_tlvs);
+	isis_spf_prc_add_changes(area->spftree6[level - 1], old_tlvs,
+				 new_tlvs);
+
+	return isis_spf_schedule_run(area, level);
+}
+
 static void isis_print_paths(struct vty *vty, struct isis_vertex_queue *queue,
 			     uint8_t *root_sysid)
 {
@@ -1590,4 +2117,5 @@ void isis_spf_print(struct isis_spftree *spftree, struct vty *vty)
 		(uint32_t)spftree->last_run_duration);
 
 	vty_out(vty, "      run count         : %u\n", spftree->runcount);
+	vty_out(vty, "      PRC run count     : %u\n", spftree->prc_runcount);
 }
@@ -25,6 +25,7 @@
 #define _ZEBRA_ISIS_SPF_H
 
 struct isis_spftree;
+struct isis_tlvs;
 
 struct isis_spftree *isis_spftree_new(struct isis_area *area);
 void isis_spftree_del(struct isis_spftree *spftree);
@@ -32,6 +33,9 @@ void spftree_area_init(struct isis_area *area);
 void spftree_area_del(struct isis_area *area);
 void spftree_area_adj_del(struct isis_area *area, struct isis_adjacency *adj);
 int isis_spf_schedule(struct isis_area *area, int level);
+int isis_spf_schedule_prc(struct isis_area *area, int level,
+			  struct isis_tlvs *old_tlvs,
+			  struct isis_tlvs *new_tlvs);
 void isis_spf_cmds_init(void);
 void isis_spf_print(struct isis_spftree *spftree, struct vty *vty);
 #endif /* _ZEBRA_ISIS_SPF_H */
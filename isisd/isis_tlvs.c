@@ -631,9 +631,9 @@ static int unpack_item_extended_reach(uint16_t mtid, uint8_t len,
 	}
 
 	rv = XCALLOC(MTYPE_ISIS_TLV, sizeof(*rv));
-	stream_get(rv->id, s, 7);
-	rv->metric = stream_get3(s);
-	subtlv_len = stream_getc(s);
+	stream_get_unchecked(rv->id, s, 7);
+	rv->metric = stream_get3_unchecked(s);
+	subtlv_len = stream_getc_unchecked(s);
 
 	format_item_extended_reach(mtid, (struct isis_item *)rv, log,
 				   indent + 2);
@@ -1186,8 +1186,8 @@ static int unpack_item_extended_ip_reach(uint16_t mtid, uint8_t len,
 
 	rv = XCALLOC(MTYPE_ISIS_TLV, sizeof(*rv));
 
-	rv->metric = stream_getl(s);
-	control = stream_getc(s);
+	rv->metric = stream_getl_unchecked(s);
+	control = stream_getc_unchecked(s);
 	rv->down = (control & ISIS_EXTENDED_IP_REACH_DOWN);
 	rv->prefix.family = AF_INET;
 	rv->prefix.prefixlen = control & 0x3f;
@@ -2509,6 +2509,12 @@ int isis_pack_tlvs(struct isis_tlvs *tlvs, struct stream *stream,
 	return 0;
 }
 
+void isis_tlvs_update_auth(struct isis_tlvs *tlvs, struct stream *stream,
+			   bool is_lsp)
+{
+	update_auth(tlvs, stream, is_lsp);
+}
+
 static struct isis_tlvs *new_fragment(struct list *l)
 {
 	struct isis_tlvs *rv = isis_alloc_tlvs();
@@ -2534,6 +2540,44 @@ struct list *isis_fragment_tlvs(struct isis_tlvs *tlvs, size_t size)
 	return rv;
 }
 
+static void move_items(struct isis_item_list *src, struct isis_item_list *dest)
+{
+	if (!src->head)
+		return;
+
+	*dest->tail = src->head;
+	dest->tail = src->tail;
+	dest->count += src->count;
+	init_item_list(src);
+}
+
+/* Moves the items a fragment can be given from src to the end of dest */
+void isis_tlvs_move_items(struct isis_tlvs *dest, struct isis_tlvs *src)
+{
+	for (size_t pack_idx = 0; pack_idx < array_size(pack_order);
+	     pack_idx++) {
+		struct pack_order_entry *pe = &pack_order[pack_idx];
+
+		if (pe->how_to_pack == ISIS_ITEMS) {
+			move_items((struct isis_item_list *)(((char *)src)
+							     + pe->what_to_pack),
+				   (struct isis_item_list *)(((char *)dest)
+							     + pe->what_to_pack));
+		} else {
+			struct isis_mt_item_list *m, *dest_m;
+			struct isis_item_list *n;
+
+			m = (struct isis_mt_item_list *)(((char *)src)
+							 + pe->what_to_pack);
+			dest_m = (struct isis_mt_item_list *)(((char *)dest)
+							      + pe->what_to_pack);
+			RB_FOREACH (n, isis_mt_item_list, m)
+				move_items(n, isis_get_mt_items(dest_m,
+								n->mtid));
+		}
+	}
+}
+
 static int unpack_tlv_unknown(enum isis_tlv_context context, uint8_t tlv_type,
 			      uint8_t tlv_len, struct stream *s,
 			      struct sbuf *log, int indent)
@@ -2562,8 +2606,8 @@ static int unpack_tlv(enum isis_tlv_context context, size_t avail_len,
 		return 1;
 	}
 
-	tlv_type = stream_getc(stream);
-	tlv_len = stream_getc(stream);
+	tlv_type = stream_getc_unchecked(stream);
+	tlv_len = stream_getc_unchecked(stream);
 
 	sbuf_push(log, indent + 2,
 		  "Found TLV of type %" PRIu8 " and len %" PRIu8 ".\n",
@@ -2623,7 +2667,9 @@ int isis_unpack_tlvs(size_t avail_len, struct stream *stream,
 		sbuf_init(&logbuf, NULL, 0);
 
 	sbuf_reset(&logbuf);
-	if (avail_len > STREAM_READABLE(stream)) {
+	/* Unpacking then only checks against avail_len, reading the
+	 * fixed-size parts of TLVs unchecked. */
+	if (!stream_reserve(stream, avail_len)) {
 		sbuf_push(&logbuf, indent,
 			  "Stream doesn't contain sufficient data. "
 			  "Claimed %zu, available %zu\n",
@@ -2641,6 +2687,47 @@ int isis_unpack_tlvs(size_t avail_len, struct stream *stream,
 	return rv;
 }
 
+void isis_tlv_iter_init(struct isis_tlv_iter *iter, struct stream *stream,
+			size_t avail_len)
+{
+	memset(iter, 0, sizeof(*iter));
+	iter->pos = stream_pnt(stream);
+	iter->end = iter->pos + MIN(avail_len, STREAM_READABLE(stream));
+}
+
+bool isis_tlv_iter_next(struct isis_tlv_iter *iter)
+{
+	if (iter->error || iter->pos == iter->end)
+		return false;
+
+	if (iter->end - iter->pos < 2
+	    || iter->end - iter->pos < 2 + iter->pos[1]) {
+		iter->error = true;
+		return false;
+	}
+
+	iter->type = iter->pos[0];
+	iter->len = iter->pos[1];
+	iter->value = iter->pos + 2;
+	iter->pos += 2 + iter->len;
+	return true;
+}
+
+/* Whether the TLVs, as opposed to their contents, lie right in the data */
+bool isis_tlv_view_wellformed(struct stream *stream, size_t avail_len)
+{
+	struct isis_tlv_iter iter;
+
+	if (avail_len > STREAM_READABLE(stream))
+		return false;
+
+	isis_tlv_iter_init(&iter, stream, avail_len);
+	while (isis_tlv_iter_next(&iter))
+		;
+
+	return !iter.error;
+}
+
 #define TLV_OPS(_name_, _desc_)                                                \
 	static const struct tlv_ops tlv_##_name_##_ops = {                     \
 		.name = _desc_, .unpack = unpack_tlv_##_name_,                 \
@@ -2901,6 +2988,48 @@ bool isis_tlvs_auth_is_valid(struct isis_tlvs *tlvs, struct isis_passwd *passwd,
 	return auth_validators[passwd->type](passwd, stream, auth, is_lsp);
 }
 
+/*
+ * As isis_tlvs_auth_is_valid(), but finding the auth TLV in the PDU rather
+ * than having all of it unpacked first.
+ */
+bool isis_tlv_view_auth_is_valid(struct stream *stream, size_t avail_len,
+				 struct isis_passwd *passwd, bool is_lsp)
+{
+	struct isis_tlv_iter iter;
+	struct isis_auth auth;
+
+	/* If no auth is set, always pass authentication */
+	if (!passwd->type)
+		return true;
+
+	/* If we don't known how to validate the auth, return invalid */
+	if (passwd->type >= array_size(auth_validators)
+	    || !auth_validators[passwd->type])
+		return false;
+
+	isis_tlv_iter_init(&iter, stream, avail_len);
+	while (isis_tlv_iter_next(&iter)) {
+		if (iter.type != ISIS_TLV_AUTH || iter.len < 1
+		    || iter.value[0] != passwd->type)
+			continue;
+
+		/* Only the fields the validators use */
+		auth.type = iter.value[0];
+		auth.length = iter.len - 1;
+		if (auth.type == ISIS_PASSWD_TYPE_HMAC_MD5 && auth.length != 16)
+			return false;
+		memcpy(auth.value, iter.value + 1, auth.length);
+		auth.offset = iter.value + 1 - STREAM_DATA(stream);
+
+		/* Perform validation and return result */
+		return auth_validators[passwd->type](passwd, stream, &auth,
+						     is_lsp);
+	}
+
+	/* If matching auth TLV could not be found, return invalid */
+	return false;
+}
+
 bool isis_tlvs_area_addresses_match(struct isis_tlvs *tlvs,
 				    struct list *addresses)
 {
@@ -3078,6 +3207,7 @@ void isis_tlvs_add_lsp_entry(struct isis_tlvs *tlvs, struct isis_lsp *lsp)
 {
 	struct isis_lsp_entry *entry = XCALLOC(MTYPE_ISIS_TLV, sizeof(*entry));
 
+	lsp_sync_lifetime(lsp);
 	entry->rem_lifetime = lsp->hdr.rem_lifetime;
 	memcpy(entry->id, lsp->hdr.lsp_id, ISIS_SYS_ID_LEN + 2);
 	entry->checksum = lsp->hdr.checksum;
@@ -3234,3 +3364,105 @@ isis_tlvs_lookup_mt_router_info(struct isis_tlvs *tlvs, uint16_t mtid)
 
 	return NULL;
 }
+
+static bool oldstyle_reachs_same(struct isis_item_list *a,
+				 struct isis_item_list *b)
+{
+	struct isis_oldstyle_reach *ra, *rb;
+
+	if (a->count != b->count)
+		return false;
+
+	for (ra = (struct isis_oldstyle_reach *)a->head,
+	    rb = (struct isis_oldstyle_reach *)b->head;
+	     ra && rb; ra = ra->next, rb = rb->next) {
+		if (memcmp(ra->id, rb->id, sizeof(ra->id))
+		    || ra->metric != rb->metric)
+			return false;
+	}
+
+	return true;
+}
+
+/* The sub-TLVs are left out, they're not what the SPF looks at. */
+static bool extended_reachs_same(struct isis_item_list *a,
+				 struct isis_item_list *b)
+{
+	struct isis_extended_reach *ra, *rb;
+
+	if (a->count != b->count)
+		return false;
+
+	for (ra = (struct isis_extended_reach *)a->head,
+	    rb = (struct isis_extended_reach *)b->head;
+	     ra && rb; ra = ra->next, rb = rb->next) {
+		if (memcmp(ra->id, rb->id, sizeof(ra->id))
+		    || ra->metric != rb->metric)
+			return false;
+	}
+
+	return true;
+}
+
+static bool mt_extended_reachs_same(struct isis_mt_item_list *a,
+				    struct isis_mt_item_list *b)
+{
+	struct isis_item_list *n, *o;
+
+	RB_FOREACH (n, isis_mt_item_list, a) {
+		o = isis_lookup_mt_items(b, n->mtid);
+		if (!o) {
+			if (n->count)
+				return false;
+			continue;
+		}
+		if (!extended_reachs_same(n, o))
+			return false;
+	}
+
+	RB_FOREACH (n, isis_mt_item_list, b) {
+		if (n->count && !isis_lookup_mt_items(a, n->mtid))
+			return false;
+	}
+
+	return true;
+}
+
+static bool mt_router_infos_same(struct isis_tlvs *a, struct isis_tlvs *b)
+{
+	struct isis_mt_router_info *ia, *ib;
+
+	if (a->mt_router_info_empty != b->mt_router_info_empty
+	    || a->mt_router_info.count != b->mt_router_info.count)
+		return false;
+
+	for (ia = (struct isis_mt_router_info *)a->mt_router_info.head,
+	    ib = (struct isis_mt_router_info *)b->mt_router_info.head;
+	     ia && ib; ia = ia->next, ib = ib->next) {
+		if (ia->mtid != ib->mtid || ia->overload != ib->overload
+		    || ia->attached != ib->attached)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Whether two instances of an LSP agree on everything the SPF takes from
+ * them but the IP reachability: their neighbors and the metrics to them,
+ * the protocols and topologies they take part in.
+ */
+bool isis_tlvs_same_topology(struct isis_tlvs *a, struct isis_tlvs *b)
+{
+	if (a->protocols_supported.count != b->protocols_supported.count
+	    || (a->protocols_supported.count
+		&& memcmp(a->protocols_supported.protocols,
+			  b->protocols_supported.protocols,
+			  a->protocols_supported.count)))
+		return false;
+
+	return oldstyle_reachs_same(&a->oldstyle_reach, &b->oldstyle_reach)
+	       && extended_reachs_same(&a->extended_reach, &b->extended_reach)
+	       && mt_extended_reachs_same(&a->mt_reach, &b->mt_reach)
+	       && mt_router_infos_same(a, b);
+}
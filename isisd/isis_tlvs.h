@@ -255,13 +255,36 @@ enum isis_tlv_type {
 struct stream;
 int isis_pack_tlvs(struct isis_tlvs *tlvs, struct stream *stream,
 		   size_t len_pointer, bool pad, bool is_lsp);
+/* Redoes the digests once more data was put behind the packed TLVs */
+void isis_tlvs_update_auth(struct isis_tlvs *tlvs, struct stream *stream,
+			   bool is_lsp);
 void isis_free_tlvs(struct isis_tlvs *tlvs);
 struct isis_tlvs *isis_alloc_tlvs(void);
 int isis_unpack_tlvs(size_t avail_len, struct stream *stream,
 		     struct isis_tlvs **dest, const char **error_log);
+
+/*
+ * Walks the TLVs of a received PDU where they are, from the stream's getp
+ * on, without unpacking them.  The stream is not changed.
+ */
+struct isis_tlv_iter {
+	const uint8_t *pos;
+	const uint8_t *end;
+	bool error; /* A TLV overran the data */
+
+	uint8_t type;
+	uint8_t len;
+	const uint8_t *value;
+};
+
+void isis_tlv_iter_init(struct isis_tlv_iter *iter, struct stream *stream,
+			size_t avail_len);
+bool isis_tlv_iter_next(struct isis_tlv_iter *iter);
+bool isis_tlv_view_wellformed(struct stream *stream, size_t avail_len);
 const char *isis_format_tlvs(struct isis_tlvs *tlvs);
 struct isis_tlvs *isis_copy_tlvs(struct isis_tlvs *tlvs);
 struct list *isis_fragment_tlvs(struct isis_tlvs *tlvs, size_t size);
+void isis_tlvs_move_items(struct isis_tlvs *dest, struct isis_tlvs *src);
 
 #define ISIS_EXTENDED_IP_REACH_DOWN 0x80
 #define ISIS_EXTENDED_IP_REACH_SUBTLV 0x40
@@ -293,6 +316,8 @@ void isis_tlvs_add_ipv6_addresses(struct isis_tlvs *tlvs,
 				  struct list *addresses);
 bool isis_tlvs_auth_is_valid(struct isis_tlvs *tlvs, struct isis_passwd *passwd,
 			     struct stream *stream, bool is_lsp);
+bool isis_tlv_view_auth_is_valid(struct stream *stream, size_t avail_len,
+				 struct isis_passwd *passwd, bool is_lsp);
 bool isis_tlvs_area_addresses_match(struct isis_tlvs *tlvs,
 				    struct list *addresses);
 struct isis_adjacency;
@@ -329,4 +354,5 @@ void isis_tlvs_add_threeway_adj(struct isis_tlvs *tlvs,
 
 struct isis_mt_router_info *
 isis_tlvs_lookup_mt_router_info(struct isis_tlvs *tlvs, uint16_t mtid);
+bool isis_tlvs_same_topology(struct isis_tlvs *a, struct isis_tlvs *b);
 #endif
@@ -234,12 +234,17 @@ static int isis_zebra_link_params(int command, struct zclient *zclient,
 				  zebra_size_t length)
 {
 	struct interface *ifp;
+	uint32_t changed;
 
-	ifp = zebra_interface_link_params_read(zclient->ibuf);
+	ifp = zebra_interface_link_params_read(zclient->ibuf, &changed);
 
 	if (ifp == NULL)
 		return 0;
 
+	/* Nothing to re-advertise if the parameters are the same */
+	if (!changed)
+		return 0;
+
 	/* Update TE TLV */
 	isis_mpls_te_update(ifp);
 
@@ -35,6 +35,7 @@
 #include "prefix.h"
 #include "table.h"
 #include "qobj.h"
+#include "pqueue.h"
 #include "spf_backoff.h"
 
 #include "isisd/dict.h"
@@ -129,6 +130,9 @@ struct isis_area *isis_area_create(const char *area_tag)
 
 	spftree_area_init(area);
 
+	area->lsp_expiry[0] = lsp_expiry_init();
+	area->lsp_expiry[1] = lsp_expiry_init();
+
 	area->circuit_list = list_new();
 	area->area_addrs = list_new();
 	thread_add_timer(master, lsp_tick, area, 1, &area->t_tick);
@@ -232,6 +236,11 @@ int isis_area_destroy(struct vty *vty, const char *area_tag)
 		area->lspdb[1] = NULL;
 	}
 
+	pqueue_delete(area->lsp_expiry[0]);
+	pqueue_delete(area->lsp_expiry[1]);
+	isis_csnp_cache_flush(area, ISIS_LEVEL1);
+	isis_csnp_cache_flush(area, ISIS_LEVEL2);
+
 	spftree_area_del(area);
 
 	THREAD_TIMER_OFF(area->spf_timer[0]);
@@ -66,6 +66,8 @@ DECLARE_QOBJ_TYPE(isis_area)
 struct isis_area {
 	struct isis *isis;			       /* back pointer */
 	dict_t *lspdb[ISIS_LEVELS];		       /* link-state dbs */
+	struct pqueue *lsp_expiry[ISIS_LEVELS];	/* lspdb by expiry time */
+	struct isis_csnp_cache *csnp_cache[ISIS_LEVELS]; /* lspdb's CSNPs */
 	struct isis_spftree *spftree[ISIS_LEVELS];     /* The v4 SPTs */
 	struct route_table *route_table[ISIS_LEVELS];  /* IPv4 routes */
 	struct isis_spftree *spftree6[ISIS_LEVELS];    /* The v6 SPTs */
@@ -62,8 +62,24 @@ static int		 lde_get_label_chunk(void);
 static void		 on_get_label_chunk_response(uint32_t start, uint32_t end);
 static uint32_t		 lde_get_next_label(void);
 
+/* A kernel label change or delete waiting to go to the parent */
+struct lde_kr_op {
+	TAILQ_ENTRY(lde_kr_op)	 entry;
+	RB_ENTRY(lde_kr_op)	 last;		/* per prefix and nexthop */
+	int			 type;
+	struct kroute		 kr;
+};
+RB_HEAD(lde_kr_op_tree, lde_kr_op);
+RB_PROTOTYPE(lde_kr_op_tree, lde_kr_op, last, lde_kr_op_compare)
+
+static __inline int	 lde_kr_op_compare(const struct lde_kr_op *,
+			    const struct lde_kr_op *);
+static void		 lde_kr_op_add(int, struct kroute *);
+static int		 lde_kr_op_flush(struct thread *);
+
 RB_GENERATE(nbr_tree, lde_nbr, entry, lde_nbr_compare)
 RB_GENERATE(lde_map_head, lde_map, entry, lde_map_compare)
+RB_GENERATE(lde_kr_op_tree, lde_kr_op, last, lde_kr_op_compare)
 
 struct ldpd_conf	*ldeconf;
 struct nbr_tree		 lde_nbrs = RB_INITIALIZER(&lde_nbrs);
@@ -71,6 +87,10 @@ struct nbr_tree		 lde_nbrs = RB_INITIALIZER(&lde_nbrs);
 static struct imsgev	*iev_ldpe;
 static struct imsgev	*iev_main, *iev_main_sync;
 
+static TAILQ_HEAD(, lde_kr_op) kr_ops = TAILQ_HEAD_INITIALIZER(kr_ops);
+static struct lde_kr_op_tree kr_ops_last = RB_INITIALIZER(&kr_ops_last);
+static struct thread	*kr_ops_ev;
+
 /* Master of threads. */
 struct thread_master *master;
 
@@ -730,6 +750,97 @@ lde_update_label(struct fec_node *fn)
 	return (lde_get_next_label());
 }
 
+/*
+ * The kernel label changes made while handling one event go to the parent
+ * once it is done, many to an imsg, and from there to zebra many to a
+ * message.  A change or delete identical to the last one waiting for the
+ * same prefix and nexthop adds nothing and is dropped: lde_kernel_update()
+ * and lde_check_mapping() often ask for the same change twice.
+ */
+static __inline int
+lde_kr_op_compare(const struct lde_kr_op *a, const struct lde_kr_op *b)
+{
+	int	 ret;
+
+	if (a->kr.af != b->kr.af)
+		return (a->kr.af - b->kr.af);
+	ret = ldp_addrcmp(a->kr.af, &a->kr.prefix, &b->kr.prefix);
+	if (ret)
+		return (ret);
+	if (a->kr.prefixlen != b->kr.prefixlen)
+		return (a->kr.prefixlen - b->kr.prefixlen);
+	ret = ldp_addrcmp(a->kr.af, &a->kr.nexthop, &b->kr.nexthop);
+	if (ret)
+		return (ret);
+	return (a->kr.ifindex - b->kr.ifindex);
+}
+
+static void
+lde_kr_op_add(int type, struct kroute *kr)
+{
+	struct lde_kr_op	*op, *last;
+
+	if (iev_main->ibuf.fd == -1)
+		return;
+
+	if ((op = calloc(1, sizeof(*op))) == NULL)
+		fatal(__func__);
+	op->type = type;
+	op->kr = *kr;
+
+	last = RB_FIND(lde_kr_op_tree, &kr_ops_last, op);
+	if (last) {
+		if (last->type == type &&
+		    memcmp(&last->kr, kr, sizeof(*kr)) == 0) {
+			free(op);
+			return;
+		}
+		RB_REMOVE(lde_kr_op_tree, &kr_ops_last, last);
+	}
+	RB_INSERT(lde_kr_op_tree, &kr_ops_last, op);
+	TAILQ_INSERT_TAIL(&kr_ops, op, entry);
+
+	thread_add_event(master, lde_kr_op_flush, NULL, 0, &kr_ops_ev);
+}
+
+/* In order, runs of the same type in one imsg */
+static int
+lde_kr_op_flush(struct thread *thread)
+{
+	struct kroute		 krs[(MAX_IMSGSIZE - IMSG_HEADER_SIZE) /
+				    sizeof(struct kroute)];
+	struct lde_kr_op	*op;
+	unsigned int		 count = 0;
+	int			 type = 0;
+
+	if (thread == NULL)
+		THREAD_OFF(kr_ops_ev);
+	else
+		kr_ops_ev = NULL;
+
+	while ((op = TAILQ_FIRST(&kr_ops)) != NULL) {
+		if (count && (op->type != type ||
+		    count == sizeof(krs) / sizeof(krs[0]))) {
+			lde_imsg_compose_parent(type, 0, krs,
+			    count * sizeof(struct kroute));
+			count = 0;
+		}
+
+		type = op->type;
+		krs[count++] = op->kr;
+
+		TAILQ_REMOVE(&kr_ops, op, entry);
+		free(op);
+	}
+	if (count)
+		lde_imsg_compose_parent(type, 0, krs,
+		    count * sizeof(struct kroute));
+
+	RB_INIT(lde_kr_op_tree, &kr_ops_last);
+
+	return (0);
+}
+
 void
 lde_send_change_klabel(struct fec_node *fn, struct fec_nh *fnh)
 {
@@ -749,8 +860,7 @@ lde_send_change_klabel(struct fec_node *fn, struct fec_nh *fnh)
 		kr.remote_label = fnh->remote_label;
 		kr.priority = fnh->priority;
 
-		lde_imsg_compose_parent(IMSG_KLABEL_CHANGE, 0, &kr,
-		    sizeof(kr));
+		lde_kr_op_add(IMSG_KLABEL_CHANGE, &kr);
 		break;
 	case FEC_TYPE_IPV6:
 		memset(&kr, 0, sizeof(kr));
@@ -763,8 +873,7 @@ lde_send_change_klabel(struct fec_node *fn, struct fec_nh *fnh)
 		kr.remote_label = fnh->remote_label;
 		kr.priority = fnh->priority;
 
-		lde_imsg_compose_parent(IMSG_KLABEL_CHANGE, 0, &kr,
-		    sizeof(kr));
+		lde_kr_op_add(IMSG_KLABEL_CHANGE, &kr);
 		break;
 	case FEC_TYPE_PWID:
 		pw = (struct l2vpn_pw *) fn->data;
@@ -776,6 +885,7 @@ lde_send_change_klabel(struct fec_node *fn, struct fec_nh *fnh)
 		pw2zpw(pw, &zpw);
 		zpw.local_label = fn->local_label;
 		zpw.remote_label = fnh->remote_label;
+		lde_kr_op_flush(NULL);
 		lde_imsg_compose_parent(IMSG_KPW_SET, 0, &zpw, sizeof(zpw));
 		break;
 	}
@@ -800,8 +910,7 @@ lde_send_delete_klabel(struct fec_node *fn, struct fec_nh *fnh)
 		kr.remote_label = fnh->remote_label;
 		kr.priority = fnh->priority;
 
-		lde_imsg_compose_parent(IMSG_KLABEL_DELETE, 0, &kr,
-		    sizeof(kr));
+		lde_kr_op_add(IMSG_KLABEL_DELETE, &kr);
 		break;
 	case FEC_TYPE_IPV6:
 		memset(&kr, 0, sizeof(kr));
@@ -814,8 +923,7 @@ lde_send_delete_klabel(struct fec_node *fn, struct fec_nh *fnh)
 		kr.remote_label = fnh->remote_label;
 		kr.priority = fnh->priority;
 
-		lde_imsg_compose_parent(IMSG_KLABEL_DELETE, 0, &kr,
-		    sizeof(kr));
+		lde_kr_op_add(IMSG_KLABEL_DELETE, &kr);
 		break;
 	case FEC_TYPE_PWID:
 		pw = (struct l2vpn_pw *) fn->data;
@@ -826,6 +934,7 @@ lde_send_delete_klabel(struct fec_node *fn, struct fec_nh *fnh)
 		pw2zpw(pw, &zpw);
 		zpw.local_label = fn->local_label;
 		zpw.remote_label = fnh->remote_label;
+		lde_kr_op_flush(NULL);
 		lde_imsg_compose_parent(IMSG_KPW_UNSET, 0, &zpw, sizeof(zpw));
 		break;
 	}
@@ -891,6 +1000,45 @@ lde_map2fec(struct map *map, struct in_addr lsr_id, struct fec *fec)
 	}
 }
 
+/*
+ * Label mappings go to ldpe as many to an imsg as fit, the last of them
+ * when the IMSG_MAPPING_ADD_END has ldpe put them on the wire.
+ */
+#define LDE_MAP_BATCH_MAX \
+	((MAX_IMSGSIZE - IMSG_HEADER_SIZE) / sizeof(struct map))
+
+static void
+lde_map_batch_flush(struct lde_nbr *ln)
+{
+	if (ln->map_batch_count == 0)
+		return;
+
+	lde_imsg_compose_ldpe(IMSG_MAPPING_ADD, ln->peerid, 0,
+	    ln->map_batch, ln->map_batch_count * sizeof(struct map));
+	ln->map_batch_count = 0;
+}
+
+static void
+lde_map_batch_add(struct lde_nbr *ln, struct map *map)
+{
+	if (ln->map_batch == NULL) {
+		ln->map_batch = calloc(LDE_MAP_BATCH_MAX, sizeof(struct map));
+		if (ln->map_batch == NULL)
+			fatal(__func__);
+	}
+
+	ln->map_batch[ln->map_batch_count++] = *map;
+	if (ln->map_batch_count == LDE_MAP_BATCH_MAX)
+		lde_map_batch_flush(ln);
+}
+
+void
+lde_send_labelmapping_end(struct lde_nbr *ln)
+{
+	lde_map_batch_flush(ln);
+	lde_imsg_compose_ldpe(IMSG_MAPPING_ADD_END, ln->peerid, 0, NULL, 0);
+}
+
 void
 lde_send_labelmapping(struct lde_nbr *ln, struct fec_node *fn, int single)
 {
@@ -976,11 +1124,9 @@ lde_send_labelmapping(struct lde_nbr *ln, struct fec_node *fn, int single)
 	}
 
 	/* SL.4: send label mapping */
-	lde_imsg_compose_ldpe(IMSG_MAPPING_ADD, ln->peerid, 0,
-	    &map, sizeof(map));
+	lde_map_batch_add(ln, &map);
 	if (single)
-		lde_imsg_compose_ldpe(IMSG_MAPPING_ADD_END, ln->peerid, 0,
-		    NULL, 0);
+		lde_send_labelmapping_end(ln);
 
 	/* SL.5: record sent label mapping */
 	me = (struct lde_map *)fec_find(&ln->sent_map, &fn->fec);
@@ -1279,6 +1425,7 @@ lde_nbr_del(struct lde_nbr *ln)
 	fec_clear(&ln->recv_req, free);
 	fec_clear(&ln->sent_req, free);
 	fec_clear(&ln->sent_wdraw, free);
+	free(ln->map_batch);
 
 	RB_REMOVE(nbr_tree, &lde_nbrs, ln);
 
@@ -1561,8 +1708,7 @@ lde_change_egress_label(int af)
 				lde_send_labelmapping(ln, fn, 0);
 	}
 	RB_FOREACH(ln, nbr_tree, &lde_nbrs)
-		lde_imsg_compose_ldpe(IMSG_MAPPING_ADD_END, ln->peerid, 0,
-		    NULL, 0);
+		lde_send_labelmapping_end(ln);
 }
 
 static int
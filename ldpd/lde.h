@@ -98,6 +98,8 @@ struct lde_nbr {
 	struct fec_tree		 sent_map_pending;
 	struct fec_tree		 sent_wdraw;
 	TAILQ_HEAD(, lde_addr)	 addr_list;
+	struct map		*map_batch;	/* mappings not sent to ldpe */
+	unsigned int		 map_batch_count;
 };
 RB_HEAD(nbr_tree, lde_nbr);
 RB_PROTOTYPE(nbr_tree, lde_nbr, entry, lde_nbr_compare)
@@ -153,6 +155,7 @@ void		 lde_fec2map(struct fec *, struct map *);
 void		 lde_map2fec(struct map *, struct in_addr, struct fec *);
 void		 lde_send_labelmapping(struct lde_nbr *, struct fec_node *,
 		    int);
+void		 lde_send_labelmapping_end(struct lde_nbr *);
 void		 lde_send_labelwithdraw(struct lde_nbr *, struct fec_node *,
 		    struct map *, struct status_tlv *);
 void		 lde_send_labelwithdraw_wcard(struct lde_nbr *, uint32_t);
@@ -222,7 +222,7 @@ fec_snap(struct lde_nbr *ln)
 		lde_send_labelmapping(ln, fn, 0);
 	}
 
-	lde_imsg_compose_ldpe(IMSG_MAPPING_ADD_END, ln->peerid, 0, NULL, 0);
+	lde_send_labelmapping_end(ln);
 }
 
 static void
@@ -37,7 +37,7 @@
 static void	 ifp2kif(struct interface *, struct kif *);
 static void	 ifc2kaddr(struct interface *, struct connected *,
 		    struct kaddr *);
-static int	 zebra_send_mpls_labels(int, struct kroute *);
+static int	 zebra_send_mpls_labels(int, struct kroute *, unsigned int);
 static int	 ldp_router_id_update(int, struct zclient *, zebra_size_t,
 		    vrf_id_t);
 static int	 ldp_interface_add(int, struct zclient *, zebra_size_t,
@@ -113,63 +113,85 @@ pw2zpw(struct l2vpn_pw *pw, struct zapi_pw *zpw)
 	    sizeof(zpw->data.ldp.vpn_name));
 }
 
+/* The largest of a label message's entries, an IPv6 one */
+#define ZEBRA_MPLS_LABELS_ENTRY_MAX	(1 + 4 + 16 + 1 + 16 + 4 + 1 + 4 + 4)
+
+/* As many entries to a message as fit, zebra goes through them all */
 static int
-zebra_send_mpls_labels(int cmd, struct kroute *kr)
+zebra_send_mpls_labels(int cmd, struct kroute *kr, unsigned int count)
 {
-	struct stream		*s;
+	struct stream		*s = zclient->obuf;
+	unsigned int		 i, entries = 0;
+	int			 ret = 0;
 
-	if (kr->local_label < MPLS_LABEL_RESERVED_MAX ||
-	    kr->remote_label == NO_LABEL)
-		return (0);
+	for (i = 0; i < count; i++, kr++) {
+		if (kr->local_label < MPLS_LABEL_RESERVED_MAX ||
+		    kr->remote_label == NO_LABEL)
+			continue;
 
-	debug_zebra_out("prefix %s/%u nexthop %s ifindex %u labels %s/%s (%s)",
-	    log_addr(kr->af, &kr->prefix), kr->prefixlen,
-	    log_addr(kr->af, &kr->nexthop), kr->ifindex,
-	    log_label(kr->local_label), log_label(kr->remote_label),
-	    (cmd == ZEBRA_MPLS_LABELS_ADD) ? "add" : "delete");
+		debug_zebra_out("prefix %s/%u nexthop %s ifindex %u labels "
+		    "%s/%s (%s)", log_addr(kr->af, &kr->prefix),
+		    kr->prefixlen, log_addr(kr->af, &kr->nexthop), kr->ifindex,
+		    log_label(kr->local_label), log_label(kr->remote_label),
+		    (cmd == ZEBRA_MPLS_LABELS_ADD) ? "add" : "delete");
+
+		if (entries &&
+		    STREAM_WRITEABLE(s) < ZEBRA_MPLS_LABELS_ENTRY_MAX) {
+			stream_putw_at(s, 0, stream_get_endp(s));
+			if (zclient_send_message(zclient) < 0)
+				ret = -1;
+			entries = 0;
+		}
 
-	/* Reset stream. */
-	s = zclient->obuf;
-	stream_reset(s);
+		if (entries == 0) {
+			/* Reset stream. */
+			stream_reset(s);
+			zclient_create_header(s, cmd, VRF_DEFAULT);
+		}
 
-	zclient_create_header(s, cmd, VRF_DEFAULT);
-	stream_putc(s, ZEBRA_LSP_LDP);
-	stream_putl(s, kr->af);
-	switch (kr->af) {
-	case AF_INET:
-		stream_put_in_addr(s, &kr->prefix.v4);
-		stream_putc(s, kr->prefixlen);
-		stream_put_in_addr(s, &kr->nexthop.v4);
-		break;
-	case AF_INET6:
-		stream_write(s, (uint8_t *)&kr->prefix.v6, 16);
-		stream_putc(s, kr->prefixlen);
-		stream_write(s, (uint8_t *)&kr->nexthop.v6, 16);
-		break;
-	default:
-		fatalx("kr_change: unknown af");
+		stream_putc(s, ZEBRA_LSP_LDP);
+		stream_putl(s, kr->af);
+		switch (kr->af) {
+		case AF_INET:
+			stream_put_in_addr(s, &kr->prefix.v4);
+			stream_putc(s, kr->prefixlen);
+			stream_put_in_addr(s, &kr->nexthop.v4);
+			break;
+		case AF_INET6:
+			stream_write(s, (uint8_t *)&kr->prefix.v6, 16);
+			stream_putc(s, kr->prefixlen);
+			stream_write(s, (uint8_t *)&kr->nexthop.v6, 16);
+			break;
+		default:
+			fatalx("kr_change: unknown af");
+		}
+		stream_putl(s, kr->ifindex);
+		stream_putc(s, kr->priority);
+		stream_putl(s, kr->local_label);
+		stream_putl(s, kr->remote_label);
+		entries++;
 	}
-	stream_putl(s, kr->ifindex);
-	stream_putc(s, kr->priority);
-	stream_putl(s, kr->local_label);
-	stream_putl(s, kr->remote_label);
 
-	/* Put length at the first point of the stream. */
-	stream_putw_at(s, 0, stream_get_endp(s));
+	if (entries) {
+		/* Put length at the first point of the stream. */
+		stream_putw_at(s, 0, stream_get_endp(s));
+		if (zclient_send_message(zclient) < 0)
+			ret = -1;
+	}
 
-	return (zclient_send_message(zclient));
+	return (ret);
 }
 
 int
-kr_change(struct kroute *kr)
+kr_change(struct kroute *kr, unsigned int count)
 {
-	return (zebra_send_mpls_labels(ZEBRA_MPLS_LABELS_ADD, kr));
+	return (zebra_send_mpls_labels(ZEBRA_MPLS_LABELS_ADD, kr, count));
 }
 
 int
-kr_delete(struct kroute *kr)
+kr_delete(struct kroute *kr, unsigned int count)
 {
-	return (zebra_send_mpls_labels(ZEBRA_MPLS_LABELS_DELETE, kr));
+	return (zebra_send_mpls_labels(ZEBRA_MPLS_LABELS_DELETE, kr, count));
 }
 
 int
@@ -573,17 +573,22 @@ main_dispatch_lde(struct thread *thread)
 			logit(imsg.hdr.pid, "%s", (const char *)imsg.data);
 			break;
 		case IMSG_KLABEL_CHANGE:
-			if (imsg.hdr.len - IMSG_HEADER_SIZE !=
+			/* lde batches these */
+			if (imsg.hdr.len == IMSG_HEADER_SIZE ||
+			    (imsg.hdr.len - IMSG_HEADER_SIZE) %
 			    sizeof(struct kroute))
 				fatalx("invalid size of IMSG_KLABEL_CHANGE");
-			if (kr_change(imsg.data))
+			if (kr_change(imsg.data, (imsg.hdr.len -
+			    IMSG_HEADER_SIZE) / sizeof(struct kroute)))
 				log_warnx("%s: error changing route", __func__);
 			break;
 		case IMSG_KLABEL_DELETE:
-			if (imsg.hdr.len - IMSG_HEADER_SIZE !=
+			if (imsg.hdr.len == IMSG_HEADER_SIZE ||
+			    (imsg.hdr.len - IMSG_HEADER_SIZE) %
 			    sizeof(struct kroute))
 				fatalx("invalid size of IMSG_KLABEL_DELETE");
-			if (kr_delete(imsg.data))
+			if (kr_delete(imsg.data, (imsg.hdr.len -
+			    IMSG_HEADER_SIZE) / sizeof(struct kroute)))
 				log_warnx("%s: error deleting route", __func__);
 			break;
 		case IMSG_KPW_ADD:
@@ -596,22 +601,22 @@ main_dispatch_lde(struct thread *thread)
 
 			switch (imsg.hdr.type) {
 			case IMSG_KPW_ADD:
-				if (kmpw_add(imsg.data))
+				if (kmpw_add(imsg.data) < 0)
 					log_warnx("%s: error adding "
 					    "pseudowire", __func__);
 				break;
 			case IMSG_KPW_DELETE:
-				if (kmpw_del(imsg.data))
+				if (kmpw_del(imsg.data) < 0)
 					log_warnx("%s: error deleting "
 					    "pseudowire", __func__);
 				break;
 			case IMSG_KPW_SET:
-				if (kmpw_set(imsg.data))
+				if (kmpw_set(imsg.data) < 0)
 					log_warnx("%s: error setting "
 					    "pseudowire", __func__);
 				break;
 			case IMSG_KPW_UNSET:
-				if (kmpw_unset(imsg.data))
+				if (kmpw_unset(imsg.data) < 0)
 					log_warnx("%s: error unsetting "
 					    "pseudowire", __func__);
 				break;
@@ -665,8 +665,8 @@ int			 cmdline_symset(char *);
 /* kroute.c */
 void		 pw2zpw(struct l2vpn_pw *, struct zapi_pw *);
 void		 kif_redistribute(const char *);
-int		 kr_change(struct kroute *);
-int		 kr_delete(struct kroute *);
+int		 kr_change(struct kroute *, unsigned int);
+int		 kr_delete(struct kroute *, unsigned int);
 int		 kmpw_add(struct zapi_pw *);
 int		 kmpw_del(struct zapi_pw *);
 int		 kmpw_set(struct zapi_pw *);
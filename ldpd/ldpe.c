@@ -572,6 +572,7 @@ ldpe_dispatch_lde(struct thread *thread)
 	struct map		*map;
 	struct notify_msg	*nm;
 	struct nbr		*nbr;
+	size_t			 i, nmaps;
 	int			 n, shut = 0;
 
 	iev->ev_read = NULL;
@@ -589,6 +590,26 @@ ldpe_dispatch_lde(struct thread *thread)
 
 		switch (imsg.hdr.type) {
 		case IMSG_MAPPING_ADD:
+			/* lde batches these */
+			if (imsg.hdr.len == IMSG_HEADER_SIZE ||
+			    (imsg.hdr.len - IMSG_HEADER_SIZE) %
+			    sizeof(struct map))
+				fatalx("invalid size of map request");
+			nmaps = (imsg.hdr.len - IMSG_HEADER_SIZE) /
+			    sizeof(struct map);
+
+			nbr = nbr_find_peerid(imsg.hdr.peerid);
+			if (nbr == NULL) {
+				log_debug("ldpe_dispatch_lde: cannot find "
+				    "neighbor");
+				break;
+			}
+			if (nbr->state != NBR_STA_OPER)
+				break;
+
+			for (i = 0, map = imsg.data; i < nmaps; i++, map++)
+				mapping_list_add(&nbr->mapping_list, map);
+			break;
 		case IMSG_RELEASE_ADD:
 		case IMSG_REQUEST_ADD:
 		case IMSG_WITHDRAW_ADD:
@@ -607,9 +628,6 @@ ldpe_dispatch_lde(struct thread *thread)
 				break;
 
 			switch (imsg.hdr.type) {
-			case IMSG_MAPPING_ADD:
-				mapping_list_add(&nbr->mapping_list, map);
-				break;
 			case IMSG_RELEASE_ADD:
 				mapping_list_add(&nbr->release_list, map);
 				break;
@@ -122,40 +122,30 @@ void bfd_set_param(struct bfd_info **bfd_info, uint32_t min_rx, uint32_t min_tx,
 }
 
 /*
- * bfd_peer_sendmsg - Format and send a peer register/Unregister
- *                    command to Zebra to be forwarded to BFD
+ * Peer register/deregister messages may carry several peers back to back;
+ * between bfd_peer_batch_begin() and bfd_peer_batch_end() peers are
+ * collected here and sent in as few messages as fit.
  */
-void bfd_peer_sendmsg(struct zclient *zclient, struct bfd_info *bfd_info,
-		      int family, void *dst_ip, void *src_ip, char *if_name,
-		      int ttl, int multihop, int command, int set_flag,
-		      vrf_id_t vrf_id)
-{
+static struct {
+	struct zclient *zclient;
 	struct stream *s;
-	int ret;
-	int len;
+	int command;
+	vrf_id_t vrf_id;
+	unsigned int count;
+} bfd_batch;
 
-	/* Individual reg/dereg messages are supressed during shutdown. */
-	if (CHECK_FLAG(bfd_gbl.flags, BFD_GBL_FLAG_IN_SHUTDOWN)) {
-		if (bfd_debug)
-			zlog_debug(
-				"%s: Suppressing BFD peer reg/dereg messages",
-				__FUNCTION__);
-		return;
-	}
-
-	/* Check socket. */
-	if (!zclient || zclient->sock < 0) {
-		if (bfd_debug)
-			zlog_debug(
-				"%s: Can't send BFD peer register, Zebra client not "
-				"established",
-				__FUNCTION__);
-		return;
-	}
+/* Room one peer may take in a message. */
+#define BFD_PEER_MSG_MAX                                                       \
+	(4 + 2 * (2 + 16) + 4 + 4 + 1 + 1 + 1 + 1 + INTERFACE_NAMSIZ)
 
-	s = zclient->obuf;
-	stream_reset(s);
-	zclient_create_header(s, command, vrf_id);
+/*
+ * bfd_peer_encode - Append one peer to a register/unregister message
+ */
+static void bfd_peer_encode(struct stream *s, struct bfd_info *bfd_info,
+			    int family, void *dst_ip, void *src_ip,
+			    char *if_name, int ttl, int multihop, int command)
+{
+	int len;
 
 	stream_putl(s, getpid());
 
@@ -208,18 +198,130 @@ void bfd_peer_sendmsg(struct zclient *zclient, struct bfd_info *bfd_info,
 			stream_putc(s, 0);
 		}
 	}
+}
 
-	stream_putw_at(s, 0, stream_get_endp(s));
+/*
+ * bfd_peer_batch_flush - Send the peers collected so far
+ */
+static void bfd_peer_batch_flush(void)
+{
+	struct zclient *zclient = bfd_batch.zclient;
 
-	ret = zclient_send_message(zclient);
+	if (!bfd_batch.count)
+		return;
 
-	if (ret < 0) {
+	stream_putw_at(bfd_batch.s, 0, stream_get_endp(bfd_batch.s));
+	stream_reset(zclient->obuf);
+	stream_copy(zclient->obuf, bfd_batch.s);
+	stream_reset(bfd_batch.s);
+	bfd_batch.count = 0;
+
+	if (zclient_send_message(zclient) < 0 && bfd_debug)
+		zlog_debug("%s: zclient_send_message() failed", __func__);
+}
+
+/*
+ * bfd_peer_batch_begin - Start collecting peer register/unregister
+ *                        messages, e.g. while replaying all peers
+ */
+void bfd_peer_batch_begin(struct zclient *zclient)
+{
+	assert(!bfd_batch.zclient);
+
+	if (!bfd_batch.s)
+		bfd_batch.s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	bfd_batch.zclient = zclient;
+	bfd_batch.count = 0;
+}
+
+/*
+ * bfd_peer_batch_end - Send what was collected since bfd_peer_batch_begin()
+ */
+void bfd_peer_batch_end(struct zclient *zclient)
+{
+	assert(bfd_batch.zclient == zclient);
+
+	if (zclient->sock >= 0)
+		bfd_peer_batch_flush();
+	stream_reset(bfd_batch.s);
+	bfd_batch.count = 0;
+	bfd_batch.zclient = NULL;
+}
+
+/*
+ * bfd_peer_sendmsg - Format and send a peer register/Unregister
+ *                    command to Zebra to be forwarded to BFD
+ */
+void bfd_peer_sendmsg(struct zclient *zclient, struct bfd_info *bfd_info,
+		      int family, void *dst_ip, void *src_ip, char *if_name,
+		      int ttl, int multihop, int command, int set_flag,
+		      vrf_id_t vrf_id)
+{
+	struct stream *s;
+	int ret;
+
+	/* Individual reg/dereg messages are supressed during shutdown. */
+	if (CHECK_FLAG(bfd_gbl.flags, BFD_GBL_FLAG_IN_SHUTDOWN)) {
 		if (bfd_debug)
 			zlog_debug(
-				"bfd_peer_sendmsg: zclient_send_message() failed");
+				"%s: Suppressing BFD peer reg/dereg messages",
+				__FUNCTION__);
 		return;
 	}
 
+	/* Check socket. */
+	if (!zclient || zclient->sock < 0) {
+		if (bfd_debug)
+			zlog_debug(
+				"%s: Can't send BFD peer register, Zebra client not "
+				"established",
+				__FUNCTION__);
+		return;
+	}
+
+	/*
+	 * zebra expects a source for IPv6 and multihop peers; one sent
+	 * without goes alone, lest it throw off the parsing of the others.
+	 */
+	if (bfd_batch.zclient == zclient
+	    && (src_ip || (!multihop && family != AF_INET6))) {
+		/* Peers share a message only for the same command and vrf. */
+		s = bfd_batch.s;
+		if (bfd_batch.count
+		    && (bfd_batch.command != command
+			|| bfd_batch.vrf_id != vrf_id
+			|| STREAM_WRITEABLE(s) < BFD_PEER_MSG_MAX))
+			bfd_peer_batch_flush();
+		if (!bfd_batch.count) {
+			zclient_create_header(s, command, vrf_id);
+			bfd_batch.command = command;
+			bfd_batch.vrf_id = vrf_id;
+		}
+		bfd_peer_encode(s, bfd_info, family, dst_ip, src_ip, if_name,
+				ttl, multihop, command);
+		bfd_batch.count++;
+	} else {
+		/* Keep the order with peers collected before. */
+		if (bfd_batch.zclient == zclient)
+			bfd_peer_batch_flush();
+
+		s = zclient->obuf;
+		stream_reset(s);
+		zclient_create_header(s, command, vrf_id);
+		bfd_peer_encode(s, bfd_info, family, dst_ip, src_ip, if_name,
+				ttl, multihop, command);
+		stream_putw_at(s, 0, stream_get_endp(s));
+
+		ret = zclient_send_message(zclient);
+
+		if (ret < 0) {
+			if (bfd_debug)
+				zlog_debug(
+					"bfd_peer_sendmsg: zclient_send_message() failed");
+			return;
+		}
+	}
+
 	if (set_flag) {
 		if (command == ZEBRA_BFD_DEST_REGISTER)
 			SET_FLAG(bfd_info->flags, BFD_FLAG_BFD_REG);
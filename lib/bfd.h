@@ -81,6 +81,15 @@ extern void bfd_peer_sendmsg(struct zclient *zclient, struct bfd_info *bfd_info,
 			     char *if_name, int ttl, int multihop, int command,
 			     int set_flag, vrf_id_t vrf_id);
 
+/*
+ * Peer register/deregister messages sent between these two go to zebra
+ * several peers to a message, instead of one message each.  For use when
+ * sending many at once, e.g. on a replay request; only one zclient may be
+ * batching at a time.
+ */
+extern void bfd_peer_batch_begin(struct zclient *zclient);
+extern void bfd_peer_batch_end(struct zclient *zclient);
+
 extern const char *bfd_get_command_dbg_str(int command);
 
 extern struct interface *bfd_get_peer_info(struct stream *s, struct prefix *dp,
@@ -38,6 +38,10 @@ struct buffer {
 
 	/* Size of each buffer_data chunk. */
 	size_t size;
+
+	/* Bytes of data not yet flushed, and the limit set on them. */
+	size_t pending;
+	size_t max;
 };
 
 /* Data container. */
@@ -118,6 +122,21 @@ int buffer_empty(struct buffer *b)
 	return (b->head == NULL);
 }
 
+void buffer_set_max(struct buffer *b, size_t max)
+{
+	b->max = max;
+}
+
+size_t buffer_pending(struct buffer *b)
+{
+	return b->pending;
+}
+
+bool buffer_full(struct buffer *b)
+{
+	return b->max && b->pending >= b->max;
+}
+
 /* Clear and free all allocated data. */
 void buffer_reset(struct buffer *b)
 {
@@ -129,6 +148,7 @@ void buffer_reset(struct buffer *b)
 		BUFFER_DATA_FREE(data);
 	}
 	b->head = b->tail = NULL;
+	b->pending = 0;
 }
 
 /* Add buffer_data to the end of buffer. */
@@ -170,6 +190,7 @@ void buffer_put(struct buffer *b, const void *p, size_t size)
 		size -= chunk;
 		ptr += chunk;
 		data->cp += chunk;
+		b->pending += chunk;
 	}
 }
 
@@ -210,6 +231,7 @@ void buffer_put_crlf(struct buffer *b, const void *origp, size_t origsize)
 
 		p += chunk;
 		data->cp += chunk;
+		b->pending += chunk;
 
 		if (lf && size <= avail) {
 			/* we just copied up to (including) a '\n' */
@@ -219,6 +241,7 @@ void buffer_put_crlf(struct buffer *b, const void *origp, size_t origsize)
 			if (data->cp == b->size)
 				data = buffer_add(b);
 			data->data[data->cp++] = '\n';
+			b->pending += 2;
 
 			p++;
 			lf = memchr(p, '\n', end - p);
@@ -325,6 +348,7 @@ buffer_status_t buffer_flush_window(struct buffer *b, int fd, int width,
 		}
 		iov[iov_index].iov_base = (char *)(data->data + data->sp);
 		iov[iov_index++].iov_len = cp - data->sp;
+		b->pending -= cp - data->sp;
 		data->sp = cp;
 
 		if (iov_index == iov_alloc)
@@ -406,22 +430,19 @@ buffer_status_t buffer_flush_window(struct buffer *b, int fd, int width,
 }
 
 /* This function (unlike other buffer_flush* functions above) is designed
-to work with non-blocking sockets.  It does not attempt to write out
-all of the queued data, just a "big" chunk.  It returns 0 if it was
-able to empty out the buffers completely, 1 if more flushing is
-required later, or -1 on a fatal write error. */
+to work with non-blocking sockets.  It hands the queued data to a single
+writev(), up to MAX_CHUNKS chunks of it, which is what the socket will
+take at once in practice.  It returns 0 if it was able to empty out the
+buffers completely, 1 if more flushing is required later, or -1 on a
+fatal write error. */
 buffer_status_t buffer_flush_available(struct buffer *b, int fd)
 {
 
-/* These are just reasonable values to make sure a significant amount of
-data is written.  There's no need to go crazy and try to write it all
-in one shot. */
 #ifdef IOV_MAX
-#define MAX_CHUNKS ((IOV_MAX >= 16) ? 16 : IOV_MAX)
+#define MAX_CHUNKS ((IOV_MAX >= 256) ? 256 : IOV_MAX)
 #else
 #define MAX_CHUNKS 16
 #endif
-#define MAX_FLUSH 131072
 
 	struct buffer_data *d;
 	size_t written;
@@ -429,8 +450,7 @@ in one shot. */
 	size_t iovcnt = 0;
 	size_t nbyte = 0;
 
-	for (d = b->head; d && (iovcnt < MAX_CHUNKS) && (nbyte < MAX_FLUSH);
-	     d = d->next, iovcnt++) {
+	for (d = b->head; d && (iovcnt < MAX_CHUNKS); d = d->next, iovcnt++) {
 		iov[iovcnt].iov_base = d->data + d->sp;
 		nbyte += (iov[iovcnt].iov_len = d->cp - d->sp);
 	}
@@ -449,6 +469,8 @@ in one shot. */
 		return BUFFER_ERROR;
 	}
 
+	b->pending -= written;
+
 	/* Free printed buffer data. */
 	while (written > 0) {
 		struct buffer_data *d;
@@ -473,7 +495,6 @@ in one shot. */
 	return b->head ? BUFFER_PENDING : BUFFER_EMPTY;
 
 #undef MAX_CHUNKS
-#undef MAX_FLUSH
 }
 
 buffer_status_t buffer_write(struct buffer *b, int fd, const void *p,
@@ -52,6 +52,15 @@ char *buffer_getstr(struct buffer *);
 /* Returns 1 if there is no pending data in the buffer.  Otherwise returns 0. */
 int buffer_empty(struct buffer *);
 
+/* Set a limit on the data pending in the buffer, 0 for none (the default).
+   Data is never refused for being over it; instead buffer_full() tells
+   producers to hold off until the buffer has been flushed below it. */
+extern void buffer_set_max(struct buffer *, size_t max);
+/* Number of bytes waiting to be flushed. */
+extern size_t buffer_pending(struct buffer *);
+/* Whether the pending data has reached the limit set by buffer_set_max(). */
+extern bool buffer_full(struct buffer *);
+
 typedef enum {
 	/* An I/O error occurred.  The buffer should be destroyed and the
 	   file descriptor should be closed. */
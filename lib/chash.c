@@ -0,0 +1,153 @@
+/*
+ * Hash tables shared between pthreads.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "chash.h"
+
+/*
+ * The stripe comes from the top bits of the key, after mixing them in with
+ * a multiplication, while the stripe's table picks a bucket by the bottom
+ * bits; the two stay independent even for keys like small integers.
+ */
+static inline struct chash_stripe *chash_stripe(struct chash *chash,
+						void *data)
+{
+	struct hash *hash = chash->stripes[0].hash;
+	uint32_t key = (*hash->hash_key)(data);
+
+	return &chash->stripes[(key * 0x9e3779b1U) >> (32 - CHASH_STRIPE_BITS)];
+}
+
+struct chash *chash_create_size(unsigned int size,
+				unsigned int (*hash_key)(void *),
+				int (*hash_cmp)(const void *, const void *),
+				const char *name)
+{
+	struct chash *chash;
+	unsigned int i;
+
+	assert((size & (size - 1)) == 0);
+	size = size > CHASH_STRIPES ? size / CHASH_STRIPES : 1;
+
+	chash = XCALLOC(MTYPE_HASH, sizeof(*chash));
+	for (i = 0; i < CHASH_STRIPES; i++) {
+		pthread_mutex_init(&chash->stripes[i].lock, NULL);
+		chash->stripes[i].hash =
+			hash_create_size(size, hash_key, hash_cmp, name);
+	}
+	return chash;
+}
+
+struct chash *chash_create(unsigned int (*hash_key)(void *),
+			   int (*hash_cmp)(const void *, const void *),
+			   const char *name)
+{
+	return chash_create_size(HASH_INITIAL_SIZE, hash_key, hash_cmp, name);
+}
+
+void *chash_get(struct chash *chash, void *data, void *(*alloc_func)(void *))
+{
+	struct chash_stripe *stripe = chash_stripe(chash, data);
+	void *rv;
+
+	if (!alloc_func)
+		return chash_lookup(chash, data);
+
+	pthread_mutex_lock(&stripe->lock);
+	rv = hash_get(stripe->hash, data, alloc_func);
+	pthread_mutex_unlock(&stripe->lock);
+	return rv;
+}
+
+void *chash_lookup(struct chash *chash, void *data)
+{
+	struct chash_stripe *stripe = chash_stripe(chash, data);
+	void *rv;
+
+	pthread_mutex_lock(&stripe->lock);
+	rv = hash_lookup(stripe->hash, data);
+	pthread_mutex_unlock(&stripe->lock);
+	return rv;
+}
+
+void *chash_lookup_apply(struct chash *chash, void *data,
+			 void *(*func)(void *entry, void *arg), void *arg)
+{
+	struct chash_stripe *stripe = chash_stripe(chash, data);
+	void *rv;
+
+	pthread_mutex_lock(&stripe->lock);
+	rv = func(hash_lookup(stripe->hash, data), arg);
+	pthread_mutex_unlock(&stripe->lock);
+	return rv;
+}
+
+void *chash_release(struct chash *chash, void *data)
+{
+	struct chash_stripe *stripe = chash_stripe(chash, data);
+	void *rv;
+
+	pthread_mutex_lock(&stripe->lock);
+	rv = hash_release(stripe->hash, data);
+	pthread_mutex_unlock(&stripe->lock);
+	return rv;
+}
+
+void chash_iterate(struct chash *chash,
+		   void (*func)(struct hash_backet *, void *), void *arg)
+{
+	unsigned int i;
+
+	for (i = 0; i < CHASH_STRIPES; i++) {
+		pthread_mutex_lock(&chash->stripes[i].lock);
+		hash_iterate(chash->stripes[i].hash, func, arg);
+		pthread_mutex_unlock(&chash->stripes[i].lock);
+	}
+}
+
+unsigned long chash_count(struct chash *chash)
+{
+	unsigned long count = 0;
+	unsigned int i;
+
+	for (i = 0; i < CHASH_STRIPES; i++) {
+		pthread_mutex_lock(&chash->stripes[i].lock);
+		count += hashcount(chash->stripes[i].hash);
+		pthread_mutex_unlock(&chash->stripes[i].lock);
+	}
+	return count;
+}
+
+void chash_clean(struct chash *chash, void (*free_func)(void *))
+{
+	unsigned int i;
+
+	for (i = 0; i < CHASH_STRIPES; i++)
+		hash_clean(chash->stripes[i].hash, free_func);
+}
+
+void chash_free(struct chash *chash)
+{
+	unsigned int i;
+
+	for (i = 0; i < CHASH_STRIPES; i++) {
+		hash_free(chash->stripes[i].hash);
+		pthread_mutex_destroy(&chash->stripes[i].lock);
+	}
+	XFREE(MTYPE_HASH, chash);
+}
@@ -0,0 +1,95 @@
+/*
+ * Hash tables shared between pthreads.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_CHASH_H_
+#define _FRR_CHASH_H_
+
+#include <pthread.h>
+
+#include "hash.h"
+
+/*
+ * A chash is a hash table any pthread may use without locking of its own.
+ * Entries are spread over CHASH_STRIPES tables by their key, each behind
+ * its own mutex, so that pthreads working on different entries mostly take
+ * different locks.  (A rwlock costs about twice as much to take, and with
+ * the table striped, readers rarely meet anyway.)
+ *
+ * Callbacks follow lib/hash.h: hash_key and hash_cmp as for hash_create(),
+ * alloc_func as for hash_get().  They run with the entry's stripe locked,
+ * as do the functions passed to chash_lookup_apply() and chash_iterate(),
+ * which must not call back into the same chash.
+ *
+ * Entries are not reference counted: a pthread may only use an entry it got
+ * from a lookup for as long as it knows no other pthread deletes it, or
+ * from within chash_lookup_apply().
+ */
+#define CHASH_STRIPE_BITS 4
+#define CHASH_STRIPES (1 << CHASH_STRIPE_BITS)
+
+struct chash {
+	struct chash_stripe {
+		pthread_mutex_t lock;
+		struct hash *hash;
+	} __attribute__((aligned(64))) stripes[CHASH_STRIPES];
+};
+
+/*
+ * Creates a chash.
+ *
+ * @param size	initial size over all stripes, a power of 2
+ * @param name	shown by "show hash statistics" for each stripe, or NULL
+ * @return the new chash
+ */
+extern struct chash *chash_create_size(unsigned int size,
+				       unsigned int (*hash_key)(void *),
+				       int (*hash_cmp)(const void *,
+						       const void *),
+				       const char *name);
+extern struct chash *chash_create(unsigned int (*hash_key)(void *),
+				  int (*hash_cmp)(const void *, const void *),
+				  const char *name);
+
+/* As hash_get(), hash_lookup() and hash_release(). */
+extern void *chash_get(struct chash *chash, void *data,
+		       void *(*alloc_func)(void *));
+extern void *chash_lookup(struct chash *chash, void *data);
+extern void *chash_release(struct chash *chash, void *data);
+
+/*
+ * Looks up an entry and runs func on it, or on NULL if there is none,
+ * while no other pthread may change or delete it.
+ *
+ * @return what func returns
+ */
+extern void *chash_lookup_apply(struct chash *chash, void *data,
+				void *(*func)(void *entry, void *arg),
+				void *arg);
+
+/* As hash_iterate(), one stripe at a time. */
+extern void chash_iterate(struct chash *chash,
+			  void (*func)(struct hash_backet *, void *),
+			  void *arg);
+
+/* Entries over all stripes; only a snapshot while others make changes. */
+extern unsigned long chash_count(struct chash *chash);
+
+/* As hash_clean() and hash_free(); no other pthread may use the chash. */
+extern void chash_clean(struct chash *chash, void (*free_func)(void *));
+extern void chash_free(struct chash *chash);
+
+#endif /* _FRR_CHASH_H_ */
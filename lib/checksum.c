@@ -8,47 +8,387 @@
 
 #include <zebra.h>
 #include "checksum.h"
+#include "memory.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CHECKSUM_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define CHECKSUM_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * The sums are done by one of several implementations, picked at startup
+ * for the CPU, each taking as much of the buffer as suits its vectors and
+ * leaving the rest to the generic one.
+ *
+ * in_sum adds the 16-bit words of buf to *sum, without folding; any grouping
+ * of the words gives the same checksum once folded, so wider words may be
+ * added instead.
+ *
+ * fletcher_sum runs the Fletcher sums over buf, c0 and c1 both less than 255
+ * before and after.
+ *
+ * Both return how many bytes they took.
+ */
+struct checksum_impl {
+	const char *name;
+	bool (*supported)(void);
+	size_t (*in_sum)(const uint8_t *buf, size_t len, uint64_t *sum);
+	size_t (*fletcher_sum)(const uint8_t *buf, size_t len, uint32_t *c0,
+			       uint32_t *c1);
+};
+
+static size_t in_sum_generic(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+	uint64_t s = *sum;
+	uint32_t w;
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		memcpy(&w, buf + i, sizeof(w));
+		s += w;
+	}
+	*sum = s;
+	return i;
+}
+
+/* Fletcher Checksum -- Refer to RFC1008. */
+#define MODX                 4102U   /* 5802 should be fine */
+
+static size_t fletcher_sum_generic(const uint8_t *buf, size_t len,
+				   uint32_t *pc0, uint32_t *pc1)
+{
+	uint32_t c0 = *pc0, c1 = *pc1;
+	size_t partial_len, i, left = len;
+
+	while (left != 0) {
+		partial_len = MIN(left, MODX);
+
+		for (i = 0; i < partial_len; i++) {
+			c0 = c0 + *(buf++);
+			c1 += c0;
+		}
+
+		c0 = c0 % 255;
+		c1 = c1 % 255;
+
+		left -= partial_len;
+	}
+
+	*pc0 = c0;
+	*pc1 = c1;
+	return len;
+}
+
+/*
+ * Vector Fletcher sums go as for Adler-32: over a block of n bytes starting
+ * with sums c0 and c1, c0 grows by the sum of the bytes and c1 by n * c0
+ * plus each byte times the number of bytes from it to the end of the block.
+ * Blocks are small enough for neither 32-bit lanes nor 64-bit totals to
+ * overflow.
+ */
+#define FLETCHER_BLOCK 4096U
+
+static void fletcher_block_add(uint32_t *c0, uint32_t *c1, size_t n,
+			       uint64_t s1, uint64_t s1_prev, unsigned int width,
+			       uint64_t s2)
+{
+	*c1 = (*c1 + n * *c0 + width * s1_prev + s2) % 255;
+	*c0 = (*c0 + s1) % 255;
+}
+
+#ifdef CHECKSUM_X86
+static bool checksum_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool checksum_ssse3_supported(void)
+{
+	return __builtin_cpu_supports("ssse3");
+}
+
+__attribute__((target("avx2"))) static uint64_t hsum256_u32(__m256i v)
+{
+	uint32_t lanes[8];
+	uint64_t sum = 0;
+	unsigned int i;
+
+	_mm256_storeu_si256((__m256i *)lanes, v);
+	for (i = 0; i < 8; i++)
+		sum += lanes[i];
+	return sum;
+}
+
+__attribute__((target("sse2"))) static uint64_t hsum128_u32(__m128i v)
+{
+	uint32_t lanes[4];
+
+	_mm_storeu_si128((__m128i *)lanes, v);
+	return (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx2"))) static size_t
+in_sum_avx2(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0, steps;
+	__m256i acc, v;
+
+	while (len - i >= 32) {
+		/* 32-bit lanes take up to 2 * 0xffff a step */
+		acc = zero;
+		for (steps = 0; steps < 16384 && len - i >= 32; steps++) {
+			v = _mm256_loadu_si256((const __m256i *)(buf + i));
+			acc = _mm256_add_epi32(acc,
+					       _mm256_unpacklo_epi16(v, zero));
+			acc = _mm256_add_epi32(acc,
+					       _mm256_unpackhi_epi16(v, zero));
+			i += 32;
+		}
+		*sum += hsum256_u32(acc);
+	}
+	return i;
+}
+
+__attribute__((target("sse2"))) static size_t
+in_sum_sse2(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0, steps;
+	__m128i acc, v;
+
+	while (len - i >= 16) {
+		acc = zero;
+		for (steps = 0; steps < 16384 && len - i >= 16; steps++) {
+			v = _mm_loadu_si128((const __m128i *)(buf + i));
+			acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+			acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+			i += 16;
+		}
+		*sum += hsum128_u32(acc);
+	}
+	return i;
+}
+
+__attribute__((target("avx2"))) static size_t
+fletcher_sum_avx2(const uint8_t *buf, size_t len, uint32_t *c0, uint32_t *c1)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i weights = _mm256_setr_epi8(
+		32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	__m256i s1, s1_prev, s2, v;
+	size_t i = 0, n, j;
+
+	while ((n = MIN(len - i, FLETCHER_BLOCK) & ~(size_t)31)) {
+		s1 = s1_prev = s2 = zero;
+		for (j = 0; j < n; j += 32) {
+			v = _mm256_loadu_si256((const __m256i *)(buf + i + j));
+			s1_prev = _mm256_add_epi32(s1_prev, s1);
+			s1 = _mm256_add_epi32(s1, _mm256_sad_epu8(v, zero));
+			s2 = _mm256_add_epi32(
+				s2, _mm256_madd_epi16(
+					    _mm256_maddubs_epi16(v, weights),
+					    ones));
+		}
+		fletcher_block_add(c0, c1, n, hsum256_u32(s1),
+				   hsum256_u32(s1_prev), 32, hsum256_u32(s2));
+		i += n;
+	}
+	return i;
+}
+
+__attribute__((target("ssse3"))) static size_t
+fletcher_sum_ssse3(const uint8_t *buf, size_t len, uint32_t *c0, uint32_t *c1)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i weights = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8,
+					      7, 6, 5, 4, 3, 2, 1);
+	__m128i s1, s1_prev, s2, v;
+	size_t i = 0, n, j;
+
+	while ((n = MIN(len - i, FLETCHER_BLOCK) & ~(size_t)15)) {
+		s1 = s1_prev = s2 = zero;
+		for (j = 0; j < n; j += 16) {
+			v = _mm_loadu_si128((const __m128i *)(buf + i + j));
+			s1_prev = _mm_add_epi32(s1_prev, s1);
+			s1 = _mm_add_epi32(s1, _mm_sad_epu8(v, zero));
+			s2 = _mm_add_epi32(
+				s2, _mm_madd_epi16(_mm_maddubs_epi16(v, weights),
+						   ones));
+		}
+		fletcher_block_add(c0, c1, n, hsum128_u32(s1),
+				   hsum128_u32(s1_prev), 16, hsum128_u32(s2));
+		i += n;
+	}
+	return i;
+}
+#endif /* CHECKSUM_X86 */
+
+#ifdef CHECKSUM_NEON
+static bool checksum_neon_supported(void)
+{
+	return true;
+}
+
+static size_t in_sum_neon(const uint8_t *buf, size_t len, uint64_t *sum)
+{
+	uint64x2_t total = vdupq_n_u64(0);
+	uint32x4_t acc;
+	size_t i = 0, steps;
+
+	while (len - i >= 16) {
+		/* 32-bit lanes take up to 2 * 0xffff a step */
+		acc = vdupq_n_u32(0);
+		for (steps = 0; steps < 16384 && len - i >= 16; steps++) {
+			acc = vpadalq_u16(acc,
+					  vreinterpretq_u16_u8(vld1q_u8(buf + i)));
+			i += 16;
+		}
+		total = vpadalq_u32(total, acc);
+	}
+	*sum += vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+	return i;
+}
+
+static size_t fletcher_sum_neon(const uint8_t *buf, size_t len, uint32_t *c0,
+				uint32_t *c1)
+{
+	static const uint8_t weights[16] = {16, 15, 14, 13, 12, 11, 10, 9,
+					    8,  7,  6,  5,  4,  3,  2,  1};
+	const uint8x8_t w_lo = vld1_u8(weights), w_hi = vld1_u8(weights + 8);
+	uint32x4_t s1, s1_prev, s2;
+	uint16x8_t m;
+	uint8x16_t v;
+	size_t i = 0, n, j;
+
+	while ((n = MIN(len - i, FLETCHER_BLOCK) & ~(size_t)15)) {
+		s1 = s1_prev = s2 = vdupq_n_u32(0);
+		for (j = 0; j < n; j += 16) {
+			v = vld1q_u8(buf + i + j);
+			s1_prev = vaddq_u32(s1_prev, s1);
+			s1 = vpadalq_u16(s1, vpaddlq_u8(v));
+			m = vmull_u8(vget_low_u8(v), w_lo);
+			m = vmlal_u8(m, vget_high_u8(v), w_hi);
+			s2 = vpadalq_u16(s2, m);
+		}
+		fletcher_block_add(c0, c1, n, vaddlvq_u32(s1),
+				   vaddlvq_u32(s1_prev), 16, vaddlvq_u32(s2));
+		i += n;
+	}
+	return i;
+}
+#endif /* CHECKSUM_NEON */
+
+static bool checksum_generic_supported(void)
+{
+	return true;
+}
+
+/* fastest first */
+static const struct checksum_impl checksum_impls[] = {
+#ifdef CHECKSUM_X86
+	{
+		.name = "avx2",
+		.supported = checksum_avx2_supported,
+		.in_sum = in_sum_avx2,
+		.fletcher_sum = fletcher_sum_avx2,
+	},
+	{
+		.name = "ssse3",
+		.supported = checksum_ssse3_supported,
+		.in_sum = in_sum_sse2,
+		.fletcher_sum = fletcher_sum_ssse3,
+	},
+#endif
+#ifdef CHECKSUM_NEON
+	{
+		.name = "neon",
+		.supported = checksum_neon_supported,
+		.in_sum = in_sum_neon,
+		.fletcher_sum = fletcher_sum_neon,
+	},
+#endif
+	{
+		.name = "generic",
+		.supported = checksum_generic_supported,
+		.in_sum = in_sum_generic,
+		.fletcher_sum = fletcher_sum_generic,
+	},
+};
+
+static const struct checksum_impl *checksum_cur =
+	&checksum_impls[array_size(checksum_impls) - 1];
+
+const char *checksum_impl_set(const char *name)
+{
+	const struct checksum_impl *impl;
+
+	for (impl = checksum_impls;
+	     impl < checksum_impls + array_size(checksum_impls); impl++) {
+		if (name ? strcmp(impl->name, name) : !impl->supported())
+			continue;
+		if (!impl->supported())
+			return NULL;
+		checksum_cur = impl;
+		return impl->name;
+	}
+	return NULL;
+}
+
+static void checksum_init(void) __attribute__((_CONSTRUCTOR(1000)));
+static void checksum_init(void)
+{
+#ifdef CHECKSUM_X86
+	__builtin_cpu_init();
+#endif
+	checksum_impl_set(NULL);
+}
 
 int /* return checksum in low-order 16 bits */
 	in_cksum(void *parg, int nbytes)
 {
-	unsigned short *ptr = parg;
-	register long sum; /* assumes long == 32 bits */
-	unsigned short oddbyte;
-	register unsigned short answer; /* assumes unsigned short == 16 bits */
+	const uint8_t *ptr = parg;
+	size_t len = nbytes, done;
+	uint64_t sum = 0; /* cannot overflow for any int nbytes */
+	unsigned short word, oddbyte;
+	unsigned short answer;
 
 	/*
-	 * Our algorithm is simple, using a 32-bit accumulator (sum),
-	 * we add sequential 16-bit words to it, and at the end, fold back
-	 * all the carry bits from the top 16 bits into the lower 16 bits.
+	 * Sum words as wide as the implementation likes, the generic one
+	 * doing what is left in 32-bit ones; at the end, fold back all the
+	 * carry bits from the top bits into the lower 16 bits.
 	 */
+	done = checksum_cur->in_sum(ptr, len, &sum);
+	done += in_sum_generic(ptr + done, len - done, &sum);
 
-	sum = 0;
-	while (nbytes > 1) {
-		sum += *ptr++;
-		nbytes -= 2;
+	if (len - done >= 2) {
+		memcpy(&word, ptr + done, sizeof(word));
+		sum += word;
+		done += 2;
 	}
 
 	/* mop up an odd byte, if necessary */
-	if (nbytes == 1) {
+	if (len - done == 1) {
 		oddbyte = 0; /* make sure top half is zero */
-		*((uint8_t *)&oddbyte) = *(uint8_t *)ptr; /* one byte only */
+		*((uint8_t *)&oddbyte) = ptr[done]; /* one byte only */
 		sum += oddbyte;
 	}
 
 	/*
-	 * Add back carry outs from top 16 bits to low 16 bits.
+	 * Add back carry outs from top bits to low 16 bits.
 	 */
-
-	sum = (sum >> 16) + (sum & 0xffff); /* add high-16 to low-16 */
-	sum += (sum >> 16);		    /* add carry */
+	while (sum >> 16)
+		sum = (sum >> 16) + (sum & 0xffff);
 	answer = ~sum; /* ones-complement, then truncate to 16 bits */
 	return (answer);
 }
 
-/* Fletcher Checksum -- Refer to RFC1008. */
-#define MODX                 4102U   /* 5802 should be fine */
-
 /* To be consistent, offset is 0-based index, rather than the 1-based
    index required in the specification ISO 8473, Annex C.1 */
 /* calling with offset == FLETCHER_CHECKSUM_VALIDATE will validate the checksum
@@ -56,11 +396,11 @@ int /* return checksum in low-order 16 bits */
 uint16_t fletcher_checksum(uint8_t *buffer, const size_t len,
 			   const uint16_t offset)
 {
-	uint8_t *p;
 	int x, y, c0, c1;
+	uint32_t s0 = 0, s1 = 0;
 	uint16_t checksum = 0;
 	uint16_t *csum;
-	size_t partial_len, i, left = len;
+	size_t done;
 
 	if (offset != FLETCHER_CHECKSUM_VALIDATE)
 	/* Zero the csum in the packet. */
@@ -71,23 +411,10 @@ uint16_t fletcher_checksum(uint8_t *buffer, const size_t len,
 		*(csum) = 0;
 	}
 
-	p = buffer;
-	c0 = 0;
-	c1 = 0;
-
-	while (left != 0) {
-		partial_len = MIN(left, MODX);
-
-		for (i = 0; i < partial_len; i++) {
-			c0 = c0 + *(p++);
-			c1 += c0;
-		}
-
-		c0 = c0 % 255;
-		c1 = c1 % 255;
-
-		left -= partial_len;
-	}
+	done = checksum_cur->fletcher_sum(buffer, len, &s0, &s1);
+	fletcher_sum_generic(buffer + done, len - done, &s0, &s1);
+	c0 = s0;
+	c1 = s1;
 
 	/* The cast is important, to ensure the mod is taken as a signed value.
 	 */
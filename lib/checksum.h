@@ -2,3 +2,11 @@ extern int in_cksum(void *, int);
 #define FLETCHER_CHECKSUM_VALIDATE 0xffff
 extern uint16_t fletcher_checksum(uint8_t *, const size_t len,
 				  const uint16_t offset);
+
+/*
+ * Picks the implementation of the checksums by name, "generic" always being
+ * there, or the fastest the CPU supports if NULL, as done at startup.
+ *
+ * @return the name of the one picked, NULL if the CPU does not support it
+ */
+extern const char *checksum_impl_set(const char *name);
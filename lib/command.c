@@ -37,6 +37,8 @@
 #include "vty.h"
 #include "command.h"
 #include "workqueue.h"
+#include "taskpool.h"
+#include "trace.h"
 #include "vrf.h"
 #include "command_match.h"
 #include "command_graph.h"
@@ -48,6 +50,7 @@
 DEFINE_MTYPE(LIB, HOST, "Host config")
 DEFINE_MTYPE(LIB, STRVEC, "String vector")
 DEFINE_MTYPE(LIB, COMPLETION, "Completion item")
+DEFINE_MTYPE_STATIC(LIB, CMD_DEFERRED, "Deferred config action")
 
 const char *node_names[] = {
 	"auth",			    // AUTH_NODE,
@@ -120,6 +123,7 @@ const char *node_names[] = {
 				     */
 	"bgp ipv6 flowspec",	    /* BGP_FLOWSPECV6_NODE
 				     */
+	"bmp",			    // BMP_NODE
 };
 
 /* Command vector which includes some level of command lists. Normally
@@ -1825,6 +1829,117 @@ int cmd_hostname_set(const char *hostname)
 	return CMD_SUCCESS;
 }
 
+/* Configuration transactions ---------------------------------------------- */
+
+struct cmd_deferred {
+	struct cmd_deferred *next;
+	void (*func)(const char *name);
+	char *name;
+};
+
+/* nesting depth of open transactions */
+static unsigned int cmd_config_depth;
+/* actions deferred meanwhile, oldest first */
+static struct cmd_deferred *cmd_deferred_head, **cmd_deferred_tail =
+	&cmd_deferred_head;
+static struct hash *cmd_deferred_hash;
+
+static unsigned int cmd_deferred_key(void *arg)
+{
+	struct cmd_deferred *d = arg;
+
+	return jhash(&d->func, sizeof(d->func),
+		     d->name ? string_hash_make(d->name) : 0);
+}
+
+static int cmd_deferred_cmp(const void *a, const void *b)
+{
+	const struct cmd_deferred *da = a, *db = b;
+
+	if (da->func != db->func)
+		return 0;
+	if (!da->name || !db->name)
+		return da->name == db->name;
+	return !strcmp(da->name, db->name);
+}
+
+void cmd_config_begin(void)
+{
+	cmd_config_depth++;
+}
+
+bool cmd_config_loading(void)
+{
+	return cmd_config_depth > 0;
+}
+
+bool cmd_config_defer(void (*func)(const char *name), const char *name)
+{
+	struct cmd_deferred tmp = {.func = func, .name = (char *)name}, *d;
+
+	if (!cmd_config_depth)
+		return false;
+
+	if (!cmd_deferred_hash)
+		cmd_deferred_hash = hash_create(cmd_deferred_key,
+						cmd_deferred_cmp,
+						"Deferred config actions");
+	if (hash_lookup(cmd_deferred_hash, &tmp))
+		return true;
+
+	d = XCALLOC(MTYPE_CMD_DEFERRED, sizeof(*d));
+	d->func = func;
+	d->name = name ? XSTRDUP(MTYPE_CMD_DEFERRED, name) : NULL;
+	hash_get(cmd_deferred_hash, d, hash_alloc_intern);
+	*cmd_deferred_tail = d;
+	cmd_deferred_tail = &d->next;
+	return true;
+}
+
+void cmd_config_commit(void)
+{
+	struct cmd_deferred *d;
+
+	if (!cmd_config_depth || --cmd_config_depth)
+		return;
+
+	if (cmd_deferred_hash)
+		hash_clean(cmd_deferred_hash, NULL);
+
+	while ((d = cmd_deferred_head)) {
+		cmd_deferred_head = d->next;
+		d->func(d->name);
+		XFREE(MTYPE_CMD_DEFERRED, d->name);
+		XFREE(MTYPE_CMD_DEFERRED, d);
+	}
+	cmd_deferred_tail = &cmd_deferred_head;
+}
+
+/* Sent by "vtysh -b" around the configuration it feeds the daemon */
+DEFUN_HIDDEN (start_config,
+	      start_config_cmd,
+	      "XFRR_start_configuration",
+	      "The Beginning of Configuration\n")
+{
+	if (!vty->config_xact) {
+		vty->config_xact = true;
+		cmd_config_begin();
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN_HIDDEN (end_config,
+	      end_config_cmd,
+	      "XFRR_end_configuration",
+	      "The End of Configuration\n")
+{
+	if (vty->config_xact) {
+		vty->config_xact = false;
+		cmd_config_commit();
+	}
+	return CMD_SUCCESS;
+}
+
 /* Hostname configuration */
 DEFUN (config_hostname,
        hostname_cmd,
@@ -2148,6 +2263,14 @@ DEFUN (show_logging,
 			zl->filename);
 	vty_out(vty, "\n");
 
+	vty_out(vty, "Asynchronous logging: ");
+	if (zlog_async_running())
+		vty_out(vty, "enabled, %" PRIu64 " messages dropped",
+			zlog_async_dropped());
+	else
+		vty_out(vty, "disabled");
+	vty_out(vty, "\n");
+
 	vty_out(vty, "Protocol name: %s\n", zl->protoname);
 	vty_out(vty, "Record priority: %s\n",
 		(zl->record_priority ? "enabled" : "disabled"));
@@ -2657,7 +2780,9 @@ void cmd_init(int terminal)
 		install_default(CONFIG_NODE);
 
 		thread_cmd_init();
+		trace_cmd_init();
 		workqueue_cmd_init();
+		taskpool_cmd_init();
 		hash_cmd_init();
 	}
 
@@ -2699,6 +2824,8 @@ void cmd_init(int terminal)
 		install_element(CONFIG_NODE, &no_banner_motd_cmd);
 		install_element(CONFIG_NODE, &service_terminal_length_cmd);
 		install_element(CONFIG_NODE, &no_service_terminal_length_cmd);
+		install_element(CONFIG_NODE, &start_config_cmd);
+		install_element(CONFIG_NODE, &end_config_cmd);
 
 		vrf_install_commands();
 	}
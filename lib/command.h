@@ -142,6 +142,7 @@ enum node_type {
 			  connections.*/
 	BGP_FLOWSPECV4_NODE,	/* BGP IPv4 FLOWSPEC Address-Family */
 	BGP_FLOWSPECV6_NODE,	/* BGP IPv6 FLOWSPEC Address-Family */
+	BMP_NODE,		/* BGP monitoring stations */
 	NODE_TYPE_MAX, /* maximum */
 };
 
@@ -418,6 +419,21 @@ extern int cmd_execute_command(vector, struct vty *,
 			       const struct cmd_element **, int);
 extern int cmd_execute_command_strict(vector, struct vty *,
 				      const struct cmd_element **);
+/*
+ * Configuration transactions, open while a whole config is read in, e.g.
+ * the config file or what "vtysh -b" feeds the daemon.  Side effects of a
+ * command that are only worth doing once all of it is in, like
+ * re-evaluating policy for each entry added to a prefix-list, can be
+ * deferred to the commit with cmd_config_defer().  Transactions nest.
+ */
+extern void cmd_config_begin(void);
+extern void cmd_config_commit(void);
+extern bool cmd_config_loading(void);
+/* Runs func(name) at commit, once per func and name however often it was
+ * deferred; returns false if no transaction is open, to run it now. */
+extern bool cmd_config_defer(void (*func)(const char *name),
+			     const char *name);
+
 extern void cmd_init(int);
 extern void cmd_terminate(void);
 extern void cmd_exit(struct vty *vty);
@@ -31,6 +31,9 @@ DEFINE_MTYPE_STATIC(LIB, CMD_DESC, "Command Token Text")
 DEFINE_MTYPE_STATIC(LIB, CMD_TEXT, "Command Token Help")
 DEFINE_MTYPE(LIB, CMD_ARG, "Command Argument")
 DEFINE_MTYPE_STATIC(LIB, CMD_VAR, "Command Argument Name")
+DEFINE_MTYPE(LIB, CMD_FOLLOW, "Command Token Nexthops")
+
+unsigned int cmd_graph_gen;
 
 struct cmd_token *cmd_token_new(enum cmd_token_type type, uint8_t attr,
 				const char *text, const char *desc)
@@ -58,6 +61,7 @@ void cmd_token_del(struct cmd_token *token)
 	XFREE(MTYPE_CMD_DESC, token->desc);
 	XFREE(MTYPE_CMD_ARG, token->arg);
 	XFREE(MTYPE_CMD_VAR, token->varname);
+	XFREE(MTYPE_CMD_FOLLOW, token->follow);
 
 	XFREE(MTYPE_CMD_TOKENS, token);
 }
@@ -353,6 +357,7 @@ void cmd_graph_merge(struct graph *old, struct graph *new, int direction)
 	assert(vector_active(old->nodes) >= 1);
 	assert(vector_active(new->nodes) >= 1);
 
+	cmd_graph_gen++;
 	cmd_merge_nodes(old, new, vector_slot(old->nodes, 0),
 			vector_slot(new->nodes, 0), direction);
 }
@@ -33,8 +33,10 @@
 #include "graph.h"
 
 DECLARE_MTYPE(CMD_ARG)
+DECLARE_MTYPE(CMD_FOLLOW)
 
 struct vty;
+struct cmd_follow;
 
 /**
  * Types for tokens.
@@ -86,8 +88,14 @@ struct cmd_token {
 	char *varname;
 
 	struct graph_node *forkjoin; // paired FORK/JOIN for JOIN/FORK
+
+	struct cmd_follow *follow; // matcher's compiled nexthops, if any
 };
 
+/* Bumped whenever a command graph changes, invalidating the matcher's
+ * compiled nexthops. */
+extern unsigned int cmd_graph_gen;
+
 /* Structure of command element. */
 struct cmd_element {
 	const char *string; /* Command specification by string. */
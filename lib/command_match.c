@@ -79,6 +79,108 @@ static enum match_type match_variable(struct cmd_token *, const char *);
 
 static enum match_type match_mac(const char *, bool);
 
+/*
+ * Compiled nexthops of a graph node: what add_nexthops() finds without a
+ * stack, split by kind, with keywords sorted by text so the ones an input
+ * token matches are found by binary search.  Built on first use and again
+ * once cmd_graph_gen moves on.
+ */
+struct cmd_follow {
+	unsigned int gen;
+	unsigned int nwords, nother, nend;
+	struct graph_node **words; /* WORD_TKN, sorted by text */
+	struct graph_node **other; /* variables, ranges, addresses */
+	struct graph_node **ends;  /* END_TKN */
+	struct graph_node *nodes[];
+};
+
+/* walks the nexthops like add_nexthops(), counting them in *n and storing
+ * those of the given kind in out, if non-NULL */
+static void follow_walk(struct graph_node *node, int kind,
+			struct graph_node **out, unsigned int *n)
+{
+	struct graph_node *child;
+	struct cmd_token *token;
+	int ckind;
+
+	for (unsigned int i = 0; i < vector_active(node->to); i++) {
+		child = vector_slot(node->to, i);
+		token = child->data;
+		if (token->type >= SPECIAL_TKN && token->type != END_TKN) {
+			follow_walk(child, kind, out, n);
+			continue;
+		}
+
+		ckind = token->type == WORD_TKN
+				? WORD_TKN
+				: token->type == END_TKN ? END_TKN : VARIABLE_TKN;
+		if (ckind != kind)
+			continue;
+		if (out)
+			out[*n] = child;
+		(*n)++;
+	}
+}
+
+static int follow_word_cmp(const void *a, const void *b)
+{
+	const struct cmd_token *ta = (*(struct graph_node * const *)a)->data;
+	const struct cmd_token *tb = (*(struct graph_node * const *)b)->data;
+
+	return strcmp(ta->text, tb->text);
+}
+
+static struct cmd_follow *follow_get(struct graph_node *node)
+{
+	struct cmd_token *token = node->data;
+	struct cmd_follow *f = token->follow;
+	unsigned int nwords = 0, nother = 0, nend = 0;
+
+	if (f && f->gen == cmd_graph_gen)
+		return f;
+
+	XFREE(MTYPE_CMD_FOLLOW, token->follow);
+
+	follow_walk(node, WORD_TKN, NULL, &nwords);
+	follow_walk(node, VARIABLE_TKN, NULL, &nother);
+	follow_walk(node, END_TKN, NULL, &nend);
+
+	f = XMALLOC(MTYPE_CMD_FOLLOW,
+		    sizeof(*f)
+			    + (nwords + nother + nend)
+				      * sizeof(struct graph_node *));
+	f->gen = cmd_graph_gen;
+	f->words = f->nodes;
+	f->other = f->words + nwords;
+	f->ends = f->other + nother;
+
+	f->nwords = f->nother = f->nend = 0;
+	follow_walk(node, WORD_TKN, f->words, &f->nwords);
+	follow_walk(node, VARIABLE_TKN, f->other, &f->nother);
+	follow_walk(node, END_TKN, f->ends, &f->nend);
+	qsort(f->words, f->nwords, sizeof(f->words[0]), follow_word_cmp);
+
+	token->follow = f;
+	return f;
+}
+
+/* first of f's keywords that an input token may be a prefix of */
+static unsigned int follow_words_from(struct cmd_follow *f, const char *input)
+{
+	unsigned int lo = 0, hi = f->nwords, mid;
+	struct cmd_token *token;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		token = f->words[mid]->data;
+		if (strcmp(token->text, input) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 enum matcher_rv command_match(struct graph *cmdgraph, vector vline,
 			      struct list **argv, const struct cmd_element **el)
 {
@@ -131,6 +233,53 @@ enum matcher_rv command_match(struct graph *cmdgraph, vector vline,
 	return status;
 }
 
+/* Matches the rest of the input against the subgraph of a candidate
+ * nexthop, keeping the better of its match and the best one so far in
+ * currbest, and returns the new status. */
+static enum matcher_rv command_match_child(struct graph_node *gn,
+					   vector vline, unsigned int n,
+					   struct graph_node **stack,
+					   struct list **currbest,
+					   enum matcher_rv status)
+{
+	struct list *result = NULL;
+	enum matcher_rv rstat =
+		command_match_r(gn, vline, n + 1, stack, &result);
+
+	// save the best match
+	if (result && *currbest) {
+		// pick the best of two matches
+		struct list *newbest =
+			disambiguate(*currbest, result, vline, n + 1);
+
+		// current best and result are ambiguous
+		if (!newbest)
+			status = MATCHER_AMBIGUOUS;
+		// current best is still the best, but ambiguous
+		else if (newbest == *currbest && status == MATCHER_AMBIGUOUS)
+			status = MATCHER_AMBIGUOUS;
+		// result is better, but also ambiguous
+		else if (newbest == result && rstat == MATCHER_AMBIGUOUS)
+			status = MATCHER_AMBIGUOUS;
+		// one or the other is superior and not ambiguous
+		else
+			status = MATCHER_OK;
+
+		// delete the unnecessary result
+		struct list *todelete =
+			((newbest && newbest == result) ? *currbest : result);
+		del_arglist(todelete);
+
+		*currbest = newbest ? newbest : *currbest;
+	} else if (result) {
+		status = rstat;
+		*currbest = result;
+	} else if (!*currbest) {
+		status = MAX(rstat, status);
+	}
+	return status;
+}
+
 /**
  * Builds an argument list given a DFA and a matching input line.
  *
@@ -239,87 +388,56 @@ static enum matcher_rv command_match_r(struct graph_node *start, vector vline,
 
 	stack[n] = start;
 
-	// pointers for iterating linklist
-	struct listnode *ln;
+	struct cmd_follow *f = follow_get(start);
 	struct graph_node *gn;
+	unsigned int i;
 
-	// get all possible nexthops
-	struct list *next = list_new();
-	add_nexthops(next, start, NULL, 0);
-
-	// determine the best match
-	for (ALL_LIST_ELEMENTS_RO(next, ln, gn)) {
-		// if we've matched all input we're looking for END_TKN
-		if (n + 1 == vector_active(vline)) {
-			struct cmd_token *tok = gn->data;
-			if (tok->type == END_TKN) {
-				// if more than one END_TKN in the follow set
-				if (*currbest) {
-					status = MATCHER_AMBIGUOUS;
-					break;
-				} else {
-					status = MATCHER_OK;
-				}
-				*currbest = list_new();
-				// node should have one child node with the
-				// element
-				struct graph_node *leaf =
-					vector_slot(gn->to, 0);
-				// last node in the list will hold the
-				// cmd_element; this is important because
-				// list_delete() expects that all nodes have
-				// the same data type, so when deleting this
-				// list the last node must be manually deleted
-				struct cmd_element *el = leaf->data;
-				listnode_add(*currbest, el);
-				(*currbest)->del =
-					(void (*)(void *)) & cmd_token_del;
-				// do not break immediately; continue walking
-				// through the follow set to ensure that there
-				// is exactly one END_TKN
-			}
-			continue;
-		}
-
-		// else recurse on candidate child node
-		struct list *result = NULL;
-		enum matcher_rv rstat =
-			command_match_r(gn, vline, n + 1, stack, &result);
-
-		// save the best match
-		if (result && *currbest) {
-			// pick the best of two matches
-			struct list *newbest =
-				disambiguate(*currbest, result, vline, n + 1);
+	if (n + 1 == vector_active(vline)) {
+		// we've matched all input, so we're looking for END_TKN
+		for (i = 0; i < f->nend; i++) {
+			gn = f->ends[i];
 
-			// current best and result are ambiguous
-			if (!newbest)
-				status = MATCHER_AMBIGUOUS;
-			// current best is still the best, but ambiguous
-			else if (newbest == *currbest
-				 && status == MATCHER_AMBIGUOUS)
+			// if more than one END_TKN in the follow set
+			if (*currbest) {
 				status = MATCHER_AMBIGUOUS;
-			// result is better, but also ambiguous
-			else if (newbest == result
-				 && rstat == MATCHER_AMBIGUOUS)
-				status = MATCHER_AMBIGUOUS;
-			// one or the other is superior and not ambiguous
-			else
+				break;
+			} else {
 				status = MATCHER_OK;
+			}
+			*currbest = list_new();
+			// node should have one child node with the element
+			struct graph_node *leaf = vector_slot(gn->to, 0);
+			// last node in the list will hold the cmd_element;
+			// this is important because list_delete() expects
+			// that all nodes have the same data type, so when
+			// deleting this list the last node must be manually
+			// deleted
+			struct cmd_element *el = leaf->data;
+			listnode_add(*currbest, el);
+			(*currbest)->del = (void (*)(void *)) & cmd_token_del;
+			// do not break immediately; continue walking through
+			// the follow set to ensure that there is exactly one
+			// END_TKN
+		}
+	} else {
+		// recurse on the keywords the next input token may match,
+		// the others can't; then on all the other candidates
+		char *next_token = vector_slot(vline, n + 1);
+		size_t len = next_token ? strlen(next_token) : 0;
+
+		i = next_token ? follow_words_from(f, next_token) : 0;
+		for (; i < f->nwords; i++) {
+			struct cmd_token *tok = f->words[i]->data;
 
-			// delete the unnecessary result
-			struct list *todelete =
-				((newbest && newbest == result) ? *currbest
-								: result);
-			del_arglist(todelete);
-
-			*currbest = newbest ? newbest : *currbest;
-		} else if (result) {
-			status = rstat;
-			*currbest = result;
-		} else if (!*currbest) {
-			status = MAX(rstat, status);
+			if (strncmp(tok->text, next_token ? next_token : "",
+				    len))
+				break;
+			status = command_match_child(f->words[i], vline, n,
+						     stack, currbest, status);
 		}
+		for (i = 0; i < f->nother; i++)
+			status = command_match_child(f->other[i], vline, n,
+						     stack, currbest, status);
 	}
 	if (*currbest) {
 		// copy token, set arg and prepend to currbest
@@ -330,9 +448,6 @@ static enum matcher_rv command_match_r(struct graph_node *start, vector vline,
 	} else if (n + 1 == vector_active(vline) && status == MATCHER_NO_MATCH)
 		status = MATCHER_INCOMPLETE;
 
-	// cleanup
-	list_delete_and_null(&next);
-
 	return status;
 }
 
@@ -379,6 +379,8 @@ cmd_graph_parse (struct graph *graph, struct cmd_element *cmd)
 {
   struct parser_ctx ctx = { .graph = graph, .el = cmd };
 
+  cmd_graph_gen++;
+
   // set to 1 to enable parser traces
   yydebug = 0;
 
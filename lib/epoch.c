@@ -0,0 +1,297 @@
+/*
+ * Epoch-based reclamation, for publishing data to other pthreads.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <pthread.h>
+
+#include "epoch.h"
+#include "memory.h"
+
+DEFINE_MTYPE_STATIC(LIB, EPOCH_READER, "Epoch reader")
+DEFINE_MTYPE_STATIC(LIB, EPOCH_RETIRED, "Epoch retired object")
+
+/* Retired objects wait this long for a batch to be reclaimed, in msecs */
+#define EPOCH_RECLAIM_DELAY 10
+
+/*
+ * A read section records the global epoch it entered at; a reclaim first
+ * advances the global epoch, so later read sections record a later one, and
+ * then frees the objects retired before the oldest epoch still recorded.
+ *
+ * A reader may load the global epoch, stall, and only record it after a
+ * reclaim scanned it; the full barrier of the exchange in epoch_enter()
+ * means its loads then come after the scan, and so after the objects freed
+ * were unpublished.
+ */
+struct epoch_reader {
+	/* on readers, under epoch_mtx */
+	struct epoch_reader *next;
+	/* epoch the open read section entered at, 0 if none */
+	_Atomic uint64_t active;
+	/* owner pthread only */
+	unsigned int nest;
+};
+
+struct epoch_retired {
+	struct epoch_retired *next;
+	uint64_t epoch;
+	void *ptr;
+	void (*free_func)(void *ptr);
+};
+
+static _Atomic uint64_t epoch_global = 1;
+
+static pthread_once_t epoch_once = PTHREAD_ONCE_INIT;
+static pthread_key_t epoch_key;
+
+static pthread_mutex_t epoch_mtx = PTHREAD_MUTEX_INITIALIZER;
+/* all under epoch_mtx; retired objects oldest first */
+static struct epoch_reader *readers;
+static struct epoch_retired *retired, **retired_tail = &retired;
+static struct thread_master *epoch_master;
+static bool epoch_scheduled;
+
+static void epoch_reader_del(void *arg)
+{
+	struct epoch_reader *reader = arg, **prev;
+
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		for (prev = &readers; *prev != reader; prev = &(*prev)->next)
+			;
+		*prev = reader->next;
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+
+	XFREE(MTYPE_EPOCH_READER, reader);
+}
+
+static void epoch_key_init(void)
+{
+	pthread_key_create(&epoch_key, epoch_reader_del);
+}
+
+void epoch_thread_register(void)
+{
+	struct epoch_reader *reader;
+
+	pthread_once(&epoch_once, epoch_key_init);
+	if (pthread_getspecific(epoch_key))
+		return;
+
+	reader = XCALLOC(MTYPE_EPOCH_READER, sizeof(*reader));
+	pthread_setspecific(epoch_key, reader);
+
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		reader->next = readers;
+		readers = reader;
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+}
+
+void epoch_thread_unregister(void)
+{
+	struct epoch_reader *reader;
+
+	pthread_once(&epoch_once, epoch_key_init);
+	reader = pthread_getspecific(epoch_key);
+	if (!reader)
+		return;
+
+	assert(!reader->nest);
+	pthread_setspecific(epoch_key, NULL);
+	epoch_reader_del(reader);
+}
+
+void epoch_enter(void)
+{
+	struct epoch_reader *reader = pthread_getspecific(epoch_key);
+
+	assert(reader);
+	if (reader->nest++)
+		return;
+
+	atomic_exchange_explicit(
+		&reader->active,
+		atomic_load_explicit(&epoch_global, memory_order_seq_cst),
+		memory_order_seq_cst);
+}
+
+void epoch_exit(void)
+{
+	struct epoch_reader *reader = pthread_getspecific(epoch_key);
+
+	assert(reader && reader->nest);
+	if (--reader->nest)
+		return;
+
+	atomic_store_explicit(&reader->active, 0, memory_order_release);
+}
+
+/* Oldest epoch a read section is open at, advancing the global one first;
+ * under epoch_mtx. */
+static uint64_t epoch_oldest(void)
+{
+	struct epoch_reader *reader;
+	uint64_t oldest, active;
+
+	oldest = atomic_fetch_add_explicit(&epoch_global, 1,
+					   memory_order_seq_cst)
+		 + 1;
+	for (reader = readers; reader; reader = reader->next) {
+		active = atomic_load_explicit(&reader->active,
+					      memory_order_seq_cst);
+		if (active && active < oldest)
+			oldest = active;
+	}
+	return oldest;
+}
+
+unsigned int epoch_reclaim(void)
+{
+	struct epoch_retired *done, *item, **last;
+	unsigned int n = 0;
+	uint64_t oldest;
+
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		oldest = epoch_oldest();
+
+		for (last = &retired; *last && (*last)->epoch < oldest;
+		     last = &(*last)->next)
+			;
+		if (last == &retired)
+			done = NULL;
+		else {
+			done = retired;
+			retired = *last;
+			*last = NULL;
+			if (!retired)
+				retired_tail = &retired;
+		}
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+
+	/* free functions may take locks of their own */
+	while ((item = done)) {
+		done = item->next;
+		item->free_func(item->ptr);
+		XFREE(MTYPE_EPOCH_RETIRED, item);
+		n++;
+	}
+	return n;
+}
+
+static int epoch_reclaim_task(struct thread *t)
+{
+	epoch_reclaim();
+
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		if (retired && epoch_master)
+			thread_add_timer_msec(epoch_master, epoch_reclaim_task,
+					      NULL, EPOCH_RECLAIM_DELAY, NULL);
+		else
+			epoch_scheduled = false;
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+	return 0;
+}
+
+void epoch_retire(void *ptr, void (*free_func)(void *ptr))
+{
+	struct epoch_retired *item;
+
+	if (!ptr)
+		return;
+
+	item = XMALLOC(MTYPE_EPOCH_RETIRED, sizeof(*item));
+	item->next = NULL;
+	item->ptr = ptr;
+	item->free_func = free_func;
+
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		item->epoch =
+			atomic_load_explicit(&epoch_global, memory_order_seq_cst);
+		*retired_tail = item;
+		retired_tail = &item->next;
+
+		if (epoch_master && !epoch_scheduled) {
+			epoch_scheduled = true;
+			thread_add_timer_msec(epoch_master, epoch_reclaim_task,
+					      NULL, EPOCH_RECLAIM_DELAY, NULL);
+		}
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+}
+
+void epoch_synchronize(void)
+{
+	struct epoch_reader *self, *reader;
+	uint64_t target;
+	bool waiting;
+
+	pthread_once(&epoch_once, epoch_key_init);
+	self = pthread_getspecific(epoch_key);
+	assert(!self || !self->nest);
+
+	target = atomic_fetch_add_explicit(&epoch_global, 1,
+					   memory_order_seq_cst)
+		 + 1;
+	do {
+		waiting = false;
+		pthread_mutex_lock(&epoch_mtx);
+		for (reader = readers; reader && !waiting;
+		     reader = reader->next) {
+			uint64_t active = atomic_load_explicit(
+				&reader->active, memory_order_seq_cst);
+
+			waiting = active && active < target;
+		}
+		pthread_mutex_unlock(&epoch_mtx);
+
+		if (waiting)
+			sched_yield();
+	} while (waiting);
+}
+
+void epoch_init(struct thread_master *master)
+{
+	epoch_thread_register();
+
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		epoch_master = master;
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+}
+
+void epoch_finish(void)
+{
+	pthread_mutex_lock(&epoch_mtx);
+	{
+		epoch_master = NULL;
+		epoch_scheduled = false;
+	}
+	pthread_mutex_unlock(&epoch_mtx);
+
+	epoch_synchronize();
+	epoch_reclaim();
+	epoch_thread_unregister();
+}
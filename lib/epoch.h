@@ -0,0 +1,82 @@
+/*
+ * Epoch-based reclamation, for publishing data to other pthreads.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_EPOCH_H_
+#define _FRR_EPOCH_H_
+
+#include "frratomic.h"
+#include "thread.h"
+
+/*
+ * Lets pthreads read structured data, e.g. a peer's policy or capability
+ * set, that another pthread replaces at any time, without locks:
+ *
+ *  writer				reader
+ *    new = copy of old, changed	  epoch_enter();
+ *    epoch_publish(&p, new);		  cur = epoch_deref(&p);
+ *    epoch_retire(old, free_func);	  ... use cur, never modify it ...
+ *					  epoch_exit();
+ *
+ * A retired object is freed, from the event loop epoch_init() was given,
+ * once no pthread is still in a read section it entered before the object
+ * was retired.  Read sections should be short, e.g. one packet; a pthread
+ * stuck in one holds up freeing everything retired after it entered.
+ *
+ * Any pthread reading must be registered: frr_pthreads are, from their
+ * default event loop, as is the pthread calling epoch_init().
+ */
+
+/* Sets up reclamation; retired objects are freed by tasks on master. */
+extern void epoch_init(struct thread_master *master);
+/* Frees everything retired, waiting for readers as needed. */
+extern void epoch_finish(void);
+
+/* Registers the calling pthread as a reader, or undoes that before it
+ * exits; no-op if it is, or is not, registered already. */
+extern void epoch_thread_register(void);
+extern void epoch_thread_unregister(void);
+
+/* Read sections; they nest. */
+extern void epoch_enter(void);
+extern void epoch_exit(void);
+
+/*
+ * Hands an object no longer published to be freed once no reader can have
+ * it any more; may be called from any pthread.
+ *
+ * @param ptr		the object, may be NULL
+ * @param free_func	frees it
+ */
+extern void epoch_retire(void *ptr, void (*free_func)(void *ptr));
+
+/* Frees what no reader can have any more, returns how many objects were
+ * freed; the tasks epoch_init() sets up call this. */
+extern unsigned int epoch_reclaim(void);
+
+/*
+ * Waits until every read section open at the time of the call has been
+ * left; not to be called from a read section.
+ */
+extern void epoch_synchronize(void);
+
+/* Publishes an object; it must be fully set up. */
+#define epoch_publish(pp, ptr)                                                 \
+	atomic_store_explicit(pp, ptr, memory_order_seq_cst)
+/* Gets a published object, only valid until epoch_exit(). */
+#define epoch_deref(pp) atomic_load_explicit(pp, memory_order_acquire)
+
+#endif /* _FRR_EPOCH_H_ */
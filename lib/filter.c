@@ -29,10 +29,12 @@
 #include "log.h"
 #include "routemap.h"
 #include "libfrr.h"
+#include "table.h"
 
 DEFINE_MTYPE_STATIC(LIB, ACCESS_LIST, "Access List")
 DEFINE_MTYPE_STATIC(LIB, ACCESS_LIST_STR, "Access List Str")
 DEFINE_MTYPE_STATIC(LIB, ACCESS_FILTER, "Access Filter")
+DEFINE_MTYPE_STATIC(LIB, ACCESS_FILTER_INDEX, "Access Filter Index")
 
 struct filter_cisco {
 	/* Cisco access-list */
@@ -199,6 +201,128 @@ static int filter_match_zebra(struct filter *mfilter, struct prefix *p)
 		return 0;
 }
 
+/*
+ * Access lists made only of zebra-style filters of one address family can
+ * be matched through a prefix tree instead of filter by filter: every
+ * filter matching a prefix sits on that prefix's path to the root, so a
+ * lookup only has to find the first one in list order among those.  Each
+ * node keeps the first non-exact and the first exact filter for its
+ * prefix.  Short lists and lists with cisco-style (wildcard mask) filters
+ * are still walked.  The index is built on the first lookup after the
+ * list changed.
+ */
+#define ACCESS_LIST_INDEX_MIN 8
+
+struct filter_index_node {
+	/* position in the list of the first matching filter, -1 if none */
+	int seq;
+	enum filter_type type;
+	int exact_seq;
+	enum filter_type exact_type;
+};
+
+static void access_list_index_free(struct access_list *access)
+{
+	struct route_node *rn;
+
+	if (access->index) {
+		for (rn = route_top(access->index); rn; rn = route_next(rn))
+			if (rn->info) {
+				XFREE(MTYPE_ACCESS_FILTER_INDEX, rn->info);
+				rn->info = NULL;
+			}
+		route_table_finish(access->index);
+		access->index = NULL;
+	}
+	access->index_valid = false;
+}
+
+static void access_list_index_build(struct access_list *access)
+{
+	struct filter *filter;
+	struct filter_index_node *fin;
+	struct route_node *rn;
+	struct prefix p;
+	int count = 0;
+	int seq;
+
+	access_list_index_free(access);
+	access->index_valid = true;
+
+	for (filter = access->head; filter; filter = filter->next) {
+		if (filter->cisco)
+			return;
+		p = filter->u.zfilter.prefix;
+		if (p.family != AF_INET && p.family != AF_INET6)
+			return;
+		if (p.family != access->head->u.zfilter.prefix.family)
+			return;
+		count++;
+	}
+	if (count < ACCESS_LIST_INDEX_MIN)
+		return;
+
+	access->index = route_table_init();
+	for (filter = access->head, seq = 0; filter;
+	     filter = filter->next, seq++) {
+		prefix_copy(&p, &filter->u.zfilter.prefix);
+		apply_mask(&p);
+
+		rn = route_node_get(access->index, &p);
+		if (rn->info) {
+			fin = rn->info;
+			route_unlock_node(rn);
+		} else {
+			fin = XCALLOC(MTYPE_ACCESS_FILTER_INDEX, sizeof(*fin));
+			fin->seq = fin->exact_seq = -1;
+			rn->info = fin;
+		}
+
+		if (filter->u.zfilter.exact) {
+			if (fin->exact_seq < 0) {
+				fin->exact_seq = seq;
+				fin->exact_type = filter->type;
+			}
+		} else if (fin->seq < 0) {
+			fin->seq = seq;
+			fin->type = filter->type;
+		}
+	}
+}
+
+static enum filter_type access_list_index_apply(struct access_list *access,
+						struct prefix *p)
+{
+	struct filter_index_node *fin;
+	struct route_node *rn, *match;
+	enum filter_type type = FILTER_DENY;
+	int best = -1;
+
+	if (p->family != access->head->u.zfilter.prefix.family)
+		return FILTER_DENY;
+
+	match = route_node_match(access->index, p);
+	for (rn = match; rn; rn = rn->parent) {
+		fin = rn->info;
+		if (!fin)
+			continue;
+
+		if (fin->seq >= 0 && (best < 0 || fin->seq < best)) {
+			best = fin->seq;
+			type = fin->type;
+		}
+		if (fin->exact_seq >= 0 && rn->p.prefixlen == p->prefixlen
+		    && (best < 0 || fin->exact_seq < best)) {
+			best = fin->exact_seq;
+			type = fin->exact_type;
+		}
+	}
+	if (match)
+		route_unlock_node(match);
+
+	return type;
+}
+
 /* Allocate new access list structure. */
 static struct access_list *access_list_new(void)
 {
@@ -224,6 +348,7 @@ static void access_list_delete(struct access_list *access)
 		next = filter->next;
 		filter_free(filter);
 	}
+	access_list_index_free(access);
 
 	master = access->master;
 
@@ -380,6 +505,11 @@ enum filter_type access_list_apply(struct access_list *access, void *object)
 	if (access == NULL)
 		return FILTER_DENY;
 
+	if (!access->index_valid)
+		access_list_index_build(access);
+	if (access->index)
+		return access_list_index_apply(access, p);
+
 	for (filter = access->head; filter; filter = filter->next) {
 		if (filter->cisco) {
 			if (filter_match_cisco(filter, p))
@@ -421,6 +551,7 @@ static void access_list_filter_add(struct access_list *access,
 	else
 		access->head = filter;
 	access->tail = filter;
+	access_list_index_free(access);
 
 	/* Run hook function. */
 	if (access->master->add_hook)
@@ -457,6 +588,7 @@ static void access_list_filter_delete(struct access_list *access,
 		access->head = filter->next;
 
 	filter_free(filter);
+	access_list_index_free(access);
 
 	route_map_notify_dependencies(access->name, RMAP_EVENT_FILTER_DELETED);
 	/* Run hook function. */
@@ -51,6 +51,10 @@ struct access_list {
 
 	struct filter *head;
 	struct filter *tail;
+
+	/* Prefix index of the filters, see access_list_index_build() */
+	struct route_table *index;
+	bool index_valid;
 };
 
 /* Prototypes for access-list. */
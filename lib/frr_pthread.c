@@ -24,6 +24,7 @@
 #include "frr_pthread.h"
 #include "memory.h"
 #include "hash.h"
+#include "epoch.h"
 
 DEFINE_MTYPE(LIB, FRR_PTHREAD, "FRR POSIX Thread");
 DEFINE_MTYPE(LIB, PTHREAD_PRIM, "POSIX synchronization primitives");
@@ -73,12 +74,14 @@ void frr_pthread_init()
 	pthread_mutex_unlock(&frr_pthread_hash_mtx);
 }
 
+static void frr_pthread_destroy_nolock(struct frr_pthread *fpt);
+
 void frr_pthread_finish()
 {
 	pthread_mutex_lock(&frr_pthread_hash_mtx);
 	{
 		hash_clean(frr_pthread_hash,
-			   (void (*)(void *))frr_pthread_destroy);
+			   (void (*)(void *))frr_pthread_destroy_nolock);
 		hash_free(frr_pthread_hash);
 	}
 	pthread_mutex_unlock(&frr_pthread_hash_mtx);
@@ -94,7 +97,11 @@ struct frr_pthread *frr_pthread_new(struct frr_pthread_attr *attr,
 
 	pthread_mutex_lock(&frr_pthread_hash_mtx);
 	{
-		holder.attr.id = attr->id;
+		/* every pthread started with the defaults gets its own id */
+		if (attr == &frr_pthread_attr_default)
+			holder.attr.id = frr_pthread_get_id();
+		else
+			holder.attr.id = attr->id;
 
 		if (!hash_lookup(frr_pthread_hash, &holder)) {
 			fpt = XCALLOC(MTYPE_FRR_PTHREAD,
@@ -107,8 +114,7 @@ struct frr_pthread *frr_pthread_new(struct frr_pthread_attr *attr,
 			fpt->attr = *attr;
 			name = (name ? name : "Anonymous thread");
 			fpt->name = XSTRDUP(MTYPE_FRR_PTHREAD, name);
-			if (attr == &frr_pthread_attr_default)
-				fpt->attr.id = frr_pthread_get_id();
+			fpt->attr.id = holder.attr.id;
 			/* initialize startup synchronization primitives */
 			fpt->running_cond_mtx = XCALLOC(
 				MTYPE_PTHREAD_PRIM, sizeof(pthread_mutex_t));
@@ -126,7 +132,7 @@ struct frr_pthread *frr_pthread_new(struct frr_pthread_attr *attr,
 	return fpt;
 }
 
-void frr_pthread_destroy(struct frr_pthread *fpt)
+static void frr_pthread_destroy_nolock(struct frr_pthread *fpt)
 {
 	thread_master_free(fpt->master);
 
@@ -140,6 +146,17 @@ void frr_pthread_destroy(struct frr_pthread *fpt)
 	XFREE(MTYPE_FRR_PTHREAD, fpt);
 }
 
+void frr_pthread_destroy(struct frr_pthread *fpt)
+{
+	pthread_mutex_lock(&frr_pthread_hash_mtx);
+	{
+		hash_release(frr_pthread_hash, fpt);
+	}
+	pthread_mutex_unlock(&frr_pthread_hash_mtx);
+
+	frr_pthread_destroy_nolock(fpt);
+}
+
 void frr_pthread_set_name(struct frr_pthread *fpt, const char *name)
 {
 	pthread_mutex_lock(&fpt->mtx);
@@ -179,6 +196,8 @@ int frr_pthread_run(struct frr_pthread *fpt, const pthread_attr_t *attr)
 	 */
 	if (ret < 0)
 		memset(&fpt->thread, 0x00, sizeof(fpt->thread));
+	else
+		thread_affinity_apply(fpt->name, fpt->thread);
 
 	return ret;
 }
@@ -267,7 +286,7 @@ static int fpt_finish(struct thread *thread)
 /* stop function, called from other threads to halt this one */
 static int fpt_halt(struct frr_pthread *fpt, void **res)
 {
-	thread_add_event(fpt->master, &fpt_finish, fpt, 0, NULL);
+	thread_post_event(fpt->master, &fpt_finish, fpt, 0);
 	pthread_join(fpt->thread, res);
 	fpt = NULL;
 
@@ -286,6 +305,7 @@ static void *fpt_run(void *arg)
 
 	fpt->master->handle_signals = false;
 
+	epoch_thread_register();
 	frr_pthread_notify_running(fpt);
 
 	struct thread task;
@@ -295,6 +315,7 @@ static void *fpt_run(void *arg)
 		}
 	}
 
+	epoch_thread_unregister();
 	close(sleeper[1]);
 	close(sleeper[0]);
 
@@ -87,11 +87,56 @@ void *hash_alloc_intern(void *arg)
 	atomic_fetch_add_explicit(&hz->stats.ssq, (new + old) * (new - old),   \
 				  memory_order_relaxed);
 
+/* Put backet at the head of its chain in the current index. */
+static void hash_backet_link(struct hash *hash, struct hash_backet *backet)
+{
+	unsigned int index = backet->key & (hash->size - 1);
+
+	backet->next = hash->index[index];
+	hash->index[index] = backet;
+
+	int oldlen = backet->next ? backet->next->len : 0;
+	int newlen = oldlen + 1;
+
+	if (newlen == 1)
+		hash->stats.empty--;
+	else
+		backet->next->len = 0;
+
+	backet->len = newlen;
+
+	hash_update_ssq(hash, oldlen, newlen);
+}
+
+/* Move up to count buckets of the previous index over after expanding. */
+static void hash_migrate(struct hash *hash, unsigned int count)
+{
+	struct hash_backet *hb, *hbnext;
+	unsigned int end;
+
+	if (!hash->old_index)
+		return;
+
+	end = hash->old_size - hash->migrated > count ? hash->migrated + count
+						      : hash->old_size;
+
+	for (; hash->migrated < end; hash->migrated++) {
+		for (hb = hash->old_index[hash->migrated]; hb; hb = hbnext) {
+			hbnext = hb->next;
+			hash_backet_link(hash, hb);
+		}
+		hash->old_index[hash->migrated] = NULL;
+	}
+
+	if (hash->migrated == hash->old_size)
+		XFREE(MTYPE_HASH_INDEX, hash->old_index);
+}
+
 /* Expand hash if the chain length exceeds the threshold. */
 static void hash_expand(struct hash *hash)
 {
-	unsigned int i, new_size;
-	struct hash_backet *hb, *hbnext, **new_index;
+	unsigned int new_size;
+	struct hash_backet **new_index;
 
 	new_size = hash->size * 2;
 
@@ -103,34 +148,19 @@ static void hash_expand(struct hash *hash)
 	if (new_index == NULL)
 		return;
 
-	hash->stats.empty = new_size;
-
-	for (i = 0; i < hash->size; i++)
-		for (hb = hash->index[i]; hb; hb = hbnext) {
-			unsigned int h = hb->key & (new_size - 1);
-
-			hbnext = hb->next;
-			hb->next = new_index[h];
-
-			int oldlen = hb->next ? hb->next->len : 0;
-			int newlen = oldlen + 1;
-
-			if (newlen == 1)
-				hash->stats.empty--;
-			else
-				hb->next->len = 0;
+	/* the previous expansion must be done before starting another */
+	hash_migrate(hash, UINT_MAX);
 
-			hb->len = newlen;
-
-			hash_update_ssq(hash, oldlen, newlen);
-
-			new_index[h] = hb;
-		}
-
-	/* Switch to new table */
-	XFREE(MTYPE_HASH_INDEX, hash->index);
+	/* Switch to new table, every entry is in the old one */
+	hash->old_index = hash->index;
+	hash->old_size = hash->size;
+	hash->migrated = 0;
 	hash->size = new_size;
 	hash->index = new_index;
+	hash->stats.empty = new_size;
+	hash->stats.ssq = 0;
+
+	hash_migrate(hash, hash->incremental ? HASH_MIGRATE_STEP : UINT_MAX);
 }
 
 /* Lookup and return hash backet in hash.  If there is no
@@ -146,6 +176,8 @@ void *hash_get(struct hash *hash, void *data, void *(*alloc_func)(void *))
 	if (!alloc_func && !hash->count)
 		return NULL;
 
+	hash_migrate(hash, HASH_MIGRATE_STEP);
+
 	key = (*hash->hash_key)(data);
 	index = key & (hash->size - 1);
 
@@ -155,35 +187,30 @@ void *hash_get(struct hash *hash, void *data, void *(*alloc_func)(void *))
 			return backet->data;
 	}
 
+	if (hash->old_index) {
+		index = key & (hash->old_size - 1);
+		for (backet = hash->old_index[index]; backet != NULL;
+		     backet = backet->next) {
+			if (backet->key == key
+			    && (*hash->hash_cmp)(backet->data, data))
+				return backet->data;
+		}
+	}
+
 	if (alloc_func) {
 		newdata = (*alloc_func)(data);
 		if (newdata == NULL)
 			return NULL;
 
-		if (HASH_THRESHOLD(hash->count + 1, hash->size)) {
+		if (HASH_THRESHOLD(hash->count + 1, hash->size))
 			hash_expand(hash);
-			index = key & (hash->size - 1);
-		}
 
 		backet = XCALLOC(MTYPE_HASH_BACKET, sizeof(struct hash_backet));
 		backet->data = newdata;
 		backet->key = key;
-		backet->next = hash->index[index];
-		hash->index[index] = backet;
+		hash_backet_link(hash, backet);
 		hash->count++;
 
-		int oldlen = backet->next ? backet->next->len : 0;
-		int newlen = oldlen + 1;
-
-		if (newlen == 1)
-			hash->stats.empty--;
-		else
-			backet->next->len = 0;
-
-		backet->len = newlen;
-
-		hash_update_ssq(hash, oldlen, newlen);
-
 		return backet->data;
 	}
 	return NULL;
@@ -217,7 +244,31 @@ void *hash_release(struct hash *hash, void *data)
 	struct hash_backet *backet;
 	struct hash_backet *pp;
 
+	hash_migrate(hash, HASH_MIGRATE_STEP);
+
 	key = (*hash->hash_key)(data);
+
+	/* entries still in the old index aren't counted in the stats yet */
+	if (hash->old_index) {
+		index = key & (hash->old_size - 1);
+		for (backet = pp = hash->old_index[index]; backet;
+		     backet = backet->next) {
+			if (backet->key == key
+			    && (*hash->hash_cmp)(backet->data, data)) {
+				if (backet == pp)
+					hash->old_index[index] = backet->next;
+				else
+					pp->next = backet->next;
+
+				ret = backet->data;
+				XFREE(MTYPE_HASH_BACKET, backet);
+				hash->count--;
+				return ret;
+			}
+			pp = backet;
+		}
+	}
+
 	index = key & (hash->size - 1);
 
 	for (backet = pp = hash->index[index]; backet; backet = backet->next) {
@@ -256,6 +307,8 @@ void hash_iterate(struct hash *hash, void (*func)(struct hash_backet *, void *),
 	struct hash_backet *hb;
 	struct hash_backet *hbnext;
 
+	hash_migrate(hash, UINT_MAX);
+
 	for (i = 0; i < hash->size; i++)
 		for (hb = hash->index[i]; hb; hb = hbnext) {
 			/* get pointer to next hash backet here, in case (*func)
@@ -275,6 +328,8 @@ void hash_walk(struct hash *hash, int (*func)(struct hash_backet *, void *),
 	struct hash_backet *hbnext;
 	int ret = HASHWALK_CONTINUE;
 
+	hash_migrate(hash, UINT_MAX);
+
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = hbnext) {
 			/* get pointer to next hash backet here, in case (*func)
@@ -295,6 +350,8 @@ void hash_clean(struct hash *hash, void (*free_func)(void *))
 	struct hash_backet *hb;
 	struct hash_backet *next;
 
+	hash_migrate(hash, UINT_MAX);
+
 	for (i = 0; i < hash->size; i++) {
 		for (hb = hash->index[i]; hb; hb = next) {
 			next = hb->next;
@@ -330,6 +387,8 @@ void hash_free(struct hash *hash)
 	if (hash->name)
 		XFREE(MTYPE_HASH, hash->name);
 
+	if (hash->old_index)
+		XFREE(MTYPE_HASH_INDEX, hash->old_index);
 	XFREE(MTYPE_HASH_INDEX, hash->index);
 	XFREE(MTYPE_HASH, hash);
 }
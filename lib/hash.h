@@ -31,6 +31,8 @@ DECLARE_MTYPE(HASH_BACKET)
 #define HASH_INITIAL_SIZE 256
 /* Expansion threshold */
 #define HASH_THRESHOLD(used, size) ((used) > (size))
+/* Buckets moved to a grown index per operation, if incremental */
+#define HASH_MIGRATE_STEP 64
 
 #define HASHWALK_CONTINUE 0
 #define HASHWALK_ABORT -1
@@ -68,6 +70,17 @@ struct hash {
 	/* If max_size is 0 there is no limit */
 	unsigned int max_size;
 
+	/* If set, entries move to a grown index a few buckets per operation
+	 * instead of all at once.  Only walk such a hash with the functions
+	 * below, which finish any pending move first. */
+	bool incremental;
+
+	/* While growing incrementally: the previous index, with all buckets
+	 * below migrated already moved over. */
+	struct hash_backet **old_index;
+	unsigned int old_size;
+	unsigned int migrated;
+
 	/* Key make function. */
 	unsigned int (*hash_key)(void *);
 
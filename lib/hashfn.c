@@ -0,0 +1,103 @@
+/*
+ * Fast hashing of hash table keys.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "hashfn.h"
+
+/* Little-endian reads, so that results do not depend on the platform. */
+static inline uint64_t hashfn_r8(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if BYTE_ORDER == BIG_ENDIAN
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline uint64_t hashfn_r4(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if BYTE_ORDER == BIG_ENDIAN
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+/* 1 to 3 bytes, as first, middle and last. */
+static inline uint64_t hashfn_r3(const uint8_t *p, size_t len)
+{
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8)
+	       | p[len - 1];
+}
+
+uint64_t hashfn64(const void *data, size_t len, uint64_t seed)
+{
+	const uint8_t *p = data;
+	uint64_t a, b, see1, see2;
+	size_t i = len;
+
+	seed ^= hashfn_mum(seed ^ HASHFN_P0, HASHFN_P1);
+
+	if (len <= 16) {
+		if (len >= 4) {
+			/* overlapping reads cover 4 to 16 bytes */
+			a = (hashfn_r4(p) << 32)
+			    | hashfn_r4(p + ((len >> 3) << 2));
+			b = (hashfn_r4(p + len - 4) << 32)
+			    | hashfn_r4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = hashfn_r3(p, len);
+			b = 0;
+		} else
+			a = b = 0;
+	} else {
+		if (i >= 48) {
+			/* three independent lanes keep the multiplier busy */
+			see1 = see2 = seed;
+			do {
+				seed = hashfn_mum(hashfn_r8(p) ^ HASHFN_P1,
+						  hashfn_r8(p + 8) ^ seed);
+				see1 = hashfn_mum(hashfn_r8(p + 16) ^ HASHFN_P2,
+						  hashfn_r8(p + 24) ^ see1);
+				see2 = hashfn_mum(hashfn_r8(p + 32) ^ HASHFN_P3,
+						  hashfn_r8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i >= 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = hashfn_mum(hashfn_r8(p) ^ HASHFN_P1,
+					  hashfn_r8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		/* the last 16 bytes, overlapping what came before */
+		a = hashfn_r8(p + i - 16);
+		b = hashfn_r8(p + i - 8);
+	}
+
+	a ^= HASHFN_P1;
+	b ^= seed;
+	hashfn_mul128(&a, &b);
+	return hashfn_mum(a ^ HASHFN_P0 ^ len, b ^ HASHFN_P1);
+}
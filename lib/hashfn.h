@@ -0,0 +1,99 @@
+/*
+ * Fast hashing of hash table keys.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_HASHFN_H
+#define _FRR_HASHFN_H
+
+/*
+ * A non-cryptographic hash in the style of wyhash: each 16 bytes of the key
+ * go through one 64x64->128 bit multiply, folded.  This is several times
+ * faster than jhash() on the few dozen bytes keys mostly are, mixing better
+ * too.
+ *
+ * The result only depends on the bytes and the seed, the same on every
+ * platform and from one release to the next, so it may be relied upon,
+ * e.g. by tests.  It is no defence against keys chosen to collide.
+ *
+ * usage:
+ *
+ *    key = hashfn(val, len, 0x1234abcd);
+ *
+ *  or, for a key made up of fields:
+ *
+ *    h = hashfn_mix(0, attr->med, attr->local_pref);
+ *    h = hashfn_mix(h, attr->origin, attr->nexthop.s_addr);
+ *    key = hashfn_fold(h);
+ */
+
+#define HASHFN_P0 0xa0761d6478bd642fULL
+#define HASHFN_P1 0xe7037ed1a0b428dbULL
+#define HASHFN_P2 0x8ebc6af09c88c6e3ULL
+#define HASHFN_P3 0x589965cc75374cc3ULL
+
+/*
+ * The 128-bit product of *a and *b, low half in *a, high half in *b;
+ * HASHFN_NO_INT128 has tests check the code for compilers without __int128.
+ */
+static inline void hashfn_mul128(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__) && !defined(HASHFN_NO_INT128)
+	__uint128_t r = (__uint128_t)*a * *b;
+
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/* Multiplies, folding the 128-bit product to 64 bits. */
+static inline uint64_t hashfn_mum(uint64_t a, uint64_t b)
+{
+	hashfn_mul128(&a, &b);
+	return a ^ b;
+}
+
+/* Hashes len bytes to 64 bits. */
+extern uint64_t hashfn64(const void *data, size_t len, uint64_t seed);
+
+/* Narrows a 64-bit hash for a hash table key. */
+static inline uint32_t hashfn_fold(uint64_t h)
+{
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+/* Hashes len bytes to a hash table key. */
+static inline uint32_t hashfn(const void *data, size_t len, uint32_t seed)
+{
+	return hashfn_fold(hashfn64(data, len, seed));
+}
+
+/* Mixes two words into a running 64-bit hash h. */
+static inline uint64_t hashfn_mix(uint64_t h, uint64_t a, uint64_t b)
+{
+	return hashfn_mum(a ^ HASHFN_P0, b ^ h ^ HASHFN_P1);
+}
+
+#endif /* _FRR_HASHFN_H */
@@ -0,0 +1,119 @@
+/*
+ * Daemon event loop heartbeat, shared with watchfrr.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <sys/mman.h>
+
+#include "heartbeat.h"
+#include "log.h"
+
+struct frr_heartbeat *frr_heartbeat;
+static char frr_heartbeat_path[256];
+
+void frr_heartbeat_open(const char *path)
+{
+	struct frr_heartbeat *hb;
+	int fd;
+
+	if (strlcpy(frr_heartbeat_path, path, sizeof(frr_heartbeat_path))
+	    >= sizeof(frr_heartbeat_path)) {
+		frr_heartbeat_path[0] = '\0';
+		return;
+	}
+
+	/* a fresh file, so a watcher never sees a predecessor's count */
+	unlink(path);
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		zlog_warn("heartbeat %s: open failed: %s", path,
+			  safe_strerror(errno));
+		frr_heartbeat_path[0] = '\0';
+		return;
+	}
+
+	if (ftruncate(fd, sizeof(*hb)) < 0) {
+		zlog_warn("heartbeat %s: ftruncate failed: %s", path,
+			  safe_strerror(errno));
+		goto out_err;
+	}
+
+	hb = mmap(NULL, sizeof(*hb), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		  0);
+	if (hb == MAP_FAILED) {
+		zlog_warn("heartbeat %s: mmap failed: %s", path,
+			  safe_strerror(errno));
+		goto out_err;
+	}
+	close(fd);
+
+	hb->pid = getpid();
+	atomic_store_explicit(&hb->beats, 0, memory_order_relaxed);
+	atomic_store_explicit(&hb->magic, FRR_HEARTBEAT_MAGIC,
+			      memory_order_release);
+	frr_heartbeat = hb;
+	return;
+
+out_err:
+	close(fd);
+	unlink(path);
+	frr_heartbeat_path[0] = '\0';
+}
+
+void frr_heartbeat_close(void)
+{
+	if (!frr_heartbeat)
+		return;
+
+	munmap(frr_heartbeat, sizeof(*frr_heartbeat));
+	frr_heartbeat = NULL;
+	unlink(frr_heartbeat_path);
+	frr_heartbeat_path[0] = '\0';
+}
+
+const struct frr_heartbeat *frr_heartbeat_map(const char *path)
+{
+	struct frr_heartbeat *hb;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*hb)) {
+		close(fd);
+		return NULL;
+	}
+
+	hb = mmap(NULL, sizeof(*hb), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hb == MAP_FAILED)
+		return NULL;
+
+	if (atomic_load_explicit(&hb->magic, memory_order_acquire)
+	    != FRR_HEARTBEAT_MAGIC) {
+		munmap(hb, sizeof(*hb));
+		return NULL;
+	}
+	return hb;
+}
+
+void frr_heartbeat_unmap(const struct frr_heartbeat *hb)
+{
+	if (hb)
+		munmap((void *)hb, sizeof(*hb));
+}
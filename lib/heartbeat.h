@@ -0,0 +1,78 @@
+/*
+ * Daemon event loop heartbeat, shared with watchfrr.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_HEARTBEAT_H_
+#define _FRR_HEARTBEAT_H_
+
+#include "frratomic.h"
+
+/*
+ * A daemon maps a small file next to its vty socket (bgpd.vty -> bgpd.hb)
+ * and counts each task its main event loop runs there.  watchfrr maps the
+ * same file read-only: an echo going unanswered while the count moves on
+ * means the daemon is busy rather than hung, with no need to get a word
+ * in over the vty.
+ */
+#define FRR_HEARTBEAT_MAGIC 0x46524842 /* "FRHB" */
+#define FRR_HEARTBEAT_SUFFIX ".hb"
+
+struct frr_heartbeat {
+	/* set last, once the rest is valid */
+	_Atomic uint32_t magic;
+	uint32_t pid;
+	/* tasks run by the main event loop */
+	_Atomic uint64_t beats;
+};
+
+/* This daemon's heartbeat, NULL if none. */
+extern struct frr_heartbeat *frr_heartbeat;
+
+/*
+ * Creates and maps the heartbeat file; failure only means no heartbeat.
+ *
+ * @param path	file to use, replaced if it exists
+ */
+extern void frr_heartbeat_open(const char *path);
+
+/* Unmaps and removes this daemon's heartbeat file. */
+extern void frr_heartbeat_close(void);
+
+/*
+ * Maps another daemon's heartbeat file, read-only.
+ *
+ * @param path	the daemon's heartbeat file
+ * @return the heartbeat, or NULL if there is none (yet)
+ */
+extern const struct frr_heartbeat *frr_heartbeat_map(const char *path);
+
+/* Unmaps a heartbeat from frr_heartbeat_map(). */
+extern void frr_heartbeat_unmap(const struct frr_heartbeat *hb);
+
+static inline void frr_heartbeat_beat(void)
+{
+	if (frr_heartbeat)
+		atomic_fetch_add_explicit(&frr_heartbeat->beats, 1,
+					  memory_order_relaxed);
+}
+
+static inline uint64_t frr_heartbeat_beats(const struct frr_heartbeat *hb)
+{
+	return atomic_load_explicit(
+		&((struct frr_heartbeat *)hb)->beats, memory_order_relaxed);
+}
+
+#endif /* _FRR_HEARTBEAT_H_ */
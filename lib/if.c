@@ -33,12 +33,15 @@
 #include "table.h"
 #include "buffer.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 
 DEFINE_MTYPE(LIB, IF, "Interface")
 DEFINE_MTYPE_STATIC(LIB, CONNECTED, "Connected")
 DEFINE_MTYPE_STATIC(LIB, NBR_CONNECTED, "Neighbor Connected")
 DEFINE_MTYPE(LIB, CONNECTED_LABEL, "Connected interface label")
 DEFINE_MTYPE_STATIC(LIB, IF_LINK_PARAMS, "Informational Link Parameters")
+DEFINE_MTYPE_STATIC(LIB, CONNECTED_ADDR, "Connected address index")
 
 static int if_cmp_func(const struct interface *, const struct interface *);
 static int if_cmp_index_func(const struct interface *ifp1,
@@ -129,6 +132,219 @@ static int if_cmp_index_func(const struct interface *ifp1,
 	return ifp1->ifindex - ifp2->ifindex;
 }
 
+/*
+ * Interfaces by (VRF, ifindex). The per-VRF RB tree keeps them in
+ * order for walks; lookups go through this hash.
+ */
+static struct hash *ifindex_hash;
+
+static unsigned int if_index_hash_key(void *arg)
+{
+	struct interface *ifp = arg;
+
+	return jhash_2words(ifp->ifindex, ifp->vrf_id, 0x4c1a9e37);
+}
+
+static int if_index_hash_cmp(const void *a, const void *b)
+{
+	const struct interface *ifp1 = a;
+	const struct interface *ifp2 = b;
+
+	return ifp1->ifindex == ifp2->ifindex
+	       && ifp1->vrf_id == ifp2->vrf_id;
+}
+
+static void if_index_insert(struct vrf *vrf, struct interface *ifp)
+{
+	IFINDEX_RB_INSERT(vrf, ifp);
+
+	if (!ifindex_hash)
+		ifindex_hash = hash_create_size(64, if_index_hash_key,
+						if_index_hash_cmp,
+						"Interface ifindex");
+	hash_get(ifindex_hash, ifp, hash_alloc_intern);
+}
+
+static void if_index_remove(struct vrf *vrf, struct interface *ifp)
+{
+	IFINDEX_RB_REMOVE(vrf, ifp);
+
+	if (!ifindex_hash)
+		return;
+
+	/* another interface may hold the slot after a duplicate insert */
+	if (hash_lookup(ifindex_hash, ifp) == ifp)
+		hash_release(ifindex_hash, ifp);
+	if (!ifindex_hash->count) {
+		hash_free(ifindex_hash);
+		ifindex_hash = NULL;
+	}
+}
+
+/*
+ * Connected addresses by (VRF, family, address), each entry listing the
+ * connected structs with that address. Other than a walk over every
+ * interface's connected list, this only sees connected structs added
+ * with if_connected_add().
+ */
+struct connected_addr {
+	vrf_id_t vrf_id;
+	struct prefix addr; /* host prefix of the address */
+	struct list *connected;
+};
+
+static struct hash *connected_addr_hash;
+
+static void connected_addr_key_make(struct connected_addr *key,
+				    vrf_id_t vrf_id, int family,
+				    const void *addr)
+{
+	memset(key, 0, sizeof(*key));
+	key->vrf_id = vrf_id;
+	key->addr.family = family;
+	if (family == AF_INET) {
+		key->addr.prefixlen = IPV4_MAX_BITLEN;
+		key->addr.u.prefix4 = *(const struct in_addr *)addr;
+	} else if (family == AF_INET6) {
+		key->addr.prefixlen = IPV6_MAX_BITLEN;
+		key->addr.u.prefix6 = *(const struct in6_addr *)addr;
+	}
+}
+
+static unsigned int connected_addr_hash_key(void *arg)
+{
+	struct connected_addr *ca = arg;
+
+	return jhash(&ca->addr.u.prefix6, sizeof(ca->addr.u.prefix6),
+		     jhash_2words(ca->vrf_id, ca->addr.family, 0x8f1bbcdc));
+}
+
+static int connected_addr_hash_cmp(const void *a, const void *b)
+{
+	const struct connected_addr *ca1 = a;
+	const struct connected_addr *ca2 = b;
+
+	return ca1->vrf_id == ca2->vrf_id
+	       && ca1->addr.family == ca2->addr.family
+	       && !memcmp(&ca1->addr.u.prefix6, &ca2->addr.u.prefix6,
+			  sizeof(ca1->addr.u.prefix6));
+}
+
+static void *connected_addr_alloc(void *arg)
+{
+	struct connected_addr *ca;
+
+	ca = XMALLOC(MTYPE_CONNECTED_ADDR, sizeof(*ca));
+	*ca = *(struct connected_addr *)arg;
+	ca->connected = list_new();
+	return ca;
+}
+
+static struct connected_addr *connected_addr_lookup(vrf_id_t vrf_id,
+						    int family,
+						    const void *addr)
+{
+	struct connected_addr key;
+
+	if (!connected_addr_hash)
+		return NULL;
+	connected_addr_key_make(&key, vrf_id, family, addr);
+	return hash_lookup(connected_addr_hash, &key);
+}
+
+static void connected_index_add(struct connected *ifc)
+{
+	struct connected_addr key;
+	struct connected_addr *ca;
+
+	if (!ifc->address || ifc->addr_index)
+		return;
+	if (ifc->address->family != AF_INET
+	    && ifc->address->family != AF_INET6)
+		return;
+
+	if (!connected_addr_hash)
+		connected_addr_hash = hash_create_size(
+			64, connected_addr_hash_key, connected_addr_hash_cmp,
+			"Connected address");
+
+	connected_addr_key_make(&key, ifc->ifp->vrf_id, ifc->address->family,
+				&ifc->address->u.prefix);
+	ca = hash_get(connected_addr_hash, &key, connected_addr_alloc);
+	listnode_add(ca->connected, ifc);
+	ifc->addr_index = ca;
+}
+
+static void connected_index_del(struct connected *ifc)
+{
+	struct connected_addr *ca = ifc->addr_index;
+
+	if (!ca)
+		return;
+
+	ifc->addr_index = NULL;
+	listnode_delete(ca->connected, ifc);
+	if (listcount(ca->connected))
+		return;
+
+	hash_release(connected_addr_hash, ca);
+	list_delete_and_null(&ca->connected);
+	XFREE(MTYPE_CONNECTED_ADDR, ca);
+
+	if (!connected_addr_hash->count) {
+		hash_free(connected_addr_hash);
+		connected_addr_hash = NULL;
+	}
+}
+
+/* Add a connected address to the interface's list and the index. */
+void if_connected_add(struct interface *ifp, struct connected *ifc)
+{
+	listnode_add(ifp->connected, ifc);
+	connected_index_add(ifc);
+}
+
+/* Remove a connected address from the interface's list and the index. */
+void if_connected_delete(struct interface *ifp, struct connected *ifc)
+{
+	connected_index_del(ifc);
+	listnode_delete(ifp->connected, ifc);
+}
+
+static struct connected *connected_addr_find(struct interface *ifp,
+					     const struct prefix *p,
+					     bool same_len)
+{
+	struct connected_addr *ca;
+	struct connected *ifc;
+	struct listnode *node;
+
+	ca = connected_addr_lookup(ifp->vrf_id, p->family, &p->u.prefix);
+	if (!ca)
+		return NULL;
+
+	for (ALL_LIST_ELEMENTS_RO(ca->connected, node, ifc))
+		if (ifc->ifp == ifp
+		    && (!same_len || ifc->address->prefixlen == p->prefixlen))
+			return ifc;
+	return NULL;
+}
+
+struct list *if_connected_by_address(vrf_id_t vrf_id, const struct prefix *p)
+{
+	struct connected_addr *ca;
+
+	ca = connected_addr_lookup(vrf_id, p->family, &p->u.prefix);
+	return ca ? ca->connected : NULL;
+}
+
+/* Look up a connected address of the interface by address and length. */
+struct connected *if_connected_lookup(struct interface *ifp,
+				      const struct prefix *p)
+{
+	return connected_addr_find(ifp, p, true);
+}
+
 /* Create new interface structure. */
 struct interface *if_create(const char *name, vrf_id_t vrf_id)
 {
@@ -160,13 +376,24 @@ struct interface *if_create(const char *name, vrf_id_t vrf_id)
 void if_update_to_new_vrf(struct interface *ifp, vrf_id_t vrf_id)
 {
 	struct vrf *vrf;
+	struct listnode *node;
+	struct connected *ifc;
+	bool indexed = false;
 
 	/* remove interface from old master vrf list */
 	vrf = vrf_lookup_by_id(ifp->vrf_id);
 	if (vrf) {
 		IFNAME_RB_REMOVE(vrf, ifp);
 		if (ifp->ifindex != IFINDEX_INTERNAL)
-			IFINDEX_RB_REMOVE(vrf, ifp);
+			if_index_remove(vrf, ifp);
+	}
+
+	/* the address index is by VRF too */
+	for (ALL_LIST_ELEMENTS_RO(ifp->connected, node, ifc)) {
+		if (!ifc->addr_index)
+			continue;
+		connected_index_del(ifc);
+		indexed = true;
 	}
 
 	ifp->vrf_id = vrf_id;
@@ -174,17 +401,26 @@ void if_update_to_new_vrf(struct interface *ifp, vrf_id_t vrf_id)
 
 	IFNAME_RB_INSERT(vrf, ifp);
 	if (ifp->ifindex != IFINDEX_INTERNAL)
-		IFINDEX_RB_INSERT(vrf, ifp);
+		if_index_insert(vrf, ifp);
+
+	if (indexed)
+		for (ALL_LIST_ELEMENTS_RO(ifp->connected, node, ifc))
+			connected_index_add(ifc);
 }
 
 
 /* Delete interface structure. */
 void if_delete_retain(struct interface *ifp)
 {
+	struct listnode *node;
+	struct connected *ifc;
+
 	hook_call(if_del, ifp);
 	QOBJ_UNREG(ifp);
 
 	/* Free connected address list */
+	for (ALL_LIST_ELEMENTS_RO(ifp->connected, node, ifc))
+		connected_index_del(ifc);
 	list_delete_all_node(ifp->connected);
 
 	/* Free connected nbr address list */
@@ -201,7 +437,7 @@ void if_delete(struct interface *ifp)
 
 	IFNAME_RB_REMOVE(vrf, ifp);
 	if (ifp->ifindex != IFINDEX_INTERNAL)
-		IFINDEX_RB_REMOVE(vrf, ifp);
+		if_index_remove(vrf, ifp);
 
 	if_delete_retain(ifp);
 
@@ -234,12 +470,12 @@ struct interface *if_lookup_by_index(ifindex_t ifindex, vrf_id_t vrf_id)
 		return NULL;
 	}
 
-	vrf = vrf_lookup_by_id(vrf_id);
-	if (!vrf)
+	if (!ifindex_hash)
 		return NULL;
 
 	if_tmp.ifindex = ifindex;
-	return RB_FIND(if_index_head, &vrf->ifaces_by_index, &if_tmp);
+	if_tmp.vrf_id = vrf_id;
+	return hash_lookup(ifindex_hash, &if_tmp);
 }
 
 const char *ifindex2ifname(ifindex_t ifindex, vrf_id_t vrf_id)
@@ -295,32 +531,18 @@ struct interface *if_lookup_by_name_all_vrf(const char *name)
 struct interface *if_lookup_exact_address(void *src, int family,
 					  vrf_id_t vrf_id)
 {
-	struct vrf *vrf = vrf_lookup_by_id(vrf_id);
-	struct listnode *cnode;
-	struct interface *ifp;
-	struct prefix *p;
+	struct connected_addr *ca;
 	struct connected *c;
 
-	FOR_ALL_INTERFACES (vrf, ifp) {
-		for (ALL_LIST_ELEMENTS_RO(ifp->connected, cnode, c)) {
-			p = c->address;
-
-			if (p && (p->family == family)) {
-				if (family == AF_INET) {
-					if (IPV4_ADDR_SAME(
-						    &p->u.prefix4,
-						    (struct in_addr *)src))
-						return ifp;
-				} else if (family == AF_INET6) {
-					if (IPV6_ADDR_SAME(
-						    &p->u.prefix6,
-						    (struct in6_addr *)src))
-						return ifp;
-				}
-			}
-		}
-	}
-	return NULL;
+	if (family != AF_INET && family != AF_INET6)
+		return NULL;
+
+	ca = connected_addr_lookup(vrf_id, family, src);
+	if (!ca)
+		return NULL;
+
+	c = listnode_head(ca->connected);
+	return c->ifp;
 }
 
 /* Lookup interface by IPv4 address. */
@@ -425,12 +647,12 @@ void if_set_index(struct interface *ifp, ifindex_t ifindex)
 		return;
 
 	if (ifp->ifindex != IFINDEX_INTERNAL)
-		IFINDEX_RB_REMOVE(vrf, ifp)
+		if_index_remove(vrf, ifp);
 
 	ifp->ifindex = ifindex;
 
 	if (ifp->ifindex != IFINDEX_INTERNAL)
-		IFINDEX_RB_INSERT(vrf, ifp)
+		if_index_insert(vrf, ifp);
 }
 
 /* Does interface up ? */
@@ -909,55 +1131,27 @@ nbr_connected_log(struct nbr_connected *connected, char *str)
 	zlog_info("%s", logbuf);
 }
 
-/* If two connected address has same prefix return 1. */
-static int connected_same_prefix(struct prefix *p1, struct prefix *p2)
-{
-	if (p1->family == p2->family) {
-		if (p1->family == AF_INET
-		    && IPV4_ADDR_SAME(&p1->u.prefix4, &p2->u.prefix4))
-			return 1;
-		if (p1->family == AF_INET6
-		    && IPV6_ADDR_SAME(&p1->u.prefix6, &p2->u.prefix6))
-			return 1;
-	}
-	return 0;
-}
-
+/* Look up a connected address of the interface with the same address,
+ * whatever its prefix length. */
 struct connected *connected_lookup_prefix_exact(struct interface *ifp,
 						struct prefix *p)
 {
-	struct listnode *node;
-	struct listnode *next;
-	struct connected *ifc;
-
-	for (node = listhead(ifp->connected); node; node = next) {
-		ifc = listgetdata(node);
-		next = node->next;
+	if (p->family != AF_INET && p->family != AF_INET6)
+		return NULL;
 
-		if (connected_same_prefix(ifc->address, p))
-			return ifc;
-	}
-	return NULL;
+	return connected_addr_find(ifp, p, false);
 }
 
 struct connected *connected_delete_by_prefix(struct interface *ifp,
 					     struct prefix *p)
 {
-	struct listnode *node;
-	struct listnode *next;
 	struct connected *ifc;
 
 	/* In case of same prefix come, replace it with new one. */
-	for (node = listhead(ifp->connected); node; node = next) {
-		ifc = listgetdata(node);
-		next = node->next;
-
-		if (connected_same_prefix(ifc->address, p)) {
-			listnode_delete(ifp->connected, ifc);
-			return ifc;
-		}
-	}
-	return NULL;
+	ifc = connected_lookup_prefix_exact(ifp, p);
+	if (ifc)
+		if_connected_delete(ifp, ifc);
+	return ifc;
 }
 
 /* Find the address on our side that will be used when packets
@@ -1002,7 +1196,7 @@ struct connected *connected_add_by_prefix(struct interface *ifp,
 	}
 
 	/* Add connected address to the interface. */
-	listnode_add(ifp->connected, ifc);
+	if_connected_add(ifp, ifc);
 	return ifc;
 }
 
@@ -1194,6 +1388,42 @@ struct if_link_params *if_link_params_get(struct interface *ifp)
 	return iflp;
 }
 
+uint32_t if_link_params_cmp(const struct if_link_params *a,
+			    const struct if_link_params *b)
+{
+	/* A parameter set on one side only has changed, one set on both
+	 * sides if its value did. */
+	uint32_t changed = a->lp_status ^ b->lp_status;
+	uint32_t set = a->lp_status & b->lp_status;
+
+#define LP_CMP(st, differ)                                                     \
+	do {                                                                   \
+		if ((set & (st)) && (differ))                                  \
+			changed |= (st);                                       \
+	} while (0)
+
+	LP_CMP(LP_TE_METRIC, a->te_metric != b->te_metric);
+	LP_CMP(LP_MAX_BW, a->max_bw != b->max_bw);
+	LP_CMP(LP_MAX_RSV_BW, a->max_rsv_bw != b->max_rsv_bw);
+	LP_CMP(LP_UNRSV_BW,
+	       memcmp(a->unrsv_bw, b->unrsv_bw, sizeof(a->unrsv_bw)));
+	LP_CMP(LP_ADM_GRP, a->admin_grp != b->admin_grp);
+	LP_CMP(LP_RMT_AS, a->rmt_as != b->rmt_as
+				  || a->rmt_ip.s_addr != b->rmt_ip.s_addr);
+	LP_CMP(LP_DELAY, a->av_delay != b->av_delay);
+	LP_CMP(LP_MM_DELAY, a->min_delay != b->min_delay
+				    || a->max_delay != b->max_delay);
+	LP_CMP(LP_DELAY_VAR, a->delay_var != b->delay_var);
+	LP_CMP(LP_PKT_LOSS, a->pkt_loss != b->pkt_loss);
+	LP_CMP(LP_RES_BW, a->res_bw != b->res_bw);
+	LP_CMP(LP_AVA_BW, a->ava_bw != b->ava_bw);
+	LP_CMP(LP_USE_BW, a->use_bw != b->use_bw);
+
+#undef LP_CMP
+
+	return changed;
+}
+
 void if_link_params_free(struct interface *ifp)
 {
 	if (ifp->link_params == NULL)
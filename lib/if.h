@@ -165,6 +165,7 @@ struct if_stats {
 #define LP_RES_BW               0x0400
 #define LP_AVA_BW               0x0800
 #define LP_USE_BW               0x1000
+#define LP_ALL                  0x1FFF
 
 #define IS_PARAM_UNSET(lp, st) !(lp->lp_status & st)
 #define IS_PARAM_SET(lp, st) (lp->lp_status & st)
@@ -388,6 +389,9 @@ struct connected {
 
 	/* Label for Linux 2.2.X and upper. */
 	char *label;
+
+	/* Entry of the address index the connected is on, if any. */
+	struct connected_addr *addr_index;
 };
 
 /* Nbr Connected address structure. */
@@ -525,6 +529,17 @@ extern struct connected *connected_lookup_prefix(struct interface *,
 						 struct prefix *);
 extern struct connected *connected_lookup_prefix_exact(struct interface *,
 						       struct prefix *);
+
+/* Connected addresses must be linked to and unlinked from ifp->connected
+ * with these for the address lookups to see them.  The address of a
+ * connected must not be changed while it is linked. */
+extern void if_connected_add(struct interface *ifp, struct connected *ifc);
+extern void if_connected_delete(struct interface *ifp, struct connected *ifc);
+extern struct connected *if_connected_lookup(struct interface *ifp,
+					     const struct prefix *p);
+/* All connected with the address of p in the VRF, or NULL if none. */
+extern struct list *if_connected_by_address(vrf_id_t vrf_id,
+					    const struct prefix *p);
 extern struct nbr_connected *nbr_connected_new(void);
 extern void nbr_connected_free(struct nbr_connected *);
 struct nbr_connected *nbr_connected_check(struct interface *, struct prefix *);
@@ -532,5 +547,8 @@ struct nbr_connected *nbr_connected_check(struct interface *, struct prefix *);
 /* link parameters */
 struct if_link_params *if_link_params_get(struct interface *);
 void if_link_params_free(struct interface *);
+/* LP_* bits of the parameters that differ between a and b */
+uint32_t if_link_params_cmp(const struct if_link_params *a,
+			    const struct if_link_params *b);
 
 #endif /* _ZEBRA_IF_H */
@@ -25,6 +25,17 @@ int ibuf_realloc(struct ibuf *, size_t);
 void ibuf_enqueue(struct msgbuf *, struct ibuf *);
 void ibuf_dequeue(struct msgbuf *, struct ibuf *);
 
+/*
+ * Freed buffers of IBUF_POOL_SIZE bytes are kept for reuse by
+ * ibuf_dynamic(), which most messages fit, instead of going back to malloc
+ * right after being written.
+ */
+#define IBUF_POOL_SIZE	512
+#define IBUF_POOL_MAX	256
+
+static TAILQ_HEAD(, ibuf) ibuf_pool = TAILQ_HEAD_INITIALIZER(ibuf_pool);
+static unsigned int ibuf_pool_count;
+
 struct ibuf *ibuf_open(size_t len)
 {
 	struct ibuf *buf;
@@ -48,6 +59,18 @@ struct ibuf *ibuf_dynamic(size_t len, size_t max)
 	if (max < len)
 		return (NULL);
 
+	if (len <= IBUF_POOL_SIZE && max >= IBUF_POOL_SIZE) {
+		if ((buf = TAILQ_FIRST(&ibuf_pool)) != NULL) {
+			TAILQ_REMOVE(&ibuf_pool, buf, entry);
+			ibuf_pool_count--;
+			buf->wpos = buf->rpos = 0;
+			buf->fd = -1;
+		} else if ((buf = ibuf_open(IBUF_POOL_SIZE)) == NULL)
+			return (NULL);
+		buf->max = max;
+		return (buf);
+	}
+
 	if ((buf = ibuf_open(len)) == NULL)
 		return (NULL);
 
@@ -131,7 +154,6 @@ int ibuf_write(struct msgbuf *msgbuf)
 	unsigned int i = 0;
 	ssize_t n;
 
-	memset(&iov, 0, sizeof(iov));
 	TAILQ_FOREACH (buf, &msgbuf->bufs, entry) {
 		if (i >= IOV_MAX)
 			break;
@@ -163,6 +185,11 @@ void ibuf_free(struct ibuf *buf)
 {
 	if (buf == NULL)
 		return;
+	if (buf->size == IBUF_POOL_SIZE && ibuf_pool_count < IBUF_POOL_MAX) {
+		TAILQ_INSERT_HEAD(&ibuf_pool, buf, entry);
+		ibuf_pool_count++;
+		return;
+	}
 	free(buf->buf);
 	free(buf);
 }
@@ -212,7 +239,6 @@ int msgbuf_write(struct msgbuf *msgbuf)
 		char buf[CMSG_SPACE(sizeof(int))];
 	} cmsgbuf;
 
-	memset(&iov, 0, sizeof(iov));
 	memset(&msg, 0, sizeof(msg));
 	memset(&cmsgbuf, 0, sizeof(cmsgbuf));
 	TAILQ_FOREACH (buf, &msgbuf->bufs, entry) {
@@ -80,10 +80,20 @@ ssize_t imsg_read(struct imsgbuf *ibuf)
 	ssize_t n = -1;
 	int fd;
 	struct imsg_fd *ifd;
+	size_t left;
 
 	memset(&msg, 0, sizeof(msg));
 	memset(&cmsgbuf, 0, sizeof(cmsgbuf));
 
+	/* move what imsg_get() left to the front, once per read */
+	if (ibuf->r.rpos > 0) {
+		left = ibuf->r.wpos - ibuf->r.rpos;
+		if (left > 0)
+			memmove(ibuf->r.buf, ibuf->r.buf + ibuf->r.rpos, left);
+		ibuf->r.wpos = left;
+		ibuf->r.rpos = 0;
+	}
+
 	iov.iov_base = ibuf->r.buf + ibuf->r.wpos;
 	iov.iov_len = sizeof(ibuf->r.buf) - ibuf->r.wpos;
 	msg.msg_iov = &iov;
@@ -91,9 +101,6 @@ ssize_t imsg_read(struct imsgbuf *ibuf)
 	msg.msg_control = &cmsgbuf.buf;
 	msg.msg_controllen = sizeof(cmsgbuf.buf);
 
-	if ((ifd = calloc(1, sizeof(struct imsg_fd))) == NULL)
-		return (-1);
-
 again:
 #ifdef __OpenBSD__
 	if (getdtablecount() + imsg_fd_overhead
@@ -106,14 +113,13 @@ again:
 				    / sizeof(int))) {
 #endif
 		errno = EAGAIN;
-		free(ifd);
 		return (-1);
 	}
 
 	if ((n = recvmsg(ibuf->fd, &msg, 0)) == -1) {
 		if (errno == EINTR)
 			goto again;
-		goto fail;
+		return (n);
 	}
 
 	ibuf->r.wpos += n;
@@ -125,6 +131,8 @@ again:
 			int i;
 			int j;
 
+			ifd = calloc(1, sizeof(struct imsg_fd));
+
 			/*
 			 * We only accept one file descriptor.  Due to C
 			 * padding rules, our control buffer might contain
@@ -147,21 +155,24 @@ again:
 		/* we do not handle other ctl data level */
 	}
 
-fail:
-	free(ifd);
 	return (n);
 }
 
+/* Alignment payloads need to be handed out in place. */
+#define IMSG_DATA_ALIGN	8
+
 ssize_t imsg_get(struct imsgbuf *ibuf, struct imsg *imsg)
 {
-	size_t av, left, datalen;
+	size_t av, datalen;
+	uint8_t *start;
 
-	av = ibuf->r.wpos;
+	av = ibuf->r.wpos - ibuf->r.rpos;
+	start = ibuf->r.buf + ibuf->r.rpos;
 
 	if (IMSG_HEADER_SIZE > av)
 		return (0);
 
-	memcpy(&imsg->hdr, ibuf->r.buf, sizeof(imsg->hdr));
+	memcpy(&imsg->hdr, start, sizeof(imsg->hdr));
 	if (imsg->hdr.len < IMSG_HEADER_SIZE || imsg->hdr.len > MAX_IMSGSIZE) {
 		errno = ERANGE;
 		return (-1);
@@ -169,10 +180,14 @@ ssize_t imsg_get(struct imsgbuf *ibuf, struct imsg *imsg)
 	if (imsg->hdr.len > av)
 		return (0);
 	datalen = imsg->hdr.len - IMSG_HEADER_SIZE;
-	ibuf->r.rptr = ibuf->r.buf + IMSG_HEADER_SIZE;
+	ibuf->r.rptr = start + IMSG_HEADER_SIZE;
+	imsg->alloc = NULL;
 	if (datalen == 0)
 		imsg->data = NULL;
-	else if ((imsg->data = malloc(datalen)) == NULL)
+	else if (((uintptr_t)ibuf->r.rptr & (IMSG_DATA_ALIGN - 1)) == 0)
+		/* left in place: imsg_read() moves nothing until called */
+		imsg->data = ibuf->r.rptr;
+	else if ((imsg->data = imsg->alloc = malloc(datalen)) == NULL)
 		return (-1);
 
 	if (imsg->hdr.flags & IMSGF_HASFD)
@@ -180,15 +195,14 @@ ssize_t imsg_get(struct imsgbuf *ibuf, struct imsg *imsg)
 	else
 		imsg->fd = -1;
 
-	if (imsg->data)
+	if (imsg->alloc)
 		memcpy(imsg->data, ibuf->r.rptr, datalen);
 
-	if (imsg->hdr.len < av) {
-		left = av - imsg->hdr.len;
-		memmove(&ibuf->r.buf, ibuf->r.buf + imsg->hdr.len, left);
-		ibuf->r.wpos = left;
-	} else
-		ibuf->r.wpos = 0;
+	/* messages are taken by offset, the rest is moved by imsg_read() */
+	if (imsg->hdr.len < av)
+		ibuf->r.rpos += imsg->hdr.len;
+	else
+		ibuf->r.rpos = ibuf->r.wpos = 0;
 
 	return (datalen + IMSG_HEADER_SIZE);
 }
@@ -288,7 +302,7 @@ void imsg_close(struct imsgbuf *ibuf, struct ibuf *msg)
 
 void imsg_free(struct imsg *imsg)
 {
-	free(imsg->data);
+	free(imsg->alloc);
 }
 
 int imsg_get_fd(struct imsgbuf *ibuf)
@@ -45,6 +45,7 @@ struct ibuf_read {
 	uint8_t buf[IBUF_READ_SIZE];
 	uint8_t *rptr;
 	size_t wpos;
+	size_t rpos;	/* start of what imsg_get() did not take yet */
 };
 
 struct imsg_fd {
@@ -70,10 +71,16 @@ struct imsg_hdr {
 	uint32_t pid;
 };
 
+/*
+ * data points into the read buffer when it is suitably aligned there, and is
+ * then only valid until the next imsg_read(); otherwise it is a copy, freed
+ * by imsg_free().
+ */
 struct imsg {
 	struct imsg_hdr hdr;
 	int fd;
 	void *data;
+	void *alloc;
 };
 
 
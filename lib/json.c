@@ -86,3 +86,153 @@ int json_object_object_get_ex(struct json_object *obj, const char *key,
 	return 0;
 }
 #endif
+
+/* Write out what has been produced about every this many bytes. */
+#define JSON_STREAM_FLUSH_SIZE (64 * 1024)
+
+static void json_stream_put(struct json_stream *js, const char *str,
+			    size_t len)
+{
+	vty_out(js->vty, "%.*s", (int)len, str);
+	js->unflushed += len;
+}
+
+static void json_stream_quoted(struct json_stream *js, const char *s)
+{
+	const char *run = s;
+	char esc[8];
+
+	json_stream_put(js, "\"", 1);
+	for (; *s; s++) {
+		unsigned char c = *s;
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		json_stream_put(js, run, s - run);
+		run = s + 1;
+		switch (c) {
+		case '"':
+		case '\\':
+			snprintf(esc, sizeof(esc), "\\%c", c);
+			break;
+		case '\n':
+			snprintf(esc, sizeof(esc), "\\n");
+			break;
+		case '\t':
+			snprintf(esc, sizeof(esc), "\\t");
+			break;
+		default:
+			snprintf(esc, sizeof(esc), "\\u%04x", c);
+			break;
+		}
+		json_stream_put(js, esc, strlen(esc));
+	}
+	json_stream_put(js, run, s - run);
+	json_stream_put(js, "\"", 1);
+}
+
+/* separator and key in front of a new member */
+static void json_stream_member(struct json_stream *js, const char *key)
+{
+	if (js->depth) {
+		if (!js->empty[js->depth - 1])
+			json_stream_put(js, ",", 1);
+		js->empty[js->depth - 1] = false;
+	}
+	if (key) {
+		json_stream_quoted(js, key);
+		json_stream_put(js, ":", 1);
+	}
+}
+
+static void json_stream_done(struct json_stream *js)
+{
+	if (!js->flush || js->unflushed < JSON_STREAM_FLUSH_SIZE)
+		return;
+
+	/* a client that cannot keep up gets the rest at the end */
+	js->flush = vty_out_flush(js->vty);
+	js->unflushed = 0;
+}
+
+void json_stream_init(struct json_stream *js, struct vty *vty)
+{
+	memset(js, 0, sizeof(*js));
+	js->vty = vty;
+	js->flush = true;
+}
+
+static void json_stream_start(struct json_stream *js, const char *key,
+			      char open, char close)
+{
+	assert(js->depth < JSON_STREAM_DEPTH);
+
+	json_stream_member(js, key);
+	json_stream_put(js, &open, 1);
+	js->close[js->depth] = close;
+	js->empty[js->depth] = true;
+	js->depth++;
+}
+
+void json_stream_object_start(struct json_stream *js, const char *key)
+{
+	json_stream_start(js, key, '{', '}');
+}
+
+void json_stream_array_start(struct json_stream *js, const char *key)
+{
+	json_stream_start(js, key, '[', ']');
+}
+
+void json_stream_end(struct json_stream *js)
+{
+	assert(js->depth > 0);
+
+	js->depth--;
+	json_stream_put(js, &js->close[js->depth], 1);
+	if (!js->depth)
+		json_stream_put(js, "\n", 1);
+	json_stream_done(js);
+}
+
+void json_stream_string(struct json_stream *js, const char *key,
+			const char *s)
+{
+	json_stream_member(js, key);
+	json_stream_quoted(js, s);
+	json_stream_done(js);
+}
+
+void json_stream_int(struct json_stream *js, const char *key, int64_t i)
+{
+	char buf[32];
+
+	json_stream_member(js, key);
+	snprintf(buf, sizeof(buf), "%" PRId64, i);
+	json_stream_put(js, buf, strlen(buf));
+	json_stream_done(js);
+}
+
+void json_stream_bool(struct json_stream *js, const char *key, bool b)
+{
+	json_stream_member(js, key);
+	if (b)
+		json_stream_put(js, "true", 4);
+	else
+		json_stream_put(js, "false", 5);
+	json_stream_done(js);
+}
+
+void json_stream_object(struct json_stream *js, const char *key,
+			struct json_object *obj)
+{
+	const char *str;
+
+	json_stream_member(js, key);
+	str = json_object_to_json_string_ext(obj,
+					     JSON_C_TO_STRING_NOSLASHESCAPE);
+	json_stream_put(js, str, strlen(str));
+	json_object_free(obj);
+	json_stream_done(js);
+}
@@ -50,6 +50,38 @@ extern void json_object_boolean_true_add(struct json_object *obj,
 extern struct json_object *json_object_lock(struct json_object *obj);
 extern void json_object_free(struct json_object *obj);
 
+/*
+ * Streaming JSON output, for replies too large to build as one json_object
+ * tree.  Members are written out through vty_out() as they are added, and
+ * what has been written is flushed to the client now and then, so memory
+ * use is bounded by the largest single member.
+ */
+#define JSON_STREAM_DEPTH 16
+
+struct json_stream {
+	struct vty *vty;
+	int depth;
+	bool flush;
+	size_t unflushed;
+	/* per open container: its closing bracket, and whether it is empty */
+	char close[JSON_STREAM_DEPTH];
+	bool empty[JSON_STREAM_DEPTH];
+};
+
+/* key is NULL for array elements and for the top-level value */
+extern void json_stream_init(struct json_stream *js, struct vty *vty);
+extern void json_stream_object_start(struct json_stream *js, const char *key);
+extern void json_stream_array_start(struct json_stream *js, const char *key);
+extern void json_stream_end(struct json_stream *js);
+extern void json_stream_string(struct json_stream *js, const char *key,
+			       const char *s);
+extern void json_stream_int(struct json_stream *js, const char *key,
+			    int64_t i);
+extern void json_stream_bool(struct json_stream *js, const char *key, bool b);
+/* writes out obj and releases it */
+extern void json_stream_object(struct json_stream *js, const char *key,
+			       struct json_object *obj);
+
 #define JSON_STR "JavaScript Object Notation\n"
 
 /* NOTE: json-c lib has following commit 316da85 which
@@ -35,6 +35,10 @@
 #include "log_int.h"
 #include "module.h"
 #include "network.h"
+#include "stream.h"
+#include "heartbeat.h"
+#include "epoch.h"
+#include "slab.h"
 
 DEFINE_HOOK(frr_late_init, (struct thread_master * tm), (tm))
 DEFINE_KOOH(frr_early_fini, (), ())
@@ -78,6 +82,8 @@ static void opt_extend(const struct optspec *os)
 
 #define OPTION_VTYSOCK   1000
 #define OPTION_MODULEDIR 1002
+#define OPTION_CPUAFFINITY 1003
+#define OPTION_SLABPAGES 1004
 
 static const struct option lo_always[] = {
 	{"help", no_argument, NULL, 'h'},
@@ -86,6 +92,8 @@ static const struct option lo_always[] = {
 	{"module", no_argument, NULL, 'M'},
 	{"vty_socket", required_argument, NULL, OPTION_VTYSOCK},
 	{"moduledir", required_argument, NULL, OPTION_MODULEDIR},
+	{"cpu_affinity", required_argument, NULL, OPTION_CPUAFFINITY},
+	{"slab_pages", required_argument, NULL, OPTION_SLABPAGES},
 	{NULL}};
 static const struct optspec os_always = {
 	"hvdM:",
@@ -94,7 +102,9 @@ static const struct optspec os_always = {
 	"  -d, --daemon       Runs in daemon mode\n"
 	"  -M, --module       Load specified module\n"
 	"      --vty_socket   Override vty socket path\n"
-	"      --moduledir    Override modules directory\n",
+	"      --moduledir    Override modules directory\n"
+	"      --cpu_affinity Pin a pthread to CPUs, as name:cpulist\n"
+	"      --slab_pages   Back slabs with transparent or explicit huge pages\n",
 	lo_always};
 
 
@@ -434,6 +444,33 @@ static int frr_opt(int opt)
 		}
 		di->module_path = optarg;
 		break;
+	case OPTION_CPUAFFINITY: {
+		char *sep = strrchr(optarg, ':');
+
+		if (sep)
+			*sep++ = '\0';
+		if (!sep || thread_affinity_set(optarg, sep) < 0) {
+			fprintf(stderr,
+				"invalid --cpu_affinity \"%s\", expected name:cpulist\n",
+				optarg);
+			errors++;
+		}
+		break;
+	}
+	case OPTION_SLABPAGES:
+		if (!strcmp(optarg, "transparent"))
+			slab_set_pages(SLAB_PAGES_TRANSPARENT);
+		else if (!strcmp(optarg, "explicit"))
+			slab_set_pages(SLAB_PAGES_EXPLICIT);
+		else if (!strcmp(optarg, "normal"))
+			slab_set_pages(SLAB_PAGES_NORMAL);
+		else {
+			fprintf(stderr,
+				"invalid --slab_pages \"%s\", expected normal, transparent or explicit\n",
+				optarg);
+			errors++;
+		}
+		break;
 	case 'u':
 		if (di->flags & FRR_NO_PRIVSEP)
 			return 1;
@@ -578,7 +615,9 @@ struct thread_master *frr_init(void)
 	zprivs_init(di->privs);
 
 	master = thread_master_create(NULL);
+	thread_affinity_apply("main", pthread_self());
 	signal_init(master, di->n_signals, di->signals);
+	epoch_init(master);
 
 	if (di->flags & FRR_LIMITED_CLI)
 		cmd_init(-1);
@@ -766,6 +805,21 @@ void frr_vty_serv(void)
 	vty_serv_sock(di->vty_addr, di->vty_port, di->vty_path);
 }
 
+/* The heartbeat goes next to the vty socket, where watchfrr looks. */
+static void frr_heartbeat_init(void)
+{
+	char path[256];
+	size_t len = strlen(di->vty_path);
+
+	if (len < 4 || strcmp(di->vty_path + len - 4, ".vty")
+	    || (size_t)snprintf(path, sizeof(path), "%.*s%s", (int)(len - 4),
+				di->vty_path, FRR_HEARTBEAT_SUFFIX)
+		       >= sizeof(path))
+		return;
+
+	frr_heartbeat_open(path);
+}
+
 static void frr_terminal_close(int isexit)
 {
 	int nullfd;
@@ -839,6 +893,7 @@ void frr_run(struct thread_master *master)
 	char instanceinfo[64] = "";
 
 	frr_vty_serv();
+	frr_heartbeat_init();
 
 	if (di->instance)
 		snprintf(instanceinfo, sizeof(instanceinfo), "instance %u ",
@@ -871,12 +926,16 @@ void frr_run(struct thread_master *master)
 		daemon_ctl_sock = -1;
 	}
 
+	zlog_async_start();
+
 	/* end fixed stderr startup logging */
 	zlog_startup_stderr = false;
 
 	struct thread thread;
-	while (thread_fetch(master, &thread))
+	while (thread_fetch(master, &thread)) {
 		thread_call(&thread);
+		frr_heartbeat_beat();
+	}
 }
 
 void frr_early_fini(void)
@@ -892,14 +951,18 @@ void frr_fini(void)
 
 	hook_call(frr_fini);
 
+	frr_heartbeat_close();
 	/* memory_init -> nothing needed */
 	vty_terminate();
 	cmd_terminate();
 	zprivs_terminate(di->privs);
 	/* signal_init -> nothing needed */
+	epoch_finish();
 	thread_master_free(master);
 	master = NULL;
+	zlog_async_stop();
 	closezlog();
+	stream_cache_finish();
 	/* frrmod_init -> nothing needed / hooks */
 
 	if (!debug_memstats_at_exit)
@@ -37,6 +37,7 @@
 #endif
 
 DEFINE_MTYPE_STATIC(LIB, ZLOG, "Logging")
+DEFINE_MTYPE_STATIC(LIB, ZLOG_BUF, "Log buffer")
 
 static int logfile_fd = -1; /* Used in signal handler. */
 
@@ -106,40 +107,43 @@ const char *lookup_msg(const struct message *mz, int kz, const char *nf)
 	return rz;
 }
 
-/* For time string format. */
-size_t quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
+/* The seconds part of the last timestamp rendered. */
+struct timestamp_cache {
+	time_t last;
+	size_t len;
+	char buf[28];
+};
+
+static size_t timestamp_render(struct timestamp_cache *cache,
+			       int timestamp_precision, char *buf,
+			       size_t buflen)
 {
-	static struct {
-		time_t last;
-		size_t len;
-		char buf[28];
-	} cache;
 	struct timeval clock;
 
 	gettimeofday(&clock, NULL);
 
 	/* first, we update the cache if the time has changed */
-	if (cache.last != clock.tv_sec) {
-		struct tm *tm;
-		cache.last = clock.tv_sec;
-		tm = localtime(&cache.last);
-		cache.len = strftime(cache.buf, sizeof(cache.buf),
-				     "%Y/%m/%d %H:%M:%S", tm);
+	if (cache->last != clock.tv_sec) {
+		struct tm tm;
+		cache->last = clock.tv_sec;
+		localtime_r(&cache->last, &tm);
+		cache->len = strftime(cache->buf, sizeof(cache->buf),
+				      "%Y/%m/%d %H:%M:%S", &tm);
 	}
 	/* note: it's not worth caching the subsecond part, because
 	   chances are that back-to-back calls are not sufficiently close
 	   together
 	   for the clock not to have ticked forward */
 
-	if (buflen > cache.len) {
-		memcpy(buf, cache.buf, cache.len);
+	if (buflen > cache->len) {
+		memcpy(buf, cache->buf, cache->len);
 		if ((timestamp_precision > 0)
-		    && (buflen > cache.len + 1 + timestamp_precision)) {
+		    && (buflen > cache->len + 1 + timestamp_precision)) {
 			/* should we worry about locale issues? */
 			static const int divisor[] = {0,   100000, 10000, 1000,
 						      100, 10,     1};
 			int prec;
-			char *p = buf + cache.len + 1
+			char *p = buf + cache->len + 1
 				  + (prec = timestamp_precision);
 			*p-- = '\0';
 			while (prec > 6)
@@ -154,16 +158,24 @@ size_t quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
 				clock.tv_usec /= 10;
 			} while (--prec > 0);
 			*p = '.';
-			return cache.len + 1 + timestamp_precision;
+			return cache->len + 1 + timestamp_precision;
 		}
-		buf[cache.len] = '\0';
-		return cache.len;
+		buf[cache->len] = '\0';
+		return cache->len;
 	}
 	if (buflen > 0)
 		buf[0] = '\0';
 	return 0;
 }
 
+/* For time string format. */
+size_t quagga_timestamp(int timestamp_precision, char *buf, size_t buflen)
+{
+	static struct timestamp_cache cache;
+
+	return timestamp_render(&cache, timestamp_precision, buf, buflen);
+}
+
 /* Utility routine for current time printing. */
 static void time_print(FILE *fp, struct timestamp_control *ctl)
 {
@@ -194,16 +206,474 @@ static void vzlog_file(struct zlog *zl, struct timestamp_control *tsctl,
 	fflush(fp);
 }
 
+/*
+ * Asynchronous file and stdout logging.
+ *
+ * Once zlog_async_start() ran, vzlog() renders the lines for the log file
+ * and stdout into ring buffers of the calling pthread, which only it writes
+ * and only the log writer pthread reads, so neither takes loglock for them.
+ * The writer wakes up every ZLOG_ASYNC_INTERVAL msecs, or when a ring is
+ * half full, and writes out all rings with one writev() per destination.
+ * A line that does not fit in its ring is dropped and counted, so a debug
+ * flood costs lines rather than stalling the daemon.  Lines from different
+ * pthreads may come out of order within one interval.
+ */
+#define ZLOG_ASYNC_RING_SIZE (256 * 1024) /* power of 2 */
+#define ZLOG_ASYNC_LINE_MAX 2048
+#define ZLOG_ASYNC_INTERVAL 50
+#define ZLOG_ASYNC_IOV 64
+
+enum zlog_async_dest {
+	ZLOG_ASYNC_FILE = 0,
+	ZLOG_ASYNC_STDOUT,
+	ZLOG_ASYNC_DESTS,
+};
+
+struct zlog_ring {
+	/* Bytes ever put in and taken out, head by the owner only, tail by
+	 * the writer only.
+	 */
+	_Atomic size_t head;
+	_Atomic size_t tail;
+	char buf[ZLOG_ASYNC_RING_SIZE];
+};
+
+/* A pthread's log buffers, allocated on its first message */
+struct zlog_tls {
+	struct zlog_tls *next;
+	struct zlog_ring *_Atomic ring[ZLOG_ASYNC_DESTS];
+	struct timestamp_cache ts;
+
+	_Atomic uint64_t dropped;
+	uint64_t dropped_seen; /* by the writer */
+
+	/* The pthread exited, free once written out */
+	_Atomic bool orphaned;
+};
+
+static struct zlog_async {
+	_Atomic bool running;
+	_Atomic bool kicked;
+	_Atomic uint64_t dropped;
+
+	pthread_t writer;
+	pthread_key_t key;
+
+	/* Protects the list of buffers, and wakes up the writer */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	struct zlog_tls *bufs;
+} zlog_async = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void zlog_async_kick(void)
+{
+	atomic_store_explicit(&zlog_async.kicked, true, memory_order_relaxed);
+	pthread_cond_signal(&zlog_async.cond);
+}
+
+static void zlog_tls_orphan(void *arg)
+{
+	struct zlog_tls *tls = arg;
+
+	atomic_store_explicit(&tls->orphaned, true, memory_order_release);
+}
+
+static struct zlog_tls *zlog_tls_get(void)
+{
+	struct zlog_tls *tls = pthread_getspecific(zlog_async.key);
+
+	if (tls)
+		return tls;
+
+	tls = XCALLOC(MTYPE_ZLOG_BUF, sizeof(struct zlog_tls));
+	pthread_setspecific(zlog_async.key, tls);
+
+	pthread_mutex_lock(&zlog_async.mtx);
+	tls->next = zlog_async.bufs;
+	zlog_async.bufs = tls;
+	pthread_mutex_unlock(&zlog_async.mtx);
+
+	return tls;
+}
+
+static void zlog_ring_put(struct zlog_tls *tls, enum zlog_async_dest dest,
+			  const char *line, size_t len)
+{
+	struct zlog_ring *ring;
+	size_t head, tail, off, part;
+
+	ring = atomic_load_explicit(&tls->ring[dest], memory_order_relaxed);
+	if (!ring) {
+		ring = XCALLOC(MTYPE_ZLOG_BUF, sizeof(struct zlog_ring));
+		atomic_store_explicit(&tls->ring[dest], ring,
+				      memory_order_release);
+	}
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	if (len > ZLOG_ASYNC_RING_SIZE - (head - tail)) {
+		atomic_fetch_add_explicit(&tls->dropped, 1,
+					  memory_order_relaxed);
+		zlog_async_kick();
+		return;
+	}
+
+	off = head & (ZLOG_ASYNC_RING_SIZE - 1);
+	part = MIN(len, ZLOG_ASYNC_RING_SIZE - off);
+	memcpy(ring->buf + off, line, part);
+	memcpy(ring->buf, line + part, len - part);
+	atomic_store_explicit(&ring->head, head + len, memory_order_release);
+
+	if (head - tail < ZLOG_ASYNC_RING_SIZE / 2
+	    && head + len - tail >= ZLOG_ASYNC_RING_SIZE / 2)
+		zlog_async_kick();
+}
+
+/* Render the line vzlog_file() would print and queue it. */
+static void zlog_async_put(struct zlog *zl, int priority, bool to_file,
+			   bool to_stdout, const char *format, va_list args)
+{
+	struct zlog_tls *tls = zlog_tls_get();
+	char line[ZLOG_ASYNC_LINE_MAX];
+	size_t len;
+	va_list ac;
+	int n;
+
+	len = timestamp_render(&tls->ts, zl->timestamp_precision, line,
+			       QUAGGA_TIMESTAMP_LEN);
+	line[len++] = ' ';
+	if (zl->record_priority)
+		len += snprintf(line + len, sizeof(line) - len, "%s: ",
+				zlog_priority[priority]);
+	if (zl->instance)
+		len += snprintf(line + len, sizeof(line) - len, "%s[%d]: ",
+				zl->protoname, zl->instance);
+	else
+		len += snprintf(line + len, sizeof(line) - len, "%s: ",
+				zl->protoname);
+
+	va_copy(ac, args);
+	n = vsnprintf(line + len, sizeof(line) - len, format, ac);
+	va_end(ac);
+	if (n > 0)
+		len += n;
+
+	/* Truncated lines still end in a newline */
+	if (len > sizeof(line) - 1)
+		len = sizeof(line) - 1;
+	line[len++] = '\n';
+
+	if (to_file)
+		zlog_ring_put(tls, ZLOG_ASYNC_FILE, line, len);
+	if (to_stdout)
+		zlog_ring_put(tls, ZLOG_ASYNC_STDOUT, line, len);
+}
+
+/* Write out the iovecs and release what they pointed into. */
+static void zlog_async_writev(int fd, struct iovec *iov, int iovcnt,
+			      struct zlog_ring **rings, size_t *heads,
+			      int nrings)
+{
+	struct iovec *pos = iov;
+	ssize_t ret;
+	int i;
+
+	while (fd >= 0 && iovcnt > 0) {
+		ret = writev(fd, pos, iovcnt);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			/* Nowhere to write to, the lines are lost */
+			break;
+		}
+		while (iovcnt > 0 && (size_t)ret >= pos->iov_len) {
+			ret -= pos->iov_len;
+			pos++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			pos->iov_base = (char *)pos->iov_base + ret;
+			pos->iov_len -= ret;
+		}
+	}
+
+	for (i = 0; i < nrings; i++)
+		atomic_store_explicit(&rings[i]->tail, heads[i],
+				      memory_order_release);
+}
+
+static void zlog_async_drain_dest(enum zlog_async_dest dest)
+{
+	struct iovec iov[ZLOG_ASYNC_IOV];
+	struct zlog_ring *rings[ZLOG_ASYNC_IOV / 2];
+	size_t heads[ZLOG_ASYNC_IOV / 2];
+	struct zlog_ring *ring;
+	struct zlog_tls *tls;
+	size_t head, tail, off, len;
+	int iovcnt = 0, nrings = 0;
+	int fd = STDOUT_FILENO;
+
+	/* loglock keeps the file from being closed under us */
+	if (dest == ZLOG_ASYNC_FILE) {
+		pthread_mutex_lock(&loglock);
+		fd = (zlog_default && zlog_default->fp)
+			     ? fileno(zlog_default->fp)
+			     : -1;
+	}
+
+	for (tls = zlog_async.bufs; tls; tls = tls->next) {
+		ring = atomic_load_explicit(&tls->ring[dest],
+					    memory_order_acquire);
+		if (!ring)
+			continue;
+		head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		if (head == tail)
+			continue;
+
+		if (iovcnt + 2 > ZLOG_ASYNC_IOV) {
+			zlog_async_writev(fd, iov, iovcnt, rings, heads, nrings);
+			iovcnt = nrings = 0;
+		}
+
+		off = tail & (ZLOG_ASYNC_RING_SIZE - 1);
+		len = MIN(head - tail, ZLOG_ASYNC_RING_SIZE - off);
+		iov[iovcnt].iov_base = ring->buf + off;
+		iov[iovcnt++].iov_len = len;
+		if (len < head - tail) {
+			iov[iovcnt].iov_base = ring->buf;
+			iov[iovcnt++].iov_len = head - tail - len;
+		}
+		rings[nrings] = ring;
+		heads[nrings++] = head;
+	}
+	zlog_async_writev(fd, iov, iovcnt, rings, heads, nrings);
+
+	if (dest == ZLOG_ASYNC_FILE)
+		pthread_mutex_unlock(&loglock);
+}
+
+static bool zlog_tls_empty(struct zlog_tls *tls)
+{
+	struct zlog_ring *ring;
+	int dest;
+
+	for (dest = 0; dest < ZLOG_ASYNC_DESTS; dest++) {
+		ring = atomic_load_explicit(&tls->ring[dest],
+					    memory_order_acquire);
+		if (ring
+		    && atomic_load_explicit(&ring->head, memory_order_acquire)
+			       != atomic_load_explicit(&ring->tail,
+						       memory_order_relaxed))
+			return false;
+	}
+	return true;
+}
+
+static void zlog_tls_free(struct zlog_tls *tls)
+{
+	int dest;
+
+	for (dest = 0; dest < ZLOG_ASYNC_DESTS; dest++)
+		if (tls->ring[dest])
+			XFREE(MTYPE_ZLOG_BUF, tls->ring[dest]);
+	XFREE(MTYPE_ZLOG_BUF, tls);
+}
+
+/* Writer pthread, with zlog_async.mtx held. */
+static void zlog_async_drain(void)
+{
+	struct zlog_tls *tls, **prev;
+	uint64_t dropped = 0, count;
+
+	zlog_async_drain_dest(ZLOG_ASYNC_FILE);
+	zlog_async_drain_dest(ZLOG_ASYNC_STDOUT);
+
+	prev = &zlog_async.bufs;
+	while ((tls = *prev)) {
+		count = atomic_load_explicit(&tls->dropped,
+					     memory_order_relaxed);
+		dropped += count - tls->dropped_seen;
+		tls->dropped_seen = count;
+
+		if (atomic_load_explicit(&tls->orphaned, memory_order_acquire)
+		    && zlog_tls_empty(tls)) {
+			*prev = tls->next;
+			zlog_tls_free(tls);
+			continue;
+		}
+		prev = &tls->next;
+	}
+
+	/* Goes to the writer's own buffers, written out next time */
+	if (dropped) {
+		atomic_fetch_add_explicit(&zlog_async.dropped, dropped,
+					  memory_order_relaxed);
+		zlog_warn("Log buffers overflowed, %" PRIu64
+			  " messages dropped",
+			  dropped);
+	}
+}
+
+static void *zlog_async_writer(void *arg)
+{
+	struct timespec ts;
+
+	/* Registers our own buffers before we hold the list's lock */
+	zlog_tls_get();
+
+	pthread_mutex_lock(&zlog_async.mtx);
+	while (atomic_load_explicit(&zlog_async.running,
+				    memory_order_relaxed)) {
+		if (!atomic_exchange_explicit(&zlog_async.kicked, false,
+					      memory_order_relaxed)) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += ZLOG_ASYNC_INTERVAL * 1000000L;
+			if (ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&zlog_async.cond,
+					       &zlog_async.mtx, &ts);
+			atomic_store_explicit(&zlog_async.kicked, false,
+					      memory_order_relaxed);
+		}
+		zlog_async_drain();
+	}
+	zlog_async_drain();
+	pthread_mutex_unlock(&zlog_async.mtx);
+
+	return NULL;
+}
+
+void zlog_async_start(void)
+{
+	sigset_t blocked, oldset;
+	int ret;
+
+	if (atomic_load_explicit(&zlog_async.running, memory_order_relaxed))
+		return;
+
+	ret = pthread_key_create(&zlog_async.key, zlog_tls_orphan);
+	if (ret) {
+		zlog_warn("Asynchronous logging unavailable: %s",
+			  safe_strerror(ret));
+		return;
+	}
+
+	/* Signals are for the main thread to handle */
+	sigfillset(&blocked);
+	pthread_sigmask(SIG_BLOCK, &blocked, &oldset);
+
+	atomic_store_explicit(&zlog_async.running, true, memory_order_relaxed);
+	ret = pthread_create(&zlog_async.writer, NULL, zlog_async_writer, NULL);
+	if (ret) {
+		atomic_store_explicit(&zlog_async.running, false,
+				      memory_order_relaxed);
+		pthread_key_delete(zlog_async.key);
+		zlog_warn("Asynchronous logging unavailable: %s",
+			  safe_strerror(ret));
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+}
+
+void zlog_async_stop(void)
+{
+	struct zlog_tls *tls;
+
+	if (!atomic_load_explicit(&zlog_async.running, memory_order_relaxed))
+		return;
+
+	atomic_store_explicit(&zlog_async.running, false, memory_order_relaxed);
+	zlog_async_kick();
+	pthread_join(zlog_async.writer, NULL);
+
+	/* Whatever the others logged since the writer's last look */
+	pthread_mutex_lock(&zlog_async.mtx);
+	zlog_async_drain_dest(ZLOG_ASYNC_FILE);
+	zlog_async_drain_dest(ZLOG_ASYNC_STDOUT);
+	while ((tls = zlog_async.bufs)) {
+		zlog_async.bufs = tls->next;
+		zlog_tls_free(tls);
+	}
+	pthread_mutex_unlock(&zlog_async.mtx);
+
+	pthread_key_delete(zlog_async.key);
+}
+
+bool zlog_async_running(void)
+{
+	return atomic_load_explicit(&zlog_async.running, memory_order_relaxed);
+}
+
+uint64_t zlog_async_dropped(void)
+{
+	return atomic_load_explicit(&zlog_async.dropped, memory_order_relaxed);
+}
+
+/* What the log file has yet to get, when crashing; async-signal-safe. */
+static void zlog_async_flush_sigsafe(int fd)
+{
+	struct zlog_tls *tls;
+	struct zlog_ring *ring;
+	size_t head, tail, off, len;
+
+	if (!atomic_load_explicit(&zlog_async.running, memory_order_relaxed))
+		return;
+
+	for (tls = zlog_async.bufs; tls; tls = tls->next) {
+		ring = atomic_load_explicit(&tls->ring[ZLOG_ASYNC_FILE],
+					    memory_order_acquire);
+		if (!ring)
+			continue;
+		head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		if (head - tail > ZLOG_ASYNC_RING_SIZE)
+			continue;
+
+		off = tail & (ZLOG_ASYNC_RING_SIZE - 1);
+		len = MIN(head - tail, ZLOG_ASYNC_RING_SIZE - off);
+		write_wrapper(fd, ring->buf + off, len);
+		if (len < head - tail)
+			write_wrapper(fd, ring->buf, head - tail - len);
+	}
+}
+
 /* va_list version of zlog. */
 void vzlog(int priority, const char *format, va_list args)
 {
+	int original_errno = errno;
+	struct zlog *zl = zlog_default;
+	bool async_file = false, async_stdout = false;
+	bool to_stderr = zlog_startup_stderr && priority <= LOG_WARNING;
+
+	if (zl && zlog_async_running()) {
+		async_file = (priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp;
+		async_stdout =
+			!to_stderr && priority <= zl->maxlvl[ZLOG_DEST_STDOUT];
+		if (async_file || async_stdout)
+			zlog_async_put(zl, priority, async_file, async_stdout,
+				       format, args);
+
+		/* Skip loglock when there is nothing else to do */
+		if (priority > zl->maxlvl[ZLOG_DEST_SYSLOG] && !to_stderr
+		    && (priority > zl->maxlvl[ZLOG_DEST_MONITOR]
+			|| !vty_log_monitored())) {
+			errno = original_errno;
+			return;
+		}
+	}
+
 	pthread_mutex_lock(&loglock);
 
 	char proto_str[32];
-	int original_errno = errno;
 	struct timestamp_control tsctl;
 	tsctl.already_rendered = 0;
-	struct zlog *zl = zlog_default;
+	zl = zlog_default;
 
 	/* When zlog_default is also NULL, use stderr for logging. */
 	if (zl == NULL) {
@@ -235,7 +705,7 @@ void vzlog(int priority, const char *format, va_list args)
 		sprintf(proto_str, "%s: ", zl->protoname);
 
 	/* File output. */
-	if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp)
+	if ((priority <= zl->maxlvl[ZLOG_DEST_FILE]) && zl->fp && !async_file)
 		vzlog_file(zl, &tsctl, proto_str, zl->record_priority, priority,
 			   zl->fp, format, args);
 
@@ -244,10 +714,10 @@ void vzlog(int priority, const char *format, va_list args)
 	 *
 	 * note the "else" on stdout output -- we don't want to print the same
 	 * message to both stderr and stdout. */
-	if (zlog_startup_stderr && priority <= LOG_WARNING)
+	if (to_stderr)
 		vzlog_file(zl, &tsctl, proto_str, 1, priority, stderr, format,
 			   args);
-	else if (priority <= zl->maxlvl[ZLOG_DEST_STDOUT])
+	else if (priority <= zl->maxlvl[ZLOG_DEST_STDOUT] && !async_stdout)
 		vzlog_file(zl, &tsctl, proto_str, zl->record_priority, priority,
 			   stdout, format, args);
 
@@ -464,6 +934,8 @@ void zlog_signal(int signo, const char *action
 
 #define DUMP(FD) write_wrapper(FD, buf, s-buf);
 	/* If no file logging configured, try to write to fallback log file. */
+	if (logfile_fd >= 0)
+		zlog_async_flush_sigsafe(logfile_fd);
 	if ((logfile_fd >= 0) || ((logfile_fd = open_crashlog()) >= 0))
 		DUMP(logfile_fd)
 	if (!zlog_default)
@@ -968,6 +1440,9 @@ static const struct zebra_desc_table command_types[] = {
 	DESC_ENTRY(ZEBRA_TABLE_MANAGER_CONNECT),
 	DESC_ENTRY(ZEBRA_GET_TABLE_CHUNK),
 	DESC_ENTRY(ZEBRA_RELEASE_TABLE_CHUNK),
+	DESC_ENTRY(ZEBRA_ROUTE_ADD_BULK),
+	DESC_ENTRY(ZEBRA_ROUTE_DELETE_BULK),
+	DESC_ENTRY(ZEBRA_IPMR_ROUTE_STATS_BULK),
 };
 #undef DESC_ENTRY
 
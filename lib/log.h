@@ -140,6 +140,15 @@ extern const char *zlog_sanitize(char *buf, size_t bufsz, const void *in,
 
 extern int vzlog_test(int priority);
 
+/* Hand file and stdout output over to a log writer pthread, so logging
+ * pthreads neither wait for the write nor for each other; see log.c.
+ */
+extern void zlog_async_start(void);
+extern void zlog_async_stop(void);
+extern bool zlog_async_running(void);
+/* Lines dropped because their pthread's buffer was full */
+extern uint64_t zlog_async_dropped(void);
+
 /* structure useful for avoiding repeated rendering of the same timestamp */
 struct timestamp_control {
 	size_t len;			/* length of rendered timestamp */
@@ -28,11 +28,82 @@ DEFINE_MGROUP(LIB, "libfrr")
 DEFINE_MTYPE(LIB, TMP, "Temporary memory")
 DEFINE_MTYPE(LIB, PREFIX_FLOWSPEC, "Prefix Flowspec")
 
-static inline void mt_count_alloc(struct memtype *mt, size_t size)
+static _Atomic unsigned int qmem_sample_every;
+
+void qmem_sample_set(unsigned int every)
+{
+	atomic_store_explicit(&qmem_sample_every, every, memory_order_relaxed);
+}
+
+unsigned int qmem_sample_get(void)
 {
-	size_t oldsize;
+	return atomic_load_explicit(&qmem_sample_every, memory_order_relaxed);
+}
 
-	atomic_fetch_add_explicit(&mt->n_alloc, 1, memory_order_relaxed);
+static inline unsigned int mt_hist_bucket(size_t size)
+{
+	unsigned int bucket;
+
+	if (size <= 16)
+		return 0;
+	bucket = sizeof(unsigned long) * 8 - __builtin_clzl(size - 1) - 4;
+	return MIN(bucket, MTYPE_HIST_BUCKETS - 1U);
+}
+
+/* Count the caller in the first site free or already its own; the first
+ * callers sampled keep their sites, which is good enough to find the
+ * allocations that dominate.
+ */
+static void mt_sample(struct memtype *mt, void *caller)
+{
+	struct memtype_site *site;
+	unsigned int i;
+	void *cur;
+
+	atomic_fetch_add_explicit(&mt->n_sampled, 1, memory_order_relaxed);
+
+	for (i = 0; i < MTYPE_SITES; i++) {
+		site = &mt->sites[i];
+		cur = atomic_load_explicit(&site->caller, memory_order_relaxed);
+		if (!cur
+		    && atomic_compare_exchange_weak_explicit(
+			       &site->caller, &cur, caller,
+			       memory_order_relaxed, memory_order_relaxed))
+			cur = caller;
+		if (cur == caller) {
+			atomic_fetch_add_explicit(&site->count, 1,
+						  memory_order_relaxed);
+			return;
+		}
+	}
+	atomic_fetch_add_explicit(&mt->n_sampled_other, 1,
+				  memory_order_relaxed);
+}
+
+static inline void mt_count_alloc(struct memtype *mt, size_t size,
+				  void *caller)
+{
+	size_t oldsize, n, max;
+	uint64_t total;
+	unsigned int every;
+
+	n = atomic_fetch_add_explicit(&mt->n_alloc, 1, memory_order_relaxed)
+	    + 1;
+	max = atomic_load_explicit(&mt->n_max, memory_order_relaxed);
+	while (n > max
+	       && !atomic_compare_exchange_weak_explicit(&mt->n_max, &max, n,
+							 memory_order_relaxed,
+							 memory_order_relaxed))
+		;
+
+	total = atomic_fetch_add_explicit(&mt->n_total, 1,
+					  memory_order_relaxed);
+	atomic_fetch_add_explicit(&mt->hist[mt_hist_bucket(size)], 1,
+				  memory_order_relaxed);
+
+	every = atomic_load_explicit(&qmem_sample_every, memory_order_relaxed);
+	if (__builtin_expect(every != 0, 0) && total % every == 0)
+		mt_sample(mt, caller);
 
 	oldsize = atomic_load_explicit(&mt->size, memory_order_relaxed);
 	if (oldsize == 0)
@@ -49,36 +120,42 @@ static inline void mt_count_free(struct memtype *mt)
 	atomic_fetch_sub_explicit(&mt->n_alloc, 1, memory_order_relaxed);
 }
 
-static inline void *mt_checkalloc(struct memtype *mt, void *ptr, size_t size)
+/* caller is where the X* macro was used, for sampling */
+static inline void *mt_checkalloc(struct memtype *mt, void *ptr, size_t size,
+				  void *caller)
 {
 	if (__builtin_expect(ptr == NULL, 0)) {
 		memory_oom(size, mt->name);
 		return NULL;
 	}
-	mt_count_alloc(mt, size);
+	mt_count_alloc(mt, size, caller);
 	return ptr;
 }
 
 void *qmalloc(struct memtype *mt, size_t size)
 {
-	return mt_checkalloc(mt, malloc(size), size);
+	return mt_checkalloc(mt, malloc(size), size,
+			     __builtin_return_address(0));
 }
 
 void *qcalloc(struct memtype *mt, size_t size)
 {
-	return mt_checkalloc(mt, calloc(size, 1), size);
+	return mt_checkalloc(mt, calloc(size, 1), size,
+			     __builtin_return_address(0));
 }
 
 void *qrealloc(struct memtype *mt, void *ptr, size_t size)
 {
 	if (ptr)
 		mt_count_free(mt);
-	return mt_checkalloc(mt, ptr ? realloc(ptr, size) : malloc(size), size);
+	return mt_checkalloc(mt, ptr ? realloc(ptr, size) : malloc(size), size,
+			     __builtin_return_address(0));
 }
 
 void *qstrdup(struct memtype *mt, const char *str)
 {
-	return mt_checkalloc(mt, strdup(str), strlen(str) + 1);
+	return mt_checkalloc(mt, strdup(str), strlen(str) + 1,
+			     __builtin_return_address(0));
 }
 
 void qfree(struct memtype *mt, void *ptr)
@@ -88,6 +165,16 @@ void qfree(struct memtype *mt, void *ptr)
 	free(ptr);
 }
 
+void qcount_alloc(struct memtype *mt, size_t size)
+{
+	mt_count_alloc(mt, size, __builtin_return_address(0));
+}
+
+void qcount_free(struct memtype *mt)
+{
+	mt_count_free(mt);
+}
+
 int qmem_walk(qmem_walk_fn *func, void *arg)
 {
 	struct memgroup *mg;
@@ -120,12 +207,12 @@ static int qmem_exit_walker(void *arg, struct memgroup *mg, struct memtype *mt)
 			"memory group %s\n",
 			eda->prefix, mg->name);
 
-	} else if (mt->n_alloc) {
+	} else if (mtype_stats_alloc(mt)) {
 		char size[32];
 		eda->error++;
 		snprintf(size, sizeof(size), "%10zu", mt->size);
 		fprintf(eda->fp, "%s: memstats:  %-30s: %6zu * %s\n",
-			eda->prefix, mt->name, mt->n_alloc,
+			eda->prefix, mt->name, mtype_stats_alloc(mt),
 			mt->size == SIZE_VAR ? "(variably sized)" : size);
 	}
 	return 0;
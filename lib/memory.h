@@ -18,18 +18,51 @@
 #define _QUAGGA_MEMORY_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sys/time.h>
 #include <frratomic.h>
 #include "compiler.h"
 
 #define array_size(ar) (sizeof(ar) / sizeof(ar[0]))
 
 #define SIZE_VAR ~0UL
+
+/* Allocation sizes are counted in power of 2 buckets, from 16 bytes or
+ * less up to more than 16 KiB.
+ */
+#define MTYPE_HIST_BUCKETS 12
+
+/* Callers of the allocations sampled, see qmem_sample_set() */
+#define MTYPE_SITES 4
+
+struct memtype_site {
+	void *_Atomic caller;
+	_Atomic size_t count;
+};
+
+struct mtcache;
+
 struct memtype {
 	struct memtype *next, **ref;
 	const char *name;
 	_Atomic size_t n_alloc;
 	_Atomic size_t size;
+
+	_Atomic size_t n_max;		/* most ever allocated at once */
+	_Atomic uint64_t n_total;	/* allocations ever made */
+	_Atomic size_t hist[MTYPE_HIST_BUCKETS];
+
+	_Atomic size_t n_sampled;
+	_Atomic size_t n_sampled_other; /* from callers not in sites */
+	struct memtype_site sites[MTYPE_SITES];
+
+	/* per-pthread caches, see mtcache.h; NULL if none */
+	struct mtcache *cache;
+
+	/* for "show memory details" rates, vty pthread only */
+	uint64_t rate_total;
+	struct timeval rate_time;
 };
 
 struct memgroup {
@@ -140,6 +173,12 @@ extern void *qstrdup(struct memtype *mt, const char *str)
 	__attribute__((malloc, nonnull(1) _RET_NONNULL));
 extern void qfree(struct memtype *mt, void *ptr) __attribute__((nonnull(1)));
 
+/* accounting for memory handed out by allocators built on top of these,
+ * e.g. objects carved from a slab chunk */
+extern void qcount_alloc(struct memtype *mt, size_t size)
+	__attribute__((nonnull(1)));
+extern void qcount_free(struct memtype *mt) __attribute__((nonnull(1)));
+
 #define XMALLOC(mtype, size)		qmalloc(mtype, size)
 #define XCALLOC(mtype, size)		qcalloc(mtype, size)
 #define XREALLOC(mtype, ptr, size)	qrealloc(mtype, ptr, size)
@@ -150,11 +189,43 @@ extern void qfree(struct memtype *mt, void *ptr) __attribute__((nonnull(1)));
 		ptr = NULL;                                                    \
 	} while (0)
 
+/* objects sitting in, and allocations served from, a memtype's caches */
+extern size_t mtype_cache_idle(struct memtype *mt);
+extern uint64_t mtype_cache_hits(struct memtype *mt);
+
 static inline size_t mtype_stats_alloc(struct memtype *mt)
 {
-	return mt->n_alloc;
+	size_t n = mt->n_alloc, idle;
+
+	if (!mt->cache)
+		return n;
+	idle = mtype_cache_idle(mt);
+	return n > idle ? n - idle : 0;
+}
+
+/* Peak and histogram do not see allocations served from a cache */
+static inline uint64_t mtype_stats_total(struct memtype *mt)
+{
+	uint64_t n = atomic_load_explicit(&mt->n_total, memory_order_relaxed);
+
+	return mt->cache ? n + mtype_cache_hits(mt) : n;
+}
+
+static inline size_t mtype_stats_peak(struct memtype *mt)
+{
+	return mt->n_max;
+}
+
+/* Upper bound of a histogram bucket, 0 for the last one */
+static inline size_t mtype_hist_bound(unsigned int bucket)
+{
+	return bucket < MTYPE_HIST_BUCKETS - 1 ? (size_t)16 << bucket : 0;
 }
 
+/* Record the callers of every nth allocation, 0 not to */
+extern void qmem_sample_set(unsigned int every);
+extern unsigned int qmem_sample_get(void);
+
 /* NB: calls are ordered by memgroup; and there is a call with mt == NULL for
  * each memgroup (so that a header can be printed, and empty memgroups show)
  *
@@ -36,6 +36,9 @@
 #include "vector.h"
 #include "vty.h"
 #include "command.h"
+#include "json.h"
+#include "monotime.h"
+#include "slab.h"
 
 #ifdef HAVE_MALLINFO
 static int show_memory_mallinfo(struct vty *vty)
@@ -73,11 +76,13 @@ static int qmem_walker(void *arg, struct memgroup *mg, struct memtype *mt)
 	if (!mt)
 		vty_out(vty, "--- qmem %s ---\n", mg->name);
 	else {
-		if (mt->n_alloc != 0) {
+		size_t n_alloc = mtype_stats_alloc(mt);
+
+		if (n_alloc != 0) {
 			char size[32];
 			snprintf(size, sizeof(size), "%6zu", mt->size);
 			vty_out(vty, "%-30s: %10zu  %s\n", mt->name,
-				mt->n_alloc,
+				n_alloc,
 				mt->size == 0 ? ""
 					      : mt->size == SIZE_VAR
 							? "(variably sized)"
@@ -102,6 +107,331 @@ DEFUN (show_memory,
 	return CMD_SUCCESS;
 }
 
+struct qmem_details_args {
+	struct vty *vty;
+	json_object *json;
+	json_object *jgroup;
+	struct timeval now;
+};
+
+/* Allocations per second since the previous look. */
+static double qmem_rate(struct memtype *mt, uint64_t total,
+			const struct timeval *now)
+{
+	double rate = -1, elapsed;
+
+	if (mt->rate_time.tv_sec) {
+		elapsed = now->tv_sec - mt->rate_time.tv_sec
+			  + (now->tv_usec - mt->rate_time.tv_usec) / 1000000.0;
+		if (elapsed > 0)
+			rate = (total - mt->rate_total) / elapsed;
+	}
+	mt->rate_total = total;
+	mt->rate_time = *now;
+	return rate;
+}
+
+static void qmem_site_name(void *caller, char *buf, size_t len)
+{
+	Dl_info info;
+
+	if (dladdr(caller, &info) && info.dli_sname)
+		snprintf(buf, len, "%s+0x%lx", info.dli_sname,
+			 (unsigned long)((char *)caller
+					 - (char *)info.dli_saddr));
+	else
+		snprintf(buf, len, "%p", caller);
+}
+
+static json_object *qmem_details_json(struct memtype *mt, uint64_t total,
+				      double rate)
+{
+	json_object *jmt, *jhist, *jsites, *jsite;
+	struct memtype_site *site;
+	char name[128];
+	unsigned int i;
+	size_t count;
+
+	jmt = json_object_new_object();
+	json_object_int_add(jmt, "current", mtype_stats_alloc(mt));
+	json_object_int_add(jmt, "peak", mt->n_max);
+	json_object_int_add(jmt, "total", total);
+	if (rate >= 0)
+		json_object_object_add(jmt, "allocsPerSec",
+				       json_object_new_double(rate));
+	if (mt->size == SIZE_VAR)
+		json_object_boolean_true_add(jmt, "variablySized");
+	else if (mt->size)
+		json_object_int_add(jmt, "size", mt->size);
+
+	jhist = json_object_new_object();
+	for (i = 0; i < MTYPE_HIST_BUCKETS; i++) {
+		count = atomic_load_explicit(&mt->hist[i],
+					     memory_order_relaxed);
+		if (!count)
+			continue;
+		if (mtype_hist_bound(i))
+			snprintf(name, sizeof(name), "upTo%zu",
+				 mtype_hist_bound(i));
+		else
+			snprintf(name, sizeof(name), "over%zu",
+				 mtype_hist_bound(i - 1));
+		json_object_int_add(jhist, name, count);
+	}
+	json_object_object_add(jmt, "sizes", jhist);
+
+	if (!mt->n_sampled)
+		return jmt;
+
+	json_object_int_add(jmt, "sampled", mt->n_sampled);
+	jsites = json_object_new_array();
+	for (i = 0; i < MTYPE_SITES; i++) {
+		site = &mt->sites[i];
+		if (!site->caller)
+			continue;
+		qmem_site_name(site->caller, name, sizeof(name));
+		jsite = json_object_new_object();
+		json_object_string_add(jsite, "caller", name);
+		json_object_int_add(jsite, "count", site->count);
+		json_object_array_add(jsites, jsite);
+	}
+	if (mt->n_sampled_other) {
+		jsite = json_object_new_object();
+		json_object_string_add(jsite, "caller", "other");
+		json_object_int_add(jsite, "count", mt->n_sampled_other);
+		json_object_array_add(jsites, jsite);
+	}
+	json_object_object_add(jmt, "sites", jsites);
+	return jmt;
+}
+
+static int qmem_details_walker(void *arg, struct memgroup *mg,
+			       struct memtype *mt)
+{
+	struct qmem_details_args *args = arg;
+	struct vty *vty = args->vty;
+	uint64_t total;
+	char size[32];
+	double rate;
+
+	if (!mt) {
+		if (args->json) {
+			args->jgroup = json_object_new_object();
+			json_object_object_add(args->json, mg->name,
+					       args->jgroup);
+		} else {
+			vty_out(vty, "--- qmem %s ---\n", mg->name);
+			vty_out(vty, "%-30s  %10s %10s %12s %10s  %s\n", "Type",
+				"Current", "Peak", "Total", "Allocs/s",
+				"Size");
+		}
+		return 0;
+	}
+
+	total = mtype_stats_total(mt);
+	if (!total)
+		return 0;
+	rate = qmem_rate(mt, total, &args->now);
+
+	if (args->json) {
+		json_object_object_add(args->jgroup, mt->name,
+				       qmem_details_json(mt, total, rate));
+		return 0;
+	}
+
+	snprintf(size, sizeof(size), "%zu", mt->size);
+	vty_out(vty, "%-30s: %10zu %10zu %12" PRIu64, mt->name,
+		mtype_stats_alloc(mt), mt->n_max, total);
+	if (rate >= 0)
+		vty_out(vty, " %10.0f", rate);
+	else
+		vty_out(vty, " %10s", "-");
+	vty_out(vty, "  %s\n",
+		mt->size == SIZE_VAR ? "(variably sized)" : size);
+	return 0;
+}
+
+static int qmem_hist_walker(void *arg, struct memgroup *mg,
+			    struct memtype *mt)
+{
+	struct vty *vty = arg;
+	unsigned int i;
+	char bound[16];
+
+	if (!mt) {
+		vty_out(vty, "--- qmem %s ---\n%-30s ", mg->name, "Type");
+		for (i = 0; i < MTYPE_HIST_BUCKETS; i++) {
+			if (mtype_hist_bound(i))
+				snprintf(bound, sizeof(bound), "<=%zu",
+					 mtype_hist_bound(i));
+			else
+				snprintf(bound, sizeof(bound), ">%zu",
+					 mtype_hist_bound(i - 1));
+			vty_out(vty, " %8s", bound);
+		}
+		vty_out(vty, "\n");
+		return 0;
+	}
+
+	if (!mt->n_total)
+		return 0;
+
+	vty_out(vty, "%-30s:", mt->name);
+	for (i = 0; i < MTYPE_HIST_BUCKETS; i++)
+		vty_out(vty, " %8zu",
+			atomic_load_explicit(&mt->hist[i],
+					     memory_order_relaxed));
+	vty_out(vty, "\n");
+	return 0;
+}
+
+static int qmem_sites_walker(void *arg, struct memgroup *mg,
+			     struct memtype *mt)
+{
+	struct vty *vty = arg;
+	struct memtype_site *site;
+	char name[128];
+	unsigned int i;
+
+	if (!mt || !mt->n_sampled)
+		return 0;
+
+	vty_out(vty, "%s: %zu sampled\n", mt->name, mt->n_sampled);
+	for (i = 0; i < MTYPE_SITES; i++) {
+		site = &mt->sites[i];
+		if (!site->caller)
+			continue;
+		qmem_site_name(site->caller, name, sizeof(name));
+		vty_out(vty, "  %10zu  %s\n", site->count, name);
+	}
+	if (mt->n_sampled_other)
+		vty_out(vty, "  %10zu  (other callers)\n", mt->n_sampled_other);
+	return 0;
+}
+
+DEFUN (show_memory_details,
+       show_memory_details_cmd,
+       "show memory details [json]",
+       SHOW_STR
+       "Memory statistics\n"
+       "Peak and total allocations, and their rate since last shown\n"
+       JSON_STR)
+{
+	struct qmem_details_args args = {.vty = vty};
+
+	monotime(&args.now);
+	if (use_json(argc, argv))
+		args.json = json_object_new_object();
+
+	qmem_walk(qmem_details_walker, &args);
+
+	if (args.json) {
+		vty_out(vty, "%s\n", json_object_to_json_string_ext(
+					     args.json, JSON_C_TO_STRING_PRETTY));
+		json_object_free(args.json);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_memory_histogram,
+       show_memory_histogram_cmd,
+       "show memory histogram",
+       SHOW_STR
+       "Memory statistics\n"
+       "Allocations by size\n")
+{
+	qmem_walk(qmem_hist_walker, vty);
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_memory_sites,
+       show_memory_sites_cmd,
+       "show memory sites",
+       SHOW_STR
+       "Memory statistics\n"
+       "Callers of the allocations sampled\n")
+{
+	if (!qmem_sample_get())
+		vty_out(vty, "Allocation sampling is off\n");
+	else
+		vty_out(vty, "Sampling every %u allocations\n",
+			qmem_sample_get());
+	qmem_walk(qmem_sites_walker, vty);
+	return CMD_SUCCESS;
+}
+
+static void show_memory_slab(void *arg, const struct slab_stats *stats)
+{
+	static const char *const pages[] = {
+		[SLAB_PAGES_NORMAL] = "normal",
+		[SLAB_PAGES_TRANSPARENT] = "transparent",
+		[SLAB_PAGES_EXPLICIT] = "explicit",
+	};
+	struct vty *vty = arg;
+
+	vty_out(vty, "%-30s %6zu %10zu %7u %6zuK %-12s %7u\n", stats->name,
+		stats->objsize, stats->count, stats->chunks,
+		stats->chunksize / 1024, pages[stats->pages],
+		stats->hugetlb_chunks);
+}
+
+DEFUN (show_memory_slabs,
+       show_memory_slabs_cmd,
+       "show memory slabs",
+       SHOW_STR
+       "Memory statistics\n"
+       "Fixed-size object slabs and their page backing\n")
+{
+#ifdef GNU_LINUX
+	char line[128];
+	FILE *fp;
+#endif
+
+	vty_out(vty, "%-30s %6s %10s %7s %7s %-12s %7s\n", "Type", "Size",
+		"Objects", "Chunks", "Chunk", "Pages", "Hugetlb");
+	slab_walk(show_memory_slab, vty);
+
+#ifdef GNU_LINUX
+	/* what the kernel actually backed with huge pages, process-wide */
+	fp = fopen("/proc/self/smaps_rollup", "r");
+	if (!fp)
+		return CMD_SUCCESS;
+	vty_out(vty, "\n");
+	while (fgets(line, sizeof(line), fp))
+		if (!strncmp(line, "Rss:", 4)
+		    || !strncmp(line, "AnonHugePages:", 14)
+		    || !strncmp(line, "Private_Hugetlb:", 16))
+			vty_out(vty, "%s", line);
+	fclose(fp);
+#endif
+	return CMD_SUCCESS;
+}
+
+DEFUN (debug_memory_sample,
+       debug_memory_sample_cmd,
+       "debug memory sample (1-1000000)",
+       DEBUG_STR
+       "Memory allocations\n"
+       "Record the callers of some allocations\n"
+       "Every so many allocations of a type\n")
+{
+	qmem_sample_set(strtoul(argv[3]->arg, NULL, 10));
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_debug_memory_sample,
+       no_debug_memory_sample_cmd,
+       "no debug memory sample [(1-1000000)]",
+       NO_STR
+       DEBUG_STR
+       "Memory allocations\n"
+       "Record the callers of some allocations\n"
+       "Every so many allocations of a type\n")
+{
+	qmem_sample_set(0);
+	return CMD_SUCCESS;
+}
+
 DEFUN (show_modules,
        show_modules_cmd,
        "show modules",
@@ -145,6 +475,12 @@ DEFUN (show_modules,
 void memory_init(void)
 {
 	install_element(VIEW_NODE, &show_memory_cmd);
+	install_element(VIEW_NODE, &show_memory_details_cmd);
+	install_element(VIEW_NODE, &show_memory_histogram_cmd);
+	install_element(VIEW_NODE, &show_memory_sites_cmd);
+	install_element(VIEW_NODE, &show_memory_slabs_cmd);
+	install_element(ENABLE_NODE, &debug_memory_sample_cmd);
+	install_element(ENABLE_NODE, &no_debug_memory_sample_cmd);
 	install_element(VIEW_NODE, &show_modules_cmd);
 }
 
@@ -0,0 +1,113 @@
+/*
+ * Lock-free multi-producer, single-consumer queue.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <sched.h>
+
+#include "mpscq.h"
+
+/*
+ * Items form a singly linked list from tail (oldest) to head (newest).
+ * Producers atomically swap themselves in as head and only then link the
+ * previous head to themselves, so for a short while the list may appear to
+ * end early; that is the only way pushing and popping interfere.
+ *
+ * The consumer can't detach the last item without racing producers that
+ * link behind it, so the stub item is pushed behind it first.  Once an item
+ * is found, popping waits for a producer half-way behind it to link up, so
+ * that the item mpscq_peek() saw is the one popped.
+ */
+
+void mpscq_init(struct mpscq *q)
+{
+	atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+	atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+	q->tail = &q->stub;
+	atomic_store_explicit(&q->count, 0, memory_order_relaxed);
+}
+
+static void mpscq_link(struct mpscq *q, struct mpscq_item *item)
+{
+	struct mpscq_item *prev;
+
+	atomic_store_explicit(&item->next, NULL, memory_order_relaxed);
+	prev = atomic_exchange_explicit(&q->head, item, memory_order_acq_rel);
+	atomic_store_explicit(&prev->next, item, memory_order_release);
+}
+
+void mpscq_push(struct mpscq *q, struct mpscq_item *item)
+{
+	/* counted first, so that the count never drops below zero */
+	atomic_fetch_add_explicit(&q->count, 1, memory_order_relaxed);
+	mpscq_link(q, item);
+}
+
+/* Skips the stub, returns the oldest item. */
+static struct mpscq_item *mpscq_first(struct mpscq *q)
+{
+	struct mpscq_item *tail = q->tail;
+	struct mpscq_item *next;
+
+	if (tail == &q->stub) {
+		next = atomic_load_explicit(&tail->next, memory_order_acquire);
+		if (!next)
+			return NULL;
+		q->tail = tail = next;
+	}
+
+	return tail;
+}
+
+struct mpscq_item *mpscq_peek(struct mpscq *q)
+{
+	return mpscq_first(q);
+}
+
+struct mpscq_item *mpscq_next(struct mpscq *q, struct mpscq_item *item)
+{
+	struct mpscq_item *next;
+
+	next = atomic_load_explicit(&item->next, memory_order_acquire);
+	if (next == &q->stub)
+		next = atomic_load_explicit(&next->next, memory_order_acquire);
+
+	return next;
+}
+
+struct mpscq_item *mpscq_pop(struct mpscq *q)
+{
+	struct mpscq_item *tail, *next;
+
+	tail = mpscq_first(q);
+	if (!tail)
+		return NULL;
+
+	next = atomic_load_explicit(&tail->next, memory_order_acquire);
+	if (!next) {
+		if (tail == atomic_load_explicit(&q->head, memory_order_acquire))
+			mpscq_link(q, &q->stub);
+
+		/* someone swapped in behind tail, but did not link it yet */
+		while (!(next = atomic_load_explicit(&tail->next,
+						     memory_order_acquire)))
+			sched_yield();
+	}
+
+	q->tail = next;
+	atomic_fetch_sub_explicit(&q->count, 1, memory_order_relaxed);
+	return tail;
+}
@@ -0,0 +1,102 @@
+/*
+ * Lock-free multi-producer, single-consumer queue.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_MPSCQ_H_
+#define _FRR_MPSCQ_H_
+
+#include <stddef.h>
+
+#include "frratomic.h"
+
+/*
+ * An intrusive FIFO that any number of pthreads may push to concurrently
+ * while one pthread at a time pops from it, without taking any lock.  It is
+ * meant for handing work from one pthread to another.
+ *
+ * Items embed a struct mpscq_item; an item can be on one queue at a time.
+ *
+ * Pushing never blocks.  Peeking and popping may transiently find the queue
+ * empty while a push is half-way done, even though mpscq_count() already
+ * accounts for it; the pusher is expected to notify the consumer after
+ * mpscq_push() returns, at which point the item is guaranteed to be visible.
+ * An item mpscq_peek() returned is always the one mpscq_pop() returns next.
+ */
+struct mpscq_item {
+	struct mpscq_item *_Atomic next;
+};
+
+struct mpscq {
+	/* most recently pushed item, producers swap themselves in here */
+	struct mpscq_item *_Atomic head;
+	/* oldest item, only touched by the consumer */
+	struct mpscq_item *tail;
+	/* placeholder keeping the list non-empty */
+	struct mpscq_item stub;
+
+	_Atomic size_t count;
+};
+
+/*
+ * Initializes an empty queue.
+ *
+ * @param q	the queue to initialize
+ */
+void mpscq_init(struct mpscq *q);
+
+/*
+ * Appends an item to the queue; may be called from any pthread.
+ *
+ * @param q	the queue
+ * @param item	the item to append
+ */
+void mpscq_push(struct mpscq *q, struct mpscq_item *item);
+
+/*
+ * Removes the oldest item from the queue; consumer only.
+ *
+ * @param q	the queue
+ * @return the item, or NULL if none is available
+ */
+struct mpscq_item *mpscq_pop(struct mpscq *q);
+
+/*
+ * Returns the oldest item without removing it; consumer only.
+ *
+ * @param q	the queue
+ * @return the item, or NULL if none is available
+ */
+struct mpscq_item *mpscq_peek(struct mpscq *q);
+
+/*
+ * Returns the item queued after one returned by mpscq_peek() or a previous
+ * call, without removing anything; consumer only.
+ *
+ * @param q	the queue
+ * @param item	an item currently on the queue
+ * @return the next item, or NULL if none is available
+ */
+struct mpscq_item *mpscq_next(struct mpscq *q, struct mpscq_item *item);
+
+/*
+ * Number of items pushed and not yet popped; may be called from any pthread.
+ */
+static inline size_t mpscq_count(struct mpscq *q)
+{
+	return atomic_load_explicit(&q->count, memory_order_relaxed);
+}
+
+#endif /* _FRR_MPSCQ_H_ */
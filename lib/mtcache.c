@@ -0,0 +1,336 @@
+/*
+ * Per-pthread caches of fixed-size objects.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <pthread.h>
+
+#include "mtcache.h"
+#include "memory.h"
+#include "mpscq.h"
+
+DEFINE_MTYPE_STATIC(LIB, MTCACHE, "Memtype cache")
+DEFINE_MTYPE_STATIC(LIB, MTCACHE_TLS, "Memtype cache pthread")
+
+struct mtcache_tls;
+
+/* Header in front of each object, keeping objects as aligned as malloc's */
+struct mtcache_obj {
+	struct mtcache_tls *owner;
+	union {
+		/* on the owner's free list */
+		struct mtcache_obj *next;
+		/* on the owner's return queue */
+		struct mpscq_item mq;
+	};
+} __attribute__((aligned(16)));
+
+struct mtcache_tls {
+	struct mtcache *cache;
+	/* on cache->threads, never removed until mtcache_del() */
+	struct mtcache_tls *next;
+
+	/* owner pthread only, or under cache->mtx once it exited */
+	struct mtcache_obj *freelist;
+	/* written by the owner only, read by "show memory" */
+	_Atomic unsigned int nfree;
+	_Atomic uint64_t hits;
+
+	/* objects freed by other pthreads, consumed under cache->mtx
+	 * once the owner exited */
+	struct mpscq returned;
+	/* owner pthread exited; objects it allocated go back to the system
+	 * when freed */
+	_Atomic bool orphaned;
+};
+
+struct mtcache {
+	struct memtype *mt;
+	/* other caches of the memtype */
+	struct mtcache *next;
+	size_t objsize;
+	unsigned int depth;
+
+	pthread_key_t key;
+	pthread_mutex_t mtx;
+	struct mtcache_tls *threads;
+};
+
+static void mtcache_obj_release(struct mtcache *cache,
+				struct mtcache_obj *obj)
+{
+	qcount_free(cache->mt);
+	free(obj);
+}
+
+static inline struct mtcache_obj *mtcache_mq_obj(struct mpscq_item *item)
+{
+	return (struct mtcache_obj *)((char *)item
+				      - offsetof(struct mtcache_obj, mq));
+}
+
+/* Gives all of a pthread's cached objects back to the system. */
+static unsigned int mtcache_tls_drain(struct mtcache_tls *tls)
+{
+	struct mtcache_obj *obj;
+	struct mpscq_item *item;
+	unsigned int n = 0;
+
+	while ((item = mpscq_pop(&tls->returned))) {
+		mtcache_obj_release(tls->cache, mtcache_mq_obj(item));
+		n++;
+	}
+	while ((obj = tls->freelist)) {
+		tls->freelist = obj->next;
+		mtcache_obj_release(tls->cache, obj);
+		n++;
+	}
+	atomic_store_explicit(&tls->nfree, 0, memory_order_relaxed);
+	return n;
+}
+
+/*
+ * Runs when a pthread that used the cache exits.
+ *
+ * Another pthread may still push an object on the return queue after it is
+ * drained here; mtcache_reclaim() gives such stragglers back.
+ */
+static void mtcache_tls_fini(void *arg)
+{
+	struct mtcache_tls *tls = arg;
+	struct mtcache *cache = tls->cache;
+
+	pthread_mutex_lock(&cache->mtx);
+	{
+		atomic_store_explicit(&tls->orphaned, true,
+				      memory_order_seq_cst);
+		mtcache_tls_drain(tls);
+	}
+	pthread_mutex_unlock(&cache->mtx);
+}
+
+static struct mtcache_tls *mtcache_tls_get(struct mtcache *cache)
+{
+	struct mtcache_tls *tls = pthread_getspecific(cache->key);
+
+	if (__builtin_expect(tls != NULL, 1))
+		return tls;
+
+	tls = XCALLOC(MTYPE_MTCACHE_TLS, sizeof(*tls));
+	tls->cache = cache;
+	mpscq_init(&tls->returned);
+	pthread_setspecific(cache->key, tls);
+
+	pthread_mutex_lock(&cache->mtx);
+	{
+		tls->next = cache->threads;
+		cache->threads = tls;
+	}
+	pthread_mutex_unlock(&cache->mtx);
+	return tls;
+}
+
+/* Takes back objects other pthreads freed, returns the new free count. */
+static unsigned int mtcache_tls_refill(struct mtcache_tls *tls,
+				       unsigned int nfree)
+{
+	struct mtcache_obj *obj;
+	struct mpscq_item *item;
+
+	while (nfree < tls->cache->depth
+	       && (item = mpscq_pop(&tls->returned))) {
+		obj = mtcache_mq_obj(item);
+		obj->next = tls->freelist;
+		tls->freelist = obj;
+		nfree++;
+	}
+	return nfree;
+}
+
+struct mtcache *mtcache_new(struct memtype *mt, size_t objsize,
+			    unsigned int depth)
+{
+	struct mtcache *cache;
+
+	assert(objsize > 0 && depth > 0);
+
+	cache = XCALLOC(MTYPE_MTCACHE, sizeof(*cache));
+	cache->mt = mt;
+	cache->objsize = objsize;
+	cache->depth = depth;
+	pthread_key_create(&cache->key, mtcache_tls_fini);
+	pthread_mutex_init(&cache->mtx, NULL);
+
+	cache->next = mt->cache;
+	mt->cache = cache;
+	return cache;
+}
+
+void mtcache_del(struct mtcache *cache)
+{
+	struct mtcache_tls *tls;
+	struct mtcache **prev;
+
+	pthread_key_delete(cache->key);
+
+	for (prev = &cache->mt->cache; *prev != cache; prev = &(*prev)->next)
+		;
+	*prev = cache->next;
+
+	while ((tls = cache->threads)) {
+		cache->threads = tls->next;
+		mtcache_tls_drain(tls);
+		XFREE(MTYPE_MTCACHE_TLS, tls);
+	}
+
+	pthread_mutex_destroy(&cache->mtx);
+	XFREE(MTYPE_MTCACHE, cache);
+}
+
+void *mtcache_alloc(struct mtcache *cache)
+{
+	struct mtcache_tls *tls = mtcache_tls_get(cache);
+	struct mtcache_obj *obj;
+	unsigned int nfree;
+
+	nfree = atomic_load_explicit(&tls->nfree, memory_order_relaxed);
+	if (!tls->freelist)
+		nfree = mtcache_tls_refill(tls, nfree);
+
+	obj = tls->freelist;
+	if (obj) {
+		tls->freelist = obj->next;
+		atomic_store_explicit(&tls->nfree, nfree - 1,
+				      memory_order_relaxed);
+		atomic_store_explicit(
+			&tls->hits,
+			atomic_load_explicit(&tls->hits, memory_order_relaxed)
+				+ 1,
+			memory_order_relaxed);
+		return obj + 1;
+	}
+	atomic_store_explicit(&tls->nfree, nfree, memory_order_relaxed);
+
+	obj = malloc(sizeof(*obj) + cache->objsize);
+	if (__builtin_expect(obj == NULL, 0)) {
+		memory_oom(cache->objsize, cache->mt->name);
+		return NULL;
+	}
+	qcount_alloc(cache->mt, cache->objsize);
+	obj->owner = tls;
+	return obj + 1;
+}
+
+void mtcache_free(struct mtcache *cache, void *ptr)
+{
+	struct mtcache_tls *tls, *owner;
+	struct mtcache_obj *obj;
+	unsigned int nfree;
+
+	if (!ptr)
+		return;
+
+	obj = (struct mtcache_obj *)ptr - 1;
+	owner = obj->owner;
+	tls = pthread_getspecific(cache->key);
+
+	if (owner == tls) {
+		nfree = atomic_load_explicit(&tls->nfree,
+					     memory_order_relaxed);
+		if (nfree < cache->depth) {
+			obj->next = tls->freelist;
+			tls->freelist = obj;
+			atomic_store_explicit(&tls->nfree, nfree + 1,
+					      memory_order_relaxed);
+			return;
+		}
+	} else if (!atomic_load_explicit(&owner->orphaned,
+					 memory_order_seq_cst)
+		   && mpscq_count(&owner->returned) < cache->depth) {
+		mpscq_push(&owner->returned, &obj->mq);
+		return;
+	}
+
+	mtcache_obj_release(cache, obj);
+}
+
+unsigned int mtcache_reclaim(struct mtcache *cache)
+{
+	struct mtcache_tls *self = pthread_getspecific(cache->key), *tls;
+	unsigned int n = 0;
+
+	pthread_mutex_lock(&cache->mtx);
+	{
+		for (tls = cache->threads; tls; tls = tls->next)
+			if (tls == self
+			    || atomic_load_explicit(&tls->orphaned,
+						    memory_order_seq_cst))
+				n += mtcache_tls_drain(tls);
+	}
+	pthread_mutex_unlock(&cache->mtx);
+	return n;
+}
+
+static size_t mtcache_idle(struct mtcache *cache)
+{
+	struct mtcache_tls *tls;
+	size_t n = 0;
+
+	pthread_mutex_lock(&cache->mtx);
+	{
+		for (tls = cache->threads; tls; tls = tls->next)
+			n += atomic_load_explicit(&tls->nfree,
+						  memory_order_relaxed)
+			     + mpscq_count(&tls->returned);
+	}
+	pthread_mutex_unlock(&cache->mtx);
+	return n;
+}
+
+static uint64_t mtcache_hits(struct mtcache *cache)
+{
+	struct mtcache_tls *tls;
+	uint64_t n = 0;
+
+	pthread_mutex_lock(&cache->mtx);
+	{
+		for (tls = cache->threads; tls; tls = tls->next)
+			n += atomic_load_explicit(&tls->hits,
+						  memory_order_relaxed);
+	}
+	pthread_mutex_unlock(&cache->mtx);
+	return n;
+}
+
+size_t mtype_cache_idle(struct memtype *mt)
+{
+	struct mtcache *cache;
+	size_t n = 0;
+
+	for (cache = mt->cache; cache; cache = cache->next)
+		n += mtcache_idle(cache);
+	return n;
+}
+
+uint64_t mtype_cache_hits(struct memtype *mt)
+{
+	struct mtcache *cache;
+	uint64_t n = 0;
+
+	for (cache = mt->cache; cache; cache = cache->next)
+		n += mtcache_hits(cache);
+	return n;
+}
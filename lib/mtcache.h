@@ -0,0 +1,98 @@
+/*
+ * Per-pthread caches of fixed-size objects.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_MTCACHE_H_
+#define _FRR_MTCACHE_H_
+
+#include "memory.h"
+
+/*
+ * An mtcache keeps freed objects of one memtype and size on a free list per
+ * pthread, so that objects allocated and freed over and over, such as the
+ * streams carrying packets, hit neither malloc nor the memtype's atomic
+ * counters.
+ *
+ * Each object remembers the pthread that allocated it.  An object freed by
+ * another pthread is pushed on its allocator's return queue, which the
+ * allocator takes back when its own free list runs dry; objects handed from
+ * one pthread to another thus cycle between the two instead of piling up on
+ * the freeing side.
+ *
+ * Objects are accounted against the memtype when first allocated from the
+ * system and until given back to it; "show memory" leaves out those sitting
+ * in a cache, and counts allocations served from a cache in the total.
+ *
+ * A memtype may have several mtcaches, e.g. one per size class.  Any
+ * pthread may allocate from and free to a cache; creating and deleting
+ * caches is for when other pthreads do not use the memtype.
+ */
+struct mtcache;
+
+/*
+ * Creates a new cache.
+ *
+ * @param mt		memtype objects are accounted against
+ * @param objsize	object size, in bytes
+ * @param depth		most objects kept per pthread, on its free list and
+ *			on its return queue each
+ * @return the newly created cache
+ */
+struct mtcache *mtcache_new(struct memtype *mt, size_t objsize,
+			    unsigned int depth);
+
+/*
+ * Deletes a cache, giving the objects it holds back to the system.
+ *
+ * No object may be allocated from the cache any more, and no other pthread
+ * may be using it.
+ *
+ * @param cache	the cache to destroy
+ */
+void mtcache_del(struct mtcache *cache);
+
+/*
+ * Allocates an object; its contents are undefined.
+ *
+ * @param cache	the cache to allocate from
+ * @return the new object
+ */
+void *mtcache_alloc(struct mtcache *cache);
+
+/*
+ * Returns an object to the cache; may be called from any pthread.
+ *
+ * @param cache	the cache obj was allocated from
+ * @param obj	the object to free, may be NULL
+ */
+void mtcache_free(struct mtcache *cache, void *obj);
+
+/*
+ * Gives the objects cached by the calling pthread, and by pthreads that
+ * have exited, back to the system.
+ *
+ * @param cache	the cache to trim
+ * @return number of objects released
+ */
+unsigned int mtcache_reclaim(struct mtcache *cache);
+
+#define MTCACHE_FREE(cache, ptr)                                               \
+	do {                                                                   \
+		mtcache_free(cache, ptr);                                      \
+		ptr = NULL;                                                    \
+	} while (0)
+
+#endif /* _FRR_MTCACHE_H_ */
@@ -31,7 +31,7 @@
 #include "prefix.h"
 #include "nexthop.h"
 #include "mpls.h"
-#include "jhash.h"
+#include "hashfn.h"
 
 DEFINE_MTYPE_STATIC(LIB, NEXTHOP, "Nexthop")
 DEFINE_MTYPE_STATIC(LIB, NH_LABEL, "Nexthop label")
@@ -164,55 +164,73 @@ void nexthops_free(struct nexthop *nexthop)
 	}
 }
 
-bool nexthop_same(const struct nexthop *nh1, const struct nexthop *nh2)
+void nexthop_key_make(struct nexthop_key *key, const struct nexthop *nh,
+		      bool full)
 {
-	if (nh1 && !nh2)
-		return false;
+	const struct mpls_label_stack *nhl = nh->nh_label;
+	uint64_t h;
 
-	if (!nh1 && nh2)
-		return false;
+	memset(key, 0, sizeof(*key));
+	key->vrf_id = nh->vrf_id;
+	key->type = nh->type;
 
-	if (nh1 == nh2)
-		return true;
-
-	if (nh1->vrf_id != nh2->vrf_id)
-		return false;
-
-	if (nh1->type != nh2->type)
-		return false;
-
-	switch (nh1->type) {
+	switch (nh->type) {
 	case NEXTHOP_TYPE_IFINDEX:
-		if (nh1->ifindex != nh2->ifindex)
-			return false;
-		break;
-	case NEXTHOP_TYPE_IPV4:
-		if (nh1->gate.ipv4.s_addr != nh2->gate.ipv4.s_addr)
-			return false;
+		key->ifindex = nh->ifindex;
 		break;
 	case NEXTHOP_TYPE_IPV4_IFINDEX:
-		if (nh1->gate.ipv4.s_addr != nh2->gate.ipv4.s_addr)
-			return false;
-		if (nh1->ifindex != nh2->ifindex)
-			return false;
-		break;
-	case NEXTHOP_TYPE_IPV6:
-		if (memcmp(&nh1->gate.ipv6, &nh2->gate.ipv6, 16))
-			return false;
+		key->ifindex = nh->ifindex;
+	/* fallthru */
+	case NEXTHOP_TYPE_IPV4:
+		key->gate.ipv4 = nh->gate.ipv4;
 		break;
 	case NEXTHOP_TYPE_IPV6_IFINDEX:
-		if (memcmp(&nh1->gate.ipv6, &nh2->gate.ipv6, 16))
-			return false;
-		if (nh1->ifindex != nh2->ifindex)
-			return false;
+		key->ifindex = nh->ifindex;
+	/* fallthru */
+	case NEXTHOP_TYPE_IPV6:
+		key->gate.ipv6 = nh->gate.ipv6;
 		break;
 	case NEXTHOP_TYPE_BLACKHOLE:
-		if (nh1->bh_type != nh2->bh_type)
-			return false;
+		key->gate.ipv4.s_addr = nh->bh_type;
 		break;
 	}
 
-	return true;
+	if (!full)
+		return;
+
+	key->src = nh->src;
+	key->flags = nh->flags & NEXTHOP_FLAG_ONLINK;
+	if (!nhl)
+		return;
+
+	key->label_type = nh->nh_label_type;
+	key->num_labels = nhl->num_labels;
+	if (nhl->num_labels <= NEXTHOP_KEY_LABELS) {
+		memcpy(key->label, nhl->label,
+		       nhl->num_labels * sizeof(mpls_label_t));
+	} else {
+		h = hashfn64(nhl->label, nhl->num_labels * sizeof(mpls_label_t),
+			     0);
+		memcpy(key->label, &h, sizeof(key->label));
+	}
+}
+
+bool nexthop_same(const struct nexthop *nh1, const struct nexthop *nh2)
+{
+	struct nexthop_key k1, k2;
+
+	if (nh1 && !nh2)
+		return false;
+
+	if (!nh1 && nh2)
+		return false;
+
+	if (nh1 == nh2)
+		return true;
+
+	nexthop_key_make(&k1, nh1, false);
+	nexthop_key_make(&k2, nh2, false);
+	return nexthop_key_same(&k1, &k2);
 }
 
 /* Update nexthop with label information. */
@@ -314,12 +332,8 @@ unsigned int nexthop_level(struct nexthop *nexthop)
 
 uint32_t nexthop_hash(struct nexthop *nexthop)
 {
-	uint32_t key;
-
-	key = jhash_1word(nexthop->vrf_id, 0x45afe398);
-	key = jhash_1word(nexthop->ifindex, key);
-	key = jhash_1word(nexthop->type, key);
-	key = jhash(&nexthop->gate, sizeof(union g_addr), key);
+	struct nexthop_key key;
 
-	return key;
+	nexthop_key_make(&key, nexthop, false);
+	return hashfn(&key, sizeof(key), 0x45afe398);
 }
@@ -109,6 +109,57 @@ struct nexthop {
 	struct mpls_label_stack *nh_label;
 };
 
+/*
+ * Canonical packed form of a nexthop, for hashing and comparing nexthops
+ * wholesale.  The fields that make up a nexthop's identity sit at fixed
+ * places, with whatever its type does not use zeroed and no padding, so a
+ * key is hashed in one go and compared with memcmp().
+ *
+ * Up to NEXTHOP_KEY_LABELS labels are held inline.  Longer stacks leave a
+ * hash of the stack in their place; two such keys being equal still needs
+ * the label stacks themselves compared, see nexthop_key_exact().
+ */
+#define NEXTHOP_KEY_LABELS 2
+
+struct nexthop_key {
+	/* gateway, zero-padded for IPv4; blackhole type for blackholes */
+	union g_addr gate;
+	union g_addr src;
+	vrf_id_t vrf_id;
+	ifindex_t ifindex;
+	uint8_t type;
+	/* NEXTHOP_FLAG_ONLINK */
+	uint8_t flags;
+	uint8_t label_type;
+	uint8_t num_labels;
+	mpls_label_t label[NEXTHOP_KEY_LABELS];
+};
+
+/*
+ * Fills in the key of a nexthop.
+ *
+ * @param key	the key to fill in
+ * @param nh	the nexthop
+ * @param full	false for what nexthop_same() compares: vrf, type, gateway
+ *		and the interface of types that have one.  true adds what a
+ *		nexthop is installed with: the onlink flag, the source
+ *		address and the labels.
+ */
+extern void nexthop_key_make(struct nexthop_key *key, const struct nexthop *nh,
+			     bool full);
+
+static inline bool nexthop_key_same(const struct nexthop_key *k1,
+				    const struct nexthop_key *k2)
+{
+	return !memcmp(k1, k2, sizeof(*k1));
+}
+
+/* Whether equal keys mean equal nexthops, i.e. the labels fit inline. */
+static inline bool nexthop_key_exact(const struct nexthop_key *key)
+{
+	return key->num_labels <= NEXTHOP_KEY_LABELS;
+}
+
 struct nexthop *nexthop_new(void);
 
 void nexthop_free(struct nexthop *nexthop);
@@ -121,9 +172,11 @@ void nexthop_del_labels(struct nexthop *);
 /*
  * Hash a nexthop. Suitable for use with hash tables.
  *
- * This function uses the following values when computing the hash:
+ * This function hashes the key nexthop_key_make() builds without the
+ * installation details, so that nexthops nexthop_same() considers equal
+ * hash the same:
  * - vrf_id
- * - ifindex
+ * - ifindex, for types that have one
  * - type
  * - gate
  *
@@ -0,0 +1,91 @@
+/*
+ * Latency histograms of pipeline stages.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "pipeline_stats.h"
+
+void pipeline_stage_add(struct pipeline_stage *stage, int64_t usecs)
+{
+	if (usecs < 0)
+		usecs = 0;
+
+	stage->count++;
+	stage->total += usecs;
+	if ((uint64_t)usecs > stage->max)
+		stage->max = usecs;
+	stage->hist[thread_hist_bucket(usecs)]++;
+}
+
+void pipeline_stages_clear(struct pipeline_stage *stages, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		stages[i].count = stages[i].total = stages[i].max = 0;
+		memset(stages[i].hist, 0, sizeof(stages[i].hist));
+	}
+}
+
+void pipeline_stages_show(struct vty *vty, struct pipeline_stage *stages,
+			  unsigned int count, json_object *json)
+{
+	struct pipeline_stage *st;
+	json_object *jstage, *jhist;
+	unsigned int i;
+	int b;
+
+	if (!json)
+		vty_out(vty, "%-12s %10s %10s %10s  %s\n", "Stage", "Samples",
+			"Avg usecs", "Max usecs", "Samples per bucket (usecs)");
+
+	for (i = 0; i < count; i++) {
+		st = &stages[i];
+
+		if (json) {
+			jstage = json_object_new_object();
+			json_object_string_add(jstage, "description", st->desc);
+			json_object_int_add(jstage, "samples", st->count);
+			json_object_int_add(jstage, "totalUsecs", st->total);
+			json_object_int_add(jstage, "maxUsecs", st->max);
+			jhist = json_object_new_array();
+			for (b = 0; b < THREAD_HIST_BUCKETS; b++)
+				json_object_array_add(
+					jhist, json_object_new_int64(st->hist[b]));
+			json_object_object_add(jstage, "histogram", jhist);
+			json_object_object_add(json, st->name, jstage);
+			continue;
+		}
+
+		vty_out(vty, "%-12s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " ",
+			st->name, st->count,
+			st->count ? st->total / st->count : 0, st->max);
+		for (b = 0; b < THREAD_HIST_BUCKETS - 1; b++)
+			if (st->hist[b])
+				vty_out(vty, " <%lu:%u", 1UL << b, st->hist[b]);
+		if (st->hist[b])
+			vty_out(vty, " >=%lu:%u", 1UL << (b - 1), st->hist[b]);
+		vty_out(vty, "\n");
+	}
+
+	if (!json) {
+		vty_out(vty, "\n");
+		for (i = 0; i < count; i++)
+			vty_out(vty, "  %-12s %s\n", stages[i].name,
+				stages[i].desc);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Latency histograms of pipeline stages.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_PIPELINE_STATS_H_
+#define _FRR_PIPELINE_STATS_H_
+
+#include "monotime.h"
+#include "thread.h"
+#include "vty.h"
+#include "json.h"
+
+/*
+ * Time spent by sampled objects in each stage of a pipeline, such as the
+ * one routes go through from the UPDATE carrying them to the kernel.
+ * Histograms use the buckets of thread_hist_bucket().
+ *
+ * Not thread-safe; stages are meant to be recorded from one pthread.
+ */
+struct pipeline_stage {
+	const char *name;
+	const char *desc;
+
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	unsigned int hist[THREAD_HIST_BUCKETS];
+};
+
+/*
+ * Microseconds on the monotonic clock.  Being the same clock in all
+ * processes of a host, timestamps can be passed between daemons.
+ */
+static inline int64_t pipeline_now(void)
+{
+	struct timeval tv;
+
+	monotime(&tv);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*
+ * Records usecs spent in a stage; negative values, from timestamps being
+ * taken on different CPUs, count as 0.
+ */
+extern void pipeline_stage_add(struct pipeline_stage *stage, int64_t usecs);
+
+extern void pipeline_stages_clear(struct pipeline_stage *stages,
+				  unsigned int count);
+
+/*
+ * Shows stages, in order, as a table or, if json is not NULL, as an object
+ * added to json for each stage.
+ */
+extern void pipeline_stages_show(struct vty *vty,
+				 struct pipeline_stage *stages,
+				 unsigned int count, json_object *json);
+
+#endif /* _FRR_PIPELINE_STATS_H_ */
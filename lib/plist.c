@@ -30,33 +30,13 @@
 #include "routemap.h"
 #include "lib/json.h"
 #include "libfrr.h"
+#include "table.h"
 
 #include "plist_int.h"
 
 DEFINE_MTYPE_STATIC(LIB, PREFIX_LIST, "Prefix List")
 DEFINE_MTYPE_STATIC(LIB, MPREFIX_LIST_STR, "Prefix List Str")
 DEFINE_MTYPE_STATIC(LIB, PREFIX_LIST_ENTRY, "Prefix List Entry")
-DEFINE_MTYPE_STATIC(LIB, PREFIX_LIST_TRIE, "Prefix List Trie Table")
-
-/* not currently changeable, code assumes bytes further down */
-#define PLC_BITS	8
-#define PLC_LEN		(1 << PLC_BITS)
-#define PLC_MAXLEVELV4	2	/* /24 for IPv4 */
-#define PLC_MAXLEVELV6	4	/* /48 for IPv6 */
-#define PLC_MAXLEVEL	4	/* max(v4,v6) */
-
-struct pltrie_entry {
-	union {
-		struct pltrie_table *next_table;
-		struct prefix_list_entry *final_chain;
-	};
-
-	struct prefix_list_entry *up_chain;
-};
-
-struct pltrie_table {
-	struct pltrie_entry entries[PLC_LEN];
-};
 
 /* List of struct prefix_list. */
 struct prefix_list_list {
@@ -83,29 +63,26 @@ struct prefix_master {
 
 	/* Hook function which is executed when prefix_list is deleted. */
 	void (*delete_hook)(struct prefix_list *);
-
-	/* number of bytes that have a trie level */
-	size_t trie_depth;
 };
 
 /* Static structure of IPv4 prefix_list's master. */
 static struct prefix_master prefix_master_ipv4 = {
-	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL, PLC_MAXLEVELV4,
+	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL,
 };
 
 /* Static structure of IPv6 prefix-list's master. */
 static struct prefix_master prefix_master_ipv6 = {
-	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL, PLC_MAXLEVELV6,
+	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL,
 };
 
 /* Static structure of BGP ORF prefix_list's master. */
 static struct prefix_master prefix_master_orf_v4 = {
-	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL, PLC_MAXLEVELV4,
+	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL,
 };
 
 /* Static structure of BGP ORF prefix_list's master. */
 static struct prefix_master prefix_master_orf_v6 = {
-	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL, PLC_MAXLEVELV6,
+	{NULL, NULL}, {NULL, NULL}, 1, NULL, NULL, NULL,
 };
 
 static struct prefix_master *prefix_master_get(afi_t afi, int orf)
@@ -212,8 +189,7 @@ static struct prefix_list *prefix_list_insert(afi_t afi, int orf,
 	plist = prefix_list_new();
 	plist->name = XSTRDUP(MTYPE_MPREFIX_LIST_STR, name);
 	plist->master = master;
-	plist->trie =
-		XCALLOC(MTYPE_PREFIX_LIST_TRIE, sizeof(struct pltrie_table));
+	plist->trie = route_table_init();
 
 	/* If name is made by all digit character.  We treat it as
 	   number. */
@@ -341,7 +317,7 @@ static void prefix_list_delete(struct prefix_list *plist)
 	if (plist->name)
 		XFREE(MTYPE_MPREFIX_LIST_STR, plist->name);
 
-	XFREE(MTYPE_PREFIX_LIST_TRIE, plist->trie);
+	route_table_finish(plist->trie);
 
 	prefix_list_free(plist);
 }
@@ -416,8 +392,15 @@ prefix_list_entry_lookup(struct prefix_list *plist, struct prefix *prefix,
 			 enum prefix_list_type type, int seq, int le, int ge)
 {
 	struct prefix_list_entry *pentry;
+	struct route_node *rn;
 
-	for (pentry = plist->head; pentry; pentry = pentry->next)
+	/* only entries on the prefix's own trie node can be the same, in
+	 * sequence order as on the list */
+	rn = route_node_lookup(plist->trie, prefix);
+	if (!rn)
+		return NULL;
+
+	for (pentry = rn->info; pentry; pentry = pentry->next_best)
 		if (prefix_same(&pentry->prefix, prefix)
 		    && pentry->type == type) {
 			if (seq >= 0 && pentry->seq != seq)
@@ -428,77 +411,31 @@ prefix_list_entry_lookup(struct prefix_list *plist, struct prefix *prefix,
 			if (pentry->ge != ge)
 				continue;
 
-			return pentry;
-		}
-
-	return NULL;
-}
-
-static void trie_walk_affected(size_t validbits, struct pltrie_table *table,
-			       uint8_t byte, struct prefix_list_entry *object,
-			       void (*fn)(struct prefix_list_entry *object,
-					  struct prefix_list_entry **updptr))
-{
-	uint8_t mask;
-	uint16_t bwalk;
-
-	if (validbits > PLC_BITS) {
-		fn(object, &table->entries[byte].final_chain);
-		return;
-	}
-
-	mask = (1 << (8 - validbits)) - 1;
-	for (bwalk = byte & ~mask; bwalk <= byte + mask; bwalk++) {
-		fn(object, &table->entries[bwalk].up_chain);
-	}
-}
-
-static void trie_uninstall_fn(struct prefix_list_entry *object,
-			      struct prefix_list_entry **updptr)
-{
-	for (; *updptr; updptr = &(*updptr)->next_best)
-		if (*updptr == object) {
-			*updptr = object->next_best;
 			break;
 		}
-}
 
-static int trie_table_empty(struct pltrie_table *table)
-{
-	size_t i;
-	for (i = 0; i < PLC_LEN; i++)
-		if (table->entries[i].next_table || table->entries[i].up_chain)
-			return 0;
-	return 1;
+	route_unlock_node(rn);
+	return pentry;
 }
 
 static void prefix_list_trie_del(struct prefix_list *plist,
 				 struct prefix_list_entry *pentry)
 {
-	size_t depth, maxdepth = plist->master->trie_depth;
-	uint8_t *bytes = &pentry->prefix.u.prefix;
-	size_t validbits = pentry->prefix.prefixlen;
-	struct pltrie_table *table, **tables[PLC_MAXLEVEL];
+	struct route_node *rn;
+	struct prefix_list_entry **pp;
 
-	table = plist->trie;
-	for (depth = 0; validbits > PLC_BITS && depth < maxdepth - 1; depth++) {
-		uint8_t byte = bytes[depth];
-		assert(table->entries[byte].next_table);
+	rn = route_node_lookup(plist->trie, &pentry->prefix);
+	assert(rn);
 
-		tables[depth + 1] = &table->entries[byte].next_table;
-		table = table->entries[byte].next_table;
+	for (pp = (struct prefix_list_entry **)&rn->info; *pp != pentry;
+	     pp = &(*pp)->next_best)
+		assert(*pp);
+	*pp = pentry->next_best;
+	pentry->next_best = NULL;
 
-		validbits -= PLC_BITS;
-	}
-
-	trie_walk_affected(validbits, table, bytes[depth], pentry,
-			   trie_uninstall_fn);
-
-	for (; depth > 0; depth--)
-		if (trie_table_empty(*tables[depth])) {
-			XFREE(MTYPE_PREFIX_LIST_TRIE, *tables[depth]);
-			*tables[depth] = NULL;
-		}
+	/* once for the lookup, once for the reference held by pentry */
+	route_unlock_node(rn);
+	route_unlock_node(rn);
 }
 
 
@@ -538,53 +475,32 @@ static void prefix_list_entry_delete(struct prefix_list *plist,
 	}
 }
 
-static void trie_install_fn(struct prefix_list_entry *object,
-			    struct prefix_list_entry **updptr)
-{
-	while (*updptr) {
-		if (*updptr == object)
-			return;
-		if ((*updptr)->prefix.prefixlen < object->prefix.prefixlen)
-			break;
-		if ((*updptr)->prefix.prefixlen == object->prefix.prefixlen
-		    && (*updptr)->seq > object->seq)
-			break;
-		updptr = &(*updptr)->next_best;
-	}
-
-	if (!object->next_best)
-		object->next_best = *updptr;
-	else
-		assert(object->next_best == *updptr || !*updptr);
-
-	*updptr = object;
-}
-
+/*
+ * Entries are indexed by their prefix; all entries for the same prefix hang
+ * off one node, sorted by sequence number.  Host bits are only expected
+ * from ORF and are masked off here, leaving the entry itself untouched.
+ */
 static void prefix_list_trie_add(struct prefix_list *plist,
 				 struct prefix_list_entry *pentry)
 {
-	size_t depth = plist->master->trie_depth;
-	uint8_t *bytes = &pentry->prefix.u.prefix;
-	size_t validbits = pentry->prefix.prefixlen;
-	struct pltrie_table *table;
-
-	table = plist->trie;
-	while (validbits > PLC_BITS && depth > 1) {
-		if (!table->entries[*bytes].next_table)
-			table->entries[*bytes].next_table =
-				XCALLOC(MTYPE_PREFIX_LIST_TRIE,
-					sizeof(struct pltrie_table));
-		table = table->entries[*bytes].next_table;
-		bytes++;
-		depth--;
-		validbits -= PLC_BITS;
-	}
+	struct prefix p;
+	struct route_node *rn;
+	struct prefix_list_entry **pp;
 
-	trie_walk_affected(validbits, table, *bytes, pentry, trie_install_fn);
+	prefix_copy(&p, &pentry->prefix);
+	rn = route_node_get(plist->trie, &p);
+
+	for (pp = (struct prefix_list_entry **)&rn->info; *pp;
+	     pp = &(*pp)->next_best)
+		if ((*pp)->seq > pentry->seq)
+			break;
+	pentry->next_best = *pp;
+	*pp = pentry;
 }
 
 static void prefix_list_entry_add(struct prefix_list *plist,
-				  struct prefix_list_entry *pentry)
+				  struct prefix_list_entry *pentry,
+				  int update_list)
 {
 	struct prefix_list_entry *replace;
 	struct prefix_list_entry *point;
@@ -633,12 +549,15 @@ static void prefix_list_entry_add(struct prefix_list *plist,
 	/* Increment count. */
 	plist->count++;
 
-	/* Run hook function. */
-	if (plist->master->add_hook)
-		(*plist->master->add_hook)(plist);
+	if (update_list) {
+		/* Run hook function. */
+		if (plist->master->add_hook)
+			(*plist->master->add_hook)(plist);
 
-	route_map_notify_dependencies(plist->name, RMAP_EVENT_PLIST_ADDED);
-	plist->master->recent = plist;
+		route_map_notify_dependencies(plist->name,
+					      RMAP_EVENT_PLIST_ADDED);
+		plist->master->recent = plist;
+	}
 }
 
 /* Return string of prefix_list_type. */
@@ -654,18 +573,13 @@ static const char *prefix_list_type_str(struct prefix_list_entry *pentry)
 	}
 }
 
+/* Whether an entry whose prefix covers p matches p's length. */
 static int prefix_list_entry_match(struct prefix_list_entry *pentry,
 				   struct prefix *p)
 {
-	int ret;
-
 	if (pentry->prefix.family != p->family)
 		return 0;
 
-	ret = prefix_match(&pentry->prefix, p);
-	if (!ret)
-		return 0;
-
 	/* In case of le nor ge is specified, exact match is performed. */
 	if (!pentry->le && !pentry->ge) {
 		if (pentry->prefix.prefixlen != p->prefixlen)
@@ -687,12 +601,8 @@ enum prefix_list_type prefix_list_apply_which_prefix(struct prefix_list *plist,
 						     void *object)
 {
 	struct prefix_list_entry *pentry, *pbest = NULL;
-
 	struct prefix *p = (struct prefix *)object;
-	uint8_t *byte = &p->u.prefix;
-	size_t depth;
-	size_t validbits = p->prefixlen;
-	struct pltrie_table *table;
+	struct route_node *match, *rn;
 
 	if (plist == NULL) {
 		if (which)
@@ -706,39 +616,24 @@ enum prefix_list_type prefix_list_apply_which_prefix(struct prefix_list *plist,
 		return PREFIX_PERMIT;
 	}
 
-	depth = plist->master->trie_depth;
-	table = plist->trie;
-	while (1) {
-		for (pentry = table->entries[*byte].up_chain; pentry;
-		     pentry = pentry->next_best) {
+	/*
+	 * Every entry that can match sits on the path from the longest
+	 * covering prefix up to the root; on each node only the first entry
+	 * in sequence order that matches the length can be the answer.
+	 */
+	match = route_node_match(plist->trie, p);
+	for (rn = match; rn; rn = rn->parent) {
+		for (pentry = rn->info; pentry; pentry = pentry->next_best) {
 			if (pbest && pbest->seq < pentry->seq)
-				continue;
-			if (prefix_list_entry_match(pentry, p))
-				pbest = pentry;
-		}
-
-		if (validbits <= PLC_BITS)
-			break;
-		validbits -= PLC_BITS;
-
-		if (--depth) {
-			if (!table->entries[*byte].next_table)
 				break;
-
-			table = table->entries[*byte].next_table;
-			byte++;
-			continue;
-		}
-
-		for (pentry = table->entries[*byte].final_chain; pentry;
-		     pentry = pentry->next_best) {
-			if (pbest && pbest->seq < pentry->seq)
-				continue;
-			if (prefix_list_entry_match(pentry, p))
+			if (prefix_list_entry_match(pentry, p)) {
 				pbest = pentry;
+				break;
+			}
 		}
-		break;
 	}
+	if (match)
+		route_unlock_node(match);
 
 	if (which) {
 		if (pbest)
@@ -788,10 +683,7 @@ static void __attribute__((unused)) prefix_list_print(struct prefix_list *plist)
 static struct prefix_list_entry *
 prefix_entry_dup_check(struct prefix_list *plist, struct prefix_list_entry *new)
 {
-	size_t depth, maxdepth = plist->master->trie_depth;
-	uint8_t byte, *bytes = &new->prefix.u.prefix;
-	size_t validbits = new->prefix.prefixlen;
-	struct pltrie_table *table;
+	struct route_node *rn;
 	struct prefix_list_entry *pentry;
 	int seq = 0;
 
@@ -800,29 +692,18 @@ prefix_entry_dup_check(struct prefix_list *plist, struct prefix_list_entry *new)
 	else
 		seq = new->seq;
 
-	table = plist->trie;
-	for (depth = 0; validbits > PLC_BITS && depth < maxdepth - 1; depth++) {
-		byte = bytes[depth];
-		if (!table->entries[byte].next_table)
-			return NULL;
-
-		table = table->entries[byte].next_table;
-		validbits -= PLC_BITS;
-	}
-
-	byte = bytes[depth];
-	if (validbits > PLC_BITS)
-		pentry = table->entries[byte].final_chain;
-	else
-		pentry = table->entries[byte].up_chain;
+	rn = route_node_lookup(plist->trie, &new->prefix);
+	if (!rn)
+		return NULL;
 
-	for (; pentry; pentry = pentry->next_best) {
+	for (pentry = rn->info; pentry; pentry = pentry->next_best) {
 		if (prefix_same(&pentry->prefix, &new->prefix)
 		    && pentry->type == new->type && pentry->le == new->le
 		    && pentry->ge == new->ge && pentry->seq != seq)
-			return pentry;
+			break;
 	}
-	return NULL;
+	route_unlock_node(rn);
+	return pentry;
 }
 
 static int vty_invalid_prefix_range(struct vty *vty, const char *prefix)
@@ -833,16 +714,14 @@ static int vty_invalid_prefix_range(struct vty *vty, const char *prefix)
 	return CMD_WARNING_CONFIG_FAILED;
 }
 
-static int vty_prefix_list_install(struct vty *vty, afi_t afi, const char *name,
-				   const char *seq, const char *typestr,
-				   const char *prefix, const char *ge,
-				   const char *le)
+static int vty_prefix_list_entry_parse(struct vty *vty, afi_t afi,
+				       const char *name, const char *seq,
+				       const char *typestr, const char *prefix,
+				       const char *ge, const char *le,
+				       struct prefix_list_entry **pentryp)
 {
 	int ret;
 	enum prefix_list_type type;
-	struct prefix_list *plist;
-	struct prefix_list_entry *pentry;
-	struct prefix_list_entry *dup;
 	struct prefix p, p_tmp;
 	int any = 0;
 	int seqnum = -1;
@@ -942,12 +821,30 @@ static int vty_prefix_list_install(struct vty *vty, afi_t afi, const char *name,
 	if (genum && (lenum == (afi == AFI_IP ? 32 : 128)))
 		lenum = 0;
 
+	/* Make prefix entry. */
+	*pentryp = prefix_list_entry_make(&p, type, seqnum, lenum, genum, any);
+
+	return CMD_SUCCESS;
+}
+
+static int vty_prefix_list_install(struct vty *vty, afi_t afi, const char *name,
+				   const char *seq, const char *typestr,
+				   const char *prefix, const char *ge,
+				   const char *le)
+{
+	int ret;
+	struct prefix_list *plist;
+	struct prefix_list_entry *pentry;
+	struct prefix_list_entry *dup;
+
+	ret = vty_prefix_list_entry_parse(vty, afi, name, seq, typestr, prefix,
+					  ge, le, &pentry);
+	if (ret != CMD_SUCCESS)
+		return ret;
+
 	/* Get prefix_list with name. */
 	plist = prefix_list_get(afi, 0, name);
 
-	/* Make prefix entry. */
-	pentry = prefix_list_entry_make(&p, type, seqnum, lenum, genum, any);
-
 	/* Check same policy. */
 	dup = prefix_entry_dup_check(plist, pentry);
 
@@ -957,11 +854,178 @@ static int vty_prefix_list_install(struct vty *vty, afi_t afi, const char *name,
 	}
 
 	/* Install new filter to the access_list. */
-	prefix_list_entry_add(plist, pentry);
+	prefix_list_entry_add(plist, pentry, 1);
+
+	return CMD_SUCCESS;
+}
+
+static int all_digits(const char *str)
+{
+	return *str && strspn(str, "0123456789") == strlen(str);
+}
+
+/*
+ * Adds the entry on one line of a prefix-list file to plist.  Lines are in
+ * the same format as the configuration, with or without the leading
+ * "ip[v6] prefix-list NAME"; comments, descriptions and "no" lines (as
+ * emitted by IRR tools to clear the list first) are skipped.
+ */
+static int vty_prefix_list_load_line(struct vty *vty, afi_t afi,
+				     struct prefix_list *plist, char *line)
+{
+	char *tok[10], *save = NULL, *t;
+	const char *seq = NULL, *typestr, *prefix, *ge = NULL, *le = NULL;
+	struct prefix_list_entry *pentry;
+	unsigned int n = 0, i = 0;
+	int ret;
+
+	for (t = strtok_r(line, " \t\r\n", &save); t;
+	     t = strtok_r(NULL, " \t\r\n", &save)) {
+		if (n == array_size(tok))
+			return CMD_WARNING_CONFIG_FAILED;
+		tok[n++] = t;
+	}
+
+	if (n == 0 || tok[0][0] == '!' || tok[0][0] == '#'
+	    || strcmp(tok[0], "no") == 0)
+		return CMD_SUCCESS;
+
+	if (n >= 3 && strcmp(tok[1], "prefix-list") == 0
+	    && strcmp(tok[0], afi == AFI_IP ? "ip" : "ipv6") == 0)
+		i = 3;
+	if (i < n
+	    && (strcmp(tok[i], "description") == 0
+		|| strcmp(tok[i], "sequence-number") == 0))
+		return CMD_SUCCESS;
+
+	if (i + 1 < n && strcmp(tok[i], "seq") == 0) {
+		seq = tok[i + 1];
+		if (!all_digits(seq))
+			return CMD_WARNING_CONFIG_FAILED;
+		i += 2;
+	}
+
+	if (i + 1 >= n
+	    || (strcmp(tok[i], "permit") && strcmp(tok[i], "deny")))
+		return CMD_WARNING_CONFIG_FAILED;
+	typestr = tok[i++];
+	prefix = tok[i++];
+
+	for (; i < n; i += 2) {
+		if (i + 1 >= n || !all_digits(tok[i + 1]))
+			return CMD_WARNING_CONFIG_FAILED;
+		if (strcmp(tok[i], "ge") == 0)
+			ge = tok[i + 1];
+		else if (strcmp(tok[i], "le") == 0)
+			le = tok[i + 1];
+		else
+			return CMD_WARNING_CONFIG_FAILED;
+	}
 
+	ret = vty_prefix_list_entry_parse(vty, afi, plist->name, seq, typestr,
+					  prefix, ge, le, &pentry);
+	if (ret != CMD_SUCCESS)
+		return ret;
+
+	if (prefix_entry_dup_check(plist, pentry)) {
+		prefix_list_entry_free(pentry);
+		return CMD_SUCCESS;
+	}
+
+	prefix_list_entry_add(plist, pentry, 0);
 	return CMD_SUCCESS;
 }
 
+static void prefix_list_flush(struct prefix_list *plist)
+{
+	struct prefix_list_entry *pentry;
+	struct prefix_list_entry *next;
+
+	for (pentry = plist->head; pentry; pentry = next) {
+		next = pentry->next;
+		prefix_list_trie_del(plist, pentry);
+		prefix_list_entry_free(pentry);
+	}
+	plist->head = plist->tail = NULL;
+	plist->count = 0;
+}
+
+/*
+ * Replaces the entries of a prefix-list with those read from a file.  The
+ * new entries are collected in a list of their own, so the old ones stay in
+ * use until the whole file has been read and nothing of it is applied if
+ * any line is bad.  Users of the list are notified once.
+ */
+static int vty_prefix_list_load(struct vty *vty, afi_t afi, const char *name,
+				const char *file)
+{
+	struct prefix_list *plist, *load;
+	struct prefix_list_entry *head, *tail;
+	struct route_table *trie;
+	char line[BUFSIZ];
+	unsigned int lineno = 0;
+	int count, ret = CMD_SUCCESS;
+	FILE *fp;
+
+	fp = fopen(file, "r");
+	if (!fp) {
+		vty_out(vty, "%% Can't open %s: %s\n", file,
+			safe_strerror(errno));
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	load = prefix_list_new();
+	load->name = XSTRDUP(MTYPE_MPREFIX_LIST_STR, name);
+	load->master = prefix_master_get(afi, 0);
+	load->trie = route_table_init();
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		ret = vty_prefix_list_load_line(vty, afi, load, line);
+		if (ret != CMD_SUCCESS) {
+			vty_out(vty, "%% %s:%u: invalid prefix-list entry\n",
+				file, lineno);
+			break;
+		}
+	}
+	fclose(fp);
+
+	if (ret == CMD_SUCCESS && load->count == 0) {
+		vty_out(vty, "%% %s: no prefix-list entries\n", file);
+		ret = CMD_WARNING_CONFIG_FAILED;
+	}
+
+	if (ret == CMD_SUCCESS) {
+		/* swap the entries, the prefix_list itself may be referenced */
+		plist = prefix_list_get(afi, 0, name);
+
+		head = plist->head;
+		tail = plist->tail;
+		count = plist->count;
+		trie = plist->trie;
+		plist->head = load->head;
+		plist->tail = load->tail;
+		plist->count = load->count;
+		plist->trie = load->trie;
+		load->head = head;
+		load->tail = tail;
+		load->count = count;
+		load->trie = trie;
+
+		if (plist->master->add_hook)
+			(*plist->master->add_hook)(plist);
+		route_map_notify_dependencies(plist->name,
+					      RMAP_EVENT_PLIST_ADDED);
+		plist->master->recent = plist;
+	}
+
+	prefix_list_flush(load);
+	route_table_finish(load->trie);
+	XFREE(MTYPE_MPREFIX_LIST_STR, load->name);
+	prefix_list_free(load);
+	return ret;
+}
+
 static int vty_prefix_list_uninstall(struct vty *vty, afi_t afi,
 				     const char *name, const char *seq,
 				     const char *typestr, const char *prefix,
@@ -1345,6 +1409,18 @@ DEFPY (ip_prefix_list,
 				       action, dest, ge_str, le_str);
 }
 
+DEFPY (ip_prefix_list_load,
+       ip_prefix_list_load_cmd,
+       "ip prefix-list WORD load FILE",
+       IP_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Replace all entries with those read from a file\n"
+       "File name\n")
+{
+	return vty_prefix_list_load(vty, AFI_IP, prefix_list, file);
+}
+
 DEFPY (no_ip_prefix_list,
        no_ip_prefix_list_cmd,
        "no ip prefix-list WORD [seq (1-4294967295)] <deny|permit>$action <any$dest|A.B.C.D/M$dest [{ge (0-32)|le (0-32)}]>",
@@ -1539,6 +1615,18 @@ DEFPY (ipv6_prefix_list,
 				       action, dest, ge_str, le_str);
 }
 
+DEFPY (ipv6_prefix_list_load,
+       ipv6_prefix_list_load_cmd,
+       "ipv6 prefix-list WORD load FILE",
+       IPV6_STR
+       PREFIX_LIST_STR
+       "Name of a prefix list\n"
+       "Replace all entries with those read from a file\n"
+       "File name\n")
+{
+	return vty_prefix_list_load(vty, AFI_IP6, prefix_list, file);
+}
+
 DEFPY (no_ipv6_prefix_list,
        no_ipv6_prefix_list_cmd,
        "no ipv6 prefix-list WORD [seq (1-4294967295)] <deny|permit>$action <any$dest|X:X::X:X/M$dest [{ge (0-128)|le (0-128)}]>",
@@ -1867,7 +1955,7 @@ int prefix_bgp_orf_set(char *name, afi_t afi, struct orf_prefix *orfp,
 			return CMD_WARNING_CONFIG_FAILED;
 		}
 
-		prefix_list_entry_add(plist, pentry);
+		prefix_list_entry_add(plist, pentry, 1);
 	} else {
 		pentry = prefix_list_entry_lookup(
 			plist, &orfp->p, (permit ? PREFIX_PERMIT : PREFIX_DENY),
@@ -2049,6 +2137,7 @@ static void prefix_list_init_ipv4(void)
 	install_node(&prefix_node, config_write_prefix_ipv4);
 
 	install_element(CONFIG_NODE, &ip_prefix_list_cmd);
+	install_element(CONFIG_NODE, &ip_prefix_list_load_cmd);
 	install_element(CONFIG_NODE, &no_ip_prefix_list_cmd);
 	install_element(CONFIG_NODE, &no_ip_prefix_list_all_cmd);
 
@@ -2082,6 +2171,7 @@ static void prefix_list_init_ipv6(void)
 	install_node(&prefix_ipv6_node, config_write_prefix_ipv6);
 
 	install_element(CONFIG_NODE, &ipv6_prefix_list_cmd);
+	install_element(CONFIG_NODE, &ipv6_prefix_list_load_cmd);
 	install_element(CONFIG_NODE, &no_ipv6_prefix_list_cmd);
 	install_element(CONFIG_NODE, &no_ipv6_prefix_list_all_cmd);
 
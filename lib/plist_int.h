@@ -24,7 +24,7 @@
 
 enum prefix_name_type { PREFIX_TYPE_STRING, PREFIX_TYPE_NUMBER };
 
-struct pltrie_table;
+struct route_table;
 
 struct prefix_list {
 	char *name;
@@ -40,7 +40,8 @@ struct prefix_list {
 	struct prefix_list_entry *head;
 	struct prefix_list_entry *tail;
 
-	struct pltrie_table *trie;
+	/* entries by prefix, see prefix_list_trie_add() */
+	struct route_table *trie;
 
 	struct prefix_list *next;
 	struct prefix_list *prev;
@@ -64,7 +65,7 @@ struct prefix_list_entry {
 	struct prefix_list_entry *next;
 	struct prefix_list_entry *prev;
 
-	/* up the chain for best match search */
+	/* next entry with the same prefix, by sequence number */
 	struct prefix_list_entry *next_best;
 };
 
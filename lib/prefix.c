@@ -26,7 +26,7 @@
 #include "sockunion.h"
 #include "memory.h"
 #include "log.h"
-#include "jhash.h"
+#include "hashfn.h"
 
 DEFINE_MTYPE_STATIC(LIB, PREFIX, "Prefix")
 
@@ -556,6 +556,11 @@ int prefix_match(const struct prefix *n, const struct prefix *p)
 	if (n->prefixlen > p->prefixlen)
 		return 0;
 
+	if (n->family == AF_INET)
+		return prefix_match_ipv4(n, p);
+	if (n->family == AF_INET6)
+		return prefix_match_ipv6(n, p);
+
 	if (n->family == AF_FLOWSPEC) {
 		/* prefixlen is unused. look at fs prefix len */
 		if (n->u.prefix_flowspec.prefixlen >
@@ -719,6 +724,10 @@ int prefix_cmp(const struct prefix *p1, const struct prefix *p2)
 
 	if (p1->family != p2->family)
 		return 1;
+	if (p1->family == AF_INET)
+		return prefix_cmp_ipv4(p1, p2);
+	if (p1->family == AF_INET6)
+		return prefix_cmp_ipv6(p1, p2);
 	if (p1->family == AF_FLOWSPEC) {
 		pp1 = (const uint8_t *)p1->u.prefix_flowspec.ptr;
 		pp2 = (const uint8_t *)p2->u.prefix_flowspec.ptr;
@@ -768,10 +777,12 @@ int prefix_common_bits(const struct prefix *p1, const struct prefix *p2)
 	const uint8_t *pp1 = (const uint8_t *)&p1->u.prefix;
 	const uint8_t *pp2 = (const uint8_t *)&p2->u.prefix;
 
+	if (p1->family != p2->family)
+		return -1;
 	if (p1->family == AF_INET)
-		length = IPV4_MAX_BYTELEN;
+		return prefix_common_bits_ipv4(p1, p2);
 	if (p1->family == AF_INET6)
-		length = IPV6_MAX_BYTELEN;
+		return prefix_common_bits_ipv6(p1, p2);
 	if (p1->family == AF_ETHERNET)
 		length = ETH_ALEN;
 	if (p1->family == AF_EVPN)
@@ -1473,9 +1484,8 @@ unsigned prefix_hash_key(void *pp)
 		 */
 		memset(&copy, 0, sizeof(copy));
 		prefix_copy(&copy, (struct prefix *)pp);
-		len = jhash((void *)copy.u.prefix_flowspec.ptr,
-			    copy.u.prefix_flowspec.prefixlen,
-			    0x55aa5a5a);
+		len = hashfn((void *)copy.u.prefix_flowspec.ptr,
+			     copy.u.prefix_flowspec.prefixlen, 0x55aa5a5a);
 		temp = (void *)copy.u.prefix_flowspec.ptr;
 		XFREE(MTYPE_PREFIX_FLOWSPEC, temp);
 		copy.u.prefix_flowspec.ptr = (uintptr_t)NULL;
@@ -1486,7 +1496,7 @@ unsigned prefix_hash_key(void *pp)
 	 * padding and unused prefix bytes. */
 	memset(&copy, 0, sizeof(copy));
 	prefix_copy(&copy, (struct prefix *)pp);
-	return jhash(&copy,
-		     offsetof(struct prefix, u.prefix) + PSIZE(copy.prefixlen),
-		     0x55aa5a5a);
+	return hashfn(&copy,
+		      offsetof(struct prefix, u.prefix) + PSIZE(copy.prefixlen),
+		      0x55aa5a5a);
 }
@@ -369,6 +369,100 @@ extern char *prefix_mac2str(const struct ethaddr *mac, char *buf, int size);
 
 extern unsigned prefix_hash_key(void *pp);
 
+/*
+ * IPv4 and IPv6 fast paths of prefix_match(), prefix_cmp() and
+ * prefix_common_bits(), for callers that know the family, e.g. table walks.
+ * Addresses are compared a word at a time, only their difference being
+ * brought into host order; both prefixes must be of the family named.
+ */
+
+/* The leading len bits of a word set, 0 <= len <= 32 or 64. */
+static inline uint32_t prefix_mask32(unsigned int len)
+{
+	return len ? ~0U << (32 - len) : 0;
+}
+
+static inline uint64_t prefix_mask64(unsigned int len)
+{
+	return len ? ~0ULL << (64 - len) : 0;
+}
+
+/* Bits in which the addresses differ, in host order. */
+static inline uint32_t prefix_ipv4_diff(const struct prefix *a,
+					const struct prefix *b)
+{
+	return ntohl(a->u.prefix4.s_addr ^ b->u.prefix4.s_addr);
+}
+
+/* Same for word i (0 or 1) of IPv6 addresses. */
+static inline uint64_t prefix_ipv6_diff(const struct prefix *a,
+					const struct prefix *b, int i)
+{
+	uint64_t wa, wb;
+
+	memcpy(&wa, &a->u.prefix6.s6_addr[i * 8], sizeof(wa));
+	memcpy(&wb, &b->u.prefix6.s6_addr[i * 8], sizeof(wb));
+#if BYTE_ORDER == LITTLE_ENDIAN
+	return __builtin_bswap64(wa ^ wb);
+#else
+	return wa ^ wb;
+#endif
+}
+
+static inline int prefix_match_ipv4(const struct prefix *n,
+				    const struct prefix *p)
+{
+	if (n->prefixlen > p->prefixlen)
+		return 0;
+	return !(prefix_ipv4_diff(n, p) & prefix_mask32(n->prefixlen));
+}
+
+static inline int prefix_match_ipv6(const struct prefix *n,
+				    const struct prefix *p)
+{
+	unsigned int len = n->prefixlen;
+
+	if (len > p->prefixlen)
+		return 0;
+	if (len <= 64)
+		return !(prefix_ipv6_diff(n, p, 0) & prefix_mask64(len));
+	return !prefix_ipv6_diff(n, p, 0)
+	       && !(prefix_ipv6_diff(n, p, 1) & prefix_mask64(len - 64));
+}
+
+/* As prefix_cmp(): 0 if the lengths and the bits under them are equal. */
+static inline int prefix_cmp_ipv4(const struct prefix *p1,
+				  const struct prefix *p2)
+{
+	return p1->prefixlen != p2->prefixlen || !prefix_match_ipv4(p1, p2);
+}
+
+static inline int prefix_cmp_ipv6(const struct prefix *p1,
+				  const struct prefix *p2)
+{
+	return p1->prefixlen != p2->prefixlen || !prefix_match_ipv6(p1, p2);
+}
+
+/* Leading bits the addresses have in common, regardless of length. */
+static inline int prefix_common_bits_ipv4(const struct prefix *p1,
+					  const struct prefix *p2)
+{
+	uint32_t x = prefix_ipv4_diff(p1, p2);
+
+	return x ? __builtin_clz(x) : IPV4_MAX_BITLEN;
+}
+
+static inline int prefix_common_bits_ipv6(const struct prefix *p1,
+					  const struct prefix *p2)
+{
+	uint64_t x = prefix_ipv6_diff(p1, p2, 0);
+
+	if (x)
+		return __builtin_clzll(x);
+	x = prefix_ipv6_diff(p1, p2, 1);
+	return x ? 64 + __builtin_clzll(x) : IPV6_MAX_BITLEN;
+}
+
 static inline int ipv6_martian(struct in6_addr *addr)
 {
 	struct in6_addr localhost_addr;
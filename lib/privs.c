@@ -21,6 +21,7 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <zebra.h>
+#include <pthread.h>
 #include "log.h"
 #include "privs.h"
 #include "memory.h"
@@ -87,6 +88,38 @@ zebra_privs_current_t zprivs_state_uid(void);
 int zprivs_change_null(zebra_privs_ops_t);
 zebra_privs_current_t zprivs_state_null(void);
 
+/*
+ * Privileges may be raised and lowered from several pthreads.  Where they
+ * belong to the whole process, they stay raised until the last pthread
+ * that raised them lowers them again.
+ */
+static pthread_mutex_t zprivs_mtx = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int zprivs_raised;
+
+static int zprivs_change_shared(zebra_privs_ops_t op,
+				int (*apply)(zebra_privs_ops_t))
+{
+	int ret = 0;
+
+	if (op != ZPRIVS_RAISE && op != ZPRIVS_LOWER)
+		return -1;
+
+	pthread_mutex_lock(&zprivs_mtx);
+	if (op == ZPRIVS_RAISE) {
+		if (!zprivs_raised)
+			ret = apply(op);
+		if (!ret)
+			zprivs_raised++;
+	} else {
+		if (zprivs_raised)
+			zprivs_raised--;
+		if (!zprivs_raised)
+			ret = apply(op);
+	}
+	pthread_mutex_unlock(&zprivs_mtx);
+	return ret;
+}
+
 #ifdef HAVE_CAPABILITIES
 /* internal capability API */
 static pset_t *zcaps2sys(zebra_capabilities_t *, int);
@@ -254,6 +287,7 @@ static pset_t *zcaps2sys(zebra_capabilities_t *zcaps, int num)
 int zprivs_change_caps(zebra_privs_ops_t op)
 {
 	cap_flag_value_t cflag;
+	int ret = -1;
 
 	/* should be no possibility of being called without valid caps */
 	assert(zprivs_state.syscaps_p && zprivs_state.caps);
@@ -267,11 +301,14 @@ int zprivs_change_caps(zebra_privs_ops_t op)
 	else
 		return -1;
 
+	/* capabilities are per thread, but their working storage is shared */
+	pthread_mutex_lock(&zprivs_mtx);
 	if (!cap_set_flag(zprivs_state.caps, CAP_EFFECTIVE,
 			  zprivs_state.syscaps_p->num,
 			  zprivs_state.syscaps_p->caps, cflag))
-		return cap_set_proc(zprivs_state.caps);
-	return -1;
+		ret = cap_set_proc(zprivs_state.caps);
+	pthread_mutex_unlock(&zprivs_mtx);
+	return ret;
 }
 
 zebra_privs_current_t zprivs_state_caps(void)
@@ -464,7 +501,7 @@ static pset_t *zcaps2sys(zebra_capabilities_t *zcaps, int num)
 /* callback exported to users to RAISE and LOWER effective privileges
  * from nothing to the given permitted set and back down
  */
-int zprivs_change_caps(zebra_privs_ops_t op)
+static int zprivs_apply_caps(zebra_privs_ops_t op)
 {
 	pset_t *privset;
 
@@ -497,6 +534,11 @@ int zprivs_change_caps(zebra_privs_ops_t op)
 	return 0;
 }
 
+int zprivs_change_caps(zebra_privs_ops_t op)
+{
+	return zprivs_change_shared(op, zprivs_apply_caps);
+}
+
 /* Retrieve current privilege state, is it RAISED or LOWERED? */
 zebra_privs_current_t zprivs_state_caps(void)
 {
@@ -635,16 +677,19 @@ static void zprivs_caps_terminate(void)
 #endif /* HAVE_LCAPS */
 #endif /* HAVE_CAPABILITIES */
 
-int zprivs_change_uid(zebra_privs_ops_t op)
+static int zprivs_apply_uid(zebra_privs_ops_t op)
 {
-	if (zprivs_state.zsuid == zprivs_state.zuid)
-		return 0;
 	if (op == ZPRIVS_RAISE)
 		return seteuid(zprivs_state.zsuid);
-	else if (op == ZPRIVS_LOWER)
-		return seteuid(zprivs_state.zuid);
 	else
-		return -1;
+		return seteuid(zprivs_state.zuid);
+}
+
+int zprivs_change_uid(zebra_privs_ops_t op)
+{
+	if (zprivs_state.zsuid == zprivs_state.zuid)
+		return 0;
+	return zprivs_change_shared(op, zprivs_apply_uid);
 }
 
 zebra_privs_current_t zprivs_state_uid(void)
@@ -22,13 +22,12 @@
 
 #include "thread.h"
 #include "memory.h"
-#include "hash.h"
+#include "chash.h"
 #include "log.h"
 #include "qobj.h"
 #include "jhash.h"
 
-static pthread_rwlock_t nodes_lock;
-static struct hash *nodes = NULL;
+static struct chash *nodes = NULL;
 
 static unsigned int qobj_key(void *data)
 {
@@ -45,39 +44,37 @@ static int qobj_cmp(const void *a, const void *b)
 void qobj_reg(struct qobj_node *node, struct qobj_nodetype *type)
 {
 	node->type = type;
-	pthread_rwlock_wrlock(&nodes_lock);
 	do {
 		node->nid = (uint64_t)random();
 		node->nid ^= (uint64_t)random() << 32;
 	} while (!node->nid
-		 || hash_get(nodes, node, hash_alloc_intern) != node);
-	pthread_rwlock_unlock(&nodes_lock);
+		 || chash_get(nodes, node, hash_alloc_intern) != node);
 }
 
 void qobj_unreg(struct qobj_node *node)
 {
-	pthread_rwlock_wrlock(&nodes_lock);
-	hash_release(nodes, node);
-	pthread_rwlock_unlock(&nodes_lock);
+	chash_release(nodes, node);
 }
 
 struct qobj_node *qobj_get(uint64_t id)
 {
-	struct qobj_node dummy = {.nid = id}, *rv;
-	pthread_rwlock_rdlock(&nodes_lock);
-	rv = hash_lookup(nodes, &dummy);
-	pthread_rwlock_unlock(&nodes_lock);
-	return rv;
+	struct qobj_node dummy = {.nid = id};
+
+	return chash_lookup(nodes, &dummy);
+}
+
+static void *qobj_typecheck(void *entry, void *arg)
+{
+	struct qobj_node *node = entry;
+
+	if (!node || node->type != arg)
+		return NULL;
+	return (char *)node - node->type->node_member_offset;
 }
 
 void *qobj_get_typed(uint64_t id, struct qobj_nodetype *type)
 {
 	struct qobj_node dummy = {.nid = id};
-	struct qobj_node *node;
-	void *rv;
-
-	pthread_rwlock_rdlock(&nodes_lock);
-	node = hash_lookup(nodes, &dummy);
 
 	/* note: we explicitly hold the lock until after we have checked the
 	 * type.
@@ -85,27 +82,19 @@ void *qobj_get_typed(uint64_t id, struct qobj_nodetype *type)
 	 * route-maps, we can still race against a delete of something that
 	 * isn't
 	 * a route-map. */
-	if (!node || node->type != type)
-		rv = NULL;
-	else
-		rv = (char *)node - node->type->node_member_offset;
-
-	pthread_rwlock_unlock(&nodes_lock);
-	return rv;
+	return chash_lookup_apply(nodes, &dummy, qobj_typecheck, type);
 }
 
 void qobj_init(void)
 {
-	if (!nodes) {
-		pthread_rwlock_init(&nodes_lock, NULL);
-		nodes = hash_create_size(16, qobj_key, qobj_cmp, "QOBJ Hash");
-	}
+	if (!nodes)
+		nodes = chash_create_size(256, qobj_key, qobj_cmp,
+					  "QOBJ Hash");
 }
 
 void qobj_finish(void)
 {
-	hash_clean(nodes, NULL);
-	hash_free(nodes);
+	chash_clean(nodes, NULL);
+	chash_free(nodes);
 	nodes = NULL;
-	pthread_rwlock_destroy(&nodes_lock);
 }
@@ -27,8 +27,14 @@ DEFINE_MTYPE_STATIC(LIB, RINGBUFFER, "Ring buffer")
 struct ringbuf *ringbuf_new(size_t size)
 {
 	struct ringbuf *buf = XCALLOC(MTYPE_RINGBUFFER, sizeof(struct ringbuf));
-	buf->data = XCALLOC(MTYPE_RINGBUFFER, size);
-	buf->size = size;
+	size_t rsize = 1;
+
+	/* power of two, so that positions wrap with a mask */
+	while (rsize < size)
+		rsize <<= 1;
+
+	buf->data = XCALLOC(MTYPE_RINGBUFFER, rsize);
+	buf->size = rsize;
 	buf->empty = true;
 	return buf;
 }
@@ -41,10 +47,9 @@ void ringbuf_del(struct ringbuf *buf)
 
 size_t ringbuf_remain(struct ringbuf *buf)
 {
-	ssize_t diff = buf->end - buf->start;
-	diff += ((diff == 0) && !buf->empty) ? buf->size : 0;
-	diff += (diff < 0) ? buf->size : 0;
-	return (size_t)diff;
+	size_t diff = (buf->end - buf->start) & (buf->size - 1);
+
+	return (diff == 0 && !buf->empty) ? buf->size : diff;
 }
 
 size_t ringbuf_space(struct ringbuf *buf)
@@ -52,71 +57,111 @@ size_t ringbuf_space(struct ringbuf *buf)
 	return buf->size - ringbuf_remain(buf);
 }
 
-size_t ringbuf_put(struct ringbuf *buf, const void *data, size_t size)
+size_t ringbuf_reserve(struct ringbuf *buf, struct iovec iov[2])
 {
-	const uint8_t *dp = data;
 	size_t space = ringbuf_space(buf);
-	size_t copysize = MIN(size, space);
-	size_t tocopy = copysize;
-	if (tocopy >= buf->size - buf->end) {
-		size_t ts = buf->size - buf->end;
-		memcpy(buf->data + buf->end, dp, ts);
-		buf->end = 0;
-		tocopy -= ts;
-		dp += ts;
+	size_t first = MIN(space, buf->size - buf->end);
+
+	iov[0].iov_base = buf->data + buf->end;
+	iov[0].iov_len = first;
+	iov[1].iov_base = buf->data;
+	iov[1].iov_len = space - first;
+	return space;
+}
+
+void ringbuf_commit(struct ringbuf *buf, size_t size)
+{
+	assert(size <= ringbuf_space(buf));
+
+	if (!size)
+		return;
+	buf->end = (buf->end + size) & (buf->size - 1);
+	buf->empty = false;
+}
+
+size_t ringbuf_spans(struct ringbuf *buf, size_t offset, struct iovec iov[2])
+{
+	size_t remain = ringbuf_remain(buf);
+	size_t cstart, first;
+
+	if (offset >= remain) {
+		iov[0].iov_base = iov[1].iov_base = buf->data;
+		iov[0].iov_len = iov[1].iov_len = 0;
+		return 0;
 	}
-	memcpy(buf->data + buf->end, dp, tocopy);
-	buf->end += tocopy;
-	buf->empty = (buf->start == buf->end) && (buf->empty && !copysize);
+
+	remain -= offset;
+	cstart = (buf->start + offset) & (buf->size - 1);
+	first = MIN(remain, buf->size - cstart);
+
+	iov[0].iov_base = buf->data + cstart;
+	iov[0].iov_len = first;
+	iov[1].iov_base = buf->data;
+	iov[1].iov_len = remain - first;
+	return remain;
+}
+
+const void *ringbuf_contig(struct ringbuf *buf, size_t offset, size_t size)
+{
+	struct iovec iov[2];
+
+	ringbuf_spans(buf, offset, iov);
+	return (size && iov[0].iov_len >= size) ? iov[0].iov_base : NULL;
+}
+
+size_t ringbuf_consume(struct ringbuf *buf, size_t size)
+{
+	size_t consumed = MIN(ringbuf_remain(buf), size);
+
+	if (!consumed)
+		return 0;
+	buf->start = (buf->start + consumed) & (buf->size - 1);
+	buf->empty = (buf->start == buf->end);
+	return consumed;
+}
+
+size_t ringbuf_put(struct ringbuf *buf, const void *data, size_t size)
+{
+	const uint8_t *dp = data;
+	struct iovec iov[2];
+	size_t copysize = MIN(size, ringbuf_reserve(buf, iov));
+	size_t first = MIN(copysize, iov[0].iov_len);
+
+	memcpy(iov[0].iov_base, dp, first);
+	memcpy(iov[1].iov_base, dp + first, copysize - first);
+	ringbuf_commit(buf, copysize);
 	return copysize;
 }
 
 size_t ringbuf_get(struct ringbuf *buf, void *data, size_t size)
 {
-	uint8_t *dp = data;
-	size_t remain = ringbuf_remain(buf);
-	size_t copysize = MIN(remain, size);
-	size_t tocopy = copysize;
-	if (tocopy >= buf->size - buf->start) {
-		size_t ts = buf->size - buf->start;
-		memcpy(dp, buf->data + buf->start, ts);
-		buf->start = 0;
-		tocopy -= ts;
-		dp += ts;
-	}
-	memcpy(dp, buf->data + buf->start, tocopy);
-	buf->start = buf->start + tocopy;
-	buf->empty = (buf->start == buf->end) && (buf->empty || copysize);
+	size_t copysize = ringbuf_peek(buf, 0, data, size);
+
+	ringbuf_consume(buf, copysize);
 	return copysize;
 }
 
 size_t ringbuf_peek(struct ringbuf *buf, size_t offset, void *data, size_t size)
 {
 	uint8_t *dp = data;
-	size_t remain = ringbuf_remain(buf);
-	if (offset >= remain)
-		return 0;
-	size_t copysize = MAX(MIN(remain - offset, size), (size_t)0);
-	size_t tocopy = copysize;
-	size_t cstart = (buf->start + offset) % buf->size;
-	if (tocopy >= buf->size - cstart) {
-		size_t ts = buf->size - cstart;
-		memcpy(dp, buf->data + cstart, ts);
-		cstart = 0;
-		tocopy -= ts;
-		dp += ts;
-	}
-	memcpy(dp, buf->data + cstart, tocopy);
+	struct iovec iov[2];
+	size_t copysize = MIN(ringbuf_spans(buf, offset, iov), size);
+	size_t first = MIN(copysize, iov[0].iov_len);
+
+	memcpy(dp, iov[0].iov_base, first);
+	memcpy(dp + first, iov[1].iov_base, copysize - first);
 	return copysize;
 }
 
 size_t ringbuf_copy(struct ringbuf *to, struct ringbuf *from, size_t size)
 {
+	struct iovec iov[2];
 	size_t tocopy = MIN(ringbuf_space(to), size);
-	uint8_t *cbuf = XCALLOC(MTYPE_TMP, tocopy);
-	tocopy = ringbuf_peek(from, 0, cbuf, tocopy);
-	size_t put = ringbuf_put(to, cbuf, tocopy);
-	XFREE(MTYPE_TMP, cbuf);
+	size_t put;
+
+	tocopy = MIN(ringbuf_spans(from, 0, iov), tocopy);
+	put = ringbuf_put(to, iov[0].iov_base, MIN(tocopy, iov[0].iov_len));
+	put += ringbuf_put(to, iov[1].iov_base, tocopy - put);
 	return put;
 }
 
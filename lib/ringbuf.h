@@ -26,7 +26,7 @@
 #include "memory.h"
 
 struct ringbuf {
-	size_t size;
+	size_t size; /* always a power of two */
 	ssize_t start;
 	ssize_t end;
 	bool empty;
@@ -36,7 +36,7 @@ struct ringbuf {
 /*
  * Creates a new ring buffer.
  *
- * @param size	buffer size, in bytes
+ * @param size	buffer size, in bytes; rounded up to a power of two
  * @return the newly created buffer
  */
 struct ringbuf *ringbuf_new(size_t size);
@@ -62,6 +62,55 @@ size_t ringbuf_remain(struct ringbuf *buf);
  */
 size_t ringbuf_space(struct ringbuf *buf);
 
+/*
+ * Get the free space of the buffer as ring memory, so that it can be filled
+ * in place, e.g. by readv(). The space is split in two spans when it wraps
+ * around the end of the buffer; otherwise iov[1] is empty. Does not change
+ * the buffer; follow with ringbuf_commit() for what was written.
+ *
+ * @param iov	where to put the spans
+ * @return number of writeable bytes, the sum of both span lengths
+ */
+size_t ringbuf_reserve(struct ringbuf *buf, struct iovec iov[2]);
+
+/*
+ * Add data written into the spans given by ringbuf_reserve() to the buffer.
+ *
+ * @param size	how many bytes were written, at most what was reserved
+ */
+void ringbuf_commit(struct ringbuf *buf, size_t size);
+
+/*
+ * Get the data in the buffer from offset on, without copying, as up to two
+ * spans of ring memory, as for ringbuf_reserve(). Does not change the
+ * buffer; use ringbuf_consume() to drop data once done with it.
+ *
+ * @param offset	where to start, in bytes offset from the start of the
+ *			data
+ * @param iov		where to put the spans
+ * @return		number of readable bytes from offset on
+ */
+size_t ringbuf_spans(struct ringbuf *buf, size_t offset, struct iovec iov[2]);
+
+/*
+ * Get a pointer to data in the buffer if it is contiguous in ring memory.
+ *
+ * @param offset	where the data starts, in bytes offset from the start
+ *			of the data
+ * @param size		how much data is wanted
+ * @return		pointer to size bytes of data; NULL if there is less
+ *			data than that or it wraps around the end of the buffer
+ */
+const void *ringbuf_contig(struct ringbuf *buf, size_t offset, size_t size);
+
+/*
+ * Drop data from the start of the buffer.
+ *
+ * @param size	how much data to drop
+ * @return number of bytes dropped; will be less than size if there was not
+ * enough data
+ */
+size_t ringbuf_consume(struct ringbuf *buf, size_t size);
 
 /*
  * Put data into the ring buffer.
@@ -30,6 +30,7 @@
 #include "log.h"
 #include "hash.h"
 #include "libfrr.h"
+#include "jhash.h"
 
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP, "Route map")
 DEFINE_MTYPE(LIB, ROUTE_MAP_NAME, "Route map name")
@@ -38,6 +39,7 @@ DEFINE_MTYPE(LIB, ROUTE_MAP_RULE, "Route map rule")
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_RULE_STR, "Route map rule str")
 DEFINE_MTYPE(LIB, ROUTE_MAP_COMPILED, "Route map compiled")
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_DEP, "Route map dependency")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_CACHE, "Route map result cache")
 
 DEFINE_QOBJ_TYPE(route_map_index)
 DEFINE_QOBJ_TYPE(route_map)
@@ -48,6 +50,34 @@ static vector route_match_vec;
 /* Vector for route set rules. */
 static vector route_set_vec;
 
+/* Number of entries in a route_map_cache, must be a power of 2. */
+#define RMAP_CACHE_SIZE 1024
+
+struct route_map_cache_entry {
+	uint64_t gen;
+	struct route_map *map;
+	uint64_t key;
+	struct prefix prefix;
+	/* First matching index, NULL if none matched */
+	struct route_map_index *index;
+};
+
+struct route_map_cache {
+	struct route_map_cache_entry entries[RMAP_CACHE_SIZE];
+
+	uint64_t hits;
+	uint64_t misses;
+};
+
+/* Bumped on any change that may alter a route-map's result; cache entries
+ * and route_map_cacheable() results from older generations are stale. */
+static uint64_t route_map_cache_gen = 1;
+
+static void route_map_cache_invalidate(void)
+{
+	route_map_cache_gen++;
+}
+
 struct route_map_match_set_hooks {
 	/* match interface */
 	int (*match_interface)(struct vty *vty, struct route_map_index *index,
@@ -666,6 +696,8 @@ static struct route_map *route_map_add(const char *name)
 	if (!list->tail)
 		list->tail = map;
 
+	route_map_cache_invalidate();
+
 	/* Execute hook. */
 	if (route_map_master.add_hook) {
 		(*route_map_master.add_hook)(name);
@@ -723,6 +755,7 @@ static void route_map_delete(struct route_map *map)
 	/* Clear all dependencies */
 	route_map_clear_all_references(name);
 	map->deleted = 1;
+	route_map_cache_invalidate();
 	/* Execute deletion hook. */
 	if (route_map_master.delete_hook) {
 		(*route_map_master.delete_hook)(name);
@@ -957,6 +990,8 @@ static void route_map_index_delete(struct route_map_index *index, int notify)
 	if (index->nextrm)
 		XFREE(MTYPE_ROUTE_MAP_NAME, index->nextrm);
 
+	route_map_cache_invalidate();
+
 	/* Execute event hook. */
 	if (route_map_master.event_hook && notify) {
 		(*route_map_master.event_hook)(RMAP_EVENT_INDEX_DELETED,
@@ -1017,6 +1052,8 @@ route_map_index_add(struct route_map *map, enum route_map_type type, int pref)
 		point->prev = index;
 	}
 
+	route_map_cache_invalidate();
+
 	/* Execute event hook. */
 	if (route_map_master.event_hook) {
 		(*route_map_master.event_hook)(RMAP_EVENT_INDEX_ADDED,
@@ -1207,6 +1244,7 @@ int route_map_add_match(struct route_map_index *index, const char *match_name,
 
 	/* Add new route match rule to linked list. */
 	route_map_rule_add(&index->match_list, rule);
+	route_map_cache_invalidate();
 
 	/* Execute event hook. */
 	if (route_map_master.event_hook) {
@@ -1236,6 +1274,7 @@ int route_map_delete_match(struct route_map_index *index,
 		if (rule->cmd == cmd && (rulecmp(rule->rule_str, match_arg) == 0
 					 || match_arg == NULL)) {
 			route_map_rule_delete(&index->match_list, rule);
+			route_map_cache_invalidate();
 			/* Execute event hook. */
 			if (route_map_master.event_hook) {
 				(*route_map_master.event_hook)(
@@ -1295,6 +1334,7 @@ int route_map_add_set(struct route_map_index *index, const char *set_name,
 
 	/* Add new route match rule to linked list. */
 	route_map_rule_add(&index->set_list, rule);
+	route_map_cache_invalidate();
 
 	/* Execute event hook. */
 	if (route_map_master.event_hook) {
@@ -1323,6 +1363,7 @@ int route_map_delete_set(struct route_map_index *index, const char *set_name,
 		if ((rule->cmd == cmd) && (rulecmp(rule->rule_str, set_arg) == 0
 					   || set_arg == NULL)) {
 			route_map_rule_delete(&index->set_list, rule);
+			route_map_cache_invalidate();
 			/* Execute event hook. */
 			if (route_map_master.event_hook) {
 				(*route_map_master.event_hook)(
@@ -1510,6 +1551,112 @@ route_map_result_t route_map_apply(struct route_map *map, struct prefix *prefix,
 	return RMAP_DENYMATCH;
 }
 
+/*
+ * A route-map's result can be cached when the first matching index decides
+ * it on its own: sets can't feed the matches of later indexes and no other
+ * route-map is called.  All match rules must declare their inputs.
+ */
+static bool route_map_cacheable(struct route_map *map)
+{
+	struct route_map_index *index;
+	struct route_map_rule *match;
+
+	if (map->cache_gen == route_map_cache_gen)
+		return map->cacheable;
+
+	map->cache_gen = route_map_cache_gen;
+	map->cache_deps = 0;
+	map->cacheable = false;
+
+	for (index = map->head; index; index = index->next) {
+		if (index->exitpolicy != RMAP_EXIT || index->nextrm)
+			return false;
+
+		for (match = index->match_list.head; match;
+		     match = match->next) {
+			if (!match->cmd->cache_deps)
+				return false;
+			map->cache_deps |= match->cmd->cache_deps;
+		}
+	}
+
+	map->cacheable = true;
+	return true;
+}
+
+struct route_map_cache *route_map_cache_new(void)
+{
+	return XCALLOC(MTYPE_ROUTE_MAP_CACHE, sizeof(struct route_map_cache));
+}
+
+void route_map_cache_free(struct route_map_cache *cache)
+{
+	XFREE(MTYPE_ROUTE_MAP_CACHE, cache);
+}
+
+void route_map_cache_stats(struct route_map_cache *cache, uint64_t *hits,
+			   uint64_t *misses)
+{
+	*hits = cache ? cache->hits : 0;
+	*misses = cache ? cache->misses : 0;
+}
+
+route_map_result_t route_map_apply_cached(struct route_map_cache *cache,
+					  struct route_map *map,
+					  struct prefix *prefix,
+					  route_map_object_t type,
+					  void *object, uint64_t key)
+{
+	struct route_map_cache_entry *entry;
+	struct route_map_index *index;
+	struct route_map_rule *set;
+	route_map_result_t ret;
+	uint32_t hash;
+
+	if (!cache || !map || !prefix || !route_map_cacheable(map))
+		return route_map_apply(map, prefix, type, object);
+
+	/* only hash what the match rules look at, so that e.g. a map matching
+	 * on communities is evaluated once per attribute, not per prefix */
+	hash = jhash(&map, sizeof(map), 0);
+	if (map->cache_deps & RMAP_CACHE_OBJECT)
+		hash = jhash_2words(key, key >> 32, hash);
+	if (map->cache_deps & RMAP_CACHE_PREFIX)
+		hash = jhash_1word(prefix_hash_key(prefix), hash);
+
+	entry = &cache->entries[hash & (RMAP_CACHE_SIZE - 1)];
+	if (entry->gen == route_map_cache_gen && entry->map == map
+	    && (!(map->cache_deps & RMAP_CACHE_OBJECT) || entry->key == key)
+	    && (!(map->cache_deps & RMAP_CACHE_PREFIX)
+		|| prefix_same(&entry->prefix, prefix))) {
+		cache->hits++;
+		index = entry->index;
+	} else {
+		cache->misses++;
+		for (index = map->head; index; index = index->next)
+			if (route_map_apply_match(&index->match_list, prefix,
+						  type, object)
+			    == RMAP_MATCH)
+				break;
+
+		entry->gen = route_map_cache_gen;
+		entry->map = map;
+		entry->key = key;
+		prefix_copy(&entry->prefix, prefix);
+		entry->index = index;
+	}
+
+	if (!index || index->type != RMAP_PERMIT)
+		return RMAP_DENYMATCH;
+
+	/* sets still run for every object */
+	ret = RMAP_MATCH;
+	for (set = index->set_list.head; set; set = set->next)
+		ret = (*set->cmd->func_apply)(set->value, prefix, type, object);
+
+	return ret;
+}
+
 void route_map_add_hook(void (*func)(const char *))
 {
 	route_map_master.add_hook = func;
@@ -1757,6 +1904,9 @@ void route_map_notify_dependencies(const char *affected_name,
 	if (!affected_name)
 		return;
 
+	/* a list or route-map used by some match rule changed */
+	route_map_cache_invalidate();
+
 	name = XSTRDUP(MTYPE_ROUTE_MAP_NAME, affected_name);
 
 	if ((upd8_hash = route_map_get_dep_hash(event)) == NULL) {
@@ -2474,6 +2624,7 @@ DEFUN (rmap_onmatch_next,
 			return CMD_WARNING_CONFIG_FAILED;
 		}
 		index->exitpolicy = RMAP_NEXT;
+		route_map_cache_invalidate();
 	}
 	return CMD_SUCCESS;
 }
@@ -2487,8 +2638,10 @@ DEFUN (no_rmap_onmatch_next,
 {
 	struct route_map_index *index = VTY_GET_CONTEXT(route_map_index);
 
-	if (index)
+	if (index) {
 		index->exitpolicy = RMAP_EXIT;
+		route_map_cache_invalidate();
+	}
 
 	return CMD_SUCCESS;
 }
@@ -2528,6 +2681,7 @@ DEFUN (rmap_onmatch_goto,
 		} else {
 			index->exitpolicy = RMAP_GOTO;
 			index->nextpref = d;
+			route_map_cache_invalidate();
 		}
 	}
 	return CMD_SUCCESS;
@@ -2542,8 +2696,10 @@ DEFUN (no_rmap_onmatch_goto,
 {
 	struct route_map_index *index = VTY_GET_CONTEXT(route_map_index);
 
-	if (index)
+	if (index) {
 		index->exitpolicy = RMAP_EXIT;
+		route_map_cache_invalidate();
+	}
 
 	return CMD_SUCCESS;
 }
@@ -2601,6 +2757,7 @@ DEFUN (rmap_call,
 		XFREE(MTYPE_ROUTE_MAP_NAME, index->nextrm);
 	}
 	index->nextrm = XSTRDUP(MTYPE_ROUTE_MAP_NAME, rmap);
+	route_map_cache_invalidate();
 
 	/* Execute event hook. */
 	route_map_upd8_dependency(RMAP_EVENT_CALL_ADDED, index->nextrm,
@@ -2621,6 +2778,7 @@ DEFUN (no_rmap_call,
 					  index->nextrm, index->map->name);
 		XFREE(MTYPE_ROUTE_MAP_NAME, index->nextrm);
 		index->nextrm = NULL;
+		route_map_cache_invalidate();
 	}
 
 	return CMD_SUCCESS;
@@ -95,8 +95,17 @@ struct route_map_rule_cmd {
 
 	/* Free allocated value by func_compile (). */
 	void (*func_free)(void *);
+
+	/* RMAP_CACHE_* inputs the match depends on, 0 if its result must not
+	 * be cached (see route_map_apply_cached()). */
+	uint8_t cache_deps;
 };
 
+/* Match rule depends on the prefix. */
+#define RMAP_CACHE_PREFIX	(1 << 0)
+/* Match rule depends on the object, as identified by the caller's key. */
+#define RMAP_CACHE_OBJECT	(1 << 1)
+
 /* Route map apply error. */
 enum { RMAP_COMPILE_SUCCESS,
 
@@ -161,10 +170,18 @@ struct route_map {
 	int to_be_processed; /* True if modification isn't acted on yet */
 	int deleted;	 /* If 1, then this node will be deleted */
 
+	/* route_map_cacheable() result, valid for one cache generation */
+	uint64_t cache_gen;
+	uint8_t cache_deps;
+	bool cacheable;
+
 	QOBJ_FIELDS
 };
 DECLARE_QOBJ_TYPE(route_map)
 
+/* Memoizes which index of a route-map an object matched. */
+struct route_map_cache;
+
 /* Prototypes. */
 extern void route_map_init(void);
 extern void route_map_finish(void);
@@ -212,6 +229,27 @@ extern route_map_result_t route_map_apply(struct route_map *map,
 					  route_map_object_t object_type,
 					  void *object);
 
+extern struct route_map_cache *route_map_cache_new(void);
+extern void route_map_cache_free(struct route_map_cache *cache);
+extern void route_map_cache_stats(struct route_map_cache *cache,
+				  uint64_t *hits, uint64_t *misses);
+
+/*
+ * Like route_map_apply(), but remembers which index matched.  An object
+ * seen again with the same key (and the same prefix, if any match rule needs
+ * it) skips the match rules; the set rules still run.  The caller must pick
+ * keys such that equal keys identify objects that all match rules marked
+ * RMAP_CACHE_OBJECT see as equal.  Route-maps that can't be cached, because
+ * a match rule lacks cache_deps or an index continues or calls another map,
+ * are applied normally.  Any route-map or list change invalidates all
+ * caches.
+ */
+extern route_map_result_t route_map_apply_cached(struct route_map_cache *cache,
+						 struct route_map *map,
+						 struct prefix *prefix,
+						 route_map_object_t type,
+						 void *object, uint64_t key);
+
 extern void route_map_add_hook(void (*func)(const char *));
 extern void route_map_delete_hook(void (*func)(const char *));
 extern void route_map_event_hook(void (*func)(route_map_event_t, const char *));
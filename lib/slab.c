@@ -0,0 +1,287 @@
+/*
+ * Fixed-size object allocator.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "slab.h"
+#include "memory.h"
+#include "queue.h"
+
+DEFINE_MTYPE_STATIC(LIB, SLAB, "Slab")
+DEFINE_MTYPE_STATIC(LIB, SLAB_CHUNK, "Slab chunk")
+
+/*
+ * Chunks are aligned to their size so that the chunk an object belongs to
+ * can be found by masking the object's address.
+ */
+#define SLAB_CHUNK_SIZE (64 * 1024)
+#define SLAB_HUGE_CHUNK_SIZE (2 * 1024 * 1024)
+#define SLAB_ALIGN 16
+#define SLAB_ROUNDUP(x) (((x) + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1))
+
+struct slab_chunk {
+	TAILQ_ENTRY(slab_chunk) entry;
+
+	/* objects freed back to this chunk, linked through their first word */
+	void *freelist;
+	/* objects currently handed out */
+	unsigned int used;
+	/* objects carved off the never-used tail of the chunk */
+	unsigned int carved;
+	/* mmap()ed from the hugetlbfs pool rather than malloc()ed */
+	bool hugetlb;
+};
+
+TAILQ_HEAD(slab_chunk_list, slab_chunk);
+
+struct slab {
+	TAILQ_ENTRY(slab) entry;
+
+	struct memtype *mt;
+	enum slab_pages pages;
+	size_t chunksize;
+	size_t objsize;
+	size_t offset;
+	unsigned int perchunk;
+	size_t count;
+	unsigned int chunks;
+	unsigned int hugetlb_chunks;
+
+	/* chunks with at least one free object, and chunks without */
+	struct slab_chunk_list avail;
+	struct slab_chunk_list full;
+};
+
+TAILQ_HEAD(slab_list, slab);
+
+/* all slabs, for slab_walk() */
+static pthread_mutex_t slabs_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct slab_list slabs = TAILQ_HEAD_INITIALIZER(slabs);
+static enum slab_pages slab_pages_default = SLAB_PAGES_NORMAL;
+
+static inline struct slab_chunk *slab_chunk_of(struct slab *slab, void *obj)
+{
+	return (struct slab_chunk *)((uintptr_t)obj
+				     & ~(uintptr_t)(slab->chunksize - 1));
+}
+
+static struct slab_chunk *slab_chunk_new(struct slab *slab)
+{
+	struct slab_chunk *chunk;
+	bool hugetlb = false;
+	void *mem = NULL;
+
+#ifdef MAP_HUGETLB
+	/* huge page mappings are aligned to the huge page size */
+	if (slab->pages == SLAB_PAGES_EXPLICIT) {
+		mem = mmap(NULL, slab->chunksize, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mem == MAP_FAILED)
+			mem = NULL;
+		else
+			hugetlb = true;
+	}
+#endif
+	if (!mem) {
+		if (posix_memalign(&mem, slab->chunksize, slab->chunksize)) {
+			memory_oom(slab->chunksize, MTYPE_SLAB_CHUNK->name);
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		if (slab->pages != SLAB_PAGES_NORMAL)
+			madvise(mem, slab->chunksize, MADV_HUGEPAGE);
+#endif
+	}
+	qcount_alloc(MTYPE_SLAB_CHUNK, slab->chunksize);
+
+	chunk = mem;
+	chunk->freelist = NULL;
+	chunk->used = 0;
+	chunk->carved = 0;
+	chunk->hugetlb = hugetlb;
+	TAILQ_INSERT_HEAD(&slab->avail, chunk, entry);
+
+	slab->chunks++;
+	if (hugetlb)
+		slab->hugetlb_chunks++;
+	return chunk;
+}
+
+static void slab_chunk_free(struct slab *slab, struct slab_chunk *chunk)
+{
+	slab->count -= chunk->used;
+	while (chunk->used--)
+		qcount_free(slab->mt);
+
+	qcount_free(MTYPE_SLAB_CHUNK);
+	slab->chunks--;
+#ifdef MAP_HUGETLB
+	if (chunk->hugetlb) {
+		slab->hugetlb_chunks--;
+		munmap(chunk, slab->chunksize);
+		return;
+	}
+#endif
+	free(chunk);
+}
+
+void slab_set_pages(enum slab_pages pages)
+{
+	pthread_mutex_lock(&slabs_mtx);
+	slab_pages_default = pages;
+	pthread_mutex_unlock(&slabs_mtx);
+}
+
+struct slab *slab_new(struct memtype *mt, size_t objsize)
+{
+	struct slab *slab = XCALLOC(MTYPE_SLAB, sizeof(struct slab));
+
+	slab->mt = mt;
+	slab->objsize = SLAB_ROUNDUP(MAX(objsize, sizeof(void *)));
+	slab->offset = SLAB_ROUNDUP(sizeof(struct slab_chunk));
+	TAILQ_INIT(&slab->avail);
+	TAILQ_INIT(&slab->full);
+
+	pthread_mutex_lock(&slabs_mtx);
+	{
+		slab->pages = slab_pages_default;
+		TAILQ_INSERT_TAIL(&slabs, slab, entry);
+	}
+	pthread_mutex_unlock(&slabs_mtx);
+
+	slab->chunksize = slab->pages == SLAB_PAGES_NORMAL
+				  ? SLAB_CHUNK_SIZE
+				  : SLAB_HUGE_CHUNK_SIZE;
+	assert(slab->objsize <= (SLAB_CHUNK_SIZE - slab->offset) / 8);
+	slab->perchunk = (slab->chunksize - slab->offset) / slab->objsize;
+
+	return slab;
+}
+
+void slab_del(struct slab *slab)
+{
+	struct slab_chunk *chunk;
+
+	while ((chunk = TAILQ_FIRST(&slab->avail))) {
+		TAILQ_REMOVE(&slab->avail, chunk, entry);
+		slab_chunk_free(slab, chunk);
+	}
+	while ((chunk = TAILQ_FIRST(&slab->full))) {
+		TAILQ_REMOVE(&slab->full, chunk, entry);
+		slab_chunk_free(slab, chunk);
+	}
+
+	pthread_mutex_lock(&slabs_mtx);
+	TAILQ_REMOVE(&slabs, slab, entry);
+	pthread_mutex_unlock(&slabs_mtx);
+
+	XFREE(MTYPE_SLAB, slab);
+}
+
+void *slab_alloc(struct slab *slab)
+{
+	struct slab_chunk *chunk;
+	void *obj;
+
+	chunk = TAILQ_FIRST(&slab->avail);
+	if (!chunk)
+		chunk = slab_chunk_new(slab);
+
+	if (chunk->freelist) {
+		obj = chunk->freelist;
+		chunk->freelist = *(void **)obj;
+	} else
+		obj = (char *)chunk + slab->offset
+		      + (size_t)chunk->carved++ * slab->objsize;
+
+	if (++chunk->used == slab->perchunk) {
+		TAILQ_REMOVE(&slab->avail, chunk, entry);
+		TAILQ_INSERT_HEAD(&slab->full, chunk, entry);
+	}
+
+	slab->count++;
+	qcount_alloc(slab->mt, slab->objsize);
+	memset(obj, 0, slab->objsize);
+	return obj;
+}
+
+void slab_free(struct slab *slab, void *obj)
+{
+	struct slab_chunk *chunk;
+
+	if (!obj)
+		return;
+
+	chunk = slab_chunk_of(slab, obj);
+	assert(chunk->used);
+
+	*(void **)obj = chunk->freelist;
+	chunk->freelist = obj;
+
+	if (chunk->used-- == slab->perchunk) {
+		TAILQ_REMOVE(&slab->full, chunk, entry);
+		TAILQ_INSERT_HEAD(&slab->avail, chunk, entry);
+	}
+
+	slab->count--;
+	qcount_free(slab->mt);
+}
+
+unsigned int slab_reclaim(struct slab *slab)
+{
+	struct slab_chunk *chunk, *next;
+	unsigned int count = 0;
+
+	TAILQ_FOREACH_SAFE (chunk, &slab->avail, entry, next) {
+		if (chunk->used)
+			continue;
+
+		TAILQ_REMOVE(&slab->avail, chunk, entry);
+		slab_chunk_free(slab, chunk);
+		count++;
+	}
+
+	return count;
+}
+
+size_t slab_count(struct slab *slab)
+{
+	return slab->count;
+}
+
+void slab_walk(void (*func)(void *arg, const struct slab_stats *stats),
+	       void *arg)
+{
+	struct slab_stats stats;
+	struct slab *slab;
+
+	/* counters of slabs used by other pthreads are read unlocked */
+	pthread_mutex_lock(&slabs_mtx);
+	TAILQ_FOREACH (slab, &slabs, entry) {
+		stats.name = slab->mt->name;
+		stats.objsize = slab->objsize;
+		stats.count = slab->count;
+		stats.chunksize = slab->chunksize;
+		stats.chunks = slab->chunks;
+		stats.hugetlb_chunks = slab->hugetlb_chunks;
+		stats.pages = slab->pages;
+		func(arg, &stats);
+	}
+	pthread_mutex_unlock(&slabs_mtx);
+}
@@ -0,0 +1,138 @@
+/*
+ * Fixed-size object allocator.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_SLAB_H_
+#define _FRR_SLAB_H_
+
+#include "memory.h"
+
+/*
+ * A slab hands out objects of one size carved from large aligned chunks,
+ * avoiding the per-object malloc header and the fragmentation that millions
+ * of small long-lived allocations cause.
+ *
+ * Objects are still accounted against the memtype given to slab_new(), so
+ * "show memory" keeps reporting them; the chunks themselves show up as
+ * "Slab chunk".
+ *
+ * A slab is not thread-safe; it is meant to be used from a single pthread.
+ */
+struct slab;
+
+/*
+ * Pages slab chunks are backed with.  With huge pages, chunks are made one
+ * 2MB huge page each, so walking millions of objects of a slab takes a
+ * fraction of the TLB entries it would with 4K pages.  SLAB_PAGES_EXPLICIT
+ * maps chunks from the hugetlbfs pool (vm.nr_hugepages) and falls back to
+ * transparent huge pages once that is exhausted.
+ */
+enum slab_pages {
+	SLAB_PAGES_NORMAL,
+	SLAB_PAGES_TRANSPARENT,
+	SLAB_PAGES_EXPLICIT,
+};
+
+/*
+ * Sets the pages slabs created from now on are backed with.
+ *
+ * Existing slabs keep theirs.  Best set at startup, before any slab is
+ * created.
+ *
+ * @param pages	page type
+ */
+void slab_set_pages(enum slab_pages pages);
+
+struct slab_stats {
+	const char *name;
+	size_t objsize;
+	size_t count;
+	size_t chunksize;
+	unsigned int chunks;
+	/* chunks mapped from the hugetlbfs pool */
+	unsigned int hugetlb_chunks;
+	enum slab_pages pages;
+};
+
+/*
+ * Calls func with the statistics of each slab, from any pthread.
+ *
+ * @param func	callback
+ * @param arg	passed to func
+ */
+void slab_walk(void (*func)(void *arg, const struct slab_stats *stats),
+	       void *arg);
+
+/*
+ * Creates a new slab.
+ *
+ * @param mt		memtype objects are accounted against
+ * @param objsize	object size, in bytes
+ * @return the newly created slab
+ */
+struct slab *slab_new(struct memtype *mt, size_t objsize);
+
+/*
+ * Deletes a slab and all its chunks.
+ *
+ * Objects still allocated from the slab become invalid.
+ *
+ * @param slab	the slab to destroy
+ */
+void slab_del(struct slab *slab);
+
+/*
+ * Allocates a zeroed object.
+ *
+ * @param slab	the slab to allocate from
+ * @return the new object
+ */
+void *slab_alloc(struct slab *slab);
+
+/*
+ * Returns an object to its slab.
+ *
+ * @param slab	the slab obj was allocated from
+ * @param obj	the object to free, may be NULL
+ */
+void slab_free(struct slab *slab, void *obj);
+
+/*
+ * Gives chunks without any allocated object back to the system.
+ *
+ * Empty chunks are otherwise kept around for reuse, so this is best called
+ * after a large number of objects were freed in one go.
+ *
+ * @param slab	the slab to trim
+ * @return number of chunks released
+ */
+unsigned int slab_reclaim(struct slab *slab);
+
+/*
+ * Get number of objects currently allocated from a slab.
+ *
+ * @param slab	the slab to query
+ * @return number of allocated objects
+ */
+size_t slab_count(struct slab *slab);
+
+#define SLAB_FREE(slab, ptr)                                                   \
+	do {                                                                   \
+		slab_free(slab, ptr);                                          \
+		ptr = NULL;                                                    \
+	} while (0)
+
+#endif /* _FRR_SLAB_H_ */
@@ -573,6 +573,55 @@ int sockopt_tcp_rtt(int sock)
 #endif
 }
 
+int sockopt_tcp_stats(int sock, struct sockopt_tcp_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+#ifdef TCP_INFO
+	struct tcp_info ti;
+	socklen_t len = sizeof(ti);
+
+	if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0)
+		return -1;
+
+	stats->rtt = ti.tcpi_rtt / 1000;
+	stats->rttvar = ti.tcpi_rttvar / 1000;
+	stats->cwnd = ti.tcpi_snd_cwnd;
+	stats->unacked = ti.tcpi_unacked;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/* Only report the socket writable while less than bytes are queued in the
+ * kernel but not sent yet, so that the data is kept by the caller */
+int sockopt_tcp_notsent_lowat(int sock, int bytes)
+{
+#ifdef TCP_NOTSENT_LOWAT
+	int ret;
+
+	ret = setsockopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes,
+			 sizeof(bytes));
+	if (ret < 0)
+		zlog_warn("%s: fd %d: can't set TCP_NOTSENT_LOWAT to %d: %s",
+			  __func__, sock, bytes, safe_strerror(errno));
+	return ret;
+#else
+	return -1;
+#endif
+}
+
+/* Not sticky on Linux: the kernel may fall back to delayed acks later, so
+ * this has to be set again after reads */
+int sockopt_tcp_quickack(int sock, int on)
+{
+#ifdef TCP_QUICKACK
+	return setsockopt(sock, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+#else
+	return -1;
+#endif
+}
+
 int sockopt_tcp_signature(int sock, union sockunion *su, const char *password)
 {
 #if defined(HAVE_TCP_MD5_LINUX24) && defined(GNU_LINUX)
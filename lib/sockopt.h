@@ -96,6 +96,17 @@ extern void sockopt_iphdrincl_swab_htosys(struct ip *iph);
 extern void sockopt_iphdrincl_swab_systoh(struct ip *iph);
 
 extern int sockopt_tcp_rtt(int);
+
+/* A few TCP_INFO counters, all 0 where the system has no TCP_INFO */
+struct sockopt_tcp_stats {
+	uint32_t rtt;	 /* smoothed round trip time, ms */
+	uint32_t rttvar; /* its variance, ms */
+	uint32_t cwnd;	 /* congestion window, segments */
+	uint32_t unacked; /* segments sent but not acked yet */
+};
+extern int sockopt_tcp_stats(int sock, struct sockopt_tcp_stats *stats);
+extern int sockopt_tcp_notsent_lowat(int sock, int bytes);
+extern int sockopt_tcp_quickack(int sock, int on);
 extern int sockopt_tcp_signature(int sock, union sockunion *su,
 				 const char *password);
 #endif /*_ZEBRA_SOCKOPT_H */
@@ -25,6 +25,7 @@
 
 #include "srcdest_table.h"
 
+#include "hashfn.h"
 #include "memory.h"
 #include "prefix.h"
 #include "table.h"
@@ -137,9 +138,9 @@ static struct route_node *srcdest_srcnode_get(struct route_node *rn,
 	srn = srcdest_rnode_from_rnode(rn);
 	if (!srn->src_table) {
 		/* this won't use srcdest_rnode, we're already on the source
-		 * here */
-		srn->src_table = route_table_init_with_delegate(
-			&_srcdest_srcnode_delegate);
+		 * here.  Its nodes go in the destination table's hash. */
+		srn->src_table = route_table_init_subtable(
+			&_srcdest_srcnode_delegate, srn->table);
 		srn->src_table->info = srn;
 
 		/* there is no route_unlock_node on the original rn here.
@@ -183,11 +184,83 @@ static struct route_node *srcdest_srcnode_lookup(struct route_node *rn,
 	return route_node_lookup(srn->src_table, (struct prefix *)src_p);
 }
 
+/* ----- combined (dst, src) index ----- */
+
+/* The hash of a srcdest table holds both its destination nodes and the
+ * nodes of all its source tables, keyed on the destination and, for the
+ * latter, the source prefix; a srcdest route is thus found with a single
+ * hash lookup rather than one in each table. */
+
+static inline uint64_t srcdest_hash_addr(uint64_t h,
+					 const struct in6_addr *addr)
+{
+	uint64_t w[2];
+
+	memcpy(w, addr, sizeof(w));
+	return hashfn_mix(h, w[0], w[1]);
+}
+
+/* Nodes and keys are masked already, so IPv6 prefixes are hashed from
+ * their address words directly rather than through prefix_hash_key()'s
+ * zeroed copy. */
+static unsigned int srcdest_hash_key(void *data)
+{
+	struct prefix *dst_p, *src_p;
+	uint64_t h;
+
+	srcdest_rnode_prefixes(data, &dst_p, &src_p);
+	if (dst_p->family != AF_INET6)
+		return prefix_hash_key(dst_p);
+
+	h = hashfn_mix(0, dst_p->prefixlen, src_p ? src_p->prefixlen + 1 : 0);
+	h = srcdest_hash_addr(h, &dst_p->u.prefix6);
+	if (src_p)
+		h = srcdest_hash_addr(h, &src_p->u.prefix6);
+	return hashfn_fold(h);
+}
+
+static int srcdest_hash_cmp(const void *a, const void *b)
+{
+	struct prefix *dst_a, *src_a, *dst_b, *src_b;
+
+	srcdest_rnode_prefixes((struct route_node *)a, &dst_a, &src_a);
+	srcdest_rnode_prefixes((struct route_node *)b, &dst_b, &src_b);
+
+	if (!src_a != !src_b)
+		return 0;
+	if (src_a && prefix_cmp(src_a, src_b))
+		return 0;
+	return prefix_cmp(dst_a, dst_b) == 0;
+}
+
+/* Looks up a source node by (dst, src) in the destination table's hash.
+ * The key stands in for a source table whose info is the destination node,
+ * which is all srcdest_rnode_prefixes() looks at. */
+static struct route_node *srcdest_srcnode_find(struct route_table *table,
+					       struct prefix_ipv6 *dst_p,
+					       struct prefix_ipv6 *src_p)
+{
+	struct route_node dst_key, src_key;
+	struct route_table table_key = {
+		.delegate = &_srcdest_srcnode_delegate,
+		.info = &dst_key,
+	};
+
+	prefix_copy(&dst_key.p, (struct prefix *)dst_p);
+	apply_mask(&dst_key.p);
+	prefix_copy(&src_key.p, (struct prefix *)src_p);
+	apply_mask(&src_key.p);
+	src_key.table = &table_key;
+
+	return hash_lookup(table->hash, &src_key);
+}
+
 /* ----- exported functions ----- */
 
 struct route_table *srcdest_table_init(void)
 {
-	return route_table_init_with_delegate(&_srcdest_dstnode_delegate);
+	return route_table_init_with_hash(&_srcdest_dstnode_delegate,
+					  srcdest_hash_key, srcdest_hash_cmp);
 }
 
 struct route_node *srcdest_route_next(struct route_node *rn)
@@ -239,6 +312,14 @@ struct route_node *srcdest_rnode_get(struct route_table *table,
 	struct prefix_ipv6 *dst_p = dst_pu.p6;
 	struct route_node *rn;
 
+	/* an existing source node holds a reference on its destination node
+	 * already, so only the source node itself needs locking */
+	if (src_p && src_p->prefixlen) {
+		rn = srcdest_srcnode_find(table, dst_p, src_p);
+		if (rn)
+			return route_lock_node(rn);
+	}
+
 	rn = route_node_get(table, (struct prefix *)dst_p);
 	return srcdest_srcnode_get(rn, src_p);
 }
@@ -251,6 +332,11 @@ struct route_node *srcdest_rnode_lookup(struct route_table *table,
 	struct route_node *rn;
 	struct route_node *srn;
 
+	if (src_p && src_p->prefixlen) {
+		rn = srcdest_srcnode_find(table, dst_p, src_p);
+		return (rn && rn->info) ? route_lock_node(rn) : NULL;
+	}
+
 	rn = route_node_lookup_maynull(table, (struct prefix *)dst_p);
 	srn = srcdest_srcnode_lookup(rn, src_p);
 
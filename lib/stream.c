@@ -27,11 +27,27 @@
 #include "network.h"
 #include "prefix.h"
 #include "log.h"
+#include "mtcache.h"
 
 DEFINE_MTYPE_STATIC(LIB, STREAM, "Stream")
 DEFINE_MTYPE_STATIC(LIB, STREAM_DATA, "Stream data")
 DEFINE_MTYPE_STATIC(LIB, STREAM_FIFO, "Stream FIFO")
 
+/* Streams, and their data in size classes of powers of 2, are allocated
+ * from these when enabled.  A stream's cached field says whether it came
+ * from stream_cache, and which class its data came from, if any; data of a
+ * class is at least as large as the stream's size.
+ */
+#define STREAM_CACHE_DEPTH 256
+#define STREAM_CACHE_MIN_SHIFT 8
+#define STREAM_CACHE_CLASSES 9 /* 256 bytes to 64 KiB */
+#define STREAM_CACHED_SELF (1 << 0)
+#define STREAM_CACHED_CLASS(s) ((int)((s)->cached >> 1) - 1)
+#define STREAM_CACHED_DATA(class) (((class) + 1) << 1)
+
+static struct mtcache *stream_cache;
+static struct mtcache *stream_data_cache[STREAM_CACHE_CLASSES];
+
 /* Tests whether a position is valid */
 #define GETP_VALID(S, G) ((G) <= (S)->endp)
 #define PUT_AT_VALID(S,G) GETP_VALID(S,G)
@@ -92,35 +108,139 @@ DEFINE_MTYPE_STATIC(LIB, STREAM_FIFO, "Stream FIFO")
 		}                                                              \
 	} while (0);
 
+void stream_cache_enable(void)
+{
+	unsigned int i;
+
+	if (stream_cache)
+		return;
+
+	stream_cache = mtcache_new(MTYPE_STREAM, sizeof(struct stream),
+				   STREAM_CACHE_DEPTH);
+	for (i = 0; i < STREAM_CACHE_CLASSES; i++)
+		stream_data_cache[i] = mtcache_new(
+			MTYPE_STREAM_DATA, (size_t)1 << (STREAM_CACHE_MIN_SHIFT + i),
+			STREAM_CACHE_DEPTH);
+}
+
+void stream_cache_finish(void)
+{
+	unsigned int i;
+
+	if (!stream_cache)
+		return;
+
+	mtcache_del(stream_cache);
+	stream_cache = NULL;
+	for (i = 0; i < STREAM_CACHE_CLASSES; i++) {
+		mtcache_del(stream_data_cache[i]);
+		stream_data_cache[i] = NULL;
+	}
+}
+
+/* Size class for data of size bytes, -1 for none */
+static int stream_cache_class(size_t size)
+{
+	int class = 0;
+
+	if (!stream_cache)
+		return -1;
+
+	while (((size_t)1 << (STREAM_CACHE_MIN_SHIFT + class)) < size)
+		if (++class == STREAM_CACHE_CLASSES)
+			return -1;
+	return class;
+}
+
+static struct stream *stream_alloc(void)
+{
+	struct stream *s;
+
+	if (!stream_cache)
+		return XCALLOC(MTYPE_STREAM, sizeof(struct stream));
+
+	s = mtcache_alloc(stream_cache);
+	memset(s, 0, sizeof(*s));
+	s->cached = STREAM_CACHED_SELF;
+	return s;
+}
+
+static void stream_release(struct stream *s)
+{
+	if (s->cached & STREAM_CACHED_SELF)
+		mtcache_free(stream_cache, s);
+	else
+		XFREE(MTYPE_STREAM, s);
+}
+
+static uint8_t *stream_data_alloc(size_t size, int class)
+{
+	if (class < 0)
+		return XMALLOC(MTYPE_STREAM_DATA, size);
+	return mtcache_alloc(stream_data_cache[class]);
+}
+
+static void stream_data_release(uint8_t *data, int class)
+{
+	if (class < 0)
+		XFREE(MTYPE_STREAM_DATA, data);
+	else
+		mtcache_free(stream_data_cache[class], data);
+}
+
 /* Make stream buffer. */
 struct stream *stream_new(size_t size)
 {
 	struct stream *s;
+	int class;
 
 	assert(size > 0);
 
-	s = XCALLOC(MTYPE_STREAM, sizeof(struct stream));
+	s = stream_alloc();
 
 	if (s == NULL)
 		return s;
 
-	if ((s->data = XMALLOC(MTYPE_STREAM_DATA, size)) == NULL) {
-		XFREE(MTYPE_STREAM, s);
+	class = stream_cache_class(size);
+	if ((s->data = stream_data_alloc(size, class)) == NULL) {
+		stream_release(s);
 		return NULL;
 	}
 
+	s->cached |= STREAM_CACHED_DATA(class);
 	s->size = size;
+	atomic_store_explicit(&s->refcnt, 1, memory_order_relaxed);
 	return s;
 }
 
-/* Free it now. */
-void stream_free(struct stream *s)
+static void stream_free_one(struct stream *s)
 {
-	if (!s)
+	struct stream *origin;
+
+	origin = s->origin;
+	if (origin) {
+		stream_release(s);
+		s = origin;
+	}
+
+	/* shared streams may be released from different pthreads */
+	if (atomic_fetch_sub_explicit(&s->refcnt, 1, memory_order_acq_rel) > 1)
 		return;
 
-	XFREE(MTYPE_STREAM_DATA, s->data);
-	XFREE(MTYPE_STREAM, s);
+	stream_data_release(s->data, STREAM_CACHED_CLASS(s));
+	stream_release(s);
+}
+
+/* Free it now, along with the segments chained behind it. */
+void stream_free(struct stream *s)
+{
+	struct stream *next;
+
+	while (s) {
+		next = s->chain;
+		stream_free_one(s);
+		s = next;
+	}
 }
 
 struct stream *stream_copy(struct stream *new, struct stream *src)
@@ -150,6 +270,118 @@ struct stream *stream_dup(struct stream *s)
 	return (stream_copy(new, s));
 }
 
+struct stream *stream_share(struct stream *s)
+{
+	struct stream *new;
+
+	STREAM_VERIFY_SANE(s);
+	assert(!s->chain);
+
+	if (s->origin)
+		s = s->origin;
+
+	new = stream_alloc();
+	atomic_fetch_add_explicit(&s->refcnt, 1, memory_order_relaxed);
+	new->origin = s;
+	new->data = s->data;
+	new->size = new->endp = s->endp;
+
+	return new;
+}
+
+void stream_reshare(struct stream *s, struct stream *src)
+{
+	struct stream *old = s->origin;
+
+	assert(old);
+	STREAM_VERIFY_SANE(src);
+
+	if (src->origin)
+		src = src->origin;
+
+	atomic_fetch_add_explicit(&src->refcnt, 1, memory_order_relaxed);
+	s->origin = src;
+	s->data = src->data;
+	s->size = s->endp = src->endp;
+	s->getp = 0;
+
+	if (atomic_fetch_sub_explicit(&old->refcnt, 1, memory_order_acq_rel) > 1)
+		return;
+
+	stream_data_release(old->data, STREAM_CACHED_CLASS(old));
+	stream_release(old);
+}
+
+struct stream *stream_share_range(struct stream *s, size_t from, size_t to)
+{
+	struct stream *new = stream_share(s);
+
+	assert(from <= to && to <= new->endp);
+	new->getp = from;
+	new->size = new->endp = to;
+	return new;
+}
+
+void stream_chain_append(struct stream *s, struct stream *seg)
+{
+	while (s->chain)
+		s = s->chain;
+	s->chain = seg;
+}
+
+size_t stream_chain_readable(struct stream *s)
+{
+	size_t readable = 0;
+
+	for (; s; s = s->chain)
+		readable += STREAM_READABLE(s);
+	return readable;
+}
+
+int stream_chain_iov(struct stream *s, struct iovec *iov, int iovmax)
+{
+	int iovcnt = 0;
+
+	for (; s; s = s->chain) {
+		if (!STREAM_READABLE(s))
+			continue;
+		if (iovcnt == iovmax)
+			return 0;
+		iov[iovcnt].iov_base = STREAM_PNT(s);
+		iov[iovcnt].iov_len = STREAM_READABLE(s);
+		iovcnt++;
+	}
+	return iovcnt;
+}
+
+void stream_chain_forward_getp(struct stream *s, size_t size)
+{
+	size_t n;
+
+	for (; s && size; s = s->chain) {
+		n = MIN(size, STREAM_READABLE(s));
+		stream_forward_getp(s, n);
+		size -= n;
+	}
+	assert(size == 0);
+}
+
+struct stream *stream_patch(struct stream *s, size_t offset,
+			    const void *data, size_t len)
+{
+	struct stream *head, *patch;
+
+	STREAM_VERIFY_SANE(s);
+	assert(offset + len <= s->endp);
+
+	head = stream_share_range(s, 0, offset);
+	patch = stream_new(len);
+	stream_put(patch, data, len);
+	stream_chain_append(head, patch);
+	stream_chain_append(head, stream_share_range(s, offset + len, s->endp));
+	return head;
+}
+
 struct stream *stream_dupcat(struct stream *s1, struct stream *s2,
 			     size_t offset)
 {
@@ -172,9 +404,27 @@ struct stream *stream_dupcat(struct stream *s1, struct stream *s2,
 size_t stream_resize(struct stream *s, size_t newsize)
 {
 	uint8_t *newdata;
-	STREAM_VERIFY_SANE(s);
+	int class, newclass;
 
-	newdata = XREALLOC(MTYPE_STREAM_DATA, s->data, newsize);
+	STREAM_VERIFY_SANE(s);
+	assert(!s->origin
+	       && atomic_load_explicit(&s->refcnt, memory_order_relaxed) == 1);
+
+	class = STREAM_CACHED_CLASS(s);
+	newclass = stream_cache_class(newsize);
+
+	if (class < 0 && newclass < 0)
+		newdata = XREALLOC(MTYPE_STREAM_DATA, s->data, newsize);
+	else if (class == newclass)
+		/* the data's size class has room for it */
+		newdata = s->data;
+	else {
+		newdata = stream_data_alloc(newsize, newclass);
+		memcpy(newdata, s->data, MIN(s->size, newsize));
+		stream_data_release(s->data, class);
+		s->cached = (s->cached & STREAM_CACHED_SELF)
+			    | STREAM_CACHED_DATA(newclass);
+	}
 
 	if (newdata == NULL)
 		return s->size;
@@ -1104,15 +1354,39 @@ struct stream_fifo *stream_fifo_new(void)
 	return new;
 }
 
+static inline struct stream *stream_from_mq(struct mpscq_item *item)
+{
+	if (!item)
+		return NULL;
+
+	return (struct stream *)((char *)item - offsetof(struct stream, mq));
+}
+
+struct stream_fifo *stream_fifo_new_mpsc(void)
+{
+	struct stream_fifo *new;
+
+	new = XCALLOC(MTYPE_STREAM_FIFO, sizeof(struct stream_fifo));
+	new->mpsc = true;
+	mpscq_init(&new->mq);
+	return new;
+}
+
 /* Add new stream to fifo. */
 void stream_fifo_push(struct stream_fifo *fifo, struct stream *s)
 {
+	if (fifo->mpsc) {
+		mpscq_push(&fifo->mq, &s->mq);
+		return;
+	}
+
 	if (fifo->tail)
 		fifo->tail->next = s;
 	else
 		fifo->head = s;
 
 	fifo->tail = s;
+	fifo->tail->next = NULL;
 
 	fifo->count++;
 }
@@ -1120,8 +1394,14 @@ void stream_fifo_push(struct stream_fifo *fifo, struct stream *s)
 /* Delete first stream from fifo. */
 struct stream *stream_fifo_pop(struct stream_fifo *fifo)
 {
+	struct mpscq_item *item;
 	struct stream *s;
 
+	if (fifo->mpsc) {
+		item = mpscq_pop(&fifo->mq);
+		return stream_from_mq(item);
+	}
+
 	s = fifo->head;
 
 	if (s) {
@@ -1139,14 +1419,35 @@ struct stream *stream_fifo_pop(struct stream_fifo *fifo)
 /* Return first fifo entry. */
 struct stream *stream_fifo_head(struct stream_fifo *fifo)
 {
+	struct mpscq_item *item;
+
+	if (fifo->mpsc) {
+		item = mpscq_peek(&fifo->mq);
+		return stream_from_mq(item);
+	}
+
 	return fifo->head;
 }
 
+struct stream *stream_fifo_next(struct stream_fifo *fifo, struct stream *s)
+{
+	if (fifo->mpsc)
+		return stream_from_mq(mpscq_next(&fifo->mq, &s->mq));
+
+	return s->next;
+}
+
 void stream_fifo_clean(struct stream_fifo *fifo)
 {
 	struct stream *s;
 	struct stream *next;
 
+	if (fifo->mpsc) {
+		while ((s = stream_fifo_pop(fifo)))
+			stream_free(s);
+		return;
+	}
+
 	for (s = fifo->head; s; s = next) {
 		next = s->next;
 		stream_free(s);
@@ -1160,3 +1461,11 @@ void stream_fifo_free(struct stream_fifo *fifo)
 	stream_fifo_clean(fifo);
 	XFREE(MTYPE_STREAM_FIFO, fifo);
 }
+
+size_t stream_fifo_count(struct stream_fifo *fifo)
+{
+	if (fifo->mpsc)
+		return mpscq_count(&fifo->mq);
+
+	return fifo->count;
+}
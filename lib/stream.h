@@ -23,6 +23,7 @@
 #define _ZEBRA_STREAM_H
 
 #include "mpls.h"
+#include "mpscq.h"
 #include "prefix.h"
 
 /*
@@ -94,6 +95,8 @@
 /* Stream buffer. */
 struct stream {
 	struct stream *next;
+	/* link for lock-free fifos */
+	struct mpscq_item mq;
 
 	/* Remainder is ***private*** to stream
 	 * direct access is frowned upon!
@@ -103,6 +106,16 @@ struct stream {
 	size_t endp;	 /* last valid data position */
 	size_t size;	 /* size of data segment */
 	unsigned char *data; /* data pointer */
+
+	/* data borrowed from another stream, see stream_share() */
+	struct stream *origin;
+	/* streams referencing data, including this one */
+	_Atomic uint32_t refcnt;
+	/* stream and/or data came from the caches, see stream_cache_enable() */
+	uint8_t cached;
+
+	/* next segment written out after this one, see stream_chain_append() */
+	struct stream *chain;
 };
 
 /* First in first out queue structure. */
@@ -111,6 +124,10 @@ struct stream_fifo {
 
 	struct stream *head;
 	struct stream *tail;
+
+	/* lock-free fifo, see stream_fifo_new_mpsc() */
+	bool mpsc;
+	struct mpscq mq;
 };
 
 /* Utility macros. */
@@ -142,8 +159,62 @@ CPP_NOTICE("lib: time to remove deprecated stream.h macros")
  */
 extern struct stream *stream_new(size_t);
 extern void stream_free(struct stream *);
+
+/* Keep freed streams, and their data in power of 2 size classes from 256
+ * bytes to 64 KiB, in per-pthread caches for reuse; for daemons going
+ * through many short-lived streams, possibly passing them between pthreads.
+ * To be called before starting any pthread.
+ */
+extern void stream_cache_enable(void);
+/* Give all cached streams back, once other pthreads are stopped */
+extern void stream_cache_finish(void);
 extern struct stream *stream_copy(struct stream *, struct stream *src);
 extern struct stream *stream_dup(struct stream *);
+
+/**
+ * Create a new stream structure referencing the data of s instead of copying
+ * it.  The new stream has its own getp, and the data is freed along with the
+ * last stream referencing it, so s may be freed first.  Neither stream may be
+ * written to or resized afterwards.
+ */
+extern struct stream *stream_share(struct stream *s);
+
+/**
+ * Make s, a stream from stream_share(), reference the data of src instead of
+ * what it did so far, rewinding it.  s keeps its place in whatever fifo it is
+ * on; the data it referenced before is freed if s was the last user.
+ */
+extern void stream_reshare(struct stream *s, struct stream *src);
+
+/**
+ * Like stream_share(), but the new stream only covers bytes from up to to of
+ * s's data.
+ */
+extern struct stream *stream_share_range(struct stream *s, size_t from,
+					 size_t to);
+
+/**
+ * Chained streams: segments appended to a stream are written out after it,
+ * by writers that gather with stream_chain_iov(), and freed along with it.
+ * This lets consumers put their own bytes in front of, or in the middle of,
+ * segments shared with stream_share_range().  Only the head of a chain may
+ * be passed to the functions below, and a chained stream may not be shared.
+ */
+extern void stream_chain_append(struct stream *s, struct stream *seg);
+/* Readable bytes in s and the segments chained behind it */
+extern size_t stream_chain_readable(struct stream *s);
+/* Fills iov with the readable parts of the chain, returns the count, or 0
+ * if that takes more than iovmax */
+extern int stream_chain_iov(struct stream *s, struct iovec *iov, int iovmax);
+/* Moves getp forward by size bytes over the chain */
+extern void stream_chain_forward_getp(struct stream *s, size_t size);
+
+/**
+ * A chain reading as the whole of s with len bytes at offset replaced by
+ * data; s is shared, not copied, and may be freed first.
+ */
+extern struct stream *stream_patch(struct stream *s, size_t offset,
+				   const void *data, size_t len);
 extern size_t stream_resize(struct stream *, size_t);
 extern size_t stream_get_getp(struct stream *);
 extern size_t stream_get_endp(struct stream *);
@@ -242,11 +313,23 @@ extern uint8_t *stream_pnt(struct stream *);
 
 /* Stream fifo. */
 extern struct stream_fifo *stream_fifo_new(void);
+/*
+ * A fifo that any number of pthreads may push to while one pthread at a
+ * time pops, peeks at or cleans it, without having to lock it.  A pop may
+ * come up empty while a push is still in progress; the pushing pthread
+ * has to notify the consuming one afterwards anyway.
+ */
+extern struct stream_fifo *stream_fifo_new_mpsc(void);
 extern void stream_fifo_push(struct stream_fifo *fifo, struct stream *s);
 extern struct stream *stream_fifo_pop(struct stream_fifo *fifo);
 extern struct stream *stream_fifo_head(struct stream_fifo *fifo);
+/* The stream after s, which must be on the fifo; consumer only. */
+extern struct stream *stream_fifo_next(struct stream_fifo *fifo,
+				       struct stream *s);
 extern void stream_fifo_clean(struct stream_fifo *fifo);
 extern void stream_fifo_free(struct stream_fifo *fifo);
+/* Number of streams in the fifo, safe to call from any pthread. */
+extern size_t stream_fifo_count(struct stream_fifo *fifo);
 
 /* This is here because "<< 24" is particularly problematic in C.
  * This is because the left operand of << is integer-promoted, which means
@@ -266,6 +349,77 @@ static inline uint8_t *ptr_get_be32(uint8_t *ptr, uint32_t *out)
 	return ptr + 4;
 }
 
+/*
+ * Decoding a group of fields with a single bounds check: once
+ * stream_reserve() or STREAM_RESERVE() found that many bytes readable, the
+ * stream_get*_unchecked() functions below read them inline without checking
+ * again.  Reading past what was reserved is a bug.
+ */
+static inline bool stream_reserve(struct stream *s, size_t size)
+{
+	return s->getp <= s->endp && STREAM_READABLE(s) >= size;
+}
+
+static inline uint8_t stream_getc_unchecked(struct stream *s)
+{
+	return s->data[s->getp++];
+}
+
+static inline uint16_t stream_getw_unchecked(struct stream *s)
+{
+	uint16_t w;
+
+	memcpy(&w, s->data + s->getp, sizeof(w));
+	s->getp += sizeof(w);
+	return ntohs(w);
+}
+
+static inline uint32_t stream_get3_unchecked(struct stream *s)
+{
+	uint32_t l;
+
+	l = (uint32_t)s->data[s->getp] << 16;
+	l |= s->data[s->getp + 1] << 8;
+	l |= s->data[s->getp + 2];
+	s->getp += 3;
+	return l;
+}
+
+static inline uint32_t stream_getl_unchecked(struct stream *s)
+{
+	uint32_t l;
+
+	ptr_get_be32(s->data + s->getp, &l);
+	s->getp += sizeof(l);
+	return l;
+}
+
+static inline uint64_t stream_getq_unchecked(struct stream *s)
+{
+	uint64_t q;
+
+	q = (uint64_t)stream_getl_unchecked(s) << 32;
+	q |= stream_getl_unchecked(s);
+	return q;
+}
+
+/* In network byte order, as stream_get_ipv4() */
+static inline uint32_t stream_get_ipv4_unchecked(struct stream *s)
+{
+	uint32_t l;
+
+	memcpy(&l, s->data + s->getp, sizeof(l));
+	s->getp += sizeof(l);
+	return l;
+}
+
+static inline void stream_get_unchecked(void *dst, struct stream *s,
+					size_t size)
+{
+	memcpy(dst, s->data + s->getp, size);
+	s->getp += size;
+}
+
 /*
  * so Normal stream_getX functions assert.  Which is anathema
  * to keeping a daemon up and running when something goes south
@@ -311,4 +465,10 @@ static inline uint8_t *ptr_get_be32(uint8_t *ptr, uint32_t *out)
 			goto stream_failure;                                   \
 	} while (0)
 
+#define STREAM_RESERVE(S, SIZE)                                                \
+	do {                                                                   \
+		if (!stream_reserve((S), (SIZE)))                              \
+			goto stream_failure;                                   \
+	} while (0)
+
 #endif /* _ZEBRA_STREAM_H */
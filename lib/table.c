@@ -27,16 +27,26 @@
 #include "table.h"
 #include "memory.h"
 #include "sockunion.h"
+#include "thread.h"
 
 DEFINE_MTYPE(LIB, ROUTE_TABLE, "Route table")
 DEFINE_MTYPE(LIB, ROUTE_NODE, "Route node")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_TABLE_WALK, "Route table walk")
 
 static void route_table_free(struct route_table *);
 
 static int route_table_hash_cmp(const void *a, const void *b)
 {
 	const struct prefix *pa = a, *pb = b;
-	return prefix_cmp(pa, pb) == 0;
+
+	switch (pa->family) {
+	case AF_INET:
+		return pa->family == pb->family && !prefix_cmp_ipv4(pa, pb);
+	case AF_INET6:
+		return pa->family == pb->family && !prefix_cmp_ipv6(pa, pb);
+	default:
+		return prefix_cmp(pa, pb) == 0;
+	}
 }
 
 /*
@@ -44,13 +54,33 @@ static int route_table_hash_cmp(const void *a, const void *b)
  */
 struct route_table *
 route_table_init_with_delegate(route_table_delegate_t *delegate)
+{
+	return route_table_init_with_hash(delegate, prefix_hash_key,
+					  route_table_hash_cmp);
+}
+
+struct route_table *
+route_table_init_with_hash(route_table_delegate_t *delegate,
+			   unsigned int (*hash_key)(void *),
+			   int (*hash_cmp)(const void *, const void *))
+{
+	struct route_table *rt;
+
+	rt = XCALLOC(MTYPE_ROUTE_TABLE, sizeof(struct route_table));
+	rt->delegate = delegate;
+	rt->hash = hash_create(hash_key, hash_cmp, "route table hash");
+	return rt;
+}
+
+struct route_table *route_table_init_subtable(route_table_delegate_t *delegate,
+					      struct route_table *parent)
 {
 	struct route_table *rt;
 
 	rt = XCALLOC(MTYPE_ROUTE_TABLE, sizeof(struct route_table));
 	rt->delegate = delegate;
-	rt->hash = hash_create(prefix_hash_key, route_table_hash_cmp,
-			       "route table hash");
+	rt->hash = parent->hash;
+	rt->hash_shared = true;
 	return rt;
 }
 
@@ -99,9 +129,6 @@ static void route_table_free(struct route_table *rt)
 	if (rt == NULL)
 		return;
 
-	hash_clean(rt->hash, NULL);
-	hash_free(rt->hash);
-
 	node = rt->top;
 
 	/* Bulk deletion of nodes remaining in this table.  This function is not
@@ -123,6 +150,8 @@ static void route_table_free(struct route_table *rt)
 
 		tmp_node->table->count--;
 		tmp_node->lock = 0; /* to cause assert if unlocked after this */
+		if (rt->hash_shared)
+			hash_release(rt->hash, tmp_node);
 		route_node_free(rt, tmp_node);
 
 		if (node != NULL) {
@@ -137,6 +166,12 @@ static void route_table_free(struct route_table *rt)
 
 	assert(rt->count == 0);
 
+	/* freed last: destroying nodes may finish subtables sharing it */
+	if (!rt->hash_shared) {
+		hash_clean(rt->hash, NULL);
+		hash_free(rt->hash);
+	}
+
 	XFREE(MTYPE_ROUTE_TABLE, rt);
 	return;
 }
@@ -145,6 +180,20 @@ static void route_table_free(struct route_table *rt)
 static const uint8_t maskbit[] = {0x00, 0x80, 0xc0, 0xe0, 0xf0,
 				  0xf8, 0xfc, 0xfe, 0xff};
 
+/* prefix_match(), inlined for the families tables mostly hold. */
+static inline int route_prefix_match(const struct prefix *n,
+				     const struct prefix *p)
+{
+	switch (n->family) {
+	case AF_INET:
+		return prefix_match_ipv4(n, p);
+	case AF_INET6:
+		return prefix_match_ipv6(n, p);
+	default:
+		return prefix_match(n, p);
+	}
+}
+
 /* Common prefix route genaration. */
 static void route_common(const struct prefix *n, const struct prefix *p,
 			 struct prefix *new)
@@ -156,8 +205,22 @@ static void route_common(const struct prefix *n, const struct prefix *p,
 	const uint8_t *pp;
 	uint8_t *newp;
 
-	if (n->family == AF_FLOWSPEC)
+	switch (n->family) {
+	case AF_FLOWSPEC:
 		return prefix_copy(new, p);
+	case AF_INET:
+		i = prefix_common_bits_ipv4(n, p);
+		new->prefixlen = MIN(i, p->prefixlen);
+		new->u.prefix4 = n->u.prefix4;
+		apply_mask_ipv4((struct prefix_ipv4 *)new);
+		return;
+	case AF_INET6:
+		i = prefix_common_bits_ipv6(n, p);
+		new->prefixlen = MIN(i, p->prefixlen);
+		new->u.prefix6 = n->u.prefix6;
+		apply_mask_ipv6((struct prefix_ipv6 *)new);
+		return;
+	}
 	np = (const uint8_t *)&n->u.prefix;
 	pp = (const uint8_t *)&p->u.prefix;
 
@@ -191,6 +254,77 @@ static void set_link(struct route_node *node, struct route_node *new)
 	new->parent = node;
 }
 
+/*
+ * Longest-prefix match is the hot path of nexthop resolution, so IPv4 and
+ * IPv6 walk the tree on host-order words rather than going through the
+ * byte-wise prefix_match() and prefix_bit() for every node.
+ */
+static inline uint64_t table_get_be64(const uint8_t *b)
+{
+	uint32_t hi, lo;
+
+	memcpy(&hi, b, sizeof(hi));
+	memcpy(&lo, b + sizeof(hi), sizeof(lo));
+	return ((uint64_t)ntohl(hi) << 32) | ntohl(lo);
+}
+
+static struct route_node *route_node_match4(const struct route_node *node,
+					    const struct prefix *p)
+{
+	const struct route_node *matched = NULL;
+	uint32_t key = ntohl(p->u.prefix4.s_addr);
+	uint8_t nlen;
+
+	while (node && (nlen = node->p.prefixlen) <= p->prefixlen) {
+		if (nlen && ((ntohl(node->p.u.prefix4.s_addr) ^ key)
+			     >> (IPV4_MAX_BITLEN - nlen)))
+			break;
+		if (node->info)
+			matched = node;
+		if (nlen == p->prefixlen)
+			break;
+
+		node = node->link[(key >> (IPV4_MAX_BITLEN - 1 - nlen)) & 1];
+	}
+
+	return (struct route_node *)matched;
+}
+
+static struct route_node *route_node_match6(const struct route_node *node,
+					    const struct prefix *p)
+{
+	const struct route_node *matched = NULL;
+	uint64_t key[2], nkey[2];
+	uint8_t nlen;
+
+	key[0] = table_get_be64(&p->u.prefix6.s6_addr[0]);
+	key[1] = table_get_be64(&p->u.prefix6.s6_addr[8]);
+
+	while (node && (nlen = node->p.prefixlen) <= p->prefixlen) {
+		nkey[0] = table_get_be64(&node->p.u.prefix6.s6_addr[0]);
+		if (nlen <= 64) {
+			if (nlen && ((nkey[0] ^ key[0]) >> (64 - nlen)))
+				break;
+		} else {
+			nkey[1] = table_get_be64(&node->p.u.prefix6.s6_addr[8]);
+			if (nkey[0] != key[0]
+			    || ((nkey[1] ^ key[1]) >> (IPV6_MAX_BITLEN - nlen)))
+				break;
+		}
+		if (node->info)
+			matched = node;
+		if (nlen == p->prefixlen)
+			break;
+
+		if (nlen < 64)
+			node = node->link[(key[0] >> (63 - nlen)) & 1];
+		else
+			node = node->link[(key[1] >> (127 - nlen)) & 1];
+	}
+
+	return (struct route_node *)matched;
+}
+
 /* Find matched prefix. */
 struct route_node *route_node_match(const struct route_table *table,
 				    union prefixconstptr pu)
@@ -202,17 +336,28 @@ struct route_node *route_node_match(const struct route_table *table,
 	matched = NULL;
 	node = table->top;
 
-	/* Walk down tree.  If there is matched route then store it to
-	   matched. */
-	while (node && node->p.prefixlen <= p->prefixlen
-	       && prefix_match(&node->p, p)) {
-		if (node->info)
-			matched = node;
-
-		if (node->p.prefixlen == p->prefixlen)
-			break;
-
-		node = node->link[prefix_bit(&p->u.prefix, node->p.prefixlen)];
+	switch (p->family) {
+	case AF_INET:
+		matched = route_node_match4(node, p);
+		break;
+	case AF_INET6:
+		matched = route_node_match6(node, p);
+		break;
+	default:
+		/* Walk down tree.  If there is matched route then store it
+		   to matched. */
+		while (node && node->p.prefixlen <= p->prefixlen
+		       && prefix_match(&node->p, p)) {
+			if (node->info)
+				matched = node;
+
+			if (node->p.prefixlen == p->prefixlen)
+				break;
+
+			node = node->link[prefix_bit(&p->u.prefix,
+						     node->p.prefixlen)];
+		}
+		break;
 	}
 
 	/* If matched route found, return it. */
@@ -248,6 +393,20 @@ struct route_node *route_node_match_ipv6(const struct route_table *table,
 	return route_node_match(table, (struct prefix *)&p);
 }
 
+/*
+ * Finds the node for a masked prefix in the table's hash.  Lookups pass a
+ * node, so that a hash shared by several tables can tell them apart.
+ */
+static struct route_node *route_node_hash_find(const struct route_table *table,
+					       const struct prefix *p)
+{
+	struct route_node key;
+
+	prefix_copy(&key.p, p);
+	key.table = (struct route_table *)table;
+	return hash_get(table->hash, &key, NULL);
+}
+
 /* Lookup same prefix node.  Return NULL when we can't find route. */
 struct route_node *route_node_lookup(const struct route_table *table,
 				     union prefixconstptr pu)
@@ -257,7 +416,7 @@ struct route_node *route_node_lookup(const struct route_table *table,
 	prefix_copy(&p, pu.p);
 	apply_mask(&p);
 
-	node = hash_get(table->hash, (void *)&p, NULL);
+	node = route_node_hash_find(table, &p);
 	return (node && node->info) ? route_lock_node(node) : NULL;
 }
 
@@ -270,10 +429,37 @@ struct route_node *route_node_lookup_maynull(const struct route_table *table,
 	prefix_copy(&p, pu.p);
 	apply_mask(&p);
 
-	node = hash_get(table->hash, (void *)&p, NULL);
+	node = route_node_hash_find(table, &p);
 	return node ? route_lock_node(node) : NULL;
 }
 
+/*
+ * Lookup the top of the subtree of nodes within a prefix: the node for the
+ * prefix itself or, without one, the shortest node under it.  Unlike
+ * route_node_get(), no node is added.  Return NULL when there is none.
+ */
+struct route_node *route_node_subtree(const struct route_table *table,
+				      union prefixconstptr pu)
+{
+	struct prefix p;
+	struct route_node *node;
+	prefix_copy(&p, pu.p);
+	apply_mask(&p);
+
+	node = route_node_hash_find(table, &p);
+	if (node)
+		return route_lock_node(node);
+
+	node = table->top;
+	while (node && node->p.prefixlen < p.prefixlen
+	       && route_prefix_match(&node->p, &p))
+		node = node->link[prefix_bit(&p.u.prefix, node->p.prefixlen)];
+
+	if (node && route_prefix_match(&p, &node->p))
+		return route_lock_node(node);
+	return NULL;
+}
+
 /* Add node to routing table. */
 struct route_node *route_node_get(struct route_table *const table,
 				  union prefixconstptr pu)
@@ -287,14 +473,14 @@ struct route_node *route_node_get(struct route_table *const table,
 	const uint8_t *prefix = &p->u.prefix;
 
 	apply_mask((struct prefix *)p);
-	node = hash_get(table->hash, (void *)p, NULL);
+	node = route_node_hash_find(table, p);
 	if (node && node->info)
 		return route_lock_node(node);
 
 	match = NULL;
 	node = table->top;
 	while (node && node->p.prefixlen <= prefixlen
-	       && prefix_match(&node->p, p)) {
+	       && route_prefix_match(&node->p, p)) {
 		if (node->p.prefixlen == prefixlen)
 			return route_lock_node(node);
 
@@ -538,7 +724,7 @@ int route_table_prefix_iter_cmp(const struct prefix *p1,
 	struct prefix *common = &common_space;
 
 	if (p1->prefixlen <= p2->prefixlen) {
-		if (prefix_match(p1, p2)) {
+		if (route_prefix_match(p1, p2)) {
 
 			/*
 			 * p1 contains p2, or is equal to it.
@@ -550,7 +736,7 @@ int route_table_prefix_iter_cmp(const struct prefix *p1,
 		/*
 		 * Check if p2 contains p1.
 		 */
-		if (prefix_match(p2, p1))
+		if (route_prefix_match(p2, p1))
 			return 1;
 	}
 
@@ -619,9 +805,9 @@ route_table_get_next_internal(const struct route_table *table,
 		int match;
 
 		if (node->p.prefixlen < p->prefixlen)
-			match = prefix_match(&node->p, p);
+			match = route_prefix_match(&node->p, p);
 		else
-			match = prefix_match(p, &node->p);
+			match = route_prefix_match(p, &node->p);
 
 		if (match) {
 			if (node->p.prefixlen == p->prefixlen) {
@@ -787,3 +973,81 @@ void route_table_iter_cleanup(route_table_iter_t *iter)
 	 */
 	iter->state = RT_ITER_STATE_DONE;
 }
+
+struct route_table_walk {
+	struct thread_master *master;
+	struct thread *t_walk;
+	route_table_iter_t iter;
+
+	route_table_walk_func_t func;
+	void (*done)(void *arg);
+	void *arg;
+
+	struct route_table_walk **ref;
+};
+
+static void route_table_walk_free(struct route_table_walk *walk)
+{
+	route_table_iter_cleanup(&walk->iter);
+	*walk->ref = NULL;
+	XFREE(MTYPE_ROUTE_TABLE_WALK, walk);
+}
+
+static int route_table_walk_run(struct thread *thread)
+{
+	struct route_table_walk *walk = THREAD_ARG(thread);
+	void (*done)(void *arg) = walk->done;
+	void *arg = walk->arg;
+	struct route_node *rn;
+
+	while ((rn = route_table_iter_next(&walk->iter))) {
+		if (walk->func(rn, arg))
+			break;
+
+		if (thread_should_yield(thread)) {
+			route_table_iter_pause(&walk->iter);
+			thread_add_event(walk->master, route_table_walk_run,
+					 walk, 0, &walk->t_walk);
+			return 0;
+		}
+	}
+
+	route_table_walk_free(walk);
+	if (done)
+		done(arg);
+	return 0;
+}
+
+void route_table_walk_start(struct thread_master *master,
+			    struct route_table *table,
+			    route_table_walk_func_t func,
+			    void (*done)(void *arg), void *arg,
+			    struct route_table_walk **ref)
+{
+	struct route_table_walk *walk;
+
+	assert(!*ref);
+
+	walk = XCALLOC(MTYPE_ROUTE_TABLE_WALK, sizeof(*walk));
+	walk->master = master;
+	route_table_iter_init(&walk->iter, table);
+	walk->func = func;
+	walk->done = done;
+	walk->arg = arg;
+	walk->ref = ref;
+	*ref = walk;
+
+	thread_add_event(master, route_table_walk_run, walk, 0,
+			 &walk->t_walk);
+}
+
+void route_table_walk_cancel(struct route_table_walk **ref)
+{
+	struct route_table_walk *walk = *ref;
+
+	if (!walk)
+		return;
+
+	THREAD_OFF(walk->t_walk);
+	route_table_walk_free(walk);
+}
@@ -64,6 +64,9 @@ struct route_table {
 	route_table_delegate_t *delegate;
 	void (*cleanup)(struct route_table *, struct route_node *);
 
+	/* hash belongs to the table this one is a subtable of */
+	bool hash_shared;
+
 	unsigned long count;
 
 	/*
@@ -179,6 +182,24 @@ extern struct route_table *route_table_init(void);
 extern struct route_table *
 route_table_init_with_delegate(route_table_delegate_t *);
 
+/*
+ * Tables indexing nodes by more than their prefix, e.g. source/destination
+ * tables, supply the functions of the exact-match hash themselves.  Both
+ * are called on nodes; on a lookup key, only ->p and ->table are set.
+ *
+ * A subtable indexes its nodes in its parent's hash instead of one of its
+ * own, which spares it the allocation and makes its nodes reachable by a
+ * lookup in the parent's hash.  The hash functions must tell the tables
+ * apart, and the parent must outlive its subtables.
+ */
+extern struct route_table *
+route_table_init_with_hash(route_table_delegate_t *delegate,
+			   unsigned int (*hash_key)(void *),
+			   int (*hash_cmp)(const void *, const void *));
+extern struct route_table *
+route_table_init_subtable(route_table_delegate_t *delegate,
+			  struct route_table *parent);
+
 extern route_table_delegate_t *route_table_get_default_delegate(void);
 
 extern void route_table_finish(struct route_table *);
@@ -192,6 +213,8 @@ extern struct route_node *route_node_lookup(const struct route_table *,
 					    union prefixconstptr);
 extern struct route_node *route_node_lookup_maynull(const struct route_table *,
 						    union prefixconstptr);
+extern struct route_node *route_node_subtree(const struct route_table *,
+					     union prefixconstptr);
 extern struct route_node *route_node_match(const struct route_table *,
 					   union prefixconstptr);
 extern struct route_node *route_node_match_ipv4(const struct route_table *,
@@ -220,6 +243,31 @@ extern void route_table_iter_init(route_table_iter_t *iter,
 extern void route_table_iter_pause(route_table_iter_t *iter);
 extern void route_table_iter_cleanup(route_table_iter_t *iter);
 
+/*
+ * Resumable walks.
+ *
+ * A walk calls func on every node of a table from events of its own,
+ * pausing whenever an event has run for long (see thread_should_yield())
+ * and resuming where it left off in the next one.  The table may change in
+ * between, as with route_table_iter_pause().
+ *
+ * func returns nonzero to end the walk early.  Once the walk has ended,
+ * *ref is cleared and done is called, so done may start another walk on
+ * the same ref.  A cancelled walk does not call done; a walk must not be
+ * cancelled from its own func.  The table must outlive the walk.
+ */
+struct route_table_walk;
+struct thread_master;
+
+typedef int (*route_table_walk_func_t)(struct route_node *, void *arg);
+
+extern void route_table_walk_start(struct thread_master *master,
+				   struct route_table *table,
+				   route_table_walk_func_t func,
+				   void (*done)(void *arg), void *arg,
+				   struct route_table_walk **ref);
+extern void route_table_walk_cancel(struct route_table_walk **ref);
+
 /*
  * Inline functions.
  */
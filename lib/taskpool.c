@@ -0,0 +1,585 @@
+/*
+ * Work-stealing pools of pthreads running short tasks.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <pthread.h>
+#ifdef GNU_LINUX
+#include <sched.h>
+#endif
+
+#include "taskpool.h"
+#include "frr_pthread.h"
+#include "epoch.h"
+#include "memory.h"
+#include "command.h"
+
+DEFINE_MTYPE_STATIC(LIB, TASKPOOL, "Task pool")
+DEFINE_MTYPE_STATIC(LIB, TASKPOOL_WORKER, "Task pool worker")
+DEFINE_MTYPE_STATIC(LIB, TASKPOOL_DEQUE, "Task pool deque")
+
+struct taskpool_task {
+	void (*func)(void *arg);
+	void *arg;
+	struct taskgroup *group;
+};
+
+struct taskpool_worker {
+	struct taskpool *pool;
+	struct frr_pthread *fpt;
+	unsigned int index;
+
+	/* ring of tasks, the oldest at head; Requires: mtx */
+	pthread_mutex_t mtx;
+	struct taskpool_task *ring;
+	unsigned int size, head, count;
+
+	_Atomic uint64_t runs;
+	_Atomic uint64_t steals;
+};
+
+struct taskpool {
+	/* on taskpools, Requires: taskpools_mtx */
+	struct taskpool *next;
+	char *name;
+
+	/* only changed while the pool is created */
+	struct taskpool_worker *workers[TASKPOOL_WORKERS_MAX];
+	unsigned int nworkers;
+	/* the worker the calling pthread is, if any */
+	pthread_key_t self;
+
+	/* tasks on the deques */
+	_Atomic unsigned int queued;
+	/* where the next task from outside the pool goes */
+	_Atomic unsigned int next_worker;
+	/* tasks run by pthreads waiting on a group */
+	_Atomic uint64_t helped;
+
+	/* workers sleep on cond while there is nothing to take */
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	_Atomic unsigned int idle;
+
+	/* Requires: mtx */
+	char *cpus;
+#ifdef GNU_LINUX
+	cpu_set_t cpuset;
+	/* CPUs the creating pthread could run on */
+	cpu_set_t cpuset_any;
+#endif
+};
+
+static pthread_mutex_t taskpools_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct taskpool *taskpools;
+
+/* Pushes a task on the worker's deque, the newest end. */
+static void taskpool_push(struct taskpool_worker *w,
+			  const struct taskpool_task *task)
+{
+	struct taskpool *pool = w->pool;
+	struct taskpool_task *ring;
+	unsigned int i;
+
+	pthread_mutex_lock(&w->mtx);
+	{
+		if (w->count == w->size) {
+			ring = XMALLOC(MTYPE_TASKPOOL_DEQUE,
+				       MAX(2 * w->size, 16U) * sizeof(*ring));
+			for (i = 0; i < w->count; i++)
+				ring[i] = w->ring[(w->head + i) % w->size];
+			if (w->ring)
+				XFREE(MTYPE_TASKPOOL_DEQUE, w->ring);
+			w->ring = ring;
+			w->size = MAX(2 * w->size, 16U);
+			w->head = 0;
+		}
+		w->ring[(w->head + w->count++) % w->size] = *task;
+
+		/* before a thief can take it, so that queued never wraps */
+		atomic_fetch_add_explicit(&pool->queued, 1,
+					  memory_order_seq_cst);
+	}
+	pthread_mutex_unlock(&w->mtx);
+
+	/* pairs with the idle count and queued check in taskpool_sleep() */
+	if (atomic_load_explicit(&pool->idle, memory_order_seq_cst)) {
+		pthread_mutex_lock(&pool->mtx);
+		pthread_cond_signal(&pool->cond);
+		pthread_mutex_unlock(&pool->mtx);
+	}
+}
+
+/* Pops a task off the worker's deque, the newest if own, else the oldest. */
+static bool taskpool_pop(struct taskpool_worker *w, bool own,
+			 struct taskpool_task *task)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&w->mtx);
+	{
+		if (w->count) {
+			if (own) {
+				*task = w->ring[(w->head + w->count - 1)
+						% w->size];
+			} else {
+				*task = w->ring[w->head];
+				w->head = (w->head + 1) % w->size;
+			}
+			w->count--;
+			atomic_fetch_sub_explicit(&w->pool->queued, 1,
+						  memory_order_seq_cst);
+			found = true;
+		}
+	}
+	pthread_mutex_unlock(&w->mtx);
+
+	return found;
+}
+
+/*
+ * Takes the next task to run for a worker, or for a pthread outside the
+ * pool if self is NULL: from its own deque first, then stealing.
+ */
+static bool taskpool_take(struct taskpool *pool, struct taskpool_worker *self,
+			  struct taskpool_task *task)
+{
+	unsigned int i, start;
+
+	if (self && taskpool_pop(self, true, task))
+		return true;
+
+	if (!atomic_load_explicit(&pool->queued, memory_order_seq_cst))
+		return false;
+
+	start = self ? self->index + 1
+		     : atomic_load_explicit(&pool->next_worker,
+					    memory_order_relaxed);
+	for (i = 0; i < pool->nworkers; i++) {
+		struct taskpool_worker *victim =
+			pool->workers[(start + i) % pool->nworkers];
+
+		if (victim == self || !taskpool_pop(victim, false, task))
+			continue;
+		if (self)
+			atomic_fetch_add_explicit(&self->steals, 1,
+						  memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+static void taskgroup_done(struct taskgroup *group)
+{
+	struct thread_master *master = NULL;
+	int (*func)(struct thread *) = NULL;
+	void *arg = NULL;
+
+	pthread_mutex_lock(&group->mtx);
+	{
+		if (atomic_fetch_sub_explicit(&group->pending, 1,
+					      memory_order_seq_cst)
+		    == 1) {
+			pthread_cond_broadcast(&group->cond);
+			master = group->notify_master;
+			func = group->notify_func;
+			arg = group->notify_arg;
+			group->notify_master = NULL;
+		}
+	}
+	pthread_mutex_unlock(&group->mtx);
+
+	/* the group may be gone as soon as it was unlocked */
+	if (master)
+		thread_post_event(master, func, arg, 0);
+}
+
+static void taskpool_run(const struct taskpool_task *task)
+{
+	task->func(task->arg);
+	taskgroup_done(task->group);
+}
+
+/*
+ * Pins the worker according to the pool's CPU list.  That list wins over a
+ * "thread affinity" for the worker's name, which only applies while the
+ * pool has none.
+ */
+static void taskpool_worker_pin(struct taskpool_worker *w)
+{
+#ifdef GNU_LINUX
+	struct taskpool *pool = w->pool;
+	pthread_t thread = w->fpt->thread;
+	unsigned int i, n = 0;
+	bool own;
+	cpu_set_t set;
+	int cpu;
+
+	pthread_mutex_lock(&pool->mtx);
+	{
+		own = pool->cpus != NULL;
+		if (own) {
+			CPU_ZERO(&set);
+			i = w->index % CPU_COUNT(&pool->cpuset);
+			for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+				if (CPU_ISSET(cpu, &pool->cpuset) && n++ == i)
+					break;
+			CPU_SET(cpu, &set);
+		} else
+			set = pool->cpuset_any;
+	}
+	pthread_mutex_unlock(&pool->mtx);
+
+	thread_affinity_own(w->fpt->master, own);
+	if (own || !thread_affinity_apply(w->fpt->name, thread))
+		pthread_setaffinity_np(thread, sizeof(set), &set);
+#endif
+}
+
+static void taskpool_sleep(struct taskpool *pool, struct frr_pthread *fpt)
+{
+	pthread_mutex_lock(&pool->mtx);
+	{
+		atomic_fetch_add_explicit(&pool->idle, 1, memory_order_seq_cst);
+		if (!atomic_load_explicit(&pool->queued, memory_order_seq_cst)
+		    && atomic_load_explicit(&fpt->running,
+					    memory_order_relaxed))
+			pthread_cond_wait(&pool->cond, &pool->mtx);
+		atomic_fetch_sub_explicit(&pool->idle, 1, memory_order_seq_cst);
+	}
+	pthread_mutex_unlock(&pool->mtx);
+}
+
+static void *taskpool_worker_run(void *arg)
+{
+	struct frr_pthread *fpt = arg;
+	struct taskpool_worker *w = fpt->data;
+	struct taskpool *pool = w->pool;
+	struct taskpool_task task;
+
+	pthread_setspecific(pool->self, w);
+	epoch_thread_register();
+	frr_pthread_notify_running(fpt);
+
+	while (atomic_load_explicit(&fpt->running, memory_order_relaxed)) {
+		if (taskpool_take(pool, w, &task)) {
+			taskpool_run(&task);
+			atomic_fetch_add_explicit(&w->runs, 1,
+						  memory_order_relaxed);
+		} else
+			taskpool_sleep(pool, fpt);
+	}
+
+	epoch_thread_unregister();
+	return NULL;
+}
+
+static int taskpool_worker_stop(struct frr_pthread *fpt, void **result)
+{
+	struct taskpool_worker *w = fpt->data;
+	struct taskpool *pool = w->pool;
+
+	/* frr_pthread_stop_all() may have stopped it already */
+	if (!atomic_exchange_explicit(&fpt->running, false,
+				      memory_order_seq_cst))
+		return 0;
+
+	pthread_mutex_lock(&pool->mtx);
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mtx);
+
+	pthread_join(fpt->thread, result);
+	return 0;
+}
+
+static void taskpool_worker_free(struct taskpool_worker *w)
+{
+	if (w->fpt)
+		frr_pthread_destroy(w->fpt);
+	if (w->ring)
+		XFREE(MTYPE_TASKPOOL_DEQUE, w->ring);
+	pthread_mutex_destroy(&w->mtx);
+	XFREE(MTYPE_TASKPOOL_WORKER, w);
+}
+
+static bool taskpool_worker_start(struct taskpool *pool)
+{
+	struct frr_pthread_attr attr = {
+		.start = taskpool_worker_run,
+		.stop = taskpool_worker_stop,
+	};
+	struct taskpool_worker *w;
+	char name[64];
+	unsigned int tries;
+
+	w = XCALLOC(MTYPE_TASKPOOL_WORKER, sizeof(*w));
+	w->pool = pool;
+	w->index = pool->nworkers;
+	pthread_mutex_init(&w->mtx, NULL);
+
+	snprintf(name, sizeof(name), "%s %u", pool->name, w->index);
+
+	/* ids handed out may clash with the fixed ones of the daemon */
+	for (tries = 0; !w->fpt && tries < 64; tries++) {
+		attr.id = frr_pthread_get_id();
+		w->fpt = frr_pthread_new(&attr, name);
+	}
+	if (!w->fpt) {
+		taskpool_worker_free(w);
+		return false;
+	}
+
+	w->fpt->data = w;
+	if (frr_pthread_run(w->fpt, NULL) < 0) {
+		taskpool_worker_free(w);
+		return false;
+	}
+	frr_pthread_wait_running(w->fpt);
+	/* after frr_pthread_run(), so its "thread affinity" is overridden */
+	taskpool_worker_pin(w);
+
+	pool->workers[pool->nworkers++] = w;
+	return true;
+}
+
+struct taskpool *taskpool_new(const char *name, unsigned int workers)
+{
+	struct taskpool *pool;
+
+	assert(workers > 0 && workers <= TASKPOOL_WORKERS_MAX);
+
+	pool = XCALLOC(MTYPE_TASKPOOL, sizeof(*pool));
+	pool->name = XSTRDUP(MTYPE_TASKPOOL, name);
+	pthread_key_create(&pool->self, NULL);
+	pthread_mutex_init(&pool->mtx, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+#ifdef GNU_LINUX
+	if (pthread_getaffinity_np(pthread_self(), sizeof(pool->cpuset_any),
+				   &pool->cpuset_any))
+		CPU_ZERO(&pool->cpuset_any);
+#endif
+
+	while (pool->nworkers < workers && taskpool_worker_start(pool))
+		;
+	if (!pool->nworkers) {
+		taskpool_del(pool);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&taskpools_mtx);
+	{
+		pool->next = taskpools;
+		taskpools = pool;
+	}
+	pthread_mutex_unlock(&taskpools_mtx);
+
+	return pool;
+}
+
+void taskpool_del(struct taskpool *pool)
+{
+	struct taskpool **prev;
+	unsigned int i;
+
+	assert(!atomic_load_explicit(&pool->queued, memory_order_seq_cst));
+
+	pthread_mutex_lock(&taskpools_mtx);
+	{
+		for (prev = &taskpools; *prev; prev = &(*prev)->next)
+			if (*prev == pool) {
+				*prev = pool->next;
+				break;
+			}
+	}
+	pthread_mutex_unlock(&taskpools_mtx);
+
+	for (i = 0; i < pool->nworkers; i++)
+		frr_pthread_stop(pool->workers[i]->fpt, NULL);
+	for (i = 0; i < pool->nworkers; i++)
+		taskpool_worker_free(pool->workers[i]);
+
+	if (pool->cpus)
+		XFREE(MTYPE_TASKPOOL, pool->cpus);
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mtx);
+	pthread_key_delete(pool->self);
+	XFREE(MTYPE_TASKPOOL, pool->name);
+	XFREE(MTYPE_TASKPOOL, pool);
+}
+
+unsigned int taskpool_workers(struct taskpool *pool)
+{
+	return pool->nworkers;
+}
+
+int taskpool_set_affinity(struct taskpool *pool, const char *cpus)
+{
+#ifdef GNU_LINUX
+	cpu_set_t set;
+	unsigned int i;
+
+	if (cpus && cpulist_parse(cpus, &set))
+		return -1;
+
+	pthread_mutex_lock(&pool->mtx);
+	{
+		if (pool->cpus)
+			XFREE(MTYPE_TASKPOOL, pool->cpus);
+		if (cpus) {
+			pool->cpus = XSTRDUP(MTYPE_TASKPOOL, cpus);
+			pool->cpuset = set;
+		}
+	}
+	pthread_mutex_unlock(&pool->mtx);
+
+	for (i = 0; i < pool->nworkers; i++)
+		taskpool_worker_pin(pool->workers[i]);
+	return 0;
+#else
+	return cpus ? -1 : 0;
+#endif
+}
+
+void taskgroup_init(struct taskgroup *group, struct taskpool *pool)
+{
+	memset(group, 0, sizeof(*group));
+	group->pool = pool;
+	pthread_mutex_init(&group->mtx, NULL);
+	pthread_cond_init(&group->cond, NULL);
+}
+
+void taskgroup_fini(struct taskgroup *group)
+{
+	assert(!atomic_load_explicit(&group->pending, memory_order_seq_cst));
+
+	pthread_cond_destroy(&group->cond);
+	pthread_mutex_destroy(&group->mtx);
+}
+
+void taskgroup_add(struct taskgroup *group, void (*func)(void *arg),
+		   void *arg)
+{
+	struct taskpool *pool = group->pool;
+	struct taskpool_task task = {
+		.func = func,
+		.arg = arg,
+		.group = group,
+	};
+	struct taskpool_worker *w = pthread_getspecific(pool->self);
+
+	atomic_fetch_add_explicit(&group->pending, 1, memory_order_seq_cst);
+
+	if (!w)
+		w = pool->workers[atomic_fetch_add_explicit(
+					  &pool->next_worker, 1,
+					  memory_order_relaxed)
+				  % pool->nworkers];
+	taskpool_push(w, &task);
+}
+
+void taskgroup_wait(struct taskgroup *group)
+{
+	struct taskpool *pool = group->pool;
+	struct taskpool_task task;
+
+	while (atomic_load_explicit(&group->pending, memory_order_seq_cst)) {
+		if (taskpool_take(pool, NULL, &task)) {
+			taskpool_run(&task);
+			atomic_fetch_add_explicit(&pool->helped, 1,
+						  memory_order_relaxed);
+			continue;
+		}
+
+		/* what is left is running on workers */
+		break;
+	}
+
+	/* also waits for the last taskgroup_done() to let go of the group */
+	pthread_mutex_lock(&group->mtx);
+	{
+		while (atomic_load_explicit(&group->pending,
+					    memory_order_seq_cst))
+			pthread_cond_wait(&group->cond, &group->mtx);
+	}
+	pthread_mutex_unlock(&group->mtx);
+}
+
+void taskgroup_notify(struct taskgroup *group, struct thread_master *master,
+		      int (*func)(struct thread *), void *arg)
+{
+	bool now;
+
+	pthread_mutex_lock(&group->mtx);
+	{
+		now = !atomic_load_explicit(&group->pending,
+					    memory_order_seq_cst);
+		group->notify_master = now ? NULL : master;
+		group->notify_func = func;
+		group->notify_arg = arg;
+	}
+	pthread_mutex_unlock(&group->mtx);
+
+	if (now)
+		thread_post_event(master, func, arg, 0);
+}
+
+DEFUN (show_task_pools,
+       show_task_pools_cmd,
+       "show task-pools",
+       SHOW_STR
+       "Work-stealing pthread pools\n")
+{
+	struct taskpool *pool;
+	struct taskpool_worker *w;
+	unsigned int i, count;
+
+	pthread_mutex_lock(&taskpools_mtx);
+	for (pool = taskpools; pool; pool = pool->next) {
+		pthread_mutex_lock(&pool->mtx);
+		vty_out(vty, "%s: %u workers, CPUs %s, %u queued, %" PRIu64
+			     " run by waiters\n",
+			pool->name, pool->nworkers,
+			pool->cpus ? pool->cpus : "any",
+			atomic_load_explicit(&pool->queued,
+					     memory_order_relaxed),
+			(uint64_t)atomic_load_explicit(&pool->helped,
+						       memory_order_relaxed));
+		pthread_mutex_unlock(&pool->mtx);
+
+		vty_out(vty, "  %6s %8s %12s %12s\n", "Worker", "Queued",
+			"Run", "Stolen");
+		for (i = 0; i < pool->nworkers; i++) {
+			w = pool->workers[i];
+			pthread_mutex_lock(&w->mtx);
+			count = w->count;
+			pthread_mutex_unlock(&w->mtx);
+			vty_out(vty, "  %6u %8u %12" PRIu64 " %12" PRIu64 "\n",
+				i, count,
+				(uint64_t)atomic_load_explicit(
+					&w->runs, memory_order_relaxed),
+				(uint64_t)atomic_load_explicit(
+					&w->steals, memory_order_relaxed));
+		}
+	}
+	pthread_mutex_unlock(&taskpools_mtx);
+
+	return CMD_SUCCESS;
+}
+
+void taskpool_cmd_init(void)
+{
+	install_element(VIEW_NODE, &show_task_pools_cmd);
+}
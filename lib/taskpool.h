@@ -0,0 +1,134 @@
+/*
+ * Work-stealing pools of pthreads running short tasks.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef _FRR_TASKPOOL_H_
+#define _FRR_TASKPOOL_H_
+
+#include <pthread.h>
+#include "frratomic.h"
+#include "thread.h"
+
+/*
+ * A taskpool runs function calls, tasks, on a set of frr_pthreads.  Each
+ * worker has a deque of its own: tasks added by a worker go on its own
+ * deque, which it works through newest first, while tasks added from outside
+ * the pool are spread over the workers.  A worker whose deque is empty
+ * steals the oldest task of another one, so that a few long tasks do not
+ * leave the other workers idle.
+ *
+ * Tasks are added to a taskgroup, which tells when all of them have run:
+ * taskgroup_wait() blocks, running tasks of the pool itself meanwhile, and
+ * taskgroup_notify() schedules an event on a thread_master instead, e.g. the
+ * main one.  Tasks may add further tasks to their own group.
+ *
+ * usage:
+ *
+ *    struct taskgroup group;
+ *
+ *    taskgroup_init(&group, pool);
+ *    for (i = 0; i < n; i++)
+ *        taskgroup_add(&group, encode_one, &items[i]);
+ *    taskgroup_wait(&group);
+ *    taskgroup_fini(&group);
+ */
+struct taskpool;
+
+struct taskgroup {
+	struct taskpool *pool;
+
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	/* tasks added and not run yet; decremented under mtx */
+	_Atomic unsigned int pending;
+
+	/* Requires: mtx */
+	struct thread_master *notify_master;
+	int (*notify_func)(struct thread *);
+	void *notify_arg;
+};
+
+/* Most workers a pool may have. */
+#define TASKPOOL_WORKERS_MAX 64
+
+/*
+ * Creates a pool and starts its workers.
+ *
+ * As with any pthread, pools should only be created once the daemon has
+ * forked into the background.
+ *
+ * @param name		name of the pool and its pthreads
+ * @param workers	number of worker pthreads, at least 1
+ * @return the new pool, or NULL if no worker could be started
+ */
+extern struct taskpool *taskpool_new(const char *name, unsigned int workers);
+
+/*
+ * Stops the workers of a pool and frees it; no group of the pool may have
+ * tasks left.
+ */
+extern void taskpool_del(struct taskpool *pool);
+
+/* Number of workers the pool runs. */
+extern unsigned int taskpool_workers(struct taskpool *pool);
+
+/*
+ * Pins the workers to CPUs, round-robin over a list like "0-3,8"; NULL
+ * lets them run anywhere again.  While the pool has a list, it overrides
+ * "thread affinity" settings for the names of its workers; without one
+ * those apply as for any other pthread.
+ *
+ * @return 0 on success, -1 if the list cannot be parsed or the platform
+ *	   cannot pin pthreads
+ */
+extern int taskpool_set_affinity(struct taskpool *pool, const char *cpus);
+
+/* Initializes an empty group of tasks on the pool. */
+extern void taskgroup_init(struct taskgroup *group, struct taskpool *pool);
+
+/* Frees what taskgroup_init() set up; the group must have no tasks left. */
+extern void taskgroup_fini(struct taskgroup *group);
+
+/*
+ * Adds a task to the group; may be called from any pthread, including the
+ * group's own tasks.
+ *
+ * @param group	the group, counting the task until it ran
+ * @param func	the task
+ * @param arg	its argument
+ */
+extern void taskgroup_add(struct taskgroup *group, void (*func)(void *arg),
+			  void *arg);
+
+/*
+ * Waits for all tasks of the group to have run, running tasks of the pool
+ * on the calling pthread until none is left to take.  Not to be called from
+ * a task: with every worker waiting, the tasks left would never run.
+ */
+extern void taskgroup_wait(struct taskgroup *group);
+
+/*
+ * Schedules an event on master once all tasks of the group have run, or
+ * right away if there are none; the group may be finished from the event.
+ * Replaces an earlier notification that did not fire yet.
+ */
+extern void taskgroup_notify(struct taskgroup *group,
+			     struct thread_master *master,
+			     int (*func)(struct thread *), void *arg);
+
+extern void taskpool_cmd_init(void);
+
+#endif /* _FRR_TASKPOOL_H_ */
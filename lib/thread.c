@@ -32,20 +32,26 @@
 #include "sigevent.h"
 #include "network.h"
 #include "jhash.h"
+#include "json.h"
 
 DEFINE_MTYPE_STATIC(LIB, THREAD, "Thread")
 DEFINE_MTYPE_STATIC(LIB, THREAD_MASTER, "Thread master")
 DEFINE_MTYPE_STATIC(LIB, THREAD_STATS, "Thread stats")
+DEFINE_MTYPE_STATIC(LIB, THREAD_POST, "Thread posted event")
+DEFINE_MTYPE_STATIC(LIB, THREAD_AFFINITY, "Thread CPU affinity")
 
 #if defined(__APPLE__)
 #include <mach/mach.h>
 #include <mach/mach_time.h>
 #endif
 
+/* Poke the owning pthread out of poll(); pointless if we are the owner,
+ * since it is then evidently not sleeping. */
 #define AWAKEN(m)                                                              \
 	do {                                                                   \
 		static unsigned char wakebyte = 0x01;                          \
-		write(m->io_pipe[1], &wakebyte, 1);                            \
+		if (!pthread_equal(m->owner, pthread_self()))                  \
+			write(m->io_pipe[1], &wakebyte, 1);                    \
 	} while (0);
 
 /* control variable for initializer */
@@ -55,6 +61,22 @@ pthread_key_t thread_current;
 pthread_mutex_t masters_mtx = PTHREAD_MUTEX_INITIALIZER;
 static struct list *masters;
 
+/* runtime in microseconds from which tasks are traced, 0 for none */
+static _Atomic unsigned long thread_slow_threshold;
+
+/* usecs a class may run per pass of the event loop, 0 for no limit */
+static _Atomic unsigned long thread_class_budget[THREAD_CLASSES] = {
+	[THREAD_CLASS_BULK] = THREAD_YIELD_TIME_SLOT,
+	[THREAD_CLASS_MGMT] = THREAD_YIELD_TIME_SLOT,
+};
+
+static const char *const thread_class_names[THREAD_CLASSES] = {
+	[THREAD_CLASS_CRITICAL] = "critical",
+	[THREAD_CLASS_NORMAL] = "normal",
+	[THREAD_CLASS_BULK] = "bulk",
+	[THREAD_CLASS_MGMT] = "management",
+};
+
 
 /* CLI start ---------------------------------------------------------------- */
 static unsigned int cpu_record_hash_key(struct cpu_thread_history *a)
@@ -76,6 +98,7 @@ static void *cpu_record_hash_alloc(struct cpu_thread_history *a)
 	new = XCALLOC(MTYPE_THREAD_STATS, sizeof(struct cpu_thread_history));
 	new->func = a->func;
 	new->funcname = a->funcname;
+	new->sclass = THREAD_CLASS_NORMAL;
 	return new;
 }
 
@@ -191,6 +214,17 @@ static void cpu_record_hash_clear(struct hash_backet *bucket, void *args[])
 	if (!(a->types & *filter))
 		return;
 
+	/* a record carrying a class stays, only its figures go */
+	if (a->sclass != THREAD_CLASS_NORMAL) {
+		a->total_calls = 0;
+		memset(&a->real, 0, sizeof(a->real));
+		memset(&a->cpu, 0, sizeof(a->cpu));
+		a->types = 0;
+		memset(a->real_hist, 0, sizeof(a->real_hist));
+		memset(a->delay_hist, 0, sizeof(a->delay_hist));
+		return;
+	}
+
 	hash_release(cpu_record, bucket->data);
 }
 
@@ -305,10 +339,557 @@ DEFUN (clear_thread_cpu,
 	return CMD_SUCCESS;
 }
 
+static json_object *cpu_hist_json(unsigned int *hist)
+{
+	json_object *json = json_object_new_array();
+	int i;
+
+	for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+		json_object_array_add(json, json_object_new_int64(hist[i]));
+	return json;
+}
+
+static void vty_out_cpu_hist(struct vty *vty, const char *what,
+			     unsigned int *hist)
+{
+	int i;
+
+	vty_out(vty, "    %-8s", what);
+	for (i = 0; i < THREAD_HIST_BUCKETS - 1; i++)
+		if (hist[i])
+			vty_out(vty, " <%lu:%u", 1UL << i, hist[i]);
+	if (hist[i])
+		vty_out(vty, " >=%lu:%u", 1UL << (i - 1), hist[i]);
+	vty_out(vty, "\n");
+}
+
+static void cpu_record_hash_print_hist(struct hash_backet *bucket,
+				       void *args[])
+{
+	struct vty *vty = args[0];
+	json_object *json = args[1];
+	struct cpu_thread_history *a = bucket->data;
+	json_object *jfunc;
+
+	if (!a->total_calls)
+		return;
+
+	if (json) {
+		jfunc = json_object_new_object();
+		json_object_int_add(jfunc, "invoked", a->total_calls);
+		json_object_object_add(jfunc, "runtime",
+				       cpu_hist_json(a->real_hist));
+		json_object_object_add(jfunc, "delay",
+				       cpu_hist_json(a->delay_hist));
+		json_object_object_add(json, a->funcname, jfunc);
+		return;
+	}
+
+	vty_out(vty, "  %s\n", a->funcname);
+	vty_out_cpu_hist(vty, "runtime", a->real_hist);
+	vty_out_cpu_hist(vty, "delay", a->delay_hist);
+}
+
+DEFUN (show_thread_cpu_histogram,
+       show_thread_cpu_histogram_cmd,
+       "show thread cpu histogram [json]",
+       SHOW_STR
+       "Thread information\n"
+       "Thread CPU usage\n"
+       "Wall-clock runtime and scheduling delay histograms\n"
+       JSON_STR)
+{
+	bool uj = use_json(argc, argv);
+	json_object *json = NULL, *jbounds, *jmaster;
+	struct thread_master *m;
+	struct listnode *ln;
+	void *args[2] = {vty, NULL};
+	int i;
+
+	if (uj) {
+		json = json_object_new_object();
+		jbounds = json_object_new_array();
+		for (i = 0; i < THREAD_HIST_BUCKETS; i++)
+			json_object_array_add(jbounds,
+					      json_object_new_int64(1LL << i));
+		json_object_object_add(json, "bucketsBelowUsec", jbounds);
+	} else
+		vty_out(vty,
+			"Number of calls per bucket, bucket bounds in usecs\n");
+
+	pthread_mutex_lock(&masters_mtx);
+	{
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m)) {
+			const char *name = m->name ? m->name : "main";
+
+			if (uj) {
+				jmaster = json_object_new_object();
+				json_object_object_add(json, name, jmaster);
+				args[1] = jmaster;
+			} else
+				vty_out(vty, "\nShowing histograms for pthread %s\n",
+					name);
+
+			hash_iterate(m->cpu_record,
+				     (void (*)(struct hash_backet *,
+					       void *))cpu_record_hash_print_hist,
+				     args);
+		}
+	}
+	pthread_mutex_unlock(&masters_mtx);
+
+	if (uj) {
+		vty_out(vty, "%s\n", json_object_to_json_string_ext(
+					     json, JSON_C_TO_STRING_PRETTY));
+		json_object_free(json);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (thread_slow_trace,
+       thread_slow_trace_cmd,
+       "thread slow-trace (1-60000000)",
+       "Thread information\n"
+       "Record the last tasks that ran at least this long\n"
+       "Wall-clock runtime in microseconds\n")
+{
+	atomic_store_explicit(&thread_slow_threshold,
+			      strtoul(argv[2]->arg, NULL, 10),
+			      memory_order_relaxed);
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_thread_slow_trace,
+       no_thread_slow_trace_cmd,
+       "no thread slow-trace [(1-60000000)]",
+       NO_STR
+       "Thread information\n"
+       "Record the last tasks that ran at least this long\n"
+       "Wall-clock runtime in microseconds\n")
+{
+	atomic_store_explicit(&thread_slow_threshold, 0, memory_order_relaxed);
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_thread_slow_trace,
+       show_thread_slow_trace_cmd,
+       "show thread slow-trace [json]",
+       SHOW_STR
+       "Thread information\n"
+       "Last tasks that ran at least as long as configured\n"
+       JSON_STR)
+{
+	bool uj = use_json(argc, argv);
+	json_object *json = NULL, *jmaster = NULL, *jtask;
+	struct timeval mono_now, wall_now, ago, wall;
+	struct thread_slow *s;
+	struct thread_master *m;
+	struct listnode *ln;
+	char timebuf[64];
+	struct tm tm;
+	unsigned int i;
+
+	monotime(&mono_now);
+	gettimeofday(&wall_now, NULL);
+
+	if (uj)
+		json = json_object_new_object();
+	else
+		vty_out(vty, "Tracing tasks running for %lu usecs or more\n",
+			atomic_load_explicit(&thread_slow_threshold,
+					     memory_order_relaxed));
+
+	pthread_mutex_lock(&masters_mtx);
+	{
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m)) {
+			const char *name = m->name ? m->name : "main";
+
+			if (uj) {
+				jmaster = json_object_new_array();
+				json_object_object_add(json, name, jmaster);
+			} else {
+				vty_out(vty, "\nSlow tasks of pthread %s\n",
+					name);
+				vty_out(vty, "%-23s %11s %9s  Thread\n",
+					"Started", "Real uSecs", "CPU uSecs");
+			}
+
+			/* oldest first */
+			for (i = 0; i < THREAD_SLOW_TRACE; i++) {
+				s = &m->slow[(m->slow_next + i)
+					     % THREAD_SLOW_TRACE];
+				if (!s->funcname)
+					continue;
+
+				timersub(&mono_now, &s->start, &ago);
+				timersub(&wall_now, &ago, &wall);
+				localtime_r(&wall.tv_sec, &tm);
+				strftime(timebuf, sizeof(timebuf),
+					 "%Y/%m/%d %H:%M:%S", &tm);
+				snprintf(timebuf + strlen(timebuf),
+					 sizeof(timebuf) - strlen(timebuf),
+					 ".%03ld", (long)wall.tv_usec / 1000);
+
+				if (!uj) {
+					vty_out(vty, "%-23s %11lu %9lu  %s\n",
+						timebuf, s->real, s->cpu,
+						s->funcname);
+					continue;
+				}
+				jtask = json_object_new_object();
+				json_object_string_add(jtask, "started",
+						       timebuf);
+				json_object_int_add(jtask, "realUsecs",
+						    s->real);
+				json_object_int_add(jtask, "cpuUsecs", s->cpu);
+				json_object_string_add(jtask, "thread",
+						       s->funcname);
+				json_object_array_add(jmaster, jtask);
+			}
+		}
+	}
+	pthread_mutex_unlock(&masters_mtx);
+
+	if (uj) {
+		vty_out(vty, "%s\n", json_object_to_json_string_ext(
+					     json, JSON_C_TO_STRING_PRETTY));
+		json_object_free(json);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (thread_class_budget_set,
+       thread_class_budget_cmd,
+       "thread class <critical|normal|bulk|management> budget (0-1000000)",
+       "Thread information\n"
+       "Scheduling class\n"
+       "Keepalive, hold and hello timers and input\n"
+       "Tasks not classed otherwise\n"
+       "Route processing and work queues\n"
+       "CLI\n"
+       "Wall-clock time the class may run per event loop pass\n"
+       "Microseconds, 0 for no limit\n")
+{
+	unsigned int i;
+
+	for (i = 0; i < THREAD_CLASSES; i++)
+		if (!strcmp(argv[2]->arg, thread_class_names[i]))
+			break;
+	if (i == THREAD_CLASSES)
+		return CMD_WARNING;
+
+	atomic_store_explicit(&thread_class_budget[i],
+			      strtoul(argv[4]->arg, NULL, 10),
+			      memory_order_relaxed);
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_thread_class,
+       show_thread_class_cmd,
+       "show thread class",
+       SHOW_STR
+       "Thread information\n"
+       "Scheduling classes\n")
+{
+	struct thread_class_stats *cs;
+	struct thread_master *m;
+	struct listnode *ln;
+	unsigned long budget;
+	unsigned int i;
+
+	pthread_mutex_lock(&masters_mtx);
+	{
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m)) {
+			vty_out(vty, "\nScheduling classes of pthread %s\n",
+				m->name ? m->name : "main");
+			vty_out(vty, "%-10s %8s %10s %14s %8s\n", "Class",
+				"Budget", "Runs", "uSecs", "Deferred");
+			for (i = 0; i < THREAD_CLASSES; i++) {
+				cs = &m->class_stats[i];
+				budget = atomic_load_explicit(
+					&thread_class_budget[i],
+					memory_order_relaxed);
+				vty_out(vty, "%-10s %8lu %10lu %14lu %8lu\n",
+					thread_class_names[i], budget, cs->runs,
+					cs->usecs, cs->deferred);
+			}
+		}
+	}
+	pthread_mutex_unlock(&masters_mtx);
+
+	return CMD_SUCCESS;
+}
+
+/*
+ * CPU sets pthreads are pinned to, keyed by the name of their thread master
+ * ("main" for the main thread).  Pinning happens when a pthread is started
+ * and, for running ones, when the set is changed.  With the default first
+ * touch policy, a pinned pthread's memory also comes from its own NUMA node.
+ *
+ * Requires: masters_mtx
+ */
+struct thread_affinity {
+	char *name;
+#ifdef GNU_LINUX
+	cpu_set_t cpus;
+#endif
+};
+static struct list *affinities;
+static pthread_t main_pthread;
+
+static const char *thread_master_name(struct thread_master *m)
+{
+	return m->name ? m->name : "main";
+}
+
+static struct thread_affinity *thread_affinity_lookup(const char *name)
+{
+	struct thread_affinity *ta;
+	struct listnode *ln;
+
+	for (ALL_LIST_ELEMENTS_RO(affinities, ln, ta))
+		if (!strcmp(ta->name, name))
+			return ta;
+	return NULL;
+}
+
+#ifdef GNU_LINUX
+int cpulist_parse(const char *str, cpu_set_t *cpus)
+{
+	unsigned long lo, hi;
+	char *end;
+
+	CPU_ZERO(cpus);
+	do {
+		if (!isdigit((unsigned char)*str))
+			return -1;
+		lo = hi = strtoul(str, &end, 10);
+		if (*end == '-') {
+			if (!isdigit((unsigned char)end[1]))
+				return -1;
+			hi = strtoul(end + 1, &end, 10);
+		}
+		if (lo > hi || hi >= CPU_SETSIZE)
+			return -1;
+		for (; lo <= hi; lo++)
+			CPU_SET(lo, cpus);
+		str = end + 1;
+	} while (*end == ',');
+
+	return *end ? -1 : 0;
+}
+
+static void cpulist_format(const cpu_set_t *cpus, char *buf, size_t len)
+{
+	size_t pos = 0;
+	int cpu, last;
+
+	buf[0] = '\0';
+	for (cpu = 0; cpu < CPU_SETSIZE && pos < len; cpu++) {
+		if (!CPU_ISSET(cpu, cpus))
+			continue;
+		for (last = cpu;
+		     last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus); last++)
+			;
+		if (last == cpu)
+			pos += snprintf(buf + pos, len - pos, "%s%d",
+					pos ? "," : "", cpu);
+		else
+			pos += snprintf(buf + pos, len - pos, "%s%d-%d",
+					pos ? "," : "", cpu, last);
+		cpu = last;
+	}
+}
+
+static void thread_affinity_pin(const char *name, pthread_t thread,
+				const cpu_set_t *cpus)
+{
+	int ret;
+
+	ret = pthread_setaffinity_np(thread, sizeof(*cpus), cpus);
+	if (ret)
+		zlog_warn("Could not set CPU affinity of pthread %s: %s",
+			  name, safe_strerror(ret));
+}
+#endif
+
+bool thread_affinity_apply(const char *name, pthread_t thread)
+{
+#ifdef GNU_LINUX
+	struct thread_affinity *ta;
+
+	pthread_mutex_lock(&masters_mtx);
+	{
+		ta = affinities ? thread_affinity_lookup(name) : NULL;
+		if (ta)
+			thread_affinity_pin(name, thread, &ta->cpus);
+	}
+	pthread_mutex_unlock(&masters_mtx);
+
+	return ta != NULL;
+#else
+	return false;
+#endif
+}
+
+void thread_affinity_own(struct thread_master *m, bool own)
+{
+	pthread_mutex_lock(&masters_mtx);
+	{
+		m->own_affinity = own;
+	}
+	pthread_mutex_unlock(&masters_mtx);
+}
+
+int thread_affinity_set(const char *name, const char *cpulist)
+{
+#ifdef GNU_LINUX
+	struct thread_affinity *ta;
+	struct thread_master *m;
+	struct listnode *ln;
+	cpu_set_t cpus;
+	long cpu, ncpus;
+
+	if (cpulist) {
+		if (cpulist_parse(cpulist, &cpus))
+			return -1;
+	} else {
+		/* back to all CPUs */
+		CPU_ZERO(&cpus);
+		ncpus = sysconf(_SC_NPROCESSORS_CONF);
+		for (cpu = 0; cpu < ncpus && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET(cpu, &cpus);
+	}
+
+	pthread_mutex_lock(&masters_mtx);
+	{
+		if (!affinities)
+			affinities = list_new();
+
+		ta = thread_affinity_lookup(name);
+		if (!cpulist && ta) {
+			listnode_delete(affinities, ta);
+			XFREE(MTYPE_THREAD_AFFINITY, ta->name);
+			XFREE(MTYPE_THREAD_AFFINITY, ta);
+		} else if (cpulist) {
+			if (!ta) {
+				ta = XCALLOC(MTYPE_THREAD_AFFINITY, sizeof(*ta));
+				ta->name = XSTRDUP(MTYPE_THREAD_AFFINITY, name);
+				listnode_add(affinities, ta);
+			}
+			ta->cpus = cpus;
+		}
+
+		/*
+		 * Masters of pthreads that have not started yet are still
+		 * owned by the main pthread; they get pinned on start.
+		 */
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m)) {
+			if (strcmp(thread_master_name(m), name))
+				continue;
+			if (m->name && pthread_equal(m->owner, main_pthread))
+				continue;
+			if (m->own_affinity)
+				continue;
+			thread_affinity_pin(name, m->owner, &cpus);
+		}
+	}
+	pthread_mutex_unlock(&masters_mtx);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+DEFUN (thread_affinity,
+       thread_affinity_cmd,
+       "thread affinity NAME CPULIST",
+       "Thread information\n"
+       "Pin a pthread to a set of CPUs\n"
+       "Name of the pthread, main for the main one\n"
+       "CPUs, e.g. 0-3,8\n")
+{
+	if (thread_affinity_set(argv[2]->arg, argv[3]->arg) < 0) {
+		vty_out(vty, "%% Invalid CPU list or no affinity support\n");
+		return CMD_WARNING;
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_thread_affinity,
+       no_thread_affinity_cmd,
+       "no thread affinity NAME [CPULIST]",
+       NO_STR
+       "Thread information\n"
+       "Pin a pthread to a set of CPUs\n"
+       "Name of the pthread, main for the main one\n"
+       "CPUs, e.g. 0-3,8\n")
+{
+	if (thread_affinity_set(argv[3]->arg, NULL) < 0) {
+		vty_out(vty, "%% No affinity support\n");
+		return CMD_WARNING;
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_thread_affinity,
+       show_thread_affinity_cmd,
+       "show thread affinity",
+       SHOW_STR
+       "Thread information\n"
+       "CPUs pthreads run on\n")
+{
+#ifdef GNU_LINUX
+	struct thread_affinity *ta;
+	struct thread_master *m;
+	struct listnode *ln;
+	char cur[256], conf[256];
+	cpu_set_t cpus;
+
+	vty_out(vty, "%-30s %-20s %s\n", "Pthread", "Running on",
+		"Configured");
+	pthread_mutex_lock(&masters_mtx);
+	{
+		for (ALL_LIST_ELEMENTS_RO(masters, ln, m)) {
+			ta = affinities ? thread_affinity_lookup(
+						  thread_master_name(m))
+					: NULL;
+			if (m->name && pthread_equal(m->owner, main_pthread))
+				strlcpy(cur, "(not started)", sizeof(cur));
+			else if (pthread_getaffinity_np(m->owner, sizeof(cpus),
+							&cpus))
+				strlcpy(cur, "-", sizeof(cur));
+			else
+				cpulist_format(&cpus, cur, sizeof(cur));
+			if (ta)
+				cpulist_format(&ta->cpus, conf, sizeof(conf));
+			else
+				strlcpy(conf, "-", sizeof(conf));
+			vty_out(vty, "%-30s %-20s %s\n", thread_master_name(m),
+				cur, conf);
+		}
+	}
+	pthread_mutex_unlock(&masters_mtx);
+#else
+	vty_out(vty, "CPU affinity is not supported on this platform\n");
+#endif
+	return CMD_SUCCESS;
+}
+
 void thread_cmd_init(void)
 {
 	install_element(VIEW_NODE, &show_thread_cpu_cmd);
+	install_element(VIEW_NODE, &show_thread_cpu_histogram_cmd);
+	install_element(VIEW_NODE, &show_thread_slow_trace_cmd);
 	install_element(ENABLE_NODE, &clear_thread_cpu_cmd);
+	install_element(ENABLE_NODE, &thread_slow_trace_cmd);
+	install_element(ENABLE_NODE, &no_thread_slow_trace_cmd);
+	install_element(VIEW_NODE, &show_thread_class_cmd);
+	install_element(ENABLE_NODE, &thread_class_budget_cmd);
+	install_element(VIEW_NODE, &show_thread_affinity_cmd);
+	install_element(ENABLE_NODE, &thread_affinity_cmd);
+	install_element(ENABLE_NODE, &no_thread_affinity_cmd);
 }
 /* CLI end ------------------------------------------------------------------ */
 
@@ -399,6 +980,8 @@ struct thread_master *thread_master_create(const char *name)
 	rv->cancel_req->del = cancelreq_del;
 	rv->canceled = true;
 
+	mpscq_init(&rv->posted);
+
 	/* Initialize pipe poker */
 	pipe(rv->io_pipe);
 	set_nonblocking(rv->io_pipe[0]);
@@ -412,11 +995,18 @@ struct thread_master *thread_master_create(const char *name)
 	rv->handler.copy = XCALLOC(MTYPE_THREAD_MASTER,
 				   sizeof(struct pollfd) * rv->handler.pfdsize);
 
+#ifdef THREAD_IO_EVQUEUE
+	/* kernel event queue is set up by the owner on first thread_fetch() */
+	rv->handler.evfd = -1;
+#endif
+
 	/* add to list of threadmasters */
 	pthread_mutex_lock(&masters_mtx);
 	{
 		if (!masters)
 			masters = list_new();
+		if (!name)
+			main_pthread = rv->owner;
 
 		listnode_add(masters, rv);
 	}
@@ -453,33 +1043,308 @@ static void thread_list_add(struct thread_list *list, struct thread *thread)
 static struct thread *thread_list_delete(struct thread_list *list,
 					 struct thread *thread)
 {
-	if (thread->next)
-		thread->next->prev = thread->prev;
-	else
-		list->tail = thread->prev;
-	if (thread->prev)
-		thread->prev->next = thread->next;
-	else
-		list->head = thread->next;
-	thread->next = thread->prev = NULL;
-	list->count--;
-	return thread;
+	if (thread->next)
+		thread->next->prev = thread->prev;
+	else
+		list->tail = thread->prev;
+	if (thread->prev)
+		thread->prev->next = thread->next;
+	else
+		list->head = thread->next;
+	thread->next = thread->prev = NULL;
+	list->count--;
+	return thread;
+}
+
+/* Thread list is empty or not.  */
+static int thread_empty(struct thread_list *list)
+{
+	return list->head ? 0 : 1;
+}
+
+/* Delete top of the list and return it. */
+static struct thread *thread_trim_head(struct thread_list *list)
+{
+	if (!thread_empty(list))
+		return thread_list_delete(list, list->head);
+	return NULL;
+}
+
+/* Put a thread on the ready list of its class. */
+static void thread_ready_add(struct thread_master *m, struct thread *thread)
+{
+	thread->type = THREAD_READY;
+	thread_list_add(&m->ready[thread->sclass], thread);
+}
+
+static unsigned int thread_ready_count(struct thread_master *m)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < THREAD_CLASSES; i++)
+		count += m->ready[i].count;
+	return count;
+}
+
+/*
+ * Next thread to run in this pass of the event loop: the first of the
+ * highest class that has any ready and has not spent its budget yet.
+ */
+static struct thread *thread_ready_next(struct thread_master *m)
+{
+	unsigned long budget;
+	unsigned int i;
+
+	for (i = 0; i < THREAD_CLASSES; i++) {
+		if (thread_empty(&m->ready[i]))
+			continue;
+
+		budget = atomic_load_explicit(&thread_class_budget[i],
+					      memory_order_relaxed);
+		if (budget && m->class_used[i] >= budget) {
+			/* counted once per pass */
+			if (!(m->class_deferred & (1 << i))) {
+				m->class_stats[i].deferred++;
+				m->class_deferred |= 1 << i;
+			}
+			continue;
+		}
+		return thread_trim_head(&m->ready[i]);
+	}
+	return NULL;
+}
+
+/* Timer wheel ------------------------------------------------------------- */
+
+/*
+ * Hierarchical timer wheel, an alternate store for timers of a second or
+ * more (keepalive, hold and retry timers).  Arming and cancelling are O(1);
+ * expiry costs one step per slot that actually holds timers, plus one
+ * cascade per occupied higher-level slot.
+ *
+ * Level 0 has THREAD_WHEEL_SLOTS slots of THREAD_WHEEL_TICK_MSEC each, and
+ * each slot of a higher level spans a full rotation of the level below.
+ * Expiry is rounded up to a multiple of THREAD_WHEEL_BATCH ticks so that
+ * second-scale timers due in the same window pop together.
+ */
+#define THREAD_WHEEL_BITS 6
+#define THREAD_WHEEL_SLOTS (1 << THREAD_WHEEL_BITS)
+#define THREAD_WHEEL_MASK (THREAD_WHEEL_SLOTS - 1)
+#define THREAD_WHEEL_LEVELS 4
+#define THREAD_WHEEL_TICK_MSEC 10
+#define THREAD_WHEEL_BATCH 10
+
+struct thread_wheel {
+	/* next tick to be processed */
+	uint64_t curtick;
+	/* occupied slots, one bit per slot */
+	uint64_t used[THREAD_WHEEL_LEVELS];
+	unsigned int count;
+
+	struct thread_list slots[THREAD_WHEEL_LEVELS][THREAD_WHEEL_SLOTS];
+};
+
+static uint64_t thread_wheel_tick(const struct timeval *tv)
+{
+	return ((uint64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000)
+	       / THREAD_WHEEL_TICK_MSEC;
+}
+
+static void thread_wheel_insert(struct thread_wheel *w, struct thread *thread)
+{
+	uint64_t msec, t, cur = w->curtick;
+	int level, shift, slot;
+
+	/* round up, never pop early */
+	msec = (uint64_t)thread->u.sands.tv_sec * 1000
+	       + (thread->u.sands.tv_usec + 999) / 1000;
+	t = (msec + THREAD_WHEEL_TICK_MSEC - 1) / THREAD_WHEEL_TICK_MSEC;
+	t = (t + THREAD_WHEEL_BATCH - 1) / THREAD_WHEEL_BATCH
+	    * THREAD_WHEEL_BATCH;
+	if (t < cur)
+		t = cur;
+
+	/* lowest level on which t shares the current rotation */
+	for (level = 0; level < THREAD_WHEEL_LEVELS - 1; level++)
+		if ((t >> (THREAD_WHEEL_BITS * (level + 1)))
+		    == (cur >> (THREAD_WHEEL_BITS * (level + 1))))
+			break;
+	shift = THREAD_WHEEL_BITS * level;
+
+	/* too far out: park in the last top level slot, it is re-filed when
+	 * that slot cascades */
+	if ((t >> shift) - (cur >> shift) > THREAD_WHEEL_MASK)
+		t = ((cur >> shift) + THREAD_WHEEL_MASK) << shift;
+
+	slot = (t >> shift) & THREAD_WHEEL_MASK;
+	thread->wheelpos = level * THREAD_WHEEL_SLOTS + slot;
+	thread_list_add(&w->slots[level][slot], thread);
+	w->used[level] |= 1ULL << slot;
+	w->count++;
+}
+
+static void thread_wheel_remove(struct thread_wheel *w, struct thread *thread)
+{
+	int level = thread->wheelpos / THREAD_WHEEL_SLOTS;
+	int slot = thread->wheelpos & THREAD_WHEEL_MASK;
+	struct thread_list *list = &w->slots[level][slot];
+
+	thread_list_delete(list, thread);
+	if (thread_empty(list))
+		w->used[level] &= ~(1ULL << slot);
+	thread->wheelpos = -1;
+	w->count--;
+}
+
+/* Tick at which the wheel next has work: a level 0 slot to pop or a higher
+ * level slot to cascade.  UINT64_MAX if the wheel is empty. */
+static uint64_t thread_wheel_next(struct thread_wheel *w)
+{
+	uint64_t next = UINT64_MAX, cur = w->curtick;
+
+	for (int level = 0; level < THREAD_WHEEL_LEVELS; level++) {
+		int shift = THREAD_WHEEL_BITS * level;
+		unsigned int idx = (cur >> shift) & THREAD_WHEEL_MASK;
+		uint64_t used = w->used[level];
+		uint64_t t;
+
+		if (!used)
+			continue;
+
+		/* rotate so that bit 0 is the current slot */
+		if (idx)
+			used = (used >> idx) | (used << (64 - idx));
+		/* above level 0, the current slot is only due while we sit
+		 * right on its boundary */
+		if (level && (cur & ((1ULL << shift) - 1)))
+			used &= ~1ULL;
+		if (!used)
+			continue;
+
+		t = ((cur >> shift) + __builtin_ctzll(used)) << shift;
+		if (t < next)
+			next = t;
+	}
+	return next;
+}
+
+/* Move all wheel timers that have popped to the ready list. */
+static unsigned int thread_wheel_expire(struct thread_master *m,
+					struct timeval *timenow)
+{
+	struct thread_wheel *w = m->wheel;
+	uint64_t now = thread_wheel_tick(timenow), next;
+	struct thread_list *list;
+	struct thread *thread;
+	unsigned int ready = 0;
+	int slot;
+
+	while (w->count && (next = thread_wheel_next(w)) <= now) {
+		w->curtick = next;
+
+		/* cascade from the top down, so that timers can trickle
+		 * through several levels in one step */
+		for (int level = THREAD_WHEEL_LEVELS - 1; level > 0; level--) {
+			int shift = THREAD_WHEEL_BITS * level;
+
+			if (next & ((1ULL << shift) - 1))
+				continue;
+
+			slot = (next >> shift) & THREAD_WHEEL_MASK;
+			list = &w->slots[level][slot];
+			w->used[level] &= ~(1ULL << slot);
+			while ((thread = thread_trim_head(list))) {
+				w->count--;
+				thread_wheel_insert(w, thread);
+			}
+		}
+
+		slot = next & THREAD_WHEEL_MASK;
+		list = &w->slots[0][slot];
+		w->used[0] &= ~(1ULL << slot);
+		while ((thread = thread_trim_head(list))) {
+			w->count--;
+			thread->wheelpos = -1;
+			thread_ready_add(m, thread);
+			ready++;
+		}
+
+		w->curtick = next + 1;
+	}
+
+	/* nothing due up to now, so no slot boundary with work was skipped */
+	if (w->curtick <= now)
+		w->curtick = now + 1;
+
+	return ready;
+}
+
+/* Time until the wheel next has work. */
+static bool thread_wheel_wait(struct thread_wheel *w, struct timeval *timer_val)
+{
+	uint64_t next;
+	struct timeval due;
+
+	if (!w || !w->count)
+		return false;
+
+	next = thread_wheel_next(w) * THREAD_WHEEL_TICK_MSEC;
+	due.tv_sec = next / 1000;
+	due.tv_usec = (next % 1000) * 1000;
+	monotime_until(&due, timer_val);
+	return true;
 }
 
-/* Thread list is empty or not.  */
-static int thread_empty(struct thread_list *list)
+/*
+ * Use the timer wheel for this thread_master's timers of one second or
+ * more.  Such timers then pop up to THREAD_WHEEL_BATCH ticks late.
+ *
+ * MT-Unsafe
+ */
+void thread_master_set_timer_wheel(struct thread_master *m, bool enable)
 {
-	return list->head ? 0 : 1;
+	struct timeval now;
+	struct thread *thread;
+
+	pthread_mutex_lock(&m->mtx);
+	if (enable && !m->wheel) {
+		monotime(&now);
+		m->wheel = XCALLOC(MTYPE_THREAD_MASTER,
+				   sizeof(struct thread_wheel));
+		m->wheel->curtick = thread_wheel_tick(&now);
+	} else if (!enable && m->wheel) {
+		/* hand pending timers back to the heap */
+		for (int level = 0; level < THREAD_WHEEL_LEVELS; level++)
+			for (int slot = 0; slot < THREAD_WHEEL_SLOTS; slot++)
+				while ((thread = thread_trim_head(
+						&m->wheel->slots[level][slot]))) {
+					thread->wheelpos = -1;
+					pqueue_enqueue(thread, m->timer);
+				}
+		XFREE(MTYPE_THREAD_MASTER, m->wheel);
+	}
+	pthread_mutex_unlock(&m->mtx);
 }
 
-/* Delete top of the list and return it. */
-static struct thread *thread_trim_head(struct thread_list *list)
+static void thread_wheel_free(struct thread_master *m)
 {
-	if (!thread_empty(list))
-		return thread_list_delete(list, list->head);
-	return NULL;
+	struct thread *thread;
+
+	if (!m->wheel)
+		return;
+
+	for (int level = 0; level < THREAD_WHEEL_LEVELS; level++)
+		for (int slot = 0; slot < THREAD_WHEEL_SLOTS; slot++)
+			while ((thread = thread_trim_head(
+					&m->wheel->slots[level][slot]))) {
+				XFREE(MTYPE_THREAD, thread);
+				m->alloc--;
+			}
+	XFREE(MTYPE_THREAD_MASTER, m->wheel);
 }
 
+/* ------------------------------------------------------------------------- */
+
 /* Move thread to unuse list. */
 static void thread_add_unuse(struct thread_master *m, struct thread *thread)
 {
@@ -559,6 +1424,8 @@ void thread_master_free_unused(struct thread_master *m)
 /* Stop thread scheduler. */
 void thread_master_free(struct thread_master *m)
 {
+	struct mpscq_item *item;
+
 	pthread_mutex_lock(&masters_mtx);
 	{
 		listnode_delete(masters, m);
@@ -571,9 +1438,13 @@ void thread_master_free(struct thread_master *m)
 	thread_array_free(m, m->read);
 	thread_array_free(m, m->write);
 	thread_queue_free(m, m->timer);
+	thread_wheel_free(m);
 	thread_list_free(m, &m->event);
-	thread_list_free(m, &m->ready);
+	for (int i = 0; i < THREAD_CLASSES; i++)
+		thread_list_free(m, &m->ready[i]);
 	thread_list_free(m, &m->unuse);
+	while ((item = mpscq_pop(&m->posted)))
+		XFREE(MTYPE_THREAD_POST, item);
 	pthread_mutex_destroy(&m->mtx);
 	pthread_cond_destroy(&m->cancel_cond);
 	close(m->io_pipe[0]);
@@ -589,6 +1460,12 @@ void thread_master_free(struct thread_master *m)
 		XFREE(MTYPE_THREAD_MASTER, m->name);
 	XFREE(MTYPE_THREAD_MASTER, m->handler.pfds);
 	XFREE(MTYPE_THREAD_MASTER, m->handler.copy);
+#ifdef THREAD_IO_EVQUEUE
+	if (m->handler.evfd >= 0)
+		close(m->handler.evfd);
+	XFREE(MTYPE_THREAD_MASTER, m->handler.fdstate);
+	XFREE(MTYPE_THREAD_MASTER, m->handler.events);
+#endif
 	XFREE(MTYPE_THREAD_MASTER, m);
 }
 
@@ -640,6 +1517,7 @@ static struct thread *thread_get(struct thread_master *m, uint8_t type,
 	thread->master = m;
 	thread->arg = arg;
 	thread->index = -1;
+	thread->wheelpos = -1;
 	thread->yield = THREAD_YIELD_TIME_SLOT; /* default */
 	thread->ref = NULL;
 
@@ -661,6 +1539,7 @@ static struct thread *thread_get(struct thread_master *m, uint8_t type,
 				 (void *(*)(void *))cpu_record_hash_alloc);
 	}
 	thread->hist->total_active++;
+	thread->sclass = thread->hist->sclass;
 	thread->func = func;
 	thread->funcname = funcname;
 	thread->schedfrom = schedfrom;
@@ -669,8 +1548,8 @@ static struct thread *thread_get(struct thread_master *m, uint8_t type,
 	return thread;
 }
 
-static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
-		   nfds_t count, const struct timeval *timer_wait)
+/* Convert a timer wait into a poll() style timeout in milliseconds. */
+static int fd_timeout(struct thread_master *m, const struct timeval *timer_wait)
 {
 	/* If timer_wait is null here, that means poll() should block
 	 * indefinitely,
@@ -685,9 +1564,6 @@ static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
 	 * zero, the behavior is default. */
 	int timeout = -1;
 
-	/* number of file descriptors with events */
-	int num;
-
 	if (timer_wait != NULL
 	    && m->selectpoll_timeout == 0) // use the default value
 		timeout = (timer_wait->tv_sec * 1000)
@@ -698,6 +1574,17 @@ static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
 		 < 0) // effect a poll (return immediately)
 		timeout = 0;
 
+	return timeout;
+}
+
+static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
+		   nfds_t count, const struct timeval *timer_wait)
+{
+	int timeout = fd_timeout(m, timer_wait);
+
+	/* number of file descriptors with events */
+	int num;
+
 	/* add poll pipe poker */
 	assert(count + 1 < pfdsize);
 	pfds[count].fd = m->io_pipe[0];
@@ -714,6 +1601,309 @@ static int fd_poll(struct thread_master *m, struct pollfd *pfds, nfds_t pfdsize,
 	return num;
 }
 
+/* Add the given events for fd to the pollfd array. */
+static void fd_poll_add(struct thread_master *m, int fd, short events)
+{
+	/* default to a new pollfd */
+	nfds_t queuepos = m->handler.pfdcount;
+
+	/* if we already have a pollfd for our file descriptor, find and
+	 * use it */
+	for (nfds_t i = 0; i < m->handler.pfdcount; i++)
+		if (m->handler.pfds[i].fd == fd) {
+			queuepos = i;
+			break;
+		}
+
+	/* make sure we have room for this fd + pipe poker fd */
+	assert(queuepos + 1 < m->handler.pfdsize);
+
+	m->handler.pfds[queuepos].fd = fd;
+	m->handler.pfds[queuepos].events |= events;
+
+	if (queuepos == m->handler.pfdcount)
+		m->handler.pfdcount++;
+}
+
+#ifdef THREAD_IO_EVQUEUE
+/*
+ * Kernel event queue backend (epoll on Linux, kqueue on BSD).
+ *
+ * fdstate[fd] holds the directions tasks are waiting for and, shifted by
+ * FD_KERN_SHIFT, the directions currently registered with the kernel.
+ * Read interest is disarmed lazily: socket read tasks nearly always
+ * reschedule themselves, so the registration is left in place when the
+ * task fires and only dropped if the fd reports readiness nobody waits
+ * for.  As the fd may have been closed and its number reused meanwhile,
+ * which silently drops it from the kernel queue, such a lingering
+ * registration is renewed when a read task is added again.  Write
+ * interest is dropped as soon as the task fires, as a writable socket
+ * would otherwise wake us up on every iteration.
+ *
+ * The queue is created by the owning pthread on its first thread_fetch(),
+ * i.e. after the daemon has forked (kqueues are not inherited).  Until
+ * then, and for descriptors the kernel refuses, the poll() set is used.
+ */
+#define FD_IO_READ 0x01
+#define FD_IO_WRITE 0x02
+#define FD_IO_WANT (FD_IO_READ | FD_IO_WRITE)
+#define FD_KERN_SHIFT 2
+#define FD_KERN(st) (((st) >> FD_KERN_SHIFT) & FD_IO_WANT)
+#define FD_IO_POLL 0x10 /* fd is handled by the poll() set */
+#define FD_IO_LINGER 0x20 /* read is registered, but nobody waited since */
+
+#define THREAD_IO_MAXEVENTS 256
+
+static inline bool fd_evq_active(struct thread_master *m)
+{
+	return m->handler.evfd >= 0;
+}
+
+/* Make the kernel registration for fd match the directions in newk. */
+static int fd_evq_update(struct thread_master *m, int fd, uint8_t newk)
+{
+	struct fd_handler *h = &m->handler;
+	uint8_t *st = &h->fdstate[fd];
+	uint8_t oldk = FD_KERN(*st);
+	int ret;
+
+	if (newk == oldk)
+		return 0;
+
+#if defined(HAVE_EPOLL)
+	struct epoll_event ev = {};
+	int op;
+
+	ev.data.fd = fd;
+	ev.events = ((newk & FD_IO_READ) ? EPOLLIN : 0)
+		    | ((newk & FD_IO_WRITE) ? EPOLLOUT : 0);
+
+	if (!newk)
+		op = EPOLL_CTL_DEL;
+	else
+		op = oldk ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+	ret = epoll_ctl(h->evfd, op, fd, &ev);
+
+	/* the fd may have been closed (and reopened) behind our back, which
+	 * silently removes it from the epoll set */
+	if (ret < 0 && errno == ENOENT && op == EPOLL_CTL_MOD)
+		ret = epoll_ctl(h->evfd, EPOLL_CTL_ADD, fd, &ev);
+	else if (ret < 0 && errno == EEXIST && op == EPOLL_CTL_ADD)
+		ret = epoll_ctl(h->evfd, EPOLL_CTL_MOD, fd, &ev);
+	else if (ret < 0 && (errno == ENOENT || errno == EBADF)
+		 && op == EPOLL_CTL_DEL)
+		ret = 0;
+#else
+	struct kevent ev[2];
+	int n = 0;
+
+	if ((newk ^ oldk) & FD_IO_READ)
+		EV_SET(&ev[n++], fd, EVFILT_READ,
+		       (newk & FD_IO_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+	if ((newk ^ oldk) & FD_IO_WRITE)
+		EV_SET(&ev[n++], fd, EVFILT_WRITE,
+		       (newk & FD_IO_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+
+	ret = kevent(h->evfd, ev, n, NULL, 0, NULL);
+
+	/* closing an fd drops its filters; deleting them is then a no-op */
+	if (ret < 0 && (errno == ENOENT || errno == EBADF) && !(newk & ~oldk))
+		ret = 0;
+#endif
+	if (ret < 0)
+		return -1;
+
+	if (!oldk && newk)
+		h->evcount++;
+	else if (oldk && !newk)
+		h->evcount--;
+
+	*st = (*st & ~(FD_IO_WANT << FD_KERN_SHIFT)) | (newk << FD_KERN_SHIFT);
+	*st &= ~FD_IO_LINGER;
+	return 0;
+}
+
+/* Register fd with the kernel again as it is, in case the fd was closed
+ * and reused after its registration was made. */
+static int fd_evq_renew(struct thread_master *m, int fd)
+{
+	struct fd_handler *h = &m->handler;
+	uint8_t *st = &h->fdstate[fd];
+	uint8_t kern = FD_KERN(*st);
+	int ret;
+
+#if defined(HAVE_EPOLL)
+	struct epoll_event ev = {};
+
+	ev.data.fd = fd;
+	ev.events = ((kern & FD_IO_READ) ? EPOLLIN : 0)
+		    | ((kern & FD_IO_WRITE) ? EPOLLOUT : 0);
+
+	/* nothing to change if the registration is still there */
+	ret = epoll_ctl(h->evfd, EPOLL_CTL_ADD, fd, &ev);
+	if (ret < 0 && errno == EEXIST)
+		ret = 0;
+#else
+	struct kevent ev[2];
+	int n = 0;
+
+	if (kern & FD_IO_READ)
+		EV_SET(&ev[n++], fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+	if (kern & FD_IO_WRITE)
+		EV_SET(&ev[n++], fd, EVFILT_WRITE, EV_ADD, 0, 0, NULL);
+
+	ret = kevent(h->evfd, ev, n, NULL, 0, NULL);
+#endif
+	if (ret < 0)
+		return -1;
+
+	*st &= ~FD_IO_LINGER;
+	return 0;
+}
+
+static void fd_evq_add(struct thread_master *m, int fd, uint8_t dir)
+{
+	uint8_t *st = &m->handler.fdstate[fd];
+	uint8_t kern;
+
+	*st |= dir;
+	if (*st & FD_IO_POLL) {
+		fd_poll_add(m, fd, dir == FD_IO_READ ? POLLIN : POLLOUT);
+		return;
+	}
+
+	/* still armed from a previous task? */
+	kern = FD_KERN(*st);
+	if (!(dir & ~kern)) {
+		if (!(*st & FD_IO_LINGER) || fd_evq_renew(m, fd) == 0)
+			return;
+	} else if (fd_evq_update(m, fd, kern | dir) == 0)
+		return;
+
+	/* e.g. EPERM for regular files: leave this one to poll() */
+	*st |= FD_IO_POLL;
+	fd_poll_add(m, fd, ((*st & FD_IO_READ) ? POLLIN : 0)
+				   | ((*st & FD_IO_WRITE) ? POLLOUT : 0));
+}
+
+static void fd_evq_cancel(struct thread_master *m, int fd, uint8_t dir)
+{
+	uint8_t *st = &m->handler.fdstate[fd];
+
+	*st &= ~dir;
+	fd_evq_update(m, fd, *st & FD_IO_WANT);
+}
+
+/* Create the kernel event queue and move the poll() set over to it. */
+static void fd_evq_start(struct thread_master *m)
+{
+	struct fd_handler *h = &m->handler;
+
+	h->evinit = true;
+
+#if defined(HAVE_EPOLL)
+	struct epoll_event ev = {};
+
+	h->evfd = epoll_create1(EPOLL_CLOEXEC);
+	ev.events = EPOLLIN;
+	ev.data.fd = m->io_pipe[0];
+	if (h->evfd >= 0
+	    && epoll_ctl(h->evfd, EPOLL_CTL_ADD, m->io_pipe[0], &ev) < 0) {
+#else
+	struct kevent ev;
+
+	h->evfd = kqueue();
+	EV_SET(&ev, m->io_pipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+	if (h->evfd >= 0 && kevent(h->evfd, &ev, 1, NULL, 0, NULL) < 0) {
+#endif
+		close(h->evfd);
+		h->evfd = -1;
+	}
+	if (h->evfd < 0) {
+		zlog_warn("%s: cannot create event queue, using poll(): %s",
+			  __func__, safe_strerror(errno));
+		return;
+	}
+
+	h->fdstate = XCALLOC(MTYPE_THREAD_MASTER, m->fd_limit);
+	h->eventsize = THREAD_IO_MAXEVENTS;
+	h->events = XCALLOC(MTYPE_THREAD_MASTER,
+			    sizeof(h->events[0]) * h->eventsize);
+
+	for (nfds_t i = 0; i < h->pfdcount;) {
+		int fd = h->pfds[i].fd;
+		uint8_t dir = 0;
+
+		if (h->pfds[i].events & POLLIN)
+			dir |= FD_IO_READ;
+		if (h->pfds[i].events & POLLOUT)
+			dir |= FD_IO_WRITE;
+
+		h->fdstate[fd] = dir;
+		if (dir && fd_evq_update(m, fd, dir) < 0) {
+			h->fdstate[fd] |= FD_IO_POLL;
+			i++;
+			continue;
+		}
+
+		memmove(h->pfds + i, h->pfds + i + 1,
+			(h->pfdcount - i - 1) * sizeof(struct pollfd));
+		h->pfdcount--;
+	}
+}
+
+static int fd_evq_wait(struct thread_master *m, int timeout)
+{
+	struct fd_handler *h = &m->handler;
+
+#if defined(HAVE_EPOLL)
+	return epoll_wait(h->evfd, h->events, h->eventsize, timeout);
+#else
+	struct timespec ts, *tsp = NULL;
+
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		tsp = &ts;
+	}
+	return kevent(h->evfd, NULL, 0, h->events, h->eventsize, tsp);
+#endif
+}
+
+/*
+ * Wait for the fds left to poll() and, through its own fd, for the event
+ * queue at once, then collect kernel events without blocking.  Returns the
+ * number of kernel events, and that of ready poll() fds in pnum.
+ */
+static int fd_evq_poll(struct thread_master *m,
+		       const struct timeval *timer_wait, int *pnum)
+{
+	struct fd_handler *h = &m->handler;
+	struct pollfd *evpfd = &h->copy[h->copycount];
+	int num;
+
+	/* the event queue takes the slot of the pipe poker, which is on it */
+	assert(h->copycount + 1 < h->pfdsize);
+	evpfd->fd = h->evfd;
+	evpfd->events = POLLIN;
+	evpfd->revents = 0;
+
+	num = poll(h->copy, h->copycount + 1, fd_timeout(m, timer_wait));
+	if (num <= 0) {
+		*pnum = 0;
+		return num;
+	}
+	if (!evpfd->revents) {
+		*pnum = num;
+		return 0;
+	}
+
+	*pnum = num - 1;
+	return fd_evq_wait(m, 0);
+}
+#endif /* THREAD_IO_EVQUEUE */
+
 /* Add new read thread. */
 struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m,
 					      int (*func)(struct thread *),
@@ -732,28 +1922,17 @@ struct thread *funcname_thread_add_read_write(int dir, struct thread_master *m,
 			return NULL;
 		}
 
-		/* default to a new pollfd */
-		nfds_t queuepos = m->handler.pfdcount;
-
-		/* if we already have a pollfd for our file descriptor, find and
-		 * use it */
-		for (nfds_t i = 0; i < m->handler.pfdcount; i++)
-			if (m->handler.pfds[i].fd == fd) {
-				queuepos = i;
-				break;
-			}
-
-		/* make sure we have room for this fd + pipe poker fd */
-		assert(queuepos + 1 < m->handler.pfdsize);
-
 		thread = thread_get(m, dir, func, arg, debugargpass);
 
-		m->handler.pfds[queuepos].fd = fd;
-		m->handler.pfds[queuepos].events |=
-			(dir == THREAD_READ ? POLLIN : POLLOUT);
-
-		if (queuepos == m->handler.pfdcount)
-			m->handler.pfdcount++;
+#ifdef THREAD_IO_EVQUEUE
+		if (fd_evq_active(m))
+			fd_evq_add(m, fd,
+				   dir == THREAD_READ ? FD_IO_READ
+						      : FD_IO_WRITE);
+		else
+#endif
+			fd_poll_add(m, fd,
+				    dir == THREAD_READ ? POLLIN : POLLOUT);
 
 		if (thread) {
 			pthread_mutex_lock(&thread->mtx);
@@ -810,7 +1989,10 @@ funcname_thread_add_timer_timeval(struct thread_master *m,
 			monotime(&thread->u.sands);
 			timeradd(&thread->u.sands, time_relative,
 				 &thread->u.sands);
-			pqueue_enqueue(thread, queue);
+			if (m->wheel && time_relative->tv_sec >= 1)
+				thread_wheel_insert(m->wheel, thread);
+			else
+				pqueue_enqueue(thread, queue);
 			if (t_ptr) {
 				*t_ptr = thread;
 				thread->ref = t_ptr;
@@ -894,6 +2076,7 @@ struct thread *funcname_thread_add_event(struct thread_master *m,
 		pthread_mutex_lock(&thread->mtx);
 		{
 			thread->u.val = val;
+			monotime(&thread->ready);
 			thread_list_add(&m->event, thread);
 		}
 		pthread_mutex_unlock(&thread->mtx);
@@ -910,6 +2093,80 @@ struct thread *funcname_thread_add_event(struct thread_master *m,
 	return thread;
 }
 
+/* An event posted from another pthread, on its way to m->event. */
+struct thread_post {
+	struct mpscq_item mq;
+
+	int (*func)(struct thread *);
+	void *arg;
+	int val;
+
+	const char *funcname;
+	const char *schedfrom;
+	int fromln;
+};
+
+void funcname_thread_post_event(struct thread_master *m,
+				int (*func)(struct thread *), void *arg,
+				int val, debugargdef)
+{
+	struct thread_post *post;
+
+	assert(m != NULL);
+
+	post = XMALLOC(MTYPE_THREAD_POST, sizeof(struct thread_post));
+	post->func = func;
+	post->arg = arg;
+	post->val = val;
+	post->funcname = funcname;
+	post->schedfrom = schedfrom;
+	post->fromln = fromln;
+
+	mpscq_push(&m->posted, &post->mq);
+
+	/* only the first poster since the owner last looked needs to poke */
+	if (!atomic_exchange_explicit(&m->posted_wake, true,
+				      memory_order_seq_cst))
+		AWAKEN(m);
+}
+
+/*
+ * Turns posted events into regular ones.
+ *
+ * @requires m->mtx
+ */
+static void thread_process_posted(struct thread_master *m)
+{
+	struct mpscq_item *item;
+	struct thread_post *post;
+	struct thread *thread;
+
+	/*
+	 * Posters set the flag after their event became visible, so whatever
+	 * isn't seen here will come with another wakeup.
+	 */
+	if (!atomic_exchange_explicit(&m->posted_wake, false,
+				      memory_order_seq_cst))
+		return;
+
+	while ((item = mpscq_pop(&m->posted))) {
+		post = (struct thread_post *)item;
+
+		thread = thread_get(m, THREAD_EVENT, post->func, post->arg,
+				    post->funcname, post->schedfrom,
+				    post->fromln);
+		pthread_mutex_lock(&thread->mtx);
+		{
+			thread->u.val = post->val;
+			monotime(&thread->ready);
+			thread_list_add(&m->event, thread);
+		}
+		pthread_mutex_unlock(&thread->mtx);
+
+		XFREE(MTYPE_THREAD_POST, post);
+	}
+}
+
 /* Thread cancellation ------------------------------------------------------ */
 
 /**
@@ -930,6 +2187,15 @@ static void thread_cancel_rw(struct thread_master *master, int fd, short state)
 {
 	bool found = false;
 
+#ifdef THREAD_IO_EVQUEUE
+	if (fd_evq_active(master)
+	    && !(master->handler.fdstate[fd] & FD_IO_POLL)) {
+		fd_evq_cancel(master, fd,
+			      (state & POLLIN) ? FD_IO_READ : FD_IO_WRITE);
+		return;
+	}
+#endif
+
 	/* Cancel POLLHUP too just in case some bozo set it */
 	state |= POLLHUP;
 
@@ -959,6 +2225,10 @@ static void thread_cancel_rw(struct thread_master *master, int fd, short state)
 			(master->handler.pfdcount - i - 1)
 				* sizeof(struct pollfd));
 		master->handler.pfdcount--;
+#ifdef THREAD_IO_EVQUEUE
+		if (fd_evq_active(master))
+			master->handler.fdstate[fd] = 0;
+#endif
 	}
 
 	/* If we have the same pollfd in the copy, perform the same operations,
@@ -1015,13 +2285,16 @@ static void do_thread_cancel(struct thread_master *master)
 				}
 			}
 
-			thread = master->ready.head;
-			while (thread) {
-				t = thread;
-				thread = t->next;
+			for (int i = 0; i < THREAD_CLASSES; i++) {
+				thread = master->ready[i].head;
+				while (thread) {
+					t = thread;
+					thread = t->next;
 
-				if (t->arg == cr->eventobj) {
-					thread_list_delete(&master->ready, t);
+					if (t->arg != cr->eventobj)
+						continue;
+					thread_list_delete(&master->ready[i],
+							   t);
 					if (t->ref)
 						*t->ref = NULL;
 					thread_add_unuse(master, t);
@@ -1057,14 +2330,16 @@ static void do_thread_cancel(struct thread_master *master)
 			list = &master->event;
 			break;
 		case THREAD_READY:
-			list = &master->ready;
+			list = &master->ready[thread->sclass];
 			break;
 		default:
 			continue;
 			break;
 		}
 
-		if (queue) {
+		if (queue && thread->wheelpos >= 0) {
+			thread_wheel_remove(master->wheel, thread);
+		} else if (queue) {
 			assert(thread->index >= 0);
 			assert(thread == queue->array[thread->index]);
 			pqueue_remove_at(thread->index, queue);
@@ -1189,15 +2464,24 @@ void thread_cancel_async(struct thread_master *master, struct thread **thread,
 }
 /* ------------------------------------------------------------------------- */
 
-static struct timeval *thread_timer_wait(struct pqueue *queue,
+static struct timeval *thread_timer_wait(struct thread_master *m,
 					 struct timeval *timer_val)
 {
+	struct pqueue *queue = m->timer;
+	struct timeval *tw = NULL;
+	struct timeval wheel_val;
+
 	if (queue->size) {
 		struct thread *next_timer = queue->array[0];
 		monotime_until(&next_timer->u.sands, timer_val);
-		return timer_val;
+		tw = timer_val;
 	}
-	return NULL;
+	if (thread_wheel_wait(m->wheel, &wheel_val)
+	    && (!tw || timercmp(&wheel_val, tw, <))) {
+		*timer_val = wheel_val;
+		tw = timer_val;
+	}
+	return tw;
 }
 
 static struct thread *thread_run(struct thread_master *m, struct thread *thread,
@@ -1222,11 +2506,12 @@ static int thread_process_io_helper(struct thread_master *m,
 		thread_array = m->write;
 
 	thread_array[thread->u.fd] = NULL;
-	thread_list_add(&m->ready, thread);
-	thread->type = THREAD_READY;
+	thread_ready_add(m, thread);
+	monotime(&thread->ready);
 	/* if another pthread scheduled this file descriptor for the event we're
 	 * responding to, no problem; we're getting to it now */
-	thread->master->handler.pfds[pos].events &= ~(state);
+	if (pos >= 0)
+		thread->master->handler.pfds[pos].events &= ~(state);
 	return 1;
 }
 
@@ -1273,6 +2558,10 @@ static void thread_process_io(struct thread_master *m, unsigned int num)
 		 * from
 		 * both pfds + update sizes and index */
 		if (pfds[i].revents & POLLNVAL) {
+#ifdef THREAD_IO_EVQUEUE
+			if (fd_evq_active(m))
+				m->handler.fdstate[pfds[i].fd] = 0;
+#endif
 			memmove(m->handler.pfds + i, m->handler.pfds + i + 1,
 				(m->handler.pfdcount - i - 1)
 					* sizeof(struct pollfd));
@@ -1288,6 +2577,66 @@ static void thread_process_io(struct thread_master *m, unsigned int num)
 	}
 }
 
+#ifdef THREAD_IO_EVQUEUE
+/**
+ * Process I/O events returned by the kernel event queue.
+ *
+ * @param m the thread master
+ * @param num the number of entries in m->handler.events
+ */
+static void fd_evq_process(struct thread_master *m, int num)
+{
+	struct fd_handler *h = &m->handler;
+	unsigned char trash[64];
+
+	for (int i = 0; i < num; i++) {
+		uint8_t ready = 0, want, kern;
+		uint8_t *st;
+		int fd;
+
+#if defined(HAVE_EPOLL)
+		uint32_t revents = h->events[i].events;
+
+		fd = h->events[i].data.fd;
+		if (revents & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			ready |= FD_IO_READ;
+		if (revents & (EPOLLOUT | EPOLLERR))
+			ready |= FD_IO_WRITE;
+#else
+		fd = (int)h->events[i].ident;
+		if (h->events[i].filter == EVFILT_READ)
+			ready |= FD_IO_READ;
+		else if (h->events[i].filter == EVFILT_WRITE)
+			ready |= FD_IO_WRITE;
+		if (h->events[i].flags & EV_ERROR)
+			ready |= FD_IO_WANT;
+#endif
+		if (fd == m->io_pipe[0]) {
+			while (read(m->io_pipe[0], &trash, sizeof(trash)) > 0)
+				;
+			continue;
+		}
+
+		st = &h->fdstate[fd];
+		want = *st & FD_IO_WANT;
+
+		if (ready & want & FD_IO_READ)
+			thread_process_io_helper(m, m->read[fd], POLLIN, -1);
+		if (ready & want & FD_IO_WRITE)
+			thread_process_io_helper(m, m->write[fd], POLLOUT, -1);
+
+		*st &= ~ready;
+
+		/* keep read armed after it fired for a task, drop whatever
+		 * else nobody is waiting for */
+		kern = FD_KERN(*st) & ~(ready & ~(want & FD_IO_READ));
+		fd_evq_update(m, fd, kern | (*st & FD_IO_WANT));
+		if (ready & want & FD_IO_READ)
+			*st |= FD_IO_LINGER;
+	}
+}
+#endif /* THREAD_IO_EVQUEUE */
+
 /* Add all timers that have popped to the ready list. */
 static unsigned int thread_process_timers(struct pqueue *queue,
 					  struct timeval *timenow)
@@ -1300,8 +2649,7 @@ static unsigned int thread_process_timers(struct pqueue *queue,
 		if (timercmp(timenow, &thread->u.sands, <))
 			return ready;
 		pqueue_dequeue(queue);
-		thread->type = THREAD_READY;
-		thread_list_add(&thread->master->ready, thread);
+		thread_ready_add(thread->master, thread);
 		ready++;
 	}
 	return ready;
@@ -1317,8 +2665,7 @@ static unsigned int thread_process(struct thread_list *list)
 	for (thread = list->head; thread; thread = next) {
 		next = thread->next;
 		thread_list_delete(list, thread);
-		thread->type = THREAD_READY;
-		thread_list_add(&thread->master->ready, thread);
+		thread_ready_add(thread->master, thread);
 		ready++;
 	}
 	return ready;
@@ -1335,6 +2682,7 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 	struct timeval *tw = NULL;
 
 	int num = 0;
+	int pnum = 0;
 
 	do {
 		/* Handle signals if any */
@@ -1343,6 +2691,11 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 
 		pthread_mutex_lock(&m->mtx);
 
+#ifdef THREAD_IO_EVQUEUE
+		if (!m->handler.evinit)
+			fd_evq_start(m);
+#endif
+
 		/* Process any pending cancellation requests */
 		do_thread_cancel(m);
 
@@ -1350,7 +2703,7 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 		 * Attempt to flush ready queue before going into poll().
 		 * This is performance-critical. Think twice before modifying.
 		 */
-		if ((thread = thread_trim_head(&m->ready))) {
+		if ((thread = thread_ready_next(m))) {
 			fetch = thread_run(m, thread, fetch);
 			if (fetch->ref)
 				*fetch->ref = NULL;
@@ -1364,6 +2717,7 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 		 * Post events to ready queue. This must come before the
 		 * following block since events should occur immediately
 		 */
+		thread_process_posted(m);
 		thread_process(&m->event);
 
 		/*
@@ -1383,13 +2737,18 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 		 * In every case except the last, we need to hit poll() at least
 		 * once per loop to avoid starvation by events
 		 */
-		if (m->ready.count == 0)
-			tw = thread_timer_wait(m->timer, &tv);
+		if (thread_ready_count(m) == 0)
+			tw = thread_timer_wait(m, &tv);
 
-		if (m->ready.count != 0 || (tw && !timercmp(tw, &zerotime, >)))
+		if (thread_ready_count(m) != 0
+		    || (tw && !timercmp(tw, &zerotime, >)))
 			tw = &zerotime;
 
-		if (!tw && m->handler.pfdcount == 0) { /* die */
+		if (!tw && m->handler.pfdcount == 0
+#ifdef THREAD_IO_EVQUEUE
+		    && m->handler.evcount == 0
+#endif
+		    ) { /* die */
 			pthread_mutex_unlock(&m->mtx);
 			fetch = NULL;
 			break;
@@ -1403,12 +2762,31 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 		memcpy(m->handler.copy, m->handler.pfds,
 		       m->handler.copycount * sizeof(struct pollfd));
 
-		pthread_mutex_unlock(&m->mtx);
+#ifdef THREAD_IO_EVQUEUE
+		if (fd_evq_active(m)) {
+			pnum = 0;
+
+			pthread_mutex_unlock(&m->mtx);
+			{
+				/* with fds left to poll(), wait in poll() */
+				if (m->handler.copycount)
+					num = fd_evq_poll(m, tw, &pnum);
+				else
+					num = fd_evq_wait(m,
+							  fd_timeout(m, tw));
+			}
+			pthread_mutex_lock(&m->mtx);
+		} else
+#endif
 		{
-			num = fd_poll(m, m->handler.copy, m->handler.pfdsize,
-				      m->handler.copycount, tw);
+			pthread_mutex_unlock(&m->mtx);
+			{
+				num = fd_poll(m, m->handler.copy,
+					      m->handler.pfdsize,
+					      m->handler.copycount, tw);
+			}
+			pthread_mutex_lock(&m->mtx);
 		}
-		pthread_mutex_lock(&m->mtx);
 
 		/* Handle any errors received in poll() */
 		if (num < 0) {
@@ -1425,11 +2803,25 @@ struct thread *thread_fetch(struct thread_master *m, struct thread *fetch)
 			break;
 		}
 
+		/* a new pass, with fresh class budgets */
+		memset(m->class_used, 0, sizeof(m->class_used));
+		m->class_deferred = 0;
+
 		/* Post timers to ready queue. */
 		monotime(&now);
 		thread_process_timers(m->timer, &now);
+		if (m->wheel)
+			thread_wheel_expire(m, &now);
 
 		/* Post I/O to ready queue. */
+#ifdef THREAD_IO_EVQUEUE
+		if (fd_evq_active(m)) {
+			if (num > 0)
+				fd_evq_process(m, num);
+			if (pnum > 0)
+				thread_process_io(m, pnum);
+		} else
+#endif
 		if (num > 0)
 			thread_process_io(m, num);
 
@@ -1486,6 +2878,37 @@ void thread_set_yield_time(struct thread *thread, unsigned long yield_time)
 	pthread_mutex_unlock(&thread->mtx);
 }
 
+/* Takes effect when the thread next becomes ready, so not for one already
+ * on a ready list. */
+void thread_set_class(struct thread *thread, enum thread_class sclass)
+{
+	pthread_mutex_lock(&thread->mtx);
+	{
+		if (thread->type != THREAD_READY)
+			thread->sclass = sclass;
+	}
+	pthread_mutex_unlock(&thread->mtx);
+}
+
+void funcname_thread_set_func_class(struct thread_master *m,
+				    int (*func)(struct thread *),
+				    enum thread_class sclass,
+				    const char *funcname)
+{
+	struct cpu_thread_history tmp, *hist;
+
+	tmp.func = func;
+	tmp.funcname = funcname;
+
+	pthread_mutex_lock(&m->mtx);
+	{
+		hist = hash_get(m->cpu_record, &tmp,
+				(void *(*)(void *))cpu_record_hash_alloc);
+		hist->sclass = sclass;
+	}
+	pthread_mutex_unlock(&m->mtx);
+}
+
 void thread_getrusage(RUSAGE_T *r)
 {
 	monotime(&r->real);
@@ -1497,12 +2920,26 @@ void thread_getrusage(RUSAGE_T *r)
    to wall clock time stats from gettimeofday. */
 void thread_call(struct thread *thread)
 {
-	unsigned long realtime, cputime;
+	unsigned long realtime, cputime, delay, slow;
 	RUSAGE_T before, after;
+	struct timeval *ready = NULL;
+	struct thread_slow *s;
 
 	GETRUSAGE(&before);
 	thread->real = before.real;
 
+	/* timers are due at their deadline, other tasks once queued */
+	if (thread->add_type == THREAD_TIMER)
+		ready = &thread->u.sands;
+	else if (thread->add_type != THREAD_EXECUTE)
+		ready = &thread->ready;
+	if (ready) {
+		delay = timercmp(&before.real, ready, >)
+				? timeval_elapsed(before.real, *ready)
+				: 0;
+		thread->hist->delay_hist[thread_hist_bucket(delay)]++;
+	}
+
 	pthread_setspecific(thread_current, thread);
 	(*thread->func)(thread);
 	pthread_setspecific(thread_current, NULL);
@@ -1519,6 +2956,26 @@ void thread_call(struct thread *thread)
 
 	++(thread->hist->total_calls);
 	thread->hist->types |= (1 << thread->add_type);
+	if (thread->master) {
+		struct thread_master *m = thread->master;
+
+		m->class_used[thread->sclass] += realtime;
+		m->class_stats[thread->sclass].runs++;
+		m->class_stats[thread->sclass].usecs += realtime;
+	}
+	thread->hist->real_hist[thread_hist_bucket(realtime)]++;
+
+	slow = atomic_load_explicit(&thread_slow_threshold,
+				    memory_order_relaxed);
+	if (slow && realtime >= slow && thread->master) {
+		s = &thread->master->slow[thread->master->slow_next];
+		thread->master->slow_next =
+			(thread->master->slow_next + 1) % THREAD_SLOW_TRACE;
+		s->funcname = thread->funcname;
+		s->start = before.real;
+		s->real = realtime;
+		s->cpu = cputime;
+	}
 
 #ifdef CONSUMED_TIME_CHECK
 	if (realtime > CONSUMED_TIME_CHECK) {
@@ -25,6 +25,15 @@
 #include <pthread.h>
 #include <poll.h>
 #include "monotime.h"
+#include "mpscq.h"
+
+#if defined(HAVE_EPOLL)
+#include <sys/epoll.h>
+#define THREAD_IO_EVQUEUE
+#elif defined(HAVE_KQUEUE)
+#include <sys/event.h>
+#define THREAD_IO_EVQUEUE
+#endif
 
 struct rusage_t {
 	struct rusage cpu;
@@ -42,6 +51,7 @@ struct thread_list {
 };
 
 struct pqueue;
+struct thread_wheel;
 
 struct fd_handler {
 	/* number of pfd that fit in the allocated space of pfds. This is a
@@ -58,6 +68,26 @@ struct fd_handler {
 	struct pollfd *copy;
 	/* number of pollfds stored in copy */
 	nfds_t copycount;
+
+#ifdef THREAD_IO_EVQUEUE
+	/* With an epoll/kqueue backend, pfds only holds descriptors the
+	 * kernel event queue refuses (e.g. regular files); everything else
+	 * is registered with evfd, so readiness costs O(ready fds). */
+	int evfd;
+	/* set once the owner has tried to create evfd */
+	bool evinit;
+	/* per-fd interest and kernel registration state, indexed by fd */
+	uint8_t *fdstate;
+	/* number of fds currently registered with evfd */
+	nfds_t evcount;
+	/* result buffer for one wait call */
+#if defined(HAVE_EPOLL)
+	struct epoll_event *events;
+#else
+	struct kevent *events;
+#endif
+	int eventsize;
+#endif
 };
 
 struct cancel_req {
@@ -66,6 +96,37 @@ struct cancel_req {
 	struct thread **threadref;
 };
 
+/*
+ * Scheduling classes.  Ready tasks run in class order, so protocol timers
+ * and I/O keeping sessions and adjacencies up never queue behind bulk work.
+ * A class may have a budget of wall-clock time per pass of the event loop;
+ * once spent, the rest of its ready tasks wait until timers and I/O have
+ * been looked at again, and lower classes get their turn meanwhile.
+ */
+enum thread_class {
+	THREAD_CLASS_CRITICAL, /* keepalive, hold and hello timers/input */
+	THREAD_CLASS_NORMAL,   /* everything not classed otherwise */
+	THREAD_CLASS_BULK,     /* route processing, work queues */
+	THREAD_CLASS_MGMT,     /* CLI */
+	THREAD_CLASSES,
+};
+
+struct thread_class_stats {
+	unsigned long runs;
+	unsigned long usecs;
+	/* passes cut short for the class by its budget */
+	unsigned long deferred;
+};
+
+/* Tasks that ran for longer than "thread slow-trace" asks for. */
+#define THREAD_SLOW_TRACE 32
+
+struct thread_slow {
+	const char *funcname;
+	struct timeval start; /* monotonic */
+	unsigned long real, cpu;
+};
+
 /* Master of the theads. */
 struct thread_master {
 	char *name;
@@ -73,8 +134,9 @@ struct thread_master {
 	struct thread **read;
 	struct thread **write;
 	struct pqueue *timer;
+	struct thread_wheel *wheel;
 	struct thread_list event;
-	struct thread_list ready;
+	struct thread_list ready[THREAD_CLASSES];
 	struct thread_list unuse;
 	struct list *cancel_req;
 	bool canceled;
@@ -89,6 +151,22 @@ struct thread_master {
 	bool handle_signals;
 	pthread_mutex_t mtx;
 	pthread_t owner;
+	/* see thread_affinity_own(), Requires: masters_mtx */
+	bool own_affinity;
+
+	/* events from thread_post_event(), picked up by thread_fetch() */
+	struct mpscq posted;
+	_Atomic bool posted_wake;
+
+	/* ring of the last slow tasks, slow_next is the oldest entry */
+	struct thread_slow slow[THREAD_SLOW_TRACE];
+	unsigned int slow_next;
+
+	/* usecs run per class in the current pass of the event loop */
+	unsigned long class_used[THREAD_CLASSES];
+	/* classes that went over budget in the current pass */
+	uint8_t class_deferred;
+	struct thread_class_stats class_stats[THREAD_CLASSES];
 };
 
 typedef unsigned char thread_type;
@@ -109,7 +187,10 @@ struct thread {
 		struct timeval sands; /* rest of time sands value. */
 	} u;
 	int index; /* queue position for timers */
+	uint8_t sclass; /* enum thread_class */
+	int wheelpos; /* timer wheel slot, -1 if not on the wheel */
 	struct timeval real;
+	struct timeval ready; /* when made runnable, unless a timer */
 	struct cpu_thread_history *hist; /* cache pointer to cpu_history */
 	unsigned long yield;		 /* yield time in microseconds */
 	const char *funcname;		 /* name of thread function */
@@ -118,6 +199,21 @@ struct thread {
 	pthread_mutex_t mtx;   /* mutex for thread.c functions */
 };
 
+/* Histogram bucket i counts times below 2^i microseconds, and at least
+ * 2^(i-1) for i > 0; the last bucket also counts everything longer. */
+#define THREAD_HIST_BUCKETS 24
+
+static inline unsigned int thread_hist_bucket(unsigned long usecs)
+{
+	unsigned int bucket;
+
+	if (!usecs)
+		return 0;
+
+	bucket = 64 - __builtin_clzll(usecs);
+	return bucket < THREAD_HIST_BUCKETS ? bucket : THREAD_HIST_BUCKETS - 1;
+}
+
 struct cpu_thread_history {
 	int (*func)(struct thread *);
 	unsigned int total_calls;
@@ -128,6 +224,12 @@ struct cpu_thread_history {
 	struct time_stats cpu;
 	thread_type types;
 	const char *funcname;
+	/* class given to tasks running func, enum thread_class */
+	uint8_t sclass;
+
+	/* wall-clock runtime, and delay from runnable to running */
+	unsigned int real_hist[THREAD_HIST_BUCKETS];
+	unsigned int delay_hist[THREAD_HIST_BUCKETS];
 };
 
 /* Struct timeval's tv_usec one second value.  */
@@ -171,12 +273,15 @@ struct cpu_thread_history {
 #define thread_add_timer_tv(m,f,a,v,t) funcname_thread_add_timer_tv(m,f,a,v,t,#f,__FILE__,__LINE__)
 #define thread_add_event(m,f,a,v,t) funcname_thread_add_event(m,f,a,v,t,#f,__FILE__,__LINE__)
 #define thread_execute(m,f,a,v) funcname_thread_execute(m,f,a,v,#f,__FILE__,__LINE__)
+#define thread_post_event(m,f,a,v) funcname_thread_post_event(m,f,a,v,#f,__FILE__,__LINE__)
+#define thread_set_func_class(m,f,c) funcname_thread_set_func_class(m,f,c,#f)
 
 /* Prototypes. */
 extern struct thread_master *thread_master_create(const char *);
 void thread_master_set_name(struct thread_master *master, const char *name);
 extern void thread_master_free(struct thread_master *);
 extern void thread_master_free_unused(struct thread_master *);
+extern void thread_master_set_timer_wheel(struct thread_master *, bool);
 
 extern struct thread *
 funcname_thread_add_read_write(int dir, struct thread_master *,
@@ -206,8 +311,23 @@ extern struct thread *funcname_thread_add_event(struct thread_master *,
 extern void funcname_thread_execute(struct thread_master *,
 				    int (*)(struct thread *), void *, int,
 				    debugargdef);
+
+/*
+ * Schedules an event on a master owned by another pthread without taking
+ * the master's lock, for hand-offs between pthreads.  Unlike
+ * thread_add_event() there is no thread pointer to return, so the event
+ * can't be cancelled.
+ */
+extern void funcname_thread_post_event(struct thread_master *,
+				       int (*)(struct thread *), void *, int,
+				       debugargdef);
 #undef debugargdef
 
+/* Class of the tasks a master runs func for, from the next one scheduled */
+extern void funcname_thread_set_func_class(struct thread_master *,
+					   int (*)(struct thread *),
+					   enum thread_class, const char *);
+
 extern void thread_cancel(struct thread *);
 extern void thread_cancel_async(struct thread_master *, struct thread **,
 				void *);
@@ -219,11 +339,37 @@ extern struct timeval thread_timer_remain(struct thread *);
 extern int thread_should_yield(struct thread *);
 /* set yield time for thread */
 extern void thread_set_yield_time(struct thread *, unsigned long);
+/* set class for a scheduled thread, over its function's */
+extern void thread_set_class(struct thread *, enum thread_class);
 
 /* Internal libfrr exports */
 extern void thread_getrusage(RUSAGE_T *);
 extern void thread_cmd_init(void);
 
+/*
+ * Pins pthreads whose thread master is called name ("main" for the main
+ * pthread) to the CPUs in cpulist, e.g. "0-3,8", or unpins them if cpulist
+ * is NULL.  Running pthreads are pinned right away, others when they are
+ * started with thread_affinity_apply().  Returns -1 on a bad list or when
+ * the platform has no affinity support.
+ */
+extern int thread_affinity_set(const char *name, const char *cpulist);
+/* Returns whether a CPU list is configured for name, and so was applied. */
+extern bool thread_affinity_apply(const char *name, pthread_t thread);
+/*
+ * Marks the owner of m as pinning itself, thread_affinity_set() then leaves
+ * it alone.
+ */
+extern void thread_affinity_own(struct thread_master *m, bool own);
+
+#ifdef GNU_LINUX
+/*
+ * Parses a "0-3,8" style list of CPUs, as in cpuset(7).  Returns -1 on
+ * anything else, including empty lists and stray commas.
+ */
+extern int cpulist_parse(const char *str, cpu_set_t *cpus);
+#endif
+
 /* Returns elapsed real (wall clock) time. */
 extern unsigned long thread_consumed_time(RUSAGE_T *after, RUSAGE_T *before,
 					  unsigned long *cpu_time_elapsed);
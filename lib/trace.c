@@ -0,0 +1,445 @@
+/*
+ * Tracepoints, recorded in binary into per-pthread rings.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "command.h"
+#include "memory.h"
+#include "monotime.h"
+
+DEFINE_MTYPE_STATIC(LIB, TRACE_RING, "Trace ring")
+DEFINE_MTYPE_STATIC(LIB, TRACE_TMP, "Trace temporary")
+
+/* Records kept per pthread, the oldest overwritten first */
+#define TRACE_RING_SIZE 2048
+
+/* Written by its pthread only; "show trace" copies the records out and
+ * drops those overwritten meanwhile.
+ */
+struct trace_ring {
+	struct trace_ring *next;
+	_Atomic uint64_t head;
+	uint64_t cleared; /* records before this were cleared */
+	struct trace_record rec[TRACE_RING_SIZE];
+};
+
+static struct tracepoint *tracepoints;
+
+static pthread_key_t trace_key;
+static pthread_mutex_t trace_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_ring *trace_rings;
+
+static void trace_key_init(void) __attribute__((_CONSTRUCTOR(500)));
+static void trace_key_init(void)
+{
+	/* Rings outlive their pthread, for what it traced before exiting */
+	pthread_key_create(&trace_key, NULL);
+}
+
+static void trace_key_fini(void) __attribute__((_DESTRUCTOR(500)));
+static void trace_key_fini(void)
+{
+	struct trace_ring *ring;
+
+	pthread_key_delete(trace_key);
+	while ((ring = trace_rings)) {
+		trace_rings = ring->next;
+		XFREE(MTYPE_TRACE_RING, ring);
+	}
+}
+
+void trace_register(struct tracepoint *tp)
+{
+	tp->next = tracepoints;
+	if (tracepoints)
+		tracepoints->ref = &tp->next;
+	tp->ref = &tracepoints;
+	tracepoints = tp;
+}
+
+void trace_unregister(struct tracepoint *tp)
+{
+	if (tp->next)
+		tp->next->ref = tp->ref;
+	*tp->ref = tp->next;
+}
+
+static struct trace_ring *trace_ring_get(void)
+{
+	struct trace_ring *ring = pthread_getspecific(trace_key);
+
+	if (ring)
+		return ring;
+
+	ring = XCALLOC(MTYPE_TRACE_RING, sizeof(struct trace_ring));
+	pthread_setspecific(trace_key, ring);
+
+	pthread_mutex_lock(&trace_mtx);
+	ring->next = trace_rings;
+	trace_rings = ring;
+	pthread_mutex_unlock(&trace_mtx);
+
+	return ring;
+}
+
+/* Whether the tracepoint's rate limit lets one more record in. */
+static bool trace_admit(struct tracepoint *tp, time_t now)
+{
+	uint32_t rate, window;
+
+	rate = atomic_load_explicit(&tp->rate, memory_order_relaxed);
+	if (!rate)
+		return true;
+
+	window = atomic_load_explicit(&tp->window, memory_order_relaxed);
+	if (window != (uint32_t)now
+	    && atomic_compare_exchange_weak_explicit(
+		       &tp->window, &window, (uint32_t)now,
+		       memory_order_relaxed, memory_order_relaxed))
+		atomic_store_explicit(&tp->window_count, 0,
+				      memory_order_relaxed);
+
+	if (atomic_fetch_add_explicit(&tp->window_count, 1,
+				      memory_order_relaxed)
+	    < rate)
+		return true;
+
+	atomic_fetch_add_explicit(&tp->suppressed, 1, memory_order_relaxed);
+	return false;
+}
+
+void _trace_event(struct tracepoint *tp, const struct prefix *p,
+		  const char *s, const uint64_t *args)
+{
+	struct trace_ring *ring;
+	struct trace_record *rec;
+	struct timeval now;
+	uint64_t head;
+
+	atomic_fetch_add_explicit(&tp->hits, 1, memory_order_relaxed);
+
+	monotime(&now);
+	if (!trace_admit(tp, now.tv_sec))
+		return;
+
+	ring = trace_ring_get();
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	rec = &ring->rec[head % TRACE_RING_SIZE];
+
+	rec->tp = tp;
+	rec->usecs = now.tv_sec * 1000000ULL + now.tv_usec;
+
+	/* Only IP prefixes, p may point to a smaller prefix struct */
+	memset(&rec->prefix, 0, sizeof(rec->prefix));
+	if (p && p->family == AF_INET) {
+		rec->prefix.family = AF_INET;
+		rec->prefix.prefixlen = p->prefixlen;
+		rec->prefix.u.prefix4 = p->u.prefix4;
+	} else if (p && p->family == AF_INET6) {
+		rec->prefix.family = AF_INET6;
+		rec->prefix.prefixlen = p->prefixlen;
+		rec->prefix.u.prefix6 = p->u.prefix6;
+	}
+	if (s)
+		strlcpy(rec->str, s, sizeof(rec->str));
+	else
+		rec->str[0] = '\0';
+	memcpy(rec->arg, args, sizeof(rec->arg));
+
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Render a record as its tracepoint's format says. */
+static void trace_format(const struct trace_record *rec, char *buf,
+			 size_t len)
+{
+	char pbuf[PREFIX2STR_BUFFER];
+	unsigned int argn = 0;
+	const char *f;
+	size_t pos = 0;
+	int n;
+
+	for (f = rec->tp->fmt; *f && pos + 1 < len; f++) {
+		if (*f != '%' || !f[1]) {
+			buf[pos++] = *f;
+			continue;
+		}
+
+		switch (*++f) {
+		case 'P':
+			if (rec->prefix.family == AF_UNSPEC)
+				strlcpy(pbuf, "-", sizeof(pbuf));
+			else
+				prefix2str(&rec->prefix, pbuf, sizeof(pbuf));
+			n = snprintf(buf + pos, len - pos, "%s", pbuf);
+			break;
+		case 'S':
+			n = snprintf(buf + pos, len - pos, "%s", rec->str);
+			break;
+		case 'U':
+		case 'D':
+		case 'X':
+			if (argn >= TRACE_ARGS) {
+				n = snprintf(buf + pos, len - pos, "?");
+				break;
+			}
+			if (*f == 'U')
+				n = snprintf(buf + pos, len - pos, "%" PRIu64,
+					     rec->arg[argn]);
+			else if (*f == 'D')
+				n = snprintf(buf + pos, len - pos, "%" PRId64,
+					     (int64_t)rec->arg[argn]);
+			else
+				n = snprintf(buf + pos, len - pos, "%" PRIx64,
+					     rec->arg[argn]);
+			argn++;
+			break;
+		default:
+			n = snprintf(buf + pos, len - pos, "%c", *f);
+			break;
+		}
+		if (n > 0)
+			pos += MIN((size_t)n, len - pos - 1);
+	}
+	buf[pos] = '\0';
+}
+
+static int trace_record_cmp(const void *a, const void *b)
+{
+	const struct trace_record *ra = a, *rb = b;
+
+	if (ra->usecs < rb->usecs)
+		return -1;
+	return ra->usecs > rb->usecs;
+}
+
+/* Copy out the records of a ring, those of tp only if given. */
+static unsigned int trace_ring_copy(struct trace_ring *ring,
+				    const struct tracepoint *tp,
+				    struct trace_record *out)
+{
+	uint64_t head, first, i;
+	unsigned int n = 0, kept = 0;
+
+	head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+	first = MAX(first, ring->cleared);
+
+	for (i = first; i < head; i++)
+		out[n++] = ring->rec[i % TRACE_RING_SIZE];
+
+	/* Whatever its pthread wrote over while we copied is garbled; the
+	 * slot of the record at head is the one being written.
+	 */
+	head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	for (i = 0; i < n; i++) {
+		if (first + i + TRACE_RING_SIZE <= head)
+			continue;
+		if (tp && out[i].tp != tp)
+			continue;
+		out[kept++] = out[i];
+	}
+	return kept;
+}
+
+static struct tracepoint *trace_lookup(const char *name)
+{
+	struct tracepoint *tp;
+
+	for (tp = tracepoints; tp; tp = tp->next)
+		if (!strcasecmp(tp->name, name))
+			return tp;
+	return NULL;
+}
+
+DEFUN (debug_trace,
+       debug_trace_cmd,
+       "debug trace WORD [rate-limit (1-1000000)]",
+       DEBUG_STR
+       "Record a tracepoint\n"
+       "Tracepoint name, or all\n"
+       "Record at most so many per second\n"
+       "Records per second\n")
+{
+	uint32_t rate = 0;
+	struct tracepoint *tp;
+	bool all = !strcmp(argv[2]->arg, "all");
+
+	if (argc > 4)
+		rate = strtoul(argv[4]->arg, NULL, 10);
+
+	tp = all ? tracepoints : trace_lookup(argv[2]->arg);
+	if (!tp) {
+		vty_out(vty, "%% No tracepoint %s\n", argv[2]->arg);
+		return CMD_WARNING;
+	}
+
+	for (; tp; tp = all ? tp->next : NULL) {
+		atomic_store_explicit(&tp->rate, rate, memory_order_relaxed);
+		atomic_store_explicit(&tp->enabled, true, memory_order_relaxed);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_debug_trace,
+       no_debug_trace_cmd,
+       "no debug trace WORD [rate-limit (1-1000000)]",
+       NO_STR
+       DEBUG_STR
+       "Record a tracepoint\n"
+       "Tracepoint name, or all\n"
+       "Record at most so many per second\n"
+       "Records per second\n")
+{
+	struct tracepoint *tp;
+	bool all = !strcmp(argv[3]->arg, "all");
+
+	tp = all ? tracepoints : trace_lookup(argv[3]->arg);
+	if (!tp) {
+		vty_out(vty, "%% No tracepoint %s\n", argv[3]->arg);
+		return CMD_WARNING;
+	}
+
+	for (; tp; tp = all ? tp->next : NULL)
+		atomic_store_explicit(&tp->enabled, false,
+				      memory_order_relaxed);
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_tracepoints,
+       show_tracepoints_cmd,
+       "show tracepoints",
+       SHOW_STR
+       "Tracepoints and their counters\n")
+{
+	struct tracepoint *tp;
+	uint32_t rate;
+
+	vty_out(vty, "%-32s %-7s %10s %12s %12s\n", "Tracepoint", "State",
+		"Rate", "Hits", "Suppressed");
+	for (tp = tracepoints; tp; tp = tp->next) {
+		rate = atomic_load_explicit(&tp->rate, memory_order_relaxed);
+		vty_out(vty, "%-32s %-7s ", tp->name,
+			atomic_load_explicit(&tp->enabled, memory_order_relaxed)
+				? "on"
+				: "off");
+		if (rate)
+			vty_out(vty, "%8u/s", rate);
+		else
+			vty_out(vty, "%10s", "-");
+		vty_out(vty, " %12" PRIu64 " %12" PRIu64 "\n",
+			atomic_load_explicit(&tp->hits, memory_order_relaxed),
+			atomic_load_explicit(&tp->suppressed,
+					     memory_order_relaxed));
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_trace,
+       show_trace_cmd,
+       "show trace [WORD]",
+       SHOW_STR
+       "Recorded tracepoints\n"
+       "Only this tracepoint\n")
+{
+	struct timeval mono_now, wall_now, ago, wall;
+	struct tracepoint *tp = NULL;
+	struct trace_record *recs;
+	struct trace_ring *ring;
+	unsigned int rings = 0, n = 0, i;
+	char timebuf[64], line[512];
+	struct tm tm;
+
+	if (argc > 2) {
+		tp = trace_lookup(argv[2]->arg);
+		if (!tp) {
+			vty_out(vty, "%% No tracepoint %s\n", argv[2]->arg);
+			return CMD_WARNING;
+		}
+	}
+
+	monotime(&mono_now);
+	gettimeofday(&wall_now, NULL);
+
+	pthread_mutex_lock(&trace_mtx);
+	for (ring = trace_rings; ring; ring = ring->next)
+		rings++;
+	recs = XMALLOC(MTYPE_TRACE_TMP,
+		       (rings ? rings : 1) * TRACE_RING_SIZE
+			       * sizeof(struct trace_record));
+	for (ring = trace_rings; ring; ring = ring->next)
+		n += trace_ring_copy(ring, tp, recs + n);
+	pthread_mutex_unlock(&trace_mtx);
+
+	qsort(recs, n, sizeof(struct trace_record), trace_record_cmp);
+
+	for (i = 0; i < n; i++) {
+		ago.tv_sec = (mono_now.tv_sec * 1000000ULL + mono_now.tv_usec
+			      - recs[i].usecs)
+			     / 1000000;
+		ago.tv_usec = (mono_now.tv_sec * 1000000ULL + mono_now.tv_usec
+			       - recs[i].usecs)
+			      % 1000000;
+		timersub(&wall_now, &ago, &wall);
+		localtime_r(&wall.tv_sec, &tm);
+		strftime(timebuf, sizeof(timebuf), "%Y/%m/%d %H:%M:%S", &tm);
+		snprintf(timebuf + strlen(timebuf),
+			 sizeof(timebuf) - strlen(timebuf), ".%06ld",
+			 (long)wall.tv_usec);
+
+		trace_format(&recs[i], line, sizeof(line));
+		vty_out(vty, "%s %s: %s\n", timebuf, recs[i].tp->name, line);
+	}
+
+	XFREE(MTYPE_TRACE_TMP, recs);
+	return CMD_SUCCESS;
+}
+
+DEFUN (clear_trace,
+       clear_trace_cmd,
+       "clear trace",
+       CLEAR_STR
+       "Recorded tracepoints\n")
+{
+	struct trace_ring *ring;
+	struct tracepoint *tp;
+
+	pthread_mutex_lock(&trace_mtx);
+	for (ring = trace_rings; ring; ring = ring->next)
+		ring->cleared = atomic_load_explicit(&ring->head,
+						     memory_order_acquire);
+	pthread_mutex_unlock(&trace_mtx);
+
+	for (tp = tracepoints; tp; tp = tp->next) {
+		atomic_store_explicit(&tp->hits, 0, memory_order_relaxed);
+		atomic_store_explicit(&tp->suppressed, 0,
+				      memory_order_relaxed);
+	}
+	return CMD_SUCCESS;
+}
+
+void trace_cmd_init(void)
+{
+	install_element(VIEW_NODE, &show_trace_cmd);
+	install_element(VIEW_NODE, &show_tracepoints_cmd);
+	install_element(ENABLE_NODE, &clear_trace_cmd);
+	install_element(ENABLE_NODE, &debug_trace_cmd);
+	install_element(ENABLE_NODE, &no_debug_trace_cmd);
+}
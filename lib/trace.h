@@ -0,0 +1,102 @@
+/*
+ * Tracepoints, recorded in binary into per-pthread rings.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _FRR_TRACE_H
+#define _FRR_TRACE_H
+
+#include "frratomic.h"
+#include "prefix.h"
+
+/* A tracepoint records its prefix, a short string and its arguments as
+ * they are, with no formatting; "show trace" decodes the records with the
+ * tracepoint's format, in which
+ *   %P is the prefix, if an IPv4 or IPv6 one, %S the string,
+ *   %U, %D and %X the next argument as unsigned, signed or hex.
+ * Tracepoints are off until "debug trace NAME", and may be rate-limited
+ * to so many records per second.
+ *
+ * macro usage:
+ *
+ *  mydaemon.c
+ *    DEFINE_TRACEPOINT(MYD_ROUTE_ADD, "%P from %S, metric %U")
+ *    trace_event(MYD_ROUTE_ADD, &rn->p, nbr->name, metric);
+ *
+ *  An argument that takes work to compute can be put behind
+ *  trace_enabled(MYD_ROUTE_ADD).
+ */
+#define TRACE_ARGS 4
+#define TRACE_STRLEN 32
+
+struct tracepoint {
+	struct tracepoint *next, **ref;
+	const char *name;
+	const char *fmt;
+
+	_Atomic bool enabled;
+	/* Records per second, 0 for no limit */
+	_Atomic uint32_t rate;
+	_Atomic uint32_t window;
+	_Atomic uint32_t window_count;
+
+	_Atomic uint64_t hits;
+	_Atomic uint64_t suppressed;
+};
+
+struct trace_record {
+	const struct tracepoint *tp;
+	uint64_t usecs; /* monotonic */
+	struct prefix prefix; /* AF_UNSPEC for none */
+	char str[TRACE_STRLEN];
+	uint64_t arg[TRACE_ARGS];
+};
+
+#define DECLARE_TRACEPOINT(name) extern struct tracepoint _tp_##name;
+#define DEFINE_TRACEPOINT(tname, tfmt)                                         \
+	struct tracepoint _tp_##tname = {                                      \
+		.name = #tname,                                                \
+		.fmt = tfmt,                                                   \
+	};                                                                     \
+	static void _tpinit_##tname(void) __attribute__((_CONSTRUCTOR(1100))); \
+	static void _tpinit_##tname(void)                                      \
+	{                                                                      \
+		trace_register(&_tp_##tname);                                  \
+	}                                                                      \
+	static void _tpfini_##tname(void) __attribute__((_DESTRUCTOR(1100)));  \
+	static void _tpfini_##tname(void)                                      \
+	{                                                                      \
+		trace_unregister(&_tp_##tname);                                \
+	}
+
+#define trace_enabled(tname)                                                   \
+	atomic_load_explicit(&_tp_##tname.enabled, memory_order_relaxed)
+
+#define trace_event(tname, p, s, ...)                                          \
+	do {                                                                   \
+		if (trace_enabled(tname))                                      \
+			_trace_event(&_tp_##tname, (p), (s),                   \
+				     (const uint64_t[TRACE_ARGS]){__VA_ARGS__}); \
+	} while (0)
+
+extern void trace_register(struct tracepoint *tp);
+extern void trace_unregister(struct tracepoint *tp);
+extern void _trace_event(struct tracepoint *tp, const struct prefix *p,
+			 const char *s, const uint64_t *args);
+
+extern void trace_cmd_init(void);
+
+#endif /* _FRR_TRACE_H */
@@ -38,6 +38,7 @@
 
 #include <arpa/telnet.h>
 #include <termios.h>
+#include <poll.h>
 
 DEFINE_MTYPE_STATIC(LIB, VTY, "VTY")
 DEFINE_MTYPE_STATIC(LIB, VTY_OUT_BUF, "VTY output buffer")
@@ -64,6 +65,12 @@ extern struct host host;
 /* Vector which store each vty structure. */
 static vector vtyvec;
 
+/* vtys that turned "terminal monitor" on and did not turn it off or close
+ * yet; failing vtys clear their flag without coming off this, so it may
+ * be more than there are.
+ */
+static _Atomic unsigned int vty_monitors;
+
 /* Vty timeout value. */
 static unsigned long vty_timeout_val = VTY_TIMEOUT_DEFAULT;
 
@@ -109,6 +116,27 @@ void vty_endframe(struct vty *vty, const char *endtext)
 	vty->frame_pos = 0;
 }
 
+/* How long vty_out_flush() waits for the client to make room (msec). */
+#define VTY_OUT_FLUSH_WAIT 1000
+
+/* Output buffered for a client beyond which vty_out() starts writing it out
+ * while the command runs, and deferred output stops producing more. */
+#define VTY_OBUF_MAX (256 * 1024)
+
+/* Whether output can go to the client before the command is done.  Paged
+ * terminals get theirs a screen at a time from vty_flush(). */
+static bool vty_out_early(struct vty *vty)
+{
+	switch (vty->type) {
+	case VTY_SHELL_SERV:
+		return true;
+	case VTY_TERM:
+		return vty->lines == 0 || vty->width == 0 || vty->height == 0;
+	default:
+		return false;
+	}
+}
+
 /* VTY standard output function. */
 int vty_out(struct vty *vty, const char *format, ...)
 {
@@ -164,6 +192,11 @@ int vty_out(struct vty *vty, const char *format, ...)
 		else
 			buffer_put_crlf(vty->obuf, (uint8_t *)p, len);
 
+		/* Hand what the client will take to the socket rather than
+		 * let it pile up; errors are left to the regular flush. */
+		if (buffer_full(vty->obuf) && vty_out_early(vty))
+			buffer_flush_available(vty->obuf, vty->wfd);
+
 		/* If p is not different with buf, it is allocated buffer.  */
 		if (p != buf)
 			XFREE(MTYPE_VTY_OUT_BUF, p);
@@ -172,6 +205,78 @@ int vty_out(struct vty *vty, const char *format, ...)
 	return len;
 }
 
+bool vty_out_flush(struct vty *vty)
+{
+	struct pollfd pfd;
+
+	if (vty_shell(vty)) {
+		fflush(stdout);
+		return true;
+	}
+
+	if (!vty_out_early(vty))
+		return false;
+
+	pfd.fd = vty->wfd;
+	pfd.events = POLLOUT;
+	for (;;) {
+		switch (buffer_flush_available(vty->obuf, vty->wfd)) {
+		case BUFFER_EMPTY:
+			return true;
+		case BUFFER_ERROR:
+			/* left for the end-of-command flush to deal with */
+			return false;
+		case BUFFER_PENDING:
+			break;
+		}
+		if (poll(&pfd, 1, VTY_OUT_FLUSH_WAIT) <= 0)
+			return false;
+	}
+}
+
+int vty_output_defer(struct vty *vty, bool (*func)(struct vty *vty, void *arg),
+		     void (*free)(void *arg), void *arg)
+{
+	if (vty_shell(vty) || !vty_out_early(vty) || vty->output_func) {
+		while (func(vty, arg))
+			;
+		if (free)
+			free(arg);
+		return CMD_SUCCESS;
+	}
+
+	vty->output_func = func;
+	vty->output_free = free;
+	vty->output_arg = arg;
+	return CMD_SUCCESS;
+}
+
+static void vty_output_stop(struct vty *vty)
+{
+	if (!vty->output_func)
+		return;
+
+	if (vty->output_free)
+		vty->output_free(vty->output_arg);
+	vty->output_func = NULL;
+	vty->output_free = NULL;
+	vty->output_arg = NULL;
+}
+
+/* Write the next parts of deferred output, as many as fit below the output
+ * buffer limit; true once all of it is out. */
+static bool vty_output_more(struct vty *vty)
+{
+	do {
+		if (!vty->output_func(vty, vty->output_arg)) {
+			vty_output_stop(vty);
+			return true;
+		}
+	} while (!buffer_full(vty->obuf));
+
+	return false;
+}
+
 static int vty_log_out(struct vty *vty, const char *level,
 		       const char *proto_str, const char *format,
 		       struct timestamp_control *ctl, va_list va)
@@ -323,6 +428,7 @@ struct vty *vty_new()
 
 	new->fd = new->wfd = -1;
 	new->obuf = buffer_new(0); /* Use default buffer size. */
+	buffer_set_max(new->obuf, VTY_OBUF_MAX);
 	new->buf = XCALLOC(MTYPE_VTY, VTY_BUFSIZ);
 	new->error_buf = XCALLOC(MTYPE_VTY, VTY_BUFSIZ);
 	new->max = VTY_BUFSIZ;
@@ -1297,7 +1403,8 @@ static int vty_execute(struct vty *vty)
 	vty->cp = vty->length = 0;
 	vty_clear_buf(vty);
 
-	if (vty->status != VTY_CLOSE)
+	/* with deferred output, the prompt comes after it */
+	if (vty->status != VTY_CLOSE && !vty->output_func)
 		vty_prompt(vty);
 
 	return ret;
@@ -1340,33 +1447,11 @@ static void vty_buffer_reset(struct vty *vty)
 	vty_redraw_line(vty);
 }
 
-/* Read data via vty socket. */
-static int vty_read(struct thread *thread)
+/* Handle what was typed.  What follows a command that deferred its output
+ * is held back until that output is done. */
+static void vty_input(struct vty *vty, unsigned char *buf, int nbytes)
 {
 	int i;
-	int nbytes;
-	unsigned char buf[VTY_READ_BUFSIZ];
-
-	int vty_sock = THREAD_FD(thread);
-	struct vty *vty = THREAD_ARG(thread);
-	vty->t_read = NULL;
-
-	/* Read raw data from socket */
-	if ((nbytes = read(vty->fd, buf, VTY_READ_BUFSIZ)) <= 0) {
-		if (nbytes < 0) {
-			if (ERRNO_IO_RETRY(errno)) {
-				vty_event(VTY_READ, vty_sock, vty);
-				return 0;
-			}
-			vty->monitor = 0; /* disable monitoring to avoid
-					     infinite recursion */
-			zlog_warn(
-				"%s: read error on vty client fd %d, closing: %s",
-				__func__, vty->fd, safe_strerror(errno));
-			buffer_reset(vty->obuf);
-		}
-		vty->status = VTY_CLOSE;
-	}
 
 	for (i = 0; i < nbytes; i++) {
 		if (buf[i] == IAC) {
@@ -1521,14 +1606,67 @@ static int vty_read(struct thread *thread)
 				vty_self_insert(vty, buf[i]);
 			break;
 		}
+
+		if (vty->output_func) {
+			i++;
+			if (i < nbytes) {
+				vty->input_held = XMALLOC(MTYPE_VTY, nbytes - i);
+				memcpy(vty->input_held, buf + i, nbytes - i);
+				vty->input_held_len = nbytes - i;
+			}
+			return;
+		}
+	}
+}
+
+static void vty_input_resume(struct vty *vty)
+{
+	unsigned char *buf = vty->input_held;
+
+	if (!buf)
+		return;
+
+	vty->input_held = NULL;
+	vty_input(vty, buf, vty->input_held_len);
+	XFREE(MTYPE_VTY, buf);
+}
+
+/* Read data via vty socket. */
+static int vty_read(struct thread *thread)
+{
+	int nbytes;
+	unsigned char buf[VTY_READ_BUFSIZ];
+
+	int vty_sock = THREAD_FD(thread);
+	struct vty *vty = THREAD_ARG(thread);
+	vty->t_read = NULL;
+
+	/* Read raw data from socket */
+	if ((nbytes = read(vty->fd, buf, VTY_READ_BUFSIZ)) <= 0) {
+		if (nbytes < 0) {
+			if (ERRNO_IO_RETRY(errno)) {
+				vty_event(VTY_READ, vty_sock, vty);
+				return 0;
+			}
+			vty->monitor = 0; /* disable monitoring to avoid
+					     infinite recursion */
+			zlog_warn(
+				"%s: read error on vty client fd %d, closing: %s",
+				__func__, vty->fd, safe_strerror(errno));
+			buffer_reset(vty->obuf);
+		}
+		vty->status = VTY_CLOSE;
 	}
 
+	vty_input(vty, buf, nbytes);
+
 	/* Check status. */
 	if (vty->status == VTY_CLOSE)
 		vty_close(vty);
 	else {
 		vty_event(VTY_WRITE, vty->wfd, vty);
-		vty_event(VTY_READ, vty_sock, vty);
+		if (!vty->output_func)
+			vty_event(VTY_READ, vty_sock, vty);
 	}
 	return 0;
 }
@@ -1574,7 +1712,16 @@ static int vty_flush(struct thread *thread)
 	case BUFFER_EMPTY:
 		if (vty->status == VTY_CLOSE)
 			vty_close(vty);
-		else {
+		else if (vty->output_func) {
+			if (vty_output_more(vty)) {
+				vty_prompt(vty);
+				vty_input_resume(vty);
+				if (!vty->output_func)
+					vty_event(VTY_READ, vty_sock, vty);
+			} else
+				vty_event(VTY_TIMEOUT_RESET, 0, vty);
+			vty_event(VTY_WRITE, vty_sock, vty);
+		} else {
 			vty->status = VTY_NORMAL;
 			if (vty->lines == 0)
 				vty_event(VTY_READ, vty_sock, vty);
@@ -2044,6 +2191,14 @@ static int vtysh_flush(struct vty *vty)
 		return -1;
 		break;
 	case BUFFER_EMPTY:
+		if (vty->output_func) {
+			if (vty_output_more(vty)) {
+				uint8_t header[4] = {0, 0, 0, CMD_SUCCESS};
+
+				buffer_put(vty->obuf, header, 4);
+			}
+			vty_event(VTYSH_WRITE, vty->wfd, vty);
+		}
 		break;
 	}
 	return 0;
@@ -2114,6 +2269,15 @@ static int vtysh_read(struct thread *thread)
 				if (ret == CMD_SUSPEND)
 					break;
 
+				/* the result follows deferred output, from
+				 * vtysh_flush() */
+				if (vty->output_func) {
+					if (!vty->t_write)
+						vty_event(VTYSH_WRITE, sock,
+							  vty);
+					break;
+				}
+
 				/* warning: watchfrr hardcodes this result write
 				 */
 				header[3] = ret;
@@ -2167,6 +2331,19 @@ void vty_close(struct vty *vty)
 	int i;
 	bool was_stdio = false;
 
+	vty_output_stop(vty);
+	if (vty->config_xact) {
+		vty->config_xact = false;
+		cmd_config_commit();
+	}
+	if (vty->monitor) {
+		atomic_fetch_sub_explicit(&vty_monitors, 1,
+					  memory_order_relaxed);
+		vty->monitor = 0;
+	}
+	if (vty->input_held)
+		XFREE(MTYPE_VTY, vty->input_held);
+
 	/* Cancel threads.*/
 	if (vty->t_read)
 		thread_cancel(vty->t_read);
@@ -2447,7 +2624,9 @@ void vty_read_config(const char *config_file, char *config_default_dir)
 			fullpath = config_default_dir;
 	}
 
+	cmd_config_begin();
 	vty_read_file(confp);
+	cmd_config_commit();
 
 	fclose(confp);
 
@@ -2801,12 +2980,20 @@ DEFUN (no_service_advanced_vty,
 	return CMD_SUCCESS;
 }
 
+bool vty_log_monitored(void)
+{
+	return atomic_load_explicit(&vty_monitors, memory_order_relaxed) > 0;
+}
+
 DEFUN_NOSH (terminal_monitor,
        terminal_monitor_cmd,
        "terminal monitor",
        "Set terminal line parameters\n"
        "Copy debug output to the current terminal line\n")
 {
+	if (!vty->monitor)
+		atomic_fetch_add_explicit(&vty_monitors, 1,
+					  memory_order_relaxed);
 	vty->monitor = 1;
 	return CMD_SUCCESS;
 }
@@ -2818,6 +3005,9 @@ DEFUN_NOSH (terminal_no_monitor,
        NO_STR
        "Copy debug output to the current terminal line\n")
 {
+	if (vty->monitor)
+		atomic_fetch_sub_explicit(&vty_monitors, 1,
+					  memory_order_relaxed);
 	vty->monitor = 0;
 	return CMD_SUCCESS;
 }
@@ -2992,6 +3182,10 @@ void vty_init(struct thread_master *master_thread)
 	vtyvec = vector_init(VECTOR_MIN_SIZE);
 
 	vty_master = master_thread;
+	thread_set_func_class(vty_master, vty_read, THREAD_CLASS_MGMT);
+#ifdef VTYSH
+	thread_set_func_class(vty_master, vtysh_read, THREAD_CLASS_MGMT);
+#endif
 
 	atexit(vty_stdio_atexit);
 
@@ -115,6 +115,9 @@ struct vty {
 	/* In configure mode. */
 	int config;
 
+	/* opened a config transaction, with XFRR_start_configuration */
+	bool config_xact;
+
 	/* Read and write thread. */
 	struct thread *t_read;
 	struct thread *t_write;
@@ -131,6 +134,15 @@ struct vty {
 	 * without any output. */
 	size_t frame_pos;
 	char frame[1024];
+
+	/* Rest of the output of the last command, see vty_output_defer() */
+	bool (*output_func)(struct vty *vty, void *arg);
+	void (*output_free)(void *arg);
+	void *output_arg;
+
+	/* Terminal input that came after that command, meanwhile */
+	unsigned char *input_held;
+	int input_held_len;
 };
 
 static inline void vty_push_context(struct vty *vty, int node, uint64_t id)
@@ -224,6 +236,26 @@ extern int vty_out(struct vty *, const char *, ...) PRINTF_ATTRIBUTE(2, 3);
 extern void vty_frame(struct vty *, const char *, ...) PRINTF_ATTRIBUTE(2, 3);
 extern void vty_endframe(struct vty *, const char *);
 
+/* Write out what has been vty_out()'d so far, while a command is still
+ * producing output.  Returns false if the client does not keep up, or the
+ * output cannot be written early; it then stays buffered as usual. */
+extern bool vty_out_flush(struct vty *vty);
+
+/*
+ * Let a command with a lot of output produce it a part at a time, so that
+ * neither the output nor the time taken pile up.  func writes the next part
+ * each time earlier output has been sent, as long as the output buffered for
+ * the client stays below its limit, until it returns false; free
+ * then releases arg, as it does if the vty is closed before.  The prompt or
+ * command result follows the last part.
+ *
+ * Where output cannot be deferred (configuration files, paged terminals),
+ * func is run to completion right away.  Returns the command result.
+ */
+extern int vty_output_defer(struct vty *vty,
+			    bool (*func)(struct vty *vty, void *arg),
+			    void (*free)(void *arg), void *arg);
+
 extern void vty_read_config(const char *, char *);
 extern void vty_time_print(struct vty *, int);
 extern void vty_serv_sock(const char *, unsigned short, const char *);
@@ -231,6 +263,8 @@ extern void vty_close(struct vty *);
 extern char *vty_get_cwd(void);
 extern void vty_log(const char *level, const char *proto, const char *fmt,
 		    struct timestamp_control *, va_list);
+/* Whether vty_log() may have a terminal monitor to write to. */
+extern bool vty_log_monitored(void);
 extern int vty_config_lock(struct vty *);
 extern int vty_config_unlock(struct vty *);
 extern void vty_config_lockless(void);
@@ -39,7 +39,10 @@ static struct list _work_queues;
  */
 static struct list *work_queues = &_work_queues;
 
-#define WORK_QUEUE_MIN_GRANULARITY 1
+#define WORK_QUEUE_MIN_GRANULARITY 1U
+
+/* In adaptive mode, yield checks made per max_stall of work */
+#define WORK_QUEUE_STALL_CHECKS 4
 
 static struct work_queue_item *work_queue_item_new(struct work_queue *wq)
 {
@@ -86,6 +89,7 @@ struct work_queue *work_queue_new(struct thread_master *m,
 
 	new->name = XSTRDUP(MTYPE_WORK_QUEUE_NAME, queue_name);
 	new->master = m;
+	thread_set_func_class(m, work_queue_run, THREAD_CLASS_BULK);
 	SET_FLAG(new->flags, WQ_UNPLUGGED);
 
 	STAILQ_INIT(&new->items);
@@ -130,8 +134,28 @@ bool work_queue_is_scheduled(struct work_queue *wq)
 	return (wq->thread != NULL);
 }
 
+/* hold time of the first run after the queue went idle */
+static unsigned int work_queue_hold(struct work_queue *wq)
+{
+	if (!wq->spec.max_stall || !wq->hold || wq->hold > wq->spec.hold)
+		return wq->spec.hold;
+	return wq->hold;
+}
+
+/* time a run may take before it yields, leaving room for the items
+ * processed between two checks */
+static unsigned long work_queue_yield(struct work_queue *wq)
+{
+	if (!wq->spec.max_stall)
+		return wq->spec.yield;
+	return wq->spec.max_stall
+	       - wq->spec.max_stall / WORK_QUEUE_STALL_CHECKS;
+}
+
 static int work_queue_schedule(struct work_queue *wq, unsigned int delay)
 {
+	unsigned long yield;
+
 	/* if appropriate, schedule work queue thread */
 	if (CHECK_FLAG(wq->flags, WQ_UNPLUGGED) && (wq->thread == NULL)
 	    && !work_queue_empty(wq)) {
@@ -139,8 +163,9 @@ static int work_queue_schedule(struct work_queue *wq, unsigned int delay)
 		thread_add_timer_msec(wq->master, work_queue_run, wq, delay,
 				      &wq->thread);
 		/* set thread yield time, if needed */
-		if (wq->thread && wq->spec.yield != THREAD_YIELD_TIME_SLOT)
-			thread_set_yield_time(wq->thread, wq->spec.yield);
+		yield = work_queue_yield(wq);
+		if (wq->thread && yield != THREAD_YIELD_TIME_SLOT)
+			thread_set_yield_time(wq->thread, yield);
 		return 1;
 	} else
 		return 0;
@@ -158,13 +183,24 @@ void work_queue_add(struct work_queue *wq, void *data)
 	}
 
 	item->data = data;
+	monotime(&item->queued);
 	work_queue_item_enqueue(wq, item);
 
-	work_queue_schedule(wq, wq->spec.hold);
+	work_queue_schedule(wq, work_queue_hold(wq));
 
 	return;
 }
 
+/* item done with, record its latency */
+static void work_queue_item_done(struct work_queue *wq,
+				 struct work_queue_item *item)
+{
+	int64_t latency = monotime_since(&item->queued, NULL);
+
+	wq->latency_hist[thread_hist_bucket(latency > 0 ? latency : 0)]++;
+	work_queue_item_remove(wq, item);
+}
+
 static void work_queue_item_requeue(struct work_queue *wq,
 				    struct work_queue_item *item)
 {
@@ -192,7 +228,7 @@ DEFUN (show_work_queues,
 	for (ALL_LIST_ELEMENTS_RO(work_queues, node, wq)) {
 		vty_out(vty, "%c %8d %5d %8ld %8ld %7d %6d %8ld %6u %s\n",
 			(CHECK_FLAG(wq->flags, WQ_UNPLUGGED) ? ' ' : 'P'),
-			work_queue_item_count(wq), wq->spec.hold, wq->runs,
+			work_queue_item_count(wq), work_queue_hold(wq), wq->runs,
 			wq->yields, wq->cycles.best, wq->cycles.granularity,
 			wq->cycles.total,
 			(wq->runs) ? (unsigned int)(wq->cycles.total / wq->runs)
@@ -203,9 +239,49 @@ DEFUN (show_work_queues,
 	return CMD_SUCCESS;
 }
 
+static void vty_out_wq_hist(struct vty *vty, const char *what,
+			    unsigned int *hist)
+{
+	int i;
+
+	vty_out(vty, "    %-8s", what);
+	for (i = 0; i < THREAD_HIST_BUCKETS - 1; i++)
+		if (hist[i])
+			vty_out(vty, " <%lu:%u", 1UL << i, hist[i]);
+	if (hist[i])
+		vty_out(vty, " >=%lu:%u", 1UL << (i - 1), hist[i]);
+	vty_out(vty, "\n");
+}
+
+DEFUN (show_work_queues_histogram,
+       show_work_queues_histogram_cmd,
+       "show work-queues histogram",
+       SHOW_STR
+       "Work Queue information\n"
+       "Item latency and run duration histograms\n")
+{
+	struct listnode *node;
+	struct work_queue *wq;
+
+	vty_out(vty, "Number of items or runs per bucket, bucket bounds in usecs\n");
+
+	for (ALL_LIST_ELEMENTS_RO(work_queues, node, wq)) {
+		vty_out(vty, "\n  %s: %lu runs, longest %lu usecs", wq->name,
+			wq->runs, wq->run_max);
+		if (wq->spec.max_stall)
+			vty_out(vty, ", adaptive to %lu usecs", wq->spec.max_stall);
+		vty_out(vty, "\n");
+		vty_out_wq_hist(vty, "latency", wq->latency_hist);
+		vty_out_wq_hist(vty, "run", wq->run_hist);
+	}
+
+	return CMD_SUCCESS;
+}
+
 void workqueue_cmd_init(void)
 {
 	install_element(VIEW_NODE, &show_work_queues_cmd);
+	install_element(VIEW_NODE, &show_work_queues_histogram_cmd);
 }
 
 /* 'plug' a queue: Stop it from being scheduled,
@@ -229,7 +305,38 @@ void work_queue_unplug(struct work_queue *wq)
 	SET_FLAG(wq->flags, WQ_UNPLUGGED);
 
 	/* if thread isnt already waiting, add one */
-	work_queue_schedule(wq, wq->spec.hold);
+	work_queue_schedule(wq, work_queue_hold(wq));
+}
+
+/* adaptive mode: tune granularity so yield checks come often enough for
+ * a run to end close to max_stall, and the hold time to the load
+ */
+static void work_queue_adapt(struct work_queue *wq, unsigned int cycles,
+			     unsigned long runtime, bool yielded)
+{
+	unsigned long per_cycle, granularity;
+	unsigned int hold = work_queue_hold(wq);
+	unsigned int min_hold = wq->spec.hold / WORK_QUEUE_HOLD_RANGE;
+
+	if (cycles) {
+		per_cycle = MAX(runtime / cycles, 1UL);
+		granularity = wq->spec.max_stall / WORK_QUEUE_STALL_CHECKS
+			      / per_cycle;
+		wq->cycles.granularity =
+			MIN(MAX(granularity, WORK_QUEUE_MIN_GRANULARITY),
+			    UINT_MAX);
+	}
+
+	/* a run that drained the queue well within the budget means items
+	 * sat out the hold time for nothing; one that ran into the budget
+	 * means they come in bursts, which a longer hold batches up
+	 */
+	if (yielded)
+		hold = MIN(hold * 2, wq->spec.hold);
+	else if (work_queue_empty(wq)
+		 && runtime < wq->spec.max_stall / WORK_QUEUE_STALL_CHECKS)
+		hold = MAX(hold / 2, MAX(min_hold, 1U));
+	wq->hold = hold;
 }
 
 /* timer thread to process a work queue
@@ -243,11 +350,14 @@ int work_queue_run(struct thread *thread)
 	wq_item_status ret;
 	unsigned int cycles = 0;
 	char yielded = 0;
+	struct timeval start;
+	unsigned long runtime;
 
 	wq = THREAD_ARG(thread);
 	wq->thread = NULL;
 
 	assert(wq);
+	monotime(&start);
 
 	/* calculate cycle granularity:
 	 * list iteration == 1 run
@@ -279,7 +389,7 @@ int work_queue_run(struct thread *thread)
 			/* run error handler, if any */
 			if (wq->spec.errorfunc)
 				wq->spec.errorfunc(wq, item->data);
-			work_queue_item_remove(wq, item);
+			work_queue_item_done(wq, item);
 			continue;
 		}
 
@@ -328,7 +438,7 @@ int work_queue_run(struct thread *thread)
 		/* fallthru */
 		case WQ_SUCCESS:
 		default: {
-			work_queue_item_remove(wq, item);
+			work_queue_item_done(wq, item);
 			break;
 		}
 		}
@@ -370,6 +480,13 @@ stats:
 	}
 #undef WQ_HYSTERIS_FACTOR
 
+	runtime = monotime_since(&start, NULL);
+	wq->run_hist[thread_hist_bucket(runtime)]++;
+	if (runtime > wq->run_max)
+		wq->run_max = runtime;
+	if (wq->spec.max_stall)
+		work_queue_adapt(wq, cycles, runtime, yielded);
+
 	wq->runs++;
 	wq->cycles.total += cycles;
 	if (yielded)
@@ -25,11 +25,15 @@
 
 #include "memory.h"
 #include "queue.h"
+#include "thread.h"
 DECLARE_MTYPE(WORK_QUEUE)
 
 /* Hold time for the initial schedule of a queue run, in  millisec */
 #define WORK_QUEUE_DEFAULT_HOLD 50
 
+/* In adaptive mode, how far below spec.hold the hold time may drop */
+#define WORK_QUEUE_HOLD_RANGE 8
+
 /* action value, for use by item processor and item error handlers */
 typedef enum {
 	WQ_SUCCESS = 0,
@@ -47,6 +51,7 @@ struct work_queue_item {
 	STAILQ_ENTRY(work_queue_item) wq;
 	void *data;	 /* opaque data */
 	unsigned short ran; /* # of times item has been run */
+	struct timeval queued; /* when added, for latency stats */
 };
 
 #define WQ_UNPLUGGED	(1 << 0) /* available for draining */
@@ -90,6 +95,13 @@ struct work_queue {
 
 		unsigned long
 			yield; /* yield time in us for associated thread */
+
+		/* adaptive mode, if non-zero: longest a run should hold up
+		 * the event loop, in us.  Yield time and granularity are then
+		 * tuned to it, and the hold time between spec.hold and
+		 * spec.hold / WORK_QUEUE_HOLD_RANGE.
+		 */
+		unsigned long max_stall;
 	} spec;
 
 	/* remaining fields should be opaque to users */
@@ -105,6 +117,14 @@ struct work_queue {
 		unsigned long total;
 	} cycles; /* cycle counts */
 
+	/* adaptive mode: hold time in use, in ms, 0 until first tuned */
+	unsigned int hold;
+
+	/* enqueue to completion latency of items, and duration of runs */
+	unsigned int latency_hist[THREAD_HIST_BUCKETS];
+	unsigned int run_hist[THREAD_HIST_BUCKETS];
+	unsigned long run_max;
+
 	/* private state */
 	uint16_t flags; /* user set flag */
 };
@@ -46,6 +46,9 @@ enum event { ZCLIENT_SCHEDULE, ZCLIENT_READ, ZCLIENT_CONNECT };
 /* Prototype for event manager. */
 static void zclient_event(enum event, struct zclient *);
 
+/* Data queued for zebra beyond which senders are asked to hold off. */
+#define ZCLIENT_WB_MAX (4 * 1024 * 1024)
+
 struct sockaddr_storage zclient_addr;
 socklen_t zclient_addr_len;
 
@@ -64,6 +67,7 @@ struct zclient *zclient_new_notify(struct thread_master *master,
 	zclient->ibuf = stream_new(ZEBRA_MAX_PACKET_SIZ);
 	zclient->obuf = stream_new(ZEBRA_MAX_PACKET_SIZ);
 	zclient->wb = buffer_new(0);
+	buffer_set_max(zclient->wb, ZCLIENT_WB_MAX);
 	zclient->master = master;
 
 	zclient->receive_notify = opt->receive_notify;
@@ -154,6 +158,7 @@ void zclient_stop(struct zclient *zclient)
 
 	/* Empty the write buffer. */
 	buffer_reset(zclient->wb);
+	zclient->wb_blocked = false;
 
 	/* Close socket. */
 	if (zclient->sock >= 0) {
@@ -259,6 +264,12 @@ static int zclient_flush_data(struct thread *thread)
 	case BUFFER_EMPTY:
 		break;
 	}
+
+	if (zclient->wb_blocked && !buffer_full(zclient->wb)) {
+		zclient->wb_blocked = false;
+		if (zclient->zebra_buffer_write_ready)
+			(*zclient->zebra_buffer_write_ready)(zclient);
+	}
 	return 0;
 }
 
@@ -280,6 +291,10 @@ int zclient_send_message(struct zclient *zclient)
 	case BUFFER_PENDING:
 		thread_add_write(zclient->master, zclient_flush_data, zclient,
 				 zclient->sock, &zclient->t_write);
+		if (buffer_full(zclient->wb)) {
+			zclient->wb_blocked = true;
+			return ZCLIENT_SEND_BUFFERED;
+		}
 		break;
 	}
 	return 0;
@@ -959,15 +974,9 @@ int zclient_route_send(uint8_t cmd, struct zclient *zclient,
 	return zclient_send_message(zclient);
 }
 
-int zapi_route_encode(uint8_t cmd, struct stream *s, struct zapi_route *api)
+/* Route type, flags and message, common to single and bulk routes. */
+static void zapi_route_encode_head(struct stream *s, struct zapi_route *api)
 {
-	struct zapi_nexthop *api_nh;
-	int i;
-	int psize;
-
-	stream_reset(s);
-	zclient_create_header(s, cmd, api->vrf_id);
-
 	stream_putc(s, api->type);
 	stream_putw(s, api->instance);
 	stream_putl(s, api->flags);
@@ -975,18 +984,13 @@ int zapi_route_encode(uint8_t cmd, struct stream *s, struct zapi_route *api)
 	stream_putc(s, api->safi);
 	if (CHECK_FLAG(api->flags, ZEBRA_FLAG_EVPN_ROUTE))
 		stream_put(s, &(api->rmac), sizeof(struct ethaddr));
+}
 
-	/* Put prefix information. */
-	stream_putc(s, api->prefix.family);
-	psize = PSIZE(api->prefix.prefixlen);
-	stream_putc(s, api->prefix.prefixlen);
-	stream_write(s, (uint8_t *)&api->prefix.u.prefix, psize);
-
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
-		psize = PSIZE(api->src_prefix.prefixlen);
-		stream_putc(s, api->src_prefix.prefixlen);
-		stream_write(s, (uint8_t *)&api->src_prefix.prefix, psize);
-	}
+/* Nexthops and attributes, common to single and bulk routes. */
+static int zapi_route_encode_tail(struct stream *s, struct zapi_route *api)
+{
+	struct zapi_nexthop *api_nh;
+	int i;
 
 	/* Nexthops.  */
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_NEXTHOP)) {
@@ -1073,6 +1077,36 @@ int zapi_route_encode(uint8_t cmd, struct stream *s, struct zapi_route *api)
 		stream_putl(s, api->mtu);
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TABLEID))
 		stream_putl(s, api->tableid);
+	if (CHECK_FLAG(api->flags, ZEBRA_FLAG_TIMESTAMPS)) {
+		stream_putq(s, api->rx_usec);
+		stream_putq(s, api->tx_usec);
+	}
+
+	return 0;
+}
+
+int zapi_route_encode(uint8_t cmd, struct stream *s, struct zapi_route *api)
+{
+	int psize;
+
+	stream_reset(s);
+	zclient_create_header(s, cmd, api->vrf_id);
+	zapi_route_encode_head(s, api);
+
+	/* Put prefix information. */
+	stream_putc(s, api->prefix.family);
+	psize = PSIZE(api->prefix.prefixlen);
+	stream_putc(s, api->prefix.prefixlen);
+	stream_write(s, (uint8_t *)&api->prefix.u.prefix, psize);
+
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
+		psize = PSIZE(api->src_prefix.prefixlen);
+		stream_putc(s, api->src_prefix.prefixlen);
+		stream_write(s, (uint8_t *)&api->src_prefix.prefix, psize);
+	}
+
+	if (zapi_route_encode_tail(s, api) < 0)
+		return -1;
 
 	/* Put length at the first point of the stream. */
 	stream_putw_at(s, 0, stream_get_endp(s));
@@ -1080,75 +1114,132 @@ int zapi_route_encode(uint8_t cmd, struct stream *s, struct zapi_route *api)
 	return 0;
 }
 
-int zapi_route_decode(struct stream *s, struct zapi_route *api)
+int zapi_route_bulk_encode(uint8_t cmd, struct stream *s,
+			   struct zapi_route *api, struct prefix *prefixes,
+			   int count)
 {
-	struct zapi_nexthop *api_nh;
+	size_t countp;
 	int i;
 
-	memset(api, 0, sizeof(*api));
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
+		zlog_warn("%s: source prefixes can't be sent in bulk",
+			  __func__);
+		return -1;
+	}
+
+	stream_reset(s);
+	zclient_create_header(s, cmd, api->vrf_id);
+	zapi_route_encode_head(s, api);
+	if (zapi_route_encode_tail(s, api) < 0)
+		return -1;
+
+	countp = stream_get_endp(s);
+	stream_putw(s, 0);
+
+	for (i = 0; i < count && i < UINT16_MAX; i++) {
+		int psize = PSIZE(prefixes[i].prefixlen);
+
+		if (STREAM_WRITEABLE(s) < (size_t)psize + 2)
+			break;
+
+		stream_putc(s, prefixes[i].family);
+		stream_putc(s, prefixes[i].prefixlen);
+		stream_write(s, (uint8_t *)&prefixes[i].u.prefix, psize);
+	}
+	stream_putw_at(s, countp, i);
 
-	/* Type, flags, message. */
-	STREAM_GETC(s, api->type);
+	/* Put length at the first point of the stream. */
+	stream_putw_at(s, 0, stream_get_endp(s));
+
+	return i;
+}
+
+int zclient_route_bulk_send(uint8_t cmd, struct zclient *zclient,
+			    struct zapi_route *api, struct prefix *prefixes,
+			    int count)
+{
+	int sent;
+
+	while (count > 0) {
+		sent = zapi_route_bulk_encode(cmd, zclient->obuf, api,
+					      prefixes, count);
+		if (sent <= 0)
+			return -1;
+		if (zclient_send_message(zclient) < 0)
+			return -1;
+
+		prefixes += sent;
+		count -= sent;
+	}
+
+	return 0;
+}
+
+static int zapi_route_decode_head(struct stream *s, struct zapi_route *api)
+{
+	/* Type, instance, flags, message, safi. */
+	STREAM_RESERVE(s, 9);
+	api->type = stream_getc_unchecked(s);
 	if (api->type > ZEBRA_ROUTE_MAX) {
 		zlog_warn("%s: Specified route type: %d is not a legal value\n",
 			  __PRETTY_FUNCTION__, api->type);
 		return -1;
 	}
 
-	STREAM_GETW(s, api->instance);
-	STREAM_GETL(s, api->flags);
-	STREAM_GETC(s, api->message);
-	STREAM_GETC(s, api->safi);
+	api->instance = stream_getw_unchecked(s);
+	api->flags = stream_getl_unchecked(s);
+	api->message = stream_getc_unchecked(s);
+	api->safi = stream_getc_unchecked(s);
 	if (CHECK_FLAG(api->flags, ZEBRA_FLAG_EVPN_ROUTE))
 		STREAM_GET(&(api->rmac), s, sizeof(struct ethaddr));
 
+	return 0;
+
+stream_failure:
+	return -1;
+}
+
+static int zapi_route_decode_prefix(struct stream *s, struct prefix *p)
+{
 	/* Prefix. */
-	STREAM_GETC(s, api->prefix.family);
-	STREAM_GETC(s, api->prefix.prefixlen);
-	switch (api->prefix.family) {
+	STREAM_RESERVE(s, 2);
+	p->family = stream_getc_unchecked(s);
+	p->prefixlen = stream_getc_unchecked(s);
+	switch (p->family) {
 	case AF_INET:
-		if (api->prefix.prefixlen > IPV4_MAX_PREFIXLEN) {
+		if (p->prefixlen > IPV4_MAX_PREFIXLEN) {
 			zlog_warn(
 				"%s: V4 prefixlen is %d which should not be more than 32",
-				__PRETTY_FUNCTION__, api->prefix.prefixlen);
+				__PRETTY_FUNCTION__, p->prefixlen);
 			return -1;
 		}
 		break;
 	case AF_INET6:
-		if (api->prefix.prefixlen > IPV6_MAX_PREFIXLEN) {
+		if (p->prefixlen > IPV6_MAX_PREFIXLEN) {
 			zlog_warn(
 				"%s: v6 prefixlen is %d which should not be more than 128",
-				__PRETTY_FUNCTION__, api->prefix.prefixlen);
+				__PRETTY_FUNCTION__, p->prefixlen);
 			return -1;
 		}
 		break;
 	default:
 		zlog_warn("%s: Specified family %d is not v4 or v6",
-			  __PRETTY_FUNCTION__, api->prefix.family);
+			  __PRETTY_FUNCTION__, p->family);
 		return -1;
 	}
-	STREAM_GET(&api->prefix.u.prefix, s, PSIZE(api->prefix.prefixlen));
+	STREAM_GET(&p->u.prefix, s, PSIZE(p->prefixlen));
 
-	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
-		api->src_prefix.family = AF_INET6;
-		STREAM_GETC(s, api->src_prefix.prefixlen);
-		if (api->src_prefix.prefixlen > IPV6_MAX_PREFIXLEN) {
-			zlog_warn(
-				"%s: SRC Prefix prefixlen received: %d is too large",
-				__PRETTY_FUNCTION__, api->src_prefix.prefixlen);
-			return -1;
-		}
-		STREAM_GET(&api->src_prefix.prefix, s,
-			   PSIZE(api->src_prefix.prefixlen));
+	return 0;
 
-		if (api->prefix.family != AF_INET6
-		    || api->src_prefix.prefixlen == 0) {
-			zlog_warn(
-				"%s: SRC prefix specified in some manner that makes no sense",
-				__PRETTY_FUNCTION__);
-			return -1;
-		}
-	}
+stream_failure:
+	return -1;
+}
+
+static int zapi_route_decode_tail(struct stream *s, struct zapi_route *api)
+{
+	struct zapi_nexthop *api_nh;
+	size_t attrlen;
+	int i;
 
 	/* Nexthops. */
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_NEXTHOP)) {
@@ -1162,8 +1253,9 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 		for (i = 0; i < api->nexthop_num; i++) {
 			api_nh = &api->nexthops[i];
 
-			STREAM_GETL(s, api_nh->vrf_id);
-			STREAM_GETC(s, api_nh->type);
+			STREAM_RESERVE(s, 5);
+			api_nh->vrf_id = stream_getl_unchecked(s);
+			api_nh->type = stream_getc_unchecked(s);
 			switch (api_nh->type) {
 			case NEXTHOP_TYPE_BLACKHOLE:
 				STREAM_GETC(s, api_nh->bh_type);
@@ -1173,9 +1265,10 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 					   IPV4_MAX_BYTELEN);
 				break;
 			case NEXTHOP_TYPE_IPV4_IFINDEX:
-				STREAM_GET(&api_nh->gate.ipv4.s_addr, s,
-					   IPV4_MAX_BYTELEN);
-				STREAM_GETL(s, api_nh->ifindex);
+				STREAM_RESERVE(s, IPV4_MAX_BYTELEN + 4);
+				api_nh->gate.ipv4.s_addr =
+					stream_get_ipv4_unchecked(s);
+				api_nh->ifindex = stream_getl_unchecked(s);
 				break;
 			case NEXTHOP_TYPE_IFINDEX:
 				STREAM_GETL(s, api_nh->ifindex);
@@ -1184,8 +1277,9 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 				STREAM_GET(&api_nh->gate.ipv6, s, 16);
 				break;
 			case NEXTHOP_TYPE_IPV6_IFINDEX:
-				STREAM_GET(&api_nh->gate.ipv6, s, 16);
-				STREAM_GETL(s, api_nh->ifindex);
+				STREAM_RESERVE(s, 16 + 4);
+				stream_get_unchecked(&api_nh->gate.ipv6, s, 16);
+				api_nh->ifindex = stream_getl_unchecked(s);
 				break;
 			default:
 				zlog_warn(
@@ -1214,19 +1308,96 @@ int zapi_route_decode(struct stream *s, struct zapi_route *api)
 	}
 
 	/* Attributes. */
+	attrlen = (CHECK_FLAG(api->message, ZAPI_MESSAGE_DISTANCE) ? 1 : 0)
+		  + (CHECK_FLAG(api->message, ZAPI_MESSAGE_METRIC) ? 4 : 0)
+		  + (CHECK_FLAG(api->message, ZAPI_MESSAGE_TAG) ? 4 : 0)
+		  + (CHECK_FLAG(api->message, ZAPI_MESSAGE_MTU) ? 4 : 0)
+		  + (CHECK_FLAG(api->message, ZAPI_MESSAGE_TABLEID) ? 4 : 0)
+		  + (CHECK_FLAG(api->flags, ZEBRA_FLAG_TIMESTAMPS) ? 16 : 0);
+	STREAM_RESERVE(s, attrlen);
+
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_DISTANCE))
-		STREAM_GETC(s, api->distance);
+		api->distance = stream_getc_unchecked(s);
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_METRIC))
-		STREAM_GETL(s, api->metric);
+		api->metric = stream_getl_unchecked(s);
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TAG))
-		STREAM_GETL(s, api->tag);
+		api->tag = stream_getl_unchecked(s);
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_MTU))
-		STREAM_GETL(s, api->mtu);
+		api->mtu = stream_getl_unchecked(s);
 	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TABLEID))
-		STREAM_GETL(s, api->tableid);
+		api->tableid = stream_getl_unchecked(s);
+	if (CHECK_FLAG(api->flags, ZEBRA_FLAG_TIMESTAMPS)) {
+		api->rx_usec = stream_getq_unchecked(s);
+		api->tx_usec = stream_getq_unchecked(s);
+	}
+
+	return 0;
+
+stream_failure:
+	return -1;
+}
+
+int zapi_route_decode(struct stream *s, struct zapi_route *api)
+{
+	memset(api, 0, sizeof(*api));
+
+	if (zapi_route_decode_head(s, api) < 0
+	    || zapi_route_decode_prefix(s, &api->prefix) < 0)
+		return -1;
+
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
+		api->src_prefix.family = AF_INET6;
+		STREAM_GETC(s, api->src_prefix.prefixlen);
+		if (api->src_prefix.prefixlen > IPV6_MAX_PREFIXLEN) {
+			zlog_warn(
+				"%s: SRC Prefix prefixlen received: %d is too large",
+				__PRETTY_FUNCTION__, api->src_prefix.prefixlen);
+			return -1;
+		}
+		STREAM_GET(&api->src_prefix.prefix, s,
+			   PSIZE(api->src_prefix.prefixlen));
+
+		if (api->prefix.family != AF_INET6
+		    || api->src_prefix.prefixlen == 0) {
+			zlog_warn(
+				"%s: SRC prefix specified in some manner that makes no sense",
+				__PRETTY_FUNCTION__);
+			return -1;
+		}
+	}
+
+	return zapi_route_decode_tail(s, api);
 
 stream_failure:
+	return -1;
+}
+
+int zapi_route_bulk_decode(struct stream *s, struct zapi_route *api,
+			   uint16_t *count)
+{
+	memset(api, 0, sizeof(*api));
+
+	if (zapi_route_decode_head(s, api) < 0)
+		return -1;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
+		zlog_warn("%s: source prefixes can't be sent in bulk",
+			  __func__);
+		return -1;
+	}
+	if (zapi_route_decode_tail(s, api) < 0)
+		return -1;
+
+	STREAM_GETW(s, *count);
 	return 0;
+
+stream_failure:
+	return -1;
+}
+
+int zapi_route_bulk_decode_prefix(struct stream *s, struct zapi_route *api)
+{
+	memset(&api->prefix, 0, sizeof(api->prefix));
+	return zapi_route_decode_prefix(s, &api->prefix);
 }
 
 bool zapi_route_notify_decode(struct stream *s, struct prefix *p,
@@ -1575,9 +1746,17 @@ static void link_params_set_value(struct stream *s, struct if_link_params *iflp)
 	iflp->use_bw = stream_getf(s);
 }
 
-struct interface *zebra_interface_link_params_read(struct stream *s)
+/*
+ * Read the link parameters sent by zebra into those of their interface.
+ * If changed is given, it is set to the LP_* bits of the parameters that
+ * differ from the interface's previous ones, all of them if it had none.
+ */
+struct interface *zebra_interface_link_params_read(struct stream *s,
+						   uint32_t *changed)
 {
 	struct if_link_params *iflp;
+	struct if_link_params old;
+	bool had_params;
 	ifindex_t ifindex;
 
 	assert(s);
@@ -1592,11 +1771,16 @@ struct interface *zebra_interface_link_params_read(struct stream *s)
 		return NULL;
 	}
 
+	had_params = HAS_LINK_PARAMS(ifp);
 	if ((iflp = if_link_params_get(ifp)) == NULL)
 		return NULL;
 
+	old = *iflp;
 	link_params_set_value(s, iflp);
 
+	if (changed)
+		*changed = had_params ? if_link_params_cmp(&old, iflp) : LP_ALL;
+
 	return ifp;
 }
 
@@ -135,6 +135,9 @@ typedef enum {
 	ZEBRA_TABLE_MANAGER_CONNECT,
 	ZEBRA_GET_TABLE_CHUNK,
 	ZEBRA_RELEASE_TABLE_CHUNK,
+	ZEBRA_ROUTE_ADD_BULK,
+	ZEBRA_ROUTE_DELETE_BULK,
+	ZEBRA_IPMR_ROUTE_STATS_BULK,
 } zebra_message_types_t;
 
 struct redist_proto {
@@ -168,6 +171,9 @@ struct zclient {
 	/* Buffer of data waiting to be written to zebra. */
 	struct buffer *wb;
 
+	/* A sender was told the buffer is full, see zclient_send_message() */
+	bool wb_blocked;
+
 	/* Read and connect thread. */
 	struct thread *t_read;
 	struct thread *t_connect;
@@ -186,6 +192,7 @@ struct zclient {
 
 	/* Pointer to the callback functions. */
 	void (*zebra_connected)(struct zclient *);
+	void (*zebra_buffer_write_ready)(struct zclient *);
 	int (*router_id_update)(int, struct zclient *, uint16_t, vrf_id_t);
 	int (*interface_add)(int, struct zclient *, uint16_t, vrf_id_t);
 	int (*interface_delete)(int, struct zclient *, uint16_t, vrf_id_t);
@@ -305,6 +312,13 @@ struct zapi_route {
 	uint32_t tableid;
 
 	struct ethaddr rmac;
+
+	/*
+	 * With ZEBRA_FLAG_TIMESTAMPS, when the client read the update the
+	 * route came from and when it sent the route, see pipeline_now().
+	 */
+	int64_t rx_usec;
+	int64_t tx_usec;
 };
 
 /* Zebra IPv4 route message API. */
@@ -450,7 +464,11 @@ extern void zclient_redistribute_default(int command, struct zclient *,
 					 vrf_id_t vrf_id);
 
 /* Send the message in zclient->obuf to the zebra daemon (or enqueue it).
-   Returns 0 for success or -1 on an I/O error. */
+   Returns 0 for success or -1 on an I/O error.  Returns ZCLIENT_SEND_BUFFERED
+   if the message was queued but the queue to zebra has grown past its
+   limit; senders of bulk updates should then hold off until
+   zclient->zebra_buffer_write_ready is called. */
+#define ZCLIENT_SEND_BUFFERED 1
 extern int zclient_send_message(struct zclient *);
 
 /* create header for command, length to be filled in by user later */
@@ -532,7 +550,8 @@ CPP_NOTICE("zapi_ipv4_route, zapi_ipv6_route, zapi_ipv4_route_ipv6_nexthop as we
 extern int zapi_ipv4_route(uint8_t, struct zclient *, struct prefix_ipv4 *,
 			   struct zapi_ipv4 *) __attribute__((deprecated));
 
-extern struct interface *zebra_interface_link_params_read(struct stream *);
+extern struct interface *zebra_interface_link_params_read(struct stream *s,
+							  uint32_t *changed);
 extern size_t zebra_interface_link_params_write(struct stream *,
 						struct interface *);
 extern int lm_label_manager_connect(struct zclient *zclient);
@@ -598,6 +617,36 @@ extern int zclient_send_rnh(struct zclient *zclient, int command,
 			    vrf_id_t vrf_id);
 extern int zapi_route_encode(uint8_t, struct stream *, struct zapi_route *);
 extern int zapi_route_decode(struct stream *, struct zapi_route *);
+
+/*
+ * ZEBRA_ROUTE_ADD_BULK and ZEBRA_ROUTE_DELETE_BULK carry the nexthops and
+ * attributes of a zapi_route once, followed by any number of prefixes that
+ * share them.  Source prefixes can't be sent in bulk.
+ */
+
+/*
+ * Encodes as many of the prefixes as fit into one message.
+ *
+ * @return the number of prefixes encoded, -1 on error
+ */
+extern int zapi_route_bulk_encode(uint8_t cmd, struct stream *s,
+				  struct zapi_route *api,
+				  struct prefix *prefixes, int count);
+
+/* Sends all prefixes, in as many messages as needed. */
+extern int zclient_route_bulk_send(uint8_t cmd, struct zclient *zclient,
+				   struct zapi_route *api,
+				   struct prefix *prefixes, int count);
+
+/*
+ * Decodes the shared part of a bulk message into api, and the number of
+ * prefixes that follow into count.  Each prefix is then decoded into
+ * api->prefix by zapi_route_bulk_decode_prefix().
+ */
+extern int zapi_route_bulk_decode(struct stream *s, struct zapi_route *api,
+				  uint16_t *count);
+extern int zapi_route_bulk_decode_prefix(struct stream *s,
+					 struct zapi_route *api);
 bool zapi_route_notify_decode(struct stream *s, struct prefix *p,
 			      uint32_t *tableid,
 			      enum zapi_route_notify_owner *note);
@@ -414,6 +414,8 @@ extern const char *zserv_command_string(unsigned int command);
 #define ZEBRA_FLAG_SCOPE_LINK         0x100
 #define ZEBRA_FLAG_FIB_OVERRIDE       0x200
 #define ZEBRA_FLAG_EVPN_ROUTE         0x400
+/* zapi_route carries pipeline timestamps, never stored in the RIB */
+#define ZEBRA_FLAG_TIMESTAMPS         0x800
 /* ZEBRA_FLAG_BLACKHOLE was 0x04 */
 /* ZEBRA_FLAG_REJECT was 0x80 */
 
@@ -56,6 +56,7 @@ static void *nhrp_cache_alloc(void *data)
 			.ifp = key->ifp,
 			.notifier_list =
 				NOTIFIER_LIST_INITIALIZER(&p->notifier_list),
+			.peer_cache_entry = LIST_INITIALIZER(p->peer_cache_entry),
 		};
 		nhrp_cache_counts[p->cur.type]++;
 	}
@@ -219,6 +220,7 @@ static void nhrp_cache_authorize_binding(struct nhrp_reqid *r, void *arg)
 			netlink_update_binding(c->cur.peer->ifp,
 					       &c->remote_addr, NULL);
 			nhrp_peer_notify_del(c->cur.peer, &c->peer_notifier);
+			list_del(&c->peer_cache_entry);
 			nhrp_peer_unref(c->cur.peer);
 		}
 		nhrp_cache_counts[c->cur.type]--;
@@ -226,9 +228,12 @@ static void nhrp_cache_authorize_binding(struct nhrp_reqid *r, void *arg)
 		c->cur = c->new;
 		c->cur.peer = nhrp_peer_ref(c->cur.peer);
 		nhrp_cache_reset_new(c);
-		if (c->cur.peer)
+		if (c->cur.peer) {
 			nhrp_peer_notify_add(c->cur.peer, &c->peer_notifier,
 					     nhrp_cache_peer_notifier);
+			list_add_tail(&c->peer_cache_entry,
+				      &c->cur.peer->cache_list);
+		}
 		nhrp_cache_update_route(c);
 		notifier_call(&c->notifier_list, NOTIFY_CACHE_BINDING_CHANGE);
 	} else {
@@ -362,6 +367,27 @@ void nhrp_cache_foreach(struct interface *ifp,
 		hash_iterate(nifp->cache_hash, nhrp_cache_iterator, &ic);
 }
 
+/* The caches bound to the peer at this NBMA address, without walking the
+ * whole cache */
+void nhrp_cache_foreach_nbma(struct interface *ifp,
+			     const union sockunion *nbma,
+			     void (*cb)(struct nhrp_cache *, void *),
+			     void *ctx)
+{
+	struct nhrp_peer *p;
+	struct nhrp_cache *c, *n;
+
+	p = nhrp_peer_find(ifp, nbma);
+	if (!p)
+		return;
+
+	/* The callback may unbind the cache, and drop the peer with it */
+	nhrp_peer_ref(p);
+	list_for_each_entry_safe(c, n, &p->cache_list, peer_cache_entry)
+		cb(c, ctx);
+	nhrp_peer_unref(p);
+}
+
 void nhrp_cache_notify_add(struct nhrp_cache *c, struct notifier_block *n,
 			   notifier_fn_t fn)
 {
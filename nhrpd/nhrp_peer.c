@@ -172,6 +172,7 @@ static void *nhrp_peer_create(void *data)
 			.vc = key->vc,
 			.notifier_list =
 				NOTIFIER_LIST_INITIALIZER(&p->notifier_list),
+			.cache_list = LIST_INITIALIZER(p->cache_list),
 		};
 		nhrp_vc_notify_add(p->vc, &p->vc_notifier, nhrp_peer_vc_notify);
 		nhrp_interface_notify_add(p->ifp, &p->ifp_notifier,
@@ -209,6 +210,24 @@ struct nhrp_peer *nhrp_peer_get(struct interface *ifp,
 	return p;
 }
 
+/* Like nhrp_peer_get(), without creating the peer nor taking a reference */
+struct nhrp_peer *nhrp_peer_find(struct interface *ifp,
+				 const union sockunion *remote_nbma)
+{
+	struct nhrp_interface *nifp = ifp->info;
+	struct nhrp_peer key;
+
+	if (!nifp->peer_hash)
+		return NULL;
+
+	key.ifp = ifp;
+	key.vc = nhrp_vc_get(&nifp->nbma, remote_nbma, 0);
+	if (!key.vc)
+		return NULL;
+
+	return hash_lookup(nifp->peer_hash, &key);
+}
+
 struct nhrp_peer *nhrp_peer_ref(struct nhrp_peer *p)
 {
 	if (p)
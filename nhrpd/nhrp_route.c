@@ -15,10 +15,25 @@
 #include "zclient.h"
 
 DEFINE_MTYPE_STATIC(NHRPD, NHRP_ROUTE, "NHRP routing entry")
+DEFINE_MTYPE_STATIC(NHRPD, NHRP_ROUTE_ANNOUNCE, "NHRP route announcement")
 
 static struct zclient *zclient;
 static struct route_table *zebra_rib[AFI_MAX];
 
+/* Announcements towards zebra wait here for nhrp_route_announce_flush(), so
+ * that a prefix changing several times in a row, as all the caches of a
+ * peer do when it flaps, is sent once in its last state. */
+struct route_announce {
+	int add;
+	enum nhrp_cache_type type;
+	ifindex_t ifindex;
+	union sockunion nexthop;
+	uint32_t mtu;
+};
+
+static struct route_table *announce_queue[AFI_MAX];
+static struct thread *t_announce;
+
 struct route_info {
 	union sockunion via;
 	struct interface *ifp;
@@ -90,15 +105,18 @@ void nhrp_route_update_nhrp(const struct prefix *p, struct interface *ifp)
 	}
 }
 
-void nhrp_route_announce(int add, enum nhrp_cache_type type,
-			 const struct prefix *p, struct interface *ifp,
-			 const union sockunion *nexthop, uint32_t mtu)
+static void nhrp_route_send(const struct prefix *p, struct route_announce *ra)
 {
 	struct zapi_route api;
 	struct zapi_nexthop *api_nh;
+	enum nhrp_cache_type type = ra->type;
+	ifindex_t ifindex = ra->ifindex;
+	const union sockunion *nexthop;
+	int add = ra->add;
+	uint32_t mtu = ra->mtu;
 
-	if (zclient->sock < 0)
-		return;
+	nexthop = sockunion_family(&ra->nexthop) != AF_UNSPEC ? &ra->nexthop
+							       : NULL;
 
 	memset(&api, 0, sizeof(api));
 	api.type = ZEBRA_ROUTE_NHRP;
@@ -109,7 +127,7 @@ void nhrp_route_announce(int add, enum nhrp_cache_type type,
 	switch (type) {
 	case NHRP_CACHE_NEGATIVE:
 		zapi_route_set_blackhole(&api, BLACKHOLE_REJECT);
-		ifp = NULL;
+		ifindex = IFINDEX_INTERNAL;
 		nexthop = NULL;
 		break;
 	case NHRP_CACHE_DYNAMIC:
@@ -135,8 +153,8 @@ void nhrp_route_announce(int add, enum nhrp_cache_type type,
 			api_nh->gate.ipv4 = nexthop->sin.sin_addr;
 			api_nh->type = NEXTHOP_TYPE_IPV4;
 		}
-		if (ifp) {
-			api_nh->ifindex = ifp->ifindex;
+		if (ifindex != IFINDEX_INTERNAL) {
+			api_nh->ifindex = ifindex;
 			if (api_nh->type == NEXTHOP_TYPE_IPV4)
 				api_nh->type = NEXTHOP_TYPE_IPV4_IFINDEX;
 			else
@@ -148,8 +166,8 @@ void nhrp_route_announce(int add, enum nhrp_cache_type type,
 			api_nh->gate.ipv6 = nexthop->sin6.sin6_addr;
 			api_nh->type = NEXTHOP_TYPE_IPV6;
 		}
-		if (ifp) {
-			api_nh->ifindex = ifp->ifindex;
+		if (ifindex != IFINDEX_INTERNAL) {
+			api_nh->ifindex = ifindex;
 			if (api_nh->type == NEXTHOP_TYPE_IPV6)
 				api_nh->type = NEXTHOP_TYPE_IPV6_IFINDEX;
 			else
@@ -173,13 +191,77 @@ void nhrp_route_announce(int add, enum nhrp_cache_type type,
 			nexthop ? inet_ntop(api.prefix.family, &api_nh->gate,
 					    buf[1], sizeof(buf[1]))
 				: "<onlink>",
-			api.metric, api.nexthop_num, ifp ? ifp->name : "none");
+			api.metric, api.nexthop_num,
+			ifindex != IFINDEX_INTERNAL
+				? ifindex2ifname(ifindex, VRF_DEFAULT)
+				: "none");
 	}
 
 	zclient_route_send(add ? ZEBRA_ROUTE_ADD : ZEBRA_ROUTE_DELETE, zclient,
 			   &api);
 }
 
+static int nhrp_route_announce_flush(struct thread *t)
+{
+	struct route_node *rn;
+	afi_t afi;
+
+	t_announce = NULL;
+
+	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+		if (!announce_queue[afi])
+			continue;
+
+		for (rn = route_top(announce_queue[afi]); rn;
+		     rn = route_next(rn)) {
+			if (!rn->info)
+				continue;
+
+			if (zclient->sock >= 0)
+				nhrp_route_send(&rn->p, rn->info);
+			XFREE(MTYPE_NHRP_ROUTE_ANNOUNCE, rn->info);
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	}
+
+	return 0;
+}
+
+void nhrp_route_announce(int add, enum nhrp_cache_type type,
+			 const struct prefix *p, struct interface *ifp,
+			 const union sockunion *nexthop, uint32_t mtu)
+{
+	struct route_announce *ra;
+	struct route_node *rn;
+	afi_t afi = family2afi(PREFIX_FAMILY(p));
+
+	if (zclient->sock < 0 || !announce_queue[afi])
+		return;
+
+	rn = route_node_get(announce_queue[afi], p);
+	if (rn->info) {
+		ra = rn->info;
+		route_unlock_node(rn);
+	} else {
+		ra = XCALLOC(MTYPE_NHRP_ROUTE_ANNOUNCE,
+			     sizeof(struct route_announce));
+		rn->info = ra;
+	}
+
+	ra->add = add;
+	ra->type = type;
+	ra->ifindex = ifp ? ifp->ifindex : IFINDEX_INTERNAL;
+	if (nexthop)
+		ra->nexthop = *nexthop;
+	else
+		sockunion_family(&ra->nexthop) = AF_UNSPEC;
+	ra->mtu = mtu;
+
+	thread_add_event(master, nhrp_route_announce_flush, NULL, 0,
+			 &t_announce);
+}
+
 int nhrp_route_read(int cmd, struct zclient *zclient, zebra_size_t length,
 		    vrf_id_t vrf_id)
 {
@@ -339,6 +421,8 @@ void nhrp_zebra_init(void)
 {
 	zebra_rib[AFI_IP] = route_table_init();
 	zebra_rib[AFI_IP6] = route_table_init();
+	announce_queue[AFI_IP] = route_table_init();
+	announce_queue[AFI_IP6] = route_table_init();
 
 	zclient = zclient_new_notify(master, &zclient_options_default);
 	zclient->zebra_connected = nhrp_zebra_connected;
@@ -356,6 +440,22 @@ void nhrp_zebra_init(void)
 
 void nhrp_zebra_terminate(void)
 {
+	struct route_node *rn;
+	afi_t afi;
+
+	THREAD_OFF(t_announce);
+	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+		if (!announce_queue[afi])
+			continue;
+		for (rn = route_top(announce_queue[afi]); rn;
+		     rn = route_next(rn)) {
+			if (rn->info)
+				XFREE(MTYPE_NHRP_ROUTE_ANNOUNCE, rn->info);
+		}
+		route_table_finish(announce_queue[afi]);
+		announce_queue[afi] = NULL;
+	}
+
 	zclient_stop(zclient);
 	zclient_free(zclient);
 	route_table_finish(zebra_rib[AFI_IP]);
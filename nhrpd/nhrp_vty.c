@@ -744,6 +744,38 @@ static void show_dmvpn_entry(struct nhrp_vc *vc, void *ctx)
 		vc->remote.id);
 }
 
+DEFUN(show_ip_nhrp_nbma, show_ip_nhrp_nbma_cmd,
+	"show " AFI_CMD " nhrp cache nbma <A.B.C.D|X:X::X:X>",
+	SHOW_STR
+	AFI_STR
+	"NHRP information\n"
+	"Forwarding cache information\n"
+	"Entries bound to an NBMA address\n"
+	"IPv4 NBMA address\n"
+	"IPv6 NBMA address\n")
+{
+	struct vrf *vrf = vrf_lookup_by_id(VRF_DEFAULT);
+	struct interface *ifp;
+	union sockunion nbma_addr;
+	struct info_ctx ctx = {
+		.vty = vty, .afi = cmd_to_afi(argv[1]),
+	};
+
+	if (str2sockunion(argv[5]->arg, &nbma_addr) < 0)
+		return nhrp_vty_return(vty, NHRP_ERR_FAIL);
+
+	FOR_ALL_INTERFACES (vrf, ifp)
+		nhrp_cache_foreach_nbma(ifp, &nbma_addr, show_ip_nhrp_cache,
+					&ctx);
+
+	if (!ctx.count) {
+		vty_out(vty, "%% No entries\n");
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(show_dmvpn, show_dmvpn_cmd,
 	"show dmvpn",
 	SHOW_STR
@@ -923,6 +955,7 @@ void nhrp_config_init(void)
 	/* global commands */
 	install_element(VIEW_NODE, &show_debugging_nhrp_cmd);
 	install_element(VIEW_NODE, &show_ip_nhrp_cmd);
+	install_element(VIEW_NODE, &show_ip_nhrp_nbma_cmd);
 	install_element(VIEW_NODE, &show_dmvpn_cmd);
 	install_element(ENABLE_NODE, &clear_nhrp_cmd);
 
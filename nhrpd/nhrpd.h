@@ -161,6 +161,8 @@ struct nhrp_peer {
 	struct nhrp_vc *vc;
 	struct thread *t_fallback;
 	struct notifier_block vc_notifier, ifp_notifier;
+	/* caches bound to this peer, by their cur.peer */
+	struct list_head cache_list;
 };
 
 struct nhrp_packet_parser {
@@ -216,6 +218,7 @@ struct nhrp_cache {
 	struct notifier_block peer_notifier;
 	struct notifier_block newpeer_notifier;
 	struct notifier_list notifier_list;
+	struct list_head peer_cache_entry;
 	struct nhrp_reqid eventid;
 	struct thread *t_timeout;
 	struct thread *t_auth;
@@ -372,6 +375,10 @@ struct nhrp_cache *nhrp_cache_get(struct interface *ifp,
 				  union sockunion *remote_addr, int create);
 void nhrp_cache_foreach(struct interface *ifp,
 			void (*cb)(struct nhrp_cache *, void *), void *ctx);
+void nhrp_cache_foreach_nbma(struct interface *ifp,
+			     const union sockunion *nbma,
+			     void (*cb)(struct nhrp_cache *, void *),
+			     void *ctx);
 void nhrp_cache_set_used(struct nhrp_cache *, int);
 int nhrp_cache_update_binding(struct nhrp_cache *, enum nhrp_cache_type type,
 			      int holding_time, struct nhrp_peer *p,
@@ -444,6 +451,8 @@ int nhrp_packet_init(void);
 
 struct nhrp_peer *nhrp_peer_get(struct interface *ifp,
 				const union sockunion *remote_nbma);
+struct nhrp_peer *nhrp_peer_find(struct interface *ifp,
+				 const union sockunion *remote_nbma);
 struct nhrp_peer *nhrp_peer_ref(struct nhrp_peer *p);
 void nhrp_peer_unref(struct nhrp_peer *p);
 int nhrp_peer_check(struct nhrp_peer *p, int establish);
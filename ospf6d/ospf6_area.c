@@ -116,6 +116,22 @@ static void ospf6_area_lsdb_hook_remove(struct ospf6_lsa *lsa)
 	}
 }
 
+static void ospf6_area_lsdb_hook_change(struct ospf6_lsa *old,
+					struct ospf6_lsa *lsa)
+{
+	switch (ntohs(lsa->header->type)) {
+	case OSPF6_LSTYPE_INTRA_PREFIX:
+		/* Only the prefixes that changed, no SPF */
+		ospf6_intra_prefix_lsa_change(old, lsa);
+		break;
+
+	default:
+		ospf6_area_lsdb_hook_remove(old);
+		ospf6_area_lsdb_hook_add(lsa);
+		break;
+	}
+}
+
 static void ospf6_area_route_hook_add(struct ospf6_route *route)
 {
 	struct ospf6_route *copy;
@@ -221,6 +237,7 @@ struct ospf6_area *ospf6_area_create(uint32_t area_id, struct ospf6 *o, int df)
 	oa->lsdb = ospf6_lsdb_create(oa);
 	oa->lsdb->hook_add = ospf6_area_lsdb_hook_add;
 	oa->lsdb->hook_remove = ospf6_area_lsdb_hook_remove;
+	oa->lsdb->hook_change = ospf6_area_lsdb_hook_change;
 	oa->lsdb_self = ospf6_lsdb_create(oa);
 	oa->temp_router_lsa_lsdb = ospf6_lsdb_create(oa);
 
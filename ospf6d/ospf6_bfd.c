@@ -155,6 +155,7 @@ static int ospf6_bfd_nbr_replay(int command, struct zclient *zclient,
 	bfd_client_sendmsg(zclient, ZEBRA_BFD_CLIENT_REGISTER);
 
 	/* Replay the neighbor, if BFD is enabled on the interface*/
+	bfd_peer_batch_begin(zclient);
 	FOR_ALL_INTERFACES (vrf, ifp) {
 		oi = (struct ospf6_interface *)ifp->info;
 
@@ -174,6 +175,7 @@ static int ospf6_bfd_nbr_replay(int command, struct zclient *zclient,
 			ospf6_bfd_reg_dereg_nbr(on, ZEBRA_BFD_DEST_UPDATE);
 		}
 	}
+	bfd_peer_batch_end(zclient);
 	return 0;
 }
 
@@ -101,6 +101,33 @@ static void ospf6_interface_lsdb_hook_remove(struct ospf6_lsa *lsa)
 	ospf6_interface_lsdb_hook(lsa, ospf6_lsremove_to_spf_reason(lsa));
 }
 
+static void ospf6_interface_lsdb_hook_change(struct ospf6_lsa *old,
+					     struct ospf6_lsa *lsa)
+{
+	struct ospf6_interface *oi = lsa->lsdb->data;
+	struct ospf6_link_lsa *old_link, *link;
+
+	/* SPF only looks for the link-local address in a Link-LSA; when
+	 * just its prefixes changed, the DR's Intra-Area-Prefix-LSA for
+	 * the link is all that needs redoing.
+	 */
+	if (ntohs(lsa->header->type) == OSPF6_LSTYPE_LINK) {
+		old_link = (struct ospf6_link_lsa *)OSPF6_LSA_HEADER_END(
+			old->header);
+		link = (struct ospf6_link_lsa *)OSPF6_LSA_HEADER_END(
+			lsa->header);
+		if (!memcmp(old_link, link,
+			    offsetof(struct ospf6_link_lsa, prefix_num))) {
+			if (oi->state == OSPF6_INTERFACE_DR)
+				OSPF6_INTRA_PREFIX_LSA_SCHEDULE_TRANSIT(oi);
+			return;
+		}
+	}
+
+	ospf6_interface_lsdb_hook_remove(old);
+	ospf6_interface_lsdb_hook_add(lsa);
+}
+
 static uint8_t ospf6_default_iftype(struct interface *ifp)
 {
 	if (if_is_pointopoint(ifp))
@@ -221,6 +248,7 @@ struct ospf6_interface *ospf6_interface_create(struct interface *ifp)
 	oi->lsdb = ospf6_lsdb_create(oi);
 	oi->lsdb->hook_add = ospf6_interface_lsdb_hook_add;
 	oi->lsdb->hook_remove = ospf6_interface_lsdb_hook_remove;
+	oi->lsdb->hook_change = ospf6_interface_lsdb_hook_change;
 	oi->lsdb_self = ospf6_lsdb_create(oi);
 
 	oi->route_connected =
@@ -1913,6 +1913,140 @@ void ospf6_intra_prefix_lsa_remove(struct ospf6_lsa *lsa)
 		zlog_debug("Trailing garbage ignored");
 }
 
+/* Whether the Intra-Area-Prefix-LSA lists the prefix, with the same options
+ * and metric.
+ */
+static bool ospf6_intra_prefix_lsa_has(struct ospf6_lsa *lsa,
+				       struct ospf6_prefix *op)
+{
+	struct ospf6_intra_prefix_lsa *intra_prefix_lsa;
+	struct ospf6_prefix *p;
+	char *current, *end;
+	int prefix_num;
+
+	intra_prefix_lsa =
+		(struct ospf6_intra_prefix_lsa *)OSPF6_LSA_HEADER_END(
+			lsa->header);
+
+	prefix_num = ntohs(intra_prefix_lsa->prefix_num);
+	end = OSPF6_LSA_END(lsa->header);
+	for (current = (caddr_t)intra_prefix_lsa
+		       + sizeof(struct ospf6_intra_prefix_lsa);
+	     current < end && prefix_num;
+	     current += OSPF6_PREFIX_SIZE(p), prefix_num--) {
+		p = (struct ospf6_prefix *)current;
+		if (end < current + OSPF6_PREFIX_SIZE(p))
+			break;
+
+		if (p->prefix_length == op->prefix_length
+		    && p->prefix_options == op->prefix_options
+		    && p->prefix_metric == op->prefix_metric
+		    && !memcmp(OSPF6_PREFIX_BODY(p), OSPF6_PREFIX_BODY(op),
+			       OSPF6_PREFIX_SPACE(op->prefix_length)))
+			return true;
+	}
+
+	return false;
+}
+
+/* A copy of the Intra-Area-Prefix-LSA with only the prefixes the other
+ * instance does not list, or NULL when there are none.
+ */
+static struct ospf6_lsa *ospf6_intra_prefix_lsa_diff(struct ospf6_lsa *lsa,
+						     struct ospf6_lsa *other)
+{
+	struct ospf6_lsa *diff;
+	struct ospf6_intra_prefix_lsa *intra_prefix_lsa, *diff_prefix_lsa;
+	struct ospf6_prefix *op;
+	char *current, *end, *pos;
+	int prefix_num;
+	uint16_t count = 0;
+
+	diff = ospf6_lsa_create(lsa->header);
+	diff->lsdb = lsa->lsdb;
+
+	intra_prefix_lsa =
+		(struct ospf6_intra_prefix_lsa *)OSPF6_LSA_HEADER_END(
+			lsa->header);
+	diff_prefix_lsa =
+		(struct ospf6_intra_prefix_lsa *)OSPF6_LSA_HEADER_END(
+			diff->header);
+	pos = (caddr_t)diff_prefix_lsa + sizeof(struct ospf6_intra_prefix_lsa);
+
+	prefix_num = ntohs(intra_prefix_lsa->prefix_num);
+	end = OSPF6_LSA_END(lsa->header);
+	for (current = (caddr_t)intra_prefix_lsa
+		       + sizeof(struct ospf6_intra_prefix_lsa);
+	     current < end && prefix_num;
+	     current += OSPF6_PREFIX_SIZE(op), prefix_num--) {
+		op = (struct ospf6_prefix *)current;
+		if (end < current + OSPF6_PREFIX_SIZE(op))
+			break;
+
+		if (ospf6_intra_prefix_lsa_has(other, op))
+			continue;
+
+		memcpy(pos, op, OSPF6_PREFIX_SIZE(op));
+		pos += OSPF6_PREFIX_SIZE(op);
+		count++;
+	}
+
+	if (count == 0) {
+		ospf6_lsa_delete(diff);
+		return NULL;
+	}
+
+	diff_prefix_lsa->prefix_num = htons(count);
+	diff->header->length = htons(pos - (caddr_t)diff->header);
+
+	return diff;
+}
+
+/*
+ * A new instance of an Intra-Area-Prefix-LSA only touches the routes of
+ * the prefixes it no longer lists, or lists with another metric or
+ * options: the rest keep their routes as they are, rather than being
+ * removed from the route tables, and zebra, to be added back.
+ */
+void ospf6_intra_prefix_lsa_change(struct ospf6_lsa *old,
+				   struct ospf6_lsa *lsa)
+{
+	struct ospf6_intra_prefix_lsa *old_prefix_lsa, *intra_prefix_lsa;
+	struct ospf6_lsa *diff;
+
+	old_prefix_lsa = (struct ospf6_intra_prefix_lsa *)OSPF6_LSA_HEADER_END(
+		old->header);
+	intra_prefix_lsa =
+		(struct ospf6_intra_prefix_lsa *)OSPF6_LSA_HEADER_END(
+			lsa->header);
+
+	/* The routes' cost and nexthops come from the referenced LS entry */
+	if (old_prefix_lsa->ref_type != intra_prefix_lsa->ref_type
+	    || old_prefix_lsa->ref_id != intra_prefix_lsa->ref_id
+	    || old_prefix_lsa->ref_adv_router
+		       != intra_prefix_lsa->ref_adv_router) {
+		ospf6_intra_prefix_lsa_remove(old);
+		ospf6_intra_prefix_lsa_add(lsa);
+		return;
+	}
+
+	if (IS_OSPF6_DEBUG_EXAMIN(INTRA_PREFIX))
+		zlog_debug("%s: LSA %s changed", __PRETTY_FUNCTION__,
+			   lsa->name);
+
+	diff = ospf6_intra_prefix_lsa_diff(old, lsa);
+	if (diff) {
+		ospf6_intra_prefix_lsa_remove(diff);
+		ospf6_lsa_delete(diff);
+	}
+
+	diff = ospf6_intra_prefix_lsa_diff(lsa, old);
+	if (diff) {
+		ospf6_intra_prefix_lsa_add(diff);
+		ospf6_lsa_delete(diff);
+	}
+}
+
 void ospf6_intra_route_calculation(struct ospf6_area *oa)
 {
 	struct ospf6_route *route, *nroute;
@@ -31,6 +31,10 @@ struct ospf6_lsdb {
 	uint32_t count;
 	void (*hook_add)(struct ospf6_lsa *);
 	void (*hook_remove)(struct ospf6_lsa *);
+	/* A changed instance replacing one still live; hook_remove on the
+	 * old and hook_add on the new instance when not set.
+	 */
+	void (*hook_change)(struct ospf6_lsa *old, struct ospf6_lsa *lsa);
 };
 
 /* Function Prototypes */
@@ -27,6 +27,8 @@
 #include "vty.h"
 #include "command.h"
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospf6_proto.h"
 #include "ospf6_lsa.h"
@@ -164,29 +166,56 @@ const char *ospf6_path_type_substr[OSPF6_PATH_TYPE_MAX] = {
 };
 
 
-struct ospf6_nexthop *ospf6_nexthop_create(void)
+/*
+ * Nexthops are shared: routes, their paths and the SPF vertices all hold
+ * the one entry for the interface and address, which goes when the last
+ * list holding it lets it go.  Entries are never written once hashed.
+ */
+static struct hash *ospf6_nexthop_hash;
+
+static unsigned int ospf6_nexthop_hash_key(void *arg)
+{
+	struct ospf6_nexthop *nh = arg;
+
+	return jhash(&nh->address, sizeof(struct in6_addr), nh->ifindex);
+}
+
+static int ospf6_nexthop_hash_cmp(const void *a, const void *b)
+{
+	return ospf6_nexthop_is_same((const struct ospf6_nexthop *)a,
+				     (const struct ospf6_nexthop *)b);
+}
+
+static void *ospf6_nexthop_hash_alloc(void *arg)
 {
 	struct ospf6_nexthop *nh;
 
 	nh = XCALLOC(MTYPE_OSPF6_NEXTHOP, sizeof(struct ospf6_nexthop));
+	ospf6_nexthop_copy(nh, (struct ospf6_nexthop *)arg);
 	return nh;
 }
 
-void ospf6_nexthop_delete(struct ospf6_nexthop *nh)
+/* The shared entry for the nexthop, with a reference for the caller */
+static struct ospf6_nexthop *ospf6_nexthop_get(struct ospf6_nexthop *nh)
 {
-	if (nh)
-		XFREE(MTYPE_OSPF6_NEXTHOP, nh);
+	struct ospf6_nexthop *shared;
+
+	shared = hash_get(ospf6_nexthop_hash, nh, ospf6_nexthop_hash_alloc);
+	shared->refcnt++;
+	return shared;
 }
 
-void ospf6_clear_nexthops(struct list *nh_list)
+void ospf6_nexthop_delete(struct ospf6_nexthop *nh)
 {
-	struct listnode *node;
-	struct ospf6_nexthop *nh;
+	if (nh == NULL)
+		return;
 
-	if (nh_list) {
-		for (ALL_LIST_ELEMENTS_RO(nh_list, node, nh))
-			ospf6_nexthop_clear(nh);
-	}
+	assert(nh->refcnt > 0);
+	if (--nh->refcnt)
+		return;
+
+	hash_release(ospf6_nexthop_hash, nh);
+	XFREE(MTYPE_OSPF6_NEXTHOP, nh);
 }
 
 static struct ospf6_nexthop *
@@ -213,8 +242,7 @@ void ospf6_copy_nexthops(struct list *dst, struct list *src)
 	if (dst && src) {
 		for (ALL_LIST_ELEMENTS_RO(src, node, nh)) {
 			if (ospf6_nexthop_is_set(nh)) {
-				nh_new = ospf6_nexthop_create();
-				ospf6_nexthop_copy(nh_new, nh);
+				nh_new = ospf6_nexthop_get(nh);
 				listnode_add_sort(dst, nh_new);
 			}
 		}
@@ -229,8 +257,7 @@ void ospf6_merge_nexthops(struct list *dst, struct list *src)
 	if (src && dst) {
 		for (ALL_LIST_ELEMENTS_RO(src, node, nh)) {
 			if (!ospf6_route_find_nexthop(dst, nh)) {
-				nh_new = ospf6_nexthop_create();
-				ospf6_nexthop_copy(nh_new, nh);
+				nh_new = ospf6_nexthop_get(nh);
 				listnode_add_sort(dst, nh_new);
 			}
 		}
@@ -284,8 +311,7 @@ void ospf6_add_nexthop(struct list *nh_list, int ifindex, struct in6_addr *addr)
 			memset(&nh_match.address, 0, sizeof(struct in6_addr));
 
 		if (!ospf6_route_find_nexthop(nh_list, &nh_match)) {
-			nh = ospf6_nexthop_create();
-			ospf6_nexthop_copy(nh, &nh_match);
+			nh = ospf6_nexthop_get(&nh_match);
 			listnode_add(nh_list, nh);
 		}
 	}
@@ -515,12 +541,11 @@ ospf6_route_lookup_identical(struct ospf6_route *route,
 {
 	struct ospf6_route *target;
 
-	for (target = ospf6_route_lookup(&route->prefix, table); target;
+	/* The routes of the prefix, the next ones are for other prefixes */
+	for (target = ospf6_route_lookup(&route->prefix, table);
+	     target && ospf6_route_is_same(target, route);
 	     target = target->next) {
 		if (target->type == route->type
-		    && (memcmp(&target->prefix, &route->prefix,
-			       sizeof(struct prefix))
-			== 0)
 		    && target->path.type == route->path.type
 		    && target->path.cost == route->path.cost
 		    && target->path.u.cost_e2 == route->path.u.cost_e2
@@ -1608,3 +1633,10 @@ void install_element_ospf6_debug_route(void)
 	install_element(CONFIG_NODE, &debug_ospf6_route_cmd);
 	install_element(CONFIG_NODE, &no_debug_ospf6_route_cmd);
 }
+
+void ospf6_route_init(void)
+{
+	ospf6_nexthop_hash = hash_create(ospf6_nexthop_hash_key,
+					 ospf6_nexthop_hash_cmp,
+					 "OSPF6 nexthop hash");
+}
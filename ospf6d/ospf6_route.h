@@ -43,6 +43,9 @@ struct ospf6_nexthop {
 
 	/* IP address, if any */
 	struct in6_addr address;
+
+	/* Lists holding this shared nexthop */
+	unsigned int refcnt;
 };
 
 #define ospf6_nexthop_is_set(x)                                                \
@@ -262,10 +265,8 @@ extern void ospf6_linkstate_prefix(uint32_t adv_router, uint32_t id,
 extern void ospf6_linkstate_prefix2str(struct prefix *prefix, char *buf,
 				       int size);
 
-extern struct ospf6_nexthop *ospf6_nexthop_create(void);
 extern int ospf6_nexthop_cmp(struct ospf6_nexthop *a, struct ospf6_nexthop *b);
 extern void ospf6_nexthop_delete(struct ospf6_nexthop *nh);
-extern void ospf6_clear_nexthops(struct list *nh_list);
 extern int ospf6_num_nexthops(struct list *nh_list);
 extern void ospf6_copy_nexthops(struct list *dst, struct list *src);
 extern void ospf6_merge_nexthops(struct list *dst, struct list *src);
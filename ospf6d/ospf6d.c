@@ -1200,6 +1200,7 @@ static void ospf6_plist_del(struct prefix_list *plist)
 /* Install ospf related commands. */
 void ospf6_init(void)
 {
+	ospf6_route_init();
 	ospf6_top_init();
 	ospf6_area_init();
 	ospf6_interface_init();
@@ -497,12 +497,17 @@ out:
 }
 
 
+/* Async messages come in floods during LSDB sync; write up to this many
+ * of them per write event rather than one */
+#define OSPF_APISERVER_ASYNC_WRITE_MAX 64
+
 int ospf_apiserver_async_write(struct thread *thread)
 {
 	struct ospf_apiserver *apiserv;
 	struct msg *msg;
 	int fd;
 	int rc = -1;
+	int count;
 
 	apiserv = THREAD_ARG(thread);
 	assert(apiserv);
@@ -522,25 +527,31 @@ int ospf_apiserver_async_write(struct thread *thread)
 			   ntohs(apiserv->peer_async.sin_port));
 
 	/* Check whether there is really a message in the fifo. */
-	msg = msg_fifo_pop(apiserv->out_async_fifo);
-	if (!msg) {
+	if (!msg_fifo_head(apiserv->out_async_fifo)) {
 		zlog_warn(
 			"API: ospf_apiserver_async_write: No message in Async-FIFO?");
 		return 0;
 	}
 
-	if (IS_DEBUG_OSPF_EVENT)
-		msg_print(msg);
+	for (count = 0; count < OSPF_APISERVER_ASYNC_WRITE_MAX; count++) {
+		msg = msg_fifo_pop(apiserv->out_async_fifo);
+		if (!msg)
+			break;
 
-	rc = msg_write(fd, msg);
+		if (IS_DEBUG_OSPF_EVENT)
+			msg_print(msg);
 
-	/* Once a message is dequeued, it should be freed anyway. */
-	msg_free(msg);
+		rc = msg_write(fd, msg);
 
-	if (rc < 0) {
-		zlog_warn("ospf_apiserver_async_write: write failed on fd=%d",
-			  fd);
-		goto out;
+		/* Once a message is dequeued, it should be freed anyway. */
+		msg_free(msg);
+
+		if (rc < 0) {
+			zlog_warn(
+				"ospf_apiserver_async_write: write failed on fd=%d",
+				fd);
+			goto out;
+		}
 	}
 
 
@@ -2355,10 +2366,44 @@ void ospf_apiserver_clients_notify_nsm_change(struct ospf_neighbor *nbr)
 	msg_free(msg);
 }
 
+/* Whether a client registered with filter wants to hear about lsa */
+static bool apiserver_lsa_filter_match(struct lsa_filter_type *filter,
+				       struct ospf_lsa *lsa,
+				       struct in_addr area_id)
+{
+	uint32_t *area;
+	int i;
+
+	/* Type first, it is the cheapest check and rules most clients out */
+	if (!(ntohs(filter->typemask) & Power2[lsa->data->type]))
+		return false;
+
+	if ((filter->origin != ANY_ORIGIN)
+	    && (filter->origin != IS_LSA_SELF(lsa)))
+		return false;
+
+	/* Check area IDs in case of non AS-E LSAs.
+	 * If filter has areas (num_areas > 0),
+	 * then one of the areas must match the area ID of this LSA. */
+	if ((lsa->data->type == OSPF_AS_EXTERNAL_LSA)
+	    || (lsa->data->type == OSPF_OPAQUE_AS_LSA))
+		return true;
+
+	if (filter->num_areas == 0)
+		return true;
+
+	area = (uint32_t *)(filter + 1);
+	for (i = 0; i < filter->num_areas; i++, area++)
+		if (*area == area_id.s_addr)
+			return true;
+
+	return false;
+}
+
 static void apiserver_clients_lsa_change_notify(uint8_t msgtype,
 						struct ospf_lsa *lsa)
 {
-	struct msg *msg;
+	struct msg *msg = NULL;
 	struct listnode *node, *nnode;
 	struct ospf_apiserver *apiserv;
 
@@ -2376,65 +2421,29 @@ static void apiserver_clients_lsa_change_notify(uint8_t msgtype,
 		ifaddr = lsa->oi->address->u.prefix4;
 	}
 
-	/* Prepare message that can be sent to clients that have a matching
-	   filter */
-	msg = new_msg_lsa_change_notify(msgtype, 0L, /* no sequence number */
-					ifaddr, area_id,
-					lsa->flags & OSPF_LSA_SELF, lsa->data);
-	if (!msg) {
-		zlog_warn(
-			"apiserver_clients_lsa_change_notify: msg_new failed");
-		return;
-	}
-
 	/* Now send message to all clients with a matching filter */
 	for (ALL_LIST_ELEMENTS(apiserver_list, node, nnode, apiserv)) {
-		struct lsa_filter_type *filter;
-		uint16_t mask;
-		uint32_t *area;
-		int i;
-
-		/* Check filter for this client. */
-		filter = apiserv->filter;
-
-		/* Check area IDs in case of non AS-E LSAs.
-		 * If filter has areas (num_areas > 0),
-		 * then one of the areas must match the area ID of this LSA. */
-
-		i = filter->num_areas;
-		if ((lsa->data->type == OSPF_AS_EXTERNAL_LSA)
-		    || (lsa->data->type == OSPF_OPAQUE_AS_LSA)) {
-			i = 0;
-		}
-
-		if (i > 0) {
-			area = (uint32_t *)(filter + 1);
-			while (i) {
-				if (*area == area_id.s_addr) {
-					break;
-				}
-				i--;
-				area++;
-			}
-		} else {
-			i = 1;
-		}
-
-		if (i > 0) {
-			/* Area match. Check LSA type. */
-			mask = ntohs(filter->typemask);
+		if (!apiserver_lsa_filter_match(apiserv->filter, lsa, area_id))
+			continue;
 
-			if (mask & Power2[lsa->data->type]) {
-				/* Type also matches. Check origin. */
-				if ((filter->origin == ANY_ORIGIN)
-				    || (filter->origin == IS_LSA_SELF(lsa))) {
-					ospf_apiserver_send_msg(apiserv, msg);
-				}
+		/* Prepare the message once the first interested client
+		   shows up, it is the same for all of them */
+		if (!msg) {
+			msg = new_msg_lsa_change_notify(
+				msgtype, 0L, /* no sequence number */
+				ifaddr, area_id, lsa->flags & OSPF_LSA_SELF,
+				lsa->data);
+			if (!msg) {
+				zlog_warn(
+					"apiserver_clients_lsa_change_notify: msg_new failed");
+				return;
 			}
 		}
+		ospf_apiserver_send_msg(apiserv, msg);
 	}
 	/* Free message since it is not used anymore */
-	msg_free(msg);
+	if (msg)
+		msg_free(msg);
 }
 
 
@@ -2446,12 +2455,9 @@ static void apiserver_clients_lsa_change_notify(uint8_t msgtype,
 
 static int apiserver_notify_clients_lsa(uint8_t msgtype, struct ospf_lsa *lsa)
 {
-	struct msg *msg;
-	/* default area for AS-External and Opaque11 LSAs */
-	struct in_addr area_id = {.s_addr = 0L};
-
-	/* default interface for non Opaque9 LSAs */
-	struct in_addr ifaddr = {.s_addr = 0L};
+	/* Nobody to tell, the common case when the API is not in use */
+	if (!listcount(apiserver_list))
+		return 0;
 
 	/* Only notify this update if the LSA's age is smaller than
 	   MAXAGE. Otherwise clients would see LSA updates with max age just
@@ -2461,25 +2467,9 @@ static int apiserver_notify_clients_lsa(uint8_t msgtype, struct ospf_lsa *lsa)
 		return 0;
 	}
 
-	if (lsa->area) {
-		area_id = lsa->area->area_id;
-	}
-	if (lsa->data->type == OSPF_OPAQUE_LINK_LSA) {
-		ifaddr = lsa->oi->address->u.prefix4;
-	}
-	msg = new_msg_lsa_change_notify(msgtype, 0L, /* no sequence number */
-					ifaddr, area_id,
-					lsa->flags & OSPF_LSA_SELF, lsa->data);
-	if (!msg) {
-		zlog_warn("notify_clients_lsa: msg_new failed");
-		return -1;
-	}
 	/* Notify all clients that new LSA is added/updated */
 	apiserver_clients_lsa_change_notify(msgtype, lsa);
 
-	/* Clients made their own copies of msg so we can free msg here */
-	msg_free(msg);
-
 	return 0;
 }
 
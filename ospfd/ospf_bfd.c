@@ -160,6 +160,7 @@ static int ospf_bfd_nbr_replay(int command, struct zclient *zclient,
 	bfd_client_sendmsg(zclient, ZEBRA_BFD_CLIENT_REGISTER);
 
 	/* Replay the neighbor, if BFD is enabled in OSPF */
+	bfd_peer_batch_begin(zclient);
 	for (ALL_LIST_ELEMENTS(om->ospf, node, onode, ospf)) {
 		for (ALL_LIST_ELEMENTS_RO(ospf->oiflist, inode, oi)) {
 			if ((nbrs = oi->nbrs) == NULL)
@@ -186,6 +187,7 @@ static int ospf_bfd_nbr_replay(int command, struct zclient *zclient,
 			}
 		}
 	}
+	bfd_peer_batch_end(zclient);
 	return 0;
 }
 
@@ -845,9 +845,13 @@ void ospf_ls_retransmit_add(struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 	if (ospf_lsa_more_recent(old, lsa) < 0) {
 		if (old) {
 			old->retransmit_counter--;
+			listnode_delete(old->retransmit_nbrs, nbr);
 			ospf_lsdb_delete(&nbr->ls_rxmt, old);
 		}
 		lsa->retransmit_counter++;
+		if (!lsa->retransmit_nbrs)
+			lsa->retransmit_nbrs = list_new();
+		listnode_add(lsa->retransmit_nbrs, nbr);
 		/*
 		 * We cannot make use of the newly introduced callback function
 		 * "lsdb->new_lsa_hook" to replace debug output below, just
@@ -870,6 +874,7 @@ void ospf_ls_retransmit_delete(struct ospf_neighbor *nbr, struct ospf_lsa *lsa)
 {
 	if (ospf_ls_retransmit_lookup(nbr, lsa)) {
 		lsa->retransmit_counter--;
+		listnode_delete(lsa->retransmit_nbrs, nbr);
 		if (IS_DEBUG_OSPF(lsa, LSA_FLOODING)) /* -- endo. */
 			zlog_debug("RXmtL(%lu)--, NBR(%s), LSA[%s]",
 				   ospf_ls_retransmit_count(nbr),
@@ -908,45 +913,38 @@ struct ospf_lsa *ospf_ls_retransmit_lookup(struct ospf_neighbor *nbr,
 	return ospf_lsdb_lookup(&nbr->ls_rxmt, lsa);
 }
 
-static void ospf_ls_retransmit_delete_nbr_if(struct ospf_interface *oi,
-					     struct ospf_lsa *lsa)
+/* Remove the LSA from the retransmission lists of the neighbors holding it,
+ * only those in the area unless it is NULL.
+ */
+static void ospf_ls_retransmit_delete_nbr_lsa(struct ospf_area *area,
+					      struct ospf_lsa *lsa)
 {
-	struct route_node *rn;
+	struct listnode *node, *nnode;
 	struct ospf_neighbor *nbr;
-	struct ospf_lsa *lsr;
 
-	if (ospf_if_is_enable(oi))
-		for (rn = route_top(oi->nbrs); rn; rn = route_next(rn))
-			/* If LSA find in LS-retransmit list, then remove it. */
-			if ((nbr = rn->info) != NULL) {
-				lsr = ospf_ls_retransmit_lookup(nbr, lsa);
-
-				/* If LSA find in ls-retransmit list, remove it.
-				 */
-				if (lsr != NULL
-				    && lsr->data->ls_seqnum
-					       == lsa->data->ls_seqnum)
-					ospf_ls_retransmit_delete(nbr, lsr);
-			}
+	if (!lsa->retransmit_nbrs || !listcount(lsa->retransmit_nbrs))
+		return;
+
+	/* Keep it while the lists let go of it */
+	ospf_lsa_lock(lsa);
+	for (ALL_LIST_ELEMENTS(lsa->retransmit_nbrs, node, nnode, nbr)) {
+		if (area && nbr->oi->area != area)
+			continue;
+		if (ospf_if_is_enable(nbr->oi))
+			ospf_ls_retransmit_delete(nbr, lsa);
+	}
+	ospf_lsa_unlock(&lsa);
 }
 
 void ospf_ls_retransmit_delete_nbr_area(struct ospf_area *area,
 					struct ospf_lsa *lsa)
 {
-	struct listnode *node, *nnode;
-	struct ospf_interface *oi;
-
-	for (ALL_LIST_ELEMENTS(area->oiflist, node, nnode, oi))
-		ospf_ls_retransmit_delete_nbr_if(oi, lsa);
+	ospf_ls_retransmit_delete_nbr_lsa(area, lsa);
 }
 
 void ospf_ls_retransmit_delete_nbr_as(struct ospf *ospf, struct ospf_lsa *lsa)
 {
-	struct listnode *node, *nnode;
-	struct ospf_interface *oi;
-
-	for (ALL_LIST_ELEMENTS(ospf->oiflist, node, nnode, oi))
-		ospf_ls_retransmit_delete_nbr_if(oi, lsa);
+	ospf_ls_retransmit_delete_nbr_lsa(NULL, lsa);
 }
 
 
@@ -44,6 +44,7 @@
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_ia.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_zebra.h"
 
 static struct ospf_route *ospf_find_abr_route(struct route_table *rtrs,
 					      struct prefix_ipv4 *abr,
@@ -704,3 +705,187 @@ void ospf_ia_routing(struct ospf *ospf, struct route_table *rt,
 			OSPF_EXAMINE_SUMMARIES_ALL(area, rt, rtrs);
 	}
 }
+
+/* Process the summary-LSAs of an area to the network p only. */
+static void ospf_examine_summaries_to(struct ospf_area *area,
+				      struct prefix_ipv4 *p,
+				      struct route_table *rt,
+				      struct route_table *rtrs)
+{
+	struct summary_lsa *sl;
+	struct ospf_lsa *lsa;
+	struct route_node *rn;
+	struct prefix_ls lp;
+
+	/* LSAs are keyed by Link State ID then Advertising Router */
+	memset(&lp, 0, sizeof(struct prefix_ls));
+	lp.family = 0;
+	lp.prefixlen = IPV4_MAX_BITLEN;
+	lp.id = p->prefix;
+
+	for (rn = route_table_get_next(SUMMARY_LSDB(area),
+				       (struct prefix *)&lp);
+	     rn && prefix_match((struct prefix *)&lp, &rn->p);
+	     rn = route_next(rn)) {
+		if ((lsa = rn->info) == NULL)
+			continue;
+
+		sl = (struct summary_lsa *)lsa->data;
+		if (ip_masklen(sl->mask) == p->prefixlen)
+			process_summary_lsa(area, rt, rtrs, lsa);
+	}
+
+	if (rn)
+		route_unlock_node(rn);
+}
+
+/* Whether an AS-external-LSA forwards to an address in p. */
+static int ospf_ia_lsdb_forwards_to(struct route_table *lsdb,
+				    struct prefix_ipv4 *p)
+{
+	struct as_external_lsa *al;
+	struct prefix_ipv4 fwd;
+	struct ospf_lsa *lsa;
+	struct route_node *rn;
+
+	fwd.family = AF_INET;
+	fwd.prefixlen = IPV4_MAX_BITLEN;
+
+	LSDB_LOOP (lsdb, rn, lsa) {
+		al = (struct as_external_lsa *)lsa->data;
+		if (al->e[0].fwd_addr.s_addr == 0)
+			continue;
+
+		fwd.prefix = al->e[0].fwd_addr;
+		if (prefix_match((struct prefix *)p, (struct prefix *)&fwd)) {
+			route_unlock_node(rn);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Partial route recalculation for a summary-LSA, RFC2328 16.5: only the
+ * inter-area route to the network it describes is calculated again, from
+ * the current routes to the area border routers, and its change is sent
+ * to zebra alone.
+ *
+ * Returns 0 when the routing table is to be calculated again instead.
+ */
+int ospf_summary_incremental_update(struct ospf *ospf, struct ospf_lsa *lsa)
+{
+	struct summary_lsa *sl = (struct summary_lsa *)lsa->data;
+	struct ospf_route *old_or = NULL, *new_or = NULL;
+	struct route_table *tmp_old;
+	struct route_node *rn;
+	struct ospf_area *area;
+	struct listnode *node;
+	struct prefix_ipv4 p;
+	int changed;
+
+	/* Which areas' summary-LSAs are examined depends on the ABR type,
+	 * and an ABR summarises inter-area routes into its other areas.
+	 * ASBR-summary-LSAs may change any AS external route.
+	 */
+	if (lsa->data->type != OSPF_SUMMARY_LSA || IS_OSPF_ABR(ospf))
+		return 0;
+
+	/* No routing table yet, or it is to be calculated again anyway */
+	if (!ospf->new_table || !ospf->new_rtrs || ospf->t_spf_calc)
+		return 0;
+
+	p.family = AF_INET;
+	p.prefix = sl->header.id;
+	p.prefixlen = ip_masklen(sl->mask);
+	apply_mask_ipv4(&p);
+
+	/* The inter-area route would override an AS external route */
+	rn = route_node_lookup(ospf->external_lsas, (struct prefix *)&p);
+	if (rn) {
+		route_unlock_node(rn);
+		if (rn->info && listcount((struct list *)rn->info))
+			return 0;
+	}
+
+	rn = route_node_lookup(ospf->new_table, (struct prefix *)&p);
+	if (rn) {
+		route_unlock_node(rn);
+		old_or = rn->info;
+
+		/* Intra-area paths are always preferred */
+		if (old_or && old_or->path_type == OSPF_PATH_INTRA_AREA)
+			return 1;
+
+		if (old_or) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	}
+
+	if (IS_DEBUG_OSPF_EVENT)
+		zlog_debug("%s: recalculating route to %s/%d", __func__,
+			   inet_ntoa(p.prefix), p.prefixlen);
+
+	for (ALL_LIST_ELEMENTS_RO(ospf->areas, node, area))
+		ospf_examine_summaries_to(area, &p, ospf->new_table,
+					  ospf->new_rtrs);
+
+	rn = route_node_lookup(ospf->new_table, (struct prefix *)&p);
+	if (rn) {
+		route_unlock_node(rn);
+		new_or = rn->info;
+
+		/* See ospf_prune_unreachable_networks() */
+		if (new_or && listcount(new_or->paths) == 0) {
+			ospf_route_free(new_or);
+			rn->info = NULL;
+			route_unlock_node(rn);
+			new_or = NULL;
+		}
+	}
+
+	/* Install the change to zebra */
+	tmp_old = route_table_init();
+	if (old_or) {
+		rn = route_node_get(tmp_old, (struct prefix *)&p);
+		rn->info = old_or;
+	}
+
+	if (new_or)
+		changed = !ospf_route_match_same(tmp_old, &p, new_or);
+	else
+		changed = old_or != NULL;
+
+	if (changed) {
+		if (new_or)
+			ospf_zebra_add(ospf, &p, new_or);
+		else
+			ospf_zebra_delete(ospf, &p, old_or);
+	}
+
+	if (old_or) {
+		rn->info = NULL;
+		route_unlock_node(rn);
+		ospf_route_free(old_or);
+	}
+	route_table_finish(tmp_old);
+
+	/* AS external routes may use the network as forwarding address */
+	if (changed) {
+		int fwd = ospf_ia_lsdb_forwards_to(EXTERNAL_LSDB(ospf), &p);
+
+		for (ALL_LIST_ELEMENTS_RO(ospf->areas, node, area))
+			if (!fwd && area->external_routing == OSPF_AREA_NSSA)
+				fwd = ospf_ia_lsdb_forwards_to(NSSA_LSDB(area),
+							       &p);
+
+		if (fwd) {
+			ospf_ase_calculate_schedule(ospf);
+			ospf_ase_calculate_timer_add(ospf);
+		}
+	}
+
+	return 1;
+}
@@ -40,5 +40,6 @@
 extern void ospf_ia_routing(struct ospf *, struct route_table *,
 			    struct route_table *);
 extern int ospf_area_is_transit(struct ospf_area *);
+extern int ospf_summary_incremental_update(struct ospf *, struct ospf_lsa *);
 
 #endif /* _ZEBRA_OSPF_IA_H */
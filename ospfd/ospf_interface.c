@@ -324,6 +324,10 @@ void ospf_if_free(struct ospf_interface *oi)
 
 	assert(oi->state == ISM_Down);
 
+	/* The area's SPF tree may have nexthops through the interface */
+	if (oi->area)
+		ospf_spf_tree_free(oi->area);
+
 	ospf_opaque_type9_lsa_term(oi);
 
 	QOBJ_UNREG(oi);
@@ -209,6 +209,8 @@ struct ospf_interface {
 	struct list *opaque_lsa_self;      /* Type-9 Opaque-LSAs */
 
 	struct route_table *ls_upd_queue;
+	/* LSA octets put on ls_upd_queue since it was last sent. */
+	uint32_t ls_upd_queued;
 
 	struct list *ls_ack; /* Link State Acknowledgment list. */
 
@@ -225,7 +227,7 @@ struct ospf_interface {
 	struct thread *t_wait;		  /* timer */
 	struct thread *t_ls_ack;	  /* timer */
 	struct thread *t_ls_ack_direct;   /* event */
-	struct thread *t_ls_upd_event;    /* event */
+	struct thread *t_ls_upd_event;    /* timer or event */
 	struct thread *t_opaque_lsa_self; /* Type-9 Opaque-LSAs */
 
 	int on_write_q;
@@ -0,0 +1,256 @@
+/*
+ * OSPF packet receive in a pthread.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+
+#include "frr_pthread.h"
+#include "linklist.h"
+#include "log.h"
+#include "memory.h"
+#include "sockopt.h"
+#include "stream.h"
+#include "thread.h"
+#include "md5.h"
+
+#include "ospfd/ospfd.h"
+#include "ospfd/ospf_io.h"
+#include "ospfd/ospf_packet.h"
+
+/*
+ * The I/O pthread reads packets off the instances' sockets and checks all
+ * that can be checked without looking at the interfaces and neighbors the
+ * main thread owns: the IP length, ospf_packet_examin() and, with MD5
+ * authentication, the digest over the packet itself.  The main thread then
+ * runs ospf_read() on the packets queued, which does the rest.
+ */
+static struct frr_pthread *ospf_io_fpt;
+
+/* The I/O pthread's receive buffer. */
+static struct stream *ospf_io_ibuf;
+
+static struct stream *ospf_recv_packet(int fd, ifindex_t *ifindex,
+				       struct stream *ibuf)
+{
+	int ret;
+	struct ip *iph;
+	uint16_t ip_len;
+	struct iovec iov;
+	/* Header and data both require alignment. */
+	char buff[CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
+	struct msghdr msgh;
+
+	memset(&msgh, 0, sizeof(struct msghdr));
+	msgh.msg_iov = &iov;
+	msgh.msg_iovlen = 1;
+	msgh.msg_control = (caddr_t)buff;
+	msgh.msg_controllen = sizeof(buff);
+
+	ret = stream_recvmsg(ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE + 1);
+	if (ret < 0) {
+		zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
+		return NULL;
+	}
+	if ((unsigned int)ret < sizeof(iph)) /* ret must be > 0 now */
+	{
+		zlog_warn(
+			"ospf_recv_packet: discarding runt packet of length %d "
+			"(ip header size is %u)",
+			ret, (unsigned int)sizeof(iph));
+		return NULL;
+	}
+
+	/* Note that there should not be alignment problems with this assignment
+	   because this is at the beginning of the stream data buffer. */
+	iph = (struct ip *)STREAM_DATA(ibuf);
+	sockopt_iphdrincl_swab_systoh(iph);
+
+	ip_len = iph->ip_len;
+
+#if !defined(GNU_LINUX) && (OpenBSD < 200311) && (__FreeBSD_version < 1000000)
+	/*
+	 * Kernel network code touches incoming IP header parameters,
+	 * before protocol specific processing.
+	 *
+	 *   1) Convert byteorder to host representation.
+	 *      --> ip_len, ip_id, ip_off
+	 *
+	 *   2) Adjust ip_len to strip IP header size!
+	 *      --> If user process receives entire IP packet via RAW
+	 *          socket, it must consider adding IP header size to
+	 *          the "ip_len" field of "ip" structure.
+	 *
+	 * For more details, see <netinet/ip_input.c>.
+	 */
+	ip_len = ip_len + (iph->ip_hl << 2);
+#endif
+
+#if defined(__DragonFly__)
+	/*
+	 * in DragonFly's raw socket, ip_len/ip_off are read
+	 * in network byte order.
+	 * As OpenBSD < 200311 adjust ip_len to strip IP header size!
+	 */
+	ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
+#endif
+
+	*ifindex = getsockopt_ifindex(AF_INET, &msgh);
+
+	if (ret != ip_len) {
+		zlog_warn(
+			"ospf_recv_packet read length mismatch: ip_len is %d, "
+			"but recvmsg returned %d",
+			ip_len, ret);
+		return NULL;
+	}
+
+	return ibuf;
+}
+
+/* Runs in the I/O pthread. */
+static int ospf_io_read(struct thread *thread)
+{
+	struct ospf *ospf = THREAD_ARG(thread);
+	struct ospf_io_packet *pkt;
+	struct ospf_header *ospfh;
+	struct stream *ibuf;
+	struct ip *iph;
+	ifindex_t ifindex = 0;
+	size_t length;
+
+	/* prepare for next packet. */
+	thread_add_read(ospf_io_fpt->master, ospf_io_read, ospf, ospf->fd,
+			&ospf->t_read);
+
+	if (!ospf_io_ibuf)
+		ospf_io_ibuf = stream_new(OSPF_MAX_PACKET_SIZE + 1);
+
+	stream_reset(ospf_io_ibuf);
+	ibuf = ospf_recv_packet(ospf->fd, &ifindex, ospf_io_ibuf);
+	if (ibuf == NULL)
+		return -1;
+
+	/* Advance from IP header to OSPF header. */
+	iph = (struct ip *)STREAM_DATA(ibuf);
+	stream_forward_getp(ibuf, iph->ip_hl * 4);
+
+	ospfh = (struct ospf_header *)stream_pnt(ibuf);
+	if (MSG_OK
+	    != ospf_packet_examin(
+		       ospfh, stream_get_endp(ibuf) - stream_get_getp(ibuf)))
+		return -1;
+
+	pkt = XCALLOC(MTYPE_OSPF_IO_PACKET, sizeof(struct ospf_io_packet));
+	length = stream_get_endp(ibuf);
+	pkt->ibuf = stream_new(length);
+	stream_put(pkt->ibuf, STREAM_DATA(ibuf), length);
+	pkt->ifindex = ifindex;
+
+	/* ospf_packet_examin() checked the digest is there. */
+	if (ntohs(ospfh->auth_type) == OSPF_AUTH_CRYPTOGRAPHIC) {
+		MD5Init(&pkt->md5);
+		MD5Update(&pkt->md5, ospfh, ntohs(ospfh->length));
+		pkt->md5_valid = true;
+	}
+
+	pthread_mutex_lock(&ospf->io_mtx);
+	{
+		listnode_add(ospf->io_queue, pkt);
+	}
+	pthread_mutex_unlock(&ospf->io_mtx);
+
+	thread_add_event(master, ospf_read, ospf, 0, &ospf->t_process_packet);
+
+	return 0;
+}
+
+void ospf_reads_on(struct ospf *ospf)
+{
+	assert(ospf_io_fpt);
+
+	thread_add_read(ospf_io_fpt->master, ospf_io_read, ospf, ospf->fd,
+			&ospf->t_read);
+}
+
+void ospf_reads_off(struct ospf *ospf)
+{
+	struct ospf_io_packet *pkt;
+
+	if (!ospf_io_fpt)
+		/* Went with the pthread's master */
+		ospf->t_read = NULL;
+	else if (atomic_load_explicit(&ospf_io_fpt->running,
+				      memory_order_relaxed))
+		thread_cancel_async(ospf_io_fpt->master, &ospf->t_read, NULL);
+	else
+		THREAD_OFF(ospf->t_read);
+
+	THREAD_OFF(ospf->t_process_packet);
+
+	while ((pkt = ospf_io_packet_pop(ospf)))
+		ospf_io_packet_free(pkt);
+}
+
+struct ospf_io_packet *ospf_io_packet_pop(struct ospf *ospf)
+{
+	struct ospf_io_packet *pkt = NULL;
+
+	pthread_mutex_lock(&ospf->io_mtx);
+	{
+		if (listcount(ospf->io_queue)) {
+			pkt = listgetdata(listhead(ospf->io_queue));
+			list_delete_node(ospf->io_queue,
+					 listhead(ospf->io_queue));
+		}
+	}
+	pthread_mutex_unlock(&ospf->io_mtx);
+
+	return pkt;
+}
+
+void ospf_io_packet_free(struct ospf_io_packet *pkt)
+{
+	stream_free(pkt->ibuf);
+	XFREE(MTYPE_OSPF_IO_PACKET, pkt);
+}
+
+void ospf_io_init(void)
+{
+	frr_pthread_init();
+	ospf_io_fpt = frr_pthread_new(NULL, "OSPF I/O thread");
+}
+
+void ospf_io_run(void)
+{
+	frr_pthread_run(ospf_io_fpt, NULL);
+	frr_pthread_wait_running(ospf_io_fpt);
+}
+
+void ospf_io_finish(void)
+{
+	if (!ospf_io_fpt)
+		return;
+
+	frr_pthread_stop_all();
+	frr_pthread_finish();
+	ospf_io_fpt = NULL;
+
+	if (ospf_io_ibuf)
+		stream_free(ospf_io_ibuf);
+	ospf_io_ibuf = NULL;
+}
@@ -0,0 +1,52 @@
+/*
+ * OSPF packet receive in a pthread.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _ZEBRA_OSPF_IO_H
+#define _ZEBRA_OSPF_IO_H
+
+#include "md5.h"
+
+/* Packets handled by one run of ospf_read() on the main thread. */
+#define OSPF_READ_PACKET_MAX 64U
+
+/* A packet received and examined by the I/O pthread. */
+struct ospf_io_packet {
+	/* The IP packet, from its header. */
+	struct stream *ibuf;
+	ifindex_t ifindex;
+
+	/* With cryptographic authentication, the MD5 over the OSPF packet
+	 * only waiting for the key.
+	 */
+	bool md5_valid;
+	MD5_CTX md5;
+};
+
+extern void ospf_io_init(void);
+extern void ospf_io_run(void);
+extern void ospf_io_finish(void);
+
+/* Start and stop receiving on the instance's socket. */
+extern void ospf_reads_on(struct ospf *ospf);
+extern void ospf_reads_off(struct ospf *ospf);
+
+/* Take the next received packet off the instance's queue, main thread. */
+extern struct ospf_io_packet *ospf_io_packet_pop(struct ospf *ospf);
+extern void ospf_io_packet_free(struct ospf_io_packet *pkt);
+
+#endif /* _ZEBRA_OSPF_IO_H */
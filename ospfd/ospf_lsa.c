@@ -48,6 +48,7 @@
 #include "ospfd/ospf_dump.h"
 #include "ospfd/ospf_route.h"
 #include "ospfd/ospf_ase.h"
+#include "ospfd/ospf_ia.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_abr.h"
 
@@ -181,6 +182,7 @@ struct ospf_lsa *ospf_lsa_dup(struct ospf_lsa *lsa)
 	UNSET_FLAG(new->flags, OSPF_LSA_DISCARD);
 	new->lock = 1;
 	new->retransmit_counter = 0;
+	new->retransmit_nbrs = NULL;
 	new->data = ospf_lsa_data_dup(lsa->data);
 
 	/* kevinm: Clear the refresh_list, otherwise there are going
@@ -210,6 +212,9 @@ void ospf_lsa_free(struct ospf_lsa *lsa)
 
 	assert(lsa->refresh_list < 0);
 
+	if (lsa->retransmit_nbrs)
+		list_delete_and_null(&lsa->retransmit_nbrs);
+
 	memset(lsa, 0, sizeof(struct ospf_lsa));
 	XFREE(MTYPE_OSPF_LSA, lsa);
 }
@@ -2375,8 +2380,10 @@ ospf_router_lsa_install(struct ospf *ospf, struct ospf_lsa *new, int rt_recalc)
 
 		ospf_refresher_register_lsa(ospf, new);
 	}
-	if (rt_recalc)
+	if (rt_recalc) {
+		ospf_spf_lsa_install(new->area, new);
 		ospf_spf_calculate_schedule(ospf, SPF_FLAG_ROUTER_LSA_INSTALL);
+	}
 	return new;
 }
 
@@ -2409,8 +2416,10 @@ static struct ospf_lsa *ospf_network_lsa_install(struct ospf *ospf,
 		oi->network_lsa_self = ospf_lsa_lock(new);
 		ospf_refresher_register_lsa(ospf, new);
 	}
-	if (rt_recalc)
+	if (rt_recalc) {
+		ospf_spf_lsa_install(new->area, new);
 		ospf_spf_calculate_schedule(ospf, SPF_FLAG_NETWORK_LSA_INSTALL);
+	}
 
 	return new;
 }
@@ -2426,13 +2435,9 @@ ospf_summary_lsa_install(struct ospf *ospf, struct ospf_lsa *new, int rt_recalc)
    destination is an AS boundary router, it may also be
    necessary to re-examine all the AS-external-LSAs.
 */
-
-#if 0
-      /* This doesn't exist yet... */
-      ospf_summary_incremental_update(new); */
-#else /* #if 0 */
-		ospf_spf_calculate_schedule(ospf, SPF_FLAG_SUMMARY_LSA_INSTALL);
-#endif /* #if 0 */
+		if (!ospf_summary_incremental_update(ospf, new))
+			ospf_spf_calculate_schedule(
+				ospf, SPF_FLAG_SUMMARY_LSA_INSTALL);
 	}
 
 	if (IS_LSA_SELF(new))
@@ -2977,6 +2982,11 @@ static int ospf_lsa_maxage_walker_remover(struct ospf *ospf,
 			case OSPF_AS_NSSA_LSA:
 				ospf_ase_incremental_update(ospf, lsa);
 				break;
+			case OSPF_SUMMARY_LSA:
+				if (!ospf_summary_incremental_update(ospf, lsa))
+					ospf_spf_calculate_schedule(
+						ospf, SPF_FLAG_MAXAGE);
+				break;
 			default:
 				ospf_spf_calculate_schedule(ospf,
 							    SPF_FLAG_MAXAGE);
@@ -93,9 +93,13 @@ struct ospf_lsa {
 #define LSA_SPF_NOT_EXPLORED -1
 #define LSA_SPF_IN_SPFTREE -2
 	/* If stat >= 0, stat is LSA position in candidates heap. */
+	/* LSDB SPF generation stat was set in, see OSPF_LSA_SPF_STAT(). */
+	uint32_t stat_generation;
 
 	/* References to this LSA in neighbor retransmission lists*/
 	int retransmit_counter;
+	/* The neighbors whose retransmission lists hold it. */
+	struct list *retransmit_nbrs;
 
 	/* Area the LSA belongs to, may be NULL if AS-external-LSA. */
 	struct ospf_area *area;
@@ -25,6 +25,8 @@
 #include "table.h"
 #include "memory.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_asbr.h"
@@ -41,12 +43,32 @@ struct ospf_lsdb *ospf_lsdb_new()
 	return new;
 }
 
+static unsigned int ospf_lsdb_index_key(void *data)
+{
+	struct lsa_header *lsah = ((struct ospf_lsa *)data)->data;
+
+	return jhash_3words(lsah->type, lsah->id.s_addr,
+			    lsah->adv_router.s_addr, 0);
+}
+
+static int ospf_lsdb_index_cmp(const void *d1, const void *d2)
+{
+	const struct lsa_header *lsah1 = ((const struct ospf_lsa *)d1)->data;
+	const struct lsa_header *lsah2 = ((const struct ospf_lsa *)d2)->data;
+
+	return lsah1->type == lsah2->type
+	       && lsah1->id.s_addr == lsah2->id.s_addr
+	       && lsah1->adv_router.s_addr == lsah2->adv_router.s_addr;
+}
+
 void ospf_lsdb_init(struct ospf_lsdb *lsdb)
 {
 	int i;
 
 	for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
 		lsdb->type[i].db = route_table_init();
+	lsdb->index = hash_create(ospf_lsdb_index_key, ospf_lsdb_index_cmp,
+				  "OSPF LSDB index");
 }
 
 void ospf_lsdb_free(struct ospf_lsdb *lsdb)
@@ -65,6 +87,8 @@ void ospf_lsdb_cleanup(struct ospf_lsdb *lsdb)
 
 	for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++)
 		route_table_finish(lsdb->type[i].db);
+	hash_free(lsdb->index);
+	lsdb->index = NULL;
 }
 
 void ls_prefix_set(struct prefix_ls *lp, struct ospf_lsa *lsa)
@@ -92,6 +116,7 @@ static void ospf_lsdb_delete_entry(struct ospf_lsdb *lsdb,
 	lsdb->type[lsa->data->type].count--;
 	lsdb->type[lsa->data->type].checksum -= ntohs(lsa->data->checksum);
 	lsdb->total--;
+	hash_release(lsdb->index, lsa);
 	rn->info = NULL;
 	route_unlock_node(rn);
 #ifdef MONITOR_LSDB_CHANGE
@@ -134,6 +159,7 @@ void ospf_lsdb_add(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 #endif /* MONITOR_LSDB_CHANGE */
 	lsdb->type[lsa->data->type].checksum += ntohs(lsa->data->checksum);
 	rn->info = ospf_lsa_lock(lsa); /* lsdb */
+	hash_get(lsdb->index, lsa, hash_alloc_intern);
 }
 
 void ospf_lsdb_delete(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
@@ -187,56 +213,41 @@ void ospf_lsdb_clean_stat(struct ospf_lsdb *lsdb)
 	struct ospf_lsa *lsa;
 	int i;
 
+	/* Stats set in an older generation read as LSA_SPF_NOT_EXPLORED,
+	 * generation 0 being that of LSAs never explored.
+	 */
+	if (++lsdb->spf_generation)
+		return;
+
+	/* Wrapped, so old stats might look current again */
+	lsdb->spf_generation = 1;
 	for (i = OSPF_MIN_LSA; i < OSPF_MAX_LSA; i++) {
 		table = lsdb->type[i].db;
 		for (rn = route_top(table); rn; rn = route_next(rn))
 			if ((lsa = (rn->info)) != NULL)
-				lsa->stat = LSA_SPF_NOT_EXPLORED;
+				OSPF_LSA_SPF_STAT_SET(lsdb, lsa,
+						      LSA_SPF_NOT_EXPLORED);
 	}
 }
 
 struct ospf_lsa *ospf_lsdb_lookup(struct ospf_lsdb *lsdb, struct ospf_lsa *lsa)
 {
-	struct route_table *table;
-	struct prefix_ls lp;
-	struct route_node *rn;
-	struct ospf_lsa *find;
-
-	table = lsdb->type[lsa->data->type].db;
-	ls_prefix_set(&lp, lsa);
-	rn = route_node_lookup(table, (struct prefix *)&lp);
-	if (rn) {
-		find = rn->info;
-		route_unlock_node(rn);
-		return find;
-	}
-	return NULL;
+	return hash_lookup(lsdb->index, lsa);
 }
 
 struct ospf_lsa *ospf_lsdb_lookup_by_id(struct ospf_lsdb *lsdb, uint8_t type,
 					struct in_addr id,
 					struct in_addr adv_router)
 {
-	struct route_table *table;
-	struct prefix_ls lp;
-	struct route_node *rn;
-	struct ospf_lsa *find;
+	struct lsa_header lsah;
+	struct ospf_lsa lsa;
 
-	table = lsdb->type[type].db;
+	lsah.type = type;
+	lsah.id = id;
+	lsah.adv_router = adv_router;
+	lsa.data = &lsah;
 
-	memset(&lp, 0, sizeof(struct prefix_ls));
-	lp.family = 0;
-	lp.prefixlen = 64;
-	lp.id = id;
-	lp.adv_router = adv_router;
-
-	rn = route_node_lookup(table, (struct prefix *)&lp);
-	if (rn) {
-		find = rn->info;
-		route_unlock_node(rn);
-		return find;
-	}
-	return NULL;
+	return hash_lookup(lsdb->index, &lsa);
 }
 
 struct ospf_lsa *ospf_lsdb_lookup_by_id_next(struct ospf_lsdb *lsdb,
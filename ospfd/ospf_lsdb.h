@@ -31,6 +31,12 @@ struct ospf_lsdb {
 		struct route_table *db;
 	} type[OSPF_MAX_LSA];
 	unsigned long total;
+	/* LSAs by (type, id, adv_router), the tables above keep them in
+	 * order. */
+	struct hash *index;
+	/* Bumped by ospf_lsdb_clean_stat(), an LSA's stat is only valid in
+	 * the generation it was set in. */
+	uint32_t spf_generation;
 #define MONITOR_LSDB_CHANGE 1 /* XXX */
 #ifdef MONITOR_LSDB_CHANGE
 	/* Hooks for callback functions to catch every add/del event. */
@@ -58,6 +64,17 @@ struct ospf_lsdb {
 #define AREA_LSDB(A,T)       ((A)->lsdb->type[(T)].db)
 #define AS_LSDB(O,T)         ((O)->lsdb->type[(T)].db)
 
+/* SPF stat of LSA L of LSDB D, LSA_SPF_NOT_EXPLORED unless set since the
+ * last ospf_lsdb_clean_stat(). */
+#define OSPF_LSA_SPF_STAT(D, L)                                                \
+	((L)->stat_generation == (D)->spf_generation ? (L)->stat               \
+						     : LSA_SPF_NOT_EXPLORED)
+#define OSPF_LSA_SPF_STAT_SET(D, L, S)                                         \
+	do {                                                                   \
+		(L)->stat = (S);                                               \
+		(L)->stat_generation = (D)->spf_generation;                    \
+	} while (0)
+
 /* OSPF LSDB related functions. */
 extern struct ospf_lsdb *ospf_lsdb_new(void);
 extern void ospf_lsdb_init(struct ospf_lsdb *);
@@ -67,7 +84,7 @@ extern void ls_prefix_set(struct prefix_ls *lp, struct ospf_lsa *lsa);
 extern void ospf_lsdb_add(struct ospf_lsdb *, struct ospf_lsa *);
 extern void ospf_lsdb_delete(struct ospf_lsdb *, struct ospf_lsa *);
 extern void ospf_lsdb_delete_all(struct ospf_lsdb *);
-/* Set all stats to -1 (LSA_SPF_NOT_EXPLORED). */
+/* Set all stats to -1 (LSA_SPF_NOT_EXPLORED), in constant time. */
 extern void ospf_lsdb_clean_stat(struct ospf_lsdb *lsdb);
 extern struct ospf_lsa *ospf_lsdb_lookup(struct ospf_lsdb *, struct ospf_lsa *);
 extern struct ospf_lsa *ospf_lsdb_lookup_by_id(struct ospf_lsdb *, uint8_t,
@@ -49,6 +49,9 @@
 #include "ospfd/ospf_lsdb.h"
 #include "ospfd/ospf_neighbor.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_io.h"
+#include "ospfd/ospf_ism.h"
+#include "ospfd/ospf_packet.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_vty.h"
 #include "ospfd/ospf_bfd.h"
@@ -183,9 +186,15 @@ int main(int argc, char **argv)
 
 	/* Initializations. */
 	master = om->master;
+	stream_cache_enable();
+
+	/* hellos, and the input carrying them, run ahead of SPF and flooding */
+	thread_set_func_class(master, ospf_hello_timer, THREAD_CLASS_CRITICAL);
+	thread_set_func_class(master, ospf_read, THREAD_CLASS_CRITICAL);
 
 	/* Library inits. */
 	debug_init();
+	ospf_io_init();
 	ospf_vrf_init();
 
 	access_list_init();
@@ -216,6 +225,7 @@ int main(int argc, char **argv)
 	}
 
 	frr_config_fork();
+	ospf_io_run();
 	frr_run(master);
 
 	/* Not reached. */
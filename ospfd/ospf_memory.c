@@ -40,9 +40,12 @@ DEFINE_MTYPE(OSPFD, OSPF_LSA_DATA, "OSPF LSA data")
 DEFINE_MTYPE(OSPFD, OSPF_LSDB, "OSPF LSDB")
 DEFINE_MTYPE(OSPFD, OSPF_PACKET, "OSPF packet")
 DEFINE_MTYPE(OSPFD, OSPF_FIFO, "OSPF FIFO queue")
+DEFINE_MTYPE(OSPFD, OSPF_IO_PACKET, "OSPF received packet")
 DEFINE_MTYPE(OSPFD, OSPF_VERTEX, "OSPF vertex")
 DEFINE_MTYPE(OSPFD, OSPF_VERTEX_PARENT, "OSPF vertex parent")
 DEFINE_MTYPE(OSPFD, OSPF_NEXTHOP, "OSPF nexthop")
+DEFINE_MTYPE(OSPFD, OSPF_SPF_HEAP, "OSPF SPF candidates")
+DEFINE_MTYPE(OSPFD, OSPF_SPF_POOL, "OSPF SPF pthreads")
 DEFINE_MTYPE(OSPFD, OSPF_PATH, "OSPF path")
 DEFINE_MTYPE(OSPFD, OSPF_VL_DATA, "OSPF VL data")
 DEFINE_MTYPE(OSPFD, OSPF_CRYPT_KEY, "OSPF crypt key")
@@ -49,6 +49,7 @@
 #include "ospfd/ospf_spf.h"
 #include "ospfd/ospf_flood.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_io.h"
 
 /*
  * OSPF Fragmentation / fragmented writes
@@ -328,7 +329,8 @@ static unsigned int ospf_packet_max(struct ospf_interface *oi)
 
 
 static int ospf_check_md5_digest(struct ospf_interface *oi,
-				 struct ospf_header *ospfh)
+				 struct ospf_header *ospfh,
+				 const MD5_CTX *md5)
 {
 	MD5_CTX ctx;
 	unsigned char digest[OSPF_AUTH_MD5_SIZE];
@@ -357,10 +359,16 @@ static int ospf_check_md5_digest(struct ospf_interface *oi,
 		return 0;
 	}
 
-	/* Generate a digest for the ospf packet - their digest + our digest. */
-	memset(&ctx, 0, sizeof(ctx));
-	MD5Init(&ctx);
-	MD5Update(&ctx, ospfh, length);
+	/* Generate a digest for the ospf packet - their digest + our digest.
+	 * The I/O pthread may have hashed the packet already.
+	 */
+	if (md5)
+		ctx = *md5;
+	else {
+		memset(&ctx, 0, sizeof(ctx));
+		MD5Init(&ctx);
+		MD5Update(&ctx, ospfh, length);
+	}
 	MD5Update(&ctx, ck->auth_key, OSPF_AUTH_MD5_SIZE);
 	MD5Final(digest, &ctx);
 
@@ -2248,88 +2256,6 @@ static void ospf_ls_ack(struct ip *iph, struct ospf_header *ospfh,
 	return;
 }
 
-static struct stream *ospf_recv_packet(struct ospf *ospf, int fd,
-				       struct interface **ifp,
-				       struct stream *ibuf)
-{
-	int ret;
-	struct ip *iph;
-	uint16_t ip_len;
-	ifindex_t ifindex = 0;
-	struct iovec iov;
-	/* Header and data both require alignment. */
-	char buff[CMSG_SPACE(SOPT_SIZE_CMSG_IFINDEX_IPV4())];
-	struct msghdr msgh;
-
-	memset(&msgh, 0, sizeof(struct msghdr));
-	msgh.msg_iov = &iov;
-	msgh.msg_iovlen = 1;
-	msgh.msg_control = (caddr_t)buff;
-	msgh.msg_controllen = sizeof(buff);
-
-	ret = stream_recvmsg(ibuf, fd, &msgh, 0, OSPF_MAX_PACKET_SIZE + 1);
-	if (ret < 0) {
-		zlog_warn("stream_recvmsg failed: %s", safe_strerror(errno));
-		return NULL;
-	}
-	if ((unsigned int)ret < sizeof(iph)) /* ret must be > 0 now */
-	{
-		zlog_warn(
-			"ospf_recv_packet: discarding runt packet of length %d "
-			"(ip header size is %u)",
-			ret, (unsigned int)sizeof(iph));
-		return NULL;
-	}
-
-	/* Note that there should not be alignment problems with this assignment
-	   because this is at the beginning of the stream data buffer. */
-	iph = (struct ip *)STREAM_DATA(ibuf);
-	sockopt_iphdrincl_swab_systoh(iph);
-
-	ip_len = iph->ip_len;
-
-#if !defined(GNU_LINUX) && (OpenBSD < 200311) && (__FreeBSD_version < 1000000)
-	/*
-	 * Kernel network code touches incoming IP header parameters,
-	 * before protocol specific processing.
-	 *
-	 *   1) Convert byteorder to host representation.
-	 *      --> ip_len, ip_id, ip_off
-	 *
-	 *   2) Adjust ip_len to strip IP header size!
-	 *      --> If user process receives entire IP packet via RAW
-	 *          socket, it must consider adding IP header size to
-	 *          the "ip_len" field of "ip" structure.
-	 *
-	 * For more details, see <netinet/ip_input.c>.
-	 */
-	ip_len = ip_len + (iph->ip_hl << 2);
-#endif
-
-#if defined(__DragonFly__)
-	/*
-	 * in DragonFly's raw socket, ip_len/ip_off are read
-	 * in network byte order.
-	 * As OpenBSD < 200311 adjust ip_len to strip IP header size!
-	 */
-	ip_len = ntohs(iph->ip_len) + (iph->ip_hl << 2);
-#endif
-
-	ifindex = getsockopt_ifindex(AF_INET, &msgh);
-
-	*ifp = if_lookup_by_index(ifindex, ospf->vrf_id);
-
-	if (ret != ip_len) {
-		zlog_warn(
-			"ospf_recv_packet read length mismatch: ip_len is %d, "
-			"but recvmsg returned %d",
-			ip_len, ret);
-		return NULL;
-	}
-
-	return ibuf;
-}
-
 static struct ospf_interface *
 ospf_associate_packet_vl(struct ospf *ospf, struct interface *ifp,
 			 struct ip *iph, struct ospf_header *ospfh)
@@ -2416,7 +2342,8 @@ static int ospf_check_network_mask(struct ospf_interface *oi,
 /* Return 1, if the packet is properly authenticated and checksummed,
    0 otherwise. In particular, check that AuType header field is valid and
    matches the locally configured AuType, and that D.5 requirements are met. */
-static int ospf_check_auth(struct ospf_interface *oi, struct ospf_header *ospfh)
+static int ospf_check_auth(struct ospf_interface *oi, struct ospf_header *ospfh,
+			   const MD5_CTX *md5)
 {
 	struct crypt_key *ck;
 	uint16_t iface_auth_type;
@@ -2495,7 +2422,7 @@ static int ospf_check_auth(struct ospf_interface *oi, struct ospf_header *ospfh)
 		       which is
 		       different from what ospf_crypt_key_lookup() does. A
 		       bug? */
-		    !ospf_check_md5_digest(oi, ospfh)) {
+		    !ospf_check_md5_digest(oi, ospfh, md5)) {
 			if (IS_DEBUG_OSPF_PACKET(ospfh->type - 1, RECV))
 				zlog_warn("interface %s: MD5 auth failed",
 					  IF_NAME(oi));
@@ -2723,8 +2650,8 @@ ospf_lsaseq_examin(struct lsa_header *lsah, /* start of buffered data */
 }
 
 /* Verify a complete OSPF packet for proper sizing/alignment. */
-static unsigned ospf_packet_examin(struct ospf_header *oh,
-				   const unsigned bytesonwire)
+unsigned ospf_packet_examin(struct ospf_header *oh,
+			    const unsigned bytesonwire)
 {
 	uint16_t bytesdeclared, bytesauth;
 	unsigned ret;
@@ -2849,7 +2776,8 @@ static unsigned ospf_packet_examin(struct ospf_header *oh,
 
 /* OSPF Header verification. */
 static int ospf_verify_header(struct stream *ibuf, struct ospf_interface *oi,
-			      struct ip *iph, struct ospf_header *ospfh)
+			      struct ip *iph, struct ospf_header *ospfh,
+			      const MD5_CTX *md5)
 {
 	/* Check Area ID. */
 	if (!ospf_check_area_id(oi, ospfh)) {
@@ -2868,36 +2796,26 @@ static int ospf_verify_header(struct stream *ibuf, struct ospf_interface *oi,
 
 	/* Check authentication. The function handles logging actions, where
 	 * required. */
-	if (!ospf_check_auth(oi, ospfh))
+	if (!ospf_check_auth(oi, ospfh, md5))
 		return -1;
 
 	return 0;
 }
 
-/* Starting point of packet process function. */
-int ospf_read(struct thread *thread)
+/* Process a packet the I/O pthread received. */
+static int ospf_read_packet(struct ospf *ospf, struct ospf_io_packet *pkt)
 {
 	int ret;
-	struct stream *ibuf;
-	struct ospf *ospf;
+	struct stream *ibuf = pkt->ibuf;
 	struct ospf_interface *oi;
 	struct ip *iph;
 	struct ospf_header *ospfh;
 	uint16_t length;
-	struct interface *ifp = NULL;
+	struct interface *ifp;
 	struct connected *c;
 
-	/* first of all get interface pointer. */
-	ospf = THREAD_ARG(thread);
+	ifp = if_lookup_by_index(pkt->ifindex, ospf->vrf_id);
 
-	/* prepare for next packet. */
-	ospf->t_read = NULL;
-	thread_add_read(master, ospf_read, ospf, ospf->fd, &ospf->t_read);
-
-	stream_reset(ospf->ibuf);
-	ibuf = ospf_recv_packet(ospf, ospf->fd, &ifp, ospf->ibuf);
-	if (ibuf == NULL)
-		return -1;
 	/* This raw packet is known to be at least as big as its IP header. */
 
 	/* Note that there should not be alignment problems with this assignment
@@ -2938,12 +2856,9 @@ int ospf_read(struct thread *thread)
 	   by ospf_recv_packet() to be correct). */
 	stream_forward_getp(ibuf, iph->ip_hl * 4);
 
+	/* The I/O pthread ran ospf_packet_examin() on it, so it is safe to
+	   access all fields of OSPF packet header. */
 	ospfh = (struct ospf_header *)stream_pnt(ibuf);
-	if (MSG_OK
-	    != ospf_packet_examin(
-		       ospfh, stream_get_endp(ibuf) - stream_get_getp(ibuf)))
-		return -1;
-	/* Now it is safe to access all fields of OSPF packet header. */
 
 	/* associate packet with ospf interface */
 	oi = ospf_if_lookup_recv_if(ospf, iph->ip_src, ifp);
@@ -3046,7 +2961,8 @@ int ospf_read(struct thread *thread)
 	}
 
 	/* Verify more OSPF header fields. */
-	ret = ospf_verify_header(ibuf, oi, iph, ospfh);
+	ret = ospf_verify_header(ibuf, oi, iph, ospfh,
+				 pkt->md5_valid ? &pkt->md5 : NULL);
 	if (ret < 0) {
 		if (IS_DEBUG_OSPF_PACKET(0, RECV))
 			zlog_debug(
@@ -3106,6 +3022,30 @@ int ospf_read(struct thread *thread)
 	return 0;
 }
 
+/* Starting point of packet process function, for the packets the I/O
+ * pthread queued.
+ */
+int ospf_read(struct thread *thread)
+{
+	struct ospf *ospf = THREAD_ARG(thread);
+	struct ospf_io_packet *pkt;
+	unsigned int count;
+
+	for (count = 0; count < OSPF_READ_PACKET_MAX; count++) {
+		pkt = ospf_io_packet_pop(ospf);
+		if (pkt == NULL)
+			return 0;
+
+		ospf_read_packet(ospf, pkt);
+		ospf_io_packet_free(pkt);
+	}
+
+	/* Let other events run before the rest */
+	thread_add_event(master, ospf_read, ospf, 0, &ospf->t_process_packet);
+
+	return 0;
+}
+
 /* Make OSPF header. */
 static void ospf_make_header(int type, struct ospf_interface *oi,
 			     struct stream *s)
@@ -3885,22 +3825,18 @@ static struct ospf_packet *ospf_ls_upd_packet_new(struct list *update,
 	return ospf_packet_new(size - sizeof(struct ip));
 }
 
-static void ospf_ls_upd_queue_send(struct ospf_interface *oi,
-				   struct list *update, struct in_addr addr,
-				   int send_lsupd_now)
+/* Build a Link State Update packet out of the head of the update list,
+ * taking the LSAs it holds off the list.
+ */
+static struct ospf_packet *ospf_ls_upd_packet_make(struct ospf_interface *oi,
+						   struct list *update)
 {
 	struct ospf_packet *op;
 	uint16_t length = OSPF_HEADER_SIZE;
 
-	if (IS_DEBUG_OSPF_EVENT)
-		zlog_debug("listcount = %d, [%s]dst %s", listcount(update),
-			   IF_NAME(oi), inet_ntoa(addr));
-
-	/* Check that we have really something to process */
-	if (listcount(update) == 0)
-		return;
-
 	op = ospf_ls_upd_packet_new(update, oi);
+	if (op == NULL)
+		return NULL;
 
 	/* Prepare OSPF common header. */
 	ospf_make_header(OSPF_MSG_LS_UPD, oi, op->s);
@@ -3916,6 +3852,13 @@ static void ospf_ls_upd_queue_send(struct ospf_interface *oi,
 	/* Set packet length. */
 	op->length = length;
 
+	return op;
+}
+
+static void ospf_ls_upd_packet_queue(struct ospf_interface *oi,
+				     struct ospf_packet *op,
+				     struct in_addr addr, int send_lsupd_now)
+{
 	/* Decide destination address. */
 	if (oi->type == OSPF_IFTYPE_POINTOPOINT)
 		op->dst.s_addr = htonl(OSPF_ALLSPFROUTERS);
@@ -3940,6 +3883,93 @@ static void ospf_ls_upd_queue_send(struct ospf_interface *oi,
 	}
 }
 
+static void ospf_ls_upd_queue_send(struct ospf_interface *oi,
+				   struct list *update, struct in_addr addr,
+				   int send_lsupd_now)
+{
+	struct ospf_packet *op;
+
+	if (IS_DEBUG_OSPF_EVENT)
+		zlog_debug("listcount = %d, [%s]dst %s", listcount(update),
+			   IF_NAME(oi), inet_ntoa(addr));
+
+	/* Check that we have really something to process */
+	if (listcount(update) == 0)
+		return;
+
+	op = ospf_ls_upd_packet_make(oi, update);
+	if (op == NULL)
+		return;
+
+	ospf_ls_upd_packet_queue(oi, op, addr, send_lsupd_now);
+}
+
+static bool ospf_ls_upd_list_same(struct list *l1, struct list *l2)
+{
+	struct listnode *n1, *n2;
+
+	if (listcount(l1) != listcount(l2))
+		return false;
+
+	for (n1 = listhead(l1), n2 = listhead(l2); n1 && n2;
+	     n1 = listnextnode(n1), n2 = listnextnode(n2))
+		if (listgetdata(n1) != listgetdata(n2))
+			return false;
+
+	return true;
+}
+
+/* Flooding on NBMA networks queues the same LSAs for every adjacent
+ * neighbor, so build their packet once and copy it for each of them.
+ */
+static void ospf_ls_upd_queue_send_nbma(struct ospf_interface *oi,
+					struct route_node *rn)
+{
+	struct list *update = rn->info;
+	struct list *peers, *other;
+	struct route_node *prn;
+	struct ospf_packet *op;
+	struct ospf_lsa *lsa;
+	struct listnode *node;
+	unsigned int count;
+
+	if (listcount(update) == 0)
+		return;
+
+	peers = list_new();
+	for (prn = route_top(oi->ls_upd_queue); prn; prn = route_next(prn))
+		if (prn != rn && prn->info
+		    && ospf_ls_upd_list_same(update, prn->info))
+			listnode_add(peers, prn);
+
+	count = listcount(update);
+	op = ospf_ls_upd_packet_make(oi, update);
+	if (op == NULL) {
+		list_delete_and_null(&peers);
+		return;
+	}
+	count -= listcount(update);
+
+	for (ALL_LIST_ELEMENTS_RO(peers, node, prn)) {
+		other = prn->info;
+		while (listcount(other) > listcount(update)) {
+			lsa = listgetdata(listhead(other));
+			list_delete_node(other, listhead(other));
+			ospf_lsa_unlock(&lsa); /* oi->ls_upd_queue */
+		}
+		ospf_ls_upd_packet_queue(oi, ospf_packet_dup(op),
+					 prn->p.u.prefix4, 0);
+	}
+
+	if (IS_DEBUG_OSPF_EVENT)
+		zlog_debug("%s: %u LSAs to %s and %d more neighbors on %s",
+			   __func__, count, inet_ntoa(rn->p.u.prefix4),
+			   listcount(peers), IF_NAME(oi));
+	list_delete_and_null(&peers);
+
+	ospf_ls_upd_packet_queue(oi, op, rn->p.u.prefix4, 0);
+}
+
 static int ospf_ls_upd_send_queue_event(struct thread *thread)
 {
 	struct ospf_interface *oi = THREAD_ARG(thread);
@@ -3949,6 +3979,7 @@ static int ospf_ls_upd_send_queue_event(struct thread *thread)
 	char again = 0;
 
 	oi->t_ls_upd_event = NULL;
+	oi->ls_upd_queued = 0;
 
 	if (IS_DEBUG_OSPF_EVENT)
 		zlog_debug("ospf_ls_upd_send_queue start");
@@ -3961,7 +3992,10 @@ static int ospf_ls_upd_send_queue_event(struct thread *thread)
 
 		update = (struct list *)rn->info;
 
-		ospf_ls_upd_queue_send(oi, update, rn->p.u.prefix4, 0);
+		if (oi->type == OSPF_IFTYPE_NBMA)
+			ospf_ls_upd_queue_send_nbma(oi, rn);
+		else
+			ospf_ls_upd_queue_send(oi, update, rn->p.u.prefix4, 0);
 
 		/* list might not be empty. */
 		if (listcount(update) == 0) {
@@ -4031,9 +4065,11 @@ void ospf_ls_upd_send(struct ospf_neighbor *nbr, struct list *update, int flag,
 	else
 		route_unlock_node(rn);
 
-	for (ALL_LIST_ELEMENTS_RO(update, node, lsa))
+	for (ALL_LIST_ELEMENTS_RO(update, node, lsa)) {
 		listnode_add(rn->info,
 			     ospf_lsa_lock(lsa)); /* oi->ls_upd_queue */
+		oi->ls_upd_queued += ntohs(lsa->data->length);
+	}
 	if (send_lsupd_now) {
 		struct list *send_update_list;
 		struct route_node *rn, *rnext;
@@ -4049,9 +4085,16 @@ void ospf_ls_upd_send(struct ospf_neighbor *nbr, struct list *update, int flag,
 			ospf_ls_upd_queue_send(oi, send_update_list,
 					       rn->p.u.prefix4, 1);
 		}
-	} else
+	} else if (oi->ls_upd_queued >= ospf_packet_max(oi)) {
+		/* A packet's worth is waiting, no use holding it back */
+		THREAD_OFF(oi->t_ls_upd_event);
 		thread_add_event(master, ospf_ls_upd_send_queue_event, oi, 0,
 				 &oi->t_ls_upd_event);
+	} else
+		/* Let LSAs flooded meanwhile join this update */
+		thread_add_timer_msec(master, ospf_ls_upd_send_queue_event, oi,
+				      OSPF_LS_UPD_BATCH_DELAY,
+				      &oi->t_ls_upd_event);
 }
 
 static void ospf_ls_ack_send_list(struct ospf_interface *oi, struct list *ack,
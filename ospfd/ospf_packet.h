@@ -45,6 +45,10 @@
 
 #define OSPF_HELLO_REPLY_DELAY          1
 
+/* Time Link State Updates are held back for more LSAs to share their
+ * packets, in msecs. */
+#define OSPF_LS_UPD_BATCH_DELAY         10
+
 /* Return values of functions involved in packet verification, see ospf6d. */
 #define MSG_OK    0
 #define MSG_NG    1
@@ -146,6 +150,7 @@ extern struct stream *ospf_stream_dup(struct stream *);
 extern struct ospf_packet *ospf_packet_dup(struct ospf_packet *);
 
 extern int ospf_read(struct thread *);
+extern unsigned ospf_packet_examin(struct ospf_header *, const unsigned);
 extern void ospf_hello_send(struct ospf_interface *);
 extern void ospf_db_desc_send(struct ospf_neighbor *);
 extern void ospf_db_desc_resend(struct ospf_neighbor *);
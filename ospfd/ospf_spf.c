@@ -24,13 +24,15 @@
 #include "thread.h"
 #include "memory.h"
 #include "hash.h"
+#include "jhash.h"
 #include "linklist.h"
 #include "prefix.h"
 #include "if.h"
 #include "table.h"
 #include "log.h"
 #include "sockunion.h" /* for inet_ntop () */
-#include "pqueue.h"
+#include "slab.h"
+#include "frr_pthread.h"
 
 #include "ospfd/ospfd.h"
 #include "ospfd/ospf_interface.h"
@@ -63,53 +65,144 @@ static void ospf_spf_set_reason(ospf_spf_reason_t reason)
 }
 
 static void ospf_vertex_free(void *);
-/* List of allocated vertices, to simplify cleanup of SPF.
- * Not thread-safe obviously. If it ever needs to be, it'd have to be
- * dynamically allocated at begin of ospf_spf_calculate
+
+/*
+ * Vertices, their parents and nexthops come from the area's slabs, SPF on
+ * a large area allocating and freeing them by the thousand.  The vertices
+ * allocated by the running calculation are also kept on the area, to
+ * simplify cleanup of SPF: those that did not make it onto the tree are
+ * freed at its end, see ospf_spf_vertices_prune().
+ *
+ * Nothing of an area's calculation is shared with another area's, so that
+ * areas can be calculated on different pthreads, see ospf_spf_pool_run().
  */
-static struct list vertex_list = {.del = ospf_vertex_free};
 
-/* Heap related functions, for the managment of the candidates, to
- * be used with pqueue. */
-static int cmp(void *node1, void *node2)
+/* The candidate list, RFC2328 16.1. (2): a 4-ary min-heap of vertices.
+ * The position of a vertex in it is kept in its LSA's stat, so that a
+ * vertex is found and its distance decreased without a search.
+ */
+#define OSPF_SPF_HEAP_ARITY 4
+
+struct ospf_spf_heap {
+	struct vertex **array;
+	int size;
+	int max;
+};
+
+/* Whether v1 is to be taken off the candidate list before v2. */
+static inline bool ospf_vertex_before(const struct vertex *v1,
+				      const struct vertex *v2)
 {
-	struct vertex *v1 = (struct vertex *)node1;
-	struct vertex *v2 = (struct vertex *)node2;
-	if (v1 != NULL && v2 != NULL) {
-		/* network vertices must be chosen before router vertices of
-		 * same
-		 * cost in order to find all shortest paths
-		 */
-		if (((v1->distance - v2->distance) == 0)
-		    && (v1->type != v2->type)) {
-			switch (v1->type) {
-			case OSPF_VERTEX_NETWORK:
-				return -1;
-			case OSPF_VERTEX_ROUTER:
-				return 1;
-			}
-		} else
-			return (v1->distance - v2->distance);
+	if (v1->distance != v2->distance)
+		return v1->distance < v2->distance;
+
+	/* network vertices must be chosen before router vertices of same
+	 * cost in order to find all shortest paths
+	 */
+	return v1->type == OSPF_VERTEX_NETWORK
+	       && v2->type == OSPF_VERTEX_ROUTER;
+}
+
+static void ospf_spf_heap_init(struct ospf_spf_heap *heap,
+			       struct ospf_area *area)
+{
+	/* Every router and network LSA may become a candidate */
+	heap->size = 0;
+	heap->max = area->lsdb->type[OSPF_ROUTER_LSA].count
+		    + area->lsdb->type[OSPF_NETWORK_LSA].count + 1;
+	heap->array = XMALLOC(MTYPE_OSPF_SPF_HEAP,
+			      heap->max * sizeof(struct vertex *));
+}
+
+static void ospf_spf_heap_fini(struct ospf_spf_heap *heap)
+{
+	XFREE(MTYPE_OSPF_SPF_HEAP, heap->array);
+	heap->size = heap->max = 0;
+}
+
+static inline void ospf_spf_heap_set(struct ospf_spf_heap *heap, int pos,
+				     struct vertex *v)
+{
+	heap->array[pos] = v;
+	*(v->stat) = pos;
+}
+
+/* The vertex at pos got closer to the root, move it up. */
+static void ospf_spf_heap_up(struct ospf_spf_heap *heap, int pos)
+{
+	struct vertex *v = heap->array[pos];
+	int parent;
+
+	while (pos > 0) {
+		parent = (pos - 1) / OSPF_SPF_HEAP_ARITY;
+		if (!ospf_vertex_before(v, heap->array[parent]))
+			break;
+		ospf_spf_heap_set(heap, pos, heap->array[parent]);
+		pos = parent;
 	}
-	return 0;
+	ospf_spf_heap_set(heap, pos, v);
 }
 
-static void update_stat(void *node, int position)
+static void ospf_spf_heap_down(struct ospf_spf_heap *heap, int pos)
 {
-	struct vertex *v = node;
+	struct vertex *v = heap->array[pos];
+	int child, last, best;
 
-	/* Set the status of the vertex, when its position changes. */
-	*(v->stat) = position;
+	for (;;) {
+		child = pos * OSPF_SPF_HEAP_ARITY + 1;
+		if (child >= heap->size)
+			break;
+
+		last = MIN(child + OSPF_SPF_HEAP_ARITY, heap->size);
+		for (best = child++; child < last; child++)
+			if (ospf_vertex_before(heap->array[child],
+					       heap->array[best]))
+				best = child;
+
+		if (!ospf_vertex_before(heap->array[best], v))
+			break;
+		ospf_spf_heap_set(heap, pos, heap->array[best]);
+		pos = best;
+	}
+	ospf_spf_heap_set(heap, pos, v);
 }
 
-static struct vertex_nexthop *vertex_nexthop_new(void)
+static void ospf_spf_heap_push(struct ospf_spf_heap *heap, struct vertex *v)
 {
-	return XCALLOC(MTYPE_OSPF_NEXTHOP, sizeof(struct vertex_nexthop));
+	if (heap->size == heap->max) {
+		heap->max *= 2;
+		heap->array = XREALLOC(MTYPE_OSPF_SPF_HEAP, heap->array,
+				       heap->max * sizeof(struct vertex *));
+	}
+
+	heap->array[heap->size] = v;
+	ospf_spf_heap_up(heap, heap->size++);
+}
+
+static struct vertex *ospf_spf_heap_pop(struct ospf_spf_heap *heap)
+{
+	struct vertex *v = heap->array[0];
+
+	if (--heap->size) {
+		heap->array[0] = heap->array[heap->size];
+		ospf_spf_heap_down(heap, 0);
+	}
+	return v;
+}
+
+static struct vertex_nexthop *vertex_nexthop_new(struct ospf_area *area)
+{
+	if (!area->spf_nexthop_slab)
+		area->spf_nexthop_slab = slab_new(
+			MTYPE_OSPF_NEXTHOP, sizeof(struct vertex_nexthop));
+
+	return slab_alloc(area->spf_nexthop_slab);
 }
 
-static void vertex_nexthop_free(struct vertex_nexthop *nh)
+static void vertex_nexthop_free(struct ospf_area *area,
+				struct vertex_nexthop *nh)
 {
-	XFREE(MTYPE_OSPF_NEXTHOP, nh);
+	slab_free(area->spf_nexthop_slab, nh);
 }
 
 /* Free the canonical nexthop objects for an area, ie the nexthop objects
@@ -138,7 +231,7 @@ static void ospf_canonical_nexthops_free(struct vertex *root)
 		/* Free child nexthops pointing back to this root vertex */
 		for (ALL_LIST_ELEMENTS(child->parents, n2, nn2, vp))
 			if (vp->parent == root && vp->nexthop) {
-				vertex_nexthop_free(vp->nexthop);
+				vertex_nexthop_free(root->area, vp->nexthop);
 				vp->nexthop = NULL;
 			}
 	}
@@ -150,40 +243,49 @@ static void ospf_canonical_nexthops_free(struct vertex *root)
 static struct vertex_parent *vertex_parent_new(struct vertex *v, int backlink,
 					       struct vertex_nexthop *hop)
 {
+	struct ospf_area *area = v->area;
 	struct vertex_parent *new;
 
-	new = XMALLOC(MTYPE_OSPF_VERTEX_PARENT, sizeof(struct vertex_parent));
-
-	if (new == NULL)
-		return NULL;
+	if (!area->spf_parent_slab)
+		area->spf_parent_slab = slab_new(MTYPE_OSPF_VERTEX_PARENT,
+						 sizeof(struct vertex_parent));
 
+	new = slab_alloc(area->spf_parent_slab);
 	new->parent = v;
 	new->backlink = backlink;
 	new->nexthop = hop;
 	return new;
 }
 
-static void vertex_parent_free(void *p)
+static void vertex_parent_free(struct ospf_area *area,
+			       struct vertex_parent *vp)
 {
-	XFREE(MTYPE_OSPF_VERTEX_PARENT, p);
+	slab_free(area->spf_parent_slab, vp);
 }
 
-static struct vertex *ospf_vertex_new(struct ospf_lsa *lsa)
+static struct vertex *ospf_vertex_new(struct ospf_area *area,
+				      struct ospf_lsa *lsa)
 {
 	struct vertex *new;
 
-	new = XCALLOC(MTYPE_OSPF_VERTEX, sizeof(struct vertex));
+	if (!area->spf_vertex_slab)
+		area->spf_vertex_slab =
+			slab_new(MTYPE_OSPF_VERTEX, sizeof(struct vertex));
+
+	new = slab_alloc(area->spf_vertex_slab);
 
 	new->flags = 0;
+	new->area = area;
+	OSPF_LSA_SPF_STAT_SET(area->lsdb, lsa, LSA_SPF_NOT_EXPLORED);
 	new->stat = &(lsa->stat);
 	new->type = lsa->data->type;
 	new->id = lsa->data->id;
 	new->lsa = lsa->data;
+	new->lsa_instance = ospf_lsa_lock(lsa);
 	new->children = list_new();
 	new->parents = list_new();
-	new->parents->del = vertex_parent_free;
 
-	listnode_add(&vertex_list, new);
+	listnode_add(&area->spf_new_vertices, new);
 
 	if (IS_DEBUG_OSPF_EVENT)
 		zlog_debug("%s: Created %s vertex %s", __func__,
@@ -196,6 +298,8 @@ static struct vertex *ospf_vertex_new(struct ospf_lsa *lsa)
 static void ospf_vertex_free(void *data)
 {
 	struct vertex *v = data;
+	struct vertex_parent *vp;
+	struct listnode *node;
 
 	if (IS_DEBUG_OSPF_EVENT)
 		zlog_debug("%s: Free %s vertex %s", __func__,
@@ -213,12 +317,80 @@ static void ospf_vertex_free(void *data)
 	if (v->children)
 		list_delete_and_null(&v->children);
 
-	if (v->parents)
+	if (v->parents) {
+		for (ALL_LIST_ELEMENTS_RO(v->parents, node, vp))
+			vertex_parent_free(v->area, vp);
 		list_delete_and_null(&v->parents);
+	}
 
 	v->lsa = NULL;
+	ospf_lsa_unlock(&v->lsa_instance);
+
+	slab_free(v->area->spf_vertex_slab, v);
+}
+
+static unsigned int ospf_vertex_hash_key(void *data)
+{
+	struct vertex *v = data;
+
+	return jhash_2words(v->type, v->id.s_addr, 0);
+}
+
+static int ospf_vertex_hash_cmp(const void *a, const void *b)
+{
+	const struct vertex *v1 = a;
+	const struct vertex *v2 = b;
+
+	return v1->type == v2->type && IPV4_ADDR_SAME(&v1->id, &v2->id);
+}
+
+/* Vertex of the area's SPF tree for a router or network LSA, if any */
+static struct vertex *ospf_spf_tree_lookup(struct ospf_area *area,
+					   uint8_t type, struct in_addr id)
+{
+	struct vertex key;
+
+	if (!area->spf_vertex_hash)
+		return NULL;
 
-	XFREE(MTYPE_OSPF_VERTEX, v);
+	key.type = type;
+	key.id = id;
+	return hash_lookup(area->spf_vertex_hash, &key);
+}
+
+/* Put a vertex on the area's SPF tree. */
+static void ospf_spf_tree_add(struct ospf_area *area, struct vertex *v)
+{
+	SET_FLAG(v->flags, OSPF_VERTEX_IN_TREE);
+	listnode_add(area->spf_vertices, v);
+	hash_get(area->spf_vertex_hash, v, hash_alloc_intern);
+}
+
+/* Free the vertices of the running calculation that are not on the tree. */
+static void ospf_spf_vertices_prune(struct ospf_area *area)
+{
+	struct listnode *node;
+	struct vertex *v;
+
+	for (node = area->spf_new_vertices.head; node; node = node->next) {
+		v = node->data;
+		if (!CHECK_FLAG(v->flags, OSPF_VERTEX_IN_TREE))
+			ospf_vertex_free(v);
+	}
+
+	list_delete_all_node(&area->spf_new_vertices);
+}
+
+/* Make a vertex of the tree refer to the LSDB's instance of its LSA. */
+static void ospf_vertex_rebind(struct vertex *v, struct ospf_lsa *lsa)
+{
+	if (v->lsa_instance == lsa)
+		return;
+
+	ospf_lsa_unlock(&v->lsa_instance);
+	v->lsa_instance = ospf_lsa_lock(lsa);
+	v->lsa = lsa->data;
+	v->stat = &lsa->stat;
 }
 
 static void ospf_vertex_dump(const char *msg, struct vertex *v,
@@ -283,10 +455,16 @@ static void ospf_spf_init(struct ospf_area *area)
 {
 	struct vertex *v;
 
+	area->spf_vertices = list_new();
+	area->spf_vertices->del = ospf_vertex_free;
+	area->spf_vertex_hash = hash_create(ospf_vertex_hash_key,
+					    ospf_vertex_hash_cmp, "OSPF SPF tree");
+
 	/* Create root node. */
-	v = ospf_vertex_new(area->router_lsa_self);
+	v = ospf_vertex_new(area, area->router_lsa_self);
 
 	area->spf = v;
+	ospf_spf_tree_add(area, v);
 
 	/* Reset ABR and ASBR router counts. */
 	area->abr_count = 0;
@@ -402,7 +580,7 @@ static void ospf_spf_flush_parents(struct vertex *w)
 	/* delete the existing nexthops */
 	for (ALL_LIST_ELEMENTS(w->parents, ln, nn, vp)) {
 		list_delete_node(w->parents, ln);
-		vertex_parent_free(vp);
+		vertex_parent_free(w->area, vp);
 	}
 }
 
@@ -626,7 +804,7 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area,
 				if (added) {
 					/* found all necessary info to build
 					 * nexthop */
-					nh = vertex_nexthop_new();
+					nh = vertex_nexthop_new(area);
 					nh->oi = oi;
 					nh->router = nexthop;
 					ospf_spf_add_parent(v, w, nh, distance);
@@ -657,7 +835,7 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area,
 				if (vl_data
 				    && CHECK_FLAG(vl_data->flags,
 						  OSPF_VL_FLAG_APPROVED)) {
-					nh = vertex_nexthop_new();
+					nh = vertex_nexthop_new(area);
 					nh->oi = vl_data->nexthop.oi;
 					nh->router = vl_data->nexthop.router;
 					ospf_spf_add_parent(v, w, nh, distance);
@@ -672,7 +850,7 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area,
 		else {
 			assert(w->type == OSPF_VERTEX_NETWORK);
 
-			nh = vertex_nexthop_new();
+			nh = vertex_nexthop_new(area);
 			nh->oi = oi;
 			nh->router.s_addr = 0; /* Nexthop not required */
 			ospf_spf_add_parent(v, w, nh, distance);
@@ -707,7 +885,7 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area,
 					 * it can be inherited from the parent
 					 * network).
 					 */
-					nh = vertex_nexthop_new();
+					nh = vertex_nexthop_new(area);
 					nh->oi = vp->nexthop->oi;
 					nh->router = l->link_data;
 					added = 1;
@@ -779,9 +957,15 @@ static unsigned int ospf_nexthop_calculation(struct ospf_area *area,
  * v is on the SPF tree.  Examine the links in v's LSA.  Update the list
  * of candidates with any vertices not already on the list.  If a lower-cost
  * path is found to a vertex already on the candidate list, store the new cost.
+ *
+ * When repairing the tree, repair_abort is set if v, put back on the tree,
+ * offers a path at least as short as the current one to a vertex that was
+ * left on it.
  */
 static void ospf_spf_next(struct vertex *v, struct ospf *ospf,
-			  struct ospf_area *area, struct pqueue *candidate)
+			  struct ospf_area *area,
+			  struct ospf_spf_heap *candidate,
+			  bool *repair_abort)
 {
 	struct ospf_lsa *w_lsa = NULL;
 	uint8_t *p;
@@ -808,6 +992,7 @@ static void ospf_spf_next(struct vertex *v, struct ospf *ospf,
 	while (p < lim) {
 		struct vertex *w;
 		unsigned int distance;
+		int w_stat;
 
 		/* In case of V is Router-LSA. */
 		if (v->lsa->type == OSPF_ROUTER_LSA) {
@@ -901,14 +1086,6 @@ static void ospf_spf_next(struct vertex *v, struct ospf *ospf,
 			continue;
 		}
 
-		/* (c) If vertex W is already on the shortest-path tree, examine
-		   the next link in the LSA. */
-		if (w_lsa->stat == LSA_SPF_IN_SPFTREE) {
-			if (IS_DEBUG_OSPF_EVENT)
-				zlog_debug("The LSA is already in SPF");
-			continue;
-		}
-
 		/* (d) Calculate the link state cost D of the resulting path
 		   from the root to vertex W.  D is equal to the sum of the link
 		   state cost of the (already calculated) shortest path to
@@ -921,20 +1098,42 @@ static void ospf_spf_next(struct vertex *v, struct ospf *ospf,
 		else /* v is not a Router-LSA */
 			distance = v->distance;
 
+		/* (c) If vertex W is already on the shortest-path tree, examine
+		   the next link in the LSA. */
+		w_stat = OSPF_LSA_SPF_STAT(area->lsdb, w_lsa);
+		if (w_stat == LSA_SPF_IN_SPFTREE) {
+			if (IS_DEBUG_OSPF_EVENT)
+				zlog_debug("The LSA is already in SPF");
+
+			if (repair_abort
+			    && CHECK_FLAG(v->flags, OSPF_VERTEX_REPAIRED)) {
+				w = ospf_spf_tree_lookup(area,
+							 w_lsa->data->type,
+							 w_lsa->data->id);
+				if (w && !CHECK_FLAG(w->flags,
+						     OSPF_VERTEX_REPAIRED)
+				    && distance <= w->distance) {
+					*repair_abort = true;
+					return;
+				}
+			}
+			continue;
+		}
+
 		/* Is there already vertex W in candidate list? */
-		if (w_lsa->stat == LSA_SPF_NOT_EXPLORED) {
+		if (w_stat == LSA_SPF_NOT_EXPLORED) {
 			/* prepare vertex W. */
-			w = ospf_vertex_new(w_lsa);
+			w = ospf_vertex_new(area, w_lsa);
 
 			/* Calculate nexthop to W. */
 			if (ospf_nexthop_calculation(area, v, w, l, distance,
 						     lsa_pos))
-				pqueue_enqueue(w, candidate);
+				ospf_spf_heap_push(candidate, w);
 			else if (IS_DEBUG_OSPF_EVENT)
 				zlog_debug("Nexthop Calc failed");
-		} else if (w_lsa->stat >= 0) {
+		} else if (w_stat >= 0) {
 			/* Get the vertex from candidates. */
-			w = candidate->array[w_lsa->stat];
+			w = candidate->array[w_stat];
 
 			/* if D is greater than. */
 			if (w->distance < distance) {
@@ -964,10 +1163,8 @@ static void ospf_spf_next(struct vertex *v, struct ospf *ospf,
 					 * in case this
 					 * node should now be the new root due
 					 * the cost change.
-					 * (next pqueu_{de,en}queue will fully
-					 * re-heap the queue).
 					 */
-					trickle_up(w_lsa->stat, candidate);
+					ospf_spf_heap_up(candidate, w_stat);
 			}
 		} /* end W is already on the candidate list */
 	}	 /* end loop over the links in V's LSA */
@@ -1158,14 +1355,385 @@ ospf_rtrs_print (struct route_table *rtrs)
 }
 #endif
 
+/*
+ * Free an area's SPF tree, so that the next calculation starts over from
+ * the root.
+ */
+void ospf_spf_tree_free(struct ospf_area *area)
+{
+	if (!area->spf_vertices)
+		return;
+
+	/* Free nexthop information, canonical versions of which are attached
+	 * the first level of router vertices attached to the root vertex, see
+	 * ospf_nexthop_calculation.
+	 */
+	if (area->spf)
+		ospf_canonical_nexthops_free(area->spf);
+	area->spf = NULL;
+
+	hash_clean(area->spf_vertex_hash, NULL);
+	hash_free(area->spf_vertex_hash);
+	area->spf_vertex_hash = NULL;
+
+	list_delete_and_null(&area->spf_vertices);
+}
+
+/* Free an area's SPF tree and the slabs it came from. */
+void ospf_spf_area_free(struct ospf_area *area)
+{
+	ospf_spf_tree_free(area);
+
+	if (area->spf_vertex_slab)
+		slab_del(area->spf_vertex_slab);
+	if (area->spf_parent_slab)
+		slab_del(area->spf_parent_slab);
+	if (area->spf_nexthop_slab)
+		slab_del(area->spf_nexthop_slab);
+	area->spf_vertex_slab = NULL;
+	area->spf_parent_slab = NULL;
+	area->spf_nexthop_slab = NULL;
+}
+
+/*
+ * A router or network LSA was installed. The tree can be repaired when
+ * vertices on it change, but one that is not on it may join it anywhere.
+ */
+void ospf_spf_lsa_install(struct ospf_area *area, struct ospf_lsa *lsa)
+{
+	if (!area || !area->spf_vertex_hash || IS_LSA_MAXAGE(lsa))
+		return;
+
+	if (!ospf_spf_tree_lookup(area, lsa->data->type, lsa->data->id))
+		ospf_spf_tree_free(area);
+}
+
+/*
+ * Whether two instances of a router or network LSA describe the same
+ * transit links, that is whether they only differ in stub networks or
+ * in flags, which do not change the SPF tree.
+ */
+static bool ospf_spf_lsa_links_same(struct lsa_header *a, struct lsa_header *b)
+{
+	struct router_lsa_link *la, *lb;
+	uint8_t *pa, *pb, *lima, *limb;
+
+	if (a->type == OSPF_NETWORK_LSA)
+		return a->length == b->length
+		       && !memcmp((uint8_t *)a + OSPF_LSA_HEADER_SIZE,
+				  (uint8_t *)b + OSPF_LSA_HEADER_SIZE,
+				  ntohs(a->length) - OSPF_LSA_HEADER_SIZE);
+
+	pa = (uint8_t *)a + OSPF_LSA_HEADER_SIZE + 4;
+	pb = (uint8_t *)b + OSPF_LSA_HEADER_SIZE + 4;
+	lima = (uint8_t *)a + ntohs(a->length);
+	limb = (uint8_t *)b + ntohs(b->length);
+
+	for (;;) {
+		la = lb = NULL;
+
+		while (pa < lima) {
+			la = (struct router_lsa_link *)pa;
+			pa += OSPF_ROUTER_LSA_LINK_SIZE
+			      + la->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+			if (la->m[0].type != LSA_LINK_TYPE_STUB)
+				break;
+			la = NULL;
+		}
+		while (pb < limb) {
+			lb = (struct router_lsa_link *)pb;
+			pb += OSPF_ROUTER_LSA_LINK_SIZE
+			      + lb->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+			if (lb->m[0].type != LSA_LINK_TYPE_STUB)
+				break;
+			lb = NULL;
+		}
+
+		if (!la || !lb)
+			return la == lb;
+
+		if (la->m[0].type != lb->m[0].type
+		    || la->m[0].metric != lb->m[0].metric
+		    || !IPV4_ADDR_SAME(&la->link_id, &lb->link_id)
+		    || !IPV4_ADDR_SAME(&la->link_data, &lb->link_data))
+			return false;
+	}
+}
+
+/* Mark the vertices whose path goes through v, and v itself. */
+static void ospf_spf_mark_affected(struct vertex *v)
+{
+	struct listnode *node;
+	struct vertex *child;
+
+	SET_FLAG(v->flags, OSPF_VERTEX_AFFECTED);
+
+	for (ALL_LIST_ELEMENTS_RO(v->children, node, child))
+		if (!CHECK_FLAG(child->flags, OSPF_VERTEX_AFFECTED))
+			ospf_spf_mark_affected(child);
+}
+
+/* Whether the nexthop of a parent is a canonical one, see
+ * ospf_canonical_nexthops_free().
+ */
+static bool ospf_vertex_parent_owns_nexthop(struct ospf_area *area,
+					    struct vertex_parent *vp)
+{
+	struct listnode *node;
+	struct vertex_parent *pp;
+
+	if (vp->parent == area->spf)
+		return true;
+
+	if (vp->parent->type != OSPF_VERTEX_NETWORK)
+		return false;
+
+	for (ALL_LIST_ELEMENTS_RO(vp->parent->parents, node, pp))
+		if (pp->parent == area->spf)
+			return true;
+
+	return false;
+}
+
+/* Seed the repair: vertices left on the tree next to one taken off it
+ * get their links examined again.
+ */
+static void ospf_spf_repair_borders(struct ospf_area *area,
+				    struct ospf_lsa *lsa, struct list *borders)
+{
+	struct router_lsa_link *l;
+	struct vertex *u;
+	uint8_t *p, *lim;
+	uint8_t type;
+
+	p = (uint8_t *)lsa->data + OSPF_LSA_HEADER_SIZE + 4;
+	lim = (uint8_t *)lsa->data + ntohs(lsa->data->length);
+
+	while (p < lim) {
+		struct in_addr id;
+
+		if (lsa->data->type == OSPF_ROUTER_LSA) {
+			l = (struct router_lsa_link *)p;
+			p += OSPF_ROUTER_LSA_LINK_SIZE
+			     + l->m[0].tos_count * OSPF_ROUTER_LSA_TOS_SIZE;
+
+			if (l->m[0].type == LSA_LINK_TYPE_STUB)
+				continue;
+			type = l->m[0].type == LSA_LINK_TYPE_TRANSIT
+				       ? OSPF_VERTEX_NETWORK
+				       : OSPF_VERTEX_ROUTER;
+			id = l->link_id;
+		} else {
+			type = OSPF_VERTEX_ROUTER;
+			id = *(struct in_addr *)p;
+			p += sizeof(struct in_addr);
+		}
+
+		u = ospf_spf_tree_lookup(area, type, id);
+		if (!u || CHECK_FLAG(u->flags, OSPF_VERTEX_BORDER))
+			continue;
+
+		SET_FLAG(u->flags, OSPF_VERTEX_BORDER);
+		listnode_add(borders, u);
+	}
+}
+
+/* Add the routes of an area's SPF tree, RFC2328 16.1. (4) and stage 2. */
+static void ospf_spf_routes_add(struct ospf_area *area,
+				struct route_table *new_table,
+				struct route_table *new_rtrs)
+{
+	struct listnode *node;
+	struct vertex *v;
+
+	/* No router-LSA of our own in the area yet */
+	if (!area->spf)
+		return;
+
+	area->abr_count = 0;
+	area->asbr_count = 0;
+	area->transit = OSPF_TRANSIT_FALSE;
+	area->shortcut_capability = 1;
+
+	for (ALL_LIST_ELEMENTS_RO(area->spf_vertices, node, v)) {
+		UNSET_FLAG(v->flags, OSPF_VERTEX_PROCESSED);
+
+		if (v->type == OSPF_VERTEX_ROUTER
+		    && IS_ROUTER_LSA_VIRTUAL((struct router_lsa *)v->lsa))
+			area->transit = OSPF_TRANSIT_TRUE;
+
+		if (v == area->spf)
+			continue;
+
+		if (v->type == OSPF_VERTEX_ROUTER)
+			ospf_intra_add_router(new_rtrs, v, area);
+		else
+			ospf_intra_add_transit(new_table, v, area);
+	}
+
+	if (IS_DEBUG_OSPF_EVENT)
+		ospf_route_table_dump(new_table);
+
+	ospf_spf_process_stubs(area, area->spf, new_table, 0);
+}
+
+/*
+ * Incremental SPF: bring the area's tree from the previous calculation up
+ * to date instead of running Dijkstra from the root again.
+ *
+ * The vertices whose transit links changed since, and all the vertices
+ * below them in the tree, are taken off the tree. Dijkstra then runs from
+ * the vertices left on it that are next to those, over the part of the
+ * graph taken off only. A vertex left on the tree is still on a shortest
+ * path, unless one of the vertices put back offers it a path at least as
+ * short: the repair is then abandoned for a full calculation.
+ *
+ * When only stub networks changed, or summary LSAs, the tree is kept as
+ * it is and only routes get recalculated from it.
+ *
+ * Returns false when the full calculation is needed.
+ */
+static bool ospf_spf_repair(struct ospf *ospf, struct ospf_area *area)
+{
+	struct listnode *node, *nnode, *vpnode;
+	struct vertex_parent *vp;
+	struct list *affected, *borders;
+	struct ospf_spf_heap candidate;
+	struct ospf_lsa *lsa;
+	struct vertex *v;
+	bool abort = false;
+
+	if (!area->spf || !area->router_lsa_self)
+		return false;
+
+	ospf_lsdb_clean_stat(area->lsdb);
+
+	/* Refer to the LSDB's instances of the LSAs, noting the vertices
+	 * whose transit links changed or that went away.
+	 */
+	affected = list_new();
+	for (ALL_LIST_ELEMENTS_RO(area->spf_vertices, node, v)) {
+		lsa = ospf_lsa_lookup_by_id(area, v->type, v->id);
+		if (lsa && !IS_LSA_MAXAGE(lsa)
+		    && ospf_spf_lsa_links_same(v->lsa, lsa->data)) {
+			ospf_vertex_rebind(v, lsa);
+			continue;
+		}
+
+		if (v == area->spf) {
+			list_delete_and_null(&affected);
+			return false;
+		}
+		listnode_add(affected, v);
+	}
+
+	if (listcount(affected)) {
+		for (ALL_LIST_ELEMENTS_RO(affected, node, v))
+			ospf_spf_mark_affected(v);
+		list_delete_all_node(affected);
+
+		/* Take the affected vertices off the tree, keeping the LSDB
+		 * instance of their LSAs to compute them again.
+		 */
+		for (ALL_LIST_ELEMENTS_RO(area->spf_vertices, node, v)) {
+			if (!CHECK_FLAG(v->flags, OSPF_VERTEX_AFFECTED)) {
+				OSPF_LSA_SPF_STAT_SET(area->lsdb,
+						      v->lsa_instance,
+						      LSA_SPF_IN_SPFTREE);
+				continue;
+			}
+
+			for (ALL_LIST_ELEMENTS_RO(v->parents, vpnode, vp)) {
+				if (vp->nexthop
+				    && ospf_vertex_parent_owns_nexthop(area, vp)) {
+					vertex_nexthop_free(area, vp->nexthop);
+					vp->nexthop = NULL;
+				}
+				if (!CHECK_FLAG(vp->parent->flags,
+						OSPF_VERTEX_AFFECTED))
+					listnode_delete(vp->parent->children, v);
+			}
+
+			lsa = ospf_lsa_lookup_by_id(area, v->type, v->id);
+			if (lsa && !IS_LSA_MAXAGE(lsa))
+				listnode_add(affected, ospf_lsa_lock(lsa));
+		}
+
+		for (ALL_LIST_ELEMENTS(area->spf_vertices, node, nnode, v)) {
+			if (!CHECK_FLAG(v->flags, OSPF_VERTEX_AFFECTED))
+				continue;
+
+			hash_release(area->spf_vertex_hash, v);
+			list_delete_node(area->spf_vertices, node);
+			ospf_vertex_free(v);
+		}
+
+		ospf_spf_heap_init(&candidate, area);
+
+		/* Examine again the links of the vertices next to those */
+		borders = list_new();
+		for (ALL_LIST_ELEMENTS_RO(affected, node, lsa)) {
+			ospf_spf_repair_borders(area, lsa, borders);
+			ospf_lsa_unlock(&lsa);
+		}
+		list_delete_and_null(&affected);
+
+		for (ALL_LIST_ELEMENTS_RO(borders, node, v)) {
+			UNSET_FLAG(v->flags, OSPF_VERTEX_BORDER);
+			ospf_spf_next(v, ospf, area, &candidate, NULL);
+		}
+		list_delete_and_null(&borders);
+
+		/* RFC2328 16.1. (3). over the vertices taken off */
+		while (candidate.size && !abort) {
+			v = ospf_spf_heap_pop(&candidate);
+			*(v->stat) = LSA_SPF_IN_SPFTREE;
+
+			ospf_vertex_add_parent(v);
+			ospf_spf_tree_add(area, v);
+			SET_FLAG(v->flags, OSPF_VERTEX_REPAIRED);
+
+			ospf_spf_next(v, ospf, area, &candidate, &abort);
+		}
+
+		ospf_spf_heap_fini(&candidate);
+		ospf_spf_vertices_prune(area);
+
+		if (abort) {
+			if (IS_DEBUG_OSPF_EVENT)
+				zlog_debug(
+					"%s: area %s needs a full calculation",
+					__func__, inet_ntoa(area->area_id));
+			return false;
+		}
+
+		for (ALL_LIST_ELEMENTS_RO(area->spf_vertices, node, v))
+			UNSET_FLAG(v->flags, OSPF_VERTEX_REPAIRED);
+	} else
+		list_delete_and_null(&affected);
+
+	area->spf_calculation++;
+	area->spf_incremental++;
+
+	monotime(&area->ts_spf);
+
+	if (IS_DEBUG_OSPF_EVENT)
+		zlog_debug("%s: area %s repaired, %u vertices", __func__,
+			   inet_ntoa(area->area_id),
+			   listcount(area->spf_vertices));
+
+	return true;
+}
+
 /* Calculating the shortest-path tree for an area. */
-static void ospf_spf_calculate(struct ospf *ospf, struct ospf_area *area,
-			       struct route_table *new_table,
-			       struct route_table *new_rtrs)
+static void ospf_spf_calculate(struct ospf *ospf, struct ospf_area *area)
 {
-	struct pqueue *candidate;
+	struct ospf_spf_heap candidate;
 	struct vertex *v;
 
+	/* Start over from the root */
+	ospf_spf_tree_free(area);
+
 	if (IS_DEBUG_OSPF_EVENT) {
 		zlog_debug("ospf_spf_calculate: Start");
 		zlog_debug("ospf_spf_calculate: running Dijkstra for area %s",
@@ -1186,13 +1754,10 @@ static void ospf_spf_calculate(struct ospf *ospf, struct ospf_area *area,
 	/* RFC2328 16.1. (1). */
 	/* Initialize the algorithm's data structures. */
 
-	/* This function scans all the LSA database and set the stat field to
-	 * LSA_SPF_NOT_EXPLORED. */
+	/* Make every LSA of the database read as LSA_SPF_NOT_EXPLORED. */
 	ospf_lsdb_clean_stat(area->lsdb);
 	/* Create a new heap for the candidates. */
-	candidate = pqueue_create();
-	candidate->cmp = cmp;
-	candidate->update = update_stat;
+	ospf_spf_heap_init(&candidate, area);
 
 	/* Initialize the shortest-path tree to only the root (which is the
 	   router doing the calculation). */
@@ -1209,13 +1774,13 @@ static void ospf_spf_calculate(struct ospf *ospf, struct ospf_area *area,
 
 	for (;;) {
 		/* RFC2328 16.1. (2). */
-		ospf_spf_next(v, ospf, area, candidate);
+		ospf_spf_next(v, ospf, area, &candidate, NULL);
 
 		/* RFC2328 16.1. (3). */
 		/* If at this step the candidate list is empty, the shortest-
 		   path tree (of transit vertices) has been completely built and
 		   this stage of the procedure terminates. */
-		if (candidate->size == 0)
+		if (candidate.size == 0)
 			break;
 
 		/* Otherwise, choose the vertex belonging to the candidate list
@@ -1223,55 +1788,184 @@ static void ospf_spf_calculate(struct ospf *ospf, struct ospf_area *area,
 		   tree (removing it from the candidate list in the
 		   process). */
 		/* Extract from the candidates the node with the lower key. */
-		v = (struct vertex *)pqueue_dequeue(candidate);
+		v = ospf_spf_heap_pop(&candidate);
 		/* Update stat field in vertex. */
 		*(v->stat) = LSA_SPF_IN_SPFTREE;
 
+		/* The routes, RFC2328 16.1. (4). and the second stage, are
+		 * added from the tree by ospf_spf_routes_add().
+		 */
 		ospf_vertex_add_parent(v);
-
-		/* RFC2328 16.1. (4). */
-		if (v->type == OSPF_VERTEX_ROUTER)
-			ospf_intra_add_router(new_rtrs, v, area);
-		else
-			ospf_intra_add_transit(new_table, v, area);
+		ospf_spf_tree_add(area, v);
 
 		/* RFC2328 16.1. (5). */
 		/* Iterate the algorithm by returning to Step 2. */
 
 	} /* end loop until no more candidate vertices */
 
-	if (IS_DEBUG_OSPF_EVENT) {
+	if (IS_DEBUG_OSPF_EVENT)
 		ospf_spf_dump(area->spf, 0);
-		ospf_route_table_dump(new_table);
-	}
-
-	/* Second stage of SPF calculation procedure's  */
-	ospf_spf_process_stubs(area, area->spf, new_table, 0);
 
 	/* Free candidate queue. */
-	pqueue_delete(candidate);
+	ospf_spf_heap_fini(&candidate);
 
 	ospf_vertex_dump(__func__, area->spf, 0, 1);
-	/* Free nexthop information, canonical versions of which are attached
-	 * the first level of router vertices attached to the root vertex, see
-	 * ospf_nexthop_calculation.
-	 */
-	ospf_canonical_nexthops_free(area->spf);
 
 	/* Increment SPF Calculation Counter. */
 	area->spf_calculation++;
 
-	monotime(&area->ospf->ts_spf);
-	area->ts_spf = area->ospf->ts_spf;
+	monotime(&area->ts_spf);
 
 	if (IS_DEBUG_OSPF_EVENT)
 		zlog_debug("ospf_spf_calculate: Stop. %zd vertices",
 			   mtype_stats_alloc(MTYPE_OSPF_VERTEX));
 
-	/* Free SPF vertices, but not the list. List has ospf_vertex_free
-	 * as deconstructor.
+	/* Free the SPF vertices that are not on the tree, the tree is kept
+	 * for the next calculation.
 	 */
-	list_delete_all_node(&vertex_list);
+	ospf_spf_vertices_prune(area);
+
+	/* Give back the memory of a tree that shrank */
+	if (area->spf_vertex_slab)
+		slab_reclaim(area->spf_vertex_slab);
+	if (area->spf_parent_slab)
+		slab_reclaim(area->spf_parent_slab);
+	if (area->spf_nexthop_slab)
+		slab_reclaim(area->spf_nexthop_slab);
+}
+
+/* Calculate the area's tree, repairing the previous one if possible. */
+static void ospf_spf_area_tree(struct ospf *ospf, struct ospf_area *area)
+{
+	if (!ospf_spf_repair(ospf, area))
+		ospf_spf_calculate(ospf, area);
+}
+
+/*
+ * Pool of pthreads calculating different areas' trees concurrently, see
+ * ospf_spf_pool_run().  It is only started by the first calculation, as
+ * pthreads would not survive daemonizing after the configuration has been
+ * read.
+ */
+struct ospf_spf_pool {
+	struct frr_pthread *fpt[OSPF_SPF_WORKERS_MAX];
+	unsigned int count;
+
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	unsigned int pending; /* Requires: mtx */
+};
+
+static void ospf_spf_pool_adjust(struct ospf_spf_pool *pool,
+				 unsigned int count)
+{
+	struct frr_pthread *fpt;
+
+	while (pool->count < count) {
+		fpt = frr_pthread_new(NULL, "OSPF SPF worker");
+		if (!fpt || frr_pthread_run(fpt, NULL) < 0) {
+			zlog_err("%s: could not start SPF worker", __func__);
+			if (fpt)
+				frr_pthread_destroy(fpt);
+			return;
+		}
+		frr_pthread_wait_running(fpt);
+		pool->fpt[pool->count++] = fpt;
+	}
+
+	while (pool->count > count) {
+		fpt = pool->fpt[--pool->count];
+		frr_pthread_stop(fpt, NULL);
+		frr_pthread_destroy(fpt);
+	}
+}
+
+static void ospf_spf_pool_free(struct ospf_spf_pool *pool)
+{
+	ospf_spf_pool_adjust(pool, 0);
+	pthread_mutex_destroy(&pool->mtx);
+	pthread_cond_destroy(&pool->cond);
+	XFREE(MTYPE_OSPF_SPF_POOL, pool);
+}
+
+static int ospf_spf_pool_job(struct thread *thread)
+{
+	struct ospf_area *area = THREAD_ARG(thread);
+	struct ospf_spf_pool *pool = area->ospf->spf_pool;
+
+	ospf_spf_area_tree(area->ospf, area);
+
+	pthread_mutex_lock(&pool->mtx);
+	{
+		if (--pool->pending == 0)
+			pthread_cond_signal(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->mtx);
+
+	return 0;
+}
+
+/* Whether the area's tree waits for the other areas' routes */
+static bool ospf_spf_area_serial(struct ospf *ospf, struct ospf_area *area)
+{
+	/* The nexthops of virtual links come from their transit areas */
+	return area == ospf->backbone && listcount(ospf->vlinks);
+}
+
+/*
+ * Calculates the areas' trees on the pool, the main pthread waiting for
+ * them all.  An area's calculation only touches the area, its LSDB and
+ * interfaces, and what it allocates comes from the area's slabs; the
+ * routes are then added from the trees on the main pthread, as are the
+ * virtual links brought up, in the order used without the pool.
+ *
+ * Returns false if the pool could not be started.
+ */
+static bool ospf_spf_pool_run(struct ospf *ospf)
+{
+	struct ospf_spf_pool *pool = ospf->spf_pool;
+	struct listnode *node;
+	struct ospf_area *area;
+	unsigned int i = 0;
+
+	if (!pool) {
+		pool = XCALLOC(MTYPE_OSPF_SPF_POOL,
+			       sizeof(struct ospf_spf_pool));
+		pthread_mutex_init(&pool->mtx, NULL);
+		pthread_cond_init(&pool->cond, NULL);
+		ospf->spf_pool = pool;
+	}
+	ospf_spf_pool_adjust(pool, ospf->spf_workers);
+	if (!pool->count)
+		return false;
+
+	pthread_mutex_lock(&pool->mtx);
+	{
+		for (ALL_LIST_ELEMENTS_RO(ospf->areas, node, area)) {
+			if (ospf_spf_area_serial(ospf, area))
+				continue;
+
+			pool->pending++;
+			thread_post_event(pool->fpt[i++ % pool->count]->master,
+					  ospf_spf_pool_job, area, 0);
+		}
+
+		while (pool->pending)
+			pthread_cond_wait(&pool->cond, &pool->mtx);
+	}
+	pthread_mutex_unlock(&pool->mtx);
+
+	return true;
+}
+
+void ospf_spf_workers_set(struct ospf *ospf, unsigned int count)
+{
+	ospf->spf_workers = count;
+
+	if (ospf->spf_pool && !count) {
+		ospf_spf_pool_free(ospf->spf_pool);
+		ospf->spf_pool = NULL;
+	}
 }
 
 /* Timer for SPF calculation. */
@@ -1282,6 +1976,7 @@ static int ospf_spf_calculate_timer(struct thread *thread)
 	struct ospf_area *area;
 	struct listnode *node, *nnode;
 	struct timeval start_time, spf_start_time;
+	bool parallel = false;
 	int areas_processed = 0;
 	unsigned long ia_time, prune_time, rt_time;
 	unsigned long abr_time, total_spf_time, spf_time;
@@ -1299,6 +1994,9 @@ static int ospf_spf_calculate_timer(struct thread *thread)
 
 	ospf_vl_unapprove(ospf);
 
+	if (ospf->spf_workers)
+		parallel = ospf_spf_pool_run(ospf);
+
 	/* Calculate SPF for each area. */
 	for (ALL_LIST_ELEMENTS(ospf->areas, node, nnode, area)) {
 		/* Do backbone last, so as to first discover intra-area paths
@@ -1307,16 +2005,22 @@ static int ospf_spf_calculate_timer(struct thread *thread)
 		if (ospf->backbone && ospf->backbone == area)
 			continue;
 
-		ospf_spf_calculate(ospf, area, new_table, new_rtrs);
+		if (!parallel)
+			ospf_spf_area_tree(ospf, area);
+		ospf_spf_routes_add(area, new_table, new_rtrs);
 		areas_processed++;
 	}
 
 	/* SPF for backbone, if required */
 	if (ospf->backbone) {
-		ospf_spf_calculate(ospf, ospf->backbone, new_table, new_rtrs);
+		if (!parallel || ospf_spf_area_serial(ospf, ospf->backbone))
+			ospf_spf_area_tree(ospf, ospf->backbone);
+		ospf_spf_routes_add(ospf->backbone, new_table, new_rtrs);
 		areas_processed++;
 	}
 
+	monotime(&ospf->ts_spf);
+
 	spf_time = monotime_since(&spf_start_time, NULL);
 
 	ospf_vl_shut_unapproved(ospf);
@@ -1428,6 +2132,15 @@ void ospf_spf_calculate_schedule(struct ospf *ospf, ospf_spf_reason_t reason)
 
 	ospf_spf_set_reason(reason);
 
+	/* The configuration may change how the tree is computed */
+	if (reason == SPF_FLAG_CONFIG_CHANGE) {
+		struct ospf_area *area;
+		struct listnode *node;
+
+		for (ALL_LIST_ELEMENTS_RO(ospf->areas, node, area))
+			ospf_spf_tree_free(area);
+	}
+
 	/* SPF calculation timer is already scheduled. */
 	if (ospf->t_spf_calc) {
 		if (IS_DEBUG_OSPF_EVENT)
@@ -28,6 +28,11 @@
 
 /* values for vertex->flags */
 #define OSPF_VERTEX_PROCESSED      0x01
+#define OSPF_VERTEX_IN_TREE        0x02 /* on the area's SPF tree */
+/* used by the incremental calculation, see ospf_spf_repair() */
+#define OSPF_VERTEX_AFFECTED       0x04
+#define OSPF_VERTEX_REPAIRED       0x08
+#define OSPF_VERTEX_BORDER         0x10
 
 /* The "root" is the node running the SPF calculation */
 
@@ -38,9 +43,11 @@ struct vertex {
 	struct in_addr id;      /* copied from LSA header */
 	struct lsa_header *lsa; /* Router or Network LSA */
 	int *stat;		/* Link to LSA status. */
+	struct ospf_lsa *lsa_instance; /* locked, lsa and stat point into it */
 	uint32_t distance;      /* from root to this vertex */
 	struct list *parents;   /* list of parents in SPF tree */
 	struct list *children;  /* list of children in SPF tree*/
+	struct ospf_area *area; /* whose slabs it comes from */
 };
 
 /* A nexthop taken on the root node to get to this (parent) vertex */
@@ -56,6 +63,9 @@ struct vertex_parent {
 	int backlink;	  /* index back to parent for router-lsa's */
 };
 
+/* Most pthreads calculating different areas' trees concurrently */
+#define OSPF_SPF_WORKERS_MAX 8
+
 /* What triggered the SPF ? */
 typedef enum {
 	SPF_FLAG_ROUTER_LSA_INSTALL = 1,
@@ -69,6 +79,10 @@ typedef enum {
 } ospf_spf_reason_t;
 
 extern void ospf_spf_calculate_schedule(struct ospf *, ospf_spf_reason_t);
+extern void ospf_spf_workers_set(struct ospf *, unsigned int);
+extern void ospf_spf_lsa_install(struct ospf_area *, struct ospf_lsa *);
+extern void ospf_spf_tree_free(struct ospf_area *);
+extern void ospf_spf_area_free(struct ospf_area *);
 extern void ospf_rtrs_free(struct route_table *);
 
 /* void ospf_spf_calculate_timer_add (); */
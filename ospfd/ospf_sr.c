@@ -75,6 +75,8 @@
 static struct ospf_sr_db OspfSR;
 static void ospf_sr_register_vty(void);
 static inline void del_sid_nhlfe(struct sr_nhlfe nhlfe);
+static void ospf_sr_batch_begin(void);
+static void ospf_sr_batch_end(void);
 
 /*
  * Segment Routing Data Base functions
@@ -290,7 +292,9 @@ static void ospf_sr_stop(void)
 	 * Remove all SR Nodes from the Hash table. Prefix and Link SID will
 	 * be remove though list_delete_and_null() call. See sr_node_del()
 	 */
+	ospf_sr_batch_begin();
 	hash_clean(OspfSR.neighbors, (void *)sr_node_del);
+	ospf_sr_batch_end();
 }
 
 /*
@@ -359,6 +363,12 @@ void ospf_sr_term(void)
 	if (OspfSR.prefix)
 		route_table_finish(OspfSR.prefix);
 
+	if (OspfSR.batch_add)
+		stream_free(OspfSR.batch_add);
+	if (OspfSR.batch_del)
+		stream_free(OspfSR.batch_del);
+	OspfSR.batch_add = OspfSR.batch_del = NULL;
+
 	OspfSR.enabled = false;
 	OspfSR.self = NULL;
 }
@@ -610,16 +620,62 @@ static int compute_prefix_nhlfe(struct sr_prefix *srp)
 	return rc;
 }
 
+/* Size of one IPv4 entry of a ZEBRA_MPLS_LABELS_ADD/DELETE message */
+#define OSPF_SR_LABELS_ENTRY_SIZE (1 + 4 + 4 + 1 + 4 + 4 + 1 + 4 + 4)
+
+/* Send the label entries gathered in s, if any, to zebra */
+static int ospf_sr_batch_flush(struct stream *s)
+{
+	if (!s || !stream_get_endp(s))
+		return 0;
+
+	stream_putw_at(s, 0, stream_get_endp(s));
+	stream_copy(zclient->obuf, s);
+	stream_reset(s);
+
+	return zclient_send_message(zclient);
+}
+
+/*
+ * Between these two, label entries sent to zebra are packed several to a
+ * message, as zebra reads them all. For the bulk updates following an SPF
+ * or an SRGB change. FEC routes are still sent one by one.
+ */
+static void ospf_sr_batch_begin(void)
+{
+	OspfSR.batch = true;
+}
+
+static void ospf_sr_batch_end(void)
+{
+	OspfSR.batch = false;
+	ospf_sr_batch_flush(OspfSR.batch_del);
+	ospf_sr_batch_flush(OspfSR.batch_add);
+}
+
 /* Send MPLS Label entry to Zebra for installation or deletion */
 static int ospf_zebra_send_mpls_labels(int cmd, struct sr_nhlfe nhlfe)
 {
 	struct stream *s;
+	struct stream **batch;
+
+	if (OspfSR.batch) {
+		batch = (cmd == ZEBRA_MPLS_LABELS_ADD) ? &OspfSR.batch_add
+						       : &OspfSR.batch_del;
+		if (*batch == NULL)
+			*batch = stream_new(ZEBRA_MAX_PACKET_SIZ);
+		s = *batch;
+		if (STREAM_WRITEABLE(s) < OSPF_SR_LABELS_ENTRY_SIZE)
+			ospf_sr_batch_flush(s);
+		if (!stream_get_endp(s))
+			zclient_create_header(s, cmd, VRF_DEFAULT);
+	} else {
+		/* Reset stream. */
+		s = zclient->obuf;
+		stream_reset(s);
 
-	/* Reset stream. */
-	s = zclient->obuf;
-	stream_reset(s);
-
-	zclient_create_header(s, cmd, VRF_DEFAULT);
+		zclient_create_header(s, cmd, VRF_DEFAULT);
+	}
 	stream_putc(s, ZEBRA_LSP_SR);
 	/* OSPF Segment Routing currently support only IPv4 */
 	stream_putl(s, nhlfe.prefv4.family);
@@ -631,9 +687,6 @@ static int ospf_zebra_send_mpls_labels(int cmd, struct sr_nhlfe nhlfe)
 	stream_putl(s, nhlfe.label_in);
 	stream_putl(s, nhlfe.label_out);
 
-	/* Put length at the first point of the stream. */
-	stream_putw_at(s, 0, stream_get_endp(s));
-
 	if (IS_DEBUG_OSPF_SR)
 		zlog_debug("    |-  %s LSP %u/%u for %s/%u via %u",
 			   cmd == ZEBRA_MPLS_LABELS_ADD ? "Add" : "Delete",
@@ -641,6 +694,12 @@ static int ospf_zebra_send_mpls_labels(int cmd, struct sr_nhlfe nhlfe)
 			   inet_ntoa(nhlfe.prefv4.prefix),
 			   nhlfe.prefv4.prefixlen, nhlfe.ifindex);
 
+	if (OspfSR.batch)
+		return 0;
+
+	/* Put length at the first point of the stream. */
+	stream_putw_at(s, 0, stream_get_endp(s));
+
 	return zclient_send_message(zclient);
 }
 
@@ -687,6 +746,19 @@ static int ospf_zebra_send_mpls_ftn(int cmd, struct sr_nhlfe nhlfe)
 	return zclient_route_send(cmd, zclient, &api);
 }
 
+/* Is the NHLFE of a SID complete, i.e. installed in zebra? */
+static inline bool sid_nhlfe_valid(struct sr_nhlfe *nhlfe)
+{
+	return (nhlfe->label_in != 0) && (nhlfe->label_out != 0);
+}
+
+/* Is a FEC route installed along with the NHLFE? */
+static inline bool sid_nhlfe_ftn(struct sr_nhlfe *nhlfe)
+{
+	return sid_nhlfe_valid(nhlfe)
+	       && (nhlfe->label_out != MPLS_LABEL_IMPLICIT_NULL);
+}
+
 /* Add new NHLFE entry for SID */
 static inline void add_sid_nhlfe(struct sr_nhlfe nhlfe)
 {
@@ -707,12 +779,44 @@ static inline void del_sid_nhlfe(struct sr_nhlfe nhlfe)
 	}
 }
 
-/* Update NHLFE entry for SID */
+/*
+ * Update NHLFE entry for SID, telling zebra only what changed from n1 to
+ * n2: an unchanged entry is not sent again, and a new output label on the
+ * same input label and nexthop replaces the old one in place.
+ */
 static inline void update_sid_nhlfe(struct sr_nhlfe n1, struct sr_nhlfe n2)
 {
+	bool same_lsp;
 
-	del_sid_nhlfe(n1);
-	add_sid_nhlfe(n2);
+	if (!sid_nhlfe_valid(&n1)) {
+		add_sid_nhlfe(n2);
+		return;
+	}
+	if (!sid_nhlfe_valid(&n2)) {
+		del_sid_nhlfe(n1);
+		return;
+	}
+
+	same_lsp = (n1.label_in == n2.label_in)
+		   && IPV4_ADDR_SAME(&n1.nexthop, &n2.nexthop)
+		   && (n1.ifindex == n2.ifindex);
+
+	if (same_lsp && (n1.label_out == n2.label_out))
+		return;
+
+	/* Input label to nexthop entry */
+	if (!same_lsp)
+		ospf_zebra_send_mpls_labels(ZEBRA_MPLS_LABELS_DELETE, n1);
+	ospf_zebra_send_mpls_labels(ZEBRA_MPLS_LABELS_ADD, n2);
+
+	/* FEC route, replaced by the add; it does not use the input label */
+	if (sid_nhlfe_ftn(&n2)) {
+		if (!sid_nhlfe_ftn(&n1) || (n1.label_out != n2.label_out)
+		    || !IPV4_ADDR_SAME(&n1.nexthop, &n2.nexthop)
+		    || (n1.ifindex != n2.ifindex))
+			ospf_zebra_send_mpls_ftn(ZEBRA_ROUTE_ADD, n2);
+	} else if (sid_nhlfe_ftn(&n1))
+		ospf_zebra_send_mpls_ftn(ZEBRA_ROUTE_DELETE, n1);
 }
 
 /*
@@ -1075,6 +1179,12 @@ static void update_out_nhlfe(struct hash_backet *backet, void *args)
 		if ((srp->nexthop == NULL)
 		    && (!CHECK_FLAG(srp->flags, EXT_SUBTLV_PREFIX_SID_NPFLG)))
 			continue;
+		/* and only the prefixes reached through srnext */
+		if ((srp->nexthop ? srp->nexthop : srn) != srnext)
+			continue;
+		/* Nothing to change for a SID value */
+		if (CHECK_FLAG(srp->flags, EXT_SUBTLV_PREFIX_SID_VFLG))
+			continue;
 		memcpy(&new, &srp->nhlfe, sizeof(struct sr_nhlfe));
 		new.label_out = index2label(srp->sid, srnext->srgb);
 		update_sid_nhlfe(srp->nhlfe, new);
@@ -1197,11 +1307,14 @@ void ospf_sr_ri_lsa_update(struct ospf_lsa *lsa)
 		srn->srgb.range_size = srgb.range_size;
 		srn->srgb.lower_bound = srgb.lower_bound;
 		/* Update NHLFE if it is a neighbor SR node */
-		if (srn->neighbor == OspfSR.self)
+		if (srn->neighbor == OspfSR.self) {
+			ospf_sr_batch_begin();
 			hash_iterate(OspfSR.neighbors,
 				     (void (*)(struct hash_backet *,
 					       void *))update_out_nhlfe,
 				     (void *)srn);
+			ospf_sr_batch_end();
+		}
 	}
 }
 
@@ -1562,6 +1675,12 @@ static void ospf_sr_nhlfe_update(struct hash_backet *backet, void *args)
 		/* next hop is not know, remove old NHLFE to avoid loop */
 		case -1:
 			del_sid_nhlfe(srp->nhlfe);
+			/* and forget it, so it is not removed again on each
+			 * SPF and is installed afresh once a nexthop is back */
+			srp->nhlfe.nexthop.s_addr = INADDR_ANY;
+			srp->nhlfe.ifindex = 0;
+			srp->nhlfe.label_in = 0;
+			srp->nhlfe.label_out = 0;
 			break;
 		/* next hop has not changed, skip it */
 		case 0:
@@ -1593,9 +1712,11 @@ static int ospf_sr_update_schedule(struct thread *t)
 	if (IS_DEBUG_OSPF_SR)
 		zlog_debug("SR (%s): Start SPF update", __func__);
 
+	ospf_sr_batch_begin();
 	hash_iterate(OspfSR.neighbors, (void (*)(struct hash_backet *,
 						 void *))ospf_sr_nhlfe_update,
 		     NULL);
+	ospf_sr_batch_end();
 
 	monotime(&stop_time);
 
@@ -1820,9 +1941,11 @@ DEFUN (sr_sid_label_range,
 	ospf_router_info_update_sr(true, OspfSR.srgb, OspfSR.msd);
 
 	/* Update NHLFE entries */
+	ospf_sr_batch_begin();
 	hash_iterate(OspfSR.neighbors,
 		     (void (*)(struct hash_backet *, void *))update_in_nhlfe,
 		     NULL);
+	ospf_sr_batch_end();
 
 	return CMD_SUCCESS;
 }
@@ -1852,9 +1975,11 @@ DEFUN (no_sr_sid_label_range,
 	ospf_router_info_update_sr(true, OspfSR.srgb, OspfSR.msd);
 
 	/* Update NHLFE entries */
+	ospf_sr_batch_begin();
 	hash_iterate(OspfSR.neighbors,
 		     (void (*)(struct hash_backet *, void *))update_in_nhlfe,
 		     NULL);
+	ospf_sr_batch_end();
 
 	return CMD_SUCCESS;
 }
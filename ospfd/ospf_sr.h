@@ -193,6 +193,14 @@ struct ospf_sr_db {
 	/* Ongoing Update following an OSPF SPF */
 	bool update;
 
+	/*
+	 * Label entries for zebra are gathered into one message per command
+	 * while set, see ospf_sr_batch_begin()
+	 */
+	bool batch;
+	struct stream *batch_add;
+	struct stream *batch_del;
+
 	/* Flooding Scope: Area = 10 or AS = 11 */
 	uint8_t scope;
 
@@ -2299,6 +2299,34 @@ DEFUN (no_ospf_timers_throttle_spf,
 				   OSPF_SPF_MAX_HOLDTIME_DEFAULT);
 }
 
+DEFUN (ospf_spf_workers,
+       ospf_spf_workers_cmd,
+       "spf workers (1-8)",
+       "SPF calculation\n"
+       "Pthreads calculating different areas' shortest-path trees concurrently\n"
+       "Number of pthreads\n")
+{
+	VTY_DECLVAR_INSTANCE_CONTEXT(ospf, ospf);
+	int idx_number = 2;
+
+	ospf_spf_workers_set(ospf, strtoul(argv[idx_number]->arg, NULL, 10));
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_ospf_spf_workers,
+       no_ospf_spf_workers_cmd,
+       "no spf workers [(1-8)]",
+       NO_STR
+       "SPF calculation\n"
+       "Pthreads calculating different areas' shortest-path trees concurrently\n"
+       "Number of pthreads\n")
+{
+	VTY_DECLVAR_INSTANCE_CONTEXT(ospf, ospf);
+
+	ospf_spf_workers_set(ospf, 0);
+	return CMD_SUCCESS;
+}
+
 
 DEFUN (ospf_timers_lsa_min_arrival,
        ospf_timers_lsa_min_arrival_cmd,
@@ -2838,6 +2866,8 @@ static void show_ip_ospf_area(struct vty *vty, struct ospf_area *area,
 		/* Show SPF calculation times. */
 		json_object_int_add(json_area, "spfExecutedCounter",
 				    area->spf_calculation);
+		json_object_int_add(json_area, "spfIncrementalCounter",
+				    area->spf_incremental);
 		json_object_int_add(json_area, "lsaNumber", area->lsdb->total);
 		json_object_int_add(
 			json_area, "lsaRouterNumber",
@@ -2894,6 +2924,8 @@ static void show_ip_ospf_area(struct vty *vty, struct ospf_area *area,
 		/* Show SPF calculation times. */
 		vty_out(vty, "   SPF algorithm executed %d times\n",
 			area->spf_calculation);
+		vty_out(vty, "   SPF algorithm executed incrementally %d times\n",
+			area->spf_incremental);
 
 		/* Show number of LSA. */
 		vty_out(vty, "   Number of LSA %ld\n", area->lsdb->total);
@@ -10263,6 +10295,9 @@ static int ospf_config_write_one(struct vty *vty, struct ospf *ospf)
 		vty_out(vty, " timers throttle spf %d %d %d\n", ospf->spf_delay,
 			ospf->spf_holdtime, ospf->spf_max_holdtime);
 
+	if (ospf->spf_workers)
+		vty_out(vty, " spf workers %u\n", ospf->spf_workers);
+
 	/* LSA timers print. */
 	if (ospf->min_ls_interval != OSPF_MIN_LS_INTERVAL)
 		vty_out(vty, " timers throttle lsa all %d\n",
@@ -10681,6 +10716,10 @@ void ospf_vty_init(void)
 	install_element(OSPF_NODE, &ospf_timers_throttle_spf_cmd);
 	install_element(OSPF_NODE, &no_ospf_timers_throttle_spf_cmd);
 
+	/* SPF workers commands */
+	install_element(OSPF_NODE, &ospf_spf_workers_cmd);
+	install_element(OSPF_NODE, &no_ospf_spf_workers_cmd);
+
 	/* LSA timers commands */
 	install_element(OSPF_NODE, &ospf_timers_min_ls_interval_cmd);
 	install_element(OSPF_NODE, &no_ospf_timers_min_ls_interval_cmd);
@@ -51,6 +51,7 @@
 #include "ospfd/ospf_spf.h"
 #include "ospfd/ospf_packet.h"
 #include "ospfd/ospf_dump.h"
+#include "ospfd/ospf_io.h"
 #include "ospfd/ospf_zebra.h"
 #include "ospfd/ospf_abr.h"
 #include "ospfd/ospf_flood.h"
@@ -308,13 +309,9 @@ static struct ospf *ospf_new(unsigned short instance, const char *name)
 			 new->lsa_refresh_interval, &new->t_lsa_refresher);
 	new->lsa_refresher_started = monotime(NULL);
 
-	if ((new->ibuf = stream_new(OSPF_MAX_PACKET_SIZE + 1)) == NULL) {
-		zlog_err(
-			"ospf_new: fatal error: stream_new(%u) failed allocating ibuf",
-			OSPF_MAX_PACKET_SIZE + 1);
-		exit(1);
-	}
 	new->t_read = NULL;
+	pthread_mutex_init(&new->io_mtx, NULL);
+	new->io_queue = list_new();
 	new->oi_write_q = list_new();
 	new->write_oi_count = OSPF_WRITE_INTERFACE_COUNT_DEFAULT;
 
@@ -333,7 +330,7 @@ static struct ospf *ospf_new(unsigned short instance, const char *name)
 				__func__);
 		return new;
 	}
-	thread_add_read(master, ospf_read, new, new->fd, &new->t_read);
+	ospf_reads_on(new);
 
 	return new;
 }
@@ -580,6 +577,7 @@ void ospf_terminate(void)
 	zclient_stop(zclient);
 	zclient_free(zclient);
 
+	ospf_io_finish();
 	frr_fini();
 }
 
@@ -705,13 +703,16 @@ static void ospf_finish_final(struct ospf *ospf)
 	OSPF_TIMER_OFF(ospf->t_asbr_check);
 	OSPF_TIMER_OFF(ospf->t_distribute_update);
 	OSPF_TIMER_OFF(ospf->t_lsa_refresher);
-	OSPF_TIMER_OFF(ospf->t_read);
+	ospf_reads_off(ospf);
 	OSPF_TIMER_OFF(ospf->t_write);
 	OSPF_TIMER_OFF(ospf->t_opaque_lsa_self);
 	OSPF_TIMER_OFF(ospf->t_sr_update);
 
 	close(ospf->fd);
-	stream_free(ospf->ibuf);
+	list_delete_and_null(&ospf->io_queue);
+	pthread_mutex_destroy(&ospf->io_mtx);
+
+	ospf_spf_workers_set(ospf, 0);
 
 	LSDB_LOOP (OPAQUE_AS_LSDB(ospf), rn, lsa)
 		ospf_discard_from_db(ospf, ospf->lsdb, lsa);
@@ -849,6 +850,8 @@ static void ospf_area_free(struct ospf_area *area)
 
 	ospf_opaque_type10_lsa_term(area);
 
+	ospf_spf_area_free(area);
+
 	/* Free LSDBs. */
 	LSDB_LOOP (ROUTER_LSDB(area), rn, lsa)
 		ospf_discard_from_db(area->ospf, area->lsdb, lsa);
@@ -1306,6 +1309,7 @@ void ospf_ls_upd_queue_empty(struct ospf_interface *oi)
 			list_delete_and_null(&lst);
 			rn->info = NULL;
 		}
+	oi->ls_upd_queued = 0;
 
 	/* remove update event */
 	if (oi->t_ls_upd_event) {
@@ -2111,8 +2115,7 @@ static int ospf_vrf_enable(struct vrf *vrf)
 			}
 			if (ret < 0 || ospf->fd <= 0)
 				return 0;
-			thread_add_read(master, ospf_read, ospf, ospf->fd,
-					&ospf->t_read);
+			ospf_reads_on(ospf);
 			ospf->oi_running = 1;
 			ospf_router_id_update(ospf);
 		}
@@ -2146,7 +2149,7 @@ static int ospf_vrf_disable(struct vrf *vrf)
 		if (IS_DEBUG_OSPF_EVENT)
 			zlog_debug("%s: ospf old_vrf_id %d unlinked",
 				   __PRETTY_FUNCTION__, old_vrf_id);
-		thread_cancel(ospf->t_read);
+		ospf_reads_off(ospf);
 		close(ospf->fd);
 		ospf->fd = -1;
 	}
@@ -29,6 +29,7 @@
 #include "filter.h"
 #include "log.h"
 #include "vrf.h"
+#include "linklist.h"
 
 #include "ospf_memory.h"
 #include "ospf_dump_api.h"
@@ -183,6 +184,8 @@ struct ospf {
 	unsigned int spf_max_holdtime; /* SPF maximum-holdtime */
 	unsigned int
 		spf_hold_multiplier; /* Adaptive multiplier for hold time */
+	unsigned int spf_workers;	/* Pthreads for the areas' SPF */
+	struct ospf_spf_pool *spf_pool;
 
 	int default_originate;	/* Default information originate. */
 #define DEFAULT_ORIGINATE_NONE		0
@@ -248,11 +251,15 @@ struct ospf {
 	struct thread *t_write;
 #define OSPF_WRITE_INTERFACE_COUNT_DEFAULT    20
 	int write_oi_count; /* Num of packets sent per thread invocation */
-	struct thread *t_read;
+	struct thread *t_read; /* on the I/O pthread, see ospf_io.c */
 	int fd;
-	struct stream *ibuf;
 	struct list *oi_write_q;
 
+	/* Packets received by the I/O pthread for ospf_read(). */
+	pthread_mutex_t io_mtx;
+	struct list *io_queue;
+	struct thread *t_process_packet;
+
 	/* Distribute lists out of other route sources. */
 	struct {
 		char *name;
@@ -404,8 +411,19 @@ struct ospf_area {
 #define PREFIX_LIST_OUT(A)  (A)->plist_out.list
 #define PREFIX_NAME_OUT(A)  (A)->plist_out.name
 
-	/* Shortest Path Tree. */
+	/* Shortest Path Tree, kept until the next calculation so that it can
+	 * be repaired instead of computed again, see ospf_spf_repair().
+	 * spf_vertices are its vertices in the order they joined the tree.
+	 */
 	struct vertex *spf;
+	struct list *spf_vertices;
+	struct hash *spf_vertex_hash;
+
+	/* Where SPF allocates the area's vertices from, see ospf_spf.c */
+	struct slab *spf_vertex_slab;
+	struct slab *spf_parent_slab;
+	struct slab *spf_nexthop_slab;
+	struct list spf_new_vertices;
 
 	/* Threads. */
 	struct thread *t_stub_router;     /* Stub-router timer */
@@ -413,6 +431,7 @@ struct ospf_area {
 
 	/* Statistics field. */
 	uint32_t spf_calculation; /* SPF Calculation Count. */
+	uint32_t spf_incremental; /* Of which incremental. */
 
 	/* Time stamps. */
 	struct timeval ts_spf; /* SPF calculation time stamp. */
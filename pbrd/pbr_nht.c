@@ -180,6 +180,8 @@ static void pbr_nhgc_delete(struct pbr_nexthop_group_cache *p)
 {
 	hash_iterate(p->nhh, pbr_nh_delete_iterate, NULL);
 	hash_free(p->nhh);
+	if (p->table_id)
+		nhg_tableid[p->table_id] = false;
 	XFREE(MTYPE_PBR_NHG, p);
 }
 
@@ -457,10 +459,18 @@ void pbr_nht_change_group(const char *name)
 	pbr_nht_install_nexthop_group(pnhgc, nhgc->nhg);
 }
 
-char *pbr_nht_nexthop_make_name(char *name, size_t l,
-				uint32_t seqno, char *buffer)
+/*
+ * The group of a single nexthop is named after it, so that all the
+ * sequences using that nexthop share the group and its table.  The
+ * spaces keep it apart from the names of configured nexthop-groups.
+ */
+char *pbr_nht_nexthop_make_name(const struct nexthop *nhop, size_t l,
+				char *buffer)
 {
-	snprintf(buffer, l, "%s%u", name, seqno);
+	char buf[PREFIX_STRLEN + 16];
+
+	snprintf(buffer, l, "%s vrf %u", nexthop2str(nhop, buf, sizeof(buf)),
+		 nhop->vrf_id);
 	return buffer;
 }
 
@@ -472,13 +482,23 @@ void pbr_nht_add_individual_nexthop(struct pbr_map_sequence *pbrms)
 	struct pbr_nexthop_cache lookup;
 
 	memset(&find, 0, sizeof(find));
-	pbr_nht_nexthop_make_name(pbrms->parent->name, PBR_MAP_NAMELEN,
-				  pbrms->seqno, find.name);
-	if (!pbrms->internal_nhg_name)
-		pbrms->internal_nhg_name = XSTRDUP(MTYPE_TMP, find.name);
+	pbr_nht_nexthop_make_name(pbrms->nhg->nexthop, PBR_MAP_NAMELEN,
+				  find.name);
+	if (pbrms->internal_nhg_name)
+		XFREE(MTYPE_TMP, pbrms->internal_nhg_name);
+	pbrms->internal_nhg_name = XSTRDUP(MTYPE_TMP, find.name);
 
 	pnhgc = hash_get(pbr_nhg_hash, &find, pbr_nhgc_alloc);
 
+	/*
+	 * Another sequence with this nexthop already had the group
+	 * installed, use it as it is
+	 */
+	if (pnhgc->refcount++) {
+		pbrms->nhs_installed = pnhgc->installed;
+		return;
+	}
+
 	lookup.nexthop = pbrms->nhg->nexthop;
 	pnhc = hash_get(pnhgc->nhh, &lookup, pbr_nh_alloc);
 	pnhc->parent = pnhgc;
@@ -512,15 +532,20 @@ void pbr_nht_delete_individual_nexthop(struct pbr_map_sequence *pbrms)
 	pnhgc = hash_lookup(pbr_nhg_hash, &find);
 
 	nh = pbrms->nhg->nexthop;
-	nh_afi = nh->type;
-	lup.nexthop = nh;
-	pnhc = hash_lookup(pnhgc->nhh, &lup);
-	pnhc->parent = NULL;
-	hash_release(pnhgc->nhh, pnhc);
-	pbr_nh_delete(&pnhc);
-	pbr_nht_uninstall_nexthop_group(pnhgc, *pbrms->nhg, nh_afi);
 
-	hash_release(pbr_nhg_hash, pnhgc);
+	/* The last sequence using the group takes it down */
+	if (--pnhgc->refcount == 0) {
+		nh_afi = nh->type;
+		lup.nexthop = nh;
+		pnhc = hash_lookup(pnhgc->nhh, &lup);
+		pnhc->parent = NULL;
+		hash_release(pnhgc->nhh, pnhc);
+		pbr_nh_delete(&pnhc);
+		pbr_nht_uninstall_nexthop_group(pnhgc, *pbrms->nhg, nh_afi);
+
+		hash_release(pbr_nhg_hash, pnhgc);
+		pbr_nhgc_delete(pnhgc);
+	}
 
 	nexthop_del(pbrms->nhg, nh);
 	nexthop_free(nh);
@@ -38,6 +38,12 @@ struct pbr_nexthop_group_cache {
 	bool valid;
 
 	bool installed;
+
+	/*
+	 * For the groups of a single nexthop, the sequences that are
+	 * sharing it
+	 */
+	unsigned int refcount;
 };
 
 struct pbr_nexthop_cache {
@@ -101,7 +107,7 @@ extern uint32_t pbr_nht_get_table(const char *name);
 
 extern bool pbr_nht_get_installed(const char *name);
 
-extern char *pbr_nht_nexthop_make_name(char *name, size_t l, uint32_t seqno,
+extern char *pbr_nht_nexthop_make_name(const struct nexthop *nhop, size_t l,
 				       char *buffer);
 
 extern void pbr_nht_show_nexthop_group(struct vty *vty, const char *name);
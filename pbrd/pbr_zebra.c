@@ -31,6 +31,8 @@
 #include "filter.h"
 #include "plist.h"
 #include "log.h"
+#include "hash.h"
+#include "jhash.h"
 #include "nexthop.h"
 #include "nexthop_group.h"
 
@@ -41,10 +43,68 @@
 #include "pbr_debug.h"
 
 DEFINE_MTYPE_STATIC(PBRD, PBR_INTERFACE, "PBR Interface")
+DEFINE_MTYPE_STATIC(PBRD, PBR_RULE, "PBR Rule sent")
 
 /* Zebra structure to hold current status. */
 struct zclient *zclient;
 
+/*
+ * The rule last sent to zebra for a sequence on an interface, so that
+ * installing it again unchanged or deleting it twice sends nothing.
+ */
+struct pbr_rule_sent {
+	uint32_t unique;
+	ifindex_t ifindex;
+
+	struct prefix src;
+	struct prefix dst;
+	uint32_t table;
+};
+
+static struct hash *pbr_rule_hash;
+
+static uint32_t pbr_rule_hash_key(void *arg)
+{
+	struct pbr_rule_sent *prs = arg;
+
+	return jhash_2words(prs->unique, prs->ifindex, 0x7d3b1e05);
+}
+
+static int pbr_rule_hash_equal(const void *arg1, const void *arg2)
+{
+	const struct pbr_rule_sent *prs1 = arg1;
+	const struct pbr_rule_sent *prs2 = arg2;
+
+	return prs1->unique == prs2->unique && prs1->ifindex == prs2->ifindex;
+}
+
+static void *pbr_rule_hash_alloc(void *arg)
+{
+	struct pbr_rule_sent *prs;
+
+	prs = XMALLOC(MTYPE_PBR_RULE, sizeof(*prs));
+	*prs = *(struct pbr_rule_sent *)arg;
+
+	return prs;
+}
+
+static void pbr_rule_free(void *arg)
+{
+	XFREE(MTYPE_PBR_RULE, arg);
+}
+
+/* Zebra did not install the rule, so do send it again next time */
+static void pbr_rule_forget(uint32_t unique, ifindex_t ifindex)
+{
+	struct pbr_rule_sent lookup, *prs;
+
+	lookup.unique = unique;
+	lookup.ifindex = ifindex;
+	prs = hash_release(pbr_rule_hash, &lookup);
+	if (prs)
+		pbr_rule_free(prs);
+}
+
 static struct interface *zebra_interface_if_lookup(struct stream *s)
 {
 	char ifname_tmp[INTERFACE_NAMSIZ];
@@ -225,6 +285,7 @@ static int rule_notify_owner(int command, struct zclient *zclient,
 		DEBUGD(&pbr_dbg_zebra, "%s: Recieved RULE_FAIL_INSTALL",
 		       __PRETTY_FUNCTION__);
 		pbrms->installed = false;
+		pbr_rule_forget(unique, ifi);
 		break;
 	case ZAPI_RULE_INSTALLED:
 		pbrms->installed = true;
@@ -242,6 +303,9 @@ static int rule_notify_owner(int command, struct zclient *zclient,
 
 static void zebra_connected(struct zclient *zclient)
 {
+	/* Whatever we sent a previous zebra is gone with it */
+	hash_clean(pbr_rule_hash, pbr_rule_free);
+
 	zclient_send_reg_requests(zclient, VRF_DEFAULT);
 }
 
@@ -417,6 +481,9 @@ void pbr_zebra_init(void)
 	zclient->route_notify_owner = route_notify_owner;
 	zclient->rule_notify_owner = rule_notify_owner;
 	zclient->nexthop_update = pbr_zebra_nexthop_update;
+
+	pbr_rule_hash = hash_create_size(64, pbr_rule_hash_key,
+					 pbr_rule_hash_equal, "PBR Rules Sent");
 }
 
 void pbr_send_rnh(struct nexthop *nhop, bool reg)
@@ -470,6 +537,30 @@ static void pbr_encode_pbr_map_sequence_prefix(struct stream *s,
 	stream_put(s, &p->u.prefix, prefix_blen(p));
 }
 
+static void pbr_rule_fill(struct pbr_rule_sent *prs,
+			  struct pbr_map_sequence *pbrms)
+{
+	unsigned char family;
+
+	family = AF_INET;
+	if (pbrms->family)
+		family = pbrms->family;
+
+	memset(&prs->src, 0, sizeof(prs->src));
+	memset(&prs->dst, 0, sizeof(prs->dst));
+	prs->src.family = prs->dst.family = family;
+	if (pbrms->src)
+		prefix_copy(&prs->src, pbrms->src);
+	if (pbrms->dst)
+		prefix_copy(&prs->dst, pbrms->dst);
+
+	prs->table = 0;
+	if (pbrms->nhgrp_name)
+		prs->table = pbr_nht_get_table(pbrms->nhgrp_name);
+	else if (pbrms->nhg)
+		prs->table = pbr_nht_get_table(pbrms->internal_nhg_name);
+}
+
 static void pbr_encode_pbr_map_sequence(struct stream *s,
 					struct pbr_map_sequence *pbrms,
 					struct interface *ifp)
@@ -498,11 +589,45 @@ void pbr_send_pbr_map(struct pbr_map_sequence *pbrms,
 		      struct pbr_map_interface *pmi, bool install)
 {
 	struct pbr_map *pbrm = pbrms->parent;
+	struct pbr_rule_sent lookup, *prs;
 	struct stream *s;
 
 	DEBUGD(&pbr_dbg_zebra, "%s: for %s %d", __PRETTY_FUNCTION__, pbrm->name,
 	       install);
 
+	/*
+	 * Only tell zebra what it does not have already
+	 */
+	lookup.unique = pbrms->unique;
+	lookup.ifindex = pmi->ifp->ifindex;
+	prs = hash_lookup(pbr_rule_hash, &lookup);
+	if (install) {
+		pbr_rule_fill(&lookup, pbrms);
+		if (prs && prs->table == lookup.table
+		    && prefix_same(&prs->src, &lookup.src)
+		    && prefix_same(&prs->dst, &lookup.dst)) {
+			DEBUGD(&pbr_dbg_zebra, "%s: \t%s %u already on %s",
+			       __PRETTY_FUNCTION__, pbrm->name, pbrms->seqno,
+			       pmi->ifp->name);
+			return;
+		}
+
+		if (prs)
+			*prs = lookup;
+		else
+			hash_get(pbr_rule_hash, &lookup, pbr_rule_hash_alloc);
+	} else {
+		if (!prs) {
+			DEBUGD(&pbr_dbg_zebra, "%s: \t%s %u not on %s",
+			       __PRETTY_FUNCTION__, pbrm->name, pbrms->seqno,
+			       pmi->ifp->name);
+			return;
+		}
+
+		hash_release(pbr_rule_hash, prs);
+		pbr_rule_free(prs);
+	}
+
 	s = zclient->obuf;
 	stream_reset(s);
 
@@ -299,6 +299,7 @@ static int pim_bfd_nbr_replay(int command, struct zclient *zclient,
 	/* Send the client registration */
 	bfd_client_sendmsg(zclient, ZEBRA_BFD_CLIENT_REGISTER);
 
+	bfd_peer_batch_begin(zclient);
 	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
 		FOR_ALL_INTERFACES (vrf, ifp) {
 			pim_ifp = ifp->info;
@@ -330,6 +331,7 @@ static int pim_bfd_nbr_replay(int command, struct zclient *zclient,
 			}
 		}
 	}
+	bfd_peer_batch_end(zclient);
 	return 0;
 }
 
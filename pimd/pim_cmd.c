@@ -2305,9 +2305,11 @@ static void pim_show_upstream(struct pim_instance *pim, struct vty *vty,
 				up->rpf.source_nexthop.interface,
 				up->rpf.rpf_addr.u.prefix4);
 			if (nbr)
-				pim_time_timer_to_hhmmss(join_timer,
-							 sizeof(join_timer),
-							 nbr->jp_timer);
+				pim_time_timer_to_hhmmss(
+					join_timer, sizeof(join_timer),
+					up->jp_due_nbr == nbr
+						? nbr->jp_due_timer
+						: nbr->jp_timer);
 		}
 
 		pim_time_timer_to_hhmmss(rs_timer, sizeof(rs_timer),
@@ -8270,8 +8272,11 @@ static void ip_msdp_show_sa_entry_detail(struct pim_msdp_sa *sa,
 	} else {
 		strcpy(local_str, "no");
 	}
-	pim_time_timer_to_hhmmss(statetimer, sizeof(statetimer),
-				 sa->sa_state_timer);
+	if (sa->flags & PIM_MSDP_SAF_STATE_TIMER)
+		pim_time_uptime(statetimer, sizeof(statetimer),
+				pim_msdp_sa_state_timer_remain(sa));
+	else
+		snprintf(statetimer, sizeof(statetimer), "--:--:--");
 	if (uj) {
 		json_object_object_get_ex(json, grp_str, &json_group);
 
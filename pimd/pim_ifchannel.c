@@ -104,6 +104,7 @@ static void pim_ifchannel_find_new_children(struct pim_ifchannel *ch)
 {
 	struct pim_interface *pim_ifp = ch->interface->info;
 	struct pim_ifchannel *child;
+	struct pim_ifchannel lookup;
 
 	// Basic Sanity that we are not being silly
 	if ((ch->sg.src.s_addr != INADDR_ANY)
@@ -114,13 +115,24 @@ static void pim_ifchannel_find_new_children(struct pim_ifchannel *ch)
 	    && (ch->sg.grp.s_addr == INADDR_ANY))
 		return;
 
-	RB_FOREACH (child, pim_ifchannel_rb, &pim_ifp->ifchannel_rb) {
-		if ((ch->sg.grp.s_addr != INADDR_ANY)
-		    && (child->sg.grp.s_addr == ch->sg.grp.s_addr)
-		    && (child != ch)) {
-			child->parent = ch;
-			listnode_add_sort(ch->sources, child);
-		}
+	if (ch->sg.grp.s_addr == INADDR_ANY)
+		return;
+
+	/*
+	 * The (S,G)s follow the (*,G) on the tree, in the order sources is
+	 * kept in, which is still empty.
+	 */
+	lookup.sg.src.s_addr = INADDR_ANY;
+	lookup.sg.grp = ch->sg.grp;
+	lookup.interface = ch->interface;
+	for (child = RB_NFIND(pim_ifchannel_rb, &pim_ifp->ifchannel_rb,
+			      &lookup);
+	     child && child->sg.grp.s_addr == ch->sg.grp.s_addr;
+	     child = RB_NEXT(pim_ifchannel_rb, child)) {
+		if (child == ch)
+			continue;
+		child->parent = ch;
+		listnode_add(ch->sources, child);
 	}
 }
 
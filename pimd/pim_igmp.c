@@ -766,6 +766,7 @@ void igmp_sock_free(struct igmp_sock *igmp)
 
 	list_delete_and_null(&igmp->igmp_group_list);
 	hash_free(igmp->igmp_group_hash);
+	hash_free(igmp->igmp_source_hash);
 
 	XFREE(MTYPE_PIM_IGMP_SOCKET, igmp);
 }
@@ -856,6 +857,9 @@ static struct igmp_sock *igmp_sock_new(int fd, struct in_addr ifaddr,
 	snprintf(hash_name, 64, "IGMP %s hash", ifp->name);
 	igmp->igmp_group_hash = hash_create(igmp_group_hash_key,
 					    igmp_group_hash_equal, hash_name);
+	snprintf(hash_name, 64, "IGMP %s source hash", ifp->name);
+	igmp->igmp_source_hash = hash_create(igmp_source_hash_key,
+					     igmp_source_hash_equal, hash_name);
 
 	igmp->fd = fd;
 	igmp->interface = ifp;
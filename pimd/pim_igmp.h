@@ -94,6 +94,7 @@ struct igmp_sock {
 
 	struct list *igmp_group_list; /* list of struct igmp_group */
 	struct hash *igmp_group_hash;
+	struct hash *igmp_source_hash; /* sources of all groups, by (G,S) */
 };
 
 struct igmp_sock *pim_igmp_sock_lookup_ifaddr(struct list *igmp_sock_list,
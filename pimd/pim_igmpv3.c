@@ -21,6 +21,8 @@
 #include "log.h"
 #include "memory.h"
 #include "if.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "pimd.h"
 #include "pim_iface.h"
@@ -390,6 +392,7 @@ void igmp_source_delete(struct igmp_source *source)
 	  called by list_delete_all_node()
 	*/
 	listnode_delete(group->group_source_list, source);
+	hash_release(group->group_igmp_sock->igmp_source_hash, source);
 
 	src.s_addr = source->source_addr.s_addr;
 	igmp_source_free(source);
@@ -425,17 +428,37 @@ void igmp_source_delete_expired(struct list *source_list)
 			igmp_source_delete(src);
 }
 
+unsigned int igmp_source_hash_key(void *arg)
+{
+	struct igmp_source *src = arg;
+
+	return jhash_2words(src->source_group->group_addr.s_addr,
+			    src->source_addr.s_addr, 0);
+}
+
+int igmp_source_hash_equal(const void *arg1, const void *arg2)
+{
+	const struct igmp_source *src1 = arg1;
+	const struct igmp_source *src2 = arg2;
+
+	return src1->source_group == src2->source_group
+	       && src1->source_addr.s_addr == src2->source_addr.s_addr;
+}
+
+/*
+ * Reports are processed source record by source record, so sources are
+ * looked up in the socket wide hash rather than by walking the group's
+ * source list.
+ */
 struct igmp_source *igmp_find_source_by_addr(struct igmp_group *group,
 					     struct in_addr src_addr)
 {
-	struct listnode *src_node;
-	struct igmp_source *src;
+	struct igmp_source lookup;
 
-	for (ALL_LIST_ELEMENTS_RO(group->group_source_list, src_node, src))
-		if (src_addr.s_addr == src->source_addr.s_addr)
-			return src;
+	lookup.source_group = group;
+	lookup.source_addr = src_addr;
 
-	return 0;
+	return hash_lookup(group->group_igmp_sock->igmp_source_hash, &lookup);
 }
 
 struct igmp_source *source_new(struct igmp_group *group,
@@ -472,6 +495,8 @@ struct igmp_source *source_new(struct igmp_group *group,
 	src->source_channel_oil = NULL;
 
 	listnode_add(group->group_source_list, src);
+	hash_get(group->group_igmp_sock->igmp_source_hash, src,
+		 hash_alloc_intern);
 
 	/* Any source (*,G) is forwarded only if mode is EXCLUDE {empty} */
 	igmp_anysource_forward_stop(group);
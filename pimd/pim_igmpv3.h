@@ -55,6 +55,9 @@ void igmp_group_reset_gmi(struct igmp_group *group);
 void igmp_source_reset_gmi(struct igmp_sock *igmp, struct igmp_group *group,
 			   struct igmp_source *source);
 
+unsigned int igmp_source_hash_key(void *arg);
+int igmp_source_hash_equal(const void *arg1, const void *arg2);
+
 void igmp_source_free(struct igmp_source *source);
 void igmp_source_delete(struct igmp_source *source);
 void igmp_source_delete_expired(struct list *source_list);
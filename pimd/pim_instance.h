@@ -24,6 +24,9 @@
 #include "pim_str.h"
 #include "pim_msdp.h"
 
+struct pim_upstream;
+RB_HEAD(pim_upstream_rb, pim_upstream);
+
 #if defined(HAVE_LINUX_MROUTE_H)
 #include <linux/mroute.h>
 #else
@@ -66,6 +69,15 @@ struct pim_instance {
 	int64_t mroute_del_events;
 	int64_t mroute_del_last;
 
+	/* Installed channels whose MFC entry is to be updated */
+	struct list *mroute_update_list;
+	struct thread *t_mroute_update;
+
+	/* Channel counters collected in bulk from zebra */
+	uint32_t mroute_stats_gen;
+	int64_t mroute_stats_last;
+	bool mroute_stats_valid;
+
 	struct interface *regiface;
 
 	// List of static routes;
@@ -74,13 +86,17 @@ struct pim_instance {
 	// Upstream vrf specific information
 	struct list *upstream_list;
 	struct hash *upstream_hash;
+	struct pim_upstream_rb upstream_rb; /* as the list, by (G,S) */
+	struct hash *upstream_rpf_hash;	    /* by RPF'(S,G) neighbor */
 	struct timer_wheel *upstream_sg_wheel;
 
 	/*
 	 * RP information
 	 */
 	struct list *rp_list;
+	/* group-range RPs by group; prefix-list RPs are kept apart */
 	struct route_table *rp_table;
+	struct list *rp_plist_list;
 
 	int iface_vif_index[MAXVIFS];
 
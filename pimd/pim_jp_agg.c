@@ -29,6 +29,7 @@
 #include "pim_jp_agg.h"
 #include "pim_join.h"
 #include "pim_iface.h"
+#include "pim_neighbor.h"
 
 void pim_jp_agg_group_list_free(struct pim_jp_agg_group *jag)
 {
@@ -344,3 +345,130 @@ void pim_jp_agg_single_upstream_send(struct pim_rpf *rpf,
 
 	pim_joinprune_send(rpf, groups);
 }
+
+/*
+ * Joins needed before the neighbor's periodic J/P, to override a Prune or
+ * as its GenID changed, wait on one timer for the earliest of them and
+ * then go together, packed into as few J/P messages as the MTU allows.
+ */
+static int pim_jp_agg_due_cmp(const void *arg1, const void *arg2)
+{
+	struct pim_upstream *up1 = *(struct pim_upstream *const *)arg1;
+	struct pim_upstream *up2 = *(struct pim_upstream *const *)arg2;
+
+	return pim_upstream_compare(up1, up2);
+}
+
+static int on_jp_agg_due_timer(struct thread *t)
+{
+	struct pim_neighbor *neigh = THREAD_ARG(t);
+	struct pim_jp_agg_group *jag = NULL;
+	struct pim_jp_sources *js;
+	struct pim_upstream **ups, *up;
+	struct list *groups;
+	struct pim_rpf rpf;
+	unsigned int count = 0, i;
+
+	if (list_isempty(neigh->upstream_jp_due))
+		return 0;
+
+	ups = XMALLOC(MTYPE_TMP,
+		      listcount(neigh->upstream_jp_due) * sizeof(*ups));
+	while ((up = listnode_head(neigh->upstream_jp_due))) {
+		list_delete_node(neigh->upstream_jp_due, up->jp_due_node);
+		up->jp_due_nbr = NULL;
+		up->jp_due_node = NULL;
+		ups[count++] = up;
+	}
+
+	/* In group order, the sources of a group in a row */
+	qsort(ups, count, sizeof(*ups), pim_jp_agg_due_cmp);
+
+	groups = list_new();
+	for (i = 0; i < count; i++) {
+		if (!jag || jag->group.s_addr != ups[i]->sg.grp.s_addr) {
+			jag = XCALLOC(MTYPE_PIM_JP_AGG_GROUP,
+				      sizeof(struct pim_jp_agg_group));
+			jag->group.s_addr = ups[i]->sg.grp.s_addr;
+			jag->sources = list_new();
+			listnode_add(groups, jag);
+		}
+
+		js = XCALLOC(MTYPE_PIM_JP_AGG_SOURCE,
+			     sizeof(struct pim_jp_sources));
+		js->up = ups[i];
+		js->is_join = true;
+		listnode_add(jag->sources, js);
+	}
+
+	if (PIM_DEBUG_PIM_TRACE) {
+		char src_str[INET_ADDRSTRLEN];
+		pim_inet4_dump("<src?>", neigh->source_addr, src_str,
+			       sizeof(src_str));
+		zlog_debug("%s: Sending %u due Joins in %d groups to %s on %s",
+			   __PRETTY_FUNCTION__, count, groups->count, src_str,
+			   neigh->interface->name);
+	}
+
+	rpf.source_nexthop.interface = neigh->interface;
+	rpf.rpf_addr.u.prefix4 = neigh->source_addr;
+	pim_joinprune_send(&rpf, groups);
+
+	pim_jp_agg_clear_group(groups);
+	list_delete_and_null(&groups);
+	XFREE(MTYPE_TMP, ups);
+
+	return 0;
+}
+
+long pim_jp_agg_due_remain_msec(struct pim_neighbor *neigh)
+{
+	struct timeval remain;
+
+	if (!neigh->jp_due_timer)
+		return 0;
+
+	remain = thread_timer_remain(neigh->jp_due_timer);
+	return remain.tv_sec * 1000 + remain.tv_usec / 1000;
+}
+
+/* The upstream's Join goes to the neighbor in interval_msec at the latest */
+void pim_jp_agg_due_add(struct pim_neighbor *neigh, struct pim_upstream *up,
+			long interval_msec)
+{
+	if (up->jp_due_nbr != neigh) {
+		pim_jp_agg_due_remove(up);
+		listnode_add(neigh->upstream_jp_due, up);
+		up->jp_due_nbr = neigh;
+		up->jp_due_node = listtail(neigh->upstream_jp_due);
+	}
+
+	if (neigh->jp_due_timer
+	    && pim_jp_agg_due_remain_msec(neigh) <= interval_msec)
+		return;
+
+	THREAD_OFF(neigh->jp_due_timer);
+	thread_add_timer_msec(master, on_jp_agg_due_timer, neigh,
+			      interval_msec, &neigh->jp_due_timer);
+}
+
+void pim_jp_agg_due_remove(struct pim_upstream *up)
+{
+	if (!up->jp_due_nbr)
+		return;
+
+	list_delete_node(up->jp_due_nbr->upstream_jp_due, up->jp_due_node);
+	up->jp_due_nbr = NULL;
+	up->jp_due_node = NULL;
+}
+
+/* The periodic J/P went, or the neighbor is going, with the Joins due */
+void pim_jp_agg_due_clear(struct pim_neighbor *neigh)
+{
+	struct pim_upstream *up;
+
+	while ((up = listnode_head(neigh->upstream_jp_due)))
+		pim_jp_agg_due_remove(up);
+
+	THREAD_OFF(neigh->jp_due_timer);
+}
@@ -47,4 +47,11 @@ void pim_jp_agg_switch_interface(struct pim_rpf *orpf, struct pim_rpf *nrpf,
 
 void pim_jp_agg_single_upstream_send(struct pim_rpf *rpf,
 				     struct pim_upstream *up, bool is_join);
+
+struct pim_neighbor;
+void pim_jp_agg_due_add(struct pim_neighbor *neigh, struct pim_upstream *up,
+			long interval_msec);
+void pim_jp_agg_due_remove(struct pim_upstream *up);
+void pim_jp_agg_due_clear(struct pim_neighbor *neigh);
+long pim_jp_agg_due_remain_msec(struct pim_neighbor *neigh);
 #endif
@@ -35,6 +35,7 @@ DEFINE_MTYPE(PIMD, PIM_IGMP_GROUP_SOURCE, "PIM interface IGMP source")
 DEFINE_MTYPE(PIMD, PIM_NEIGHBOR, "PIM interface neighbor")
 DEFINE_MTYPE(PIMD, PIM_IFCHANNEL, "PIM interface (S,G) state")
 DEFINE_MTYPE(PIMD, PIM_UPSTREAM, "PIM upstream (S,G) state")
+DEFINE_MTYPE(PIMD, PIM_UPSTREAM_RPF_NBR, "PIM upstream RPF neighbor")
 DEFINE_MTYPE(PIMD, PIM_SSMPINGD, "PIM sspimgd socket")
 DEFINE_MTYPE(PIMD, PIM_STATIC_ROUTE, "PIM Static Route")
 DEFINE_MTYPE(PIMD, PIM_BR, "PIM Bridge Router info")
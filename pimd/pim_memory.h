@@ -34,6 +34,7 @@ DECLARE_MTYPE(PIM_IGMP_GROUP_SOURCE)
 DECLARE_MTYPE(PIM_NEIGHBOR)
 DECLARE_MTYPE(PIM_IFCHANNEL)
 DECLARE_MTYPE(PIM_UPSTREAM)
+DECLARE_MTYPE(PIM_UPSTREAM_RPF_NBR)
 DECLARE_MTYPE(PIM_SSMPINGD)
 DECLARE_MTYPE(PIM_STATIC_ROUTE)
 DECLARE_MTYPE(PIM_BR)
@@ -770,6 +770,11 @@ int pim_mroute_socket_disable(struct pim_instance *pim)
 	mroute_read_off(pim);
 	pim->mroute_socket = -1;
 
+	THREAD_OFF(pim->t_mroute_update);
+	while (listcount(pim->mroute_update_list))
+		pim_mroute_update_cancel(
+			listnode_head(pim->mroute_update_list));
+
 	return 0;
 }
 
@@ -861,16 +866,13 @@ int pim_mroute_del_vif(struct interface *ifp)
 	return 0;
 }
 
-int pim_mroute_add(struct channel_oil *c_oil, const char *name)
+static int pim_mroute_install(struct channel_oil *c_oil, const char *name)
 {
 	struct pim_instance *pim = c_oil->pim;
 	int err;
 	int orig = 0;
 	int orig_iif_vif = 0;
 
-	pim->mroute_add_last = pim_time_monotonic_sec();
-	++pim->mroute_add_events;
-
 	/* Do not install route if incoming interface is undefined. */
 	if (c_oil->oil.mfcc_parent >= MAXVIFS) {
 		if (PIM_DEBUG_MROUTE) {
@@ -937,6 +939,54 @@ int pim_mroute_add(struct channel_oil *c_oil, const char *name)
 	return 0;
 }
 
+/*
+ * The changes made to an installed channel's OIL while handling one event,
+ * say the joins of one J/P message, go to the kernel in a single
+ * MRT_ADD_MFC once the event is done.
+ */
+static int pim_mroute_update_run(struct thread *t)
+{
+	struct pim_instance *pim = THREAD_ARG(t);
+	struct channel_oil *c_oil;
+
+	while ((c_oil = listnode_head(pim->mroute_update_list))) {
+		pim_mroute_update_cancel(c_oil);
+		pim_mroute_install(c_oil, __PRETTY_FUNCTION__);
+	}
+
+	return 0;
+}
+
+void pim_mroute_update_cancel(struct channel_oil *c_oil)
+{
+	if (!c_oil->mroute_update_node)
+		return;
+
+	list_delete_node(c_oil->pim->mroute_update_list,
+			 c_oil->mroute_update_node);
+	c_oil->mroute_update_node = NULL;
+}
+
+int pim_mroute_add(struct channel_oil *c_oil, const char *name)
+{
+	struct pim_instance *pim = c_oil->pim;
+
+	pim->mroute_add_last = pim_time_monotonic_sec();
+	++pim->mroute_add_events;
+
+	if (!c_oil->installed || c_oil->oil.mfcc_parent >= MAXVIFS)
+		return pim_mroute_install(c_oil, name);
+
+	if (!c_oil->mroute_update_node) {
+		listnode_add(pim->mroute_update_list, c_oil);
+		c_oil->mroute_update_node = listtail(pim->mroute_update_list);
+	}
+	thread_add_event(master, pim_mroute_update_run, pim, 0,
+			 &pim->t_mroute_update);
+
+	return 0;
+}
+
 int pim_mroute_del(struct channel_oil *c_oil, const char *name)
 {
 	struct pim_instance *pim = c_oil->pim;
@@ -945,6 +995,8 @@ int pim_mroute_del(struct channel_oil *c_oil, const char *name)
 	pim->mroute_del_last = pim_time_monotonic_sec();
 	++pim->mroute_del_events;
 
+	pim_mroute_update_cancel(c_oil);
+
 	if (!c_oil->installed) {
 		if (PIM_DEBUG_MROUTE) {
 			char buf[1000];
@@ -1033,3 +1085,43 @@ void pim_mroute_update_counters(struct channel_oil *c_oil)
 
 	return;
 }
+
+/*
+ * How long the counters zebra gave for all the instance's channels serve
+ * before being asked for again.  A channel is looked at about every
+ * 31 seconds, the counters it compares are always from different runs.
+ */
+#define PIM_MROUTE_STATS_BULK_INTERVAL 10
+
+void pim_mroute_update_counters_bulk(struct channel_oil *c_oil)
+{
+	struct pim_instance *pim = c_oil->pim;
+	int64_t now = pim_time_monotonic_sec();
+
+	if (!pim->mroute_stats_last
+	    || now - pim->mroute_stats_last >= PIM_MROUTE_STATS_BULK_INTERVAL) {
+		pim->mroute_stats_last = now;
+		pim->mroute_stats_valid =
+			!pim_zlookup_sg_statistics_bulk(pim,
+							++pim->mroute_stats_gen);
+	}
+
+	/* Installed since, or zebra couldn't tell */
+	if (!c_oil->installed || !pim->mroute_stats_valid
+	    || c_oil->bulk_cc_gen != pim->mroute_stats_gen) {
+		pim_mroute_update_counters(c_oil);
+		return;
+	}
+
+	c_oil->cc.oldpktcnt = c_oil->cc.pktcnt;
+	c_oil->cc.oldbytecnt = c_oil->cc.bytecnt;
+	c_oil->cc.oldwrong_if = c_oil->cc.wrong_if;
+
+	c_oil->cc.pktcnt = c_oil->bulk_cc.pktcnt;
+	c_oil->cc.bytecnt = c_oil->bulk_cc.bytecnt;
+	c_oil->cc.wrong_if = c_oil->bulk_cc.wrong_if;
+
+	/* In hundredths of a second, as of now rather than the collection */
+	c_oil->cc.lastused =
+		c_oil->bulk_cc.lastused + 100 * (now - pim->mroute_stats_last);
+}
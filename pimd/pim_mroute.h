@@ -176,6 +176,8 @@ int pim_mroute_del_vif(struct interface *ifp);
 
 int pim_mroute_add(struct channel_oil *c_oil, const char *name);
 int pim_mroute_del(struct channel_oil *c_oil, const char *name);
+void pim_mroute_update_cancel(struct channel_oil *c_oil);
 
 void pim_mroute_update_counters(struct channel_oil *c_oil);
+void pim_mroute_update_counters_bulk(struct channel_oil *c_oil);
 #endif /* PIM_MROUTE_H */
@@ -28,6 +28,7 @@
 #include <lib/thread.h>
 #include <lib/vty.h>
 #include <lib/plist.h>
+#include <lib/wheel.h>
 
 #include "pimd.h"
 #include "pim_cmd.h"
@@ -55,6 +56,7 @@ static void pim_msdp_enable(struct pim_instance *pim);
 static void pim_msdp_sa_adv_timer_setup(struct pim_instance *pim, bool start);
 static void pim_msdp_sa_deref(struct pim_msdp_sa *sa,
 			      enum pim_msdp_sa_flags flags);
+static unsigned int pim_msdp_sa_hash_key_make(void *p);
 static int pim_msdp_mg_mbr_comp(const void *p1, const void *p2);
 static void pim_msdp_mg_mbr_free(struct pim_msdp_mg_mbr *mbr);
 static void pim_msdp_mg_mbr_do_del(struct pim_msdp_mg *mg,
@@ -90,30 +92,90 @@ static void pim_msdp_sa_adv_timer_setup(struct pim_instance *pim, bool start)
 	}
 }
 
-/* RFC-3618:Sec-5.3 - SA cache state timer */
-static int pim_msdp_sa_state_timer_cb(struct thread *t)
+/* RFC-3618:Sec-5.3 - SA cache state timer
+ * Peers refresh every SA once per advertisement interval, so rather than
+ * re-arming a timer per SA each time, a refresh just restamps the entry and
+ * a shared wheel reaps the ones that have not been heard from in time. */
+static void pim_msdp_sa_state_timer_run(void *arg)
 {
-	struct pim_msdp_sa *sa;
+	struct pim_msdp_sa *sa = arg;
 
-	sa = THREAD_ARG(t);
+	if (pim_msdp_sa_state_timer_remain(sa))
+		return;
 
 	if (PIM_DEBUG_MSDP_EVENTS) {
 		pim_msdp_sa_timer_expiry_log(sa, "state");
 	}
 
+	/* only entries with a peer reference are on the wheel, so this can
+	 * free sa but no other entry */
 	pim_msdp_sa_deref(sa, PIM_MSDP_SAF_PEER);
-	return 0;
 }
 static void pim_msdp_sa_state_timer_setup(struct pim_msdp_sa *sa, bool start)
 {
-	THREAD_OFF(sa->sa_state_timer);
+	struct timer_wheel *wheel = sa->pim->msdp.sa_state_wheel;
+
 	if (start) {
-		thread_add_timer(sa->pim->msdp.master,
-				 pim_msdp_sa_state_timer_cb, sa,
-				 PIM_MSDP_SA_HOLD_TIME, &sa->sa_state_timer);
+		sa->sa_state_ts = pim_time_monotonic_sec();
+		if (!(sa->flags & PIM_MSDP_SAF_STATE_TIMER)) {
+			wheel_add_item(wheel, sa);
+			sa->flags |= PIM_MSDP_SAF_STATE_TIMER;
+		}
+	} else if (sa->flags & PIM_MSDP_SAF_STATE_TIMER) {
+		wheel_remove_item(wheel, sa);
+		sa->flags &= ~PIM_MSDP_SAF_STATE_TIMER;
 	}
 }
 
+/* seconds left before the SA ages out, 0 if it is not timed */
+long pim_msdp_sa_state_timer_remain(struct pim_msdp_sa *sa)
+{
+	int64_t age;
+
+	if (!(sa->flags & PIM_MSDP_SAF_STATE_TIMER))
+		return 0;
+
+	age = pim_time_monotonic_sec() - sa->sa_state_ts;
+	return age < PIM_MSDP_SA_HOLD_TIME ? PIM_MSDP_SA_HOLD_TIME - age : 0;
+}
+
+/* New local SAs are sent to the peers straight away, but together: a burst
+ * of new sources (e.g. after an RP change) goes out in as few SA messages as
+ * possible instead of one message per SA per peer. */
+static int pim_msdp_sa_tx_event_cb(struct thread *t)
+{
+	struct pim_instance *pim = THREAD_ARG(t);
+	struct listnode *sanode;
+	struct pim_msdp_sa *sa;
+
+	pim_msdp_pkt_sa_tx_list(pim, pim->msdp.sa_tx_list);
+
+	for (ALL_LIST_ELEMENTS_RO(pim->msdp.sa_tx_list, sanode, sa))
+		sa->flags &= ~PIM_MSDP_SAF_TX_PENDING;
+	list_delete_all_node(pim->msdp.sa_tx_list);
+	return 0;
+}
+static void pim_msdp_sa_tx_queue(struct pim_msdp_sa *sa)
+{
+	struct pim_instance *pim = sa->pim;
+
+	if (sa->flags & PIM_MSDP_SAF_TX_PENDING)
+		return;
+
+	sa->flags |= PIM_MSDP_SAF_TX_PENDING;
+	listnode_add(pim->msdp.sa_tx_list, sa);
+	thread_add_event(pim->msdp.master, pim_msdp_sa_tx_event_cb, pim, 0,
+			 &pim->msdp.sa_tx_event);
+}
+static void pim_msdp_sa_tx_dequeue(struct pim_msdp_sa *sa)
+{
+	if (!(sa->flags & PIM_MSDP_SAF_TX_PENDING))
+		return;
+
+	sa->flags &= ~PIM_MSDP_SAF_TX_PENDING;
+	listnode_delete(sa->pim->msdp.sa_tx_list, sa);
+}
+
 static void pim_msdp_sa_upstream_del(struct pim_msdp_sa *sa)
 {
 	struct pim_upstream *up = sa->up;
@@ -297,6 +359,7 @@ static void pim_msdp_sa_del(struct pim_msdp_sa *sa)
 
 	/* stop timers */
 	pim_msdp_sa_state_timer_setup(sa, false /* start */);
+	pim_msdp_sa_tx_dequeue(sa);
 
 	/* remove the entry from various tables */
 	listnode_delete(sa->pim->msdp.sa_list, sa);
@@ -359,6 +422,7 @@ static void pim_msdp_sa_deref(struct pim_msdp_sa *sa,
 			}
 			if (sa->pim->msdp.local_cnt)
 				--sa->pim->msdp.local_cnt;
+			pim_msdp_sa_tx_dequeue(sa);
 		}
 	}
 
@@ -426,7 +490,7 @@ void pim_msdp_sa_ref(struct pim_instance *pim, struct pim_msdp_peer *mp,
 					   sa->sg_str);
 			}
 			/* send an immediate SA update to peers */
-			pim_msdp_pkt_sa_tx_one(sa);
+			pim_msdp_sa_tx_queue(sa);
 		}
 		sa->flags &= ~PIM_MSDP_SAF_STALE;
 	}
@@ -1606,6 +1670,13 @@ void pim_msdp_init(struct pim_instance *pim, struct thread_master *master)
 	pim->msdp.sa_list = list_new();
 	pim->msdp.sa_list->del = (void (*)(void *))pim_msdp_sa_free;
 	pim->msdp.sa_list->cmp = (int (*)(void *, void *))pim_msdp_sa_comp;
+
+	pim->msdp.sa_state_wheel =
+		wheel_init(master, PIM_MSDP_SA_STATE_WHEEL_PERIOD,
+			   PIM_MSDP_SA_STATE_WHEEL_SLOTS,
+			   pim_msdp_sa_hash_key_make,
+			   pim_msdp_sa_state_timer_run);
+	pim->msdp.sa_tx_list = list_new();
 }
 
 /* counterpart to MSDP init; XXX: unused currently */
@@ -1622,6 +1693,16 @@ void pim_msdp_exit(struct pim_instance *pim)
 		list_delete_and_null(&pim->msdp.peer_list);
 	}
 
+	THREAD_OFF(pim->msdp.sa_tx_event);
+	if (pim->msdp.sa_tx_list) {
+		list_delete_and_null(&pim->msdp.sa_tx_list);
+	}
+
+	if (pim->msdp.sa_state_wheel) {
+		wheel_delete(pim->msdp.sa_state_wheel);
+		pim->msdp.sa_state_wheel = NULL;
+	}
+
 	if (pim->msdp.sa_hash) {
 		hash_free(pim->msdp.sa_hash);
 		pim->msdp.sa_hash = NULL;
@@ -70,7 +70,11 @@ enum pim_msdp_sa_flags {
 	PIM_MSDP_SAF_REF = (PIM_MSDP_SAF_LOCAL | PIM_MSDP_SAF_PEER),
 	PIM_MSDP_SAF_STALE = (1 << 2), /* local entries can get kicked out on
 					* misc pim events such as RP change */
-	PIM_MSDP_SAF_UP_DEL_IN_PROG = (1 << 3)
+	PIM_MSDP_SAF_UP_DEL_IN_PROG = (1 << 3),
+	/* on the state timer wheel */
+	PIM_MSDP_SAF_STATE_TIMER = (1 << 4),
+	/* queued for the next batched SA update to peers */
+	PIM_MSDP_SAF_TX_PENDING = (1 << 5)
 };
 
 struct pim_msdp_sa {
@@ -85,7 +89,7 @@ struct pim_msdp_sa {
 /* rfc-3618 is missing default value for SA-hold-down-Period. pulled
  * this number from industry-standards */
 #define PIM_MSDP_SA_HOLD_TIME ((3*60)+30)
-	struct thread *sa_state_timer; // 5.6
+	int64_t sa_state_ts; // 5.6, time of the last refresh
 	int64_t uptime;
 
 	struct pim_upstream *up;
@@ -191,6 +195,16 @@ struct pim_msdp {
 	struct list *sa_list;
 	uint32_t local_cnt;
 
+/* SA cache state timers are all run off a single wheel; every entry on it
+ * is checked for expiry once per period (in msec) */
+#define PIM_MSDP_SA_STATE_WHEEL_PERIOD 10000
+#define PIM_MSDP_SA_STATE_WHEEL_SLOTS 100
+	struct timer_wheel *sa_state_wheel;
+
+	/* new local SAs, sent to the peers together on the next event */
+	struct list *sa_tx_list;
+	struct thread *sa_tx_event;
+
 	/* keep a scratch pad for building SA TLVs */
 	struct stream *work_obuf;
 
@@ -236,6 +250,7 @@ int pim_msdp_config_write(struct vty *vty);
 int pim_msdp_config_write_helper(struct pim_instance *pim, struct vty *vty,
 				 const char *spaces);
 void pim_msdp_peer_pkt_txed(struct pim_msdp_peer *mp);
+long pim_msdp_sa_state_timer_remain(struct pim_msdp_sa *sa);
 void pim_msdp_sa_ref(struct pim_instance *pim, struct pim_msdp_peer *mp,
 		     struct prefix_sg *sg, struct in_addr rp);
 void pim_msdp_sa_local_update(struct pim_upstream *up);
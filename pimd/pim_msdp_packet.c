@@ -371,13 +371,15 @@ static void pim_msdp_pkt_sa_fill_one(struct pim_msdp_sa *sa)
 	stream_put_ipv4(sa->pim->msdp.work_obuf, sa->sg.src.s_addr);
 }
 
+/* Encode the local SAs of sa_list, local_cnt of them, once and queue the
+ * resulting messages to mp or, if NULL, to every established peer */
 static void pim_msdp_pkt_sa_gen(struct pim_instance *pim,
-				struct pim_msdp_peer *mp)
+				struct pim_msdp_peer *mp, struct list *sa_list,
+				int local_cnt)
 {
 	struct listnode *sanode;
 	struct pim_msdp_sa *sa;
 	int sa_count;
-	int local_cnt = pim->msdp.local_cnt;
 
 	sa_count = 0;
 	if (PIM_DEBUG_MSDP_INTERNAL) {
@@ -386,7 +388,7 @@ static void pim_msdp_pkt_sa_gen(struct pim_instance *pim,
 
 	local_cnt = pim_msdp_pkt_sa_fill_hdr(pim, local_cnt);
 
-	for (ALL_LIST_ELEMENTS_RO(pim->msdp.sa_list, sanode, sa)) {
+	for (ALL_LIST_ELEMENTS_RO(sa_list, sanode, sa)) {
 		if (!(sa->flags & PIM_MSDP_SAF_LOCAL)) {
 			/* current implementation of MSDP is for anycast i.e.
 			 * full mesh. so
@@ -432,22 +434,26 @@ static void pim_msdp_pkt_sa_tx_done(struct pim_instance *pim)
 
 void pim_msdp_pkt_sa_tx(struct pim_instance *pim)
 {
-	pim_msdp_pkt_sa_gen(pim, NULL /* mp */);
+	pim_msdp_pkt_sa_gen(pim, NULL /* mp */, pim->msdp.sa_list,
+			    pim->msdp.local_cnt);
 	pim_msdp_pkt_sa_tx_done(pim);
 }
 
-void pim_msdp_pkt_sa_tx_one(struct pim_msdp_sa *sa)
+/* send just the SAs of sa_list, all of which must be local */
+void pim_msdp_pkt_sa_tx_list(struct pim_instance *pim, struct list *sa_list)
 {
-	pim_msdp_pkt_sa_fill_hdr(sa->pim, 1 /* cnt */);
-	pim_msdp_pkt_sa_fill_one(sa);
-	pim_msdp_pkt_sa_push(sa->pim, NULL);
-	pim_msdp_pkt_sa_tx_done(sa->pim);
+	if (!listcount(sa_list))
+		return;
+
+	pim_msdp_pkt_sa_gen(pim, NULL /* mp */, sa_list, listcount(sa_list));
+	pim_msdp_pkt_sa_tx_done(pim);
 }
 
 /* when a connection is first established we push all SAs immediately */
 void pim_msdp_pkt_sa_tx_to_one_peer(struct pim_msdp_peer *mp)
 {
-	pim_msdp_pkt_sa_gen(mp->pim, mp);
+	pim_msdp_pkt_sa_gen(mp->pim, mp, mp->pim->msdp.sa_list,
+			    mp->pim->msdp.local_cnt);
 	pim_msdp_pkt_sa_tx_done(mp->pim);
 }
 
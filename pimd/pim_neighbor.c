@@ -276,6 +276,9 @@ static int on_neighbor_jp_timer(struct thread *t)
 	rpf.rpf_addr.u.prefix4 = neigh->source_addr;
 	pim_joinprune_send(&rpf, neigh->upstream_jp_agg);
 
+	/* Those went with the rest */
+	pim_jp_agg_due_clear(neigh);
+
 	thread_add_timer(master, on_neighbor_jp_timer, neigh, qpim_t_periodic,
 			 &neigh->jp_timer);
 
@@ -326,6 +329,7 @@ pim_neighbor_new(struct interface *ifp, struct in_addr source_addr,
 	neigh->upstream_jp_agg->cmp = pim_jp_agg_group_list_cmp;
 	neigh->upstream_jp_agg->del =
 		(void (*)(void *))pim_jp_agg_group_list_free;
+	neigh->upstream_jp_due = list_new();
 	pim_neighbor_start_jp_timer(neigh);
 
 	pim_neighbor_timer_reset(neigh, holdtime);
@@ -411,6 +415,9 @@ void pim_neighbor_free(struct pim_neighbor *neigh)
 
 	delete_prefix_list(neigh);
 
+	pim_jp_agg_due_clear(neigh);
+	list_delete_and_null(&neigh->upstream_jp_due);
+
 	list_delete_and_null(&neigh->upstream_jp_agg);
 	THREAD_OFF(neigh->jp_timer);
 
@@ -43,6 +43,10 @@ struct pim_neighbor {
 
 	struct thread *jp_timer;
 	struct list *upstream_jp_agg;
+
+	/* Upstreams whose Join is due before the periodic J/P */
+	struct thread *jp_due_timer;
+	struct list *upstream_jp_due;
 	struct bfd_info *bfd_info;
 };
 
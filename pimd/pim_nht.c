@@ -319,6 +319,7 @@ static int pim_update_upstream_nh_helper(struct hash_backet *backet, void *arg)
 					old.rpf_addr.u.prefix4);
 		if (nbr)
 			pim_jp_agg_remove_group(nbr->upstream_jp_agg, up);
+		pim_jp_agg_due_remove(up);
 
 		/*
 		 * We have detected a case where we might need to rescan
@@ -116,6 +116,8 @@ void pim_oil_init(struct pim_instance *pim)
 	pim->channel_oil_list->del = (void (*)(void *))pim_channel_oil_free;
 	pim->channel_oil_list->cmp =
 		(int (*)(void *, void *))pim_channel_oil_compare;
+
+	pim->mroute_update_list = list_new();
 }
 
 void pim_oil_terminate(struct pim_instance *pim)
@@ -126,10 +128,15 @@ void pim_oil_terminate(struct pim_instance *pim)
 	if (pim->channel_oil_hash)
 		hash_free(pim->channel_oil_hash);
 	pim->channel_oil_hash = NULL;
+
+	THREAD_OFF(pim->t_mroute_update);
+	if (pim->mroute_update_list)
+		list_delete_and_null(&pim->mroute_update_list);
 }
 
 void pim_channel_oil_free(struct channel_oil *c_oil)
 {
+	pim_mroute_update_cancel(c_oil);
 	XFREE(MTYPE_PIM_CHANNEL_OIL, c_oil);
 }
 
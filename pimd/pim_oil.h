@@ -78,6 +78,13 @@ struct channel_oil {
 	uint32_t oif_flags[MAXVIFS];
 	struct channel_counts cc;
 	struct pim_upstream *up;
+
+	/* On the instance's MFC updates to send */
+	struct listnode *mroute_update_node;
+
+	/* As last collected for all the instance's channels at once */
+	struct channel_counts bulk_cc;
+	uint32_t bulk_cc_gen;
 };
 
 extern struct list *pim_channel_oil_list;
@@ -106,6 +106,9 @@ void pim_rp_init(struct pim_instance *pim)
 	pim->rp_list->del = (void (*)(void *))pim_rp_info_free;
 	pim->rp_list->cmp = pim_rp_list_cmp;
 
+	/* the entries are owned by rp_list */
+	pim->rp_plist_list = list_new();
+
 	pim->rp_table = route_table_init();
 	if (!pim->rp_table) {
 		zlog_err("Unable to alloc rp_table");
@@ -154,6 +157,8 @@ void pim_rp_init(struct pim_instance *pim)
 
 void pim_rp_free(struct pim_instance *pim)
 {
+	if (pim->rp_plist_list)
+		list_delete_and_null(&pim->rp_plist_list);
 	if (pim->rp_list)
 		list_delete_and_null(&pim->rp_list);
 }
@@ -168,9 +173,9 @@ static struct rp_info *pim_rp_find_prefix_list(struct pim_instance *pim,
 	struct listnode *node;
 	struct rp_info *rp_info;
 
-	for (ALL_LIST_ELEMENTS_RO(pim->rp_list, node, rp_info)) {
+	for (ALL_LIST_ELEMENTS_RO(pim->rp_plist_list, node, rp_info)) {
 		if (rp.s_addr == rp_info->rp.rpf_addr.u.prefix4.s_addr
-		    && rp_info->plist && strcmp(rp_info->plist, plist) == 0) {
+		    && strcmp(rp_info->plist, plist) == 0) {
 			return rp_info;
 		}
 	}
@@ -186,8 +191,8 @@ static int pim_rp_prefix_list_used(struct pim_instance *pim, const char *plist)
 	struct listnode *node;
 	struct rp_info *rp_info;
 
-	for (ALL_LIST_ELEMENTS_RO(pim->rp_list, node, rp_info)) {
-		if (rp_info->plist && strcmp(rp_info->plist, plist) == 0) {
+	for (ALL_LIST_ELEMENTS_RO(pim->rp_plist_list, node, rp_info)) {
+		if (strcmp(rp_info->plist, plist) == 0) {
 			return 1;
 		}
 	}
@@ -203,14 +208,18 @@ static struct rp_info *pim_rp_find_exact(struct pim_instance *pim,
 					 struct in_addr rp,
 					 struct prefix *group)
 {
-	struct listnode *node;
 	struct rp_info *rp_info;
+	struct route_node *rn;
 
-	for (ALL_LIST_ELEMENTS_RO(pim->rp_list, node, rp_info)) {
-		if (rp.s_addr == rp_info->rp.rpf_addr.u.prefix4.s_addr
-		    && prefix_same(&rp_info->group, group))
-			return rp_info;
-	}
+	rn = route_node_lookup(pim->rp_table, group);
+	if (!rn)
+		return NULL;
+
+	rp_info = rn->info;
+	route_unlock_node(rn);
+
+	if (rp_info && rp.s_addr == rp_info->rp.rpf_addr.u.prefix4.s_addr)
+		return rp_info;
 
 	return NULL;
 }
@@ -228,25 +237,25 @@ static struct rp_info *pim_rp_find_match_group(struct pim_instance *pim,
 	struct prefix *p, *bp;
 	struct route_node *rn;
 
+	/* Only the prefix-list RPs need to be walked, the group-range ones
+	 * are matched through rp_table below. */
 	bp = NULL;
-	for (ALL_LIST_ELEMENTS_RO(pim->rp_list, node, rp_info)) {
-		if (rp_info->plist) {
-			plist = prefix_list_lookup(AFI_IP, rp_info->plist);
+	for (ALL_LIST_ELEMENTS_RO(pim->rp_plist_list, node, rp_info)) {
+		plist = prefix_list_lookup(AFI_IP, rp_info->plist);
 
-			if (prefix_list_apply_which_prefix(plist, &p, group)
-			    == PREFIX_DENY)
-				continue;
+		if (prefix_list_apply_which_prefix(plist, &p, group)
+		    == PREFIX_DENY)
+			continue;
 
-			if (!best) {
-				best = rp_info;
-				bp = p;
-				continue;
-			}
+		if (!best) {
+			best = rp_info;
+			bp = p;
+			continue;
+		}
 
-			if (bp && bp->prefixlen < p->prefixlen) {
-				best = rp_info;
-				bp = p;
-			}
+		if (bp && bp->prefixlen < p->prefixlen) {
+			best = rp_info;
+			bp = p;
 		}
 	}
 
@@ -259,10 +268,10 @@ static struct rp_info *pim_rp_find_match_group(struct pim_instance *pim,
 	}
 
 	rp_info = rn->info;
+	route_unlock_node(rn);
 	if (PIM_DEBUG_TRACE) {
 		char buf[PREFIX_STRLEN];
 
-		route_unlock_node(rn);
 		zlog_debug("Lookedup: %p for rp_info: %p(%s) Lock: %d", rn,
 			   rp_info,
 			   prefix2str(&rp_info->group, buf, sizeof(buf)),
@@ -297,9 +306,8 @@ void pim_rp_prefix_list_update(struct pim_instance *pim,
 	struct rp_info *rp_info;
 	int refresh_needed = 0;
 
-	for (ALL_LIST_ELEMENTS_RO(pim->rp_list, node, rp_info)) {
-		if (rp_info->plist
-		    && strcmp(rp_info->plist, prefix_list_name(plist)) == 0) {
+	for (ALL_LIST_ELEMENTS_RO(pim->rp_plist_list, node, rp_info)) {
+		if (strcmp(rp_info->plist, prefix_list_name(plist)) == 0) {
 			refresh_needed = 1;
 			break;
 		}
@@ -445,12 +453,10 @@ int pim_rp_new(struct pim_instance *pim, const char *rp,
 		/*
 		 * Remove any prefix-list rp_info entries for this RP
 		 */
-		for (ALL_LIST_ELEMENTS(pim->rp_list, node, nnode,
+		for (ALL_LIST_ELEMENTS(pim->rp_plist_list, node, nnode,
 				       tmp_rp_info)) {
-			if (tmp_rp_info->plist
-			    && rp_info->rp.rpf_addr.u.prefix4.s_addr
-				       == tmp_rp_info->rp.rpf_addr.u.prefix4
-						  .s_addr) {
+			if (rp_info->rp.rpf_addr.u.prefix4.s_addr
+			    == tmp_rp_info->rp.rpf_addr.u.prefix4.s_addr) {
 				pim_rp_del(pim, rp, NULL, tmp_rp_info->plist);
 			}
 		}
@@ -533,22 +539,29 @@ int pim_rp_new(struct pim_instance *pim, const char *rp,
 	}
 
 	listnode_add_sort(pim->rp_list, rp_info);
-	rn = route_node_get(pim->rp_table, &rp_info->group);
-	if (!rn) {
-		char buf[PREFIX_STRLEN];
-		zlog_err("Failure to get route node for pim->rp_table: %s",
-			 prefix2str(&rp_info->group, buf, sizeof(buf)));
-		return PIM_MALLOC_FAIL;
-	}
-	rn->info = rp_info;
+	if (rp_info->plist) {
+		/* its group is just a placeholder, keep it out of rp_table */
+		listnode_add(pim->rp_plist_list, rp_info);
+	} else {
+		rn = route_node_get(pim->rp_table, &rp_info->group);
+		if (!rn) {
+			char buf[PREFIX_STRLEN];
+			zlog_err(
+				"Failure to get route node for pim->rp_table: %s",
+				prefix2str(&rp_info->group, buf, sizeof(buf)));
+			return PIM_MALLOC_FAIL;
+		}
+		rn->info = rp_info;
 
-	if (PIM_DEBUG_TRACE) {
-		char buf[PREFIX_STRLEN];
+		if (PIM_DEBUG_TRACE) {
+			char buf[PREFIX_STRLEN];
 
-		zlog_debug("Allocated: %p for rp_info: %p(%s) Lock: %d", rn,
-			   rp_info,
-			   prefix2str(&rp_info->group, buf, sizeof(buf)),
-			   rn->lock);
+			zlog_debug(
+				"Allocated: %p for rp_info: %p(%s) Lock: %d",
+				rn, rp_info,
+				prefix2str(&rp_info->group, buf, sizeof(buf)),
+				rn->lock);
+		}
 	}
 
 	/* Register addr with Zebra NHT */
@@ -616,6 +629,7 @@ int pim_rp_del(struct pim_instance *pim, const char *rp,
 		return PIM_RP_NOT_FOUND;
 
 	if (rp_info->plist) {
+		listnode_delete(pim->rp_plist_list, rp_info);
 		XFREE(MTYPE_PIM_FILTER_NAME, rp_info->plist);
 		rp_info->plist = NULL;
 		was_plist = true;
@@ -636,7 +650,10 @@ int pim_rp_del(struct pim_instance *pim, const char *rp,
 	if (!str2prefix("224.0.0.0/4", &g_all))
 		return PIM_RP_BAD_ADDRESS;
 
-	rp_all = pim_rp_find_match_group(pim, &g_all);
+	rn = route_node_lookup(pim->rp_table, &g_all);
+	rp_all = rn ? rn->info : NULL;
+	if (rn)
+		route_unlock_node(rn);
 
 	if (rp_all == rp_info) {
 		rp_all->rp.rpf_addr.family = AF_INET;
@@ -248,6 +248,7 @@ enum pim_rpf_result pim_rpf_update(struct pim_instance *pim,
 
 	rpf->rpf_addr.family = AF_INET;
 	rpf->rpf_addr.u.prefix4 = pim_rpf_find_rpf_addr(up);
+	pim_upstream_rpf_nbr_update(pim, up);
 	if (pim_rpf_addr_is_inaddr_any(rpf) && PIM_DEBUG_ZEBRA) {
 		/* RPF'(S,G) not found */
 		zlog_debug("%s %s: RPF'%s not found: won't send join upstream",
@@ -57,6 +57,16 @@
 static void join_timer_stop(struct pim_upstream *up);
 static void
 pim_upstream_update_assert_tracking_desired(struct pim_upstream *up);
+static void pim_upstream_rpf_nbr_del(struct pim_instance *pim,
+				     struct pim_upstream *up);
+
+RB_GENERATE(pim_upstream_rb, pim_upstream, pim_rb, pim_upstream_rb_compare);
+
+/* The upstreams whose RPF'(S,G) is one neighbor */
+struct pim_upstream_rpf_nbr {
+	struct in_addr addr;
+	struct list *upstreams;
+};
 
 /*
  * A (*,G) or a (*,*) is going away
@@ -94,7 +104,7 @@ static void pim_upstream_find_new_children(struct pim_instance *pim,
 					   struct pim_upstream *up)
 {
 	struct pim_upstream *child;
-	struct listnode *ch_node;
+	struct pim_upstream lookup;
 
 	if ((up->sg.src.s_addr != INADDR_ANY)
 	    && (up->sg.grp.s_addr != INADDR_ANY))
@@ -104,13 +114,22 @@ static void pim_upstream_find_new_children(struct pim_instance *pim,
 	    && (up->sg.grp.s_addr == INADDR_ANY))
 		return;
 
-	for (ALL_LIST_ELEMENTS_RO(pim->upstream_list, ch_node, child)) {
-		if ((up->sg.grp.s_addr != INADDR_ANY)
-		    && (child->sg.grp.s_addr == up->sg.grp.s_addr)
-		    && (child != up)) {
-			child->parent = up;
-			listnode_add_sort(up->sources, child);
-		}
+	if (up->sg.grp.s_addr == INADDR_ANY)
+		return;
+
+	/*
+	 * The (S,G)s follow the (*,G) on the tree, in the order sources is
+	 * kept in, which is still empty.
+	 */
+	lookup.sg.src.s_addr = INADDR_ANY;
+	lookup.sg.grp = up->sg.grp;
+	for (child = RB_NFIND(pim_upstream_rb, &pim->upstream_rb, &lookup);
+	     child && child->sg.grp.s_addr == up->sg.grp.s_addr;
+	     child = RB_NEXT(pim_upstream_rb, child)) {
+		if (child == up)
+			continue;
+		child->parent = up;
+		listnode_add(up->sources, child);
 	}
 }
 
@@ -218,7 +237,9 @@ struct pim_upstream *pim_upstream_del(struct pim_instance *pim,
 		listnode_delete(up->parent->sources, up);
 	up->parent = NULL;
 
-	listnode_delete(pim->upstream_list, up);
+	pim_upstream_rpf_nbr_del(pim, up);
+	list_delete_node(pim->upstream_list, up->pim_node);
+	RB_REMOVE(pim_upstream_rb, &pim->upstream_rb, up);
 	hash_release(pim->upstream_hash, up);
 
 	if (notify_msdp) {
@@ -299,6 +320,7 @@ static void join_timer_stop(struct pim_upstream *up)
 
 	if (nbr)
 		pim_jp_agg_remove_group(nbr->upstream_jp_agg, up);
+	pim_jp_agg_due_remove(up);
 
 	pim_jp_agg_upstream_verification(up, false);
 }
@@ -343,14 +365,50 @@ void pim_upstream_join_timer_restart(struct pim_upstream *up,
 	join_timer_start(up);
 }
 
+/* The neighbor whose periodic J/P carries the upstream's Join, if any */
+static struct pim_neighbor *pim_upstream_jp_agg_nbr(struct pim_upstream *up)
+{
+	if (up->t_join_timer || !up->rpf.source_nexthop.interface)
+		return NULL;
+
+	return pim_neighbor_find(up->rpf.source_nexthop.interface,
+				 up->rpf.rpf_addr.u.prefix4);
+}
+
+static long pim_upstream_join_timer_remain_msec(struct pim_upstream *up)
+{
+	struct pim_neighbor *nbr;
+	long remain_msec;
+
+	nbr = pim_upstream_jp_agg_nbr(up);
+	if (!nbr)
+		return pim_time_timer_remain_msec(up->t_join_timer);
+
+	remain_msec = pim_time_timer_remain_msec(nbr->jp_timer);
+	if (up->jp_due_nbr == nbr)
+		remain_msec =
+			MIN(remain_msec, pim_jp_agg_due_remain_msec(nbr));
+
+	return remain_msec;
+}
+
 static void pim_upstream_join_timer_restart_msec(struct pim_upstream *up,
 						 int interval_msec)
 {
+	struct pim_neighbor *nbr;
+
 	if (PIM_DEBUG_PIM_EVENTS) {
 		zlog_debug("%s: restarting %d msec timer for upstream (S,G)=%s",
 			   __PRETTY_FUNCTION__, interval_msec, up->sg_str);
 	}
 
+	/* Goes with the other Joins due to the neighbor */
+	nbr = pim_upstream_jp_agg_nbr(up);
+	if (nbr) {
+		pim_jp_agg_due_add(nbr, up, interval_msec);
+		return;
+	}
+
 	THREAD_OFF(up->t_join_timer);
 	thread_add_timer_msec(master, on_join_timer, up, interval_msec,
 			      &up->t_join_timer);
@@ -366,6 +424,13 @@ void pim_upstream_join_suppress(struct pim_upstream *up,
 		MIN(pim_if_t_suppressed_msec(up->rpf.source_nexthop.interface),
 		    1000 * holdtime);
 
+	/*
+	 * The neighbor's periodic J/P goes for all its upstreams, this
+	 * one's Join can't be held back from it.
+	 */
+	if (pim_upstream_jp_agg_nbr(up))
+		return;
+
 	join_timer_remain_msec = pim_time_timer_remain_msec(up->t_join_timer);
 
 	if (PIM_DEBUG_TRACE) {
@@ -395,7 +460,7 @@ void pim_upstream_join_timer_decrease_to_t_override(const char *debug_label,
 	long join_timer_remain_msec;
 	int t_override_msec;
 
-	join_timer_remain_msec = pim_time_timer_remain_msec(up->t_join_timer);
+	join_timer_remain_msec = pim_upstream_join_timer_remain_msec(up);
 	t_override_msec =
 		pim_if_t_override_msec(up->rpf.source_nexthop.interface);
 
@@ -579,6 +644,12 @@ void pim_upstream_switch(struct pim_instance *pim, struct pim_upstream *up,
 	}
 }
 
+int pim_upstream_rb_compare(const struct pim_upstream *up1,
+			    const struct pim_upstream *up2)
+{
+	return pim_upstream_compare((void *)up1, (void *)up2);
+}
+
 int pim_upstream_compare(void *arg1, void *arg2)
 {
 	const struct pim_upstream *up1 = (const struct pim_upstream *)arg1;
@@ -607,7 +678,7 @@ static struct pim_upstream *pim_upstream_new(struct pim_instance *pim,
 {
 	enum pim_rpf_result rpf_result;
 	struct pim_interface *pim_ifp;
-	struct pim_upstream *up;
+	struct pim_upstream *up, *next;
 
 	up = XCALLOC(MTYPE_PIM_UPSTREAM, sizeof(*up));
 	if (!up) {
@@ -698,6 +769,7 @@ static struct pim_upstream *pim_upstream_new(struct pim_instance *pim,
 
 		list_delete_and_null(&up->ifchannels);
 
+		pim_upstream_rpf_nbr_del(pim, up);
 		hash_release(pim->upstream_hash, up);
 		XFREE(MTYPE_PIM_UPSTREAM, up);
 		return NULL;
@@ -709,7 +781,11 @@ static struct pim_upstream *pim_upstream_new(struct pim_instance *pim,
 			up->channel_oil = pim_channel_oil_add(
 				pim, &up->sg, pim_ifp->mroute_vif_index);
 	}
-	listnode_add_sort(pim->upstream_list, up);
+	/* The list is kept in the tree's order */
+	RB_INSERT(pim_upstream_rb, &pim->upstream_rb, up);
+	next = RB_NEXT(pim_upstream_rb, up);
+	up->pim_node = listnode_add_before(pim->upstream_list,
+					   next ? next->pim_node : NULL, up);
 
 	if (PIM_DEBUG_TRACE) {
 		zlog_debug(
@@ -934,40 +1010,113 @@ void pim_upstream_rpf_genid_changed(struct pim_instance *pim,
 	struct listnode *up_node;
 	struct listnode *up_nextnode;
 	struct pim_upstream *up;
+	struct pim_upstream_rpf_nbr lookup, *nbr;
 
 	/*
-	 * Scan all (S,G) upstreams searching for RPF'(S,G)=neigh_addr
+	 * Scan the (S,G) upstreams whose RPF'(S,G)=neigh_addr
 	 */
-	for (ALL_LIST_ELEMENTS(pim->upstream_list, up_node, up_nextnode, up)) {
+	lookup.addr = neigh_addr;
+	nbr = hash_lookup(pim->upstream_rpf_hash, &lookup);
+	if (!nbr)
+		return;
+
+	for (ALL_LIST_ELEMENTS(nbr->upstreams, up_node, up_nextnode, up)) {
 
 		if (PIM_DEBUG_TRACE) {
 			char neigh_str[INET_ADDRSTRLEN];
-			char rpf_addr_str[PREFIX_STRLEN];
 			pim_inet4_dump("<neigh?>", neigh_addr, neigh_str,
 				       sizeof(neigh_str));
-			pim_addr_dump("<rpf?>", &up->rpf.rpf_addr, rpf_addr_str,
-				      sizeof(rpf_addr_str));
 			zlog_debug(
-				"%s: matching neigh=%s against upstream (S,G)=%s[%s] joined=%d rpf_addr=%s",
+				"%s: matching neigh=%s against upstream (S,G)=%s[%s] joined=%d",
 				__PRETTY_FUNCTION__, neigh_str, up->sg_str,
 				pim->vrf->name,
-				up->join_state == PIM_UPSTREAM_JOINED,
-				rpf_addr_str);
+				up->join_state == PIM_UPSTREAM_JOINED);
 		}
 
 		/* consider only (S,G) upstream in Joined state */
 		if (up->join_state != PIM_UPSTREAM_JOINED)
 			continue;
 
-		/* match RPF'(S,G)=neigh_addr */
-		if (up->rpf.rpf_addr.u.prefix4.s_addr != neigh_addr.s_addr)
-			continue;
-
 		pim_upstream_join_timer_decrease_to_t_override(
 			"RPF'(S,G) GenID change", up);
 	}
 }
 
+static unsigned int pim_upstream_rpf_nbr_hash_key(void *arg)
+{
+	struct pim_upstream_rpf_nbr *nbr = arg;
+
+	return jhash_1word(nbr->addr.s_addr, 0);
+}
+
+static int pim_upstream_rpf_nbr_hash_equal(const void *arg1,
+					   const void *arg2)
+{
+	const struct pim_upstream_rpf_nbr *nbr1 = arg1;
+	const struct pim_upstream_rpf_nbr *nbr2 = arg2;
+
+	return nbr1->addr.s_addr == nbr2->addr.s_addr;
+}
+
+static void *pim_upstream_rpf_nbr_alloc(void *arg)
+{
+	struct pim_upstream_rpf_nbr *lookup = arg;
+	struct pim_upstream_rpf_nbr *nbr;
+
+	nbr = XCALLOC(MTYPE_PIM_UPSTREAM_RPF_NBR, sizeof(*nbr));
+	nbr->addr = lookup->addr;
+	nbr->upstreams = list_new();
+
+	return nbr;
+}
+
+static void pim_upstream_rpf_nbr_free(void *arg)
+{
+	struct pim_upstream_rpf_nbr *nbr = arg;
+
+	list_delete_and_null(&nbr->upstreams);
+	XFREE(MTYPE_PIM_UPSTREAM_RPF_NBR, nbr);
+}
+
+static void pim_upstream_rpf_nbr_del(struct pim_instance *pim,
+				     struct pim_upstream *up)
+{
+	struct pim_upstream_rpf_nbr *nbr = up->rpf_nbr;
+
+	if (!nbr)
+		return;
+
+	list_delete_node(nbr->upstreams, up->rpf_nbr_node);
+	up->rpf_nbr = NULL;
+	up->rpf_nbr_node = NULL;
+
+	if (list_isempty(nbr->upstreams)) {
+		hash_release(pim->upstream_rpf_hash, nbr);
+		pim_upstream_rpf_nbr_free(nbr);
+	}
+}
+
+/* Files the upstream under its RPF'(S,G), as pim_rpf_update() found it */
+void pim_upstream_rpf_nbr_update(struct pim_instance *pim,
+				 struct pim_upstream *up)
+{
+	struct pim_upstream_rpf_nbr lookup, *nbr;
+
+	lookup.addr = up->rpf.rpf_addr.u.prefix4;
+	if (up->rpf_nbr && up->rpf_nbr->addr.s_addr == lookup.addr.s_addr)
+		return;
+
+	pim_upstream_rpf_nbr_del(pim, up);
+	if (lookup.addr.s_addr == INADDR_ANY)
+		return;
+
+	nbr = hash_get(pim->upstream_rpf_hash, &lookup,
+		       pim_upstream_rpf_nbr_alloc);
+	listnode_add(nbr->upstreams, up);
+	up->rpf_nbr = nbr;
+	up->rpf_nbr_node = listtail(nbr->upstreams);
+}
+
 
 void pim_upstream_rpf_interface_changed(struct pim_upstream *up,
 					struct interface *old_rpf_ifp)
@@ -1547,6 +1696,13 @@ void pim_upstream_terminate(struct pim_instance *pim)
 {
 	if (pim->upstream_list)
 		list_delete_and_null(&pim->upstream_list);
+	RB_INIT(pim_upstream_rb, &pim->upstream_rb);
+
+	if (pim->upstream_rpf_hash) {
+		hash_clean(pim->upstream_rpf_hash, pim_upstream_rpf_nbr_free);
+		hash_free(pim->upstream_rpf_hash);
+	}
+	pim->upstream_rpf_hash = NULL;
 
 	if (pim->upstream_hash)
 		hash_free(pim->upstream_hash);
@@ -1644,7 +1800,7 @@ static void pim_upstream_sg_running(void *arg)
 		pim_upstream_inherited_olist_decide(pim, up);
 		up->channel_oil->oil_inherited_rescan = 0;
 	}
-	pim_mroute_update_counters(up->channel_oil);
+	pim_mroute_update_counters_bulk(up->channel_oil);
 
 	// Have we seen packets?
 	if ((up->channel_oil->cc.oldpktcnt >= up->channel_oil->cc.pktcnt)
@@ -1775,4 +1931,10 @@ void pim_upstream_init(struct pim_instance *pim)
 	pim->upstream_list = list_new();
 	pim->upstream_list->del = (void (*)(void *))pim_upstream_free;
 	pim->upstream_list->cmp = pim_upstream_compare;
+	RB_INIT(pim_upstream_rb, &pim->upstream_rb);
+
+	snprintf(hash_name, 64, "PIM %s Upstream RPF Hash", pim->vrf->name);
+	pim->upstream_rpf_hash =
+		hash_create(pim_upstream_rpf_nbr_hash_key,
+			    pim_upstream_rpf_nbr_hash_equal, hash_name);
 }
@@ -86,6 +86,8 @@ enum pim_upstream_sptbit {
 	PIM_UPSTREAM_SPTBIT_TRUE
 };
 
+struct pim_upstream_rpf_nbr;
+
 /*
   Upstream (S,G) channel in Joined state
 
@@ -94,6 +96,9 @@ enum pim_upstream_sptbit {
   See RFC 4601: 4.5.7.  Sending (S,G) Join/Prune Message
 */
 struct pim_upstream {
+	RB_ENTRY(rb_pim_upstream) pim_rb;
+	struct listnode *pim_node; /* on the instance's upstream_list */
+
 	struct pim_upstream *parent;
 	struct in_addr upstream_addr;     /* Who we are talking to */
 	struct in_addr upstream_register; /*Who we received a register from*/
@@ -112,7 +117,14 @@ struct pim_upstream {
 
 	struct pim_rpf rpf;
 
+	/* The upstreams of the same RPF'(S,G), for its GenID changes */
+	struct pim_upstream_rpf_nbr *rpf_nbr;
+	struct listnode *rpf_nbr_node;
+
 	struct thread *t_join_timer;
+	/* Or, with a neighbor, its place on the neighbor's due Joins */
+	struct pim_neighbor *jp_due_nbr;
+	struct listnode *jp_due_node;
 
 	/*
 	 * RST(S,G)
@@ -137,6 +149,10 @@ struct pim_upstream {
 	int64_t state_transition; /* Record current state uptime */
 };
 
+int pim_upstream_rb_compare(const struct pim_upstream *up1,
+			    const struct pim_upstream *up2);
+RB_PROTOTYPE(pim_upstream_rb, pim_upstream, pim_rb, pim_upstream_rb_compare);
+
 void pim_upstream_free(struct pim_upstream *up);
 struct pim_upstream *pim_upstream_find(struct pim_instance *pim,
 				       struct prefix_sg *sg);
@@ -171,6 +187,8 @@ void pim_upstream_join_timer_restart(struct pim_upstream *up,
 				     struct pim_rpf *old);
 void pim_upstream_rpf_genid_changed(struct pim_instance *pim,
 				    struct in_addr neigh_addr);
+void pim_upstream_rpf_nbr_update(struct pim_instance *pim,
+				 struct pim_upstream *up);
 void pim_upstream_rpf_interface_changed(struct pim_upstream *up,
 					struct interface *old_rpf_ifp);
 
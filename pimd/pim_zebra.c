@@ -427,6 +427,7 @@ static void scan_upstream_rpf_cache(struct pim_instance *pim)
 			if (nbr)
 				pim_jp_agg_remove_group(nbr->upstream_jp_agg,
 							up);
+			pim_jp_agg_due_remove(up);
 
 			/*
 			 * We have detected a case where we might need
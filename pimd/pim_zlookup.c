@@ -554,3 +554,90 @@ int pim_zlookup_sg_statistics(struct channel_oil *c_oil)
 
 	return 0;
 }
+
+/*
+ * Ask zebra for the counters of all the instance's kernel MFC entries at
+ * once.  It answers in as many messages as they need, the last one telling
+ * whether they could all be collected.  The channels found are stamped with
+ * gen.
+ */
+int pim_zlookup_sg_statistics_bulk(struct pim_instance *pim, uint32_t gen)
+{
+	struct stream *s = zlookup->obuf;
+	struct channel_oil *c_oil;
+	struct prefix_sg sg;
+	uint32_t i, count;
+	uint8_t more = 1;
+	int suc = 0;
+	int ret;
+
+	if (PIM_DEBUG_ZEBRA)
+		zlog_debug("Sending Request for all Channel Oil Information(%s)",
+			   pim->vrf->name);
+
+	stream_reset(s);
+	zclient_create_header(s, ZEBRA_IPMR_ROUTE_STATS_BULK, pim->vrf_id);
+	stream_putw_at(s, 0, stream_get_endp(s));
+
+	ret = writen(zlookup->sock, s->data, stream_get_endp(s));
+	if (ret <= 0) {
+		zlog_err(
+			"%s: writen() failure: %d writing to zclient lookup socket",
+			__PRETTY_FUNCTION__, errno);
+		return -1;
+	}
+
+	s = zlookup->ibuf;
+
+	while (more) {
+		uint16_t command = 0;
+
+		while (command != ZEBRA_IPMR_ROUTE_STATS_BULK) {
+			int err;
+			uint16_t length = 0;
+			vrf_id_t vrf_id;
+			uint8_t marker;
+			uint8_t version;
+
+			stream_reset(s);
+			err = zclient_read_header(s, zlookup->sock, &length,
+						  &marker, &version, &vrf_id,
+						  &command);
+			if (err < 0) {
+				zlog_err("%s: zclient_read_header() failed",
+					 __PRETTY_FUNCTION__);
+				zclient_lookup_failed(zlookup);
+				return -1;
+			}
+		}
+
+		suc = stream_getl(s);
+		more = stream_getc(s);
+		count = stream_getl(s);
+
+		for (i = 0; i < count; i++) {
+			sg.src.s_addr = stream_get_ipv4(s);
+			sg.grp.s_addr = stream_get_ipv4(s);
+
+			c_oil = pim_find_channel_oil(pim, &sg);
+			if (!c_oil) {
+				stream_forward_getp(s, 4 * 8);
+				continue;
+			}
+
+			stream_get(&c_oil->bulk_cc.lastused, s,
+				   sizeof(c_oil->bulk_cc.lastused));
+			c_oil->bulk_cc.pktcnt = stream_getq(s);
+			c_oil->bulk_cc.bytecnt = stream_getq(s);
+			c_oil->bulk_cc.wrong_if = stream_getq(s);
+			c_oil->bulk_cc_gen = gen;
+		}
+	}
+
+	if (PIM_DEBUG_ZEBRA && suc)
+		zlog_debug("%s: zebra could not collect (%s) counters: %d",
+			   __PRETTY_FUNCTION__, pim->vrf->name, suc);
+
+	return suc ? -1 : 0;
+}
+
@@ -44,4 +44,5 @@ int zclient_lookup_nexthop(struct pim_instance *pim,
 void pim_zlookup_show_ip_multicast(struct vty *vty);
 
 int pim_zlookup_sg_statistics(struct channel_oil *c_oil);
+int pim_zlookup_sg_statistics_bulk(struct pim_instance *pim, uint32_t gen);
 #endif /* PIM_ZLOOKUP_H */
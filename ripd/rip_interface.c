@@ -1871,6 +1871,10 @@ static int rip_interface_new_hook(struct interface *ifp)
 /* Called when interface structure deleted. */
 static int rip_interface_delete_hook(struct interface *ifp)
 {
+	struct rip_interface *ri = ifp->info;
+
+	if (ri->obuf_rte)
+		stream_free(ri->obuf_rte);
 	XFREE(MTYPE_RIP_INTERFACE, ifp->info);
 	ifp->info = NULL;
 	return 0;
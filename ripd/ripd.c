@@ -141,6 +141,24 @@ static int rip_garbage_collect(struct thread *t)
 
 static void rip_timeout_update(struct rip_info *rinfo);
 
+/* Set the route change flag on the first entry of the route, and queue the
+ * route for the next triggered update.
+ */
+static void rip_route_changed(struct route_node *rp)
+{
+	struct rip_info *rinfo;
+	struct route_node *rn;
+
+	rinfo = listgetdata(listhead((struct list *)rp->info));
+	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+
+	rn = route_node_get(rip->changed, &rp->p);
+	if (rn->info)
+		route_unlock_node(rn);
+	else
+		rn->info = route_lock_node(rp);
+}
+
 /* Add new route to the ECMP list.
  * RETURN: the new entry added in the list, or NULL if it is not the first
  *         entry and ECMP is not allowed.
@@ -171,7 +189,7 @@ struct rip_info *rip_ecmp_add(struct rip_info *rinfo_new)
 
 	/* Set the route change flag on the first entry. */
 	rinfo = listgetdata(listhead(list));
-	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+	rip_route_changed(rp);
 
 	/* Signal the output process to trigger an update (see section 2.5). */
 	rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -220,7 +238,7 @@ struct rip_info *rip_ecmp_replace(struct rip_info *rinfo_new)
 	}
 
 	/* Set the route change flag. */
-	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+	rip_route_changed(rp);
 
 	/* Signal the output process to trigger an update (see section 2.5). */
 	rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -270,7 +288,7 @@ struct rip_info *rip_ecmp_delete(struct rip_info *rinfo)
 
 	/* Set the route change flag on the first entry. */
 	rinfo = listgetdata(listhead(list));
-	SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+	rip_route_changed(rp);
 
 	/* Signal the output process to trigger an update (see section 2.5). */
 	rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -655,7 +673,7 @@ static void rip_rte_process(struct rte *rte, struct sockaddr_in *from,
 					/* - Set the route change flag on the
 					 * first entry. */
 					rinfo = listgetdata(listhead(list));
-					SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+					rip_route_changed(rp);
 					rip_event(RIP_TRIGGERED_UPDATE, 0);
 				}
 			}
@@ -1550,7 +1568,7 @@ void rip_redistribute_delete(int type, int sub_type, struct prefix_ipv4 *p,
 					     rip_garbage_collect,
 					     rip->garbage_time);
 				RIP_TIMER_OFF(rinfo->t_timeout);
-				rinfo->flags |= RIP_RTF_CHANGED;
+				rip_route_changed(rp);
 
 				if (IS_RIP_DEBUG_EVENT)
 					zlog_debug(
@@ -2035,73 +2053,33 @@ static int rip_write_rte(int num, struct stream *s, struct prefix_ipv4 *p,
 	return ++num;
 }
 
-/* Send update to the ifp or spcified neighbor. */
-void rip_output_process(struct connected *ifc, struct sockaddr_in *to,
-			int route_type, uint8_t version)
+/* Encode the RTEs the ifp or neighbors on it are sent, in the interface's
+   RTE buffer. */
+static void rip_output_encode(struct connected *ifc, int route_type,
+			      uint8_t version)
 {
 	int ret;
 	struct stream *s;
+	struct route_table *table;
+	struct route_node *rn;
 	struct route_node *rp;
 	struct rip_info *rinfo;
 	struct rip_interface *ri;
 	struct prefix_ipv4 *p;
 	struct prefix_ipv4 classfull;
 	struct prefix_ipv4 ifaddrclass;
-	struct key *key = NULL;
-	/* this might need to made dynamic if RIP ever supported auth methods
-	   with larger key string sizes */
-	char auth_str[RIP_AUTH_SIMPLE_SIZE];
-	size_t doff = 0; /* offset of digest offset field */
 	int num = 0;
-	int rtemax;
 	int subnetted = 0;
 	struct list *list = NULL;
 	struct listnode *listnode = NULL;
 
-	/* Logging output event. */
-	if (IS_RIP_DEBUG_EVENT) {
-		if (to)
-			zlog_debug("update routes to neighbor %s",
-				   inet_ntoa(to->sin_addr));
-		else
-			zlog_debug("update routes on interface %s ifindex %d",
-				   ifc->ifp->name, ifc->ifp->ifindex);
-	}
-
-	/* Set output stream. */
-	s = rip->obuf;
-
-	/* Reset stream and RTE counter. */
-	stream_reset(s);
-	rtemax = RIP_MAX_RTE;
-
 	/* Get RIP interface. */
 	ri = ifc->ifp->info;
 
-	/* If output interface is in simple password authentication mode, we
-	   need space for authentication data.  */
-	if (ri->auth_type == RIP_AUTH_SIMPLE_PASSWORD)
-		rtemax -= 1;
-
-	/* If output interface is in MD5 authentication mode, we need space
-	   for authentication header and data. */
-	if (ri->auth_type == RIP_AUTH_MD5)
-		rtemax -= 2;
-
-	/* If output interface is in simple password authentication mode
-	   and string or keychain is specified we need space for auth. data */
-	if (ri->auth_type != RIP_NO_AUTH) {
-		if (ri->key_chain) {
-			struct keychain *keychain;
-
-			keychain = keychain_lookup(ri->key_chain);
-			if (keychain)
-				key = key_lookup_for_send(keychain);
-		}
-		/* to be passed to auth functions later */
-		rip_auth_prepare_str_send(ri, key, auth_str,
-					  RIP_AUTH_SIMPLE_SIZE);
-	}
+	if (!ri->obuf_rte)
+		ri->obuf_rte = stream_new(RIP_MAX_RTE * RIP_RTE_SIZE);
+	s = ri->obuf_rte;
+	stream_reset(s);
 
 	if (version == RIPv1) {
 		memcpy(&ifaddrclass, ifc->address, sizeof(struct prefix_ipv4));
@@ -2111,8 +2089,12 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to,
 			subnetted = 1;
 	}
 
-	for (rp = route_top(rip->table); rp; rp = route_next(rp))
-		if ((list = rp->info) != NULL && listcount(list) != 0) {
+	/* Triggered updates only look at the changed routes. */
+	table = (route_type == rip_changed_route) ? rip->changed : rip->table;
+
+	for (rn = route_top(table); rn; rn = route_next(rn))
+		if ((rp = (table == rip->table) ? rn : rn->info) != NULL
+		    && (list = rp->info) != NULL && listcount(list) != 0) {
 			rinfo = listgetdata(listhead(list));
 			/* For RIPv1, if we are subnetted, output subnets in our
 			 * network    */
@@ -2159,11 +2141,6 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to,
 			if (ret < 0)
 				continue;
 
-			/* Changed route only output. */
-			if (route_type == rip_changed_route
-			    && (!(rinfo->flags & RIP_RTF_CHANGED)))
-				continue;
-
 			/* Split horizon. */
 			/* if (split_horizon == rip_split_horizon) */
 			if (ri->split_horizon == RIP_SPLIT_HORIZON) {
@@ -2344,44 +2321,104 @@ void rip_output_process(struct connected *ifc, struct sockaddr_in *to,
 				}
 			}
 
-			/* Prepare preamble, auth headers, if needs be */
-			if (num == 0) {
-				stream_putc(s, RIP_RESPONSE);
-				stream_putc(s, version);
-				stream_putw(s, 0);
-
-				/* auth header for !v1 && !no_auth */
-				if ((ri->auth_type != RIP_NO_AUTH)
-				    && (version != RIPv1))
-					doff = rip_auth_header_write(
-						s, ri, key, auth_str,
-						RIP_AUTH_SIMPLE_SIZE);
-			}
-
-			/* Write RTE to the stream. */
+			/* Write RTE to the buffer. */
+			if (STREAM_WRITEABLE(s) < RIP_RTE_SIZE)
+				stream_resize(s, 2 * s->size);
 			num = rip_write_rte(num, s, p, version, rinfo);
-			if (num == rtemax) {
-				if (version == RIPv2
-				    && ri->auth_type == RIP_AUTH_MD5)
-					rip_auth_md5_set(s, ri, doff, auth_str,
-							 RIP_AUTH_SIMPLE_SIZE);
-
-				ret = rip_send_packet(STREAM_DATA(s),
-						      stream_get_endp(s), to,
-						      ifc);
-
-				if (ret >= 0 && IS_RIP_DEBUG_SEND)
-					rip_packet_dump((struct rip_packet *)
-								STREAM_DATA(s),
-							stream_get_endp(s),
-							"SEND");
-				num = 0;
-				stream_reset(s);
-			}
 		}
 
-	/* Flush unwritten RTE. */
-	if (num != 0) {
+	ri->obuf_num = num;
+	ri->obuf_run = rip->update_run;
+	ri->obuf_ifc = ifc;
+	ri->obuf_version = version;
+}
+
+/* Send update to the ifp or spcified neighbor. */
+void rip_output_process(struct connected *ifc, struct sockaddr_in *to,
+			int route_type, uint8_t version)
+{
+	int ret;
+	struct stream *s;
+	struct rip_interface *ri;
+	struct key *key = NULL;
+	/* this might need to made dynamic if RIP ever supported auth methods
+	   with larger key string sizes */
+	char auth_str[RIP_AUTH_SIMPLE_SIZE];
+	size_t doff = 0; /* offset of digest offset field */
+	int num;
+	int rtemax;
+	int i;
+
+	/* Logging output event. */
+	if (IS_RIP_DEBUG_EVENT) {
+		if (to)
+			zlog_debug("update routes to neighbor %s",
+				   inet_ntoa(to->sin_addr));
+		else
+			zlog_debug("update routes on interface %s ifindex %d",
+				   ifc->ifp->name, ifc->ifp->ifindex);
+	}
+
+	/* Set output stream. */
+	s = rip->obuf;
+
+	/* Reset stream and RTE counter. */
+	stream_reset(s);
+	rtemax = RIP_MAX_RTE;
+
+	/* Get RIP interface. */
+	ri = ifc->ifp->info;
+
+	/* During an update run every address and neighbor of the interface
+	   is sent the same RTEs, RIPv1 ones only those of the same address,
+	   so they are only encoded once. */
+	if (!rip->update_running || !ri->obuf_rte
+	    || ri->obuf_run != rip->update_run || ri->obuf_version != version
+	    || (version == RIPv1 && ri->obuf_ifc != ifc))
+		rip_output_encode(ifc, route_type, version);
+
+	/* If output interface is in simple password authentication mode, we
+	   need space for authentication data.  */
+	if (ri->auth_type == RIP_AUTH_SIMPLE_PASSWORD)
+		rtemax -= 1;
+
+	/* If output interface is in MD5 authentication mode, we need space
+	   for authentication header and data. */
+	if (ri->auth_type == RIP_AUTH_MD5)
+		rtemax -= 2;
+
+	/* If output interface is in simple password authentication mode
+	   and string or keychain is specified we need space for auth. data */
+	if (ri->auth_type != RIP_NO_AUTH) {
+		if (ri->key_chain) {
+			struct keychain *keychain;
+
+			keychain = keychain_lookup(ri->key_chain);
+			if (keychain)
+				key = key_lookup_for_send(keychain);
+		}
+		/* to be passed to auth functions later */
+		rip_auth_prepare_str_send(ri, key, auth_str,
+					  RIP_AUTH_SIMPLE_SIZE);
+	}
+
+	/* Send the RTEs, rtemax of them to a packet. */
+	for (i = 0; i < ri->obuf_num; i += num) {
+		num = MIN(ri->obuf_num - i, rtemax);
+
+		/* Prepare preamble, auth headers, if needs be */
+		stream_putc(s, RIP_RESPONSE);
+		stream_putc(s, version);
+		stream_putw(s, 0);
+
+		/* auth header for !v1 && !no_auth */
+		if ((ri->auth_type != RIP_NO_AUTH) && (version != RIPv1))
+			doff = rip_auth_header_write(s, ri, key, auth_str,
+						     RIP_AUTH_SIMPLE_SIZE);
+
+		stream_put(s, STREAM_DATA(ri->obuf_rte) + i * RIP_RTE_SIZE,
+			   num * RIP_RTE_SIZE);
+
 		if (version == RIPv2 && ri->auth_type == RIP_AUTH_MD5)
 			rip_auth_md5_set(s, ri, doff, auth_str,
 					 RIP_AUTH_SIMPLE_SIZE);
@@ -2459,6 +2496,10 @@ static void rip_update_process(int route_type)
 	struct sockaddr_in to;
 	struct prefix *p;
 
+	/* The RTEs encoded for an interface now hold for the whole run. */
+	rip->update_run++;
+	rip->update_running = true;
+
 	/* Send RIP update to each interface. */
 	FOR_ALL_INTERFACES (vrf, ifp) {
 		if (if_is_loopback(ifp))
@@ -2530,6 +2571,8 @@ static void rip_update_process(int route_type)
 			rip_output_process(connected, &to, route_type,
 					   rip->version_send);
 		}
+
+	rip->update_running = false;
 }
 
 /* RIP's periodical timer. */
@@ -2555,22 +2598,25 @@ static int rip_update(struct thread *t)
 	return 0;
 }
 
-/* Walk down the RIP routing table then clear changed flag. */
+/* Walk down the changed routes then clear changed flag. */
 static void rip_clear_changed_flag(void)
 {
-	struct route_node *rp;
+	struct route_node *rn, *rp;
 	struct rip_info *rinfo = NULL;
 	struct list *list = NULL;
-	struct listnode *listnode = NULL;
 
-	for (rp = route_top(rip->table); rp; rp = route_next(rp))
-		if ((list = rp->info) != NULL)
-			for (ALL_LIST_ELEMENTS_RO(list, listnode, rinfo)) {
+	for (rn = route_top(rip->changed); rn; rn = route_next(rn))
+		if ((rp = rn->info) != NULL) {
+			/* This flag can be set only on the first entry. */
+			if ((list = rp->info) != NULL && listcount(list) != 0) {
+				rinfo = listgetdata(listhead(list));
 				UNSET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
-				/* This flag can be set only on the first entry.
-				 */
-				break;
 			}
+
+			rn->info = NULL;
+			route_unlock_node(rn);
+			route_unlock_node(rp);
+		}
 }
 
 /* Triggered update interval timer. */
@@ -2645,7 +2691,7 @@ void rip_redistribute_withdraw(int type)
 					     rip_garbage_collect,
 					     rip->garbage_time);
 				RIP_TIMER_OFF(rinfo->t_timeout);
-				rinfo->flags |= RIP_RTF_CHANGED;
+				rip_route_changed(rp);
 
 				if (IS_RIP_DEBUG_EVENT) {
 					struct prefix_ipv4 *p =
@@ -2680,6 +2726,7 @@ static int rip_create(void)
 
 	/* Initialize RIP routig table. */
 	rip->table = route_table_init();
+	rip->changed = route_table_init();
 	rip->route = route_table_init();
 	rip->neighbor = route_table_init();
 
@@ -3348,7 +3395,7 @@ static void rip_ecmp_disable(void)
 			rip_zebra_ipv4_add(rp);
 
 			/* Set the route change flag. */
-			SET_FLAG(rinfo->flags, RIP_RTF_CHANGED);
+			rip_route_changed(rp);
 
 			/* Signal the output process to trigger an update. */
 			rip_event(RIP_TRIGGERED_UPDATE, 0);
@@ -3821,6 +3868,10 @@ void rip_clean(void)
 	if (rip) {
 		QOBJ_UNREG(rip);
 
+		/* Release the routes waiting for a triggered update. */
+		rip_clear_changed_flag();
+		route_table_finish(rip->changed);
+
 		/* Clear RIP routes */
 		for (rp = route_top(rip->table); rp; rp = route_next(rp))
 			if ((list = rp->info) != NULL) {
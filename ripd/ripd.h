@@ -113,6 +113,10 @@ struct rip {
 	/* RIP routing information base. */
 	struct route_table *table;
 
+	/* Routes changed since the last triggered update, each holding a
+	   lock on its node of the routing table. */
+	struct route_table *changed;
+
 	/* RIP only static routing information. */
 	struct route_table *route;
 
@@ -130,6 +134,10 @@ struct rip {
 	struct thread *t_triggered_update;
 	struct thread *t_triggered_interval;
 
+	/* Update runs, during which the interfaces' RTEs are cached. */
+	uint32_t update_run;
+	bool update_running;
+
 	/* RIP timer values. */
 	unsigned long update_time;
 	unsigned long timeout_time;
@@ -296,6 +304,13 @@ struct rip_interface {
 
 	/* Passive interface. */
 	int passive;
+
+	/* RTEs encoded by the last update run on the interface. */
+	struct stream *obuf_rte;
+	int obuf_num;
+	uint32_t obuf_run;
+	struct connected *obuf_ifc;
+	uint8_t obuf_version;
 };
 
 /* RIP peer information. */
@@ -160,6 +160,10 @@ int main(int argc, char **argv)
 
 	master = frr_init();
 
+	/* Every route has second-scale timeout and garbage-collect timers,
+	 * re-armed on each update heard; keep them off the timer heap. */
+	thread_master_set_timer_wheel(master, true);
+
 	/* Library inits. */
 	vrf_init(NULL, NULL, NULL, NULL);
 
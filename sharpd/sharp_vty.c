@@ -28,6 +28,7 @@
 #include "log.h"
 #include "vrf.h"
 #include "zclient.h"
+#include "memory.h"
 
 #include "sharpd/sharp_zebra.h"
 #include "sharpd/sharp_vty.h"
@@ -36,6 +37,10 @@
 #endif
 
 extern uint32_t total_routes;
+
+/* Routes handed to zebra in one go */
+#define SHARP_BATCH_SIZE 1000
+static struct prefix batch[SHARP_BATCH_SIZE];
 extern uint32_t installed_routes;
 extern uint32_t removed_routes;
 
@@ -81,41 +86,72 @@ DEFPY(watch_nexthop_v4, watch_nexthop_v4_cmd,
 
 DEFPY (install_routes,
        install_routes_cmd,
-       "sharp install routes A.B.C.D$start nexthop A.B.C.D$nexthop (1-1000000)$routes",
+       "sharp install routes A.B.C.D$start nexthop A.B.C.D$nexthop (1-1000000)$routes [ecmp (1-256)$ecmp] [fanout (1-1000)$fanout]",
        "Sharp routing Protocol\n"
        "install some routes\n"
        "Routes to install\n"
        "Address to start /32 generation at\n"
        "Nexthop to use\n"
        "Nexthop address\n"
-       "How many to create\n")
+       "How many to create\n"
+       "Nexthops per route\n"
+       "How many, counting up from the nexthop address\n"
+       "Different sets of nexthops, used in turn by the routes\n"
+       "How many sets\n")
 {
-	int i;
+	int i, j, count, set;
 	struct prefix p;
-	struct nexthop nhop;
+	struct nexthop *nhops;
 	uint32_t temp;
 
+	if (!ecmp)
+		ecmp = 1;
+	if (!fanout)
+		fanout = 1;
+	if (ecmp > MULTIPATH_NUM) {
+		vty_out(vty, "%% Zebra takes no more than %d nexthops\n",
+			MULTIPATH_NUM);
+		return CMD_WARNING;
+	}
+
 	total_routes = routes;
 	installed_routes = 0;
 
 	memset(&p, 0, sizeof(p));
-	memset(&nhop, 0, sizeof(nhop));
 
 	p.family = AF_INET;
 	p.prefixlen = 32;
-	p.u.prefix4 = start;
 
-	nhop.gate.ipv4 = nexthop;
-	nhop.type = NEXTHOP_TYPE_IPV4;
+	/* Set n is made of the nexthops n * ecmp to (n + 1) * ecmp - 1 */
+	nhops = XCALLOC(MTYPE_TMP, ecmp * fanout * sizeof(struct nexthop));
+	temp = ntohl(nexthop.s_addr);
+	for (i = 0; i < ecmp * fanout; i++) {
+		nhops[i].gate.ipv4.s_addr = htonl(temp + i);
+		nhops[i].type = NEXTHOP_TYPE_IPV4;
+	}
 
 	zlog_debug("Inserting %ld routes", routes);
 
-	temp = ntohl(p.u.prefix4.s_addr);
-	for (i = 0; i < routes; i++) {
-		route_add(&p, &nhop);
-		p.u.prefix4.s_addr = htonl(++temp);
+	sharp_bench_start(true, start, routes, ecmp, fanout);
+
+	/* Route n uses set n % fanout, the routes of a set go in bulk */
+	temp = ntohl(start.s_addr);
+	for (set = 0; set < fanout; set++) {
+		for (i = set; i < routes; i += count * fanout) {
+			count = MIN((routes - i + fanout - 1) / fanout,
+				    SHARP_BATCH_SIZE);
+			for (j = 0; j < count; j++) {
+				p.u.prefix4.s_addr =
+					htonl(temp + i + j * fanout);
+				batch[j] = p;
+				sharp_bench_sent(i + j * fanout);
+			}
+			route_add(batch, count, &nhops[set * ecmp], ecmp);
+		}
 	}
 
+	XFREE(MTYPE_TMP, nhops);
+
 	return CMD_SUCCESS;
 }
 
@@ -158,7 +194,7 @@ DEFPY (remove_routes,
        "Starting spot\n"
        "Routes to uniinstall\n")
 {
-	int i;
+	int i, j, count;
 	struct prefix p;
 	uint32_t temp;
 
@@ -173,15 +209,34 @@ DEFPY (remove_routes,
 
 	zlog_debug("Removing %ld routes", routes);
 
+	sharp_bench_start(false, start, routes, 0, 0);
+
 	temp = ntohl(p.u.prefix4.s_addr);
-	for (i = 0; i < routes; i++) {
-		route_delete(&p);
-		p.u.prefix4.s_addr = htonl(++temp);
+	for (i = 0; i < routes; i += count) {
+		count = MIN(routes - i, SHARP_BATCH_SIZE);
+		for (j = 0; j < count; j++) {
+			batch[j] = p;
+			p.u.prefix4.s_addr = htonl(++temp);
+			sharp_bench_sent(i + j);
+		}
+		route_delete(batch, count);
 	}
 
 	return CMD_SUCCESS;
 }
 
+DEFUN (show_sharp_benchmark,
+       show_sharp_benchmark_cmd,
+       "show sharp benchmark",
+       SHOW_STR
+       "Sharp Routing Protocol\n"
+       "Timing of the last install or remove of routes\n")
+{
+	sharp_bench_show(vty);
+
+	return CMD_SUCCESS;
+}
+
 void sharp_vty_init(void)
 {
 	install_element(ENABLE_NODE, &install_routes_cmd);
@@ -189,5 +244,6 @@ void sharp_vty_init(void)
 	install_element(ENABLE_NODE, &vrf_label_cmd);
 	install_element(ENABLE_NODE, &watch_nexthop_v6_cmd);
 	install_element(ENABLE_NODE, &watch_nexthop_v4_cmd);
+	install_element(VIEW_NODE, &show_sharp_benchmark_cmd);
 	return;
 }
@@ -34,6 +34,8 @@
 #include "plist.h"
 #include "log.h"
 #include "nexthop.h"
+#include "vty.h"
+#include "libfrr.h"
 
 #include "sharp_zebra.h"
 
@@ -132,6 +134,173 @@ extern uint32_t total_routes;
 extern uint32_t installed_routes;
 extern uint32_t removed_routes;
 
+/*
+ * Timing of the last install or remove run, from the time each route
+ * was handed to zebra to the notification zebra sent back for it.
+ */
+static struct sharp_bench {
+	bool install;
+	uint32_t start; /* first /32, host order */
+	uint32_t total;
+	uint32_t ecmp;
+	uint32_t fanout;
+
+	uint32_t done;
+	uint32_t failed;
+
+	struct timeval t_start;
+	uint64_t *sent;    /* usecs since t_start */
+	uint64_t *latency; /* usecs, SHARP_BENCH_PENDING until notified */
+#define SHARP_BENCH_PENDING UINT64_MAX
+
+	long zebra_kb_start;
+
+	/* Results, once the last route is notified */
+	uint64_t elapsed;
+	uint64_t p50, p99;
+	long zebra_kb_end;
+} bench;
+
+/* Resident memory of zebra in kB, if its pid file says where it runs */
+static long sharp_zebra_memory(void)
+{
+	char path[MAXPATHLEN];
+	long pid, pages, kb = -1;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/zebra.pid", frr_vtydir);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%ld", &pid) != 1)
+		pid = 0;
+	fclose(fp);
+	if (pid <= 0)
+		return -1;
+
+	snprintf(path, sizeof(path), "/proc/%ld/statm", pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (fscanf(fp, "%*s %ld", &pages) == 1)
+		kb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+	fclose(fp);
+
+	return kb;
+}
+
+void sharp_bench_start(bool install, struct in_addr start, uint32_t total,
+		       uint32_t ecmp, uint32_t fanout)
+{
+	uint32_t i;
+
+	XFREE(MTYPE_TMP, bench.sent);
+	XFREE(MTYPE_TMP, bench.latency);
+	memset(&bench, 0, sizeof(bench));
+
+	bench.install = install;
+	bench.start = ntohl(start.s_addr);
+	bench.total = total;
+	bench.ecmp = ecmp;
+	bench.fanout = fanout;
+
+	bench.sent = XCALLOC(MTYPE_TMP, total * sizeof(uint64_t));
+	bench.latency = XMALLOC(MTYPE_TMP, total * sizeof(uint64_t));
+	for (i = 0; i < total; i++)
+		bench.latency[i] = SHARP_BENCH_PENDING;
+
+	bench.zebra_kb_start = sharp_zebra_memory();
+	monotime(&bench.t_start);
+}
+
+void sharp_bench_sent(uint32_t route)
+{
+	bench.sent[route] = monotime_since(&bench.t_start, NULL);
+}
+
+static int sharp_bench_cmp(const void *a, const void *b)
+{
+	uint64_t la = *(const uint64_t *)a, lb = *(const uint64_t *)b;
+
+	return (la > lb) - (la < lb);
+}
+
+static void sharp_bench_finish(void)
+{
+	/* Every route is in, their order no longer matters */
+	qsort(bench.latency, bench.total, sizeof(uint64_t), sharp_bench_cmp);
+	bench.p50 = bench.latency[(bench.total - 1) * 50 / 100];
+	bench.p99 = bench.latency[(bench.total - 1) * 99 / 100];
+	bench.zebra_kb_end = sharp_zebra_memory();
+
+	zlog_notice("%s %u routes took %" PRIu64 " usecs, %u failed",
+		    bench.install ? "Installing" : "Removing", bench.total,
+		    bench.elapsed, bench.failed);
+}
+
+static void sharp_bench_notified(struct prefix *p, bool ok)
+{
+	uint32_t route;
+	uint64_t now;
+
+	if (!bench.latency || p->family != AF_INET
+	    || p->prefixlen != IPV4_MAX_BITLEN)
+		return;
+
+	route = ntohl(p->u.prefix4.s_addr) - bench.start;
+	if (route >= bench.total
+	    || bench.latency[route] != SHARP_BENCH_PENDING)
+		return;
+
+	now = monotime_since(&bench.t_start, NULL);
+	bench.latency[route] = now - bench.sent[route];
+	if (!ok)
+		bench.failed++;
+
+	if (++bench.done == bench.total) {
+		bench.elapsed = now;
+		sharp_bench_finish();
+	}
+}
+
+void sharp_bench_show(struct vty *vty)
+{
+	if (!bench.total) {
+		vty_out(vty, "No routes installed or removed yet\n");
+		return;
+	}
+
+	vty_out(vty, "%s %u routes", bench.install ? "Install" : "Remove",
+		bench.total);
+	if (bench.install)
+		vty_out(vty, ", ECMP width %u, nexthop fan-out %u", bench.ecmp,
+			bench.fanout);
+	vty_out(vty, "\n");
+
+	if (bench.done != bench.total) {
+		vty_out(vty, "  In progress: %u notified, %u failed, %" PRId64
+			     " usecs so far\n",
+			bench.done, bench.failed,
+			monotime_since(&bench.t_start, NULL));
+		return;
+	}
+
+	vty_out(vty, "  Took %" PRIu64 " usecs, %" PRIu64 " routes/sec, %u failed\n",
+		bench.elapsed,
+		bench.elapsed ? (uint64_t)bench.total * 1000000 / bench.elapsed
+			      : 0,
+		bench.failed);
+	vty_out(vty, "  Latency p50 %" PRIu64 " usecs, p99 %" PRIu64
+		     " usecs\n",
+		bench.p50, bench.p99);
+	if (bench.zebra_kb_start >= 0 && bench.zebra_kb_end >= 0)
+		vty_out(vty, "  Zebra memory %ld kB -> %ld kB (%+ld kB)\n",
+			bench.zebra_kb_start, bench.zebra_kb_end,
+			bench.zebra_kb_end - bench.zebra_kb_start);
+	else
+		vty_out(vty, "  Zebra memory unknown\n");
+}
+
 static int route_notify_owner(int command, struct zclient *zclient,
 			      zebra_size_t length, vrf_id_t vrf_id)
 {
@@ -147,20 +316,25 @@ static int route_notify_owner(int command, struct zclient *zclient,
 		installed_routes++;
 		if (total_routes == installed_routes)
 			zlog_debug("Installed All Items");
+		sharp_bench_notified(&p, true);
 		break;
 	case ZAPI_ROUTE_FAIL_INSTALL:
 		zlog_debug("Failed install of route");
+		sharp_bench_notified(&p, false);
 		break;
 	case ZAPI_ROUTE_BETTER_ADMIN_WON:
 		zlog_debug("Better Admin Distance won over us");
+		sharp_bench_notified(&p, false);
 		break;
 	case ZAPI_ROUTE_REMOVED:
 		removed_routes++;
 		if (total_routes == removed_routes)
 			zlog_debug("Removed all Items");
+		sharp_bench_notified(&p, true);
 		break;
 	case ZAPI_ROUTE_REMOVE_FAIL:
 		zlog_debug("Route removal Failure");
+		sharp_bench_notified(&p, false);
 		break;
 	}
 	return 0;
@@ -176,31 +350,33 @@ void vrf_label_add(vrf_id_t vrf_id, afi_t afi, mpls_label_t label)
 	zclient_send_vrf_label(zclient, vrf_id, afi, label, ZEBRA_LSP_SHARP);
 }
 
-void route_add(struct prefix *p, struct nexthop *nh)
+void route_add(struct prefix *p, int count, struct nexthop *nh, int nh_num)
 {
 	struct zapi_route api;
 	struct zapi_nexthop *api_nh;
+	int i;
 
 	memset(&api, 0, sizeof(api));
 	api.vrf_id = VRF_DEFAULT;
 	api.type = ZEBRA_ROUTE_SHARP;
 	api.safi = SAFI_UNICAST;
-	memcpy(&api.prefix, p, sizeof(*p));
 
 	SET_FLAG(api.flags, ZEBRA_FLAG_ALLOW_RECURSION);
 	SET_FLAG(api.message, ZAPI_MESSAGE_NEXTHOP);
 
-	api_nh = &api.nexthops[0];
-	api_nh->vrf_id = VRF_DEFAULT;
-	api_nh->gate.ipv4 = nh->gate.ipv4;
-	api_nh->type = nh->type;
-	api_nh->ifindex = nh->ifindex;
-	api.nexthop_num = 1;
+	for (i = 0; i < nh_num; i++) {
+		api_nh = &api.nexthops[i];
+		api_nh->vrf_id = VRF_DEFAULT;
+		api_nh->gate.ipv4 = nh[i].gate.ipv4;
+		api_nh->type = nh[i].type;
+		api_nh->ifindex = nh[i].ifindex;
+	}
+	api.nexthop_num = nh_num;
 
-	zclient_route_send(ZEBRA_ROUTE_ADD, zclient, &api);
+	zclient_route_bulk_send(ZEBRA_ROUTE_ADD_BULK, zclient, &api, p, count);
 }
 
-void route_delete(struct prefix *p)
+void route_delete(struct prefix *p, int count)
 {
 	struct zapi_route api;
 
@@ -208,8 +384,8 @@ void route_delete(struct prefix *p)
 	api.vrf_id = VRF_DEFAULT;
 	api.type = ZEBRA_ROUTE_SHARP;
 	api.safi = SAFI_UNICAST;
-	memcpy(&api.prefix, p, sizeof(*p));
-	zclient_route_send(ZEBRA_ROUTE_DELETE, zclient, &api);
+	zclient_route_bulk_send(ZEBRA_ROUTE_DELETE_BULK, zclient, &api, p,
+				count);
 
 	return;
 }
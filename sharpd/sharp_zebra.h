@@ -25,7 +25,17 @@
 extern void sharp_zebra_init(void);
 
 extern void vrf_label_add(vrf_id_t vrf_id, afi_t afi, mpls_label_t label);
-extern void route_add(struct prefix *p, struct nexthop *nh);
-extern void route_delete(struct prefix *p);
+extern void route_add(struct prefix *p, int count, struct nexthop *nh,
+		      int nh_num);
+extern void route_delete(struct prefix *p, int count);
 extern void sharp_zebra_nexthop_watch(struct prefix *p, bool watch);
+
+/*
+ * Time a run of "install routes" or "remove routes" until zebra has
+ * notified every route, routes being numbered from the start address.
+ */
+extern void sharp_bench_start(bool install, struct in_addr start,
+			      uint32_t total, uint32_t ecmp, uint32_t fanout);
+extern void sharp_bench_sent(uint32_t route);
+extern void sharp_bench_show(struct vty *vty);
 #endif
@@ -291,10 +291,14 @@ testcase_t test_bgp_mp_list = {
  */
 
 struct bgp_node test_rn;
+struct bgp_table *test_table;
 
 static int setup_bgp_info_mpath_update(testcase_t *t)
 {
 	int i;
+	/* paths are listed per peer and afi/safi of their node's table */
+	test_table = bgp_table_init(NULL, AFI_IP, SAFI_UNICAST);
+	test_rn.table = test_table->route_table;
 	str2prefix("42.1.1.0/24", &test_rn.p);
 	setup_bgp_mp_list(t);
 	for (i = 0; i < test_mp_list_info_count; i++)
@@ -347,6 +351,7 @@ static int cleanup_bgp_info_mpath_update(testcase_t *t)
 
 	for (i = 0; i < test_mp_list_peer_count; i++)
 		sockunion_free(test_mp_list_peer[i].su_remote);
+	bgp_table_unlock(test_table);
 
 	return 0;
 }
@@ -101,6 +101,7 @@ static int test(FILE *input, FILE *output)
 	stream_set_getp(s, 0);
 	struct isis_tlvs *tlvs;
 	const char *log;
+	bool wellformed = isis_tlv_view_wellformed(s, STREAM_READABLE(s));
 	int rv = isis_unpack_tlvs(STREAM_READABLE(s), s, &tlvs, &log);
 
 	if (rv) {
@@ -110,6 +111,9 @@ static int test(FILE *input, FILE *output)
 		return 2;
 	}
 
+	/* What unpacks must also be walkable in place */
+	assert(wellformed);
+
 	fprintf(output, "Unpack log:\n%s", log);
 	const char *s_tlvs = isis_format_tlvs(tlvs);
 	fprintf(output, "Unpacked TLVs:\n%s", s_tlvs);
@@ -125,6 +129,7 @@ static int test(FILE *input, FILE *output)
 	}
 
 	stream_set_getp(s2, 0);
+	assert(isis_tlv_view_wellformed(s2, STREAM_READABLE(s2)));
 	rv = isis_unpack_tlvs(STREAM_READABLE(s2), s2, &tlvs, &log);
 	if (rv) {
 		fprintf(output, "Could not unpack own TLVs:\n%s\n", log);
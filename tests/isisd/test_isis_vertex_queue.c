@@ -2,6 +2,8 @@
 
 #include "isisd/isis_spf.c"
 
+#include "prng.h"
+
 struct thread_master *master;
 int isis_sock_init(struct isis_circuit *circuit);
 int isis_sock_init(struct isis_circuit *circuit)
@@ -26,33 +28,33 @@ static void setup_test_vertices(void)
 	p.family = AF_INET;
 	p.prefixlen = 24;
 	inet_pton(AF_INET, "192.168.1.0", &p.u.prefix4);
-	vertices[vertex_count] = isis_vertex_new(&p, VTYPE_IPREACH_TE);
+	vertices[vertex_count] = isis_vertex_new(NULL, &p, VTYPE_IPREACH_TE);
 	vertices[vertex_count]->d_N = 20;
 	vertex_count++;
 
 	p.family = AF_INET;
 	p.prefixlen = 24;
 	inet_pton(AF_INET, "192.168.2.0", &p.u.prefix4);
-	vertices[vertex_count] = isis_vertex_new(&p, VTYPE_IPREACH_TE);
+	vertices[vertex_count] = isis_vertex_new(NULL, &p, VTYPE_IPREACH_TE);
 	vertices[vertex_count]->d_N = 20;
 	vertex_count++;
 
 	memset(node_id, 0, sizeof(node_id));
 	node_id[6] = 1;
-	vertices[vertex_count] = isis_vertex_new(node_id, VTYPE_PSEUDO_TE_IS);
+	vertices[vertex_count] = isis_vertex_new(NULL, node_id, VTYPE_PSEUDO_TE_IS);
 	vertices[vertex_count]->d_N = 15;
 	vertex_count++;
 
 	memset(node_id, 0, sizeof(node_id));
 	node_id[5] = 2;
-	vertices[vertex_count] = isis_vertex_new(node_id, VTYPE_NONPSEUDO_TE_IS);
+	vertices[vertex_count] = isis_vertex_new(NULL, node_id, VTYPE_NONPSEUDO_TE_IS);
 	vertices[vertex_count]->d_N = 15;
 	vertex_count++;
 
 	p.family = AF_INET;
 	p.prefixlen = 24;
 	inet_pton(AF_INET, "192.168.3.0", &p.u.prefix4);
-	vertices[vertex_count] = isis_vertex_new(&p, VTYPE_IPREACH_TE);
+	vertices[vertex_count] = isis_vertex_new(NULL, &p, VTYPE_IPREACH_TE);
 	vertices[vertex_count]->d_N = 20;
 	vertex_count++;
 };
@@ -60,7 +62,7 @@ static void setup_test_vertices(void)
 static void cleanup_test_vertices(void)
 {
 	for (size_t i = 0; i < vertex_count; i++)
-		isis_vertex_del(vertices[i]);
+		isis_vertex_del(NULL, vertices[i]);
 	XFREE(MTYPE_TMP, vertices);
 	vertex_count = 0;
 }
@@ -69,7 +71,7 @@ static void test_ordered(void)
 {
 	struct isis_vertex_queue q;
 
-	isis_vertex_queue_init(&q, NULL, true);
+	isis_vertex_queue_init(&q, NULL, NULL, true);
 	for (size_t i = 0; i < vertex_count; i++)
 		isis_vertex_queue_insert(&q, vertices[i]);
 
@@ -100,11 +102,177 @@ static void test_ordered(void)
 	isis_vertex_queue_free(&q);
 }
 
+/* Routers on a square grid, each linked to its neighbours with random
+ * metrics, for Dijkstra to run on the way SPF uses the queues: TENT and
+ * the SPT sharing the index and the spare vertices.
+ */
+#define GRID_SIZE 100
+#define GRID_RUNS 10
+
+static unsigned int grid = GRID_SIZE;
+static uint32_t *metric_right, *metric_down;
+
+static void grid_node_id(unsigned int r, uint8_t *node_id)
+{
+	memset(node_id, 0, ISIS_SYS_ID_LEN + 1);
+	node_id[3] = r >> 16;
+	node_id[4] = r >> 8;
+	node_id[5] = r;
+}
+
+static void grid_relax(struct isis_vertex_queue *tents,
+		       struct isis_vertex_queue *paths, struct hash *hash,
+		       struct isis_vertex **spare, unsigned int r,
+		       uint32_t dist)
+{
+	uint8_t node_id[ISIS_SYS_ID_LEN + 1];
+	struct isis_vertex *vertex;
+
+	grid_node_id(r, node_id);
+	vertex = isis_lookup_vertex(hash, node_id, VTYPE_NONPSEUDO_TE_IS);
+	if (vertex) {
+		if (vertex->queue == paths || vertex->d_N <= dist)
+			return;
+		isis_vertex_queue_delete(tents, vertex);
+		isis_vertex_del(spare, vertex);
+	}
+
+	vertex = isis_vertex_new(spare, node_id, VTYPE_NONPSEUDO_TE_IS);
+	vertex->d_N = dist;
+	isis_vertex_queue_insert(tents, vertex);
+}
+
+static void grid_spf(struct isis_vertex_queue *tents,
+		     struct isis_vertex_queue *paths, struct hash *hash,
+		     struct isis_vertex **spare)
+{
+	struct isis_vertex *vertex;
+	unsigned int r, x, y;
+
+	grid_relax(tents, paths, hash, spare, 0, 0);
+	while ((vertex = isis_vertex_queue_pop(tents))) {
+		isis_vertex_queue_append(paths, vertex);
+
+		r = (vertex->N.id[3] << 16) | (vertex->N.id[4] << 8)
+		    | vertex->N.id[5];
+		x = r % grid;
+		y = r / grid;
+		if (x + 1 < grid)
+			grid_relax(tents, paths, hash, spare, r + 1,
+				   vertex->d_N + metric_right[r]);
+		if (y + 1 < grid)
+			grid_relax(tents, paths, hash, spare, r + grid,
+				   vertex->d_N + metric_down[r]);
+		if (x > 0)
+			grid_relax(tents, paths, hash, spare, r - 1,
+				   vertex->d_N + metric_right[r - 1]);
+		if (y > 0)
+			grid_relax(tents, paths, hash, spare, r - grid,
+				   vertex->d_N + metric_down[r - grid]);
+	}
+}
+
+/* Every link must be relaxed and every router but the root reached by
+ * a link on a shortest path.
+ */
+static unsigned int grid_check(uint32_t *d)
+{
+	unsigned int r, x, y, errors = 0;
+	bool tight;
+
+	for (r = 0; r < grid * grid; r++) {
+		x = r % grid;
+		y = r / grid;
+		tight = (r == 0 && d[r] == 0);
+
+		if (x + 1 < grid && (d[r + 1] > d[r] + metric_right[r]
+				     || d[r] > d[r + 1] + metric_right[r]))
+			errors++;
+		if (y + 1 < grid && (d[r + grid] > d[r] + metric_down[r]
+				     || d[r] > d[r + grid] + metric_down[r]))
+			errors++;
+
+		if (x + 1 < grid && d[r] == d[r + 1] + metric_right[r])
+			tight = true;
+		if (y + 1 < grid && d[r] == d[r + grid] + metric_down[r])
+			tight = true;
+		if (x > 0 && d[r] == d[r - 1] + metric_right[r - 1])
+			tight = true;
+		if (y > 0 && d[r] == d[r - grid] + metric_down[r - grid])
+			tight = true;
+		if (!tight)
+			errors++;
+	}
+
+	return errors;
+}
+
+static void test_grid(void)
+{
+	struct isis_vertex *spare = NULL, *vertex;
+	struct isis_vertex_queue tents, paths;
+	unsigned int r, i, count = grid * grid;
+	uint8_t node_id[ISIS_SYS_ID_LEN + 1];
+	struct timeval tv_start;
+	struct prng *prng;
+	struct hash *hash;
+	uint32_t *d;
+
+	prng = prng_new(0);
+	metric_right = XCALLOC(MTYPE_TMP, count * sizeof(uint32_t));
+	metric_down = XCALLOC(MTYPE_TMP, count * sizeof(uint32_t));
+	for (r = 0; r < count; r++) {
+		metric_right[r] = 1 + prng_rand(prng) % 63;
+		metric_down[r] = 1 + prng_rand(prng) % 63;
+	}
+
+	hash = isis_vertex_queue_hash("IS-IS test vertices");
+	isis_vertex_queue_init(&tents, hash, &spare, true);
+	isis_vertex_queue_init(&paths, hash, &spare, false);
+
+	monotime(&tv_start);
+	for (i = 0; i < GRID_RUNS; i++) {
+		isis_vertex_queue_clear(&paths);
+		grid_spf(&tents, &paths, hash, &spare);
+	}
+	printf("Dijkstra on %u routers took %lu usecs\n", count,
+	       (unsigned long)monotime_since(&tv_start, NULL) / GRID_RUNS);
+
+	assert(isis_vertex_queue_count(&tents) == 0);
+	assert(isis_vertex_queue_count(&paths) == count);
+
+	d = XCALLOC(MTYPE_TMP, count * sizeof(uint32_t));
+	for (r = 0; r < count; r++) {
+		grid_node_id(r, node_id);
+		assert(isis_find_vertex(&tents, node_id, VTYPE_NONPSEUDO_TE_IS)
+		       == NULL);
+		vertex = isis_find_vertex(&paths, node_id,
+					  VTYPE_NONPSEUDO_TE_IS);
+		assert(vertex);
+		d[r] = vertex->d_N;
+	}
+	assert(grid_check(d) == 0);
+
+	isis_vertex_queue_free(&tents);
+	isis_vertex_queue_free(&paths);
+	hash_free(hash);
+	while ((vertex = spare)) {
+		spare = vertex->next_spare;
+		isis_vertex_del(NULL, vertex);
+	}
+
+	XFREE(MTYPE_TMP, d);
+	XFREE(MTYPE_TMP, metric_right);
+	XFREE(MTYPE_TMP, metric_down);
+	prng_free(prng);
+}
+
 int main(int argc, char **argv)
 {
 	setup_test_vertices();
 	test_ordered();
 	cleanup_test_vertices();
+	test_grid();
 
 	return 0;
 }
@@ -0,0 +1,458 @@
+/*
+ * Microbenchmarks of lib hot paths
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Run by "make bench".  Each benchmark prints one JSON object per line,
+ *
+ *   {"bench": "table_insert", "ops": 1000000, "nsec": 412345678,
+ *    "nsec_per_op": 412.35}
+ *
+ * so results can be collected and compared between releases.  Inputs come
+ * from a fixed seed and are the same on every run.  Benchmarks whose name
+ * does not start with one of the arguments, if any, are skipped.
+ */
+
+#include <zebra.h>
+
+#include "checksum.h"
+#include "command.h"
+#include "hash.h"
+#include "jhash.h"
+#include "memory.h"
+#include "plist.h"
+#include "prefix.h"
+#include "routemap.h"
+#include "stream.h"
+#include "table.h"
+#include "thread.h"
+#include "vty.h"
+
+#include "prng.h"
+
+#define NPREFIXES 1000000
+#define NKEYS 1000000
+#define NRECORDS 1000000
+#define NEVENTS 1000000
+#define NTIMERS 1000000
+#define NPLIST_ENTRIES 1000
+#define NAPPLIES 1000000
+#define NCKSUMS 200000
+#define CKSUM_LEN 1500
+
+struct thread_master *master;
+
+static struct prng *prng;
+static int nfilters;
+static char **filters;
+
+struct bench {
+	const char *name;
+	struct timespec start;
+};
+
+static bool bench_start(struct bench *b, const char *name)
+{
+	int i;
+
+	for (i = 0; i < nfilters; i++)
+		if (!strncmp(name, filters[i], strlen(filters[i])))
+			break;
+	if (nfilters && i == nfilters)
+		return false;
+
+	b->name = name;
+	clock_gettime(CLOCK_MONOTONIC, &b->start);
+	return true;
+}
+
+static void bench_stop(struct bench *b, unsigned long ops)
+{
+	struct timespec stop;
+	int64_t nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	nsec = (stop.tv_sec - b->start.tv_sec) * 1000000000LL
+	       + (stop.tv_nsec - b->start.tv_nsec);
+
+	printf("{\"bench\": \"%s\", \"ops\": %lu, \"nsec\": %" PRId64
+	       ", \"nsec_per_op\": %.2f}\n",
+	       b->name, ops, nsec, ops ? (double)nsec / ops : 0.0);
+	fflush(stdout);
+}
+
+static void random_prefix_ipv4(struct prefix_ipv4 *p, int minlen)
+{
+	memset(p, 0, sizeof(*p));
+	p->family = AF_INET;
+	p->prefixlen = minlen + prng_rand(prng) % (IPV4_MAX_BITLEN - minlen + 1);
+	p->prefix.s_addr = htonl(prng_rand(prng));
+	apply_mask_ipv4(p);
+}
+
+/* route_node_get/lookup/match and route_next on a table of 1M prefixes */
+static void bench_table(void)
+{
+	struct prefix_ipv4 *prefixes;
+	struct route_table *table;
+	struct route_node *rn;
+	struct bench b;
+	unsigned long n;
+	int i;
+
+	prefixes = XCALLOC(MTYPE_TMP, NPREFIXES * sizeof(*prefixes));
+	for (i = 0; i < NPREFIXES; i++)
+		random_prefix_ipv4(&prefixes[i], 8);
+
+	table = route_table_init();
+	if (bench_start(&b, "table_insert")) {
+		for (i = 0; i < NPREFIXES; i++)
+			route_node_get(table, (struct prefix *)&prefixes[i]);
+		bench_stop(&b, NPREFIXES);
+	} else
+		for (i = 0; i < NPREFIXES; i++)
+			route_node_get(table, (struct prefix *)&prefixes[i]);
+
+	if (bench_start(&b, "table_lookup")) {
+		for (i = 0; i < NPREFIXES; i++) {
+			rn = route_node_lookup(table,
+					       (struct prefix *)&prefixes[i]);
+			route_unlock_node(rn);
+		}
+		bench_stop(&b, NPREFIXES);
+	}
+
+	for (i = 0; i < NPREFIXES; i++)
+		random_prefix_ipv4(&prefixes[i], IPV4_MAX_BITLEN);
+	if (bench_start(&b, "table_match")) {
+		for (i = 0; i < NPREFIXES; i++) {
+			rn = route_node_match(table,
+					      (struct prefix *)&prefixes[i]);
+			if (rn)
+				route_unlock_node(rn);
+		}
+		bench_stop(&b, NPREFIXES);
+	}
+
+	if (bench_start(&b, "table_iterate")) {
+		n = 0;
+		for (rn = route_top(table); rn; rn = route_next(rn))
+			n++;
+		bench_stop(&b, n);
+	}
+
+	route_table_finish(table);
+	XFREE(MTYPE_TMP, prefixes);
+}
+
+static unsigned int bench_hash_key(void *arg)
+{
+	return jhash_1word(*(uint32_t *)arg, 0);
+}
+
+static int bench_hash_cmp(const void *a, const void *b)
+{
+	return *(const uint32_t *)a == *(const uint32_t *)b;
+}
+
+/* hash_get/lookup/release of 1M keys */
+static void bench_hash(void)
+{
+	struct hash *hash;
+	struct bench b;
+	uint32_t *keys;
+	int i;
+
+	keys = XCALLOC(MTYPE_TMP, NKEYS * sizeof(*keys));
+	for (i = 0; i < NKEYS; i++)
+		keys[i] = prng_rand(prng);
+
+	hash = hash_create(bench_hash_key, bench_hash_cmp, "bench");
+	if (bench_start(&b, "hash_insert")) {
+		for (i = 0; i < NKEYS; i++)
+			hash_get(hash, &keys[i], hash_alloc_intern);
+		bench_stop(&b, NKEYS);
+	} else
+		for (i = 0; i < NKEYS; i++)
+			hash_get(hash, &keys[i], hash_alloc_intern);
+
+	if (bench_start(&b, "hash_lookup")) {
+		for (i = 0; i < NKEYS; i++)
+			hash_lookup(hash, &keys[i]);
+		bench_stop(&b, NKEYS);
+	}
+
+	if (bench_start(&b, "hash_release")) {
+		for (i = 0; i < NKEYS; i++)
+			hash_release(hash, &keys[i]);
+		bench_stop(&b, NKEYS);
+	}
+
+	hash_clean(hash, NULL);
+	hash_free(hash);
+	XFREE(MTYPE_TMP, keys);
+}
+
+/* records of a prefix and a few attributes, as in zapi route messages */
+static void bench_stream(void)
+{
+	struct prefix_ipv4 p;
+	struct stream *s;
+	struct bench b;
+	uint8_t buf[16];
+	size_t endp;
+	int i, n;
+
+	s = stream_new(4096);
+	random_prefix_ipv4(&p, 8);
+
+	if (bench_start(&b, "stream_encode")) {
+		for (i = 0; i < NRECORDS; i++) {
+			if (STREAM_WRITEABLE(s) < 32)
+				stream_reset(s);
+			stream_putl(s, i);
+			stream_putw(s, 0x1234);
+			stream_putc(s, 20);
+			stream_put_prefix(s, (struct prefix *)&p);
+			stream_putl(s, 100);
+		}
+		bench_stop(&b, NRECORDS);
+	}
+
+	stream_reset(s);
+	while (STREAM_WRITEABLE(s) >= 32) {
+		stream_putl(s, 0);
+		stream_putw(s, 0x1234);
+		stream_putc(s, 20);
+		stream_put_prefix(s, (struct prefix *)&p);
+		stream_putl(s, 100);
+	}
+	endp = stream_get_endp(s);
+
+	if (bench_start(&b, "stream_decode")) {
+		for (i = 0; i < NRECORDS; i++) {
+			if (stream_get_getp(s) >= endp)
+				stream_set_getp(s, 0);
+			stream_getl(s);
+			stream_getw(s);
+			stream_getc(s);
+			n = stream_getc(s);
+			stream_get(buf, s, PSIZE(n));
+			stream_getl(s);
+		}
+		bench_stop(&b, NRECORDS);
+	}
+
+	stream_free(s);
+}
+
+static int bench_thread_func(struct thread *thread)
+{
+	return 0;
+}
+
+/* event dispatch and timer add/cancel on a thread_master */
+static void bench_thread(void)
+{
+	struct thread **timers;
+	struct thread thread;
+	struct bench b;
+	int i, j;
+
+	if (bench_start(&b, "thread_event")) {
+		for (i = 0; i < NEVENTS; i += 1000) {
+			for (j = 0; j < 1000; j++)
+				thread_add_event(master, bench_thread_func,
+						 NULL, j, NULL);
+			for (j = 0; j < 1000; j++)
+				if (thread_fetch(master, &thread))
+					thread_call(&thread);
+		}
+		bench_stop(&b, NEVENTS);
+	}
+
+	timers = XCALLOC(MTYPE_TMP, NTIMERS * sizeof(*timers));
+	if (bench_start(&b, "thread_timer")) {
+		for (i = 0; i < NTIMERS; i++)
+			thread_add_timer_msec(
+				master, bench_thread_func, NULL,
+				1000000 + prng_rand(prng) % 1000000,
+				&timers[i]);
+		for (i = 0; i < NTIMERS; i++)
+			thread_cancel(timers[i]);
+		bench_stop(&b, NTIMERS);
+	}
+	XFREE(MTYPE_TMP, timers);
+}
+
+/* prefix_list_apply() on a list of 1000 entries with ge/le ranges */
+static void bench_plist(void)
+{
+	char name[] = "bench";
+	struct prefix_list *plist;
+	struct prefix_ipv4 p;
+	struct orf_prefix o;
+	struct bench b;
+	int i;
+
+	for (i = 0; i < NPLIST_ENTRIES; i++) {
+		memset(&o, 0, sizeof(o));
+		o.seq = (i + 1) * 5;
+		random_prefix_ipv4((struct prefix_ipv4 *)&o.p, 8);
+		if (o.p.prefixlen < 24)
+			o.le = 24;
+		prefix_bgp_orf_set(name, AFI_IP, &o, prng_rand(prng) % 2, 1);
+	}
+	plist = prefix_bgp_orf_lookup(AFI_IP, name);
+
+	if (plist && bench_start(&b, "plist_apply")) {
+		for (i = 0; i < NAPPLIES; i++) {
+			random_prefix_ipv4(&p, 8);
+			prefix_list_apply(plist, &p);
+		}
+		bench_stop(&b, NAPPLIES);
+	}
+
+	prefix_bgp_orf_remove_all(AFI_IP, name);
+}
+
+static route_map_result_t bench_match_tag(void *rule, struct prefix *prefix,
+					  route_map_object_t type,
+					  void *object)
+{
+	return *(uint32_t *)rule == *(uint32_t *)object ? RMAP_MATCH
+							 : RMAP_NOMATCH;
+}
+
+static void *bench_match_tag_compile(const char *arg)
+{
+	uint32_t *tag = XMALLOC(MTYPE_ROUTE_MAP_COMPILED, sizeof(*tag));
+
+	*tag = strtoul(arg, NULL, 10);
+	return tag;
+}
+
+static void bench_match_tag_free(void *rule)
+{
+	XFREE(MTYPE_ROUTE_MAP_COMPILED, rule);
+}
+
+static struct route_map_rule_cmd bench_match_tag_cmd = {
+	"tag", bench_match_tag, bench_match_tag_compile, bench_match_tag_free,
+	RMAP_CACHE_OBJECT,
+};
+
+/* route_map_apply() on a map of 10 "match tag" entries, configured as
+ * a daemon would */
+static void bench_routemap(void)
+{
+	static const char *const config[] = {
+		"route-map bench deny 10",   "match tag 1",
+		"route-map bench deny 20",   "match tag 2",
+		"route-map bench deny 30",   "match tag 3",
+		"route-map bench deny 40",   "match tag 4",
+		"route-map bench deny 50",   "match tag 5",
+		"route-map bench permit 60", "match tag 6",
+		"route-map bench permit 70", "match tag 7",
+		"route-map bench permit 80", "match tag 8",
+		"route-map bench permit 90", "match tag 9",
+		"route-map bench permit 100",
+	};
+	struct route_map *map;
+	struct prefix_ipv4 p;
+	struct vty *vty;
+	struct bench b;
+	uint32_t tag;
+	vector vline;
+	unsigned int i;
+
+	route_map_init();
+	route_map_match_tag_hook(generic_match_add);
+	route_map_install_match(&bench_match_tag_cmd);
+
+	vty = vty_new();
+	vty->node = CONFIG_NODE;
+	for (i = 0; i < array_size(config); i++) {
+		if (!strncmp(config[i], "route-map", 9))
+			vty->node = CONFIG_NODE;
+		vline = cmd_make_strvec(config[i]);
+		cmd_execute_command(vline, vty, NULL, 0);
+		cmd_free_strvec(vline);
+	}
+	vty_close(vty);
+
+	map = route_map_lookup_by_name("bench");
+	if (map && bench_start(&b, "routemap_apply")) {
+		for (i = 0; i < NAPPLIES; i++) {
+			random_prefix_ipv4(&p, 8);
+			tag = 1 + prng_rand(prng) % 12;
+			route_map_apply(map, (struct prefix *)&p, RMAP_ZEBRA,
+					&tag);
+		}
+		bench_stop(&b, NAPPLIES);
+	}
+
+	route_map_finish();
+}
+
+/* IP and Fletcher checksums over MTU sized buffers */
+static void bench_cksum(void)
+{
+	uint8_t *buf;
+	struct bench b;
+	int i;
+
+	buf = XMALLOC(MTYPE_TMP, CKSUM_LEN);
+	for (i = 0; i < CKSUM_LEN; i++)
+		buf[i] = prng_rand(prng);
+
+	if (bench_start(&b, "cksum_in")) {
+		for (i = 0; i < NCKSUMS; i++)
+			in_cksum(buf, CKSUM_LEN);
+		bench_stop(&b, NCKSUMS);
+	}
+	if (bench_start(&b, "cksum_fletcher")) {
+		for (i = 0; i < NCKSUMS; i++)
+			fletcher_checksum(buf, CKSUM_LEN,
+					  FLETCHER_CHECKSUM_VALIDATE);
+		bench_stop(&b, NCKSUMS);
+	}
+
+	XFREE(MTYPE_TMP, buf);
+}
+
+int main(int argc, char **argv)
+{
+	nfilters = argc - 1;
+	filters = argv + 1;
+
+	prng = prng_new(0);
+	master = thread_master_create(NULL);
+	cmd_init(1);
+
+	bench_table();
+	bench_hash();
+	bench_stream();
+	bench_thread();
+	bench_plist();
+	bench_routemap();
+	bench_cksum();
+
+	thread_master_free(master);
+	prng_free(prng);
+	return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ * Concurrent hash test and benchmark.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include "memory.h"
+#include "monotime.h"
+#include "chash.h"
+
+DEFINE_MGROUP(TEST_CHASH, "chash test")
+DEFINE_MTYPE_STATIC(TEST_CHASH, ITEM, "chash test item")
+
+#define MAXTHREADS 64
+#define NITEMS 100000
+/* lookups per insertion, as with read-mostly tables */
+#define NLOOKUPS 8
+
+struct item {
+	uint32_t id;
+};
+
+static unsigned int nthreads = 4;
+static struct chash *chash;
+
+/* baseline: one table behind one mutex */
+static struct hash *hash;
+static pthread_mutex_t hash_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int item_key(void *arg)
+{
+	return ((struct item *)arg)->id;
+}
+
+static int item_cmp(const void *a, const void *b)
+{
+	return ((const struct item *)a)->id == ((const struct item *)b)->id;
+}
+
+static void *item_check(void *entry, void *arg)
+{
+	assert(entry == arg);
+	return entry;
+}
+
+static void *chash_worker(void *arg)
+{
+	uint32_t base = (uintptr_t)arg * NITEMS;
+	struct item *items, key;
+	unsigned int i, j;
+	void *rv;
+
+	items = XCALLOC(MTYPE_ITEM, NITEMS * sizeof(*items));
+	for (i = 0; i < NITEMS; i++) {
+		items[i].id = base + i;
+		rv = chash_get(chash, &items[i], hash_alloc_intern);
+		assert(rv == &items[i]);
+		for (j = 0; j < NLOOKUPS; j++) {
+			key.id = base + (i * 7 + j) % (i + 1);
+			rv = chash_lookup(chash, &key);
+			assert(rv == &items[key.id - base]);
+		}
+	}
+
+	key.id = base;
+	rv = chash_lookup_apply(chash, &key, item_check, &items[0]);
+	assert(rv == &items[0]);
+
+	for (i = 0; i < NITEMS; i++) {
+		rv = chash_release(chash, &items[i]);
+		assert(rv == &items[i]);
+	}
+	rv = chash_lookup(chash, &key);
+	assert(!rv);
+
+	XFREE(MTYPE_ITEM, items);
+	return NULL;
+}
+
+static void *hash_worker(void *arg)
+{
+	uint32_t base = (uintptr_t)arg * NITEMS;
+	struct item *items, key;
+	unsigned int i, j;
+	void *rv;
+
+	items = XCALLOC(MTYPE_ITEM, NITEMS * sizeof(*items));
+	for (i = 0; i < NITEMS; i++) {
+		items[i].id = base + i;
+		pthread_mutex_lock(&hash_mtx);
+		rv = hash_get(hash, &items[i], hash_alloc_intern);
+		pthread_mutex_unlock(&hash_mtx);
+		assert(rv == &items[i]);
+		for (j = 0; j < NLOOKUPS; j++) {
+			key.id = base + (i * 7 + j) % (i + 1);
+			pthread_mutex_lock(&hash_mtx);
+			rv = hash_lookup(hash, &key);
+			pthread_mutex_unlock(&hash_mtx);
+			assert(rv == &items[key.id - base]);
+		}
+	}
+
+	for (i = 0; i < NITEMS; i++) {
+		pthread_mutex_lock(&hash_mtx);
+		rv = hash_release(hash, &items[i]);
+		pthread_mutex_unlock(&hash_mtx);
+		assert(rv == &items[i]);
+	}
+
+	XFREE(MTYPE_ITEM, items);
+	return NULL;
+}
+
+static void run(const char *what, void *(*worker)(void *))
+{
+	pthread_t threads[MAXTHREADS];
+	struct timeval start;
+	uintptr_t i;
+	int64_t usecs;
+
+	monotime(&start);
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&threads[i], NULL, worker, (void *)i);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	usecs = monotime_since(&start, NULL);
+
+	printf("%-16s %u pthreads: %8lld us, %6.1f ns/op\n", what, nthreads,
+	       (long long)usecs,
+	       usecs * 1000.0 / (nthreads * NITEMS * (NLOOKUPS + 2)));
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		nthreads = strtoul(argv[1], NULL, 10);
+	if (!nthreads || nthreads > MAXTHREADS) {
+		fprintf(stderr, "usage: %s [pthreads, 1-%d]\n", argv[0],
+			MAXTHREADS);
+		return 1;
+	}
+
+	chash = chash_create(item_key, item_cmp, NULL);
+	hash = hash_create(item_key, item_cmp, NULL);
+
+	run("chash", chash_worker);
+	assert(chash_count(chash) == 0);
+	run("hash + mutex", hash_worker);
+	assert(hashcount(hash) == 0);
+
+	chash_free(chash);
+	hash_free(hash);
+	return 0;
+}
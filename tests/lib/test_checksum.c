@@ -23,6 +23,7 @@
 #include <time.h>
 
 #include "checksum.h"
+#include "memory.h"
 
 struct thread_master *master;
 
@@ -459,6 +460,69 @@ static int /* return checksum in low-order 16 bits */
 }
 
 
+/* every implementation the library may have */
+static const char *const impls[] = {"generic", "ssse3", "avx2", "neon"};
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Checksums of so many bytes in all, over buffers of each size. */
+#define BENCH_TOTAL (64U << 20)
+
+static void bench(void)
+{
+	static const size_t sizes[] = {64, 1500, 60000};
+	static uint8_t buf[60000];
+	volatile uint16_t sink;
+	unsigned int s, i, n, rounds;
+	double start;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = random();
+
+	printf("%-10s %8s %12s %12s\n", "", "bytes", "fletcher", "in_cksum");
+	for (s = 0; s < array_size(sizes); s++) {
+		rounds = BENCH_TOTAL / sizes[s];
+
+		start = bench_now();
+		for (n = 0; n < rounds; n++)
+			sink = ospfd_checksum(buf, sizes[s], 0);
+		printf("%-10s %8zu %9.2f ns", "bytewise", sizes[s],
+		       (bench_now() - start) * 1e9 / rounds);
+		start = bench_now();
+		for (n = 0; n < rounds; n++)
+			sink = in_cksum_rfc(buf, sizes[s]);
+		printf(" %9.2f ns\n", (bench_now() - start) * 1e9 / rounds);
+
+		for (i = 0; i < array_size(impls); i++) {
+			if (!checksum_impl_set(impls[i]))
+				continue;
+
+			start = bench_now();
+			for (n = 0; n < rounds; n++)
+				sink = fletcher_checksum(buf, sizes[s], 0);
+			printf("%-10s %8zu %9.2f ns", impls[i], sizes[s],
+			       (bench_now() - start) * 1e9 / rounds);
+			start = bench_now();
+			for (n = 0; n < rounds; n++)
+				sink = in_cksum(buf, sizes[s]);
+			printf(" %9.2f ns\n",
+			       (bench_now() - start) * 1e9 / rounds);
+		}
+	}
+	(void)sink;
+}
+
+/*
+ * Checks the library against the original implementations over random
+ * buffers, forever, going round its implementations; with "bench", times
+ * them all instead.
+ */
 int main(int argc, char **argv)
 {
 /* 60017 65629 702179 */
@@ -466,13 +530,24 @@ int main(int argc, char **argv)
 #define BUFSIZE MAXDATALEN + sizeof(uint16_t)
 	uint8_t buffer[BUFSIZE];
 	int exercise = 0;
+	unsigned int round = 0;
+	const char *impl;
 #define EXERCISESTEP 257
 	srandom(time(NULL));
 
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench();
+		return 0;
+	}
+
 	while (1) {
 		uint16_t ospfd, isisd, lib, in_csum, in_csum_res, in_csum_rfc;
 		int i, j;
 
+		impl = checksum_impl_set(impls[round++ % array_size(impls)]);
+		if (!impl)
+			impl = checksum_impl_set("generic");
+
 		exercise += EXERCISESTEP;
 		exercise %= MAXDATALEN;
 
@@ -489,8 +564,8 @@ int main(int argc, char **argv)
 		in_csum_rfc = in_cksum_rfc(buffer, exercise);
 		if (in_csum_res != in_csum || in_csum != in_csum_rfc)
 			printf("verify: in_chksum failed in_csum:%x, in_csum_res:%x,"
-			       "in_csum_rfc %x, len:%d\n",
-			       in_csum, in_csum_res, in_csum_rfc, exercise);
+			       "in_csum_rfc %x, len:%d, %s\n",
+			       in_csum, in_csum_res, in_csum_rfc, exercise, impl);
 
 		ospfd = ospfd_checksum(buffer, exercise + sizeof(uint16_t),
 				       exercise);
@@ -503,14 +578,14 @@ int main(int argc, char **argv)
 		lib = fletcher_checksum(buffer, exercise + sizeof(uint16_t),
 					exercise);
 		if (verify(buffer, exercise + sizeof(uint16_t)))
-			printf("verify: lib failed\n");
+			printf("verify: lib failed, %s\n", impl);
 
 		if (ospfd != lib) {
-			printf("Mismatch in values at size %u\n"
+			printf("Mismatch in values at size %u, %s\n"
 			       "ospfd: 0x%04x\tc0: %d\tc1: %d\tx: %d\ty: %d\n"
 			       "isisd: 0x%04x\tc0: %d\tc1: %d\tx: %d\ty: %d\n"
 			       "lib: 0x%04x\n",
-			       exercise, ospfd, ospfd_vals.a.c0,
+			       exercise, impl, ospfd, ospfd_vals.a.c0,
 			       ospfd_vals.a.c1, ospfd_vals.x, ospfd_vals.y,
 			       isisd, isisd_vals.a.c0, isisd_vals.a.c1,
 			       isisd_vals.x, isisd_vals.y, lib);
@@ -0,0 +1,141 @@
+/*
+ * Epoch-based reclamation tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include "memory.h"
+#include "epoch.h"
+
+DEFINE_MGROUP(TEST_EPOCH, "epoch test")
+DEFINE_MTYPE_STATIC(TEST_EPOCH, CONF, "epoch test config")
+
+#define NREADERS 3
+#define NVERSIONS 20000
+
+/* stands in for a peer's configuration, as read by an I/O pthread */
+struct conf {
+	uint64_t gen;
+	uint64_t check;
+};
+
+static struct conf *_Atomic current;
+static _Atomic bool done;
+static _Atomic unsigned int freed;
+
+static void conf_free(void *arg)
+{
+	struct conf *conf = arg;
+
+	/* poisoned, for a reader still at it to notice */
+	conf->check = 0;
+	XFREE(MTYPE_CONF, conf);
+	atomic_fetch_add_explicit(&freed, 1, memory_order_relaxed);
+}
+
+static void *reader(void *arg)
+{
+	struct conf *conf;
+	uint64_t last = 0;
+	unsigned long reads = 0;
+
+	epoch_thread_register();
+	while (!atomic_load_explicit(&done, memory_order_acquire)) {
+		epoch_enter();
+		conf = epoch_deref(&current);
+		assert(conf->check == conf->gen * 3);
+		/* versions only ever move forward */
+		assert(conf->gen >= last);
+		last = conf->gen;
+		/* nested sections change nothing */
+		epoch_enter();
+		assert(epoch_deref(&current)->gen >= last);
+		epoch_exit();
+		assert(conf->check == conf->gen * 3);
+		epoch_exit();
+		reads++;
+	}
+	epoch_thread_unregister();
+
+	assert(reads > 0);
+	return NULL;
+}
+
+static struct conf *conf_new(uint64_t gen)
+{
+	struct conf *conf = XMALLOC(MTYPE_CONF, sizeof(*conf));
+
+	conf->gen = gen;
+	conf->check = gen * 3;
+	return conf;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[NREADERS];
+	struct conf *old, *conf;
+	unsigned int i;
+
+	epoch_init(NULL);
+
+	printf("Single pthread...\n");
+	conf = conf_new(0);
+	epoch_enter();
+	epoch_retire(conf, conf_free);
+	/* still in a read section from before it was retired */
+	assert(epoch_reclaim() == 0);
+	assert(freed == 0);
+	epoch_exit();
+	assert(epoch_reclaim() == 1);
+	assert(freed == 1);
+	epoch_retire(NULL, conf_free);
+	assert(epoch_reclaim() == 0);
+
+	printf("Readers...\n");
+	freed = 0;
+	epoch_publish(&current, conf_new(0));
+	for (i = 0; i < NREADERS; i++)
+		pthread_create(&threads[i], NULL, reader, NULL);
+
+	for (i = 1; i <= NVERSIONS; i++) {
+		old = epoch_deref(&current);
+		epoch_publish(&current, conf_new(i));
+		epoch_retire(old, conf_free);
+		if (i % 64 == 0)
+			epoch_reclaim();
+		if (i % 1000 == 0) {
+			epoch_synchronize();
+			sched_yield();
+		}
+	}
+
+	atomic_store_explicit(&done, true, memory_order_release);
+	for (i = 0; i < NREADERS; i++)
+		pthread_join(threads[i], NULL);
+
+	epoch_synchronize();
+	epoch_reclaim();
+	assert(freed == NVERSIONS);
+
+	epoch_retire(epoch_deref(&current), conf_free);
+	epoch_finish();
+	assert(freed == NVERSIONS + 1);
+	assert(mtype_stats_alloc(MTYPE_CONF) == 0);
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestEpoch(frrtest.TestMultiOut):
+    program = './test_epoch'
+
+TestEpoch.exit_cleanly()
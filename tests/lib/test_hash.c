@@ -0,0 +1,130 @@
+/*
+ * Hash table tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "hash.h"
+
+#define NITEMS 50000
+#define NOPS 400000
+
+struct item {
+	unsigned int val;
+	int present;
+	int seen;
+};
+
+static struct item items[NITEMS];
+
+static unsigned int item_key(void *arg)
+{
+	struct item *item = arg;
+
+	/* poor on purpose, so that chains get long */
+	return item->val % 4099;
+}
+
+static int item_cmp(const void *a, const void *b)
+{
+	const struct item *i1 = a, *i2 = b;
+
+	return i1->val == i2->val;
+}
+
+static void item_seen(struct hash_backet *backet, void *arg)
+{
+	struct item *item = backet->data;
+
+	assert(item->present);
+	item->seen++;
+}
+
+static void test_hash(bool incremental)
+{
+	struct hash *hash;
+	struct item lookup;
+	unsigned long count = 0;
+	bool grown = false;
+	int i, n;
+
+	hash = hash_create(item_key, item_cmp, NULL);
+	hash->incremental = incremental;
+
+	for (i = 0; i < NITEMS; i++) {
+		items[i].val = i;
+		items[i].present = 0;
+	}
+
+	for (n = 0; n < NOPS; n++) {
+		i = random() % NITEMS;
+		lookup.val = i;
+
+		switch (random() % 3) {
+		case 0:
+			assert(hash_lookup(hash, &lookup)
+			       == (items[i].present ? &items[i] : NULL));
+			break;
+		case 1:
+			assert(hash_get(hash, &items[i], hash_alloc_intern)
+			       == &items[i]);
+			count += !items[i].present;
+			items[i].present = 1;
+			break;
+		case 2:
+			if (n % 4)
+				break;
+			assert(hash_release(hash, &lookup)
+			       == (items[i].present ? &items[i] : NULL));
+			count -= items[i].present;
+			items[i].present = 0;
+			break;
+		}
+
+		assert(hash->count == count);
+		if (hash->old_index) {
+			assert(incremental);
+			grown = true;
+		}
+	}
+	assert(grown == incremental);
+
+	for (i = 0; i < NITEMS; i++)
+		items[i].seen = 0;
+	hash_iterate(hash, item_seen, NULL);
+	assert(!hash->old_index);
+	for (i = 0; i < NITEMS; i++)
+		assert(items[i].seen == items[i].present);
+
+	printf("%lu entries in %u buckets\n", hash->count, hash->size);
+
+	hash_clean(hash, NULL);
+	assert(hash->count == 0);
+	hash_free(hash);
+}
+
+int main(int argc, char **argv)
+{
+	srandom(1);
+
+	printf("All at once...\n");
+	test_hash(false);
+	printf("Incremental...\n");
+	test_hash(true);
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestHash(frrtest.TestMultiOut):
+    program = './test_hash'
+
+TestHash.exit_cleanly()
@@ -0,0 +1,255 @@
+/*
+ * hashfn tests and benchmarks.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <math.h>
+#include "hashfn.h"
+#include "jhash.h"
+#include "memory.h"
+#include "prefix.h"
+
+/* Results are part of the API, they must never change. */
+static const struct {
+	const char *data;
+	uint64_t seed;
+	uint64_t hash;
+} vectors[] = {
+	{"", 0, 0x0409638ee2bde459ULL},
+	{"a", 0, 0x28d2053309d28531ULL},
+	{"abc", 0, 0x02a4f1d7cb516c72ULL},
+	{"message", 0, 0xaabad898b38cbc3dULL},
+	{"1234567890abcdef", 0, 0xb9a7d1fdd3876bc0ULL},
+	{"The quick brown fox jumps over the lazy dog", 0,
+	 0x6303b3bade45a571ULL},
+	{"The quick brown fox jumps over the lazy dog", 1,
+	 0xe9759017046e0ca3ULL},
+	{"The quick brown fox jumps over the lazy dog, "
+	 "and then over the lazy cat, the lazy cow and the lazy horse",
+	 0x55aa5a5a, 0x7ebbc6f740cd8faeULL},
+};
+
+/* deterministic data sets */
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return rng_state >> 33;
+}
+
+/* Keys shaped like those of the tables hashfn() is used for. */
+enum dataset { DS_PREFIX, DS_ASPATH, DS_COMMUNITY, DS_MAX };
+static const char *const ds_names[DS_MAX] = {"prefixes", "AS paths",
+					    "communities"};
+#define NKEYS 100000
+
+struct key {
+	uint8_t data[64];
+	size_t len;
+};
+static struct key keys[DS_MAX][NKEYS];
+
+static void make_keys(void)
+{
+	static const uint32_t transit[] = {174,  701,  1299, 2914, 3257, 3356,
+					   3491, 6453, 6461, 6762, 6939, 7018};
+	struct prefix p;
+	uint32_t as[16], com[8];
+	size_t n, j;
+	unsigned int i;
+
+	for (i = 0; i < NKEYS; i++) {
+		/* IPv4 table: mostly /24s, hashed like prefix_hash_key() */
+		memset(&p, 0, sizeof(p));
+		p.family = AF_INET;
+		n = rng() % 10;
+		p.prefixlen = n < 6 ? 24 : n < 8 ? 22 : n < 9 ? 23 : 20;
+		p.u.prefix4.s_addr = htonl(i << (32 - p.prefixlen));
+		keys[DS_PREFIX][i].len =
+			offsetof(struct prefix, u.prefix) + PSIZE(p.prefixlen);
+		memcpy(keys[DS_PREFIX][i].data, &p, keys[DS_PREFIX][i].len);
+
+		/* a transit AS or two, some prepending, a distinct origin */
+		n = 0;
+		as[n++] = transit[rng() % array_size(transit)];
+		if (rng() % 2)
+			as[n++] = transit[rng() % array_size(transit)];
+		as[n++] = 64512 + rng() % 1000;
+		for (j = rng() % 3; j; j--)
+			as[n++] = 100000 + i;
+		as[n++] = 100000 + i;
+		keys[DS_ASPATH][i].len = n * sizeof(as[0]);
+		memcpy(keys[DS_ASPATH][i].data, as, keys[DS_ASPATH][i].len);
+
+		/* ASN:value pairs from a few ASes, one tagging the route */
+		n = 0;
+		com[n++] = ((uint32_t)(65000 + i / 1000) << 16) | (i % 1000);
+		for (j = rng() % 5; j; j--)
+			com[n++] = (transit[rng() % array_size(transit)] << 16)
+				   | (rng() % 200);
+		keys[DS_COMMUNITY][i].len = n * sizeof(com[0]);
+		memcpy(keys[DS_COMMUNITY][i].data, com,
+		       keys[DS_COMMUNITY][i].len);
+	}
+}
+
+typedef uint32_t (*hashfunc)(const void *data, size_t len);
+
+static uint32_t hash_jhash(const void *data, size_t len)
+{
+	return jhash(data, len, 0x55aa5a5a);
+}
+
+static uint32_t hash_hashfn(const void *data, size_t len)
+{
+	return hashfn(data, len, 0x55aa5a5a);
+}
+
+static const struct {
+	const char *name;
+	hashfunc f;
+} funcs[] = {
+	{"jhash", hash_jhash},
+	{"hashfn", hash_hashfn},
+};
+
+/*
+ * Keys landing in a used bucket of a table of lib/hash.c's kind, as many
+ * buckets as keys rounded up to a power of 2.
+ */
+static unsigned int collisions(enum dataset ds, hashfunc f,
+			       unsigned int nbuckets)
+{
+	static uint8_t used[1 << 18];
+	unsigned int i, n = 0, b;
+
+	assert(nbuckets <= sizeof(used));
+	memset(used, 0, nbuckets);
+	for (i = 0; i < NKEYS; i++) {
+		b = f(keys[ds][i].data, keys[ds][i].len) & (nbuckets - 1);
+		n += used[b];
+		used[b] = 1;
+	}
+	return n;
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(void)
+{
+	static const size_t sizes[] = {4, 8, 12, 16, 24, 32, 64, 256, 1500};
+	static uint8_t buf[1500];
+	volatile uint32_t sink = 0;
+	unsigned int s, f, n, ds, rounds = 1 << 22;
+	double start;
+
+	for (n = 0; n < sizeof(buf); n++)
+		buf[n] = rng();
+
+	printf("%8s", "bytes");
+	for (f = 0; f < array_size(funcs); f++)
+		printf(" %9s", funcs[f].name);
+	printf("\n");
+	for (s = 0; s < array_size(sizes); s++) {
+		printf("%8zu", sizes[s]);
+		for (f = 0; f < array_size(funcs); f++) {
+			start = bench_now();
+			for (n = 0; n < rounds; n++)
+				sink += funcs[f].f(buf + (n & 7), sizes[s]);
+			printf(" %6.2f ns", (bench_now() - start) * 1e9 / rounds);
+		}
+		printf("\n");
+	}
+
+	for (ds = 0; ds < DS_MAX; ds++) {
+		printf("%-12s", ds_names[ds]);
+		for (f = 0; f < array_size(funcs); f++) {
+			start = bench_now();
+			for (s = 0; s < 20; s++)
+				for (n = 0; n < NKEYS; n++)
+					sink += funcs[f].f(keys[ds][n].data,
+							   keys[ds][n].len);
+			printf(" %s %6.2f ns", funcs[f].name,
+			       (bench_now() - start) * 1e9 / (20 * NKEYS));
+		}
+		printf("\n");
+	}
+	(void)sink;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, ds, f, nbuckets, n;
+	double expect;
+	uint64_t h;
+	uint8_t buf[64];
+
+	printf("Stable results...\n");
+	for (i = 0; i < array_size(vectors); i++) {
+		h = hashfn64(vectors[i].data, strlen(vectors[i].data),
+			     vectors[i].seed);
+		if (h != vectors[i].hash) {
+			printf("%u: 0x%016" PRIx64 "\n", i, h);
+			assert(!"hash changed");
+		}
+	}
+
+	printf("Every byte counts...\n");
+	memset(buf, 0, sizeof(buf));
+	for (n = 1; n <= sizeof(buf); n++) {
+		h = hashfn64(buf, n, 0);
+		/* nor does a bit of the key go unnoticed */
+		for (i = 0; i < n * 8; i++) {
+			buf[i / 8] ^= 1 << (i % 8);
+			assert(hashfn64(buf, n, 0) != h);
+			buf[i / 8] ^= 1 << (i % 8);
+		}
+		/* length is part of the key */
+		assert(n == 1 || hashfn64(buf, n - 1, 0) != h);
+		assert(hashfn64(buf, n, 1) != h);
+	}
+	assert(hashfn_mix(0, 1, 2) != hashfn_mix(0, 2, 1));
+	assert(hashfn_mix(1, 1, 2) != hashfn_mix(0, 1, 2));
+
+	printf("Collisions...\n");
+	make_keys();
+	for (nbuckets = 1; nbuckets < NKEYS; nbuckets <<= 1)
+		;
+	/* expected for a random function */
+	expect = NKEYS - nbuckets * (1 - pow(1 - 1.0 / nbuckets, NKEYS));
+	for (ds = 0; ds < DS_MAX; ds++)
+		for (f = 0; f < array_size(funcs); f++) {
+			n = collisions(ds, funcs[f].f, nbuckets);
+			printf("%-12s %-8s %6u (%.0f expected)\n", ds_names[ds],
+			       funcs[f].name, n, expect);
+			if (funcs[f].f == hash_hashfn)
+				assert(fabs(n - expect) < expect * 0.05);
+		}
+
+	if (argc > 1 && !strcmp(argv[1], "bench"))
+		bench();
+
+	printf("Done.\n");
+	return 0;
+}
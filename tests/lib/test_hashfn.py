@@ -0,0 +1,6 @@
+import frrtest
+
+class TestHashfn(frrtest.TestMultiOut):
+    program = './test_hashfn'
+
+TestHashfn.exit_cleanly()
@@ -0,0 +1,126 @@
+/*
+ * Streaming JSON writer tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "buffer.h"
+#include "memory.h"
+#include "vty.h"
+#include "lib/json.h"
+
+#define NROUTES 20000
+
+static const char *weird = "a \"quoted\" \\ back/slash\n\t\x01 end";
+
+/* parse what has been written to vty so far, and start over */
+static struct json_object *parse(struct vty *vty)
+{
+	struct json_object *obj;
+	char *str;
+
+	str = buffer_getstr(vty->obuf);
+	buffer_reset(vty->obuf);
+	obj = json_tokener_parse(str);
+	assert(obj);
+	XFREE(MTYPE_TMP, str);
+	return obj;
+}
+
+static struct json_object *member(struct json_object *obj, const char *key)
+{
+	struct json_object *val;
+
+	assert(json_object_object_get_ex(obj, key, &val));
+	return val;
+}
+
+int main(int argc, char **argv)
+{
+	struct vty *vty = vty_new();
+	struct json_stream js;
+	struct json_object *obj, *val, *path;
+	char key[32];
+	int i;
+
+	/* output stays in vty->obuf for parse() */
+	vty->type = VTY_FILE;
+
+	printf("Scalars and nesting...\n");
+	json_stream_init(&js, vty);
+	json_stream_object_start(&js, NULL);
+	json_stream_int(&js, "int", -42);
+	json_stream_int(&js, "big", 1LL << 40);
+	json_stream_bool(&js, "yes", true);
+	json_stream_bool(&js, "no", false);
+	json_stream_string(&js, weird, weird);
+	json_stream_object_start(&js, "empty");
+	json_stream_end(&js);
+	json_stream_array_start(&js, "list");
+	json_stream_int(&js, NULL, 1);
+	json_stream_array_start(&js, NULL);
+	json_stream_end(&js);
+	json_stream_string(&js, NULL, "two");
+	json_stream_end(&js);
+	json_stream_end(&js);
+	assert(js.depth == 0);
+
+	obj = parse(vty);
+	assert(json_object_get_int64(member(obj, "int")) == -42);
+	assert(json_object_get_int64(member(obj, "big")) == 1LL << 40);
+	assert(json_object_get_boolean(member(obj, "yes")));
+	assert(!json_object_get_boolean(member(obj, "no")));
+	assert(!strcmp(json_object_get_string(member(obj, weird)), weird));
+	assert(json_object_object_length(member(obj, "empty")) == 0);
+	val = member(obj, "list");
+	assert(json_object_array_length(val) == 3);
+	assert(json_object_get_int(json_object_array_get_idx(val, 0)) == 1);
+	assert(json_object_array_length(json_object_array_get_idx(val, 1))
+	       == 0);
+	assert(!strcmp(json_object_get_string(json_object_array_get_idx(val, 2)),
+		       "two"));
+	json_object_free(obj);
+
+	printf("%d embedded objects...\n", NROUTES);
+	json_stream_init(&js, vty);
+	json_stream_object_start(&js, NULL);
+	json_stream_object_start(&js, "routes");
+	for (i = 0; i < NROUTES; i++) {
+		val = json_object_new_array();
+		path = json_object_new_object();
+		json_object_int_add(path, "med", i);
+		json_object_string_add(path, "origin", "IGP");
+		json_object_array_add(val, path);
+		snprintf(key, sizeof(key), "10.%d.%d.0/24", i / 256, i % 256);
+		json_stream_object(&js, key, val);
+	}
+	json_stream_end(&js);
+	json_stream_end(&js);
+
+	obj = parse(vty);
+	val = member(obj, "routes");
+	assert(json_object_object_length(val) == NROUTES);
+	for (i = 0; i < NROUTES; i += 997) {
+		snprintf(key, sizeof(key), "10.%d.%d.0/24", i / 256, i % 256);
+		path = json_object_array_get_idx(member(val, key), 0);
+		assert(json_object_get_int(member(path, "med")) == i);
+	}
+	json_object_free(obj);
+
+	vty_close(vty);
+	printf("Done.\n");
+	return 0;
+}
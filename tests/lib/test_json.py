@@ -0,0 +1,6 @@
+import frrtest
+
+class TestJson(frrtest.TestMultiOut):
+    program = './test_json'
+
+TestJson.exit_cleanly()
@@ -0,0 +1,121 @@
+/*
+ * Lock-free MPSC queue tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <pthread.h>
+#include <memory.h>
+#include "mpscq.h"
+
+#define NPRODUCERS 4
+#define NITEMS 100000
+
+struct item {
+	struct mpscq_item mq;
+	unsigned int producer;
+	unsigned int seq;
+};
+
+static struct mpscq queue;
+static struct item *items[NPRODUCERS];
+
+static void *producer(void *arg)
+{
+	unsigned int p = (uintptr_t)arg;
+	unsigned int i;
+
+	for (i = 0; i < NITEMS; i++)
+		mpscq_push(&queue, &items[p][i].mq);
+
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[NPRODUCERS];
+	unsigned int expect[NPRODUCERS] = {};
+	struct item single[3];
+	struct mpscq_item *mi;
+	struct item *it;
+	unsigned int p, i, popped;
+
+	mpscq_init(&queue);
+
+	printf("Single pthread...\n");
+	assert(mpscq_pop(&queue) == NULL);
+	assert(mpscq_peek(&queue) == NULL);
+	for (i = 0; i < 3; i++)
+		mpscq_push(&queue, &single[i].mq);
+	assert(mpscq_count(&queue) == 3);
+	mi = mpscq_peek(&queue);
+	for (i = 0; i < 3; i++) {
+		assert(mi == &single[i].mq);
+		mi = mpscq_next(&queue, mi);
+	}
+	assert(mi == NULL);
+	for (i = 0; i < 3; i++) {
+		assert(mpscq_peek(&queue) == &single[i].mq);
+		assert(mpscq_pop(&queue) == &single[i].mq);
+	}
+	assert(mpscq_pop(&queue) == NULL);
+	assert(mpscq_count(&queue) == 0);
+
+	/* the queue keeps working after having run empty */
+	mpscq_push(&queue, &single[0].mq);
+	assert(mpscq_pop(&queue) == &single[0].mq);
+	assert(mpscq_pop(&queue) == NULL);
+
+	printf("%d producers...\n", NPRODUCERS);
+	for (p = 0; p < NPRODUCERS; p++) {
+		items[p] = XCALLOC(MTYPE_TMP, NITEMS * sizeof(struct item));
+		for (i = 0; i < NITEMS; i++) {
+			items[p][i].producer = p;
+			items[p][i].seq = i;
+		}
+	}
+	for (p = 0; p < NPRODUCERS; p++)
+		pthread_create(&threads[p], NULL, producer,
+			       (void *)(uintptr_t)p);
+
+	popped = 0;
+	while (popped < NPRODUCERS * NITEMS) {
+		mi = mpscq_pop(&queue);
+		if (!mi) {
+			sched_yield();
+			continue;
+		}
+
+		it = (struct item *)mi;
+		assert(it->producer < NPRODUCERS);
+		/* each producer's items come out in the order pushed */
+		assert(it->seq == expect[it->producer]);
+		expect[it->producer]++;
+		popped++;
+	}
+
+	for (p = 0; p < NPRODUCERS; p++)
+		pthread_join(threads[p], NULL);
+
+	assert(mpscq_pop(&queue) == NULL);
+	assert(mpscq_count(&queue) == 0);
+	for (p = 0; p < NPRODUCERS; p++) {
+		assert(expect[p] == NITEMS);
+		XFREE(MTYPE_TMP, items[p]);
+	}
+
+	printf("Done.\n");
+	return 0;
+}
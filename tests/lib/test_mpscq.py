@@ -0,0 +1,6 @@
+import frrtest
+
+class TestMpscq(frrtest.TestMultiOut):
+    program = './test_mpscq'
+
+TestMpscq.exit_cleanly()
@@ -0,0 +1,112 @@
+/*
+ * Per-pthread memtype cache tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include <memory.h>
+#include "mtcache.h"
+
+DEFINE_MGROUP(TEST_MTCACHE, "mtcache test")
+DEFINE_MTYPE_STATIC(TEST_MTCACHE, CACHE_OBJ, "mtcache test object")
+
+#define DEPTH 64
+#define NOBJS 100000
+#define INFLIGHT 32
+
+struct obj {
+	uint32_t id;
+	char pad[60];
+};
+
+static struct mtcache *cache;
+static struct obj *_Atomic ring[INFLIGHT];
+
+/* Allocates objects the main pthread frees, as bgpd's I/O pthread does
+ * with the packets it reads.
+ */
+static void *producer(void *arg)
+{
+	struct obj *obj;
+	unsigned int i;
+
+	for (i = 0; i < NOBJS; i++) {
+		obj = mtcache_alloc(cache);
+		obj->id = i;
+		while (atomic_load_explicit(&ring[i % INFLIGHT],
+					    memory_order_acquire))
+			sched_yield();
+		atomic_store_explicit(&ring[i % INFLIGHT], obj,
+				      memory_order_release);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct obj *objs[DEPTH + 1], *obj;
+	pthread_t thread;
+	unsigned int i;
+
+	cache = mtcache_new(MTYPE_CACHE_OBJ, sizeof(struct obj), DEPTH);
+
+	printf("Single pthread...\n");
+	for (i = 0; i < DEPTH + 1; i++)
+		objs[i] = mtcache_alloc(cache);
+	assert(mtype_stats_alloc(MTYPE_CACHE_OBJ) == DEPTH + 1);
+	for (i = 0; i < DEPTH + 1; i++)
+		mtcache_free(cache, objs[i]);
+	/* the one past the cache's depth went back to the system */
+	assert(mtype_stats_alloc(MTYPE_CACHE_OBJ) == 0);
+	assert(MTYPE_CACHE_OBJ->n_alloc == DEPTH);
+
+	/* freed objects are reused, most recently freed first */
+	obj = mtcache_alloc(cache);
+	assert(obj == objs[DEPTH - 1]);
+	assert(mtype_stats_alloc(MTYPE_CACHE_OBJ) == 1);
+	assert(mtype_stats_total(MTYPE_CACHE_OBJ) == DEPTH + 2);
+	MTCACHE_FREE(cache, obj);
+	assert(obj == NULL);
+
+	assert(mtcache_reclaim(cache) == DEPTH);
+	assert(MTYPE_CACHE_OBJ->n_alloc == 0);
+
+	printf("Freeing from another pthread...\n");
+	pthread_create(&thread, NULL, producer, NULL);
+	for (i = 0; i < NOBJS; i++) {
+		while (!(obj = atomic_load_explicit(&ring[i % INFLIGHT],
+						    memory_order_acquire)))
+			sched_yield();
+		assert(obj->id == i);
+		atomic_store_explicit(&ring[i % INFLIGHT], NULL,
+				      memory_order_release);
+		mtcache_free(cache, obj);
+	}
+	pthread_join(thread, NULL);
+
+	/* the producer's cache was emptied when it exited */
+	assert(mtype_stats_alloc(MTYPE_CACHE_OBJ) == 0);
+	assert(mtype_stats_total(MTYPE_CACHE_OBJ) == DEPTH + 2 + NOBJS);
+	mtcache_reclaim(cache);
+	assert(MTYPE_CACHE_OBJ->n_alloc == 0);
+
+	mtcache_del(cache);
+	assert(MTYPE_CACHE_OBJ->cache == NULL);
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestMtcache(frrtest.TestMultiOut):
+    program = './test_mtcache'
+
+TestMtcache.exit_cleanly()
@@ -0,0 +1,212 @@
+/*
+ * Nexthop key tests and benchmarks.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include "jhash.h"
+#include "memory.h"
+#include "nexthop.h"
+
+struct thread_master *master;
+
+/* The field-wise comparison the keys replaced. */
+static bool ref_same(const struct nexthop *nh1, const struct nexthop *nh2)
+{
+	if (nh1->vrf_id != nh2->vrf_id || nh1->type != nh2->type)
+		return false;
+
+	switch (nh1->type) {
+	case NEXTHOP_TYPE_IFINDEX:
+		return nh1->ifindex == nh2->ifindex;
+	case NEXTHOP_TYPE_IPV4:
+		return nh1->gate.ipv4.s_addr == nh2->gate.ipv4.s_addr;
+	case NEXTHOP_TYPE_IPV4_IFINDEX:
+		return nh1->gate.ipv4.s_addr == nh2->gate.ipv4.s_addr
+		       && nh1->ifindex == nh2->ifindex;
+	case NEXTHOP_TYPE_IPV6:
+		return !memcmp(&nh1->gate.ipv6, &nh2->gate.ipv6, 16);
+	case NEXTHOP_TYPE_IPV6_IFINDEX:
+		return !memcmp(&nh1->gate.ipv6, &nh2->gate.ipv6, 16)
+		       && nh1->ifindex == nh2->ifindex;
+	case NEXTHOP_TYPE_BLACKHOLE:
+		return nh1->bh_type == nh2->bh_type;
+	}
+	return true;
+}
+
+static bool ref_same_full(const struct nexthop *nh1, const struct nexthop *nh2)
+{
+	if (!ref_same(nh1, nh2))
+		return false;
+	if (CHECK_FLAG(nh1->flags, NEXTHOP_FLAG_ONLINK)
+	    != CHECK_FLAG(nh2->flags, NEXTHOP_FLAG_ONLINK))
+		return false;
+	if (memcmp(&nh1->src, &nh2->src, sizeof(nh1->src)))
+		return false;
+	if (!nh1->nh_label || !nh2->nh_label)
+		return nh1->nh_label == nh2->nh_label;
+	return nh1->nh_label_type == nh2->nh_label_type
+	       && nh1->nh_label->num_labels == nh2->nh_label->num_labels
+	       && !memcmp(nh1->nh_label->label, nh2->nh_label->label,
+			  nh1->nh_label->num_labels * sizeof(mpls_label_t));
+}
+
+static uint32_t ref_hash(const struct nexthop *nh)
+{
+	uint32_t key;
+
+	key = jhash_1word(nh->vrf_id, 0x45afe398);
+	key = jhash_1word(nh->ifindex, key);
+	key = jhash_1word(nh->type, key);
+	return jhash(&nh->gate, sizeof(union g_addr), key);
+}
+
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return rng_state >> 33;
+}
+
+/* Nexthops drawn from few values, so that many pairs are equal. */
+static void rand_nexthop(struct nexthop *nh)
+{
+	mpls_label_t labels[4];
+	unsigned int i, n;
+
+	memset(nh, 0, sizeof(*nh));
+	nh->type = NEXTHOP_TYPE_IFINDEX + rng() % 6;
+	nh->vrf_id = rng() % 2;
+	/* ifindex is left in place by types that do not use it */
+	nh->ifindex = rng() % 3;
+	if (nh->type == NEXTHOP_TYPE_BLACKHOLE)
+		nh->bh_type = rng() % 4;
+	else
+		for (i = 0; i < 16; i += 4)
+			nh->gate.ipv6.s6_addr[i] = rng() % 2;
+	nh->src.ipv4.s_addr = rng() % 2;
+	if (rng() % 2)
+		SET_FLAG(nh->flags, NEXTHOP_FLAG_ONLINK);
+	if (rng() % 4)
+		SET_FLAG(nh->flags, NEXTHOP_FLAG_ACTIVE);
+
+	n = rng() % 5;
+	if (n) {
+		for (i = 0; i < n; i++)
+			labels[i] = 16 + rng() % 2;
+		nexthop_add_labels(nh, ZEBRA_LSP_STATIC, n - 1, labels);
+	}
+}
+
+#define NNH 512
+
+static struct nexthop nhs[NNH];
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(void)
+{
+	struct nexthop_key keys[NNH];
+	volatile uint32_t sink = 0;
+	unsigned int i, j;
+	double start;
+
+	for (i = 0; i < NNH; i++)
+		nexthop_key_make(&keys[i], &nhs[i], true);
+
+#define BENCH(name, expr)                                                      \
+	do {                                                                   \
+		start = bench_now();                                           \
+		for (i = 0; i < NNH; i++)                                      \
+			for (j = 0; j < NNH; j++)                              \
+				sink += (expr);                                \
+		printf("  %-16s %6.2f ns\n", name,                             \
+		       (bench_now() - start) * 1e9 / (NNH * NNH));             \
+	} while (0)
+
+	BENCH("field-wise same", ref_same_full(&nhs[i], &nhs[j]));
+	BENCH("key same", nexthop_key_same(&keys[i], &keys[j]));
+	BENCH("jhash", ref_hash(&nhs[j]));
+	BENCH("nexthop_hash", nexthop_hash(&nhs[j]));
+#undef BENCH
+	(void)sink;
+}
+
+int main(int argc, char **argv)
+{
+	struct nexthop_key k1, k2;
+	mpls_label_t labels[4];
+	unsigned int i, j;
+	bool same;
+
+	for (i = 0; i < NNH; i++)
+		rand_nexthop(&nhs[i]);
+
+	printf("Keys agree with the nexthops...\n");
+	for (i = 0; i < NNH; i++)
+		for (j = 0; j < NNH; j++) {
+			same = ref_same(&nhs[i], &nhs[j]);
+			assert(nexthop_same(&nhs[i], &nhs[j]) == same);
+			if (same)
+				assert(nexthop_hash(&nhs[i])
+				       == nexthop_hash(&nhs[j]));
+
+			nexthop_key_make(&k1, &nhs[i], true);
+			nexthop_key_make(&k2, &nhs[j], true);
+			same = ref_same_full(&nhs[i], &nhs[j]);
+			if (nexthop_key_exact(&k1))
+				assert(nexthop_key_same(&k1, &k2) == same);
+			else if (same)
+				assert(nexthop_key_same(&k1, &k2));
+		}
+
+	printf("Long label stacks...\n");
+	for (i = 0; i < 4; i++)
+		labels[i] = 100 + i;
+	nexthop_del_labels(&nhs[0]);
+	nexthop_del_labels(&nhs[1]);
+	nexthop_add_labels(&nhs[0], ZEBRA_LSP_STATIC, 4, labels);
+	labels[3]++;
+	nexthop_add_labels(&nhs[1], ZEBRA_LSP_STATIC, 4, labels);
+	nhs[1].type = nhs[0].type;
+	nhs[1].vrf_id = nhs[0].vrf_id;
+	nhs[1].ifindex = nhs[0].ifindex;
+	nhs[1].gate = nhs[0].gate;
+	nhs[1].src = nhs[0].src;
+	nhs[1].flags = nhs[0].flags;
+	nexthop_key_make(&k1, &nhs[0], true);
+	nexthop_key_make(&k2, &nhs[1], true);
+	assert(!nexthop_key_exact(&k1));
+	assert(!nexthop_key_same(&k1, &k2));
+	assert(nexthop_same(&nhs[0], &nhs[1]));
+
+	if (argc > 1 && !strcmp(argv[1], "bench"))
+		bench();
+
+	for (i = 0; i < NNH; i++)
+		nexthop_del_labels(&nhs[i]);
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestNexthop(frrtest.TestMultiOut):
+    program = './test_nexthop'
+
+TestNexthop.exit_cleanly()
@@ -0,0 +1,158 @@
+/*
+ * Prefix-list lookup tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+
+#include "prefix.h"
+#include "plist.h"
+
+#define NENTRIES 2000
+#define NQUERIES 20000
+
+struct entry {
+	struct orf_prefix orfp;
+	int permit;
+	int installed;
+};
+
+static struct entry entries[NENTRIES];
+
+/* Addresses are drawn from a small pool so that entries overlap a lot. */
+static void random_prefix(struct prefix *p, afi_t afi, int minlen)
+{
+	int maxlen = afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+
+	memset(p, 0, sizeof(*p));
+	p->family = afi2family(afi);
+	p->prefixlen = minlen + random() % (maxlen - minlen + 1);
+	p->u.prefix6.s6_addr[0] = 10;
+	p->u.prefix6.s6_addr[1] = random() % 4;
+	p->u.prefix6.s6_addr[2] = random() % 4;
+	p->u.prefix6.s6_addr[3] = random() % 4;
+	if (random() % 2)
+		p->u.prefix6.s6_addr[random() % 4] |= 1 << (random() % 8);
+}
+
+/* What prefix_list_apply() must return, by walking entries in seq order. */
+static enum prefix_list_type expected(struct prefix *p)
+{
+	struct entry *best = NULL;
+	struct orf_prefix *o;
+	int i;
+
+	for (i = 0; i < NENTRIES; i++) {
+		o = &entries[i].orfp;
+		if (!entries[i].installed || (best && best->orfp.seq < o->seq))
+			continue;
+		if (o->p.family != p->family || !prefix_match(&o->p, p))
+			continue;
+		if (!o->ge && !o->le) {
+			if (o->p.prefixlen != p->prefixlen)
+				continue;
+		} else if ((o->le && p->prefixlen > o->le)
+			   || (o->ge && p->prefixlen < o->ge))
+			continue;
+		best = &entries[i];
+	}
+
+	if (!best)
+		return PREFIX_DENY;
+	return best->permit ? PREFIX_PERMIT : PREFIX_DENY;
+}
+
+static void check(struct prefix_list *plist, afi_t afi)
+{
+	struct prefix p;
+	int i;
+
+	for (i = 0; i < NQUERIES; i++) {
+		random_prefix(&p, afi, 0);
+		apply_mask(&p);
+		assert(prefix_list_apply(plist, &p) == expected(&p));
+	}
+}
+
+static void test_afi(afi_t afi)
+{
+	char name[] = "test";
+	int maxlen = afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN;
+	struct prefix_list *plist;
+	struct orf_prefix *o;
+	int i, len, installed = 0;
+
+	for (i = 0; i < NENTRIES; i++) {
+		o = &entries[i].orfp;
+		memset(o, 0, sizeof(*o));
+		/* installed out of sequence order, and with gaps */
+		o->seq = 1 + random() % (NENTRIES * 4);
+		random_prefix(&o->p, afi, 0);
+		len = o->p.prefixlen;
+		if (len < maxlen && random() % 2)
+			o->ge = len + 1 + random() % (maxlen - len);
+		if (len < maxlen && random() % 2)
+			o->le = MAX(o->ge, len + 1) + random() % 4;
+		if (o->le > maxlen)
+			o->le = maxlen;
+		if (o->ge && o->le == maxlen)
+			o->le = 0;
+		entries[i].permit = random() % 2;
+		entries[i].installed =
+			!prefix_bgp_orf_set(name, afi, o, entries[i].permit, 1);
+		installed += entries[i].installed;
+	}
+
+	/* the last entry with a given seq replaces earlier ones */
+	for (i = 0; i < NENTRIES; i++) {
+		int j;
+
+		for (j = i + 1; j < NENTRIES; j++)
+			if (entries[j].installed
+			    && entries[j].orfp.seq == entries[i].orfp.seq)
+				entries[i].installed = 0;
+	}
+
+	plist = prefix_bgp_orf_lookup(afi, name);
+	assert(plist);
+	printf("%d of %d entries installed...\n", installed, NENTRIES);
+	check(plist, afi);
+
+	printf("Removing half of them...\n");
+	for (i = 0; i < NENTRIES; i += 2) {
+		if (!entries[i].installed)
+			continue;
+		assert(!prefix_bgp_orf_set(name, afi, &entries[i].orfp,
+					   entries[i].permit, 0));
+		entries[i].installed = 0;
+	}
+	check(plist, afi);
+
+	prefix_bgp_orf_remove_all(afi, name);
+	assert(!prefix_bgp_orf_lookup(afi, name));
+}
+
+int main(int argc, char **argv)
+{
+	srandom(1);
+
+	printf("IPv4...\n");
+	test_afi(AFI_IP);
+	printf("IPv6...\n");
+	test_afi(AFI_IP6);
+
+	printf("Done.\n");
+	return 0;
+}
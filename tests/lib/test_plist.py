@@ -0,0 +1,6 @@
+import frrtest
+
+class TestPlist(frrtest.TestMultiOut):
+    program = './test_plist'
+
+TestPlist.exit_cleanly()
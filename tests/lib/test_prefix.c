@@ -0,0 +1,239 @@
+/*
+ * Prefix comparison tests and benchmarks.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include "prefix.h"
+#include "table.h"
+
+struct thread_master *master;
+
+/* The byte-wise versions the word-wise fast paths replaced. */
+static const uint8_t maskbit[] = {0x00, 0x80, 0xc0, 0xe0, 0xf0,
+				  0xf8, 0xfc, 0xfe, 0xff};
+
+static int ref_match(const struct prefix *n, const struct prefix *p)
+{
+	const uint8_t *np = (const uint8_t *)&n->u.prefix;
+	const uint8_t *pp = (const uint8_t *)&p->u.prefix;
+	int offset = n->prefixlen / 8;
+	int shift = n->prefixlen % 8;
+
+	if (n->prefixlen > p->prefixlen)
+		return 0;
+	if (shift && (maskbit[shift] & (np[offset] ^ pp[offset])))
+		return 0;
+	while (offset--)
+		if (np[offset] != pp[offset])
+			return 0;
+	return 1;
+}
+
+static int ref_cmp(const struct prefix *p1, const struct prefix *p2)
+{
+	if (p1->prefixlen != p2->prefixlen)
+		return 1;
+	return !ref_match(p1, p2);
+}
+
+static int ref_common_bits(const struct prefix *p1, const struct prefix *p2)
+{
+	const uint8_t *pp1 = (const uint8_t *)&p1->u.prefix;
+	const uint8_t *pp2 = (const uint8_t *)&p2->u.prefix;
+	int length = p1->family == AF_INET ? 4 : 16;
+	int pos, bit;
+
+	for (pos = 0; pos < length; pos++)
+		if (pp1[pos] != pp2[pos])
+			break;
+	if (pos == length)
+		return pos * 8;
+	for (bit = 0; bit < 8; bit++)
+		if ((pp1[pos] ^ pp2[pos]) & (1 << (7 - bit)))
+			break;
+	return pos * 8 + bit;
+}
+
+static void ref_apply_mask(struct prefix *p)
+{
+	uint8_t *pnt = (uint8_t *)&p->u.prefix;
+	int length = p->family == AF_INET ? 4 : 16;
+	int index = p->prefixlen / 8;
+
+	if (index < length) {
+		pnt[index] &= maskbit[p->prefixlen % 8];
+		while (++index < length)
+			pnt[index] = 0;
+	}
+}
+
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return rng_state >> 33;
+}
+
+static void rand_prefix(struct prefix *p, int family)
+{
+	unsigned int i, bits = family == AF_INET ? 32 : 128;
+
+	memset(p, 0, sizeof(*p));
+	p->family = family;
+	p->prefixlen = rng() % (bits + 1);
+	for (i = 0; i < bits / 8; i++)
+		(&p->u.prefix)[i] = rng();
+}
+
+/* A prefix sharing a random number of leading bits with p. */
+static void rand_related(struct prefix *q, const struct prefix *p)
+{
+	unsigned int bits = p->family == AF_INET ? 32 : 128;
+	unsigned int keep = rng() % (bits + 1), i;
+
+	*q = *p;
+	q->prefixlen = rng() % (bits + 1);
+	for (i = keep; i < bits; i++)
+		if (rng() & 1)
+			(&q->u.prefix)[i / 8] ^= 0x80 >> (i % 8);
+}
+
+static void check(int family, unsigned int rounds)
+{
+	struct prefix p, q, m, r;
+	unsigned int i;
+
+	for (i = 0; i < rounds; i++) {
+		rand_prefix(&p, family);
+		rand_related(&q, &p);
+		if (i % 8 == 0)
+			q = p;
+
+		assert(prefix_match(&p, &q) == ref_match(&p, &q));
+		assert(prefix_match(&q, &p) == ref_match(&q, &p));
+		assert(prefix_cmp(&p, &q) == ref_cmp(&p, &q));
+		assert(prefix_common_bits(&p, &q) == ref_common_bits(&p, &q));
+
+		m = r = p;
+		apply_mask(&m);
+		ref_apply_mask(&r);
+		assert(!memcmp(&m, &r, sizeof(m)));
+	}
+}
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define NPAIRS 4096
+
+static struct prefix pairs[NPAIRS][2];
+
+static void bench_family(int family)
+{
+	volatile int sink = 0;
+	unsigned int i, r, rounds = 2000;
+	struct prefix m;
+	double start;
+
+	for (i = 0; i < NPAIRS; i++) {
+		rand_prefix(&pairs[i][0], family);
+		rand_related(&pairs[i][1], &pairs[i][0]);
+	}
+
+#define BENCH(name, expr)                                                      \
+	do {                                                                   \
+		start = bench_now();                                           \
+		for (r = 0; r < rounds; r++)                                   \
+			for (i = 0; i < NPAIRS; i++)                           \
+				sink += (expr);                                \
+		printf("  %-18s %6.2f ns\n", name,                             \
+		       (bench_now() - start) * 1e9 / (rounds * NPAIRS));       \
+	} while (0)
+
+	printf("%s:\n", family == AF_INET ? "IPv4" : "IPv6");
+	BENCH("bytes match", ref_match(&pairs[i][0], &pairs[i][1]));
+	BENCH("prefix_match", prefix_match(&pairs[i][0], &pairs[i][1]));
+	BENCH("bytes cmp", ref_cmp(&pairs[i][0], &pairs[i][1]));
+	BENCH("prefix_cmp", prefix_cmp(&pairs[i][0], &pairs[i][1]));
+	BENCH("bytes common", ref_common_bits(&pairs[i][0], &pairs[i][1]));
+	BENCH("prefix_common_bits",
+	      prefix_common_bits(&pairs[i][0], &pairs[i][1]));
+	BENCH("bytes mask",
+	      (m = pairs[i][0], ref_apply_mask(&m), m.u.prefix));
+	BENCH("apply_mask", (m = pairs[i][0], apply_mask(&m), m.u.prefix));
+#undef BENCH
+	(void)sink;
+}
+
+static void bench_table(int family)
+{
+	struct route_table *table = route_table_init();
+	struct route_node *rn;
+	unsigned int i, r, rounds = 200;
+	double start;
+
+	/* distinct prefixes of /16 and longer: the top 12 bits are i */
+	for (i = 0; i < NPAIRS; i++) {
+		rand_prefix(&pairs[i][0], family);
+		pairs[i][0].prefixlen = 16 + pairs[i][0].prefixlen % 17;
+		(&pairs[i][0].u.prefix)[0] = i >> 4;
+		(&pairs[i][0].u.prefix)[1] &= 0x0f;
+		(&pairs[i][0].u.prefix)[1] |= i << 4;
+		apply_mask(&pairs[i][0]);
+	}
+
+	start = bench_now();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < NPAIRS; i++) {
+			rn = route_node_get(table, &pairs[i][0]);
+			rn->info = table;
+		}
+		for (i = 0; i < NPAIRS; i++) {
+			rn = route_node_lookup(table, &pairs[i][0]);
+			rn->info = NULL;
+			route_unlock_node(rn);
+			route_unlock_node(rn);
+		}
+	}
+	printf("  %-18s %6.2f ns\n", "table get+delete",
+	       (bench_now() - start) * 1e9 / (rounds * NPAIRS));
+	route_table_finish(table);
+}
+
+int main(int argc, char **argv)
+{
+	printf("IPv4...\n");
+	check(AF_INET, 1000000);
+	printf("IPv6...\n");
+	check(AF_INET6, 1000000);
+
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench_family(AF_INET);
+		bench_table(AF_INET);
+		bench_family(AF_INET6);
+		bench_table(AF_INET6);
+	}
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestPrefix(frrtest.TestMultiOut):
+    program = './test_prefix'
+
+TestPrefix.exit_cleanly()
@@ -170,17 +170,50 @@ int main(int argc, char **argv)
 
 	printf("Creating new buffer...\n");
 	soil = ringbuf_new(15);
+	validate_state(soil, 16, 0);
 	soil->start = soil->end = 7;
 
 	/* validate data encode of excessive data */
-	const char *twenty = "vascular plants----";
-	char sixteen[16];
+	const char *twenty = "vascular plants!---";
+	char seventeen[17];
 	printf("Encoding: %s\n", twenty);
-	assert(ringbuf_put(soil, twenty, strlen(twenty)) == 15);
-	assert(ringbuf_get(soil, sixteen, 20));
-	sixteen[15] = '\0';
-	printf("Retrieved: %s\n", sixteen);
-	assert(!strcmp(sixteen, "vascular plants"));
+	assert(ringbuf_put(soil, twenty, strlen(twenty)) == 16);
+	assert(ringbuf_get(soil, seventeen, 20));
+	seventeen[16] = '\0';
+	printf("Retrieved: %s\n", seventeen);
+	assert(!strcmp(seventeen, "vascular plants!"));
+
+	/* validate in-place writes and reads */
+	printf("Validating reserve / commit...\n");
+	struct iovec iov[2];
+	soil->start = soil->end = 12;
+	assert(ringbuf_reserve(soil, iov) == 16);
+	assert(iov[0].iov_base == soil->data + 12 && iov[0].iov_len == 4);
+	assert(iov[1].iov_base == soil->data && iov[1].iov_len == 12);
+	memcpy(iov[0].iov_base, "root", 4);
+	memcpy(iov[1].iov_base, "stem", 4);
+	ringbuf_commit(soil, 8);
+	validate_state(soil, 16, 8);
+	assert(ringbuf_reserve(soil, iov) == 8);
+	assert(iov[0].iov_base == soil->data + 4 && iov[0].iov_len == 8);
+	assert(iov[1].iov_len == 0);
+
+	printf("Validating spans / consume...\n");
+	assert(ringbuf_spans(soil, 2, iov) == 6);
+	assert(iov[0].iov_len == 2 && !memcmp(iov[0].iov_base, "ot", 2));
+	assert(iov[1].iov_len == 4 && !memcmp(iov[1].iov_base, "stem", 4));
+	assert(ringbuf_contig(soil, 0, 4) == soil->data + 12);
+	assert(ringbuf_contig(soil, 2, 4) == NULL);
+	assert(ringbuf_contig(soil, 4, 4) == soil->data);
+	assert(ringbuf_contig(soil, 4, 5) == NULL);
+	assert(ringbuf_consume(soil, 4) == 4);
+	validate_state(soil, 16, 4);
+	assert(ringbuf_get(soil, water, 4) == 4);
+	assert(!memcmp(water, "stem", 4));
+	validate_state(soil, 16, 0);
+	assert(ringbuf_spans(soil, 0, iov) == 0);
+	assert(ringbuf_consume(soil, 1) == 0);
+	validate_state(soil, 16, 0);
 
 	printf("Deleting...\n");
 	ringbuf_del(soil);
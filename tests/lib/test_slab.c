@@ -0,0 +1,97 @@
+/*
+ * Slab allocator tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <zebra.h>
+#include <memory.h>
+#include "slab.h"
+
+DEFINE_MGROUP(TEST_SLAB, "slab test")
+DEFINE_MTYPE_STATIC(TEST_SLAB, SLAB_OBJ, "slab test object")
+
+#define NOBJS 20000
+
+struct obj {
+	uint32_t id;
+	char pad[44];
+};
+
+static void test_slab(enum slab_pages pages)
+{
+	struct slab *slab;
+	struct obj **objs = XCALLOC(MTYPE_TMP, NOBJS * sizeof(*objs));
+	unsigned int i;
+
+	slab_set_pages(pages);
+	slab = slab_new(MTYPE_SLAB_OBJ, sizeof(struct obj));
+
+	printf("Allocating...\n");
+	for (i = 0; i < NOBJS; i++) {
+		objs[i] = slab_alloc(slab);
+		assert(objs[i]->id == 0);
+		objs[i]->id = i;
+	}
+	assert(slab_count(slab) == NOBJS);
+	assert(mtype_stats_alloc(MTYPE_SLAB_OBJ) == NOBJS);
+
+	printf("Freeing every other object...\n");
+	for (i = 0; i < NOBJS; i += 2)
+		SLAB_FREE(slab, objs[i]);
+	for (i = 1; i < NOBJS; i += 2)
+		assert(objs[i]->id == i);
+	assert(slab_count(slab) == NOBJS / 2);
+	assert(mtype_stats_alloc(MTYPE_SLAB_OBJ) == NOBJS / 2);
+	assert(mtype_stats_peak(MTYPE_SLAB_OBJ) == NOBJS);
+
+	/* every chunk still holds live objects */
+	assert(slab_reclaim(slab) == 0);
+
+	printf("Reusing freed objects...\n");
+	for (i = 0; i < NOBJS; i += 2) {
+		objs[i] = slab_alloc(slab);
+		assert(objs[i]->id == 0);
+		objs[i]->id = i;
+	}
+	for (i = 0; i < NOBJS; i++)
+		assert(objs[i]->id == i);
+
+	printf("Freeing everything...\n");
+	for (i = 0; i < NOBJS; i++)
+		SLAB_FREE(slab, objs[i]);
+	assert(slab_count(slab) == 0);
+	assert(mtype_stats_alloc(MTYPE_SLAB_OBJ) == 0);
+	assert(slab_reclaim(slab) > 0);
+	assert(slab_reclaim(slab) == 0);
+
+	printf("Deleting with live objects...\n");
+	for (i = 0; i < NOBJS; i++)
+		objs[i] = slab_alloc(slab);
+	slab_del(slab);
+	assert(mtype_stats_alloc(MTYPE_SLAB_OBJ) == 0);
+
+	XFREE(MTYPE_TMP, objs);
+}
+
+int main(int argc, char **argv)
+{
+	printf("Normal pages...\n");
+	test_slab(SLAB_PAGES_NORMAL);
+	printf("Transparent huge pages...\n");
+	test_slab(SLAB_PAGES_TRANSPARENT);
+
+	printf("Done.\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestSlab(frrtest.TestMultiOut):
+    program = './test_slab'
+
+TestSlab.exit_cleanly()
@@ -246,6 +246,7 @@ static void test_state_verify(struct test_state *test)
 {
 	struct route_node *rn;
 	struct prefix hash_entry[2];
+	unsigned long nodes = 0;
 
 	memset(hash_entry, 0, sizeof(hash_entry));
 
@@ -254,6 +255,8 @@ static void test_state_verify(struct test_state *test)
 	for (rn = route_top(test->table); rn; rn = srcdest_route_next(rn)) {
 		struct prefix_ipv6 *dst_p, *src_p;
 
+		nodes++;
+
 		/* While we are iterating, we hold a lock on the current
 		 * route_node,
 		 * so all the lock counts we check for take that into account;
@@ -320,6 +323,10 @@ static void test_state_verify(struct test_state *test)
 				    src_p);
 	}
 
+	/* Source nodes share the hash of the destination table, with no
+	 * node left behind or missing from it */
+	assert(test->table->hash->count == nodes);
+
 	/* Verify that all added elements are still in the table */
 	hash_iterate(test->log, verify_log, test);
 }
@@ -44,9 +44,28 @@ static void print_stream(struct stream *s)
 	stream_set_getp(s, getp);
 }
 
+static void print_chain(struct stream *s)
+{
+	struct iovec iov[4];
+	int iovcnt, i;
+	size_t j;
+
+	iovcnt = stream_chain_iov(s, iov, array_size(iov));
+	printf("readable: %zu, segments: %d\n", stream_chain_readable(s),
+	       iovcnt);
+
+	for (i = 0; i < iovcnt; i++)
+		for (j = 0; j < iov[i].iov_len; j++)
+			printf("0x%x ", ((uint8_t *)iov[i].iov_base)[j]);
+
+	printf("\n");
+}
+
 int main(void)
 {
-	struct stream *s;
+	struct stream *s, *shared;
+
+	stream_cache_enable();
 
 	s = stream_new(1024);
 
@@ -66,5 +85,47 @@ int main(void)
 	printf("l: 0x%x\n", stream_getl(s));
 	printf("q: 0x%" PRIx64 "\n", stream_getq(s));
 
+	/* the same fields, bounds checked once */
+	stream_set_getp(s, 0);
+	assert(stream_reserve(s, 15));
+	assert(!stream_reserve(s, 16));
+	printf("c: 0x%hhx\n", stream_getc_unchecked(s));
+	printf("w: 0x%hx\n", stream_getw_unchecked(s));
+	printf("l: 0x%x\n", stream_getl_unchecked(s));
+	printf("q: 0x%" PRIx64 "\n", stream_getq_unchecked(s));
+	assert(!stream_reserve(s, 1));
+
+	/* shared data outlives the stream it came from */
+	shared = stream_share(s);
+	stream_free(s);
+
+	print_stream(shared);
+
+	printf("l: 0x%x\n", stream_getl_from(shared, 3));
+
+	/* and can be swapped for other data in place */
+	s = stream_new(4);
+	stream_putl(s, 0xcafef00d);
+	stream_reshare(shared, s);
+	stream_free(s);
+
+	print_stream(shared);
+
+	stream_free(shared);
+
+	/* patching a stream shares the bytes around the patch */
+	s = stream_new(8);
+	stream_putq(s, ham);
+	shared = stream_patch(s, 2, "\x01\x02", 2);
+	stream_free(s);
+
+	print_chain(shared);
+
+	stream_chain_forward_getp(shared, 3);
+	print_chain(shared);
+
+	stream_free(shared);
+	stream_cache_finish();
+
 	return 0;
 }
@@ -23,6 +23,7 @@
 
 #include "prefix.h"
 #include "table.h"
+#include "thread.h"
 
 /*
  * test_node_t
@@ -492,6 +493,273 @@ static void test_iter_pause(void)
 	route_table_finish(table);
 }
 
+/*
+ * verify_match
+ *
+ * Check route_node_match() against a linear scan of the table for the
+ * longest prefix covering p.
+ */
+static void verify_match(struct route_table *table, struct prefix *p)
+{
+	struct route_node *rn, *best = NULL, *match;
+
+	for (rn = route_top(table); rn; rn = route_next(rn)) {
+		if (!rn->info || rn->p.prefixlen > p->prefixlen
+		    || !prefix_match(&rn->p, p))
+			continue;
+		if (!best || rn->p.prefixlen > best->p.prefixlen)
+			best = rn;
+	}
+
+	match = route_node_match(table, p);
+	assert(match == best);
+	if (match)
+		route_unlock_node(match);
+}
+
+/*
+ * test_match
+ *
+ * Fill tables with random IPv4 and IPv6 prefixes, and verify lookups of
+ * random addresses and prefixes.
+ */
+static void test_match(int family)
+{
+	struct route_table *table;
+	struct route_node *rn;
+	struct prefix p;
+	int i, j, maxlen = family == AF_INET ? IPV4_MAX_BITLEN
+					     : IPV6_MAX_BITLEN;
+
+	printf("\n\nTesting route_node_match() for %s\n",
+	       family == AF_INET ? "IPv4" : "IPv6");
+	srandom(family);
+	table = route_table_init();
+
+	for (i = 0; i < 2000; i++) {
+		memset(&p, 0, sizeof(p));
+		p.family = family;
+		/* keep the address space small so that prefixes nest */
+		for (j = 0; j < 2; j++)
+			p.u.val[j] = random() & 0xc3;
+		p.prefixlen = random() % (maxlen + 1);
+		apply_mask(&p);
+
+		rn = route_node_get(table, &p);
+		if (rn->info)
+			route_unlock_node(rn);
+		else
+			rn->info = (void *)table;
+	}
+
+	for (i = 0; i < 5000; i++) {
+		memset(&p, 0, sizeof(p));
+		p.family = family;
+		for (j = 0; j < 2; j++)
+			p.u.val[j] = random() & 0xc3;
+		for (j = 2; j < (maxlen / 8); j++)
+			p.u.val[j] = random();
+		p.prefixlen = (i % 2) ? maxlen : random() % (maxlen + 1);
+
+		verify_match(table, &p);
+	}
+
+	for (rn = route_top(table); rn; rn = route_next(rn))
+		if (rn->info) {
+			rn->info = NULL;
+			route_unlock_node(rn);
+		}
+	route_table_finish(table);
+
+	printf("Verified longest-prefix match\n");
+}
+
+/*
+ * del_node
+ *
+ * Remove the given prefix (passed in as a string) from the given table.
+ */
+static void del_node(struct route_table *table, const char *prefix_str)
+{
+	struct prefix_ipv4 p;
+	test_node_t *node;
+	struct route_node *rn;
+
+	assert(str2prefix_ipv4(prefix_str, &p) > 0);
+	rn = route_node_lookup(table, (struct prefix *)&p);
+	assert(rn && rn->info);
+
+	node = rn->info;
+	rn->info = NULL;
+	free(node->prefix_str);
+	free(node);
+	route_unlock_node(rn);
+	route_unlock_node(rn);
+}
+
+/*
+ * count_subtree
+ *
+ * Counts the nodes with info route_node_subtree() finds under prefix_str,
+ * or returns -1 if it finds none.
+ */
+static int count_subtree(struct route_table *table, const char *prefix_str)
+{
+	struct prefix_ipv4 p;
+	struct route_node *top, *rn;
+	int count = 0;
+
+	assert(str2prefix_ipv4(prefix_str, &p) > 0);
+	top = route_node_subtree(table, (struct prefix *)&p);
+	if (!top)
+		return -1;
+
+	for (rn = route_lock_node(top); rn; rn = route_next_until(rn, top)) {
+		assert(prefix_match((struct prefix *)&p, &rn->p));
+		if (rn->info)
+			count++;
+	}
+	route_unlock_node(top);
+	return count;
+}
+
+/*
+ * test_subtree
+ */
+static void test_subtree(void)
+{
+	struct route_table *table;
+	struct route_node *rn;
+	int nodes = 0;
+
+	printf("\n\nTesting route_node_subtree()\n");
+	table = route_table_init();
+	add_nodes(table, "10.1.0.0/16", "10.1.1.0/24", "10.1.2.0/24",
+		  "10.2.8.0/24", "192.168.0.0/24", NULL);
+	for (rn = route_top(table); rn; rn = route_next(rn))
+		nodes++;
+
+	assert(count_subtree(table, "0.0.0.0/0") == 5);
+	assert(count_subtree(table, "10.0.0.0/8") == 4);
+	assert(count_subtree(table, "10.1.0.0/16") == 3);
+	/* the internal node over 10.1.1.0/24 and 10.1.2.0/24 */
+	assert(count_subtree(table, "10.1.0.0/20") == 2);
+	assert(count_subtree(table, "10.2.0.0/16") == 1);
+	assert(count_subtree(table, "10.1.1.0/24") == 1);
+	assert(count_subtree(table, "10.1.1.1/32") == -1);
+	assert(count_subtree(table, "10.3.0.0/16") == -1);
+	assert(count_subtree(table, "11.0.0.0/8") == -1);
+
+	/* nothing was added */
+	for (rn = route_top(table); rn; rn = route_next(rn))
+		nodes--;
+	assert(nodes == 0);
+
+	clear_table(table);
+	route_table_finish(table);
+
+	printf("Verified subtree lookups\n");
+}
+
+struct walk_state {
+	struct route_table *table;
+	struct prefix last;
+	int visited, added_visited, ticks, done;
+};
+
+/*
+ * walk_tick
+ *
+ * Runs whenever the walk yielded, and changes the part of the table that
+ * was not walked yet.
+ */
+static int walk_tick(struct thread *t)
+{
+	struct walk_state *ws = THREAD_ARG(t);
+	char buf[PREFIX_STRLEN];
+
+	ws->ticks++;
+	snprintf(buf, sizeof(buf), "11.0.%d.0/24", ws->ticks);
+	add_node(ws->table, buf);
+	snprintf(buf, sizeof(buf), "10.7.%d.0/24", ws->ticks);
+	del_node(ws->table, buf);
+	return 0;
+}
+
+static int walk_node(struct route_node *rn, void *arg)
+{
+	struct walk_state *ws = arg;
+
+	if (!rn->info)
+		return 0;
+
+	if (ws->visited)
+		assert(route_table_prefix_iter_cmp(&ws->last, &rn->p) < 0);
+	prefix_copy(&ws->last, &rn->p);
+	ws->visited++;
+	if (rn->p.u.val[0] == 11)
+		ws->added_visited++;
+
+	/* overrun the time slot, the walk must yield after this node */
+	if (ws->visited % 500 == 0 && ws->visited < 2000) {
+		thread_add_event(master, walk_tick, ws, 0, NULL);
+		usleep(THREAD_YIELD_TIME_SLOT);
+	}
+	return 0;
+}
+
+static void walk_done(void *arg)
+{
+	struct walk_state *ws = arg;
+
+	ws->done = 1;
+}
+
+/*
+ * test_walk
+ */
+static void test_walk(void)
+{
+	struct route_table *table;
+	struct route_table_walk *walk = NULL;
+	struct walk_state ws = {};
+	struct thread t;
+	char buf[PREFIX_STRLEN];
+	int i;
+
+	printf("\n\nTesting resumable walks\n");
+	master = thread_master_create(NULL);
+	table = route_table_init();
+	for (i = 0; i < 2000; i++) {
+		snprintf(buf, sizeof(buf), "10.%d.%d.0/24", i / 250, i % 250);
+		add_node(table, buf);
+	}
+
+	/* cancelled before it ever ran */
+	route_table_walk_start(master, table, walk_node, walk_done, &ws,
+			       &walk);
+	assert(walk);
+	route_table_walk_cancel(&walk);
+	assert(!walk);
+
+	ws.table = table;
+	route_table_walk_start(master, table, walk_node, walk_done, &ws,
+			       &walk);
+	while (!ws.done && thread_fetch(master, &t))
+		thread_call(&t);
+
+	assert(!walk);
+	assert(ws.ticks == 3);
+	assert(ws.visited == 2000);
+	assert(ws.added_visited == 3);
+
+	clear_table(table);
+	route_table_finish(table);
+	thread_master_free(master);
+
+	printf("Verified resumable walk\n");
+}
+
 /*
  * run_tests
  */
@@ -500,6 +768,10 @@ static void run_tests(void)
 	test_prefix_iter_cmp();
 	test_get_next();
 	test_iter_pause();
+	test_match(AF_INET);
+	test_match(AF_INET6);
+	test_subtree();
+	test_walk();
 }
 
 /*
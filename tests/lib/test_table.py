@@ -8,3 +8,7 @@ for i in range(6):
 for i in range(11):
     TestTable.onesimple('Verifying successor')
 TestTable.onesimple('Verified pausing')
+for i in range(2):
+    TestTable.onesimple('Verified longest-prefix match')
+TestTable.onesimple('Verified subtree lookups')
+TestTable.onesimple('Verified resumable walk')
@@ -0,0 +1,165 @@
+/*
+ * Work-stealing task pool tests.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+#include <pthread.h>
+#include "memory.h"
+#include "thread.h"
+#include "frr_pthread.h"
+#include "taskpool.h"
+
+#define NWORKERS 4
+#define NITEMS 100000
+#define SPLIT 64
+
+static struct taskpool *pool;
+static struct taskgroup group;
+static uint64_t items[NITEMS];
+static _Atomic uint64_t sum;
+
+struct range {
+	unsigned int first, last;
+};
+static struct range ranges[NITEMS];
+static _Atomic unsigned int nranges;
+
+/* Sums its range, handing the upper half to the pool while large. */
+static void sum_range(void *arg)
+{
+	struct range *r = arg, *upper;
+	uint64_t s = 0;
+	unsigned int i;
+
+	while (r->last - r->first > SPLIT) {
+		upper = &ranges[atomic_fetch_add_explicit(
+			&nranges, 1, memory_order_relaxed)];
+		upper->first = (r->first + r->last) / 2;
+		upper->last = r->last;
+		r->last = upper->first;
+		taskgroup_add(&group, sum_range, upper);
+	}
+	for (i = r->first; i < r->last; i++)
+		s += items[i];
+	atomic_fetch_add_explicit(&sum, s, memory_order_relaxed);
+}
+
+static void bump(void *arg)
+{
+	atomic_fetch_add_explicit(&sum, (uintptr_t)arg, memory_order_relaxed);
+}
+
+static bool notified;
+
+static int notify_done(struct thread *t)
+{
+	assert(THREAD_ARG(t) == &group);
+	assert(atomic_load_explicit(&sum, memory_order_relaxed)
+	       == (uint64_t)NITEMS * (NITEMS + 1) / 2);
+	notified = true;
+	return 0;
+}
+
+/* keeps the event loop from running dry while workers are busy */
+static int notify_timeout(struct thread *t)
+{
+	assert(!"no notification");
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct thread_master *master;
+	struct thread *t_timeout = NULL;
+	struct thread t;
+	uint64_t expect = 0;
+	unsigned int i;
+
+	frr_pthread_init();
+	master = thread_master_create(NULL);
+	thread_add_timer(master, notify_timeout, NULL, 60, &t_timeout);
+
+	pool = taskpool_new("test pool", NWORKERS);
+	assert(pool && taskpool_workers(pool) == NWORKERS);
+
+	printf("Nested tasks...\n");
+	for (i = 0; i < NITEMS; i++) {
+		items[i] = random() % 1000;
+		expect += items[i];
+	}
+	taskgroup_init(&group, pool);
+	ranges[0].first = 0;
+	ranges[0].last = NITEMS;
+	nranges = 1;
+	taskgroup_add(&group, sum_range, &ranges[0]);
+	taskgroup_wait(&group);
+	assert(sum == expect);
+	/* waiting on an empty group returns at once */
+	taskgroup_wait(&group);
+	taskgroup_fini(&group);
+
+	printf("Notification...\n");
+	sum = 0;
+	taskgroup_init(&group, pool);
+	for (i = 1; i <= NITEMS; i++)
+		taskgroup_add(&group, bump, (void *)(uintptr_t)i);
+	taskgroup_notify(&group, master, notify_done, &group);
+	while (!notified && thread_fetch(master, &t))
+		thread_call(&t);
+	assert(notified);
+	taskgroup_fini(&group);
+
+	/* fires right away without tasks */
+	notified = false;
+	sum = (uint64_t)NITEMS * (NITEMS + 1) / 2;
+	taskgroup_init(&group, pool);
+	taskgroup_notify(&group, master, notify_done, &group);
+	while (!notified && thread_fetch(master, &t))
+		thread_call(&t);
+	taskgroup_fini(&group);
+
+	printf("Affinity...\n");
+	assert(taskpool_set_affinity(pool, "3-1") < 0);
+	assert(taskpool_set_affinity(pool, "0,") < 0);
+	assert(taskpool_set_affinity(pool, "x") < 0);
+	assert(taskpool_set_affinity(pool, "") < 0);
+	assert(taskpool_set_affinity(pool, "0,,1") < 0);
+	assert(taskpool_set_affinity(pool, "-1") < 0);
+	/* the same parser as "thread affinity" */
+	assert(thread_affinity_set("main", "0,") < 0);
+#ifdef GNU_LINUX
+	assert(taskpool_set_affinity(pool, "0") == 0);
+	assert(taskpool_set_affinity(pool, "0-1,0") == 0);
+#endif
+	/* pinned workers still run tasks */
+	sum = 0;
+	taskgroup_init(&group, pool);
+	for (i = 1; i <= 100; i++)
+		taskgroup_add(&group, bump, (void *)(uintptr_t)i);
+	taskgroup_wait(&group);
+	taskgroup_fini(&group);
+	assert(sum == 5050);
+	assert(taskpool_set_affinity(pool, NULL) == 0);
+
+	taskpool_del(pool);
+	THREAD_OFF(t_timeout);
+	thread_master_free(master);
+	frr_pthread_finish();
+
+	printf("Done.\n");
+	return 0;
+}
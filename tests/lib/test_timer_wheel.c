@@ -0,0 +1,117 @@
+/*
+ * Test that timers on the thread_master timer wheel never pop early,
+ * all pop, and cancelled ones don't.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "prng.h"
+#include "thread.h"
+
+#define SCHEDULE_TIMERS 400
+#define REMOVE_TIMERS   100
+
+struct thread_master *master;
+
+static struct prng *prng;
+static struct thread **timers;
+static struct thread *far_timer;
+static int timers_pending;
+static int errors;
+
+static void terminate_test(void)
+{
+	if (errors)
+		printf("%d timers popped early or more than once\n", errors);
+	else
+		printf("Timer wheel popped all timers in time.\n");
+
+	thread_cancel(far_timer);
+	thread_master_free(master);
+	prng_free(prng);
+	XFREE(MTYPE_TMP, timers);
+
+	exit(errors ? 1 : 0);
+}
+
+static int timer_func(struct thread *thread)
+{
+	struct timeval *due = thread->arg;
+
+	if (monotime_until(due, NULL) > 0)
+		errors++;
+	XFREE(MTYPE_TMP, due);
+
+	timers_pending--;
+	if (!timers_pending)
+		terminate_test();
+
+	return 0;
+}
+
+static int far_func(struct thread *thread)
+{
+	errors++;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct thread t;
+	int i;
+
+	master = thread_master_create(NULL);
+	thread_master_set_timer_wheel(master, true);
+
+	prng = prng_new(0);
+	timers = XCALLOC(MTYPE_TMP, SCHEDULE_TIMERS * sizeof(*timers));
+
+	/* parked on the top level, never due during the test */
+	thread_add_timer(master, far_func, NULL, 7 * 86400, &far_timer);
+
+	for (i = 0; i < SCHEDULE_TIMERS; i++) {
+		struct timeval *due = XMALLOC(MTYPE_TMP, sizeof(*due));
+
+		/* 1..3 seconds, i.e. all on the wheel */
+		thread_add_timer_msec(master, timer_func, due,
+				      1000 + prng_rand(prng) % 2000,
+				      &timers[i]);
+		*due = timers[i]->u.sands;
+		timers_pending++;
+	}
+
+	for (i = 0; i < REMOVE_TIMERS; i++) {
+		int index = prng_rand(prng) % SCHEDULE_TIMERS;
+
+		if (!timers[index])
+			continue;
+
+		XFREE(MTYPE_TMP, timers[index]->arg);
+		thread_cancel(timers[index]);
+		timers[index] = NULL;
+		timers_pending--;
+	}
+
+	while (thread_fetch(master, &t))
+		thread_call(&t);
+
+	return 0;
+}
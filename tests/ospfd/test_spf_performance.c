@@ -0,0 +1,317 @@
+/*
+ * Test program which measures the time SPF takes on a large area, both
+ * from scratch and when repairing the tree after a link metric changed,
+ * and checks that the repaired tree matches the one computed from
+ * scratch.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <zebra.h>
+
+#include "ospfd/ospf_spf.c"
+
+#include "prng.h"
+
+#define GRID_SIZE 60
+#define FULL_RUNS 20
+#define REPAIR_RUNS 200
+
+struct thread_master *master;
+struct zebra_privs_t ospfd_privs;
+
+static struct ospf *ospf;
+static struct ospf_area *area;
+static struct prng *prng;
+
+/* Routers are laid out on a square grid, each linked to its neighbours
+ * by point-to-point links with random metrics.
+ */
+static unsigned int grid = GRID_SIZE;
+static uint16_t *metric_right, *metric_down;
+
+static struct in_addr router_id(unsigned int r)
+{
+	struct in_addr id;
+
+	id.s_addr = htonl(0x0a000000 + r + 1);
+	return id;
+}
+
+/* Address of either end of the link numbered e, a /30 */
+static struct in_addr link_addr(unsigned int e, bool low)
+{
+	struct in_addr addr;
+
+	addr.s_addr = htonl(0xac100000 + e * 4 + (low ? 1 : 2));
+	return addr;
+}
+
+static void add_link(struct router_lsa_link *l, struct in_addr id,
+		     struct in_addr data, uint8_t type, uint16_t metric)
+{
+	l->link_id = id;
+	l->link_data = data;
+	l->m[0].type = type;
+	l->m[0].tos_count = 0;
+	l->m[0].metric = htons(metric);
+}
+
+static struct ospf_lsa *router_lsa_build(unsigned int r)
+{
+	unsigned int x = r % grid, y = r / grid;
+	struct router_lsa_link *l;
+	struct ospf_lsa *lsa;
+	struct router_lsa *rl;
+	uint16_t links = 0;
+	size_t length;
+	uint8_t *p;
+
+	length = OSPF_LSA_HEADER_SIZE + 4 + 5 * OSPF_ROUTER_LSA_LINK_SIZE;
+
+	lsa = ospf_lsa_new();
+	lsa->data = ospf_lsa_data_new(length);
+	lsa->area = area;
+
+	rl = (struct router_lsa *)lsa->data;
+	p = (uint8_t *)lsa->data + OSPF_LSA_HEADER_SIZE + 4;
+
+	/* The right and down links are numbered 2r and 2r + 1 */
+	if (x + 1 < grid) {
+		add_link((struct router_lsa_link *)p, router_id(r + 1),
+			 link_addr(2 * r, true), LSA_LINK_TYPE_POINTOPOINT,
+			 metric_right[r]);
+		p += OSPF_ROUTER_LSA_LINK_SIZE;
+		links++;
+	}
+	if (y + 1 < grid) {
+		add_link((struct router_lsa_link *)p, router_id(r + grid),
+			 link_addr(2 * r + 1, true),
+			 LSA_LINK_TYPE_POINTOPOINT, metric_down[r]);
+		p += OSPF_ROUTER_LSA_LINK_SIZE;
+		links++;
+	}
+	if (x > 0) {
+		add_link((struct router_lsa_link *)p, router_id(r - 1),
+			 link_addr(2 * (r - 1), false),
+			 LSA_LINK_TYPE_POINTOPOINT, metric_right[r - 1]);
+		p += OSPF_ROUTER_LSA_LINK_SIZE;
+		links++;
+	}
+	if (y > 0) {
+		add_link((struct router_lsa_link *)p, router_id(r - grid),
+			 link_addr(2 * (r - grid) + 1, false),
+			 LSA_LINK_TYPE_POINTOPOINT, metric_down[r - grid]);
+		p += OSPF_ROUTER_LSA_LINK_SIZE;
+		links++;
+	}
+
+	/* A loopback, but on the root which would need an interface for it */
+	if (r) {
+		l = (struct router_lsa_link *)p;
+		add_link(l, router_id(r), (struct in_addr){.s_addr = 0xffffffff},
+			 LSA_LINK_TYPE_STUB, 0);
+		p += OSPF_ROUTER_LSA_LINK_SIZE;
+		links++;
+	}
+
+	length = p - (uint8_t *)lsa->data;
+	rl->header.type = OSPF_ROUTER_LSA;
+	rl->header.id = router_id(r);
+	rl->header.adv_router = router_id(r);
+	rl->header.ls_seqnum = htonl(OSPF_INITIAL_SEQUENCE_NUMBER);
+	rl->header.length = htons(length);
+	rl->links = htons(links);
+
+	return lsa;
+}
+
+static void router_lsa_install(unsigned int r)
+{
+	struct ospf_lsa *lsa = router_lsa_build(r), *old;
+
+	/* As ospf_discard_from_db() does */
+	old = ospf_lsdb_lookup(area->lsdb, lsa);
+	if (old)
+		SET_FLAG(old->flags, OSPF_LSA_DISCARD);
+
+	ospf_lsdb_add(area->lsdb, lsa);
+	if (r == 0) {
+		ospf_lsa_unlock(&area->router_lsa_self);
+		area->router_lsa_self = ospf_lsa_lock(lsa);
+	}
+	ospf_lsa_unlock(&lsa);
+}
+
+/* The root's interfaces, one per link in its router-LSA */
+static void root_interface_add(int lsa_pos, unsigned int e)
+{
+	struct ospf_interface *oi;
+	struct prefix_ipv4 *addr;
+
+	oi = XCALLOC(MTYPE_TMP, sizeof(struct ospf_interface));
+	oi->ifp = XCALLOC(MTYPE_TMP, sizeof(struct interface));
+	snprintf(oi->ifp->name, sizeof(oi->ifp->name), "eth%d", lsa_pos);
+	oi->ifp->ifindex = lsa_pos + 1;
+	oi->connected = XCALLOC(MTYPE_TMP, sizeof(struct connected));
+
+	/* The nexthop is then found in the neighbour's router-LSA */
+	oi->type = OSPF_IFTYPE_POINTOMULTIPOINT;
+	addr = XCALLOC(MTYPE_TMP, sizeof(struct prefix_ipv4));
+	addr->family = AF_INET;
+	addr->prefixlen = 30;
+	addr->prefix = link_addr(e, true);
+	oi->address = (struct prefix *)addr;
+
+	oi->area = area;
+	oi->lsa_pos_beg = lsa_pos;
+	oi->lsa_pos_end = lsa_pos + 1;
+
+	listnode_add(area->oiflist, oi);
+	listnode_add(ospf->oiflist, oi);
+}
+
+static void topology_setup(void)
+{
+	unsigned int r, count = grid * grid;
+
+	ospf = XCALLOC(MTYPE_TMP, sizeof(struct ospf));
+	ospf->router_id = router_id(0);
+	ospf->areas = list_new();
+	ospf->oiflist = list_new();
+
+	area = XCALLOC(MTYPE_TMP, sizeof(struct ospf_area));
+	area->ospf = ospf;
+	area->lsdb = ospf_lsdb_new();
+	area->oiflist = list_new();
+	area->ranges = route_table_init();
+	listnode_add(ospf->areas, area);
+	ospf->backbone = area;
+
+	metric_right = XCALLOC(MTYPE_TMP, count * sizeof(uint16_t));
+	metric_down = XCALLOC(MTYPE_TMP, count * sizeof(uint16_t));
+	for (r = 0; r < count; r++) {
+		metric_right[r] = 1 + prng_rand(prng) % 10;
+		metric_down[r] = 1 + prng_rand(prng) % 10;
+	}
+
+	for (r = 0; r < count; r++)
+		router_lsa_install(r);
+
+	root_interface_add(0, 0);
+	root_interface_add(1, 1);
+}
+
+static void spf_run(bool repair)
+{
+	struct route_table *new_table, *new_rtrs;
+
+	new_table = route_table_init();
+	new_rtrs = route_table_init();
+
+	if (!repair || !ospf_spf_repair(ospf, area))
+		ospf_spf_calculate(ospf, area);
+	ospf_spf_routes_add(area, new_table, new_rtrs);
+
+	ospf_route_table_free(new_table);
+	ospf_rtrs_free(new_rtrs);
+}
+
+/* Distances from the root, as found on the area's tree */
+static void spf_distances(uint32_t *distances)
+{
+	unsigned int r;
+	struct vertex *v;
+
+	for (r = 0; r < grid * grid; r++) {
+		v = ospf_spf_tree_lookup(area, OSPF_VERTEX_ROUTER,
+					 router_id(r));
+		distances[r] = v ? v->distance : UINT32_MAX;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct timeval tv_start;
+	unsigned long t_full, t_repair;
+	uint32_t *repaired, *computed;
+	unsigned int r, i, errors = 0;
+
+	if (argc > 1)
+		grid = strtoul(argv[1], NULL, 10);
+	if (grid < 2 || grid > 1000) {
+		fprintf(stderr, "usage: %s [grid size, 2 to 1000]\n", argv[0]);
+		return 1;
+	}
+
+	master = thread_master_create(NULL);
+	prng = prng_new(0);
+
+	topology_setup();
+
+	monotime(&tv_start);
+	for (i = 0; i < FULL_RUNS; i++) {
+		ospf_spf_tree_free(area);
+		spf_run(false);
+	}
+	t_full = monotime_since(&tv_start, NULL) / FULL_RUNS;
+
+	printf("SPF on %u routers took %lu usecs, %u incremental runs\n",
+	       grid * grid, t_full, area->spf_incremental);
+
+	repaired = XCALLOC(MTYPE_TMP, grid * grid * sizeof(uint32_t));
+	computed = XCALLOC(MTYPE_TMP, grid * grid * sizeof(uint32_t));
+
+	/* Change the metric of random links, checking every so often that
+	 * the repaired tree is the one the full calculation would give.
+	 */
+	t_repair = 0;
+	for (i = 0; i < REPAIR_RUNS; i++) {
+		r = prng_rand(prng) % (grid * grid - grid);
+		metric_down[r] = 1 + prng_rand(prng) % 10;
+		router_lsa_install(r);
+		router_lsa_install(r + grid);
+
+		monotime(&tv_start);
+		spf_run(true);
+		t_repair += monotime_since(&tv_start, NULL);
+
+		if (i % 20)
+			continue;
+
+		spf_distances(repaired);
+		ospf_spf_tree_free(area);
+		spf_run(false);
+		spf_distances(computed);
+
+		for (r = 0; r < grid * grid; r++)
+			if (repaired[r] != computed[r]) {
+				printf("Router %s at distance %u, not %u\n",
+				       inet_ntoa(router_id(r)), repaired[r],
+				       computed[r]);
+				errors++;
+			}
+	}
+
+	printf("Repairing SPF on %u routers took %lu usecs, %u incremental runs\n",
+	       grid * grid, t_repair / REPAIR_RUNS, area->spf_incremental);
+	fflush(stdout);
+
+	XFREE(MTYPE_TMP, repaired);
+	XFREE(MTYPE_TMP, computed);
+	thread_master_free(master);
+	prng_free(prng);
+	return errors ? 1 : 0;
+}
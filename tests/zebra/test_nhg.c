@@ -0,0 +1,271 @@
+/*
+ * Nexthop group re-resolution tests
+ * Copyright (C) 2018 Cumulus Networks, Inc.
+ *
+ * This file is part of FRR.
+ *
+ * FRR is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * FRR is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * zebra has no library to link against; the file under test is built in,
+ * with the few zebra functions it calls stubbed out below.
+ */
+#include "zebra/zebra_memory.c"
+#include "zebra/zebra_nhg.c"
+
+unsigned long zebra_debug_nht;
+
+static bool route_map_set;
+
+/* nodes queued, and calls made for them */
+static unsigned int nqueued, ncalls;
+
+void rib_queue_add(struct route_node *rn)
+{
+	rib_dest_t *dest = rn->info;
+
+	ncalls++;
+	if (CHECK_FLAG(dest->flags, RIB_ROUTE_ANY_QUEUED))
+		return;
+	SET_FLAG(dest->flags, RIB_ROUTE_QUEUED(0));
+	nqueued++;
+}
+
+bool zebra_route_map_proto_set(afi_t afi, int rib_type)
+{
+	return route_map_set;
+}
+
+void kernel_nhg_release(struct nhg_hash_entry *nhe)
+{
+}
+
+static struct route_table *table;
+
+static struct route_entry *route_add(const char *prefix, int type,
+				     const char *gate1, const char *gate2)
+{
+	const char *gates[] = {gate1, gate2};
+	struct route_entry *re;
+	struct route_node *rn;
+	struct nexthop *nexthop;
+	rib_dest_t *dest;
+	struct prefix p;
+	unsigned int i;
+	int ret;
+
+	ret = str2prefix(prefix, &p);
+	assert(ret);
+	rn = route_node_get(table, &p);
+	if (!rn->info) {
+		dest = XCALLOC(MTYPE_RIB_DEST, sizeof(rib_dest_t));
+		dest->rnode = rn;
+		rn->info = dest;
+	} else
+		route_unlock_node(rn);
+	dest = rn->info;
+
+	re = XCALLOC(MTYPE_RE, sizeof(struct route_entry));
+	re->type = type;
+	re->vrf_id = VRF_DEFAULT;
+	for (i = 0; i < array_size(gates); i++) {
+		if (!gates[i])
+			continue;
+		nexthop = nexthop_new();
+		nexthop->type = NEXTHOP_TYPE_IPV4;
+		nexthop->vrf_id = VRF_DEFAULT;
+		ret = inet_pton(AF_INET, gates[i], &nexthop->gate.ipv4);
+		assert(ret == 1);
+		nexthop_add(&re->ng.nexthop, nexthop);
+	}
+	zebra_nhg_intern(re, AFI_IP, SAFI_UNICAST, &p, NULL);
+
+	/* what rib_link() does */
+	re->next = dest->routes;
+	if (dest->routes)
+		dest->routes->prev = re;
+	dest->routes = re;
+	zebra_nhg_link(rn, re);
+
+	/* as if the group was resolved already */
+	if (re->nhe)
+		re->nhe->resolved_epoch = zebra_nhg_epoch;
+
+	return re;
+}
+
+static void routes_free(void)
+{
+	struct route_entry *re, *next;
+	struct route_node *rn;
+	rib_dest_t *dest;
+
+	for (rn = route_top(table); rn; rn = route_next(rn)) {
+		dest = rn->info;
+		if (!dest)
+			continue;
+		for (re = dest->routes; re; re = next) {
+			next = re->next;
+			zebra_nhg_release(re);
+			XFREE(MTYPE_RE, re);
+		}
+		XFREE(MTYPE_RIB_DEST, dest);
+		rn->info = NULL;
+		route_unlock_node(rn);
+	}
+}
+
+static bool changed(const struct route_entry *re)
+{
+	return CHECK_FLAG(re->status, ROUTE_ENTRY_NEXTHOPS_CHANGED);
+}
+
+/* Report the gateways as changed, returns the number of nodes queued. */
+static unsigned int gates_changed(const char *gate1, const char *gate2)
+{
+	const char *gates[] = {gate1, gate2};
+	struct route_table *changed;
+	struct route_entry *re;
+	struct route_node *rn;
+	struct prefix p;
+	unsigned int i;
+	int ret;
+
+	for (rn = route_top(table); rn; rn = route_next(rn)) {
+		if (!rn->info)
+			continue;
+		UNSET_FLAG(rib_dest_from_rnode(rn)->flags,
+			   RIB_ROUTE_ANY_QUEUED);
+		RNODE_FOREACH_RE (rn, re)
+			re->status = 0;
+	}
+	nqueued = ncalls = 0;
+
+	changed = route_table_init();
+	for (i = 0; i < array_size(gates); i++) {
+		if (!gates[i])
+			continue;
+		ret = str2prefix(gates[i], &p);
+		assert(ret);
+		rn = route_node_get(changed, &p);
+		rn->info = rn;
+	}
+	zebra_nhg_nexthops_changed(VRF_DEFAULT, AF_INET, changed);
+	route_table_finish(changed);
+
+	return nqueued;
+}
+
+#define GW_A "192.0.2.1"
+#define GW_B "192.0.2.2"
+#define GW_C "192.0.2.3"
+
+static void test_shared(void)
+{
+	struct route_entry *a1, *a2, *a3, *b1, *b2, *ab;
+
+	printf("Shared groups are queued by gateway\n");
+
+	a1 = route_add("10.0.1.0/24", ZEBRA_ROUTE_BGP, GW_A, NULL);
+	a2 = route_add("10.0.2.0/24", ZEBRA_ROUTE_BGP, GW_A, NULL);
+	a3 = route_add("10.0.3.0/24", ZEBRA_ROUTE_BGP, GW_A, NULL);
+	b1 = route_add("10.1.1.0/24", ZEBRA_ROUTE_BGP, GW_B, NULL);
+	b2 = route_add("10.1.2.0/24", ZEBRA_ROUTE_BGP, GW_B, NULL);
+	ab = route_add("10.2.1.0/24", ZEBRA_ROUTE_BGP, GW_A, GW_B);
+	assert(a1->nhe && a1->nhe == a2->nhe && a1->nhe == a3->nhe);
+	assert(b1->nhe && b1->nhe == b2->nhe && ab->nhe);
+	assert(hashcount(zebra_nhg_gates) == 2);
+
+	assert(gates_changed(GW_A, NULL) == 4);
+	assert(changed(a1) && changed(a2) && changed(a3) && changed(ab));
+	assert(!changed(b1) && !changed(b2));
+	assert(!a1->nhe->resolved_epoch && !ab->nhe->resolved_epoch);
+	assert(b1->nhe->resolved_epoch == zebra_nhg_epoch);
+
+	/* the group over both gateways is only done once */
+	assert(gates_changed(GW_A, GW_B) == 6 && ncalls == 6);
+
+	/* a gateway nothing uses */
+	assert(gates_changed(GW_C, NULL) == 0);
+
+	/* an unshared route is found through its own gateways */
+	zebra_nhg_unshare(a1);
+	assert(!a1->nhe && listcount(a2->nhe->routes) == 2);
+	assert(gates_changed(GW_A, NULL) == 4);
+	assert(changed(a1) && changed(a2));
+
+	routes_free();
+	assert(hashcount(zebra_nhg_hash) == 0);
+	assert(hashcount(zebra_nhg_gates) == 0);
+}
+
+static void test_private(void)
+{
+	struct route_entry *bgp, *ospf, *ac;
+
+	printf("Private routes are queued by gateway\n");
+
+	route_map_set = true;
+	bgp = route_add("10.3.1.0/24", ZEBRA_ROUTE_BGP, GW_A, NULL);
+	ospf = route_add("10.3.1.0/24", ZEBRA_ROUTE_OSPF, GW_B, NULL);
+	ac = route_add("10.3.2.0/24", ZEBRA_ROUTE_BGP, GW_A, GW_C);
+	route_map_set = false;
+	assert(!bgp->nhe && !ospf->nhe && !ac->nhe);
+
+	/* of two routes on one node, only the one via GW_A */
+	assert(gates_changed(GW_A, NULL) == 2);
+	assert(changed(bgp) && !changed(ospf) && changed(ac));
+
+	assert(gates_changed(GW_B, NULL) == 1);
+	assert(!changed(bgp) && changed(ospf) && !changed(ac));
+
+	/* a route via two changed gateways is queued once */
+	assert(gates_changed(GW_A, GW_C) == 2 && changed(ac));
+	assert(gates_changed(GW_C, NULL) == 1);
+
+	routes_free();
+	assert(hashcount(zebra_nhg_gates) == 0);
+}
+
+static void test_system(void)
+{
+	struct route_entry *kernel, *stat;
+
+	printf("System and static routes are left to nexthop tracking\n");
+
+	kernel = route_add("10.4.1.0/24", ZEBRA_ROUTE_KERNEL, GW_A, NULL);
+	stat = route_add("10.4.2.0/24", ZEBRA_ROUTE_STATIC, GW_A, NULL);
+	assert(!kernel->nhe && !stat->nhe);
+
+	assert(gates_changed(GW_A, NULL) == 0);
+	assert(!changed(kernel) && !changed(stat));
+
+	routes_free();
+}
+
+int main(int argc, char **argv)
+{
+	table = route_table_init();
+	zebra_nhg_init();
+
+	test_shared();
+	test_private();
+	test_system();
+
+	route_table_finish(table);
+	printf("Done\n");
+	return 0;
+}
@@ -0,0 +1,6 @@
+import frrtest
+
+class TestNhg(frrtest.TestMultiOut):
+    program = './test_nhg'
+
+TestNhg.exit_cleanly()
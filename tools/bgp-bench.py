@@ -0,0 +1,613 @@
+#!/usr/bin/env python3
+#
+# BGP convergence benchmark
+# Copyright (C) 2018
+#
+# This file is part of FRR.
+#
+# FRR is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published by the
+# Free Software Foundation; either version 2, or (at your option) any
+# later version.
+#
+# FRR is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; see the file COPYING; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+#
+"""
+This program
+- reads a MRT TABLE_DUMP_V2 routing table dump, such as bgpd writes with
+  "dump bgp routes-mrt"
+- opens real BGP sessions to a running bgpd from several simulated eBGP
+  peers, each bound to its own local address
+- replays the dump's routes to bgpd from every peer, then optionally
+  withdraws them again
+- reports, for each phase, how long bgpd took to converge, the UPDATEs
+  per second it received and sent, its peak RSS and the CPU its threads
+  used, as "show thread cpu" gives it
+
+bgpd must have the simulated peers configured; --print-config writes the
+configuration it needs.  Peers use 127.0.0.2 and up by default, which
+Linux answers on without any further setup.
+"""
+
+import argparse
+import bz2
+import gzip
+import ipaddress
+import json
+import re
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+# MRT, RFC 6396
+MRT_TABLE_DUMP_V2 = 13
+PEER_INDEX_TABLE = 1
+RIB_IPV4_UNICAST = 2
+RIB_IPV6_UNICAST = 4
+
+# BGP
+BGP_OPEN = 1
+BGP_UPDATE = 2
+BGP_NOTIFICATION = 3
+BGP_KEEPALIVE = 4
+BGP_MAX_PACKET = 4096
+BGP_HEADER = 19
+AS_TRANS = 23456
+
+ATTR_FLAG_OPTIONAL = 0x80
+ATTR_FLAG_TRANSITIVE = 0x40
+ATTR_FLAG_EXTLEN = 0x10
+
+ATTR_ORIGIN = 1
+ATTR_AS_PATH = 2
+ATTR_NEXT_HOP = 3
+ATTR_LOCAL_PREF = 5
+ATTR_ORIGINATOR_ID = 9
+ATTR_CLUSTER_LIST = 10
+ATTR_MP_REACH = 14
+ATTR_MP_UNREACH = 15
+ATTR_AS4_PATH = 17
+ATTR_AS4_AGGREGATOR = 18
+
+AS_SEQUENCE = 2
+
+AFI_IP = 1
+AFI_IP6 = 2
+SAFI_UNICAST = 1
+
+# Attributes a route learnt over eBGP does not carry, or that are rebuilt
+DROPPED_ATTRS = (ATTR_LOCAL_PREF, ATTR_ORIGINATOR_ID, ATTR_CLUSTER_LIST,
+                 ATTR_MP_UNREACH, ATTR_AS4_PATH, ATTR_AS4_AGGREGATOR)
+
+
+def log(msg):
+    sys.stderr.write('%8.3f %s\n' % (time.time() - START, msg))
+    sys.stderr.flush()
+
+
+START = time.time()
+
+
+# MRT reading -----------------------------------------------------------------
+
+def mrt_open(path):
+    if path.endswith('.gz'):
+        return gzip.open(path, 'rb')
+    if path.endswith('.bz2'):
+        return bz2.BZ2File(path, 'rb')
+    return open(path, 'rb')
+
+
+def attrs_split(data):
+    """Yield (flags, type, value) for each path attribute in data"""
+    off = 0
+    while off + 3 <= len(data):
+        flags, atype = data[off], data[off + 1]
+        if flags & ATTR_FLAG_EXTLEN:
+            alen = struct.unpack_from('!H', data, off + 2)[0]
+            off += 4
+        else:
+            alen = data[off + 2]
+            off += 3
+        yield flags, atype, data[off:off + alen]
+        off += alen
+
+
+def attr_encode(flags, atype, value):
+    if len(value) > 255:
+        return struct.pack('!BBH', flags | ATTR_FLAG_EXTLEN, atype,
+                           len(value)) + value
+    return struct.pack('!BBB', flags & ~ATTR_FLAG_EXTLEN, atype,
+                       len(value)) + value
+
+
+class Table(object):
+    """The routes of a TABLE_DUMP_V2 dump, as RIB entries per prefix"""
+
+    def __init__(self):
+        self.peers = 0
+        # (afi, prefix NLRI bytes) -> {peer index: attributes}
+        self.routes = {}
+
+    def load(self, path, limit):
+        with mrt_open(path) as f:
+            while not limit or len(self.routes) < limit:
+                hdr = f.read(12)
+                if len(hdr) < 12:
+                    break
+                _, mtype, subtype, mlen = struct.unpack('!IHHI', hdr)
+                body = f.read(mlen)
+                if len(body) < mlen:
+                    break
+                if mtype != MRT_TABLE_DUMP_V2:
+                    continue
+                if subtype == PEER_INDEX_TABLE:
+                    self.peer_index(body)
+                elif subtype == RIB_IPV4_UNICAST:
+                    self.rib(AFI_IP, body)
+                elif subtype == RIB_IPV6_UNICAST:
+                    self.rib(AFI_IP6, body)
+
+    def peer_index(self, body):
+        namelen = struct.unpack_from('!H', body, 4)[0]
+        self.peers = struct.unpack_from('!H', body, 6 + namelen)[0]
+
+    def rib(self, afi, body):
+        plen = body[4]
+        pbytes = (plen + 7) // 8
+        nlri = bytes(body[4:5 + pbytes])
+        off = 5 + pbytes
+        count = struct.unpack_from('!H', body, off)[0]
+        off += 2
+        entries = self.routes.setdefault((afi, nlri), {})
+        for _ in range(count):
+            index, _, alen = struct.unpack_from('!HIH', body, off)
+            off += 8
+            entries[index] = bytes(body[off:off + alen])
+            off += alen
+
+
+# Simulated peers -------------------------------------------------------------
+
+class Peer(object):
+    def __init__(self, args, num):
+        self.args = args
+        self.num = num
+        self.asn = args.peer_as + num
+        self.addr = str(ipaddress.ip_address(args.local_base) + num)
+        self.sock = None
+        self.lock = threading.Lock()
+        self.established = threading.Event()
+        self.closed = False
+
+        # UPDATEs built for the table, per afi, and their prefix counts
+        self.updates = []
+        self.withdraws = []
+        self.prefixes = {AFI_IP: 0, AFI_IP6: 0}
+
+        self.updates_sent = 0
+        self.updates_rcvd = 0
+        self.last_rcvd = 0.0
+
+    def attrs_rewrite(self, afi, raw):
+        """Turn attributes as dumped into what this peer would send"""
+        out = []
+        mp_nexthop = None
+        for flags, atype, value in attrs_split(raw):
+            if atype in DROPPED_ATTRS:
+                continue
+            if atype == ATTR_AS_PATH:
+                value = aspath_prepend(value, self.asn)
+            elif atype == ATTR_NEXT_HOP:
+                if afi != AFI_IP:
+                    continue
+                if not self.args.keep_nexthop:
+                    value = socket.inet_aton(self.addr)
+            elif atype == ATTR_MP_REACH:
+                # The dump only keeps the nexthop, RFC 6396 4.3.4
+                mp_nexthop = value[1:1 + value[0]]
+                continue
+            out.append(attr_encode(flags, atype, value))
+
+        if afi == AFI_IP6:
+            if self.args.ipv6_nexthop:
+                mp_nexthop = socket.inet_pton(socket.AF_INET6,
+                                              self.args.ipv6_nexthop)
+            if not mp_nexthop:
+                return None
+        return b''.join(out), mp_nexthop
+
+    def build(self, table, npeers):
+        """Pack the routes this peer advertises into UPDATEs"""
+        groups = {}
+        for (afi, nlri), entries in table.routes.items():
+            index = self.num % table.peers if table.peers else 0
+            raw = entries.get(index)
+            if raw is None:
+                raw = next(iter(entries.values()))
+            attrs = self.attrs_rewrite(afi, raw)
+            if attrs is None:
+                continue
+            groups.setdefault((afi, attrs), []).append(nlri)
+            self.prefixes[afi] += 1
+
+        for (afi, (attrs, mp_nexthop)), nlris in groups.items():
+            for chunk in nlri_chunks(nlris,
+                                     BGP_MAX_PACKET - BGP_HEADER - 4 -
+                                     len(attrs) - 64):
+                self.updates.append(update_reach(afi, attrs, mp_nexthop,
+                                                 chunk))
+                self.withdraws.append(update_unreach(afi, chunk))
+
+    def connect(self):
+        args = self.args
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.sock.bind((self.addr, 0))
+        self.sock.connect((args.bgpd, args.port))
+
+        caps = capability(1, struct.pack('!HBB', AFI_IP, 0, SAFI_UNICAST))
+        if self.prefixes[AFI_IP6]:
+            caps += capability(1, struct.pack('!HBB', AFI_IP6, 0,
+                                              SAFI_UNICAST))
+        caps += capability(2, b'')
+        caps += capability(65, struct.pack('!I', self.asn))
+        opt = struct.pack('!BB', 2, len(caps)) + caps
+        body = struct.pack('!BHH4sB', 4, self.asn if self.asn < 65536
+                           else AS_TRANS, args.hold_time,
+                           socket.inet_aton(self.addr), len(opt)) + opt
+        self.send(message(BGP_OPEN, body))
+
+        threading.Thread(target=self.reader, daemon=True).start()
+        threading.Thread(target=self.keepalives, daemon=True).start()
+
+    def send(self, data):
+        with self.lock:
+            self.sock.sendall(data)
+
+    def reader(self):
+        buf = b''
+        while True:
+            try:
+                data = self.sock.recv(65536)
+            except OSError:
+                data = b''
+            if not data:
+                break
+            buf += data
+            while len(buf) >= BGP_HEADER:
+                mlen, mtype = struct.unpack_from('!HB', buf, 16)
+                if len(buf) < mlen:
+                    break
+                msg, buf = buf[:mlen], buf[mlen:]
+                if mtype == BGP_OPEN:
+                    self.send(message(BGP_KEEPALIVE, b''))
+                elif mtype == BGP_KEEPALIVE:
+                    self.established.set()
+                elif mtype == BGP_UPDATE:
+                    self.updates_rcvd += 1
+                    self.last_rcvd = time.time()
+                elif mtype == BGP_NOTIFICATION:
+                    log('peer %s: notification %d/%d from bgpd' %
+                        (self.addr, msg[19], msg[20]))
+        self.closed = True
+        self.established.set()
+
+    def keepalives(self):
+        while not self.closed:
+            time.sleep(self.args.hold_time / 3.0)
+            try:
+                self.send(message(BGP_KEEPALIVE, b''))
+            except OSError:
+                break
+
+    def replay(self, updates):
+        for msg in updates:
+            self.send(msg)
+            self.updates_sent += 1
+        # End-of-RIB
+        self.send(message(BGP_UPDATE, struct.pack('!HH', 0, 0)))
+        if self.prefixes[AFI_IP6]:
+            self.send(update_unreach(AFI_IP6, []))
+
+
+def aspath_prepend(value, asn):
+    if len(value) >= 2 and value[0] == AS_SEQUENCE and value[1] < 255:
+        return struct.pack('!BBI', AS_SEQUENCE, value[1] + 1, asn) + \
+            value[2:]
+    return struct.pack('!BBI', AS_SEQUENCE, 1, asn) + value
+
+
+def nlri_chunks(nlris, room):
+    chunk, size = [], 0
+    for nlri in nlris:
+        if chunk and size + len(nlri) > room:
+            yield chunk
+            chunk, size = [], 0
+        chunk.append(nlri)
+        size += len(nlri)
+    if chunk:
+        yield chunk
+
+
+def message(mtype, body):
+    return b'\xff' * 16 + struct.pack('!HB', BGP_HEADER + len(body),
+                                      mtype) + body
+
+
+def capability(code, value):
+    return struct.pack('!BB', code, len(value)) + value
+
+
+def update_reach(afi, attrs, mp_nexthop, nlris):
+    if afi == AFI_IP:
+        return message(BGP_UPDATE, struct.pack('!HH', 0, len(attrs)) +
+                       attrs + b''.join(nlris))
+    mp = struct.pack('!HBB', AFI_IP6, SAFI_UNICAST, len(mp_nexthop)) + \
+        mp_nexthop + b'\x00' + b''.join(nlris)
+    attrs += attr_encode(ATTR_FLAG_OPTIONAL, ATTR_MP_REACH, mp)
+    return message(BGP_UPDATE, struct.pack('!HH', 0, len(attrs)) + attrs)
+
+
+def update_unreach(afi, nlris):
+    if afi == AFI_IP:
+        withdrawn = b''.join(nlris)
+        return message(BGP_UPDATE, struct.pack('!H', len(withdrawn)) +
+                       withdrawn + struct.pack('!H', 0))
+    attrs = attr_encode(ATTR_FLAG_OPTIONAL, ATTR_MP_UNREACH,
+                        struct.pack('!HB', AFI_IP6, SAFI_UNICAST) +
+                        b''.join(nlris))
+    return message(BGP_UPDATE, struct.pack('!HH', 0, len(attrs)) + attrs)
+
+
+# bgpd side -------------------------------------------------------------------
+
+class Bgpd(object):
+    def __init__(self, args):
+        self.args = args
+        self.pid = args.pid
+        if not self.pid:
+            try:
+                with open(args.pid_file) as f:
+                    self.pid = int(f.read().strip())
+            except (IOError, ValueError):
+                log('no pid for bgpd, RSS will not be reported')
+
+    def vtysh(self, cmd):
+        return subprocess.check_output(self.args.vtysh + ['-d', 'bgpd', '-c',
+                                                          cmd]).decode()
+
+    def summary(self, afi):
+        cmd = 'show bgp %s unicast summary json' % \
+            ('ipv4' if afi == AFI_IP else 'ipv6')
+        try:
+            return json.loads(self.vtysh(cmd))
+        except (subprocess.CalledProcessError, ValueError):
+            return {}
+
+    def memory(self):
+        """Current and peak resident memory, in kB"""
+        rss = hwm = None
+        if not self.pid:
+            return rss, hwm
+        try:
+            with open('/proc/%d/status' % self.pid) as f:
+                for line in f:
+                    if line.startswith('VmRSS:'):
+                        rss = int(line.split()[1])
+                    elif line.startswith('VmHWM:'):
+                        hwm = int(line.split()[1])
+        except IOError:
+            pass
+        return rss, hwm
+
+    def cpu_clear(self):
+        self.vtysh('clear thread cpu')
+
+    def cpu(self):
+        """Per pthread, CPU msecs of each thread function since cleared"""
+        stats, pthread = {}, None
+        line_re = re.compile(r'^\s*\d+\s+(\d+)\.(\d+)\s+(\d+)\s+\d+\s+\d+'
+                             r'\s+\d+\s+\d+ (.{5}) (\S+)$')
+        for line in self.vtysh('show thread cpu').splitlines():
+            if line.startswith('Showing statistics for pthread '):
+                pthread = line[len('Showing statistics for pthread '):]
+                stats[pthread] = {}
+            elif line.startswith('Total thread statistics'):
+                pthread = None
+            elif pthread:
+                m = line_re.match(line)
+                if m:
+                    msecs = int(m.group(1)) + int(m.group(2)) / 1000.0
+                    stats[pthread][m.group(5)] = (msecs, int(m.group(3)))
+        return stats
+
+
+# Phases ----------------------------------------------------------------------
+
+class Phase(object):
+    def __init__(self, name, bgpd, peers):
+        self.name = name
+        self.bgpd = bgpd
+        self.peers = peers
+        self.sent = sum(p.updates_sent for p in peers)
+        self.rcvd = sum(p.updates_rcvd for p in peers)
+        bgpd.cpu_clear()
+        self.start = time.time()
+
+    def converged(self, expected):
+        """Whether bgpd holds expected prefixes from each peer, per afi,
+        and has nothing left to send"""
+        for afi in (AFI_IP, AFI_IP6):
+            if not any(p.prefixes[afi] for p in self.peers):
+                continue
+            summary = self.bgpd.summary(afi)
+            neighbors = summary.get('peers', {})
+            for p in self.peers:
+                n = neighbors.get(p.addr)
+                if not n or n.get('outq', 0) or \
+                   n.get('prefixReceivedCount', 0) != expected(p, afi):
+                    return False
+        return True
+
+    def wait(self, expected):
+        args = self.bgpd.args
+        deadline = self.start + args.timeout
+        while time.time() < deadline:
+            if self.converged(expected):
+                break
+            time.sleep(args.poll)
+        else:
+            log('%s: not converged after %d seconds' %
+                (self.name, args.timeout))
+        done = time.time()
+
+        # bgpd may still be sending what it computed, wait for it to
+        # stop before counting the UPDATEs it sent
+        while time.time() - max([p.last_rcvd for p in self.peers] +
+                                [done]) < args.quiet:
+            time.sleep(args.poll)
+        return done
+
+    def report(self, done):
+        elapsed = done - self.start
+        sent = sum(p.updates_sent for p in self.peers) - self.sent
+        rcvd = sum(p.updates_rcvd for p in self.peers) - self.rcvd
+        rss, hwm = self.bgpd.memory()
+
+        print('%s:' % self.name)
+        print('  converged in %.3f secs' % elapsed)
+        print('  UPDATEs in:  %d, %.0f/sec' % (sent, sent / elapsed))
+        print('  UPDATEs out: %d, %.0f/sec' % (rcvd, rcvd / elapsed))
+        if rss is not None:
+            print('  RSS %d kB, peak %d kB' % (rss, hwm))
+
+        for pthread, funcs in sorted(self.bgpd.cpu().items()):
+            total = sum(msecs for msecs, _ in funcs.values())
+            print('  pthread %s: %.3f CPU msecs' % (pthread, total))
+            top = sorted(funcs.items(), key=lambda f: -f[1][0])
+            for func, (msecs, calls) in top[:self.bgpd.args.top]:
+                print('    %10.3f ms %9d calls  %s' % (msecs, calls, func))
+        sys.stdout.flush()
+
+
+def print_config(args, peers):
+    print('router bgp %d' % args.local_as)
+    print(' bgp router-id %s' % args.bgpd)
+    for p in peers:
+        print(' neighbor %s remote-as %d' % (p.addr, p.asn))
+    for afi in ('ipv4', 'ipv6'):
+        print(' address-family %s unicast' % afi)
+        for p in peers:
+            if afi == 'ipv6':
+                print('  neighbor %s activate' % p.addr)
+            if args.soft_reconfig:
+                print('  neighbor %s soft-reconfiguration inbound' % p.addr)
+        print(' exit-address-family')
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Measure bgpd convergence on a replayed MRT table dump')
+    parser.add_argument('mrt', help='TABLE_DUMP_V2 file, may be .gz or .bz2')
+    parser.add_argument('--peers', type=int, default=4,
+                        help='simulated peers (default 4)')
+    parser.add_argument('--limit', type=int, default=0,
+                        help='only replay the first LIMIT prefixes')
+    parser.add_argument('--bgpd', default='127.0.0.1',
+                        help='address bgpd listens on')
+    parser.add_argument('--port', type=int, default=179)
+    parser.add_argument('--local-as', type=int, default=64512,
+                        help='the AS bgpd is in')
+    parser.add_argument('--peer-as', type=int, default=65001,
+                        help='AS of the first peer, the next ones count up')
+    parser.add_argument('--local-base', default='127.0.0.2',
+                        help='address of the first peer')
+    parser.add_argument('--hold-time', type=int, default=180)
+    parser.add_argument('--keep-nexthop', action='store_true',
+                        help='keep the IPv4 nexthops of the dump')
+    parser.add_argument('--ipv6-nexthop',
+                        help='nexthop of the IPv6 routes instead of the '
+                        'dump\'s')
+    parser.add_argument('--withdraw', action='store_true',
+                        help='then withdraw everything and time that too')
+    parser.add_argument('--vtysh', default='vtysh', type=lambda s: s.split(),
+                        help='vtysh command line')
+    parser.add_argument('--pid', type=int, help='pid of bgpd')
+    parser.add_argument('--pid-file', default='/var/run/frr/bgpd.pid')
+    parser.add_argument('--timeout', type=int, default=600,
+                        help='seconds to wait for each phase to converge')
+    parser.add_argument('--poll', type=float, default=0.2,
+                        help='seconds between looks at bgpd')
+    parser.add_argument('--quiet', type=float, default=1.0,
+                        help='seconds without UPDATEs from bgpd for it to '
+                        'be done sending')
+    parser.add_argument('--top', type=int, default=5,
+                        help='thread functions to show per pthread')
+    parser.add_argument('--soft-reconfig', action='store_true',
+                        help='with --print-config, keep Adj-RIB-In')
+    parser.add_argument('--print-config', action='store_true',
+                        help='print the bgpd configuration this needs')
+    args = parser.parse_args()
+
+    peers = [Peer(args, i) for i in range(args.peers)]
+    if args.print_config:
+        print_config(args, peers)
+        return 0
+
+    table = Table()
+    table.load(args.mrt, args.limit)
+    log('%d prefixes from %d peers in %s' %
+        (len(table.routes), table.peers, args.mrt))
+    for p in peers:
+        p.build(table, len(peers))
+    log('%d UPDATEs built per peer' % len(peers[0].updates))
+
+    bgpd = Bgpd(args)
+
+    phase = Phase('establish', bgpd, peers)
+    for p in peers:
+        p.connect()
+    for p in peers:
+        p.established.wait(args.timeout)
+        if p.closed:
+            log('peer %s: session closed, is it configured?' % p.addr)
+            return 1
+    phase.report(time.time())
+
+    phase = Phase('load', bgpd, peers)
+    threads = [threading.Thread(target=p.replay, args=(p.updates,))
+               for p in peers]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    log('all UPDATEs sent')
+    phase.report(phase.wait(lambda p, afi: p.prefixes[afi]))
+
+    if args.withdraw:
+        phase = Phase('withdraw', bgpd, peers)
+        threads = [threading.Thread(target=p.replay, args=(p.withdraws,))
+                   for p in peers]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        log('all withdraws sent')
+        phase.report(phase.wait(lambda p, afi: 0))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
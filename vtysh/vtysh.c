@@ -55,6 +55,9 @@ struct vty *vty;
 /* VTY shell pager name. */
 char *vtysh_pager_name = NULL;
 
+/* Config lines sent to a daemon ahead of their replies, at most */
+#define VTYSH_PIPELINE_DEPTH 64
+
 /* VTY shell client structure. */
 struct vtysh_client {
 	int fd;
@@ -62,6 +65,13 @@ struct vtysh_client {
 	int flag;
 	char path[MAXPATHLEN];
 	struct vtysh_client *next;
+
+	/* config lines awaiting their reply, oldest at pending_head; see
+	 * vtysh_client_send() */
+	unsigned int inflight;
+	unsigned int pending_head;
+	int pending_lineno[VTYSH_PIPELINE_DEPTH];
+	char *pending_line[VTYSH_PIPELINE_DEPTH];
 };
 
 struct vtysh_client vtysh_client[] = {
@@ -94,6 +104,13 @@ static void vclient_close(struct vtysh_client *vclient)
 		close(vclient->fd);
 		vclient->fd = -1;
 	}
+
+	for (; vclient->inflight; vclient->inflight--) {
+		XFREE(MTYPE_VTYSH_CMD,
+		      vclient->pending_line[vclient->pending_head]);
+		vclient->pending_head =
+			(vclient->pending_head + 1) % VTYSH_PIPELINE_DEPTH;
+	}
 }
 
 /* Return true if str begins with prefix, else return false */
@@ -108,9 +125,12 @@ static int begins_with(const char *str, const char *prefix)
 	return strncmp(str, prefix, lenprefix) == 0;
 }
 
-static int vtysh_client_run(struct vtysh_client *vclient, const char *line,
-			    FILE *fp, void (*callback)(void *, const char *),
-			    void *cbarg)
+static int vtysh_client_drain(struct vtysh_client *vclient);
+
+/* Reads a command's output and result from vclient. */
+static int vtysh_client_reply(struct vtysh_client *vclient, FILE *fp,
+			      void (*callback)(void *, const char *),
+			      void *cbarg)
 {
 	int ret;
 	char stackbuf[4096];
@@ -119,13 +139,6 @@ static int vtysh_client_run(struct vtysh_client *vclient, const char *line,
 	char *bufvalid, *end = NULL;
 	char terminator[3] = {0, 0, 0};
 
-	if (vclient->fd < 0)
-		return CMD_SUCCESS;
-
-	ret = write(vclient->fd, line, strlen(line) + 1);
-	if (ret <= 0)
-		goto out_err;
-
 	bufvalid = buf;
 	do {
 		ssize_t nread =
@@ -257,6 +270,113 @@ out:
 	return ret;
 }
 
+static int vtysh_client_run(struct vtysh_client *vclient, const char *line,
+			    FILE *fp, void (*callback)(void *, const char *),
+			    void *cbarg)
+{
+	/* replies to pipelined lines come first */
+	vtysh_client_drain(vclient);
+
+	if (vclient->fd < 0)
+		return CMD_SUCCESS;
+
+	if (write(vclient->fd, line, strlen(line) + 1) <= 0) {
+		vclient_close(vclient);
+		return CMD_SUCCESS;
+	}
+
+	return vtysh_client_reply(vclient, fp, callback, cbarg);
+}
+
+/* Reads the reply to the oldest config line in flight to vclient, and
+ * reports it if the line failed; returns its result. */
+static int vtysh_client_pending_reply(struct vtysh_client *vclient)
+{
+	unsigned int slot = vclient->pending_head;
+	char *line = vclient->pending_line[slot];
+	int lineno = vclient->pending_lineno[slot];
+	int ret;
+
+	vclient->pending_head = (slot + 1) % VTYSH_PIPELINE_DEPTH;
+	vclient->inflight--;
+
+	ret = vtysh_client_reply(vclient, outputfile, NULL, NULL);
+	if (ret != CMD_SUCCESS && ret != CMD_WARNING)
+		fprintf(stderr,
+			"line %d: Failure to communicate[%d] to %s, line: %s\n",
+			lineno, ret, vclient->name, line);
+
+	XFREE(MTYPE_VTYSH_CMD, line);
+	return ret;
+}
+
+/* Waits for the replies to all config lines in flight to vclient; returns
+ * the last failure among them, if any. */
+static int vtysh_client_drain(struct vtysh_client *vclient)
+{
+	int ret, rc = CMD_SUCCESS;
+
+	while (vclient->inflight) {
+		ret = vtysh_client_pending_reply(vclient);
+		if (ret != CMD_SUCCESS && ret != CMD_WARNING)
+			rc = ret;
+	}
+	return rc;
+}
+
+/*
+ * Sends a config line to vclient without waiting for its reply, so that
+ * the daemon always has lines queued up and all daemons work through a
+ * config at the same time.  Replies are read, and failures reported, once
+ * VTYSH_PIPELINE_DEPTH lines are in flight or by vtysh_client_drain();
+ * returns the last failure among those read here.
+ */
+static int vtysh_client_send(struct vtysh_client *vclient, const char *line,
+			     int lineno)
+{
+	int ret, rc = CMD_SUCCESS;
+	unsigned int slot;
+
+	if (vclient->fd < 0)
+		return CMD_SUCCESS;
+
+	if (vclient->inflight == VTYSH_PIPELINE_DEPTH) {
+		ret = vtysh_client_pending_reply(vclient);
+		if (ret != CMD_SUCCESS && ret != CMD_WARNING)
+			rc = ret;
+		if (vclient->fd < 0)
+			return rc;
+	}
+
+	if (write(vclient->fd, line, strlen(line) + 1) <= 0) {
+		vclient_close(vclient);
+		return rc;
+	}
+
+	slot = (vclient->pending_head + vclient->inflight)
+	       % VTYSH_PIPELINE_DEPTH;
+	vclient->pending_line[slot] = XSTRDUP(MTYPE_VTYSH_CMD, line);
+	vclient->pending_lineno[slot] = lineno;
+	vclient->inflight++;
+	return rc;
+}
+
+/* Waits for the replies to the config lines in flight to all daemons. */
+static int vtysh_config_sync(void)
+{
+	struct vtysh_client *client;
+	int ret, rc = CMD_SUCCESS;
+	size_t i;
+
+	for (i = 0; i < array_size(vtysh_client); i++)
+		for (client = &vtysh_client[i]; client; client = client->next) {
+			ret = vtysh_client_drain(client);
+			if (ret != CMD_SUCCESS)
+				rc = ret;
+		}
+	return rc;
+}
+
 static int vtysh_client_run_all(struct vtysh_client *head_client,
 				const char *line, int continue_on_err, FILE *fp,
 				void (*callback)(void *, const char *),
@@ -295,6 +415,19 @@ static int vtysh_client_execute(struct vtysh_client *head_client,
 	return vtysh_client_run_all(head_client, line, 0, fp, NULL, NULL);
 }
 
+/* Brackets a whole config fed to the daemons, so they can hold back what
+ * is only worth doing once it's all in; see cmd_config_begin() */
+void vtysh_config_transaction(bool start)
+{
+	const char *line = start ? "XFRR_start_configuration"
+				 : "XFRR_end_configuration";
+	size_t i;
+
+	for (i = 0; i < array_size(vtysh_client); i++)
+		vtysh_client_run_all(&vtysh_client[i], line, 1, NULL, NULL,
+				     NULL);
+}
+
 static void vtysh_client_config(struct vtysh_client *head_client, char *line)
 {
 	/* watchfrr currently doesn't load any config, and has some hardcoded
@@ -804,6 +937,45 @@ int vtysh_config_from_file(struct vty *vty, FILE *fp)
 			unsigned int i;
 			int cmd_stat = CMD_SUCCESS;
 
+			/*
+			 * Lines within a node are pipelined to the daemons,
+			 * except to multi-instance ones, whose replies tell
+			 * which instance took a line.  Lines moving between
+			 * nodes are mirrored here only if the daemons took
+			 * them, so they wait for all replies.
+			 */
+			if (!cmd->func) {
+				for (i = 0; i < array_size(vtysh_client); i++) {
+					if (!(cmd->daemon & vtysh_client[i].flag))
+						continue;
+					if (!vtysh_client[i].next) {
+						cmd_stat = vtysh_client_send(
+							&vtysh_client[i],
+							vty->buf, lineno);
+						if (cmd_stat != CMD_SUCCESS)
+							retcode = cmd_stat;
+						continue;
+					}
+					cmd_stat = vtysh_client_execute(
+						&vtysh_client[i], vty->buf,
+						outputfile);
+					if (cmd_stat != CMD_SUCCESS
+					    && cmd_stat != CMD_WARNING) {
+						fprintf(stderr,
+							"line %d: Failure to communicate[%d] to %s, line: %s\n",
+							lineno, cmd_stat,
+							vtysh_client[i].name,
+							vty->buf);
+						retcode = cmd_stat;
+					}
+				}
+				break;
+			}
+
+			ret = vtysh_config_sync();
+			if (ret != CMD_SUCCESS)
+				retcode = ret;
+
 			for (i = 0; i < array_size(vtysh_client); i++) {
 				if (cmd->daemon & vtysh_client[i].flag) {
 					cmd_stat = vtysh_client_execute(
@@ -843,6 +1015,10 @@ int vtysh_config_from_file(struct vty *vty, FILE *fp)
 		}
 	}
 
+	ret = vtysh_config_sync();
+	if (ret != CMD_SUCCESS)
+		retcode = ret;
+
 	return (retcode);
 }
 
@@ -2031,6 +2207,99 @@ DEFUN (vtysh_show_thread,
 	return ret;
 }
 
+DEFUN (vtysh_show_thread_latency,
+       vtysh_show_thread_latency_cmd,
+       "show thread <cpu histogram|slow-trace> [json]",
+       SHOW_STR
+       "Thread information\n"
+       "Thread CPU usage\n"
+       "Wall-clock runtime and scheduling delay histograms\n"
+       "Last tasks that ran at least as long as configured\n"
+       "JavaScript Object Notation\n")
+{
+	unsigned int i;
+	int ret = CMD_SUCCESS;
+	char line[100] = "do show thread";
+	int idx;
+
+	for (idx = 2; idx < argc; idx++) {
+		strlcat(line, " ", sizeof(line));
+		strlcat(line, argv[idx]->text, sizeof(line));
+	}
+	strlcat(line, "\n", sizeof(line));
+
+	for (i = 0; i < array_size(vtysh_client); i++)
+		if (vtysh_client[i].fd >= 0) {
+			fprintf(stdout, "Thread statistics for %s:\n",
+				vtysh_client[i].name);
+			ret = vtysh_client_execute(&vtysh_client[i], line,
+						   outputfile);
+			fprintf(stdout, "\n");
+		}
+	return ret;
+}
+
+/* Runs the command, as given, on all daemons. */
+static int vtysh_argv_all(int argc, struct cmd_token *argv[],
+			  const char *header)
+{
+	unsigned int i;
+	int ret = CMD_SUCCESS;
+	char line[128] = "do";
+	int idx;
+
+	for (idx = 0; idx < argc; idx++) {
+		strlcat(line, " ", sizeof(line));
+		strlcat(line, argv[idx]->arg, sizeof(line));
+	}
+	strlcat(line, "\n", sizeof(line));
+
+	for (i = 0; i < array_size(vtysh_client); i++)
+		if (vtysh_client[i].fd >= 0) {
+			if (header)
+				fprintf(stdout, "%s for %s:\n", header,
+					vtysh_client[i].name);
+			ret = vtysh_client_execute(&vtysh_client[i], line,
+						   outputfile);
+			if (header)
+				fprintf(stdout, "\n");
+		}
+	return ret;
+}
+
+DEFUN (vtysh_show_trace,
+       vtysh_show_trace_cmd,
+       "show <trace [WORD]|tracepoints>",
+       SHOW_STR
+       "Recorded tracepoints\n"
+       "Only this tracepoint\n"
+       "Tracepoints and their counters\n")
+{
+	return vtysh_argv_all(argc, argv, "Tracepoints");
+}
+
+DEFUN (vtysh_debug_trace,
+       vtysh_debug_trace_cmd,
+       "[no] debug trace WORD [rate-limit (1-1000000)]",
+       NO_STR
+       DEBUG_STR
+       "Record a tracepoint\n"
+       "Tracepoint name, or all\n"
+       "Record at most so many per second\n"
+       "Records per second\n")
+{
+	return vtysh_argv_all(argc, argv, NULL);
+}
+
+DEFUN (vtysh_clear_trace,
+       vtysh_clear_trace_cmd,
+       "clear trace",
+       CLEAR_STR
+       "Recorded tracepoints\n")
+{
+	return vtysh_argv_all(argc, argv, NULL);
+}
+
 DEFUN (vtysh_show_work_queues,
        vtysh_show_work_queues_cmd,
        "show work-queues",
@@ -2166,6 +2435,31 @@ DEFUN (vtysh_show_memory,
 	return show_per_daemon("show memory\n", "Memory statistics for %s:\n");
 }
 
+DEFUN (vtysh_show_memory_stats,
+       vtysh_show_memory_stats_cmd,
+       "show memory <details [json]|histogram|sites>",
+       SHOW_STR
+       "Memory statistics\n"
+       "Peak and total allocations, and their rate since last shown\n"
+       "JavaScript Object Notation\n"
+       "Allocations by size\n"
+       "Callers of the allocations sampled\n")
+{
+	return vtysh_argv_all(argc, argv, "Memory statistics");
+}
+
+DEFUN (vtysh_debug_memory_sample,
+       vtysh_debug_memory_sample_cmd,
+       "[no] debug memory sample [(1-1000000)]",
+       NO_STR
+       DEBUG_STR
+       "Memory allocations\n"
+       "Record the callers of some allocations\n"
+       "Every so many allocations of a type\n")
+{
+	return vtysh_argv_all(argc, argv, NULL);
+}
+
 DEFUN (vtysh_show_modules,
        vtysh_show_modules_cmd,
        "show modules",
@@ -3554,10 +3848,16 @@ void vtysh_init_vty(void)
 
 	/* misc lib show commands */
 	install_element(VIEW_NODE, &vtysh_show_memory_cmd);
+	install_element(VIEW_NODE, &vtysh_show_memory_stats_cmd);
+	install_element(ENABLE_NODE, &vtysh_debug_memory_sample_cmd);
 	install_element(VIEW_NODE, &vtysh_show_modules_cmd);
 	install_element(VIEW_NODE, &vtysh_show_work_queues_cmd);
 	install_element(VIEW_NODE, &vtysh_show_work_queues_daemon_cmd);
 	install_element(VIEW_NODE, &vtysh_show_thread_cmd);
+	install_element(VIEW_NODE, &vtysh_show_thread_latency_cmd);
+	install_element(VIEW_NODE, &vtysh_show_trace_cmd);
+	install_element(ENABLE_NODE, &vtysh_debug_trace_cmd);
+	install_element(ENABLE_NODE, &vtysh_clear_trace_cmd);
 
 	/* Logging */
 	install_element(VIEW_NODE, &vtysh_show_logging_cmd);
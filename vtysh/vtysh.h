@@ -77,6 +77,7 @@ char *vtysh_prompt(void);
 void vtysh_config_write(void);
 
 int vtysh_config_from_file(struct vty *, FILE *);
+void vtysh_config_transaction(bool start);
 
 void config_add_line(struct list *, const char *);
 
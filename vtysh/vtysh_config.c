@@ -23,6 +23,8 @@
 #include "command.h"
 #include "linklist.h"
 #include "memory.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "vtysh/vtysh.h"
 #include "vtysh/vtysh_user.h"
@@ -30,6 +32,7 @@
 DEFINE_MGROUP(MVTYSH, "vtysh")
 DEFINE_MTYPE_STATIC(MVTYSH, VTYSH_CONFIG, "Vtysh configuration")
 DEFINE_MTYPE_STATIC(MVTYSH, VTYSH_CONFIG_LINE, "Vtysh configuration line")
+DEFINE_MTYPE_STATIC(MVTYSH, VTYSH_CONFIG_UNIQ, "Vtysh unique config line")
 
 vector configvec;
 
@@ -45,10 +48,60 @@ struct config {
 
 	/* Index of this config. */
 	uint32_t index;
+
+	/* List in configvec this config is on. */
+	struct list *master;
 };
 
 struct list *config_top;
 
+/* Sections by master list and name, and the lines config_add_line_uniq()
+ * added by list and text, so that neither needs a list scan; both are
+ * emptied along with the lists by vtysh_config_dump(). */
+static struct hash *config_hash;
+static struct hash *config_uniq_hash;
+
+struct config_uniq {
+	struct list *list;
+	/* owned by list */
+	const char *line;
+};
+
+static unsigned int config_hash_key(void *arg)
+{
+	struct config *config = arg;
+
+	return jhash_1word((uintptr_t)config->master,
+			   string_hash_make(config->name));
+}
+
+static int config_hash_cmp(const void *a, const void *b)
+{
+	const struct config *c1 = a, *c2 = b;
+
+	return c1->master == c2->master && !strcmp(c1->name, c2->name);
+}
+
+static unsigned int config_uniq_key(void *arg)
+{
+	struct config_uniq *uniq = arg;
+
+	return jhash_1word((uintptr_t)uniq->list,
+			   string_hash_make(uniq->line));
+}
+
+static int config_uniq_cmp(const void *a, const void *b)
+{
+	const struct config_uniq *u1 = a, *u2 = b;
+
+	return u1->list == u2->list && !strcmp(u1->line, u2->line);
+}
+
+static void config_uniq_free(void *arg)
+{
+	XFREE(MTYPE_VTYSH_CONFIG_UNIQ, arg);
+}
+
 static int line_cmp(char *c1, char *c2)
 {
 	return strcmp(c1, c2);
@@ -82,11 +135,8 @@ static void config_del(struct config *config)
 static struct config *config_get(int index, const char *line)
 {
 	struct config *config;
-	struct config *config_loop;
+	struct config key;
 	struct list *master;
-	struct listnode *node, *nnode;
-
-	config = config_loop = NULL;
 
 	master = vector_lookup_ensure(configvec, index);
 
@@ -97,10 +147,9 @@ static struct config *config_get(int index, const char *line)
 		vector_set_index(configvec, index, master);
 	}
 
-	for (ALL_LIST_ELEMENTS(master, node, nnode, config_loop)) {
-		if (strcmp(config_loop->name, line) == 0)
-			config = config_loop;
-	}
+	key.master = master;
+	key.name = (char *)line;
+	config = hash_lookup(config_hash, &key);
 
 	if (!config) {
 		config = config_new();
@@ -109,7 +158,9 @@ static struct config *config_get(int index, const char *line)
 		config->line->cmp = (int (*)(void *, void *))line_cmp;
 		config->name = XSTRDUP(MTYPE_VTYSH_CONFIG_LINE, line);
 		config->index = index;
+		config->master = master;
 		listnode_add(master, config);
+		hash_get(config_hash, config, hash_alloc_intern);
 	}
 	return config;
 }
@@ -121,14 +172,24 @@ void config_add_line(struct list *config, const char *line)
 
 static void config_add_line_uniq(struct list *config, const char *line)
 {
-	struct listnode *node, *nnode;
-	char *pnt;
+	struct config_uniq key = {.list = config, .line = line}, *uniq;
+	struct listnode *tail = listtail(config);
+	char *dup;
 
-	for (ALL_LIST_ELEMENTS(config, node, nnode, pnt)) {
-		if (strcmp(pnt, line) == 0)
-			return;
-	}
-	listnode_add_sort(config, XSTRDUP(MTYPE_VTYSH_CONFIG_LINE, line));
+	if (hash_lookup(config_uniq_hash, &key))
+		return;
+
+	dup = XSTRDUP(MTYPE_VTYSH_CONFIG_LINE, line);
+	/* daemons mostly write such lines in order already */
+	if (!tail || !config->cmp || config->cmp(listgetdata(tail), dup) < 0)
+		listnode_add(config, dup);
+	else
+		listnode_add_sort(config, dup);
+
+	uniq = XMALLOC(MTYPE_VTYSH_CONFIG_UNIQ, sizeof(*uniq));
+	uniq->list = config;
+	uniq->line = dup;
+	hash_get(config_uniq_hash, uniq, hash_alloc_intern);
 }
 
 /*
@@ -386,6 +447,9 @@ void vtysh_config_dump(FILE *fp)
 			}
 		}
 
+	hash_clean(config_hash, NULL);
+	hash_clean(config_uniq_hash, config_uniq_free);
+
 	for (i = 0; i < vector_active(configvec); i++)
 		if ((master = vector_slot(configvec, i)) != NULL) {
 			list_delete_and_null(&master);
@@ -407,10 +471,12 @@ static int vtysh_read_file(FILE *confp)
 
 	vtysh_execute_no_pager("enable");
 	vtysh_execute_no_pager("configure terminal");
+	vtysh_config_transaction(true);
 
 	/* Execute configuration file. */
 	ret = vtysh_config_from_file(vty, confp);
 
+	vtysh_config_transaction(false);
 	vtysh_execute_no_pager("end");
 	vtysh_execute_no_pager("disable");
 
@@ -471,4 +537,9 @@ void vtysh_config_init()
 	config_top = list_new();
 	config_top->del = (void (*)(void *))line_del;
 	configvec = vector_init(1);
+
+	config_hash = hash_create(config_hash_key, config_hash_cmp,
+				  "vtysh config sections");
+	config_uniq_hash = hash_create(config_uniq_key, config_uniq_cmp,
+				       "vtysh unique config lines");
 }
@@ -27,6 +27,7 @@
 #include "command.h"
 #include "memory_vty.h"
 #include "libfrr.h"
+#include "heartbeat.h"
 
 #include <getopt.h>
 #include <sys/un.h>
@@ -94,6 +95,7 @@ static struct global_state {
 	const char *vtydir;
 	long period;
 	long timeout;
+	long busy_timeout;
 	long restart_timeout;
 	long min_restart_interval;
 	long max_restart_interval;
@@ -139,6 +141,20 @@ struct daemon {
 	int fd;
 	struct timeval echo_sent;
 	unsigned int connect_tries;
+
+	/* the daemon's event loop heartbeat, and its count when the echo
+	 * was sent or its wait last extended */
+	const struct frr_heartbeat *hb;
+	uint64_t hb_beats;
+	unsigned int busy_waits;
+	unsigned long busy_count;
+
+	/* echo response times, in microseconds */
+	unsigned long echo_count;
+	unsigned long echo_last;
+	unsigned long echo_max;
+	unsigned int echo_hist[THREAD_HIST_BUCKETS];
+
 	struct thread *t_wakeup;
 	struct thread *t_read;
 	struct thread *t_write;
@@ -149,6 +165,7 @@ struct daemon {
 #define OPTION_MINRESTART 2000
 #define OPTION_MAXRESTART 2001
 #define OPTION_DRY        2002
+#define OPTION_BUSYTIMEOUT 2003
 
 static const struct option longopts[] = {
 	{"daemon", no_argument, NULL, 'd'},
@@ -157,6 +174,7 @@ static const struct option longopts[] = {
 	{"interval", required_argument, NULL, 'i'},
 	{"timeout", required_argument, NULL, 't'},
 	{"restart-timeout", required_argument, NULL, 'T'},
+	{"busy-timeout", required_argument, NULL, OPTION_BUSYTIMEOUT},
 	{"restart", required_argument, NULL, 'r'},
 	{"start-command", required_argument, NULL, 's'},
 	{"kill-command", required_argument, NULL, 'k'},
@@ -211,6 +229,11 @@ Otherwise, the interval is doubled (but capped at the -M value).\n\n",
 		restart commands (default is %d).\n\
 -i, --interval	Set the status polling interval in seconds (default is %d)\n\
 -t, --timeout	Set the unresponsiveness timeout in seconds (default is %d)\n\
+    --busy-timeout\n\
+		Wait up to this many seconds for an echo response as long as\n\
+		the daemon's event loop is seen to make progress, before\n\
+		declaring it unresponsive (default is 0, not waiting longer\n\
+		than the -t timeout).\n\
 -T, --restart-timeout\n\
 		Set the restart (kill) timeout in seconds (default is %d).\n\
 		If any background jobs are still running after this much\n\
@@ -504,6 +527,9 @@ static void daemon_down(struct daemon *dmn, const char *why)
 	THREAD_OFF(dmn->t_read);
 	THREAD_OFF(dmn->t_write);
 	THREAD_OFF(dmn->t_wakeup);
+	/* a restarted daemon makes a new heartbeat file */
+	frr_heartbeat_unmap(dmn->hb);
+	dmn->hb = NULL;
 	if (try_connect(dmn) < 0)
 		SET_WAKEUP_DOWN(dmn);
 	phase_check();
@@ -559,6 +585,13 @@ static int handle_read(struct thread *t_read)
 
 	time_elapsed(&delay, &dmn->echo_sent);
 	dmn->echo_sent.tv_sec = 0;
+
+	dmn->echo_last = delay.tv_sec * 1000000UL + delay.tv_usec;
+	if (dmn->echo_last > dmn->echo_max)
+		dmn->echo_max = dmn->echo_last;
+	dmn->echo_hist[thread_hist_bucket(dmn->echo_last)]++;
+	dmn->echo_count++;
+
 	if (dmn->state == DAEMON_UNRESPONSIVE) {
 		if (delay.tv_sec < gs.timeout) {
 			dmn->state = DAEMON_UP;
@@ -861,16 +894,53 @@ static int wakeup_unresponsive(struct thread *t_wakeup)
 	return 0;
 }
 
+static int wakeup_no_answer(struct thread *t_wakeup);
+
+/*
+ * With --busy-timeout, a daemon whose event loop got tasks done since the
+ * echo was sent, or since the last extension, is given another -t timeout
+ * to respond, up to the busy timeout in all.
+ */
+static bool busy_wait_extend(struct daemon *dmn)
+{
+	long waited = (dmn->busy_waits + 1) * gs.timeout;
+	uint64_t beats;
+
+	if (!gs.busy_timeout || !dmn->hb || waited >= gs.busy_timeout)
+		return false;
+
+	beats = frr_heartbeat_beats(dmn->hb);
+	if (beats == dmn->hb_beats)
+		return false;
+
+	if (!dmn->busy_waits)
+		dmn->busy_count++;
+	dmn->busy_waits++;
+	dmn->hb_beats = beats;
+
+	zlog_warn("%s: busy, no response yet to ping sent %ld seconds ago",
+		  dmn->name, waited);
+	thread_add_timer(master, wakeup_no_answer, dmn,
+			 MIN(gs.timeout, gs.busy_timeout - waited),
+			 &dmn->t_wakeup);
+	return true;
+}
+
 static int wakeup_no_answer(struct thread *t_wakeup)
 {
 	struct daemon *dmn = THREAD_ARG(t_wakeup);
+	struct timeval delay;
 
 	dmn->t_wakeup = NULL;
+	if (busy_wait_extend(dmn))
+		return 0;
+
+	time_elapsed(&delay, &dmn->echo_sent);
 	dmn->state = DAEMON_UNRESPONSIVE;
 	zlog_err(
 		"%s state -> unresponsive : no response yet to ping "
 		"sent %ld seconds ago",
-		dmn->name, gs.timeout);
+		dmn->name, (long)delay.tv_sec);
 	SET_WAKEUP_UNRESPONSIVE(dmn);
 	try_restart(dmn);
 	return 0;
@@ -892,6 +962,17 @@ static int wakeup_send_echo(struct thread *t_wakeup)
 		daemon_down(dmn, why);
 	} else {
 		gettimeofday(&dmn->echo_sent, NULL);
+
+		if (!dmn->hb) {
+			char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+			snprintf(path, sizeof(path), "%s/%s%s", gs.vtydir,
+				 dmn->name, FRR_HEARTBEAT_SUFFIX);
+			dmn->hb = frr_heartbeat_map(path);
+		}
+		dmn->hb_beats = dmn->hb ? frr_heartbeat_beats(dmn->hb) : 0;
+		dmn->busy_waits = 0;
+
 		dmn->t_wakeup = NULL;
 		thread_add_timer(master, wakeup_no_answer, dmn, gs.timeout,
 				 &dmn->t_wakeup);
@@ -899,6 +980,40 @@ static int wakeup_send_echo(struct thread *t_wakeup)
 	return 0;
 }
 
+void watchfrr_status(struct vty *vty)
+{
+	struct daemon *dmn;
+	unsigned int i;
+
+	vty_out(vty, "%-10s %-12s %8s %10s %10s %6s  %s\n", "Daemon", "State",
+		"Echoes", "Last(us)", "Max(us)", "Busy", "Heartbeat");
+	for (dmn = gs.daemons; dmn; dmn = dmn->next) {
+		vty_out(vty, "%-10s %-12s %8lu %10lu %10lu %6lu  ", dmn->name,
+			state_str[dmn->state], dmn->echo_count, dmn->echo_last,
+			dmn->echo_max, dmn->busy_count);
+		if (dmn->hb)
+			vty_out(vty, "%" PRIu64 " (pid %u)\n",
+				frr_heartbeat_beats(dmn->hb), dmn->hb->pid);
+		else
+			vty_out(vty, "-\n");
+	}
+
+	vty_out(vty, "\nEcho response times, <usecs:count\n");
+	for (dmn = gs.daemons; dmn; dmn = dmn->next) {
+		if (!dmn->echo_count)
+			continue;
+		vty_out(vty, "%-10s", dmn->name);
+		for (i = 0; i < THREAD_HIST_BUCKETS - 1; i++)
+			if (dmn->echo_hist[i])
+				vty_out(vty, " <%lu:%u", 1UL << i,
+					dmn->echo_hist[i]);
+		if (dmn->echo_hist[i])
+			vty_out(vty, " >=%lu:%u", 1UL << (i - 1),
+				dmn->echo_hist[i]);
+		vty_out(vty, "\n");
+	}
+}
+
 bool check_all_up(void)
 {
 	struct daemon *dmn;
@@ -1116,6 +1231,18 @@ int main(int argc, char **argv)
 				frr_help_exit(1);
 			}
 		} break;
+		case OPTION_BUSYTIMEOUT: {
+			char garbage[3];
+			if ((sscanf(optarg, "%ld%1s", &gs.busy_timeout,
+				    garbage)
+			     != 1)
+			    || (gs.busy_timeout < 0)) {
+				fprintf(stderr,
+					"Invalid busy timeout argument: %s\n",
+					optarg);
+				frr_help_exit(1);
+			}
+		} break;
 		default:
 			fputs("Invalid option.\n", stderr);
 			frr_help_exit(1);
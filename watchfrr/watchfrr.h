@@ -33,4 +33,7 @@ extern void integrated_write_sigchld(int status);
  */
 extern bool check_all_up(void);
 
+/* Shows the daemons' states and echo response times. */
+extern void watchfrr_status(struct vty *vty);
+
 #endif /* FRR_WATCHFRR_H */
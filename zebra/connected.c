@@ -63,7 +63,7 @@ static void connected_withdraw(struct connected *ifc)
 	UNSET_FLAG(ifc->conf, ZEBRA_IFC_QUEUED);
 
 	if (!CHECK_FLAG(ifc->conf, ZEBRA_IFC_CONFIGURED)) {
-		listnode_delete(ifc->ifp->connected, ifc);
+		if_connected_delete(ifc->ifp, ifc);
 		connected_free(ifc);
 	}
 }
@@ -81,7 +81,7 @@ static void connected_announce(struct interface *ifp, struct connected *ifc)
 			UNSET_FLAG(ifc->flags, ZEBRA_IFA_UNNUMBERED);
 	}
 
-	listnode_add(ifp->connected, ifc);
+	if_connected_add(ifp, ifc);
 
 	/* Update interface address information to protocol daemon. */
 	if (ifc->address->family == AF_INET)
@@ -98,15 +98,7 @@ static void connected_announce(struct interface *ifp, struct connected *ifc)
 struct connected *connected_check(struct interface *ifp,
 				  union prefixconstptr pu)
 {
-	const struct prefix *p = pu.p;
-	struct connected *ifc;
-	struct listnode *node;
-
-	for (ALL_LIST_ELEMENTS_RO(ifp->connected, node, ifc))
-		if (prefix_same(ifc->address, p))
-			return ifc;
-
-	return NULL;
+	return if_connected_lookup(ifp, pu.p);
 }
 
 /* same, but with peer address */
@@ -118,13 +110,18 @@ struct connected *connected_check_ptp(struct interface *ifp,
 	const struct prefix *d = du.p;
 	struct connected *ifc;
 	struct listnode *node;
+	struct list *same_addr;
 
 	/* ignore broadcast addresses */
 	if (p->prefixlen != IPV4_MAX_PREFIXLEN)
 		d = NULL;
 
-	for (ALL_LIST_ELEMENTS_RO(ifp->connected, node, ifc)) {
-		if (!prefix_same(ifc->address, p))
+	same_addr = if_connected_by_address(ifp->vrf_id, p);
+	if (!same_addr)
+		return NULL;
+
+	for (ALL_LIST_ELEMENTS_RO(same_addr, node, ifc)) {
+		if (ifc->ifp != ifp || !prefix_same(ifc->address, p))
 			continue;
 		if (!CONNECTED_PEER(ifc) && !d)
 			return ifc;
@@ -267,7 +264,8 @@ void connected_up(struct interface *ifp, struct connected *ifc)
 				ifp->vrf_id, ifp->name,
 				prefix2str(&p, buf, sizeof(buf)));
 		}
-		mpls_mark_lsps_for_processing(vrf_info_lookup(ifp->vrf_id));
+		mpls_mark_lsps_for_processing(vrf_info_lookup(ifp->vrf_id),
+					      &p);
 	}
 }
 
@@ -429,7 +427,8 @@ void connected_down(struct interface *ifp, struct connected *ifc)
 				ifp->vrf_id, ifp->name,
 				prefix2str(&p, buf, sizeof(buf)));
 		}
-		mpls_mark_lsps_for_processing(vrf_info_lookup(ifp->vrf_id));
+		mpls_mark_lsps_for_processing(vrf_info_lookup(ifp->vrf_id),
+					      &p);
 	}
 }
 
@@ -463,7 +462,8 @@ static void connected_delete_helper(struct connected *ifc, struct prefix *p)
 				ifp->vrf_id, ifp->name,
 				prefix2str(p, buf, sizeof(buf)));
 		}
-		mpls_mark_lsps_for_processing(vrf_info_lookup(ifp->vrf_id));
+		mpls_mark_lsps_for_processing(vrf_info_lookup(ifp->vrf_id),
+					      p);
 	}
 }
 
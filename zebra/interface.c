@@ -115,7 +115,6 @@ static int if_zebra_new_hook(struct interface *ifp)
 		rtadv->AdvSendAdvertisements = 0;
 		rtadv->MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
 		rtadv->MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
-		rtadv->AdvIntervalTimer = 0;
 		rtadv->AdvManagedFlag = 0;
 		rtadv->AdvOtherConfigFlag = 0;
 		rtadv->AdvHomeAgentFlag = 0;
@@ -133,6 +132,7 @@ static int if_zebra_new_hook(struct interface *ifp)
 
 		rtadv->AdvPrefixList = list_new();
 	}
+	zebra_if->ifp = ifp;
 #endif /* HAVE_RTADV */
 
 	/* Initialize installed address chains tree. */
@@ -170,9 +170,11 @@ static int if_zebra_delete_hook(struct interface *ifp)
 
 		rtadv = &zebra_if->rtadv;
 		list_delete_and_null(&rtadv->AdvPrefixList);
+		rtadv_if_delete(ifp);
 #endif /* HAVE_RTADV */
 
 		THREAD_OFF(zebra_if->speed_update);
+		THREAD_OFF(zebra_if->t_updown);
 
 		XFREE(MTYPE_TMP, zebra_if);
 	}
@@ -532,6 +534,64 @@ static void if_addr_wakeup(struct interface *ifp)
 	}
 }
 
+/* Tells the clients about ifp's up/down state, if it changed. */
+static void if_updown_report(struct interface *ifp)
+{
+	struct zebra_if *zif = ifp->info;
+
+	if (zif->up_pending == zif->up_reported)
+		return;
+
+	zif->up_reported = zif->up_pending;
+	if (zif->up_reported)
+		zebra_interface_up_update(ifp);
+	else
+		zebra_interface_down_update(ifp);
+}
+
+static int if_updown_timer(struct thread *thread)
+{
+	if_updown_report(THREAD_ARG(thread));
+	return 0;
+}
+
+/*
+ * Notifies the protocol daemons of ifp going up or down.  With a hold
+ * time, what they hear about is the state ifp is in once it has passed,
+ * so that a flap doesn't go out at all.
+ */
+static void if_updown_notify(struct interface *ifp, bool up)
+{
+	struct zebra_if *zif = ifp->info;
+
+	zif->up_pending = up;
+
+	if (zebrad.if_hold_time) {
+		thread_add_timer_msec(zebrad.master, if_updown_timer, ifp,
+				      zebrad.if_hold_time, &zif->t_updown);
+		return;
+	}
+
+	THREAD_OFF(zif->t_updown);
+	zif->up_reported = up;
+	if (up)
+		zebra_interface_up_update(ifp);
+	else
+		zebra_interface_down_update(ifp);
+}
+
+/* Reports a held back up/down change right away. */
+static void if_updown_flush(struct interface *ifp)
+{
+	struct zebra_if *zif = ifp->info;
+
+	if (!zif->t_updown)
+		return;
+
+	THREAD_OFF(zif->t_updown);
+	if_updown_report(ifp);
+}
+
 /* Handle interface addition */
 void if_add_update(struct interface *ifp)
 {
@@ -557,6 +617,10 @@ void if_add_update(struct interface *ifp)
 
 	zebra_interface_add_update(ifp);
 
+	/* that had the current state in it */
+	THREAD_OFF(if_data->t_updown);
+	if_data->up_pending = if_data->up_reported = if_is_operative(ifp);
+
 	if (!CHECK_FLAG(ifp->status, ZEBRA_INTERFACE_ACTIVE)) {
 		SET_FLAG(ifp->status, ZEBRA_INTERFACE_ACTIVE);
 
@@ -682,8 +746,7 @@ static void if_delete_connected(struct interface *ifp)
 					 * (unconditionally). */
 					if (!CHECK_FLAG(ifc->conf,
 							ZEBRA_IFC_CONFIGURED)) {
-						listnode_delete(ifp->connected,
-								ifc);
+						if_connected_delete(ifp, ifc);
 						connected_free(ifc);
 					} else
 						last = node;
@@ -704,7 +767,7 @@ static void if_delete_connected(struct interface *ifp)
 			if (CHECK_FLAG(ifc->conf, ZEBRA_IFC_CONFIGURED))
 				last = node;
 			else {
-				listnode_delete(ifp->connected, ifc);
+				if_connected_delete(ifp, ifc);
 				connected_free(ifc);
 			}
 		} else {
@@ -737,6 +800,8 @@ void if_delete_update(struct interface *ifp)
 	/* Delete connected routes from the kernel. */
 	if_delete_connected(ifp);
 
+	if_updown_flush(ifp);
+
 	/* Send out notification on interface delete. */
 	zebra_interface_delete_update(ifp);
 
@@ -784,6 +849,8 @@ void if_handle_vrf_change(struct interface *ifp, vrf_id_t vrf_id)
 	/* Delete all neighbor addresses learnt through IPv6 RA */
 	if_down_del_nbr_connected(ifp);
 
+	if_updown_flush(ifp);
+
 	/* Send out notification on interface VRF change. */
 	/* This is to issue an UPDATE or a DELETE, as appropriate. */
 	zebra_interface_vrf_update_del(ifp, vrf_id);
@@ -914,17 +981,12 @@ void if_up(struct interface *ifp)
 			  __func__, ifp->name);
 		return;
 	}
-	zebra_interface_up_update(ifp);
+	if_updown_notify(ifp, true);
 
 	if_nbr_ipv6ll_to_ipv4ll_neigh_add_all(ifp);
 
 #if defined(HAVE_RTADV)
-	/* Enable fast tx of RA if enabled && RA interval is not in msecs */
-	if (zif->rtadv.AdvSendAdvertisements
-	    && (zif->rtadv.MaxRtrAdvInterval >= 1000)) {
-		zif->rtadv.inFastRexmit = 1;
-		zif->rtadv.NumFastReXmitsRemain = RTADV_NUM_FAST_REXMITS;
-	}
+	rtadv_if_up(ifp);
 #endif
 
 	/* Install connected routes to the kernel. */
@@ -983,11 +1045,14 @@ void if_down(struct interface *ifp)
 
 
 	/* Notify to the protocol daemons. */
-	zebra_interface_down_update(ifp);
+	if_updown_notify(ifp, false);
 
 	/* Uninstall connected routes from the kernel. */
 	if_uninstall_connected(ifp);
 
+	/* The kernel flushed the nexthop objects using the interface */
+	kernel_nhg_if_down(ifp);
+
 	if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 		zlog_debug("%u: IF %s down, scheduling RIB processing",
 			   ifp->vrf_id, ifp->name);
@@ -2501,7 +2566,7 @@ static int ip_address_install(struct vty *vty, struct interface *ifp,
 			ifc->label = XSTRDUP(MTYPE_CONNECTED_LABEL, label);
 
 		/* Add to linked list. */
-		listnode_add(ifp->connected, ifc);
+		if_connected_add(ifp, ifc);
 	}
 
 	/* This address is configured from zebra. */
@@ -2580,7 +2645,7 @@ static int ip_address_uninstall(struct vty *vty, struct interface *ifp,
 	/* This is not real address or interface is not active. */
 	if (!CHECK_FLAG(ifc->conf, ZEBRA_IFC_QUEUED)
 	    || !CHECK_FLAG(ifp->status, ZEBRA_INTERFACE_ACTIVE)) {
-		listnode_delete(ifp->connected, ifc);
+		if_connected_delete(ifp, ifc);
 		connected_free(ifc);
 		return CMD_WARNING_CONFIG_FAILED;
 	}
@@ -2729,7 +2794,7 @@ static int ipv6_address_install(struct vty *vty, struct interface *ifp,
 			ifc->label = XSTRDUP(MTYPE_CONNECTED_LABEL, label);
 
 		/* Add to linked list. */
-		listnode_add(ifp->connected, ifc);
+		if_connected_add(ifp, ifc);
 	}
 
 	/* This address is configured from zebra. */
@@ -2808,7 +2873,7 @@ static int ipv6_address_uninstall(struct vty *vty, struct interface *ifp,
 	/* This is not real address or interface is not active. */
 	if (!CHECK_FLAG(ifc->conf, ZEBRA_IFC_QUEUED)
 	    || !CHECK_FLAG(ifp->status, ZEBRA_INTERFACE_ACTIVE)) {
-		listnode_delete(ifp->connected, ifc);
+		if_connected_delete(ifp, ifc);
 		connected_free(ifc);
 		return CMD_WARNING_CONFIG_FAILED;
 	}
@@ -24,6 +24,7 @@
 #include "redistribute.h"
 #include "vrf.h"
 #include "hook.h"
+#include "queue.h"
 
 #include "zebra/zebra_l2.h"
 
@@ -59,12 +60,9 @@ struct rtadvconf {
 	   MUST be no greater than .75 * MaxRtrAdvInterval.
 
 	   Default: 0.33 * MaxRtrAdvInterval */
-	int MinRtrAdvInterval; /* This field is currently unused. */
+	int MinRtrAdvInterval;
 #define RTADV_MIN_RTR_ADV_INTERVAL (0.33 * RTADV_MAX_RTR_ADV_INTERVAL)
 
-	/* Unsolicited Router Advertisements' interval timer. */
-	int AdvIntervalTimer;
-
 	/* The TRUE/FALSE value to be placed in the "Managed address
 	   configuration" flag field in the Router Advertisement.  See
 	   [ADDRCONF].
@@ -226,6 +224,24 @@ struct zebra_if {
 #if defined(HAVE_RTADV)
 	struct rtadvconf rtadv;
 	unsigned int ra_sent, ra_rcvd;
+
+	/*
+	 * RA schedule: the namespace whose wheel the interface is on, NULL
+	 * if none, and the tick it is due at.
+	 */
+	struct interface *ifp;
+	struct zebra_ns *ra_zns;
+	uint64_t ra_due;
+	TAILQ_ENTRY(zebra_if) ra_wheel;
+
+	/*
+	 * The RA last sent, rebuilt when the configuration or the hardware
+	 * address changes.
+	 */
+	uint8_t *ra_pkt;
+	unsigned int ra_pkt_len;
+	uint8_t ra_hw_addr[INTERFACE_HWADDR_MAX];
+	int ra_hw_addr_len;
 #endif /* HAVE_RTADV */
 
 	struct irdp_interface *irdp;
@@ -273,6 +289,14 @@ struct zebra_if {
 
 	struct thread *speed_update;
 
+	/*
+	 * Up/down state the clients were last told about, and the one
+	 * t_updown reports once the hold time has passed.
+	 */
+	bool up_reported;
+	bool up_pending;
+	struct thread *t_updown;
+
 	/*
 	 * Does this interface have a v6 to v4 ll neighbor entry
 	 * for bgp unnumbered?
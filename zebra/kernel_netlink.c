@@ -32,6 +32,8 @@
 #include "zebra_memory.h"
 #include "rib.h"
 #include "thread.h"
+#include "frr_pthread.h"
+#include "queue.h"
 #include "privs.h"
 #include "nexthop.h"
 #include "vrf.h"
@@ -90,6 +92,9 @@ static const struct message nlmsg_str[] = {{RTM_NEWROUTE, "RTM_NEWROUTE"},
 					   {RTM_NEWRULE, "RTM_NEWRULE"},
 					   {RTM_DELRULE, "RTM_DELRULE"},
 					   {RTM_GETRULE, "RTM_GETRULE"},
+					   {RTM_NEWNEXTHOP, "RTM_NEWNEXTHOP"},
+					   {RTM_DELNEXTHOP, "RTM_DELNEXTHOP"},
+					   {RTM_GETNEXTHOP, "RTM_GETNEXTHOP"},
 					   {0}};
 
 static const struct message rtproto_str[] = {
@@ -272,21 +277,10 @@ static int netlink_information_fetch(struct sockaddr_nl *snl,
 	return 0;
 }
 
-static int kernel_read(struct thread *thread)
-{
-	struct zebra_ns *zns = (struct zebra_ns *)THREAD_ARG(thread);
-	netlink_parse_info(netlink_information_fetch, &zns->netlink, zns, 5, 0);
-	zns->t_netlink = NULL;
-	thread_add_read(zebrad.master, kernel_read, zns, zns->netlink.sock,
-			&zns->t_netlink);
-
-	return 0;
-}
-
 /* Filter out messages from self that occur on listener socket,
  * caused by our actions on the command socket
  */
-static void netlink_install_filter(int sock, __u32 pid)
+static void netlink_install_filter(int sock, __u32 pid, __u32 dplane_pid)
 {
 	struct sock_filter filter[] = {
 		/* 0: ldh [4]	          */
@@ -298,16 +292,18 @@ static void netlink_install_filter(int sock, __u32 pid)
 		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELROUTE), 2, 0),
 		/* 3: jeq 0x19 jt 5 jf next  */
 		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_NEWNEIGH), 1, 0),
-		/* 4: jeq 0x19 jt 5 jf 8  */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELNEIGH), 0, 3),
+		/* 4: jeq 0x19 jt 5 jf 9  */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htons(RTM_DELNEIGH), 0, 4),
 		/* 5: ldw [12]		  */
 		BPF_STMT(BPF_LD | BPF_ABS | BPF_W,
 			 offsetof(struct nlmsghdr, nlmsg_pid)),
-		/* 6: jeq XX  jt 7 jf 8   */
-		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 0, 1),
-		/* 7: ret 0    (skip)     */
+		/* 6: jeq XX  jt 8 jf next   */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(pid), 1, 0),
+		/* 7: jeq YY  jt 8 jf 9   */
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(dplane_pid), 0, 1),
+		/* 8: ret 0    (skip)     */
 		BPF_STMT(BPF_RET | BPF_K, 0),
-		/* 8: ret 0xffff (keep)   */
+		/* 9: ret 0xffff (keep)   */
 		BPF_STMT(BPF_RET | BPF_K, 0xffff),
 	};
 
@@ -439,6 +435,172 @@ const char *nl_rttype_to_str(uint8_t rttype)
 	return lookup_msg(rttype_str, rttype, "");
 }
 
+/*
+ * netlink_parse_error
+ *
+ * Look at a non-zero NLMSG_ERROR reply and decide whether it really is one.
+ *
+ * nl  -> netlink socket information
+ * zns -> The zebra namespace data
+ * h   -> The NLMSG_ERROR message
+ *
+ * Returns 0 for errors known to be caused by harmless races, -1 otherwise.
+ */
+static int netlink_parse_error(struct nlsock *nl, struct zebra_ns *zns,
+			       struct nlmsghdr *h)
+{
+	struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(h);
+	int errnum = err->error;
+	int msg_type = err->msg.nlmsg_type;
+
+	if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+		zlog_err("%s error: message truncated", nl->name);
+		return -1;
+	}
+
+	/* Deal with errors that occur because of races in link handling */
+	if ((nl == &zns->netlink_cmd || nl == &zns->netlink_dplane)
+	    && ((msg_type == RTM_DELROUTE
+		 && (-errnum == ENODEV || -errnum == ESRCH))
+		|| (msg_type == RTM_NEWROUTE
+		    && (-errnum == ENETDOWN || -errnum == EEXIST)))) {
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug("%s: error: %s type=%s(%u), seq=%u, pid=%u",
+				   nl->name, safe_strerror(-errnum),
+				   nl_msg_type_to_str(msg_type), msg_type,
+				   err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+		return 0;
+	}
+
+	/* We see RTM_DELNEIGH when shutting down an interface with an IPv4
+	 * link-local.  The kernel should have already deleted the neighbor
+	 * so do not log these as an error.
+	 *
+	 * Kernels without (replaceable) nexthop objects fail the probe for
+	 * them, and deleting a nexthop object the kernel already flushed
+	 * fails as well.
+	 */
+	if (msg_type == RTM_DELNEIGH
+	    || (msg_type == RTM_GETNEXTHOP
+		&& (-errnum == EOPNOTSUPP || -errnum == EINVAL))
+	    || (msg_type == RTM_NEWNEXTHOP && -errnum == EEXIST)
+	    || (msg_type == RTM_DELNEXTHOP && -errnum == ENOENT)
+	    || ((nl == &zns->netlink_cmd || nl == &zns->netlink_dplane)
+		&& msg_type == RTM_NEWROUTE
+		&& (-errnum == ESRCH || -errnum == ENETUNREACH))) {
+		/* This is known to happen in some situations, don't log
+		 * as error.
+		 */
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug("%s error: %s, type=%s(%u), seq=%u, pid=%u",
+				   nl->name, safe_strerror(-errnum),
+				   nl_msg_type_to_str(msg_type), msg_type,
+				   err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+	} else
+		zlog_err("%s error: %s, type=%s(%u), seq=%u, pid=%u",
+			 nl->name, safe_strerror(-errnum),
+			 nl_msg_type_to_str(msg_type), msg_type,
+			 err->msg.nlmsg_seq, err->msg.nlmsg_pid);
+
+	return -1;
+}
+
+/*
+ * Passes the messages of one datagram read from nl to filter.  Returns 1
+ * once the answer is complete, with the result in *ret, and 0 if more is
+ * to come.
+ */
+static int netlink_parse_msgs(int (*filter)(struct sockaddr_nl *,
+					    struct nlmsghdr *, ns_id_t, int),
+			      struct nlsock *nl, struct zebra_ns *zns,
+			      struct sockaddr_nl *snl, char *buf, int status,
+			      int msg_flags, int startup, int *ret)
+{
+	struct nlmsghdr *h;
+	int error;
+
+	for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, (unsigned int)status);
+	     h = NLMSG_NEXT(h, status)) {
+		/* Finish of reading. */
+		if (h->nlmsg_type == NLMSG_DONE)
+			return 1;
+
+		/* Error handling. */
+		if (h->nlmsg_type == NLMSG_ERROR) {
+			struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(h);
+
+			/* If the error field is zero, then this is an
+			 * ACK */
+			if (err->error == 0) {
+				if (IS_ZEBRA_DEBUG_KERNEL) {
+					zlog_debug(
+						"%s: %s ACK: type=%s(%u), seq=%u, pid=%u",
+						__FUNCTION__, nl->name,
+						nl_msg_type_to_str(
+							err->msg.nlmsg_type),
+						err->msg.nlmsg_type,
+						err->msg.nlmsg_seq,
+						err->msg.nlmsg_pid);
+				}
+
+				/* return if not a multipart message,
+				 * otherwise continue */
+				if (!(h->nlmsg_flags & NLM_F_MULTI)) {
+					*ret = 0;
+					return 1;
+				}
+				continue;
+			}
+
+			*ret = netlink_parse_error(nl, zns, h);
+			return 1;
+		}
+
+		/* OK we got netlink message. */
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug(
+				"netlink_parse_info: %s type %s(%u), len=%d, seq=%u, pid=%u",
+				nl->name, nl_msg_type_to_str(h->nlmsg_type),
+				h->nlmsg_type, h->nlmsg_len, h->nlmsg_seq,
+				h->nlmsg_pid);
+
+		/* skip unsolicited messages originating from command
+		 * socket
+		 * linux sets the originators port-id for {NEW|DEL}ADDR
+		 * messages,
+		 * so this has to be checked here. */
+		if (nl != &zns->netlink_cmd
+		    && h->nlmsg_pid == zns->netlink_cmd.snl.nl_pid
+		    && (h->nlmsg_type != RTM_NEWADDR
+			&& h->nlmsg_type != RTM_DELADDR)) {
+			if (IS_ZEBRA_DEBUG_KERNEL)
+				zlog_debug(
+					"netlink_parse_info: %s packet comes from %s",
+					zns->netlink_cmd.name, nl->name);
+			continue;
+		}
+
+		error = (*filter)(snl, h, zns->ns_id, startup);
+		if (error < 0) {
+			zlog_err("%s filter function error", nl->name);
+			*ret = error;
+		}
+	}
+
+	/* After error care. */
+	if (msg_flags & MSG_TRUNC) {
+		zlog_err("%s error: message truncated", nl->name);
+		return 0;
+	}
+	if (status) {
+		zlog_err("%s error: data remnant size %d", nl->name, status);
+		*ret = -1;
+		return 1;
+	}
+
+	return 0;
+}
+
 /*
  * netlink_parse_info
  *
@@ -459,7 +621,6 @@ int netlink_parse_info(int (*filter)(struct sockaddr_nl *, struct nlmsghdr *,
 {
 	int status;
 	int ret = 0;
-	int error;
 	int read_in = 0;
 
 	while (1) {
@@ -470,7 +631,6 @@ int netlink_parse_info(int (*filter)(struct sockaddr_nl *, struct nlmsghdr *,
 				     .msg_namelen = sizeof snl,
 				     .msg_iov = &iov,
 				     .msg_iovlen = 1};
-		struct nlmsghdr *h;
 
 		if (count && read_in >= count)
 			return 0;
@@ -510,152 +670,311 @@ int netlink_parse_info(int (*filter)(struct sockaddr_nl *, struct nlmsghdr *,
 		}
 
 		read_in++;
-		for (h = (struct nlmsghdr *)buf;
-		     NLMSG_OK(h, (unsigned int)status);
-		     h = NLMSG_NEXT(h, status)) {
-			/* Finish of reading. */
-			if (h->nlmsg_type == NLMSG_DONE)
-				return ret;
-
-			/* Error handling. */
-			if (h->nlmsg_type == NLMSG_ERROR) {
-				struct nlmsgerr *err =
-					(struct nlmsgerr *)NLMSG_DATA(h);
-				int errnum = err->error;
-				int msg_type = err->msg.nlmsg_type;
-
-				/* If the error field is zero, then this is an
-				 * ACK */
-				if (err->error == 0) {
-					if (IS_ZEBRA_DEBUG_KERNEL) {
-						zlog_debug(
-							"%s: %s ACK: type=%s(%u), seq=%u, pid=%u",
-							__FUNCTION__, nl->name,
-							nl_msg_type_to_str(
-								err->msg.nlmsg_type),
-							err->msg.nlmsg_type,
-							err->msg.nlmsg_seq,
-							err->msg.nlmsg_pid);
-					}
-
-					/* return if not a multipart message,
-					 * otherwise continue */
-					if (!(h->nlmsg_flags & NLM_F_MULTI))
-						return 0;
-					continue;
-				}
+		if (netlink_parse_msgs(filter, nl, zns, &snl, buf, status,
+				       msg.msg_flags, startup, &ret))
+			return ret;
+	}
+	return ret;
+}
 
-				if (h->nlmsg_len
-				    < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
-					zlog_err("%s error: message truncated",
-						 nl->name);
-					return -1;
-				}
+/*
+ * Kernel events are read off the listen sockets by a pthread of their own,
+ * so that bursts are drained at socket speed while the main thread is busy
+ * with the RIB, and handed to the main thread to be parsed.
+ */
+#define NL_RX_BATCH 32  /* datagrams per recvmmsg() */
+#define NL_RX_BUDGET 64 /* datagrams parsed per main thread event */
+#define NL_RX_SPARE 128 /* datagram buffers kept around for reuse */
 
-				/* Deal with errors that occur because of races
-				 * in link handling */
-				if (nl == &zns->netlink_cmd
-				    && ((msg_type == RTM_DELROUTE
-					 && (-errnum == ENODEV
-					     || -errnum == ESRCH))
-					|| (msg_type == RTM_NEWROUTE
-					    && (-errnum == ENETDOWN
-						|| -errnum == EEXIST)))) {
-					if (IS_ZEBRA_DEBUG_KERNEL)
-						zlog_debug(
-							"%s: error: %s type=%s(%u), seq=%u, pid=%u",
-							nl->name,
-							safe_strerror(-errnum),
-							nl_msg_type_to_str(
-								msg_type),
-							msg_type,
-							err->msg.nlmsg_seq,
-							err->msg.nlmsg_pid);
-					return 0;
-				}
+DEFINE_MTYPE_STATIC(ZEBRA, NL_RX_DGRAM, "Netlink received datagram")
 
-				/* We see RTM_DELNEIGH when shutting down an
-				 * interface with an IPv4
-				 * link-local.  The kernel should have already
-				 * deleted the neighbor
-				 * so do not log these as an error.
-				 */
-				if (msg_type == RTM_DELNEIGH
-				    || (nl == &zns->netlink_cmd
-					&& msg_type == RTM_NEWROUTE
-					&& (-errnum == ESRCH
-					    || -errnum == ENETUNREACH))) {
-					/* This is known to happen in some
-					 * situations, don't log
-					 * as error.
-					 */
-					if (IS_ZEBRA_DEBUG_KERNEL)
-						zlog_debug(
-							"%s error: %s, type=%s(%u), seq=%u, pid=%u",
-							nl->name,
-							safe_strerror(-errnum),
-							nl_msg_type_to_str(
-								msg_type),
-							msg_type,
-							err->msg.nlmsg_seq,
-							err->msg.nlmsg_pid);
-				} else
-					zlog_err(
-						"%s error: %s, type=%s(%u), seq=%u, pid=%u",
-						nl->name,
-						safe_strerror(-errnum),
-						nl_msg_type_to_str(msg_type),
-						msg_type, err->msg.nlmsg_seq,
-						err->msg.nlmsg_pid);
+struct nl_rx_dgram {
+	TAILQ_ENTRY(nl_rx_dgram) entry;
 
-				return -1;
-			}
+	struct zebra_ns *zns;
+	struct sockaddr_nl snl;
+	int len;
+	int flags;
+	char buf[NL_PKT_BUF_SIZE];
+};
+
+TAILQ_HEAD(nl_rx_list, nl_rx_dgram);
+
+static struct nl_rx {
+	/* NULL until the first event, or if it could not be started */
+	struct frr_pthread *pthread;
+	/* listen sockets read by the pthread */
+	unsigned int nsocks;
+
+	pthread_mutex_t mtx;
+	/* signalled when a socket was handed back; Requires: mtx */
+	pthread_cond_t cond;
+	/* read, waiting for the main thread; Requires: mtx */
+	struct nl_rx_list queue;
+	/* unused buffers; Requires: mtx */
+	struct nl_rx_list spare;
+	unsigned int nspare;
+
+	struct thread *t_process;
+} nl_rx = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.queue = TAILQ_HEAD_INITIALIZER(nl_rx.queue),
+	.spare = TAILQ_HEAD_INITIALIZER(nl_rx.spare),
+};
+
+/* Requires: nl_rx.mtx */
+static void netlink_rx_put(struct nl_rx_list *list)
+{
+	struct nl_rx_dgram *dg;
 
-			/* OK we got netlink message. */
-			if (IS_ZEBRA_DEBUG_KERNEL)
-				zlog_debug(
-					"netlink_parse_info: %s type %s(%u), len=%d, seq=%u, pid=%u",
-					nl->name,
-					nl_msg_type_to_str(h->nlmsg_type),
-					h->nlmsg_type, h->nlmsg_len,
-					h->nlmsg_seq, h->nlmsg_pid);
-
-			/* skip unsolicited messages originating from command
-			 * socket
-			 * linux sets the originators port-id for {NEW|DEL}ADDR
-			 * messages,
-			 * so this has to be checked here. */
-			if (nl != &zns->netlink_cmd
-			    && h->nlmsg_pid == zns->netlink_cmd.snl.nl_pid
-			    && (h->nlmsg_type != RTM_NEWADDR
-				&& h->nlmsg_type != RTM_DELADDR)) {
-				if (IS_ZEBRA_DEBUG_KERNEL)
-					zlog_debug(
-						"netlink_parse_info: %s packet comes from %s",
-						zns->netlink_cmd.name,
-						nl->name);
-				continue;
-			}
+	while ((dg = TAILQ_FIRST(list))) {
+		TAILQ_REMOVE(list, dg, entry);
+		if (nl_rx.nspare >= NL_RX_SPARE) {
+			XFREE(MTYPE_NL_RX_DGRAM, dg);
+			continue;
+		}
+		TAILQ_INSERT_HEAD(&nl_rx.spare, dg, entry);
+		nl_rx.nspare++;
+	}
+}
+
+/* Parses what the reader queued up, main thread only. */
+static int netlink_rx_process(struct thread *thread)
+{
+	struct nl_rx_list work;
+	struct nl_rx_dgram *dg;
+	struct zebra_ns *zns;
+	int n, ret;
+	bool more;
+
+	TAILQ_INIT(&work);
+
+	pthread_mutex_lock(&nl_rx.mtx);
+	{
+		for (n = 0; n < NL_RX_BUDGET; n++) {
+			dg = TAILQ_FIRST(&nl_rx.queue);
+			if (!dg)
+				break;
+			TAILQ_REMOVE(&nl_rx.queue, dg, entry);
+			TAILQ_INSERT_TAIL(&work, dg, entry);
+		}
+		more = !TAILQ_EMPTY(&nl_rx.queue);
+	}
+	pthread_mutex_unlock(&nl_rx.mtx);
+
+	TAILQ_FOREACH (dg, &work, entry) {
+		zns = dg->zns;
+		if (IS_ZEBRA_DEBUG_KERNEL_MSGDUMP_RECV) {
+			zlog_debug("%s: << netlink message dump [recv]",
+				   __func__);
+			zlog_hexdump(dg->buf, dg->len);
+		}
+		netlink_parse_msgs(netlink_information_fetch, &zns->netlink,
+				   zns, &dg->snl, dg->buf, dg->len, dg->flags,
+				   0, &ret);
+	}
+
+	pthread_mutex_lock(&nl_rx.mtx);
+	{
+		netlink_rx_put(&work);
+	}
+	pthread_mutex_unlock(&nl_rx.mtx);
 
-			error = (*filter)(&snl, h, zns->ns_id, startup);
-			if (error < 0) {
-				zlog_err("%s filter function error", nl->name);
-				ret = error;
+	if (more)
+		thread_add_event(zebrad.master, netlink_rx_process, NULL, 0,
+				 &nl_rx.t_process);
+	return 0;
+}
+
+/* Drains a listen socket, on the reader pthread. */
+static int netlink_rx_read(struct thread *thread)
+{
+	struct zebra_ns *zns = THREAD_ARG(thread);
+	struct nlsock *nl = &zns->netlink;
+	struct nl_rx_dgram *dg[NL_RX_BATCH];
+	struct mmsghdr msgs[NL_RX_BATCH];
+	struct iovec iov[NL_RX_BATCH];
+	struct nl_rx_list batch, unused;
+	int i, n;
+
+	TAILQ_INIT(&batch);
+	TAILQ_INIT(&unused);
+
+	do {
+		pthread_mutex_lock(&nl_rx.mtx);
+		{
+			for (i = 0; i < NL_RX_BATCH; i++) {
+				dg[i] = TAILQ_FIRST(&nl_rx.spare);
+				if (!dg[i])
+					continue;
+				TAILQ_REMOVE(&nl_rx.spare, dg[i], entry);
+				nl_rx.nspare--;
 			}
 		}
+		pthread_mutex_unlock(&nl_rx.mtx);
+
+		memset(msgs, 0, sizeof(msgs));
+		for (i = 0; i < NL_RX_BATCH; i++) {
+			if (!dg[i])
+				dg[i] = XMALLOC(MTYPE_NL_RX_DGRAM,
+						sizeof(struct nl_rx_dgram));
+			iov[i].iov_base = dg[i]->buf;
+			iov[i].iov_len = sizeof(dg[i]->buf);
+			msgs[i].msg_hdr.msg_name = &dg[i]->snl;
+			msgs[i].msg_hdr.msg_namelen = sizeof(dg[i]->snl);
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
 
-		/* After error care. */
-		if (msg.msg_flags & MSG_TRUNC) {
-			zlog_err("%s error: message truncated", nl->name);
+		n = recvmmsg(nl->sock, msgs, NL_RX_BATCH, MSG_DONTWAIT, NULL);
+		if (n < 0) {
+			if (errno != EINTR && errno != EWOULDBLOCK
+			    && errno != EAGAIN) {
+				zlog_err("%s recvmmsg overrun: %s", nl->name,
+					 safe_strerror(errno));
+				/*
+				 *  In this case we are screwed.
+				 *  There is no good way to
+				 *  recover zebra at this point.
+				 */
+				exit(-1);
+			}
+			n = errno == EINTR ? NL_RX_BATCH : 0;
+			for (i = 0; i < NL_RX_BATCH; i++)
+				TAILQ_INSERT_TAIL(&unused, dg[i], entry);
 			continue;
 		}
-		if (status) {
-			zlog_err("%s error: data remnant size %d", nl->name,
-				 status);
-			return -1;
+
+		for (i = 0; i < NL_RX_BATCH; i++) {
+			if (i >= n) {
+				TAILQ_INSERT_TAIL(&unused, dg[i], entry);
+				continue;
+			}
+			if (msgs[i].msg_hdr.msg_namelen != sizeof(dg[i]->snl)) {
+				zlog_err("%s sender address length error: length %d",
+					 nl->name, msgs[i].msg_hdr.msg_namelen);
+				TAILQ_INSERT_TAIL(&unused, dg[i], entry);
+				continue;
+			}
+			dg[i]->zns = zns;
+			dg[i]->len = msgs[i].msg_len;
+			dg[i]->flags = msgs[i].msg_hdr.msg_flags;
+			TAILQ_INSERT_TAIL(&batch, dg[i], entry);
 		}
+	} while (n == NL_RX_BATCH);
+
+	pthread_mutex_lock(&nl_rx.mtx);
+	{
+		TAILQ_CONCAT(&nl_rx.queue, &batch, entry);
+		netlink_rx_put(&unused);
 	}
-	return ret;
+	pthread_mutex_unlock(&nl_rx.mtx);
+
+	thread_add_event(zebrad.master, netlink_rx_process, NULL, 0,
+			 &nl_rx.t_process);
+	thread_add_read(nl_rx.pthread->master, netlink_rx_read, zns, nl->sock,
+			&zns->t_netlink);
+	return 0;
+}
+
+/* Takes a listen socket off the reader pthread, on that pthread. */
+static int netlink_rx_release(struct thread *thread)
+{
+	struct zebra_ns *zns = THREAD_ARG(thread);
+
+	THREAD_READ_OFF(zns->t_netlink);
+
+	pthread_mutex_lock(&nl_rx.mtx);
+	{
+		zns->netlink_async = false;
+		pthread_cond_broadcast(&nl_rx.cond);
+	}
+	pthread_mutex_unlock(&nl_rx.mtx);
+	return 0;
+}
+
+static int netlink_rx_start(void)
+{
+	struct frr_pthread *pthread;
+
+	if (nl_rx.pthread)
+		return 0;
+
+	pthread = frr_pthread_new(NULL, "Zebra netlink reader");
+	if (!pthread || frr_pthread_run(pthread, NULL)) {
+		zlog_err("Can't start netlink reader pthread, kernel events will be read inline");
+		return -1;
+	}
+	frr_pthread_wait_running(pthread);
+
+	nl_rx.pthread = pthread;
+	return 0;
+}
+
+static void netlink_rx_stop(struct zebra_ns *zns)
+{
+	struct nl_rx_dgram *dg, *next;
+	struct nl_rx_list drop;
+
+	if (!zns->netlink_async)
+		return;
+
+	TAILQ_INIT(&drop);
+
+	thread_post_event(nl_rx.pthread->master, netlink_rx_release, zns, 0);
+
+	pthread_mutex_lock(&nl_rx.mtx);
+	{
+		while (zns->netlink_async)
+			pthread_cond_wait(&nl_rx.cond, &nl_rx.mtx);
+
+		TAILQ_FOREACH_SAFE (dg, &nl_rx.queue, entry, next)
+			if (dg->zns == zns) {
+				TAILQ_REMOVE(&nl_rx.queue, dg, entry);
+				TAILQ_INSERT_TAIL(&drop, dg, entry);
+			}
+		netlink_rx_put(&drop);
+	}
+	pthread_mutex_unlock(&nl_rx.mtx);
+
+	if (--nl_rx.nsocks)
+		return;
+
+	frr_pthread_stop(nl_rx.pthread, NULL);
+	nl_rx.pthread = NULL;
+	THREAD_OFF(nl_rx.t_process);
+
+	while ((dg = TAILQ_FIRST(&nl_rx.spare))) {
+		TAILQ_REMOVE(&nl_rx.spare, dg, entry);
+		XFREE(MTYPE_NL_RX_DGRAM, dg);
+	}
+	nl_rx.nspare = 0;
+}
+
+/*
+ * The first event on a listen socket hands it over to the reader pthread;
+ * that can't be started any earlier, zebra may still fork.
+ */
+static int kernel_read(struct thread *thread)
+{
+	struct zebra_ns *zns = (struct zebra_ns *)THREAD_ARG(thread);
+
+	zns->t_netlink = NULL;
+
+	if (!netlink_rx_start()) {
+		zns->netlink_async = true;
+		nl_rx.nsocks++;
+		thread_post_event(nl_rx.pthread->master, netlink_rx_read, zns,
+				  0);
+		return 0;
+	}
+
+	netlink_parse_info(netlink_information_fetch, &zns->netlink, zns, 5, 0);
+	thread_add_read(zebrad.master, kernel_read, zns, zns->netlink.sock,
+			&zns->t_netlink);
+
+	return 0;
 }
 
 /*
@@ -735,6 +1054,172 @@ int netlink_talk(int (*filter)(struct sockaddr_nl *, struct nlmsghdr *, ns_id_t,
 	return netlink_parse_info(filter, nl, zns, 0, startup);
 }
 
+/*
+ * netlink_talk_batch
+ *
+ * sendmsg() a buffer holding several requests to netlink socket in one go
+ * then recvmsg() until every one of them has been answered.
+ *
+ * ack   -> Called once per request with its index in the buffer and 0 for
+ *          success or -1 for failure
+ * arg   -> Passed through to ack
+ * n     -> The first of the requests, the others follow NLMSG_ALIGN'ed
+ * len   -> Total length of the requests
+ * nl    -> The netlink socket information
+ * zns   -> The zebra namespace information
+ *
+ * Returns 0 once all requests have been answered, -1 if sending or
+ * receiving failed, in which case requests not answered yet have not been
+ * passed to ack.
+ */
+int netlink_talk_batch(void (*ack)(unsigned int, int, void *), void *arg,
+		       struct nlmsghdr *n, size_t len, struct nlsock *nl,
+		       struct zebra_ns *zns)
+{
+	int status;
+	struct sockaddr_nl snl;
+	struct iovec iov;
+	struct msghdr msg;
+	struct nlmsghdr *h;
+	int save_errno;
+	int remain = len;
+	uint32_t first = nl->seq + 1;
+	unsigned int count = 0;
+	unsigned int pending;
+
+	for (h = n; NLMSG_OK(h, remain); h = NLMSG_NEXT(h, remain)) {
+		h->nlmsg_seq = ++nl->seq;
+		h->nlmsg_pid = nl->snl.nl_pid;
+
+		/* Request an acknowledgement by setting NLM_F_ACK */
+		h->nlmsg_flags |= NLM_F_ACK;
+
+		if (IS_ZEBRA_DEBUG_KERNEL)
+			zlog_debug(
+				"netlink_talk_batch: %s type %s(%u), len=%d seq=%u flags 0x%x",
+				nl->name, nl_msg_type_to_str(h->nlmsg_type),
+				h->nlmsg_type, h->nlmsg_len, h->nlmsg_seq,
+				h->nlmsg_flags);
+		count++;
+	}
+
+	memset(&snl, 0, sizeof snl);
+	memset(&iov, 0, sizeof iov);
+	memset(&msg, 0, sizeof msg);
+
+	iov.iov_base = n;
+	iov.iov_len = len;
+	msg.msg_name = (void *)&snl;
+	msg.msg_namelen = sizeof snl;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	snl.nl_family = AF_NETLINK;
+
+	/* Send messages to netlink interface. */
+	if (zserv_privs.change(ZPRIVS_RAISE))
+		zlog_err("Can't raise privileges");
+	status = sendmsg(nl->sock, &msg, 0);
+	save_errno = errno;
+	if (zserv_privs.change(ZPRIVS_LOWER))
+		zlog_err("Can't lower privileges");
+
+	if (IS_ZEBRA_DEBUG_KERNEL_MSGDUMP_SEND) {
+		zlog_debug("%s: >> netlink message dump [sent]", __func__);
+		zlog_hexdump(n, len);
+	}
+
+	if (status < 0) {
+		zlog_err("netlink_talk_batch sendmsg() error: %s",
+			 safe_strerror(save_errno));
+		return -1;
+	}
+
+	/*
+	 * The kernel handles the requests in order and answers each of them
+	 * with an acknowledgement or an error, which carry the sequence
+	 * number of the request they belong to.
+	 */
+	pending = count;
+	while (pending) {
+		char buf[NL_PKT_BUF_SIZE];
+
+		iov.iov_base = buf;
+		iov.iov_len = sizeof buf;
+		msg.msg_namelen = sizeof snl;
+		msg.msg_flags = 0;
+
+		status = recvmsg(nl->sock, &msg, 0);
+		if (status < 0) {
+			if (errno == EINTR)
+				continue;
+			zlog_err("%s recvmsg error: %s", nl->name,
+				 safe_strerror(errno));
+			return -1;
+		}
+
+		if (status == 0) {
+			zlog_err("%s EOF", nl->name);
+			return -1;
+		}
+
+		if (IS_ZEBRA_DEBUG_KERNEL_MSGDUMP_RECV) {
+			zlog_debug("%s: << netlink message dump [recv]",
+				   __func__);
+			zlog_hexdump(buf, status);
+		}
+
+		for (h = (struct nlmsghdr *)buf;
+		     NLMSG_OK(h, (unsigned int)status);
+		     h = NLMSG_NEXT(h, status)) {
+			struct nlmsgerr *err;
+			unsigned int index;
+
+			if (h->nlmsg_type != NLMSG_ERROR) {
+				if (IS_ZEBRA_DEBUG_KERNEL)
+					zlog_debug(
+						"netlink_talk_batch: %s ignoring type %s(%u), seq=%u",
+						nl->name,
+						nl_msg_type_to_str(
+							h->nlmsg_type),
+						h->nlmsg_type, h->nlmsg_seq);
+				continue;
+			}
+
+			err = (struct nlmsgerr *)NLMSG_DATA(h);
+			index = err->msg.nlmsg_seq - first;
+			if (index >= count) {
+				if (IS_ZEBRA_DEBUG_KERNEL)
+					zlog_debug(
+						"netlink_talk_batch: %s stale reply seq=%u",
+						nl->name, err->msg.nlmsg_seq);
+				continue;
+			}
+
+			if (err->error == 0) {
+				if (IS_ZEBRA_DEBUG_KERNEL)
+					zlog_debug(
+						"%s: %s ACK: type=%s(%u), seq=%u, pid=%u",
+						__func__, nl->name,
+						nl_msg_type_to_str(
+							err->msg.nlmsg_type),
+						err->msg.nlmsg_type,
+						err->msg.nlmsg_seq,
+						err->msg.nlmsg_pid);
+				(*ack)(index, 0, arg);
+			} else
+				(*ack)(index, netlink_parse_error(nl, zns, h),
+				       arg);
+			pending--;
+		}
+
+		if (msg.msg_flags & MSG_TRUNC)
+			zlog_err("%s error: message truncated", nl->name);
+	}
+
+	return 0;
+}
+
 /* Issue request message to kernel via netlink socket. GET messages
  * are issued through this interface.
  */
@@ -802,6 +1287,15 @@ void kernel_init(struct zebra_ns *zns)
 	zns->netlink_cmd.sock = -1;
 	netlink_socket(&zns->netlink_cmd, 0, zns->ns_id);
 
+	snprintf(zns->netlink_dplane.name, sizeof(zns->netlink_dplane.name),
+		 "netlink-dp (NS %u)", zns->ns_id);
+	zns->netlink_dplane.sock = -1;
+	netlink_socket(&zns->netlink_dplane, 0, zns->ns_id);
+
+	/* Replies to batched route updates pile up on the dataplane socket */
+	if (zns->netlink_dplane.sock > 0 && nl_rcvbufsize)
+		netlink_recvbuf(&zns->netlink_dplane, nl_rcvbufsize);
+
 	/* Register kernel socket. */
 	if (zns->netlink.sock > 0) {
 		/* Only want non-blocking on the netlink event socket */
@@ -814,7 +1308,8 @@ void kernel_init(struct zebra_ns *zns)
 			netlink_recvbuf(&zns->netlink, nl_rcvbufsize);
 
 		netlink_install_filter(zns->netlink.sock,
-				       zns->netlink_cmd.snl.nl_pid);
+				       zns->netlink_cmd.snl.nl_pid,
+				       zns->netlink_dplane.snl.nl_pid);
 		zns->t_netlink = NULL;
 		thread_add_read(zebrad.master, kernel_read, zns,
 				zns->netlink.sock, &zns->t_netlink);
@@ -825,7 +1320,13 @@ void kernel_init(struct zebra_ns *zns)
 
 void kernel_terminate(struct zebra_ns *zns)
 {
-	THREAD_READ_OFF(zns->t_netlink);
+	if (zns->netlink_async)
+		netlink_rx_stop(zns);
+	else
+		THREAD_READ_OFF(zns->t_netlink);
+
+	/* Don't pull the dataplane socket from under queued updates */
+	kernel_route_rib_wait();
 
 	if (zns->netlink.sock >= 0) {
 		close(zns->netlink.sock);
@@ -836,6 +1337,11 @@ void kernel_terminate(struct zebra_ns *zns)
 		close(zns->netlink_cmd.sock);
 		zns->netlink_cmd.sock = -1;
 	}
+
+	if (zns->netlink_dplane.sock >= 0) {
+		close(zns->netlink_dplane.sock);
+		zns->netlink_dplane.sock = -1;
+	}
 }
 
 #endif /* HAVE_NETLINK */
@@ -54,6 +54,9 @@ extern int netlink_talk(int (*filter)(struct sockaddr_nl *, struct nlmsghdr *,
 				      ns_id_t, int startup),
 			struct nlmsghdr *n, struct nlsock *nl,
 			struct zebra_ns *zns, int startup);
+extern int netlink_talk_batch(void (*ack)(unsigned int, int, void *),
+			      void *arg, struct nlmsghdr *n, size_t len,
+			      struct nlsock *nl, struct zebra_ns *zns);
 extern int netlink_request(struct nlsock *nl, struct nlmsghdr *n);
 
 #endif /* HAVE_NETLINK */
@@ -27,6 +27,7 @@
 
 #include "zebra.h"
 #include "zserv.h"
+#include "lib/buffer.h"
 #include "lib/log.h"
 #include "lib/memory.h"
 #include "lib/mpls.h"
@@ -45,76 +46,57 @@ extern struct zebra_privs_t zserv_privs;
 
 DEFINE_MGROUP(LBL_MGR, "Label Manager");
 DEFINE_MTYPE_STATIC(LBL_MGR, LM_CHUNK, "Label Manager Chunk");
+DEFINE_MTYPE_STATIC(LBL_MGR, LM_PENDING, "Label Manager Pending Request");
 
 /* In case this zebra daemon is not acting as label manager,
  * it will be a proxy to relay messages to external label manager
  * This zclient thus is to connect to it
  */
-static struct stream *ibuf;
-static struct stream *obuf;
 static struct zclient *zclient;
 bool lm_is_external;
 
-static void delete_label_chunk(void *val)
-{
-	XFREE(MTYPE_LM_CHUNK, val);
-}
-
-static int relay_response_back(struct zserv *zserv)
-{
-	int ret = 0;
-	struct stream *src, *dst;
-	uint16_t size = 0;
-	uint8_t marker;
-	uint8_t version;
+/*
+ * Requests relayed to the external label manager and still waiting for
+ * their response. It answers them in order, so the head of the list is the
+ * client the next response belongs to. The client is cleared if it goes
+ * away before its response arrives.
+ */
+struct lm_pending_request {
+	struct zserv *client;
+	uint16_t cmd;
 	vrf_id_t vrf_id;
-	uint16_t resp_cmd;
+};
 
-	src = zclient->ibuf;
-	dst = obuf;
+static struct list *lm_pending;
 
-	stream_reset(src);
-
-	ret = zclient_read_header(src, zclient->sock, &size, &marker, &version,
-				  &vrf_id, &resp_cmd);
-	if (ret < 0 && errno != EAGAIN) {
-		zlog_err("%s: Error reading Label Manager response: %s",
-			 __func__, strerror(errno));
-		return -1;
-	}
-	zlog_debug("%s: Label Manager response received, %d bytes", __func__,
-		   size);
-	if (size == 0)
-		return -1;
+static int lm_zclient_connect(struct thread *t);
+static int lm_zclient_read(struct thread *t);
 
-	/* send response back */
-	stream_copy(dst, src);
-	ret = writen(zserv->sock, src->data, stream_get_endp(src));
-	if (ret <= 0) {
-		zlog_err("%s: Error sending Label Manager response back: %s",
-			 __func__, strerror(errno));
+static int lm_chunk_compare(const struct label_manager_chunk *a,
+			    const struct label_manager_chunk *b)
+{
+	if (a->start < b->start)
 		return -1;
-	}
-	zlog_debug("%s: Label Manager response (%d bytes) sent back", __func__,
-		   ret);
-
+	if (a->start > b->start)
+		return 1;
 	return 0;
 }
+RB_GENERATE(lm_chunk_head, label_manager_chunk, entry, lm_chunk_compare)
 
-static int lm_zclient_read(struct thread *t)
+static int lm_free_chunk_compare(const struct label_manager_chunk *a,
+				 const struct label_manager_chunk *b)
 {
-	struct zserv *zserv;
-	int ret;
-
-	/* Get socket to zebra. */
-	zserv = THREAD_ARG(t);
-	zclient->t_read = NULL;
-
-	/* read response and send it back */
-	ret = relay_response_back(zserv);
+	uint32_t size_a = a->end - a->start;
+	uint32_t size_b = b->end - b->start;
 
-	return ret;
+	if (size_a < size_b)
+		return -1;
+	if (size_a > size_b)
+		return 1;
+	return lm_chunk_compare(a, b);
 }
+RB_GENERATE(lm_free_chunk_head, label_manager_chunk, free_entry,
+	    lm_free_chunk_compare)
 
 static int reply_error(int cmd, struct zserv *zserv, vrf_id_t vrf_id)
 {
@@ -136,22 +118,180 @@ static int reply_error(int cmd, struct zserv *zserv, vrf_id_t vrf_id)
 	stream_free(s);
 	return ret;
 }
+
+static void lm_pending_del(void *val)
+{
+	XFREE(MTYPE_LM_PENDING, val);
+}
+
+/*
+ * The connection to the external label manager is gone: drop whatever was
+ * half read or written, fail the requests still waiting and try to reconnect.
+ */
+static void lm_zclient_fail(void)
+{
+	struct lm_pending_request *req;
+
+	zlog_err("%s: Lost connection to external label manager", __func__);
+
+	THREAD_OFF(zclient->t_read);
+	THREAD_OFF(zclient->t_write);
+	if (zclient->sock >= 0) {
+		close(zclient->sock);
+		zclient->sock = -1;
+	}
+	stream_reset(zclient->ibuf);
+	buffer_reset(zclient->wb);
+
+	while ((req = listnode_head(lm_pending))) {
+		if (req->client)
+			reply_error(req->cmd, req->client, req->vrf_id);
+		listnode_delete(lm_pending, req);
+		lm_pending_del(req);
+	}
+
+	if (!zclient->t_connect)
+		thread_add_timer(zebrad.master, lm_zclient_connect, zclient,
+				 CONNECTION_DELAY, &zclient->t_connect);
+}
+
+static void lm_zclient_event_read(void)
+{
+	thread_add_read(zclient->master, lm_zclient_read, NULL, zclient->sock,
+			&zclient->t_read);
+}
+
+/* Hand a complete response over to the client waiting for it */
+static void relay_response_back(struct stream *s)
+{
+	struct lm_pending_request *req;
+	int ret;
+
+	req = listnode_head(lm_pending);
+	if (!req) {
+		zlog_warn("%s: Unexpected Label Manager response, dropping",
+			  __func__);
+		return;
+	}
+	listnode_delete(lm_pending, req);
+
+	if (!req->client) {
+		zlog_debug("%s: Client gone, dropping Label Manager response",
+			   __func__);
+		lm_pending_del(req);
+		return;
+	}
+
+	ret = writen(req->client->sock, STREAM_DATA(s), stream_get_endp(s));
+	if (ret <= 0)
+		zlog_err("%s: Error sending Label Manager response back: %s",
+			 __func__, strerror(errno));
+	else
+		zlog_debug("%s: Label Manager response (%d bytes) sent back",
+			   __func__, ret);
+
+	lm_pending_del(req);
+}
+
+/*
+ * Read responses from the external label manager without blocking: partial
+ * messages stay in ibuf until the rest arrives, the same way zclient_read()
+ * does.
+ */
+static int lm_zclient_read(struct thread *t)
+{
+	struct stream *s = zclient->ibuf;
+	size_t already;
+	uint16_t length;
+	ssize_t nbyte;
+
+	zclient->t_read = NULL;
+
+	already = stream_get_endp(s);
+	if (already < ZEBRA_HEADER_SIZE) {
+		nbyte = stream_read_try(s, zclient->sock,
+					ZEBRA_HEADER_SIZE - already);
+		if (nbyte == 0 || nbyte == -1) {
+			lm_zclient_fail();
+			return -1;
+		}
+		if (nbyte != (ssize_t)(ZEBRA_HEADER_SIZE - already)) {
+			lm_zclient_event_read();
+			return 0;
+		}
+		already = ZEBRA_HEADER_SIZE;
+	}
+
+	length = stream_getw_from(s, 0);
+	if (length < ZEBRA_HEADER_SIZE || length > STREAM_SIZE(s)) {
+		zlog_err("%s: Bad Label Manager response length %u", __func__,
+			 length);
+		lm_zclient_fail();
+		return -1;
+	}
+
+	if (already < length) {
+		nbyte = stream_read_try(s, zclient->sock, length - already);
+		if (nbyte == 0 || nbyte == -1) {
+			lm_zclient_fail();
+			return -1;
+		}
+		if (nbyte != (ssize_t)(length - already)) {
+			lm_zclient_event_read();
+			return 0;
+		}
+	}
+
+	zlog_debug("%s: Label Manager response received, %u bytes", __func__,
+		   length);
+	relay_response_back(s);
+	stream_reset(s);
+
+	lm_zclient_event_read();
+
+	return 0;
+}
+
+static int lm_zclient_flush(struct thread *t)
+{
+	zclient->t_write = NULL;
+
+	if (zclient->sock < 0)
+		return -1;
+
+	switch (buffer_flush_available(zclient->wb, zclient->sock)) {
+	case BUFFER_ERROR:
+		lm_zclient_fail();
+		return -1;
+	case BUFFER_PENDING:
+		thread_add_write(zclient->master, lm_zclient_flush, NULL,
+				 zclient->sock, &zclient->t_write);
+		break;
+	case BUFFER_EMPTY:
+		break;
+	}
+
+	return 0;
+}
+
 /**
  * Receive a request to get or release a label chunk and forward it to external
  * label manager.
  *
  * It's called from zserv in case it's not an actual label manager, but just a
- * proxy.
+ * proxy. The request is queued to the external label manager and the
+ * response relayed back from lm_zclient_read() whenever it arrives, so
+ * requests from several clients are in flight at once.
  *
  * @param cmd Type of request (connect, get or release)
  * @param zserv
+ * @param msg Request as received from the client, header included
  * @return 0 on success, -1 otherwise
  */
 int zread_relay_label_manager_request(int cmd, struct zserv *zserv,
-				      vrf_id_t vrf_id)
+				      struct stream *msg, vrf_id_t vrf_id)
 {
-	struct stream *src, *dst;
-	int ret = 0;
+	struct lm_pending_request *req;
 
 	if (zclient->sock < 0) {
 		zlog_err(
@@ -161,36 +301,51 @@ int zread_relay_label_manager_request(int cmd, struct zserv *zserv,
 		return -1;
 	}
 
-	/* in case there's any incoming message enqueued, read and forward it */
-	while (ret == 0)
-		ret = relay_response_back(zserv);
+	/* Release label chunk has no response */
+	if (cmd != ZEBRA_RELEASE_LABEL_CHUNK) {
+		req = XCALLOC(MTYPE_LM_PENDING, sizeof(*req));
+		req->client = zserv;
+		req->cmd = cmd;
+		req->vrf_id = vrf_id;
+		listnode_add(lm_pending, req);
+	}
 
 	/* Send request to external label manager */
-	src = ibuf;
-	dst = zclient->obuf;
-
-	stream_copy(dst, src);
-
-	ret = writen(zclient->sock, dst->data, stream_get_endp(dst));
-	if (ret <= 0) {
+	switch (buffer_write(zclient->wb, zclient->sock, STREAM_DATA(msg),
+			     stream_get_endp(msg))) {
+	case BUFFER_ERROR:
 		zlog_err("%s: Error relaying label chunk request: %s", __func__,
 			 strerror(errno));
-		reply_error(cmd, zserv, vrf_id);
+		lm_zclient_fail();
 		return -1;
+	case BUFFER_EMPTY:
+		break;
+	case BUFFER_PENDING:
+		thread_add_write(zclient->master, lm_zclient_flush, NULL,
+				 zclient->sock, &zclient->t_write);
+		break;
 	}
-	zlog_debug("%s: Label chunk request relayed. %d bytes sent", __func__,
-		   ret);
+	zlog_debug("%s: Label chunk request relayed. %zu bytes queued",
+		   __func__, stream_get_endp(msg));
 
-	/* Release label chunk has no response */
-	if (cmd == ZEBRA_RELEASE_LABEL_CHUNK)
-		return 0;
+	return 0;
+}
 
-	/* make sure we listen to the response */
-	if (!zclient->t_read)
-		thread_add_read(zclient->master, lm_zclient_read, zserv,
-				zclient->sock, &zclient->t_read);
+/**
+ * Forget a client going away, so that responses still to come for it from
+ * the external label manager are dropped.
+ */
+void label_manager_client_close(struct zserv *zserv)
+{
+	struct listnode *node;
+	struct lm_pending_request *req;
 
-	return 0;
+	if (!lm_is_external)
+		return;
+
+	for (ALL_LIST_ELEMENTS_RO(lm_pending, node, req))
+		if (req->client == zserv)
+			req->client = NULL;
 }
 
 static int lm_zclient_connect(struct thread *t)
@@ -212,6 +367,9 @@ static int lm_zclient_connect(struct thread *t)
 		zlog_warn("%s: set_nonblocking(%d) failed", __func__,
 			  zclient->sock);
 
+	/* listen to responses for as long as we are connected */
+	lm_zclient_event_read();
+
 	return 0;
 }
 
@@ -232,6 +390,8 @@ static void lm_zclient_init(char *lm_zserv_path)
 	zclient->privs = &zserv_privs;
 	zclient->sock = -1;
 	zclient->t_connect = NULL;
+	lm_pending = list_new();
+	lm_pending->del = lm_pending_del;
 	lm_zclient_connect(NULL);
 }
 
@@ -244,24 +404,21 @@ void label_manager_init(char *lm_zserv_path)
 	if (!lm_zserv_path) {
 		zlog_debug("Initializing own label manager");
 		lm_is_external = false;
-		lbl_mgr.lc_list = list_new();
-		lbl_mgr.lc_list->del = delete_label_chunk;
+		RB_INIT(lm_chunk_head, &lbl_mgr.chunks);
+		RB_INIT(lm_free_chunk_head, &lbl_mgr.free_chunks);
 	} else { /* it's acting just as a proxy */
 		zlog_debug("Initializing external label manager at %s",
 			   lm_zserv_path);
 		lm_is_external = true;
 		lm_zclient_init(lm_zserv_path);
 	}
-
-	ibuf = stream_new(ZEBRA_MAX_PACKET_SIZ);
-	obuf = stream_new(ZEBRA_MAX_PACKET_SIZ);
 }
 
 /**
  * Core function, assigns label cunks
  *
- * It first searches through the list to check if there's one available
- * (previously released). Otherwise it creates and assigns a new one
+ * It first looks up the released chunks for one of the same size.
+ * Otherwise it creates and assigns a new one right after the last chunk
  *
  * @param proto Daemon protocol of client, to identify the owner
  * @param instance Instance, to identify the owner
@@ -273,31 +430,33 @@ struct label_manager_chunk *assign_label_chunk(uint8_t proto,
 					       unsigned short instance,
 					       uint8_t keep, uint32_t size)
 {
-	struct label_manager_chunk *lmc;
-	struct listnode *node;
+	struct label_manager_chunk *lmc, *last;
+	struct label_manager_chunk key;
 
-	/* first check if there's one available */
-	for (ALL_LIST_ELEMENTS_RO(lbl_mgr.lc_list, node, lmc)) {
-		if (lmc->proto == NO_PROTO
-		    && lmc->end - lmc->start + 1 == size) {
-			lmc->proto = proto;
-			lmc->instance = instance;
-			lmc->keep = keep;
-			return lmc;
-		}
+	if (size == 0)
+		return NULL;
+
+	/* first check if there's one available, of the very same size */
+	key.start = 0;
+	key.end = size - 1;
+	lmc = RB_NFIND(lm_free_chunk_head, &lbl_mgr.free_chunks, &key);
+	if (lmc && lmc->end - lmc->start + 1 == size) {
+		RB_REMOVE(lm_free_chunk_head, &lbl_mgr.free_chunks, lmc);
+		lmc->proto = proto;
+		lmc->instance = instance;
+		lmc->keep = keep;
+		return lmc;
 	}
 	/* otherwise create a new one */
 	lmc = XCALLOC(MTYPE_LM_CHUNK, sizeof(struct label_manager_chunk));
 	if (!lmc)
 		return NULL;
 
-	if (list_isempty(lbl_mgr.lc_list))
+	last = RB_MAX(lm_chunk_head, &lbl_mgr.chunks);
+	if (!last)
 		lmc->start = MPLS_LABEL_UNRESERVED_MIN;
 	else
-		lmc->start = ((struct label_manager_chunk *)listgetdata(
-				      listtail(lbl_mgr.lc_list)))
-				     ->end
-			     + 1;
+		lmc->start = last->end + 1;
 	if (lmc->start > MPLS_LABEL_UNRESERVED_MAX - size + 1) {
 		zlog_err("Reached max labels. Start: %u, size: %u", lmc->start,
 			 size);
@@ -308,7 +467,7 @@ struct label_manager_chunk *assign_label_chunk(uint8_t proto,
 	lmc->proto = proto;
 	lmc->instance = instance;
 	lmc->keep = keep;
-	listnode_add(lbl_mgr.lc_list, lmc);
+	RB_INSERT(lm_chunk_head, &lbl_mgr.chunks, lmc);
 
 	return lmc;
 }
@@ -325,27 +484,26 @@ struct label_manager_chunk *assign_label_chunk(uint8_t proto,
 int release_label_chunk(uint8_t proto, unsigned short instance, uint32_t start,
 			uint32_t end)
 {
-	struct listnode *node;
 	struct label_manager_chunk *lmc;
+	struct label_manager_chunk key;
 	int ret = -1;
 
 	/* check that size matches */
 	zlog_debug("Releasing label chunk: %u - %u", start, end);
 	/* find chunk and disown */
-	for (ALL_LIST_ELEMENTS_RO(lbl_mgr.lc_list, node, lmc)) {
-		if (lmc->start != start)
-			continue;
-		if (lmc->end != end)
-			continue;
+	key.start = start;
+	lmc = RB_FIND(lm_chunk_head, &lbl_mgr.chunks, &key);
+	if (lmc && lmc->end == end && lmc->proto != NO_PROTO) {
 		if (lmc->proto != proto || lmc->instance != instance) {
 			zlog_err("%s: Daemon mismatch!!", __func__);
-			continue;
+		} else {
+			lmc->proto = NO_PROTO;
+			lmc->instance = 0;
+			lmc->keep = 0;
+			RB_INSERT(lm_free_chunk_head, &lbl_mgr.free_chunks,
+				  lmc);
+			ret = 0;
 		}
-		lmc->proto = NO_PROTO;
-		lmc->instance = 0;
-		lmc->keep = 0;
-		ret = 0;
-		break;
 	}
 	if (ret != 0)
 		zlog_err("%s: Label chunk not released!!", __func__);
@@ -365,12 +523,11 @@ int release_label_chunk(uint8_t proto, unsigned short instance, uint32_t start,
  */
 int release_daemon_label_chunks(uint8_t proto, unsigned short instance)
 {
-	struct listnode *node;
 	struct label_manager_chunk *lmc;
 	int count = 0;
 	int ret;
 
-	for (ALL_LIST_ELEMENTS_RO(lbl_mgr.lc_list, node, lmc)) {
+	RB_FOREACH (lmc, lm_chunk_head, &lbl_mgr.chunks) {
 		if (lmc->proto == proto && lmc->instance == instance
 		    && lmc->keep == 0) {
 			ret = release_label_chunk(lmc->proto, lmc->instance,
@@ -387,7 +544,16 @@ int release_daemon_label_chunks(uint8_t proto, unsigned short instance)
 
 void label_manager_close()
 {
-	list_delete_and_null(&lbl_mgr.lc_list);
-	stream_free(ibuf);
-	stream_free(obuf);
+	struct label_manager_chunk *lmc;
+
+	if (lm_is_external) {
+		list_delete_and_null(&lm_pending);
+		return;
+	}
+
+	while ((lmc = RB_ROOT(lm_chunk_head, &lbl_mgr.chunks))) {
+		RB_REMOVE(lm_chunk_head, &lbl_mgr.chunks, lmc);
+		XFREE(MTYPE_LM_CHUNK, lmc);
+	}
+	RB_INIT(lm_free_chunk_head, &lbl_mgr.free_chunks);
 }
@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 #include "lib/linklist.h"
+#include "lib/openbsd-tree.h"
 #include "lib/thread.h"
 
 #define NO_PROTO 0
@@ -49,20 +50,31 @@ struct label_manager_chunk {
 	uint8_t keep;
 	uint32_t start; /* First label of the chunk */
 	uint32_t end;   /* Last label of the chunk */
+
+	RB_ENTRY(label_manager_chunk) entry;
+	RB_ENTRY(label_manager_chunk) free_entry;
 };
+RB_HEAD(lm_chunk_head, label_manager_chunk);
+RB_PROTOTYPE(lm_chunk_head, label_manager_chunk, entry, lm_chunk_compare)
+RB_HEAD(lm_free_chunk_head, label_manager_chunk);
+RB_PROTOTYPE(lm_free_chunk_head, label_manager_chunk, free_entry,
+	     lm_free_chunk_compare)
 
 /*
  * Main label manager struct
- * Holds a linked list of label chunks.
+ * Holds the label chunks by their first label, and those not owned by
+ * anyone by size, so that assigning and releasing a chunk is O(log n).
  */
 struct label_manager {
-	struct list *lc_list;
+	struct lm_chunk_head chunks;
+	struct lm_free_chunk_head free_chunks;
 };
 
 bool lm_is_external;
 
 int zread_relay_label_manager_request(int cmd, struct zserv *zserv,
-				      vrf_id_t vrf_id);
+				      struct stream *msg, vrf_id_t vrf_id);
+void label_manager_client_close(struct zserv *zserv);
 void label_manager_init(char *lm_zserv_path);
 struct label_manager_chunk *assign_label_chunk(uint8_t proto,
 					       unsigned short instance,
@@ -36,6 +36,8 @@
 #include "vrf.h"
 #include "logicalrouter.h"
 #include "libfrr.h"
+#include "frr_pthread.h"
+#include "stream.h"
 
 #include "zebra/rib.h"
 #include "zebra/zserv.h"
@@ -49,6 +51,7 @@
 #include "zebra/zebra_mpls.h"
 #include "zebra/label_manager.h"
 #include "zebra/zebra_netns_notify.h"
+#include "zebra/zebra_dplane.h"
 
 #define ZEBRA_PTM_SUPPORT
 
@@ -56,6 +59,10 @@
 struct zebra_t zebrad = {
 	.rtm_table_default = 0,
 	.packets_to_process = ZEBRA_ZAPI_PACKETS_TO_PROCESS,
+	.rib_batch = ZEBRA_RIB_PROCESS_BATCH,
+	.if_hold_time = ZEBRA_IF_HOLD_TIME,
+	.zapi_wm_high = ZEBRA_ZAPI_WM_HIGH,
+	.zapi_wm_low = ZEBRA_ZAPI_WM_LOW,
 };
 
 /* process id. */
@@ -73,6 +80,9 @@ int allow_delete = 0;
 /* Don't delete kernel route. */
 int keep_kernel_mode = 0;
 
+/* Seconds to keep kernel routes of an earlier run, for clients to refresh. */
+static int graceful_restart;
+
 #ifdef HAVE_NETLINK
 /* Receive buffer size for netlink socket */
 uint32_t nl_rcvbufsize = 4194304;
@@ -82,6 +92,7 @@ uint32_t nl_rcvbufsize = 4194304;
 struct option longopts[] = {{"batch", no_argument, NULL, 'b'},
 			    {"allow_delete", no_argument, NULL, 'a'},
 			    {"keep_kernel", no_argument, NULL, 'k'},
+			    {"graceful_restart", required_argument, NULL, 'K'},
 			    {"socket", required_argument, NULL, 'z'},
 			    {"ecmp", required_argument, NULL, 'e'},
 			    {"label_socket", no_argument, NULL, 'l'},
@@ -145,6 +156,7 @@ static void sigint(void)
 
 	ns_walk_func(zebra_ns_disabled);
 	zebra_ns_notify_close();
+	zebra_dplane_finish();
 
 	access_list_reset();
 	prefix_list_reset();
@@ -154,6 +166,7 @@ static void sigint(void)
 	work_queue_free_and_null(&zebrad.ribq);
 	meta_queue_free(zebrad.mq);
 
+	frr_pthread_finish();
 	frr_fini();
 	exit(0);
 }
@@ -194,6 +207,13 @@ FRR_DAEMON_INFO(
 
 	.privs = &zserv_privs, )
 
+/* Graceful restart time is up, remove what was not refreshed. */
+static int zebra_sweep_timer(struct thread *t)
+{
+	rib_sweep_route();
+	return 0;
+}
+
 /* Main startup routine. */
 int main(int argc, char **argv)
 {
@@ -213,7 +233,7 @@ int main(int argc, char **argv)
 	frr_preinit(&zebra_di, argc, argv);
 
 	frr_opt_add(
-		"bakz:e:l:r"
+		"bakK:z:e:l:r"
 #ifdef HAVE_NETLINK
 		"s:n"
 #endif
@@ -228,6 +248,7 @@ int main(int argc, char **argv)
 		"  -e, --ecmp         Specify ECMP to use.\n"
 		"  -l, --label_socket Socket to external label manager\n"
 		"  -k, --keep_kernel  Don't delete old routes which installed by zebra.\n"
+		"  -K, --graceful_restart Time to keep old routes installed by zebra around.\n"
 		"  -r, --retain       When program terminates, retain added route by zebra.\n"
 #ifdef HAVE_NETLINK
 		"  -n, --vrfwnetns    Set VRF with NetNS\n"
@@ -256,6 +277,9 @@ int main(int argc, char **argv)
 		case 'k':
 			keep_kernel_mode = 1;
 			break;
+		case 'K':
+			graceful_restart = atoi(optarg);
+			break;
 		case 'e':
 			multipath_num = atoi(optarg);
 			if (multipath_num > MULTIPATH_NUM
@@ -305,7 +329,13 @@ int main(int argc, char **argv)
 	vty_config_lockless();
 	zebrad.master = frr_init();
 
+	/* each zserv client's messages are read and written on its own
+	 * pthread, and processed on the main one */
+	stream_cache_enable();
+
 	/* Zebra related initialize. */
+	frr_pthread_init();
+	zebra_dplane_init();
 	zserv_init();
 	rib_init();
 	zebra_if_init();
@@ -315,6 +345,7 @@ int main(int argc, char **argv)
 	/*
 	 * Initialize NS( and implicitly the VRF module), and make kernel
 	 * routing socket. */
+	zebrad.sweep_pending = !keep_kernel_mode && !graceful_restart;
 	zebra_ns_init();
 
 	zebra_vty_init();
@@ -351,6 +382,9 @@ int main(int argc, char **argv)
 	*/
 	frr_config_fork();
 
+	/* Threads don't survive daemonizing, so only start them now. */
+	zebra_dplane_start();
+
 	/* After we have successfully acquired the pidfile, we can be sure
 	*  about being the only copy of zebra process, which is submitting
 	*  changes to the FIB.
@@ -358,9 +392,16 @@ int main(int argc, char **argv)
 	*  immediately, so originating PID in notifications from kernel
 	*  will be equal to the current getpid(). To know about such routes,
 	* we have to have route_read() called before.
+	*  With a graceful restart time, the clients get that long to add
+	*  their routes again first.
 	*/
-	if (!keep_kernel_mode)
-		rib_sweep_route();
+	if (!keep_kernel_mode) {
+		if (graceful_restart)
+			thread_add_timer(zebrad.master, zebra_sweep_timer, NULL,
+					 graceful_restart, NULL);
+		else
+			rib_sweep_route();
+	}
 
 	/* Needed for BSD routing socket. */
 	pid = getpid();
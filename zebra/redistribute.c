@@ -142,6 +142,20 @@ static void zebra_redistribute(struct zserv *client, int type,
 		}
 }
 
+/*
+ * Queues a redistribution message for client, encoding it into *s for the
+ * first client it goes to, so that the others share that.
+ */
+static void redistribute_send(struct stream **s, int cmd, struct zserv *client,
+			      struct prefix *p, struct prefix *src_p,
+			      struct route_entry *re)
+{
+	if (!*s)
+		*s = zserv_encode_redistribute_route(cmd, p, src_p, re);
+	if (*s)
+		zsend_redistribute(client, *s, p, src_p, re);
+}
+
 /* Either advertise a route for redistribution to registered clients or */
 /* withdraw redistribution if add cannot be done for client */
 void redistribute_update(struct prefix *p, struct prefix *src_p,
@@ -149,6 +163,7 @@ void redistribute_update(struct prefix *p, struct prefix *src_p,
 {
 	struct listnode *node, *nnode;
 	struct zserv *client;
+	struct stream *add = NULL, *del = NULL;
 	int send_redistribute;
 	int afi;
 	char buf[INET6_ADDRSTRLEN];
@@ -187,8 +202,8 @@ void redistribute_update(struct prefix *p, struct prefix *src_p,
 			send_redistribute = 1;
 
 		if (send_redistribute) {
-			zsend_redistribute_route(ZEBRA_REDISTRIBUTE_ROUTE_ADD,
-						 client, p, src_p, re);
+			redistribute_send(&add, ZEBRA_REDISTRIBUTE_ROUTE_ADD,
+					  client, p, src_p, re);
 		} else if (prev_re
 			   && ((re->instance
 				&& redist_check_instance(
@@ -198,10 +213,13 @@ void redistribute_update(struct prefix *p, struct prefix *src_p,
 			       || vrf_bitmap_check(
 					  client->redist[afi][prev_re->type],
 					  re->vrf_id))) {
-			zsend_redistribute_route(ZEBRA_REDISTRIBUTE_ROUTE_DEL,
-						 client, p, src_p, prev_re);
+			redistribute_send(&del, ZEBRA_REDISTRIBUTE_ROUTE_DEL,
+					  client, p, src_p, prev_re);
 		}
 	}
+
+	stream_free(add);
+	stream_free(del);
 }
 
 void redistribute_delete(struct prefix *p, struct prefix *src_p,
@@ -209,6 +227,7 @@ void redistribute_delete(struct prefix *p, struct prefix *src_p,
 {
 	struct listnode *node, *nnode;
 	struct zserv *client;
+	struct stream *del = NULL;
 	char buf[INET6_ADDRSTRLEN];
 	int afi;
 
@@ -240,10 +259,12 @@ void redistribute_delete(struct prefix *p, struct prefix *src_p,
 				   re->instance))
 		    || vrf_bitmap_check(client->redist[afi][re->type],
 					re->vrf_id)) {
-			zsend_redistribute_route(ZEBRA_REDISTRIBUTE_ROUTE_DEL,
-						 client, p, src_p, re);
+			redistribute_send(&del, ZEBRA_REDISTRIBUTE_ROUTE_DEL,
+					  client, p, src_p, re);
 		}
 	}
+
+	stream_free(del);
 }
 
 void zebra_redistribute_add(ZAPI_HANDLER_ARGS)
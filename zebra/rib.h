@@ -30,6 +30,7 @@
 #include "queue.h"
 #include "nexthop.h"
 #include "nexthop_group.h"
+#include "pipeline_stats.h"
 #include "vrf.h"
 #include "if.h"
 #include "mpls.h"
@@ -38,6 +39,9 @@
 #define DISTANCE_INFINITY  255
 #define ZEBRA_KERNEL_TABLE_MAX 252 /* support for no more than this rt tables */
 
+struct nhg_hash_entry;
+struct nhg_gate_links;
+
 struct route_entry {
 	/* Link list. */
 	struct route_entry *next;
@@ -46,18 +50,39 @@ struct route_entry {
 	/* Nexthop structure */
 	struct nexthop_group ng;
 
-	/* Tag */
-	route_tag_t tag;
+	/* Shared nexthop group ng points into, NULL if ng is our own */
+	struct nhg_hash_entry *nhe;
+
+	/*
+	 * Where zebra_nhg_link() listed the route: on its group's list if it
+	 * has one, else with the gateways of its own nexthops.
+	 */
+	union {
+		struct listnode *nhe_node;
+		struct nhg_gate_links *nhe_gates;
+	};
 
 	/* Uptime. */
 	time_t uptime;
 
+	/*
+	 * The fields below are ordered by size so that no padding is needed,
+	 * keep it that way when adding to them.
+	 */
+	uint32_t nhe_version;
+
+	/*
+	 * Hash of the last update sent to the kernel if it went through a
+	 * kernel nexthop object, 0 otherwise.
+	 */
+	uint32_t kernel_hash;
+
+	/* Tag */
+	route_tag_t tag;
+
 	/* Type fo this route. */
 	int type;
 
-	/* Source protocol instance */
-	unsigned short instance;
-
 	/* VRF identifier. */
 	vrf_id_t vrf_id;
 
@@ -71,15 +96,21 @@ struct route_entry {
 	uint32_t mtu;
 	uint32_t nexthop_mtu;
 
-	/* Distance. */
-	uint8_t distance;
-
 	/* Flags of this route.
 	 * This flag's definition is in lib/zebra.h ZEBRA_FLAG_* and is exposed
 	 * to clients via Zserv
 	 */
 	uint32_t flags;
 
+	/* Source protocol instance */
+	unsigned short instance;
+
+	/* Kernel updates queued whose result was not reported yet */
+	uint16_t inflight;
+
+	/* Distance. */
+	uint8_t distance;
+
 	/* RIB internal status */
 	uint8_t status;
 #define ROUTE_ENTRY_REMOVED          0x1
@@ -87,12 +118,21 @@ struct route_entry {
 #define ROUTE_ENTRY_NEXTHOPS_CHANGED 0x2
 #define ROUTE_ENTRY_CHANGED          0x4
 #define ROUTE_ENTRY_LABELS_CHANGED   0x8
+/* Unlinked while queued, freed once all results are in */
+#define ROUTE_ENTRY_UNLINKED         0x20
+/* Installed in the kernel, the nexthops' FIB flags may be shared */
+#define ROUTE_ENTRY_INSTALLED        0x40
+/* Stored in its dest's allocation, see struct rib_dest_re */
+#define ROUTE_ENTRY_EMBEDDED         0x80
 
 	/* Nexthop information. */
 	uint8_t nexthop_num;
 	uint8_t nexthop_active_num;
 };
 
+#define RIB_SYSTEM_ROUTE(R)                                                    \
+	((R)->type == ZEBRA_ROUTE_KERNEL || (R)->type == ZEBRA_ROUTE_CONNECT)
+
 /* meta-queue structure:
  * sub-queue 0: connected, kernel
  * sub-queue 1: static
@@ -102,8 +142,18 @@ struct route_entry {
  */
 #define MQ_SIZE 5
 struct meta_queue {
-	struct list *subq[MQ_SIZE];
+	/* of rib_dest_t, linked through their mq_entries */
+	STAILQ_HEAD(, rib_dest_t_) subq[MQ_SIZE];
 	uint32_t size; /* sum of lengths of all subqueues */
+
+	/* Per sub-queue counters, for "show zebra" */
+	struct {
+		uint32_t len;
+		uint32_t max_len;
+		uint64_t processed;
+		uint64_t usecs; /* spent in rib_process() */
+		uint64_t max_usecs;
+	} stats[MQ_SIZE];
 };
 
 /*
@@ -129,11 +179,40 @@ typedef struct rib_dest_t_ {
 	 */
 	uint32_t flags;
 
+	/*
+	 * For routes timed through the rib_pipeline stages: low 32 bits of
+	 * pipeline_now() when the current stage began, 0 if not timed.  Fills
+	 * what would otherwise be padding.
+	 */
+	uint32_t pipeline_stamp;
+
 	/*
 	 * Linkage to put dest on the FPM processing queue.
 	 */
 	TAILQ_ENTRY(rib_dest_t_) fpm_q_entries;
 
+	/*
+	 * Sequence number of the last update sent to the FPM, and linkage
+	 * to keep the dest on the FPM's log until the FPM has applied it.
+	 */
+	uint32_t fpm_seq;
+
+	/* usecs from the client reading the route until pipeline_stamp */
+	uint32_t pipeline_age;
+
+	TAILQ_ENTRY(rib_dest_t_) fpm_log_entries;
+
+	/*
+	 * Linkage to put dest on the ZeroMQ export queue.
+	 */
+	TAILQ_ENTRY(rib_dest_t_) zmq_q_entries;
+
+	/*
+	 * Linkage to put dest on the meta queue, one per sub-queue as it
+	 * may be on several at a time (see RIB_ROUTE_QUEUED).
+	 */
+	STAILQ_ENTRY(rib_dest_t_) mq_entries[MQ_SIZE];
+
 } rib_dest_t;
 
 #define RIB_ROUTE_QUEUED(x)	(1 << (x))
@@ -157,6 +236,43 @@ typedef struct rib_dest_t_ {
  */
 #define RIB_DEST_UPDATE_FPM    (1 << (ZEBRA_MAX_QINDEX + 2))
 
+/*
+ * This flag is set while redistribution of the selected route waits for
+ * the kernel to confirm the FIB route.
+ */
+#define RIB_DEST_REDIST_PENDING (1 << (ZEBRA_MAX_QINDEX + 3))
+
+/*
+ * This flag is set while the dest is on the FPM's log of updates that
+ * the FPM has not confirmed yet.
+ */
+#define RIB_DEST_LOGGED_FPM    (1 << (ZEBRA_MAX_QINDEX + 4))
+
+/*
+ * The dest was allocated as part of a struct rib_dest_re, and the route
+ * slot in there is in use.
+ */
+#define RIB_DEST_RE_SLOT       (1 << (ZEBRA_MAX_QINDEX + 5))
+#define RIB_DEST_RE_SLOT_USED  (1 << (ZEBRA_MAX_QINDEX + 6))
+
+/*
+ * This flag is set when the ZeroMQ export module is to send an update
+ * about a dest.
+ */
+#define RIB_DEST_UPDATE_ZMQ    (1 << (ZEBRA_MAX_QINDEX + 7))
+
+/*
+ * Most prefixes only ever have a single route, from a single protocol.
+ * Their dest is allocated together with room for that route, saving an
+ * allocation per prefix. Routes linked to a dest whose slot is free are
+ * moved there by rib_link(); a dest outlives its node while the route in
+ * the slot still waits for the kernel.
+ */
+struct rib_dest_re {
+	rib_dest_t dest;
+	struct route_entry re;
+};
+
 /*
  * Macro to iterate over each route for a destination (prefix).
  */
@@ -182,13 +298,28 @@ struct rtadv {
 	int sock;
 
 	int adv_if_count;
-	int adv_msec_if_count;
 
 	struct thread *ra_read;
 	struct thread *ra_timer;
+
+	/*
+	 * Interfaces sending RAs, hashed by the tick they are next due at,
+	 * see rtadv_timer().  wheel_tick is the next tick to run, and
+	 * timer_tick the one ra_timer is set for.
+	 */
+#define RTADV_TICK_MSEC 10
+#define RTADV_WHEEL_SLOTS 1024
+	TAILQ_HEAD(rtadv_wheel_slot, zebra_if) wheel[RTADV_WHEEL_SLOTS];
+	uint64_t wheel_tick;
+	uint64_t timer_tick;
+	unsigned int wheel_count;
 };
 #endif /* HAVE_RTADV */
 
+/* Route counter slots of a table: iBGP is counted apart from eBGP. */
+#define ZEBRA_ROUTE_IBGP  ZEBRA_ROUTE_MAX
+#define ZEBRA_ROUTE_TOTAL (ZEBRA_ROUTE_IBGP + 1)
+
 /*
  * rib_table_info_t
  *
@@ -204,6 +335,25 @@ typedef struct rib_table_info_t_ {
 	afi_t afi;
 	safi_t safi;
 
+	/*
+	 * Bumped whenever a node of the table gains or loses its
+	 * rib_dest_t, which invalidates the lookups cached by
+	 * rib_route_node_match().
+	 */
+	unsigned int gen;
+	struct rib_lookup_cache *lookup_cache;
+
+	/* Pending rib_sweep_table() walk. */
+	struct route_table_walk *t_sweep;
+
+	/*
+	 * Routes linked into the table and routes selected, per type, kept
+	 * up to date by rib_link()/rib_unlink() and wherever
+	 * ZEBRA_FLAG_SELECTED changes.
+	 */
+	uint32_t rib_cnt[ZEBRA_ROUTE_TOTAL + 1];
+	uint32_t fib_cnt[ZEBRA_ROUTE_TOTAL + 1];
+
 } rib_table_info_t;
 
 typedef enum {
@@ -310,6 +460,25 @@ extern int rib_add(afi_t afi, safi_t safi, vrf_id_t vrf_id, int type,
 extern int rib_add_multipath(afi_t afi, safi_t safi, struct prefix *p,
 			     struct prefix_ipv6 *src_p, struct route_entry *re);
 
+/*
+ * Stages sampled routes from clients sending ZEBRA_FLAG_TIMESTAMPS go
+ * through, timed from the client reading the update they came in.
+ */
+enum rib_pipeline_stage {
+	RIB_PIPELINE_ZAPI,
+	RIB_PIPELINE_QUEUE,
+	RIB_PIPELINE_KERNEL,
+	RIB_PIPELINE_TOTAL,
+	RIB_PIPELINE_STAGES,
+};
+extern struct pipeline_stage rib_pipeline[RIB_PIPELINE_STAGES];
+
+/* Starts timing a route just added with rib_add_multipath() */
+extern void rib_pipeline_received(afi_t afi, safi_t safi, vrf_id_t vrf_id,
+				  uint32_t table_id, struct prefix *p,
+				  struct prefix_ipv6 *src_p, int64_t rx_usec,
+				  int64_t tx_usec);
+
 extern void rib_delete(afi_t afi, safi_t safi, vrf_id_t vrf_id, int type,
 		       unsigned short instance, int flags, struct prefix *p,
 		       struct prefix_ipv6 *src_p, const struct nexthop *nh,
@@ -336,12 +505,22 @@ extern unsigned long rib_score_proto_table(uint8_t proto,
 					   unsigned short instance,
 					   struct route_table *table);
 extern void rib_queue_add(struct route_node *rn);
+extern void meta_queue_remove_vrf(struct meta_queue *mq,
+				  struct zebra_vrf *zvrf);
 extern void meta_queue_free(struct meta_queue *mq);
 extern int zebra_rib_labeled_unicast(struct route_entry *re);
 extern struct route_table *rib_table_ipv6;
 
 extern void rib_unlink(struct route_node *rn, struct route_entry *re);
 extern int rib_gc_dest(struct route_node *rn);
+extern void rib_dest_free(rib_dest_t *dest);
+extern void route_entry_free(struct route_entry *re);
+extern struct route_node *rib_route_node_match(struct route_table *table,
+					       const struct prefix *p);
+extern void rib_table_info_free(rib_table_info_t *info);
+
+/* Called once the dataplane reported back everything handed to it. */
+extern void rib_dplane_idle(void);
 extern struct route_table *rib_tables_iter_next(rib_tables_iter_t *iter);
 
 extern uint8_t route_distance(int type);
@@ -64,6 +64,22 @@ extern void kernel_route_rib(struct route_node *rn, struct prefix *p,
 			     struct prefix *src_p, struct route_entry *old,
 			     struct route_entry *new);
 
+/*
+ * Push out route updates kernel_route_rib() may still be holding on to.
+ *
+ * Results for those are reported through kernel_route_rib_pass_fail()
+ * later on, once the kernel answered.
+ */
+extern void kernel_route_rib_flush(void);
+
+/*
+ * Push out route updates and wait until all results have been reported.
+ *
+ * Queued updates keep a lock on their route node, so this must be called
+ * before a table is freed.
+ */
+extern void kernel_route_rib_wait(void);
+
 /*
  * So route install/failure may not be immediately known
  * so let's separate it out and allow the result to
@@ -73,6 +89,18 @@ extern void kernel_route_rib_pass_fail(struct route_node *rn, struct prefix *p,
 				       struct route_entry *re,
 				       enum southbound_results res);
 
+/*
+ * Kernels with nexthop objects get shared nexthop groups as such.
+ *
+ * kernel_nhg_release() is called when a group with a kernel object goes
+ * away, kernel_nhg_if_down() when an interface went down and the kernel
+ * dropped the nexthop objects using it.
+ */
+struct nhg_hash_entry;
+extern void kernel_nhg_release(struct nhg_hash_entry *nhe);
+extern void kernel_nhg_if_down(struct interface *ifp);
+extern void kernel_nhg_show(struct vty *vty);
+
 extern int kernel_address_add_ipv4(struct interface *, struct connected *);
 extern int kernel_address_delete_ipv4(struct interface *, struct connected *);
 extern int kernel_address_add_ipv6(struct interface *, struct connected *);
@@ -101,6 +129,9 @@ extern int mpls_kernel_init(void);
 
 extern uint32_t kernel_get_speed(struct interface *ifp);
 extern int kernel_get_ipmr_sg_stats(struct zebra_vrf *zvrf, void *mroute);
+extern int kernel_get_ipmr_sg_stats_bulk(struct zebra_vrf *zvrf,
+					 void (*func)(void *mroute, void *arg),
+					 void *arg);
 extern int kernel_add_vtep(vni_t vni, struct interface *ifp,
 			   struct in_addr *vtep_ip);
 extern int kernel_del_vtep(vni_t vni, struct interface *ifp,
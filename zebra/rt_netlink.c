@@ -26,6 +26,7 @@
 #include <linux/lwtunnel.h>
 #include <linux/mpls_iptunnel.h>
 #include <linux/neighbour.h>
+#include <linux/nexthop.h>
 #include <linux/rtnetlink.h>
 
 /* Hack for GNU libc version 2. */
@@ -34,6 +35,9 @@
 #endif /* MSG_TRUNC */
 
 #include "linklist.h"
+#include "hash.h"
+#include "jhash.h"
+#include "queue.h"
 #include "if.h"
 #include "log.h"
 #include "prefix.h"
@@ -64,6 +68,9 @@
 #include "zebra/rt_netlink.h"
 #include "zebra/zebra_mroute.h"
 #include "zebra/zebra_vxlan.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/zebra_pbr.h"
 
 #ifndef AF_MPLS
 #define AF_MPLS 28
@@ -160,8 +167,8 @@ static inline int proto2zebra(int proto, int family)
 		proto = ZEBRA_ROUTE_BGP;
 		break;
 	case RTPROT_OSPF:
-		proto = (family == AFI_IP) ? ZEBRA_ROUTE_OSPF
-					   : ZEBRA_ROUTE_OSPF6;
+		proto = (family == AF_INET) ? ZEBRA_ROUTE_OSPF
+					    : ZEBRA_ROUTE_OSPF6;
 		break;
 	case RTPROT_ISIS:
 		proto = ZEBRA_ROUTE_ISIS;
@@ -184,6 +191,9 @@ static inline int proto2zebra(int proto, int family)
 	case RTPROT_STATIC:
 		proto = ZEBRA_ROUTE_STATIC;
 		break;
+	case RTPROT_SHARP:
+		proto = ZEBRA_ROUTE_SHARP;
+		break;
 	default:
 		proto = ZEBRA_ROUTE_KERNEL;
 		break;
@@ -276,6 +286,11 @@ static int netlink_route_change_read_unicast(struct sockaddr_nl *snl,
 
 	if (rtm->rtm_flags & RTM_F_CLONED)
 		return 0;
+	/* Only our own routes through nexthop objects can be made sense of */
+	if (tb[RTA_NH_ID]
+	    && (h->nlmsg_type == RTM_NEWROUTE
+		|| !is_selfroute(rtm->rtm_protocol)))
+		return 0;
 	if (rtm->rtm_protocol == RTPROT_REDIRECT)
 		return 0;
 	if (rtm->rtm_protocol == RTPROT_KERNEL)
@@ -600,6 +615,11 @@ static int netlink_route_change_read_unicast(struct sockaddr_nl *snl,
 
 static struct mcast_route_data *mroute = NULL;
 
+/* Or, dumping the multicast routes, what to run on those of a VRF */
+static void (*mroute_walk)(void *mroute, void *arg);
+static void *mroute_walk_arg;
+static vrf_id_t mroute_walk_vrf;
+
 static int netlink_route_change_read_multicast(struct sockaddr_nl *snl,
 					       struct nlmsghdr *h,
 					       ns_id_t ns_id, int startup)
@@ -652,6 +672,20 @@ static int netlink_route_change_read_multicast(struct sockaddr_nl *snl,
 	if ((RTA_EXPIRES <= RTA_MAX) && tb[RTA_EXPIRES])
 		m->lastused = *(unsigned long long *)RTA_DATA(tb[RTA_EXPIRES]);
 
+	if ((RTA_MFC_STATS <= RTA_MAX) && tb[RTA_MFC_STATS]) {
+		struct rta_mfc_stats *mfcs = RTA_DATA(tb[RTA_MFC_STATS]);
+
+		m->pktcnt = mfcs->mfcs_packets;
+		m->bytecnt = mfcs->mfcs_bytes;
+		m->wrong_if = mfcs->mfcs_wrong_if;
+	}
+
+	if (mroute_walk) {
+		if (vrf == mroute_walk_vrf)
+			(*mroute_walk)(m, mroute_walk_arg);
+		return 0;
+	}
+
 	if (tb[RTA_MULTIPATH]) {
 		struct rtnexthop *rtnh =
 			(struct rtnexthop *)RTA_DATA(tb[RTA_MULTIPATH]);
@@ -745,12 +779,18 @@ static int netlink_request_route(struct zebra_ns *zns, int family, int type)
 	return netlink_request(&zns->netlink_cmd, &req.n);
 }
 
+static void netlink_nhg_init(struct zebra_ns *zns);
+
 /* Routing table read function using netlink interface.  Only called
    bootstrap time. */
 int netlink_route_read(struct zebra_ns *zns)
 {
 	int ret;
 
+	/* Before the routes, leftover nexthop objects take theirs along */
+	if (zns->ns_id == NS_DEFAULT)
+		netlink_nhg_init(zns);
+
 	/* Get IPv4 routing table. */
 	ret = netlink_request_route(zns, AF_INET, RTM_GETROUTE);
 	if (ret < 0)
@@ -1309,20 +1349,874 @@ static int netlink_neigh_update(int cmd, int ifindex, uint32_t addr, char *lla,
 			    0);
 }
 
+/*
+ * Route, LSP and PBR rule updates, as well as the MAC and neighbor entries
+ * installed for EVPN, are not handed to the kernel one at a time but collected in a
+ * batch, which is passed to the dataplane pthread once it fills up or
+ * once the thread that queued them is done.  There the batch is sent with
+ * a single sendmsg() and the kernel's answers are matched back to its
+ * entries by sequence number; the results are then reported on the main
+ * thread.
+ */
+#define NL_ROUTE_BATCH_SIZE (256 * 1024)
+#define NL_ROUTE_BATCH_MAX 1024
+
+DEFINE_MTYPE_STATIC(ZEBRA, NL_ROUTE_BATCH, "Netlink route batch")
+
+/*
+ * Kernel nexthop objects.
+ *
+ * Kernels that have them let a route point at a nexthop group by id
+ * instead of carrying its nexthops.  Shared nexthop groups (zebra_nhg.h)
+ * whose nexthops allow it are installed as a kernel group, made of one
+ * nexthop object per distinct gateway and interface.  When one of those
+ * fails, a single message replaces the group, while the routes using it
+ * are left alone: their own updates are identical to what the kernel has
+ * already, and are not sent at all.
+ *
+ * Everything else, and everything on kernels without nexthop objects,
+ * is installed with its nexthops in the route as before.
+ */
+DEFINE_MTYPE_STATIC(ZEBRA, NL_NH, "Kernel nexthop object")
+DEFINE_MTYPE_STATIC(ZEBRA, NL_NHG, "Kernel nexthop group")
+
+struct nl_nh {
+	/* lookup key */
+	uint8_t family;
+	bool gateway;
+	bool onlink;
+	ifindex_t ifindex;
+	union g_addr gate;
+
+	uint32_t id;
+	/* number of groups using the object */
+	uint32_t refcnt;
+	/* the kernel flushed the object, it must be sent again */
+	bool stale;
+};
+
+struct nhg_kernel {
+	uint32_t id;
+
+	/* the nhe, if still around, and queued updates for the group */
+	uint32_t refcnt;
+	struct nhg_hash_entry *nhe;
+
+	/* false if the kernel may not have the members below */
+	bool valid;
+	/* bumped when the kernel may have lost the group, and its routes */
+	uint32_t generation;
+
+	unsigned int num;
+	struct nl_nh **members;
+
+	TAILQ_ENTRY(nhg_kernel) entries;
+};
+
+TAILQ_HEAD(nhg_kernel_list, nhg_kernel);
+
+static bool nl_nhg_enabled;
+static uint32_t nl_nhg_last_id;
+static struct hash *nl_nh_hash;
+
+/* groups in use, and released ones waiting for their routes to go */
+static struct nhg_kernel_list nl_nhg_list =
+	TAILQ_HEAD_INITIALIZER(nl_nhg_list);
+static struct nhg_kernel_list nl_nhg_released =
+	TAILQ_HEAD_INITIALIZER(nl_nhg_released);
+static unsigned int nl_nhg_count;
+
+static uint64_t nl_nhg_replaced;
+static uint64_t nl_nhg_routes_skipped;
+
+static void netlink_nhg_unref(struct nhg_kernel *knhg)
+{
+	if (--knhg->refcnt)
+		return;
+
+	XFREE(MTYPE_NL_NHG, knhg->members);
+	XFREE(MTYPE_NL_NHG, knhg);
+}
+
+struct nl_route_batch_entry {
+	/* NULL if nobody is interested in the result */
+	struct route_node *rn;
+	struct route_entry *re;
+	/* set for updates of a kernel nexthop group */
+	struct nhg_kernel *knhg;
+	/* set for LSP updates, reported through kernel_lsp_pass_fail() */
+	zebra_lsp_t *lsp;
+	/* copy of the rule for PBR rule updates, freed once reported */
+	struct zebra_pbr_rule *rule;
+	int cmd;
+	/* filled in by the dataplane pthread */
+	int ret;
+};
+
+struct nl_route_batch {
+	struct zebra_ns *zns;
+
+	unsigned int count;
+	struct nl_route_batch_entry entries[NL_ROUTE_BATCH_MAX];
+
+	size_t len;
+	char buf[NL_ROUTE_BATCH_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+};
+
+/* the batch being filled, and one kept around for reuse */
+static struct nl_route_batch *nl_route_batch;
+static struct nl_route_batch *nl_route_batch_spare;
+static struct thread *t_nl_route_batch;
+
+/* Runs on the dataplane pthread, must not look at the RIB. */
+static void netlink_route_batch_ack(unsigned int index, int ret, void *arg)
+{
+	struct nl_route_batch *batch = arg;
+
+	if (index < batch->count)
+		batch->entries[index].ret = ret;
+}
+
+static void netlink_route_batch_send(void *arg)
+{
+	struct nl_route_batch *batch = arg;
+
+	netlink_talk_batch(netlink_route_batch_ack, batch,
+			   (struct nlmsghdr *)batch->buf, batch->len,
+			   &batch->zns->netlink_dplane, batch->zns);
+}
+
+/* Back on the main thread. */
+static void netlink_route_batch_done(void *arg)
+{
+	struct nl_route_batch *batch = arg;
+	struct nl_route_batch_entry *entry;
+	struct prefix *p, *src_p;
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++) {
+		entry = &batch->entries[i];
+		if (entry->knhg) {
+			if (entry->ret && entry->knhg->nhe) {
+				entry->knhg->valid = false;
+				entry->knhg->generation++;
+			}
+			netlink_nhg_unref(entry->knhg);
+		}
+
+		if (entry->lsp) {
+			UNSET_FLAG(entry->lsp->flags, LSP_FLAG_QUEUED);
+			if (entry->cmd == RTM_NEWROUTE)
+				kernel_lsp_pass_fail(
+					entry->lsp,
+					(!entry->ret)
+						? SOUTHBOUND_INSTALL_SUCCESS
+						: SOUTHBOUND_INSTALL_FAILURE);
+			else
+				kernel_lsp_pass_fail(
+					entry->lsp,
+					(!entry->ret)
+						? SOUTHBOUND_DELETE_SUCCESS
+						: SOUTHBOUND_DELETE_FAILURE);
+			continue;
+		}
+
+		if (entry->rule) {
+			if (entry->cmd == RTM_NEWRULE)
+				kernel_pbr_rule_add_del_status(
+					entry->rule,
+					(!entry->ret)
+						? SOUTHBOUND_INSTALL_SUCCESS
+						: SOUTHBOUND_INSTALL_FAILURE);
+			else
+				kernel_pbr_rule_add_del_status(
+					entry->rule,
+					(!entry->ret)
+						? SOUTHBOUND_DELETE_SUCCESS
+						: SOUTHBOUND_DELETE_FAILURE);
+			XFREE(MTYPE_TMP, entry->rule);
+			continue;
+		}
+
+		if (!entry->rn)
+			continue;
+
+		entry->re->inflight--;
+		if (entry->ret)
+			entry->re->kernel_hash = 0;
+		srcdest_rnode_prefixes(entry->rn, &p, &src_p);
+
+		if (entry->cmd == RTM_NEWROUTE)
+			kernel_route_rib_pass_fail(
+				entry->rn, p, entry->re,
+				(!entry->ret) ? SOUTHBOUND_INSTALL_SUCCESS
+					      : SOUTHBOUND_INSTALL_FAILURE);
+		else
+			kernel_route_rib_pass_fail(
+				entry->rn, p, entry->re,
+				(!entry->ret) ? SOUTHBOUND_DELETE_SUCCESS
+					      : SOUTHBOUND_DELETE_FAILURE);
+
+		route_unlock_node(entry->rn);
+	}
+
+	if (nl_route_batch_spare)
+		XFREE(MTYPE_NL_ROUTE_BATCH, batch);
+	else
+		nl_route_batch_spare = batch;
+}
+
+static void netlink_route_batch_flush(void)
+{
+	struct nl_route_batch *batch = nl_route_batch;
+
+	THREAD_OFF(t_nl_route_batch);
+
+	if (!batch)
+		return;
+
+	nl_route_batch = NULL;
+	zebra_dplane_enqueue(netlink_route_batch_send,
+			     netlink_route_batch_done, batch);
+}
+
+static void netlink_nhg_release_flush(void);
+
+void kernel_route_rib_flush(void)
+{
+	netlink_nhg_release_flush();
+	netlink_route_batch_flush();
+}
+
+void kernel_route_rib_wait(void)
+{
+	kernel_route_rib_flush();
+	zebra_dplane_wait();
+}
+
+static int netlink_route_batch_timer(struct thread *thread)
+{
+	t_nl_route_batch = NULL;
+	kernel_route_rib_flush();
+
+	return 0;
+}
+
+/* Queue a message for the kernel, the entry to track it is returned. */
+static struct nl_route_batch_entry *
+netlink_route_batch_queue(struct zebra_ns *zns, struct nlmsghdr *n)
+{
+	struct nl_route_batch *batch = nl_route_batch;
+	struct nl_route_batch_entry *entry;
+	size_t len = NLMSG_ALIGN(n->nlmsg_len);
+
+	if (batch
+	    && (batch->zns != zns || batch->count == NL_ROUTE_BATCH_MAX
+		|| batch->len + len > sizeof(batch->buf))) {
+		netlink_route_batch_flush();
+		batch = NULL;
+	}
+
+	if (!batch) {
+		if (nl_route_batch_spare) {
+			batch = nl_route_batch_spare;
+			nl_route_batch_spare = NULL;
+		} else
+			batch = XMALLOC(MTYPE_NL_ROUTE_BATCH,
+					sizeof(struct nl_route_batch));
+		batch->zns = zns;
+		batch->count = 0;
+		batch->len = 0;
+		nl_route_batch = batch;
+	}
+
+	memcpy(batch->buf + batch->len, n, n->nlmsg_len);
+	memset(batch->buf + batch->len + n->nlmsg_len, 0,
+	       len - n->nlmsg_len);
+	batch->len += len;
+
+	/* Whatever the kernel does not answer counts as failed */
+	entry = &batch->entries[batch->count++];
+	entry->cmd = n->nlmsg_type;
+	entry->ret = -1;
+	entry->rn = NULL;
+	entry->re = NULL;
+	entry->knhg = NULL;
+	entry->lsp = NULL;
+	entry->rule = NULL;
+
+	thread_add_event(zebrad.master, netlink_route_batch_timer, NULL, 0,
+			 &t_nl_route_batch);
+
+	return entry;
+}
+
+/*
+ * Queue a route update for the kernel.
+ *
+ * If rn is given, its result is reported through
+ * kernel_route_rib_pass_fail() once the kernel answered.  An update of a
+ * kernel nexthop group passes the group in knhg, which is held until then.
+ */
+static void netlink_route_batch_add(struct zebra_ns *zns, struct nlmsghdr *n,
+				    struct route_node *rn,
+				    struct route_entry *re,
+				    struct nhg_kernel *knhg)
+{
+	struct nl_route_batch_entry *entry;
+
+	entry = netlink_route_batch_queue(zns, n);
+	entry->knhg = knhg;
+	if (knhg)
+		knhg->refcnt++;
+	if (rn) {
+		entry->rn = rn;
+		entry->re = re;
+		route_lock_node(rn);
+		re->inflight++;
+	}
+}
+
+/*
+ * Queue a PBR rule update for the kernel.  The batch keeps a copy of rule,
+ * its result is reported through kernel_pbr_rule_add_del_status() once the
+ * kernel answered.
+ */
+void netlink_rule_batch_add(struct zebra_ns *zns, struct nlmsghdr *n,
+			    struct zebra_pbr_rule *rule)
+{
+	struct nl_route_batch_entry *entry;
+
+	entry = netlink_route_batch_queue(zns, n);
+	entry->rule = XMALLOC(MTYPE_TMP, sizeof(*rule));
+	memcpy(entry->rule, rule, sizeof(*rule));
+}
+
+static unsigned int netlink_nh_hash_key(void *arg)
+{
+	struct nl_nh *nh = arg;
+
+	return jhash(&nh->gate, sizeof(nh->gate),
+		     jhash_3words(nh->family, nh->onlink, nh->ifindex, 0));
+}
+
+static int netlink_nh_hash_cmp(const void *arg1, const void *arg2)
+{
+	const struct nl_nh *nh1 = arg1;
+	const struct nl_nh *nh2 = arg2;
+
+	return nh1->family == nh2->family && nh1->gateway == nh2->gateway
+	       && nh1->onlink == nh2->onlink && nh1->ifindex == nh2->ifindex
+	       && !memcmp(&nh1->gate, &nh2->gate, sizeof(nh1->gate));
+}
+
+static uint32_t netlink_nhg_id_alloc(void)
+{
+	if (!++nl_nhg_last_id)
+		nl_nhg_last_id = 1;
+	return nl_nhg_last_id;
+}
+
+static void *netlink_nh_alloc(void *arg)
+{
+	struct nl_nh *nh;
+
+	nh = XCALLOC(MTYPE_NL_NH, sizeof(struct nl_nh));
+	*nh = *(struct nl_nh *)arg;
+	nh->id = netlink_nhg_id_alloc();
+
+	return nh;
+}
+
+static void netlink_nh_msg_init(struct nlmsghdr *n, int cmd, uint8_t family,
+				uint32_t id, struct zebra_ns *zns)
+{
+	struct nhmsg *nhm = NLMSG_DATA(n);
+
+	n->nlmsg_len = NLMSG_LENGTH(sizeof(struct nhmsg));
+	n->nlmsg_flags = NLM_F_REQUEST;
+	n->nlmsg_type = cmd;
+	n->nlmsg_pid = zns->netlink_cmd.snl.nl_pid;
+
+	nhm->nh_family = family;
+
+	/* deletes must leave the header empty */
+	if (cmd == RTM_NEWNEXTHOP) {
+		n->nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+		nhm->nh_protocol = RTPROT_ZEBRA;
+	}
+
+	addattr32(n, NL_PKT_BUF_SIZE, NHA_ID, id);
+}
+
+static void netlink_nh_send(struct zebra_ns *zns, struct nl_nh *nh)
+{
+	struct {
+		struct nlmsghdr n;
+		struct nhmsg nhm;
+		char buf[256];
+	} req;
+
+	memset(&req, 0, sizeof(req));
+	netlink_nh_msg_init(&req.n, RTM_NEWNEXTHOP, nh->family, nh->id, zns);
+	if (nh->onlink)
+		req.nhm.nh_flags |= RTNH_F_ONLINK;
+
+	addattr32(&req.n, sizeof(req), NHA_OIF, nh->ifindex);
+	if (nh->gateway)
+		addattr_l(&req.n, sizeof(req), NHA_GATEWAY, &nh->gate,
+			  nh->family == AF_INET ? 4 : 16);
+
+	nh->stale = false;
+	netlink_route_batch_add(zns, &req.n, NULL, NULL, NULL);
+}
+
+static void netlink_nh_del(struct zebra_ns *zns, uint32_t id)
+{
+	struct {
+		struct nlmsghdr n;
+		struct nhmsg nhm;
+		char buf[64];
+	} req;
+
+	memset(&req, 0, sizeof(req));
+	netlink_nh_msg_init(&req.n, RTM_DELNEXTHOP, AF_UNSPEC, id, zns);
+	netlink_route_batch_add(zns, &req.n, NULL, NULL, NULL);
+}
+
+static void netlink_nh_unref(struct zebra_ns *zns, struct nl_nh *nh)
+{
+	if (--nh->refcnt)
+		return;
+
+	hash_release(nl_nh_hash, nh);
+	netlink_nh_del(zns, nh->id);
+	XFREE(MTYPE_NL_NH, nh);
+}
+
+static void netlink_nhg_send(struct zebra_ns *zns, struct nhg_kernel *knhg)
+{
+	struct {
+		struct nlmsghdr n;
+		struct nhmsg nhm;
+		char buf[NL_PKT_BUF_SIZE];
+	} req;
+	struct nexthop_grp grp[MULTIPATH_NUM];
+	unsigned int i;
+
+	memset(&req, 0, sizeof(req.n) + sizeof(req.nhm));
+	netlink_nh_msg_init(&req.n, RTM_NEWNEXTHOP, AF_UNSPEC, knhg->id, zns);
+
+	memset(grp, 0, sizeof(grp));
+	for (i = 0; i < knhg->num; i++)
+		grp[i].id = knhg->members[i]->id;
+	addattr_l(&req.n, sizeof(req), NHA_GROUP, grp,
+		  knhg->num * sizeof(grp[0]));
+
+	netlink_route_batch_add(zns, &req.n, NULL, NULL, knhg);
+}
+
+/*
+ * Fills in the nexthop objects the route's group is made of, returns how
+ * many or 0 if the group can't be installed as a kernel nexthop group.
+ */
+static unsigned int netlink_nhg_members(struct route_entry *re, int family,
+					struct nl_nh *keys)
+{
+	struct nexthop *nexthop, *nh;
+	struct nl_nh *key;
+	unsigned int num = 0, i;
+
+	for (ALL_NEXTHOPS(re->ng, nexthop)) {
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+			continue;
+		if (!NEXTHOP_IS_ACTIVE(nexthop->flags))
+			continue;
+		if (num >= multipath_num)
+			break;
+
+		/* labels are pushed by the route */
+		for (nh = nexthop; nh; nh = nh->rparent)
+			if (nh->nh_label && nh->nh_label->num_labels)
+				return 0;
+
+		key = &keys[num];
+		memset(key, 0, sizeof(*key));
+		switch (nexthop->type) {
+		case NEXTHOP_TYPE_IFINDEX:
+			key->family = family;
+			break;
+		case NEXTHOP_TYPE_IPV4:
+		case NEXTHOP_TYPE_IPV4_IFINDEX:
+			if (family != AF_INET)
+				return 0;
+			key->family = AF_INET;
+			key->gateway = true;
+			key->gate.ipv4 = nexthop->gate.ipv4;
+			break;
+		case NEXTHOP_TYPE_IPV6:
+		case NEXTHOP_TYPE_IPV6_IFINDEX:
+			/* RFC 5549 routes go through ipv4_ll instead */
+			if (family != AF_INET6)
+				return 0;
+			key->family = AF_INET6;
+			key->gateway = true;
+			key->gate.ipv6 = nexthop->gate.ipv6;
+			break;
+		default:
+			return 0;
+		}
+
+		if (!nexthop->ifindex)
+			return 0;
+		key->ifindex = nexthop->ifindex;
+		key->onlink = CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ONLINK);
+
+		/* the kernel won't take the same member twice */
+		for (i = 0; i < num; i++)
+			if (netlink_nh_hash_cmp(&keys[i], key))
+				break;
+		if (i == num)
+			num++;
+	}
+
+	return num;
+}
+
+/*
+ * Makes sure the kernel has the route's nexthop group with its current
+ * members, returns NULL if the route must carry its nexthops itself.
+ */
+static struct nhg_kernel *netlink_nhg_install(struct zebra_ns *zns,
+					      struct route_entry *re,
+					      int family)
+{
+	struct nhg_hash_entry *nhe = re->nhe;
+	struct nhg_kernel *knhg;
+	struct nl_nh keys[MULTIPATH_NUM];
+	struct nl_nh *members[MULTIPATH_NUM];
+	struct nl_nh **old;
+	unsigned int num, old_num, i;
+
+	/* nexthop objects are only probed for in the default namespace */
+	if (!nl_nhg_enabled || !nhe || zns->ns_id != NS_DEFAULT)
+		return NULL;
+
+#if defined(SUPPORT_REALMS)
+	/* realms are set per nexthop */
+	if (re->tag > 0 && re->tag <= 255)
+		return NULL;
+#endif
+
+	num = netlink_nhg_members(re, family, keys);
+	if (!num)
+		return NULL;
+
+	knhg = nhe->kernel;
+	if (!knhg) {
+		knhg = XCALLOC(MTYPE_NL_NHG, sizeof(struct nhg_kernel));
+		knhg->id = netlink_nhg_id_alloc();
+		knhg->refcnt = 1;
+		knhg->nhe = nhe;
+		TAILQ_INSERT_TAIL(&nl_nhg_list, knhg, entries);
+		nl_nhg_count++;
+		nhe->kernel = knhg;
+	}
+
+	for (i = 0; i < num; i++)
+		members[i] = hash_get(nl_nh_hash, &keys[i], netlink_nh_alloc);
+
+	if (knhg->valid && knhg->num == num
+	    && !memcmp(knhg->members, members, num * sizeof(members[0])))
+		return knhg;
+
+	/*
+	 * New members first, then the group, and only then whatever the
+	 * group does not use anymore.
+	 */
+	for (i = 0; i < num; i++)
+		if (!members[i]->refcnt++ || members[i]->stale || !knhg->valid)
+			netlink_nh_send(zns, members[i]);
+
+	old = knhg->members;
+	old_num = knhg->num;
+	knhg->members = XMALLOC(MTYPE_NL_NHG, num * sizeof(members[0]));
+	memcpy(knhg->members, members, num * sizeof(members[0]));
+	knhg->num = num;
+	knhg->valid = true;
+	netlink_nhg_send(zns, knhg);
+
+	if (old_num)
+		nl_nhg_replaced++;
+	for (i = 0; i < old_num; i++)
+		netlink_nh_unref(zns, old[i]);
+	XFREE(MTYPE_NL_NHG, old);
+
+	return knhg;
+}
+
+/* Deletes released groups, behind the updates of the routes using them. */
+static void netlink_nhg_release_flush(void)
+{
+	struct zebra_ns *zns = zebra_ns_lookup(NS_DEFAULT);
+	struct nhg_kernel *knhg;
+	unsigned int i;
+
+	while ((knhg = TAILQ_FIRST(&nl_nhg_released))) {
+		TAILQ_REMOVE(&nl_nhg_released, knhg, entries);
+
+		netlink_nh_del(zns, knhg->id);
+		for (i = 0; i < knhg->num; i++)
+			netlink_nh_unref(zns, knhg->members[i]);
+		knhg->num = 0;
+
+		netlink_nhg_unref(knhg);
+	}
+}
+
+void kernel_nhg_release(struct nhg_hash_entry *nhe)
+{
+	struct nhg_kernel *knhg = nhe->kernel;
+
+	nhe->kernel = NULL;
+	knhg->nhe = NULL;
+	TAILQ_REMOVE(&nl_nhg_list, knhg, entries);
+	TAILQ_INSERT_TAIL(&nl_nhg_released, knhg, entries);
+	nl_nhg_count--;
+
+	thread_add_event(zebrad.master, netlink_route_batch_timer, NULL, 0,
+			 &t_nl_route_batch);
+}
+
+void kernel_nhg_if_down(struct interface *ifp)
+{
+	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
+	struct nhg_kernel *knhg;
+	struct nl_nh *nh;
+	unsigned int i, down;
+
+	if (!nl_nhg_enabled || !zvrf || zvrf->zns->ns_id != NS_DEFAULT)
+		return;
+
+	TAILQ_FOREACH (knhg, &nl_nhg_list, entries) {
+		down = 0;
+		for (i = 0; i < knhg->num; i++) {
+			nh = knhg->members[i];
+			if (nh->ifindex != ifp->ifindex)
+				continue;
+			nh->stale = true;
+			down++;
+		}
+		if (!down)
+			continue;
+
+		/*
+		 * The kernel dropped the members from the group, and the
+		 * group along with its routes if none was left.
+		 */
+		knhg->valid = false;
+		if (down == knhg->num)
+			knhg->generation++;
+	}
+}
+
+void kernel_nhg_show(struct vty *vty)
+{
+	if (!nl_nhg_enabled) {
+		vty_out(vty, "\nKernel nexthop groups not in use\n");
+		return;
+	}
+
+	vty_out(vty,
+		"\nKernel nexthop groups %u, members %lu, replaced %" PRIu64
+		", route updates skipped %" PRIu64 "\n",
+		nl_nhg_count, nl_nh_hash->count, nl_nhg_replaced,
+		nl_nhg_routes_skipped);
+}
+
+/* The preferred source for a route that doesn't carry its nexthops. */
+static bool netlink_nexthop_src(struct nexthop *nexthop, int family,
+				union g_addr *src)
+{
+	if (family == AF_INET) {
+		if (nexthop->rmap_src.ipv4.s_addr)
+			src->ipv4 = nexthop->rmap_src.ipv4;
+		else if (nexthop->src.ipv4.s_addr)
+			src->ipv4 = nexthop->src.ipv4;
+		else
+			return false;
+	} else {
+		if (!IN6_IS_ADDR_UNSPECIFIED(&nexthop->rmap_src.ipv6))
+			src->ipv6 = nexthop->rmap_src.ipv6;
+		else if (!IN6_IS_ADDR_UNSPECIFIED(&nexthop->src.ipv6))
+			src->ipv6 = nexthop->src.ipv6;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+/* Like the nexthop based updates, prefer the source of recursive ones. */
+static bool netlink_route_src(struct route_entry *re, int family,
+			      union g_addr *src)
+{
+	struct nexthop *nexthop;
+	union g_addr first;
+	bool found = false;
+
+	for (ALL_NEXTHOPS(re->ng, nexthop)) {
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE)) {
+			if (netlink_nexthop_src(nexthop, family, src))
+				return true;
+			continue;
+		}
+		if (!found && NEXTHOP_IS_ACTIVE(nexthop->flags))
+			found = netlink_nexthop_src(nexthop, family, &first);
+	}
+
+	if (found)
+		*src = first;
+	return found;
+}
+
+/* Nexthop objects left behind by an earlier run, read at startup */
+static uint32_t *nl_nh_stale;
+static unsigned int nl_nh_stale_num;
+
+static int netlink_nexthop_read_filter(struct sockaddr_nl *snl,
+				       struct nlmsghdr *h, ns_id_t ns_id,
+				       int startup)
+{
+	struct nhmsg *nhm = NLMSG_DATA(h);
+	struct rtattr *tb[NHA_MAX + 1];
+	uint32_t id;
+	int len;
+
+	if (h->nlmsg_type != RTM_NEWNEXTHOP)
+		return 0;
+
+	len = h->nlmsg_len - NLMSG_LENGTH(sizeof(struct nhmsg));
+	if (len < 0)
+		return -1;
+
+	memset(tb, 0, sizeof(tb));
+	netlink_parse_rtattr(tb, NHA_MAX,
+			     (struct rtattr *)((char *)nhm
+					       + NLMSG_ALIGN(sizeof(*nhm))),
+			     len);
+	if (!tb[NHA_ID])
+		return 0;
+
+	id = *(uint32_t *)RTA_DATA(tb[NHA_ID]);
+	if (id > nl_nhg_last_id)
+		nl_nhg_last_id = id;
+
+	if (nhm->nh_protocol == RTPROT_ZEBRA) {
+		nl_nh_stale = XREALLOC(MTYPE_TMP, nl_nh_stale,
+				       (nl_nh_stale_num + 1) * sizeof(id));
+		nl_nh_stale[nl_nh_stale_num++] = id;
+	}
+
+	return 0;
+}
+
+static void netlink_nh_del_sync(struct zebra_ns *zns, uint32_t id)
+{
+	struct {
+		struct nlmsghdr n;
+		struct nhmsg nhm;
+		char buf[64];
+	} req;
+
+	memset(&req, 0, sizeof(req));
+	netlink_nh_msg_init(&req.n, RTM_DELNEXTHOP, AF_UNSPEC, id, zns);
+	netlink_talk(netlink_talk_filter, &req.n, &zns->netlink_cmd, zns, 0);
+}
+
+/* Whether the kernel has nexthop objects, and can replace them. */
+static bool netlink_nhg_probe(struct zebra_ns *zns)
+{
+	struct {
+		struct nlmsghdr n;
+		struct nhmsg nhm;
+		char buf[64];
+	} req;
+	uint32_t id;
+	unsigned int i;
+	int ret;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_type = RTM_GETNEXTHOP;
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct nhmsg));
+	req.nhm.nh_family = AF_UNSPEC;
+
+	if (netlink_request(&zns->netlink_cmd, &req.n) < 0)
+		return false;
+	if (netlink_parse_info(netlink_nexthop_read_filter,
+			       &zns->netlink_cmd, zns, 0, 1)
+	    < 0)
+		return false;
+
+	/* The kernel drops the routes using them along with them */
+	for (i = 0; i < nl_nh_stale_num; i++)
+		netlink_nh_del_sync(zns, nl_nh_stale[i]);
+	XFREE(MTYPE_TMP, nl_nh_stale);
+	nl_nh_stale_num = 0;
+
+	id = netlink_nhg_id_alloc();
+	for (i = 0; i < 2; i++) {
+		memset(&req, 0, sizeof(req));
+		netlink_nh_msg_init(&req.n, RTM_NEWNEXTHOP, AF_INET, id, zns);
+		if (!i)
+			req.n.nlmsg_flags &= ~NLM_F_REPLACE;
+		addattr_l(&req.n, sizeof(req), NHA_BLACKHOLE, NULL, 0);
+
+		ret = netlink_talk(netlink_talk_filter, &req.n,
+				   &zns->netlink_cmd, zns, 0);
+		if (ret < 0)
+			break;
+	}
+
+	if (i)
+		netlink_nh_del_sync(zns, id);
+
+	return ret == 0;
+}
+
+static void netlink_nhg_init(struct zebra_ns *zns)
+{
+	nl_nhg_enabled = netlink_nhg_probe(zns);
+	if (nl_nhg_enabled && !nl_nh_hash)
+		nl_nh_hash = hash_create(netlink_nh_hash_key,
+					 netlink_nh_hash_cmp,
+					 "Kernel nexthop objects");
+
+	if (IS_ZEBRA_DEBUG_KERNEL)
+		zlog_debug("Kernel nexthop objects %s",
+			   nl_nhg_enabled ? "in use" : "unavailable");
+}
+
 /* Routing table change via netlink interface. */
 /* Update flag indicates whether this is a "replace" or not. */
-static int netlink_route_multipath(int cmd, struct prefix *p,
-				   struct prefix *src_p, struct route_entry *re,
-				   int update)
+/* Returns 1 if the update was queued for the kernel, in which case the
+ * result for rn is reported later on, and 0 if there was nothing to send.
+ * kernel_hash is the kernel_hash of the route being replaced, if any.
+ */
+static int netlink_route_multipath(int cmd, struct route_node *rn,
+				   struct prefix *p, struct prefix *src_p,
+				   struct route_entry *re, int update,
+				   uint32_t kernel_hash)
 {
 	int bytelen;
-	struct sockaddr_nl snl;
 	struct nexthop *nexthop = NULL;
 	unsigned int nexthop_num;
 	int family = PREFIX_FAMILY(p);
 	const char *routedesc;
 	int setsrc = 0;
 	union g_addr src;
+	struct nhg_kernel *knhg;
+	uint32_t hash;
 
 	struct {
 		struct nlmsghdr n;
@@ -1333,6 +2227,8 @@ static int netlink_route_multipath(int cmd, struct prefix *p,
 	struct zebra_ns *zns;
 	struct zebra_vrf *zvrf = vrf_info_lookup(re->vrf_id);
 
+	re->kernel_hash = 0;
+
 	zns = zvrf->zns;
 	memset(&req, 0, sizeof req - NL_PKT_BUF_SIZE);
 
@@ -1401,6 +2297,31 @@ static int netlink_route_multipath(int cmd, struct prefix *p,
 			  RTA_PAYLOAD(rta));
 	}
 
+	if (cmd == RTM_NEWROUTE
+	    && (knhg = netlink_nhg_install(zns, re, family))) {
+		addattr32(&req.n, sizeof req, RTA_NH_ID, knhg->id);
+		if (netlink_route_src(re, family, &src))
+			addattr_l(&req.n, sizeof req, RTA_PREFSRC, &src,
+				  bytelen);
+
+		/*
+		 * If the kernel has just this already, the group changing
+		 * underneath was all there was to it.
+		 */
+		hash = jhash(NLMSG_DATA(&req.n), req.n.nlmsg_len - NLMSG_HDRLEN,
+			     knhg->generation);
+		if (!hash)
+			hash = 1;
+		re->kernel_hash = hash;
+		if (update && hash == kernel_hash) {
+			nl_nhg_routes_skipped++;
+			return 0;
+		}
+
+		netlink_route_batch_add(zns, &req.n, rn, re, NULL);
+		return 1;
+	}
+
 	/* Count overall nexthops so we can decide whether to use singlepath
 	 * or multipath case. */
 	nexthop_num = 0;
@@ -1614,13 +2535,9 @@ static int netlink_route_multipath(int cmd, struct prefix *p,
 
 skip:
 
-	/* Destination netlink address. */
-	memset(&snl, 0, sizeof snl);
-	snl.nl_family = AF_NETLINK;
-
-	/* Talk to netlink socket. */
-	return netlink_talk(netlink_talk_filter, &req.n, &zns->netlink_cmd, zns,
-			    0);
+	/* Queue it up for the netlink socket. */
+	netlink_route_batch_add(zns, &req.n, rn, re, NULL);
+	return 1;
 }
 
 int kernel_get_ipmr_sg_stats(struct zebra_vrf *zvrf, void *in)
@@ -1660,18 +2577,54 @@ int kernel_get_ipmr_sg_stats(struct zebra_vrf *zvrf, void *in)
 	return suc;
 }
 
+/* Runs func over each of the VRF's multicast routes, as dumped by the
+ * kernel with its counters.
+ */
+int kernel_get_ipmr_sg_stats_bulk(struct zebra_vrf *zvrf,
+				  void (*func)(void *mroute, void *arg),
+				  void *arg)
+{
+	struct zebra_ns *zns = zvrf->zns;
+	int ret;
+
+	ret = netlink_request_route(zns, RTNL_FAMILY_IPMR, RTM_GETROUTE);
+	if (ret < 0)
+		return ret;
+
+	mroute_walk = func;
+	mroute_walk_arg = arg;
+	mroute_walk_vrf = zvrf_id(zvrf);
+
+	ret = netlink_parse_info(netlink_route_change_read_multicast,
+				 &zns->netlink_cmd, zns, 0, 0);
+
+	mroute_walk = NULL;
+	mroute_walk_arg = NULL;
+	return ret;
+}
+
 void kernel_route_rib(struct route_node *rn, struct prefix *p,
 		      struct prefix *src_p, struct route_entry *old,
 		      struct route_entry *new)
 {
 	int ret = 0;
+	uint32_t kernel_hash;
 
 	assert(old || new);
 
 	if (new) {
+		/*
+		 * Routes replacing one the same (BGP sending it again, say)
+		 * need not be sent.
+		 */
+		kernel_hash = (old && zebra_nhg_in_fib(old)) ? old->kernel_hash
+							     : 0;
+
 		if (p->family == AF_INET)
-			ret = netlink_route_multipath(RTM_NEWROUTE, p, src_p,
-						      new, (old) ? 1 : 0);
+			ret = netlink_route_multipath(RTM_NEWROUTE, rn, p,
+						      src_p, new,
+						      (old) ? 1 : 0,
+						      kernel_hash);
 		else {
 			/*
 			 * So v6 route replace semantics are not in
@@ -1684,25 +2637,29 @@ void kernel_route_rib(struct route_node *rn, struct prefix *p,
 			 * I'm also intentionally ignoring the failure case
 			 * of the route delete.  If that happens yeah we're
 			 * screwed.
+			 *
+			 * Kernels that have nexthop objects do replace v6
+			 * routes fine.
 			 */
-			if (old)
-				netlink_route_multipath(RTM_DELROUTE, p, src_p,
-							old, 0);
-			ret = netlink_route_multipath(RTM_NEWROUTE, p, src_p,
-						      new, 0);
+			if (old && !nl_nhg_enabled)
+				netlink_route_multipath(RTM_DELROUTE, NULL, p,
+							src_p, old, 0, 0);
+			ret = netlink_route_multipath(
+				RTM_NEWROUTE, rn, p, src_p, new,
+				(old && nl_nhg_enabled) ? 1 : 0, kernel_hash);
 		}
-		kernel_route_rib_pass_fail(rn, p, new,
-					   (!ret) ? SOUTHBOUND_INSTALL_SUCCESS
-						  : SOUTHBOUND_INSTALL_FAILURE);
+		if (!ret)
+			kernel_route_rib_pass_fail(rn, p, new,
+						   SOUTHBOUND_INSTALL_SUCCESS);
 		return;
 	}
 
 	if (old) {
-		ret = netlink_route_multipath(RTM_DELROUTE, p, src_p, old, 0);
-
-		kernel_route_rib_pass_fail(rn, p, old,
-					   (!ret) ? SOUTHBOUND_DELETE_SUCCESS
-						  : SOUTHBOUND_DELETE_FAILURE);
+		ret = netlink_route_multipath(RTM_DELROUTE, rn, p, src_p, old,
+					      0, 0);
+		if (!ret)
+			kernel_route_rib_pass_fail(rn, p, old,
+						   SOUTHBOUND_DELETE_SUCCESS);
 	}
 }
 
@@ -2088,8 +3045,8 @@ static int netlink_macfdb_update(struct interface *ifp, vlanid_t vid,
 			   prefix_mac2str(mac, buf, sizeof(buf)),
 			   dst_present ? dst_buf : "");
 
-	return netlink_talk(netlink_talk_filter, &req.n, &zns->netlink_cmd, zns,
-			    0);
+	netlink_route_batch_add(zns, &req.n, NULL, NULL, NULL);
+	return 0;
 }
 
 #define NUD_VALID                                                              \
@@ -2391,8 +3348,8 @@ static int netlink_neigh_update2(struct interface *ifp, struct ipaddr *ip,
 			   mac ? prefix_mac2str(mac, buf2, sizeof(buf2))
 			       : "null");
 
-	return netlink_talk(netlink_talk_filter, &req.n, &zns->netlink_cmd, zns,
-			    0);
+	netlink_route_batch_add(zns, &req.n, NULL, NULL, NULL);
+	return 0;
 }
 
 int kernel_add_mac(struct interface *ifp, vlanid_t vid, struct ethaddr *mac,
@@ -2422,6 +3379,10 @@ int kernel_del_neigh(struct interface *ifp, struct ipaddr *ip)
 
 /*
  * MPLS label forwarding table change via netlink interface.
+ *
+ * Returns 1 if the update was queued for the kernel, in which case the
+ * result for lsp is reported through kernel_lsp_pass_fail() later on, and
+ * 0 if there was nothing to send.
  */
 int netlink_mpls_multipath(int cmd, zebra_lsp_t *lsp)
 {
@@ -2431,6 +3392,7 @@ int netlink_mpls_multipath(int cmd, zebra_lsp_t *lsp)
 	unsigned int nexthop_num;
 	const char *routedesc;
 	struct zebra_ns *zns = zebra_ns_lookup(NS_DEFAULT);
+	struct nl_route_batch_entry *entry;
 	int route_type;
 
 	struct {
@@ -2569,8 +3531,10 @@ int netlink_mpls_multipath(int cmd, zebra_lsp_t *lsp)
 				  RTA_DATA(rta), RTA_PAYLOAD(rta));
 	}
 
-	/* Talk to netlink socket. */
-	return netlink_talk(netlink_talk_filter, &req.n, &zns->netlink_cmd, zns,
-			    0);
+	entry = netlink_route_batch_queue(zns, &req.n);
+	entry->lsp = lsp;
+	SET_FLAG(lsp->flags, LSP_FLAG_QUEUED);
+
+	return 1;
 }
 #endif /* HAVE_NETLINK */
@@ -57,6 +57,10 @@ void rt_netlink_init(void);
 
 extern int netlink_mpls_multipath(int cmd, zebra_lsp_t *lsp);
 
+struct zebra_pbr_rule;
+extern void netlink_rule_batch_add(struct zebra_ns *zns, struct nlmsghdr *n,
+				   struct zebra_pbr_rule *rule);
+
 extern int netlink_route_change(struct sockaddr_nl *snl, struct nlmsghdr *h,
 				ns_id_t ns_id, int startup);
 extern int netlink_route_read(struct zebra_ns *zns);
@@ -421,6 +421,28 @@ void kernel_route_rib(struct route_node *rn, struct prefix *p,
 	}
 }
 
+void kernel_route_rib_flush(void)
+{
+	/* Routing socket updates are not queued */
+}
+
+void kernel_route_rib_wait(void)
+{
+}
+
+/* Routing sockets have no nexthop objects */
+void kernel_nhg_release(struct nhg_hash_entry *nhe)
+{
+}
+
+void kernel_nhg_if_down(struct interface *ifp)
+{
+}
+
+void kernel_nhg_show(struct vty *vty)
+{
+}
+
 int kernel_neigh_update(int add, int ifindex, uint32_t addr, char *lla,
 			int llalen, ns_id_t ns_id)
 {
@@ -433,6 +455,13 @@ extern int kernel_get_ipmr_sg_stats(struct zebra_vrf *zvrf, void *mroute)
 	return 0;
 }
 
+int kernel_get_ipmr_sg_stats_bulk(struct zebra_vrf *zvrf,
+				  void (*func)(void *mroute, void *arg),
+				  void *arg)
+{
+	return -1;
+}
+
 int kernel_add_vtep(vni_t vni, struct interface *ifp, struct in_addr *vtep_ip)
 {
 	return 0;
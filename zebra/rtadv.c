@@ -67,11 +67,11 @@ extern struct zebra_privs_t zserv_privs;
    command matching, so only modify with care. */
 const char *rtadv_pref_strs[] = {"medium", "high", "INVALID", "low", 0};
 
+DEFINE_MTYPE_STATIC(ZEBRA, RTADV_PACKET, "Router Advertisement packet")
+
 enum rtadv_event {
 	RTADV_START,
 	RTADV_STOP,
-	RTADV_TIMER,
-	RTADV_TIMER_MSEC,
 	RTADV_READ
 };
 
@@ -149,57 +149,16 @@ static int rtadv_recv_packet(struct zebra_ns *zns, int sock, uint8_t *buf,
 
 #define RTADV_MSG_SIZE 4096
 
-/* Send router advertisement packet. */
-static void rtadv_send_packet(int sock, struct interface *ifp)
+/* Make router advertisement message for ifp in buf, returns its length. */
+static int rtadv_packet_build(struct interface *ifp, unsigned char *buf)
 {
-	struct msghdr msg;
-	struct iovec iov;
-	struct cmsghdr *cmsgptr;
-	struct in6_pktinfo *pkt;
-	struct sockaddr_in6 addr;
-	static void *adata = NULL;
-	unsigned char buf[RTADV_MSG_SIZE];
 	struct nd_router_advert *rtadv;
-	int ret;
 	int len = 0;
 	struct zebra_if *zif;
 	struct rtadv_prefix *rprefix;
-	uint8_t all_nodes_addr[] = {0xff, 0x02, 0, 0, 0, 0, 0, 0,
-				    0,    0,    0, 0, 0, 0, 0, 1};
 	struct listnode *node;
 	uint16_t pkt_RouterLifetime;
 
-	/*
-	 * Allocate control message bufffer.  This is dynamic because
-	 * CMSG_SPACE is not guaranteed not to call a function.  Note that
-	 * the size will be different on different architectures due to
-	 * differing alignment rules.
-	 */
-	if (adata == NULL) {
-		/* XXX Free on shutdown. */
-		adata = calloc(1, CMSG_SPACE(sizeof(struct in6_pktinfo)));
-
-		if (adata == NULL) {
-			zlog_err(
-				"rtadv_send_packet: can't malloc control data");
-			exit(-1);
-		}
-	}
-
-	/* Logging of packet. */
-	if (IS_ZEBRA_DEBUG_PACKET)
-		zlog_debug("%s(%u): Tx RA, socket %u", ifp->name, ifp->ifindex,
-			   sock);
-
-	/* Fill in sockaddr_in6. */
-	memset(&addr, 0, sizeof(struct sockaddr_in6));
-	addr.sin6_family = AF_INET6;
-#ifdef SIN6_LEN
-	addr.sin6_len = sizeof(struct sockaddr_in6);
-#endif /* SIN6_LEN */
-	addr.sin6_port = htons(IPPROTO_ICMPV6);
-	IPV6_ADDR_COPY(&addr.sin6_addr, all_nodes_addr);
-
 	/* Fetch interface information. */
 	zif = ifp->info;
 
@@ -352,6 +311,84 @@ static void rtadv_send_packet(int sock, struct interface *ifp)
 		len += sizeof(struct nd_opt_mtu);
 	}
 
+	return len;
+}
+
+/*
+ * Make sure ifp has an RA to send.  It is only built again once the
+ * configuration it is made from changed, see rtadv_packet_invalidate(), or
+ * the interface got a new hardware address.
+ */
+static void rtadv_packet_update(struct interface *ifp)
+{
+	struct zebra_if *zif = ifp->info;
+	unsigned char buf[RTADV_MSG_SIZE];
+
+	if (zif->ra_pkt && zif->ra_hw_addr_len == ifp->hw_addr_len
+	    && !memcmp(zif->ra_hw_addr, ifp->hw_addr, ifp->hw_addr_len))
+		return;
+
+	XFREE(MTYPE_RTADV_PACKET, zif->ra_pkt);
+	zif->ra_pkt_len = rtadv_packet_build(ifp, buf);
+	zif->ra_pkt = XMALLOC(MTYPE_RTADV_PACKET, zif->ra_pkt_len);
+	memcpy(zif->ra_pkt, buf, zif->ra_pkt_len);
+
+	zif->ra_hw_addr_len = ifp->hw_addr_len;
+	memcpy(zif->ra_hw_addr, ifp->hw_addr, ifp->hw_addr_len);
+}
+
+static void rtadv_packet_invalidate(struct zebra_if *zif)
+{
+	XFREE(MTYPE_RTADV_PACKET, zif->ra_pkt);
+}
+
+/* Send router advertisement packet. */
+static void rtadv_send_packet(int sock, struct interface *ifp)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsgptr;
+	struct in6_pktinfo *pkt;
+	struct sockaddr_in6 addr;
+	static void *adata = NULL;
+	int ret;
+	struct zebra_if *zif = ifp->info;
+	uint8_t all_nodes_addr[] = {0xff, 0x02, 0, 0, 0, 0, 0, 0,
+				    0,    0,    0, 0, 0, 0, 0, 1};
+
+	/*
+	 * Allocate control message bufffer.  This is dynamic because
+	 * CMSG_SPACE is not guaranteed not to call a function.  Note that
+	 * the size will be different on different architectures due to
+	 * differing alignment rules.
+	 */
+	if (adata == NULL) {
+		/* XXX Free on shutdown. */
+		adata = calloc(1, CMSG_SPACE(sizeof(struct in6_pktinfo)));
+
+		if (adata == NULL) {
+			zlog_err(
+				"rtadv_send_packet: can't malloc control data");
+			exit(-1);
+		}
+	}
+
+	/* Logging of packet. */
+	if (IS_ZEBRA_DEBUG_PACKET)
+		zlog_debug("%s(%u): Tx RA, socket %u", ifp->name, ifp->ifindex,
+			   sock);
+
+	/* Fill in sockaddr_in6. */
+	memset(&addr, 0, sizeof(struct sockaddr_in6));
+	addr.sin6_family = AF_INET6;
+#ifdef SIN6_LEN
+	addr.sin6_len = sizeof(struct sockaddr_in6);
+#endif /* SIN6_LEN */
+	addr.sin6_port = htons(IPPROTO_ICMPV6);
+	IPV6_ADDR_COPY(&addr.sin6_addr, all_nodes_addr);
+
+	rtadv_packet_update(ifp);
+
 	msg.msg_name = (void *)&addr;
 	msg.msg_namelen = sizeof(struct sockaddr_in6);
 	msg.msg_iov = &iov;
@@ -359,8 +396,8 @@ static void rtadv_send_packet(int sock, struct interface *ifp)
 	msg.msg_control = (void *)adata;
 	msg.msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
 	msg.msg_flags = 0;
-	iov.iov_base = buf;
-	iov.iov_len = len;
+	iov.iov_base = zif->ra_pkt;
+	iov.iov_len = zif->ra_pkt_len;
 
 	cmsgptr = ZCMSG_FIRSTHDR(&msg);
 	cmsgptr->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
@@ -380,69 +417,181 @@ static void rtadv_send_packet(int sock, struct interface *ifp)
 		zif->ra_sent++;
 }
 
+/*
+ * Unsolicited RAs.
+ *
+ * Rather than every interface having a timer, or one timer looking at all
+ * of them, the interfaces sending RAs sit on a wheel of their namespace,
+ * in the slot of the RTADV_TICK_MSEC tick they are next due at.  The timer
+ * only wakes up for ticks that have interfaces in their slot and sends
+ * the RAs of all of them.  As RFC4861 6.2.4 asks, the time until the next
+ * RA is picked at random between MinRtrAdvInterval and MaxRtrAdvInterval,
+ * which spreads interfaces over the ticks.
+ */
+static uint64_t rtadv_tick_now(void)
+{
+	struct timeval tv;
+
+	monotime(&tv);
+	return ((uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000)
+	       / RTADV_TICK_MSEC;
+}
+
+static int rtadv_timer(struct thread *thread);
+
+static void rtadv_timer_set(struct zebra_ns *zns, uint64_t tick, uint64_t now)
+{
+	struct rtadv *rtadv = &zns->rtadv;
+
+	THREAD_OFF(rtadv->ra_timer);
+	rtadv->timer_tick = tick;
+	thread_add_timer_msec(zebrad.master, rtadv_timer, zns,
+			      tick > now ? (tick - now) * RTADV_TICK_MSEC : 0,
+			      &rtadv->ra_timer);
+}
+
+static void rtadv_unschedule(struct zebra_if *zif)
+{
+	struct rtadv *rtadv;
+
+	if (!zif->ra_zns)
+		return;
+
+	rtadv = &zif->ra_zns->rtadv;
+	TAILQ_REMOVE(&rtadv->wheel[zif->ra_due % RTADV_WHEEL_SLOTS], zif,
+		     ra_wheel);
+	rtadv->wheel_count--;
+	zif->ra_zns = NULL;
+}
+
+/* Have zif send its next RA in msec, rounded up to a whole tick. */
+static void rtadv_schedule(struct zebra_ns *zns, struct zebra_if *zif,
+			   unsigned int msec)
+{
+	struct rtadv *rtadv = &zns->rtadv;
+	uint64_t now = rtadv_tick_now();
+
+	rtadv_unschedule(zif);
+
+	if (!rtadv->wheel_count)
+		rtadv->wheel_tick = now;
+
+	zif->ra_due = now + (msec + RTADV_TICK_MSEC - 1) / RTADV_TICK_MSEC;
+	/* the timer is past earlier slots already */
+	if (zif->ra_due < rtadv->wheel_tick)
+		zif->ra_due = rtadv->wheel_tick;
+
+	TAILQ_INSERT_TAIL(&rtadv->wheel[zif->ra_due % RTADV_WHEEL_SLOTS], zif,
+			  ra_wheel);
+	rtadv->wheel_count++;
+	zif->ra_zns = zns;
+
+	if (!rtadv->ra_timer || rtadv->timer_tick > zif->ra_due)
+		rtadv_timer_set(zns, zif->ra_due, now);
+}
+
+/* Time until the next unsolicited RA, see RFC4861 6.2.4. */
+static unsigned int rtadv_interval(struct zebra_if *zif)
+{
+	int min = zif->rtadv.MinRtrAdvInterval;
+	int max = zif->rtadv.MaxRtrAdvInterval;
+
+	if (min >= max)
+		return max;
+
+	return min + random() % (max - min + 1);
+}
+
+static void rtadv_if_timer(struct zebra_ns *zns, struct zebra_if *zif)
+{
+	struct interface *ifp = zif->ifp;
+
+	if (if_is_loopback(ifp)
+	    || CHECK_FLAG(ifp->status, ZEBRA_INTERFACE_VRF_LOOPBACK)
+	    || !if_is_operative(ifp)) {
+		/* look again in a bit */
+		rtadv_schedule(zns, zif, RTADV_FAST_REXMIT_PERIOD * 1000);
+		return;
+	}
+
+	if (zif->rtadv.inFastRexmit) {
+		if (--zif->rtadv.NumFastReXmitsRemain <= 0)
+			zif->rtadv.inFastRexmit = 0;
+
+		if (IS_ZEBRA_DEBUG_SEND)
+			zlog_debug("Fast RA Rexmit on interface %s",
+				   ifp->name);
+	}
+
+	rtadv_send_packet(zns->rtadv.sock, ifp);
+
+	rtadv_schedule(zns, zif,
+		       zif->rtadv.inFastRexmit
+			       ? RTADV_FAST_REXMIT_PERIOD * 1000
+			       : rtadv_interval(zif));
+}
+
 static int rtadv_timer(struct thread *thread)
 {
 	struct zebra_ns *zns = THREAD_ARG(thread);
-	struct vrf *vrf;
-	struct interface *ifp;
-	struct zebra_if *zif;
-	int period;
+	struct rtadv *rtadv = &zns->rtadv;
+	struct rtadv_wheel_slot *slot;
+	struct zebra_if *zif, *next;
+	uint64_t now = rtadv_tick_now();
+	unsigned int i;
 
-	zns->rtadv.ra_timer = NULL;
-	if (zns->rtadv.adv_msec_if_count == 0) {
-		period = 1000; /* 1 s */
-		rtadv_event(zns, RTADV_TIMER, 1 /* 1 s */);
-	} else {
-		period = 10; /* 10 ms */
-		rtadv_event(zns, RTADV_TIMER_MSEC, 10 /* 10 ms */);
+	rtadv->ra_timer = NULL;
+
+	/*
+	 * Run the slots up to now, each at most once.  Interfaces moved to
+	 * a later tick of the slot being run are passed over.
+	 */
+	for (i = 0; i < RTADV_WHEEL_SLOTS && rtadv->wheel_tick <= now; i++) {
+		slot = &rtadv->wheel[rtadv->wheel_tick % RTADV_WHEEL_SLOTS];
+		TAILQ_FOREACH_SAFE (zif, slot, ra_wheel, next)
+			if (zif->ra_due <= now)
+				rtadv_if_timer(zns, zif);
+		rtadv->wheel_tick++;
 	}
+	rtadv->wheel_tick = now + 1;
 
-	RB_FOREACH (vrf, vrf_id_head, &vrfs_by_id)
-		FOR_ALL_INTERFACES (vrf, ifp) {
-			if (if_is_loopback(ifp)
-			    || CHECK_FLAG(ifp->status,
-					  ZEBRA_INTERFACE_VRF_LOOPBACK)
-			    || !if_is_operative(ifp))
-				continue;
-
-			zif = ifp->info;
-
-			if (zif->rtadv.AdvSendAdvertisements) {
-				if (zif->rtadv.inFastRexmit) {
-					/* We assume we fast rexmit every sec so
-					 * no
-					 * additional vars */
-					if (--zif->rtadv.NumFastReXmitsRemain
-					    <= 0)
-						zif->rtadv.inFastRexmit = 0;
-
-					if (IS_ZEBRA_DEBUG_SEND)
-						zlog_debug(
-							"Fast RA Rexmit on interface %s",
-							ifp->name);
-
-					rtadv_send_packet(zns->rtadv.sock, ifp);
-				} else {
-					zif->rtadv.AdvIntervalTimer -= period;
-					if (zif->rtadv.AdvIntervalTimer <= 0) {
-						/* FIXME: using
-						   MaxRtrAdvInterval each
-						   time isn't what section
-						   6.2.4 of RFC4861 tells to do.
-						   */
-						zif->rtadv.AdvIntervalTimer =
-							zif->rtadv
-								.MaxRtrAdvInterval;
-						rtadv_send_packet(
-							zns->rtadv.sock, ifp);
-					}
-				}
-			}
-		}
+	if (!rtadv->wheel_count) {
+		THREAD_OFF(rtadv->ra_timer);
+		return 0;
+	}
+
+	/* Wake up for the next slot that is not empty */
+	for (i = 0; i < RTADV_WHEEL_SLOTS; i++)
+		if (!TAILQ_EMPTY(&rtadv->wheel[(rtadv->wheel_tick + i)
+					       % RTADV_WHEEL_SLOTS]))
+			break;
+	rtadv_timer_set(zns, rtadv->wheel_tick + i, now);
 
 	return 0;
 }
 
+void rtadv_if_up(struct interface *ifp)
+{
+	struct zebra_if *zif = ifp->info;
+
+	/* Enable fast tx of RA if enabled && RA interval is not in msecs */
+	if (zif->rtadv.AdvSendAdvertisements
+	    && (zif->rtadv.MaxRtrAdvInterval >= 1000)) {
+		zif->rtadv.inFastRexmit = 1;
+		zif->rtadv.NumFastReXmitsRemain = RTADV_NUM_FAST_REXMITS;
+		if (zif->ra_zns)
+			rtadv_schedule(zif->ra_zns, zif, 0);
+	}
+}
+
+void rtadv_if_delete(struct interface *ifp)
+{
+	struct zebra_if *zif = ifp->info;
+
+	rtadv_unschedule(zif);
+	rtadv_packet_invalidate(zif);
+}
+
 static void rtadv_process_solicit(struct interface *ifp)
 {
 	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
@@ -734,6 +883,7 @@ static void rtadv_prefix_set(struct zebra_if *zif, struct rtadv_prefix *rp)
 	rprefix->AdvOnLinkFlag = rp->AdvOnLinkFlag;
 	rprefix->AdvAutonomousFlag = rp->AdvAutonomousFlag;
 	rprefix->AdvRouterAddressFlag = rp->AdvRouterAddressFlag;
+	rtadv_packet_invalidate(zif);
 }
 
 static int rtadv_prefix_reset(struct zebra_if *zif, struct rtadv_prefix *rp)
@@ -744,6 +894,7 @@ static int rtadv_prefix_reset(struct zebra_if *zif, struct rtadv_prefix *rp)
 	if (rprefix != NULL) {
 		listnode_delete(zif->rtadv.AdvPrefixList, (void *)rprefix);
 		rtadv_prefix_free(rprefix);
+		rtadv_packet_invalidate(zif);
 		return 1;
 	} else
 		return 0;
@@ -764,7 +915,7 @@ static void ipv6_nd_suppress_ra_set(struct interface *ifp,
 		/* RA is currently enabled */
 		if (zif->rtadv.AdvSendAdvertisements) {
 			zif->rtadv.AdvSendAdvertisements = 0;
-			zif->rtadv.AdvIntervalTimer = 0;
+			rtadv_unschedule(zif);
 			zns->rtadv.adv_if_count--;
 
 			if_leave_all_router(zns->rtadv.sock, ifp);
@@ -775,7 +926,6 @@ static void ipv6_nd_suppress_ra_set(struct interface *ifp,
 	} else {
 		if (!zif->rtadv.AdvSendAdvertisements) {
 			zif->rtadv.AdvSendAdvertisements = 1;
-			zif->rtadv.AdvIntervalTimer = 0;
 			zns->rtadv.adv_if_count++;
 
 			if (zif->rtadv.MaxRtrAdvInterval >= 1000) {
@@ -790,6 +940,7 @@ static void ipv6_nd_suppress_ra_set(struct interface *ifp,
 
 			if (zns->rtadv.adv_if_count == 1)
 				rtadv_event(zns, RTADV_START, zns->rtadv.sock);
+			rtadv_schedule(zns, zif, 0);
 		}
 	}
 }
@@ -843,14 +994,18 @@ static void zebra_interface_radv_set(ZAPI_HANDLER_ARGS, int enable)
 		if (ra_interval
 		    && (ra_interval * 1000) < zif->rtadv.MaxRtrAdvInterval
 		    && !CHECK_FLAG(zif->rtadv.ra_configured,
-				   VTY_RA_INTERVAL_CONFIGURED))
+				   VTY_RA_INTERVAL_CONFIGURED)) {
 			zif->rtadv.MaxRtrAdvInterval = ra_interval * 1000;
+			rtadv_packet_invalidate(zif);
+		}
 	} else {
 		UNSET_FLAG(zif->rtadv.ra_configured, BGP_RA_CONFIGURED);
 		if (!CHECK_FLAG(zif->rtadv.ra_configured,
-				VTY_RA_INTERVAL_CONFIGURED))
+				VTY_RA_INTERVAL_CONFIGURED)) {
 			zif->rtadv.MaxRtrAdvInterval =
 				RTADV_MAX_RTR_ADV_INTERVAL;
+			rtadv_packet_invalidate(zif);
+		}
 		if (!CHECK_FLAG(zif->rtadv.ra_configured, VTY_RA_CONFIGURED))
 			ipv6_nd_suppress_ra_set(ifp, RA_SUPPRESS);
 	}
@@ -927,10 +1082,7 @@ DEFUN (ipv6_nd_ra_interval_msec,
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	unsigned interval;
 	struct zebra_if *zif = ifp->info;
-	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
-	struct zebra_ns *zns;
 
-	zns = zvrf->zns;
 	interval = strtoul(argv[idx_number]->arg, NULL, 10);
 	if ((zif->rtadv.AdvDefaultLifetime != -1
 	     && interval > (unsigned)zif->rtadv.AdvDefaultLifetime * 1000)) {
@@ -939,16 +1091,12 @@ DEFUN (ipv6_nd_ra_interval_msec,
 		return CMD_WARNING_CONFIG_FAILED;
 	}
 
-	if (zif->rtadv.MaxRtrAdvInterval % 1000)
-		zns->rtadv.adv_msec_if_count--;
-
-	if (interval % 1000)
-		zns->rtadv.adv_msec_if_count++;
-
 	SET_FLAG(zif->rtadv.ra_configured, VTY_RA_INTERVAL_CONFIGURED);
 	zif->rtadv.MaxRtrAdvInterval = interval;
 	zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-	zif->rtadv.AdvIntervalTimer = 0;
+	rtadv_packet_invalidate(zif);
+	if (zif->ra_zns)
+		rtadv_schedule(zif->ra_zns, zif, 0);
 
 	return CMD_SUCCESS;
 }
@@ -965,10 +1113,7 @@ DEFUN (ipv6_nd_ra_interval,
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	unsigned interval;
 	struct zebra_if *zif = ifp->info;
-	struct zebra_vrf *zvrf = vrf_info_lookup(ifp->vrf_id);
-	struct zebra_ns *zns;
 
-	zns = zvrf->zns;
 	interval = strtoul(argv[idx_number]->arg, NULL, 10);
 	if ((zif->rtadv.AdvDefaultLifetime != -1
 	     && interval > (unsigned)zif->rtadv.AdvDefaultLifetime)) {
@@ -977,16 +1122,15 @@ DEFUN (ipv6_nd_ra_interval,
 		return CMD_WARNING_CONFIG_FAILED;
 	}
 
-	if (zif->rtadv.MaxRtrAdvInterval % 1000)
-		zns->rtadv.adv_msec_if_count--;
-
 	/* convert to milliseconds */
 	interval = interval * 1000;
 
 	SET_FLAG(zif->rtadv.ra_configured, VTY_RA_INTERVAL_CONFIGURED);
 	zif->rtadv.MaxRtrAdvInterval = interval;
 	zif->rtadv.MinRtrAdvInterval = 0.33 * interval;
-	zif->rtadv.AdvIntervalTimer = 0;
+	rtadv_packet_invalidate(zif);
+	if (zif->ra_zns)
+		rtadv_schedule(zif->ra_zns, zif, 0);
 
 	return CMD_SUCCESS;
 }
@@ -1004,14 +1148,6 @@ DEFUN (no_ipv6_nd_ra_interval,
 {
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	struct zebra_if *zif = ifp->info;
-	struct zebra_vrf *zvrf;
-	struct zebra_ns *zns;
-
-	zvrf = vrf_info_lookup(ifp->vrf_id);
-	zns = zvrf->zns;
-
-	if (zif->rtadv.MaxRtrAdvInterval % 1000)
-		zns->rtadv.adv_msec_if_count--;
 
 	UNSET_FLAG(zif->rtadv.ra_configured, VTY_RA_INTERVAL_CONFIGURED);
 
@@ -1020,8 +1156,10 @@ DEFUN (no_ipv6_nd_ra_interval,
 	else
 		zif->rtadv.MaxRtrAdvInterval = RTADV_MAX_RTR_ADV_INTERVAL;
 
-	zif->rtadv.AdvIntervalTimer = zif->rtadv.MaxRtrAdvInterval;
 	zif->rtadv.MinRtrAdvInterval = RTADV_MIN_RTR_ADV_INTERVAL;
+	rtadv_packet_invalidate(zif);
+	if (zif->ra_zns)
+		rtadv_schedule(zif->ra_zns, zif, rtadv_interval(zif));
 
 	return CMD_SUCCESS;
 }
@@ -1052,6 +1190,7 @@ DEFUN (ipv6_nd_ra_lifetime,
 	}
 
 	zif->rtadv.AdvDefaultLifetime = lifetime;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1069,6 +1208,7 @@ DEFUN (no_ipv6_nd_ra_lifetime,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvDefaultLifetime = -1;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1085,6 +1225,7 @@ DEFUN (ipv6_nd_reachable_time,
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	struct zebra_if *zif = ifp->info;
 	zif->rtadv.AdvReachableTime = strtoul(argv[idx_number]->arg, NULL, 10);
+	rtadv_packet_invalidate(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1101,6 +1242,7 @@ DEFUN (no_ipv6_nd_reachable_time,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvReachableTime = 0;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1118,6 +1260,7 @@ DEFUN (ipv6_nd_homeagent_preference,
 	struct zebra_if *zif = ifp->info;
 	zif->rtadv.HomeAgentPreference =
 		strtoul(argv[idx_number]->arg, NULL, 10);
+	rtadv_packet_invalidate(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1134,6 +1277,7 @@ DEFUN (no_ipv6_nd_homeagent_preference,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.HomeAgentPreference = 0;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1150,6 +1294,7 @@ DEFUN (ipv6_nd_homeagent_lifetime,
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	struct zebra_if *zif = ifp->info;
 	zif->rtadv.HomeAgentLifetime = strtoul(argv[idx_number]->arg, NULL, 10);
+	rtadv_packet_invalidate(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1166,6 +1311,7 @@ DEFUN (no_ipv6_nd_homeagent_lifetime,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.HomeAgentLifetime = -1;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1181,6 +1327,7 @@ DEFUN (ipv6_nd_managed_config_flag,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvManagedFlag = 1;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1197,6 +1344,7 @@ DEFUN (no_ipv6_nd_managed_config_flag,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvManagedFlag = 0;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1212,6 +1360,7 @@ DEFUN (ipv6_nd_homeagent_config_flag,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvHomeAgentFlag = 1;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1228,6 +1377,7 @@ DEFUN (no_ipv6_nd_homeagent_config_flag,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvHomeAgentFlag = 0;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1243,6 +1393,7 @@ DEFUN (ipv6_nd_adv_interval_config_option,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvIntervalOption = 1;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1259,6 +1410,7 @@ DEFUN (no_ipv6_nd_adv_interval_config_option,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvIntervalOption = 0;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1274,6 +1426,7 @@ DEFUN (ipv6_nd_other_config_flag,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvOtherConfigFlag = 1;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1290,6 +1443,7 @@ DEFUN (no_ipv6_nd_other_config_flag,
 	struct zebra_if *zif = ifp->info;
 
 	zif->rtadv.AdvOtherConfigFlag = 0;
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1437,6 +1591,7 @@ DEFUN (ipv6_nd_router_preference,
 			    1)
 		    == 0) {
 			zif->rtadv.DefaultPreference = i;
+			rtadv_packet_invalidate(zif);
 			return CMD_SUCCESS;
 		}
 		i++;
@@ -1461,6 +1616,7 @@ DEFUN (no_ipv6_nd_router_preference,
 
 	zif->rtadv.DefaultPreference =
 		RTADV_PREF_MEDIUM; /* Default per RFC4191. */
+	rtadv_packet_invalidate(zif);
 
 	return CMD_SUCCESS;
 }
@@ -1477,6 +1633,7 @@ DEFUN (ipv6_nd_mtu,
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	struct zebra_if *zif = ifp->info;
 	zif->rtadv.AdvLinkMTU = strtoul(argv[idx_number]->arg, NULL, 10);
+	rtadv_packet_invalidate(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1492,6 +1649,7 @@ DEFUN (no_ipv6_nd_mtu,
 	VTY_DECLVAR_CONTEXT(interface, ifp);
 	struct zebra_if *zif = ifp->info;
 	zif->rtadv.AdvLinkMTU = 0;
+	rtadv_packet_invalidate(zif);
 	return CMD_SUCCESS;
 }
 
@@ -1662,8 +1820,6 @@ static void rtadv_event(struct zebra_ns *zns, enum rtadv_event event, int val)
 	case RTADV_START:
 		thread_add_read(zebrad.master, rtadv_read, zns, val,
 				&rtadv->ra_read);
-		thread_add_event(zebrad.master, rtadv_timer, zns, 0,
-				 &rtadv->ra_timer);
 		break;
 	case RTADV_STOP:
 		if (rtadv->ra_timer) {
@@ -1675,14 +1831,6 @@ static void rtadv_event(struct zebra_ns *zns, enum rtadv_event event, int val)
 			rtadv->ra_read = NULL;
 		}
 		break;
-	case RTADV_TIMER:
-		thread_add_timer(zebrad.master, rtadv_timer, zns, val,
-				 &rtadv->ra_timer);
-		break;
-	case RTADV_TIMER_MSEC:
-		thread_add_timer_msec(zebrad.master, rtadv_timer, zns, val,
-				      &rtadv->ra_timer);
-		break;
 	case RTADV_READ:
 		thread_add_read(zebrad.master, rtadv_read, zns, val,
 				&rtadv->ra_read);
@@ -1695,19 +1843,30 @@ static void rtadv_event(struct zebra_ns *zns, enum rtadv_event event, int val)
 
 void rtadv_init(struct zebra_ns *zns)
 {
+	int i;
+
+	for (i = 0; i < RTADV_WHEEL_SLOTS; i++)
+		TAILQ_INIT(&zns->rtadv.wheel[i]);
+
 	zns->rtadv.sock = rtadv_make_socket(zns->ns_id);
 }
 
 void rtadv_terminate(struct zebra_ns *zns)
 {
+	struct zebra_if *zif;
+	int i;
+
 	rtadv_event(zns, RTADV_STOP, 0);
 	if (zns->rtadv.sock >= 0) {
 		close(zns->rtadv.sock);
 		zns->rtadv.sock = -1;
 	}
 
+	for (i = 0; i < RTADV_WHEEL_SLOTS; i++)
+		while ((zif = TAILQ_FIRST(&zns->rtadv.wheel[i])))
+			rtadv_unschedule(zif);
+
 	zns->rtadv.adv_if_count = 0;
-	zns->rtadv.adv_msec_if_count = 0;
 }
 
 void rtadv_cmd_init(void)
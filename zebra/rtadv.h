@@ -93,6 +93,9 @@ struct nd_opt_homeagent_info { /* Home Agent info */
 
 extern const char *rtadv_pref_strs[];
 
+extern void rtadv_if_up(struct interface *ifp);
+extern void rtadv_if_delete(struct interface *ifp);
+
 #endif /* HAVE_RTADV */
 
 typedef enum {
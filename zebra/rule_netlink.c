@@ -38,6 +38,7 @@
 #include "zebra/debug.h"
 #include "zebra/rtadv.h"
 #include "zebra/kernel_netlink.h"
+#include "zebra/rt_netlink.h"
 #include "zebra/rule_netlink.h"
 #include "zebra/zebra_pbr.h"
 
@@ -48,10 +49,10 @@
 /* Private functions */
 
 /* Install or uninstall specified rule for a specific interface.
- * Form netlink message and ship it. Currently, notify status after
- * waiting for netlink status.
+ * Form netlink message and queue it with the route updates, status is
+ * notified once the kernel answered.
  */
-static int netlink_rule_update(int cmd, struct zebra_pbr_rule *rule)
+static void netlink_rule_update(int cmd, struct zebra_pbr_rule *rule)
 {
 	int family;
 	int bytelen;
@@ -61,7 +62,6 @@ static int netlink_rule_update(int cmd, struct zebra_pbr_rule *rule)
 		char buf[NL_PKT_BUF_SIZE];
 	} req;
 	struct zebra_ns *zns = zebra_ns_lookup(NS_DEFAULT);
-	struct sockaddr_nl snl;
 	char buf1[PREFIX_STRLEN];
 	char buf2[PREFIX_STRLEN];
 
@@ -117,14 +117,7 @@ static int netlink_rule_update(int cmd, struct zebra_pbr_rule *rule)
 			prefix2str(&rule->filter.dst_ip, buf2, sizeof(buf2)),
 			rule->action.table);
 
-	/* Ship off the message.
-	 * Note: Currently, netlink_talk() is a blocking call which returns
-	 * back the status.
-	 */
-	memset(&snl, 0, sizeof(snl));
-	snl.nl_family = AF_NETLINK;
-	return netlink_talk(netlink_talk_filter, &req.n,
-			    &zns->netlink_cmd, zns, 0);
+	netlink_rule_batch_add(zns, &req.n, rule);
 }
 
 
@@ -136,12 +129,7 @@ static int netlink_rule_update(int cmd, struct zebra_pbr_rule *rule)
  */
 void kernel_add_pbr_rule(struct zebra_pbr_rule *rule)
 {
-	int ret = 0;
-
-	ret = netlink_rule_update(RTM_NEWRULE, rule);
-	kernel_pbr_rule_add_del_status(rule,
-				       (!ret) ? SOUTHBOUND_INSTALL_SUCCESS
-					      : SOUTHBOUND_INSTALL_FAILURE);
+	netlink_rule_update(RTM_NEWRULE, rule);
 }
 
 /*
@@ -149,12 +137,7 @@ void kernel_add_pbr_rule(struct zebra_pbr_rule *rule)
  */
 void kernel_del_pbr_rule(struct zebra_pbr_rule *rule)
 {
-	int ret = 0;
-
-	ret = netlink_rule_update(RTM_DELRULE, rule);
-	kernel_pbr_rule_add_del_status(rule,
-				       (!ret) ? SOUTHBOUND_DELETE_SUCCESS
-					      : SOUTHBOUND_DELETE_FAILURE);
+	netlink_rule_update(RTM_DELRULE, rule);
 }
 
 /*
@@ -0,0 +1,196 @@
+/*
+ * Zebra dataplane pthread
+ * Copyright (C) 2018 Cumulus Networks, Inc.
+ *
+ * This file is part of FRR.
+ *
+ * FRR is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * FRR is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRR; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "frr_pthread.h"
+#include "memory.h"
+#include "queue.h"
+#include "thread.h"
+
+#include "zebra/zebra_memory.h"
+#include "zebra/zserv.h"
+#include "zebra/rib.h"
+#include "zebra/zebra_dplane.h"
+
+DEFINE_MTYPE_STATIC(ZEBRA, DPLANE_WORK, "Dataplane work item")
+
+struct dplane_work {
+	TAILQ_ENTRY(dplane_work) entry;
+
+	void (*work)(void *);
+	void (*done)(void *);
+	void *arg;
+};
+
+TAILQ_HEAD(dplane_work_list, dplane_work);
+
+static struct zebra_dplane {
+	/* NULL while work is run inline */
+	struct frr_pthread *pthread;
+
+	pthread_mutex_t mtx;
+	/* signalled whenever outstanding drops; Requires: mtx */
+	pthread_cond_t cond;
+
+	/* queued but not yet worked on; Requires: mtx */
+	unsigned int outstanding;
+	/* worked on, waiting for the main thread; Requires: mtx */
+	struct dplane_work_list done;
+
+	struct thread *t_done;
+} dplane;
+
+/* Runs the 'done' callbacks of completed work, main thread only. */
+static void dplane_process_done(void)
+{
+	struct dplane_work_list done;
+	struct dplane_work *w;
+	bool idle;
+
+	TAILQ_INIT(&done);
+
+	pthread_mutex_lock(&dplane.mtx);
+	{
+		TAILQ_CONCAT(&done, &dplane.done, entry);
+		idle = !dplane.outstanding;
+	}
+	pthread_mutex_unlock(&dplane.mtx);
+
+	while ((w = TAILQ_FIRST(&done))) {
+		TAILQ_REMOVE(&done, w, entry);
+		(*w->done)(w->arg);
+		XFREE(MTYPE_DPLANE_WORK, w);
+	}
+
+	if (idle)
+		rib_dplane_idle();
+}
+
+static int dplane_done_thread(struct thread *thread)
+{
+	dplane_process_done();
+	return 0;
+}
+
+static int dplane_work_thread(struct thread *thread)
+{
+	struct dplane_work *w = THREAD_ARG(thread);
+
+	(*w->work)(w->arg);
+
+	pthread_mutex_lock(&dplane.mtx);
+	{
+		TAILQ_INSERT_TAIL(&dplane.done, w, entry);
+		dplane.outstanding--;
+		pthread_cond_signal(&dplane.cond);
+	}
+	pthread_mutex_unlock(&dplane.mtx);
+
+	thread_add_event(zebrad.master, dplane_done_thread, NULL, 0,
+			 &dplane.t_done);
+	return 0;
+}
+
+void zebra_dplane_enqueue(void (*work)(void *), void (*done)(void *),
+			  void *arg)
+{
+	struct dplane_work *w;
+
+	if (!dplane.pthread) {
+		(*work)(arg);
+		(*done)(arg);
+		return;
+	}
+
+	w = XCALLOC(MTYPE_DPLANE_WORK, sizeof(struct dplane_work));
+	w->work = work;
+	w->done = done;
+	w->arg = arg;
+
+	pthread_mutex_lock(&dplane.mtx);
+	{
+		dplane.outstanding++;
+	}
+	pthread_mutex_unlock(&dplane.mtx);
+
+	thread_post_event(dplane.pthread->master, dplane_work_thread, w, 0);
+}
+
+void zebra_dplane_wait(void)
+{
+	pthread_mutex_lock(&dplane.mtx);
+	{
+		while (dplane.outstanding)
+			pthread_cond_wait(&dplane.cond, &dplane.mtx);
+	}
+	pthread_mutex_unlock(&dplane.mtx);
+
+	THREAD_OFF(dplane.t_done);
+	dplane_process_done();
+}
+
+bool zebra_dplane_busy(void)
+{
+	bool busy;
+
+	pthread_mutex_lock(&dplane.mtx);
+	{
+		busy = dplane.outstanding || !TAILQ_EMPTY(&dplane.done);
+	}
+	pthread_mutex_unlock(&dplane.mtx);
+
+	return busy;
+}
+
+void zebra_dplane_init(void)
+{
+	pthread_mutex_init(&dplane.mtx, NULL);
+	pthread_cond_init(&dplane.cond, NULL);
+	TAILQ_INIT(&dplane.done);
+}
+
+void zebra_dplane_start(void)
+{
+	struct frr_pthread *pthread;
+
+	pthread = frr_pthread_new(NULL, "Zebra dplane thread");
+	if (!pthread || frr_pthread_run(pthread, NULL)) {
+		zlog_err("Can't start dataplane pthread, kernel updates will be done inline");
+		return;
+	}
+	frr_pthread_wait_running(pthread);
+
+	dplane.pthread = pthread;
+}
+
+void zebra_dplane_finish(void)
+{
+	struct frr_pthread *pthread = dplane.pthread;
+
+	if (!pthread)
+		return;
+
+	zebra_dplane_wait();
+	dplane.pthread = NULL;
+	frr_pthread_stop(pthread, NULL);
+}
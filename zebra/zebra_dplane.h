@@ -0,0 +1,75 @@
+/*
+ * Zebra dataplane pthread
+ * Copyright (C) 2018 Cumulus Networks, Inc.
+ *
+ * This file is part of FRR.
+ *
+ * FRR is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * FRR is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRR; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_DPLANE_H
+#define _ZEBRA_DPLANE_H
+
+#include <zebra.h>
+
+/*
+ * The dataplane pthread talks to the kernel on behalf of the main thread,
+ * so that a slow kernel does not hold up reading from clients and
+ * processing the RIB.
+ *
+ * Work is handed over as an opaque context object together with two
+ * callbacks: 'work' runs on the dataplane pthread and must only touch the
+ * context, 'done' runs afterwards on the main thread and may look at the
+ * RIB again.  Items are worked on and completed in the order they were
+ * queued.
+ *
+ * Until zebra_dplane_start() and after zebra_dplane_finish() both callbacks
+ * are simply run inline.
+ */
+
+/* Sets up the dataplane; the pthread itself is not started yet. */
+extern void zebra_dplane_init(void);
+
+/* Starts the dataplane pthread. */
+extern void zebra_dplane_start(void);
+
+/* Completes all outstanding work and stops the dataplane pthread. */
+extern void zebra_dplane_finish(void);
+
+/*
+ * Queues work for the dataplane pthread.
+ *
+ * @param work	called on the dataplane pthread with arg
+ * @param done	called on the main thread with arg once work returned
+ * @param arg	the context object
+ */
+extern void zebra_dplane_enqueue(void (*work)(void *), void (*done)(void *),
+				 void *arg);
+
+/*
+ * Waits for the dataplane pthread to catch up, then runs the 'done'
+ * callbacks of everything queued so far.
+ */
+extern void zebra_dplane_wait(void);
+
+/*
+ * Whether queued work has not been completed on the main thread yet.
+ *
+ * Once it has, rib_dplane_idle() is called.
+ */
+extern bool zebra_dplane_busy(void);
+
+#endif /* _ZEBRA_DPLANE_H */
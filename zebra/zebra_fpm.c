@@ -27,6 +27,7 @@
 #include "libfrr.h"
 #include "stream.h"
 #include "thread.h"
+#include "frr_pthread.h"
 #include "network.h"
 #include "command.h"
 #include "version.h"
@@ -48,15 +49,27 @@
  * Sizes of outgoing and incoming stream buffers for writing/reading
  * FPM messages.
  */
-#define ZFPM_OBUF_SIZE (2 * FPM_MAX_MSG_LEN)
+#define ZFPM_OBUF_SIZE (4 * FPM_MAX_BATCH_MSG_LEN)
 #define ZFPM_IBUF_SIZE (FPM_MAX_MSG_LEN)
 
 /*
- * The maximum number of times the FPM socket write callback can call
- * 'write' before it yields.
+ * The maximum number of filled output buffers that may be waiting for
+ * the writer before we stop building more.
+ */
+#define ZFPM_MAX_OBUFS 4
+
+/*
+ * The maximum number of output buffers the writer writes out before it
+ * yields.
  */
 #define ZFPM_MAX_WRITES_PER_RUN 10
 
+/*
+ * How long we wait for an FPM to tell us how far it got, when resync
+ * is configured, before we fall back to sending it everything.
+ */
+#define ZFPM_SYNC_WAIT_SECS 3
+
 /*
  * Interval over which we collect statistics.
  */
@@ -85,6 +98,13 @@ typedef struct zfpm_stats_t_ {
 	unsigned long partial_writes;
 	unsigned long max_writes_hit;
 	unsigned long t_write_yields;
+	unsigned long obufs_queued;
+	unsigned long obuf_limit_hits;
+
+	unsigned long full_syncs;
+	unsigned long incremental_syncs;
+	unsigned long log_acked;
+	unsigned long log_replayed;
 
 	unsigned long nop_deletes_skipped;
 	unsigned long route_adds;
@@ -183,11 +203,42 @@ typedef struct zfpm_glob_t_ {
 	int sock;
 
 	/*
-	 * Buffers for messages to/from the FPM.
+	 * Buffers for messages to/from the FPM. The outbound buffer is
+	 * filled here, then handed off to the writer.
 	 */
 	struct stream *obuf;
 	struct stream *ibuf;
 
+	/*
+	 * True if the FPM has announced that it takes route batches.
+	 */
+	int batch;
+
+	/*
+	 * True if 'fpm resync' is configured, and if the FPM we are
+	 * talking to has announced that it can resync.
+	 */
+	int resync_cfg;
+	int resync;
+
+	/*
+	 * Updates sent to an FPM that can resync carry sequence numbers
+	 * in an epoch of their own. Dests whose last update the FPM may
+	 * not have applied yet are kept on the log, in the order the
+	 * updates were sent. While 'log_ok' is set, the log (and the dest
+	 * queue) are kept up to date even when the connection is down.
+	 */
+	uint32_t epoch;
+	uint32_t seq;
+	TAILQ_HEAD(zfpm_dest_log, rib_dest_t_) log;
+	int log_ok;
+
+	/*
+	 * Thread to give up waiting for the FPM to tell us how far it
+	 * got.
+	 */
+	struct thread *t_sync;
+
 	/*
 	 * Threads for I/O.
 	 */
@@ -195,6 +246,52 @@ typedef struct zfpm_glob_t_ {
 	struct thread *t_write;
 	struct thread *t_read;
 
+	/*
+	 * Thread to build updates for the FPM from the dest queue.
+	 */
+	struct thread *t_build;
+
+	/*
+	 * Thread to take the connection down after the writer failed.
+	 */
+	struct thread *t_write_error;
+
+	/*
+	 * The writer, which writes out filled output buffers to the
+	 * socket on its own pthread, or on the main thread if that could
+	 * not be started.
+	 */
+	struct {
+		struct frr_pthread *pthread;
+		struct thread_master *master;
+
+		/*
+		 * Output buffers waiting to be written. Pushed to here,
+		 * popped by the writer.
+		 */
+		struct stream_fifo *queue;
+
+		pthread_mutex_t mtx;
+		/* signalled when the writer has stopped; Requires: mtx */
+		pthread_cond_t cond;
+		/* Requires: mtx */
+		bool stopped;
+		/* errno of a failed write; Requires: mtx */
+		int error;
+		/* write counters not yet added to 'stats'; Requires: mtx */
+		zfpm_stats_t stats;
+
+		/* true once we tried to start the pthread */
+		bool run;
+
+		/*
+		 * Owned by the writer.
+		 */
+		int sock;
+		struct stream *cur;
+		struct thread *t_write;
+	} w;
+
 	/*
 	 * Thread to clean up after the TCP connection to the FPM goes down
 	 * and the state that belongs to it.
@@ -254,6 +351,9 @@ static int zfpm_trigger_update(struct route_node *rn, const char *reason);
 
 static int zfpm_read_cb(struct thread *thread);
 static int zfpm_write_cb(struct thread *thread);
+static int zfpm_build_cb(struct thread *thread);
+static int zfpm_writer_cb(struct thread *thread);
+static int zfpm_write_error_cb(struct thread *thread);
 
 static void zfpm_set_state(zfpm_state_t state, const char *reason);
 static void zfpm_start_connect_timer(const char *reason);
@@ -428,6 +528,118 @@ static void zfpm_stats_compose(const zfpm_stats_t *s1, const zfpm_stats_t *s2,
 	}
 }
 
+/*
+ * zfpm_stats_collect
+ *
+ * Pick up the counters that the writer has updated since the last
+ * call.
+ */
+static void zfpm_stats_collect(void)
+{
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		zfpm_stats_compose(&zfpm_g->stats, &zfpm_g->w.stats,
+				   &zfpm_g->stats);
+		zfpm_stats_reset(&zfpm_g->w.stats);
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+}
+
+/*
+ * zfpm_seq_after
+ *
+ * Returns TRUE if sequence number 'a' is more recent than 'b'.
+ */
+static inline int zfpm_seq_after(uint32_t a, uint32_t b)
+{
+	return (int32_t)(a - b) > 0;
+}
+
+/*
+ * zfpm_log_add
+ *
+ * Give the dest the next sequence number, and put it at the end of
+ * the log.
+ */
+static void zfpm_log_add(rib_dest_t *dest)
+{
+	if (CHECK_FLAG(dest->flags, RIB_DEST_LOGGED_FPM))
+		TAILQ_REMOVE(&zfpm_g->log, dest, fpm_log_entries);
+
+	/*
+	 * 0 means 'no sequence number'.
+	 */
+	if (++zfpm_g->seq == 0)
+		zfpm_g->seq = 1;
+
+	dest->fpm_seq = zfpm_g->seq;
+	SET_FLAG(dest->flags, RIB_DEST_LOGGED_FPM);
+	TAILQ_INSERT_TAIL(&zfpm_g->log, dest, fpm_log_entries);
+}
+
+/*
+ * zfpm_log_del
+ *
+ * Take the dest off the log, and delete it if it isn't needed anymore.
+ */
+static void zfpm_log_del(rib_dest_t *dest)
+{
+	TAILQ_REMOVE(&zfpm_g->log, dest, fpm_log_entries);
+	UNSET_FLAG(dest->flags, RIB_DEST_LOGGED_FPM);
+
+	rib_gc_dest(dest->rnode);
+}
+
+/*
+ * zfpm_log_ack
+ *
+ * The FPM has applied all updates up to and including 'seq'.
+ */
+static void zfpm_log_ack(uint32_t seq)
+{
+	rib_dest_t *dest;
+
+	while ((dest = TAILQ_FIRST(&zfpm_g->log))) {
+		if (zfpm_seq_after(dest->fpm_seq, seq))
+			break;
+
+		zfpm_log_del(dest);
+		zfpm_g->stats.log_acked++;
+	}
+}
+
+/*
+ * zfpm_log_clear
+ */
+static void zfpm_log_clear(void)
+{
+	rib_dest_t *dest;
+
+	while ((dest = TAILQ_FIRST(&zfpm_g->log)))
+		zfpm_log_del(dest);
+}
+
+/*
+ * zfpm_log_replay
+ *
+ * Queue up everything on the log that the FPM didn't get to apply.
+ */
+static void zfpm_log_replay(void)
+{
+	rib_dest_t *dest;
+
+	TAILQ_FOREACH (dest, &zfpm_g->log, fpm_log_entries) {
+
+		/*
+		 * The FPM may or may not have the route, make sure a
+		 * deletion does get sent.
+		 */
+		SET_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM);
+		zfpm_trigger_update(dest->rnode, NULL);
+		zfpm_g->stats.log_replayed++;
+	}
+}
+
 /*
  * zfpm_read_on
  */
@@ -452,6 +664,15 @@ static inline void zfpm_write_on(void)
 			 &zfpm_g->t_write);
 }
 
+/*
+ * zfpm_build_on
+ */
+static inline void zfpm_build_on(void)
+{
+	thread_add_event(zfpm_g->master, zfpm_build_cb, NULL, 0,
+			 &zfpm_g->t_build);
+}
+
 /*
  * zfpm_read_off
  */
@@ -468,6 +689,249 @@ static inline void zfpm_write_off(void)
 	THREAD_WRITE_OFF(zfpm_g->t_write);
 }
 
+/*
+ * zfpm_writer_cb
+ *
+ * Write out queued output buffers to the FPM. Runs on the writer's
+ * thread_master.
+ */
+static int zfpm_writer_cb(struct thread *thread)
+{
+	zfpm_stats_t stats;
+	struct stream *s;
+	ssize_t nbyte;
+	int num_writes, written, error;
+
+	/*
+	 * Nothing to do if we're stopped, or still waiting for the socket
+	 * to become writable again.
+	 */
+	if (zfpm_g->w.sock < 0 || zfpm_g->w.t_write)
+		return 0;
+
+	zfpm_stats_init(&stats);
+	stats.write_cb_calls++;
+
+	num_writes = 0;
+	written = 0;
+	error = 0;
+
+	do {
+		s = zfpm_g->w.cur;
+		if (!s) {
+			s = stream_fifo_pop(zfpm_g->w.queue);
+			if (!s)
+				break;
+			zfpm_g->w.cur = s;
+		}
+
+		nbyte = write(zfpm_g->w.sock, stream_pnt(s),
+			      STREAM_READABLE(s));
+		stats.write_calls++;
+		num_writes++;
+
+		if (nbyte < 0) {
+			if (ERRNO_IO_RETRY(errno)) {
+				thread_add_write(zfpm_g->w.master,
+						 zfpm_writer_cb, NULL,
+						 zfpm_g->w.sock,
+						 &zfpm_g->w.t_write);
+				break;
+			}
+
+			/*
+			 * Leave the socket alone until the main thread has
+			 * taken the connection down.
+			 */
+			error = errno;
+			zfpm_g->w.sock = -1;
+			break;
+		}
+
+		stream_forward_getp(s, nbyte);
+		if (STREAM_READABLE(s)) {
+
+			/*
+			 * Partial write.
+			 */
+			stats.partial_writes++;
+			thread_add_write(zfpm_g->w.master, zfpm_writer_cb, NULL,
+					 zfpm_g->w.sock, &zfpm_g->w.t_write);
+			break;
+		}
+
+		stream_free(s);
+		zfpm_g->w.cur = NULL;
+		written++;
+
+		if (num_writes >= ZFPM_MAX_WRITES_PER_RUN) {
+			stats.max_writes_hit++;
+			thread_post_event(zfpm_g->w.master, zfpm_writer_cb,
+					  NULL, 0);
+			break;
+		}
+	} while (1);
+
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		zfpm_stats_compose(&zfpm_g->w.stats, &stats, &zfpm_g->w.stats);
+		if (error)
+			zfpm_g->w.error = error;
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+
+	if (error)
+		thread_add_event(zfpm_g->master, zfpm_write_error_cb, NULL, 0,
+				 &zfpm_g->t_write_error);
+	else if (written)
+		zfpm_build_on();
+
+	return 0;
+}
+
+/*
+ * zfpm_writer_release
+ *
+ * Make the writer let go of the socket, and drop everything it has not
+ * written yet. Runs on the writer's thread_master.
+ */
+static int zfpm_writer_release(struct thread *thread)
+{
+	THREAD_WRITE_OFF(zfpm_g->w.t_write);
+	zfpm_g->w.sock = -1;
+
+	if (zfpm_g->w.cur) {
+		stream_free(zfpm_g->w.cur);
+		zfpm_g->w.cur = NULL;
+	}
+	stream_fifo_clean(zfpm_g->w.queue);
+
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		zfpm_g->w.stopped = true;
+		pthread_cond_broadcast(&zfpm_g->w.cond);
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+	return 0;
+}
+
+/*
+ * zfpm_writer_init
+ */
+static void zfpm_writer_init(void)
+{
+	pthread_mutex_init(&zfpm_g->w.mtx, NULL);
+	pthread_cond_init(&zfpm_g->w.cond, NULL);
+	zfpm_g->w.queue = stream_fifo_new_mpsc();
+	zfpm_g->w.sock = -1;
+	zfpm_g->w.stopped = true;
+	zfpm_g->w.master = zfpm_g->master;
+}
+
+/*
+ * zfpm_writer_run
+ *
+ * Start the writer's pthread. This can't be done when the module is
+ * initialized, as zebra may still fork into the background after.
+ */
+static void zfpm_writer_run(void)
+{
+	struct frr_pthread *pthread;
+
+	pthread = frr_pthread_new(NULL, "Zebra FPM writer");
+	if (!pthread || frr_pthread_run(pthread, NULL)) {
+		zlog_err("Can't start FPM writer pthread, FPM updates will be written inline");
+		return;
+	}
+	frr_pthread_wait_running(pthread);
+
+	zfpm_g->w.pthread = pthread;
+	zfpm_g->w.master = pthread->master;
+}
+
+/*
+ * zfpm_writer_acquire
+ *
+ * Hand the writer the socket to write to. Runs on the writer's
+ * thread_master.
+ */
+static int zfpm_writer_acquire(struct thread *thread)
+{
+	bool stopped;
+
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		stopped = zfpm_g->w.stopped;
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+
+	if (!stopped)
+		zfpm_g->w.sock = THREAD_VAL(thread);
+	return 0;
+}
+
+/*
+ * zfpm_writer_start
+ *
+ * Let the writer write to the given socket.
+ */
+static void zfpm_writer_start(int sock)
+{
+	if (!zfpm_g->w.run) {
+		zfpm_g->w.run = true;
+		zfpm_writer_run();
+	}
+
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		assert(zfpm_g->w.stopped);
+		zfpm_g->w.error = 0;
+		zfpm_g->w.stopped = false;
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+
+	thread_post_event(zfpm_g->w.master, zfpm_writer_acquire, NULL, sock);
+}
+
+/*
+ * zfpm_writer_stop
+ *
+ * Stop the writer, and wait for it to be done with the socket.
+ */
+static void zfpm_writer_stop(void)
+{
+	if (!zfpm_g->w.pthread) {
+		zfpm_writer_release(NULL);
+		return;
+	}
+
+	thread_post_event(zfpm_g->w.master, zfpm_writer_release, NULL, 0);
+
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		while (!zfpm_g->w.stopped)
+			pthread_cond_wait(&zfpm_g->w.cond, &zfpm_g->w.mtx);
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+}
+
+/*
+ * zfpm_obuf_flush
+ *
+ * Hand the output buffer to the writer, if there is anything in it.
+ */
+static void zfpm_obuf_flush(void)
+{
+	if (stream_empty(zfpm_g->obuf))
+		return;
+
+	stream_fifo_push(zfpm_g->w.queue, zfpm_g->obuf);
+	zfpm_g->obuf = stream_new(ZFPM_OBUF_SIZE);
+	zfpm_g->stats.obufs_queued++;
+
+	thread_post_event(zfpm_g->w.master, zfpm_writer_cb, NULL, 0);
+}
+
 /*
  * zfpm_conn_up_thread_cb
  *
@@ -515,23 +979,22 @@ static int zfpm_conn_up_thread_cb(struct thread *thread)
 
 	zfpm_g->stats.t_conn_up_finishes++;
 
+	/*
+	 * Everything is either on the log or queued up now.
+	 */
+	if (zfpm_g->resync)
+		zfpm_g->log_ok = 1;
+
 done:
 	zfpm_rnodes_iter_cleanup(iter);
 	return 0;
 }
 
 /*
- * zfpm_connection_up
- *
- * Called when the connection to the FPM comes up.
+ * zfpm_conn_up_start
  */
-static void zfpm_connection_up(const char *detail)
+static void zfpm_conn_up_start(void)
 {
-	assert(zfpm_g->sock >= 0);
-	zfpm_read_on();
-	zfpm_write_on();
-	zfpm_set_state(ZFPM_STATE_ESTABLISHED, detail);
-
 	/*
 	 * Start thread to push existing routes to the FPM.
 	 */
@@ -546,6 +1009,118 @@ static void zfpm_connection_up(const char *detail)
 	zfpm_g->stats.t_conn_up_starts++;
 }
 
+/*
+ * zfpm_send_sync
+ *
+ * Tell the FPM what the sequence numbers of the routes that follow
+ * mean.
+ */
+static void zfpm_send_sync(int full)
+{
+#ifdef HAVE_PROTOBUF
+	struct stream *s = zfpm_g->obuf;
+	fpm_msg_hdr_t *hdr;
+	size_t data_len;
+
+	assert(stream_empty(s));
+
+	hdr = (fpm_msg_hdr_t *)STREAM_DATA(s);
+	hdr->version = FPM_PROTO_VERSION;
+	hdr->msg_type = FPM_MSG_TYPE_PROTOBUF;
+
+	data_len = zfpm_protobuf_encode_sync(zfpm_g->epoch, full,
+					     fpm_msg_data(hdr),
+					     FPM_MAX_MSG_LEN - FPM_MSG_HDR_LEN);
+	assert(data_len);
+
+	hdr->msg_len = htons(fpm_data_len_to_msg_len(data_len));
+	stream_forward_endp(s, fpm_data_len_to_msg_len(data_len));
+	zfpm_obuf_flush();
+#endif
+}
+
+/*
+ * zfpm_sync
+ *
+ * Start sending routes to the FPM, based on what it has announced
+ * about itself, if anything.
+ */
+static void zfpm_sync(const struct zfpm_caps *caps)
+{
+	int full;
+
+	zfpm_g->resync = caps && caps->resync;
+
+	full = !zfpm_g->resync || !zfpm_g->log_ok || !caps->applied
+	       || caps->epoch != zfpm_g->epoch;
+
+	zfpm_debug("Starting %s sync%s", full ? "full" : "incremental",
+		   zfpm_g->resync ? " with sequence numbers" : "");
+
+	if (zfpm_g->resync)
+		zfpm_send_sync(full);
+
+	if (full) {
+		zfpm_g->stats.full_syncs++;
+
+		/*
+		 * The log can only be trusted again once the FPM has got
+		 * everything.
+		 */
+		zfpm_g->log_ok = 0;
+		zfpm_log_clear();
+		zfpm_conn_up_start();
+	} else {
+		zfpm_g->stats.incremental_syncs++;
+		zfpm_log_ack(caps->applied_seq);
+		zfpm_log_replay();
+	}
+
+	/*
+	 * There may be updates queued from while the connection was down.
+	 */
+	zfpm_build_on();
+}
+
+/*
+ * zfpm_sync_timer_cb
+ */
+static int zfpm_sync_timer_cb(struct thread *thread)
+{
+	zfpm_g->t_sync = NULL;
+
+	zfpm_debug("FPM did not announce whether it can resync");
+	zfpm_sync(NULL);
+	return 0;
+}
+
+/*
+ * zfpm_connection_up
+ *
+ * Called when the connection to the FPM comes up.
+ */
+static void zfpm_connection_up(const char *detail)
+{
+	assert(zfpm_g->sock >= 0);
+	zfpm_read_on();
+	zfpm_writer_start(zfpm_g->sock);
+	zfpm_set_state(ZFPM_STATE_ESTABLISHED, detail);
+
+	zfpm_g->resync = 0;
+
+	if (!zfpm_g->resync_cfg) {
+		zfpm_sync(NULL);
+		return;
+	}
+
+	/*
+	 * Wait for the FPM to tell us how far it got, holding back any
+	 * updates until it has.
+	 */
+	thread_add_timer(zfpm_g->master, zfpm_sync_timer_cb, NULL,
+			 ZFPM_SYNC_WAIT_SECS, &zfpm_g->t_sync);
+}
+
 /*
  * zfpm_connect_check
  *
@@ -657,15 +1232,36 @@ static void zfpm_connection_down(const char *detail)
 
 	zfpm_read_off();
 	zfpm_write_off();
+	THREAD_OFF(zfpm_g->t_build);
+	THREAD_OFF(zfpm_g->t_sync);
+
+	/*
+	 * The writer may have run into trouble itself in the meantime.
+	 */
+	zfpm_writer_stop();
+	THREAD_OFF(zfpm_g->t_write_error);
 
 	stream_reset(zfpm_g->ibuf);
 	stream_reset(zfpm_g->obuf);
+	zfpm_g->batch = 0;
 
 	if (zfpm_g->sock >= 0) {
 		close(zfpm_g->sock);
 		zfpm_g->sock = -1;
 	}
 
+	/*
+	 * Keep everything as it is if the FPM can catch up from where it
+	 * left off, and keep track of what changes in the meantime.
+	 */
+	if (zfpm_g->log_ok) {
+		zfpm_set_state(ZFPM_STATE_IDLE, detail);
+		zfpm_start_connect_timer("keeping state to resync");
+		return;
+	}
+
+	zfpm_log_clear();
+
 	/*
 	 * Start thread to clean up state after the connection goes down.
 	 */
@@ -680,6 +1276,31 @@ static void zfpm_connection_down(const char *detail)
 	zfpm_set_state(ZFPM_STATE_IDLE, detail);
 }
 
+/*
+ * zfpm_write_error_cb
+ *
+ * Called when the writer failed to write to the socket.
+ */
+static int zfpm_write_error_cb(struct thread *thread)
+{
+	char buffer[1024];
+	int error;
+
+	if (zfpm_g->state != ZFPM_STATE_ESTABLISHED)
+		return 0;
+
+	pthread_mutex_lock(&zfpm_g->w.mtx);
+	{
+		error = zfpm_g->w.error;
+	}
+	pthread_mutex_unlock(&zfpm_g->w.mtx);
+
+	snprintf(buffer, sizeof(buffer), "failed to write to socket(%d): %s",
+		 error, safe_strerror(error));
+	zfpm_connection_down(buffer);
+	return 0;
+}
+
 /*
  * zfpm_read_cb
  */
@@ -767,37 +1388,39 @@ static int zfpm_read_cb(struct thread *thread)
 
 	zfpm_debug("Read out a full fpm message");
 
+#ifdef HAVE_PROTOBUF
 	/*
-	 * Just throw it away for now.
-	 */
-	stream_reset(ibuf);
-
-done:
-	zfpm_read_on();
-	return 0;
-}
-
-/*
- * zfpm_writes_pending
- *
- * Returns TRUE if we may have something to write to the FPM.
- */
-static int zfpm_writes_pending(void)
-{
-
-	/*
-	 * Check if there is any data in the outbound buffer that has not
-	 * been written to the socket yet.
+	 * The only message we care about is the one that tells us what
+	 * the FPM supports, irrespective of the format used for routes.
 	 */
-	if (stream_get_endp(zfpm_g->obuf) - stream_get_getp(zfpm_g->obuf))
-		return 1;
+	if (hdr->msg_type == FPM_MSG_TYPE_PROTOBUF) {
+		struct zfpm_caps caps;
+
+		if (zfpm_protobuf_decode_capabilities(fpm_msg_data(hdr),
+						      fpm_msg_data_len(hdr),
+						      &caps)) {
+			zfpm_debug("FPM %s route batches, %s resync",
+				   caps.batch ? "takes" : "does not take",
+				   caps.resync ? "can" : "cannot");
+			zfpm_g->batch = caps.batch;
+
+			if (zfpm_g->t_sync) {
+				THREAD_OFF(zfpm_g->t_sync);
+				zfpm_sync(&caps);
+			} else if (zfpm_g->resync && caps.applied
+				   && caps.epoch == zfpm_g->epoch)
+				zfpm_log_ack(caps.applied_seq);
+		}
+	}
+#endif
 
 	/*
-	 * Check if there are any prefixes on the outbound queue.
+	 * Throw everything else away for now.
 	 */
-	if (!TAILQ_EMPTY(&zfpm_g->dest_q))
-		return 1;
+	stream_reset(ibuf);
 
+done:
+	zfpm_read_on();
 	return 0;
 }
 
@@ -805,12 +1428,14 @@ static int zfpm_writes_pending(void)
  * zfpm_encode_route
  *
  * Encode a message to the FPM with information about the given route.
+ * If 'batch' is set, it is encoded to be added to a message started by
+ * zfpm_batch_open().
  *
  * Returns the number of bytes written to the buffer. 0 or a negative
  * value indicates an error.
  */
 static inline int zfpm_encode_route(rib_dest_t *dest, struct route_entry *re,
-				    char *in_buf, size_t in_buf_len,
+				    char *in_buf, size_t in_buf_len, int batch,
 				    fpm_msg_type_e *msg_type)
 {
 	size_t len;
@@ -825,8 +1450,12 @@ static inline int zfpm_encode_route(rib_dest_t *dest, struct route_entry *re,
 
 	case ZFPM_MSG_FORMAT_PROTOBUF:
 #ifdef HAVE_PROTOBUF
-		len = zfpm_protobuf_encode_route(dest, re, (uint8_t *)in_buf,
-						 in_buf_len);
+		if (batch)
+			len = zfpm_protobuf_encode_batch_route(
+				dest, re, (uint8_t *)in_buf, in_buf_len);
+		else
+			len = zfpm_protobuf_encode_route(
+				dest, re, (uint8_t *)in_buf, in_buf_len);
 		*msg_type = FPM_MSG_TYPE_PROTOBUF;
 #endif
 		break;
@@ -859,11 +1488,55 @@ struct route_entry *zfpm_route_for_update(rib_dest_t *dest)
 	return dest->selected_fib;
 }
 
+/*
+ * zfpm_batch_open
+ *
+ * Start a message at the end of the given stream that a number of
+ * routes can be added to.
+ *
+ * Returns the header of the message.
+ */
+static fpm_msg_hdr_t *zfpm_batch_open(struct stream *s)
+{
+	fpm_msg_hdr_t *hdr;
+	size_t data_len;
+
+	hdr = (fpm_msg_hdr_t *)(STREAM_DATA(s) + stream_get_endp(s));
+	hdr->version = FPM_PROTO_VERSION;
+	hdr->msg_type = FPM_MSG_TYPE_NONE;
+
+	data_len = 0;
+
+	switch (zfpm_g->message_format) {
+
+	case ZFPM_MSG_FORMAT_PROTOBUF:
+#ifdef HAVE_PROTOBUF
+		data_len = zfpm_protobuf_encode_batch(
+			fpm_msg_data(hdr),
+			STREAM_WRITEABLE(s) - FPM_MSG_HDR_LEN);
+		hdr->msg_type = FPM_MSG_TYPE_PROTOBUF;
+#endif
+		break;
+
+	case ZFPM_MSG_FORMAT_NETLINK:
+		hdr->msg_type = FPM_MSG_TYPE_NETLINK;
+		break;
+
+	default:
+		break;
+	}
+
+	hdr->msg_len = htons(fpm_data_len_to_msg_len(data_len));
+	stream_forward_endp(s, fpm_data_len_to_msg_len(data_len));
+	return hdr;
+}
+
 /*
  * zfpm_build_updates
  *
  * Process the outgoing queue and write messages to the outbound
- * buffer.
+ * buffer. If the FPM takes route batches, as many routes as fit are
+ * packed into each message.
  */
 static void zfpm_build_updates(void)
 {
@@ -872,12 +1545,13 @@ static void zfpm_build_updates(void)
 	unsigned char *buf, *data, *buf_end;
 	size_t msg_len;
 	size_t data_len;
-	fpm_msg_hdr_t *hdr;
+	fpm_msg_hdr_t *hdr, *batch;
 	struct route_entry *re;
 	int is_add, write_msg;
 	fpm_msg_type_e msg_type;
 
 	s = zfpm_g->obuf;
+	batch = NULL;
 
 	assert(stream_empty(s));
 
@@ -886,27 +1560,20 @@ static void zfpm_build_updates(void)
 		/*
 		 * Make sure there is enough space to write another message.
 		 */
-		if (STREAM_WRITEABLE(s) < FPM_MAX_MSG_LEN)
+		if (STREAM_WRITEABLE(s) < 2 * FPM_MAX_MSG_LEN)
 			break;
 
-		buf = STREAM_DATA(s) + stream_get_endp(s);
-		buf_end = buf + STREAM_WRITEABLE(s);
-
 		dest = TAILQ_FIRST(&zfpm_g->dest_q);
 		if (!dest)
 			break;
 
 		assert(CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM));
 
-		hdr = (fpm_msg_hdr_t *)buf;
-		hdr->version = FPM_PROTO_VERSION;
-
-		data = fpm_msg_data(hdr);
-
 		re = zfpm_route_for_update(dest);
 		is_add = re ? 1 : 0;
 
 		write_msg = 1;
+		data_len = 0;
 
 		/*
 		 * If this is a route deletion, and we have not sent the route
@@ -919,8 +1586,44 @@ static void zfpm_build_updates(void)
 		}
 
 		if (write_msg) {
+			if (zfpm_g->resync)
+				zfpm_log_add(dest);
+			else
+				dest->fpm_seq = 0;
+		}
+
+		if (write_msg && zfpm_g->batch) {
+			if (batch
+			    && fpm_msg_len(batch) + FPM_MAX_MSG_LEN
+				       > FPM_MAX_BATCH_MSG_LEN)
+				batch = NULL;
+
+			if (!batch)
+				batch = zfpm_batch_open(s);
+
+			data = STREAM_DATA(s) + stream_get_endp(s);
+			data_len = zfpm_encode_route(dest, re, (char *)data,
+						     STREAM_WRITEABLE(s), 1,
+						     &msg_type);
+
+			assert(data_len);
+			if (data_len) {
+				stream_forward_endp(s, data_len);
+				msg_len = fpm_msg_len(batch) + data_len;
+				batch->msg_len = htons(msg_len);
+			}
+		} else if (write_msg) {
+			buf = STREAM_DATA(s) + stream_get_endp(s);
+			buf_end = buf + STREAM_WRITEABLE(s);
+
+			hdr = (fpm_msg_hdr_t *)buf;
+			hdr->version = FPM_PROTO_VERSION;
+
+			data = fpm_msg_data(hdr);
+
 			data_len = zfpm_encode_route(dest, re, (char *)data,
-						     buf_end - data, &msg_type);
+						     buf_end - data, 0,
+						     &msg_type);
 
 			assert(data_len);
 			if (data_len) {
@@ -928,12 +1631,20 @@ static void zfpm_build_updates(void)
 				msg_len = fpm_data_len_to_msg_len(data_len);
 				hdr->msg_len = htons(msg_len);
 				stream_forward_endp(s, msg_len);
-
-				if (is_add)
-					zfpm_g->stats.route_adds++;
-				else
-					zfpm_g->stats.route_dels++;
 			}
+
+			/*
+			 * Don't add any later routes to a batch ahead of
+			 * this one.
+			 */
+			batch = NULL;
+		}
+
+		if (write_msg && data_len) {
+			if (is_add)
+				zfpm_g->stats.route_adds++;
+			else
+				zfpm_g->stats.route_dels++;
 		}
 
 		/*
@@ -959,86 +1670,54 @@ static void zfpm_build_updates(void)
 
 /*
  * zfpm_write_cb
+ *
+ * We only wait for the socket to become writable while an
+ * asynchronous connect() is in progress; the writer takes care of
+ * writing to it after that.
  */
 static int zfpm_write_cb(struct thread *thread)
 {
-	struct stream *s;
-	int num_writes;
-
-	zfpm_g->stats.write_cb_calls++;
 	zfpm_g->t_write = NULL;
 
-	/*
-	 * Check if async connect is now done.
-	 */
-	if (zfpm_g->state == ZFPM_STATE_CONNECTING) {
-		zfpm_connect_check();
-		return 0;
-	}
-
-	assert(zfpm_g->state == ZFPM_STATE_ESTABLISHED);
-	assert(zfpm_g->sock >= 0);
+	assert(zfpm_g->state == ZFPM_STATE_CONNECTING);
+	zfpm_connect_check();
+	return 0;
+}
 
-	num_writes = 0;
+/*
+ * zfpm_build_cb
+ *
+ * Build updates for the FPM into output buffers and hand them to the
+ * writer, for as long as it keeps up.
+ */
+static int zfpm_build_cb(struct thread *thread)
+{
+	if (zfpm_g->state != ZFPM_STATE_ESTABLISHED || zfpm_g->t_sync)
+		return 0;
 
 	do {
-		int bytes_to_write, bytes_written;
-
-		s = zfpm_g->obuf;
-
 		/*
-		 * If the stream is empty, try fill it up with data.
+		 * The writer kicks us again once it has written out a
+		 * buffer.
 		 */
-		if (stream_empty(s)) {
-			zfpm_build_updates();
-		}
-
-		bytes_to_write = stream_get_endp(s) - stream_get_getp(s);
-		if (!bytes_to_write)
+		if (stream_fifo_count(zfpm_g->w.queue) >= ZFPM_MAX_OBUFS) {
+			zfpm_g->stats.obuf_limit_hits++;
 			break;
-
-		bytes_written =
-			write(zfpm_g->sock, stream_pnt(s), bytes_to_write);
-		zfpm_g->stats.write_calls++;
-		num_writes++;
-
-		if (bytes_written < 0) {
-			if (ERRNO_IO_RETRY(errno))
-				break;
-
-			zfpm_connection_down("failed to write to socket");
-			return 0;
 		}
 
-		if (bytes_written != bytes_to_write) {
+		zfpm_build_updates();
+		zfpm_obuf_flush();
 
-			/*
-			 * Partial write.
-			 */
-			stream_forward_getp(s, bytes_written);
-			zfpm_g->stats.partial_writes++;
+		if (TAILQ_EMPTY(&zfpm_g->dest_q))
 			break;
-		}
-
-		/*
-		 * We've written out the entire contents of the stream.
-		 */
-		stream_reset(s);
-
-		if (num_writes >= ZFPM_MAX_WRITES_PER_RUN) {
-			zfpm_g->stats.max_writes_hit++;
-			break;
-		}
 
 		if (zfpm_thread_should_yield(thread)) {
 			zfpm_g->stats.t_write_yields++;
+			zfpm_build_on();
 			break;
 		}
 	} while (1);
 
-	if (zfpm_writes_pending())
-		zfpm_write_on();
-
 	return 0;
 }
 
@@ -1151,7 +1830,6 @@ static void zfpm_set_state(zfpm_state_t state, const char *reason)
 		       || cur_state == ZFPM_STATE_CONNECTING);
 		assert(zfpm_g->sock);
 		assert(zfpm_g->t_read);
-		assert(zfpm_g->t_write);
 		break;
 	}
 
@@ -1243,10 +1921,11 @@ static int zfpm_trigger_update(struct route_node *rn, const char *reason)
 	char buf[PREFIX_STRLEN];
 
 	/*
-	 * Ignore if the connection is down. We will update the FPM about
-	 * all destinations once the connection comes up.
+	 * Ignore if the connection is down, unless we're keeping track of
+	 * changes for the FPM to resync. Otherwise we will update the FPM
+	 * about all destinations once the connection comes up.
 	 */
-	if (!zfpm_conn_is_up())
+	if (!zfpm_conn_is_up() && !zfpm_g->log_ok)
 		return 0;
 
 	dest = rib_dest_from_rnode(rn);
@@ -1266,12 +1945,10 @@ static int zfpm_trigger_update(struct route_node *rn, const char *reason)
 	zfpm_g->stats.updates_triggered++;
 
 	/*
-	 * Make sure that writes are enabled.
+	 * Make sure that updates get built.
 	 */
-	if (zfpm_g->t_write)
-		return 0;
-
-	zfpm_write_on();
+	if (zfpm_conn_is_up())
+		zfpm_build_on();
 	return 0;
 }
 
@@ -1282,6 +1959,8 @@ static int zfpm_stats_timer_cb(struct thread *t)
 {
 	zfpm_g->t_stats = NULL;
 
+	zfpm_stats_collect();
+
 	/*
 	 * Remember the stats collected in the last interval for display
 	 * purposes.
@@ -1350,6 +2029,7 @@ static void zfpm_show_stats(struct vty *vty)
 	/*
 	 * Compute the total stats up to this instant.
 	 */
+	zfpm_stats_collect();
 	zfpm_stats_compose(&zfpm_g->cumulative_stats, &zfpm_g->stats,
 			   &total_stats);
 
@@ -1361,6 +2041,12 @@ static void zfpm_show_stats(struct vty *vty)
 	ZFPM_SHOW_STAT(partial_writes);
 	ZFPM_SHOW_STAT(max_writes_hit);
 	ZFPM_SHOW_STAT(t_write_yields);
+	ZFPM_SHOW_STAT(obufs_queued);
+	ZFPM_SHOW_STAT(obuf_limit_hits);
+	ZFPM_SHOW_STAT(full_syncs);
+	ZFPM_SHOW_STAT(incremental_syncs);
+	ZFPM_SHOW_STAT(log_acked);
+	ZFPM_SHOW_STAT(log_replayed);
 	ZFPM_SHOW_STAT(nop_deletes_skipped);
 	ZFPM_SHOW_STAT(route_adds);
 	ZFPM_SHOW_STAT(route_dels);
@@ -1396,6 +2082,7 @@ static void zfpm_clear_stats(struct vty *vty)
 		return;
 	}
 
+	zfpm_stats_collect();
 	zfpm_stats_reset(&zfpm_g->stats);
 	zfpm_stats_reset(&zfpm_g->last_ivl_stats);
 	zfpm_stats_reset(&zfpm_g->cumulative_stats);
@@ -1485,6 +2172,27 @@ DEFUN ( no_fpm_remote_ip,
 	return CMD_SUCCESS;
 }
 
+/*
+ * Let an FPM that can resync pick up where it left off after the
+ * connection went down. Takes effect on the next connection.
+ */
+DEFUN (fpm_resync,
+       fpm_resync_cmd,
+       "[no] fpm resync",
+       NO_STR
+       "Forwarding Path Manager configuration\n"
+       "Only resend what the FPM missed when it reconnects\n")
+{
+#ifndef HAVE_PROTOBUF
+	if (!strmatch(argv[0]->text, "no")) {
+		vty_out(vty, "FPM resync requires protobuf support\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+#endif
+	zfpm_g->resync_cfg = !strmatch(argv[0]->text, "no");
+	return CMD_SUCCESS;
+}
+
 /*
  * zfpm_init_message_format
  */
@@ -1557,6 +2265,9 @@ static int fpm_remote_srv_write(struct vty *vty)
 		vty_out(vty, "fpm connection ip %s port %d\n", inet_ntoa(in),
 			zfpm_g->fpm_port);
 
+	if (zfpm_g->resync_cfg)
+		vty_out(vty, "fpm resync\n");
+
 	return 0;
 }
 
@@ -1565,6 +2276,21 @@ static int fpm_remote_srv_write(struct vty *vty)
 static struct cmd_node zebra_node = {ZEBRA_NODE, "", 1};
 
 
+/*
+ * zfpm_finish
+ */
+static int zfpm_finish(void)
+{
+	struct frr_pthread *pthread = zfpm_g->w.pthread;
+
+	if (!pthread)
+		return 0;
+
+	zfpm_g->w.pthread = NULL;
+	frr_pthread_stop(pthread, NULL);
+	return 0;
+}
+
 /**
  * zfpm_init
  *
@@ -1585,6 +2311,8 @@ static int zfpm_init(struct thread_master *master)
 	memset(zfpm_g, 0, sizeof(*zfpm_g));
 	zfpm_g->master = master;
 	TAILQ_INIT(&zfpm_g->dest_q);
+	TAILQ_INIT(&zfpm_g->log);
+	zfpm_g->epoch = time(NULL);
 	zfpm_g->sock = -1;
 	zfpm_g->state = ZFPM_STATE_IDLE;
 
@@ -1597,6 +2325,7 @@ static int zfpm_init(struct thread_master *master)
 	install_element(ENABLE_NODE, &clear_zebra_fpm_stats_cmd);
 	install_element(CONFIG_NODE, &fpm_remote_ip_cmd);
 	install_element(CONFIG_NODE, &no_fpm_remote_ip_cmd);
+	install_element(CONFIG_NODE, &fpm_resync_cmd);
 
 	zfpm_init_message_format(format);
 
@@ -1619,6 +2348,9 @@ static int zfpm_init(struct thread_master *master)
 	zfpm_g->obuf = stream_new(ZFPM_OBUF_SIZE);
 	zfpm_g->ibuf = stream_new(ZFPM_IBUF_SIZE);
 
+	zfpm_writer_init();
+	hook_register(frr_early_fini, zfpm_finish);
+
 	zfpm_start_stats_timer();
 	zfpm_start_connect_timer("initialized");
 	return 0;
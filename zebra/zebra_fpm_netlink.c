@@ -125,6 +125,7 @@ typedef struct netlink_nh_info_t_ {
  */
 typedef struct netlink_route_info_t_ {
 	uint16_t nlmsg_type;
+	uint32_t nlmsg_seq;
 	uint8_t rtm_type;
 	uint32_t rtm_table;
 	uint8_t rtm_protocol;
@@ -229,6 +230,7 @@ static int netlink_route_info_fill(netlink_route_info_t *ri, int cmd,
 	ri->af = rib_dest_af(dest);
 
 	ri->nlmsg_type = cmd;
+	ri->nlmsg_seq = dest->fpm_seq;
 	ri->rtm_table = zvrf_id(rib_dest_vrf(dest));
 	ri->rtm_protocol = RTPROT_UNSPEC;
 
@@ -325,6 +327,7 @@ static int netlink_route_info_encode(netlink_route_info_t *ri, char *in_buf,
 	req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
 	req->n.nlmsg_flags = NLM_F_CREATE | NLM_F_REQUEST;
 	req->n.nlmsg_type = ri->nlmsg_type;
+	req->n.nlmsg_seq = ri->nlmsg_seq;
 	req->r.rtm_family = ri->af;
 	req->r.rtm_table = ri->rtm_table;
 	req->r.rtm_dst_len = ri->prefix->prefixlen;
@@ -50,6 +50,22 @@ static inline void zfpm_debug(const char *format, ...)
 #endif
 
 
+/*
+ * What the FPM announced in a CAPABILITIES message.
+ */
+struct zfpm_caps {
+	int batch;
+	int resync;
+
+	/*
+	 * Set if epoch and applied_seq identify the last update the FPM
+	 * applied.
+	 */
+	int applied;
+	uint32_t epoch;
+	uint32_t applied_seq;
+};
+
 /*
  * Externs
  */
@@ -60,5 +76,17 @@ extern int zfpm_netlink_encode_route(int cmd, rib_dest_t *dest,
 extern int zfpm_protobuf_encode_route(rib_dest_t *dest, struct route_entry *re,
 				      uint8_t *in_buf, size_t in_buf_len);
 
+extern int zfpm_protobuf_encode_batch(uint8_t *in_buf, size_t in_buf_len);
+
+extern int zfpm_protobuf_encode_batch_route(rib_dest_t *dest,
+					    struct route_entry *re,
+					    uint8_t *in_buf, size_t in_buf_len);
+
+extern int zfpm_protobuf_encode_sync(uint32_t epoch, int full, uint8_t *in_buf,
+				     size_t in_buf_len);
+
+extern int zfpm_protobuf_decode_capabilities(const uint8_t *buf, size_t len,
+					     struct zfpm_caps *caps);
+
 extern struct route_entry *zfpm_route_for_update(rib_dest_t *dest);
 #endif /* _ZEBRA_FPM_PRIVATE_H */
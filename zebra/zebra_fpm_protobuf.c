@@ -36,6 +36,60 @@
 
 #include "zebra_fpm_private.h"
 
+/*
+ * Route messages are built in a long-lived arena, which is rewound
+ * rather than freed. Messages that carry a batch of routes are built
+ * one after another in the same arena, which is only rewound when a
+ * new message is started, or when what is left may not be enough for
+ * another route.
+ */
+#define ZFPM_PB_ARENA_SIZE (64 * 1024)
+
+/*
+ * The most arena space a single route can take.
+ */
+#define ZFPM_PB_ROUTE_ARENA_SIZE 4096
+
+static struct {
+	qpb_allocator_t allocator;
+	linear_allocator_t lin;
+	char buf[ZFPM_PB_ARENA_SIZE] __attribute__((aligned(8)));
+} zfpm_pb_arena;
+
+/*
+ * zfpm_pb_arena_reset
+ *
+ * Rewind the arena, and return an allocator for it.
+ */
+static qpb_allocator_t *zfpm_pb_arena_reset(void)
+{
+	if (!zfpm_pb_arena.lin.buf) {
+		linear_allocator_init(&zfpm_pb_arena.lin, zfpm_pb_arena.buf,
+				      sizeof(zfpm_pb_arena.buf));
+		qpb_allocator_init_linear(&zfpm_pb_arena.allocator,
+					  &zfpm_pb_arena.lin);
+	} else
+		linear_allocator_reset(&zfpm_pb_arena.lin);
+
+	return &zfpm_pb_arena.allocator;
+}
+
+/*
+ * zfpm_pb_arena_get
+ *
+ * Return an allocator for the arena that has at least 'size' bytes
+ * left, rewinding it if need be.
+ */
+static qpb_allocator_t *zfpm_pb_arena_get(size_t size)
+{
+	linear_allocator_t *lin = &zfpm_pb_arena.lin;
+
+	if (!lin->buf || (size_t)(lin->end - lin->cur) < size)
+		return zfpm_pb_arena_reset();
+
+	return &zfpm_pb_arena.allocator;
+}
+
 /*
  * create_delete_route_message
  */
@@ -66,6 +120,11 @@ static Fpm__DeleteRoute *create_delete_route_message(qpb_allocator_t *allocator,
 		return NULL;
 	}
 
+	if (dest->fpm_seq) {
+		msg->has_seq = 1;
+		msg->seq = dest->fpm_seq;
+	}
+
 	return msg;
 }
 
@@ -163,6 +222,11 @@ static Fpm__AddRoute *create_add_route_message(qpb_allocator_t *allocator,
 	msg->sub_address_family = QPB__SUB_ADDRESS_FAMILY__UNICAST;
 	msg->key = fpm_route_key_create(allocator, rib_dest_prefix(dest));
 	qpb_protocol_set(&msg->protocol, re->type);
+
+	if (dest->fpm_seq) {
+		msg->has_seq = 1;
+		msg->seq = dest->fpm_seq;
+	}
 	msg->has_route_type = 1;
 	msg->route_type = FPM__ROUTE_TYPE__NORMAL;
 	msg->metric = re->metric;
@@ -281,12 +345,9 @@ int zfpm_protobuf_encode_route(rib_dest_t *dest, struct route_entry *re,
 			       uint8_t *in_buf, size_t in_buf_len)
 {
 	Fpm__Message *msg;
-	QPB_DECLARE_STACK_ALLOCATOR(allocator, 4096);
 	size_t len;
 
-	QPB_INIT_STACK_ALLOCATOR(allocator);
-
-	msg = create_route_message(&allocator, dest, re);
+	msg = create_route_message(zfpm_pb_arena_reset(), dest, re);
 	if (!msg) {
 		assert(0);
 		return 0;
@@ -295,6 +356,153 @@ int zfpm_protobuf_encode_route(rib_dest_t *dest, struct route_entry *re,
 	len = fpm__message__pack(msg, (uint8_t *)in_buf);
 	assert(len <= in_buf_len);
 
-	QPB_RESET_STACK_ALLOCATOR(allocator);
 	return len;
 }
+
+/*
+ * zfpm_protobuf_put_varint
+ */
+static size_t zfpm_protobuf_put_varint(uint8_t *buf, uint32_t val)
+{
+	size_t len = 0;
+
+	while (val >= 0x80) {
+		buf[len++] = (val & 0x7f) | 0x80;
+		val >>= 7;
+	}
+	buf[len++] = val;
+	return len;
+}
+
+/*
+ * Keys of the fields of a ROUTES message that we write out by hand, so
+ * that routes can be appended to it one at a time.
+ */
+#define ZFPM_PB_KEY_TYPE ((1 << 3) | 0)   /* type, varint */
+#define ZFPM_PB_KEY_ROUTES ((4 << 3) | 2) /* routes, length-delimited */
+
+/*
+ * zfpm_protobuf_encode_batch
+ *
+ * Start a ROUTES message in the given buffer, to which routes are then
+ * added with zfpm_protobuf_encode_batch_route().
+ *
+ * Returns the number of bytes written to the buffer.
+ */
+int zfpm_protobuf_encode_batch(uint8_t *in_buf, size_t in_buf_len)
+{
+	size_t len;
+
+	assert(in_buf_len >= 2);
+
+	zfpm_pb_arena_reset();
+
+	in_buf[0] = ZFPM_PB_KEY_TYPE;
+	len = 1 + zfpm_protobuf_put_varint(in_buf + 1,
+					   FPM__MESSAGE__TYPE__ROUTES);
+	return len;
+}
+
+/*
+ * zfpm_protobuf_encode_batch_route
+ *
+ * Encode the given route as an element of the 'routes' field of a
+ * ROUTES message.
+ *
+ * Returns the number of bytes written to the buffer. 0 or a negative
+ * value indicates an error.
+ */
+int zfpm_protobuf_encode_batch_route(rib_dest_t *dest, struct route_entry *re,
+				     uint8_t *in_buf, size_t in_buf_len)
+{
+	Fpm__Message *msg;
+	size_t len, msg_len;
+
+	msg = create_route_message(zfpm_pb_arena_get(ZFPM_PB_ROUTE_ARENA_SIZE),
+				   dest, re);
+	if (!msg) {
+		assert(0);
+		return 0;
+	}
+
+	msg_len = fpm__message__get_packed_size(msg);
+
+	in_buf[0] = ZFPM_PB_KEY_ROUTES;
+	len = 1 + zfpm_protobuf_put_varint(in_buf + 1, msg_len);
+	assert(len + msg_len <= in_buf_len);
+
+	len += fpm__message__pack(msg, in_buf + len);
+
+	return len;
+}
+
+/*
+ * zfpm_protobuf_encode_sync
+ *
+ * Create a SYNC message in the given buffer space.
+ *
+ * Returns the number of bytes written to the buffer. 0 or a negative
+ * value indicates an error.
+ */
+int zfpm_protobuf_encode_sync(uint32_t epoch, int full, uint8_t *in_buf,
+			      size_t in_buf_len)
+{
+	Fpm__Message msg;
+	Fpm__Sync sync;
+	size_t len;
+
+	fpm__message__init(&msg);
+	fpm__sync__init(&sync);
+
+	sync.epoch = epoch;
+	sync.full = full;
+
+	msg.has_type = 1;
+	msg.type = FPM__MESSAGE__TYPE__SYNC;
+	msg.sync = &sync;
+
+	len = fpm__message__get_packed_size(&msg);
+	if (len > in_buf_len) {
+		assert(0);
+		return 0;
+	}
+
+	return fpm__message__pack(&msg, in_buf);
+}
+
+/*
+ * zfpm_protobuf_decode_capabilities
+ *
+ * Check if the given message from the FPM is a CAPABILITIES message,
+ * and if so return what it announces in 'caps'.
+ *
+ * Returns TRUE if it was a CAPABILITIES message.
+ */
+int zfpm_protobuf_decode_capabilities(const uint8_t *buf, size_t len,
+				      struct zfpm_caps *caps)
+{
+	Fpm__Message *msg;
+	Fpm__Capabilities *c;
+	QPB_DECLARE_STACK_ALLOCATOR(allocator, 4096);
+	int ret = 0;
+
+	QPB_INIT_STACK_ALLOCATOR(allocator);
+
+	msg = fpm__message__unpack(&allocator, len, buf);
+	if (msg && msg->has_type
+	    && msg->type == FPM__MESSAGE__TYPE__CAPABILITIES) {
+		memset(caps, 0, sizeof(*caps));
+		c = msg->capabilities;
+		if (c) {
+			caps->batch = c->has_route_batch && c->route_batch;
+			caps->resync = c->has_resync && c->resync;
+			caps->applied = c->has_epoch && c->has_applied_seq;
+			caps->epoch = c->epoch;
+			caps->applied_seq = c->applied_seq;
+		}
+		ret = 1;
+	}
+
+	QPB_RESET_STACK_ALLOCATOR(allocator);
+	return ret;
+}
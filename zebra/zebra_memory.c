@@ -32,5 +32,7 @@ DEFINE_MTYPE(ZEBRA, RE, "Route Entry")
 DEFINE_MTYPE(ZEBRA, RIB_QUEUE, "RIB process work queue")
 DEFINE_MTYPE(ZEBRA, STATIC_ROUTE, "Static route")
 DEFINE_MTYPE(ZEBRA, RIB_DEST, "RIB destination")
+DEFINE_MTYPE(ZEBRA, RIB_DEST_RE, "RIB destination with route")
 DEFINE_MTYPE(ZEBRA, RIB_TABLE_INFO, "RIB table info")
+DEFINE_MTYPE(ZEBRA, RIB_LOOKUP_CACHE, "RIB nexthop lookup cache")
 DEFINE_MTYPE(ZEBRA, RNH, "Nexthop tracking object")
@@ -32,7 +32,9 @@ DECLARE_MTYPE(RE)
 DECLARE_MTYPE(RIB_QUEUE)
 DECLARE_MTYPE(STATIC_ROUTE)
 DECLARE_MTYPE(RIB_DEST)
+DECLARE_MTYPE(RIB_DEST_RE)
 DECLARE_MTYPE(RIB_TABLE_INFO)
+DECLARE_MTYPE(RIB_LOOKUP_CACHE)
 DECLARE_MTYPE(RNH)
 
 #endif /* _QUAGGA_ZEBRA_MEMORY_H */
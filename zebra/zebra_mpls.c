@@ -44,6 +44,7 @@
 #include "zebra/zebra_memory.h"
 #include "zebra/zebra_vrf.h"
 #include "zebra/zebra_mpls.h"
+#include "zebra/zebra_nhg.h"
 
 DEFINE_MTYPE_STATIC(ZEBRA, LSP, "MPLS LSP object")
 DEFINE_MTYPE_STATIC(ZEBRA, FEC, "MPLS FEC object")
@@ -86,7 +87,6 @@ static int nhlfe_nexthop_active(zebra_nhlfe_t *nhlfe);
 
 static void lsp_select_best_nhlfe(zebra_lsp_t *lsp);
 static void lsp_uninstall_from_kernel(struct hash_backet *backet, void *ctxt);
-static void lsp_schedule(struct hash_backet *backet, void *ctxt);
 static wq_item_status lsp_process(struct work_queue *wq, void *data);
 static void lsp_processq_del(struct work_queue *wq, void *data);
 static void lsp_processq_complete(struct work_queue *wq);
@@ -244,7 +244,8 @@ static int lsp_install(struct zebra_vrf *zvrf, mpls_label_t label,
 		if (lsp_processq_add(lsp))
 			return -1;
 	} else if (!lsp->nhlfe_list
-		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)) {
+		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)
+		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_QUEUED)) {
 		if (IS_ZEBRA_DEBUG_MPLS)
 			zlog_debug("Free LSP in-label %u flags 0x%x",
 				   lsp->ile.in_label, lsp->flags);
@@ -308,7 +309,8 @@ static int lsp_uninstall(struct zebra_vrf *zvrf, mpls_label_t label)
 		if (lsp_processq_add(lsp))
 			return -1;
 	} else if (!lsp->nhlfe_list
-		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)) {
+		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)
+		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_QUEUED)) {
 		if (IS_ZEBRA_DEBUG_MPLS)
 			zlog_debug("Del LSP in-label %u flags 0x%x",
 				   lsp->ile.in_label, lsp->flags);
@@ -444,6 +446,35 @@ static int fec_change_update_lsp(struct zebra_vrf *zvrf, zebra_fec_t *fec,
 	return 0;
 }
 
+/*
+ * While a client's register message is handled, the bindings sent back to
+ * it are collected in as few FEC updates as they fit in, see
+ * zebra_mpls_fec_batch().
+ */
+static struct zserv *fec_batch_client;
+static struct stream *fec_batch;
+
+/* family, prefix and label */
+#define FEC_UPDATE_ENTRY_MAX (2 + 1 + IPV6_MAX_BYTELEN + 4)
+
+static int fec_batch_send(void)
+{
+	struct stream *s = fec_batch;
+
+	if (!s)
+		return 0;
+
+	fec_batch = NULL;
+	stream_putw_at(s, 0, stream_get_endp(s));
+	return zebra_server_send_message(fec_batch_client, s);
+}
+
+void zebra_mpls_fec_batch(struct zserv *client)
+{
+	fec_batch_send();
+	fec_batch_client = client;
+}
+
 /*
  * Inform about FEC to a registered client.
  */
@@ -451,9 +482,26 @@ static int fec_send(zebra_fec_t *fec, struct zserv *client)
 {
 	struct stream *s;
 	struct route_node *rn;
+	int ret = 0;
 
 	rn = fec->rn;
 
+	if (client && client == fec_batch_client) {
+		if (fec_batch
+		    && STREAM_WRITEABLE(fec_batch) < FEC_UPDATE_ENTRY_MAX)
+			ret = fec_batch_send();
+		if (!fec_batch) {
+			fec_batch = stream_new(ZEBRA_MAX_PACKET_SIZ);
+			zclient_create_header(fec_batch, ZEBRA_FEC_UPDATE,
+					      VRF_DEFAULT);
+		}
+
+		stream_putw(fec_batch, rn->p.family);
+		stream_put_prefix(fec_batch, &rn->p);
+		stream_putl(fec_batch, fec->label);
+		return ret;
+	}
+
 	/* Get output stream. */
 	s = stream_new(ZEBRA_MAX_PACKET_SIZ);
 
@@ -863,18 +911,6 @@ static void lsp_uninstall_from_kernel(struct hash_backet *backet, void *ctxt)
 		kernel_del_lsp(lsp);
 }
 
-/*
- * Schedule LSP forwarding entry for processing. Called upon changes
- * that may impact LSPs such as nexthop / connected route changes.
- */
-static void lsp_schedule(struct hash_backet *backet, void *ctxt)
-{
-	zebra_lsp_t *lsp;
-
-	lsp = (zebra_lsp_t *)backet->data;
-	(void)lsp_processq_add(lsp);
-}
-
 /*
  * Process a LSP entry that is in the queue. Recalculate best NHLFE and
  * any multipaths and update or delete from the kernel, as needed.
@@ -996,7 +1032,8 @@ static void lsp_processq_del(struct work_queue *wq, void *data)
 			nhlfe_del(nhlfe);
 	}
 
-	if (!lsp->nhlfe_list) {
+	/* An LSP the kernel has yet to answer for is freed then */
+	if (!lsp->nhlfe_list && !CHECK_FLAG(lsp->flags, LSP_FLAG_QUEUED)) {
 		if (IS_ZEBRA_DEBUG_MPLS)
 			zlog_debug("Free LSP in-label %u flags 0x%x",
 				   lsp->ile.in_label, lsp->flags);
@@ -1013,7 +1050,8 @@ static void lsp_processq_del(struct work_queue *wq, void *data)
  */
 static void lsp_processq_complete(struct work_queue *wq)
 {
-	/* Nothing to do for now. */
+	/* Hand whatever is left of the updates to the kernel */
+	kernel_route_rib_flush();
 }
 
 /*
@@ -1142,6 +1180,87 @@ static zebra_nhlfe_t *nhlfe_find(zebra_lsp_t *lsp, enum lsp_types_t lsp_type,
 	return nhlfe;
 }
 
+/*
+ * Add NHLFE to the gateway index of the VRF its nexthop resolves in.
+ * Nexthops only checked against interface state go to the list of
+ * those without a gateway.
+ */
+static void nhlfe_gate_index(zebra_nhlfe_t *nhlfe)
+{
+	struct nexthop *nexthop = nhlfe->nexthop;
+	struct zebra_vrf *zvrf;
+	struct route_table *table = NULL;
+	zebra_nhlfe_t **head;
+	struct prefix p;
+
+	zvrf = vrf_info_lookup(nexthop->vrf_id);
+	if (!zvrf)
+		return;
+
+	memset(&p, 0, sizeof(p));
+	switch (nexthop->type) {
+	case NEXTHOP_TYPE_IPV4:
+	case NEXTHOP_TYPE_IPV4_IFINDEX:
+		p.family = AF_INET;
+		p.prefixlen = IPV4_MAX_PREFIXLEN;
+		p.u.prefix4 = nexthop->gate.ipv4;
+		table = zvrf->nhlfe_gate_table[AFI_IP];
+		break;
+	case NEXTHOP_TYPE_IPV6:
+	case NEXTHOP_TYPE_IPV6_IFINDEX:
+		if (nexthop->type == NEXTHOP_TYPE_IPV6_IFINDEX
+		    && IN6_IS_ADDR_LINKLOCAL(&nexthop->gate.ipv6))
+			break;
+		p.family = AF_INET6;
+		p.prefixlen = IPV6_MAX_PREFIXLEN;
+		p.u.prefix6 = nexthop->gate.ipv6;
+		table = zvrf->nhlfe_gate_table[AFI_IP6];
+		break;
+	default:
+		break;
+	}
+
+	if (table) {
+		nhlfe->gate_rn = route_node_get(table, &p);
+		/* The node keeps a single lock while it has NHLFEs. */
+		if (nhlfe->gate_rn->info)
+			route_unlock_node(nhlfe->gate_rn);
+		head = (zebra_nhlfe_t **)&nhlfe->gate_rn->info;
+	} else
+		head = &zvrf->nhlfe_nogate_list;
+
+	if (*head)
+		(*head)->gate_prev = nhlfe;
+	nhlfe->gate_next = *head;
+	*head = nhlfe;
+}
+
+/*
+ * Remove NHLFE from the gateway index.
+ */
+static void nhlfe_gate_unindex(zebra_nhlfe_t *nhlfe)
+{
+	struct zebra_vrf *zvrf;
+	struct route_node *rn = nhlfe->gate_rn;
+
+	if (nhlfe->gate_next)
+		nhlfe->gate_next->gate_prev = nhlfe->gate_prev;
+	if (nhlfe->gate_prev)
+		nhlfe->gate_prev->gate_next = nhlfe->gate_next;
+	else if (rn) {
+		rn->info = nhlfe->gate_next;
+		if (!rn->info)
+			route_unlock_node(rn);
+	} else {
+		zvrf = vrf_info_lookup(nhlfe->nexthop->vrf_id);
+		if (zvrf && zvrf->nhlfe_nogate_list == nhlfe)
+			zvrf->nhlfe_nogate_list = nhlfe->gate_next;
+	}
+
+	nhlfe->gate_rn = NULL;
+	nhlfe->gate_next = nhlfe->gate_prev = NULL;
+}
+
 /*
  * Add NHLFE. Base entry must have been created and duplicate
  * check done.
@@ -1202,6 +1321,8 @@ static zebra_nhlfe_t *nhlfe_add(zebra_lsp_t *lsp, enum lsp_types_t lsp_type,
 	nhlfe->next = lsp->nhlfe_list;
 	lsp->nhlfe_list = nhlfe;
 
+	nhlfe_gate_index(nhlfe);
+
 	return nhlfe;
 }
 
@@ -1220,8 +1341,10 @@ static int nhlfe_del(zebra_nhlfe_t *nhlfe)
 		return -1;
 
 	/* Free nexthop. */
-	if (nhlfe->nexthop)
+	if (nhlfe->nexthop) {
+		nhlfe_gate_unindex(nhlfe);
 		nexthop_free(nhlfe->nexthop);
+	}
 
 	/* Unlink from LSP */
 	if (nhlfe->next)
@@ -1284,7 +1407,8 @@ static int mpls_lsp_uninstall_all(struct hash *lsp_table, zebra_lsp_t *lsp,
 		if (lsp_processq_add(lsp))
 			return -1;
 	} else if (!lsp->nhlfe_list
-		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)) {
+		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)
+		   && !CHECK_FLAG(lsp->flags, LSP_FLAG_QUEUED)) {
 		if (IS_ZEBRA_DEBUG_MPLS)
 			zlog_debug("Free LSP in-label %u flags 0x%x",
 				   lsp->ile.in_label, lsp->flags);
@@ -1680,6 +1804,7 @@ static int mpls_processq_init(struct zebra_t *zebra)
 	zebra->lsp_process_q->spec.completion_func = &lsp_processq_complete;
 	zebra->lsp_process_q->spec.max_retries = 0;
 	zebra->lsp_process_q->spec.hold = 10;
+	zebra->lsp_process_q->spec.max_stall = zebra->wq_max_stall * 1000UL;
 
 	return 0;
 }
@@ -1720,6 +1845,20 @@ void kernel_lsp_pass_fail(zebra_lsp_t *lsp, enum southbound_results res)
 		zlog_warn("LSP Deletion Failure: %u", lsp->ile.in_label);
 		break;
 	}
+
+	/* The LSP may have lost its NHLFEs while the kernel was busy */
+	if (!lsp->nhlfe_list && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)
+	    && !CHECK_FLAG(lsp->flags, LSP_FLAG_QUEUED)) {
+		struct zebra_vrf *zvrf = vrf_info_lookup(VRF_DEFAULT);
+
+		if (IS_ZEBRA_DEBUG_MPLS)
+			zlog_debug("Free LSP in-label %u flags 0x%x",
+				   lsp->ile.in_label, lsp->flags);
+
+		lsp = hash_release(zvrf->lsp_table, &lsp->ile);
+		if (lsp)
+			XFREE(MTYPE_LSP, lsp);
+	}
 }
 
 /*
@@ -2299,6 +2438,9 @@ int mpls_ftn_update(int add, struct zebra_vrf *zvrf, enum lsp_types_t type,
 	if (re == NULL)
 		return -1;
 
+	/* The labels are for this route only */
+	zebra_nhg_unshare(re);
+
 	found = false;
 	for (nexthop = re->ng.nexthop; nexthop; nexthop = nexthop->next) {
 		switch (nexthop->type) {
@@ -2467,7 +2609,8 @@ int mpls_lsp_uninstall(struct zebra_vrf *zvrf, enum lsp_types_t type,
 
 		/* Free LSP entry if no other NHLFEs and not scheduled. */
 		if (!lsp->nhlfe_list
-		    && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)) {
+		    && !CHECK_FLAG(lsp->flags, LSP_FLAG_SCHEDULED)
+		    && !CHECK_FLAG(lsp->flags, LSP_FLAG_QUEUED)) {
 			if (IS_ZEBRA_DEBUG_MPLS)
 				zlog_debug("Free LSP in-label %u flags 0x%x",
 					   lsp->ile.in_label, lsp->flags);
@@ -2726,15 +2869,98 @@ int zebra_mpls_static_lsp_del(struct zebra_vrf *zvrf, mpls_label_t in_label,
 }
 
 /*
- * Schedule all MPLS label forwarding entries for processing.
- * Called upon changes that may affect one or more of them such as
- * interface or nexthop state changes.
+ * Note a connected prefix change for the next zebra_mpls_lsp_schedule().
+ */
+void mpls_mark_lsps_for_processing(struct zebra_vrf *zvrf,
+				   const struct prefix *p)
+{
+	struct route_node *rn;
+	struct prefix cp;
+	afi_t afi;
+
+	if (!zvrf)
+		return;
+
+	zvrf->mpls_flags |= MPLS_FLAG_SCHEDULE_LSPS;
+
+	afi = family2afi(p->family);
+	if (afi != AFI_IP && afi != AFI_IP6)
+		return;
+
+	prefix_copy(&cp, p);
+	apply_mask(&cp);
+	if (!zvrf->lsp_changed[afi])
+		zvrf->lsp_changed[afi] = route_table_init();
+	rn = route_node_get(zvrf->lsp_changed[afi], &cp);
+	if (rn->info)
+		route_unlock_node(rn);
+	else
+		rn->info = zvrf;
+}
+
+/*
+ * Schedule the LSPs of NHLFEs that may resolve through a changed prefix.
+ * The longest match of a gateway can only change with a prefix covering
+ * it, so those are the gateways below the changed prefix.
+ */
+static void lsp_schedule_changed(struct route_table *gate_table,
+				 struct route_table *changed)
+{
+	struct route_node *crn, *nrn;
+	struct prefix *last = NULL;
+	zebra_nhlfe_t *nhlfe;
+
+	for (crn = route_top(changed); crn; crn = route_next(crn)) {
+		if (!crn->info)
+			continue;
+
+		/* Anything below a prefix that was already walked follows
+		 * it directly in table order.
+		 */
+		if (last && prefix_match(last, &crn->p))
+			continue;
+		last = &crn->p;
+
+		nrn = route_node_lookup(gate_table, &crn->p);
+		if (!nrn)
+			nrn = route_table_get_next(gate_table, &crn->p);
+
+		while (nrn && prefix_match(&crn->p, &nrn->p)) {
+			for (nhlfe = nrn->info; nhlfe; nhlfe = nhlfe->gate_next)
+				(void)lsp_processq_add(nhlfe->lsp);
+			nrn = route_next(nrn); /* this will also unlock nrn */
+		}
+
+		if (nrn)
+			route_unlock_node(nrn);
+	}
+}
+
+/*
+ * Schedule the MPLS label forwarding entries that may be affected by the
+ * connected prefix changes noted since the last call for processing.
  */
 void zebra_mpls_lsp_schedule(struct zebra_vrf *zvrf)
 {
+	zebra_nhlfe_t *nhlfe;
+	afi_t afi;
+
 	if (!zvrf)
 		return;
-	hash_iterate(zvrf->lsp_table, lsp_schedule, NULL);
+
+	/* Interface state changes come with a connected change. */
+	for (nhlfe = zvrf->nhlfe_nogate_list; nhlfe; nhlfe = nhlfe->gate_next)
+		(void)lsp_processq_add(nhlfe->lsp);
+
+	for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
+		if (!zvrf->lsp_changed[afi])
+			continue;
+		if (zvrf->nhlfe_gate_table[afi])
+			lsp_schedule_changed(zvrf->nhlfe_gate_table[afi],
+					     zvrf->lsp_changed[afi]);
+		route_table_finish(zvrf->lsp_changed[afi]);
+		zvrf->lsp_changed[afi] = NULL;
+	}
 }
 
 /*
@@ -2951,13 +3177,23 @@ void zebra_mpls_cleanup_tables(struct zebra_vrf *zvrf)
  */
 void zebra_mpls_close_tables(struct zebra_vrf *zvrf)
 {
+	afi_t afi;
+
 	hash_iterate(zvrf->lsp_table, lsp_uninstall_from_kernel, NULL);
+	kernel_route_rib_wait();
 	hash_clean(zvrf->lsp_table, NULL);
 	hash_free(zvrf->lsp_table);
 	hash_clean(zvrf->slsp_table, NULL);
 	hash_free(zvrf->slsp_table);
 	route_table_finish(zvrf->fec_table[AFI_IP]);
 	route_table_finish(zvrf->fec_table[AFI_IP6]);
+	for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
+		route_table_finish(zvrf->nhlfe_gate_table[afi]);
+		zvrf->nhlfe_gate_table[afi] = NULL;
+		route_table_finish(zvrf->lsp_changed[afi]);
+		zvrf->lsp_changed[afi] = NULL;
+	}
+	zvrf->nhlfe_nogate_list = NULL;
 }
 
 /*
@@ -2973,6 +3209,8 @@ void zebra_mpls_init_tables(struct zebra_vrf *zvrf)
 	zvrf->lsp_table = hash_create(label_hash, label_cmp, "ZEBRA LSP table");
 	zvrf->fec_table[AFI_IP] = route_table_init();
 	zvrf->fec_table[AFI_IP6] = route_table_init();
+	zvrf->nhlfe_gate_table[AFI_IP] = route_table_init();
+	zvrf->nhlfe_gate_table[AFI_IP6] = route_table_init();
 	zvrf->mpls_flags = 0;
 	zvrf->mpls_srgb.start_label = MPLS_DEFAULT_MIN_SRGB_LABEL;
 	zvrf->mpls_srgb.end_label = MPLS_DEFAULT_MAX_SRGB_LABEL;
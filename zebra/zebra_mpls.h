@@ -101,6 +101,11 @@ struct zebra_nhlfe_t_ {
 	zebra_nhlfe_t *next;
 	zebra_nhlfe_t *prev;
 	uint8_t distance;
+
+	/* Node of the gateway index, NULL if on the list without one */
+	struct route_node *gate_rn;
+	zebra_nhlfe_t *gate_next;
+	zebra_nhlfe_t *gate_prev;
 };
 
 /*
@@ -138,6 +143,8 @@ struct zebra_lsp_t_ {
 #define LSP_FLAG_SCHEDULED        (1 << 0)
 #define LSP_FLAG_INSTALLED        (1 << 1)
 #define LSP_FLAG_CHANGED          (1 << 2)
+/* the LSP has an update queued for the kernel, see kernel_lsp_pass_fail() */
+#define LSP_FLAG_QUEUED           (1 << 3)
 
 	/* Address-family of NHLFE - saved here for delete. All NHLFEs */
 	/* have to be of the same AF */
@@ -218,6 +225,12 @@ int zebra_mpls_lsp_uninstall(struct zebra_vrf *zvrf, struct route_node *rn,
 int zebra_mpls_fec_register(struct zebra_vrf *zvrf, struct prefix *p,
 			    uint32_t label_index, struct zserv *client);
 
+/*
+ * Collects the FEC updates for client until called again (with NULL to
+ * just send them).
+ */
+void zebra_mpls_fec_batch(struct zserv *client);
+
 /*
  * Deregistration from a client for the label binding for a FEC. The FEC
  * itself is deleted if no other registered clients exist and there is no
@@ -360,12 +373,18 @@ int zebra_mpls_static_lsp_del(struct zebra_vrf *zvrf, mpls_label_t in_label,
 			      ifindex_t ifindex);
 
 /*
- * Schedule all MPLS label forwarding entries for processing.
- * Called upon changes that may affect one or more of them such as
- * interface or nexthop state changes.
+ * Schedule the MPLS label forwarding entries that may be affected by the
+ * connected prefixes marked since the last call for processing.
  */
 void zebra_mpls_lsp_schedule(struct zebra_vrf *zvrf);
 
+/*
+ * Note a connected prefix change that may affect the resolution of
+ * MPLS label forwarding entries.
+ */
+void mpls_mark_lsps_for_processing(struct zebra_vrf *zvrf,
+				   const struct prefix *p);
+
 /*
  * Display MPLS label forwarding table for a specific LSP
  * (VTY command handler).
@@ -517,14 +536,6 @@ static inline const char *nhlfe_type2str(enum lsp_types_t lsp_type)
 	return "Unknown";
 }
 
-static inline void mpls_mark_lsps_for_processing(struct zebra_vrf *zvrf)
-{
-	if (!zvrf)
-		return;
-
-	zvrf->mpls_flags |= MPLS_FLAG_SCHEDULE_LSPS;
-}
-
 static inline void mpls_unmark_lsps_for_processing(struct zebra_vrf *zvrf)
 {
 	if (!zvrf)
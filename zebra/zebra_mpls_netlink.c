@@ -38,11 +38,10 @@ void kernel_add_lsp(zebra_lsp_t *lsp)
 		return;
 	}
 
+	/* If queued, the result is reported once the kernel answered */
 	ret = netlink_mpls_multipath(RTM_NEWROUTE, lsp);
-
-	kernel_lsp_pass_fail(lsp,
-			     (!ret) ? SOUTHBOUND_INSTALL_SUCCESS
-				    : SOUTHBOUND_INSTALL_FAILURE);
+	if (!ret)
+		kernel_lsp_pass_fail(lsp, SOUTHBOUND_INSTALL_SUCCESS);
 }
 
 /*
@@ -65,11 +64,10 @@ void kernel_upd_lsp(zebra_lsp_t *lsp)
 		return;
 	}
 
+	/* If queued, the result is reported once the kernel answered */
 	ret = netlink_mpls_multipath(RTM_NEWROUTE, lsp);
-
-	kernel_lsp_pass_fail(lsp,
-			     (!ret) ? SOUTHBOUND_INSTALL_SUCCESS
-				    : SOUTHBOUND_INSTALL_FAILURE);
+	if (!ret)
+		kernel_lsp_pass_fail(lsp, SOUTHBOUND_INSTALL_SUCCESS);
 }
 
 /*
@@ -90,10 +88,8 @@ void kernel_del_lsp(zebra_lsp_t *lsp)
 	}
 
 	ret = netlink_mpls_multipath(RTM_DELROUTE, lsp);
-
-	kernel_lsp_pass_fail(lsp,
-			     (!ret) ? SOUTHBOUND_DELETE_SUCCESS
-				    : SOUTHBOUND_DELETE_FAILURE);
+	if (!ret)
+		kernel_lsp_pass_fail(lsp, SOUTHBOUND_DELETE_SUCCESS);
 }
 
 int mpls_kernel_init(void)
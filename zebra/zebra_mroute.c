@@ -69,3 +69,94 @@ stream_failure:
 	stream_putw_at(s, 0, stream_get_endp(s));
 	zebra_server_send_message(client, s);
 }
+
+struct ipmr_route_stats_bulk {
+	struct zserv *client;
+	struct zebra_vrf *zvrf;
+	struct stream *s;
+	size_t countp;
+	uint32_t count;
+};
+
+/* Source, group, last used and the three counters */
+#define IPMR_ROUTE_STATS_BULK_ENTRY_SIZE (4 + 4 + 4 * 8)
+
+static void ipmr_route_stats_bulk_start(struct ipmr_route_stats_bulk *bulk)
+{
+	struct stream *s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+
+	zclient_create_header(s, ZEBRA_IPMR_ROUTE_STATS_BULK,
+			      zvrf_id(bulk->zvrf));
+	stream_putl(s, 0); /* result, on the last message */
+	stream_putc(s, 0); /* more to come */
+	bulk->countp = stream_get_endp(s);
+	stream_putl(s, 0);
+
+	bulk->s = s;
+	bulk->count = 0;
+}
+
+static void ipmr_route_stats_bulk_send(struct ipmr_route_stats_bulk *bulk,
+				       int suc, bool more)
+{
+	struct stream *s;
+
+	if (!bulk->s)
+		ipmr_route_stats_bulk_start(bulk);
+
+	s = bulk->s;
+	stream_putl_at(s, ZEBRA_HEADER_SIZE, suc);
+	stream_putc_at(s, ZEBRA_HEADER_SIZE + 4, more);
+	stream_putl_at(s, bulk->countp, bulk->count);
+	stream_putw_at(s, 0, stream_get_endp(s));
+	zebra_server_send_message(bulk->client, s);
+
+	bulk->s = NULL;
+}
+
+static void ipmr_route_stats_bulk_add(void *arg1, void *arg2)
+{
+	struct mcast_route_data *mroute = arg1;
+	struct ipmr_route_stats_bulk *bulk = arg2;
+	struct stream *s;
+
+	if (bulk->s
+	    && STREAM_WRITEABLE(bulk->s) < IPMR_ROUTE_STATS_BULK_ENTRY_SIZE)
+		ipmr_route_stats_bulk_send(bulk, 0, true);
+
+	if (!bulk->s)
+		ipmr_route_stats_bulk_start(bulk);
+
+	s = bulk->s;
+	stream_put_in_addr(s, &mroute->sg.src);
+	stream_put_in_addr(s, &mroute->sg.grp);
+	stream_put(s, &mroute->lastused, sizeof(mroute->lastused));
+	stream_putq(s, mroute->pktcnt);
+	stream_putq(s, mroute->bytecnt);
+	stream_putq(s, mroute->wrong_if);
+	bulk->count++;
+}
+
+/*
+ * The counters of all the VRF's multicast routes, for pimd to look at its
+ * channels' without a request per (S,G).
+ */
+void zebra_ipmr_route_stats_bulk(ZAPI_HANDLER_ARGS)
+{
+	struct ipmr_route_stats_bulk bulk;
+	int suc;
+
+	memset(&bulk, 0, sizeof(bulk));
+	bulk.client = client;
+	bulk.zvrf = zvrf;
+
+	if (IS_ZEBRA_DEBUG_KERNEL)
+		zlog_debug("Asking for all (%s) mroute information",
+			   zvrf_name(zvrf));
+
+	suc = kernel_get_ipmr_sg_stats_bulk(zvrf, ipmr_route_stats_bulk_add,
+					    &bulk);
+
+	ipmr_route_stats_bulk_send(&bulk, suc, false);
+}
+
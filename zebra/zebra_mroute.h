@@ -28,8 +28,12 @@ struct mcast_route_data {
 	struct prefix_sg sg;
 	unsigned int ifindex;
 	unsigned long long lastused;
+	unsigned long long pktcnt;
+	unsigned long long bytecnt;
+	unsigned long long wrong_if;
 };
 
 void zebra_ipmr_route_stats(ZAPI_HANDLER_ARGS);
+void zebra_ipmr_route_stats_bulk(ZAPI_HANDLER_ARGS);
 
 #endif
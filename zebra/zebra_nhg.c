@@ -0,0 +1,719 @@
+/*
+ * Zebra shared nexthop groups
+ * Copyright (C) 2018 Cumulus Networks, Inc.
+ *
+ * This file is part of FRR.
+ *
+ * FRR is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * FRR is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRR; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "hash.h"
+#include "hashfn.h"
+#include "linklist.h"
+#include "memory.h"
+#include "nexthop.h"
+#include "nexthop_group.h"
+#include "prefix.h"
+#include "routemap.h"
+#include "table.h"
+
+#include "zebra/zebra_memory.h"
+#include "zebra/rib.h"
+#include "zebra/zebra_routemap.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/rt.h"
+#include "zebra/debug.h"
+
+DEFINE_MTYPE_STATIC(ZEBRA, NHG, "Nexthop group")
+DEFINE_MTYPE_STATIC(ZEBRA, NHG_KEYS, "Nexthop group keys")
+DEFINE_MTYPE_STATIC(ZEBRA, NHG_GATE, "Nexthop group gateway")
+DEFINE_MTYPE_STATIC(ZEBRA, NHG_GATE_LINKS, "Nexthop group gateway links")
+
+static struct hash *zebra_nhg_hash;
+
+/*
+ * The groups and private routes with a nexthop via this gateway, found
+ * again through it when the tracked nexthop for the gateway changes.
+ */
+struct nhg_gate {
+	vrf_id_t vrf_id;
+	int family;
+	union g_addr addr;
+
+	/* struct nhg_hash_entry */
+	struct list *groups;
+	/* route nodes of the private routes */
+	struct list *routes;
+};
+
+/* Where a group or private route is listed, once per distinct gateway */
+struct nhg_gate_links {
+	unsigned int num;
+	struct {
+		struct nhg_gate *gate;
+		struct listnode *node;
+	} link[];
+};
+
+static struct hash *zebra_nhg_gates;
+
+/* Bumped for each batch of changed nexthops, see zebra_nhg_group_changed() */
+static uint32_t zebra_nhg_changed_seq;
+
+/* Current resolution epoch, never 0 so that fresh groups are unresolved */
+static uint32_t zebra_nhg_epoch = 1;
+
+/* Groups of up to this many nexthops are looked up without allocating. */
+#define ZEBRA_NHG_KEYS_STACK 8
+
+static uint32_t zebra_nhg_key_make(const struct nhg_hash_entry *nhe)
+{
+	uint64_t h;
+
+	h = hashfn_mix(0, ((uint64_t)nhe->afi << 32) | nhe->vrf_id,
+		       ((uint64_t)(uint32_t)nhe->type << 32) | nhe->flags);
+	h = hashfn64(nhe->keys, nhe->num_keys * sizeof(*nhe->keys), h);
+
+	return hashfn_fold(h);
+}
+
+static unsigned int zebra_nhg_hash_key(void *arg)
+{
+	struct nhg_hash_entry *nhe = arg;
+
+	return nhe->key;
+}
+
+static bool zebra_nhg_nexthop_same(const struct nexthop *nh1,
+				   const struct nexthop *nh2)
+{
+	if (!nexthop_same(nh1, nh2))
+		return false;
+
+	if (CHECK_FLAG(nh1->flags, NEXTHOP_FLAG_ONLINK)
+	    != CHECK_FLAG(nh2->flags, NEXTHOP_FLAG_ONLINK))
+		return false;
+
+	if (memcmp(&nh1->src, &nh2->src, sizeof(nh1->src)))
+		return false;
+
+	if (!nh1->nh_label || !nh2->nh_label)
+		return nh1->nh_label == nh2->nh_label;
+
+	return nh1->nh_label_type == nh2->nh_label_type
+	       && nh1->nh_label->num_labels == nh2->nh_label->num_labels
+	       && !memcmp(nh1->nh_label->label, nh2->nh_label->label,
+			  nh1->nh_label->num_labels * sizeof(mpls_label_t));
+}
+
+static int zebra_nhg_hash_cmp(const void *arg1, const void *arg2)
+{
+	const struct nhg_hash_entry *nhe1 = arg1;
+	const struct nhg_hash_entry *nhe2 = arg2;
+	struct nexthop *nh1, *nh2;
+	unsigned int i;
+
+	if (nhe1->key != nhe2->key || nhe1->afi != nhe2->afi
+	    || nhe1->vrf_id != nhe2->vrf_id || nhe1->type != nhe2->type
+	    || nhe1->flags != nhe2->flags || nhe1->num_keys != nhe2->num_keys)
+		return 0;
+
+	if (memcmp(nhe1->keys, nhe2->keys,
+		   nhe1->num_keys * sizeof(*nhe1->keys)))
+		return 0;
+
+	for (i = 0; i < nhe1->num_keys; i++)
+		if (!nexthop_key_exact(&nhe1->keys[i]))
+			break;
+	if (i == nhe1->num_keys)
+		return 1;
+
+	/* long label stacks are only hashed into the keys */
+	for (nh1 = nhe1->nhg.nexthop, nh2 = nhe2->nhg.nexthop; nh1 && nh2;
+	     nh1 = nh1->next, nh2 = nh2->next)
+		if (!zebra_nhg_nexthop_same(nh1, nh2))
+			return 0;
+
+	return !nh1 && !nh2;
+}
+
+static size_t zebra_nhg_gate_len(int family)
+{
+	return family == AF_INET ? sizeof(struct in_addr)
+				 : sizeof(struct in6_addr);
+}
+
+static unsigned int zebra_nhg_gate_hash_key(void *arg)
+{
+	struct nhg_gate *gate = arg;
+
+	return hashfn_fold(hashfn64(&gate->addr,
+				    zebra_nhg_gate_len(gate->family),
+				    hashfn_mix(0, gate->vrf_id, gate->family)));
+}
+
+static int zebra_nhg_gate_hash_cmp(const void *arg1, const void *arg2)
+{
+	const struct nhg_gate *gate1 = arg1;
+	const struct nhg_gate *gate2 = arg2;
+
+	return gate1->vrf_id == gate2->vrf_id
+	       && gate1->family == gate2->family
+	       && !memcmp(&gate1->addr, &gate2->addr,
+			  zebra_nhg_gate_len(gate1->family));
+}
+
+static void *zebra_nhg_gate_alloc(void *arg)
+{
+	struct nhg_gate *gate;
+
+	gate = XCALLOC(MTYPE_NHG_GATE, sizeof(struct nhg_gate));
+	*gate = *(struct nhg_gate *)arg;
+	gate->groups = list_new();
+	gate->routes = list_new();
+
+	return gate;
+}
+
+/* Fill in the lookup key for the nexthop's gateway, if it has one. */
+static bool zebra_nhg_gate_key(struct nhg_gate *key,
+			       const struct nexthop *nexthop)
+{
+	memset(key, 0, sizeof(*key));
+	key->vrf_id = nexthop->vrf_id;
+
+	switch (nexthop->type) {
+	case NEXTHOP_TYPE_IPV4:
+	case NEXTHOP_TYPE_IPV4_IFINDEX:
+		key->family = AF_INET;
+		key->addr.ipv4 = nexthop->gate.ipv4;
+		return true;
+	case NEXTHOP_TYPE_IPV6:
+	case NEXTHOP_TYPE_IPV6_IFINDEX:
+		key->family = AF_INET6;
+		key->addr.ipv6 = nexthop->gate.ipv6;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * List data, a group or a route node, with the gateways of the nexthops;
+ * NULL if there are none.
+ */
+static struct nhg_gate_links *zebra_nhg_gates_link(struct nexthop *nexthops,
+						   void *data, bool group)
+{
+	struct nhg_gate_links *links;
+	struct nhg_gate key, *gate;
+	struct nexthop *nexthop;
+	struct list *list;
+	unsigned int n = 0, i;
+
+	for (nexthop = nexthops; nexthop; nexthop = nexthop->next)
+		n++;
+	links = XCALLOC(MTYPE_NHG_GATE_LINKS,
+			sizeof(*links) + n * sizeof(links->link[0]));
+
+	for (nexthop = nexthops; nexthop; nexthop = nexthop->next) {
+		if (!zebra_nhg_gate_key(&key, nexthop))
+			continue;
+
+		gate = hash_get(zebra_nhg_gates, &key, zebra_nhg_gate_alloc);
+		for (i = 0; i < links->num; i++)
+			if (links->link[i].gate == gate)
+				break;
+		if (i < links->num)
+			continue;
+
+		list = group ? gate->groups : gate->routes;
+		listnode_add(list, data);
+		links->link[links->num].gate = gate;
+		links->link[links->num++].node = listtail(list);
+	}
+
+	if (!links->num)
+		XFREE(MTYPE_NHG_GATE_LINKS, links);
+
+	return links;
+}
+
+static void zebra_nhg_gates_unlink(struct nhg_gate_links *links, bool group)
+{
+	struct nhg_gate *gate;
+	unsigned int i;
+
+	if (!links)
+		return;
+
+	for (i = 0; i < links->num; i++) {
+		gate = links->link[i].gate;
+		list_delete_node(group ? gate->groups : gate->routes,
+				 links->link[i].node);
+		if (listcount(gate->groups) || listcount(gate->routes))
+			continue;
+
+		hash_release(zebra_nhg_gates, gate);
+		list_delete_and_null(&gate->groups);
+		list_delete_and_null(&gate->routes);
+		XFREE(MTYPE_NHG_GATE, gate);
+	}
+
+	XFREE(MTYPE_NHG_GATE_LINKS, links);
+}
+
+/* Whether the route is listed at node for one of its gateways. */
+static bool zebra_nhg_gates_listed(struct nhg_gate_links *links,
+				   struct listnode *node)
+{
+	unsigned int i;
+
+	if (!links)
+		return false;
+
+	for (i = 0; i < links->num; i++)
+		if (links->link[i].node == node)
+			return true;
+
+	return false;
+}
+
+static void *zebra_nhg_alloc(void *arg)
+{
+	struct nhg_hash_entry *nhe;
+
+	nhe = XCALLOC(MTYPE_NHG, sizeof(struct nhg_hash_entry));
+	*nhe = *(struct nhg_hash_entry *)arg;
+	nhe->keys = XMALLOC(MTYPE_NHG_KEYS,
+			    nhe->num_keys * sizeof(*nhe->keys));
+	memcpy(nhe->keys, ((struct nhg_hash_entry *)arg)->keys,
+	       nhe->num_keys * sizeof(*nhe->keys));
+	nhe->routes = list_new();
+	nhe->gates = zebra_nhg_gates_link(nhe->nhg.nexthop, nhe, true);
+
+	return nhe;
+}
+
+static void zebra_nhg_put(struct nhg_hash_entry *nhe)
+{
+	if (--nhe->refcnt)
+		return;
+
+	hash_release(zebra_nhg_hash, nhe);
+	if (nhe->kernel)
+		kernel_nhg_release(nhe);
+	zebra_nhg_gates_unlink(nhe->gates, true);
+	nexthops_free(nhe->nhg.nexthop);
+	list_delete_and_null(&nhe->routes);
+	XFREE(MTYPE_NHG_KEYS, nhe->keys);
+	XFREE(MTYPE_NHG, nhe);
+}
+
+/*
+ * Whether resolving the route's nexthops gives the same result for any
+ * other route with the same nexthops.
+ */
+static bool zebra_nhg_shareable(struct route_entry *re, afi_t afi,
+				safi_t safi, struct prefix *p,
+				struct prefix_ipv6 *src_p)
+{
+	struct nexthop *nexthop;
+	struct prefix nhp;
+
+	if (safi != SAFI_UNICAST || (src_p && src_p->prefixlen))
+		return false;
+
+	/* these carry per-route nexthop state of their own */
+	if (RIB_SYSTEM_ROUTE(re) || re->type == ZEBRA_ROUTE_STATIC
+	    || re->type == ZEBRA_ROUTE_TABLE
+	    || CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE))
+		return false;
+
+	/* route-maps match on the prefix */
+	if (zebra_route_map_proto_set(afi, re->type))
+		return false;
+
+	if (!re->ng.nexthop)
+		return false;
+
+	for (nexthop = re->ng.nexthop; nexthop; nexthop = nexthop->next) {
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_EVPN_RVTEP)
+		    || CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_FILTERED))
+			return false;
+
+		switch (nexthop->type) {
+		case NEXTHOP_TYPE_IPV4:
+		case NEXTHOP_TYPE_IPV4_IFINDEX:
+			nhp.family = AF_INET;
+			nhp.prefixlen = IPV4_MAX_PREFIXLEN;
+			nhp.u.prefix4 = nexthop->gate.ipv4;
+			break;
+		case NEXTHOP_TYPE_IPV6:
+		case NEXTHOP_TYPE_IPV6_IFINDEX:
+			nhp.family = AF_INET6;
+			nhp.prefixlen = IPV6_MAX_PREFIXLEN;
+			nhp.u.prefix6 = nexthop->gate.ipv6;
+			break;
+		default:
+			continue;
+		}
+
+		/*
+		 * Resolution refuses to go through the route itself, so the
+		 * outcome depends on the prefix.
+		 */
+		if (prefix_match(p, &nhp))
+			return false;
+	}
+
+	return true;
+}
+
+void zebra_nhg_intern(struct route_entry *re, afi_t afi, safi_t safi,
+		      struct prefix *p, struct prefix_ipv6 *src_p)
+{
+	struct nexthop_key keys[ZEBRA_NHG_KEYS_STACK];
+	struct nhg_hash_entry lookup;
+	struct nhg_hash_entry *nhe;
+	struct nexthop *nexthop;
+	unsigned int n = 0;
+
+	if (re->nhe || !zebra_nhg_shareable(re, afi, safi, p, src_p))
+		return;
+
+	memset(&lookup, 0, sizeof(lookup));
+	lookup.afi = afi;
+	lookup.vrf_id = re->vrf_id;
+	lookup.type = re->type;
+	lookup.flags = re->flags & ZEBRA_FLAG_ALLOW_RECURSION;
+	lookup.nhg.nexthop = re->ng.nexthop;
+
+	for (nexthop = re->ng.nexthop; nexthop; nexthop = nexthop->next)
+		n++;
+	lookup.keys = n <= array_size(keys)
+			      ? keys
+			      : XMALLOC(MTYPE_NHG_KEYS, n * sizeof(*keys));
+	lookup.num_keys = n;
+	for (nexthop = re->ng.nexthop, n = 0; nexthop; nexthop = nexthop->next)
+		nexthop_key_make(&lookup.keys[n++], nexthop, true);
+	lookup.key = zebra_nhg_key_make(&lookup);
+
+	nhe = hash_get(zebra_nhg_hash, &lookup, zebra_nhg_alloc);
+	if (lookup.keys != keys)
+		XFREE(MTYPE_NHG_KEYS, lookup.keys);
+	if (nhe->refcnt)
+		nexthops_free(re->ng.nexthop);
+	nhe->refcnt++;
+
+	re->nhe = nhe;
+	re->nhe_version = nhe->version;
+	re->ng.nexthop = nhe->nhg.nexthop;
+}
+
+void zebra_nhg_release(struct route_entry *re)
+{
+	struct nhg_hash_entry *nhe = re->nhe;
+
+	zebra_nhg_unlink(re);
+
+	if (!nhe) {
+		nexthops_free(re->ng.nexthop);
+		re->ng.nexthop = NULL;
+		return;
+	}
+
+	zebra_nhg_fib_unset(re);
+
+	re->nhe = NULL;
+	re->ng.nexthop = NULL;
+	zebra_nhg_put(nhe);
+}
+
+void zebra_nhg_unshare(struct route_entry *re)
+{
+	struct nhg_hash_entry *nhe = re->nhe;
+	struct nexthop *nexthop;
+	struct route_node *rn;
+
+	if (!nhe)
+		return;
+
+	re->ng.nexthop = NULL;
+	copy_nexthops(&re->ng.nexthop, nhe->nhg.nexthop, NULL);
+
+	/* the kernel route goes away with the group's nexthop object */
+	if (re->kernel_hash)
+		SET_FLAG(re->status, ROUTE_ENTRY_CHANGED);
+
+	if (CHECK_FLAG(re->status, ROUTE_ENTRY_INSTALLED)
+	    && !--nhe->installed)
+		for (ALL_NEXTHOPS(nhe->nhg, nexthop))
+			UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+
+	rn = re->nhe_node ? listgetdata(re->nhe_node) : NULL;
+	zebra_nhg_unlink(re);
+	re->nhe = NULL;
+	if (rn)
+		zebra_nhg_link(rn, re);
+
+	zebra_nhg_put(nhe);
+}
+
+void zebra_nhg_fib_set(struct route_entry *re)
+{
+	struct nexthop *nexthop;
+
+	if (re->nhe && !CHECK_FLAG(re->status, ROUTE_ENTRY_INSTALLED))
+		re->nhe->installed++;
+	SET_FLAG(re->status, ROUTE_ENTRY_INSTALLED);
+
+	for (ALL_NEXTHOPS(re->ng, nexthop)) {
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
+			continue;
+
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE))
+			SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+		else
+			UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+	}
+}
+
+void zebra_nhg_fib_unset(struct route_entry *re)
+{
+	struct nexthop *nexthop;
+
+	if (re->nhe) {
+		if (!CHECK_FLAG(re->status, ROUTE_ENTRY_INSTALLED))
+			return;
+		UNSET_FLAG(re->status, ROUTE_ENTRY_INSTALLED);
+		if (--re->nhe->installed)
+			return;
+	}
+	UNSET_FLAG(re->status, ROUTE_ENTRY_INSTALLED);
+
+	for (ALL_NEXTHOPS(re->ng, nexthop))
+		UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+}
+
+bool zebra_nhg_in_fib(struct route_entry *re)
+{
+	struct nexthop *nexthop;
+
+	/* the group's FIB flags may be there for another route */
+	if (re->nhe)
+		return CHECK_FLAG(re->status, ROUTE_ENTRY_INSTALLED);
+
+	for (ALL_NEXTHOPS(re->ng, nexthop))
+		if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB))
+			return true;
+
+	return false;
+}
+
+/* Whether a private route is listed with its gateways for re-resolution. */
+static bool zebra_nhg_resolves(struct route_entry *re)
+{
+	/* static routes are taken care of by nexthop tracking directly */
+	return !RIB_SYSTEM_ROUTE(re) && re->type != ZEBRA_ROUTE_STATIC;
+}
+
+void zebra_nhg_link(struct route_node *rn, struct route_entry *re)
+{
+	if (re->nhe) {
+		listnode_add(re->nhe->routes, rn);
+		re->nhe_node = listtail(re->nhe->routes);
+	} else if (zebra_nhg_resolves(re))
+		re->nhe_gates = zebra_nhg_gates_link(re->ng.nexthop, rn, false);
+}
+
+void zebra_nhg_unlink(struct route_entry *re)
+{
+	if (re->nhe) {
+		if (re->nhe_node)
+			list_delete_node(re->nhe->routes, re->nhe_node);
+		re->nhe_node = NULL;
+	} else {
+		zebra_nhg_gates_unlink(re->nhe_gates, false);
+		re->nhe_gates = NULL;
+	}
+}
+
+struct zebra_nhg_changed_ctx {
+	unsigned int groups;
+	unsigned int shared;
+	unsigned int routes;
+};
+
+/* Queue the route to be resolved again, returns false if it already was. */
+static bool zebra_nhg_route_changed(struct route_node *rn,
+				    struct route_entry *re)
+{
+	bool queued = CHECK_FLAG(re->status, ROUTE_ENTRY_CHANGED);
+
+	SET_FLAG(re->status, ROUTE_ENTRY_CHANGED);
+	SET_FLAG(re->status, ROUTE_ENTRY_NEXTHOPS_CHANGED);
+	rib_queue_add(rn);
+
+	return !queued;
+}
+
+static void zebra_nhg_group_changed(struct nhg_hash_entry *nhe,
+				    struct zebra_nhg_changed_ctx *ctx)
+{
+	struct listnode *node;
+	struct route_node *rn;
+	struct route_entry *re;
+
+	/* a group with several changed gateways is only done once */
+	if (nhe->changed_seq == zebra_nhg_changed_seq)
+		return;
+	nhe->changed_seq = zebra_nhg_changed_seq;
+	ctx->groups++;
+
+	/* resolved again when the first of its routes is processed */
+	nhe->resolved_epoch = 0;
+
+	for (ALL_LIST_ELEMENTS_RO(nhe->routes, node, rn))
+		RNODE_FOREACH_RE (rn, re)
+			if (re->nhe == nhe && re->nhe_node == node) {
+				if (zebra_nhg_route_changed(rn, re))
+					ctx->shared++;
+				break;
+			}
+}
+
+void zebra_nhg_nexthops_changed(vrf_id_t vrf_id, int family,
+				struct route_table *changed)
+{
+	struct zebra_nhg_changed_ctx ctx = {};
+	struct nhg_hash_entry *nhe;
+	struct nhg_gate key, *gate;
+	struct route_node *crn, *rn;
+	struct route_entry *re;
+	struct listnode *node;
+
+	if (!++zebra_nhg_changed_seq)
+		zebra_nhg_changed_seq = 1;
+
+	memset(&key, 0, sizeof(key));
+	key.vrf_id = vrf_id;
+	key.family = family;
+
+	for (crn = route_top(changed); crn; crn = route_next(crn)) {
+		if (!crn->info || crn->p.family != family
+		    || !is_host_route(&crn->p))
+			continue;
+
+		memcpy(&key.addr, &crn->p.u.prefix, zebra_nhg_gate_len(family));
+		gate = hash_lookup(zebra_nhg_gates, &key);
+		if (!gate)
+			continue;
+
+		for (ALL_LIST_ELEMENTS_RO(gate->groups, node, nhe))
+			zebra_nhg_group_changed(nhe, &ctx);
+
+		for (ALL_LIST_ELEMENTS_RO(gate->routes, node, rn))
+			RNODE_FOREACH_RE (rn, re)
+				if (!re->nhe
+				    && zebra_nhg_gates_listed(re->nhe_gates,
+							      node)) {
+					if (zebra_nhg_route_changed(rn, re))
+						ctx.routes++;
+					break;
+				}
+	}
+
+	if (!ctx.shared && !ctx.routes)
+		return;
+
+	if (IS_ZEBRA_DEBUG_NHT)
+		zlog_debug(
+			"%u: Tracked nexthops changed, queued %u routes of %u nexthop groups and %u others",
+			vrf_id, ctx.shared, ctx.groups, ctx.routes);
+}
+
+void zebra_nhg_invalidate(void)
+{
+	if (!++zebra_nhg_epoch)
+		zebra_nhg_epoch = 1;
+}
+
+/* Catch up with changes to the group made while resolving another route. */
+static void zebra_nhg_sync(struct route_entry *re)
+{
+	if (re->nhe_version == re->nhe->version)
+		return;
+
+	re->nhe_version = re->nhe->version;
+	SET_FLAG(re->status, ROUTE_ENTRY_CHANGED);
+	SET_FLAG(re->status, ROUTE_ENTRY_NEXTHOPS_CHANGED);
+}
+
+bool zebra_nhg_resolved(struct route_entry *re)
+{
+	struct nhg_hash_entry *nhe = re->nhe;
+
+	if (!nhe)
+		return false;
+
+	/* a route-map was set up since, it matches on the prefix */
+	if (zebra_route_map_proto_set(nhe->afi, nhe->type)) {
+		zebra_nhg_unshare(re);
+		return false;
+	}
+
+	if (nhe->resolved_epoch != zebra_nhg_epoch)
+		return false;
+
+	re->nexthop_active_num = nhe->active_num;
+	re->nexthop_mtu = nhe->nexthop_mtu;
+	zebra_nhg_sync(re);
+
+	return true;
+}
+
+void zebra_nhg_resolve_done(struct route_entry *re, bool set, bool changed)
+{
+	struct nhg_hash_entry *nhe = re->nhe;
+
+	if (!nhe)
+		return;
+
+	if (changed)
+		nhe->version++;
+
+	/* without 'set' the recursive resolution was not redone */
+	if (set) {
+		nhe->resolved_epoch = zebra_nhg_epoch;
+		nhe->active_num = re->nexthop_active_num;
+		nhe->nexthop_mtu = re->nexthop_mtu;
+	}
+
+	zebra_nhg_sync(re);
+}
+
+void zebra_nhg_init(void)
+{
+	zebra_nhg_hash = hash_create_size(8192, zebra_nhg_hash_key,
+					  zebra_nhg_hash_cmp,
+					  "Zebra nexthop groups");
+	zebra_nhg_gates = hash_create_size(8192, zebra_nhg_gate_hash_key,
+					   zebra_nhg_gate_hash_cmp,
+					   "Zebra nexthop group gateways");
+}
@@ -0,0 +1,148 @@
+/*
+ * Zebra shared nexthop groups
+ * Copyright (C) 2018 Cumulus Networks, Inc.
+ *
+ * This file is part of FRR.
+ *
+ * FRR is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * FRR is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FRR; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _ZEBRA_NHG_H
+#define _ZEBRA_NHG_H
+
+#include "nexthop_group.h"
+
+#include "zebra/rib.h"
+
+struct nhg_kernel;
+struct nhg_gate_links;
+
+/*
+ * Routes that carry the same set of nexthops and would resolve them the
+ * same way share one interned nexthop group.  re->ng.nexthop then points
+ * into the group's list, so code that only reads nexthops does not need
+ * to care; code that wants to modify them must call zebra_nhg_unshare()
+ * first.
+ *
+ * Routes whose nexthop resolution depends on the route itself (route-maps,
+ * static routes, nexthops inside their own prefix, ...) never share and
+ * keep a private list, with re->nhe being NULL.
+ */
+struct nhg_hash_entry {
+	afi_t afi;
+	vrf_id_t vrf_id;
+	int type;
+	/* route flags that influence resolution, ZEBRA_FLAG_ALLOW_RECURSION */
+	uint32_t flags;
+
+	struct nexthop_group nhg;
+
+	/*
+	 * Packed keys of the nexthops as interned, compared instead of the
+	 * nexthops themselves; like the hash key they are computed once,
+	 * the nexthops change while resolving.
+	 */
+	struct nexthop_key *keys;
+	unsigned int num_keys;
+	uint32_t key;
+
+	/* number of routes using the group */
+	uint32_t refcnt;
+	/* route nodes of those linked into the RIB, see zebra_nhg_link() */
+	struct list *routes;
+	/* where the group is listed with its nexthops' gateways */
+	struct nhg_gate_links *gates;
+	/* number of those installed in the kernel */
+	uint32_t installed;
+
+	/* bumped whenever resolution changed the group */
+	uint32_t version;
+	/* last batch of changed nexthops the group was queued for */
+	uint32_t changed_seq;
+
+	/* result of the last resolution, valid for resolved_epoch */
+	uint32_t resolved_epoch;
+	uint8_t active_num;
+	uint32_t nexthop_mtu;
+
+	/* the group's kernel nexthop object, if any, owned by rt_netlink.c */
+	struct nhg_kernel *kernel;
+};
+
+extern void zebra_nhg_init(void);
+
+/*
+ * Moves the nexthops of a route that is about to be added to the RIB into
+ * a shared group, if the route qualifies.
+ */
+extern void zebra_nhg_intern(struct route_entry *re, afi_t afi, safi_t safi,
+			     struct prefix *p, struct prefix_ipv6 *src_p);
+
+/* Drops the route's nexthops, freeing the group with its last user. */
+extern void zebra_nhg_release(struct route_entry *re);
+
+/* Gives the route a private copy of its nexthops. */
+extern void zebra_nhg_unshare(struct route_entry *re);
+
+/*
+ * Mark the route's nexthops as installed in / removed from the kernel.
+ * A shared group keeps its FIB flags while any of its routes is installed.
+ */
+extern void zebra_nhg_fib_set(struct route_entry *re);
+extern void zebra_nhg_fib_unset(struct route_entry *re);
+
+/* Whether the route itself is installed in the kernel. */
+extern bool zebra_nhg_in_fib(struct route_entry *re);
+
+/*
+ * Keep track of a route linked into / unlinked from rn if it resolves
+ * nexthops over other routes, so that it is found again when those change.
+ */
+extern void zebra_nhg_link(struct route_node *rn, struct route_entry *re);
+extern void zebra_nhg_unlink(struct route_entry *re);
+
+/*
+ * The tracked nexthops in 'changed', host prefixes of the given family,
+ * resolve differently now.  Queues the routes with nexthops via those
+ * gateways for processing, marked as changed: for a shared group the
+ * resolution is then redone once, when the first of its routes is
+ * processed.  The routes are found through an index of the gateways, the
+ * work is in proportion to the routes queued.
+ */
+extern void zebra_nhg_nexthops_changed(vrf_id_t vrf_id, int family,
+				       struct route_table *changed);
+
+/*
+ * Anything nexthop resolution looks at has changed, every group needs to
+ * be resolved again.
+ */
+extern void zebra_nhg_invalidate(void);
+
+/*
+ * If the route's group was already resolved since the last invalidation,
+ * copy the result into the route and return true.
+ */
+extern bool zebra_nhg_resolved(struct route_entry *re);
+
+/*
+ * Record that the route's group was just resolved; 'changed' tells whether
+ * the outcome differs from before.  Flags the route as changed if another
+ * route sharing the group saw a change it has not caught up with yet.
+ */
+extern void zebra_nhg_resolve_done(struct route_entry *re, bool set,
+				   bool changed);
+
+#endif /* _ZEBRA_NHG_H */
@@ -139,6 +139,10 @@ int zebra_ns_enable(ns_id_t ns_id, void **info)
 	zns->rules_hash =
 		hash_create_size(8, zebra_pbr_rules_hash_key,
 				 zebra_pbr_rules_hash_equal, "Rules Hash");
+	zns->rules_unique_hash =
+		hash_create_size(8, zebra_pbr_rules_unique_hash_key,
+				 zebra_pbr_rules_unique_hash_equal,
+				 "Rules Unique Hash");
 
 #if defined(HAVE_RTADV)
 	rtadv_init(zns);
@@ -237,7 +241,7 @@ static void zebra_ns_free_table(struct zebra_ns_table *znst)
 
 	table_info = znst->table->info;
 	route_table_finish(znst->table);
-	XFREE(MTYPE_RIB_TABLE_INFO, table_info);
+	rib_table_info_free(table_info);
 	XFREE(MTYPE_ZEBRA_NS, znst);
 }
 
@@ -246,6 +250,8 @@ int zebra_ns_disable(ns_id_t ns_id, void **info)
 	struct zebra_ns_table *znst;
 	struct zebra_ns *zns = (struct zebra_ns *)(*info);
 
+	hash_clean(zns->rules_unique_hash, NULL);
+	hash_free(zns->rules_unique_hash);
 	hash_clean(zns->rules_hash, zebra_pbr_rules_free);
 	hash_free(zns->rules_hash);
 	while (!RB_EMPTY(zebra_ns_table_head, &zns->ns_tables)) {
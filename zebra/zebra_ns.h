@@ -57,7 +57,10 @@ struct zebra_ns {
 #ifdef HAVE_NETLINK
 	struct nlsock netlink;     /* kernel messages */
 	struct nlsock netlink_cmd; /* command channel */
+	struct nlsock netlink_dplane; /* route updates, dataplane pthread */
 	struct thread *t_netlink;
+	/* t_netlink is on the netlink reader pthread */
+	bool netlink_async;
 #endif
 
 	struct route_table *if_table;
@@ -72,6 +75,8 @@ struct zebra_ns {
 	struct zebra_ns_table_head ns_tables;
 
 	struct hash *rules_hash;
+	/* the same rules by their unique id, for replacing them */
+	struct hash *rules_unique_hash;
 
 	/* Back pointer */
 	struct ns *ns;
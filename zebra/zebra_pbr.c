@@ -99,34 +99,37 @@ int zebra_pbr_rules_hash_equal(const void *arg1, const void *arg2)
 	return 1;
 }
 
-struct pbr_unique_lookup {
-	struct zebra_pbr_rule *rule;
-	uint32_t unique;
-};
-
-static int pbr_rule_lookup_unique_walker(struct hash_backet *b, void *data)
+uint32_t zebra_pbr_rules_unique_hash_key(void *arg)
 {
-	struct pbr_unique_lookup *pul = data;
-	struct zebra_pbr_rule *rule = b->data;
+	struct zebra_pbr_rule *rule = arg;
 
-	if (pul->unique == rule->unique) {
-		pul->rule = rule;
-		return HASHWALK_ABORT;
-	}
+	return jhash_1word(rule->unique, 0);
+}
 
-	return HASHWALK_CONTINUE;
+int zebra_pbr_rules_unique_hash_equal(const void *arg1, const void *arg2)
+{
+	const struct zebra_pbr_rule *r1 = arg1;
+	const struct zebra_pbr_rule *r2 = arg2;
+
+	return r1->unique == r2->unique;
 }
 
 static struct zebra_pbr_rule *pbr_rule_lookup_unique(struct zebra_ns *zns,
 						     uint32_t unique)
 {
-	struct pbr_unique_lookup pul;
+	struct zebra_pbr_rule lookup;
 
-	pul.unique = unique;
-	pul.rule = NULL;
-	hash_walk(zns->rules_hash, &pbr_rule_lookup_unique_walker, &pul);
+	lookup.unique = unique;
+	return hash_lookup(zns->rules_unique_hash, &lookup);
+}
 
-	return pul.rule;
+/* Forget about rule, which the kernel has been asked to delete */
+static void pbr_rule_release(struct zebra_ns *zns, struct zebra_pbr_rule *rule)
+{
+	hash_release(zns->rules_hash, rule);
+	if (pbr_rule_lookup_unique(zns, rule->unique) == rule)
+		hash_release(zns->rules_unique_hash, rule);
+	XFREE(MTYPE_TMP, rule);
 }
 
 static void *pbr_rule_alloc_intern(void *arg)
@@ -147,16 +150,32 @@ void zebra_pbr_add_rule(struct zebra_ns *zns, struct zebra_pbr_rule *rule)
 {
 	struct zebra_pbr_rule *unique =
 		pbr_rule_lookup_unique(zns, rule->unique);
+	struct zebra_pbr_rule *new;
+
+	/*
+	 * The kernel would happily hold the same rule twice, so a rule we
+	 * know already is not sent again, its owner just hears it is there.
+	 */
+	if (unique && zebra_pbr_rules_hash_equal(unique, rule)) {
+		unique->sock = rule->sock;
+		zsend_rule_notify_owner(unique, ZAPI_RULE_INSTALLED);
+		return;
+	}
 
-	(void)hash_get(zns->rules_hash, rule, pbr_rule_alloc_intern);
+	new = hash_get(zns->rules_hash, rule, pbr_rule_alloc_intern);
+	if (unique)
+		hash_release(zns->rules_unique_hash, unique);
+	(void)hash_get(zns->rules_unique_hash, new, hash_alloc_intern);
 	kernel_add_pbr_rule(rule);
 
 	/*
 	 * Rule Replace semantics, if we have an old, install the
 	 * new rule, look above, and then delete the old
 	 */
-	if (unique)
-		zebra_pbr_del_rule(zns, unique);
+	if (unique) {
+		kernel_del_pbr_rule(unique);
+		pbr_rule_release(zns, unique);
+	}
 }
 
 void zebra_pbr_del_rule(struct zebra_ns *zns, struct zebra_pbr_rule *rule)
@@ -166,10 +185,9 @@ void zebra_pbr_del_rule(struct zebra_ns *zns, struct zebra_pbr_rule *rule)
 	lookup = hash_lookup(zns->rules_hash, rule);
 	kernel_del_pbr_rule(rule);
 
-	if (lookup) {
-		hash_release(zns->rules_hash, lookup);
-		XFREE(MTYPE_TMP, lookup);
-	} else
+	if (lookup)
+		pbr_rule_release(zns, lookup);
+	else
 		zlog_warn("%s: Rule being deleted we know nothing about",
 			  __PRETTY_FUNCTION__);
 }
@@ -182,8 +200,7 @@ static void zebra_pbr_cleanup_rules(struct hash_backet *b, void *data)
 
 	if (rule->sock == *sock) {
 		kernel_del_pbr_rule(rule);
-		hash_release(zns->rules_hash, rule);
-		XFREE(MTYPE_TMP, rule);
+		pbr_rule_release(zns, rule);
 	}
 }
 
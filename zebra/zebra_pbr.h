@@ -137,5 +137,8 @@ extern void zebra_pbr_client_close_cleanup(int sock);
 extern void zebra_pbr_rules_free(void *arg);
 extern uint32_t zebra_pbr_rules_hash_key(void *arg);
 extern int zebra_pbr_rules_hash_equal(const void *arg1, const void *arg2);
+extern uint32_t zebra_pbr_rules_unique_hash_key(void *arg);
+extern int zebra_pbr_rules_unique_hash_equal(const void *arg1,
+					     const void *arg2);
 
 #endif /* _ZEBRA_PBR_H */
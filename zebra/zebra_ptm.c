@@ -218,6 +218,22 @@ static int zebra_ptm_send_message(char *data, int size)
 	return 0;
 }
 
+/* Buffers a message for PTM, sent by zebra_ptm_flush_queued(). */
+static void zebra_ptm_queue_message(char *data, int size)
+{
+	buffer_put(ptm_cb.wb, data, size);
+}
+
+/* Writes out what zebra_ptm_queue_message() buffered, in one go. */
+static void zebra_ptm_flush_queued(void)
+{
+	if (ptm_cb.ptm_sock == -1 || buffer_empty(ptm_cb.wb))
+		return;
+
+	if (!ptm_cb.t_write)
+		zebra_ptm_flush_messages(NULL);
+}
+
 int zebra_ptm_connect(struct thread *t)
 {
 	int init = 0;
@@ -660,10 +676,11 @@ int zebra_ptm_sock_read(struct thread *thread)
 	return 0;
 }
 
-/* BFD peer/dst register/update */
-void zebra_ptm_bfd_dst_register(ZAPI_HANDLER_ARGS)
+/* Forwards one peer of the message to PTM. */
+static int zebra_ptm_bfd_dst_register_one(struct zserv *client,
+					  struct stream *s,
+					  struct zebra_vrf *zvrf)
 {
-	struct stream *s;
 	struct prefix src_p;
 	struct prefix dst_p;
 	uint8_t multi_hop;
@@ -679,22 +696,6 @@ void zebra_ptm_bfd_dst_register(ZAPI_HANDLER_ARGS)
 	int data_len = ZEBRA_PTM_SEND_MAX_SOCKBUF;
 	unsigned int pid;
 
-	if (hdr->command == ZEBRA_BFD_DEST_UPDATE)
-		client->bfd_peer_upd8_cnt++;
-	else
-		client->bfd_peer_add_cnt++;
-
-	if (IS_ZEBRA_DEBUG_EVENT)
-		zlog_debug("bfd_dst_register msg from client %s: length=%d",
-			   zebra_route_string(client->proto), hdr->length);
-
-	if (ptm_cb.ptm_sock == -1) {
-		ptm_cb.t_timer = NULL;
-		thread_add_timer(zebrad.master, zebra_ptm_connect, NULL,
-				 ptm_cb.reconnect_time, &ptm_cb.t_timer);
-		return;
-	}
-
 	ptm_lib_init_msg(ptm_hdl, 0, PTMLIB_MSG_TYPE_CMD, NULL, &out_ctxt);
 	sprintf(tmp_buf, "%s", ZEBRA_PTM_BFD_START_CMD);
 	ptm_lib_append_msg(ptm_hdl, out_ctxt, ZEBRA_PTM_CMD_STR, tmp_buf);
@@ -702,8 +703,6 @@ void zebra_ptm_bfd_dst_register(ZAPI_HANDLER_ARGS)
 	ptm_lib_append_msg(ptm_hdl, out_ctxt, ZEBRA_PTM_BFD_CLIENT_FIELD,
 			   tmp_buf);
 
-	s = msg;
-
 	STREAM_GETL(s, pid);
 	sprintf(tmp_buf, "%d", pid);
 	ptm_lib_append_msg(ptm_hdl, out_ctxt, ZEBRA_PTM_BFD_SEQID_FIELD,
@@ -813,18 +812,47 @@ void zebra_ptm_bfd_dst_register(ZAPI_HANDLER_ARGS)
 	if (IS_ZEBRA_DEBUG_SEND)
 		zlog_debug("%s: Sent message (%d) %s", __func__, data_len,
 			   ptm_cb.out_data);
-	zebra_ptm_send_message(ptm_cb.out_data, data_len);
+	zebra_ptm_queue_message(ptm_cb.out_data, data_len);
 
-	return;
+	return 0;
 
 stream_failure:
 	ptm_lib_cleanup_msg(ptm_hdl, out_ctxt);
+	return -1;
 }
 
-/* BFD peer/dst deregister */
-void zebra_ptm_bfd_dst_deregister(ZAPI_HANDLER_ARGS)
+/* BFD peer/dst register/update */
+void zebra_ptm_bfd_dst_register(ZAPI_HANDLER_ARGS)
+{
+	if (IS_ZEBRA_DEBUG_EVENT)
+		zlog_debug("bfd_dst_register msg from client %s: length=%d",
+			   zebra_route_string(client->proto), hdr->length);
+
+	if (ptm_cb.ptm_sock == -1) {
+		ptm_cb.t_timer = NULL;
+		thread_add_timer(zebrad.master, zebra_ptm_connect, NULL,
+				 ptm_cb.reconnect_time, &ptm_cb.t_timer);
+		return;
+	}
+
+	/* Peers may come several to a message. */
+	while (STREAM_READABLE(msg) > 0) {
+		if (hdr->command == ZEBRA_BFD_DEST_UPDATE)
+			client->bfd_peer_upd8_cnt++;
+		else
+			client->bfd_peer_add_cnt++;
+		if (zebra_ptm_bfd_dst_register_one(client, msg, zvrf) < 0)
+			break;
+	}
+
+	zebra_ptm_flush_queued();
+}
+
+/* Forwards one peer of the message to PTM. */
+static int zebra_ptm_bfd_dst_deregister_one(struct zserv *client,
+					    struct stream *s,
+					    struct zebra_vrf *zvrf)
 {
-	struct stream *s;
 	struct prefix src_p;
 	struct prefix dst_p;
 	uint8_t multi_hop;
@@ -836,19 +864,6 @@ void zebra_ptm_bfd_dst_deregister(ZAPI_HANDLER_ARGS)
 	void *out_ctxt;
 	unsigned int pid;
 
-	client->bfd_peer_del_cnt++;
-
-	if (IS_ZEBRA_DEBUG_EVENT)
-		zlog_debug("bfd_dst_deregister msg from client %s: length=%d",
-			   zebra_route_string(client->proto), hdr->length);
-
-	if (ptm_cb.ptm_sock == -1) {
-		ptm_cb.t_timer = NULL;
-		thread_add_timer(zebrad.master, zebra_ptm_connect, NULL,
-				 ptm_cb.reconnect_time, &ptm_cb.t_timer);
-		return;
-	}
-
 	ptm_lib_init_msg(ptm_hdl, 0, PTMLIB_MSG_TYPE_CMD, NULL, &out_ctxt);
 
 	sprintf(tmp_buf, "%s", ZEBRA_PTM_BFD_STOP_CMD);
@@ -858,8 +873,6 @@ void zebra_ptm_bfd_dst_deregister(ZAPI_HANDLER_ARGS)
 	ptm_lib_append_msg(ptm_hdl, out_ctxt, ZEBRA_PTM_BFD_CLIENT_FIELD,
 			   tmp_buf);
 
-	s = msg;
-
 	STREAM_GETL(s, pid);
 	sprintf(tmp_buf, "%d", pid);
 	ptm_lib_append_msg(ptm_hdl, out_ctxt, ZEBRA_PTM_BFD_SEQID_FIELD,
@@ -943,12 +956,37 @@ void zebra_ptm_bfd_dst_deregister(ZAPI_HANDLER_ARGS)
 		zlog_debug("%s: Sent message (%d) %s", __func__, data_len,
 			   ptm_cb.out_data);
 
-	zebra_ptm_send_message(ptm_cb.out_data, data_len);
+	zebra_ptm_queue_message(ptm_cb.out_data, data_len);
 
-	return;
+	return 0;
 
 stream_failure:
 	ptm_lib_cleanup_msg(ptm_hdl, out_ctxt);
+	return -1;
+}
+
+/* BFD peer/dst deregister */
+void zebra_ptm_bfd_dst_deregister(ZAPI_HANDLER_ARGS)
+{
+	if (IS_ZEBRA_DEBUG_EVENT)
+		zlog_debug("bfd_dst_deregister msg from client %s: length=%d",
+			   zebra_route_string(client->proto), hdr->length);
+
+	if (ptm_cb.ptm_sock == -1) {
+		ptm_cb.t_timer = NULL;
+		thread_add_timer(zebrad.master, zebra_ptm_connect, NULL,
+				 ptm_cb.reconnect_time, &ptm_cb.t_timer);
+		return;
+	}
+
+	/* Peers may come several to a message. */
+	while (STREAM_READABLE(msg) > 0) {
+		client->bfd_peer_del_cnt++;
+		if (zebra_ptm_bfd_dst_deregister_one(client, msg, zvrf) < 0)
+			break;
+	}
+
+	zebra_ptm_flush_queued();
 }
 
 /* BFD client register */
@@ -26,6 +26,39 @@
 #include "zebra/zebra_ptm_redistribute.h"
 #include "zebra/zebra_memory.h"
 
+/*
+ * BFD status changes come in bursts, e.g. when a link carrying many sessions
+ * goes down.  The updates for a client are collected, several to a stream,
+ * and queued for it once the burst is over or the stream is full.
+ */
+#define ZSERV_BFD_UPDATE_SIZE (ZEBRA_HEADER_SIZE + 4 + 2 * (1 + 16 + 1) + 4)
+
+static struct thread *t_bfd_update;
+
+static void zsend_interface_bfd_flush_client(struct zserv *client)
+{
+	struct stream *s = client->bfd_update;
+
+	if (!s)
+		return;
+
+	client->bfd_update = NULL;
+	zebra_server_send_message(client, s);
+}
+
+static int zsend_interface_bfd_flush(struct thread *thread)
+{
+	struct listnode *node;
+	struct zserv *client;
+
+	t_bfd_update = NULL;
+
+	for (ALL_LIST_ELEMENTS_RO(zebrad.client_list, node, client))
+		zsend_interface_bfd_flush_client(client);
+
+	return 0;
+}
+
 static int zsend_interface_bfd_update(int cmd, struct zserv *client,
 				      struct interface *ifp, struct prefix *dp,
 				      struct prefix *sp, int status,
@@ -33,12 +66,21 @@ static int zsend_interface_bfd_update(int cmd, struct zserv *client,
 {
 	int blen;
 	struct stream *s;
+	size_t start;
 
 	/* Check this client need interface information. */
 	if (!client->ifinfo)
 		return 0;
 
-	s = stream_new(ZEBRA_MAX_PACKET_SIZ);
+	if (client->bfd_update
+	    && STREAM_WRITEABLE(client->bfd_update) < ZSERV_BFD_UPDATE_SIZE)
+		zsend_interface_bfd_flush_client(client);
+
+	if (!client->bfd_update)
+		client->bfd_update = stream_new(ZEBRA_MAX_PACKET_SIZ);
+
+	s = client->bfd_update;
+	start = stream_get_endp(s);
 
 	zclient_create_header(s, cmd, vrf_id);
 	if (ifp)
@@ -62,10 +104,12 @@ static int zsend_interface_bfd_update(int cmd, struct zserv *client,
 	stream_putc(s, sp->prefixlen);
 
 	/* Write packet size. */
-	stream_putw_at(s, 0, stream_get_endp(s));
+	stream_putw_at(s, start, stream_get_endp(s) - start);
 
 	client->if_bfd_cnt++;
-	return zebra_server_send_message(client, s);
+	thread_add_event(zebrad.master, zsend_interface_bfd_flush, NULL, 0,
+			 &t_bfd_update);
+	return 0;
 }
 
 void zebra_interface_bfd_update(struct interface *ifp, struct prefix *dp,
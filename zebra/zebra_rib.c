@@ -51,6 +51,15 @@
 #include "zebra/interface.h"
 #include "zebra/connected.h"
 #include "zebra/zebra_vxlan.h"
+#include "zebra/zebra_dplane.h"
+#include "zebra/zebra_nhg.h"
+#include "trace.h"
+
+DEFINE_TRACEPOINT(ZEBRA_RIB_ADD,
+		  "vrf %U %P from %S instance %U, distance %U metric %U")
+DEFINE_TRACEPOINT(ZEBRA_RIB_DELETE, "vrf %U %P from %S instance %U, table %U")
+DEFINE_TRACEPOINT(ZEBRA_RIB_PROCESS,
+		  "vrf %U %P, FIB route type %U now type %U")
 
 DEFINE_HOOK(rib_update, (struct route_node * rn, const char *reason),
 	    (rn, reason))
@@ -394,6 +403,75 @@ static void nexthop_set_resolved(afi_t afi, struct nexthop *newhop,
 	nexthop_add(&nexthop->resolved, resolved_hop);
 }
 
+/*
+ * Most recursive nexthops of a large feed resolve over a handful of
+ * addresses, yet every one of them walks the table. Per-table
+ * direct-mapped cache of route_node_match() results, only valid for as
+ * long as no node of the table gains or loses a rib_dest_t.
+ */
+#define RIB_LOOKUP_CACHE_SIZE 1024
+
+struct rib_lookup_cache {
+	struct {
+		unsigned int gen;
+		struct prefix p;
+		struct route_node *rn;
+	} slots[RIB_LOOKUP_CACHE_SIZE];
+};
+
+static inline void rib_table_changed(struct route_node *rn)
+{
+	rib_table_info_t *info = srcdest_rnode_table_info(rn);
+
+	if (info)
+		info->gen++;
+}
+
+struct route_node *rib_route_node_match(struct route_table *table,
+					const struct prefix *p)
+{
+	rib_table_info_t *info = table->info;
+	struct rib_lookup_cache *cache;
+	struct route_node *rn;
+	unsigned int slot;
+
+	if (!info || (p->family != AF_INET && p->family != AF_INET6))
+		return route_node_match(table, p);
+
+	if (!info->lookup_cache) {
+		info->lookup_cache = XCALLOC(MTYPE_RIB_LOOKUP_CACHE,
+					     sizeof(struct rib_lookup_cache));
+		/* slots start out with generation 0 */
+		info->gen++;
+	}
+	cache = info->lookup_cache;
+
+	slot = prefix_hash_key((void *)p) % RIB_LOOKUP_CACHE_SIZE;
+	if (cache->slots[slot].gen == info->gen
+	    && prefix_same(&cache->slots[slot].p, p)) {
+		rn = cache->slots[slot].rn;
+		return rn ? route_lock_node(rn) : NULL;
+	}
+
+	rn = route_node_match(table, p);
+
+	cache->slots[slot].gen = info->gen;
+	prefix_copy(&cache->slots[slot].p, p);
+	cache->slots[slot].rn = rn;
+
+	return rn;
+}
+
+void rib_table_info_free(rib_table_info_t *info)
+{
+	if (!info)
+		return;
+
+	route_table_walk_cancel(&info->t_sweep);
+	XFREE(MTYPE_RIB_LOOKUP_CACHE, info->lookup_cache);
+	XFREE(MTYPE_RIB_TABLE_INFO, info);
+}
+
 /* If force flag is not set, do not modify falgs at all for uninstall
    the route from FIB. */
 static int nexthop_active(afi_t afi, struct route_entry *re,
@@ -468,7 +546,7 @@ static int nexthop_active(afi_t afi, struct route_entry *re,
 	if (!table)
 		return 0;
 
-	rn = route_node_match(table, (struct prefix *)&p);
+	rn = rib_route_node_match(table, &p);
 	while (rn) {
 		route_unlock_node(rn);
 
@@ -822,9 +900,6 @@ int rib_lookup_ipv4_route(struct prefix_ipv4 *p, union sockunion *qgate,
 	return ZEBRA_RIB_NOTFOUND;
 }
 
-#define RIB_SYSTEM_ROUTE(R)                                                    \
-	((R)->type == ZEBRA_ROUTE_KERNEL || (R)->type == ZEBRA_ROUTE_CONNECT)
-
 /* This function verifies reachability of one given nexthop, which can be
  * numbered or unnumbered, IPv4 or IPv6. The result is unconditionally stored
  * in nexthop->flags field. If the 4th parameter, 'set', is non-zero,
@@ -958,9 +1033,14 @@ static int nexthop_active_update(struct route_node *rn, struct route_entry *re,
 	ifindex_t prev_index;
 	old_num_nh = re->nexthop_active_num;
 
-	re->nexthop_active_num = 0;
 	UNSET_FLAG(re->status, ROUTE_ENTRY_CHANGED);
 
+	/* Another route sharing the nexthops did the work already */
+	if (zebra_nhg_resolved(re))
+		goto out;
+
+	re->nexthop_active_num = 0;
+
 	for (nexthop = re->ng.nexthop; nexthop; nexthop = nexthop->next) {
 		/* No protocol daemon provides src and so we're skipping
 		 * tracking it */
@@ -984,6 +1064,10 @@ static int nexthop_active_update(struct route_node *rn, struct route_entry *re,
 		}
 	}
 
+	zebra_nhg_resolve_done(re, set,
+			       CHECK_FLAG(re->status, ROUTE_ENTRY_CHANGED));
+
+out:
 	if (old_num_nh != re->nexthop_active_num)
 		SET_FLAG(re->status, ROUTE_ENTRY_CHANGED);
 
@@ -1012,28 +1096,210 @@ int zebra_rib_labeled_unicast(struct route_entry *re)
 	return 1;
 }
 
+/* Counter slot of re in rib_table_info_t. */
+static inline int rib_count_type(struct route_entry *re)
+{
+	if (re->type == ZEBRA_ROUTE_BGP
+	    && CHECK_FLAG(re->flags, ZEBRA_FLAG_IBGP))
+		return ZEBRA_ROUTE_IBGP;
+
+	return re->type;
+}
+
+static void rib_count(uint32_t *cnt, struct route_entry *re, int delta)
+{
+	cnt[rib_count_type(re)] += delta;
+	cnt[ZEBRA_ROUTE_TOTAL] += delta;
+}
+
+/* Set or clear ZEBRA_FLAG_SELECTED on re, keeping the FIB counters. */
+static void rib_re_selected(struct route_node *rn, struct route_entry *re,
+			    bool selected)
+{
+	rib_table_info_t *info;
+
+	if (selected == !!CHECK_FLAG(re->flags, ZEBRA_FLAG_SELECTED))
+		return;
+
+	info = srcdest_rnode_table_info(rn);
+	if (selected) {
+		SET_FLAG(re->flags, ZEBRA_FLAG_SELECTED);
+		rib_count(info->fib_cnt, re, 1);
+	} else {
+		UNSET_FLAG(re->flags, ZEBRA_FLAG_SELECTED);
+		rib_count(info->fib_cnt, re, -1);
+	}
+}
+
+/*
+ * rib_process() held back redistribution of the selected route until its
+ * FIB route is installed; now the kernel has answered.
+ */
+static void rib_redistribute_pending(struct route_node *rn, rib_dest_t *dest,
+				     bool installed)
+{
+	struct route_entry *re;
+	struct prefix *p, *src_p;
+
+	if (!CHECK_FLAG(dest->flags, RIB_DEST_REDIST_PENDING))
+		return;
+	UNSET_FLAG(dest->flags, RIB_DEST_REDIST_PENDING);
+
+	srcdest_rnode_prefixes(rn, &p, &src_p);
+	RE_DEST_FOREACH_ROUTE (dest, re) {
+		if (!CHECK_FLAG(re->flags, ZEBRA_FLAG_SELECTED))
+			continue;
+
+		if (installed)
+			redistribute_update(p, src_p, re, NULL);
+		else {
+			redistribute_delete(p, src_p, re);
+			rib_re_selected(rn, re, false);
+		}
+		break;
+	}
+}
+
+/*
+ * Remember that the routes of rn changed, so that the tracked nexthops
+ * which may resolve through it get evaluated once the queue is done.
+ */
+static void rib_nht_changed(struct route_node *rn)
+{
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+	struct zebra_vrf *zvrf;
+	struct route_table *table;
+	struct route_node *crn;
+	unsigned long tracked;
+	afi_t afi;
+
+	if (!dest)
+		return;
+
+	zvrf = rib_dest_vrf(dest);
+	afi = family2afi(rn->p.family);
+
+	/* Nexthops only resolve through the unicast table, and through
+	 * destination nodes of it.
+	 */
+	if (!zvrf || (afi != AFI_IP && afi != AFI_IP6)
+	    || rib_dest_table(dest) != zvrf->table[afi][SAFI_UNICAST])
+		return;
+
+	zvrf->flags |= ZEBRA_VRF_RIB_SCHEDULED;
+	if (zvrf->nht_all[afi])
+		return;
+
+	tracked = 0;
+	if (zvrf->rnh_table[afi])
+		tracked += zvrf->rnh_table[afi]->count;
+	if (zvrf->import_check_table[afi])
+		tracked += zvrf->import_check_table[afi]->count;
+
+	if (!zvrf->nht_changed[afi])
+		zvrf->nht_changed[afi] = route_table_init();
+	table = zvrf->nht_changed[afi];
+
+	/* Walking everything is cheaper than looking up that many. */
+	if (table->count >= tracked) {
+		route_table_finish(table);
+		zvrf->nht_changed[afi] = NULL;
+		zvrf->nht_all[afi] = true;
+		return;
+	}
+
+	crn = route_node_get(table, &rn->p);
+	if (crn->info)
+		route_unlock_node(crn);
+	crn->info = zvrf;
+}
+
+struct pipeline_stage rib_pipeline[RIB_PIPELINE_STAGES] = {
+	[RIB_PIPELINE_ZAPI] = {"zapi", "Client sent the route, until read"},
+	[RIB_PIPELINE_QUEUE] = {"rib-queue", "Read, until processed"},
+	[RIB_PIPELINE_KERNEL] = {"kernel",
+				 "Processed, until the kernel acknowledged it"},
+	[RIB_PIPELINE_TOTAL] = {"total",
+				"Client read the update, until the kernel "
+				"acknowledged the route"},
+};
+
+void rib_pipeline_received(afi_t afi, safi_t safi, vrf_id_t vrf_id,
+			   uint32_t table_id, struct prefix *p,
+			   struct prefix_ipv6 *src_p, int64_t rx_usec,
+			   int64_t tx_usec)
+{
+	struct route_table *table;
+	struct route_node *rn;
+	rib_dest_t *dest;
+	int64_t now = pipeline_now();
+
+	pipeline_stage_add(&rib_pipeline[RIB_PIPELINE_ZAPI], now - tx_usec);
+
+	table = zebra_vrf_table_with_table_id(afi, safi, vrf_id, table_id);
+	if (!table)
+		return;
+	rn = srcdest_rnode_lookup(table, p, src_p);
+	if (!rn)
+		return;
+
+	dest = rib_dest_from_rnode(rn);
+	if (dest) {
+		dest->pipeline_stamp = (uint32_t)now | 1;
+		dest->pipeline_age = MIN(MAX(now - rx_usec, 0), UINT32_MAX);
+	}
+	route_unlock_node(rn);
+}
+
+/* Ends a timed dest's current stage, and begins the next one */
+static void rib_pipeline_stage(rib_dest_t *dest, enum rib_pipeline_stage stage)
+{
+	uint32_t now = pipeline_now();
+	uint32_t usecs = now - dest->pipeline_stamp;
+
+	pipeline_stage_add(&rib_pipeline[stage], usecs);
+	dest->pipeline_age += usecs;
+	dest->pipeline_stamp = now | 1;
+}
+
 void kernel_route_rib_pass_fail(struct route_node *rn, struct prefix *p,
 				struct route_entry *re,
 				enum southbound_results res)
 {
-	struct nexthop *nexthop;
 	char buf[PREFIX_STRLEN];
 	rib_dest_t *dest;
 
-	dest = rib_dest_from_rnode(rn);
+	/* Both selected_fib and the FIB flags may change */
+	zebra_nhg_invalidate();
 
-	switch (res) {
-	case SOUTHBOUND_INSTALL_SUCCESS:
-		dest->selected_fib = re;
-		for (ALL_NEXTHOPS(re->ng, nexthop)) {
-			if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE))
-				continue;
+	/*
+	 * If re was unlinked while the kernel was working on it, it is not
+	 * part of the RIB anymore; its owner still gets to know the outcome.
+	 */
+	if (CHECK_FLAG(re->status, ROUTE_ENTRY_UNLINKED))
+		dest = NULL;
+	else
+		dest = rib_dest_from_rnode(rn);
 
-			if (CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE))
-				SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
-			else
-				UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+	if (dest)
+		rib_nht_changed(rn);
+
+	if (dest && dest->pipeline_stamp) {
+		if (res == SOUTHBOUND_INSTALL_SUCCESS) {
+			rib_pipeline_stage(dest, RIB_PIPELINE_KERNEL);
+			pipeline_stage_add(&rib_pipeline[RIB_PIPELINE_TOTAL],
+					   dest->pipeline_age);
 		}
+		dest->pipeline_stamp = 0;
+	}
+
+	switch (res) {
+	case SOUTHBOUND_INSTALL_SUCCESS:
+		if (dest)
+			dest->selected_fib = re;
+		zebra_nhg_fib_set(re);
+		if (dest)
+			rib_redistribute_pending(rn, dest, true);
 		zsend_route_notify_owner(re, p, ZAPI_ROUTE_INSTALLED);
 		break;
 	case SOUTHBOUND_INSTALL_FAILURE:
@@ -1042,7 +1308,10 @@ void kernel_route_rib_pass_fail(struct route_node *rn, struct prefix *p,
 		 * but the code always set selected_fib before
 		 * this assignment was moved here.
 		 */
-		dest->selected_fib = re;
+		if (dest) {
+			dest->selected_fib = re;
+			rib_redistribute_pending(rn, dest, false);
+		}
 
 		zsend_route_notify_owner(re, p, ZAPI_ROUTE_FAIL_INSTALL);
 		zlog_warn("%u:%s: Route install failed", re->vrf_id,
@@ -1056,10 +1325,9 @@ void kernel_route_rib_pass_fail(struct route_node *rn, struct prefix *p,
 		 * as such we should leave the selected_fib
 		 * pointer alone
 		 */
-		if (dest->selected_fib == re)
+		if (dest && dest->selected_fib == re)
 			dest->selected_fib = NULL;
-		for (ALL_NEXTHOPS(re->ng, nexthop))
-			UNSET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+		zebra_nhg_fib_unset(re);
 
 		zsend_route_notify_owner(re, p, ZAPI_ROUTE_REMOVED);
 		break;
@@ -1068,13 +1336,74 @@ void kernel_route_rib_pass_fail(struct route_node *rn, struct prefix *p,
 		 * Should we set this to NULL if the
 		 * delete fails?
 		 */
-		dest->selected_fib = NULL;
+		if (dest)
+			dest->selected_fib = NULL;
 		zlog_warn("%u:%s: Route Deletion failure", re->vrf_id,
 			  prefix2str(p, buf, sizeof(buf)));
 
 		zsend_route_notify_owner(re, p, ZAPI_ROUTE_REMOVE_FAIL);
 		break;
 	}
+
+	/*
+	 * The FPM sends whatever selected_fib is by the time it gets to
+	 * the dest, which may have been before the kernel was done.
+	 */
+	if (dest)
+		hook_call(rib_update, rn, "kernel update done");
+
+	/* the last answer for an unlinked re frees it */
+	if (!dest && !re->inflight)
+		route_entry_free(re);
+}
+
+/* Next nexthop of a route that goes into the kernel. */
+static struct nexthop *rib_kernel_nexthop(struct nexthop *nexthop)
+{
+	for (; nexthop; nexthop = nexthop_next(nexthop))
+		if (!CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_RECURSIVE)
+		    && CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_ACTIVE)
+		    && !CHECK_FLAG(nexthop->flags, NEXTHOP_FLAG_DUPLICATE))
+			return nexthop;
+	return NULL;
+}
+
+/*
+ * Whether installing re gives the kernel what it has for stale, a route
+ * read back from there.  The source address the kernel reported is in
+ * the nexthop's src; netlink installs the route-map one, if any.
+ */
+static bool rib_kernel_same(struct route_entry *stale, struct route_entry *re)
+{
+	struct nexthop *snh, *nh;
+	union g_addr *src;
+
+	if (stale == re)
+		return true;
+	if (stale->type != re->type || stale->mtu != re->mtu)
+		return false;
+
+	snh = rib_kernel_nexthop(stale->ng.nexthop);
+	nh = rib_kernel_nexthop(re->ng.nexthop);
+	while (snh && nh) {
+		if (!nexthop_same_firsthop(snh, nh)
+		    || snh->bh_type != nh->bh_type)
+			return false;
+		if ((snh->nh_label || nh->nh_label)
+		    && !nexthop_labels_match(snh, nh))
+			return false;
+
+		src = memcmp(&nh->rmap_src, &in6addr_any, sizeof(nh->rmap_src))
+			      ? &nh->rmap_src
+			      : &nh->src;
+		if (memcmp(&snh->src, src, sizeof(*src)))
+			return false;
+
+		snh = rib_kernel_nexthop(nexthop_next(snh));
+		nh = rib_kernel_nexthop(nexthop_next(nh));
+	}
+
+	return !snh && !nh;
 }
 
 /* Update flag indicates whether this is a "replace" or not. Currently, this
@@ -1083,6 +1412,7 @@ void kernel_route_rib_pass_fail(struct route_node *rn, struct prefix *p,
 void rib_install_kernel(struct route_node *rn, struct route_entry *re,
 			struct route_entry *old)
 {
+	struct route_entry *stale;
 	struct nexthop *nexthop;
 	rib_table_info_t *info = srcdest_rnode_table_info(rn);
 	struct prefix *p, *src_p;
@@ -1118,6 +1448,19 @@ void rib_install_kernel(struct route_node *rn, struct route_entry *re,
 	if (old && (old != re) && (old->type != re->type))
 		zsend_route_notify_owner(old, p, ZAPI_ROUTE_BETTER_ADMIN_WON);
 
+	/*
+	 * A route read back from the kernel after a restart is installed
+	 * already, and so is one that is just like the route it replaces.
+	 */
+	stale = CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE) ? re : old;
+	if (stale && CHECK_FLAG(stale->flags, ZEBRA_FLAG_SELFROUTE)
+	    && rib_kernel_same(stale, re)) {
+		hook_call(rib_update, rn, "installed in kernel");
+		kernel_route_rib_pass_fail(rn, p, re,
+					   SOUTHBOUND_INSTALL_SUCCESS);
+		return;
+	}
+
 	/*
 	 * Make sure we update the FPM any time we send new information to
 	 * the kernel.
@@ -1180,7 +1523,7 @@ static void rib_uninstall(struct route_node *rn, struct route_entry *re)
 		srcdest_rnode_prefixes(rn, &p, &src_p);
 
 		redistribute_delete(p, src_p, re);
-		UNSET_FLAG(re->flags, ZEBRA_FLAG_SELECTED);
+		rib_re_selected(rn, re, false);
 	}
 }
 
@@ -1195,12 +1538,21 @@ static int rib_can_delete_dest(rib_dest_t *dest)
 		return 0;
 	}
 
+	/* Still linked on the meta queue */
+	if (CHECK_FLAG(dest->flags, RIB_ROUTE_ANY_QUEUED))
+		return 0;
+
 	/*
 	 * Don't delete the dest if we have to update the FPM about this
 	 * prefix.
 	 */
 	if (CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_FPM)
-	    || CHECK_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM))
+	    || CHECK_FLAG(dest->flags, RIB_DEST_SENT_TO_FPM)
+	    || CHECK_FLAG(dest->flags, RIB_DEST_LOGGED_FPM))
+		return 0;
+
+	/* Or the ZeroMQ export. */
+	if (CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ))
 		return 0;
 
 	return 1;
@@ -1232,9 +1584,9 @@ int rib_gc_dest(struct route_node *rn)
 		rnode_debug(rn, zvrf_id(zvrf), "removing dest from table");
 	}
 
-	dest->rnode = NULL;
-	XFREE(MTYPE_RIB_DEST, dest);
+	rib_dest_free(dest);
 	rn->info = NULL;
+	rib_table_changed(rn);
 
 	/*
 	 * Release the one reference that we keep on the route node.
@@ -1318,7 +1670,6 @@ static void rib_process_update_fib(struct zebra_vrf *zvrf,
 				   struct route_entry *old,
 				   struct route_entry *new)
 {
-	struct nexthop *nexthop = NULL;
 	int nh_active = 0;
 	rib_dest_t *dest = rib_dest_from_rnode(rn);
 
@@ -1389,12 +1740,8 @@ static void rib_process_update_fib(struct zebra_vrf *zvrf,
 				if (RIB_SYSTEM_ROUTE(new)) {
 					if (!RIB_SYSTEM_ROUTE(old))
 						rib_uninstall_kernel(rn, old);
-				} else {
-					for (nexthop = old->ng.nexthop; nexthop;
-					     nexthop = nexthop->next)
-						UNSET_FLAG(nexthop->flags,
-							   NEXTHOP_FLAG_FIB);
-				}
+				} else
+					zebra_nhg_fib_unset(old);
 			}
 		}
 
@@ -1443,18 +1790,8 @@ static void rib_process_update_fib(struct zebra_vrf *zvrf,
 		 * is ready
 		 * to add routes.
 		 */
-		if (!RIB_SYSTEM_ROUTE(new)) {
-			bool in_fib = false;
-
-			for (ALL_NEXTHOPS(new->ng, nexthop))
-				if (CHECK_FLAG(nexthop->flags,
-					       NEXTHOP_FLAG_FIB)) {
-					in_fib = true;
-					break;
-				}
-			if (!in_fib)
-				rib_install_kernel(rn, new, NULL);
-		}
+		if (!RIB_SYSTEM_ROUTE(new) && !zebra_nhg_in_fib(new))
+			rib_install_kernel(rn, new, NULL);
 	}
 
 	/* Update prior route. */
@@ -1549,6 +1886,9 @@ static void rib_process(struct route_node *rn)
 	if (dest)
 		old_fib = dest->selected_fib;
 
+	if (dest && dest->pipeline_stamp)
+		rib_pipeline_stage(dest, RIB_PIPELINE_QUEUE);
+
 	RNODE_FOREACH_RE_SAFE (rn, re, next) {
 		if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 			zlog_debug(
@@ -1663,10 +2003,23 @@ static void rib_process(struct route_node *rn)
 			(void *)old_fib, (void *)new_fib);
 	}
 
+	trace_event(ZEBRA_RIB_PROCESS, p, NULL, vrf_id,
+		    old_fib ? old_fib->type : ZEBRA_ROUTE_MAX,
+		    new_fib ? new_fib->type : ZEBRA_ROUTE_MAX);
+
 	/* Buffer ROUTE_ENTRY_CHANGED here, because it will get cleared if
 	 * fib == selected */
 	bool selected_changed = new_selected && CHECK_FLAG(new_selected->status,
 							   ROUTE_ENTRY_CHANGED);
+	bool fib_changed = new_fib && CHECK_FLAG(new_fib->status,
+						 ROUTE_ENTRY_CHANGED);
+
+	/* Tracked nexthops resolving through this prefix only need another
+	 * look if the selected or FIB route changed; what the kernel makes
+	 * of it is noted from kernel_route_rib_pass_fail(). */
+	if (old_selected != new_selected || selected_changed
+	    || old_fib != new_fib || fib_changed)
+		rib_nht_changed(rn);
 
 	/* Update fib according to selection results */
 	if (new_fib && old_fib)
@@ -1678,19 +2031,20 @@ static void rib_process(struct route_node *rn)
 
 	/* Redistribute SELECTED entry */
 	if (old_selected != new_selected || selected_changed) {
-		struct nexthop *nexthop = NULL;
+		bool pending;
+
+		/* If the kernel has yet to confirm the FIB route, the selected
+		 * route is redistributed from kernel_route_rib_pass_fail() */
+		pending = new_fib && new_selected
+			  && new_fib->inflight;
+		if (pending)
+			SET_FLAG(dest->flags, RIB_DEST_REDIST_PENDING);
+		else if (dest)
+			UNSET_FLAG(dest->flags, RIB_DEST_REDIST_PENDING);
 
 		/* Check if we have a FIB route for the destination, otherwise,
 		 * don't redistribute it */
-		if (new_fib) {
-			for (ALL_NEXTHOPS(new_fib->ng, nexthop)) {
-				if (CHECK_FLAG(nexthop->flags,
-					       NEXTHOP_FLAG_FIB)) {
-					break;
-				}
-			}
-		}
-		if (!nexthop)
+		if (!new_fib || (!pending && !zebra_nhg_in_fib(new_fib)))
 			new_selected = NULL;
 
 		if (new_selected && new_selected != new_fib) {
@@ -1699,22 +2053,40 @@ static void rib_process(struct route_node *rn)
 		}
 
 		if (old_selected) {
-			if (!new_selected)
+			/* Clients of the old type only won't hear about the
+			 * new route, withdraw it from them now */
+			if (!new_selected
+			    || (pending && old_selected != new_selected
+				&& (old_selected->type != new_selected->type
+				    || old_selected->instance
+					       != new_selected->instance)))
 				redistribute_delete(p, src_p, old_selected);
 			if (old_selected != new_selected)
-				UNSET_FLAG(old_selected->flags,
-					   ZEBRA_FLAG_SELECTED);
+				rib_re_selected(rn, old_selected, false);
 		}
 
 		if (new_selected) {
 			/* Install new or replace existing redistributed entry
 			 */
-			SET_FLAG(new_selected->flags, ZEBRA_FLAG_SELECTED);
-			redistribute_update(p, src_p, new_selected,
-					    old_selected);
+			rib_re_selected(rn, new_selected, true);
+			if (!pending)
+				redistribute_update(p, src_p, new_selected,
+						    old_selected);
 		}
 	}
 
+	if (dest && dest->selected_fib != old_fib)
+		zebra_nhg_invalidate();
+
+	/* Timed routes not waiting for the kernel are done with */
+	if (dest && dest->pipeline_stamp) {
+		RNODE_FOREACH_RE (rn, re)
+			if (re->inflight)
+				break;
+		if (!re)
+			dest->pipeline_stamp = 0;
+	}
+
 	/* Remove all RE entries queued for removal */
 	RNODE_FOREACH_RE_SAFE (rn, re, next) {
 		if (CHECK_FLAG(re->status, ROUTE_ENTRY_REMOVED)) {
@@ -1732,26 +2104,32 @@ static void rib_process(struct route_node *rn)
 	rib_gc_dest(rn);
 }
 
-/* Take a list of route_node structs and return 1, if there was a record
- * picked from it and processed by rib_process(). Don't process more,
- * than one RN record; operate only in the specified sub-queue.
+/* Take the first dest off the specified (non-empty) sub-queue and run
+ * rib_process() on its route_node.
  */
-static unsigned int process_subq(struct list *subq, uint8_t qindex)
-{
-	struct listnode *lnode = listhead(subq);
-	struct route_node *rnode;
-	rib_dest_t *dest;
-	struct zebra_vrf *zvrf = NULL;
-
-	if (!lnode)
-		return 0;
-
-	rnode = listgetdata(lnode);
-	dest = rib_dest_from_rnode(rnode);
-	if (dest)
-		zvrf = rib_dest_vrf(dest);
-
+static void process_subq(struct meta_queue *mq, uint8_t qindex)
+{
+	rib_dest_t *dest = STAILQ_FIRST(&mq->subq[qindex]);
+	struct route_node *rnode = dest->rnode;
+	struct zebra_vrf *zvrf = rib_dest_vrf(dest);
+	struct timeval start;
+	uint64_t usecs;
+
+	/* Off the queue first, rib_process() may free the dest or queue it
+	 * again */
+	STAILQ_REMOVE_HEAD(&mq->subq[qindex], mq_entries[qindex]);
+	UNSET_FLAG(dest->flags, RIB_ROUTE_QUEUED(qindex));
+	mq->stats[qindex].len--;
+	mq->size--;
+
+	monotime(&start);
 	rib_process(rnode);
+	usecs = monotime_since(&start, NULL);
+
+	mq->stats[qindex].processed++;
+	mq->stats[qindex].usecs += usecs;
+	if (usecs > mq->stats[qindex].max_usecs)
+		mq->stats[qindex].max_usecs = usecs;
 
 	if (IS_ZEBRA_DEBUG_RIB_DETAILED) {
 		char buf[SRCDEST2STR_BUFFER];
@@ -1760,21 +2138,35 @@ static unsigned int process_subq(struct list *subq, uint8_t qindex)
 			   zvrf ? zvrf_id(zvrf) : 0, buf, rnode, qindex);
 	}
 
-	if (rnode->info)
-		UNSET_FLAG(rib_dest_from_rnode(rnode)->flags,
-			   RIB_ROUTE_QUEUED(qindex));
-
-#if 0
-  else
-    {
-      zlog_debug ("%s: called for route_node (%p, %d) with no ribs",
-                  __func__, rnode, rnode->lock);
-      zlog_backtrace(LOG_DEBUG);
-    }
-#endif
 	route_unlock_node(rnode);
-	list_delete_node(subq, lnode);
-	return 1;
+}
+
+/* Set while next-hop evaluation waits for the dataplane to catch up. */
+static bool rib_complete_deferred;
+
+/* Evaluate the tracked nexthops affected by the routes processed. */
+static void rib_evaluate_nht(struct zebra_vrf *zvrf, afi_t afi)
+{
+	struct route_table *changed = zvrf->nht_changed[afi];
+	int family = afi2family(afi);
+
+	zvrf->nht_changed[afi] = NULL;
+
+	if (zvrf->nht_all[afi]) {
+		zvrf->nht_all[afi] = false;
+		zebra_evaluate_rnh(zvrf_id(zvrf), family, 0, RNH_NEXTHOP_TYPE,
+				   NULL);
+		zebra_evaluate_rnh(zvrf_id(zvrf), family, 0,
+				   RNH_IMPORT_CHECK_TYPE, NULL);
+	} else if (changed) {
+		zebra_evaluate_rnh_changed(zvrf_id(zvrf), family,
+					   RNH_NEXTHOP_TYPE, changed);
+		zebra_evaluate_rnh_changed(zvrf_id(zvrf), family,
+					   RNH_IMPORT_CHECK_TYPE, changed);
+	}
+
+	if (changed)
+		route_table_finish(changed);
 }
 
 /*
@@ -1785,6 +2177,17 @@ static void meta_queue_process_complete(struct work_queue *dummy)
 	struct vrf *vrf;
 	struct zebra_vrf *zvrf;
 
+	/*
+	 * Nexthop tracking looks at what made it into the kernel, so let the
+	 * dataplane catch up first; rib_dplane_idle() gets us back here.
+	 */
+	kernel_route_rib_flush();
+	if (zebra_dplane_busy()) {
+		rib_complete_deferred = true;
+		return;
+	}
+	rib_complete_deferred = false;
+
 	/* Evaluate nexthops for those VRFs which underwent route processing.
 	 * This
 	 * should limit the evaluation to the necessary VRFs in most common
@@ -1796,14 +2199,8 @@ static void meta_queue_process_complete(struct work_queue *dummy)
 			continue;
 
 		zvrf->flags &= ~ZEBRA_VRF_RIB_SCHEDULED;
-		zebra_evaluate_rnh(zvrf_id(zvrf), AF_INET, 0, RNH_NEXTHOP_TYPE,
-				   NULL);
-		zebra_evaluate_rnh(zvrf_id(zvrf), AF_INET, 0,
-				   RNH_IMPORT_CHECK_TYPE, NULL);
-		zebra_evaluate_rnh(zvrf_id(zvrf), AF_INET6, 0, RNH_NEXTHOP_TYPE,
-				   NULL);
-		zebra_evaluate_rnh(zvrf_id(zvrf), AF_INET6, 0,
-				   RNH_IMPORT_CHECK_TYPE, NULL);
+		rib_evaluate_nht(zvrf, AFI_IP);
+		rib_evaluate_nht(zvrf, AFI_IP6);
 	}
 
 	/* Schedule LSPs for processing, if needed. */
@@ -1811,28 +2208,36 @@ static void meta_queue_process_complete(struct work_queue *dummy)
 	if (mpls_should_lsps_be_processed(zvrf)) {
 		if (IS_ZEBRA_DEBUG_MPLS)
 			zlog_debug(
-				"%u: Scheduling all LSPs upon RIB completion",
+				"%u: Scheduling affected LSPs upon RIB completion",
 				zvrf_id(zvrf));
 		zebra_mpls_lsp_schedule(zvrf);
 		mpls_unmark_lsps_for_processing(zvrf);
 	}
 }
 
+void rib_dplane_idle(void)
+{
+	if (rib_complete_deferred)
+		meta_queue_process_complete(zebrad.ribq);
+}
+
 /* Dispatch the meta queue by picking, processing and unlocking the next RN from
- * a non-empty sub-queue with lowest priority. wq is equal to zebra->ribq and
- * data
- * is pointed to the meta queue structure.
+ * a non-empty sub-queue with lowest priority, up to zebrad.rib_batch of them
+ * before the work queue gets to check whether to yield. wq is equal to
+ * zebra->ribq and data is pointed to the meta queue structure.
  */
 static wq_item_status meta_queue_process(struct work_queue *dummy, void *data)
 {
 	struct meta_queue *mq = data;
+	uint32_t batch = zebrad.rib_batch;
 	unsigned i;
 
-	for (i = 0; i < MQ_SIZE; i++)
-		if (process_subq(mq->subq[i], i)) {
-			mq->size--;
-			break;
-		}
+	while (mq->size && batch--) {
+		/* rib_process() may have queued to a higher priority one */
+		for (i = 0; STAILQ_EMPTY(&mq->subq[i]); i++)
+			;
+		process_subq(mq, i);
+	}
 	return mq->size ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
@@ -1873,13 +2278,14 @@ static void rib_meta_queue_add(struct meta_queue *mq, struct route_node *rn)
 {
 	struct route_entry *re;
 
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
+
 	RNODE_FOREACH_RE (rn, re) {
 		uint8_t qindex = meta_queue_map[re->type];
 		struct zebra_vrf *zvrf;
 
 		/* Invariant: at this point we always have rn->info set. */
-		if (CHECK_FLAG(rib_dest_from_rnode(rn)->flags,
-			       RIB_ROUTE_QUEUED(qindex))) {
+		if (CHECK_FLAG(dest->flags, RIB_ROUTE_QUEUED(qindex))) {
 			if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 				rnode_debug(
 					rn, re->vrf_id,
@@ -1888,11 +2294,13 @@ static void rib_meta_queue_add(struct meta_queue *mq, struct route_node *rn)
 			continue;
 		}
 
-		SET_FLAG(rib_dest_from_rnode(rn)->flags,
-			 RIB_ROUTE_QUEUED(qindex));
-		listnode_add(mq->subq[qindex], rn);
+		SET_FLAG(dest->flags, RIB_ROUTE_QUEUED(qindex));
+		STAILQ_INSERT_TAIL(&mq->subq[qindex], dest,
+				   mq_entries[qindex]);
 		route_lock_node(rn);
 		mq->size++;
+		if (++mq->stats[qindex].len > mq->stats[qindex].max_len)
+			mq->stats[qindex].max_len = mq->stats[qindex].len;
 
 		if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 			rnode_debug(rn, re->vrf_id,
@@ -1951,21 +2359,39 @@ static struct meta_queue *meta_queue_new(void)
 	new = XCALLOC(MTYPE_WORK_QUEUE, sizeof(struct meta_queue));
 	assert(new);
 
-	for (i = 0; i < MQ_SIZE; i++) {
-		new->subq[i] = list_new();
-		assert(new->subq[i]);
-	}
+	for (i = 0; i < MQ_SIZE; i++)
+		STAILQ_INIT(&new->subq[i]);
 
 	return new;
 }
 
-void meta_queue_free(struct meta_queue *mq)
+/* Drops the dests of zvrf from the meta queue. */
+void meta_queue_remove_vrf(struct meta_queue *mq, struct zebra_vrf *zvrf)
 {
+	STAILQ_HEAD(, rib_dest_t_) keep;
+	rib_dest_t *dest;
 	unsigned i;
 
-	for (i = 0; i < MQ_SIZE; i++)
-		list_delete_and_null(&mq->subq[i]);
+	for (i = 0; i < MQ_SIZE; i++) {
+		STAILQ_INIT(&keep);
+		while ((dest = STAILQ_FIRST(&mq->subq[i]))) {
+			STAILQ_REMOVE_HEAD(&mq->subq[i], mq_entries[i]);
+			if (rib_dest_vrf(dest) != zvrf) {
+				STAILQ_INSERT_TAIL(&keep, dest, mq_entries[i]);
+				continue;
+			}
 
+			UNSET_FLAG(dest->flags, RIB_ROUTE_QUEUED(i));
+			mq->stats[i].len--;
+			mq->size--;
+			route_unlock_node(dest->rnode);
+		}
+		STAILQ_CONCAT(&mq->subq[i], &keep);
+	}
+}
+
+void meta_queue_free(struct meta_queue *mq)
+{
 	XFREE(MTYPE_WORK_QUEUE, mq);
 }
 
@@ -1987,6 +2413,7 @@ static void rib_queue_init(struct zebra_t *zebra)
 	/* XXX: TODO: These should be runtime configurable via vty */
 	zebra->ribq->spec.max_retries = 3;
 	zebra->ribq->spec.hold = ZEBRA_RIB_PROCESS_HOLD_TIME;
+	zebra->ribq->spec.max_stall = zebra->wq_max_stall * 1000UL;
 
 	if (!(zebra->mq = meta_queue_new())) {
 		zlog_err("%s: could not initialise meta queue!", __func__);
@@ -2032,11 +2459,72 @@ static void rib_queue_init(struct zebra_t *zebra)
  *
  */
 
-/* Add RE to head of the route node. */
+/*
+ * Free a dest detached from its node. If the route in its slot is still
+ * waiting for the kernel, the dest goes away along with that route.
+ */
+void rib_dest_free(rib_dest_t *dest)
+{
+	dest->rnode = NULL;
+
+	if (!CHECK_FLAG(dest->flags, RIB_DEST_RE_SLOT))
+		XFREE(MTYPE_RIB_DEST, dest);
+	else if (!CHECK_FLAG(dest->flags, RIB_DEST_RE_SLOT_USED))
+		XFREE(MTYPE_RIB_DEST_RE, dest);
+}
+
+/* Free a route no longer linked to its dest, and its nexthops */
+void route_entry_free(struct route_entry *re)
+{
+	struct rib_dest_re *dre;
+
+	zebra_nhg_release(re);
+
+	if (!CHECK_FLAG(re->status, ROUTE_ENTRY_EMBEDDED)) {
+		XFREE(MTYPE_RE, re);
+		return;
+	}
+
+	dre = (struct rib_dest_re *)((char *)re
+				     - offsetof(struct rib_dest_re, re));
+	UNSET_FLAG(dre->dest.flags, RIB_DEST_RE_SLOT_USED);
+	if (!dre->dest.rnode)
+		XFREE(MTYPE_RIB_DEST_RE, dre);
+}
+
+/*
+ * Move a route about to be linked into the dest's slot if it is free.
+ * Returns where the route is now.
+ */
+static struct route_entry *rib_dest_embed(rib_dest_t *dest,
+					  struct route_entry *re)
+{
+	struct rib_dest_re *dre = (struct rib_dest_re *)dest;
+
+	if (!CHECK_FLAG(dest->flags, RIB_DEST_RE_SLOT)
+	    || CHECK_FLAG(dest->flags, RIB_DEST_RE_SLOT_USED))
+		return re;
+
+	dre->re = *re;
+	SET_FLAG(dre->re.status, ROUTE_ENTRY_EMBEDDED);
+	SET_FLAG(dest->flags, RIB_DEST_RE_SLOT_USED);
+	XFREE(MTYPE_RE, re);
+
+	return &dre->re;
+}
+
+/*
+ * Add RE to head of the route node.
+ *
+ * re must not be referenced from anywhere yet: it may be moved into the
+ * dest's own allocation, see struct rib_dest_re.
+ */
 static void rib_link(struct route_node *rn, struct route_entry *re, int process)
 {
 	struct route_entry *head;
+	struct rib_dest_re *dre;
 	rib_dest_t *dest;
+	rib_table_info_t *info;
 	afi_t afi;
 	const char *rmap_name;
 
@@ -2047,12 +2535,18 @@ static void rib_link(struct route_node *rn, struct route_entry *re, int process)
 		if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 			rnode_debug(rn, re->vrf_id, "rn %p adding dest", rn);
 
-		dest = XCALLOC(MTYPE_RIB_DEST, sizeof(rib_dest_t));
+		dre = XCALLOC(MTYPE_RIB_DEST_RE, sizeof(struct rib_dest_re));
+		dest = &dre->dest;
+		SET_FLAG(dest->flags, RIB_DEST_RE_SLOT);
 		route_lock_node(rn); /* rn route table reference */
 		rn->info = dest;
 		dest->rnode = rn;
+		rib_table_changed(rn);
 	}
 
+	re = rib_dest_embed(dest, re);
+	zebra_nhg_link(rn, re);
+
 	head = dest->routes;
 	if (head) {
 		head->prev = re;
@@ -2060,6 +2554,11 @@ static void rib_link(struct route_node *rn, struct route_entry *re, int process)
 	re->next = head;
 	dest->routes = re;
 
+	info = srcdest_rnode_table_info(rn);
+	rib_count(info->rib_cnt, re, 1);
+	if (CHECK_FLAG(re->flags, ZEBRA_FLAG_SELECTED))
+		rib_count(info->fib_cnt, re, 1);
+
 	afi = (rn->p.family == AF_INET)
 		      ? AFI_IP
 		      : (rn->p.family == AF_INET6) ? AFI_IP6 : AFI_MAX;
@@ -2098,6 +2597,7 @@ void rib_addnode(struct route_node *rn, struct route_entry *re, int process)
 void rib_unlink(struct route_node *rn, struct route_entry *re)
 {
 	rib_dest_t *dest;
+	rib_table_info_t *info;
 
 	assert(rn && re);
 
@@ -2107,6 +2607,8 @@ void rib_unlink(struct route_node *rn, struct route_entry *re)
 
 	dest = rib_dest_from_rnode(rn);
 
+	zebra_nhg_unlink(re);
+
 	if (re->next)
 		re->next->prev = re->prev;
 
@@ -2116,15 +2618,28 @@ void rib_unlink(struct route_node *rn, struct route_entry *re)
 		dest->routes = re->next;
 	}
 
-	if (dest->selected_fib == re)
+	info = srcdest_rnode_table_info(rn);
+	rib_count(info->rib_cnt, re, -1);
+	if (CHECK_FLAG(re->flags, ZEBRA_FLAG_SELECTED))
+		rib_count(info->fib_cnt, re, -1);
+
+	if (dest->selected_fib == re) {
 		dest->selected_fib = NULL;
+		zebra_nhg_invalidate();
+	}
 
-	/* free RE and nexthops */
 	if (re->type == ZEBRA_ROUTE_STATIC)
 		zebra_deregister_rnh_static_nexthops(re->ng.nexthop->vrf_id,
 						     re->ng.nexthop, rn);
-	nexthops_free(re->ng.nexthop);
-	XFREE(MTYPE_RE, re);
+
+	/* The kernel has yet to answer for re, it is freed then */
+	if (re->inflight) {
+		SET_FLAG(re->status, ROUTE_ENTRY_UNLINKED);
+		return;
+	}
+
+	/* free RE and nexthops */
+	route_entry_free(re);
 }
 
 void rib_delnode(struct route_node *rn, struct route_entry *re)
@@ -2135,6 +2650,7 @@ void rib_delnode(struct route_node *rn, struct route_entry *re)
 		rnode_debug(rn, re->vrf_id, "rn %p, re %p, removing",
 			    (void *)rn, (void *)re);
 	SET_FLAG(re->status, ROUTE_ENTRY_REMOVED);
+	zebra_nhg_invalidate();
 
 	afi = (rn->p.family == AF_INET)
 		      ? AFI_IP
@@ -2317,8 +2833,12 @@ int rib_add_multipath(afi_t afi, safi_t safi, struct prefix *p,
 
 	assert(!src_p || afi == AFI_IP6);
 
+	trace_event(ZEBRA_RIB_ADD, p, zebra_route_string(re->type), re->vrf_id,
+		    re->instance, re->distance, re->metric);
+
 	/* Lookup table.  */
-	table = zebra_vrf_table_with_table_id(afi, safi, re->vrf_id, re->table);
+	table = zebra_vrf_table_with_table_id_get(afi, safi, re->vrf_id,
+						  re->table);
 	if (!table) {
 		XFREE(MTYPE_RE, re);
 		return 0;
@@ -2367,6 +2887,8 @@ int rib_add_multipath(afi_t afi, safi_t safi, struct prefix *p,
 	if (RIB_SYSTEM_ROUTE(re))
 		for (nexthop = re->ng.nexthop; nexthop; nexthop = nexthop->next)
 			SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+	else
+		zebra_nhg_intern(re, afi, safi, p, src_p);
 
 	/* Link new re to node.*/
 	if (IS_ZEBRA_DEBUG_RIB) {
@@ -2378,7 +2900,11 @@ int rib_add_multipath(afi_t afi, safi_t safi, struct prefix *p,
 		if (IS_ZEBRA_DEBUG_RIB_DETAILED)
 			route_entry_dump(p, src_p, re);
 	}
-	rib_addnode(rn, re, 1);
+	/* Our own routes read back from the kernel at startup go away again
+	 * once swept, which queues them; don't process them twice. */
+	rib_addnode(rn, re,
+		    !zebrad.sweep_pending
+			    || !CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE));
 	ret = 1;
 
 	/* Free implicit route.*/
@@ -2408,6 +2934,9 @@ void rib_delete(afi_t afi, safi_t safi, vrf_id_t vrf_id, int type,
 
 	assert(!src_p || afi == AFI_IP6);
 
+	trace_event(ZEBRA_RIB_DELETE, p, zebra_route_string(type), vrf_id,
+		    instance, table_id);
+
 	/* Lookup table.  */
 	table = zebra_vrf_table_with_table_id(afi, safi, vrf_id, table_id);
 	if (!table)
@@ -2500,10 +3029,7 @@ void rib_delete(afi_t afi, safi_t safi, vrf_id_t vrf_id, int type,
 			}
 			if (allow_delete) {
 				/* Unset flags. */
-				for (rtnh = fib->ng.nexthop; rtnh;
-				     rtnh = rtnh->next)
-					UNSET_FLAG(rtnh->flags,
-						   NEXTHOP_FLAG_FIB);
+				zebra_nhg_fib_unset(fib);
 
 				/*
 				 * This is a non FRR route
@@ -2511,6 +3037,7 @@ void rib_delete(afi_t afi, safi_t safi, vrf_id_t vrf_id, int type,
 				 * it as deleted
 				 */
 				dest->selected_fib = NULL;
+				zebra_nhg_invalidate();
 			} else {
 				/* This means someone else, other than Zebra,
 				 * has deleted
@@ -2687,68 +3214,141 @@ static void rib_update_table(struct route_table *table,
 	}
 }
 
-/* RIB update function. */
-void rib_update(vrf_id_t vrf_id, rib_update_event_t event)
+static int rib_update_handler(struct thread *thread)
 {
+	struct zebra_vrf *zvrf = THREAD_ARG(thread);
+	uint8_t pending = zvrf->rib_update_pending;
 	struct route_table *table;
+	rib_update_event_t event;
 
-	/* Process routes of interested address-families. */
-	table = zebra_vrf_table(AFI_IP, SAFI_UNICAST, vrf_id);
-	if (table)
-		rib_update_table(table, event);
+	zvrf->rib_update_pending = 0;
 
-	table = zebra_vrf_table(AFI_IP6, SAFI_UNICAST, vrf_id);
-	if (table)
-		rib_update_table(table, event);
+	zebra_nhg_invalidate();
+
+	for (event = RIB_UPDATE_IF_CHANGE; event <= RIB_UPDATE_OTHER;
+	     event++) {
+		if (!CHECK_FLAG(pending, 1 << event))
+			continue;
+
+		/* Process routes of interested address-families. */
+		table = zebra_vrf_table(AFI_IP, SAFI_UNICAST, zvrf_id(zvrf));
+		if (table)
+			rib_update_table(table, event);
+
+		table = zebra_vrf_table(AFI_IP6, SAFI_UNICAST, zvrf_id(zvrf));
+		if (table)
+			rib_update_table(table, event);
+	}
+
+	return 0;
 }
 
-/* Delete self installed routes after zebra is relaunched.  */
-void rib_sweep_table(struct route_table *table)
+/*
+ * RIB update function.  The tables are walked from an event, so that a
+ * burst of updates - interface ones over the interface hold time - is
+ * handled in one go.
+ */
+void rib_update(vrf_id_t vrf_id, rib_update_event_t event)
 {
-	struct route_node *rn;
+	struct zebra_vrf *zvrf = vrf_info_lookup(vrf_id);
+	long delay = 0;
+
+	if (!zvrf)
+		return;
+
+	if (event == RIB_UPDATE_IF_CHANGE)
+		delay = zebrad.if_hold_time;
+
+	SET_FLAG(zvrf->rib_update_pending, 1 << event);
+	thread_add_timer_msec(zebrad.master, rib_update_handler, zvrf, delay,
+			      &zvrf->t_rib_update);
+}
+
+static void rib_sweep_node(struct route_node *rn)
+{
+	rib_dest_t *dest = rib_dest_from_rnode(rn);
 	struct route_entry *re;
 	struct route_entry *next;
 	struct nexthop *nexthop;
 
-	if (!table)
-		return;
+	RNODE_FOREACH_RE_SAFE (rn, re, next) {
+		if (IS_ZEBRA_DEBUG_RIB)
+			route_entry_dump(&rn->p, NULL, re);
 
-	for (rn = route_top(table); rn; rn = srcdest_route_next(rn)) {
-		RNODE_FOREACH_RE_SAFE (rn, re, next) {
-			if (IS_ZEBRA_DEBUG_RIB)
-				route_entry_dump(&rn->p, NULL, re);
+		if (CHECK_FLAG(re->status, ROUTE_ENTRY_REMOVED))
+			continue;
 
-			if (CHECK_FLAG(re->status, ROUTE_ENTRY_REMOVED))
-				continue;
+		if (!CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE))
+			continue;
 
-			if (!CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE))
-				continue;
+		/*
+		 * Swept after a graceful restart time, the route has been
+		 * through rib_process() and counts as installed already.
+		 * Removing it then works like for any other route, and
+		 * whatever comes next replaces it in the kernel.
+		 */
+		if (dest && dest->selected_fib == re) {
+			rib_delnode(rn, re);
+			continue;
+		}
 
-			/*
-			 * So we are starting up and have received
-			 * routes from the kernel that we have installed
-			 * from a previous run of zebra but not cleaned
-			 * up ( say a kill -9 )
-			 * But since we haven't actually installed
-			 * them yet( we received them from the kernel )
-			 * we don't think they are active.
-			 * So let's pretend they are active to actually
-			 * remove them.
-			 * In all honesty I'm not sure if we should
-			 * mark them as active when we receive them
-			 * This is startup only so probably ok.
-			 *
-			 * If we ever decide to move rib_sweep_table
-			 * to a different spot (ie startup )
-			 * this decision needs to be revisited
-			 */
-			for (ALL_NEXTHOPS(re->ng, nexthop))
-				SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
+		/*
+		 * So we are starting up and have received
+		 * routes from the kernel that we have installed
+		 * from a previous run of zebra but not cleaned
+		 * up ( say a kill -9 )
+		 * But since we haven't actually installed
+		 * them yet( we received them from the kernel )
+		 * we don't think they are active.
+		 * So let's pretend they are active to actually
+		 * remove them.
+		 * In all honesty I'm not sure if we should
+		 * mark them as active when we receive them
+		 * This is startup only so probably ok.
+		 *
+		 * If we ever decide to move rib_sweep_table
+		 * to a different spot (ie startup )
+		 * this decision needs to be revisited
+		 */
+		for (ALL_NEXTHOPS(re->ng, nexthop))
+			SET_FLAG(nexthop->flags, NEXTHOP_FLAG_FIB);
 
-			rib_uninstall_kernel(rn, re);
-			rib_delnode(rn, re);
+		rib_uninstall_kernel(rn, re);
+		rib_delnode(rn, re);
+	}
+}
+
+static int rib_sweep_walk(struct route_node *rn, void *arg)
+{
+	struct route_node *srn;
+
+	/* source-specific routes hang off their destination's node */
+	route_lock_node(rn);
+	for (srn = rn; srn; srn = srcdest_route_next(srn)) {
+		if (srn != rn && !rnode_is_srcnode(srn)) {
+			route_unlock_node(srn);
+			break;
 		}
+		rib_sweep_node(srn);
 	}
+	return 0;
+}
+
+/*
+ * Delete self installed routes after zebra is relaunched.  Big tables are
+ * swept over several events, so that the daemon stays responsive.
+ */
+void rib_sweep_table(struct route_table *table)
+{
+	rib_table_info_t *info;
+
+	if (!table)
+		return;
+
+	info = table->info;
+	route_table_walk_cancel(&info->t_sweep);
+	route_table_walk_start(zebrad.master, table, rib_sweep_walk, NULL,
+			       NULL, &info->t_sweep);
 }
 
 /* Sweep all RIB tables.  */
@@ -2757,6 +3357,8 @@ void rib_sweep_route(void)
 	struct vrf *vrf;
 	struct zebra_vrf *zvrf;
 
+	zebrad.sweep_pending = false;
+
 	RB_FOREACH (vrf, vrf_id_head, &vrfs_by_id) {
 		if ((zvrf = vrf->info) == NULL)
 			continue;
@@ -2835,11 +3437,14 @@ void rib_close_table(struct route_table *table)
 				rib_uninstall_kernel(rn, dest->selected_fib);
 		}
 	}
+
+	kernel_route_rib_wait();
 }
 
 /* Routing information base initialize. */
 void rib_init(void)
 {
+	zebra_nhg_init();
 	rib_queue_init(&zebrad);
 }
 
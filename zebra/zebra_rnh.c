@@ -47,6 +47,7 @@
 #include "zebra/zebra_routemap.h"
 #include "zebra/interface.h"
 #include "zebra/zebra_memory.h"
+#include "zebra/zebra_nhg.h"
 
 static void free_state(vrf_id_t vrf_id, struct route_entry *re,
 		       struct route_node *rn);
@@ -70,24 +71,54 @@ static void print_rnh(struct route_node *rn, struct vty *vty);
 int zebra_rnh_ip_default_route = 0;
 int zebra_rnh_ipv6_default_route = 0;
 
-static inline struct route_table *get_rnh_table(vrf_id_t vrfid, int family,
-						rnh_type_t type)
+static inline struct route_table **rnh_table_slot(vrf_id_t vrfid, int family,
+						  rnh_type_t type)
 {
 	struct zebra_vrf *zvrf;
-	struct route_table *t = NULL;
 
 	zvrf = zebra_vrf_lookup_by_id(vrfid);
 	if (zvrf)
 		switch (type) {
 		case RNH_NEXTHOP_TYPE:
-			t = zvrf->rnh_table[family2afi(family)];
-			break;
+			return &zvrf->rnh_table[family2afi(family)];
 		case RNH_IMPORT_CHECK_TYPE:
-			t = zvrf->import_check_table[family2afi(family)];
-			break;
+			return &zvrf->import_check_table[family2afi(family)];
 		}
 
-	return t;
+	return NULL;
+}
+
+static inline struct route_table *get_rnh_table(vrf_id_t vrfid, int family,
+						rnh_type_t type)
+{
+	struct route_table **t = rnh_table_slot(vrfid, family, type);
+
+	return t ? *t : NULL;
+}
+
+static void zebra_rnhtable_node_cleanup(struct route_table *table,
+					struct route_node *node)
+{
+	if (node->info)
+		zebra_free_rnh(node->info);
+}
+
+/* The NHT tables of a VRF are allocated on the first registration. */
+static struct route_table *create_rnh_table(vrf_id_t vrfid, int family,
+					    rnh_type_t type)
+{
+	struct route_table **t = rnh_table_slot(vrfid, family, type);
+	struct zebra_vrf *zvrf = zebra_vrf_lookup_by_id(vrfid);
+
+	if (!t || !zvrf_is_active(zvrf))
+		return NULL;
+
+	if (!*t) {
+		*t = route_table_init();
+		(*t)->cleanup = zebra_rnhtable_node_cleanup;
+	}
+
+	return *t;
 }
 
 char *rnh_str(struct rnh *rnh, char *buf, int size)
@@ -107,7 +138,7 @@ struct rnh *zebra_add_rnh(struct prefix *p, vrf_id_t vrfid, rnh_type_t type)
 		prefix2str(p, buf, sizeof(buf));
 		zlog_debug("%u: Add RNH %s type %d", vrfid, buf, type);
 	}
-	table = get_rnh_table(vrfid, PREFIX_FAMILY(p), type);
+	table = create_rnh_table(vrfid, PREFIX_FAMILY(p), type);
 	if (!table) {
 		prefix2str(p, buf, sizeof(buf));
 		zlog_warn("%u: Add RNH %s type %d - table not found", vrfid,
@@ -389,7 +420,7 @@ zebra_rnh_resolve_import_entry(vrf_id_t vrfid, int family,
 	if (!route_table) // unexpected
 		return NULL;
 
-	rn = route_node_match(route_table, &nrn->p);
+	rn = rib_route_node_match(route_table, &nrn->p);
 	if (!rn)
 		return NULL;
 
@@ -695,7 +726,7 @@ zebra_rnh_resolve_nexthop_entry(vrf_id_t vrfid, int family,
 	if (!route_table)
 		return NULL;
 
-	rn = route_node_match(route_table, &nrn->p);
+	rn = rib_route_node_match(route_table, &nrn->p);
 	if (!rn)
 		return NULL;
 
@@ -763,12 +794,55 @@ static void zebra_rnh_process_pseudowires(vrf_id_t vrfid, struct rnh *rnh)
 		zebra_pw_update(pw);
 }
 
+/*
+ * Tracked nexthops that resolve differently now, collected while evaluating
+ * so that the routes resolving over them are all looked up in one go.  Only
+ * addresses from the nexthop table are collected: an import check tracks a
+ * network, whose resolution says nothing about the routes using a gateway in
+ * it.
+ */
+static struct route_table *rnh_resolution_changed;
+
+static void zebra_rnh_resolution_changed(struct route_node *nrn)
+{
+	struct route_node *crn;
+
+	if (!is_host_route(&nrn->p))
+		return;
+
+	if (!rnh_resolution_changed)
+		rnh_resolution_changed = route_table_init();
+
+	crn = route_node_get(rnh_resolution_changed, &nrn->p);
+	if (crn->info)
+		route_unlock_node(crn);
+	crn->info = nrn;
+}
+
+/*
+ * zebra resolves the routes over the changed nexthops again itself, clients
+ * need not send them again just for that.
+ */
+static void zebra_rnh_resolution_flush(vrf_id_t vrfid, int family,
+				       rnh_type_t type)
+{
+	struct route_table *changed = rnh_resolution_changed;
+
+	if (type != RNH_NEXTHOP_TYPE || !changed)
+		return;
+
+	rnh_resolution_changed = NULL;
+	zebra_nhg_nexthops_changed(vrfid, family, changed);
+	route_table_finish(changed);
+}
+
 /*
  * See if a tracked nexthop entry has undergone any change, and if so,
  * take appropriate action; this involves notifying any clients and/or
- * scheduling dependent static routes for processing.
+ * scheduling dependent static routes for processing.  Returns whether the
+ * entry resolves differently now.
  */
-static void zebra_rnh_eval_nexthop_entry(vrf_id_t vrfid, int family, int force,
+static bool zebra_rnh_eval_nexthop_entry(vrf_id_t vrfid, int family, int force,
 					 struct route_node *nrn,
 					 struct rnh *rnh,
 					 struct route_node *prn,
@@ -811,6 +885,8 @@ static void zebra_rnh_eval_nexthop_entry(vrf_id_t vrfid, int family, int force,
 		/* Process pseudowires attached to this nexthop */
 		zebra_rnh_process_pseudowires(vrfid, rnh);
 	}
+
+	return state_changed;
 }
 
 /* Evaluate one tracked entry */
@@ -848,9 +924,9 @@ static void zebra_rnh_evaluate_entry(vrf_id_t vrfid, int family, int force,
 	if (type == RNH_IMPORT_CHECK_TYPE)
 		zebra_rnh_eval_import_check_entry(vrfid, family, force, nrn,
 						  rnh, re);
-	else
-		zebra_rnh_eval_nexthop_entry(vrfid, family, force, nrn, rnh,
-					     prn, re);
+	else if (zebra_rnh_eval_nexthop_entry(vrfid, family, force, nrn, rnh,
+					      prn, re))
+		zebra_rnh_resolution_changed(nrn);
 }
 
 /*
@@ -895,7 +971,7 @@ void zebra_evaluate_rnh(vrf_id_t vrfid, int family, int force, rnh_type_t type,
 	struct route_node *nrn;
 
 	rnh_table = get_rnh_table(vrfid, family, type);
-	if (!rnh_table) // unexpected
+	if (!rnh_table) /* nothing registered yet */
 		return;
 
 	if (p) {
@@ -924,6 +1000,71 @@ void zebra_evaluate_rnh(vrf_id_t vrfid, int family, int force, rnh_type_t type,
 			nrn = route_next(nrn); /* this will also unlock nrn */
 		}
 	}
+
+	zebra_rnh_resolution_flush(vrfid, family, type);
+}
+
+/* Evaluate, or clear the nexthops-changed flag of, the tracked entries
+ * covered by the prefixes in the given table.
+ */
+static void zebra_rnh_walk_changed(vrf_id_t vrfid, int family,
+				   rnh_type_t type,
+				   struct route_table *rnh_table,
+				   struct route_table *changed, bool clear)
+{
+	struct route_node *crn, *nrn;
+	struct prefix *last = NULL;
+
+	for (crn = route_top(changed); crn; crn = route_next(crn)) {
+		if (!crn->info)
+			continue;
+
+		/* Changed prefixes come in table order, so anything below
+		 * a prefix that was already walked follows it directly.
+		 */
+		if (last && prefix_match(last, &crn->p))
+			continue;
+		last = &crn->p;
+
+		nrn = route_node_lookup(rnh_table, &crn->p);
+		if (!nrn)
+			nrn = route_table_get_next(rnh_table, &crn->p);
+
+		while (nrn && prefix_match(&crn->p, &nrn->p)) {
+			if (nrn->info) {
+				if (clear)
+					zebra_rnh_clear_nhc_flag(vrfid, family,
+								 type, nrn);
+				else
+					zebra_rnh_evaluate_entry(vrfid, family,
+								 0, type, nrn);
+			}
+			nrn = route_next(nrn); /* this will also unlock nrn */
+		}
+
+		if (nrn)
+			route_unlock_node(nrn);
+	}
+}
+
+/* Evaluate the tracked entries of a particular VRF and address-family
+ * that may resolve through one of the changed prefixes.  Only routes
+ * covering a tracked prefix can resolve it, so that is the part of the
+ * table below a changed prefix.
+ */
+void zebra_evaluate_rnh_changed(vrf_id_t vrfid, int family, rnh_type_t type,
+				struct route_table *changed)
+{
+	struct route_table *rnh_table;
+
+	rnh_table = get_rnh_table(vrfid, family, type);
+	if (!rnh_table) /* nothing registered yet */
+		return;
+
+	zebra_rnh_walk_changed(vrfid, family, type, rnh_table, changed, false);
+	zebra_rnh_walk_changed(vrfid, family, type, rnh_table, changed, true);
+
+	zebra_rnh_resolution_flush(vrfid, family, type);
 }
 
 void zebra_print_rnh_table(vrf_id_t vrfid, int af, struct vty *vty,
@@ -956,10 +1097,8 @@ int zebra_cleanup_rnh_client(vrf_id_t vrf_id, int family, struct zserv *client,
 			   type);
 
 	ntable = get_rnh_table(vrf_id, family, type);
-	if (!ntable) {
-		zlog_debug("cleanup_rnh_client: rnh table not found\n");
-		return -1;
-	}
+	if (!ntable) /* nothing registered yet */
+		return 0;
 
 	for (nrn = route_top(ntable); nrn; nrn = route_next(nrn)) {
 		if (!nrn->info)
@@ -1044,6 +1183,8 @@ static int send_client(struct rnh *rnh, struct zserv *client, rnh_type_t type,
 	uint8_t num;
 	struct nexthop *nh;
 	struct route_node *rn;
+	struct zserv_msg_key key;
+	int ret;
 	int cmd = (type == RNH_IMPORT_CHECK_TYPE) ? ZEBRA_IMPORT_CHECK_UPDATE
 						  : ZEBRA_NEXTHOP_UPDATE;
 
@@ -1125,8 +1266,15 @@ static int send_client(struct rnh *rnh, struct zserv *client, rnh_type_t type,
 	stream_putw_at(s, 0, stream_get_endp(s));
 
 	client->nh_last_upd_time = monotime(NULL);
-	client->last_write_cmd = cmd;
-	return zebra_server_send_message(client, s);
+	atomic_store_explicit(&client->last_write_cmd, cmd,
+			      memory_order_relaxed);
+
+	/* a newer update on the nexthop supersedes this one */
+	zserv_msg_key_init(&key, cmd, vrf_id, &rn->p, NULL);
+	stream_resize(s, stream_get_endp(s));
+	ret = zebra_server_send_coalesced(client, s, &key);
+	stream_free(s);
+	return ret;
 }
 
 static void print_nh(struct nexthop *nexthop, struct vty *vty)
@@ -84,6 +84,9 @@ extern void zebra_remove_rnh_client(struct rnh *rnh, struct zserv *client,
 				    rnh_type_t type);
 extern void zebra_evaluate_rnh(vrf_id_t vrfid, int family, int force,
 			       rnh_type_t type, struct prefix *p);
+extern void zebra_evaluate_rnh_changed(vrf_id_t vrfid, int family,
+				       rnh_type_t type,
+				       struct route_table *changed);
 extern void zebra_print_rnh_table(vrf_id_t vrfid, int family, struct vty *vty,
 				  rnh_type_t);
 extern char *rnh_str(struct rnh *rnh, char *buf, int size);
@@ -1278,6 +1278,16 @@ route_map_result_t zebra_route_map_check(int family, int rib_type,
 	return (ret);
 }
 
+/* Whether zebra_route_map_check() may apply a route-map to rib_type. */
+bool zebra_route_map_proto_set(afi_t afi, int rib_type)
+{
+	if (rib_type >= 0 && rib_type < ZEBRA_ROUTE_MAX
+	    && proto_rm[afi][rib_type])
+		return true;
+
+	return proto_rm[afi][ZEBRA_ROUTE_MAX] != NULL;
+}
+
 char *zebra_get_import_table_route_map(afi_t afi, uint32_t table)
 {
 	return zebra_import_table_routemap[afi][table];
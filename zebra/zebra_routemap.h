@@ -40,6 +40,7 @@ extern route_map_result_t zebra_route_map_check(int family, int rib_type,
 						struct nexthop *nexthop,
 						vrf_id_t vrf_id,
 						route_tag_t tag);
+extern bool zebra_route_map_proto_set(afi_t afi, int rib_type);
 extern route_map_result_t
 zebra_nht_route_map_check(int family, int client_proto, struct prefix *p,
 			  struct route_entry *, struct nexthop *nexthop);
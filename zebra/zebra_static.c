@@ -36,6 +36,214 @@
 #include "zebra/redistribute.h"
 #include "zebra/zebra_memory.h"
 
+DEFINE_MTYPE_STATIC(ZEBRA, STATIC_INDEX, "Static route index")
+DEFINE_MTYPE_STATIC(ZEBRA, STATIC_NH_BATCH, "Static route nexthop batch")
+
+TAILQ_HEAD(static_route_list, static_route);
+
+/*
+ * Static routes by the name of their interface, and by the name of
+ * their nexthop vrf, so that interface and vrf events only have to
+ * look at the static routes they affect.
+ */
+struct static_index {
+	char *name;
+	struct static_route_list routes;
+};
+
+static struct hash *static_if_index;
+static struct hash *static_nh_vrf_index;
+
+static unsigned int static_index_hash_key(void *arg)
+{
+	struct static_index *idx = arg;
+
+	return string_hash_make(idx->name);
+}
+
+static int static_index_hash_cmp(const void *a, const void *b)
+{
+	const struct static_index *idx1 = a, *idx2 = b;
+
+	return !strcmp(idx1->name, idx2->name);
+}
+
+static void *static_index_alloc(void *arg)
+{
+	struct static_index *key = arg;
+	struct static_index *idx;
+
+	idx = XCALLOC(MTYPE_STATIC_INDEX, sizeof(*idx));
+	idx->name = XSTRDUP(MTYPE_STATIC_INDEX, key->name);
+	TAILQ_INIT(&idx->routes);
+	return idx;
+}
+
+static struct static_index *static_index_get(struct hash *hash,
+					     const char *name)
+{
+	struct static_index key;
+
+	key.name = (char *)name;
+	return hash_get(hash, &key, static_index_alloc);
+}
+
+static struct static_index *static_index_lookup(struct hash *hash,
+						const char *name)
+{
+	struct static_index key;
+
+	if (!hash)
+		return NULL;
+
+	key.name = (char *)name;
+	return hash_lookup(hash, &key);
+}
+
+static void static_index_release(struct hash *hash, struct static_index *idx)
+{
+	if (!TAILQ_EMPTY(&idx->routes))
+		return;
+
+	hash_release(hash, idx);
+	XFREE(MTYPE_STATIC_INDEX, idx->name);
+	XFREE(MTYPE_STATIC_INDEX, idx);
+}
+
+static void static_index_add(struct static_route *si)
+{
+	struct static_index *idx;
+
+	if (!static_if_index) {
+		static_if_index =
+			hash_create(static_index_hash_key,
+				    static_index_hash_cmp,
+				    "Static routes by interface");
+		static_nh_vrf_index =
+			hash_create(static_index_hash_key,
+				    static_index_hash_cmp,
+				    "Static routes by nexthop vrf");
+	}
+
+	if (si->ifname[0]) {
+		idx = static_index_get(static_if_index, si->ifname);
+		TAILQ_INSERT_TAIL(&idx->routes, si, if_entries);
+	}
+
+	idx = static_index_get(static_nh_vrf_index, si->nh_vrfname);
+	TAILQ_INSERT_TAIL(&idx->routes, si, nh_vrf_entries);
+}
+
+static void static_index_del(struct static_route *si)
+{
+	struct static_index *idx;
+
+	if (si->ifname[0]) {
+		idx = static_index_lookup(static_if_index, si->ifname);
+		assert(idx);
+		TAILQ_REMOVE(&idx->routes, si, if_entries);
+		static_index_release(static_if_index, idx);
+	}
+
+	idx = static_index_lookup(static_nh_vrf_index, si->nh_vrfname);
+	assert(idx);
+	TAILQ_REMOVE(&idx->routes, si, nh_vrf_entries);
+	static_index_release(static_nh_vrf_index, idx);
+}
+
+/* Free a static route that has been unlinked from its node. */
+void static_route_free(struct static_route *si)
+{
+	static_index_del(si);
+	XFREE(MTYPE_STATIC_ROUTE, si);
+}
+
+/*
+ * Installing a static route with a gateway nexthop evaluates the
+ * nexthop, which processes every static route tracking it.  When many
+ * static routes are installed at once, each distinct nexthop is only
+ * evaluated once, at the end of the batch.
+ */
+struct static_nh_batch {
+	vrf_id_t vrf_id;
+	struct route_table *nhs[AFI_MAX];
+};
+
+static int static_batch_depth;
+static struct list *static_nh_batches;
+
+static void static_batch_start(void)
+{
+	static_batch_depth++;
+}
+
+static void static_evaluate_nh(vrf_id_t vrf_id, struct prefix *nh_p)
+{
+	struct static_nh_batch *batch = NULL;
+	struct listnode *node;
+	struct route_node *rn;
+	afi_t afi = family2afi(nh_p->family);
+
+	if (!static_batch_depth) {
+		zebra_evaluate_rnh(vrf_id, nh_p->family, 1, RNH_NEXTHOP_TYPE,
+				   nh_p);
+		return;
+	}
+
+	if (!static_nh_batches)
+		static_nh_batches = list_new();
+
+	for (ALL_LIST_ELEMENTS_RO(static_nh_batches, node, batch))
+		if (batch->vrf_id == vrf_id)
+			break;
+
+	if (!batch) {
+		batch = XCALLOC(MTYPE_STATIC_NH_BATCH, sizeof(*batch));
+		batch->vrf_id = vrf_id;
+		listnode_add(static_nh_batches, batch);
+	}
+
+	if (!batch->nhs[afi])
+		batch->nhs[afi] = route_table_init();
+
+	rn = route_node_get(batch->nhs[afi], nh_p);
+	if (rn->info)
+		route_unlock_node(rn);
+	else
+		rn->info = batch;
+}
+
+static void static_batch_end(void)
+{
+	struct static_nh_batch *batch;
+	struct listnode *node, *nnode;
+	struct route_node *rn;
+	afi_t afi;
+
+	assert(static_batch_depth > 0);
+	if (--static_batch_depth || !static_nh_batches)
+		return;
+
+	for (ALL_LIST_ELEMENTS(static_nh_batches, node, nnode, batch)) {
+		for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+			if (!batch->nhs[afi])
+				continue;
+
+			for (rn = route_top(batch->nhs[afi]); rn;
+			     rn = route_next(rn))
+				if (rn->info)
+					zebra_evaluate_rnh(batch->vrf_id,
+							   rn->p.family, 1,
+							   RNH_NEXTHOP_TYPE,
+							   &rn->p);
+			route_table_finish(batch->nhs[afi]);
+		}
+
+		list_delete_node(static_nh_batches, node);
+		XFREE(MTYPE_STATIC_NH_BATCH, batch);
+	}
+}
+
 /* Install static route into rib. */
 void static_install_route(afi_t afi, safi_t safi, struct prefix *p,
 			  struct prefix_ipv6 *src_p, struct static_route *si)
@@ -49,7 +257,7 @@ void static_install_route(afi_t afi, safi_t safi, struct prefix *p,
 	struct vrf *nh_vrf;
 
 	/* Lookup table.  */
-	table = zebra_vrf_table(afi, safi, si->vrf_id);
+	table = zebra_vrf_table_get(afi, safi, si->vrf_id);
 	if (!table)
 		return;
 
@@ -156,8 +364,7 @@ void static_install_route(afi_t afi, safi_t safi, struct prefix *p,
 		 */
 		if (si->type == STATIC_IPV4_GATEWAY
 		    || si->type == STATIC_IPV6_GATEWAY)
-			zebra_evaluate_rnh(si->nh_vrf_id, nh_p.family, 1,
-					   RNH_NEXTHOP_TYPE, &nh_p);
+			static_evaluate_nh(si->nh_vrf_id, &nh_p);
 		else
 			rib_queue_add(rn);
 	} else {
@@ -237,8 +444,7 @@ void static_install_route(afi_t afi, safi_t safi, struct prefix *p,
 		if (si->type == STATIC_IPV4_GATEWAY
 		    || si->type == STATIC_IPV6_GATEWAY) {
 			rib_addnode(rn, re, 0);
-			zebra_evaluate_rnh(si->nh_vrf_id, nh_p.family, 1,
-					   RNH_NEXTHOP_TYPE, &nh_p);
+			static_evaluate_nh(si->nh_vrf_id, &nh_p);
 		} else
 			rib_addnode(rn, re, 1);
 	}
@@ -402,10 +608,7 @@ int static_add_route(afi_t afi, safi_t safi, uint8_t type, struct prefix *p,
 	struct static_route *pp;
 	struct static_route *cp;
 	struct static_route *update = NULL;
-	struct route_table *stable = zvrf->stable[afi][safi];
-
-	if (!stable)
-		return -1;
+	struct route_table *stable;
 
 	if (!gate && (type == STATIC_IPV4_GATEWAY
 		      || type == STATIC_IPV4_GATEWAY_IFNAME
@@ -418,6 +621,10 @@ int static_add_route(afi_t afi, safi_t safi, uint8_t type, struct prefix *p,
 		|| type == STATIC_IPV6_GATEWAY_IFNAME))
 		return -1;
 
+	stable = zebra_vrf_static_table_get(afi, safi, zvrf);
+	if (!stable)
+		return -1;
+
 	/* Lookup static route prefix. */
 	rn = srcdest_rnode_get(stable, p, src_p);
 
@@ -506,6 +713,11 @@ int static_add_route(afi_t afi, safi_t safi, uint8_t type, struct prefix *p,
 	si->prev = pp;
 	si->next = cp;
 
+	si->rn = rn;
+	si->afi = afi;
+	si->safi = safi;
+	static_index_add(si);
+
 	/* check whether interface exists in system & install if it does */
 	if (!ifname)
 		static_install_route(afi, safi, p, src_p, si);
@@ -577,90 +789,45 @@ int static_delete_route(afi_t afi, safi_t safi, uint8_t type, struct prefix *p,
 	route_unlock_node(rn);
 
 	/* Free static route configuration. */
-	XFREE(MTYPE_STATIC_ROUTE, si);
+	static_route_free(si);
 
 	route_unlock_node(rn);
 
-	return 1;
-}
-
-static void static_ifindex_update_af(struct interface *ifp, bool up, afi_t afi,
-				     safi_t safi)
-{
-	struct route_table *stable;
-	struct route_node *rn;
-	struct static_route *si;
-	struct prefix *p, *src_pp;
-	struct prefix_ipv6 *src_p;
-	struct vrf *vrf;
+	zebra_vrf_static_table_release(afi, safi, zvrf);
 
-	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
-		struct zebra_vrf *zvrf;
-
-		zvrf = vrf->info;
-
-		stable = zebra_vrf_static_table(afi, safi, zvrf);
-		if (!stable)
-			continue;
-
-		for (rn = route_top(stable); rn; rn = srcdest_route_next(rn)) {
-			srcdest_rnode_prefixes(rn, &p, &src_pp);
-			src_p = (struct prefix_ipv6 *)src_pp;
-
-			for (si = rn->info; si; si = si->next) {
-				if (!si->ifname[0])
-					continue;
-				if (up) {
-					if (strcmp(si->ifname, ifp->name))
-						continue;
-					si->ifindex = ifp->ifindex;
-					static_install_route(afi, safi, p, src_p, si);
-				} else {
-					if (si->ifindex != ifp->ifindex)
-						continue;
-					static_uninstall_route(afi, safi, p, src_p, si);
-					si->ifindex = IFINDEX_INTERNAL;
-				}
-			}
-		}
-	}
+	return 1;
 }
 
 /*
- * This function looks at a zvrf's stable and notices if any of the
- * nexthops we are using are part of the vrf coming up.
- * If we are using them then cleanup the nexthop vrf id
- * to be the new value and then re-installs them
- *
+ * This function finds the static routes whose nexthops are part of
+ * the vrf coming up, sets their nexthop vrf id to the new value and
+ * then re-installs them.
  *
- * stable -> The table we are looking at.
  * zvrf -> The newly changed vrf.
- * afi -> The afi to look at
- * safi -> the safi to look at
  */
-static void static_fixup_vrf(struct zebra_vrf *zvrf,
-			     struct route_table *stable, afi_t afi, safi_t safi)
+static void static_fixup_vrf(struct zebra_vrf *zvrf)
 {
-	struct route_node *rn;
+	struct static_index *idx;
 	struct static_route *si;
 	struct interface *ifp;
+	struct prefix *p, *src_p;
 
-	for (rn = route_top(stable); rn; rn = route_next(rn)) {
-		for (si = rn->info; si; si = si->next) {
-			if (strcmp(zvrf->vrf->name, si->nh_vrfname) != 0)
-				continue;
+	idx = static_index_lookup(static_nh_vrf_index, zvrf->vrf->name);
+	if (!idx)
+		return;
 
-			si->nh_vrf_id = zvrf->vrf->vrf_id;
-			if (si->ifindex) {
-				ifp = if_lookup_by_name(si->ifname,
-							si->nh_vrf_id);
-				if (ifp)
-					si->ifindex = ifp->ifindex;
-				else
-					continue;
-			}
-			static_install_route(afi, safi, &rn->p, NULL, si);
+	TAILQ_FOREACH (si, &idx->routes, nh_vrf_entries) {
+		si->nh_vrf_id = zvrf->vrf->vrf_id;
+		if (si->ifindex) {
+			ifp = if_lookup_by_name(si->ifname, si->nh_vrf_id);
+			if (ifp)
+				si->ifindex = ifp->ifindex;
+			else
+				continue;
 		}
+		srcdest_rnode_prefixes(si->rn, &p, &src_p);
+		static_install_route(si->afi, si->safi, p,
+				     (struct prefix_ipv6 *)src_p, si);
 	}
 }
 
@@ -708,56 +875,47 @@ static void static_enable_vrf(struct zebra_vrf *zvrf,
 void static_fixup_vrf_ids(struct zebra_vrf *enable_zvrf)
 {
 	struct route_table *stable;
-	struct vrf *vrf;
 	afi_t afi;
 	safi_t safi;
 
-	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
-		struct zebra_vrf *zvrf;
+	static_batch_start();
 
-		zvrf = vrf->info;
-		/* Install any static routes configured for this VRF. */
-		for (afi = AFI_IP; afi < AFI_MAX; afi++) {
-			for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-				stable = zvrf->stable[afi][safi];
-				if (!stable)
-					continue;
+	static_fixup_vrf(enable_zvrf);
 
-				static_fixup_vrf(enable_zvrf, stable,
-						 afi, safi);
+	/* Install any static routes configured for this VRF. */
+	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			stable = enable_zvrf->stable[afi][safi];
+			if (!stable)
+				continue;
 
-				if (enable_zvrf == zvrf)
-					static_enable_vrf(zvrf, stable,
-							  afi, safi);
-			}
+			static_enable_vrf(enable_zvrf, stable, afi, safi);
 		}
 	}
+
+	static_batch_end();
 }
 
 /*
- * Look at the specified stable and if any of the routes in
- * this table are using the zvrf as the nexthop, uninstall
- * those routes.
+ * Uninstall the static routes that are using the zvrf as the
+ * nexthop.
  *
  * zvrf -> the vrf being disabled
- * stable -> the table we need to look at.
- * afi -> the afi in question
- * safi -> the safi in question
  */
-static void static_cleanup_vrf(struct zebra_vrf *zvrf,
-			       struct route_table *stable,
-			       afi_t afi, safi_t safi)
+static void static_cleanup_vrf(struct zebra_vrf *zvrf)
 {
-	struct route_node *rn;
+	struct static_index *idx;
 	struct static_route *si;
+	struct prefix *p, *src_p;
 
-	for (rn = route_top(stable); rn; rn = route_next(rn)) {
-		for (si = rn->info; si; si = si->next) {
-			if (strcmp(zvrf->vrf->name, si->nh_vrfname) != 0)
-				continue;
+	idx = static_index_lookup(static_nh_vrf_index, zvrf->vrf->name);
+	if (!idx)
+		return;
 
-			static_uninstall_route(afi, safi, &rn->p, NULL, si);
-		}
+	TAILQ_FOREACH (si, &idx->routes, nh_vrf_entries) {
+		srcdest_rnode_prefixes(si->rn, &p, &src_p);
+		static_uninstall_route(si->afi, si->safi, p,
+				       (struct prefix_ipv6 *)src_p, si);
 	}
 }
 
@@ -792,30 +950,20 @@ static void static_disable_vrf(struct route_table *stable,
  */
 void static_cleanup_vrf_ids(struct zebra_vrf *disable_zvrf)
 {
-	struct vrf *vrf;
+	struct route_table *stable;
 	afi_t afi;
 	safi_t safi;
 
-	RB_FOREACH (vrf, vrf_name_head, &vrfs_by_name) {
-		struct zebra_vrf *zvrf;
-
-		zvrf = vrf->info;
-
-		/* Uninstall any static routes configured for this VRF. */
-		for (afi = AFI_IP; afi < AFI_MAX; afi++) {
-			for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-				struct route_table *stable;
-
-				stable = zvrf->stable[afi][safi];
-				if (!stable)
-					continue;
+	static_cleanup_vrf(disable_zvrf);
 
-				static_cleanup_vrf(disable_zvrf, stable,
-						   afi, safi);
+	/* Uninstall any static routes configured for this VRF. */
+	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+		for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+			stable = disable_zvrf->stable[afi][safi];
+			if (!stable)
+				continue;
 
-				if (disable_zvrf == zvrf)
-					static_disable_vrf(stable, afi, safi);
-			}
+			static_disable_vrf(stable, afi, safi);
 		}
 	}
 }
@@ -823,8 +971,30 @@ void static_cleanup_vrf_ids(struct zebra_vrf *disable_zvrf)
 /* called from if_{add,delete}_update, i.e. when ifindex becomes [in]valid */
 void static_ifindex_update(struct interface *ifp, bool up)
 {
-	static_ifindex_update_af(ifp, up, AFI_IP, SAFI_UNICAST);
-	static_ifindex_update_af(ifp, up, AFI_IP, SAFI_MULTICAST);
-	static_ifindex_update_af(ifp, up, AFI_IP6, SAFI_UNICAST);
-	static_ifindex_update_af(ifp, up, AFI_IP6, SAFI_MULTICAST);
+	struct static_index *idx;
+	struct static_route *si;
+	struct prefix *p, *src_p;
+
+	idx = static_index_lookup(static_if_index, ifp->name);
+	if (!idx)
+		return;
+
+	static_batch_start();
+
+	TAILQ_FOREACH (si, &idx->routes, if_entries) {
+		srcdest_rnode_prefixes(si->rn, &p, &src_p);
+		if (up) {
+			si->ifindex = ifp->ifindex;
+			static_install_route(si->afi, si->safi, p,
+					     (struct prefix_ipv6 *)src_p, si);
+		} else {
+			if (si->ifindex != ifp->ifindex)
+				continue;
+			static_uninstall_route(si->afi, si->safi, p,
+					       (struct prefix_ipv6 *)src_p, si);
+			si->ifindex = IFINDEX_INTERNAL;
+		}
+	}
+
+	static_batch_end();
 }
@@ -22,6 +22,7 @@
 #ifndef __ZEBRA_STATIC_H__
 #define __ZEBRA_STATIC_H__
 
+#include "queue.h"
 #include "zebra/zebra_mpls.h"
 
 /* Static route label information */
@@ -77,6 +78,18 @@ struct static_route {
 
 	/* Label information */
 	struct static_nh_label snh_label;
+
+	/* Node in the static route table, and the table's afi/safi. */
+	struct route_node *rn;
+	afi_t afi;
+	safi_t safi;
+
+	/*
+	 * Linkage in the indexes of static routes by interface name and
+	 * by nexthop vrf name.
+	 */
+	TAILQ_ENTRY(static_route) if_entries;
+	TAILQ_ENTRY(static_route) nh_vrf_entries;
 };
 
 extern void static_install_route(afi_t afi, safi_t safi, struct prefix *p,
@@ -101,6 +114,8 @@ extern int static_delete_route(afi_t, safi_t safi, uint8_t type,
 			       struct zebra_vrf *zvrf,
 			       struct static_nh_label *snh_label);
 
+extern void static_route_free(struct static_route *si);
+
 extern void static_ifindex_update(struct interface *ifp, bool up);
 
 extern void static_cleanup_vrf_ids(struct zebra_vrf *zvrf);
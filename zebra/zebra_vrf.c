@@ -31,6 +31,7 @@
 #include "zebra/debug.h"
 #include "zebra/zserv.h"
 #include "zebra/rib.h"
+#include "zebra/rt.h"
 #include "zebra/zebra_vrf.h"
 #include "zebra/zebra_rnh.h"
 #include "zebra/router-id.h"
@@ -45,8 +46,6 @@ extern struct zebra_t zebrad;
 
 static void zebra_vrf_table_create(struct zebra_vrf *zvrf, afi_t afi,
 				   safi_t safi);
-static void zebra_rnhtable_node_cleanup(struct route_table *table,
-					struct route_node *node);
 
 /* VRF information update. */
 static void zebra_vrf_add_update(struct zebra_vrf *zvrf)
@@ -102,9 +101,6 @@ static int zebra_vrf_new(struct vrf *vrf)
 static int zebra_vrf_enable(struct vrf *vrf)
 {
 	struct zebra_vrf *zvrf = vrf->info;
-	struct route_table *table;
-	afi_t afi;
-	safi_t safi;
 
 	assert(zvrf);
 	if (IS_ZEBRA_DEBUG_EVENT)
@@ -120,20 +116,10 @@ static int zebra_vrf_enable(struct vrf *vrf)
 	 */
 
 	zebra_vrf_add_update(zvrf);
-	/* Allocate tables */
-	for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
-		for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++)
-			zebra_vrf_table_create(zvrf, afi, safi);
-
-		table = route_table_init();
-		table->cleanup = zebra_rnhtable_node_cleanup;
-		zvrf->rnh_table[afi] = table;
-
-		table = route_table_init();
-		table->cleanup = zebra_rnhtable_node_cleanup;
-		zvrf->import_check_table[afi] = table;
-	}
 
+	/* The routing and NHT tables are only allocated once something is
+	 * put in them, see zebra_vrf_table_get().
+	 */
 	static_fixup_vrf_ids(zvrf);
 
 	/*
@@ -156,7 +142,6 @@ static int zebra_vrf_disable(struct vrf *vrf)
 	struct interface *ifp;
 	afi_t afi;
 	safi_t safi;
-	unsigned i;
 
 	assert(zvrf);
 	if (IS_ZEBRA_DEBUG_EVENT)
@@ -194,21 +179,9 @@ static int zebra_vrf_disable(struct vrf *vrf)
 		if_nbr_ipv6ll_to_ipv4ll_neigh_del_all(ifp);
 
 	/* clean-up work queues */
-	for (i = 0; i < MQ_SIZE; i++) {
-		struct listnode *lnode, *nnode;
-		struct route_node *rnode;
-		rib_dest_t *dest;
-
-		for (ALL_LIST_ELEMENTS(zebrad.mq->subq[i], lnode, nnode,
-				       rnode)) {
-			dest = rib_dest_from_rnode(rnode);
-			if (dest && rib_dest_vrf(dest) == zvrf) {
-				route_unlock_node(rnode);
-				list_delete_node(zebrad.mq->subq[i], lnode);
-				zebrad.mq->size--;
-			}
-		}
-	}
+	meta_queue_remove_vrf(zebrad.mq, zvrf);
+	THREAD_OFF(zvrf->t_rib_update);
+	zvrf->rib_update_pending = 0;
 
 	/* Cleanup (free) routing tables and NHT tables. */
 	for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
@@ -216,9 +189,11 @@ static int zebra_vrf_disable(struct vrf *vrf)
 
 		for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++) {
 			table = zvrf->table[afi][safi];
+			if (!table)
+				continue;
 			table_info = table->info;
 			route_table_finish(table);
-			XFREE(MTYPE_RIB_TABLE_INFO, table_info);
+			rib_table_info_free(table_info);
 			zvrf->table[afi][safi] = NULL;
 		}
 
@@ -226,6 +201,9 @@ static int zebra_vrf_disable(struct vrf *vrf)
 		zvrf->rnh_table[afi] = NULL;
 		route_table_finish(zvrf->import_check_table[afi]);
 		zvrf->import_check_table[afi] = NULL;
+		route_table_finish(zvrf->nht_changed[afi]);
+		zvrf->nht_changed[afi] = NULL;
+		zvrf->nht_all[afi] = false;
 	}
 
 	return 0;
@@ -237,7 +215,6 @@ static int zebra_vrf_delete(struct vrf *vrf)
 	struct route_table *table;
 	afi_t afi;
 	safi_t safi;
-	unsigned i;
 
 	assert(zvrf);
 	if (IS_ZEBRA_DEBUG_EVENT)
@@ -245,21 +222,11 @@ static int zebra_vrf_delete(struct vrf *vrf)
 			   zvrf_id(zvrf));
 
 	/* clean-up work queues */
-	for (i = 0; i < MQ_SIZE; i++) {
-		struct listnode *lnode, *nnode;
-		struct route_node *rnode;
-		rib_dest_t *dest;
-
-		for (ALL_LIST_ELEMENTS(zebrad.mq->subq[i], lnode, nnode,
-				       rnode)) {
-			dest = rib_dest_from_rnode(rnode);
-			if (dest && rib_dest_vrf(dest) == zvrf) {
-				route_unlock_node(rnode);
-				list_delete_node(zebrad.mq->subq[i], lnode);
-				zebrad.mq->size--;
-			}
-		}
-	}
+	meta_queue_remove_vrf(zebrad.mq, zvrf);
+	THREAD_OFF(zvrf->t_rib_update);
+
+	/* Route nodes may still be referenced by pending kernel updates. */
+	kernel_route_rib_wait();
 
 	/* Free Vxlan and MPLS. */
 	zebra_vxlan_close_tables(zvrf);
@@ -274,7 +241,7 @@ static int zebra_vrf_delete(struct vrf *vrf)
 			if (table) {
 				table_info = table->info;
 				route_table_finish(table);
-				XFREE(MTYPE_RIB_TABLE_INFO, table_info);
+				rib_table_info_free(table_info);
 			}
 
 			table = zvrf->stable[afi][safi];
@@ -283,6 +250,7 @@ static int zebra_vrf_delete(struct vrf *vrf)
 
 		route_table_finish(zvrf->rnh_table[afi]);
 		route_table_finish(zvrf->import_check_table[afi]);
+		route_table_finish(zvrf->nht_changed[afi]);
 	}
 
 	/* Cleanup EVPN states for vrf */
@@ -327,31 +295,44 @@ int zebra_vrf_has_config(struct zebra_vrf *zvrf)
 	return 0;
 }
 
-/* Lookup the routing table in a VRF based on both VRF-Id and table-id.
- * NOTE: Table-id is relevant only in the Default VRF.
- */
-struct route_table *zebra_vrf_table_with_table_id(afi_t afi, safi_t safi,
-						  vrf_id_t vrf_id,
-						  uint32_t table_id)
+static struct route_table *zebra_vrf_table_by_id(afi_t afi, safi_t safi,
+						 vrf_id_t vrf_id,
+						 uint32_t table_id, bool create)
 {
 	struct route_table *table = NULL;
 
 	if (afi >= AFI_MAX || safi >= SAFI_MAX)
 		return NULL;
 
-	if (vrf_id == VRF_DEFAULT) {
-		if (table_id == RT_TABLE_MAIN
-		    || table_id == zebrad.rtm_table_default)
-			table = zebra_vrf_table(afi, safi, vrf_id);
-		else
-			table = zebra_vrf_other_route_table(afi, table_id,
-							    vrf_id);
-	} else
+	if (vrf_id == VRF_DEFAULT && table_id != RT_TABLE_MAIN
+	    && table_id != zebrad.rtm_table_default)
+		table = zebra_vrf_other_route_table(afi, table_id, vrf_id);
+	else if (create)
+		table = zebra_vrf_table_get(afi, safi, vrf_id);
+	else
 		table = zebra_vrf_table(afi, safi, vrf_id);
 
 	return table;
 }
 
+/* Lookup the routing table in a VRF based on both VRF-Id and table-id.
+ * NOTE: Table-id is relevant only in the Default VRF.
+ */
+struct route_table *zebra_vrf_table_with_table_id(afi_t afi, safi_t safi,
+						  vrf_id_t vrf_id,
+						  uint32_t table_id)
+{
+	return zebra_vrf_table_by_id(afi, safi, vrf_id, table_id, false);
+}
+
+/* As above, allocating the VRF's table if it is not there yet. */
+struct route_table *zebra_vrf_table_with_table_id_get(afi_t afi, safi_t safi,
+						      vrf_id_t vrf_id,
+						      uint32_t table_id)
+{
+	return zebra_vrf_table_by_id(afi, safi, vrf_id, table_id, true);
+}
+
 void zebra_rtable_node_cleanup(struct route_table *table,
 			       struct route_node *node)
 {
@@ -361,8 +342,10 @@ void zebra_rtable_node_cleanup(struct route_table *table,
 		rib_unlink(node, re);
 	}
 
-	if (node->info)
-		XFREE(MTYPE_RIB_DEST, node->info);
+	if (node->info) {
+		rib_dest_free(node->info);
+		node->info = NULL;
+	}
 }
 
 static void zebra_stable_node_cleanup(struct route_table *table,
@@ -373,17 +356,10 @@ static void zebra_stable_node_cleanup(struct route_table *table,
 	if (node->info)
 		for (si = node->info; si; si = next) {
 			next = si->next;
-			XFREE(MTYPE_STATIC_ROUTE, si);
+			static_route_free(si);
 		}
 }
 
-static void zebra_rnhtable_node_cleanup(struct route_table *table,
-					struct route_node *node)
-{
-	if (node->info)
-		zebra_free_rnh(node->info);
-}
-
 /*
  * Create a routing table for the specific AFI/SAFI in the given VRF.
  */
@@ -413,24 +389,9 @@ static void zebra_vrf_table_create(struct zebra_vrf *zvrf, afi_t afi,
 struct zebra_vrf *zebra_vrf_alloc(void)
 {
 	struct zebra_vrf *zvrf;
-	afi_t afi;
-	safi_t safi;
-	struct route_table *table;
 
 	zvrf = XCALLOC(MTYPE_ZEBRA_VRF, sizeof(struct zebra_vrf));
 
-	/* Allocate table for static route configuration. */
-	for (afi = AFI_IP; afi <= AFI_IP6; afi++) {
-		for (safi = SAFI_UNICAST; safi <= SAFI_MULTICAST; safi++) {
-			if (afi == AFI_IP6)
-				table = srcdest_table_init();
-			else
-				table = route_table_init();
-			table->cleanup = zebra_stable_node_cleanup;
-			zvrf->stable[afi][safi] = table;
-		}
-	}
-
 	zebra_vxlan_init_tables(zvrf);
 	zebra_mpls_init_tables(zvrf);
 	zebra_pw_init(zvrf);
@@ -473,6 +434,28 @@ struct route_table *zebra_vrf_table(afi_t afi, safi_t safi, vrf_id_t vrf_id)
 	return zvrf->table[afi][safi];
 }
 
+/* Lookup the routing table in an enabled VRF, allocating it on first use.
+ * Most VRFs only ever carry one or two address-families, so tables are not
+ * created up front.
+ */
+struct route_table *zebra_vrf_table_get(afi_t afi, safi_t safi,
+					vrf_id_t vrf_id)
+{
+	struct zebra_vrf *zvrf = vrf_info_lookup(vrf_id);
+
+	if (!zvrf || !zvrf_is_active(zvrf))
+		return NULL;
+
+	if (afi < AFI_IP || afi > AFI_IP6 || safi < SAFI_UNICAST
+	    || safi > SAFI_MULTICAST)
+		return NULL;
+
+	if (!zvrf->table[afi][safi])
+		zebra_vrf_table_create(zvrf, afi, safi);
+
+	return zvrf->table[afi][safi];
+}
+
 /* Lookup the static routing table in a VRF. */
 struct route_table *zebra_vrf_static_table(afi_t afi, safi_t safi,
 					   struct zebra_vrf *zvrf)
@@ -486,6 +469,44 @@ struct route_table *zebra_vrf_static_table(afi_t afi, safi_t safi,
 	return zvrf->stable[afi][safi];
 }
 
+/* As above, allocating the table when the first static route is added. */
+struct route_table *zebra_vrf_static_table_get(afi_t afi, safi_t safi,
+					       struct zebra_vrf *zvrf)
+{
+	struct route_table *table;
+
+	if (!zvrf)
+		return NULL;
+
+	if (afi < AFI_IP || afi > AFI_IP6 || safi < SAFI_UNICAST
+	    || safi > SAFI_MULTICAST)
+		return NULL;
+
+	if (!zvrf->stable[afi][safi]) {
+		if (afi == AFI_IP6)
+			table = srcdest_table_init();
+		else
+			table = route_table_init();
+		table->cleanup = zebra_stable_node_cleanup;
+		zvrf->stable[afi][safi] = table;
+	}
+
+	return zvrf->stable[afi][safi];
+}
+
+/* Free the static routing table once its last route is deleted. */
+void zebra_vrf_static_table_release(afi_t afi, safi_t safi,
+				    struct zebra_vrf *zvrf)
+{
+	struct route_table *table = zvrf->stable[afi][safi];
+
+	if (!table || route_table_count(table))
+		return;
+
+	route_table_finish(table);
+	zvrf->stable[afi][safi] = NULL;
+}
+
 struct route_table *zebra_vrf_other_route_table(afi_t afi, uint32_t table_id,
 						vrf_id_t vrf_id)
 {
@@ -62,6 +62,22 @@ struct zebra_vrf {
 	/* Import check table (used mostly by BGP */
 	struct route_table *import_check_table[AFI_MAX];
 
+	/*
+	 * Prefixes of the unicast table that were processed since tracked
+	 * nexthops were last evaluated.  Only tracked nexthops below one of
+	 * them need to be evaluated again, unless nht_all is set because
+	 * there were more of them than tracked nexthops.
+	 */
+	struct route_table *nht_changed[AFI_MAX];
+	bool nht_all[AFI_MAX];
+
+	/*
+	 * rib_update() events (1 << rib_update_event_t) yet to be handled
+	 * by t_rib_update, so that interface churn costs one table walk.
+	 */
+	uint8_t rib_update_pending;
+	struct thread *t_rib_update;
+
 	/* 2nd pointer type used primarily to quell a warning on
 	 * ALL_LIST_ELEMENTS_RO
 	 */
@@ -99,6 +115,16 @@ struct zebra_vrf {
 	uint16_t mpls_flags;
 #define MPLS_FLAG_SCHEDULE_LSPS    (1 << 0)
 
+	/*
+	 * NHLFEs indexed by nexthop gateway, and the connected prefixes
+	 * that changed since LSPs were last scheduled.  Only NHLFEs with
+	 * a gateway below a changed prefix need to be looked at again;
+	 * the ones without a gateway to resolve are kept on a list.
+	 */
+	struct route_table *nhlfe_gate_table[AFI_MAX];
+	struct zebra_nhlfe_t_ *nhlfe_nogate_list;
+	struct route_table *lsp_changed[AFI_MAX];
+
 	/*
 	 * VNI hash table (for EVPN). Only in default instance.
 	 */
@@ -153,14 +179,22 @@ static inline bool zvrf_is_active(struct zebra_vrf *zvrf)
 struct route_table *zebra_vrf_table_with_table_id(afi_t afi, safi_t safi,
 						  vrf_id_t vrf_id,
 						  uint32_t table_id);
+struct route_table *zebra_vrf_table_with_table_id_get(afi_t afi, safi_t safi,
+						      vrf_id_t vrf_id,
+						      uint32_t table_id);
 
 extern void zebra_vrf_update_all(struct zserv *client);
 extern struct zebra_vrf *zebra_vrf_lookup_by_id(vrf_id_t vrf_id);
 extern struct zebra_vrf *zebra_vrf_lookup_by_name(const char *);
 extern struct zebra_vrf *zebra_vrf_alloc(void);
 extern struct route_table *zebra_vrf_table(afi_t, safi_t, vrf_id_t);
+extern struct route_table *zebra_vrf_table_get(afi_t, safi_t, vrf_id_t);
 extern struct route_table *zebra_vrf_static_table(afi_t, safi_t,
 						  struct zebra_vrf *zvrf);
+extern struct route_table *zebra_vrf_static_table_get(afi_t, safi_t,
+						      struct zebra_vrf *zvrf);
+extern void zebra_vrf_static_table_release(afi_t, safi_t,
+					   struct zebra_vrf *zvrf);
 extern struct route_table *
 zebra_vrf_other_route_table(afi_t afi, uint32_t table_id, vrf_id_t vrf_id);
 extern int zebra_vrf_has_config(struct zebra_vrf *zvrf);
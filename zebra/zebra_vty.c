@@ -31,6 +31,7 @@
 #include "vrf.h"
 #include "linklist.h"
 #include "mpls.h"
+#include "workqueue.h"
 #include "routemap.h"
 #include "srcdest_table.h"
 #include "vxlan.h"
@@ -51,6 +52,8 @@
 #include "zebra/router-id.h"
 #include "zebra/ipforward.h"
 #include "zebra/zebra_vxlan_private.h"
+#include "zebra/zebra_nhg.h"
+#include "zebra/rt.h"
 
 extern int allow_delete;
 
@@ -66,6 +69,8 @@ static void vty_show_ip_route_summary(struct vty *vty,
 				      struct route_table *table);
 static void vty_show_ip_route_summary_prefix(struct vty *vty,
 					     struct route_table *table);
+static void vty_show_ip_route_summary_memory(struct vty *vty,
+					     struct route_table *table);
 
 /*
  * special macro to allow us to get the correct zebra_vrf
@@ -1776,6 +1781,7 @@ DEFUN (ip_nht_default_route,
 		return CMD_SUCCESS;
 
 	zebra_rnh_ip_default_route = 1;
+	zebra_nhg_invalidate();
 	zebra_evaluate_rnh(VRF_DEFAULT, AF_INET, 1, RNH_NEXTHOP_TYPE, NULL);
 	return CMD_SUCCESS;
 }
@@ -1792,6 +1798,7 @@ DEFUN (no_ip_nht_default_route,
 		return CMD_SUCCESS;
 
 	zebra_rnh_ip_default_route = 0;
+	zebra_nhg_invalidate();
 	zebra_evaluate_rnh(VRF_DEFAULT, AF_INET, 1, RNH_NEXTHOP_TYPE, NULL);
 	return CMD_SUCCESS;
 }
@@ -1807,6 +1814,7 @@ DEFUN (ipv6_nht_default_route,
 		return CMD_SUCCESS;
 
 	zebra_rnh_ipv6_default_route = 1;
+	zebra_nhg_invalidate();
 	zebra_evaluate_rnh(VRF_DEFAULT, AF_INET6, 1, RNH_NEXTHOP_TYPE, NULL);
 	return CMD_SUCCESS;
 }
@@ -1823,6 +1831,7 @@ DEFUN (no_ipv6_nht_default_route,
 		return CMD_SUCCESS;
 
 	zebra_rnh_ipv6_default_route = 0;
+	zebra_nhg_invalidate();
 	zebra_evaluate_rnh(VRF_DEFAULT, AF_INET6, 1, RNH_NEXTHOP_TYPE, NULL);
 	return CMD_SUCCESS;
 }
@@ -2007,9 +2016,9 @@ DEFPY (show_route_summary,
        "show\
          <\
           ip$ipv4 route [vrf <NAME$vrf_name|all$vrf_all>]\
-            summary [prefix$prefix]\
+            summary [<prefix$prefix|memory$memory>]\
           |ipv6$ipv6 route [vrf <NAME$vrf_name|all$vrf_all>]\
-	    summary [prefix$prefix]\
+	    summary [<prefix$prefix|memory$memory>]\
 	 >",
        SHOW_STR
        IP_STR
@@ -2017,11 +2026,13 @@ DEFPY (show_route_summary,
        VRF_FULL_CMD_HELP_STR
        "Summary of all routes\n"
        "Prefix routes\n"
+       "Memory used per route\n"
        IP6_STR
        "IP routing table\n"
        VRF_FULL_CMD_HELP_STR
        "Summary of all routes\n"
-       "Prefix routes\n")
+       "Prefix routes\n"
+       "Memory used per route\n")
 {
 	afi_t afi = ipv4 ? AFI_IP : AFI_IP6;
 	struct route_table *table;
@@ -2037,6 +2048,8 @@ DEFPY (show_route_summary,
 
 			if (prefix)
 				vty_show_ip_route_summary_prefix(vty, table);
+			else if (memory)
+				vty_show_ip_route_summary_memory(vty, table);
 			else
 				vty_show_ip_route_summary(vty, table);
 		}
@@ -2052,6 +2065,8 @@ DEFPY (show_route_summary,
 
 		if (prefix)
 			vty_show_ip_route_summary_prefix(vty, table);
+		else if (memory)
+			vty_show_ip_route_summary_memory(vty, table);
 		else
 			vty_show_ip_route_summary(vty, table);
 	}
@@ -2062,40 +2077,14 @@ DEFPY (show_route_summary,
 static void vty_show_ip_route_summary(struct vty *vty,
 				      struct route_table *table)
 {
-	struct route_node *rn;
-	struct route_entry *re;
-#define ZEBRA_ROUTE_IBGP  ZEBRA_ROUTE_MAX
-#define ZEBRA_ROUTE_TOTAL (ZEBRA_ROUTE_IBGP + 1)
-	uint32_t rib_cnt[ZEBRA_ROUTE_TOTAL + 1];
-	uint32_t fib_cnt[ZEBRA_ROUTE_TOTAL + 1];
+	rib_table_info_t *info = table->info;
+	uint32_t *rib_cnt = info->rib_cnt;
+	uint32_t *fib_cnt = info->fib_cnt;
 	uint32_t i;
-	uint32_t is_ibgp;
-
-	memset(&rib_cnt, 0, sizeof(rib_cnt));
-	memset(&fib_cnt, 0, sizeof(fib_cnt));
-	for (rn = route_top(table); rn; rn = srcdest_route_next(rn))
-		RNODE_FOREACH_RE (rn, re) {
-			is_ibgp = (re->type == ZEBRA_ROUTE_BGP
-				   && CHECK_FLAG(re->flags, ZEBRA_FLAG_IBGP));
-
-			rib_cnt[ZEBRA_ROUTE_TOTAL]++;
-			if (is_ibgp)
-				rib_cnt[ZEBRA_ROUTE_IBGP]++;
-			else
-				rib_cnt[re->type]++;
-
-			if (CHECK_FLAG(re->flags, ZEBRA_FLAG_SELECTED)) {
-				fib_cnt[ZEBRA_ROUTE_TOTAL]++;
-
-				if (is_ibgp)
-					fib_cnt[ZEBRA_ROUTE_IBGP]++;
-				else
-					fib_cnt[re->type]++;
-			}
-		}
 
+	/* The table keeps these counts as routes come and go. */
 	vty_out(vty, "%-20s %-20s %s  (vrf %s)\n", "Route Source", "Routes",
-		"FIB", zvrf_name(((rib_table_info_t *)table->info)->zvrf));
+		"FIB", zvrf_name(info->zvrf));
 
 	for (i = 0; i < ZEBRA_ROUTE_MAX; i++) {
 		if ((rib_cnt[i] > 0) || (i == ZEBRA_ROUTE_BGP
@@ -2133,8 +2122,6 @@ static void vty_show_ip_route_summary_prefix(struct vty *vty,
 	struct route_node *rn;
 	struct route_entry *re;
 	struct nexthop *nexthop;
-#define ZEBRA_ROUTE_IBGP  ZEBRA_ROUTE_MAX
-#define ZEBRA_ROUTE_TOTAL (ZEBRA_ROUTE_IBGP + 1)
 	uint32_t rib_cnt[ZEBRA_ROUTE_TOTAL + 1];
 	uint32_t fib_cnt[ZEBRA_ROUTE_TOTAL + 1];
 	uint32_t i;
@@ -2197,6 +2184,103 @@ static void vty_show_ip_route_summary_prefix(struct vty *vty,
 	vty_out(vty, "\n");
 }
 
+/*
+ * Implementation of the ip route summary memory command.
+ *
+ * This command prints, per protocol, how much memory its routes take: the
+ * route entry, its nexthops, and its share of the dest and route node of
+ * its prefix and of the shared nexthop group it uses, if any. Routes stored
+ * along with their dest are counted as compact.
+ */
+static void vty_show_ip_route_summary_memory(struct vty *vty,
+					     struct route_table *table)
+{
+	struct route_node *rn;
+	struct route_entry *re;
+	struct nexthop *nexthop;
+	rib_dest_t *dest;
+	uint32_t rib_cnt[ZEBRA_ROUTE_TOTAL + 1];
+	uint32_t compact_cnt[ZEBRA_ROUTE_TOTAL + 1];
+	uint64_t bytes[ZEBRA_ROUTE_TOTAL + 1];
+	unsigned int routes;
+	size_t shared, size;
+	uint32_t i, nhs;
+	int type;
+
+	memset(&rib_cnt, 0, sizeof(rib_cnt));
+	memset(&compact_cnt, 0, sizeof(compact_cnt));
+	memset(&bytes, 0, sizeof(bytes));
+	for (rn = route_top(table); rn; rn = srcdest_route_next(rn)) {
+		dest = rib_dest_from_rnode(rn);
+		if (!dest)
+			continue;
+
+		routes = 0;
+		RE_DEST_FOREACH_ROUTE (dest, re)
+			routes++;
+		if (!routes)
+			continue;
+
+		/* the slot's route is accounted for as a route */
+		shared = sizeof(struct route_node) + sizeof(rib_dest_t);
+
+		RE_DEST_FOREACH_ROUTE (dest, re) {
+			if (re->type == ZEBRA_ROUTE_BGP
+			    && CHECK_FLAG(re->flags, ZEBRA_FLAG_IBGP))
+				type = ZEBRA_ROUTE_IBGP;
+			else
+				type = re->type;
+
+			nhs = 0;
+			for (ALL_NEXTHOPS(re->ng, nexthop))
+				nhs++;
+
+			size = sizeof(struct route_entry) + shared / routes;
+			if (re->nhe)
+				size += (sizeof(struct nhg_hash_entry)
+					 + nhs * sizeof(struct nexthop))
+					/ re->nhe->refcnt;
+			else
+				size += nhs * sizeof(struct nexthop);
+
+			rib_cnt[type]++;
+			rib_cnt[ZEBRA_ROUTE_TOTAL]++;
+			bytes[type] += size;
+			bytes[ZEBRA_ROUTE_TOTAL] += size;
+			if (CHECK_FLAG(re->status, ROUTE_ENTRY_EMBEDDED)) {
+				compact_cnt[type]++;
+				compact_cnt[ZEBRA_ROUTE_TOTAL]++;
+			}
+		}
+	}
+
+	vty_out(vty, "%-20s %-12s %-12s %-12s %s  (vrf %s)\n", "Route Source",
+		"Routes", "Compact", "Bytes", "Bytes/Route",
+		zvrf_name(((rib_table_info_t *)table->info)->zvrf));
+
+	for (i = 0; i < ZEBRA_ROUTE_TOTAL; i++) {
+		if (!rib_cnt[i])
+			continue;
+
+		vty_out(vty, "%-20s %-12u %-12u %-12" PRIu64 " %" PRIu64 "\n",
+			i == ZEBRA_ROUTE_IBGP
+				? "ibgp"
+				: i == ZEBRA_ROUTE_BGP ? "ebgp"
+						       : zebra_route_string(i),
+			rib_cnt[i], compact_cnt[i], bytes[i],
+			bytes[i] / rib_cnt[i]);
+	}
+
+	vty_out(vty, "------\n");
+	vty_out(vty, "%-20s %-12u %-12u %-12" PRIu64 " %" PRIu64 "\n",
+		"Totals", rib_cnt[ZEBRA_ROUTE_TOTAL],
+		compact_cnt[ZEBRA_ROUTE_TOTAL], bytes[ZEBRA_ROUTE_TOTAL],
+		rib_cnt[ZEBRA_ROUTE_TOTAL]
+			? bytes[ZEBRA_ROUTE_TOTAL] / rib_cnt[ZEBRA_ROUTE_TOTAL]
+			: 0);
+	vty_out(vty, "\n");
+}
+
 /* Write static route configuration. */
 int static_config(struct vty *vty, struct zebra_vrf *zvrf, afi_t afi,
 		  safi_t safi, const char *cmd)
@@ -3330,6 +3414,74 @@ DEFUN_HIDDEN (no_zebra_packet_process,
 	return CMD_SUCCESS;
 }
 
+DEFUN (zebra_zapi_watermark,
+       zebra_zapi_watermark_cmd,
+       "zebra zapi-watermark high (1-10000000) low (0-10000000)",
+       ZEBRA_STR
+       "Messages waiting to be sent to a client\n"
+       "Stop processing the client's requests at this many\n"
+       "Number of messages\n"
+       "Resume once down to this many\n"
+       "Number of messages\n")
+{
+	uint32_t high = strtoul(argv[3]->arg, NULL, 10);
+	uint32_t low = strtoul(argv[5]->arg, NULL, 10);
+
+	if (low >= high) {
+		vty_out(vty, "%% Low watermark must be below the high one\n");
+		return CMD_WARNING_CONFIG_FAILED;
+	}
+
+	zebrad.zapi_wm_high = high;
+	zebrad.zapi_wm_low = low;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_zapi_watermark,
+       no_zebra_zapi_watermark_cmd,
+       "no zebra zapi-watermark [high (1-10000000) low (0-10000000)]",
+       NO_STR
+       ZEBRA_STR
+       "Messages waiting to be sent to a client\n"
+       "Stop processing the client's requests at this many\n"
+       "Number of messages\n"
+       "Resume once down to this many\n"
+       "Number of messages\n")
+{
+	zebrad.zapi_wm_high = ZEBRA_ZAPI_WM_HIGH;
+	zebrad.zapi_wm_low = ZEBRA_ZAPI_WM_LOW;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN (zebra_interface_hold_time,
+       zebra_interface_hold_time_cmd,
+       "zebra interface hold-time (0-10000)",
+       ZEBRA_STR
+       "Interface events\n"
+       "Hold up/down changes back while an interface flaps\n"
+       "Time in milliseconds\n")
+{
+	zebrad.if_hold_time = strtoul(argv[3]->arg, NULL, 10);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_interface_hold_time,
+       no_zebra_interface_hold_time_cmd,
+       "no zebra interface hold-time [(0-10000)]",
+       NO_STR
+       ZEBRA_STR
+       "Interface events\n"
+       "Hold up/down changes back while an interface flaps\n"
+       "Time in milliseconds\n")
+{
+	zebrad.if_hold_time = ZEBRA_IF_HOLD_TIME;
+
+	return CMD_SUCCESS;
+}
+
 DEFUN_HIDDEN (zebra_workqueue_timer,
 	      zebra_workqueue_timer_cmd,
 	      "zebra work-queue (0-10000)",
@@ -3343,6 +3495,69 @@ DEFUN_HIDDEN (zebra_workqueue_timer,
 	return CMD_SUCCESS;
 }
 
+DEFUN_HIDDEN (zebra_workqueue_batch,
+	      zebra_workqueue_batch_cmd,
+	      "zebra work-queue batch (1-10000)",
+	      ZEBRA_STR
+	      "Work Queue\n"
+	      "Route nodes to process before checking whether to yield\n"
+	      "Number of route nodes\n")
+{
+	zebrad.rib_batch = strtoul(argv[3]->arg, NULL, 10);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_HIDDEN (no_zebra_workqueue_batch,
+	      no_zebra_workqueue_batch_cmd,
+	      "no zebra work-queue batch [(1-10000)]",
+	      NO_STR
+	      ZEBRA_STR
+	      "Work Queue\n"
+	      "Route nodes to process before checking whether to yield\n"
+	      "Number of route nodes\n")
+{
+	zebrad.rib_batch = ZEBRA_RIB_PROCESS_BATCH;
+
+	return CMD_SUCCESS;
+}
+
+static void zebra_workqueue_max_stall_set(uint32_t msecs)
+{
+	zebrad.wq_max_stall = msecs;
+	if (zebrad.ribq)
+		zebrad.ribq->spec.max_stall = msecs * 1000UL;
+	if (zebrad.lsp_process_q)
+		zebrad.lsp_process_q->spec.max_stall = msecs * 1000UL;
+}
+
+DEFUN (zebra_workqueue_max_stall,
+       zebra_workqueue_max_stall_cmd,
+       "zebra work-queue max-stall (1-1000)",
+       ZEBRA_STR
+       "Work Queue\n"
+       "Tune batching to keep each run of the route and LSP queues short\n"
+       "Longest run in milliseconds\n")
+{
+	zebra_workqueue_max_stall_set(strtoul(argv[3]->arg, NULL, 10));
+
+	return CMD_SUCCESS;
+}
+
+DEFUN (no_zebra_workqueue_max_stall,
+       no_zebra_workqueue_max_stall_cmd,
+       "no zebra work-queue max-stall [(1-1000)]",
+       NO_STR
+       ZEBRA_STR
+       "Work Queue\n"
+       "Tune batching to keep each run of the route and LSP queues short\n"
+       "Longest run in milliseconds\n")
+{
+	zebra_workqueue_max_stall_set(0);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN_HIDDEN (no_zebra_workqueue_timer,
 	      no_zebra_workqueue_timer_cmd,
 	      "no zebra work-queue [(0-10000)]",
@@ -3404,10 +3619,26 @@ static int config_write_protocol(struct vty *vty)
 	if (zebrad.ribq->spec.hold != ZEBRA_RIB_PROCESS_HOLD_TIME)
 		vty_out(vty, "zebra work-queue %u\n", zebrad.ribq->spec.hold);
 
+	if (zebrad.rib_batch != ZEBRA_RIB_PROCESS_BATCH)
+		vty_out(vty, "zebra work-queue batch %u\n", zebrad.rib_batch);
+
+	if (zebrad.wq_max_stall)
+		vty_out(vty, "zebra work-queue max-stall %u\n",
+			zebrad.wq_max_stall);
+
 	if (zebrad.packets_to_process != ZEBRA_ZAPI_PACKETS_TO_PROCESS)
 		vty_out(vty, "zebra zapi-packets %u\n",
 			zebrad.packets_to_process);
 
+	if (zebrad.zapi_wm_high != ZEBRA_ZAPI_WM_HIGH
+	    || zebrad.zapi_wm_low != ZEBRA_ZAPI_WM_LOW)
+		vty_out(vty, "zebra zapi-watermark high %u low %u\n",
+			zebrad.zapi_wm_high, zebrad.zapi_wm_low);
+
+	if (zebrad.if_hold_time != ZEBRA_IF_HOLD_TIME)
+		vty_out(vty, "zebra interface hold-time %u\n",
+			zebrad.if_hold_time);
+
 	enum multicast_mode ipv4_multicast_mode = multicast_mode_ipv4_get();
 
 	if (ipv4_multicast_mode != MCAST_NO_CONFIG)
@@ -3469,7 +3700,11 @@ DEFUN (show_zebra,
        SHOW_STR
        ZEBRA_STR)
 {
+	static const char *const mq_names[MQ_SIZE] = {
+		"connected, kernel", "static", "IGP", "BGP", "other",
+	};
 	struct vrf *vrf;
+	unsigned i;
 
 	vty_out(vty,
 		"                            Route      Route      Neighbor   LSP        LSP\n");
@@ -3486,6 +3721,59 @@ DEFUN (show_zebra,
 			zvrf->lsp_removals);
 	}
 
+	vty_out(vty, "\nMeta queue, up to %u route nodes per run\n",
+		zebrad.rib_batch);
+	vty_out(vty,
+		"Sub-queue                           Max                Avg        Max\n");
+	vty_out(vty,
+		"                       Depth      Depth  Processed   usecs      usecs\n");
+	for (i = 0; i < MQ_SIZE; i++) {
+		uint64_t n = zebrad.mq->stats[i].processed;
+
+		vty_out(vty, "%-20s %7u %10u %10" PRIu64 " %7" PRIu64
+			     " %10" PRIu64 "\n",
+			mq_names[i], zebrad.mq->stats[i].len,
+			zebrad.mq->stats[i].max_len, n,
+			n ? zebrad.mq->stats[i].usecs / n : 0,
+			zebrad.mq->stats[i].max_usecs);
+	}
+
+	kernel_nhg_show(vty);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN (show_zebra_pipeline_latency,
+       show_zebra_pipeline_latency_cmd,
+       "show zebra pipeline-latency [json]",
+       SHOW_STR
+       ZEBRA_STR
+       "Latency of sampled routes from clients, by stage\n"
+       JSON_STR)
+{
+	json_object *json = NULL;
+
+	if (use_json(argc, argv))
+		json = json_object_new_object();
+
+	pipeline_stages_show(vty, rib_pipeline, RIB_PIPELINE_STAGES, json);
+
+	if (json) {
+		vty_out(vty, "%s\n", json_object_to_json_string_ext(
+					     json, JSON_C_TO_STRING_PRETTY));
+		json_object_free(json);
+	}
+	return CMD_SUCCESS;
+}
+
+DEFUN (clear_zebra_pipeline_latency,
+       clear_zebra_pipeline_latency_cmd,
+       "clear zebra pipeline-latency",
+       CLEAR_STR
+       ZEBRA_STR
+       "Latency of sampled routes from clients, by stage\n")
+{
+	pipeline_stages_clear(rib_pipeline, RIB_PIPELINE_STAGES);
 	return CMD_SUCCESS;
 }
 
@@ -3663,6 +3951,8 @@ void zebra_vty_init(void)
 	install_element(CONFIG_NODE, &ip_forwarding_cmd);
 	install_element(CONFIG_NODE, &no_ip_forwarding_cmd);
 	install_element(ENABLE_NODE, &show_zebra_cmd);
+	install_element(VIEW_NODE, &show_zebra_pipeline_latency_cmd);
+	install_element(ENABLE_NODE, &clear_zebra_pipeline_latency_cmd);
 
 #ifdef HAVE_NETLINK
 	install_element(VIEW_NODE, &show_table_cmd);
@@ -3695,6 +3985,14 @@ void zebra_vty_init(void)
 	install_element(CONFIG_NODE, &no_ip_zebra_import_table_cmd);
 	install_element(CONFIG_NODE, &zebra_workqueue_timer_cmd);
 	install_element(CONFIG_NODE, &no_zebra_workqueue_timer_cmd);
+	install_element(CONFIG_NODE, &zebra_workqueue_batch_cmd);
+	install_element(CONFIG_NODE, &zebra_zapi_watermark_cmd);
+	install_element(CONFIG_NODE, &no_zebra_zapi_watermark_cmd);
+	install_element(CONFIG_NODE, &zebra_interface_hold_time_cmd);
+	install_element(CONFIG_NODE, &no_zebra_interface_hold_time_cmd);
+	install_element(CONFIG_NODE, &no_zebra_workqueue_batch_cmd);
+	install_element(CONFIG_NODE, &zebra_workqueue_max_stall_cmd);
+	install_element(CONFIG_NODE, &no_zebra_workqueue_max_stall_cmd);
 	install_element(CONFIG_NODE, &zebra_packet_process_cmd);
 	install_element(CONFIG_NODE, &no_zebra_packet_process_cmd);
 
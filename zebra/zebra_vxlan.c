@@ -51,6 +51,7 @@ DEFINE_MTYPE_STATIC(ZEBRA, HOST_PREFIX, "host prefix");
 DEFINE_MTYPE_STATIC(ZEBRA, ZVNI, "VNI hash");
 DEFINE_MTYPE_STATIC(ZEBRA, ZL3VNI, "L3 VNI hash");
 DEFINE_MTYPE_STATIC(ZEBRA, ZVNI_VTEP, "VNI remote VTEP");
+DEFINE_MTYPE_STATIC(ZEBRA, ZVNI_VTEP_HOSTS, "VNI remote VTEP hosts");
 DEFINE_MTYPE_STATIC(ZEBRA, MAC, "VNI MAC");
 DEFINE_MTYPE_STATIC(ZEBRA, NEIGH, "VNI Neighbor");
 
@@ -171,6 +172,14 @@ static int zvni_vtep_del(zebra_vni_t *zvni, zebra_vtep_t *zvtep);
 static int zvni_vtep_del_all(zebra_vni_t *zvni, int uninstall);
 static int zvni_vtep_install(zebra_vni_t *zvni, struct in_addr *vtep_ip);
 static int zvni_vtep_uninstall(zebra_vni_t *zvni, struct in_addr *vtep_ip);
+static unsigned int vtep_hosts_hash_keymake(void *p);
+static int vtep_hosts_cmp(const void *p1, const void *p2);
+static zebra_vtep_hosts_t *zvni_vtep_hosts_lookup(zebra_vni_t *zvni,
+						  struct in_addr *vtep_ip);
+static void zvni_mac_vtep_link(zebra_vni_t *zvni, zebra_mac_t *mac);
+static void zvni_mac_vtep_unlink(zebra_vni_t *zvni, zebra_mac_t *mac);
+static void zvni_neigh_vtep_link(zebra_vni_t *zvni, zebra_neigh_t *n);
+static void zvni_neigh_vtep_unlink(zebra_vni_t *zvni, zebra_neigh_t *n);
 static int zvni_del_macip_for_intf(struct interface *ifp, zebra_vni_t *zvni);
 static int zvni_add_macip_for_intf(struct interface *ifp, zebra_vni_t *zvni);
 static int zvni_gw_macip_add(struct interface *ifp, zebra_vni_t *zvni,
@@ -184,29 +193,26 @@ static void zvni_deref_ip2mac(zebra_vni_t *zvni, zebra_mac_t *mac,
 
 /* Private functions */
 
+static void num_valid_macs_hash(struct hash_backet *backet, void *ctxt)
+{
+	zebra_mac_t *mac = (zebra_mac_t *)backet->data;
+	uint32_t *num_macs = ctxt;
+
+	if (CHECK_FLAG(mac->flags, ZEBRA_MAC_REMOTE)
+	    || !CHECK_FLAG(mac->flags, ZEBRA_MAC_AUTO))
+		(*num_macs)++;
+}
+
 /*
  * Return number of valid MACs in a VNI's MAC hash table - all
  * remote MACs and non-internal (auto) local MACs count.
  */
 static uint32_t num_valid_macs(zebra_vni_t *zvni)
 {
-	unsigned int i;
 	uint32_t num_macs = 0;
-	struct hash *hash;
-	struct hash_backet *hb;
-	zebra_mac_t *mac;
 
-	hash = zvni->mac_table;
-	if (!hash)
-		return num_macs;
-	for (i = 0; i < hash->size; i++) {
-		for (hb = hash->index[i]; hb; hb = hb->next) {
-			mac = (zebra_mac_t *)hb->data;
-			if (CHECK_FLAG(mac->flags, ZEBRA_MAC_REMOTE)
-			    || !CHECK_FLAG(mac->flags, ZEBRA_MAC_AUTO))
-				num_macs++;
-		}
-	}
+	if (zvni->mac_table)
+		hash_iterate(zvni->mac_table, num_valid_macs_hash, &num_macs);
 
 	return num_macs;
 }
@@ -1283,6 +1289,8 @@ static int zvni_neigh_del(zebra_vni_t *zvni, zebra_neigh_t *n)
 	if (zmac)
 		listnode_delete(zmac->neigh_list, n);
 
+	zvni_neigh_vtep_unlink(zvni, n);
+
 	/* Free the VNI hash entry and allocated memory. */
 	tmp_n = hash_release(zvni->neigh_table, n);
 	if (tmp_n)
@@ -1301,10 +1309,7 @@ static int zvni_neigh_del_hash_entry(struct hash_backet *backet, void *arg)
 
 	if (((wctx->flags & DEL_LOCAL_NEIGH) && (n->flags & ZEBRA_NEIGH_LOCAL))
 	    || ((wctx->flags & DEL_REMOTE_NEIGH)
-		&& (n->flags & ZEBRA_NEIGH_REMOTE))
-	    || ((wctx->flags & DEL_REMOTE_NEIGH_FROM_VTEP)
-		&& (n->flags & ZEBRA_NEIGH_REMOTE)
-		&& IPV4_ADDR_SAME(&n->r_vtep_ip, &wctx->r_vtep_ip))) {
+		&& (n->flags & ZEBRA_NEIGH_REMOTE))) {
 		if (wctx->upd_client && (n->flags & ZEBRA_NEIGH_LOCAL))
 			zvni_neigh_send_del_to_client(wctx->zvni->vni, &n->ip,
 						      &n->emac, 0);
@@ -1324,21 +1329,23 @@ static int zvni_neigh_del_hash_entry(struct hash_backet *backet, void *arg)
 static void zvni_neigh_del_from_vtep(zebra_vni_t *zvni, int uninstall,
 				     struct in_addr *r_vtep_ip)
 {
-	struct neigh_walk_ctx wctx;
+	zebra_vtep_hosts_t *hosts;
+	zebra_neigh_t *n;
 
-	if (!zvni->neigh_table)
-		return;
+	/* Every pass unlinks a neighbor; the last one takes hosts along. */
+	while ((hosts = zvni_vtep_hosts_lookup(zvni, r_vtep_ip))
+	       && (n = TAILQ_FIRST(&hosts->neighs))) {
+		if (!(n->flags & ZEBRA_NEIGH_REMOTE)
+		    || !IPV4_ADDR_SAME(&n->r_vtep_ip, r_vtep_ip)) {
+			zvni_neigh_vtep_unlink(zvni, n);
+			continue;
+		}
 
-	memset(&wctx, 0, sizeof(struct neigh_walk_ctx));
-	wctx.zvni = zvni;
-	wctx.uninstall = uninstall;
-	wctx.flags = DEL_REMOTE_NEIGH_FROM_VTEP;
-	wctx.r_vtep_ip = *r_vtep_ip;
+		if (uninstall)
+			zvni_neigh_uninstall(zvni, n);
 
-	hash_iterate(zvni->neigh_table,
-		     (void (*)(struct hash_backet *,
-			       void *))zvni_neigh_del_hash_entry,
-		     &wctx);
+		zvni_neigh_del(zvni, n);
+	}
 }
 
 /*
@@ -2001,6 +2008,8 @@ static int zvni_mac_del(zebra_vni_t *zvni, zebra_mac_t *mac)
 
 	list_delete_and_null(&mac->neigh_list);
 
+	zvni_mac_vtep_unlink(zvni, mac);
+
 	/* Free the VNI hash entry and allocated memory. */
 	tmp_mac = hash_release(zvni->mac_table, mac);
 	if (tmp_mac)
@@ -2019,11 +2028,7 @@ static int zvni_mac_del_hash_entry(struct hash_backet *backet, void *arg)
 
 	if (((wctx->flags & DEL_LOCAL_MAC) && (mac->flags & ZEBRA_MAC_LOCAL))
 	    || ((wctx->flags & DEL_REMOTE_MAC)
-		&& (mac->flags & ZEBRA_MAC_REMOTE))
-	    || ((wctx->flags & DEL_REMOTE_MAC_FROM_VTEP)
-		&& (mac->flags & ZEBRA_MAC_REMOTE)
-		&& IPV4_ADDR_SAME(&mac->fwd_info.r_vtep_ip,
-				  &wctx->r_vtep_ip))) {
+		&& (mac->flags & ZEBRA_MAC_REMOTE))) {
 		if (wctx->upd_client && (mac->flags & ZEBRA_MAC_LOCAL)) {
 			zvni_mac_send_del_to_client(wctx->zvni->vni,
 						    &mac->macaddr, mac->flags);
@@ -2044,20 +2049,23 @@ static int zvni_mac_del_hash_entry(struct hash_backet *backet, void *arg)
 static void zvni_mac_del_from_vtep(zebra_vni_t *zvni, int uninstall,
 				   struct in_addr *r_vtep_ip)
 {
-	struct mac_walk_ctx wctx;
+	zebra_vtep_hosts_t *hosts;
+	zebra_mac_t *mac;
 
-	if (!zvni->mac_table)
-		return;
+	/* Every pass unlinks a MAC; the last one takes hosts along. */
+	while ((hosts = zvni_vtep_hosts_lookup(zvni, r_vtep_ip))
+	       && (mac = TAILQ_FIRST(&hosts->macs))) {
+		if (!(mac->flags & ZEBRA_MAC_REMOTE)
+		    || !IPV4_ADDR_SAME(&mac->fwd_info.r_vtep_ip, r_vtep_ip)) {
+			zvni_mac_vtep_unlink(zvni, mac);
+			continue;
+		}
 
-	memset(&wctx, 0, sizeof(struct mac_walk_ctx));
-	wctx.zvni = zvni;
-	wctx.uninstall = uninstall;
-	wctx.flags = DEL_REMOTE_MAC_FROM_VTEP;
-	wctx.r_vtep_ip = *r_vtep_ip;
+		if (uninstall)
+			zvni_mac_uninstall(zvni, mac, 0);
 
-	hash_iterate(zvni->mac_table, (void (*)(struct hash_backet *,
-						void *))zvni_mac_del_hash_entry,
-		     &wctx);
+		zvni_mac_del(zvni, mac);
+	}
 }
 
 /*
@@ -2516,10 +2524,17 @@ static zebra_vni_t *zvni_add(vni_t vni)
 	/* Create hash table for MAC */
 	zvni->mac_table =
 		hash_create(mac_hash_keymake, mac_cmp, "Zebra VNI MAC Table");
+	zvni->mac_table->incremental = true;
 
 	/* Create hash table for neighbors */
 	zvni->neigh_table = hash_create(neigh_hash_keymake, neigh_cmp,
 					"Zebra VNI Neighbor Table");
+	zvni->neigh_table->incremental = true;
+
+	/* Create hash table for remote MACs and neighbors by VTEP */
+	zvni->vtep_hosts_table =
+		hash_create(vtep_hosts_hash_keymake, vtep_hosts_cmp,
+			    "Zebra VNI VTEP Hosts Table");
 
 	return zvni;
 }
@@ -2545,6 +2560,10 @@ static int zvni_del(zebra_vni_t *zvni)
 	hash_free(zvni->mac_table);
 	zvni->mac_table = NULL;
 
+	/* Free the VTEP hosts hash table. */
+	hash_free(zvni->vtep_hosts_table);
+	zvni->vtep_hosts_table = NULL;
+
 	/* Free the VNI hash entry and allocated memory. */
 	tmp_zvni = hash_release(zvrf->vni_table, zvni);
 	if (tmp_zvni)
@@ -2801,6 +2820,149 @@ static int zvni_vtep_del_all(zebra_vni_t *zvni, int uninstall)
 	return 0;
 }
 
+/*
+ * Make hash key for the remote MACs and neighbors of a VTEP.
+ */
+static unsigned int vtep_hosts_hash_keymake(void *p)
+{
+	zebra_vtep_hosts_t *hosts = p;
+
+	return jhash_1word(hosts->vtep_ip.s_addr, 0);
+}
+
+/*
+ * Compare two VTEP hosts hash structures.
+ */
+static int vtep_hosts_cmp(const void *p1, const void *p2)
+{
+	const zebra_vtep_hosts_t *hosts1 = p1;
+	const zebra_vtep_hosts_t *hosts2 = p2;
+
+	return IPV4_ADDR_SAME(&hosts1->vtep_ip, &hosts2->vtep_ip);
+}
+
+/*
+ * Callback to allocate VTEP hosts hash entry.
+ */
+static void *zvni_vtep_hosts_alloc(void *p)
+{
+	const zebra_vtep_hosts_t *tmp_hosts = p;
+	zebra_vtep_hosts_t *hosts;
+
+	hosts = XCALLOC(MTYPE_ZVNI_VTEP_HOSTS, sizeof(zebra_vtep_hosts_t));
+	hosts->vtep_ip = tmp_hosts->vtep_ip;
+	TAILQ_INIT(&hosts->macs);
+	TAILQ_INIT(&hosts->neighs);
+
+	return ((void *)hosts);
+}
+
+/*
+ * Look up the remote MACs and neighbors of a VTEP.
+ */
+static zebra_vtep_hosts_t *zvni_vtep_hosts_lookup(zebra_vni_t *zvni,
+						  struct in_addr *vtep_ip)
+{
+	zebra_vtep_hosts_t tmp;
+
+	if (!zvni->vtep_hosts_table)
+		return NULL;
+
+	memset(&tmp, 0, sizeof(tmp));
+	tmp.vtep_ip = *vtep_ip;
+
+	return hash_lookup(zvni->vtep_hosts_table, &tmp);
+}
+
+/*
+ * Free the VTEP hosts hash entry once nothing is linked to it.
+ */
+static void zvni_vtep_hosts_check_free(zebra_vni_t *zvni,
+				       zebra_vtep_hosts_t *hosts)
+{
+	if (!TAILQ_EMPTY(&hosts->macs) || !TAILQ_EMPTY(&hosts->neighs))
+		return;
+
+	hosts = hash_release(zvni->vtep_hosts_table, hosts);
+	if (hosts)
+		XFREE(MTYPE_ZVNI_VTEP_HOSTS, hosts);
+}
+
+/*
+ * Link a remote MAC to the VTEP it now points to.
+ */
+static void zvni_mac_vtep_link(zebra_vni_t *zvni, zebra_mac_t *mac)
+{
+	zebra_vtep_hosts_t tmp;
+	zebra_vtep_hosts_t *hosts;
+
+	if (mac->vtep_hosts
+	    && IPV4_ADDR_SAME(&mac->vtep_hosts->vtep_ip,
+			      &mac->fwd_info.r_vtep_ip))
+		return;
+
+	zvni_mac_vtep_unlink(zvni, mac);
+
+	memset(&tmp, 0, sizeof(tmp));
+	tmp.vtep_ip = mac->fwd_info.r_vtep_ip;
+	hosts = hash_get(zvni->vtep_hosts_table, &tmp, zvni_vtep_hosts_alloc);
+
+	TAILQ_INSERT_TAIL(&hosts->macs, mac, vtep_entries);
+	mac->vtep_hosts = hosts;
+}
+
+/*
+ * Unlink a MAC from its remote VTEP, if any.
+ */
+static void zvni_mac_vtep_unlink(zebra_vni_t *zvni, zebra_mac_t *mac)
+{
+	zebra_vtep_hosts_t *hosts = mac->vtep_hosts;
+
+	if (!hosts)
+		return;
+
+	TAILQ_REMOVE(&hosts->macs, mac, vtep_entries);
+	mac->vtep_hosts = NULL;
+	zvni_vtep_hosts_check_free(zvni, hosts);
+}
+
+/*
+ * Link a remote neighbor to the VTEP it now points to.
+ */
+static void zvni_neigh_vtep_link(zebra_vni_t *zvni, zebra_neigh_t *n)
+{
+	zebra_vtep_hosts_t tmp;
+	zebra_vtep_hosts_t *hosts;
+
+	if (n->vtep_hosts
+	    && IPV4_ADDR_SAME(&n->vtep_hosts->vtep_ip, &n->r_vtep_ip))
+		return;
+
+	zvni_neigh_vtep_unlink(zvni, n);
+
+	memset(&tmp, 0, sizeof(tmp));
+	tmp.vtep_ip = n->r_vtep_ip;
+	hosts = hash_get(zvni->vtep_hosts_table, &tmp, zvni_vtep_hosts_alloc);
+
+	TAILQ_INSERT_TAIL(&hosts->neighs, n, vtep_entries);
+	n->vtep_hosts = hosts;
+}
+
+/*
+ * Unlink a neighbor from its remote VTEP, if any.
+ */
+static void zvni_neigh_vtep_unlink(zebra_vni_t *zvni, zebra_neigh_t *n)
+{
+	zebra_vtep_hosts_t *hosts = n->vtep_hosts;
+
+	if (!hosts)
+		return;
+
+	TAILQ_REMOVE(&hosts->neighs, n, vtep_entries);
+	n->vtep_hosts = NULL;
+	zvni_vtep_hosts_check_free(zvni, hosts);
+}
+
 /*
  * Install remote VTEP into the kernel.
  */
@@ -4814,6 +4976,7 @@ int zebra_vxlan_local_neigh_add_update(struct interface *ifp,
 		{
 			UNSET_FLAG(n->flags, ZEBRA_NEIGH_REMOTE);
 			n->r_vtep_ip.s_addr = 0;
+			zvni_neigh_vtep_unlink(zvni, n);
 			SET_FLAG(n->flags, ZEBRA_NEIGH_LOCAL);
 			n->ifindex = ifp->ifindex;
 		}
@@ -5167,6 +5330,7 @@ void zebra_vxlan_remote_macip_add(ZAPI_HANDLER_ARGS)
 			memset(&mac->fwd_info, 0, sizeof(mac->fwd_info));
 			SET_FLAG(mac->flags, ZEBRA_MAC_REMOTE);
 			mac->fwd_info.r_vtep_ip = vtep_ip;
+			zvni_mac_vtep_link(zvni, mac);
 
 			if (sticky)
 				SET_FLAG(mac->flags, ZEBRA_MAC_STICKY);
@@ -5228,6 +5392,7 @@ void zebra_vxlan_remote_macip_add(ZAPI_HANDLER_ARGS)
 			/* TODO: Handle MAC change. */
 			n->r_vtep_ip = vtep_ip;
 			SET_FLAG(n->flags, ZEBRA_NEIGH_REMOTE);
+			zvni_neigh_vtep_link(zvni, n);
 
 			/* Install the entry. */
 			zvni_neigh_install(zvni, n);
@@ -5516,6 +5681,7 @@ int zebra_vxlan_local_mac_add_update(struct interface *ifp,
 	UNSET_FLAG(mac->flags, ZEBRA_MAC_REMOTE);
 	UNSET_FLAG(mac->flags, ZEBRA_MAC_AUTO);
 	SET_FLAG(mac->flags, ZEBRA_MAC_LOCAL);
+	zvni_mac_vtep_unlink(zvni, mac);
 	memset(&mac->fwd_info, 0, sizeof(mac->fwd_info));
 	mac->fwd_info.local.ifindex = ifp->ifindex;
 	mac->fwd_info.local.vid = vid;
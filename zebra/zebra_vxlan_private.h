@@ -30,6 +30,7 @@
 
 #include "if.h"
 #include "linklist.h"
+#include "queue.h"
 #include "zebra_vxlan.h"
 
 #define ERR_STR_SZ 256
@@ -37,6 +38,7 @@
 /* definitions */
 typedef struct zebra_vni_t_ zebra_vni_t;
 typedef struct zebra_vtep_t_ zebra_vtep_t;
+typedef struct zebra_vtep_hosts_t_ zebra_vtep_hosts_t;
 typedef struct zebra_mac_t_ zebra_mac_t;
 typedef struct zebra_neigh_t_ zebra_neigh_t;
 typedef struct zebra_l3vni_t_ zebra_l3vni_t;
@@ -56,6 +58,21 @@ struct zebra_vtep_t_ {
 	struct zebra_vtep_t_ *prev;
 };
 
+/*
+ * Remote MACs and neighbors of a VNI by the VTEP they were learnt from, so
+ * that the ones of a VTEP going away are found without walking all of the
+ * VNI's.  Entries are linked when they become remote and unlinked when
+ * they are freed or turn local; whoever walks the lists still checks that
+ * an entry is remote from the VTEP.
+ */
+struct zebra_vtep_hosts_t_ {
+	/* Remote VTEP IP - key */
+	struct in_addr vtep_ip;
+
+	TAILQ_HEAD(, zebra_mac_t_) macs;
+	TAILQ_HEAD(, zebra_neigh_t_) neighs;
+};
+
 
 /*
  * VNI hash table
@@ -90,6 +107,9 @@ struct zebra_vni_t_ {
 
 	/* List of local or remote neighbors (MAC+IP) */
 	struct hash *neigh_table;
+
+	/* Remote MACs and neighbors by VTEP */
+	struct hash *vtep_hosts_table;
 };
 
 /* L3 VNI hash table */
@@ -254,6 +274,10 @@ struct zebra_mac_t_ {
 
 	/* list of hosts pointing to this remote RMAC */
 	struct list *host_list;
+
+	/* Remote VTEP the MAC is linked to, if any */
+	zebra_vtep_hosts_t *vtep_hosts;
+	TAILQ_ENTRY(zebra_mac_t_) vtep_entries;
 };
 
 /*
@@ -269,7 +293,6 @@ struct mac_walk_ctx {
 #define DEL_LOCAL_MAC                0x1
 #define DEL_REMOTE_MAC               0x2
 #define DEL_ALL_MAC                  (DEL_LOCAL_MAC | DEL_REMOTE_MAC)
-#define DEL_REMOTE_MAC_FROM_VTEP     0x4
 #define SHOW_REMOTE_MAC_FROM_VTEP    0x8
 
 	struct in_addr r_vtep_ip; /* To walk MACs from specific VTEP */
@@ -328,6 +351,10 @@ struct zebra_neigh_t_ {
 
 	/* list of hosts pointing to this remote NH entry */
 	struct list *host_list;
+
+	/* Remote VTEP the neighbor is linked to, if any */
+	zebra_vtep_hosts_t *vtep_hosts;
+	TAILQ_ENTRY(zebra_neigh_t_) vtep_entries;
 };
 
 /*
@@ -343,7 +370,6 @@ struct neigh_walk_ctx {
 #define DEL_LOCAL_NEIGH              0x1
 #define DEL_REMOTE_NEIGH             0x2
 #define DEL_ALL_NEIGH                (DEL_LOCAL_NEIGH | DEL_REMOTE_NEIGH)
-#define DEL_REMOTE_NEIGH_FROM_VTEP   0x4
 #define SHOW_REMOTE_NEIGH_FROM_VTEP  0x8
 
 	struct in_addr r_vtep_ip; /* To walk neighbors from specific VTEP */
@@ -0,0 +1,585 @@
+/*
+ * Export of zebra's FIB routes over ZeroMQ.
+ *
+ * This file is part of GNU Zebra.
+ *
+ * GNU Zebra is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * GNU Zebra is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; see the file COPYING; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The module is loaded as "-M zebra_zmq[:ENDPOINT[,push][,hwm=N]]".
+ *
+ * Every change to the route zebra selects for the FIB of a prefix is
+ * published in the FPM protobuf encoding (fpm/fpm.proto): ROUTES
+ * messages carrying a batch of ADD_ROUTE/DELETE_ROUTE updates, and SYNC
+ * messages. By default the socket is a PUB socket, and each message is
+ * sent as two frames, the topic "fib" and the encoded message. With
+ * "push" it is a PUSH socket instead, and only the encoded message is
+ * sent.
+ *
+ * Updates are not sent one by one, but the prefixes that changed are
+ * queued (once, no matter how often they change) and sent in batches
+ * as the socket can take them, with the route selected at the moment
+ * the batch is built. When the socket's high-water mark is reached,
+ * prefixes simply stay queued until the subscribers catch up, so a slow
+ * subscriber costs memory bounded by the size of the RIB, and gets the
+ * latest state of each prefix rather than every intermediate one.
+ *
+ * When a subscriber subscribes to a PUB socket, a SYNC message with a
+ * new epoch and the "full" flag is published, followed by all routes;
+ * subscribers that were already there see the same routes again. A
+ * PUSH socket only sends this snapshot once, when zebra starts.
+ */
+
+#include <zebra.h>
+
+#include "log.h"
+#include "libfrr.h"
+#include "thread.h"
+#include "command.h"
+#include "version.h"
+#include "frr_zmq.h"
+
+#include "zebra/rib.h"
+#include "zebra/zserv.h"
+#include "zebra/zebra_vrf.h"
+#include "fpm/fpm.h"
+#include "zebra_fpm_private.h"
+
+#define ZZMQ_DEFAULT_ENDPOINT "tcp://127.0.0.1:2621"
+#define ZZMQ_DEFAULT_HWM 1000
+
+#define ZZMQ_TOPIC "fib"
+
+/*
+ * Size of the buffer that batches are built in; a batch is closed when
+ * what is left may not be enough for another route.
+ */
+#define ZZMQ_BUF_SIZE (64 * 1024)
+
+/*
+ * Number of messages sent before giving other tasks a chance to run.
+ */
+#define ZZMQ_SEND_BURST 16
+
+/*
+ * How long to wait before trying again when the socket is full.
+ */
+#define ZZMQ_BLOCKED_RETRY_MSECS 10
+
+struct zzmq_stats {
+	unsigned long updates_triggered;
+	unsigned long redundant_triggers;
+	unsigned long updates_dropped;
+	unsigned long routes_sent;
+	unsigned long messages_sent;
+	unsigned long bytes_sent;
+	unsigned long send_blocked;
+	unsigned long send_errors;
+	unsigned long subscriptions;
+	unsigned long snapshots;
+};
+
+static struct zzmq_glob {
+	struct thread_master *master;
+
+	void *zmqsock;
+	struct frrzmq_cb *cb;
+	bool push;
+	int hwm;
+	char *endpoint;
+
+	/*
+	 * Set once there is someone to send to. Until then updates aren't
+	 * queued, as the snapshot will pick them up.
+	 */
+	bool active;
+
+	/* Dests on which the route to be exported may have changed. */
+	TAILQ_HEAD(zzmq_dest_q, rib_dest_t_) dest_q;
+
+	/*
+	 * The message being sent; it stays here while the socket is full.
+	 */
+	uint8_t buf[ZZMQ_BUF_SIZE];
+	size_t pending;
+
+	/* A SYNC message with the epoch is to be sent first. */
+	bool sync_pending;
+	uint32_t epoch;
+
+	unsigned int burst;
+
+	struct thread *t_snapshot;
+	struct thread *t_write;
+
+	struct zzmq_stats stats;
+} zzmq_glob_space;
+static struct zzmq_glob *zzmq_g = &zzmq_glob_space;
+
+static void zzmq_write_cb(void *arg, void *zmqsock);
+
+/*
+ * zzmq_write_on
+ *
+ * Make sure that whatever is queued gets sent.
+ */
+static void zzmq_write_on(void)
+{
+	if (!zzmq_g->zmqsock || zzmq_g->t_write)
+		return;
+	if (zzmq_g->cb && !zzmq_g->cb->write.cancelled)
+		return;
+
+	zzmq_g->burst = 0;
+	if (frrzmq_thread_add_write_msg(zzmq_g->master, zzmq_write_cb, NULL,
+					NULL, zzmq_g->zmqsock, &zzmq_g->cb))
+		zlog_err("%s: can't schedule ZeroMQ write", __func__);
+}
+
+/*
+ * zzmq_write_resume
+ *
+ * Timer/event that starts writing again after it was paused.
+ */
+static int zzmq_write_resume(struct thread *t)
+{
+	zzmq_g->t_write = NULL;
+	zzmq_write_on();
+	return 0;
+}
+
+/*
+ * zzmq_write_pause
+ *
+ * Stop writing from within the write callback, and start again after
+ * the given number of milliseconds, or as soon as other tasks have run.
+ */
+static void zzmq_write_pause(long msecs)
+{
+	frrzmq_thread_cancel(&zzmq_g->cb, &zzmq_g->cb->write);
+	if (msecs)
+		thread_add_timer_msec(zzmq_g->master, zzmq_write_resume, NULL,
+				      msecs, &zzmq_g->t_write);
+	else
+		thread_add_event(zzmq_g->master, zzmq_write_resume, NULL, 0,
+				 &zzmq_g->t_write);
+}
+
+/*
+ * zzmq_dequeue
+ */
+static void zzmq_dequeue(rib_dest_t *dest)
+{
+	UNSET_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ);
+	TAILQ_REMOVE(&zzmq_g->dest_q, dest, zmq_q_entries);
+	rib_gc_dest(dest->rnode);
+}
+
+/*
+ * zzmq_build
+ *
+ * Build the next message to send in the buffer.
+ */
+static void zzmq_build(void)
+{
+	rib_dest_t *dest;
+	size_t len, to_write;
+	int n;
+
+	if (zzmq_g->sync_pending) {
+		zzmq_g->sync_pending = false;
+		zzmq_g->pending = zfpm_protobuf_encode_sync(
+			zzmq_g->epoch, 1, zzmq_g->buf, sizeof(zzmq_g->buf));
+		return;
+	}
+
+	if (TAILQ_EMPTY(&zzmq_g->dest_q))
+		return;
+
+	len = zfpm_protobuf_encode_batch(zzmq_g->buf, sizeof(zzmq_g->buf));
+	while ((dest = TAILQ_FIRST(&zzmq_g->dest_q))) {
+		to_write = sizeof(zzmq_g->buf) - len;
+		if (to_write < FPM_MAX_MSG_LEN)
+			break;
+
+		n = zfpm_protobuf_encode_batch_route(dest, dest->selected_fib,
+						     zzmq_g->buf + len,
+						     to_write);
+		if (n > 0) {
+			len += n;
+			zzmq_g->stats.routes_sent++;
+		}
+		zzmq_dequeue(dest);
+	}
+	zzmq_g->pending = len;
+}
+
+/*
+ * zzmq_send
+ *
+ * Try to send the message in the buffer, without blocking.
+ *
+ * Returns 0 if it was sent, else errno.
+ */
+static int zzmq_send(void *zmqsock)
+{
+	if (!zzmq_g->push
+	    && zmq_send(zmqsock, ZZMQ_TOPIC, strlen(ZZMQ_TOPIC),
+			ZMQ_SNDMORE | ZMQ_DONTWAIT)
+		       < 0)
+		return errno;
+
+	/*
+	 * Once the first frame of a message has been queued, the others
+	 * are always taken.
+	 */
+	if (zmq_send(zmqsock, zzmq_g->buf, zzmq_g->pending, ZMQ_DONTWAIT) < 0)
+		return errno;
+
+	zzmq_g->stats.messages_sent++;
+	zzmq_g->stats.bytes_sent += zzmq_g->pending;
+	zzmq_g->pending = 0;
+	return 0;
+}
+
+/*
+ * zzmq_write_cb
+ *
+ * Called by frr_zmq for as long as the socket can take messages; sends
+ * one message per call.
+ */
+static void zzmq_write_cb(void *arg, void *zmqsock)
+{
+	int err;
+
+	if (!zzmq_g->pending)
+		zzmq_build();
+
+	if (!zzmq_g->pending) {
+		frrzmq_thread_cancel(&zzmq_g->cb, &zzmq_g->cb->write);
+		return;
+	}
+
+	err = zzmq_send(zmqsock);
+	if (err == EAGAIN) {
+		zzmq_g->stats.send_blocked++;
+		zzmq_write_pause(ZZMQ_BLOCKED_RETRY_MSECS);
+		return;
+	}
+	if (err) {
+		zlog_err("%s: ZeroMQ send failed: %s", __func__,
+			 safe_strerror(err));
+		zzmq_g->stats.send_errors++;
+		zzmq_g->pending = 0;
+	}
+
+	if (++zzmq_g->burst >= ZZMQ_SEND_BURST)
+		zzmq_write_pause(0);
+}
+
+/*
+ * zzmq_trigger_update
+ *
+ * The zebra code invokes this function to indicate that the route
+ * selected for the given route_node may have changed.
+ */
+static int zzmq_trigger_update(struct route_node *rn, const char *reason)
+{
+	rib_dest_t *dest;
+
+	if (!zzmq_g->active) {
+		zzmq_g->stats.updates_dropped++;
+		return 0;
+	}
+
+	dest = rib_dest_from_rnode(rn);
+	if (CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ)) {
+		zzmq_g->stats.redundant_triggers++;
+		return 0;
+	}
+
+	SET_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ);
+	TAILQ_INSERT_TAIL(&zzmq_g->dest_q, dest, zmq_q_entries);
+	zzmq_g->stats.updates_triggered++;
+
+	zzmq_write_on();
+	return 0;
+}
+
+/*
+ * zzmq_snapshot
+ *
+ * Queue a new epoch's SYNC message followed by all routes.
+ */
+static int zzmq_snapshot(struct thread *t)
+{
+	rib_tables_iter_t iter;
+	struct route_table *table;
+	struct route_node *rn;
+	rib_dest_t *dest;
+
+	zzmq_g->t_snapshot = NULL;
+	zzmq_g->active = true;
+	zzmq_g->epoch++;
+	zzmq_g->sync_pending = true;
+	zzmq_g->stats.snapshots++;
+
+	/*
+	 * Whatever is queued will be sent after the SYNC message anyway;
+	 * queue the rest behind it.
+	 */
+	rib_tables_iter_init(&iter);
+	while ((table = rib_tables_iter_next(&iter))) {
+		for (rn = route_top(table); rn; rn = route_next(rn)) {
+			dest = rib_dest_from_rnode(rn);
+			if (!dest || !dest->selected_fib
+			    || CHECK_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ))
+				continue;
+
+			SET_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ);
+			TAILQ_INSERT_TAIL(&zzmq_g->dest_q, dest,
+					  zmq_q_entries);
+		}
+	}
+	rib_tables_iter_cleanup(&iter);
+
+	zzmq_write_on();
+	return 0;
+}
+
+/*
+ * zzmq_read_cb
+ *
+ * Subscription messages on an XPUB socket: the first byte is 1 for a
+ * subscription and 0 for an unsubscription, followed by the topic.
+ */
+static void zzmq_read_cb(void *arg, void *zmqsock)
+{
+	uint8_t msg[64];
+	int n;
+
+	n = zmq_recv(zmqsock, msg, sizeof(msg), ZMQ_DONTWAIT);
+	if (n < 1 || msg[0] != 1)
+		return;
+
+	zzmq_g->stats.subscriptions++;
+
+	/* Several subscribers arriving at once share a snapshot. */
+	thread_add_event(zzmq_g->master, zzmq_snapshot, NULL, 0,
+			 &zzmq_g->t_snapshot);
+}
+
+/*
+ * zzmq_parse_args
+ *
+ * Parse the module's load arguments, "ENDPOINT[,push][,hwm=N]".
+ */
+static int zzmq_parse_args(const char *args)
+{
+	char *copy, *tok, *save;
+	int ret = 0;
+
+	zzmq_g->hwm = ZZMQ_DEFAULT_HWM;
+	if (!args || !*args) {
+		zzmq_g->endpoint = XSTRDUP(MTYPE_TMP, ZZMQ_DEFAULT_ENDPOINT);
+		return 0;
+	}
+
+	copy = XSTRDUP(MTYPE_TMP, args);
+	for (tok = strtok_r(copy, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		if (!strcmp(tok, "push"))
+			zzmq_g->push = true;
+		else if (!strncmp(tok, "hwm=", 4))
+			zzmq_g->hwm = atoi(tok + 4);
+		else if (!zzmq_g->endpoint)
+			zzmq_g->endpoint = XSTRDUP(MTYPE_TMP, tok);
+		else {
+			zlog_err("zebra_zmq: unknown argument '%s'", tok);
+			ret = -1;
+		}
+	}
+	XFREE(MTYPE_TMP, copy);
+
+	if (!zzmq_g->endpoint)
+		zzmq_g->endpoint = XSTRDUP(MTYPE_TMP, ZZMQ_DEFAULT_ENDPOINT);
+	return ret;
+}
+
+/*
+ * zzmq_show_stats
+ */
+static void zzmq_show_stats(struct vty *vty)
+{
+	struct zzmq_stats *s = &zzmq_g->stats;
+	rib_dest_t *dest;
+	unsigned long queued = 0;
+
+	TAILQ_FOREACH (dest, &zzmq_g->dest_q, zmq_q_entries)
+		queued++;
+
+	vty_out(vty, "%s socket %s, high-water mark %d, %s\n",
+		zzmq_g->push ? "PUSH" : "PUB", zzmq_g->endpoint, zzmq_g->hwm,
+		zzmq_g->zmqsock ? (zzmq_g->active ? "active" : "waiting")
+				: "not open");
+	vty_out(vty, "Epoch %u, %lu prefixes queued, %zu bytes pending\n\n",
+		zzmq_g->epoch, queued, zzmq_g->pending);
+
+#define ZZMQ_SHOW_STAT(counter)                                                \
+	vty_out(vty, "%-40s %10lu\n", #counter, s->counter)
+
+	ZZMQ_SHOW_STAT(updates_triggered);
+	ZZMQ_SHOW_STAT(redundant_triggers);
+	ZZMQ_SHOW_STAT(updates_dropped);
+	ZZMQ_SHOW_STAT(routes_sent);
+	ZZMQ_SHOW_STAT(messages_sent);
+	ZZMQ_SHOW_STAT(bytes_sent);
+	ZZMQ_SHOW_STAT(send_blocked);
+	ZZMQ_SHOW_STAT(send_errors);
+	ZZMQ_SHOW_STAT(subscriptions);
+	ZZMQ_SHOW_STAT(snapshots);
+#undef ZZMQ_SHOW_STAT
+}
+
+DEFUN (show_zebra_zmq,
+       show_zebra_zmq_cmd,
+       "show zebra zmq",
+       SHOW_STR
+       ZEBRA_STR
+       "ZeroMQ route export information\n")
+{
+	zzmq_show_stats(vty);
+	return CMD_SUCCESS;
+}
+
+/*
+ * zzmq_open
+ *
+ * Create and bind the socket. Returns 0 on success.
+ */
+static int zzmq_open(void)
+{
+	int on = 1;
+
+	zzmq_g->zmqsock = zmq_socket(frrzmq_context,
+				     zzmq_g->push ? ZMQ_PUSH : ZMQ_XPUB);
+	if (!zzmq_g->zmqsock) {
+		zlog_err("zebra_zmq: can't create socket: %s",
+			 safe_strerror(errno));
+		return -1;
+	}
+
+	zmq_setsockopt(zzmq_g->zmqsock, ZMQ_SNDHWM, &zzmq_g->hwm,
+		       sizeof(zzmq_g->hwm));
+	if (!zzmq_g->push) {
+		/*
+		 * See every subscription, not just the first one for the
+		 * topic, so that each subscriber gets a snapshot; and let
+		 * sends fail at the high-water mark rather than dropping.
+		 */
+		zmq_setsockopt(zzmq_g->zmqsock, ZMQ_XPUB_VERBOSE, &on,
+			       sizeof(on));
+		zmq_setsockopt(zzmq_g->zmqsock, ZMQ_XPUB_NODROP, &on,
+			       sizeof(on));
+	}
+
+	if (zmq_bind(zzmq_g->zmqsock, zzmq_g->endpoint)) {
+		zlog_err("zebra_zmq: can't bind to %s: %s", zzmq_g->endpoint,
+			 safe_strerror(errno));
+		zmq_close(zzmq_g->zmqsock);
+		zzmq_g->zmqsock = NULL;
+		return -1;
+	}
+
+	if (!zzmq_g->push
+	    && frrzmq_thread_add_read_msg(zzmq_g->master, zzmq_read_cb, NULL,
+					  NULL, zzmq_g->zmqsock, &zzmq_g->cb)) {
+		zlog_err("zebra_zmq: can't schedule ZeroMQ read");
+		zmq_close(zzmq_g->zmqsock);
+		zzmq_g->zmqsock = NULL;
+		return -1;
+	}
+
+	zlog_info("zebra_zmq: exporting routes on %s socket %s",
+		  zzmq_g->push ? "PUSH" : "PUB", zzmq_g->endpoint);
+	return 0;
+}
+
+/*
+ * zzmq_finish
+ */
+static int zzmq_finish(void)
+{
+	rib_dest_t *dest;
+
+	THREAD_OFF(zzmq_g->t_snapshot);
+	THREAD_OFF(zzmq_g->t_write);
+
+	while ((dest = TAILQ_FIRST(&zzmq_g->dest_q))) {
+		UNSET_FLAG(dest->flags, RIB_DEST_UPDATE_ZMQ);
+		TAILQ_REMOVE(&zzmq_g->dest_q, dest, zmq_q_entries);
+	}
+	zzmq_g->active = false;
+
+	if (zzmq_g->cb) {
+		frrzmq_thread_cancel(&zzmq_g->cb, &zzmq_g->cb->read);
+		frrzmq_thread_cancel(&zzmq_g->cb, &zzmq_g->cb->write);
+	}
+	if (zzmq_g->zmqsock) {
+		zmq_close(zzmq_g->zmqsock);
+		zzmq_g->zmqsock = NULL;
+	}
+	frrzmq_finish();
+
+	XFREE(MTYPE_TMP, zzmq_g->endpoint);
+	return 0;
+}
+
+static int zzmq_init(struct thread_master *master)
+{
+	memset(zzmq_g, 0, sizeof(*zzmq_g));
+	zzmq_g->master = master;
+	TAILQ_INIT(&zzmq_g->dest_q);
+	zzmq_g->epoch = time(NULL);
+
+	install_element(ENABLE_NODE, &show_zebra_zmq_cmd);
+
+	if (zzmq_parse_args(THIS_MODULE->load_args))
+		return 0;
+
+	frrzmq_init();
+	hook_register(frr_early_fini, zzmq_finish);
+
+	if (zzmq_open())
+		return 0;
+
+	/* There's no telling who is listening on a PUSH socket. */
+	if (zzmq_g->push)
+		thread_add_event(master, zzmq_snapshot, NULL, 0,
+				 &zzmq_g->t_snapshot);
+	return 0;
+}
+
+static int zebra_zmq_module_init(void)
+{
+	hook_register(rib_update, zzmq_trigger_update);
+	hook_register(frr_late_init, zzmq_init);
+	return 0;
+}
+
+FRR_MODULE_SETUP(.name = "zebra_zmq", .version = FRR_VERSION,
+		 .description = "zebra ZeroMQ route export module",
+		 .init = zebra_zmq_module_init, )
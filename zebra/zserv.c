@@ -43,6 +43,9 @@
 #include "vrf.h"
 #include "libfrr.h"
 #include "sockopt.h"
+#include "frr_pthread.h"
+#include "hash.h"
+#include "jhash.h"
 
 #include "zebra/zserv.h"
 #include "zebra/zebra_ns.h"
@@ -65,21 +68,179 @@
 
 /* Event list of zebra. */
 enum event { ZEBRA_READ, ZEBRA_WRITE };
+/* Stop reading from a client while this many messages await processing */
+#define ZSERV_IBUF_FIFO_MAX 1024
 /* privileges */
 extern struct zebra_privs_t zserv_privs;
+
+DEFINE_MTYPE_STATIC(ZEBRA, ZSERV_QUEUED, "Coalescable queued message")
+
+/* Message on a client's obuf_fifo, see zebra_server_send_coalesced() */
+struct zserv_queued {
+	struct zserv_msg_key key;
+
+	/* still queued while seq isn't behind the client's obuf_popped */
+	struct stream *msg;
+	uint64_t seq;
+};
+
 /* post event into client */
 static void zebra_event(struct zserv *client, enum event event);
+static int zserv_process_messages(struct thread *thread);
 
 
 /* Public interface ======================================================== */
 
-int zebra_server_send_message(struct zserv *client, struct stream *msg)
+/*
+ * Queues msg on the client's obuf_fifo, noting when that runs over the
+ * high watermark.  Returns whether it just did.
+ *
+ * Requires: client->obuf_mtx
+ */
+static bool zserv_obuf_push(struct zserv *client, struct stream *msg)
 {
 	stream_fifo_push(client->obuf_fifo, msg);
+	client->obuf_pushed++;
+
+	if (client->obuf_fifo->count > client->obuf_max)
+		client->obuf_max = client->obuf_fifo->count;
+
+	if (client->obuf_congested || client->is_synchronous
+	    || client->obuf_fifo->count < zebrad.zapi_wm_high)
+		return false;
+
+	client->obuf_congested = true;
+	client->obuf_congested_cnt++;
+	return true;
+}
+
+static void zserv_obuf_congested(struct zserv *client)
+{
+	zlog_warn("client %s fd %d: %u messages waiting to be sent, not processing its requests until down to %u",
+		  zebra_route_string(client->proto), client->sock,
+		  zebrad.zapi_wm_high, zebrad.zapi_wm_low);
+}
+
+int zebra_server_send_message(struct zserv *client, struct stream *msg)
+{
+	bool congested;
+
+	pthread_mutex_lock(&client->obuf_mtx);
+	{
+		congested = zserv_obuf_push(client, msg);
+	}
+	pthread_mutex_unlock(&client->obuf_mtx);
+
+	if (congested)
+		zserv_obuf_congested(client);
+
 	zebra_event(client, ZEBRA_WRITE);
 	return 0;
 }
 
+static unsigned int zserv_queued_hash_key(void *arg)
+{
+	return jhash(arg, sizeof(struct zserv_msg_key), 0);
+}
+
+static int zserv_queued_hash_cmp(const void *a, const void *b)
+{
+	return !memcmp(a, b, sizeof(struct zserv_msg_key));
+}
+
+static void *zserv_queued_alloc(void *arg)
+{
+	struct zserv_queued *qm;
+
+	qm = XMALLOC(MTYPE_ZSERV_QUEUED, sizeof(struct zserv_queued));
+	qm->key = *(struct zserv_msg_key *)arg;
+	qm->msg = NULL;
+	return qm;
+}
+
+static void zserv_queued_free(void *arg)
+{
+	XFREE(MTYPE_ZSERV_QUEUED, arg);
+}
+
+void zserv_msg_key_init(struct zserv_msg_key *key, uint16_t cmd,
+			vrf_id_t vrf_id, const struct prefix *p,
+			const struct prefix *src_p)
+{
+	memset(key, 0, sizeof(*key));
+	key->cmd = cmd;
+	key->vrf_id = vrf_id;
+	prefix_copy(&key->p, p);
+	if (src_p)
+		prefix_copy((struct prefix *)&key->src_p, src_p);
+}
+
+int zebra_server_send_coalesced(struct zserv *client, struct stream *msg,
+				struct zserv_msg_key *key)
+{
+	struct zserv_queued *qm;
+	bool superseded = false, congested = false;
+
+	pthread_mutex_lock(&client->obuf_mtx);
+	{
+		/* with nothing queued, nothing can be superseded */
+		if (client->obuf_popped == client->obuf_pushed)
+			hash_clean(client->obuf_queued, zserv_queued_free);
+
+		qm = hash_get(client->obuf_queued, key, zserv_queued_alloc);
+		if (qm->msg && qm->seq >= client->obuf_popped) {
+			stream_reshare(qm->msg, msg);
+			client->obuf_coalesced_cnt++;
+			superseded = true;
+		} else {
+			qm->msg = stream_share(msg);
+			qm->seq = client->obuf_pushed;
+			congested = zserv_obuf_push(client, qm->msg);
+		}
+	}
+	pthread_mutex_unlock(&client->obuf_mtx);
+
+	if (congested)
+		zserv_obuf_congested(client);
+
+	if (!superseded)
+		zebra_event(client, ZEBRA_WRITE);
+	return 0;
+}
+
+/*
+ * Queues msg, from zserv_encode_redistribute_route(), for the client.  The
+ * encoding is shared, so the same msg can go to any number of clients; the
+ * caller keeps its reference.  If the client hasn't been sent the last
+ * message about the route yet, msg replaces that.
+ */
+int zsend_redistribute(struct zserv *client, struct stream *msg,
+		       struct prefix *p, struct prefix *src_p,
+		       struct route_entry *re)
+{
+	struct zserv_msg_key key;
+
+	/* adds and deletes supersede each other */
+	zserv_msg_key_init(&key, ZEBRA_REDISTRIBUTE_ROUTE_ADD, re->vrf_id, p,
+			   src_p);
+	key.type = re->type;
+	key.instance = re->instance;
+
+	if (IS_ZEBRA_DEBUG_SEND) {
+		char buf_prefix[PREFIX_STRLEN];
+		prefix2str(p, buf_prefix, sizeof(buf_prefix));
+
+		zlog_debug("%s: %s to client %s: type %s, vrf_id %d, p %s",
+			   __func__,
+			   zserv_command_string(stream_getw_from(msg, 6)),
+			   zebra_route_string(client->proto),
+			   zebra_route_string(re->type), re->vrf_id,
+			   buf_prefix);
+	}
+
+	return zebra_server_send_coalesced(client, msg, &key);
+}
+
 /* Encoding helpers -------------------------------------------------------- */
 
 static void zserv_encode_interface(struct stream *s, struct interface *ifp)
@@ -530,8 +691,10 @@ int zsend_interface_update(int cmd, struct zserv *client, struct interface *ifp)
 	return zebra_server_send_message(client, s);
 }
 
-int zsend_redistribute_route(int cmd, struct zserv *client, struct prefix *p,
-			     struct prefix *src_p, struct route_entry *re)
+/* Encodes a redistribution message, for zsend_redistribute() */
+struct stream *zserv_encode_redistribute_route(int cmd, struct prefix *p,
+					       struct prefix *src_p,
+					       struct route_entry *re)
 {
 	struct zapi_route api;
 	struct zapi_nexthop *api_nh;
@@ -601,23 +764,30 @@ int zsend_redistribute_route(int cmd, struct zserv *client, struct prefix *p,
 
 	struct stream *s = stream_new(ZEBRA_MAX_PACKET_SIZ);
 
-	/* Encode route and send. */
+	/* Encode route. */
 	if (zapi_route_encode(cmd, s, &api) < 0) {
 		stream_free(s);
-		return -1;
+		return NULL;
 	}
 
-	if (IS_ZEBRA_DEBUG_SEND) {
-		char buf_prefix[PREFIX_STRLEN];
-		prefix2str(&api.prefix, buf_prefix, sizeof(buf_prefix));
+	/* it may be queued for a while */
+	stream_resize(s, stream_get_endp(s));
+	return s;
+}
 
-		zlog_debug("%s: %s to client %s: type %s, vrf_id %d, p %s",
-			   __func__, zserv_command_string(cmd),
-			   zebra_route_string(client->proto),
-			   zebra_route_string(api.type), api.vrf_id,
-			   buf_prefix);
-	}
-	return zebra_server_send_message(client, s);
+int zsend_redistribute_route(int cmd, struct zserv *client, struct prefix *p,
+			     struct prefix *src_p, struct route_entry *re)
+{
+	struct stream *s;
+	int ret;
+
+	s = zserv_encode_redistribute_route(cmd, p, src_p, re);
+	if (!s)
+		return -1;
+
+	ret = zsend_redistribute(client, s, p, src_p, re);
+	stream_free(s);
+	return ret;
 }
 
 /*
@@ -677,6 +847,10 @@ int zsend_route_notify_owner(struct route_entry *re, struct prefix *p,
 	struct stream *s;
 	uint8_t blen;
 
+	/* Routes read back from the kernel are nobody's to tell about. */
+	if (CHECK_FLAG(re->flags, ZEBRA_FLAG_SELFROUTE))
+		return 0;
+
 	client = zebra_find_client(re->type, re->instance);
 	if (!client || !client->notify_owner) {
 		if (IS_ZEBRA_DEBUG_PACKET) {
@@ -718,12 +892,47 @@ int zsend_route_notify_owner(struct route_entry *re, struct prefix *p,
 	return zebra_server_send_message(client, s);
 }
 
+/*
+ * Rule notifications come in bursts, as the kernel answers a batch of rule
+ * updates at once.  They are collected, several to a stream, and queued for
+ * the client once the burst is over or the stream is full.
+ */
+#define ZSERV_RULE_NOTIFY_SIZE                                                 \
+	(ZEBRA_HEADER_SIZE + sizeof(enum zapi_rule_notify_owner) + 16)
+
+static struct thread *t_rule_notify;
+
+static void zsend_rule_notify_flush_client(struct zserv *client)
+{
+	struct stream *s = client->rule_notify;
+
+	if (!s)
+		return;
+
+	client->rule_notify = NULL;
+	zebra_server_send_message(client, s);
+}
+
+static int zsend_rule_notify_flush(struct thread *thread)
+{
+	struct listnode *node;
+	struct zserv *client;
+
+	t_rule_notify = NULL;
+
+	for (ALL_LIST_ELEMENTS_RO(zebrad.client_list, node, client))
+		zsend_rule_notify_flush_client(client);
+
+	return 0;
+}
+
 void zsend_rule_notify_owner(struct zebra_pbr_rule *rule,
 			     enum zapi_rule_notify_owner note)
 {
 	struct listnode *node;
 	struct zserv *client;
 	struct stream *s;
+	size_t start;
 
 	if (IS_ZEBRA_DEBUG_PACKET) {
 		zlog_debug("%s: Notifying %u", __PRETTY_FUNCTION__,
@@ -738,8 +947,15 @@ void zsend_rule_notify_owner(struct zebra_pbr_rule *rule,
 	if (!client)
 		return;
 
-	s = stream_new(ZEBRA_MAX_PACKET_SIZ);
-	stream_reset(s);
+	if (client->rule_notify
+	    && STREAM_WRITEABLE(client->rule_notify) < ZSERV_RULE_NOTIFY_SIZE)
+		zsend_rule_notify_flush_client(client);
+
+	if (!client->rule_notify)
+		client->rule_notify = stream_new(ZEBRA_MAX_PACKET_SIZ);
+
+	s = client->rule_notify;
+	start = stream_get_endp(s);
 
 	zclient_create_header(s, ZEBRA_RULE_NOTIFY_OWNER, VRF_DEFAULT);
 	stream_put(s, &note, sizeof(note));
@@ -751,9 +967,10 @@ void zsend_rule_notify_owner(struct zebra_pbr_rule *rule,
 	else
 		stream_putl(s, 0);
 
-	stream_putw_at(s, 0, stream_get_endp(s));
+	stream_putw_at(s, start, stream_get_endp(s) - start);
 
-	zebra_server_send_message(client, s);
+	thread_add_event(zebrad.master, zsend_rule_notify_flush, NULL, 0,
+			 &t_rule_notify);
 }
 
 /* Router-id is updated. Send ZEBRA_ROUTER_ID_ADD to client. */
@@ -1023,6 +1240,9 @@ static void zread_fec_register(ZAPI_HANDLER_ARGS)
 		return;
 	}
 
+	/* bgpd sends its FECs in bulk, the labels go back the same way */
+	zebra_mpls_fec_batch(client);
+
 	while (l < hdr->length) {
 		STREAM_GETW(s, flags);
 		memset(&p, 0, sizeof(p));
@@ -1031,7 +1251,7 @@ static void zread_fec_register(ZAPI_HANDLER_ARGS)
 			zlog_err(
 				"fec_register: Received unknown family type %d\n",
 				p.family);
-			return;
+			goto stream_failure;
 		}
 		STREAM_GETC(s, p.prefixlen);
 		if ((p.family == AF_INET && p.prefixlen > IPV4_MAX_BITLEN)
@@ -1040,7 +1260,7 @@ static void zread_fec_register(ZAPI_HANDLER_ARGS)
 			zlog_warn(
 				"%s: Specified prefix hdr->length: %d is to long for %d",
 				__PRETTY_FUNCTION__, p.prefixlen, p.family);
-			return;
+			goto stream_failure;
 		}
 		l += 5;
 		STREAM_GET(&p.u.prefix, s, PSIZE(p.prefixlen));
@@ -1054,6 +1274,7 @@ static void zread_fec_register(ZAPI_HANDLER_ARGS)
 	}
 
 stream_failure:
+	zebra_mpls_fec_batch(NULL);
 	return;
 }
 
@@ -1156,10 +1377,9 @@ void zserv_nexthop_num_warn(const char *caller, const struct prefix *p,
 	}
 }
 
-static void zread_route_add(ZAPI_HANDLER_ARGS)
+static void zserv_route_add(struct zserv *client, struct zebra_vrf *zvrf,
+			    struct zapi_route *api)
 {
-	struct stream *s;
-	struct zapi_route api;
 	struct zapi_nexthop *api_nh;
 	afi_t afi;
 	struct prefix_ipv6 *src_p = NULL;
@@ -1167,36 +1387,29 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	struct nexthop *nexthop = NULL;
 	int i, ret;
 	vrf_id_t vrf_id = 0;
+	uint32_t table_id;
 	struct ipaddr vtep_ip;
 
-	s = msg;
-	if (zapi_route_decode(s, &api) < 0) {
-		if (IS_ZEBRA_DEBUG_RECV)
-			zlog_debug("%s: Unable to decode zapi_route sent",
-				   __PRETTY_FUNCTION__);
-		return;
-	}
-
 	if (IS_ZEBRA_DEBUG_RECV) {
 		char buf_prefix[PREFIX_STRLEN];
-		prefix2str(&api.prefix, buf_prefix, sizeof(buf_prefix));
+		prefix2str(&api->prefix, buf_prefix, sizeof(buf_prefix));
 		zlog_debug("%s: p=%s, ZAPI_MESSAGE_LABEL: %sset, flags=0x%x",
 			   __func__, buf_prefix,
-			   (CHECK_FLAG(api.message, ZAPI_MESSAGE_LABEL) ? ""
+			   (CHECK_FLAG(api->message, ZAPI_MESSAGE_LABEL) ? ""
 									: "un"),
-			   api.flags);
+			   api->flags);
 	}
 
 	/* Allocate new route. */
 	vrf_id = zvrf_id(zvrf);
 	re = XCALLOC(MTYPE_RE, sizeof(struct route_entry));
-	re->type = api.type;
-	re->instance = api.instance;
-	re->flags = api.flags;
+	re->type = api->type;
+	re->instance = api->instance;
+	re->flags = api->flags & ~ZEBRA_FLAG_TIMESTAMPS;
 	re->uptime = time(NULL);
 	re->vrf_id = vrf_id;
-	if (api.tableid && vrf_id == VRF_DEFAULT)
-		re->table = api.tableid;
+	if (api->tableid && vrf_id == VRF_DEFAULT)
+		re->table = api->tableid;
 	else
 		re->table = zvrf->table_id;
 
@@ -1205,9 +1418,9 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	 * api_nh->vrf_id instead of re->vrf_id ? I only changed
 	 * for cases NEXTHOP_TYPE_IPV4 and NEXTHOP_TYPE_IPV6.
 	 */
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_NEXTHOP)) {
-		for (i = 0; i < api.nexthop_num; i++) {
-			api_nh = &api.nexthops[i];
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_NEXTHOP)) {
+		for (i = 0; i < api->nexthop_num; i++) {
+			api_nh = &api->nexthops[i];
 			ifindex_t ifindex = 0;
 
 			if (IS_ZEBRA_DEBUG_RECV) {
@@ -1235,7 +1448,7 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 			case NEXTHOP_TYPE_IPV4_IFINDEX:
 
 				memset(&vtep_ip, 0, sizeof(struct ipaddr));
-				if (CHECK_FLAG(api.flags,
+				if (CHECK_FLAG(api->flags,
 					       ZEBRA_FLAG_EVPN_ROUTE)) {
 					ifindex = get_l3vni_svi_ifindex(vrf_id);
 				} else {
@@ -1258,7 +1471,7 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 				/* if this an EVPN route entry,
 				 * program the nh as neigh
 				 */
-				if (CHECK_FLAG(api.flags,
+				if (CHECK_FLAG(api->flags,
 					       ZEBRA_FLAG_EVPN_ROUTE)) {
 					SET_FLAG(nexthop->flags,
 						 NEXTHOP_FLAG_EVPN_RVTEP);
@@ -1267,8 +1480,8 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 					       &(api_nh->gate.ipv4),
 					       sizeof(struct in_addr));
 					zebra_vxlan_evpn_vrf_route_add(
-						vrf_id, &api.rmac, &vtep_ip,
-						&api.prefix);
+						vrf_id, &api->rmac, &vtep_ip,
+						&api->prefix);
 				}
 				break;
 			case NEXTHOP_TYPE_IPV6:
@@ -1277,7 +1490,7 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 				break;
 			case NEXTHOP_TYPE_IPV6_IFINDEX:
 				memset(&vtep_ip, 0, sizeof(struct ipaddr));
-				if (CHECK_FLAG(api.flags,
+				if (CHECK_FLAG(api->flags,
 					       ZEBRA_FLAG_EVPN_ROUTE)) {
 					ifindex =
 						get_l3vni_svi_ifindex(vrf_id);
@@ -1292,7 +1505,7 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 				/* if this an EVPN route entry,
 				 * program the nh as neigh
 				 */
-				if (CHECK_FLAG(api.flags,
+				if (CHECK_FLAG(api->flags,
 					       ZEBRA_FLAG_EVPN_ROUTE)) {
 					SET_FLAG(nexthop->flags,
 						 NEXTHOP_FLAG_EVPN_RVTEP);
@@ -1302,9 +1515,9 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 					       sizeof(struct in6_addr));
 					zebra_vxlan_evpn_vrf_route_add(
 								vrf_id,
-								&api.rmac,
+								&api->rmac,
 								&vtep_ip,
-								&api.prefix);
+								&api->prefix);
 				}
 				break;
 			case NEXTHOP_TYPE_BLACKHOLE:
@@ -1316,13 +1529,13 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 			if (!nexthop) {
 				zlog_warn(
 					"%s: Nexthops Specified: %d but we failed to properly create one",
-					__PRETTY_FUNCTION__, api.nexthop_num);
+					__PRETTY_FUNCTION__, api->nexthop_num);
 				nexthops_free(re->ng.nexthop);
 				XFREE(MTYPE_RE, re);
 				return;
 			}
 			/* MPLS labels for BGP-LU or Segment Routing */
-			if (CHECK_FLAG(api.message, ZAPI_MESSAGE_LABEL)
+			if (CHECK_FLAG(api->message, ZAPI_MESSAGE_LABEL)
 			    && api_nh->type != NEXTHOP_TYPE_IFINDEX
 			    && api_nh->type != NEXTHOP_TYPE_BLACKHOLE) {
 				enum lsp_types_t label_type;
@@ -1344,30 +1557,35 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 		}
 	}
 
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_DISTANCE))
-		re->distance = api.distance;
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_METRIC))
-		re->metric = api.metric;
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_TAG))
-		re->tag = api.tag;
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_MTU))
-		re->mtu = api.mtu;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_DISTANCE))
+		re->distance = api->distance;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_METRIC))
+		re->metric = api->metric;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_TAG))
+		re->tag = api->tag;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_MTU))
+		re->mtu = api->mtu;
 
-	afi = family2afi(api.prefix.family);
-	if (afi != AFI_IP6 && CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX)) {
+	afi = family2afi(api->prefix.family);
+	if (afi != AFI_IP6 && CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
 		zlog_warn("%s: Received SRC Prefix but afi is not v6",
 			  __PRETTY_FUNCTION__);
 		nexthops_free(re->ng.nexthop);
 		XFREE(MTYPE_RE, re);
 		return;
 	}
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX))
-		src_p = &api.src_prefix;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX))
+		src_p = &api->src_prefix;
 
-	ret = rib_add_multipath(afi, api.safi, &api.prefix, src_p, re);
+	table_id = re->table;
+	ret = rib_add_multipath(afi, api->safi, &api->prefix, src_p, re);
+	if (CHECK_FLAG(api->flags, ZEBRA_FLAG_TIMESTAMPS))
+		rib_pipeline_received(afi, api->safi, vrf_id, table_id,
+				      &api->prefix, src_p, api->rx_usec,
+				      api->tx_usec);
 
 	/* Stats */
-	switch (api.prefix.family) {
+	switch (api->prefix.family) {
 	case AF_INET:
 		if (ret > 0)
 			client->v4_route_add_cnt++;
@@ -1383,38 +1601,71 @@ static void zread_route_add(ZAPI_HANDLER_ARGS)
 	}
 }
 
-static void zread_route_del(ZAPI_HANDLER_ARGS)
+static void zread_route_add(ZAPI_HANDLER_ARGS)
 {
-	struct stream *s;
 	struct zapi_route api;
+
+	if (zapi_route_decode(msg, &api) < 0) {
+		if (IS_ZEBRA_DEBUG_RECV)
+			zlog_debug("%s: Unable to decode zapi_route sent",
+				   __PRETTY_FUNCTION__);
+		return;
+	}
+
+	zserv_route_add(client, zvrf, &api);
+}
+
+static void zread_route_add_bulk(ZAPI_HANDLER_ARGS)
+{
+	struct zapi_route api;
+	uint16_t count;
+
+	if (zapi_route_bulk_decode(msg, &api, &count) < 0) {
+		if (IS_ZEBRA_DEBUG_RECV)
+			zlog_debug("%s: Unable to decode zapi_route sent",
+				   __PRETTY_FUNCTION__);
+		return;
+	}
+
+	while (count--) {
+		if (zapi_route_bulk_decode_prefix(msg, &api) < 0) {
+			if (IS_ZEBRA_DEBUG_RECV)
+				zlog_debug("%s: Unable to decode prefix sent",
+					   __PRETTY_FUNCTION__);
+			return;
+		}
+
+		zserv_route_add(client, zvrf, &api);
+	}
+}
+
+static void zserv_route_del(struct zserv *client, struct zebra_vrf *zvrf,
+			    struct zapi_route *api)
+{
 	afi_t afi;
 	struct prefix_ipv6 *src_p = NULL;
 	uint32_t table_id;
 
-	s = msg;
-	if (zapi_route_decode(s, &api) < 0)
-		return;
-
-	afi = family2afi(api.prefix.family);
-	if (afi != AFI_IP6 && CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX)) {
+	afi = family2afi(api->prefix.family);
+	if (afi != AFI_IP6 && CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX)) {
 		zlog_warn("%s: Received a src prefix while afi is not v6",
 			  __PRETTY_FUNCTION__);
 		return;
 	}
-	if (CHECK_FLAG(api.message, ZAPI_MESSAGE_SRCPFX))
-		src_p = &api.src_prefix;
+	if (CHECK_FLAG(api->message, ZAPI_MESSAGE_SRCPFX))
+		src_p = &api->src_prefix;
 
-	if (api.vrf_id == VRF_DEFAULT && api.tableid != 0)
-		table_id = api.tableid;
+	if (api->vrf_id == VRF_DEFAULT && api->tableid != 0)
+		table_id = api->tableid;
 	else
 		table_id = zvrf->table_id;
 
-	rib_delete(afi, api.safi, zvrf_id(zvrf), api.type, api.instance,
-		   api.flags, &api.prefix, src_p, NULL, table_id,
-		   api.metric, false, &api.rmac);
+	rib_delete(afi, api->safi, zvrf_id(zvrf), api->type, api->instance,
+		   api->flags, &api->prefix, src_p, NULL, table_id,
+		   api->metric, false, &api->rmac);
 
 	/* Stats */
-	switch (api.prefix.family) {
+	switch (api->prefix.family) {
 	case AF_INET:
 		client->v4_route_del_cnt++;
 		break;
@@ -1424,6 +1675,32 @@ static void zread_route_del(ZAPI_HANDLER_ARGS)
 	}
 }
 
+static void zread_route_del(ZAPI_HANDLER_ARGS)
+{
+	struct zapi_route api;
+
+	if (zapi_route_decode(msg, &api) < 0)
+		return;
+
+	zserv_route_del(client, zvrf, &api);
+}
+
+static void zread_route_del_bulk(ZAPI_HANDLER_ARGS)
+{
+	struct zapi_route api;
+	uint16_t count;
+
+	if (zapi_route_bulk_decode(msg, &api, &count) < 0)
+		return;
+
+	while (count--) {
+		if (zapi_route_bulk_decode_prefix(msg, &api) < 0)
+			return;
+
+		zserv_route_del(client, zvrf, &api);
+	}
+}
+
 /* This function support multiple nexthop. */
 /*
  * Parse the ZEBRA_IPV4_ROUTE_ADD sent from client. Update re and
@@ -2103,7 +2380,8 @@ static void zread_vrf_unregister(ZAPI_HANDLER_ARGS)
 	vrf_bitmap_unset(client->ridinfo, zvrf_id(zvrf));
 }
 
-static void zread_mpls_labels(ZAPI_HANDLER_ARGS)
+/* One of the entries of a label message, false past the last */
+static bool zread_mpls_labels_one(ZAPI_HANDLER_ARGS)
 {
 	struct stream *s;
 	enum lsp_types_t type;
@@ -2128,7 +2406,7 @@ static void zread_mpls_labels(ZAPI_HANDLER_ARGS)
 			zlog_warn(
 				"%s: Specified prefix length %d is greater than a v4 address can support",
 				__PRETTY_FUNCTION__, prefix.prefixlen);
-			return;
+			return false;
 		}
 		STREAM_GET(&gate.ipv4.s_addr, s, IPV4_MAX_BYTELEN);
 		break;
@@ -2139,14 +2417,14 @@ static void zread_mpls_labels(ZAPI_HANDLER_ARGS)
 			zlog_warn(
 				"%s: Specified prefix length %d is greater than a v6 address can support",
 				__PRETTY_FUNCTION__, prefix.prefixlen);
-			return;
+			return false;
 		}
 		STREAM_GET(&gate.ipv6, s, 16);
 		break;
 	default:
 		zlog_warn("%s: Specified AF %d is not supported for this call",
 			  __PRETTY_FUNCTION__, prefix.family);
-		return;
+		return false;
 	}
 	STREAM_GETL(s, ifindex);
 	STREAM_GETC(s, distance);
@@ -2167,11 +2445,11 @@ static void zread_mpls_labels(ZAPI_HANDLER_ARGS)
 			gtype = NEXTHOP_TYPE_IPV6;
 		break;
 	default:
-		return;
+		return false;
 	}
 
 	if (!mpls_enabled)
-		return;
+		return false;
 
 	if (hdr->command == ZEBRA_MPLS_LABELS_ADD) {
 		mpls_lsp_install(zvrf, type, in_label, out_label, gtype, &gate,
@@ -2183,8 +2461,21 @@ static void zread_mpls_labels(ZAPI_HANDLER_ARGS)
 		mpls_ftn_update(0, zvrf, type, &prefix, gtype, &gate, ifindex,
 				distance, out_label);
 	}
+	return true;
+
 stream_failure:
-	return;
+	return false;
+}
+
+/*
+ * A label message carries one or more entries, ldpd packing the label
+ * changes of an IGP update in as few messages as it can.
+ */
+static void zread_mpls_labels(ZAPI_HANDLER_ARGS)
+{
+	while (STREAM_READABLE(msg)
+	       && zread_mpls_labels_one(client, hdr, msg, zvrf))
+		;
 }
 
 static int zsend_table_manager_connect_response(struct zserv *client,
@@ -2338,7 +2629,7 @@ static void zread_label_manager_request(ZAPI_HANDLER_ARGS)
 
 	/* external label manager */
 	if (lm_is_external)
-		zread_relay_label_manager_request(hdr->command, client,
+		zread_relay_label_manager_request(hdr->command, client, msg,
 						  zvrf_id(zvrf));
 	/* this is a label manager */
 	else {
@@ -2771,6 +3062,9 @@ void (*zserv_handlers[])(ZAPI_HANDLER_ARGS) = {
 	[ZEBRA_TABLE_MANAGER_CONNECT] = zread_table_manager_request,
 	[ZEBRA_GET_TABLE_CHUNK] = zread_table_manager_request,
 	[ZEBRA_RELEASE_TABLE_CHUNK] = zread_table_manager_request,
+	[ZEBRA_ROUTE_ADD_BULK] = zread_route_add_bulk,
+	[ZEBRA_ROUTE_DELETE_BULK] = zread_route_del_bulk,
+	[ZEBRA_IPMR_ROUTE_STATS_BULK] = zebra_ipmr_route_stats_bulk,
 };
 
 static inline void zserv_handle_commands(struct zserv *client,
@@ -2792,6 +3086,13 @@ static inline void zserv_handle_commands(struct zserv *client,
 /* free zebra client information. */
 static void zebra_client_free(struct zserv *client)
 {
+	/* Stop the I/O pthread; everything below is ours alone afterwards */
+	if (client->pthread) {
+		frr_pthread_stop(client->pthread, NULL);
+		frr_pthread_destroy(client->pthread);
+		client->pthread = NULL;
+	}
+
 	/* Send client de-registration to BFD */
 	zebra_ptm_bfd_client_deregister(client->proto);
 
@@ -2803,6 +3104,7 @@ static void zebra_client_free(struct zserv *client)
 
 	/* Release Label Manager chunks */
 	release_daemon_label_chunks(client->proto, client->instance);
+	label_manager_client_close(client);
 
 	/* Release Table Manager chunks */
 	release_daemon_table_chunks(client->proto, client->instance);
@@ -2832,20 +3134,30 @@ static void zebra_client_free(struct zserv *client)
 		stream_free(client->ibuf_work);
 	if (client->obuf_work)
 		stream_free(client->obuf_work);
+	if (client->rule_notify)
+		stream_free(client->rule_notify);
+	if (client->bfd_update)
+		stream_free(client->bfd_update);
 	if (client->ibuf_fifo)
 		stream_fifo_free(client->ibuf_fifo);
 	if (client->obuf_fifo)
 		stream_fifo_free(client->obuf_fifo);
+	if (client->obuf_queued) {
+		hash_clean(client->obuf_queued, zserv_queued_free);
+		hash_free(client->obuf_queued);
+	}
 	if (client->wb)
 		buffer_free(client->wb);
 
-	/* Release threads. */
-	if (client->t_read)
-		thread_cancel(client->t_read);
-	if (client->t_write)
-		thread_cancel(client->t_write);
-	if (client->t_suicide)
-		thread_cancel(client->t_suicide);
+	/*
+	 * Release threads; t_read and t_write went away with the pthread's
+	 * thread master.
+	 */
+	THREAD_OFF(client->t_process);
+	THREAD_OFF(client->t_suicide);
+
+	pthread_mutex_destroy(&client->ibuf_mtx);
+	pthread_mutex_destroy(&client->obuf_mtx);
 
 	/* Free bitmaps. */
 	for (afi_t afi = AFI_IP; afi < AFI_MAX; afi++)
@@ -2860,7 +3172,7 @@ static void zebra_client_free(struct zserv *client)
 }
 
 /*
- * Called from client thread to terminate itself.
+ * Called on the main thread to terminate a client.
  */
 static void zebra_client_close(struct zserv *client)
 {
@@ -2881,9 +3193,14 @@ static void zebra_client_create(int sock)
 	client->sock = sock;
 	client->ibuf_fifo = stream_fifo_new();
 	client->obuf_fifo = stream_fifo_new();
+	client->obuf_queued = hash_create(zserv_queued_hash_key,
+					  zserv_queued_hash_cmp,
+					  "Zebra client queued messages");
 	client->ibuf_work = stream_new(ZEBRA_MAX_PACKET_SIZ);
 	client->obuf_work = stream_new(ZEBRA_MAX_PACKET_SIZ);
 	client->wb = buffer_new(0);
+	pthread_mutex_init(&client->ibuf_mtx, NULL);
+	pthread_mutex_init(&client->obuf_mtx, NULL);
 
 	/* Set table number. */
 	client->rtm_table = zebrad.rtm_table_default;
@@ -2903,6 +3220,20 @@ static void zebra_client_create(int sock)
 	/* Add this client to linked list. */
 	listnode_add(zebrad.client_list, client);
 
+	/* Start the client's I/O pthread */
+	client->pthread = frr_pthread_new(NULL, "Zebra API client thread");
+	if (!client->pthread || frr_pthread_run(client->pthread, NULL)) {
+		zlog_err("Can't start I/O pthread for zserv client fd %d",
+			 sock);
+		if (client->pthread) {
+			frr_pthread_destroy(client->pthread);
+			client->pthread = NULL;
+		}
+		zebra_client_close(client);
+		return;
+	}
+	frr_pthread_wait_running(client->pthread);
+
 	zebra_vrf_update_all(client);
 
 	/* start read loop */
@@ -2913,11 +3244,22 @@ static int zserv_delayed_close(struct thread *thread)
 {
 	struct zserv *client = THREAD_ARG(thread);
 
-	client->t_suicide = NULL;
 	zebra_client_close(client);
 	return 0;
 }
 
+/*
+ * Called on the client pthread when the connection failed.
+ *
+ * The client is torn down on the main thread, which owns all its other
+ * state; the pthread simply stops scheduling I/O for it.
+ */
+static void zserv_fail(struct zserv *client)
+{
+	thread_add_event(zebrad.master, zserv_delayed_close, client, 0,
+			 &client->t_suicide);
+}
+
 /*
  * Log zapi message to zlog.
  *
@@ -2944,89 +3286,103 @@ static void zserv_log_message(const char *errmsg, struct stream *msg,
 	zlog_hexdump(msg->data, STREAM_READABLE(msg));
 }
 
+/* Runs on the client pthread. */
 static int zserv_flush_data(struct thread *thread)
 {
 	struct zserv *client = THREAD_ARG(thread);
+	unsigned long queued;
 
-	client->t_write = NULL;
-	if (client->t_suicide) {
-		zebra_client_close(client);
-		return -1;
-	}
 	switch (buffer_flush_available(client->wb, client->sock)) {
 	case BUFFER_ERROR:
 		zlog_warn(
 			"%s: buffer_flush_available failed on zserv client fd %d, closing",
 			__func__, client->sock);
-		zebra_client_close(client);
-		client = NULL;
-		break;
+		zserv_fail(client);
+		return -1;
 	case BUFFER_PENDING:
-		client->t_write = NULL;
-		thread_add_write(zebrad.master, zserv_flush_data, client,
-				 client->sock, &client->t_write);
+		thread_add_write(client->pthread->master, zserv_flush_data,
+				 client, client->sock, &client->t_write);
 		break;
 	case BUFFER_EMPTY:
+		/* messages queued meanwhile were waiting on us */
+		pthread_mutex_lock(&client->obuf_mtx);
+		{
+			queued = client->obuf_fifo->count;
+		}
+		pthread_mutex_unlock(&client->obuf_mtx);
+
+		if (queued)
+			zebra_event(client, ZEBRA_WRITE);
 		break;
 	}
 
-	if (client)
-		client->last_write_time = monotime(NULL);
+	atomic_store_explicit(&client->last_write_time, monotime(NULL),
+			      memory_order_relaxed);
 	return 0;
 }
 
 /*
- * Write a single packet.
+ * Write all queued packets, runs on the client pthread.
  */
 static int zserv_write(struct thread *thread)
 {
 	struct zserv *client = THREAD_ARG(thread);
 	struct stream *msg;
-	int writerv;
-
-	if (client->t_suicide)
-		return -1;
+	int writerv = BUFFER_EMPTY;
+	bool resume = false;
 
 	if (client->is_synchronous)
 		return 0;
 
-	msg = stream_fifo_pop(client->obuf_fifo);
-	stream_set_getp(msg, 0);
-	client->last_write_cmd = stream_getw_from(msg, 6);
+	while (writerv != BUFFER_ERROR) {
+		pthread_mutex_lock(&client->obuf_mtx);
+		{
+			msg = stream_fifo_pop(client->obuf_fifo);
+			if (msg)
+				client->obuf_popped++;
+			if (client->obuf_congested
+			    && client->obuf_fifo->count <= zebrad.zapi_wm_low) {
+				client->obuf_congested = false;
+				resume = true;
+			}
+		}
+		pthread_mutex_unlock(&client->obuf_mtx);
+
+		if (resume)
+			thread_add_event(zebrad.master, zserv_process_messages,
+					 client, 0, &client->t_process);
 
-	writerv = buffer_write(client->wb, client->sock, STREAM_DATA(msg),
-			       stream_get_endp(msg));
+		if (!msg)
+			break;
 
-	stream_free(msg);
+		stream_set_getp(msg, 0);
+		atomic_store_explicit(&client->last_write_cmd,
+				      stream_getw_from(msg, 6),
+				      memory_order_relaxed);
+
+		writerv = buffer_write(client->wb, client->sock,
+				       STREAM_DATA(msg), stream_get_endp(msg));
+
+		stream_free(msg);
+	}
 
 	switch (writerv) {
 	case BUFFER_ERROR:
 		zlog_warn(
 			"%s: buffer_write failed to zserv client fd %d, closing",
 			__func__, client->sock);
-		/*
-		 * Schedule a delayed close since many of the functions that
-		 * call this one do not check the return code. They do not
-		 * allow for the possibility that an I/O error may have caused
-		 * the client to be deleted.
-		 */
-		client->t_suicide = NULL;
-		thread_add_event(zebrad.master, zserv_delayed_close, client, 0,
-				 &client->t_suicide);
+		zserv_fail(client);
 		return -1;
 	case BUFFER_EMPTY:
-		THREAD_OFF(client->t_write);
 		break;
 	case BUFFER_PENDING:
-		thread_add_write(zebrad.master, zserv_flush_data, client,
-				 client->sock, &client->t_write);
+		thread_add_write(client->pthread->master, zserv_flush_data,
+				 client, client->sock, &client->t_write);
 		break;
 	}
 
-	if (client->obuf_fifo->count)
-		zebra_event(client, ZEBRA_WRITE);
-
-	client->last_write_time = monotime(NULL);
+	atomic_store_explicit(&client->last_write_time, monotime(NULL),
+			      memory_order_relaxed);
 	return 0;
 }
 
@@ -3050,16 +3406,52 @@ static void zserv_write_incoming(struct stream *orig, uint16_t command)
 }
 #endif
 
+/*
+ * Process messages read by the client pthread, on the main thread.
+ *
+ * At most packets_to_process messages are handled per run so that one busy
+ * client can't starve the others; if more are waiting the job is simply
+ * rescheduled behind everybody else's.
+ */
 static int zserv_process_messages(struct thread *thread)
 {
 	struct zserv *client = THREAD_ARG(thread);
+	struct stream_fifo *cache;
 	struct zebra_vrf *zvrf;
 	struct zmsghdr hdr;
 	struct stream *msg;
 	bool hdrvalid;
+	uint32_t p2p = zebrad.packets_to_process;
+	unsigned long left;
+	bool congested;
+
+	/* zserv_write() picks up again once the client caught up */
+	pthread_mutex_lock(&client->obuf_mtx);
+	{
+		congested = client->obuf_congested;
+	}
+	pthread_mutex_unlock(&client->obuf_mtx);
+
+	if (congested)
+		return 0;
+
+	cache = stream_fifo_new();
+	pthread_mutex_lock(&client->ibuf_mtx);
+	{
+		while (p2p-- && (msg = stream_fifo_pop(client->ibuf_fifo)))
+			stream_fifo_push(cache, msg);
+		left = client->ibuf_fifo->count;
+	}
+	pthread_mutex_unlock(&client->ibuf_mtx);
+
+	if (left)
+		thread_add_event(zebrad.master, zserv_process_messages, client,
+				 0, &client->t_process);
+	if (left < ZSERV_IBUF_FIFO_MAX)
+		zebra_event(client, ZEBRA_READ);
 
 	do {
-		msg = stream_fifo_pop(client->ibuf_fifo);
+		msg = stream_fifo_pop(cache);
 
 		/* break if out of messages */
 		if (!msg)
@@ -3089,15 +3481,23 @@ static int zserv_process_messages(struct thread *thread)
 
 	} while (msg);
 
+	stream_fifo_free(cache);
 	return 0;
 }
 
-/* Handler of zebra service request. */
+/*
+ * Handler of zebra service request, runs on the client pthread.
+ *
+ * Complete messages are queued on ibuf_fifo for zserv_process_messages().
+ * Reading pauses while ZSERV_IBUF_FIFO_MAX messages are waiting, the main
+ * thread resumes it once it caught up.
+ */
 static int zserv_read(struct thread *thread)
 {
 	int sock;
 	struct zserv *client;
 	size_t already;
+	unsigned long queued = 0;
 #if defined(HANDLE_ZAPI_FUZZING)
 	int packets = 1;
 #else
@@ -3107,11 +3507,6 @@ static int zserv_read(struct thread *thread)
 	sock = THREAD_FD(thread);
 	client = THREAD_ARG(thread);
 
-	if (client->t_suicide) {
-		zebra_client_close(client);
-		return -1;
-	}
-
 	while (packets) {
 		struct zmsghdr hdr;
 		ssize_t nb;
@@ -3204,16 +3599,20 @@ static int zserv_read(struct thread *thread)
 		if (IS_ZEBRA_DEBUG_PACKET && IS_ZEBRA_DEBUG_RECV)
 			zserv_log_message(NULL, client->ibuf_work, &hdr);
 
-		client->last_read_time = monotime(NULL);
-		client->last_read_cmd = hdr.command;
+		atomic_store_explicit(&client->last_read_time, monotime(NULL),
+				      memory_order_relaxed);
+		atomic_store_explicit(&client->last_read_cmd, hdr.command,
+				      memory_order_relaxed);
 
 		stream_set_getp(client->ibuf_work, 0);
 		struct stream *msg = stream_dup(client->ibuf_work);
 
-		stream_fifo_push(client->ibuf_fifo, msg);
-
-		if (client->t_suicide)
-			goto zread_fail;
+		pthread_mutex_lock(&client->ibuf_mtx);
+		{
+			stream_fifo_push(client->ibuf_fifo, msg);
+			queued = client->ibuf_fifo->count;
+		}
+		pthread_mutex_unlock(&client->ibuf_mtx);
 
 		--packets;
 		stream_reset(client->ibuf_work);
@@ -3224,28 +3623,34 @@ static int zserv_read(struct thread *thread)
 			   zebrad.packets_to_process - packets);
 
 	/* Schedule job to process those packets */
-	thread_add_event(zebrad.master, &zserv_process_messages, client, 0,
-			 NULL);
+	if (queued)
+		thread_add_event(zebrad.master, zserv_process_messages, client,
+				 0, &client->t_process);
 
-	/* Reschedule ourselves */
-	zebra_event(client, ZEBRA_READ);
+	/* Reschedule ourselves, unless the main thread is behind */
+	if (queued < ZSERV_IBUF_FIFO_MAX)
+		zebra_event(client, ZEBRA_READ);
 
 	return 0;
 
 zread_fail:
-	zebra_client_close(client);
+	zserv_fail(client);
 	return -1;
 }
 
+/* May be called from either thread. */
 static void zebra_event(struct zserv *client, enum event event)
 {
+	if (!client->pthread)
+		return;
+
 	switch (event) {
 	case ZEBRA_READ:
-		thread_add_read(zebrad.master, zserv_read, client, client->sock,
-				&client->t_read);
+		thread_add_read(client->pthread->master, zserv_read, client,
+				client->sock, &client->t_read);
 		break;
 	case ZEBRA_WRITE:
-		thread_add_write(zebrad.master, zserv_write, client,
+		thread_add_write(client->pthread->master, zserv_write, client,
 				 client->sock, &client->t_write);
 		break;
 	}
@@ -3387,6 +3792,16 @@ static void zebra_show_client_detail(struct vty *vty, struct zserv *client)
 {
 	char cbuf[ZEBRA_TIME_BUF], rbuf[ZEBRA_TIME_BUF];
 	char wbuf[ZEBRA_TIME_BUF], nhbuf[ZEBRA_TIME_BUF], mbuf[ZEBRA_TIME_BUF];
+	time_t last_read_time, last_write_time;
+	uint32_t obuf_max, congested_cnt, coalesced_cnt;
+	unsigned long queued;
+	bool congested;
+
+	/* updated by the client pthread */
+	last_read_time = atomic_load_explicit(&client->last_read_time,
+					      memory_order_relaxed);
+	last_write_time = atomic_load_explicit(&client->last_write_time,
+					       memory_order_relaxed);
 
 	vty_out(vty, "Client: %s", zebra_route_string(client->proto));
 	if (client->instance)
@@ -3413,13 +3828,13 @@ static void zebra_show_client_detail(struct vty *vty, struct zserv *client)
 		vty_out(vty, "Not registered for Nexthop Updates\n");
 
 	vty_out(vty, "Last Msg Rx Time: %s \n",
-		zserv_time_buf(&client->last_read_time, rbuf, ZEBRA_TIME_BUF));
+		zserv_time_buf(&last_read_time, rbuf, ZEBRA_TIME_BUF));
 	vty_out(vty, "Last Msg Tx Time: %s \n",
-		zserv_time_buf(&client->last_write_time, wbuf, ZEBRA_TIME_BUF));
-	if (client->last_read_time)
+		zserv_time_buf(&last_write_time, wbuf, ZEBRA_TIME_BUF));
+	if (last_read_time)
 		vty_out(vty, "Last Rcvd Cmd: %s \n",
 			zserv_command_string(client->last_read_cmd));
-	if (client->last_write_time)
+	if (last_write_time)
 		vty_out(vty, "Last Sent Cmd: %s \n",
 			zserv_command_string(client->last_write_cmd));
 	vty_out(vty, "\n");
@@ -3447,6 +3862,21 @@ static void zebra_show_client_detail(struct vty *vty, struct zserv *client)
 	vty_out(vty, "MAC-IP add notifications: %d\n", client->macipadd_cnt);
 	vty_out(vty, "MAC-IP delete notifications: %d\n", client->macipdel_cnt);
 
+	pthread_mutex_lock(&client->obuf_mtx);
+	{
+		queued = client->obuf_fifo->count;
+		congested = client->obuf_congested;
+		obuf_max = client->obuf_max;
+		congested_cnt = client->obuf_congested_cnt;
+		coalesced_cnt = client->obuf_coalesced_cnt;
+	}
+	pthread_mutex_unlock(&client->obuf_mtx);
+
+	vty_out(vty, "Output queue: %lu%s, max %u\n", queued,
+		congested ? " (congested)" : "", obuf_max);
+	vty_out(vty, "Output queue congestions: %u\n", congested_cnt);
+	vty_out(vty, "Output messages coalesced: %u\n", coalesced_cnt);
+
 	vty_out(vty, "\n");
 	return;
 }
@@ -3455,12 +3885,18 @@ static void zebra_show_client_brief(struct vty *vty, struct zserv *client)
 {
 	char cbuf[ZEBRA_TIME_BUF], rbuf[ZEBRA_TIME_BUF];
 	char wbuf[ZEBRA_TIME_BUF];
+	time_t last_read_time, last_write_time;
+
+	last_read_time = atomic_load_explicit(&client->last_read_time,
+					      memory_order_relaxed);
+	last_write_time = atomic_load_explicit(&client->last_write_time,
+					       memory_order_relaxed);
 
 	vty_out(vty, "%-8s%12s %12s%12s%8d/%-8d%8d/%-8d\n",
 		zebra_route_string(client->proto),
 		zserv_time_buf(&client->connect_time, cbuf, ZEBRA_TIME_BUF),
-		zserv_time_buf(&client->last_read_time, rbuf, ZEBRA_TIME_BUF),
-		zserv_time_buf(&client->last_write_time, wbuf, ZEBRA_TIME_BUF),
+		zserv_time_buf(&last_read_time, rbuf, ZEBRA_TIME_BUF),
+		zserv_time_buf(&last_write_time, wbuf, ZEBRA_TIME_BUF),
 		client->v4_route_add_cnt + client->v4_route_upd8_cnt,
 		client->v4_route_del_cnt,
 		client->v6_route_add_cnt + client->v6_route_upd8_cnt,
@@ -28,6 +28,7 @@
 #include "routemap.h"
 #include "vty.h"
 #include "zclient.h"
+#include "frr_pthread.h"
 
 #include "zebra/zebra_ns.h"
 #include "zebra/zebra_pw.h"
@@ -43,13 +44,47 @@
 
 /* Client structure. */
 struct zserv {
+	/* Client pthread, does all socket I/O */
+	struct frr_pthread *pthread;
+
 	/* Client file descriptor. */
 	int sock;
 
 	/* Input/output buffer to the client. */
+	pthread_mutex_t ibuf_mtx;
 	struct stream_fifo *ibuf_fifo;
+	pthread_mutex_t obuf_mtx;
 	struct stream_fifo *obuf_fifo;
 
+	/*
+	 * Messages on obuf_fifo by what they are about, so that a newer one
+	 * takes the place of one not sent yet.  obuf_pushed and obuf_popped
+	 * count the messages into and out of obuf_fifo.  Requests are not
+	 * processed while obuf_congested, from when obuf_fifo reaches the
+	 * high watermark until it's down to the low one.
+	 *
+	 * Requires: obuf_mtx
+	 */
+	struct hash *obuf_queued;
+	uint64_t obuf_pushed;
+	uint64_t obuf_popped;
+	bool obuf_congested;
+	uint32_t obuf_max;
+	uint32_t obuf_congested_cnt;
+	uint32_t obuf_coalesced_cnt;
+
+	/*
+	 * ZEBRA_RULE_NOTIFY_OWNER messages not queued yet, they go out
+	 * together, see zsend_rule_notify_owner().
+	 */
+	struct stream *rule_notify;
+
+	/*
+	 * ZEBRA_INTERFACE_BFD_DEST_UPDATE messages not queued yet, see
+	 * zsend_interface_bfd_update().
+	 */
+	struct stream *bfd_update;
+
 	/* Private I/O buffers */
 	struct stream *ibuf_work;
 	struct stream *obuf_work;
@@ -57,10 +92,13 @@ struct zserv {
 	/* Buffer of data waiting to be written to client. */
 	struct buffer *wb;
 
-	/* Threads for read/write. */
+	/* Threads for read/write, run on the client pthread. */
 	struct thread *t_read;
 	struct thread *t_write;
 
+	/* Event for message processing, run on the main thread. */
+	struct thread *t_process;
+
 	/* Thread for delayed close. */
 	struct thread *t_suicide;
 
@@ -123,14 +161,14 @@ struct zserv {
 	uint32_t prefixdel_cnt;
 
 	time_t connect_time;
-	time_t last_read_time;
-	time_t last_write_time;
+	_Atomic time_t last_read_time;
+	_Atomic time_t last_write_time;
 	time_t nh_reg_time;
 	time_t nh_dereg_time;
 	time_t nh_last_upd_time;
 
-	int last_read_cmd;
-	int last_write_cmd;
+	_Atomic int last_read_cmd;
+	_Atomic int last_write_cmd;
 };
 
 #define ZAPI_HANDLER_ARGS                                                      \
@@ -151,6 +189,30 @@ struct zebra_t {
 	struct work_queue *ribq;
 	struct meta_queue *mq;
 
+	/* route nodes processed per run of ribq */
+#define ZEBRA_RIB_PROCESS_BATCH 100
+	uint32_t rib_batch;
+
+	/* longest a run of ribq or the LSP queue should take, in msecs,
+	 * 0 for fixed granularity and hold time
+	 */
+	uint32_t wq_max_stall;
+
+	/* a client's requests aren't processed while this many messages wait
+	 * to be sent to it, until down to the low watermark
+	 */
+#define ZEBRA_ZAPI_WM_HIGH 100000
+#define ZEBRA_ZAPI_WM_LOW 10000
+	uint32_t zapi_wm_high;
+	uint32_t zapi_wm_low;
+
+	/* msecs up/down changes are held back while an interface flaps */
+#define ZEBRA_IF_HOLD_TIME 0
+	uint32_t if_hold_time;
+
+	/* routes left in the kernel by an earlier run are yet to be swept */
+	bool sweep_pending;
+
 	/* LSP work queue */
 	struct work_queue *lsp_process_q;
 
@@ -177,6 +239,28 @@ extern void nbr_connected_delete_ipv6(struct interface *, struct in6_addr *);
 extern int zsend_interface_update(int, struct zserv *, struct interface *);
 extern int zsend_redistribute_route(int, struct zserv *, struct prefix *,
 				    struct prefix *, struct route_entry *);
+extern struct stream *zserv_encode_redistribute_route(int cmd,
+						      struct prefix *p,
+						      struct prefix *src_p,
+						      struct route_entry *re);
+extern int zsend_redistribute(struct zserv *client, struct stream *msg,
+			      struct prefix *p, struct prefix *src_p,
+			      struct route_entry *re);
+
+/* What a message is about, see zebra_server_send_coalesced() */
+struct zserv_msg_key {
+	uint16_t cmd;
+	vrf_id_t vrf_id;
+	uint8_t type;
+	unsigned short instance;
+	struct prefix p;
+	struct prefix_ipv6 src_p;
+};
+
+/* Zeroes key and fills it in; src_p may be NULL. */
+extern void zserv_msg_key_init(struct zserv_msg_key *key, uint16_t cmd,
+			       vrf_id_t vrf_id, const struct prefix *p,
+			       const struct prefix *src_p);
 extern int zsend_router_id_update(struct zserv *, struct prefix *, vrf_id_t);
 extern int zsend_interface_vrf_update(struct zserv *, struct interface *,
 				      vrf_id_t);
@@ -195,6 +279,15 @@ extern void zserv_nexthop_num_warn(const char *, const struct prefix *,
 				   const unsigned int);
 extern int zebra_server_send_message(struct zserv *client, struct stream *msg);
 
+/*
+ * Like zebra_server_send_message(), but while a message with the same key is
+ * still waiting to be sent to the client, msg takes its place instead.  msg
+ * is shared rather than taken over, the caller still has to free it.
+ */
+extern int zebra_server_send_coalesced(struct zserv *client,
+				       struct stream *msg,
+				       struct zserv_msg_key *key);
+
 extern struct zserv *zebra_find_client(uint8_t proto, unsigned short instance);
 
 #if defined(HANDLE_ZAPI_FUZZING)